@@ -0,0 +1,943 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+#include "DB_index.hh"
+#include "DB_art.hh"
+#include "DB_btree.hh"
+
+namespace bench {
+
+// An ordered index with the interface of ordered_index, on a tree of
+// fixed-length byte keys instead of Masstree: an adaptive radix tree
+// (DB_art.hh) or an optimistic B+tree (DB_btree.hh). It supports point
+// selects, inserts, deletes and range scans over keys of sizeof(K) bytes,
+// whose Str conversions order them. Rows are versioned as in ordered_index,
+// and absent keys and scans are protected by the versions of the tree
+// nodes they read (node items). OCC only; logging, checkpoints, immutable
+// tables, range and filter predicates, TicToc node tracking and batched
+// selects stay with ordered_index.
+//
+// With DeferInserts, insert_row leaves the tree alone: new rows wait in a
+// per-thread sorted overlay, which this transaction's selects, deletes and
+// scans consult, and enter the tree when lock() takes their row locks. An
+// aborted insert then never touches the tree, so it neither bumps node
+// versions under other transactions' scans nor leaves garbage to reclaim.
+// The price is at commit: an insert that creates a node under a node this
+// transaction read aborts, since node reads cannot be added that late.
+template <typename K, typename V, typename DBParams,
+          template <typename, size_t, typename> class Tree,
+          bool DeferInserts = (STO_DEFER_INSERTS != 0)>
+class tree_ordered_index : public TObject {
+public:
+    static_assert(!DBParams::MVCC, "tree_ordered_index is OCC only");
+
+    typedef K key_type;
+    typedef V value_type;
+    typedef commutators::Commutator<value_type> comm_type;
+
+    typedef typename get_version<DBParams>::type version_type;
+
+    using accessor_t = typename index_common<K, V, DBParams>::accessor_t;
+
+    static constexpr typename version_type::type invalid_bit = TransactionTid::user_bit;
+    static constexpr TransItem::flags_type insert_bit = TransItem::user0_bit;
+    static constexpr TransItem::flags_type delete_bit = TransItem::user0_bit << 1u;
+    static constexpr TransItem::flags_type row_update_bit = TransItem::user0_bit << 2u;
+    static constexpr TransItem::flags_type row_cell_bit = TransItem::user0_bit << 3u;
+    static constexpr TransItem::flags_type comm_applied_bit = TransItem::user0_bit << 4u;
+    static constexpr TransItem::flags_type deferred_bit = TransItem::user0_bit << 5u;
+    static constexpr uintptr_t internode_bit = 1;
+
+    typedef typename value_type::NamedColumn NamedColumn;
+    typedef IndexValueContainer<V, version_type> value_container_type;
+
+    static constexpr bool value_is_small = is_small<V>::value;
+
+    static constexpr bool index_read_my_write = DBParams::RdMyWr;
+
+    struct internal_elem : pool_allocated<internal_elem> {
+        key_type key;
+        value_container_type row_container;
+        bool deleted;
+
+        internal_elem(const key_type& k, const value_type& v, bool valid)
+            : key(k),
+              row_container((valid ? Sto::initialized_tid() : (Sto::initialized_tid() | invalid_bit)),
+                            !valid, v),
+              deleted(false) {}
+
+        version_type& version() {
+            return row_container.row_version();
+        }
+
+        bool valid() {
+            return !(version().value() & invalid_bit);
+        }
+    };
+
+    // Keys are their own bytes, as their Str conversions are
+    struct elem_key {
+        const void* operator()(const internal_elem* e) const {
+            return key_bytes(e->key);
+        }
+    };
+
+    typedef Masstree::Str Str;
+    typedef Tree<internal_elem, sizeof(K), elem_key> tree_type;
+    typedef typename tree_type::node node_type;
+    typedef typename tree_type::version_value_type nodeversion_value_type;
+
+    using column_access_t = typename split_version_helpers<tree_ordered_index<K, V, DBParams, Tree, DeferInserts>>::column_access_t;
+    using item_key_t = typename split_version_helpers<tree_ordered_index<K, V, DBParams, Tree, DeferInserts>>::item_key_t;
+    template <typename T>
+    static constexpr auto column_to_cell_accesses
+        = split_version_helpers<tree_ordered_index<K, V, DBParams, Tree, DeferInserts>>::template column_to_cell_accesses<T>;
+    template <typename T, typename... Accs>
+    static constexpr auto static_cell_accesses
+        = split_version_helpers<tree_ordered_index<K, V, DBParams, Tree, DeferInserts>>::template static_cell_accesses<T, Accs...>;
+    template <typename T>
+    static constexpr auto extract_item_list
+        = split_version_helpers<tree_ordered_index<K, V, DBParams, Tree, DeferInserts>>::template extract_item_list<T>;
+    template <typename T>
+    static constexpr auto ro_access_all
+        = split_version_helpers<tree_ordered_index<K, V, DBParams, Tree, DeferInserts>>::template ro_access_all<T>;
+
+    typedef std::tuple<bool, bool>                               ins_return_type;
+    typedef std::tuple<bool, bool>                               del_return_type;
+    typedef std::tuple<bool, bool, uintptr_t, UniRecordAccessor<V>> sel_split_return_type;
+
+    tree_ordered_index(size_t init_size) {
+        this->table_init();
+        (void)init_size;
+    }
+    tree_ordered_index() {
+        this->table_init();
+    }
+
+    void table_init() {
+        key_gen_ = 0;
+        if (DeferInserts)
+            overlays_.resize(MAX_THREADS);
+    }
+
+    // The tree needs no per-thread state
+    static void thread_init() {
+    }
+
+    uint64_t gen_key() {
+        return fetch_and_add(&key_gen_, 1);
+    }
+    void skip_keys(uint64_t n) {
+        if (key_gen_ < n)
+            key_gen_ = n;
+    }
+
+    // Reads and validates only the columns Cols of the row at key, and
+    // returns copies of them (see DB_projection.hh)
+    template <typename V::NamedColumn... Cols>
+    std::tuple<bool, bool, projection<V, Cols...>>
+    select_row(const key_type& key) {
+        return select_projection<V, Cols...>(*this, key);
+    }
+
+    [[nodiscard]] sel_split_return_type
+    select_split_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
+        return find_split_row(key, accesses);
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(const key_type& key, static_accesses<Accs...> accesses) {
+        return find_split_row(key, accesses);
+    }
+
+    template <typename Accesses>
+    [[nodiscard]] sel_split_return_type
+    find_split_row(const key_type& key, const Accesses& accesses) {
+        if (internal_elem* p = find_pending(key))
+            return select_split_row(reinterpret_cast<uintptr_t>(p), accesses);
+        node_type* node;
+        nodeversion_value_type nv;
+        internal_elem* e = tree_.lookup(key_bytes(key), node, nv);
+        if (e)
+            return select_split_row(reinterpret_cast<uintptr_t>(e), accesses);
+        return {register_internode_version(node, nv), false, 0, UniRecordAccessor<V>(nullptr)};
+    }
+
+    [[nodiscard]] sel_split_return_type
+    select_split_row(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
+        return select_split_cells(rid, column_to_cell_accesses<value_container_type>(accesses));
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(uintptr_t rid, static_accesses<Accs...>) {
+#if STO_PROFILE_COLUMNS
+        column_profile::record<value_type, std::initializer_list<column_access_t>>(
+                {column_access_t(Accs::column, Accs::access)...});
+#endif
+        constexpr auto cell_accesses = static_cell_accesses<value_container_type, Accs...>();
+        return select_split_cells(rid, cell_accesses);
+    }
+
+    [[nodiscard]] sel_split_return_type
+    select_split_cells(uintptr_t rid, const std::array<access_t, value_container_type::num_versions>& cell_accesses) {
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        if constexpr (supports_ro_observe<version_type>::value) {
+            if (Sto::readonly()) {
+                if (!e->valid() || !ro_access_all<value_container_type>(cell_accesses, e->row_container))
+                    return {false, false, 0, UniRecordAccessor<V>(nullptr)};
+                return {true, true, rid, UniRecordAccessor<V>(&(e->row_container.row))};
+            }
+        }
+        TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
+
+        std::array<TransItem*, value_container_type::num_versions> cell_items {};
+        bool any_has_write;
+        bool ok;
+        std::tie(any_has_write, cell_items) = extract_item_list<value_container_type>(cell_accesses, this, e);
+
+        if (is_phantom(e, row_item))
+            goto abort;
+
+        if (index_read_my_write) {
+            if (has_delete(row_item)) {
+                return {true, false, 0, UniRecordAccessor<V>(nullptr)};
+            }
+            if (any_has_write || has_row_update(row_item)) {
+                value_type *vptr;
+                if (has_insert(row_item))
+                    vptr = &e->row_container.row;
+                else
+                    vptr = row_item.template raw_write_value<value_type *>();
+                return {true, true, rid, UniRecordAccessor<V>(vptr)};
+            }
+        }
+
+        ok = access_all(cell_accesses, cell_items, e->row_container);
+        if (!ok)
+            goto abort;
+
+        return {true, true, rid, UniRecordAccessor<V>(&(e->row_container.row))};
+
+    abort:
+        return {false, false, 0, UniRecordAccessor<V>(nullptr)};
+    }
+
+    void update_row(uintptr_t rid, value_type *new_row) {
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        auto row_item = Sto::item(this, item_key_t::row_item_key(e));
+        if (value_is_small) {
+            row_item.acquire_write(e->version(), *new_row);
+        } else {
+            row_item.acquire_write(e->version(), new_row);
+        }
+    }
+
+    // As in ordered_index
+    void update_row(uintptr_t rid, const comm_type &comm) {
+        assert(&comm);
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        auto row_item = Sto::item(this, item_key_t::row_item_key(e));
+        if (fold_commute(row_item, comm))
+            return;
+        if (row_item.has_write() && !row_item.has_commute()) {
+            if (has_insert(row_item)) {
+                comm.operate(e->row_container.row);
+                return;
+            }
+            if (!value_is_small && has_row_update(row_item)) {
+                auto vptr = row_item.template raw_write_value<value_type*>();
+                if (vptr) {
+                    comm.operate(*vptr);
+                    return;
+                }
+            }
+        }
+        row_item.add_commute(comm);
+    }
+
+    // insert assumes common case where the row doesn't exist in the table
+    // if a row already exists, then use select (FOR UPDATE) instead
+    [[nodiscard]] ins_return_type
+    insert_row(const key_type& key, value_type *vptr, bool overwrite = false) {
+        internal_elem* e = nullptr;
+        internal_elem* found;
+        node_observer obs(this);
+        if (DeferInserts) {
+            found = find_pending(key);
+            if (!found)
+                found = tree_.lookup(key_bytes(key));
+            if (!found) {
+                // no node read needed: if another transaction inserts the
+                // key first, ours fails in lock()
+                e = new internal_elem(key, vptr ? *vptr : value_type(), false /*!valid*/);
+                overlay().emplace(pending_key(key), e);
+            }
+        } else {
+            e = new internal_elem(key, vptr ? *vptr : value_type(), false /*!valid*/);
+            found = tree_.insert(e, obs);
+            if (found)
+                delete e;
+        }
+        if (found) {
+            e = found;
+            TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
+
+            if (is_phantom(e, row_item))
+                goto abort;
+
+            if (index_read_my_write) {
+                if (has_delete(row_item)) {
+                    auto proxy = row_item.clear_flags(delete_bit).clear_write();
+
+                    if (value_is_small)
+                        proxy.add_write(*vptr);
+                    else
+                        proxy.add_write(vptr);
+
+                    return ins_return_type(true, false);
+                }
+            }
+
+            if (overwrite) {
+                bool ok;
+                if (value_is_small)
+                    ok = version_adapter::select_for_overwrite(row_item, e->version(), *vptr);
+                else
+                    ok = version_adapter::select_for_overwrite(row_item, e->version(), vptr);
+                if (!ok)
+                    goto abort;
+                if (index_read_my_write) {
+                    if (has_insert(row_item)) {
+                        copy_row(e, vptr);
+                    }
+                }
+            } else {
+                // observes that the row exists, but nothing more
+                if (!row_item.observe(e->version()))
+                    goto abort;
+            }
+        } else {
+            TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
+            row_item.acquire_write(e->version());
+            row_item.add_flags(DeferInserts ? insert_bit | deferred_bit : insert_bit);
+
+            // the nodes already in the read set and changed by the insert
+            if (!obs.ok)
+                goto abort;
+        }
+
+        return ins_return_type(true, found);
+
+    abort:
+        return ins_return_type(false, false);
+    }
+
+    [[nodiscard]] del_return_type
+    delete_row(const key_type& key) {
+        if (internal_elem* p = find_pending(key)) {
+            // our own insert, which never reached the tree
+            Sto::item(this, item_key_t::row_item_key(p)).clear_write().clear_flags(insert_bit | deferred_bit);
+            overlay().erase(pending_key(key));
+            Transaction::rcu_delete(p);
+            return del_return_type(true, true);
+        }
+        node_type* node;
+        nodeversion_value_type nv;
+        internal_elem* e = tree_.lookup(key_bytes(key), node, nv);
+        if (e) {
+            TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
+
+            if (is_phantom(e, row_item)) {
+                goto abort;
+            }
+
+            if (index_read_my_write) {
+                if (has_delete(row_item))
+                    return del_return_type(true, false);
+                if (!e->valid() && has_insert(row_item)) {
+                    row_item.add_flags(delete_bit);
+                    return del_return_type(true, true);
+                }
+            }
+
+            if (!version_adapter::select_for_update(row_item, e->version())) {
+                goto abort;
+            }
+            fence();
+            if (e->deleted) {
+                goto abort;
+            }
+            row_item.add_flags(delete_bit);
+        } else {
+            if (!register_internode_version(node, nv)) {
+                goto abort;
+            }
+        }
+
+        return del_return_type(true, e != nullptr);
+
+    abort:
+        return del_return_type(false, false);
+    }
+
+    // Visits the rows from begin up to end (excluded, and unbounded if
+    // empty), or with Reverse down from begin, as ordered_index::range_scan
+    // does
+    template <typename Callback, bool Reverse>
+    [[nodiscard]] bool range_scan(const key_type& begin, const key_type& end, Callback callback,
+                    std::initializer_list<column_access_t> accesses, bool phantom_protection = true, int limit = -1) {
+        auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
+
+        auto value_callback = [&] (internal_elem *e, bool& ret, bool& count) {
+            if constexpr (supports_ro_observe<version_type>::value) {
+                if (Sto::readonly()) {
+                    if (!ro_access_all<value_container_type>(cell_accesses, e->row_container))
+                        return false;
+                    if (!e->valid()) {
+                        ret = true;
+                        count = false;
+                        return true;
+                    }
+                    ret = callback(e->key, &(e->row_container.row));
+                    return true;
+                }
+            }
+            TransProxy row_item = index_read_my_write ? Sto::item(this, item_key_t::row_item_key(e))
+                                                      : Sto::fresh_item(this, item_key_t::row_item_key(e));
+
+            bool any_has_write;
+            std::array<TransItem*, value_container_type::num_versions> cell_items {};
+            std::tie(any_has_write, cell_items) = extract_item_list<value_container_type>(cell_accesses, this, e);
+
+            if (index_read_my_write) {
+                if (has_delete(row_item)) {
+                    ret = true;
+                    count = false;
+                    return true;
+                }
+                if (any_has_write) {
+                    if (has_insert(row_item))
+                        ret = callback(e->key, &(e->row_container.row));
+                    else
+                        ret = callback(e->key, row_item.template raw_write_value<value_type *>());
+                    return true;
+                }
+            }
+
+            bool ok = access_all(cell_accesses, cell_items, e->row_container);
+            if (!ok)
+                return false;
+
+            // skip invalid (inserted but yet committed) values, but do not abort
+            if (!e->valid()) {
+                ret = true;
+                count = false;
+                return true;
+            }
+
+            ret = callback(e->key, &(e->row_container.row));
+            return true;
+        };
+
+        return scan_range<Reverse>(begin, end, value_callback, phantom_protection, limit);
+    }
+
+    template <typename Callback, bool Reverse>
+    [[nodiscard]] bool range_scan(const key_type& begin, const key_type& end, Callback callback,
+                    RowAccess access, bool phantom_protection = true, int limit = -1) {
+        auto value_callback = [&] (internal_elem *e, bool& ret, bool& count) {
+            TransProxy row_item = index_read_my_write ? Sto::item(this, item_key_t::row_item_key(e))
+                                                      : Sto::fresh_item(this, item_key_t::row_item_key(e));
+
+            if (index_read_my_write) {
+                if (has_delete(row_item)) {
+                    ret = true;
+                    count = false;
+                    return true;
+                }
+                if (has_row_update(row_item)) {
+                    if (has_insert(row_item))
+                        ret = callback(e->key, &(e->row_container.row));
+                    else
+                        ret = callback(e->key, row_item.template raw_write_value<value_type *>());
+                    return true;
+                }
+            }
+
+            bool ok = true;
+            switch (access) {
+                case RowAccess::ObserveValue:
+                case RowAccess::ObserveExists:
+                    ok = row_item.observe(e->version());
+                    break;
+                case RowAccess::None:
+                    break;
+                default:
+                    always_assert(false, "unsupported access type in range_scan");
+                    break;
+            }
+
+            if (!ok)
+                return false;
+
+            // skip invalid (inserted but yet committed) values, but do not abort
+            if (!e->valid()) {
+                ret = true;
+                count = false;
+                return true;
+            }
+
+            ret = callback(e->key, &(e->row_container.row));
+            return true;
+        };
+
+        return scan_range<Reverse>(begin, end, value_callback, phantom_protection, limit);
+    }
+
+    value_type *nontrans_get(const key_type& k) {
+        internal_elem* e = tree_.lookup(key_bytes(k));
+        return e ? &(e->row_container.row) : nullptr;
+    }
+
+    void nontrans_put(const key_type& k, const value_type& v) {
+        auto e = new internal_elem(k, v, true);
+        if (internal_elem* found = tree_.insert(e)) {
+            delete e;
+            if (value_is_small)
+                found->row_container.row = v;
+            else
+                copy_row(found, &v);
+        }
+    }
+    bool nontrans_remove(const key_type& k) {
+        return _remove(k);
+    }
+
+    // TObject interface methods
+    bool lock(TransItem& item, Transaction &txn) override {
+        assert(!is_internode(item));
+        auto key = item.key<item_key_t>();
+        auto e = key.internal_elem_ptr();
+        if (key.is_row_item()) {
+            if (has_deferred(item))
+                return insert_pending(item, txn, e);
+            return is_cell_commute(item) || txn.try_lock(item, e->version());
+        } else if (is_cells_item(key))
+            return cell_versions::lock(txn, item, e->row_container);
+        else
+            return txn.try_lock(item, e->row_container.version_at(key.cell_num()));
+    }
+
+    bool check(TransItem& item, Transaction& txn) override {
+        if (is_internode(item)) {
+            node_type* n = get_internode_address(item);
+            return tree_type::current_version(n) == item.template read_value<nodeversion_value_type>();
+        }
+        auto key = item.key<item_key_t>();
+        auto e = key.internal_elem_ptr();
+        if (key.is_row_item())
+            return e->version().cp_check_version(txn, item);
+        else if (is_cells_item(key))
+            return cell_versions::check(item, e->row_container);
+        else
+            return e->row_container.version_at(key.cell_num()).cp_check_version(txn, item);
+    }
+
+    const void* version_address(TransItem& item) const override {
+        if (is_internode(item))
+            return get_internode_address(item);
+        auto key = item.key<item_key_t>();
+        auto e = key.internal_elem_ptr();
+        if (key.is_row_item())
+            return &e->version();
+        else
+            return &e->row_container.version_at(key.cell_num());
+    }
+
+    void install(TransItem& item, Transaction& txn) override {
+        assert(!is_internode(item));
+        auto key = item.key<item_key_t>();
+        auto e = key.internal_elem_ptr();
+
+        if (key.is_row_item()) {
+            if (has_delete(item)) {
+                assert(e->valid() && !e->deleted);
+                e->deleted = true;
+                txn.set_version(e->version());
+                return;
+            }
+
+            if (!has_insert(item)) {
+                if (item.has_commute()) {
+                    if (has_row_update(item))
+                        copy_row(e, item.write_value<comm_type>());
+                    else
+                        apply_commute(item, e);
+                } else {
+                    value_type *vptr;
+                    if (value_is_small) {
+                        vptr = &(item.write_value<value_type>());
+                    } else {
+                        vptr = item.write_value<value_type *>();
+                    }
+
+                    if (has_row_update(item)) {
+                        if (value_is_small) {
+                            e->row_container.row = *vptr;
+                        } else {
+                            copy_row(e, vptr);
+                        }
+                    } else if (has_row_cell(item)) {
+                        e->row_container.install_cell(0, vptr);
+                    }
+                }
+            }
+            if (is_cell_commute(item))
+                item.clear_needs_unlock();
+            else
+                txn.set_version_unlock(e->version(), item);
+        } else {
+            // skip installation if row-level update is present
+            auto row_item = Sto::item(this, item_key_t::row_item_key(e));
+            if (!has_row_update(row_item)) {
+                if (row_item.has_commute()) {
+                    apply_commute(row_item.item(), e);
+                } else {
+                    value_type *vptr;
+                    if (value_is_small)
+                        vptr = &(row_item.template raw_write_value<value_type>());
+                    else
+                        vptr = row_item.template raw_write_value<value_type *>();
+
+                    if (is_cells_item(key))
+                        cell_versions::for_each(cell_versions::written(item), [&](int cell) {
+                                e->row_container.install_cell(cell, vptr);
+                            });
+                    else
+                        e->row_container.install_cell(key.cell_num(), vptr);
+                }
+            }
+
+            if (is_cells_item(key))
+                cell_versions::set_version_unlock(txn, item, e->row_container);
+            else
+                txn.set_version_unlock(e->row_container.version_at(key.cell_num()), item);
+        }
+    }
+
+    void unlock(TransItem& item) override {
+        assert(!is_internode(item));
+        auto key = item.key<item_key_t>();
+        auto e = key.internal_elem_ptr();
+        if (key.is_row_item()) {
+            if (!is_cell_commute(item))
+                e->version().cp_unlock(item);
+        } else if (is_cells_item(key))
+            cell_versions::unlock(item, e->row_container);
+        else
+            e->row_container.version_at(key.cell_num()).cp_unlock(item);
+    }
+
+    void cleanup(TransItem& item, bool committed) override {
+        if (DeferInserts && has_insert(item)) {
+            internal_elem *e = item.key<item_key_t>().internal_elem_ptr();
+            overlay().erase(pending_key(e->key));
+            if (has_deferred(item)) {
+                Transaction::rcu_delete(e);
+                item.clear_needs_unlock();
+                return;
+            }
+        }
+        if (committed ? has_delete(item) : has_insert(item)) {
+            auto key = item.key<item_key_t>();
+            assert(key.is_row_item());
+            internal_elem *e = key.internal_elem_ptr();
+            bool ok = _remove(e->key);
+            always_assert(ok, "insert-bit exclusive ownership violated");
+            item.clear_needs_unlock();
+        }
+    }
+
+    static bool has_insert(const TransItem& item) {
+        return (item.flags() & insert_bit) != 0;
+    }
+    static bool has_delete(const TransItem& item) {
+        return (item.flags() & delete_bit) != 0;
+    }
+    static bool has_row_update(const TransItem& item) {
+        return (item.flags() & row_update_bit) != 0;
+    }
+    static bool has_row_cell(const TransItem& item) {
+        return (item.flags() & row_cell_bit) != 0;
+    }
+    static bool has_deferred(const TransItem& item) {
+        return (item.flags() & deferred_bit) != 0;
+    }
+    static bool is_cells_item(const item_key_t& key) {
+        return value_container_type::cell_bitmap && !key.is_row_item();
+    }
+    static bool is_phantom(internal_elem *e, const TransItem& item) {
+        return (!e->valid() && !has_insert(item));
+    }
+    // As in index_common
+    static bool is_cell_commute(const TransItem& item) {
+        return item.has_commute() && !item.has_read()
+            && !(item.flags() & (insert_bit | delete_bit | row_update_bit | row_cell_bit));
+    }
+    static void apply_commute(TransItem& row_item, internal_elem* e) {
+        if (!(row_item.flags() & comm_applied_bit)) {
+            e->row_container.install_cell(row_item.write_value<comm_type>());
+            row_item.add_flags(comm_applied_bit);
+        }
+    }
+
+private:
+    // Keeps this transaction's node items current through its own insert:
+    // a node it read moves to its new version, and the nodes the insert
+    // creates under it are read too
+    struct node_observer {
+        tree_ordered_index* index;
+        bool covered = false;
+        bool ok = true;
+
+        explicit node_observer(tree_ordered_index* idx)
+            : index(idx) {}
+
+        void changed(node_type* n, nodeversion_value_type before, nodeversion_value_type after) {
+            TransProxy item = Sto::item(index, get_internode_key(n));
+            if (!item.has_read())
+                return;
+            covered = true;
+            if (item.template read_value<nodeversion_value_type>() == before)
+                item.update_read(before, after);
+            else
+                ok = false;
+        }
+        void created(node_type* n, nodeversion_value_type v) {
+            if (covered)
+                ok = index->register_internode_version(n, v) && ok;
+        }
+    };
+
+    // Keeps the nodes this transaction read current through the commit-time
+    // insert of a pending row, like node_observer, but without adding items
+    struct commit_observer {
+        tree_ordered_index* index;
+        Transaction& txn;
+        bool covered = false;
+        bool ok = true;
+
+        commit_observer(tree_ordered_index* idx, Transaction& t)
+            : index(idx), txn(t) {}
+
+        void changed(node_type* n, nodeversion_value_type before, nodeversion_value_type after) {
+            auto item = txn.check_item(index, get_internode_key(n));
+            if (!item || !item.get().has_read())
+                return;
+            covered = true;
+            if (item.get().template read_value<nodeversion_value_type>() == before)
+                item.get().update_read(before, after);
+            else
+                ok = false;
+        }
+        void created(node_type*, nodeversion_value_type) {
+            if (covered)
+                ok = false;
+        }
+    };
+
+    typedef std::array<uint8_t, sizeof(K)> pending_key_type;
+    typedef std::map<pending_key_type, internal_elem*> overlay_type;
+
+    tree_type tree_;
+    uint64_t key_gen_;
+    std::vector<overlay_type> overlays_;    // pending inserts, by thread
+
+    overlay_type& overlay() {
+        return overlays_[TThread::id()];
+    }
+    static pending_key_type pending_key(const key_type& k) {
+        pending_key_type pk;
+        memcpy(pk.data(), key_bytes(k), sizeof(K));
+        return pk;
+    }
+    internal_elem* find_pending(const key_type& k) {
+        if (!DeferInserts)
+            return nullptr;
+        auto& ov = overlay();
+        auto it = ov.find(pending_key(k));
+        return it == ov.end() ? nullptr : it->second;
+    }
+
+    // Enters a pending row into the tree, with its row lock held
+    bool insert_pending(TransItem& item, Transaction& txn, internal_elem* e) {
+        if (!txn.try_lock(item, e->version()))
+            return false;
+        commit_observer obs(this, txn);
+        if (tree_.insert(e, obs))
+            return false;
+        item.clear_flags(deferred_bit);
+        return obs.ok;
+    }
+
+    static const void* key_bytes(const key_type& k) {
+        Str s(k);
+        assert(s.length() == sizeof(key_type));
+        return s.data();
+    }
+
+    // Drives the tree scan for range_scan: value_callback(e, ret, count)
+    // as in ordered_index's range_scanner. Pending inserts join the scan in
+    // key order.
+    template <bool Reverse, typename ValueCallback>
+    bool scan_range(const key_type& begin, const key_type& end, ValueCallback& value_callback,
+                    bool phantom_protection, int limit) {
+        assert((limit == -1) || (limit > 0));
+        Str boundary(end);
+        bool succeeded = true;
+        bool stopped = false;
+        int scancount = 0;
+        auto node_cb = [&] (node_type* n, nodeversion_value_type v) {
+            if (!phantom_protection || register_internode_version(n, v))
+                return true;
+            succeeded = false;
+            return false;
+        };
+        auto visit = [&] (internal_elem* e) {
+            if (boundary) {
+                Str k(e->key);
+                if (Reverse ? boundary >= k : boundary <= k)
+                    return false;
+            }
+            bool visited = false;
+            bool count = true;
+            bool ok = value_callback(e, visited, count);
+            if (!ok || !visited)
+                succeeded = false;
+            if (count)
+                ++scancount;
+            if (!ok || (limit > 0 && scancount >= limit))
+                return false;
+            return visited;
+        };
+
+        typedef typename std::conditional<Reverse, typename overlay_type::reverse_iterator,
+                                          typename overlay_type::iterator>::type pending_iterator;
+        static overlay_type no_pending;
+        auto& ov = DeferInserts ? overlay() : no_pending;
+        pending_iterator pit, pend;
+        if constexpr (Reverse) {
+            pit = pending_iterator(ov.upper_bound(pending_key(begin)));
+            pend = ov.rend();
+        } else {
+            pit = ov.lower_bound(pending_key(begin));
+            pend = ov.end();
+        }
+        auto leaf_cb = [&] (internal_elem* e) {
+            // pending inserts up to e's key come first
+            for (; pit != pend; ++pit) {
+                int cmp = memcmp(pit->first.data(), key_bytes(e->key), sizeof(K));
+                if (Reverse ? cmp < 0 : cmp > 0)
+                    break;
+                if (!visit(pit->second)) {
+                    stopped = true;
+                    return false;
+                }
+            }
+            stopped = !visit(e);
+            return !stopped;
+        };
+        if (tree_.template scan<Reverse>(key_bytes(begin), node_cb, leaf_cb))
+            for (; !stopped && pit != pend; ++pit)
+                stopped = !visit(pit->second);
+        return succeeded;
+    }
+
+    bool register_internode_version(node_type* node, nodeversion_value_type nv) {
+        TransProxy item = Sto::item(this, get_internode_key(node));
+        if constexpr (DBParams::Opaque) {
+            return item.add_read_opaque(nv);
+        } else {
+            return item.add_read(nv);
+        }
+    }
+
+    static bool
+    access_all(const std::array<access_t, value_container_type::num_versions>& cell_accesses, std::array<TransItem*,
+               value_container_type::num_versions>& cell_items, value_container_type& row_container) {
+        for (size_t idx = 0; idx < cell_accesses.size(); ++idx) {
+            auto& access = cell_accesses[idx];
+            auto proxy = TransProxy(*Sto::transaction(), *cell_items[idx]);
+            if (value_container_type::cell_bitmap && idx != 0) {
+                if ((static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::read))
+                    && !cell_versions::observe(proxy, row_container, idx))
+                    return false;
+                if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::write))
+                    cell_versions::add_write(proxy, idx);
+                continue;
+            }
+            if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::read)) {
+                if (!proxy.observe(row_container.version_at(idx)))
+                    return false;
+            }
+            if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::write)) {
+                // keep a commutator an earlier update buffered, for the
+                // next update_row() to fold into
+                if (!proxy.has_commute() && !proxy.acquire_write(row_container.version_at(idx)))
+                    return false;
+                if (proxy.item().key<item_key_t>().is_row_item()) {
+                    proxy.item().add_flags(row_cell_bit);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool _remove(const key_type& key) {
+        internal_elem* e = tree_.remove(key_bytes(key));
+        if (e)
+            Transaction::rcu_delete(e);
+        return e != nullptr;
+    }
+
+    static uintptr_t get_internode_key(node_type* node) {
+        return reinterpret_cast<uintptr_t>(node) | internode_bit;
+    }
+    static bool is_internode(TransItem& item) {
+        return (item.key<uintptr_t>() & internode_bit) != 0;
+    }
+    static node_type *get_internode_address(TransItem& item) {
+        assert(is_internode(item));
+        return reinterpret_cast<node_type *>(item.key<uintptr_t>() & ~internode_bit);
+    }
+
+    static void copy_row(internal_elem *e, comm_type &comm) {
+        comm.operate(e->row_container.row);
+    }
+    static void copy_row(internal_elem *e, const value_type *new_row) {
+        if (new_row == nullptr)
+            return;
+        e->row_container.row = *new_row;
+    }
+};
+
+template <typename K, typename V, typename DBParams>
+using art_ordered_index = tree_ordered_index<K, V, DBParams, art_tree>;
+template <typename K, typename V, typename DBParams>
+using btree_ordered_index = tree_ordered_index<K, V, DBParams, olc_btree>;
+
+// The ordered index engines a benchmark table can be built on
+enum class ordered_engine { masstree, art, btree };
+
+template <ordered_engine Engine, typename K, typename V, typename DBParams>
+using ordered_index_on = typename std::conditional<Engine == ordered_engine::art,
+      art_ordered_index<K, V, DBParams>,
+      typename std::conditional<Engine == ordered_engine::btree,
+          btree_ordered_index<K, V, DBParams>,
+          ordered_index<K, V, DBParams>>::type>::type;
+
+} // namespace bench
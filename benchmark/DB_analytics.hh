@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <memory>
+
+#include "DB_index.hh"
+#include "PlatformFeatures.hh"
+
+namespace bench {
+
+// Vectorized analytical scans over MVCC snapshots, for HTAP runs where
+// analytic threads query tables that OLTP workers keep updating.
+//
+// snapshot_scanner reads an mvcc_ordered_index as of a pinned snapshot tid
+// (SnapshotPin), outside any transaction: nothing is tracked, validated or
+// locked, so the scan never aborts and never blocks a writer, and every
+// table a query reads with the same tid sees one consistent database.
+// Only the splits (column groups) a query asks for are looked up. Rows are
+// materialized a batch at a time into column_batch, whose columns are
+// plain int64_t arrays, so filters and aggregates run as vector kernels
+// over each column with a selection bitmap instead of row by row.
+
+namespace analytics {
+
+// Kernels over n int64_t values and a selection bitmap sel of (n + 63) / 64
+// words, bit i for value i
+
+// Clears the bits of values outside [lo, hi]
+typedef void (*filter_type)(const int64_t* col, size_t n, int64_t lo, int64_t hi, uint64_t* sel);
+// Sum of the selected values
+typedef int64_t (*sum_type)(const int64_t* col, size_t n, const uint64_t* sel);
+
+inline void filter_scalar(const int64_t* col, size_t n, int64_t lo, int64_t hi, uint64_t* sel) {
+    for (size_t w = 0; w * 64 < n; ++w, col += 64) {
+        size_t m = std::min(n - w * 64, size_t(64));
+        uint64_t keep = 0;
+        for (size_t i = 0; i != m; ++i)
+            keep |= uint64_t(col[i] >= lo && col[i] <= hi) << i;
+        sel[w] &= keep;
+    }
+}
+
+__attribute__((target("avx2")))
+inline void filter_avx2(const int64_t* col, size_t n, int64_t lo, int64_t hi, uint64_t* sel) {
+    const __m256i vlo = _mm256_set1_epi64x(lo);
+    const __m256i vhi = _mm256_set1_epi64x(hi);
+    size_t w = 0;
+    for (; (w + 1) * 64 <= n; ++w, col += 64) {
+        uint64_t out = 0;
+        for (unsigned i = 0; i != 64; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(col + i));
+            __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(vlo, v), _mm256_cmpgt_epi64(v, vhi));
+            out |= uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(bad))) << i;
+        }
+        sel[w] &= ~out;
+    }
+    if (w * 64 != n)
+        filter_scalar(col, n - w * 64, lo, hi, sel + w);
+}
+
+inline int64_t sum_scalar(const int64_t* col, size_t n, const uint64_t* sel) {
+    int64_t sum = 0;
+    for (size_t w = 0; w * 64 < n; ++w)
+        for (uint64_t bits = sel[w]; bits; bits &= bits - 1)
+            sum += col[w * 64 + __builtin_ctzll(bits)];
+    return sum;
+}
+
+__attribute__((target("avx2")))
+inline int64_t sum_avx2(const int64_t* col, size_t n, const uint64_t* sel) {
+    const __m256i lane_bits = _mm256_set_epi64x(8, 4, 2, 1);
+    __m256i acc = _mm256_setzero_si256();
+    size_t w = 0;
+    for (; (w + 1) * 64 <= n; ++w, col += 64) {
+        uint64_t bits = sel[w];
+        if (!bits)
+            continue;
+        for (unsigned i = 0; i != 64; i += 4) {
+            __m256i m = _mm256_and_si256(_mm256_set1_epi64x(static_cast<long long>(bits >> i)), lane_bits);
+            m = _mm256_cmpeq_epi64(m, lane_bits);
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(col + i));
+            acc = _mm256_add_epi64(acc, _mm256_and_si256(v, m));
+        }
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    if (w * 64 != n)
+        sum += sum_scalar(col, n - w * 64, sel + w);
+    return sum;
+}
+
+inline filter_type select_filter() {
+    return cpu_simd_level() == SimdLevel::scalar ? filter_scalar : filter_avx2;
+}
+inline sum_type select_sum() {
+    return cpu_simd_level() == SimdLevel::scalar ? sum_scalar : sum_avx2;
+}
+
+inline const filter_type filter_kernel = select_filter();
+inline const sum_type sum_kernel = select_sum();
+
+} // namespace analytics
+
+// Up to capacity rows of N int64_t columns, with the rows that passed
+// the filters so far
+template <size_t N>
+struct column_batch {
+    static constexpr size_t capacity = 1024;
+    static constexpr size_t words = capacity / 64;
+
+    size_t size = 0;
+    int64_t columns[N][capacity];
+    uint64_t sel[words];
+
+    // Selects all size rows
+    void select_all() {
+        size_t full = size / 64;
+        memset(sel, 0xFF, full * sizeof(uint64_t));
+        if (full != words)
+            memset(sel + full, 0, (words - full) * sizeof(uint64_t));
+        if (size % 64)
+            sel[full] = (uint64_t(1) << (size % 64)) - 1;
+    }
+    // Keeps the selected rows whose column c is in [lo, hi]
+    void filter(size_t c, int64_t lo, int64_t hi) {
+        analytics::filter_kernel(columns[c], size, lo, hi, sel);
+    }
+    // Sum of column c over the selected rows
+    int64_t sum(size_t c) const {
+        return analytics::sum_kernel(columns[c], size, sel);
+    }
+    size_t count() const {
+        size_t n = 0;
+        for (size_t w = 0; w * 64 < size; ++w)
+            n += __builtin_popcountll(sel[w]);
+        return n;
+    }
+};
+
+// Scans an mvcc_ordered_index as of a snapshot tid into column batches.
+// extract(key, split_values, batch, row) fills row's N columns; split_values
+// holds the row's version of each split in splits (and split 0), the others
+// are null. consume(batch) gets each batch, with all its rows selected.
+// The caller keeps tid pinned for the scan (SnapshotPin) and the scanning
+// thread needs the index's thread_init().
+template <typename IndexType, size_t N>
+class snapshot_scanner {
+public:
+    typedef typename IndexType::key_type key_type;
+    typedef column_batch<N> batch_type;
+
+    explicit snapshot_scanner(uint64_t splits = ~uint64_t(0))
+        : splits_(splits), batch_(new batch_type) {
+    }
+
+    // Scans [begin, end) (an empty end is unbounded); returns the rows seen
+    template <typename Extract, typename Consume>
+    uint64_t scan(IndexType& index, lcdf::Str begin, lcdf::Str end, TransactionTid::type tid,
+                  Extract extract, Consume consume) {
+        uint64_t rows = 0;
+        batch_->size = 0;
+        index.range_scan_splits_as_of(begin, end, tid, splits_,
+            [&] (const key_type& key, const auto& split_values) {
+                extract(key, split_values, *batch_, batch_->size);
+                if (++batch_->size == batch_type::capacity)
+                    flush(consume);
+                ++rows;
+                return true;
+            });
+        if (batch_->size)
+            flush(consume);
+        return rows;
+    }
+
+private:
+    uint64_t splits_;
+    std::unique_ptr<batch_type> batch_;
+
+    template <typename Consume>
+    void flush(Consume& consume) {
+        batch_->select_all();
+        consume(*batch_);
+        batch_->size = 0;
+    }
+};
+
+} // namespace bench
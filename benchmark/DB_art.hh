@@ -0,0 +1,640 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "compiler.hh"
+#include "Transaction.hh"
+
+namespace bench {
+
+// Adaptive radix tree (Leis et al., ICDE 2013) over fixed-length byte keys,
+// an ordered index engine of tree_ordered_index. Inner nodes branch on one
+// key byte and come in four sizes (4, 16, 48 and 256 children), grown as
+// they fill. A child slot holds either an inner node or a leaf: a pointer
+// to a T, tagged in its low bit, whose full key (KeyOf()(leaf), KeyLen
+// bytes) is compared on lookup, so paths end as soon as a key is unique.
+// Every node keeps the whole key prefix of its subtree (bytes [0, level)),
+// which never changes once the node is published; inserting a node above
+// another only touches the parent's slot.
+//
+// Concurrency follows optimistic lock coupling (Leis et al., DaMoN 2016).
+// Each node has a version word: readers take it before reading the node
+// and check it is unchanged afterwards, restarting from the root if not;
+// writers lock the nodes they change and bump their versions on unlock. A
+// full node is replaced by a larger copy and marked obsolete, and freed
+// through Transaction::rcu_call once no reader can be using it. Nodes
+// never shrink, and removing a key only clears its slot.
+//
+// Node versions double as the phantom protection of transactions, as the
+// leaf versions of Masstree do (register_internode_version): an absent key
+// is witnessed by the one node any insert of it must change, and a scan by
+// every node it reads. Writers report the
+// nodes they change and create to an observer, so that a transaction can
+// update the versions it has already read.
+template <typename T, size_t KeyLen, typename KeyOf>
+class art_tree {
+public:
+    static_assert(KeyLen > 0 && KeyLen < 256, "keys must be 1-255 bytes");
+    static_assert(alignof(T) >= 2, "leaves are tagged in their low bit");
+
+    typedef uint64_t version_value_type;
+    static constexpr version_value_type lock_bit = 1;
+    static constexpr version_value_type obsolete_bit = 2;
+    static constexpr version_value_type version_step = 4;
+
+    enum node_kind : uint8_t { kind4, kind16, kind48, kind256 };
+
+    struct node {
+        std::atomic<version_value_type> version;
+        node_kind kind;
+        uint8_t level;              // index of the key byte this node branches on
+        uint16_t count;             // children
+        uint8_t prefix[KeyLen];     // key bytes [0, level), shared by the subtree
+
+        node(node_kind k, unsigned lv, const uint8_t* key)
+            : version(0), kind(k), level(lv), count(0) {
+            memcpy(prefix, key, lv);
+        }
+    };
+
+    // Observer of nothing, for writers outside transactions
+    struct no_observer {
+        void changed(node*, version_value_type, version_value_type) {}
+        void created(node*, version_value_type) {}
+    };
+
+    art_tree()
+        : root_(new node256(0, nullptr)) {
+    }
+    ~art_tree() {
+        destroy(root_);
+    }
+    art_tree(const art_tree&) = delete;
+    art_tree& operator=(const art_tree&) = delete;
+
+    // Returns the leaf with key, or nullptr after setting witness and
+    // witness_version to the node an insert of key would change: the node
+    // where the search ended, or its parent if the key leaves its prefix
+    T* lookup(const void* key, node*& witness, version_value_type& witness_version) const {
+        auto k = reinterpret_cast<const uint8_t*>(key);
+    restart:
+        node* parent = nullptr;
+        version_value_type pv = 0;
+        node* n = root_;
+        version_value_type v = stable(n);
+        unsigned from = 0;
+        while (true) {
+            if (memcmp(n->prefix + from, k + from, n->level - from) != 0) {
+                // an insert of key would change the parent's slot
+                n = parent;
+                v = pv;
+                break;
+            }
+            uintptr_t c = find_child(n, k[n->level]);
+            if (!validate(n, v))
+                goto restart;
+            if (!c)
+                break;
+            if (is_leaf(c)) {
+                T* x = leaf(c);
+                if (memcmp(KeyOf()(x), k, KeyLen) == 0)
+                    return x;
+                break;
+            }
+            node* child = reinterpret_cast<node*>(c);
+            version_value_type cv = stable(child);
+            if ((cv & obsolete_bit) || !validate(n, v))
+                goto restart;
+            from = n->level + 1;
+            parent = n;
+            pv = v;
+            n = child;
+            v = cv;
+        }
+        witness = n;
+        witness_version = v;
+        return nullptr;
+    }
+    T* lookup(const void* key) const {
+        node* n;
+        version_value_type v;
+        return lookup(key, n, v);
+    }
+
+    // Inserts value under its key unless a leaf with the key exists, and
+    // returns that leaf (nullptr if value was inserted). obs hears of every
+    // node the insert changes, with its version before and after, and of
+    // the node it creates.
+    template <typename Observer>
+    T* insert(T* value, Observer& obs) {
+        auto k = reinterpret_cast<const uint8_t*>(KeyOf()(value));
+        uintptr_t lv = reinterpret_cast<uintptr_t>(value) | 1;
+    restart:
+        node* parent = nullptr;
+        version_value_type pv = 0;
+        node* n = root_;
+        version_value_type v = stable(n);
+        unsigned from = 0;
+        while (true) {
+            unsigned d = mismatch(n->prefix, k, from, n->level);
+            if (d != n->level) {
+                // the key leaves n's prefix at byte d: a new node there
+                // takes n's place under parent
+                if (!try_lock(parent, pv))
+                    goto restart;
+                if (!validate(n, v)) {
+                    unlock_unchanged(parent, pv);
+                    goto restart;
+                }
+                node* m = new node4(d, k);
+                add_child(m, k[d], lv);
+                add_child(m, n->prefix[d], reinterpret_cast<uintptr_t>(n));
+                replace_child(parent, k[parent->level], reinterpret_cast<uintptr_t>(m));
+                obs.changed(parent, pv, unlock(parent));
+                obs.created(m, 0);
+                return nullptr;
+            }
+            uint8_t b = k[n->level];
+            uintptr_t c = find_child(n, b);
+            if (!validate(n, v))
+                goto restart;
+            if (!c) {
+                if (n->count == capacity(n)) {
+                    if (!try_lock(parent, pv))
+                        goto restart;
+                    if (!try_lock(n, v)) {
+                        unlock_unchanged(parent, pv);
+                        goto restart;
+                    }
+                    node* g = grow(n);
+                    add_child(g, b, lv);
+                    replace_child(parent, k[parent->level], reinterpret_cast<uintptr_t>(g));
+                    obs.changed(n, v, unlock_obsolete(n));
+                    obs.changed(parent, pv, unlock(parent));
+                    obs.created(g, 0);
+                    Transaction::rcu_call<free_node_cb>(n);
+                } else {
+                    if (!try_lock(n, v))
+                        goto restart;
+                    add_child(n, b, lv);
+                    obs.changed(n, v, unlock(n));
+                }
+                return nullptr;
+            }
+            if (is_leaf(c)) {
+                T* x = leaf(c);
+                auto xk = reinterpret_cast<const uint8_t*>(KeyOf()(x));
+                if (memcmp(xk, k, KeyLen) == 0)
+                    return x;
+                // the two keys share a slot: split it at their first
+                // differing byte
+                if (!try_lock(n, v))
+                    goto restart;
+                unsigned e = mismatch(xk, k, n->level + 1, KeyLen);
+                node* m = new node4(e, k);
+                add_child(m, k[e], lv);
+                add_child(m, xk[e], c);
+                replace_child(n, b, reinterpret_cast<uintptr_t>(m));
+                obs.changed(n, v, unlock(n));
+                obs.created(m, 0);
+                return nullptr;
+            }
+            node* child = reinterpret_cast<node*>(c);
+            version_value_type cv = stable(child);
+            if ((cv & obsolete_bit) || !validate(n, v))
+                goto restart;
+            from = n->level + 1;
+            parent = n;
+            pv = v;
+            n = child;
+            v = cv;
+        }
+    }
+    T* insert(T* value) {
+        no_observer obs;
+        return insert(value, obs);
+    }
+
+    // Removes the leaf with key, and returns it (nullptr if absent)
+    T* remove(const void* key) {
+        auto k = reinterpret_cast<const uint8_t*>(key);
+    restart:
+        node* n = root_;
+        version_value_type v = stable(n);
+        unsigned from = 0;
+        while (true) {
+            if (memcmp(n->prefix + from, k + from, n->level - from) != 0)
+                return nullptr;
+            uint8_t b = k[n->level];
+            uintptr_t c = find_child(n, b);
+            if (!validate(n, v))
+                goto restart;
+            if (!c)
+                return nullptr;
+            if (is_leaf(c)) {
+                T* x = leaf(c);
+                if (memcmp(KeyOf()(x), k, KeyLen) != 0)
+                    return nullptr;
+                if (!try_lock(n, v))
+                    goto restart;
+                remove_child(n, b);
+                unlock(n);
+                return x;
+            }
+            node* child = reinterpret_cast<node*>(c);
+            version_value_type cv = stable(child);
+            if ((cv & obsolete_bit) || !validate(n, v))
+                goto restart;
+            from = n->level + 1;
+            n = child;
+            v = cv;
+        }
+    }
+
+    // Visits the leaves in key order from key on (with Reverse, down from
+    // key), including key itself. Calls node_cb(node, version) for every
+    // node the scan reads, and stops, returning false, if it returns false;
+    // leaf_cb(leaf) stops the scan, which then returns true, by returning
+    // false. A scan that meets a concurrent change restarts from the root
+    // after the last leaf it visited, so no leaf is visited twice.
+    template <bool Reverse, typename NodeCallback, typename LeafCallback>
+    bool scan(const void* key, NodeCallback& node_cb, LeafCallback& leaf_cb) const {
+        scan_state<NodeCallback, LeafCallback> s{{}, true, node_cb, leaf_cb};
+        memcpy(s.bound, key, KeyLen);
+        int r;
+        while ((r = scan_node<Reverse>(root_, 0, true, s)) == scan_restart)
+            /* retry */;
+        return r != scan_abort;
+    }
+
+    // The version of a node, as a transaction validates it
+    static version_value_type current_version(const node* n) {
+        return n->version.load(std::memory_order_acquire);
+    }
+
+private:
+    struct node4 : public node {
+        uint8_t keys[4];
+        uintptr_t children[4];
+        node4(unsigned lv, const uint8_t* key)
+            : node(kind4, lv, key), keys(), children() {}
+    };
+    struct node16 : public node {
+        uint8_t keys[16];
+        uintptr_t children[16];
+        node16(unsigned lv, const uint8_t* key)
+            : node(kind16, lv, key), keys(), children() {}
+    };
+    struct node48 : public node {
+        uint8_t index[256];         // slot + 1 of each byte's child, or 0
+        uintptr_t children[48];
+        node48(unsigned lv, const uint8_t* key)
+            : node(kind48, lv, key), index(), children() {}
+    };
+    struct node256 : public node {
+        uintptr_t children[256];
+        node256(unsigned lv, const uint8_t* key)
+            : node(kind256, lv, key), children() {}
+    };
+
+    enum { scan_more, scan_stop, scan_abort, scan_restart };
+
+    template <typename NodeCallback, typename LeafCallback>
+    struct scan_state {
+        uint8_t bound[KeyLen];      // the start key, then the last visited
+        bool inclusive;
+        NodeCallback& node_cb;
+        LeafCallback& leaf_cb;
+    };
+
+    node* root_;
+
+    static bool is_leaf(uintptr_t c) {
+        return c & 1;
+    }
+    static T* leaf(uintptr_t c) {
+        return reinterpret_cast<T*>(c - 1);
+    }
+
+    static unsigned mismatch(const uint8_t* a, const uint8_t* b, unsigned from, unsigned to) {
+        while (from != to && a[from] == b[from])
+            ++from;
+        return from;
+    }
+
+    static version_value_type stable(const node* n) {
+        version_value_type v;
+        while ((v = n->version.load(std::memory_order_acquire)) & lock_bit)
+            relax_fence();
+        return v;
+    }
+    static bool validate(const node* n, version_value_type v) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return n->version.load(std::memory_order_relaxed) == v;
+    }
+    static bool try_lock(node* n, version_value_type v) {
+        return !(v & obsolete_bit)
+            && n->version.compare_exchange_strong(v, v | lock_bit, std::memory_order_acquire);
+    }
+    static version_value_type unlock(node* n) {
+        version_value_type v = (n->version.load(std::memory_order_relaxed) & ~lock_bit) + version_step;
+        n->version.store(v, std::memory_order_release);
+        return v;
+    }
+    static version_value_type unlock_obsolete(node* n) {
+        version_value_type v = ((n->version.load(std::memory_order_relaxed) & ~lock_bit) + version_step)
+            | obsolete_bit;
+        n->version.store(v, std::memory_order_release);
+        return v;
+    }
+    static void unlock_unchanged(node* n, version_value_type v) {
+        n->version.store(v, std::memory_order_release);
+    }
+
+    static unsigned capacity(const node* n) {
+        switch (n->kind) {
+        case kind4: return 4;
+        case kind16: return 16;
+        case kind48: return 48;
+        default: return 256;
+        }
+    }
+
+    static uintptr_t find_child(const node* n, uint8_t b) {
+        switch (n->kind) {
+        case kind4: {
+            auto x = static_cast<const node4*>(n);
+            for (unsigned i = 0; i != x->count && i != 4; ++i)
+                if (x->keys[i] == b)
+                    return x->children[i];
+            return 0;
+        }
+        case kind16: {
+            auto x = static_cast<const node16*>(n);
+            for (unsigned i = 0; i != x->count && i != 16; ++i)
+                if (x->keys[i] == b)
+                    return x->children[i];
+            return 0;
+        }
+        case kind48: {
+            auto x = static_cast<const node48*>(n);
+            unsigned i = x->index[b];
+            return i ? x->children[(i - 1) % 48] : 0;
+        }
+        default:
+            return static_cast<const node256*>(n)->children[b];
+        }
+    }
+
+    // The child with the least byte >= b (with Reverse, the greatest byte
+    // <= b), setting at to its byte; 0 if none
+    template <bool Reverse>
+    static uintptr_t adjacent_child(const node* n, int b, int& at) {
+        switch (n->kind) {
+        case kind4:
+        case kind16: {
+            const uint8_t* keys;
+            const uintptr_t* children;
+            unsigned cap;
+            if (n->kind == kind4) {
+                keys = static_cast<const node4*>(n)->keys;
+                children = static_cast<const node4*>(n)->children;
+                cap = 4;
+            } else {
+                keys = static_cast<const node16*>(n)->keys;
+                children = static_cast<const node16*>(n)->children;
+                cap = 16;
+            }
+            unsigned count = std::min(unsigned(n->count), cap);
+            if (Reverse) {
+                for (unsigned i = count; i != 0; --i)
+                    if (keys[i - 1] <= b) {
+                        at = keys[i - 1];
+                        return children[i - 1];
+                    }
+            } else {
+                for (unsigned i = 0; i != count; ++i)
+                    if (keys[i] >= b) {
+                        at = keys[i];
+                        return children[i];
+                    }
+            }
+            return 0;
+        }
+        case kind48: {
+            auto x = static_cast<const node48*>(n);
+            for (; Reverse ? b >= 0 : b <= 255; b += Reverse ? -1 : 1)
+                if (unsigned i = x->index[b]) {
+                    at = b;
+                    return x->children[(i - 1) % 48];
+                }
+            return 0;
+        }
+        default: {
+            auto x = static_cast<const node256*>(n);
+            for (; Reverse ? b >= 0 : b <= 255; b += Reverse ? -1 : 1)
+                if (uintptr_t c = x->children[b]) {
+                    at = b;
+                    return c;
+                }
+            return 0;
+        }
+        }
+    }
+
+    // The mutators below run with n locked, or before n is published
+    template <typename N>
+    static void sorted_add(N* x, uint8_t b, uintptr_t c) {
+        unsigned i = x->count;
+        for (; i != 0 && x->keys[i - 1] > b; --i) {
+            x->keys[i] = x->keys[i - 1];
+            x->children[i] = x->children[i - 1];
+        }
+        x->keys[i] = b;
+        x->children[i] = c;
+        ++x->count;
+    }
+    template <typename N>
+    static void sorted_remove(N* x, uint8_t b) {
+        unsigned i = 0;
+        while (x->keys[i] != b)
+            ++i;
+        for (; i + 1 < x->count; ++i) {
+            x->keys[i] = x->keys[i + 1];
+            x->children[i] = x->children[i + 1];
+        }
+        --x->count;
+    }
+
+    static void add_child(node* n, uint8_t b, uintptr_t c) {
+        switch (n->kind) {
+        case kind4:
+            sorted_add(static_cast<node4*>(n), b, c);
+            break;
+        case kind16:
+            sorted_add(static_cast<node16*>(n), b, c);
+            break;
+        case kind48: {
+            auto x = static_cast<node48*>(n);
+            unsigned i = 0;
+            while (x->children[i])
+                ++i;
+            x->children[i] = c;
+            x->index[b] = i + 1;
+            ++x->count;
+            break;
+        }
+        default:
+            static_cast<node256*>(n)->children[b] = c;
+            ++n->count;
+            break;
+        }
+    }
+
+    static void replace_child(node* n, uint8_t b, uintptr_t c) {
+        switch (n->kind) {
+        case kind4: {
+            auto x = static_cast<node4*>(n);
+            for (unsigned i = 0; i != x->count; ++i)
+                if (x->keys[i] == b)
+                    x->children[i] = c;
+            break;
+        }
+        case kind16: {
+            auto x = static_cast<node16*>(n);
+            for (unsigned i = 0; i != x->count; ++i)
+                if (x->keys[i] == b)
+                    x->children[i] = c;
+            break;
+        }
+        case kind48: {
+            auto x = static_cast<node48*>(n);
+            x->children[x->index[b] - 1] = c;
+            break;
+        }
+        default:
+            static_cast<node256*>(n)->children[b] = c;
+            break;
+        }
+    }
+
+    static void remove_child(node* n, uint8_t b) {
+        switch (n->kind) {
+        case kind4:
+            sorted_remove(static_cast<node4*>(n), b);
+            break;
+        case kind16:
+            sorted_remove(static_cast<node16*>(n), b);
+            break;
+        case kind48: {
+            auto x = static_cast<node48*>(n);
+            x->children[x->index[b] - 1] = 0;
+            x->index[b] = 0;
+            --x->count;
+            break;
+        }
+        default:
+            static_cast<node256*>(n)->children[b] = 0;
+            --n->count;
+            break;
+        }
+    }
+
+    // A copy of the full node n with room for more children
+    static node* grow(const node* n) {
+        node* g;
+        switch (n->kind) {
+        case kind4:
+            g = new node16(n->level, n->prefix);
+            break;
+        case kind16:
+            g = new node48(n->level, n->prefix);
+            break;
+        default:
+            g = new node256(n->level, n->prefix);
+            break;
+        }
+        int at;
+        for (int b = 0; uintptr_t c = adjacent_child<false>(n, b, at); b = at + 1) {
+            add_child(g, at, c);
+            if (at == 255)
+                break;
+        }
+        return g;
+    }
+
+    template <bool Reverse, typename State>
+    static int scan_node(const node* n, unsigned from, bool tight, State& s) {
+        version_value_type v = stable(n);
+        if (v & obsolete_bit)
+            return scan_restart;
+        if (!s.node_cb(const_cast<node*>(n), v))
+            return scan_abort;
+        int b = Reverse ? 255 : 0;
+        if (tight) {
+            // while the path follows the bound, subtrees before it are skipped
+            int cmp = memcmp(n->prefix + from, s.bound + from, n->level - from);
+            if (cmp != 0) {
+                if ((cmp < 0) != Reverse)
+                    return scan_more;
+                tight = false;
+            } else
+                b = s.bound[n->level];
+        }
+        while (Reverse ? b >= 0 : b <= 255) {
+            int at;
+            uintptr_t c = adjacent_child<Reverse>(n, b, at);
+            if (!validate(n, v))
+                return scan_restart;
+            if (!c)
+                break;
+            bool ctight = tight && at == s.bound[n->level];
+            if (is_leaf(c)) {
+                T* x = leaf(c);
+                auto xk = KeyOf()(x);
+                int cmp = ctight ? memcmp(xk, s.bound, KeyLen) : (Reverse ? -1 : 1);
+                if (Reverse ? cmp < 0 || (cmp == 0 && s.inclusive)
+                            : cmp > 0 || (cmp == 0 && s.inclusive)) {
+                    memcpy(s.bound, xk, KeyLen);
+                    s.inclusive = false;
+                    if (!s.leaf_cb(x))
+                        return scan_stop;
+                }
+            } else {
+                int r = scan_node<Reverse>(reinterpret_cast<const node*>(c), n->level + 1, ctight, s);
+                if (r != scan_more)
+                    return r;
+            }
+            b = Reverse ? at - 1 : at + 1;
+        }
+        return scan_more;
+    }
+
+    static void delete_node(node* n) {
+        switch (n->kind) {
+        case kind4: delete static_cast<node4*>(n); break;
+        case kind16: delete static_cast<node16*>(n); break;
+        case kind48: delete static_cast<node48*>(n); break;
+        default: delete static_cast<node256*>(n); break;
+        }
+    }
+    static void free_node_cb(void* p) {
+        delete_node(reinterpret_cast<node*>(p));
+    }
+
+    static void destroy(node* n) {
+        int at;
+        for (int b = 0; uintptr_t c = adjacent_child<false>(n, b, at); b = at + 1) {
+            if (!is_leaf(c))
+                destroy(reinterpret_cast<node*>(c));
+            if (at == 255)
+                break;
+        }
+        delete_node(n);
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,498 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "compiler.hh"
+#include "PlatformFeatures.hh"
+
+namespace bench {
+
+// Search kernels over the sorted key heads of a B+tree node: how many of
+// the n heads are less than h
+namespace btree_search {
+
+typedef unsigned (*count_less_type)(const uint64_t* heads, unsigned n, uint64_t h);
+
+inline unsigned count_less_scalar(const uint64_t* heads, unsigned n, uint64_t h) {
+    unsigned c = 0;
+    for (unsigned i = 0; i != n; ++i)
+        c += heads[i] < h;
+    return c;
+}
+
+__attribute__((target("avx2")))
+inline unsigned count_less_avx2(const uint64_t* heads, unsigned n, uint64_t h) {
+    // lanes compare signed, so flip the sign bits to compare unsigned
+    const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(uint64_t(1) << 63));
+    const __m256i x = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(h)), sign);
+    unsigned c = 0;
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i)), sign);
+        c += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, v))));
+    }
+    return c + count_less_scalar(heads + i, n - i, h);
+}
+
+inline count_less_type select_count_less() {
+    return cpu_simd_level() == SimdLevel::scalar ? count_less_scalar : count_less_avx2;
+}
+
+inline const count_less_type count_less_kernel = select_count_less();
+
+} // namespace btree_search
+
+// B+tree over fixed-length byte keys with optimistic lock coupling (Leis et
+// al., DaMoN 2016), another ordered index engine of tree_ordered_index.
+// Nodes hold up to 32 keys, searched through their heads: the first 8 key
+// bytes as big-endian integers, 256 bytes per node compared in a few AVX2
+// instructions, with full keys compared only among equal heads. Leaves
+// hold pointers to T, whose keys are KeyOf()(leaf), KeyLen bytes; they are
+// chained in key order, so forward scans walk from leaf to leaf without
+// going back to the root.
+//
+// Every node has a version word: readers take it before reading the node
+// and check it is unchanged afterwards, restarting from the root if not;
+// writers lock the nodes they change and bump their versions on unlock.
+// Full inner nodes are split on the way down, so a full leaf always finds
+// room in its parent. The root is an inner node that never moves: when it
+// fills, its contents move into two new children. Nodes never merge and
+// are only freed with the tree.
+//
+// Leaf versions double as the phantom protection of transactions: every
+// key lives in exactly one leaf, so an absent key is witnessed by its leaf
+// and a scan by the leaves it reads. Splits change the split leaf, so a
+// witness also covers keys that move. Writers report the leaves they
+// change and create to an observer, as art_tree's writers do.
+template <typename T, size_t KeyLen, typename KeyOf>
+class olc_btree {
+public:
+    static_assert(KeyLen > 0, "keys must be nonempty");
+
+    typedef uint64_t version_value_type;
+    static constexpr version_value_type lock_bit = 1;
+    static constexpr version_value_type version_step = 2;
+    static constexpr unsigned width = 32;
+
+    struct node {
+        std::atomic<version_value_type> version;
+        bool is_leaf;
+        uint16_t count;             // keys
+        uint64_t heads[width];
+
+        explicit node(bool leaf)
+            : version(0), is_leaf(leaf), count(0), heads() {}
+    };
+
+    // Observer of nothing, for writers outside transactions
+    struct no_observer {
+        void changed(node*, version_value_type, version_value_type) {}
+        void created(node*, version_value_type) {}
+    };
+
+    olc_btree()
+        : root_(new inner) {
+        root_->children[0] = new leaf;
+    }
+    ~olc_btree() {
+        destroy(root_);
+    }
+    olc_btree(const olc_btree&) = delete;
+    olc_btree& operator=(const olc_btree&) = delete;
+
+    // Returns the leaf with key, or nullptr after setting witness and
+    // witness_version to the leaf whose range holds key
+    T* lookup(const void* key, node*& witness, version_value_type& witness_version) const {
+        auto k = reinterpret_cast<const uint8_t*>(key);
+    restart:
+        version_value_type v;
+        leaf* l = find_leaf<false>(k, v);
+        if (!l)
+            goto restart;
+        T* x = candidate(l, k);
+        if (!validate(l, v))
+            goto restart;
+        if (x && memcmp(KeyOf()(x), k, KeyLen) == 0)
+            return x;
+        witness = l;
+        witness_version = v;
+        return nullptr;
+    }
+    T* lookup(const void* key) const {
+        node* n;
+        version_value_type v;
+        return lookup(key, n, v);
+    }
+
+    // Inserts value under its key unless a leaf with the key exists, and
+    // returns that leaf (nullptr if value was inserted). obs hears of every
+    // leaf the insert changes, with its version before and after, and of
+    // the leaves it creates.
+    template <typename Observer>
+    T* insert(T* value, Observer& obs) {
+        auto k = reinterpret_cast<const uint8_t*>(KeyOf()(value));
+    restart:
+        inner* parent = nullptr;
+        version_value_type pv = 0;
+        node* n = root_;
+        version_value_type v = stable(n);
+        while (!n->is_leaf) {
+            auto x = static_cast<inner*>(n);
+            if (x->count == width) {
+                if (parent && !try_lock(parent, pv))
+                    goto restart;
+                if (!try_lock(x, v)) {
+                    if (parent)
+                        unlock_unchanged(parent, pv);
+                    goto restart;
+                }
+                if (parent) {
+                    split_inner(parent, x);
+                    unlock(parent);
+                } else
+                    split_root();
+                unlock(x);
+                goto restart;
+            }
+            node* c = x->children[search<true>(x, size(x), k)];
+            if (!validate(x, v))
+                goto restart;
+            version_value_type cv = stable(c);
+            if (!validate(x, v))
+                goto restart;
+            parent = x;
+            pv = v;
+            n = c;
+            v = cv;
+        }
+
+        auto l = static_cast<leaf*>(n);
+        unsigned cnt = size(l);
+        unsigned p = search<false>(l, cnt, k);
+        T* x = p != cnt && l->heads[p] == head(k) ? l->values[p] : nullptr;
+        if (!validate(l, v))
+            goto restart;
+        if (x && memcmp(KeyOf()(x), k, KeyLen) == 0)
+            return x;
+        if (cnt == width) {
+            if (!try_lock(parent, pv))
+                goto restart;
+            if (!try_lock(l, v)) {
+                unlock_unchanged(parent, pv);
+                goto restart;
+            }
+            leaf* r = split_leaf(parent, l);
+            obs.changed(l, v, unlock(l));
+            obs.created(r, current_version(r));
+            unlock(parent);
+            goto restart;
+        }
+        if (!try_lock(l, v))
+            goto restart;
+        for (unsigned i = cnt; i != p; --i) {
+            l->heads[i] = l->heads[i - 1];
+            l->values[i] = l->values[i - 1];
+        }
+        l->heads[p] = head(k);
+        l->values[p] = value;
+        l->count = cnt + 1;
+        obs.changed(l, v, unlock(l));
+        return nullptr;
+    }
+    T* insert(T* value) {
+        no_observer obs;
+        return insert(value, obs);
+    }
+
+    // Removes the leaf with key, and returns it (nullptr if absent)
+    T* remove(const void* key) {
+        auto k = reinterpret_cast<const uint8_t*>(key);
+    restart:
+        version_value_type v;
+        leaf* l = find_leaf<false>(k, v);
+        if (!l)
+            goto restart;
+        unsigned cnt = size(l);
+        unsigned p = search<false>(l, cnt, k);
+        T* x = p != cnt && l->heads[p] == head(k) ? l->values[p] : nullptr;
+        if (!validate(l, v))
+            goto restart;
+        if (!x || memcmp(KeyOf()(x), k, KeyLen) != 0)
+            return nullptr;
+        if (!try_lock(l, v))
+            goto restart;
+        for (unsigned i = p; i + 1 < cnt; ++i) {
+            l->heads[i] = l->heads[i + 1];
+            l->values[i] = l->values[i + 1];
+        }
+        l->count = cnt - 1;
+        unlock(l);
+        return x;
+    }
+
+    // Visits the leaves in key order from key on (with Reverse, down from
+    // key), including key itself, with art_tree::scan's callbacks; node_cb
+    // sees every leaf node the scan reads. Forward scans follow the leaf
+    // chain, reverse scans descend again from each leaf's low key. A scan
+    // that meets a concurrent change restarts from the root after the last
+    // leaf it visited.
+    template <bool Reverse, typename NodeCallback, typename LeafCallback>
+    bool scan(const void* key, NodeCallback& node_cb, LeafCallback& leaf_cb) const {
+        uint8_t bound[KeyLen];      // the start key, then the last visited
+        uint8_t low[KeyLen];
+        T* batch[width];
+        memcpy(bound, key, KeyLen);
+        bool inclusive = true;
+    restart:
+        version_value_type v;
+        leaf* l = Reverse && !inclusive ? find_leaf<true>(bound, v) : find_leaf<false>(bound, v);
+        if (!l)
+            goto restart;
+        while (true) {
+            unsigned cnt = size(l);
+            unsigned n;
+            leaf* next = nullptr;
+            bool has_low = false;
+            if (!Reverse) {
+                unsigned p = inclusive ? search<false>(l, cnt, bound) : search<true>(l, cnt, bound);
+                n = cnt - p;
+                std::copy(l->values + p, l->values + cnt, batch);
+                next = l->next;
+            } else {
+                n = inclusive ? search<true>(l, cnt, bound) : search<false>(l, cnt, bound);
+                std::reverse_copy(l->values, l->values + n, batch);
+                has_low = l->has_low;
+                memcpy(low, l->low, KeyLen);
+            }
+            if (!validate(l, v))
+                goto restart;
+            if (!node_cb(static_cast<node*>(l), v))
+                return false;
+            for (unsigned i = 0; i != n; ++i) {
+                memcpy(bound, KeyOf()(batch[i]), KeyLen);
+                inclusive = false;
+                if (!leaf_cb(batch[i]))
+                    return true;
+            }
+            if (Reverse) {
+                if (!has_low)
+                    return true;
+                memcpy(bound, low, KeyLen);
+                inclusive = false;
+                goto restart;
+            }
+            if (!next)
+                return true;
+            version_value_type nv = stable(next);
+            if (!validate(l, v))
+                goto restart;
+            l = next;
+            v = nv;
+        }
+    }
+
+    // The version of a node, as a transaction validates it
+    static version_value_type current_version(const node* n) {
+        return n->version.load(std::memory_order_acquire);
+    }
+
+private:
+    struct leaf : public node {
+        T* values[width];
+        leaf* next;                 // the leaf with the following keys
+        bool has_low;               // false for the first leaf
+        uint8_t low[KeyLen];        // the separator above this leaf's keys
+
+        leaf()
+            : node(true), values(), next(nullptr), has_low(false), low() {}
+    };
+
+    // children[i] holds the keys below keys[i], and children[i + 1] the
+    // keys from keys[i] on
+    struct inner : public node {
+        uint8_t keys[width][KeyLen];
+        node* children[width + 1];
+
+        inner()
+            : node(false), children() {}
+    };
+
+    inner* root_;
+
+    static uint64_t head(const uint8_t* k) {
+        uint64_t h = 0;
+        memcpy(&h, k, std::min(KeyLen, sizeof(h)));
+        return __builtin_bswap64(h);
+    }
+
+    // Key counts read optimistically may be torn; keep them in bounds
+    static unsigned size(const node* n) {
+        return std::min<unsigned>(n->count, width);
+    }
+
+    static const uint8_t* key_at(const leaf* l, unsigned i) {
+        T* x = l->values[i];
+        return x ? reinterpret_cast<const uint8_t*>(KeyOf()(x)) : nullptr;
+    }
+    static const uint8_t* key_at(const inner* x, unsigned i) {
+        return x->keys[i];
+    }
+
+    // The position of k among the n keys of x: that of the first key not
+    // less than k, or with Upper, of the first key greater than k
+    template <bool Upper, typename N>
+    static unsigned search(const N* x, unsigned n, const uint8_t* k) {
+        uint64_t h = head(k);
+        unsigned p = btree_search::count_less_kernel(x->heads, n, h);
+        // equal heads order by their remaining bytes
+        while (p != n && x->heads[p] == h) {
+            int cmp = 0;
+            if (KeyLen > sizeof(h)) {
+                const uint8_t* pk = key_at(x, p);
+                if (!pk)
+                    break;
+                cmp = memcmp(pk + sizeof(h), k + sizeof(h), KeyLen - sizeof(h));
+            }
+            if (Upper ? cmp > 0 : cmp >= 0)
+                break;
+            ++p;
+        }
+        return p;
+    }
+
+    // The value that may hold key k in l
+    static T* candidate(const leaf* l, const uint8_t* k) {
+        unsigned cnt = size(l);
+        unsigned p = search<false>(l, cnt, k);
+        return p != cnt && l->heads[p] == head(k) ? l->values[p] : nullptr;
+    }
+
+    // The leaf whose range holds k, or with Below the one holding the keys
+    // just below k, with its version in v; nullptr if a node changed
+    template <bool Below>
+    leaf* find_leaf(const uint8_t* k, version_value_type& v) const {
+        node* n = root_;
+        version_value_type nv = stable(n);
+        while (!n->is_leaf) {
+            auto x = static_cast<const inner*>(n);
+            node* c = x->children[search<!Below>(x, size(x), k)];
+            if (!validate(n, nv))
+                return nullptr;
+            version_value_type cv = stable(c);
+            if (!validate(n, nv))
+                return nullptr;
+            n = c;
+            nv = cv;
+        }
+        v = nv;
+        return static_cast<leaf*>(n);
+    }
+
+    static version_value_type stable(const node* n) {
+        version_value_type v;
+        while ((v = n->version.load(std::memory_order_acquire)) & lock_bit)
+            relax_fence();
+        return v;
+    }
+    static bool validate(const node* n, version_value_type v) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return n->version.load(std::memory_order_relaxed) == v;
+    }
+    static bool try_lock(node* n, version_value_type v) {
+        return n->version.compare_exchange_strong(v, v | lock_bit, std::memory_order_acquire);
+    }
+    static version_value_type unlock(node* n) {
+        version_value_type v = (n->version.load(std::memory_order_relaxed) & ~lock_bit) + version_step;
+        n->version.store(v, std::memory_order_release);
+        return v;
+    }
+    static void unlock_unchanged(node* n, version_value_type v) {
+        n->version.store(v, std::memory_order_release);
+    }
+
+    // The mutators below run with their nodes locked, or before the nodes
+    // are published
+
+    // Adds separator k, with child c to its right, to the non-full x
+    static void insert_child(inner* x, const uint8_t* k, node* c) {
+        unsigned cnt = x->count;
+        unsigned p = search<true>(x, cnt, k);
+        for (unsigned i = cnt; i != p; --i) {
+            x->heads[i] = x->heads[i - 1];
+            memcpy(x->keys[i], x->keys[i - 1], KeyLen);
+            x->children[i + 1] = x->children[i];
+        }
+        x->heads[p] = head(k);
+        memcpy(x->keys[p], k, KeyLen);
+        x->children[p + 1] = c;
+        x->count = cnt + 1;
+    }
+
+    // Moves the keys of x after its middle one, and their children, to y,
+    // and returns the middle key's position
+    static unsigned move_upper(inner* x, inner* y) {
+        unsigned mid = width / 2;
+        for (unsigned i = mid + 1; i != width; ++i) {
+            y->heads[i - mid - 1] = x->heads[i];
+            memcpy(y->keys[i - mid - 1], x->keys[i], KeyLen);
+        }
+        for (unsigned i = mid + 1; i != width + 1; ++i)
+            y->children[i - mid - 1] = x->children[i];
+        y->count = width - mid - 1;
+        x->count = mid;
+        return mid;
+    }
+
+    void split_root() {
+        auto a = new inner;
+        auto b = new inner;
+        unsigned mid = move_upper(root_, b);
+        std::copy(root_->heads, root_->heads + mid, a->heads);
+        memcpy(a->keys, root_->keys, mid * KeyLen);
+        std::copy(root_->children, root_->children + mid + 1, a->children);
+        a->count = mid;
+        root_->heads[0] = root_->heads[mid];
+        memcpy(root_->keys[0], root_->keys[mid], KeyLen);
+        root_->children[0] = a;
+        root_->children[1] = b;
+        root_->count = 1;
+    }
+
+    static void split_inner(inner* parent, inner* x) {
+        auto y = new inner;
+        unsigned mid = move_upper(x, y);
+        insert_child(parent, x->keys[mid], y);
+    }
+
+    static leaf* split_leaf(inner* parent, leaf* l) {
+        auto r = new leaf;
+        unsigned mid = width / 2;
+        std::copy(l->heads + mid, l->heads + width, r->heads);
+        std::copy(l->values + mid, l->values + width, r->values);
+        r->count = width - mid;
+        r->has_low = true;
+        memcpy(r->low, KeyOf()(r->values[0]), KeyLen);
+        r->next = l->next;
+        l->next = r;
+        l->count = mid;
+        insert_child(parent, r->low, r);
+        return r;
+    }
+
+    static void destroy(node* n) {
+        if (n->is_leaf) {
+            delete static_cast<leaf*>(n);
+            return;
+        }
+        auto x = static_cast<inner*>(n);
+        for (unsigned i = 0; i != x->count + 1u; ++i)
+            destroy(x->children[i]);
+        delete x;
+    }
+};
+
+} // namespace bench
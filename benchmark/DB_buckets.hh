@@ -0,0 +1,426 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "compiler.hh"
+
+// Interleave the steps of batched index lookups
+#ifndef STO_INTERLEAVED_PROBES
+#define STO_INTERLEAVED_PROBES 1
+#endif
+
+namespace bench {
+
+// Bucket array of the unordered indexes, grown online. Each bucket is one
+// cache line: the bucket version, nslots inline node slots with a byte of
+// hash fingerprint each, and an overflow chain of Nodes (anything with a
+// `next` pointer). Lookups compare all fingerprints at once and only touch
+// nodes whose fingerprint matches, so a hit usually costs one miss on the
+// bucket and one on the node, and a miss only the bucket. The version is
+// bumped whenever a key is added, so an absent key observed through the
+// bucket version stays absent at commit. Writers hold the bucket lock;
+// readers run unlocked, and nodes never move between slots or into the
+// chain while they are in a bucket, so a lookup cannot skip a present key.
+//
+// When inserts find long chains, grow() links a table twice the size
+// behind the current one, and writers then migrate the old buckets a batch
+// at a time (help_migrate). While a bucket is unmigrated, the old table
+// holds all of its keys; migrating it relinks its nodes into the new
+// table, marks it moved and bumps its version, so lookups that observed
+// the old bucket fail validation and retry on the new table, whose buckets
+// already hold every migrated key. Nodes keep their addresses throughout.
+// Retired tables stay allocated until the index is destroyed (their total
+// is less than the live table), since non-transactional callers may still
+// be reading them.
+template <typename Node, typename Version>
+class resizable_buckets {
+public:
+    static constexpr unsigned nslots = 4;
+
+    struct __attribute__((aligned(64))) bucket_entry {
+        Version version;
+        Node* head;      // overflow chain
+        uint64_t tags;   // byte i: fingerprint of slot[i], 0 if empty
+        bool moved;      // set once the nodes live in the next table
+        Node* slot[nslots];
+        bucket_entry() : version(0), head(nullptr), tags(0), moved(false), slot() {}
+    };
+
+    // Overflow walks longer than this on insert suggest the table is too
+    // small
+    static constexpr size_t max_chain = 4;
+    // Grow once sampled buckets average more than this many nodes
+    static constexpr size_t max_load = nslots;
+    static constexpr size_t migrate_batch = 16;
+
+    explicit resizable_buckets(size_t size)
+        : cur_(new table(size)), old_(nullptr) {
+        tables_.push_back(cur_.load(std::memory_order_relaxed));
+    }
+    ~resizable_buckets() {
+        for (table* t : tables_)
+            delete t;
+    }
+
+    size_t nbuckets() const {
+        return cur_.load(std::memory_order_acquire)->size();
+    }
+
+    // The bucket for hash h and its version, read before the bucket is
+    // searched. Never returns a moved bucket.
+    bucket_entry& find(size_t h, Version& vers) {
+        while (true) {
+            bucket_entry& b = bucket(h);
+            vers = b.version;
+            fence();
+            if (!b.moved)
+                return b;
+        }
+    }
+    // Looks up with match(node) outside a transaction, rereading a bucket
+    // whose nodes were being migrated
+    template <typename Match>
+    Node* nontrans_find(size_t h, Match match) {
+        while (true) {
+            Version vers;
+            bucket_entry& b = find(h, vers);
+            Node* n = find_in(b, h, match);
+            fence();
+            if (n || (!vers.is_locked() && b.version.value() == vers.value()))
+                return n;
+        }
+    }
+    // Starts loading the bucket for hash h (batched lookups)
+    void prefetch(size_t h) {
+        ::prefetch(&bucket(h));
+    }
+    // The bucket for hash h, locked
+    bucket_entry& lock(size_t h) {
+        while (true) {
+            bucket_entry& b = bucket(h);
+            b.version.lock_exclusive();
+            if (!b.moved)
+                return b;
+            b.version.unlock_exclusive();
+        }
+    }
+
+    // The node of b with hash h for which match(node) holds. *depth counts
+    // the overflow nodes passed.
+    template <typename Match>
+    static Node* find_in(const bucket_entry& b, size_t h, Match match, size_t* depth = nullptr) {
+        for (uint64_t m = tag_matches(b.tags, fingerprint(h)); m; m &= m - 1) {
+            Node* n = b.slot[ctz(m) / 8];
+            if (n && match(n))
+                return n;
+        }
+        Node* n = b.head;
+        while (n && !match(n)) {
+            n = n->next;
+            if (depth)
+                ++*depth;
+        }
+        return n;
+    }
+    // Adds n, whose hash is h, to locked bucket b. Callers bump the
+    // version themselves.
+    static void insert(bucket_entry& b, size_t h, Node* n) {
+        if (uint64_t m = tag_matches(b.tags, 0)) {
+            unsigned i = ctz(m) / 8;
+            b.slot[i] = n;
+            fence();
+            b.tags |= uint64_t(fingerprint(h)) << (8 * i);
+        } else {
+            n->next = b.head;
+            fence();
+            b.head = n;
+        }
+    }
+    // Unlinks n from locked bucket b; false if it isn't there
+    static bool erase(bucket_entry& b, Node* n) {
+        for (unsigned i = 0; i != nslots; ++i)
+            if (b.slot[i] == n) {
+                b.tags &= ~(uint64_t(0xFF) << (8 * i));
+                fence();
+                b.slot[i] = nullptr;
+                return true;
+            }
+        for (Node** pprev = &b.head; *pprev; pprev = &(*pprev)->next)
+            if (*pprev == n) {
+                *pprev = n->next;
+                return true;
+            }
+        return false;
+    }
+    // Calls f on every node of b
+    template <typename F>
+    static void for_each_node(const bucket_entry& b, F f) {
+        for (unsigned i = 0; i != nslots; ++i)
+            if (Node* n = b.slot[i])
+                f(n);
+        for (Node* n = b.head; n; n = n->next)
+            f(n);
+    }
+
+    // A lookup of hash h run a step at a time, equivalent to find() then
+    // find_in(). Each step but the last ends by prefetching the line the
+    // next step reads (bucket, candidate slot node, next chain node), so
+    // several probes run round-robin (run_probes) overlap their misses.
+    class probe {
+    public:
+        probe() = default;
+        explicit probe(size_t h)
+            : h_(h), b_(nullptr), vers_(), cand_(0), n_(nullptr), state_(st_start) {
+        }
+        bool done() const {
+            return state_ == st_done;
+        }
+        // Valid once done(): the bucket searched, its version before the
+        // search, and the matching node (nullptr if none)
+        bucket_entry& bucket() const {
+            return *b_;
+        }
+        const Version& version() const {
+            return vers_;
+        }
+        Node* node() const {
+            return n_;
+        }
+
+        // Runs one step; true once the probe is done
+        template <typename Match>
+        bool step(resizable_buckets& bs, Match match) {
+            switch (state_) {
+            case st_start:
+                bs.prefetch(h_);
+                state_ = st_bucket;
+                return false;
+            case st_bucket:
+                b_ = &bs.find(h_, vers_);
+                cand_ = tag_matches(b_->tags, fingerprint(h_));
+                return next_candidate();
+            case st_slot:
+                if (match(n_))
+                    return finish(n_);
+                return next_candidate();
+            case st_chain:
+                if (match(n_))
+                    return finish(n_);
+                if (!(n_ = n_->next))
+                    return finish(nullptr);
+                ::prefetch(n_);
+                return false;
+            default:
+                return true;
+            }
+        }
+
+    private:
+        enum { st_start, st_bucket, st_slot, st_chain, st_done };
+        size_t h_;
+        bucket_entry* b_;
+        Version vers_;
+        uint64_t cand_;  // fingerprint matches not yet checked
+        Node* n_;
+        int state_;
+
+        bool next_candidate() {
+            for (; cand_; cand_ &= cand_ - 1)
+                if ((n_ = b_->slot[ctz(cand_) / 8])) {
+                    cand_ &= cand_ - 1;
+                    ::prefetch(n_);
+                    state_ = st_slot;
+                    return false;
+                }
+            if (!(n_ = b_->head))
+                return finish(nullptr);
+            ::prefetch(n_);
+            state_ = st_chain;
+            return false;
+        }
+        bool finish(Node* n) {
+            n_ = n;
+            state_ = st_done;
+            return true;
+        }
+    };
+
+    // Runs ps[0..n) to completion, stepping match_of(i)'s probe ps[i] in
+    // turn. With STO_INTERLEAVED_PROBES off, each probe runs alone to
+    // completion instead (for comparison).
+    template <typename MatchOf>
+    void run_probes(probe* ps, size_t n, MatchOf match_of) {
+#if STO_INTERLEAVED_PROBES
+        for (size_t left = n; left; )
+            for (size_t i = 0; i != n; ++i)
+                if (!ps[i].done() && ps[i].step(*this, match_of(i)))
+                    --left;
+#else
+        for (size_t i = 0; i != n; ++i)
+            while (!ps[i].step(*this, match_of(i)))
+                /* do nothing */;
+#endif
+    }
+
+    // Called by an insert that walked `depth` overflow nodes of b, after
+    // unlocking b. A long chain only grows the table if the buckets next
+    // to it are loaded too, so one hot bucket can't double it forever.
+    template <typename HashNode>
+    void note_insert(const bucket_entry& b, size_t depth, HashNode hash_node) {
+        if (likely(depth <= max_chain))
+            return;
+        table* t = cur_.load(std::memory_order_acquire);
+        if (&b < t->b_.data() || &b >= t->b_.data() + t->size())
+            return;
+        size_t sample = std::min(t->size(), size_t(33));
+        size_t first = std::min(size_t(&b - t->b_.data()), t->size() - sample);
+        size_t n = 0;
+        for (size_t i = first; i != first + sample; ++i)
+            if (&t->b_[i] != &b)
+                for_each_node(t->b_[i], [&](Node*) { ++n; });
+        if (n > max_load * (sample - 1))
+            grow(t, hash_node);
+    }
+
+    // Migrates one batch of buckets if a resize is under way
+    template <typename HashNode>
+    void help_migrate(HashNode hash_node) {
+        if (unlikely(old_.load(std::memory_order_relaxed) != nullptr))
+            migrate(hash_node);
+    }
+    // Finishes any resize, then calls f on every bucket
+    template <typename HashNode, typename F>
+    void for_each(HashNode hash_node, F f) {
+        while (old_.load(std::memory_order_acquire))
+            migrate(hash_node);
+        for (bucket_entry& b : cur_.load(std::memory_order_acquire)->b_)
+            f(b);
+    }
+    // Finishes any resize, then calls f on part `part` of nparts equal
+    // bucket ranges, while other threads read and write. Returns false if a
+    // resize started meanwhile: nodes it migrated may have been skipped,
+    // so the caller should walk the part again.
+    template <typename HashNode, typename F>
+    bool for_each_part(HashNode hash_node, size_t part, size_t nparts, F f) {
+        while (old_.load(std::memory_order_acquire))
+            migrate(hash_node);
+        table* t = cur_.load(std::memory_order_acquire);
+        size_t first = t->size() * part / nparts, last = t->size() * (part + 1) / nparts;
+        for (size_t i = first; i != last; ++i)
+            f(t->b_[i]);
+        fence();
+        return cur_.load(std::memory_order_acquire) == t && !old_.load(std::memory_order_acquire);
+    }
+
+private:
+    struct table {
+        std::vector<bucket_entry> b_;
+        table* next;  // the table this one migrates into
+        std::atomic<size_t> claimed;
+        std::atomic<size_t> migrated;
+
+        explicit table(size_t size)
+            : b_(size), next(nullptr), claimed(0), migrated(0) {
+        }
+        size_t size() const {
+            return b_.size();
+        }
+        bucket_entry& at(size_t h) {
+            return b_[h % b_.size()];
+        }
+    };
+
+    // cur_ is swung after old_, so a reader that sees the new table also
+    // sees the migration
+    std::atomic<table*> cur_;
+    std::atomic<table*> old_;
+    std::mutex grow_lock_;
+    std::vector<table*> tables_;
+
+    // Nonzero; taken from the high bits of a mixed hash, since the low
+    // bits pick the bucket
+    static uint8_t fingerprint(size_t h) {
+        uint8_t f = (uint64_t(h) * 0x9E3779B97F4A7C15ULL) >> 56;
+        return f ? f : 1;
+    }
+    // Byte i's high bit is set if slot i may have fingerprint f (borrows
+    // can add false positives, never drop a match)
+    static uint64_t tag_matches(uint64_t tags, uint8_t f) {
+        constexpr uint64_t lows = 0x0101010101010101ULL;
+        constexpr uint64_t slot_mask = (uint64_t(1) << (8 * nslots)) - 1;
+        uint64_t x = (tags ^ (lows * f)) | ~slot_mask;
+        return (x - lows) & ~x & (lows << 7);
+    }
+
+    bucket_entry& bucket(size_t h) {
+        table* t = cur_.load(std::memory_order_acquire);
+        if (table* o = old_.load(std::memory_order_acquire)) {
+            bucket_entry& b = o->at(h);
+            if (!b.moved)
+                return b;
+            t = o->next;
+        }
+        return t->at(h);
+    }
+
+    template <typename HashNode>
+    void grow(table* t, HashNode hash_node) {
+        {
+            std::lock_guard<std::mutex> guard(grow_lock_);
+            if (old_.load(std::memory_order_relaxed) || cur_.load(std::memory_order_relaxed) != t)
+                return;
+            table* n = new table(2 * t->size());
+            tables_.push_back(n);
+            t->next = n;
+            old_.store(t, std::memory_order_release);
+            cur_.store(n, std::memory_order_release);
+        }
+        migrate(hash_node);
+    }
+
+    template <typename HashNode>
+    void migrate(HashNode hash_node) {
+        table* o = old_.load(std::memory_order_acquire);
+        if (!o)
+            return;
+        size_t first = o->claimed.fetch_add(migrate_batch);
+        if (first >= o->size())
+            return;
+        size_t last = std::min(first + migrate_batch, o->size());
+        for (size_t i = first; i != last; ++i)
+            migrate_bucket(o->b_[i], o->next, hash_node);
+        if (o->migrated.fetch_add(last - first) + (last - first) == o->size()) {
+            std::lock_guard<std::mutex> guard(grow_lock_);
+            old_.store(nullptr, std::memory_order_release);
+        }
+    }
+
+    template <typename HashNode>
+    static void migrate_bucket(bucket_entry& b, table* n, HashNode hash_node) {
+        b.version.lock_exclusive();
+        Node* chain = b.head;
+        auto move = [&](Node* e) {
+            // keys of other old buckets: readers of nb need no version bump
+            size_t h = hash_node(e);
+            bucket_entry& nb = n->at(h);
+            nb.version.lock_exclusive();
+            insert(nb, h, e);
+            nb.version.unlock_exclusive();
+        };
+        for (unsigned i = 0; i != nslots; ++i)
+            if (Node* e = b.slot[i])
+                move(e);
+        while (Node* e = chain) {
+            chain = e->next;
+            move(e);
+        }
+        b.moved = true;
+        fence();
+        b.version.inc_nonopaque();
+        b.version.unlock_exclusive();
+    }
+};
+
+}
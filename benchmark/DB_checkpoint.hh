@@ -0,0 +1,744 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "AsyncIO.hh"
+#include "DB_index.hh"
+
+namespace bench {
+
+// One file of a checkpoint, holding one part of one table:
+//
+//   [header, header_bytes][row 0][row 1]...[row nrows-1][padding]
+//
+// A row is the byte image of its key, padded to the value's alignment,
+// followed by that of its value, padded to row_size; every key and value
+// is aligned, so a mapped file is read in place (mapped_part). Rows are
+// written a block at a time with direct I/O where the file system allows
+// it, so the file is padded to a whole page.
+struct checkpoint_header {
+    static constexpr size_t header_bytes = 4096;
+
+    char magic[8];          // "STOCKPT1"
+    uint64_t start_epoch;
+    uint64_t tid;           // snapshot tid; MVCC tables are read as of it
+    uint64_t nrows;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t value_offset;
+    uint32_t row_size;
+    uint32_t part;
+    uint32_t nparts;
+};
+static_assert(sizeof(checkpoint_header) <= checkpoint_header::header_bytes,
+              "Checkpoint header too large.");
+
+template <typename K, typename V>
+struct checkpoint_row_layout {
+    static constexpr size_t align = alignof(K) > alignof(V) ? alignof(K) : alignof(V);
+    static constexpr size_t value_offset = (sizeof(K) + alignof(V) - 1) / alignof(V) * alignof(V);
+    static constexpr size_t row_size = (value_offset + sizeof(V) + align - 1) / align * align;
+    static_assert(checkpoint_header::header_bytes % align == 0, "Checkpoint rows misaligned.");
+};
+
+// A checkpoint file of K keys and V rows, mapped read-only. Iterators
+// yield (first, second) references into the mapping, so a part can go
+// straight to an index's bulk_load.
+template <typename K, typename V>
+class mapped_part {
+public:
+    typedef checkpoint_row_layout<K, V> layout;
+
+    struct row_ref {
+        const K& first;
+        const V& second;
+    };
+
+    class iterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef row_ref value_type;
+        typedef ptrdiff_t difference_type;
+        typedef row_ref reference;
+        struct pointer {
+            row_ref r;
+            const row_ref* operator->() const {
+                return &r;
+            }
+        };
+
+        iterator() = default;
+        explicit iterator(const char* p)
+            : p_(p) {
+        }
+
+        reference operator*() const {
+            return {*reinterpret_cast<const K*>(p_),
+                    *reinterpret_cast<const V*>(p_ + layout::value_offset)};
+        }
+        pointer operator->() const {
+            return {**this};
+        }
+        reference operator[](difference_type n) const {
+            return *(*this + n);
+        }
+
+        iterator& operator++() {
+            p_ += layout::row_size;
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator x = *this;
+            ++*this;
+            return x;
+        }
+        iterator& operator--() {
+            p_ -= layout::row_size;
+            return *this;
+        }
+        iterator operator--(int) {
+            iterator x = *this;
+            --*this;
+            return x;
+        }
+        iterator& operator+=(difference_type n) {
+            p_ += n * difference_type(layout::row_size);
+            return *this;
+        }
+        iterator& operator-=(difference_type n) {
+            p_ -= n * difference_type(layout::row_size);
+            return *this;
+        }
+        iterator operator+(difference_type n) const {
+            return iterator(*this) += n;
+        }
+        friend iterator operator+(difference_type n, const iterator& x) {
+            return x + n;
+        }
+        iterator operator-(difference_type n) const {
+            return iterator(*this) -= n;
+        }
+        difference_type operator-(const iterator& x) const {
+            return (p_ - x.p_) / difference_type(layout::row_size);
+        }
+
+        bool operator==(const iterator& x) const {
+            return p_ == x.p_;
+        }
+        bool operator!=(const iterator& x) const {
+            return p_ != x.p_;
+        }
+        bool operator<(const iterator& x) const {
+            return p_ < x.p_;
+        }
+        bool operator>(const iterator& x) const {
+            return p_ > x.p_;
+        }
+        bool operator<=(const iterator& x) const {
+            return p_ <= x.p_;
+        }
+        bool operator>=(const iterator& x) const {
+            return p_ >= x.p_;
+        }
+
+    private:
+        const char* p_ = nullptr;
+    };
+
+    // Check ok(): false if the file can't be mapped or doesn't hold K
+    // keys and V rows
+    explicit mapped_part(const std::string& path)
+        : base_(nullptr), len_(0), nrows_(0) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && size_t(st.st_size) >= checkpoint_header::header_bytes) {
+            void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                base_ = static_cast<const char*>(p);
+                len_ = st.st_size;
+            }
+        }
+        ::close(fd);
+        if (!base_)
+            return;
+        const checkpoint_header& hdr = header();
+        if (memcmp(hdr.magic, "STOCKPT1", sizeof(hdr.magic)) != 0
+            || hdr.key_size != sizeof(K) || hdr.value_size != sizeof(V)
+            || hdr.value_offset != layout::value_offset || hdr.row_size != layout::row_size
+            || hdr.nrows > (len_ - checkpoint_header::header_bytes) / layout::row_size) {
+            unmap();
+            return;
+        }
+        nrows_ = hdr.nrows;
+        ::madvise(const_cast<char*>(base_), len_, MADV_SEQUENTIAL);
+    }
+    ~mapped_part() {
+        unmap();
+    }
+    mapped_part(const mapped_part&) = delete;
+    mapped_part& operator=(const mapped_part&) = delete;
+
+    bool ok() const {
+        return base_ != nullptr;
+    }
+    const checkpoint_header& header() const {
+        return *reinterpret_cast<const checkpoint_header*>(base_);
+    }
+    size_t size() const {
+        return nrows_;
+    }
+    iterator begin() const {
+        return iterator(base_ + checkpoint_header::header_bytes);
+    }
+    iterator end() const {
+        return begin() + nrows_;
+    }
+
+private:
+    const char* base_;
+    size_t len_;
+    size_t nrows_;
+
+    void unmap() {
+        if (base_)
+            ::munmap(const_cast<char*>(base_), len_);
+        base_ = nullptr;
+    }
+};
+
+// Checkpoints ordered_index and unordered_index tables, and their MVCC
+// variants, from background threads while transactions run, without
+// blocking them. Each table is cut into parts, bucket ranges of an
+// unordered index or key ranges of an ordered one; each part is written
+// to its own file, <dir>/<table>.<part>, and nthreads threads write the
+// parts in parallel.
+//
+// A checkpoint starts at the current global epoch. Once every commit of
+// an earlier epoch is installed, it pins a snapshot: MVCC tables are read
+// as of the snapshot, other tables get fuzzy copies, each row consistent
+// with its version but copied at its own time. Either way every write the
+// checkpoint misses committed in the start epoch or later, so replaying
+// the log from the start epoch (TxnLog::recover's from_epoch) over the
+// checkpoint restores the tables, and older logs can be truncated. The
+// wait for earlier epochs uses TxnLog's durable epoch and is skipped when
+// TxnLog isn't running. When every file is synced, the checkpoint is
+// recorded in <dir>/checkpoint, replacing the one before.
+class checkpointer {
+public:
+    // Checkpoint threads run as TThread ids first_thread_id and up
+    checkpointer(std::string dir, int nthreads, int first_thread_id,
+                 size_t block_bytes = size_t(1) << 20)
+        : dir_(std::move(dir)), nthreads_(std::max(nthreads, 1)), first_thread_id_(first_thread_id),
+          block_bytes_(std::max(block_bytes / page * page, page)),
+          start_epoch_(0), tid_(0), ok_(true) {
+    }
+    ~checkpointer() {
+        join();
+    }
+
+    // An unordered table, in nparts bucket ranges
+    template <typename Index>
+    void add_table(const std::string& name, Index& index, size_t nparts) {
+        for (size_t p = 0; p != nparts; ++p)
+            add_part<Index>(name, p, nparts, [&index, p, nparts](TransactionTid::type tid, part_writer& w) {
+                    while (!index.checkpoint_part(p, nparts, tid, [&](const auto& k, const auto& v) {
+                                w.append(&k, &v);
+                            }))
+                        w.restart();
+                });
+    }
+    // An ordered table, in the key ranges that the sorted bounds separate
+    template <typename Index>
+    void add_table(const std::string& name, Index& index, const std::vector<typename Index::key_type>& bounds) {
+        auto b = std::make_shared<std::vector<typename Index::key_type>>(bounds);
+        size_t nparts = bounds.size() + 1;
+        for (size_t p = 0; p != nparts; ++p)
+            add_part<Index>(name, p, nparts, [&index, b, p](TransactionTid::type tid, part_writer& w) {
+                    lcdf::Str begin = p ? lcdf::Str((*b)[p - 1]) : lcdf::Str();
+                    lcdf::Str end = p != b->size() ? lcdf::Str((*b)[p]) : lcdf::Str();
+                    index.checkpoint_range(begin, end, tid, [&](const auto& k, const auto& v) {
+                            w.append(&k, &v);
+                        });
+                });
+    }
+
+    // Starts the checkpoint in the background
+    void start() {
+        assert(!thread_.joinable());
+        thread_ = std::thread(&checkpointer::run, this);
+    }
+    // Waits for the checkpoint; false if it couldn't be written
+    bool join() {
+        if (thread_.joinable())
+            thread_.join();
+        return ok_;
+    }
+
+    uint64_t start_epoch() const {
+        return start_epoch_;
+    }
+    TransactionTid::type tid() const {
+        return tid_;
+    }
+    uint64_t rows() const {
+        uint64_t n = 0;
+        for (auto& p : parts_)
+            n += p.nrows;
+        return n;
+    }
+
+    // The start epoch of the checkpoint recorded in dir, or 0 if none
+    static uint64_t last_start_epoch(const std::string& dir) {
+        std::ifstream in(dir + "/checkpoint");
+        std::string word;
+        uint64_t epoch;
+        if (in >> word >> epoch && word == "start_epoch")
+            return epoch;
+        return 0;
+    }
+
+    // Calls f(key, value) for every row of a checkpoint file written for
+    // key type K and value type V; false if the file doesn't hold them
+    template <typename K, typename V, typename F>
+    static bool read_part(const std::string& path, F f) {
+        mapped_part<K, V> m(path);
+        for (auto r : m)
+            f(r.first, r.second);
+        return m.ok();
+    }
+
+private:
+    static constexpr size_t page = checkpoint_header::header_bytes;
+
+    // Buffers one part's rows and writes them a block at a time. Blocks
+    // alternate between two registered buffers, so one is filled while
+    // the other is written.
+    class part_writer {
+    public:
+        part_writer(const std::string& path, const checkpoint_header& hdr, size_t block_bytes)
+            : hdr_(hdr), block_bytes_(block_bytes), len_(0), offset_(page), ok_(true), io_(2) {
+            fd_ = AsyncIO::open_direct(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            void* p = nullptr;
+            ok_ = fd_ >= 0 && posix_memalign(&p, page, 2 * block_bytes_) == 0;
+            buf_ = spare_ = reinterpret_cast<char*>(p);
+            if (ok_) {
+                spare_ += block_bytes_;
+                struct iovec iov = {p, 2 * block_bytes_};
+                io_.register_buffers(&iov, 1);
+            }
+        }
+        ~part_writer() {
+            io_.wait();
+            if (fd_ >= 0)
+                ::close(fd_);
+            free(std::min(buf_, spare_));
+        }
+
+        void append(const void* key, const void* value) {
+            if (!ok_)
+                return;
+            put(reinterpret_cast<const char*>(key), hdr_.key_size);
+            put_zeros(hdr_.value_offset - hdr_.key_size);
+            put(reinterpret_cast<const char*>(value), hdr_.value_size);
+            put_zeros(hdr_.row_size - hdr_.value_offset - hdr_.value_size);
+            ++hdr_.nrows;
+        }
+        // Drops the rows appended so far
+        void restart() {
+            ok_ = io_.wait() && ok_;
+            len_ = 0;
+            offset_ = page;
+            hdr_.nrows = 0;
+        }
+        uint64_t rows() const {
+            return hdr_.nrows;
+        }
+
+        // Pads and writes the last block, then the header; syncs and closes
+        bool finish() {
+            if (ok_ && len_) {
+                size_t padded = (len_ + page - 1) / page * page;
+                memset(buf_ + len_, 0, padded - len_);
+                write_block(padded);
+            }
+            if (ok_) {
+                memset(buf_, 0, page);
+                memcpy(buf_, &hdr_, sizeof(hdr_));
+                io_.write(fd_, buf_, page, 0);
+                ok_ = io_.flush();
+            }
+            if (ok_ && ::ftruncate(fd_, offset_) != 0)
+                ok_ = false;
+            if (ok_) {
+                io_.sync(fd_);
+                ok_ = io_.flush();
+            }
+            if (fd_ >= 0 && ::close(fd_) != 0)
+                ok_ = false;
+            fd_ = -1;
+            return ok_;
+        }
+
+    private:
+        checkpoint_header hdr_;
+        size_t block_bytes_;
+        char* buf_;     // being filled
+        char* spare_;   // being written, or free
+        size_t len_;
+        off_t offset_;
+        int fd_;
+        bool ok_;
+        AsyncIO io_;
+
+        void put(const char* p, size_t n) {
+            while (n) {
+                size_t k = std::min(n, block_bytes_ - len_);
+                memcpy(buf_ + len_, p, k);
+                len_ += k;
+                p += k;
+                n -= k;
+                if (len_ == block_bytes_)
+                    write_block(len_);
+            }
+        }
+
+        void put_zeros(size_t n) {
+            static const char zeros[64] = {};
+            for (size_t k; n; n -= k) {
+                k = std::min(n, sizeof(zeros));
+                put(zeros, k);
+            }
+        }
+
+        // Submits the first size bytes of buf_ and switches buffers once
+        // the block before is written
+        void write_block(size_t size) {
+            ok_ = io_.wait() && ok_;
+            io_.write(fd_, buf_, size, offset_);
+            io_.submit();
+            offset_ += size;
+            len_ = 0;
+            std::swap(buf_, spare_);
+        }
+    };
+
+    struct part {
+        std::string file;
+        checkpoint_header hdr;
+        void (*thread_init)();
+        std::function<void(TransactionTid::type, part_writer&)> scan;
+        uint64_t nrows;
+        bool ok;
+    };
+
+    std::string dir_;
+    int nthreads_;
+    int first_thread_id_;
+    size_t block_bytes_;
+    uint64_t start_epoch_;
+    TransactionTid::type tid_;
+    bool ok_;
+    std::vector<part> parts_;
+    std::thread thread_;
+
+    template <typename Index>
+    void add_part(const std::string& name, size_t p, size_t nparts,
+                  std::function<void(TransactionTid::type, part_writer&)> scan) {
+        typedef typename Index::key_type key_type;
+        typedef typename Index::value_type value_type;
+        static_assert(std::is_trivially_copyable<key_type>::value
+                      && std::is_trivially_copyable<value_type>::value,
+                      "Checkpointed keys and rows must be trivially copyable.");
+        part x;
+        x.file = name + "." + std::to_string(p);
+        memset(&x.hdr, 0, sizeof(x.hdr));
+        memcpy(x.hdr.magic, "STOCKPT1", sizeof(x.hdr.magic));
+        x.hdr.key_size = sizeof(key_type);
+        x.hdr.value_size = sizeof(value_type);
+        x.hdr.value_offset = checkpoint_row_layout<key_type, value_type>::value_offset;
+        x.hdr.row_size = checkpoint_row_layout<key_type, value_type>::row_size;
+        x.hdr.part = p;
+        x.hdr.nparts = nparts;
+        x.thread_init = &Index::thread_init;
+        x.scan = std::move(scan);
+        x.nrows = 0;
+        x.ok = false;
+        parts_.push_back(std::move(x));
+    }
+
+    void run() {
+        TThread::set_id(first_thread_id_);
+        start_epoch_ = Transaction::global_epochs.global_epoch.load(std::memory_order_acquire);
+        // a commit is installed before its epoch can become durable
+        if (TxnLog::enabled())
+            TxnLog::wait_durable(start_epoch_ - 1);
+        int slot = Transaction::pin_snapshot(tid_);
+
+        std::atomic<size_t> next(0);
+        auto worker = [&] (int i) {
+            TThread::set_id(first_thread_id_ + i);
+            for (size_t p; (p = next.fetch_add(1)) < parts_.size(); )
+                write_part(parts_[p]);
+        };
+        std::vector<std::thread> helpers;
+        for (int i = 1; i < nthreads_; ++i)
+            helpers.emplace_back(worker, i);
+        worker(0);
+        for (auto& t : helpers)
+            t.join();
+        Transaction::unpin_snapshot(slot);
+
+        for (auto& p : parts_)
+            ok_ = ok_ && p.ok;
+        ok_ = ok_ && write_manifest();
+    }
+
+    void write_part(part& p) {
+        p.thread_init();
+        p.hdr.start_epoch = start_epoch_;
+        p.hdr.tid = tid_;
+        part_writer w(dir_ + "/" + p.file, p.hdr, block_bytes_);
+        p.scan(tid_, w);
+        p.nrows = w.rows();
+        p.ok = w.finish();
+    }
+
+    // Written beside the parts, then renamed over the last checkpoint's
+    bool write_manifest() {
+        std::string text = "start_epoch " + std::to_string(start_epoch_) + "\ntid " + std::to_string(tid_) + "\n";
+        for (auto& p : parts_)
+            text += p.file + " " + std::to_string(p.nrows) + "\n";
+        std::string tmp = dir_ + "/checkpoint.tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = ::write(fd, text.data(), text.size()) == ssize_t(text.size()) && ::fsync(fd) == 0;
+        ok = ::close(fd) == 0 && ok;
+        return ok && ::rename(tmp.c_str(), (dir_ + "/checkpoint").c_str()) == 0;
+    }
+};
+
+// Rebuilds tables after a crash, outside any transaction, from the
+// checkpoint in one directory and the log in another. Checkpoint parts
+// are mapped and bulk loaded in parallel, rows going from the mapping
+// straight into the index. The log
+// from the checkpoint's start epoch is then replayed by
+// TxnLog::recover's parallel replay: records are partitioned by key
+// across the threads and applied in version order, so the last
+// writer of each key wins. A table's log records are those with its log
+// id, holding the byte image of a key and either a row, a delta patching
+// the key's current row, or a delete.
+class recoverer {
+public:
+    struct stats {
+        uint64_t checkpoint_bytes = 0;
+        uint64_t checkpoint_rows = 0;
+        double checkpoint_seconds = 0;
+        TxnLog::recovery_stats log;
+
+        double seconds() const {
+            return checkpoint_seconds + log.seconds;
+        }
+        double gbps() const {
+            double t = seconds();
+            return t > 0 ? (checkpoint_bytes + log.bytes) / t / 1e9 : 0;
+        }
+    };
+
+    // Log replay runs on the calling thread and on threads with TThread
+    // ids 1 to nthreads - 1
+    explicit recoverer(int nthreads)
+        : nthreads_(std::max(nthreads, 1)) {
+    }
+
+    // A table checkpointed under name whose writes are logged under log_id
+    template <typename Index>
+    void add_table(const std::string& name, uint32_t log_id, Index& index) {
+        typedef typename Index::key_type key_type;
+        typedef typename Index::value_type value_type;
+        table t;
+        t.name = name;
+        t.log_id = log_id;
+        t.load = [this, &index](const std::string& dir, const std::vector<manifest_entry>& parts) {
+            return load_table<key_type, value_type>(dir, parts, index);
+        };
+        t.thread_init = &Index::thread_init;
+        t.apply = [&index](const TxnLog::record& r) {
+            if (r.keylen != sizeof(key_type))
+                return false;
+            key_type k;
+            memcpy(&k, r.key, sizeof(k));
+            if (r.is_delete()) {
+                if constexpr (has_nontrans_remove<Index>::value) {
+                    index.nontrans_remove(k);
+                    return true;
+                } else
+                    return false;
+            }
+            value_type v;
+            if (r.is_delta()) {
+                // patch the row as of the checkpoint and earlier records
+                if constexpr (has_nontrans_get_ptr<Index>::value) {
+                    value_type* row = index.nontrans_get(k);
+                    return row && TxnLog::apply_delta(r, row, sizeof(value_type));
+                } else {
+                    if (!index.nontrans_get(k, &v) || !TxnLog::apply_delta(r, &v, sizeof(v)))
+                        return false;
+                    index.nontrans_put(k, v);
+                    return true;
+                }
+            }
+            if (r.vallen != sizeof(value_type))
+                return false;
+            memcpy(&v, r.value, sizeof(v));
+            index.nontrans_put(k, v);
+            return true;
+        };
+        tables_.push_back(std::move(t));
+    }
+
+    // Loads the checkpoint in checkpoint_dir, if there is one, then
+    // replays log_dir over it. False if a checkpoint file is unreadable or
+    // a logged write doesn't fit its table.
+    bool run(const std::string& checkpoint_dir, const std::string& log_dir) {
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t start_epoch = 0;
+        std::vector<manifest_entry> entries;
+        bool ok = read_manifest(checkpoint_dir, start_epoch, entries);
+        for (auto& t : tables_) {
+            std::vector<manifest_entry> parts;
+            for (auto& e : entries)
+                if (e.file.compare(0, t.name.size() + 1, t.name + ".") == 0)
+                    parts.push_back(e);
+            // in part order, which for ordered tables is key order
+            std::sort(parts.begin(), parts.end(), [](const manifest_entry& a, const manifest_entry& b) {
+                    return a.part < b.part;
+                });
+            ok = t.load(checkpoint_dir, parts) && ok;
+        }
+        stats_.checkpoint_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        std::vector<std::vector<char>> ready(nthreads_, std::vector<char>(tables_.size()));
+        std::atomic<bool> fits(true);
+        stats_.log = TxnLog::recover(log_dir.c_str(), nthreads_, [&](const TxnLog::record& r, int i) {
+                for (size_t t = 0; t != tables_.size(); ++t)
+                    if (tables_[t].log_id == r.object_id) {
+                        if (!ready[i][t]) {
+                            tables_[t].thread_init();
+                            ready[i][t] = true;
+                        }
+                        if (!tables_[t].apply(r))
+                            fits.store(false, std::memory_order_relaxed);
+                        return;
+                    }
+            }, start_epoch);
+        return ok && fits.load();
+    }
+
+    const stats& statistics() const {
+        return stats_;
+    }
+
+private:
+    struct manifest_entry {
+        std::string file;
+        uint64_t part;
+        uint64_t nrows;
+    };
+    struct table {
+        std::string name;
+        uint32_t log_id;
+        std::function<bool(const std::string&, const std::vector<manifest_entry>&)> load;
+        void (*thread_init)();
+        std::function<bool(const TxnLog::record&)> apply;
+    };
+
+    template <typename T, typename = void>
+    struct has_nontrans_remove : std::false_type {};
+    template <typename T>
+    struct has_nontrans_remove<T, std::void_t<decltype(std::declval<T&>().nontrans_remove(
+            std::declval<const typename T::key_type&>()))>> : std::true_type {};
+    // OCC indexes hand out the row itself, MVCC ones a copy
+    template <typename T, typename = void>
+    struct has_nontrans_get_ptr : std::false_type {};
+    template <typename T>
+    struct has_nontrans_get_ptr<T, std::void_t<decltype(*std::declval<T&>().nontrans_get(
+            std::declval<const typename T::key_type&>()))>> : std::true_type {};
+
+    int nthreads_;
+    std::vector<table> tables_;
+    stats stats_;
+
+    // False only for a manifest that exists but can't be parsed
+    static bool read_manifest(const std::string& dir, uint64_t& start_epoch,
+                              std::vector<manifest_entry>& entries) {
+        std::ifstream in(dir + "/checkpoint");
+        if (!in)
+            return true;
+        std::string word;
+        uint64_t tid;
+        if (!(in >> word >> start_epoch) || word != "start_epoch"
+            || !(in >> word >> tid) || word != "tid")
+            return false;
+        manifest_entry e;
+        while (in >> e.file >> e.nrows) {
+            size_t dot = e.file.rfind('.');
+            if (dot == std::string::npos)
+                return false;
+            e.part = strtoull(e.file.c_str() + dot + 1, nullptr, 10);
+            entries.push_back(e);
+        }
+        return in.eof();
+    }
+
+    // Parts load side by side, each bulk loaded straight from its mapping;
+    // a table of fewer parts than threads splits each part's load
+    template <typename K, typename V, typename Index>
+    bool load_table(const std::string& dir, const std::vector<manifest_entry>& parts, Index& index) {
+        int per_part = std::max(1, nthreads_ / std::max(int(parts.size()), 1));
+        std::atomic<size_t> next(0);
+        std::atomic<uint64_t> rows(0);
+        std::atomic<bool> ok(true);
+        auto worker = [&] () {
+            for (size_t p; (p = next.fetch_add(1)) < parts.size(); ) {
+                mapped_part<K, V> m(dir + "/" + parts[p].file);
+                if (!m.ok() || m.size() != parts[p].nrows) {
+                    ok.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                index.bulk_load(m.begin(), m.end(), per_part);
+                rows.fetch_add(m.size(), std::memory_order_relaxed);
+            }
+        };
+        std::vector<std::thread> helpers;
+        for (int i = 1; i < std::min(nthreads_, int(parts.size())); ++i)
+            helpers.emplace_back(worker);
+        worker();
+        for (auto& t : helpers)
+            t.join();
+        stats_.checkpoint_rows += rows.load();
+        stats_.checkpoint_bytes += rows.load() * checkpoint_row_layout<K, V>::row_size;
+        return ok.load();
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "TThread.hh"
+
+// Record the columns named by every row access, for split layout tuning
+#ifndef STO_PROFILE_COLUMNS
+#define STO_PROFILE_COLUMNS 0
+#endif
+
+// Where db_profiler writes the recorded column accesses
+#ifndef STO_PROFILE_COLUMNS_FILE
+#define STO_PROFILE_COLUMNS_FILE "column_profile.txt"
+#endif
+
+namespace bench {
+
+// Histogram of column access patterns per row type. Each row access an
+// index turns into cell accesses is recorded as the sets of columns it
+// reads and writes, so the co-access frequency of any group of columns
+// can be recovered from the dump. The codegen tool reads the dump to pick
+// @groups (see sto-core/codegen).
+//
+// Dump format, per row type:
+//   row <type name> <number of patterns>
+//   <count> <read column mask> <write column mask>    (masks in hex)
+class column_profile {
+public:
+    static constexpr int max_columns = 64;
+
+    template <typename Row, typename Accesses>
+    static void record(const Accesses& accesses) {
+        uint64_t read = 0, write = 0;
+        for (auto& a : accesses) {
+            if (a.col_id >= max_columns)
+                continue;
+            if (static_cast<int>(a.access) & 1)
+                read |= uint64_t(1) << a.col_id;
+            if (static_cast<int>(a.access) & 2)
+                write |= uint64_t(1) << a.col_id;
+        }
+        auto& counts = table_of<Row>().counts[TThread::id()];
+        ++counts.map[pattern{read, write}];
+    }
+
+    static void dump(std::ostream& out) {
+        std::lock_guard<std::mutex> guard(tables_lock());
+        for (auto t : tables()) {
+            std::unordered_map<pattern, uint64_t, pattern_hash> total;
+            for (auto& c : t->counts)
+                for (auto& pc : c.map)
+                    total[pc.first] += pc.second;
+            out << "row " << t->name << ' ' << total.size() << '\n';
+            for (auto& pc : total)
+                out << std::dec << pc.second << std::hex
+                    << " 0x" << pc.first.read << " 0x" << pc.first.write << std::dec << '\n';
+        }
+    }
+
+    static bool dump(const char* filename) {
+        std::ofstream out(filename);
+        dump(out);
+        return bool(out);
+    }
+
+private:
+    struct pattern {
+        uint64_t read;
+        uint64_t write;
+        bool operator==(const pattern& other) const {
+            return read == other.read && write == other.write;
+        }
+    };
+    struct pattern_hash {
+        size_t operator()(const pattern& p) const {
+            return std::hash<uint64_t>()(p.read * 0x9e3779b97f4a7c15ull ^ p.write);
+        }
+    };
+    struct alignas(64) thread_counts {
+        std::unordered_map<pattern, uint64_t, pattern_hash> map;
+    };
+    struct table {
+        std::string name;
+        thread_counts counts[MAX_THREADS];
+    };
+
+    template <typename Row>
+    static table& table_of() {
+        static table* t = add_table(typeid(Row));
+        return *t;
+    }
+
+    static table* add_table(const std::type_info& type) {
+        table* t = new table;
+        int status;
+        char* name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        t->name = status == 0 ? name : type.name();
+        free(name);
+        std::lock_guard<std::mutex> guard(tables_lock());
+        tables().push_back(t);
+        return t;
+    }
+
+    static std::vector<table*>& tables() {
+        static std::vector<table*> t;
+        return t;
+    }
+    static std::mutex& tables_lock() {
+        static std::mutex m;
+        return m;
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Where db_profiler writes the key conflict heatmap
+#ifndef STO_CONFLICT_MAP_FILE
+#define STO_CONFLICT_MAP_FILE "conflict_map.csv"
+#endif
+
+namespace bench {
+
+// Where an ordered index's conflicts land in its key space, for deciding
+// where partitioning, splitting or deferred updates would pay off. Commit
+// lock failures, read validation failures and phantoms (failed leaf node
+// version checks) are counted by key prefix: the first prefix_bytes
+// bytes of the key, or for a phantom, of the leaf's first key.
+//
+// Off until enable(), and then cheap: only failures are counted, and of
+// those every sample_period'th on a thread is recorded, with weight
+// sample_period, in that thread's sketch for the index. A sketch is a
+// Space-Saving top-K of prefixes, as in ConflictProfile: a prefix missing
+// from a full sketch takes over the entry with the smallest total, so a
+// listed total overstates the true one by at most its err. Only the
+// owning thread writes a sketch; heatmap() merges them at report time and
+// is approximate while threads run.
+//
+// Heatmap format (dump), one line per prefix in key order:
+//   index,prefix,lock,validation,phantom,err    (prefix in hex)
+class key_conflict_map {
+public:
+    enum kind { lock_failure = 0, validation_failure, phantom, nkinds };
+    static constexpr unsigned sketch_size = 64;
+
+    struct cell {
+        uint64_t prefix;
+        uint64_t count[nkinds];
+        uint64_t err;
+
+        uint64_t total() const {
+            return count[lock_failure] + count[validation_failure] + count[phantom];
+        }
+    };
+
+    template <typename Row>
+    static key_conflict_map* make() {
+        int status;
+        char* name = abi::__cxa_demangle(typeid(Row).name(), nullptr, nullptr, &status);
+        auto m = new key_conflict_map(status == 0 ? name : typeid(Row).name());
+        free(name);
+        return m;
+    }
+    ~key_conflict_map() {
+        std::lock_guard<std::mutex> guard(maps_lock());
+        auto& ms = maps();
+        ms.erase(std::remove(ms.begin(), ms.end(), this), ms.end());
+        for (auto& s : sketches_)
+            delete s.load(std::memory_order_relaxed);
+    }
+
+    // Starts recording, for every index
+    static void enable(unsigned prefix_bytes = 2, unsigned sample_period = 16) {
+        prefix_bytes_ = std::min(std::max(prefix_bytes, 1U), 8U);
+        sample_period_ = std::max(sample_period, 1U);
+        enabled_ = true;
+    }
+    static void disable() {
+        enabled_ = false;
+    }
+    static bool enabled() {
+        return enabled_;
+    }
+
+    // slice is the key's first 8 bytes in comparable (big-endian) form
+    void record(kind k, uint64_t slice) {
+        if (enabled_)
+            record_slow(k, slice);
+    }
+
+    const std::string& name() const {
+        return name_;
+    }
+    // Merged counts, in prefix order
+    std::vector<cell> heatmap() const {
+        std::vector<cell> out;
+        for (auto& sp : sketches_) {
+            const sketch* s = sp.load(std::memory_order_acquire);
+            if (!s)
+                continue;
+            for (unsigned i = 0; i != s->n; ++i) {
+                auto it = std::find_if(out.begin(), out.end(), [&](const cell& c) {
+                        return c.prefix == s->cells[i].prefix;
+                    });
+                if (it == out.end()) {
+                    out.push_back(s->cells[i]);
+                    continue;
+                }
+                for (int k = 0; k != nkinds; ++k)
+                    it->count[k] += s->cells[i].count[k];
+                it->err += s->cells[i].err;
+            }
+        }
+        std::sort(out.begin(), out.end(), [](const cell& a, const cell& b) {
+                return a.prefix < b.prefix;
+            });
+        return out;
+    }
+    void clear() {
+        for (auto& sp : sketches_)
+            if (sketch* s = sp.load(std::memory_order_acquire))
+                s->n = 0;
+    }
+
+    // Prints each index's hottest n prefixes, in key order, with a bar
+    // scaled to the hottest
+    static void report(std::ostream& out, unsigned n = 16) {
+        std::lock_guard<std::mutex> guard(maps_lock());
+        for (auto m : maps()) {
+            auto cells = m->heatmap();
+            if (cells.empty())
+                continue;
+            if (cells.size() > n) {
+                std::nth_element(cells.begin(), cells.begin() + n, cells.end(), [](const cell& a, const cell& b) {
+                        return a.total() > b.total();
+                    });
+                cells.resize(n);
+                std::sort(cells.begin(), cells.end(), [](const cell& a, const cell& b) {
+                        return a.prefix < b.prefix;
+                    });
+            }
+            uint64_t hottest = 0;
+            for (auto& c : cells)
+                hottest = std::max(hottest, c.total());
+            out << "Key conflicts in " << m->name_ << ": prefix, lock/validation/phantom (overcount bound)\n";
+            for (auto& c : cells) {
+                out << "  " << format_prefix(c.prefix) << "  " << c.count[lock_failure] << '/'
+                    << c.count[validation_failure] << '/' << c.count[phantom] << " (" << c.err << ") "
+                    << std::string(hottest ? (c.total() * 40 + hottest - 1) / hottest : 0, '#') << '\n';
+            }
+        }
+        out << std::flush;
+    }
+
+    static void dump(std::ostream& out) {
+        std::lock_guard<std::mutex> guard(maps_lock());
+        out << "index,prefix,lock,validation,phantom,err\n";
+        for (auto m : maps())
+            for (auto& c : m->heatmap())
+                out << '"' << m->name_ << "\"," << format_prefix(c.prefix) << ',' << c.count[lock_failure]
+                    << ',' << c.count[validation_failure] << ',' << c.count[phantom] << ',' << c.err << '\n';
+    }
+    static bool dump(const char* filename) {
+        std::ofstream out(filename);
+        dump(out);
+        return bool(out);
+    }
+
+    // Whether any index recorded anything
+    static bool recorded() {
+        std::lock_guard<std::mutex> guard(maps_lock());
+        return !maps().empty();
+    }
+
+private:
+    struct sketch {
+        cell cells[sketch_size];
+        unsigned n = 0;
+        unsigned skip = 0;
+    };
+
+    std::string name_;
+    std::atomic<bool> registered_;
+    std::atomic<sketch*> sketches_[MAX_THREADS];
+
+    static inline bool enabled_ = false;
+    static inline unsigned prefix_bytes_ = 2;
+    static inline unsigned sample_period_ = 16;
+
+    explicit key_conflict_map(std::string name)
+        : name_(std::move(name)), registered_(false) {
+        for (auto& s : sketches_)
+            s.store(nullptr, std::memory_order_relaxed);
+    }
+
+    void record_slow(kind k, uint64_t slice) {
+        sketch* s = sketches_[TThread::id()].load(std::memory_order_relaxed);
+        if (unlikely(!s)) {
+            s = new sketch;
+            s->skip = sample_period_ - 1;
+            sketches_[TThread::id()].store(s, std::memory_order_release);
+            if (!registered_.exchange(true)) {
+                std::lock_guard<std::mutex> guard(maps_lock());
+                maps().push_back(this);
+            }
+        }
+        if (++s->skip < sample_period_)
+            return;
+        s->skip = 0;
+        uint64_t prefix = prefix_bytes_ == 8 ? slice : slice >> (64 - 8 * prefix_bytes_);
+        unsigned min = 0;
+        for (unsigned i = 0; i != s->n; ++i) {
+            if (s->cells[i].prefix == prefix) {
+                s->cells[i].count[k] += sample_period_;
+                return;
+            }
+            if (s->cells[i].total() < s->cells[min].total())
+                min = i;
+        }
+        cell* c;
+        uint64_t carried = 0;
+        if (s->n != sketch_size)
+            c = &s->cells[s->n++];
+        else {
+            // the newcomer may have had up to the evicted total
+            c = &s->cells[min];
+            carried = c->total();
+        }
+        *c = cell{prefix, {0, 0, 0}, carried};
+        c->count[k] = carried + sample_period_;
+    }
+
+    static std::string format_prefix(uint64_t prefix) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%0*llx", int(2 * prefix_bytes_), (unsigned long long) prefix);
+        return buf;
+    }
+
+    static std::vector<key_conflict_map*>& maps() {
+        static std::vector<key_conflict_map*> m;
+        return m;
+    }
+    static std::mutex& maps_lock() {
+        static std::mutex m;
+        return m;
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "compiler.hh"
+
+namespace bench {
+
+// Deterministic batch execution, as in Calvin, for workloads where every
+// concurrency control scheme collapses under contention (dbid "det").
+//
+// Each of the engine's threads generates batch_size transactions per
+// batch; a batch's transactions are ordered by (thread, position), so the
+// order depends only on what was generated. Every transaction declares
+// its lock set up front. Locks are granted through per-key FIFO queues in
+// batch order, shared for reads and exclusive for writes. The queues are
+// built in parallel, each thread taking the keys that hash to it. A
+// transaction runs once it holds all its locks, so conflicting
+// transactions run in batch order and nothing aborts or validates. A
+// thread runs the transactions it generated, so the drivers' per-runner
+// state (input generators, order id leases) stays with one thread; the
+// first transaction of a batch not yet run is always runnable, so the
+// threads never deadlock.
+
+// The lock set a transaction declares before it runs
+class det_lockset {
+public:
+    void clear() {
+        locks_.clear();
+    }
+    void read(uint64_t key) {
+        locks_.push_back({key, false, nullptr});
+    }
+    void write(uint64_t key) {
+        locks_.push_back({key, true, nullptr});
+    }
+    size_t size() const {
+        return locks_.size();
+    }
+
+private:
+    struct det_queue;
+    struct entry {
+        uint64_t key;
+        bool write;
+        det_queue* queue;
+    };
+    std::vector<entry> locks_;
+
+    // Sorts by key and merges a key's locks, keeping a write
+    void normalize() {
+        std::sort(locks_.begin(), locks_.end(), [] (const entry& a, const entry& b) {
+                return a.key < b.key || (a.key == b.key && a.write > b.write);
+            });
+        locks_.erase(std::unique(locks_.begin(), locks_.end(), [] (const entry& a, const entry& b) {
+                return a.key == b.key;
+            }), locks_.end());
+    }
+
+    template <typename Txn> friend class det_engine;
+};
+
+// One key's lock queue: the transactions (by batch position) that lock
+// it, in batch order. [head, granted_end) hold the lock: one writer or a
+// run of readers. During execution only the holders touch a queue, and
+// the last of them to release grants the next group.
+struct det_lockset::det_queue {
+    struct waiter {
+        uint32_t slot;
+        bool write;
+    };
+    std::vector<waiter> waiters;
+    uint32_t granted_end = 0;
+    std::atomic<uint32_t> active{0};
+
+    // Appends slot; returns true if it holds the lock from the start
+    bool enqueue(uint32_t slot, bool write) {
+        bool granted = granted_end == waiters.size()
+            && (waiters.empty() || (!write && !waiters.back().write));
+        waiters.push_back({slot, write});
+        if (granted) {
+            ++granted_end;
+            active.store(active.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        return granted;
+    }
+};
+
+template <typename Txn>
+class det_engine {
+public:
+    static constexpr size_t default_batch_size = 64;
+
+    det_engine(int nthreads, size_t batch_size = default_batch_size)
+        : nthreads_(nthreads), batch_size_(batch_size),
+          slots_(new slot[size_t(nthreads) * batch_size]),
+          queues_(new queue_map[nthreads]), ready_(new ready_list[nthreads]),
+          arrived_(0), generation_(0), stop_(false) {
+    }
+    det_engine(const det_engine&) = delete;
+    det_engine& operator=(const det_engine&) = delete;
+
+    // Called by each of the engine's threads, tid in [0, nthreads). Runs
+    // batches until stop(), checked between batches, returns true. Each
+    // batch, gen(txn, locks) fills in this thread's batch_size
+    // transactions and their lock sets, then exec(txn) runs each of them
+    // once it holds its locks. Returns the number of transactions this
+    // thread ran.
+    template <typename Gen, typename Exec, typename Stop>
+    uint64_t run(int tid, Gen gen, Exec exec, Stop stop) {
+        uint64_t nrun = 0;
+        const uint32_t first = tid * batch_size_;
+        const uint32_t nslots = nthreads_ * batch_size_;
+        while (true) {
+            for (uint32_t s = first; s != first + batch_size_; ++s) {
+                slots_[s].locks.clear();
+                gen(slots_[s].txn, slots_[s].locks);
+                slots_[s].locks.normalize();
+                // one more for the start of execution, below
+                slots_[s].pending.store(1, std::memory_order_relaxed);
+            }
+            barrier([] {});
+
+            // queue this thread's keys, in batch order
+            queue_map& queues = queues_[tid];
+            queues.clear();
+            for (uint32_t s = 0; s != nslots; ++s)
+                for (auto& l : slots_[s].locks.locks_)
+                    if (owner(l.key) == tid) {
+                        l.queue = &queues[l.key];
+                        if (!l.queue->enqueue(s, l.write))
+                            slots_[s].pending.fetch_add(1, std::memory_order_relaxed);
+                    }
+            barrier([] {});
+
+            for (uint32_t s = first; s != first + batch_size_; ++s)
+                grant(s);
+            for (uint32_t left = batch_size_; left; --left) {
+                uint32_t s = ready_[tid].pop();
+                exec(slots_[s].txn);
+                release(slots_[s]);
+                ++nrun;
+            }
+            barrier([&] { stop_ = stop(); });
+            if (stop_)
+                return nrun;
+        }
+    }
+
+private:
+    typedef det_lockset::det_queue det_queue;
+    typedef std::unordered_map<uint64_t, det_queue> queue_map;
+
+    struct slot {
+        Txn txn;
+        det_lockset locks;
+        std::atomic<uint32_t> pending{0};
+    };
+
+    // A thread's runnable transactions
+    struct alignas(64) ready_list {
+        std::mutex mu;
+        std::vector<uint32_t> slots;
+
+        void push(uint32_t s) {
+            std::lock_guard<std::mutex> lk(mu);
+            slots.push_back(s);
+        }
+        uint32_t pop() {
+            for (unsigned spins = 0; ; ++spins) {
+                {
+                    std::lock_guard<std::mutex> lk(mu);
+                    if (!slots.empty()) {
+                        uint32_t s = slots.back();
+                        slots.pop_back();
+                        return s;
+                    }
+                }
+                if (spins < 64)
+                    relax_fence();
+                else
+                    std::this_thread::yield();
+            }
+        }
+    };
+
+    int nthreads_;
+    uint32_t batch_size_;
+    std::unique_ptr<slot[]> slots_;
+    std::unique_ptr<queue_map[]> queues_;
+    std::unique_ptr<ready_list[]> ready_;
+    alignas(64) std::atomic<int> arrived_;
+    std::atomic<uint64_t> generation_;
+    bool stop_;
+
+    int owner(uint64_t key) const {
+        return int(((key * 0x9E3779B97F4A7C15ULL) >> 32) % uint64_t(nthreads_));
+    }
+
+    // Waits for every thread; the last to arrive calls f() first
+    template <typename F>
+    void barrier(F f) {
+        uint64_t gen = generation_.load(std::memory_order_acquire);
+        if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == nthreads_) {
+            f();
+            arrived_.store(0, std::memory_order_relaxed);
+            generation_.store(gen + 1, std::memory_order_release);
+            return;
+        }
+        for (unsigned spins = 0; generation_.load(std::memory_order_acquire) == gen; ++spins) {
+            if (spins < 1024)
+                relax_fence();
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void release(slot& sl) {
+        for (auto& l : sl.locks.locks_) {
+            det_queue& q = *l.queue;
+            if (q.active.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                grant_next(q);
+        }
+    }
+
+    // Grants the next writer, or run of readers, in q
+    void grant_next(det_queue& q) {
+        uint32_t head = q.granted_end, end = head;
+        if (head == q.waiters.size())
+            return;
+        ++end;
+        if (!q.waiters[head].write)
+            while (end != q.waiters.size() && !q.waiters[end].write)
+                ++end;
+        q.granted_end = end;
+        q.active.store(end - head, std::memory_order_release);
+        for (uint32_t i = head; i != end; ++i)
+            grant(q.waiters[i].slot);
+    }
+
+    void grant(uint32_t s) {
+        if (slots_[s].pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            ready_[s / batch_size_].push(s);
+    }
+};
+
+} // namespace bench
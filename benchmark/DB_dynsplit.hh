@@ -0,0 +1,305 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Row accesses each thread samples between repartitioning attempts
+#ifndef STO_DYNSPLIT_INTERVAL
+#define STO_DYNSPLIT_INTERVAL 16384
+#endif
+
+namespace bench {
+
+struct column_range {
+    size_t offset;
+    size_t size;
+};
+
+// Columns of a row type split at runtime, in NamedColumn order. Specialize
+// with a static constexpr std::array<column_range, N> columns, e.g.
+//   { DYNSPLIT_COLUMN(row, a), DYNSPLIT_COLUMN(row, b) }
+template <typename V>
+struct DynamicSplitColumns;
+
+#define DYNSPLIT_COLUMN(V, member) ::bench::column_range{offsetof(V, member), sizeof(V::member)}
+
+// Split 0 of a row split at runtime: the layout its data splits follow
+struct dynamic_layout_tag {
+    uint8_t layout = 0;
+};
+
+// Runtime vertical partitioning of row type V into Cells data splits, for
+// mvcc_ordered_index (see DynamicSplitParams in DB_index.hh). Every data
+// split holds a whole copy of the row but owns, and is written for, only
+// the columns its row's layout gives it. Layouts are published here and
+// never change once published; each row records its own in split 0.
+//
+// A row keeps its layout until it is next written: a write to a row whose
+// layout is not the current one rewrites every split, which migrates it
+// in one version. Every access reads split 0, so a write racing with a
+// migration of its row fails validation.
+//
+// The current layout follows observed contention. Accesses sample the
+// columns they write, and validation failures on a data split are charged
+// to the columns it owns. A split whose conflict rate exceeds
+// conflict_threshold gives its most written column a split of its own,
+// and an isolated column whose conflicts fall below a quarter of that
+// returns to split 1, the home of cold columns.
+template <typename V, size_t Cells = 3>
+class dynamic_split {
+public:
+    static constexpr size_t num_cells = Cells;
+    static constexpr size_t num_splits = Cells + 1;
+    static constexpr size_t num_columns = DynamicSplitColumns<V>::columns.size();
+    static constexpr size_t max_layouts = 256;
+    static constexpr uint64_t interval = STO_DYNSPLIT_INTERVAL;
+    static constexpr double conflict_threshold = 0.001;
+    static_assert(Cells >= 1 && Cells <= 255, "bad number of data splits");
+
+    // Data split (0-based, not counting the tag) of each column
+    typedef std::array<uint8_t, num_columns> layout_type;
+
+    static dynamic_split& instance() {
+        static dynamic_split s;
+        return s;
+    }
+
+    uint8_t current() const {
+        return current_.load(std::memory_order_acquire);
+    }
+    const layout_type& layout(uint8_t id) const {
+        return layouts_[id];
+    }
+    size_t num_layouts() const {
+        return nlayouts_.load(std::memory_order_acquire);
+    }
+
+    // Split holding column col in layout id
+    int split_of(uint8_t id, int col) const {
+        return 1 + layouts_[id][col];
+    }
+
+    // Split accesses of a row in layout id: split 0 is always read, and a
+    // write to a row in a stale layout updates every split
+    template <typename AccessT, typename Accesses>
+    std::array<AccessT, num_splits> split_accesses(uint8_t id, const Accesses& accesses) {
+        std::array<uint8_t, num_splits> a{};
+        a[0] = 1;
+        uint64_t written = 0;
+        for (auto& ca : accesses) {
+            auto bits = static_cast<uint8_t>(ca.access);
+            a[split_of(id, ca.col_id)] |= bits;
+            if (bits & 2)
+                written |= uint64_t(1) << ca.col_id;
+        }
+        if (written && id != current())
+            a.fill(3);
+        sample(written);
+
+        std::array<AccessT, num_splits> result;
+        for (size_t i = 0; i != num_splits; ++i)
+            result[i] = static_cast<AccessT>(a[i]);
+        return result;
+    }
+
+    // A validation failure on split of a row in layout id
+    void record_conflict(uint8_t id, int split) {
+        if (split == 0)
+            return;
+        auto& c = counts_[TThread::id()];
+        for (size_t col = 0; col != num_columns; ++col)
+            if (split_of(id, col) == split)
+                bump(c.conflicts[col]);
+    }
+
+    // Copies the columns of out that splits holds; splits[0] must be set
+    void merge(V* out, const std::array<void*, num_splits>& splits) const {
+        uint8_t id = static_cast<const dynamic_layout_tag*>(splits[0])->layout;
+        for (size_t col = 0; col != num_columns; ++col)
+            if (auto in = splits[split_of(id, col)])
+                copy_column(out, static_cast<const V*>(in), col);
+    }
+
+    template <typename T>
+    static const T& column(const std::array<void*, num_splits>& splits, int col) {
+        uint8_t id = static_cast<const dynamic_layout_tag*>(splits[0])->layout;
+        auto row = static_cast<const char*>(splits[instance().split_of(id, col)]);
+        return *reinterpret_cast<const T*>(row + DynamicSplitColumns<V>::columns[col].offset);
+    }
+
+    // Pieces of DynamicSplitParams
+    template <size_t... I>
+    static auto split_types(std::index_sequence<I...>)
+        -> std::tuple<dynamic_layout_tag, std::tuple_element_t<0, std::tuple<V, decltype(I)>>...>;
+    using split_type_list = decltype(split_types(std::make_index_sequence<Cells>()));
+    static constexpr auto split_builders() {
+        return builders(std::make_index_sequence<Cells>());
+    }
+    static constexpr auto split_mergers() {
+        return mergers(std::make_index_sequence<Cells>());
+    }
+
+    // Publishes layout l, returning false if the layout table is full
+    bool publish(const layout_type& l) {
+        size_t n = nlayouts_.load(std::memory_order_relaxed);
+        if (l == layouts_[current()])
+            return true;
+        if (n == max_layouts)
+            return false;
+        layouts_[n] = l;
+        nlayouts_.store(n + 1, std::memory_order_release);
+        current_.store(uint8_t(n), std::memory_order_release);
+        return true;
+    }
+
+    // The layout the policy picks from the counts since the last call
+    layout_type propose() {
+        std::array<uint64_t, num_columns> writes{}, conflicts{};
+        uint64_t accesses = 0;
+        for (auto& c : counts_) {
+            accesses += c.accesses.load(std::memory_order_relaxed);
+            for (size_t col = 0; col != num_columns; ++col) {
+                writes[col] += c.writes[col].load(std::memory_order_relaxed);
+                conflicts[col] += c.conflicts[col].load(std::memory_order_relaxed);
+            }
+        }
+        uint64_t da = accesses - last_.accesses;
+        std::array<double, num_columns> rate;
+        std::array<uint64_t, num_columns> dw;
+        for (size_t col = 0; col != num_columns; ++col) {
+            dw[col] = writes[col] - last_.writes[col];
+            rate[col] = da ? double(conflicts[col] - last_.conflicts[col]) / da : 0;
+        }
+        last_.accesses = accesses;
+        last_.writes = writes;
+        last_.conflicts = conflicts;
+
+        layout_type l = layouts_[current()];
+        std::array<int, Cells> members{};
+        for (auto cell : l)
+            ++members[cell];
+        // cooled isolated columns go home
+        for (size_t col = 0; col != num_columns; ++col)
+            if (l[col] != 0 && members[l[col]] == 1 && rate[col] < conflict_threshold / 4) {
+                --members[l[col]];
+                ++members[0];
+                l[col] = 0;
+            }
+        // hot shared splits shed their most written column
+        for (size_t cell = 0; cell != Cells; ++cell) {
+            if (members[cell] < 2)
+                continue;
+            int hottest = -1;
+            for (size_t col = 0; col != num_columns; ++col)
+                if (l[col] == cell && rate[col] >= conflict_threshold && dw[col]
+                    && (hottest < 0 || dw[col] > dw[hottest]))
+                    hottest = col;
+            if (hottest < 0)
+                continue;
+            size_t free = 0;
+            while (free != Cells && members[free] != 0)
+                ++free;
+            if (free == Cells)
+                break;
+            --members[cell];
+            ++members[free];
+            l[hottest] = uint8_t(free);
+        }
+        return l;
+    }
+
+private:
+    struct alignas(64) thread_counts {
+        std::atomic<uint64_t> accesses;
+        std::array<std::atomic<uint64_t>, num_columns> writes;
+        std::array<std::atomic<uint64_t>, num_columns> conflicts;
+    };
+    struct totals {
+        uint64_t accesses = 0;
+        std::array<uint64_t, num_columns> writes{};
+        std::array<uint64_t, num_columns> conflicts{};
+    };
+
+    dynamic_split()
+        : nlayouts_(1), current_(0), adapting_(false) {
+        layouts_[0].fill(0);
+        for (auto& c : counts_) {
+            c.accesses.store(0, std::memory_order_relaxed);
+            for (size_t col = 0; col != num_columns; ++col) {
+                c.writes[col].store(0, std::memory_order_relaxed);
+                c.conflicts[col].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Counters have one writer each, so they skip the atomic increment
+    static void bump(std::atomic<uint64_t>& x) {
+        x.store(x.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void sample(uint64_t written) {
+        auto& c = counts_[TThread::id()];
+        for (size_t col = 0; written; ++col, written >>= 1)
+            if (written & 1)
+                bump(c.writes[col]);
+        bump(c.accesses);
+        if (c.accesses.load(std::memory_order_relaxed) % interval == 0
+            && !adapting_.exchange(true, std::memory_order_acquire)) {
+            publish(propose());
+            adapting_.store(false, std::memory_order_release);
+        }
+    }
+
+    static dynamic_layout_tag build_tag(const V&) {
+        return dynamic_layout_tag{instance().current()};
+    }
+    template <size_t I>
+    static V build_copy(const V& in) {
+        return in;
+    }
+    // Split mergers run in split order, so the tag's merger leaves the
+    // layout for the data splits' mergers on this thread
+    static void merge_tag(V*, const dynamic_layout_tag* in) {
+        merge_layout_ = in->layout;
+    }
+    template <size_t I>
+    static void merge_split(V* out, const V* in) {
+        auto& d = instance();
+        for (size_t col = 0; col != num_columns; ++col)
+            if (d.split_of(merge_layout_, col) == int(I))
+                copy_column(out, in, col);
+    }
+    template <size_t... I>
+    static constexpr auto builders(std::index_sequence<I...>) {
+        return std::make_tuple(&build_tag, &build_copy<I>...);
+    }
+    template <size_t... I>
+    static constexpr auto mergers(std::index_sequence<I...>) {
+        return std::make_tuple(&merge_tag, &merge_split<I + 1>...);
+    }
+
+    static void copy_column(V* out, const V* in, size_t col) {
+        auto& r = DynamicSplitColumns<V>::columns[col];
+        memcpy(reinterpret_cast<char*>(out) + r.offset,
+               reinterpret_cast<const char*>(in) + r.offset, r.size);
+    }
+
+    layout_type layouts_[max_layouts];
+    std::atomic<size_t> nlayouts_;
+    std::atomic<uint8_t> current_;
+    std::atomic<bool> adapting_;
+    totals last_;
+    thread_counts counts_[MAX_THREADS];
+
+    static inline thread_local uint8_t merge_layout_;
+};
+
+} // namespace bench
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "DB_checkpoint.hh"
+
+namespace bench {
+
+// A loaded database frozen into a directory, so that later runs thaw it
+// instead of loading it again. The image is a checkpoint of every table,
+// one part per table, plus <dir>/image, which holds a tag naming the
+// database and whatever parameters shape its rows; an image frozen under
+// another tag is never thawed. Rows are stored as their byte images, so
+// the files hold no pointers. Thawing maps each file and bulk loads its
+// rows straight from the mapping with nthreads threads.
+class db_image {
+public:
+    db_image(std::string dir, std::string tag, int nthreads)
+        : dir_(std::move(dir)), tag_(std::move(tag)),
+          freezer_(dir_, nthreads, 0), thawer_(nthreads), freeze_seconds_(0) {
+    }
+
+    template <typename Index>
+    void add_table(const std::string& name, Index& index) {
+        if constexpr (has_checkpoint_range<Index>::value)
+            freezer_.add_table(name, index, std::vector<typename Index::key_type>());
+        else
+            freezer_.add_table(name, index, size_t(1));
+        thawer_.add_table(name, 0, index);
+    }
+
+    // dir holds a complete image frozen under this tag
+    bool exists() const {
+        std::ifstream in(dir_ + "/image");
+        std::string tag;
+        return std::getline(in, tag) && tag == tag_;
+    }
+
+    // Writes every table; call while no transaction runs. The tag is
+    // written last, so an interrupted freeze leaves no image.
+    bool freeze() {
+        auto start = std::chrono::steady_clock::now();
+        std::string path = dir_ + "/image";
+        ::unlink(path.c_str());
+        freezer_.start();
+        if (!freezer_.join())
+            return false;
+        {
+            std::ofstream out(path + ".tmp");
+            if (!(out << tag_ << "\n" << freezer_.rows() << " rows\n"))
+                return false;
+        }
+        bool ok = ::rename((path + ".tmp").c_str(), path.c_str()) == 0;
+        freeze_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return ok;
+    }
+    // Loads the image into the tables, which must be empty; false if
+    // there's no image for this tag or a file doesn't fit its table
+    bool thaw() {
+        return exists() && thawer_.run(dir_, std::string());
+    }
+
+    uint64_t frozen_rows() const {
+        return freezer_.rows();
+    }
+    double freeze_seconds() const {
+        return freeze_seconds_;
+    }
+    uint64_t thawed_rows() const {
+        return thawer_.statistics().checkpoint_rows;
+    }
+    double thaw_seconds() const {
+        return thawer_.statistics().checkpoint_seconds;
+    }
+
+private:
+    struct ignore_row {
+        template <typename K, typename V>
+        void operator()(const K&, const V&) const {
+        }
+    };
+    template <typename T, typename = void>
+    struct has_checkpoint_range : std::false_type {};
+    template <typename T>
+    struct has_checkpoint_range<T, std::void_t<decltype(std::declval<T&>().checkpoint_range(
+            lcdf::Str(), lcdf::Str(), TransactionTid::type(), ignore_row()))>> : std::true_type {};
+
+    std::string dir_;
+    std::string tag_;
+    checkpointer freezer_;
+    recoverer thawer_;
+    double freeze_seconds_;
+};
+
+} // namespace bench
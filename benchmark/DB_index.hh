@@ -13,16 +13,35 @@
 #include "masstree_scan.hh"
 #include "string.hh"
 
+#include <thread>
 #include <vector>
 #include "DB_structs.hh"
+#include "DB_column_profile.hh"
+#include "DB_dynsplit.hh"
+#include "DB_projection.hh"
 #include "VersionSelector.hh"
 #include "MVCC.hh"
+#include "ObjectPool.hh"
 
 #include "TBox.hh"
 #include "TMvBox.hh"
 
+// Keep index inserts in the transaction until commit (DeferInserts)
+#ifndef STO_DEFER_INSERTS
+#define STO_DEFER_INSERTS 0
+#endif
+
 namespace bench {
 
+// Lock and check failures of transactions that set Transaction::special_txp
+struct txp_special {
+    static inline const unsigned lock_abort1  = txp_registry::add("special_lock_abort1");
+    static inline const unsigned lock_abort2  = txp_registry::add("special_lock_abort2");
+    static inline const unsigned lock_abort3  = txp_registry::add("special_lock_abort3");
+    static inline const unsigned check_abort1 = txp_registry::add("special_check_abort1");
+    static inline const unsigned check_abort2 = txp_registry::add("special_check_abort2");
+};
+
 class version_adapter {
 public:
     template <bool Adaptive>
@@ -125,23 +144,51 @@ public:
     }
 
     bool lock(TransItem& item, Transaction& txn) override {
+        if (combined(item)) {
+            for (unsigned n = 0; !combiner.try_enter(item, vers); ++n) {
+                if (n == (1U << STO_SPIN_BOUND_WRITE))
+                    return false;
+                relax_fence();
+            }
+            return true;
+        }
         return txn.try_lock(item, vers);
     }
     bool check(TransItem& item, Transaction& txn) override {
         return vers.cp_check_version(txn, item);
     }
     void install(TransItem& item, Transaction& txn) override {
-        value += item.write_value<int_type>();
-        txn.set_version_unlock(vers, item);
+        if (combined(item))
+            combiner.post(commutators::Commutator<int_type>(item.write_value<int_type>()),
+                          vers.cp_commit_tid(txn));
+        else {
+            value += item.write_value<int_type>();
+            txn.set_version_unlock(vers, item);
+        }
+    }
+    bool unlock_after_install(TransItem& item) const override {
+        return combined(item);
     }
     void unlock(TransItem& item) override {
-        vers.cp_unlock(item);
+        if (combined(item))
+            combiner.leave(item, vers, value);
+        else
+            vers.cp_unlock(item);
     }
 
 private:
+    // Blind increments share the row lock through a combining slot when
+    // the version is a plain OCC version
+    static constexpr bool can_combine = std::is_same<version_type, TVersion>::value
+                                        || std::is_same<version_type, TNonopaqueVersion>::value;
+
+    static bool combined(const TransItem& item) {
+        return can_combine && !item.has_read();
+    }
 
     version_type vers;
     int_type value;
+    commutators::DeltaCombiner<version_type> combiner;
 };
 
 template <typename DBParams>
@@ -159,6 +206,47 @@ inline access_t operator&(const access_t& lhs, const access_t& rhs) {
     return static_cast<access_t>(static_cast<int8_t>(lhs) & static_cast<int8_t>(rhs));
 }
 
+// A column access fixed at compile time. The split select functions take a
+// list of them, static_accesses<...>{}, in place of an initializer_list of
+// column accesses: the compiler then works out the cells they touch, so the
+// hot path has no per-call translation loop.
+template <auto Column, access_t Access = access_t::read>
+struct col_access {
+    static constexpr auto column = Column;
+    static constexpr access_t access = Access;
+};
+
+// (An empty list is rejected where its cells are worked out, not here:
+// overload resolution instantiates static_accesses<> for every braced
+// initializer_list argument.)
+template <typename... ColAccesses>
+struct static_accesses {};
+
+// Body of the indexes' select_row<Cols...>(key): selects the row at key for
+// reading Cols only, and copies them out if it is found
+template <typename V, typename V::NamedColumn... Cols, typename Index, typename Key>
+std::tuple<bool, bool, projection<V, Cols...>>
+select_projection(Index& index, const Key& key) {
+    auto [success, found, rid, accessor] = index.select_split_row(
+            key, static_accesses<col_access<Cols, access_t::read>...>());
+    (void)rid;
+    if (!success || !found)
+        return {success, found, projection<V, Cols...>()};
+    return {true, true, projection<V, Cols...>(accessor)};
+}
+
+// Folds comm into the commutator row_item already buffers, in place.
+// Returns false if there is none, or the two don't combine, so the caller
+// registers comm some other way.
+template <typename Comm>
+bool fold_commute(TransProxy& row_item, const Comm& comm) {
+    if constexpr (commutators::is_foldable<Comm>::value) {
+        if (row_item.has_commute())
+            return row_item.template write_value<Comm>().fold(comm);
+    }
+    return false;
+}
+
 template <typename IndexType>
 class split_version_helpers {
 public:
@@ -182,12 +270,14 @@ public:
     // I: internode and ttnv bits (or bucket bit in the unordered case)
     // cell id: valid range 0-16383 (0x3fff)
     // cell id 0 identifies the row item
+    // with a cell bitmap, cell id 1 identifies the item of all other cells
 
     class item_key_t {
         typedef uintptr_t type;
         static constexpr unsigned shift = 16u;
         static constexpr type cell_mask = type(0xfffc);
         static constexpr int row_item_cell_num = 0x0;
+        static constexpr int cells_item_cell_num = 0x1;
         type key_;
 
     public:
@@ -199,6 +289,9 @@ public:
         static item_key_t row_item_key(internal_elem *e) {
             return item_key_t(e, row_item_cell_num);
         }
+        static item_key_t cells_item_key(internal_elem *e) {
+            return item_key_t(e, cells_item_cell_num);
+        }
 
         internal_elem *internal_elem_ptr() const {
             return reinterpret_cast<internal_elem *>(key_ >> shift);
@@ -219,6 +312,9 @@ public:
         constexpr size_t num_versions = T::num_versions;
         std::array<access_t, num_versions> cell_accesses { access_t::none };
         std::fill(cell_accesses.begin(), cell_accesses.end(), access_t::none);
+#if STO_PROFILE_COLUMNS
+        column_profile::record<value_type>(accesses);
+#endif
 
         for (auto it = accesses.begin(); it != accesses.end(); ++it) {
             int cell_id = T::map(it->col_id);
@@ -228,12 +324,46 @@ public:
         return cell_accesses;
     }
 
+    // column_to_cell_accesses of a static access list, for constexpr use
+    template <typename T, typename... Accs>
+    constexpr static std::array<access_t, T::num_versions>
+    static_cell_accesses() {
+        static_assert(sizeof...(Accs) != 0, "empty access list");
+        std::array<access_t, T::num_versions> cell_accesses {};
+        constexpr int cols[] = {static_cast<int>(Accs::column)...};
+        constexpr access_t accs[] = {Accs::access...};
+        for (size_t i = 0; i != sizeof...(Accs); ++i) {
+            int cell_id = T::map(cols[i]);
+            cell_accesses[cell_id] = static_cast<access_t>(
+                    static_cast<uint8_t>(cell_accesses[cell_id]) | static_cast<uint8_t>(accs[i]));
+        }
+        return cell_accesses;
+    }
+
+    template <typename T, typename... Accs>
+    constexpr static std::array<access_t, T::num_splits>
+    mvcc_static_cell_accesses() {
+        static_assert(sizeof...(Accs) != 0, "empty access list");
+        std::array<access_t, T::num_splits> cell_accesses {};
+        constexpr int cols[] = {static_cast<int>(Accs::column)...};
+        constexpr access_t accs[] = {Accs::access...};
+        for (size_t i = 0; i != sizeof...(Accs); ++i) {
+            int cell_id = T::map(cols[i]);
+            cell_accesses[cell_id] = static_cast<access_t>(
+                    static_cast<uint8_t>(cell_accesses[cell_id]) | static_cast<uint8_t>(accs[i]));
+        }
+        return cell_accesses;
+    }
+
     template <typename T>
     constexpr static std::array<access_t, T::num_splits>
     mvcc_column_to_cell_accesses(std::initializer_list<column_access_t> accesses) {
         constexpr size_t num_splits = T::num_splits;
         std::array<access_t, num_splits> cell_accesses { access_t::none };
         std::fill(cell_accesses.begin(), cell_accesses.end(), access_t::none);
+#if STO_PROFILE_COLUMNS
+        column_profile::record<value_type>(accesses);
+#endif
 
         for (auto it = accesses.begin(); it != accesses.end(); ++it) {
             int cell_id = T::map(it->col_id);
@@ -249,9 +379,18 @@ public:
         bool any_has_write = false;
         std::array<TransItem*, T::num_versions> cell_items { nullptr };
         std::fill(cell_items.begin(), cell_items.end(), nullptr);
+        TransItem* cells_item = nullptr;
 
         for (size_t i = 0; i < T::num_versions; ++i) {
             if (cell_accesses[i] != access_t::none) {
+                if (T::cell_bitmap && i != 0) {
+                    if (!cells_item)
+                        cells_item = &Sto::item(tobj, item_key_t::cells_item_key(e)).item();
+                    if (IndexType::index_read_my_write && ((cell_versions::written(*cells_item) >> i) & 1))
+                        any_has_write = true;
+                    cell_items[i] = cells_item;
+                    continue;
+                }
                 auto item = Sto::item(tobj, item_key_t(e, i));
                 if (IndexType::index_read_my_write && !any_has_write && item.has_write())
                     any_has_write = true;
@@ -261,6 +400,25 @@ public:
         return { any_has_write, cell_items };
     }
 
+    // Read-only transactions: observe the versions of the read cells with
+    // Transaction::ro_observe instead of creating items
+    template <typename T>
+    static bool
+    ro_access_all(const std::array<access_t, T::num_versions>& cell_accesses, T& row_container) {
+        Transaction& txn = *Sto::transaction();
+        for (size_t i = 0; i < T::num_versions; ++i) {
+            assert((cell_accesses[i] & access_t::write) == access_t::none);
+            if ((cell_accesses[i] & access_t::read) != access_t::none) {
+                auto& vers = row_container.version_at(i);
+                auto observed = vers;
+                fence();
+                if (!txn.ro_observe(vers, observed))
+                    return false;
+            }
+        }
+        return true;
+    }
+
     // mvcc_*_loop() methods: Template meta-programs that iterates through all version "splits" at compile time.
     // Template parameters:
     // C: size of split (should be constant throughout the recursive instantiation)
@@ -268,16 +426,39 @@ public:
     // First: Type of the first split column
     // Rest...: Type(s) of the rest of the split columns (could be empty)
     // Return value: success (false == not found)
+    // The select loop clears ok if the transaction must abort.
     template <int C, int I, typename First, typename... Rest>
     static bool
     mvcc_select_loop(const std::array<access_t, C>& cell_accesses,
                   std::array<void*, C>& value_ptrs,
-                  TObject* tobj, internal_elem* e) {
+                  TObject* tobj, internal_elem* e, bool& ok) {
         auto mvobj = e->template chain_at<I>();
-        if (cell_accesses[I] != access_t::none) {
+        if (cell_accesses[I] != access_t::none && Sto::readonly()) {
+            // read-only: the snapshot at read_tid is stable, so no items
+            assert((cell_accesses[I] & access_t::write) == access_t::none);
+            auto h = mvobj->find(Sto::read_tid());
+            if (h->status_is(COMMITTED_DELETED))
+                return false;
+            else if (!h->status_is(DELETED))
+                value_ptrs[I] = h->vp();
+        } else if (cell_accesses[I] != access_t::none) {
             auto item = Sto::item(tobj, item_key_t(e, I));
             if ((cell_accesses[I] & access_t::write) != access_t::none) {
-                item.add_write();
+#if MVCC_WRITE_INTENT
+                // read-modify-write: a concurrent updater would fail cp_lock
+                // anyway. Blind and commutative writes don't conflict.
+                if ((cell_accesses[I] & access_t::read) != access_t::none
+                    && !item.has_write() && !mvobj->try_intend_write()) {
+                    TXP_INCREMENT(txp_mvcc_intent_aborts);
+                    Sto::transaction()->mark_abort_because(&item.item(), "write intent");
+                    ok = false;
+                    return false;
+                }
+#endif
+                // keep a commutator an earlier update buffered, for the
+                // next update_row() to fold into
+                if (!item.has_commute())
+                    item.add_write();
             }
             if ((cell_accesses[I] & access_t::read) != access_t::none) {
                 auto h = mvobj->find(Sto::read_tid());
@@ -294,12 +475,12 @@ public:
                 }
             }
         }
-        return mvcc_select_loop<C, I + 1, Rest...>(cell_accesses, value_ptrs, tobj, e);
+        return mvcc_select_loop<C, I + 1, Rest...>(cell_accesses, value_ptrs, tobj, e, ok);
     }
 
     template <int C, int I>
     static bool
-    mvcc_select_loop(const std::array<access_t, C>&, std::array<void*, C>&, TObject*, internal_elem*) {
+    mvcc_select_loop(const std::array<access_t, C>&, std::array<void*, C>&, TObject*, internal_elem*, bool&) {
         static_assert(I == C, "Index invalid.");
         return true;
     }
@@ -316,6 +497,17 @@ public:
 
         auto h = mvobj->find(Sto::read_tid());
 
+        if (Sto::readonly()) {
+            if (I == 0 && h->status_is(DELETED)) {
+                count = false;
+                return;
+            }
+            if (cell_accesses[I] != access_t::none)
+                split_values[I] = h->vp();
+            mvcc_scan_loop<C, I + 1, Rest...>(ret, count, cell_accesses, tobj, e, split_values);
+            return;
+        }
+
         /*
         if (I == 0) {
             // skip invalid (inserted but yet committed) and/or deleted values, but do not abort
@@ -389,6 +581,45 @@ public:
     mvcc_nontrans_get_loop(value_type*, internal_elem*) {
         static_assert(I == C, "Index invalid.");
     }
+    // Row as of tid; false if it didn't exist then
+    template <int C, int I, typename P, typename First, typename... Rest>
+    static bool
+    mvcc_as_of_get_loop(value_type* whole_value_out, internal_elem* e, TransactionTid::type tid) {
+        auto h = e->template chain_at<I>()->find(tid);
+        if (I == 0 && h->status_is(DELETED))
+            return false;
+        std::get<I>(P::split_merger)(whole_value_out, h->vp());
+        return mvcc_as_of_get_loop<C, I+1, P, Rest...>(whole_value_out, e, tid);
+    }
+    template <int C, int I, typename P>
+    static bool
+    mvcc_as_of_get_loop(value_type*, internal_elem*, TransactionTid::type) {
+        static_assert(I == C, "Index invalid.");
+        return true;
+    }
+    // Same, but leaves each split's version in place. Splits other than 0
+    // (which decides whether the row exists) are only looked up if their
+    // bit is set in splits; the others are left null.
+    template <int C, int I, typename First, typename... Rest>
+    static bool
+    mvcc_as_of_splits_loop(std::array<void*, C>& split_values, internal_elem* e, TransactionTid::type tid,
+                           uint64_t splits) {
+        if (I != 0 && !(splits & (uint64_t(1) << I))) {
+            split_values[I] = nullptr;
+        } else {
+            auto h = e->template chain_at<I>()->find(tid);
+            if (I == 0 && h->status_is(DELETED))
+                return false;
+            split_values[I] = h->vp();
+        }
+        return mvcc_as_of_splits_loop<C, I+1, Rest...>(split_values, e, tid, splits);
+    }
+    template <int C, int I>
+    static bool
+    mvcc_as_of_splits_loop(std::array<void*, C>&, internal_elem*, TransactionTid::type, uint64_t) {
+        static_assert(I == C, "Index invalid.");
+        return true;
+    }
 
     // Static looping for TObject::lock
     template <int C, int I, typename First, typename... Rest>
@@ -478,7 +709,9 @@ public:
     static void mvcc_update_loop(IndexType* idx, internal_elem* e, const value_comm_type& comm) {
         auto[found, item] = Sto::find_write_item(idx, item_key_t(e, I));
         if (found) {
-            item.add_commute(static_cast<commutators::Commutator<First>>(comm));
+            auto cell_comm = static_cast<commutators::Commutator<First>>(comm);
+            if (!fold_commute(item, cell_comm))
+                item.add_commute(cell_comm);
         }
         mvcc_update_loop<C, I+1, Rest...>(idx, e, comm);
     }
@@ -494,11 +727,13 @@ public:
     struct MvSplitAccessAll<P, std::tuple<SplitTypes...>> {
         static std::array<void*, P::num_splits> run_select(
                 bool* found,
+                bool* ok,
                 const std::array<access_t, P::num_splits>& cell_accesses,
                 TObject* tobj,
                 internal_elem* e) {
             std::array<void*, P::num_splits> value_ptrs = { nullptr };
-            *found = mvcc_select_loop<P::num_splits, 0, SplitTypes...>(cell_accesses, value_ptrs, tobj, e);
+            *ok = true;
+            *found = mvcc_select_loop<P::num_splits, 0, SplitTypes...>(cell_accesses, value_ptrs, tobj, e, *ok);
             return value_ptrs;
         }
         template <typename Callback>
@@ -527,6 +762,14 @@ public:
         static void run_nontrans_get(value_type* whole_value_out, internal_elem* e) {
             mvcc_nontrans_get_loop<P::num_splits, 0, P, SplitTypes...>(whole_value_out, e);
         }
+        static bool run_get_as_of(value_type* whole_value_out, internal_elem* e, TransactionTid::type tid) {
+            return mvcc_as_of_get_loop<P::num_splits, 0, P, SplitTypes...>(whole_value_out, e, tid);
+        }
+        static bool run_get_splits_as_of(std::array<void*, P::num_splits>& split_values,
+                                         internal_elem* e, TransactionTid::type tid,
+                                         uint64_t splits = ~uint64_t(0)) {
+            return mvcc_as_of_splits_loop<P::num_splits, 0, SplitTypes...>(split_values, e, tid, splits);
+        }
         static bool run_lock(int cell_id, Transaction& txn, TransItem& item, IndexType* idx, internal_elem* e) {
             return mvcc_lock_loop<P::num_splits, 0, SplitTypes...>(cell_id, txn, item, idx, e);
         }
@@ -577,6 +820,34 @@ struct SplitParams {
     static constexpr size_t num_splits = std::tuple_size<layout_type>::value;
 };
 
+// Split parameters of a row type whose layout changes at runtime, for
+// mvcc_ordered_index: split 0 is the row's layout tag and splits 1..Cells
+// are whole copies of the row (see DB_dynsplit.hh). Derive SplitParams<V>
+// from it, and give SplitRecordAccessor<V> columns through
+// dynamic_type::column().
+template <typename V, size_t Cells = 3>
+struct DynamicSplitParams {
+    using dynamic_type = dynamic_split<V, Cells>;
+
+    using split_type_list = typename dynamic_type::split_type_list;
+    static constexpr auto split_builder = dynamic_type::split_builders();
+    static constexpr auto split_merger = dynamic_type::split_mergers();
+    // Under the current layout; rows in other layouts map through
+    // dynamic_type::split_accesses
+    static constexpr auto map = [](int col_n) -> int {
+        auto& d = dynamic_type::instance();
+        return d.split_of(d.current(), col_n);
+    };
+
+    using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+    static constexpr size_t num_splits = std::tuple_size<layout_type>::value;
+};
+
+template <typename P, typename = void>
+struct is_dynamic_split : std::false_type {};
+template <typename P>
+struct is_dynamic_split<P, std::void_t<typename P::dynamic_type>> : std::true_type {};
+
 // Helper method, turning a user-provided row into split row representation (array of pointers)
 // allocated in the transactional scratch space.
 template <size_t C, size_t I, typename RowType>
@@ -609,6 +880,43 @@ class UniRecordAccessor;
 template <typename V>
 class SplitRecordAccessor;
 
+// Calls load(first, last) on nthreads consecutive slices of [begin, end),
+// each on a thread of its own when there is more than one
+template <typename Iter, typename F>
+void for_each_load_range(Iter begin, Iter end, int nthreads, F load) {
+    size_t n = end - begin;
+    if (nthreads <= 1 || n < size_t(nthreads)) {
+        load(begin, end);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(load, begin + n * t / nthreads, begin + n * (t + 1) / nthreads);
+    for (auto& th : threads)
+        th.join();
+}
+
+// Copies a committed row of a single-version index outside any
+// transaction, for fuzzy checkpoints: the copy is taken between two equal
+// reads of the row version while no writer holds it. Returns false for a
+// row that is inserted but uncommitted, or deleted.
+template <typename Elem, typename V>
+bool fuzzy_copy_row(Elem* e, V& out) {
+    while (true) {
+        auto v0 = e->version();
+        fence();
+        if (!v0.is_locked()) {
+            if ((v0.value() & TransactionTid::user_bit) || e->deleted)
+                return false;
+            out = e->row_container.row;
+            fence();
+            if (v0 == e->version())
+                return true;
+        }
+        relax_fence();
+    }
+}
+
 template <typename K, typename V, typename DBParams>
 class index_common {
 public:
@@ -660,7 +968,26 @@ public:
         return (item.flags() & row_cell_bit) != 0;
     }
 
-    struct MvInternalElement {
+    // Commutative updates of split rows. The row item carries the commutator
+    // and the cells it changes are locked, and their versions bumped, through
+    // their own items. Unless the row item also reads or writes cell 0, the
+    // row version is left alone, so readers of the untouched cells still
+    // validate. The first of the row's items to install applies the update.
+    static constexpr TransItem::flags_type comm_applied_bit = TransItem::user0_bit << 4u;
+
+    static bool is_cell_commute(const TransItem& item) {
+        return item.has_commute() && !item.has_read()
+            && !(item.flags() & (insert_bit | delete_bit | row_update_bit | row_cell_bit));
+    }
+    template <typename Elem>
+    static void apply_commute(TransItem& row_item, Elem* e) {
+        if (!(row_item.flags() & comm_applied_bit)) {
+            e->row_container.install_cell(row_item.write_value<comm_type>());
+            row_item.add_flags(comm_applied_bit);
+        }
+    }
+
+    struct MvInternalElement : pool_allocated<MvInternalElement> {
         typedef typename SplitParams<value_type>::layout_type split_layout_type;
         using object0_type = std::tuple_element_t<0, split_layout_type>;
 
@@ -727,7 +1054,7 @@ bool mvcc_chain_operations<K, V, DBParams>::lock_impl_per_chain(
         auto hprev = item.read_value<history_type*>();
         if (Sto::commit_tid() < hprev->rtid()) {
             TransProxy(txn, item).add_write(nullptr);
-            TXP_ACCOUNT(txp_tpcc_lock_abort1, txn.special_txp);
+            TXP_DYN_ACCOUNT(txp_special::lock_abort1, txn.special_txp);
             return false;
         }
     }
@@ -742,7 +1069,12 @@ bool mvcc_chain_operations<K, V, DBParams>::lock_impl_per_chain(
             h = chain->new_history(Sto::commit_tid(), nullptr);
             h->status_delete();
         } else {
-            h = chain->new_history(Sto::commit_tid(), wval);
+            if (item.has_read()) {
+                h = chain->new_sparse_history(Sto::commit_tid(), item.read_value<history_type*>(), wval);
+            }
+            if (!h) {
+                h = chain->new_history(Sto::commit_tid(), wval);
+            }
         }
     }
     assert(h);
@@ -750,10 +1082,10 @@ bool mvcc_chain_operations<K, V, DBParams>::lock_impl_per_chain(
     if (!result && !h->status_is(MvStatus::ABORTED)) {
         chain->delete_history(h);
         TransProxy(txn, item).add_mvhistory(nullptr);
-        TXP_ACCOUNT(txp_tpcc_lock_abort2, txn.special_txp);
+        TXP_DYN_ACCOUNT(txp_special::lock_abort2, txn.special_txp);
     } else {
         TransProxy(txn, item).add_mvhistory(h);
-        TXP_ACCOUNT(txp_tpcc_lock_abort3, txn.special_txp && !result);
+        TXP_DYN_ACCOUNT(txp_special::lock_abort3, txn.special_txp && !result);
     }
     return result;
 }
@@ -766,7 +1098,7 @@ bool mvcc_chain_operations<K, V, DBParams>::check_impl_per_chain(TransItem &item
 
     auto h = item.template read_value<history_type*>();
     auto result = chain->cp_check(Sto::read_tid(), h);
-    TXP_ACCOUNT(txp_tpcc_check_abort2, txn.special_txp && !result);
+    TXP_DYN_ACCOUNT(txp_special::check_abort2, txn.special_txp && !result);
     return result;
 }
 
@@ -787,8 +1119,10 @@ template <typename K, typename V, typename DBParams>
 template <typename TSplit>
 void mvcc_chain_operations<K, V, DBParams>::cleanup_impl_per_chain(TransItem &item, bool committed,
                                                                    MvObject<TSplit> *chain) {
-    (void) chain; /* XXX do not need this parameter */
     using history_type = typename MvObject<TSplit>::history_type;
+#if MVCC_WRITE_INTENT
+    chain->clear_write_intent();
+#endif
     if (!committed) {
         if (item.has_mvhistory()) {
             auto h = item.template write_value<history_type*>();
@@ -809,3 +1143,4 @@ void mvcc_chain_operations<K, V, DBParams>::cleanup_impl_per_chain(TransItem &it
 
 #include "DB_uindex.hh"
 #include "DB_oindex.hh"
+#include "DB_aindex.hh"
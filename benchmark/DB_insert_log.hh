@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Entries kept by an ordered index's insert log
+#ifndef STO_INSERT_LOG_SIZE
+#define STO_INSERT_LOG_SIZE 4096
+#endif
+
+namespace bench {
+
+// Ring of the keys recently inserted into an index, for validating range
+// predicates without tracking leaves. A reader takes position() before it
+// looks at the index, and at commit check()s every key appended since:
+// an insert that lands in the range after the position was taken shows up
+// there, and one that landed before it was visible to the reader. Inserts
+// are appended once they are in the index, whether or not they commit, so
+// an aborted insert can fail a check that needn't have failed.
+//
+// Appends are lock-free: an inserter claims a sequence number and fills
+// its slot under a seqlock. A check that finds a slot still being written
+// waits for it briefly, then gives up; one that finds the ring wrapped
+// past its position fails. Both failures only cost aborts.
+//
+// An index with filter predicates keeps a second log, of the keys its
+// committing transactions update, checked the same way.
+template <typename K, uint64_t N = STO_INSERT_LOG_SIZE>
+class insert_log {
+public:
+    static_assert((N & (N - 1)) == 0, "log size must be a power of two");
+    static constexpr int spin_limit = 1024;
+
+    insert_log()
+        : head_(0) {
+        for (uint64_t q = 0; q != N; ++q)
+            entries_[q].seq.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t position() const {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    void append(const K& key) {
+        uint64_t p = head_.fetch_add(1);
+        entry& e = entries_[p & (N - 1)];
+        e.seq.store(2 * p + 1, std::memory_order_relaxed);
+        fence();
+        memcpy(e.key, &key, sizeof(K));
+        e.thread = TThread::id();
+        e.seq.store(2 * p + 2, std::memory_order_release);
+    }
+
+    // Returns false if a key appended at or after position since, by a
+    // thread other than the caller, may satisfy conflicts(key).
+    template <typename F>
+    bool check(uint64_t since, F conflicts) const {
+        uint64_t head = position();
+        if (head - since > N)
+            return false;
+        int me = TThread::id();
+        for (uint64_t q = since; q != head; ++q) {
+            const entry& e = entries_[q & (N - 1)];
+            uint64_t seq;
+            for (int spin = 0; (seq = e.seq.load(std::memory_order_acquire)) != 2 * q + 2; ++spin) {
+                if (seq > 2 * q + 2 || spin == spin_limit)
+                    return false;
+                relax_fence();
+            }
+            alignas(K) char key[sizeof(K)];
+            memcpy(key, e.key, sizeof(K));
+            int thread = e.thread;
+            acquire_fence();
+            if (e.seq.load(std::memory_order_relaxed) != seq)
+                return false;
+            if (thread != me && conflicts(*reinterpret_cast<const K*>(key)))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    struct entry {
+        std::atomic<uint64_t> seq;
+        int thread;
+        alignas(K) char key[sizeof(K)];
+    };
+
+    alignas(64) std::atomic<uint64_t> head_;
+    alignas(64) entry entries_[N];
+};
+
+} // namespace bench
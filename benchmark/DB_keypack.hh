@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace bench {
+
+// Order-preserving encoding of a composite key of unsigned integer fields,
+// the i-th field taking Bits[i] bits. Fields are laid out most significant
+// first in a bit string stored as big-endian 8-byte slices, so comparing
+// the bytes orders keys as comparing the field tuples would. A key whose
+// fields fit in 64 bits is a single masstree ikey slice, without the layers
+// or suffixes a struct of bswapped uint64_t fields needs.
+//
+// A value too wide for its field saturates to the field's maximum. This
+// keeps scan bounds like std::numeric_limits<uint64_t>::max() ordered after
+// every stored key; stored values must fit.
+template <unsigned... Bits>
+class packed_key {
+public:
+    static constexpr size_t num_fields = sizeof...(Bits);
+    static constexpr unsigned total_bits = (0 + ... + Bits);
+    static constexpr size_t num_slices = (total_bits + 63) / 64;
+    static_assert(num_fields != 0, "empty key");
+    static_assert(((Bits != 0 && Bits <= 64) && ...), "field widths must be 1-64 bits");
+
+    packed_key() : slices_() {}
+
+    template <typename... Ts>
+    explicit packed_key(Ts... fields) : slices_() {
+        static_assert(sizeof...(Ts) == num_fields, "one value per field");
+        uint64_t values[] = {static_cast<uint64_t>(fields)...};
+        uint64_t s[num_slices] = {};
+        for (size_t i = 0, pos = 0; i != num_fields; pos += widths[i], ++i)
+            put(s, pos, widths[i], saturate(values[i], widths[i]));
+        for (size_t i = 0; i != num_slices; ++i)
+            slices_[i] = __builtin_bswap64(s[i]);
+    }
+
+    template <size_t I>
+    uint64_t get() const {
+        static_assert(I < num_fields, "no such field");
+        size_t pos = 0;
+        for (size_t i = 0; i != I; ++i)
+            pos += widths[i];
+        uint64_t v = 0;
+        for (unsigned bits = widths[I]; bits; ) {
+            size_t slice = pos / 64;
+            unsigned off = pos % 64, n = bits < 64 - off ? bits : 64 - off;
+            uint64_t word = __builtin_bswap64(slices_[slice]);
+            v = (v << (n % 64)) | ((word >> (64 - off - n)) & mask(n));
+            pos += n;
+            bits -= n;
+        }
+        return v;
+    }
+
+    bool operator==(const packed_key& other) const {
+        return !memcmp(slices_, other.slices_, sizeof(slices_));
+    }
+
+private:
+    static constexpr unsigned widths[] = {Bits...};
+
+    static constexpr uint64_t mask(unsigned bits) {
+        return bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+    }
+    static uint64_t saturate(uint64_t v, unsigned bits) {
+        return v > mask(bits) ? mask(bits) : v;
+    }
+    // Writes the bits-wide value v at bit pos, counted from the top of s[0]
+    static void put(uint64_t* s, size_t pos, unsigned bits, uint64_t v) {
+        while (bits) {
+            size_t slice = pos / 64;
+            unsigned off = pos % 64, n = bits < 64 - off ? bits : 64 - off;
+            s[slice] |= ((v >> (bits - n)) & mask(n)) << (64 - off - n);
+            pos += n;
+            bits -= n;
+        }
+    }
+
+    uint64_t slices_[num_slices];
+};
+
+} // namespace bench
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "compiler.hh"
+#include "TThread.hh"
+#include "TxnLog.hh"
+
+// Record the latency of every benchmark transaction, retries included
+#ifndef STO_PROFILE_LATENCY
+#define STO_PROFILE_LATENCY 0
+#endif
+
+// Where db_profiler writes the latency histograms as JSON
+#ifndef STO_PROFILE_LATENCY_FILE
+#define STO_PROFILE_LATENCY_FILE "latency.json"
+#endif
+
+namespace bench {
+
+// Log-bucketed histogram of tick counts, in the style of HdrHistogram.
+// Values below 2^sub_bits get a bucket each; every power-of-two range above
+// is split into 2^sub_bits buckets, so a bucket's width is at most 1/2^sub_bits
+// of the values it holds.
+class latency_histogram {
+public:
+    static constexpr unsigned sub_bits = 5;
+    static constexpr uint64_t sub_count = uint64_t(1) << sub_bits;
+    static constexpr unsigned num_buckets = (64 - sub_bits + 1) * sub_count;
+
+    latency_histogram()
+        : counts_(), count_(0), sum_(0), min_(~uint64_t(0)), max_(0) {}
+
+    void record(uint64_t ticks) {
+        ++counts_[bucket_of(ticks)];
+        ++count_;
+        sum_ += ticks;
+        min_ = std::min(min_, ticks);
+        max_ = std::max(max_, ticks);
+    }
+
+    void merge(const latency_histogram& other) {
+        for (unsigned b = 0; b != num_buckets; ++b)
+            counts_[b] += other.counts_[b];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t count() const {
+        return count_;
+    }
+    uint64_t min() const {
+        return count_ ? min_ : 0;
+    }
+    uint64_t max() const {
+        return max_;
+    }
+    uint64_t bucket_count(unsigned b) const {
+        return counts_[b];
+    }
+    double mean() const {
+        return count_ ? double(sum_) / count_ : 0;
+    }
+
+    // Highest value of the bucket holding the q-th quantile (0 < q <= 1)
+    uint64_t quantile(double q) const {
+        if (!count_)
+            return 0;
+        uint64_t rank = std::max(uint64_t(1), uint64_t(q * count_ + 0.5));
+        uint64_t seen = 0;
+        for (unsigned b = 0; b != num_buckets; ++b) {
+            seen += counts_[b];
+            if (seen >= rank)
+                return std::min(bucket_high(b), max_);
+        }
+        return max_;
+    }
+
+    static unsigned bucket_of(uint64_t v) {
+        if (v < sub_count)
+            return v;
+        unsigned shift = 63 - __builtin_clzll(v) - sub_bits;
+        return (shift + 1) * sub_count + ((v >> shift) - sub_count);
+    }
+    static uint64_t bucket_high(unsigned b) {
+        if (b < sub_count)
+            return b;
+        unsigned shift = b / sub_count - 1;
+        uint64_t low = (b % sub_count + sub_count) << shift;
+        return low + ((uint64_t(1) << shift) - 1);
+    }
+
+private:
+    uint64_t counts_[num_buckets];
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+// Per-thread latency histograms for each transaction type of a benchmark.
+// A driver names its types once, before its runners start; each runner
+// records into histograms only it writes, so recording takes no locks or
+// atomics, and the report merges them after the runners join.
+//
+// While TxnLog is logging, each timed transaction also records its latency
+// to durability, from the same start to the TxnLog::on_durable callback,
+// in a second set of histograms.
+class latency_profile {
+public:
+    // Times one transaction as its caller sees it, from the first attempt
+    // to the commit, retries included
+    class timer {
+    public:
+        timer()
+            : start_(STO_PROFILE_LATENCY || TxnLog::enabled() ? read_tsc() : 0) {}
+        void record(int type) {
+            if (STO_PROFILE_LATENCY)
+                latency_profile::record(type, read_tsc() - start_);
+            latency_profile::record_durable_from(type, start_);
+        }
+
+    private:
+        uint64_t start_;
+    };
+
+    static void name_types(std::vector<std::string> names) {
+        types() = std::move(names);
+        for (auto& t : threads())
+            t.reset();
+    }
+
+    static void record(int type, uint64_t ticks) {
+        assert(type >= 0 && size_t(type) < types().size());
+        thread_hists().hists[type].record(ticks);
+    }
+    static void record_durable(int type, uint64_t ticks) {
+        assert(type >= 0 && size_t(type) < types().size());
+        thread_hists().durable[type].record(ticks);
+    }
+    // If logging, records the latency from start until the calling thread's
+    // last commit is durable
+    static void record_durable_from(int type, uint64_t start) {
+        if (TxnLog::enabled())
+            TxnLog::on_durable([type, start] {
+                    record_durable(type, read_tsc() - start);
+                });
+    }
+
+    // Whether anything was recorded since the types were named
+    static bool recorded() {
+        for (auto& t : threads())
+            if (t)
+                return true;
+        return false;
+    }
+
+    // Commit latencies, or with durable, latencies to durability
+    static std::vector<latency_histogram> merged(bool durable = false) {
+        std::vector<latency_histogram> all(types().size());
+        for (auto& t : threads())
+            if (t)
+                for (size_t i = 0; i != all.size(); ++i)
+                    all[i].merge(durable ? t->durable[i] : t->hists[i]);
+        return all;
+    }
+
+    // Percentiles per type, in microseconds
+    static void report(std::ostream& out, double ticks_per_us) {
+        report(out, "Latency (us):", merged(), ticks_per_us);
+        auto durable = merged(true);
+        if (std::any_of(durable.begin(), durable.end(), [](const latency_histogram& h) { return h.count(); }))
+            report(out, "Latency to durability (us):", durable, ticks_per_us);
+    }
+
+    // One object per type: summary statistics in microseconds, and the
+    // nonempty buckets as [highest tick count, count] pairs. Latencies to
+    // durability, if any, follow in "durable_types".
+    static void dump(std::ostream& out, double ticks_per_us) {
+        out << "{\"ticks_per_us\": " << ticks_per_us << ", \"types\": ";
+        dump(out, merged(), ticks_per_us);
+        auto durable = merged(true);
+        if (std::any_of(durable.begin(), durable.end(), [](const latency_histogram& h) { return h.count(); })) {
+            out << ",\n\"durable_types\": ";
+            dump(out, durable, ticks_per_us);
+        }
+        out << "}" << std::endl;
+    }
+
+    static bool dump(const char* filename, double ticks_per_us) {
+        std::ofstream out(filename);
+        dump(out, ticks_per_us);
+        return bool(out);
+    }
+
+private:
+    struct thread_histograms {
+        std::vector<latency_histogram> hists;
+        std::vector<latency_histogram> durable;
+        explicit thread_histograms(size_t ntypes)
+            : hists(ntypes), durable(ntypes) {}
+    };
+
+    static std::vector<std::string>& types() {
+        static std::vector<std::string> t;
+        return t;
+    }
+    static std::vector<std::unique_ptr<thread_histograms>>& threads() {
+        static std::vector<std::unique_ptr<thread_histograms>> t(MAX_THREADS);
+        return t;
+    }
+    static thread_histograms& thread_hists() {
+        auto& t = threads()[TThread::id()];
+        if (!t)
+            t.reset(new thread_histograms(types().size()));
+        return *t;
+    }
+
+    static void report(std::ostream& out, const char* title, const std::vector<latency_histogram>& all,
+                       double ticks_per_us) {
+        auto flags = out.flags();
+        auto precision = out.precision();
+        out << title << std::endl;
+        for (size_t i = 0; i != all.size(); ++i) {
+            auto& h = all[i];
+            if (!h.count())
+                continue;
+            out << "  " << std::left << std::setw(20) << types()[i] << std::right << std::fixed
+                << std::setprecision(1) << " n=" << h.count()
+                << " mean=" << h.mean() / ticks_per_us
+                << " p50=" << h.quantile(0.5) / ticks_per_us
+                << " p99=" << h.quantile(0.99) / ticks_per_us
+                << " p99.9=" << h.quantile(0.999) / ticks_per_us
+                << " max=" << h.max() / ticks_per_us << std::endl;
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    static void dump(std::ostream& out, const std::vector<latency_histogram>& all, double ticks_per_us) {
+        out << "{";
+        for (size_t i = 0; i != all.size(); ++i) {
+            auto& h = all[i];
+            out << (i ? ",\n  \"" : "\n  \"") << types()[i] << "\": {\"count\": " << h.count()
+                << ", \"mean\": " << h.mean() / ticks_per_us
+                << ", \"min\": " << h.min() / ticks_per_us
+                << ", \"p50\": " << h.quantile(0.5) / ticks_per_us
+                << ", \"p90\": " << h.quantile(0.9) / ticks_per_us
+                << ", \"p99\": " << h.quantile(0.99) / ticks_per_us
+                << ", \"p99.9\": " << h.quantile(0.999) / ticks_per_us
+                << ", \"max\": " << h.max() / ticks_per_us
+                << ", \"buckets\": [";
+            const char* sep = "";
+            for (unsigned b = 0; b != latency_histogram::num_buckets; ++b)
+                if (uint64_t n = h.bucket_count(b)) {
+                    out << sep << '[' << latency_histogram::bucket_high(b) << ", " << n << ']';
+                    sep = ", ";
+                }
+            out << "]}";
+        }
+        out << "\n}";
+    }
+};
+
+// Open-loop load settings: arrivals per second at each runner (0 for a
+// closed loop), at a fixed rate or as a Poisson process
+struct arrival_params {
+    double rate = 0;
+    bool poisson = false;
+};
+
+// Open-loop load for one runner: transactions arrive at a fixed rate, or as
+// a Poisson process, whether or not the runner keeps up. A runner that falls
+// behind runs the late arrivals back to back, and their latency counts from
+// the scheduled arrival, so the queueing that a closed loop hides
+// (coordinated omission) shows in the percentiles. With rate 0 the runner
+// is closed-loop, and latency counts from each transaction's start.
+class arrival_schedule {
+public:
+    arrival_schedule(const arrival_params& params, double ticks_per_sec, uint64_t start, uint64_t seed)
+        : mean_gap_(params.rate > 0 ? ticks_per_sec / params.rate : 0), poisson_(params.poisson),
+          next_(double(start)), arrival_(start), rng_(seed), gap_(1.0) {}
+
+    bool open_loop() const {
+        return mean_gap_ != 0;
+    }
+
+    // Waits for the next arrival. Returns false, without waiting, if it
+    // falls at or after deadline.
+    bool wait(uint64_t deadline) {
+        if (!open_loop()) {
+            arrival_ = read_tsc();
+            return arrival_ < deadline;
+        }
+        arrival_ = uint64_t(next_);
+        if (arrival_ >= deadline)
+            return false;
+        next_ += poisson_ ? mean_gap_ * gap_(rng_) : mean_gap_;
+        while (read_tsc() < arrival_)
+            relax_fence();
+        return true;
+    }
+
+    // Scheduled time of the arrival last waited for
+    uint64_t arrival() const {
+        return arrival_;
+    }
+
+    // Records the latency of that arrival's transaction
+    void record(int type) const {
+        if (STO_PROFILE_LATENCY || open_loop())
+            latency_profile::record(type, read_tsc() - arrival_);
+        latency_profile::record_durable_from(type, arrival_);
+    }
+
+private:
+    double mean_gap_;
+    bool poisson_;
+    double next_;
+    uint64_t arrival_;
+    std::mt19937_64 rng_;
+    std::exponential_distribution<double> gap_;
+};
+
+} // namespace bench
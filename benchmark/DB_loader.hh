@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "PlatformFeatures.hh"
+
+namespace bench {
+
+// Runs a benchmark's prepopulation as nparts partitions on up to nthreads
+// loader threads. A loader is pinned with set_affinity to the runner that
+// will own the partition it loads, so that the pages it first touches are
+// on that runner's node. load(part) returns the number of rows it loaded,
+// and run() reports the load throughput.
+class db_loader {
+public:
+    db_loader(const char* name, int nparts, int nthreads, std::function<int(int)> runner_of)
+        : name_(name), nparts_(nparts), nthreads_(std::max(std::min(nthreads, nparts), 1)),
+          runner_of_(std::move(runner_of)) {}
+
+    template <typename F>
+    uint64_t run(F load) {
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<uint64_t> rows(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t != nthreads_; ++t)
+            threads.emplace_back([&, t] {
+                    uint64_t n = 0;
+                    for (int part = t; part < nparts_; part += nthreads_) {
+                        set_affinity(runner_of_(part));
+                        n += load(part);
+                    }
+                    rows.fetch_add(n, std::memory_order_relaxed);
+                });
+        for (auto& th : threads)
+            th.join();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report(rows.load(), secs);
+        return rows.load();
+    }
+
+private:
+    void report(uint64_t rows, double secs) const {
+        auto flags = std::cout.flags();
+        auto precision = std::cout.precision();
+        std::cout << "Loaded " << name_ << ": ";
+        if (rows)
+            std::cout << rows << " rows, ";
+        std::cout << nparts_ << " partitions on " << nthreads_ << " threads in "
+                  << std::fixed << std::setprecision(2) << secs << " s";
+        if (rows && secs > 0)
+            std::cout << " (" << std::setprecision(0) << rows / secs << " rows/s)";
+        std::cout << std::endl;
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+    }
+
+    const char* name_;
+    int nparts_;
+    int nthreads_;
+    std::function<int(int)> runner_of_;
+};
+
+} // namespace bench
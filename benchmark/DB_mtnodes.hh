@@ -0,0 +1,187 @@
+#pragma once
+
+#include <array>
+#include <cstdlib>
+#include <utility>
+
+#include "compiler.hh"
+#include "kvthread.hh"
+#include "MemStats.hh"
+#include "ObjectPool.hh"
+#include "Transaction.hh"
+
+// 1: ordered indexes take Masstree nodes from STO's per-thread pools and
+// free them through STO's epochs (see mt_threadinfo); 0: Masstree's own
+// threadinfo pools and limbo lists
+#ifndef STO_MASSTREE_POOL
+#define STO_MASSTREE_POOL 1
+#endif
+
+namespace bench {
+
+// object_pool<(c + 1) * Line>'s functions, by size class c
+template <size_t Line, size_t N>
+class mt_node_pools {
+public:
+    struct ops {
+        void* (*allocate)();
+        void (*release)(void*);
+    };
+
+    static const ops& at(size_t c) {
+        return ops_[c];
+    }
+
+private:
+    template <size_t... I>
+    static constexpr std::array<ops, N> make(std::index_sequence<I...>) {
+        return {{ops{&object_pool<(I + 1) * Line>::allocate,
+                     &object_pool<(I + 1) * Line>::release}...}};
+    }
+    static const std::array<ops, N> ops_;
+};
+
+template <size_t Line, size_t N>
+const std::array<typename mt_node_pools<Line, N>::ops, N> mt_node_pools<Line, N>::ops_
+    = mt_node_pools<Line, N>::make(std::make_index_sequence<N>());
+
+// Masstree threadinfo for the ordered indexes. Masstree allocates and
+// frees through the threadinfo type named by its table params; this one
+// forwards counters and fences to a Masstree threadinfo and keeps memory
+// on STO's side.
+//
+// Nodes come from object_pool, in cache-line size classes up to
+// max_pooled_size, which covers nodeparams<15,15> internodes and leaves
+// with their inline key suffixes. Splits during insert-heavy phases then
+// take nodes from the thread's own free list, refilled with the hugepage
+// arena from slabs on the thread's NUMA node, rather than from the
+// global allocator.
+//
+// Nodes, key suffixes and layer callbacks freed under RCU go to the
+// thread's TRcuSet, like every other index element, and are reclaimed
+// once no transaction can reach them. Masstree's limbo lists go unused,
+// and with them the rcu_start()/rcu_stop() calls around every
+// transaction: STO never advances Masstree's epoch, so nothing queued
+// there was freed anyway.
+//
+// One mt_threadinfo per thread serves every index.
+class mt_threadinfo {
+public:
+    typedef ::threadinfo base_type;
+    static constexpr size_t pool_line = 64;
+    static constexpr size_t pool_classes = 12;
+    static constexpr size_t max_pooled_size = pool_classes * pool_line;
+
+    struct mrcu_callback {
+        virtual ~mrcu_callback() {}
+        virtual void operator()(mt_threadinfo& ti) = 0;
+    };
+
+    // The calling thread's threadinfo, made on first call
+    static mt_threadinfo* make(int purpose, int index) {
+        if (!current_)
+            current_ = new mt_threadinfo(base_type::make(purpose, index));
+        return current_;
+    }
+
+    int purpose() const {
+        return base_->purpose();
+    }
+    int index() const {
+        return base_->index();
+    }
+
+    void mark(threadcounter ci) {
+        base_->mark(ci);
+    }
+    void mark(threadcounter ci, int64_t delta) {
+        base_->mark(ci, delta);
+    }
+    base_type::accounting_relax_fence_function accounting_relax_fence(threadcounter ci) {
+        return base_->accounting_relax_fence(ci);
+    }
+    base_type::stable_accounting_relax_fence_function stable_fence() {
+        return base_->stable_fence();
+    }
+    base_type::accounting_relax_fence_function lock_fence(threadcounter ci) {
+        return base_->lock_fence(ci);
+    }
+
+    // Key suffixes and layer callbacks
+    void* allocate(size_t sz, memtag, size_t* actual_size = nullptr) {
+        if (actual_size)
+            *actual_size = sz;
+        return ::malloc(sz);
+    }
+    void deallocate(void* p, size_t, memtag) {
+        ::free(p);
+    }
+    void deallocate_rcu(void* p, size_t, memtag) {
+        Transaction::rcu_free(p);
+    }
+
+    // Nodes
+    void* pool_allocate(size_t sz, memtag) {
+        size_t c = size_class(sz);
+        MemStats::account(mem_index, pool_size(c));
+        if (likely(c < pool_classes))
+            return pools::at(c).allocate();
+        return ::malloc(sz);
+    }
+    void pool_deallocate(void* p, size_t sz, memtag) {
+        size_t c = size_class(sz);
+        MemStats::account(mem_index, -int64_t(pool_size(c)));
+        if (likely(c < pool_classes))
+            pools::at(c).release(p);
+        else
+            ::free(p);
+    }
+    void pool_deallocate_rcu(void* p, size_t sz, memtag) {
+        size_t c = size_class(sz);
+        MemStats::account(mem_index, -int64_t(pool_size(c)));
+        if (likely(c < pool_classes))
+            Transaction::rcu_call(pools::at(c).release, p);
+        else
+            Transaction::rcu_free(p);
+    }
+
+    void rcu_register(mrcu_callback* cb) {
+        Transaction::rcu_call(run_callback, cb);
+    }
+    // Readers are covered by the epochs of the transactions they run in
+    void rcu_start() {
+    }
+    void rcu_stop() {
+    }
+    void rcu_quiesce() {
+    }
+
+private:
+    typedef mt_node_pools<pool_line, pool_classes> pools;
+
+    base_type* base_;
+
+    static inline thread_local mt_threadinfo* current_ = nullptr;
+
+    explicit mt_threadinfo(base_type* base)
+        : base_(base) {
+    }
+
+    static size_t size_class(size_t sz) {
+        return (sz + pool_line - 1) / pool_line - 1;
+    }
+    static size_t pool_size(size_t c) {
+        return (c + 1) * pool_line;
+    }
+    static void run_callback(void* x) {
+        (*static_cast<mrcu_callback*>(x))(*make(base_type::TI_PROCESS, TThread::id()));
+    }
+};
+
+#if STO_MASSTREE_POOL
+typedef mt_threadinfo index_threadinfo;
+#else
+typedef ::threadinfo index_threadinfo;
+#endif
+
+} // namespace bench
@@ -1,9 +1,112 @@
 #pragma once
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <optional>
+#include <thread>
+
 #include "DB_index.hh"
+#include "DB_conflict_map.hh"
+#include "DB_insert_log.hh"
+#include "DB_mtnodes.hh"
+#include "DB_pscan.hh"
+#include "TIntRange.hh"
 
 namespace bench {
-template <typename K, typename V, typename DBParams>
+
+// The leaf versions a transaction's lookups and scans saw, for phantom
+// protection in one item per index rather than an item per leaf. Used
+// with DBParams::NodeTrack outside TicToc (which tracks leaves with
+// timestamps of its own): long scans then add entries here instead of
+// growing the tset, and commit checks them in one loop that loads each
+// block's leaves before comparing their versions. Lives in transaction
+// scratch, in blocks of block_size entries.
+template <typename Node, typename Version>
+class leaf_version_set {
+public:
+    static constexpr unsigned block_size = 30;
+
+    static leaf_version_set* make() {
+        auto s = Sto::tx_alloc<leaf_version_set>();
+        s->head_ = s->tail_ = nullptr;
+        s->size_ = 0;
+        return s;
+    }
+
+    unsigned size() const {
+        return size_;
+    }
+
+    // Adds leaf n seen at version v; a repeat of the last entry is dropped
+    void add(Node* n, Version v) {
+        if (tail_ && tail_->n) {
+            unsigned i = tail_->n - 1;
+            if (tail_->nodes[i] == n && tail_->versions[i] == v)
+                return;
+        }
+        if (!tail_ || tail_->n == block_size) {
+            auto b = Sto::tx_alloc<block>();
+            b->next = nullptr;
+            b->n = 0;
+            (tail_ ? tail_->next : head_) = b;
+            tail_ = b;
+        }
+        tail_->nodes[tail_->n] = n;
+        tail_->versions[tail_->n] = v;
+        ++tail_->n;
+        ++size_;
+    }
+
+    // This transaction moved leaf n from version prev to next; false if
+    // it was seen at another version
+    bool update(Node* n, Version prev, Version next) {
+        for (block* b = head_; b; b = b->next)
+            for (unsigned i = 0; i != b->n; ++i)
+                if (b->nodes[i] == n) {
+                    if (b->versions[i] != prev)
+                        return false;
+                    b->versions[i] = next;
+                }
+        return true;
+    }
+
+    // The first leaf whose version_of(leaf) changed, or nullptr
+    template <typename F>
+    Node* check(F version_of) const {
+        for (const block* b = head_; b; b = b->next) {
+            for (unsigned i = 0; i != b->n; ++i)
+                ::prefetch(b->nodes[i]);
+            for (unsigned i = 0; i != b->n; ++i)
+                if (version_of(b->nodes[i]) != b->versions[i])
+                    return b->nodes[i];
+        }
+        return nullptr;
+    }
+
+private:
+    struct block {
+        block* next;
+        unsigned n;
+        Node* nodes[block_size];
+        Version versions[block_size];
+    };
+
+    block* head_;
+    block* tail_;
+    unsigned size_;
+};
+
+// With DeferInserts, on plain OCC tables without range phantoms,
+// insert_row leaves the tree alone: new rows wait in a per-thread sorted
+// overlay, which this transaction's selects, deletes and scans consult, and
+// enter the tree when lock() takes their row locks (as in
+// tree_ordered_index). An aborted insert then never touches the tree, so it
+// neither bumps leaf versions under other transactions' scans nor leaves
+// garbage to reclaim. A conflicting insert of the same key makes lock()
+// fail.
+template <typename K, typename V, typename DBParams,
+          bool DeferInserts = (STO_DEFER_INSERTS != 0)>
 class ordered_index : public TObject {
 public:
     typedef K key_type;
@@ -20,9 +123,17 @@ public:
     static constexpr TransItem::flags_type delete_bit = TransItem::user0_bit << 1u;
     static constexpr TransItem::flags_type row_update_bit = TransItem::user0_bit << 2u;
     static constexpr TransItem::flags_type row_cell_bit = TransItem::user0_bit << 3u;
+    static constexpr TransItem::flags_type comm_applied_bit = TransItem::user0_bit << 4u;
+    static constexpr TransItem::flags_type deferred_bit = TransItem::user0_bit << 5u;
     static constexpr uintptr_t internode_bit = 1;
     // TicToc node version bit
     static constexpr uintptr_t ttnv_bit = 1 << 1u;
+    // Range predicate items set both
+    static constexpr uintptr_t range_bits = internode_bit | ttnv_bit;
+    // Key of filtered range predicate items (range_scan_where)
+    static constexpr uintptr_t filter_key = range_bits | (1 << 2u);
+    // Key of the leaf_version_set item: the internode item of no node
+    static constexpr uintptr_t leaf_set_key = internode_bit;
 
     typedef typename value_type::NamedColumn NamedColumn;
     typedef IndexValueContainer<V, version_type> value_container_type;
@@ -30,8 +141,12 @@ public:
     static constexpr bool value_is_small = is_small<V>::value;
 
     static constexpr bool index_read_my_write = DBParams::RdMyWr;
+    // keys looked up together by select_split_rows
+    static constexpr size_t select_batch = 16;
+    static constexpr bool defer_inserts = DeferInserts && !DBParams::MVCC && !DBParams::TicToc
+        && !DBParams::Adaptive && !DBParams::TwoPhaseLock && !DBParams::Swiss;
 
-    struct internal_elem {
+    struct internal_elem : pool_allocated<internal_elem> {
         key_type key;
         value_container_type row_container;
         bool deleted;
@@ -54,7 +169,7 @@ public:
     struct table_params : public Masstree::nodeparams<15,15> {
         typedef internal_elem* value_type;
         typedef Masstree::value_print<value_type> value_print_type;
-        typedef threadinfo threadinfo_type;
+        typedef index_threadinfo threadinfo_type;
 
         static constexpr bool track_nodes = (DBParams::NodeTrack && DBParams::TicToc);
         typedef std::conditional_t<track_nodes, version_type, int> aux_tracker_type;
@@ -68,15 +183,27 @@ public:
 
     typedef typename table_type::node_type node_type;
     typedef typename unlocked_cursor_type::nodeversion_value_type nodeversion_value_type;
-
-    using column_access_t = typename split_version_helpers<ordered_index<K, V, DBParams>>::column_access_t;
-    using item_key_t = typename split_version_helpers<ordered_index<K, V, DBParams>>::item_key_t;
+    // Pending inserts, by key bytes
+    typedef std::array<uint8_t, sizeof(K)> pending_key_type;
+    typedef std::map<pending_key_type, internal_elem*> overlay_type;
+    // Leaves seen for phantom protection go in one leaf_version_set item
+    static constexpr bool leaf_set = DBParams::NodeTrack && !table_params::track_nodes;
+    typedef leaf_version_set<node_type, nodeversion_value_type> leaf_set_type;
+
+    using column_access_t = typename split_version_helpers<ordered_index<K, V, DBParams, DeferInserts>>::column_access_t;
+    using item_key_t = typename split_version_helpers<ordered_index<K, V, DBParams, DeferInserts>>::item_key_t;
     template <typename T>
     static constexpr auto column_to_cell_accesses
-        = split_version_helpers<ordered_index<K, V, DBParams>>::template column_to_cell_accesses<T>;
+        = split_version_helpers<ordered_index<K, V, DBParams, DeferInserts>>::template column_to_cell_accesses<T>;
+    template <typename T, typename... Accs>
+    static constexpr auto static_cell_accesses
+        = split_version_helpers<ordered_index<K, V, DBParams, DeferInserts>>::template static_cell_accesses<T, Accs...>;
     template <typename T>
     static constexpr auto extract_item_list
-        = split_version_helpers<ordered_index<K, V, DBParams>>::template extract_item_list<T>;
+        = split_version_helpers<ordered_index<K, V, DBParams, DeferInserts>>::template extract_item_list<T>;
+    template <typename T>
+    static constexpr auto ro_access_all
+        = split_version_helpers<ordered_index<K, V, DBParams, DeferInserts>>::template ro_access_all<T>;
 
     typedef std::tuple<bool, bool, uintptr_t, const value_type*> sel_return_type;
     typedef std::tuple<bool, bool>                               ins_return_type;
@@ -95,28 +222,85 @@ public:
 
     void table_init() {
         if (ti == nullptr)
-            ti = threadinfo::make(threadinfo::TI_MAIN, -1);
+            ti = table_params::threadinfo_type::make(threadinfo::TI_MAIN, -1);
         table_.initialize(*ti);
         key_gen_ = 0;
+        if (defer_inserts)
+            overlays_.resize(MAX_THREADS);
     }
 
     static void thread_init() {
         if (ti == nullptr)
-            ti = threadinfo::make(threadinfo::TI_PROCESS, TThread::id());
+            ti = table_params::threadinfo_type::make(threadinfo::TI_PROCESS, TThread::id());
+#if !STO_MASSTREE_POOL
         Transaction::tinfo[TThread::id()].trans_start_callback = []() {
             ti->rcu_start();
         };
         Transaction::tinfo[TThread::id()].trans_end_callback = []() {
             ti->rcu_stop();
         };
+#endif
     }
 
     uint64_t gen_key() {
         return fetch_and_add(&key_gen_, 1);
     }
+    // Skips gen_key() past n keys, as after loading rows keyed by them
+    void skip_keys(uint64_t n) {
+        if (key_gen_ < n)
+            key_gen_ = n;
+    }
+
+    // Logs this table's committed writes under id, a nonzero id unique
+    // among logged objects (TxnLog): inserts as whole rows, updates as the
+    // words of the row they changed, and deletes. Set before the index is
+    // used.
+    void set_log_id(uint32_t id) {
+        static_assert(std::is_trivially_copyable<key_type>::value
+                      && std::is_trivially_copyable<value_type>::value,
+                      "logged keys and rows are copied bytewise");
+        log_id_ = id;
+    }
+    uint32_t log_id() const {
+        return log_id_;
+    }
+
+    // Declares the table read-only from now on; set after loading, before
+    // transactions use it. Selects then add nothing to the tset: the rows
+    // can't change, so there is nothing to validate at commit. Updates,
+    // inserts and deletes become errors.
+    void set_immutable(bool on) {
+        immutable_ = on;
+    }
+    bool immutable() const {
+        return immutable_;
+    }
+
+    // With range phantoms on, scans and absent keys are protected by key
+    // range predicates, validated against a log of this index's inserts,
+    // instead of by the versions of every leaf they visit. Set before the
+    // index is used.
+    void set_range_phantoms(bool on) {
+        always_assert(!on || !DBParams::TicToc, "range phantoms don't support TicToc");
+        if (on && !inserts_)
+            inserts_.reset(new insert_log_type);
+        range_phantoms_ = on;
+    }
+
+    // With filter predicates on, committed updates are logged too, so that
+    // range_scan_where can skip the rows its filter rejects. Implies range
+    // phantoms. Set before the index is used.
+    void set_filter_predicates(bool on) {
+        if (on) {
+            set_range_phantoms(true);
+            if (!updates_)
+                updates_.reset(new insert_log_type);
+        }
+        filter_predicates_ = on;
+    }
 
 #if 0
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(const key_type& key, RowAccess acc) {
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
@@ -131,8 +315,31 @@ public:
     }
 #endif
 
-    sel_split_return_type
+    // Reads and validates only the columns Cols of the row at key, and
+    // returns copies of them (see DB_projection.hh)
+    template <typename V::NamedColumn... Cols>
+    std::tuple<bool, bool, projection<V, Cols...>>
+    select_row(const key_type& key) {
+        return select_projection<V, Cols...>(*this, key);
+    }
+
+    [[nodiscard]] sel_split_return_type
     select_split_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
+        return find_split_row(key, accesses);
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(const key_type& key, static_accesses<Accs...> accesses) {
+        return find_split_row(key, accesses);
+    }
+
+    // select_split_row(key, accesses) for either kind of access list
+    template <typename Accesses>
+    [[nodiscard]] sel_split_return_type
+    find_split_row(const key_type& key, const Accesses& accesses) {
+        if (internal_elem* p = find_pending(key))
+            return select_split_row(reinterpret_cast<uintptr_t>(p), accesses);
+        uint64_t since = insert_position();
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
         internal_elem *e = lp.value();
@@ -140,15 +347,64 @@ public:
             return select_split_row(reinterpret_cast<uintptr_t>(e), accesses);
         }
         return {
-            register_internode_version(lp.node(), lp),
+            immutable_ || register_absent(key, since, lp),
             false,
             0,
             UniRecordAccessor<V>(nullptr)
         };
     }
 
+    // Batched select_split_row: calls callback(i, found, rid, value) for
+    // the keys key_of(0), ..., key_of(n - 1) in order, and returns false if
+    // the transaction must abort.
+    // Each batch descends the tree for all its keys and prefetches the rows
+    // found before registering any row item, so the row misses overlap.
+    // (A leaf can't be prefetched without descending to it.)
+    template <typename KeyOf, typename Callback>
+    bool select_split_rows(size_t n, KeyOf key_of,
+                           std::initializer_list<column_access_t> accesses, Callback callback) {
+        return find_split_rows(n, key_of, accesses, callback);
+    }
+    template <typename KeyOf, typename Callback, typename... Accs>
+    bool select_split_rows(size_t n, KeyOf key_of, static_accesses<Accs...> accesses, Callback callback) {
+        return find_split_rows(n, key_of, accesses, callback);
+    }
+
+    template <typename KeyOf, typename Accesses, typename Callback>
+    bool find_split_rows(size_t n, KeyOf key_of, const Accesses& accesses, Callback callback) {
+        internal_elem* es[select_batch];
+        for (size_t first = 0; first < n; first += select_batch) {
+            size_t m = std::min(n - first, select_batch);
+            uint64_t since = insert_position();
+            for (size_t i = 0; i != m; ++i) {
+                key_type k = key_of(first + i);  // must outlive the cursor
+                if ((es[i] = find_pending(k)))
+                    continue;
+                unlocked_cursor_type lp(table_, k);
+                if (lp.find_unlocked(*ti)) {
+                    es[i] = lp.value();
+                    ::prefetch(&es[i]->row_container);
+                } else {
+                    es[i] = nullptr;
+                    if (!immutable_ && !register_absent(k, since, lp))
+                        return false;
+                }
+            }
+            for (size_t i = 0; i != m; ++i) {
+                if (es[i]) {
+                    auto r = select_split_row(reinterpret_cast<uintptr_t>(es[i]), accesses);
+                    if (!std::get<0>(r))
+                        return false;
+                    callback(first + i, std::get<1>(r), std::get<2>(r), std::get<3>(r));
+                } else
+                    callback(first + i, false, uintptr_t(0), UniRecordAccessor<V>(nullptr));
+            }
+        }
+        return true;
+    }
+
 #if 0
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
         auto e = reinterpret_cast<internal_elem *>(rid);
         bool ok = true;
@@ -194,15 +450,36 @@ public:
     }
 #endif
 
-    sel_split_return_type
+    [[nodiscard]] sel_split_return_type
     select_split_row(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
+        return select_split_cells(rid, column_to_cell_accesses<value_container_type>(accesses));
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(uintptr_t rid, static_accesses<Accs...>) {
+#if STO_PROFILE_COLUMNS
+        column_profile::record<value_type, std::initializer_list<column_access_t>>(
+                {column_access_t(Accs::column, Accs::access)...});
+#endif
+        constexpr auto cell_accesses = static_cell_accesses<value_container_type, Accs...>();
+        return select_split_cells(rid, cell_accesses);
+    }
+
+    [[nodiscard]] sel_split_return_type
+    select_split_cells(uintptr_t rid, const std::array<access_t, value_container_type::num_versions>& cell_accesses) {
         auto e = reinterpret_cast<internal_elem*>(rid);
+        if (immutable_)
+            return {true, true, rid, UniRecordAccessor<V>(&(e->row_container.row))};
+        if constexpr (supports_ro_observe<version_type>::value) {
+            if (Sto::readonly()) {
+                if (!e->valid() || !ro_access_all<value_container_type>(cell_accesses, e->row_container))
+                    return {false, false, 0, UniRecordAccessor<V>(nullptr)};
+                return {true, true, rid, UniRecordAccessor<V>(&(e->row_container.row))};
+            }
+        }
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
 
-        // Translate from column accesses to cell accesses
         // all buffered writes are only stored in the wdata_ of the row item (to avoid redundant copies)
-        auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
-
         std::array<TransItem*, value_container_type::num_versions> cell_items {};
         bool any_has_write;
         bool ok;
@@ -236,6 +513,7 @@ public:
     }
 
     void update_row(uintptr_t rid, value_type *new_row) {
+        always_assert(!immutable_, "write to an immutable table");
         auto e = reinterpret_cast<internal_elem*>(rid);
         auto row_item = Sto::item(this, item_key_t::row_item_key(e));
         if (value_is_small) {
@@ -245,16 +523,58 @@ public:
         }
     }
 
+    // Like update_row(rid, new_row), and registers f(*new_row, row) to run
+    // at commit (Sto::defer_update) on the live row, after validation and
+    // with the row's written columns locked. Hot columns selected with
+    // access_t::write and computed by f never join the read set. f may
+    // only read columns this transaction writes; others aren't locked.
+    template <typename F>
+    void defer_update_row(uintptr_t rid, value_type *new_row, F f) {
+        update_row(rid, new_row);
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        value_type* out = new_row;
+        if (value_is_small)
+            out = &Sto::item(this, item_key_t::row_item_key(e)).template write_value<value_type>();
+        const value_type* row = &e->row_container.row;
+        Sto::defer_update([=] { f(*out, *row); });
+    }
+
+    // Repeated updates of a row coalesce into the write already buffered:
+    // a commutator folds into an earlier one, or applies directly to a row
+    // this transaction inserted or replaced.
     void update_row(uintptr_t rid, const comm_type &comm) {
+        always_assert(!immutable_, "write to an immutable table");
         assert(&comm);
-        auto row_item = Sto::item(this, item_key_t::row_item_key(reinterpret_cast<internal_elem *>(rid)));
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        auto row_item = Sto::item(this, item_key_t::row_item_key(e));
+        if (fold_commute(row_item, comm))
+            return;
+        if (row_item.has_write() && !row_item.has_commute()) {
+            if (has_insert(row_item)) {
+                comm.operate(e->row_container.row);
+                return;
+            }
+            // small rows are buffered by value, and a row selected for
+            // update but not yet written can't be told apart; leave those
+            // to the commutator
+            if (!value_is_small && has_row_update(row_item)) {
+                auto vptr = row_item.template raw_write_value<value_type*>();
+                if (vptr) {
+                    comm.operate(*vptr);
+                    return;
+                }
+            }
+        }
         row_item.add_commute(comm);
     }
 
     // insert assumes common case where the row doesn't exist in the table
     // if a row already exists, then use select (FOR UPDATE) instead
-    ins_return_type
+    [[nodiscard]] ins_return_type
     insert_row(const key_type& key, value_type *vptr, bool overwrite = false) {
+        always_assert(!immutable_, "write to an immutable table");
+        if (defers_inserts())
+            return defer_insert(key, vptr, overwrite);
         cursor_type lp(table_, key);
         bool found = lp.find_insert(*ti);
         if (found) {
@@ -269,44 +589,7 @@ public:
             // and figure out if the row-level version is locked.
             internal_elem *e = lp.value();
             lp.finish(0, *ti);
-
-            TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
-
-            if (is_phantom(e, row_item))
-                goto abort;
-
-            if (index_read_my_write) {
-                if (has_delete(row_item)) {
-                    auto proxy = row_item.clear_flags(delete_bit).clear_write();
-
-                    if (value_is_small)
-                        proxy.add_write(*vptr);
-                    else
-                        proxy.add_write(vptr);
-
-                    return ins_return_type(true, false);
-                }
-            }
-
-            if (overwrite) {
-                bool ok;
-                if (value_is_small)
-                    ok = version_adapter::select_for_overwrite(row_item, e->version(), *vptr);
-                else
-                    ok = version_adapter::select_for_overwrite(row_item, e->version(), vptr);
-                if (!ok)
-                    goto abort;
-                if (index_read_my_write) {
-                    if (has_insert(row_item)) {
-                        copy_row(e, vptr);
-                    }
-                }
-            } else {
-                // observes that the row exists, but nothing more
-                if (!row_item.observe(e->version()))
-                    goto abort;
-            }
-
+            return insert_found(e, vptr, overwrite);
         } else {
             auto e = new internal_elem(key, vptr ? *vptr : value_type(),
                                        false /*!valid*/);
@@ -330,6 +613,8 @@ public:
             fence();
             lp.finish(1, *ti);
             //fence();
+            if (range_phantoms_)
+                inserts_->append(key);
 
             TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
             //if (value_is_small)
@@ -350,8 +635,83 @@ public:
         return ins_return_type(false, false);
     }
 
-    del_return_type
+private:
+    // insert_row of a key whose row e exists, or is pending in this
+    // transaction
+    ins_return_type insert_found(internal_elem* e, value_type* vptr, bool overwrite) {
+        TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
+
+        if (is_phantom(e, row_item))
+            goto abort;
+
+        if (index_read_my_write) {
+            if (has_delete(row_item)) {
+                auto proxy = row_item.clear_flags(delete_bit).clear_write();
+
+                if (value_is_small)
+                    proxy.add_write(*vptr);
+                else
+                    proxy.add_write(vptr);
+
+                return ins_return_type(true, false);
+            }
+        }
+
+        if (overwrite) {
+            bool ok;
+            if (value_is_small)
+                ok = version_adapter::select_for_overwrite(row_item, e->version(), *vptr);
+            else
+                ok = version_adapter::select_for_overwrite(row_item, e->version(), vptr);
+            if (!ok)
+                goto abort;
+            if (index_read_my_write) {
+                if (has_insert(row_item)) {
+                    copy_row(e, vptr);
+                }
+            }
+        } else {
+            // observes that the row exists, but nothing more
+            if (!row_item.observe(e->version()))
+                goto abort;
+        }
+
+        return ins_return_type(true, true);
+
+    abort:
+        return ins_return_type(false, false);
+    }
+
+    // insert_row with DeferInserts: a new row waits in the overlay
+    ins_return_type defer_insert(const key_type& key, value_type* vptr, bool overwrite) {
+        internal_elem* e = find_pending(key);
+        if (!e) {
+            unlocked_cursor_type lp(table_, key);
+            if (lp.find_unlocked(*ti))
+                e = lp.value();
+        }
+        if (e)
+            return insert_found(e, vptr, overwrite);
+        // no leaf read needed: if another transaction inserts the key
+        // first, ours fails in lock()
+        e = new internal_elem(key, vptr ? *vptr : value_type(), false /*!valid*/);
+        overlay().emplace(pending_key(key), e);
+        TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
+        row_item.acquire_write(e->version());
+        row_item.add_flags(insert_bit | deferred_bit);
+        return ins_return_type(true, false);
+    }
+
+public:
+    [[nodiscard]] del_return_type
     delete_row(const key_type& key) {
+        always_assert(!immutable_, "write to an immutable table");
+        if (internal_elem* p = find_pending(key)) {
+            // our own insert, which never reached the tree
+            drop_pending(p);
+            return del_return_type(true, true);
+        }
+        uint64_t since = insert_position();
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
         if (found) {
@@ -385,7 +745,7 @@ public:
             }
             row_item.add_flags(delete_bit);
         } else {
-            if (!register_internode_version(lp.node(), lp)) {
+            if (!register_absent(key, since, lp)) {
                 goto abort;
             }
         }
@@ -397,17 +757,35 @@ public:
     }
 
     template <typename Callback, bool Reverse>
-    bool range_scan(const key_type& begin, const key_type& end, Callback callback,
+    [[nodiscard]] bool range_scan(const key_type& begin, const key_type& end, Callback callback,
                     std::initializer_list<column_access_t> accesses, bool phantom_protection = true, int limit = -1) {
         assert((limit == -1) || (limit > 0));
+        uint64_t since = insert_position();
+        std::optional<key_type> last;
+        scan_node_batch node_batch;
         auto node_callback = [&] (leaf_type* node,
             typename unlocked_cursor_type::nodeversion_value_type version) {
-            return ((!phantom_protection) || scan_track_node_version(node, version));
+            return ((!phantom_protection) || range_phantoms_ || scan_track_node_version(node, version, node_batch));
         };
 
         auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
 
         auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            if (range_phantoms_ && limit > 0)
+                last.emplace(key);
+            if constexpr (supports_ro_observe<version_type>::value) {
+                if (Sto::readonly()) {
+                    if (!ro_access_all<value_container_type>(cell_accesses, e->row_container))
+                        return false;
+                    if (!e->valid()) {
+                        ret = true;
+                        count = false;
+                        return true;
+                    }
+                    ret = callback(key_type(key), &(e->row_container.row));
+                    return true;
+                }
+            }
             TransProxy row_item = index_read_my_write ? Sto::item(this, item_key_t::row_item_key(e))
                                                       : Sto::fresh_item(this, item_key_t::row_item_key(e));
 
@@ -453,23 +831,230 @@ public:
 
         range_scanner<decltype(node_callback), decltype(value_callback), Reverse>
             scanner(end, node_callback, value_callback, limit);
+        if (defers_inserts())
+            scanner.set_pending(overlay(), begin);
         if (Reverse)
             table_.rscan(begin, true, scanner, *ti);
         else
             table_.scan(begin, true, scanner, *ti);
-        return scanner.scan_succeeded_;
+        scanner.finish_pending();
+        if (phantom_protection && range_phantoms_)
+            return scanner.scan_succeeded_ && register_scan_range<Reverse>(begin, scanner, last, since);
+        return flush_scan_nodes(node_batch) && scanner.scan_succeeded_;
     }
 
     template <typename Callback, bool Reverse>
-    bool range_scan(const key_type& begin, const key_type& end, Callback callback,
+    [[nodiscard]] bool range_scan(const key_type& begin, const key_type& end, Callback callback,
                     RowAccess access, bool phantom_protection = true, int limit = -1) {
+        return scan_rows<Callback, Reverse>(begin, end, false, callback, access, phantom_protection, limit);
+    }
+
+    // Like range_scan over [begin, end), with the range split into pieces
+    // at the tree's top internodes (scan_split_points) and the pieces
+    // scanned by helpers. The leaves and row versions they read are added
+    // to this transaction afterwards, so commit validates them as if this
+    // thread had read them. callback(piece, key, value) runs on the helper
+    // threads, in key order within a piece but concurrently across pieces;
+    // returning false stops the whole scan. Rows are checked only at
+    // commit, so a callback can see a row that fails validation. Needs a
+    // read-only transaction on a plain OCC table; otherwise (or with no
+    // helpers) this is range_scan, with every row in piece 0. The helpers
+    // only read rows this transaction could reach, so its RCU epoch keeps
+    // them allocated.
+    template <typename Callback>
+    [[nodiscard]] bool parallel_range_scan(const key_type& begin, const key_type& end, Callback callback,
+                                           std::initializer_list<column_access_t> accesses,
+                                           scan_helpers* helpers) {
+        if constexpr (supports_ro_observe<version_type>::value && !table_params::track_nodes) {
+            if (helpers && Sto::readonly() && !range_phantoms_)
+                return parallel_range_scan_impl(begin, end, callback, accesses, *helpers);
+        }
+        auto serial = [&] (const key_type& key, const value_type* value) {
+            return callback(size_t(0), key, value);
+        };
+        return range_scan<decltype(serial), false>(begin, end, serial, accesses);
+    }
+
+    // Visits, like range_scan, the rows in [begin, end] whose Field (a
+    // pointer to an integer member of the row) lies in range. The rows the
+    // filter rejects aren't observed: one predicate item covers them, and
+    // the scan's phantoms, and fails at commit only if a row some other
+    // transaction inserted or updated in the meantime now passes the
+    // filter. An update that leaves a rejected row rejected doesn't abort
+    // the scan. Needs set_filter_predicates(true).
+    template <auto Field, bool Reverse = false, typename Callback>
+    [[nodiscard]] bool range_scan_where(const key_type& begin, const key_type& end, TIntRange<int64_t> range,
+                                        Callback callback, RowAccess access, int limit = -1) {
+        assert((limit == -1) || (limit > 0));
+        always_assert(filter_predicates_, "range_scan_where needs filter predicates");
+        uint64_t inserts_since = inserts_->position();
+        uint64_t updates_since = updates_->position();
+        std::optional<key_type> last;
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            if (limit > 0)
+                last.emplace(key);
+            ret = true;
+            count = false;
+            value_type* row = &(e->row_container.row);
+            bool written = false;
+            // rejected rows get no item, unless this transaction wrote them
+            if (index_read_my_write) {
+                if (auto mine = Sto::check_item(this, item_key_t::row_item_key(e))) {
+                    TransProxy row_item = mine.get();
+                    if (has_delete(row_item.item()))
+                        return true;
+                    if (has_row_update(row_item.item()) && !has_insert(row_item.item()))
+                        row = row_item.template raw_write_value<value_type *>();
+                    written = row_item.has_write();
+                }
+            }
+            if (!range.verify(int64_t(row->*Field)))
+                return true;
+
+            if (!written) {
+                TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
+                if ((access == RowAccess::ObserveValue || access == RowAccess::ObserveExists)
+                    && !row_item.observe(e->version()))
+                    return false;
+                // the row may have changed before it was observed
+                if (!e->valid() || !range.verify(int64_t(row->*Field)))
+                    return true;
+            }
+
+            count = true;
+            ret = callback(key_type(key), row);
+            return true;
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), Reverse>
+            scanner(end, node_callback, value_callback, limit);
+        if (Reverse)
+            table_.rscan(begin, true, scanner, *ti);
+        else
+            table_.scan(begin, true, scanner, *ti);
+        if (!scanner.scan_succeeded_)
+            return false;
+
+        key_filter f{begin, end, inserts_since, updates_since, &column_value<Field>, range};
+        if (scanner.limit_ > 0 && scanner.scancount_ >= scanner.limit_ && last)
+            f.hi = *last;
+        if (Reverse)
+            std::swap(f.lo, f.hi);
+        Sto::fresh_item(this, filter_key).set_predicate(f);
+        return true;
+    }
+
+    // Visits, newest first, the last n rows whose keys share their first
+    // prefix_len bytes with upper: the scan seeks to upper and stops after
+    // n rows or at the first key outside the prefix. Keys are compared with
+    // the prefix only in leaves whose layer doesn't fix it already.
+    template <typename Callback>
+    [[nodiscard]] bool scan_last_n(const key_type& upper, int prefix_len, int n, Callback callback,
+                     RowAccess access, bool phantom_protection = true) {
+        Str u(upper);
+        return scan_rows<Callback, true>(upper, Str(u.data(), prefix_len), true,
+                                         callback, access, phantom_protection, n);
+    }
+
+    // Deletes the rows in [begin, end), at most limit of them (-1: all),
+    // in one scan instead of a descent per key. Each row is selected for
+    // update and marked deleted as delete_row would, and the leaves
+    // visited are protected against phantoms like a range_scan's, so the
+    // range is empty at commit. Returns whether the transaction can go on
+    // and how many rows it deleted.
+    [[nodiscard]] std::tuple<bool, size_t>
+    delete_range(const key_type& begin, const key_type& end, int limit = -1) {
+        always_assert(!immutable_, "write to an immutable table");
+        assert((limit == -1) || (limit > 0));
+        uint64_t since = insert_position();
+        std::optional<key_type> last;
+        scan_node_batch node_batch;
+        size_t ndeleted = 0;
+        std::vector<internal_elem*> dropped;
+        leaf_type* leaf = nullptr;
+        bool leaf_written = false;
+        auto node_callback = [&] (leaf_type* node,
+                                  typename unlocked_cursor_type::nodeversion_value_type version) {
+            leaf = node;
+            leaf_written = false;
+            return range_phantoms_ || scan_track_node_version(node, version, node_batch);
+        };
+
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            if (range_phantoms_ && limit > 0)
+                last.emplace(key);
+            TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
+            ret = true;
+            if (index_read_my_write) {
+                if (has_delete(row_item)) {
+                    count = false;
+                    return true;
+                }
+                if (!e->valid() && has_insert(row_item)) {
+                    // a pending row leaves after the scan, which walks them
+                    if (has_deferred(row_item.item()))
+                        dropped.push_back(e);
+                    else
+                        row_item.add_flags(delete_bit);
+                    ++ndeleted;
+                    return true;
+                }
+            }
+            // skip rows other transactions are inserting, as a scan does
+            if (is_phantom(e, row_item)) {
+                count = false;
+                return true;
+            }
+            if (!leaf_written) {
+                ttnv_register_node_write(leaf);
+                leaf_written = true;
+            }
+            if (!version_adapter::select_for_update(row_item, e->version()))
+                return false;
+            fence();
+            if (e->deleted)
+                return false;
+            row_item.add_flags(delete_bit);
+            ++ndeleted;
+            return true;
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), false>
+                scanner(end, node_callback, value_callback, limit);
+        if (defers_inserts())
+            scanner.set_pending(overlay(), begin);
+        table_.scan(begin, true, scanner, *ti);
+        scanner.finish_pending();
+        for (internal_elem* e : dropped)
+            drop_pending(e);
+        bool ok = scanner.scan_succeeded_;
+        if (range_phantoms_)
+            ok = ok && register_scan_range<false>(begin, scanner, last, since);
+        else
+            ok = flush_scan_nodes(node_batch) && ok;
+        return {ok, ndeleted};
+    }
+
+private:
+    template <typename Callback, bool Reverse>
+    [[nodiscard]] bool scan_rows(const key_type& begin, Str boundary, bool prefix, Callback callback,
+                   RowAccess access, bool phantom_protection, int limit) {
         assert((limit == -1) || (limit > 0));
+        uint64_t since = insert_position();
+        std::optional<key_type> last;
+        scan_node_batch node_batch;
         auto node_callback = [&] (leaf_type* node,
                                   typename unlocked_cursor_type::nodeversion_value_type version) {
-            return ((!phantom_protection) || scan_track_node_version(node, version));
+            return ((!phantom_protection) || range_phantoms_ || scan_track_node_version(node, version, node_batch));
         };
 
         auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            if (range_phantoms_ && limit > 0)
+                last.emplace(key);
             TransProxy row_item = index_read_my_write ? Sto::item(this, item_key_t::row_item_key(e))
                                                       : Sto::fresh_item(this, item_key_t::row_item_key(e));
 
@@ -516,12 +1101,45 @@ public:
         };
 
         range_scanner<decltype(node_callback), decltype(value_callback), Reverse>
-                scanner(end, node_callback, value_callback, limit);
+                scanner(boundary, node_callback, value_callback, limit, prefix);
+        if (defers_inserts())
+            scanner.set_pending(overlay(), begin);
         if (Reverse)
             table_.rscan(begin, true, scanner, *ti);
         else
             table_.scan(begin, true, scanner, *ti);
-        return scanner.scan_succeeded_;
+        scanner.finish_pending();
+        if (phantom_protection && range_phantoms_)
+            return scanner.scan_succeeded_ && register_scan_range<Reverse>(begin, scanner, last, since);
+        return flush_scan_nodes(node_batch) && scanner.scan_succeeded_;
+    }
+
+public:
+    // Fuzzy checkpoint of the keys in [begin, end) (an empty end is
+    // unbounded), alongside running transactions: calls callback(key,
+    // value) with a version-consistent copy of each committed row (tid is
+    // unused; rows are as of their copy). Callers need thread_init() and
+    // must keep rows from being freed (a snapshot pin does).
+    template <typename Callback>
+    void checkpoint_range(Str begin, Str end, TransactionTid::type tid, Callback callback) {
+        (void)tid;
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+        value_type v;
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            ret = true;
+            count = fuzzy_copy_row(e, v);
+            if (count)
+                callback(key_type(key), v);
+            return true;
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), false>
+                scanner(end, node_callback, value_callback, -1);
+        ti->rcu_start();
+        table_.scan(begin, true, scanner, *ti);
+        ti->rcu_stop();
     }
 
     value_type *nontrans_get(const key_type& k) {
@@ -548,8 +1166,52 @@ public:
             internal_elem *e = new internal_elem(k, v, true);
             lp.value() = e;
             lp.finish(1, *ti);
+            if (range_phantoms_)
+                inserts_->append(k);
         }
     }
+    bool nontrans_remove(const key_type& k) {
+        return _remove(k);
+    }
+
+    // Empties the table outside any transaction, with none running on it.
+    // The rows go to RCU as the scan passes them and the tree's nodes to
+    // Masstree's deferred destroy, in O(nodes) instead of a locked removal
+    // per key.
+    void truncate() {
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+        auto value_callback = [] (const lcdf::Str&, internal_elem *e, bool& ret, bool&) {
+            Transaction::rcu_delete(e);
+            ret = true;
+            return true;
+        };
+        range_scanner<decltype(node_callback), decltype(value_callback), false>
+                scanner(Str(), node_callback, value_callback, -1);
+        ti->rcu_start();
+        table_.scan(Str(), true, scanner, *ti);
+        table_.destroy(*ti);
+        table_.initialize(*ti);
+        ti->rcu_stop();
+    }
+
+    // Loads [begin, end), pairs of key and row sorted by key, as nontrans_put
+    // would one by one. Sorted keys keep each descent's path and the leaf
+    // being filled in cache; with nthreads > 1, slices of the key range load
+    // in parallel on threads of their own.
+    template <typename Iter>
+    void bulk_load(Iter begin, Iter end, int nthreads = 1) {
+        assert(std::is_sorted(begin, end, [](const auto& a, const auto& b) {
+                    return Str(a.first) < Str(b.first);
+                }));
+        for_each_load_range(begin, end, nthreads, [this](Iter first, Iter last) {
+                if (ti == nullptr)
+                    ti = table_params::threadinfo_type::make(threadinfo::TI_PROCESS, TThread::id());
+                for (; first != last; ++first)
+                    nontrans_put(first->first, first->second);
+            });
+    }
 
     // TObject interface methods
     bool lock(TransItem& item, Transaction &txn) override {
@@ -562,18 +1224,32 @@ public:
         }
         auto key = item.key<item_key_t>();
         auto e = key.internal_elem_ptr();
-        if (key.is_row_item())
-            return txn.try_lock(item, e->version());
+        bool result;
+        if (key.is_row_item() && has_deferred(item))
+            result = insert_pending(item, txn, e);
+        else if (key.is_row_item())
+            result = is_cell_commute(item) || txn.try_lock(item, e->version());
+        else if (is_cells_item(key))
+            result = cell_versions::lock(txn, item, e->row_container);
         else
-            return txn.try_lock(item, e->row_container.version_at(key.cell_num()));
+            result = txn.try_lock(item, e->row_container.version_at(key.cell_num()));
+        if (!result)
+            conflicts_->record(key_conflict_map::lock_failure, key_slice(e->key));
+        return result;
     }
 
     bool check(TransItem& item, Transaction& txn) override {
+        if (leaf_set && is_leaf_set(item))
+            return check_leaf_set(item);
         if (is_internode(item)) {
             node_type *n = get_internode_address(item);
             auto curr_nv = static_cast<leaf_type *>(n)->full_version_value();
             auto read_nv = item.template read_value<decltype(curr_nv)>();
-            return (curr_nv == read_nv);
+            if (curr_nv != read_nv) {
+                conflicts_->record(key_conflict_map::phantom, leaf_slice(n));
+                return false;
+            }
+            return true;
         } else {
             if constexpr (table_params::track_nodes) {
                 if (is_ttnv(item)) {
@@ -583,13 +1259,56 @@ public:
             }
             auto key = item.key<item_key_t>();
             auto e = key.internal_elem_ptr();
+            bool result;
             if (key.is_row_item())
-                return e->version().cp_check_version(txn, item);
+                result = e->version().cp_check_version(txn, item);
+            else if (is_cells_item(key))
+                result = cell_versions::check(item, e->row_container);
             else
-                return e->row_container.version_at(key.cell_num()).cp_check_version(txn, item);
+                result = e->row_container.version_at(key.cell_num()).cp_check_version(txn, item);
+            if (!result)
+                conflicts_->record(key_conflict_map::validation_failure, key_slice(e->key));
+            return result;
         }
     }
 
+    bool check_predicate(TransItem& item, Transaction& txn, bool committing) override {
+        (void)txn, (void)committing;
+        assert(is_range(item));
+        if (is_filter(item))
+            return check_filter(item.template predicate_value<key_filter>());
+        auto& r = item.template predicate_value<key_range>();
+        Str lo(r.lo), hi(r.hi);
+        return inserts_->check(r.since, [&] (const key_type& k) {
+                Str s(k);
+                return lo <= s && s <= hi;
+            });
+    }
+
+    const void* version_address(TransItem& item) const override {
+        if (is_range(item))
+            return inserts_.get();
+        if (is_internode(item) || is_ttnv(item))
+            return get_internode_address(item);
+        auto key = item.key<item_key_t>();
+        auto e = key.internal_elem_ptr();
+        if (key.is_row_item())
+            return &e->version();
+        else
+            return &e->row_container.version_at(key.cell_num());
+    }
+
+    // Prefetch every row's version first, then validate without virtual dispatch
+    unsigned check_batch(TransItem** items, unsigned n, Transaction& txn) override {
+        for (unsigned i = 0; i != n; ++i)
+            if (!is_internode(*items[i]) && !is_ttnv(*items[i]))
+                ::prefetch(items[i]->key<item_key_t>().internal_elem_ptr());
+        for (unsigned i = 0; i != n; ++i)
+            if (!ordered_index::check(*items[i], txn))
+                return i;
+        return n;
+    }
+
     void install(TransItem& item, Transaction& txn) override {
         assert(!is_internode(item));
 
@@ -603,24 +1322,29 @@ public:
 
         auto key = item.key<item_key_t>();
         auto e = key.internal_elem_ptr();
+        // the row before this install, to log what it changes
+        alignas(value_type) char before[sizeof(value_type)];
+        bool logged = log_id_ && txn.logging();
+        if (logged)
+            memcpy(before, &e->row_container.row, sizeof(value_type));
 
         if (key.is_row_item()) {
             //assert(e->version.is_locked());
             if (has_delete(item)) {
                 assert(e->valid() && !e->deleted);
                 e->deleted = true;
+                if (logged)
+                    txn.log_delete(log_id_, &e->key, sizeof(key_type), txn.commit_tid());
                 txn.set_version(e->version());
                 return;
             }
 
             if (!has_insert(item)) {
                 if (item.has_commute()) {
-                    comm_type &comm = item.write_value<comm_type>();
-                    if (has_row_update(item)) {
-                        copy_row(e, comm);
-                    } else if (has_row_cell(item)) {
-                        e->row_container.install_cell(comm);
-                    }
+                    if (has_row_update(item))
+                        copy_row(e, item.write_value<comm_type>());
+                    else
+                        apply_commute(item, e);
                 } else {
                     value_type *vptr;
                     if (value_is_small) {
@@ -643,15 +1367,20 @@ public:
                     }
                 }
             }
-            txn.set_version_unlock(e->version(), item);
+            if (logged)
+                log_row(txn, e, before, has_insert(item));
+            if (filter_predicates_)
+                updates_->append(e->key);
+            if (is_cell_commute(item))
+                item.clear_needs_unlock();
+            else
+                txn.set_version_unlock(e->version(), item);
         } else {
             // skip installation if row-level update is present
             auto row_item = Sto::item(this, item_key_t::row_item_key(e));
             if (!has_row_update(row_item)) {
                 if (row_item.has_commute()) {
-                    comm_type &comm = row_item.template write_value<comm_type>();
-                    assert(&comm);
-                    e->row_container.install_cell(comm);
+                    apply_commute(row_item.item(), e);
                 } else {
                     value_type *vptr;
                     if (value_is_small)
@@ -659,11 +1388,23 @@ public:
                     else
                         vptr = row_item.template raw_write_value<value_type *>();
 
-                    e->row_container.install_cell(key.cell_num(), vptr);
+                    if (is_cells_item(key))
+                        cell_versions::for_each(cell_versions::written(item), [&](int cell) {
+                                e->row_container.install_cell(cell, vptr);
+                            });
+                    else
+                        e->row_container.install_cell(key.cell_num(), vptr);
                 }
             }
+            if (logged)
+                log_row(txn, e, before, false);
+            if (filter_predicates_)
+                updates_->append(e->key);
 
-            txn.set_version_unlock(e->row_container.version_at(key.cell_num()), item);
+            if (is_cells_item(key))
+                cell_versions::set_version_unlock(txn, item, e->row_container);
+            else
+                txn.set_version_unlock(e->row_container.version_at(key.cell_num()), item);
         }
     }
 
@@ -678,13 +1419,25 @@ public:
         }
         auto key = item.key<item_key_t>();
         auto e = key.internal_elem_ptr();
-        if (key.is_row_item())
-            e->version().cp_unlock(item);
+        if (key.is_row_item()) {
+            if (!is_cell_commute(item))
+                e->version().cp_unlock(item);
+        } else if (is_cells_item(key))
+            cell_versions::unlock(item, e->row_container);
         else
             e->row_container.version_at(key.cell_num()).cp_unlock(item);
     }
 
     void cleanup(TransItem& item, bool committed) override {
+        if (defer_inserts && has_insert(item)) {
+            internal_elem* e = item.key<item_key_t>().internal_elem_ptr();
+            overlay().erase(pending_key(e->key));
+            if (has_deferred(item)) {
+                Transaction::rcu_delete(e);
+                item.clear_needs_unlock();
+                return;
+            }
+        }
         if (committed ? has_delete(item) : has_insert(item)) {
             auto key = item.key<item_key_t>();
             assert(key.is_row_item());
@@ -705,12 +1458,40 @@ protected:
     template <typename NodeCallback, typename ValueCallback, bool Reverse>
     class range_scanner {
     public:
-        range_scanner(const Str upper, NodeCallback ncb, ValueCallback vcb, int limit) :
-            boundary_(upper), boundary_compar_(false), scan_succeeded_(true), limit_(limit), scancount_(0),
-            node_callback_(ncb), value_callback_(vcb) {}
+        // With prefix set, upper is a key prefix: the scan stops at the
+        // first key without it
+        range_scanner(const Str upper, NodeCallback ncb, ValueCallback vcb, int limit, bool prefix = false) :
+            boundary_(upper), boundary_compar_(false), prefix_(prefix), scan_succeeded_(true), limit_(limit), scancount_(0),
+            stopped_(false), node_callback_(ncb), value_callback_(vcb) {}
+
+        // Has the rows pending in ov, from begin on, join the scan in key
+        // order: those up to each key the tree yields come first, and
+        // finish_pending() visits the rest once the tree runs out
+        void set_pending(overlay_type& ov, const key_type& begin) {
+            if constexpr (Reverse) {
+                pit_ = pending_iterator(ov.upper_bound(pending_key(begin)));
+                pend_ = ov.rend();
+            } else {
+                pit_ = ov.lower_bound(pending_key(begin));
+                pend_ = ov.end();
+            }
+        }
+        void finish_pending() {
+            if (!stopped_)
+                stopped_ = !visit_pending(nullptr);
+        }
+
+        bool has_prefix(const Str& s) const {
+            return s.length() >= boundary_.length() && memcmp(s.data(), boundary_.data(), boundary_.length()) == 0;
+        }
 
         template <typename ITER, typename KEY>
         void check(const ITER& iter, const KEY& key) {
+            if (prefix_) {
+                // a leaf in a layer below the prefix holds only keys with it
+                boundary_compar_ = !(key.prefix_length() >= boundary_.length() && has_prefix(key.full_string()));
+                return;
+            }
             int min = std::min(boundary_.length(), key.prefix_length());
             int cmp = memcmp(boundary_.data(), key.full_string().data(), min);
             if (!Reverse) {
@@ -729,8 +1510,16 @@ protected:
         }
 
         template <typename ITER>
-        void visit_leaf(const ITER& iter, const Masstree::key<uint64_t>& key, threadinfo&) {
-            if (!node_callback_(iter.node(), iter.full_version_value())) {
+        void visit_leaf(const ITER& iter, const Masstree::key<uint64_t>& key, typename table_params::threadinfo_type&) {
+            // start loading the next leaf and this leaf's rows while its
+            // values are visited
+            auto n = iter.node();
+            if (auto next = Reverse ? n->prev_ : n->safe_next())
+                ::prefetch(next);
+            auto perm = iter.permutation();
+            for (int i = 0; i != perm.size(); ++i)
+                ::prefetch(&n->lv_[perm[i]].value()->row_container);
+            if (!node_callback_(n, iter.full_version_value())) {
                 scan_succeeded_ = false;
             }
             if (this->boundary_) {
@@ -738,15 +1527,35 @@ protected:
             }
         }
 
-        bool visit_value(const Masstree::key<uint64_t>& key, internal_elem *e, threadinfo&) {
-            if (this->boundary_compar_) {
-                if ((Reverse && (boundary_ >= key.full_string())) ||
-                    (!Reverse && (boundary_ <= key.full_string())))
+        bool visit_value(const Masstree::key<uint64_t>& key, internal_elem *e, typename table_params::threadinfo_type&) {
+            Str k = key.full_string();
+            stopped_ = !visit_pending(&k) || (this->boundary_compar_ && beyond(k)) || !visit(k, e);
+            return !stopped_;
+        }
+
+        bool beyond(const Str& k) const {
+            return prefix_ ? !has_prefix(k) : (Reverse ? boundary_ >= k : boundary_ <= k);
+        }
+
+        // Visits the pending rows up to *upto (all if null); false ends
+        // the scan
+        bool visit_pending(const Str* upto) {
+            for (; pit_ != pend_; ++pit_) {
+                Str k(pit_->second->key);
+                if (upto && (Reverse ? k < *upto : *upto < k))
+                    break;
+                if ((this->boundary_ && beyond(k)) || !visit(k, pit_->second)) {
+                    ++pit_;
                     return false;
+                }
             }
+            return true;
+        }
+
+        bool visit(const Str& k, internal_elem* e) {
             bool visited = false;
             bool count = true;
-            if (!value_callback_(key.full_string(), e, visited, count)) {
+            if (!value_callback_(k, e, visited, count)) {
                 scan_succeeded_ = false;
                 if (count) {++scancount_;}
                 return false;
@@ -761,32 +1570,159 @@ protected:
             }
         }
 
+        typedef std::conditional_t<Reverse, typename overlay_type::reverse_iterator,
+                                   typename overlay_type::iterator> pending_iterator;
+
         Str boundary_;
         bool boundary_compar_;
+        bool prefix_;
         bool scan_succeeded_;
         int limit_;
         int scancount_;
+        bool stopped_;
+        pending_iterator pit_;
+        pending_iterator pend_;
 
         NodeCallback node_callback_;
         ValueCallback value_callback_;
     };
 
 private:
+    typedef insert_log<key_type> insert_log_type;
+
+    // Keys a predicate item covers, and the insert log position it was
+    // taken at
+    struct key_range {
+        key_type lo;
+        key_type hi;
+        uint64_t since;
+    };
+
+    // A filtered range: keys from lo to hi whose column lies in range,
+    // with the log positions it was taken at
+    struct key_filter {
+        key_type lo;
+        key_type hi;
+        uint64_t inserts_since;
+        uint64_t updates_since;
+        int64_t (*column)(const value_type&);
+        TIntRange<int64_t> range;
+    };
+
     table_type table_;
     uint64_t key_gen_;
+    std::unique_ptr<key_conflict_map> conflicts_{key_conflict_map::make<value_type>()};
+    bool range_phantoms_ = false;
+    bool filter_predicates_ = false;
+    std::unique_ptr<insert_log_type> inserts_;
+    // committed updates, with filter predicates
+    std::unique_ptr<insert_log_type> updates_;
+    uint32_t log_id_ = 0;
+    bool immutable_ = false;
+    std::vector<overlay_type> overlays_;    // pending inserts, by thread
+
+    bool defers_inserts() const {
+        return defer_inserts && !range_phantoms_;
+    }
+    overlay_type& overlay() {
+        return overlays_[TThread::id()];
+    }
+    static pending_key_type pending_key(const key_type& k) {
+        pending_key_type pk;
+        Str s(k);
+        assert(s.length() == sizeof(K));
+        memcpy(pk.data(), s.data(), sizeof(K));
+        return pk;
+    }
+    internal_elem* find_pending(const key_type& k) {
+        if (!defers_inserts())
+            return nullptr;
+        auto& ov = overlay();
+        auto it = ov.find(pending_key(k));
+        return it == ov.end() ? nullptr : it->second;
+    }
+    // Takes back this transaction's pending insert e
+    void drop_pending(internal_elem* e) {
+        Sto::item(this, item_key_t::row_item_key(e)).clear_write()
+            .clear_flags(insert_bit | delete_bit | deferred_bit);
+        overlay().erase(pending_key(e->key));
+        Transaction::rcu_delete(e);
+    }
+
+    // Enters a pending row into the tree, with its row lock held
+    bool insert_pending(TransItem& item, Transaction& txn, internal_elem* e) {
+        if (!txn.try_lock(item, e->version()))
+            return false;
+        cursor_type lp(table_, e->key);
+        if (lp.find_insert(*ti)) {
+            lp.finish(0, *ti);
+            return false;
+        }
+        lp.value() = e;
+
+        node_type *node;
+        nodeversion_value_type orig_nv;
+        nodeversion_value_type new_nv;
+        if (lp.node() != lp.original_node()) {
+            node = lp.original_node();
+            orig_nv = lp.original_version_value();
+            new_nv = lp.updated_version_value();
+        } else {
+            node = lp.node();
+            orig_nv = lp.previous_full_version_value();
+            new_nv = lp.next_full_version_value(1);
+        }
+        fence();
+        lp.finish(1, *ti);
+        item.clear_flags(deferred_bit);
+
+        // the leaf, if this transaction read it, stays current through our
+        // own insert; like update_internode_version, without adding items
+        if constexpr (leaf_set) {
+            auto set_item = txn.check_item(this, leaf_set_key);
+            return !set_item || !set_item.get().has_read()
+                || set_item.get().template read_value<leaf_set_type*>()->update(node, orig_nv, new_nv);
+        }
+        auto node_item = txn.check_item(this, get_internode_key(node));
+        if (!node_item || !node_item.get().has_read())
+            return true;
+        if (node_item.get().template read_value<nodeversion_value_type>() != orig_nv)
+            return false;
+        node_item.get().update_read(orig_nv, new_nv);
+        return true;
+    }
+
+    void log_row(Transaction& txn, internal_elem* e, const void* before, bool insert) {
+        if (insert)
+            txn.log_write(log_id_, &e->key, sizeof(key_type), &e->row_container.row,
+                          sizeof(value_type), txn.commit_tid());
+        else
+            txn.log_delta(log_id_, &e->key, sizeof(key_type), before, &e->row_container.row,
+                          sizeof(value_type), txn.commit_tid());
+    }
 
     static bool
-    access_all(std::array<access_t, value_container_type::num_versions>& cell_accesses, std::array<TransItem*,
+    access_all(const std::array<access_t, value_container_type::num_versions>& cell_accesses, std::array<TransItem*,
                value_container_type::num_versions>& cell_items, value_container_type& row_container) {
         for (size_t idx = 0; idx < cell_accesses.size(); ++idx) {
             auto& access = cell_accesses[idx];
             auto proxy = TransProxy(*Sto::transaction(), *cell_items[idx]);
+            if (value_container_type::cell_bitmap && idx != 0) {
+                if ((static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::read))
+                    && !cell_versions::observe(proxy, row_container, idx))
+                    return false;
+                if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::write))
+                    cell_versions::add_write(proxy, idx);
+                continue;
+            }
             if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::read)) {
                 if (!proxy.observe(row_container.version_at(idx)))
                     return false;
             }
             if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::write)) {
-                if (!proxy.acquire_write(row_container.version_at(idx)))
+                // keep a commutator an earlier update buffered, for the
+                // next update_row() to fold into
+                if (!proxy.has_commute() && !proxy.acquire_write(row_container.version_at(idx)))
                     return false;
                 if (proxy.item().key<item_key_t>().is_row_item()) {
                     proxy.item().add_flags(row_cell_bit);
@@ -808,13 +1744,48 @@ private:
     static bool has_row_cell(const TransItem& item) {
         return (item.flags() & row_cell_bit) != 0;
     }
+    static bool is_cells_item(const item_key_t& key) {
+        return value_container_type::cell_bitmap && !key.is_row_item();
+    }
     static bool is_phantom(internal_elem *e, const TransItem& item) {
         return (!e->valid() && !has_insert(item));
     }
+    static bool has_deferred(const TransItem& item) {
+        return (item.flags() & deferred_bit) != 0;
+    }
+    // As in index_common
+    static bool is_cell_commute(const TransItem& item) {
+        return item.has_commute() && !item.has_read()
+            && !(item.flags() & (insert_bit | delete_bit | row_update_bit | row_cell_bit));
+    }
+    static void apply_commute(TransItem& row_item, internal_elem* e) {
+        if (!(row_item.flags() & comm_applied_bit)) {
+            e->row_container.install_cell(row_item.write_value<comm_type>());
+            row_item.add_flags(comm_applied_bit);
+        }
+    }
+
+    // A key's first 8 bytes, for key_conflict_map
+    static uint64_t key_slice(const key_type& k) {
+        Str s(k);
+        return string_slice<uint64_t>::make_comparable(s.data(), std::min(s.length(), 8));
+    }
+    // A leaf's first key, which phantoms in the leaf are charged to
+    static uint64_t leaf_slice(node_type* n) {
+        auto leaf = static_cast<leaf_type*>(n);
+        auto perm = leaf->permutation();
+        if (perm.size() == 0)
+            return 0;
+        if (leaf->is_layer(perm[0]))
+            return leaf->ikey0_[perm[0]];
+        return key_slice(leaf->lv_[perm[0]].value()->key);
+    }
 
     bool register_internode_version(node_type *node, unlocked_cursor_type& cursor) {
         if constexpr (table_params::track_nodes) {
             return ttnv_register_node_read_with_snapshot(node, *cursor.get_aux_tracker());
+        } else if constexpr (leaf_set) {
+            return register_leaf(node, cursor.full_version_value());
         } else {
             TransProxy item = Sto::item(this, get_internode_key(node));
             if constexpr (DBParams::Opaque) {
@@ -825,12 +1796,187 @@ private:
         }
     }
 
+    // Adds leaf node, seen at version nv, to this transaction's
+    // leaf_version_set
+    bool register_leaf(node_type* node, nodeversion_value_type nv) {
+        TransProxy item = Sto::item(this, leaf_set_key);
+        leaf_set_type* set = item.has_read() ? item.template read_value<leaf_set_type*>() : leaf_set_type::make();
+        bool ok;
+        if constexpr (DBParams::Opaque)
+            ok = item.add_read_opaque(set);
+        else
+            ok = item.add_read(set);
+        set->add(node, nv);
+        return ok;
+    }
+    bool check_leaf_set(TransItem& item) {
+        node_type* n = item.template read_value<leaf_set_type*>()->check([] (node_type* n) {
+                return static_cast<leaf_type*>(n)->full_version_value();
+            });
+        if (n)
+            conflicts_->record(key_conflict_map::phantom, leaf_slice(n));
+        return !n;
+    }
+    static bool is_leaf_set(TransItem& item) {
+        return item.key<uintptr_t>() == leaf_set_key;
+    }
+
+    uint64_t insert_position() const {
+        return range_phantoms_ ? inserts_->position() : 0;
+    }
+
+    template <auto Field>
+    static int64_t column_value(const value_type& row) {
+        return int64_t(row.*Field);
+    }
+
+    bool check_filter(const key_filter& f) {
+        Str lo(f.lo), hi(f.hi);
+        auto conflicts = [&] (const key_type& k) {
+            Str s(k);
+            return lo <= s && s <= hi && may_pass_filter(k, f);
+        };
+        return inserts_->check(f.inserts_since, conflicts)
+            && updates_->check(f.updates_since, conflicts);
+    }
+
+    // Whether the committed row at k passes f's filter, or might, being
+    // uncommitted or written by a transaction now committing
+    bool may_pass_filter(const key_type& k, const key_filter& f) {
+        unlocked_cursor_type lp(table_, k);
+        if (!lp.find_unlocked(*ti))
+            return false;
+        internal_elem* e = lp.value();
+        auto& rc = e->row_container;
+        std::array<typename version_type::type, value_container_type::num_versions> vs;
+        for (size_t i = 0; i != vs.size(); ++i) {
+            if (rc.version_at(i).is_locked_elsewhere())
+                return true;
+            vs[i] = rc.version_at(i).value();
+        }
+        if (vs[0] & invalid_bit)
+            return true;
+        fence();
+        bool pass = !e->deleted && f.range.verify(f.column(rc.row));
+        fence();
+        for (size_t i = 0; i != vs.size(); ++i)
+            if (TransactionTid::unlocked(rc.version_at(i).value()) != TransactionTid::unlocked(vs[i]))
+                return true;
+        return pass;
+    }
+
+    bool register_range(const key_type& lo, const key_type& hi, uint64_t since) {
+        Sto::fresh_item(this, range_bits).set_predicate(key_range{lo, hi, since});
+        return true;
+    }
+
+    // Phantom protection for a key found absent through cursor
+    bool register_absent(const key_type& key, uint64_t since, unlocked_cursor_type& cursor) {
+        if (range_phantoms_)
+            return register_range(key, key, since);
+        return register_internode_version(cursor.node(), cursor);
+    }
+
+    // Registers the keys between a scan's start and where it stopped: the
+    // last key it visited if it reached its limit, else its boundary (for
+    // a prefix, the least key with it)
+    template <bool Reverse, typename Scanner>
+    bool register_scan_range(const key_type& begin, const Scanner& scanner,
+                             const std::optional<key_type>& last, uint64_t since) {
+        if (scanner.limit_ > 0 && scanner.scancount_ >= scanner.limit_ && last)
+            return Reverse ? register_range(*last, begin, since) : register_range(begin, *last, since);
+        char buf[sizeof(key_type)] = {};
+        memcpy(buf, scanner.boundary_.data(), std::min(size_t(scanner.boundary_.length()), sizeof(buf)));
+        key_type end{Str(buf, sizeof(buf))};
+        return Reverse ? register_range(end, begin, since) : register_range(begin, end, since);
+    }
+
+    // What one piece of a parallel_range_scan read
+    struct scan_piece {
+        std::vector<std::pair<leaf_type*, nodeversion_value_type>> nodes;
+        std::vector<std::pair<const version_type*, version_type>> reads;
+    };
+
+    template <typename Callback>
+    bool parallel_range_scan_impl(const key_type& begin, const key_type& end, Callback& callback,
+                                  std::initializer_list<column_access_t> accesses, scan_helpers& helpers) {
+        auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
+        // a few pieces per helper, so that uneven pieces even out
+        auto bounds = scan_split_points(table_, begin, end, 4 * helpers.size());
+        size_t npieces = bounds.size() + 1;
+        std::vector<scan_piece> pieces(npieces);
+        std::atomic<bool> stop(false);
+
+        helpers.run(npieces, [&] (size_t p) {
+            if (ti == nullptr)
+                thread_init();
+            scan_piece& piece = pieces[p];
+            auto node_callback = [&] (leaf_type* node, nodeversion_value_type version) {
+                piece.nodes.emplace_back(node, version);
+                return true;
+            };
+            auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+                if (stop.load(std::memory_order_relaxed))
+                    return false;
+                for (size_t i = 0; i != value_container_type::num_versions; ++i)
+                    if ((cell_accesses[i] & access_t::read) != access_t::none) {
+                        auto& vers = e->row_container.version_at(i);
+                        version_type observed = vers;
+                        fence();
+                        piece.reads.emplace_back(&vers, observed);
+                    }
+                ret = true;
+                if (!e->valid()) {
+                    count = false;
+                    return true;
+                }
+                if (!callback(p, key_type(key), &(e->row_container.row)))
+                    stop.store(true, std::memory_order_relaxed);
+                return true;
+            };
+            Str lo = p ? Str(bounds[p - 1].data(), bounds[p - 1].size()) : Str(begin);
+            Str hi = p + 1 != npieces ? Str(bounds[p].data(), bounds[p].size()) : Str(end);
+            range_scanner<decltype(node_callback), decltype(value_callback), false>
+                scanner(hi, node_callback, value_callback, -1);
+            ti->rcu_start();
+            table_.scan(lo, true, scanner, *ti);
+            ti->rcu_stop();
+        });
+
+        Transaction& txn = *Sto::transaction();
+        scan_node_batch node_batch;
+        for (auto& piece : pieces) {
+            for (auto& [node, version] : piece.nodes)
+                if (!scan_track_node_version(node, version, node_batch))
+                    return false;
+            for (auto& [vers, observed] : piece.reads)
+                if (!txn.ro_observe(*vers, observed))
+                    return false;
+        }
+        return flush_scan_nodes(node_batch);
+    }
+
+    // Leaves visited by a scan under node tracking, with their trackers as
+    // of the visit; registered a batch at a time
+    struct scan_node_batch {
+        static constexpr unsigned capacity = table_params::track_nodes ? 16 : 1;
+        node_type* nodes[capacity];
+        typename table_params::aux_tracker_type snapshots[capacity];
+        unsigned n = 0;
+    };
+
     // Used in scan helpers to track leaf node timestamps for phantom protection.
-    bool scan_track_node_version(node_type *node, nodeversion_value_type nodeversion) {
+    bool scan_track_node_version(node_type *node, nodeversion_value_type nodeversion, scan_node_batch& batch) {
         if constexpr (table_params::track_nodes) {
             (void)nodeversion;
-            return ttnv_register_node_read(node);
+            batch.nodes[batch.n] = node;
+            batch.snapshots[batch.n] = *static_cast<leaf_type*>(node)->get_aux_tracker();
+            return ++batch.n != batch.capacity || flush_scan_nodes(batch);
+        } else if constexpr (leaf_set) {
+            (void)batch;
+            return register_leaf(node, nodeversion);
         } else {
+            (void)batch;
             TransProxy item = Sto::item(this, get_internode_key(node));
             if constexpr (DBParams::Opaque) {
                 return item.add_read_opaque(nodeversion);
@@ -840,9 +1986,22 @@ private:
         }
     }
 
+    bool flush_scan_nodes(scan_node_batch& batch) {
+        bool ok = true;
+        for (unsigned i = 0; i != batch.n; ++i)
+            ok = ttnv_register_node_read_with_snapshot(batch.nodes[i], batch.snapshots[i]) && ok;
+        batch.n = 0;
+        return ok;
+    }
+
     bool update_internode_version(node_type *node,
             nodeversion_value_type prev_nv, nodeversion_value_type new_nv) {
         ttnv_register_node_write(node);
+        if constexpr (leaf_set) {
+            TransProxy item = Sto::item(this, leaf_set_key);
+            return !item.has_read()
+                || item.template read_value<leaf_set_type*>()->update(node, prev_nv, new_nv);
+        }
         TransProxy item = Sto::item(this, get_internode_key(node));
         if (!item.has_read()) {
             return true;
@@ -906,7 +2065,7 @@ private:
         return reinterpret_cast<uintptr_t>(node) | internode_bit;
     }
     static bool is_internode(TransItem& item) {
-        return (item.key<uintptr_t>() & internode_bit) != 0;
+        return (item.key<uintptr_t>() & range_bits) == internode_bit;
     }
     static node_type *get_internode_address(TransItem& item) {
         if (is_internode(item)) {
@@ -922,7 +2081,13 @@ private:
         return reinterpret_cast<uintptr_t>(node) | ttnv_bit;
     }
     static bool is_ttnv(TransItem& item) {
-        return (item.key<uintptr_t>() & ttnv_bit);
+        return (item.key<uintptr_t>() & range_bits) == ttnv_bit;
+    }
+    static bool is_range(TransItem& item) {
+        return (item.key<uintptr_t>() & range_bits) == range_bits;
+    }
+    static bool is_filter(TransItem& item) {
+        return item.key<uintptr_t>() == filter_key;
     }
 
     static void copy_row(internal_elem *e, comm_type &comm) {
@@ -935,8 +2100,9 @@ private:
     }
 };
 
-template <typename K, typename V, typename DBParams>
-__thread typename ordered_index<K, V, DBParams>::table_params::threadinfo_type* ordered_index<K, V, DBParams>::ti;
+template <typename K, typename V, typename DBParams, bool DeferInserts>
+__thread typename ordered_index<K, V, DBParams, DeferInserts>::table_params::threadinfo_type*
+ordered_index<K, V, DBParams, DeferInserts>::ti;
 
 template <typename K, typename V, typename DBParams>
 class mvcc_ordered_index : public TObject {
@@ -952,17 +2118,21 @@ public:
     static constexpr TransItem::flags_type row_update_bit = TransItem::user0_bit << 2u;
     static constexpr TransItem::flags_type row_cell_bit = TransItem::user0_bit << 3u;
     static constexpr uintptr_t internode_bit = 1;
+    // Key of the leaf_version_set item: the internode item of no node
+    static constexpr uintptr_t leaf_set_key = internode_bit;
 
     typedef typename value_type::NamedColumn NamedColumn;
 
     static constexpr bool index_read_my_write = DBParams::RdMyWr;
+    // keys looked up together by select_split_rows
+    static constexpr size_t select_batch = 16;
 
     typedef typename index_common<K, V, DBParams>::MvInternalElement internal_elem;
 
     struct table_params : public Masstree::nodeparams<15,15> {
         typedef internal_elem* value_type;
         typedef Masstree::value_print<value_type> value_print_type;
-        typedef threadinfo threadinfo_type;
+        typedef index_threadinfo threadinfo_type;
     };
 
     typedef Masstree::Str Str;
@@ -973,6 +2143,9 @@ public:
 
     typedef typename table_type::node_type node_type;
     typedef typename unlocked_cursor_type::nodeversion_value_type nodeversion_value_type;
+    // Leaves seen for phantom protection go in one leaf_version_set item
+    static constexpr bool leaf_set = DBParams::NodeTrack;
+    typedef leaf_version_set<node_type, nodeversion_value_type> leaf_set_type;
 
     using accessor_t = typename index_common<K, V, DBParams>::accessor_t;
 
@@ -986,9 +2159,13 @@ public:
     using item_key_t = typename split_version_helpers<index_t>::item_key_t;
     template <typename T> static constexpr auto mvcc_column_to_cell_accesses =
         split_version_helpers<index_t>::template mvcc_column_to_cell_accesses<T>;
+    template <typename T, typename... Accs> static constexpr auto mvcc_static_cell_accesses =
+        split_version_helpers<index_t>::template mvcc_static_cell_accesses<T, Accs...>;
     template <typename T> static constexpr auto extract_item_list =
         split_version_helpers<index_t>::template extract_item_list<T>;
     using MvSplitAccessAll = typename split_version_helpers<index_t>::template MvSplitAccessAll<SplitParams<value_type>>;
+    // Rows whose layout changes at runtime (DynamicSplitParams)
+    static constexpr bool dynamic_split = is_dynamic_split<SplitParams<value_type>>::value;
 
     static __thread typename table_params::threadinfo_type *ti;
 
@@ -1003,27 +2180,34 @@ public:
     void table_init() {
         static_assert(DBParams::Opaque, "MVCC must operate in opaque mode.");
         if (ti == nullptr)
-            ti = threadinfo::make(threadinfo::TI_MAIN, -1);
+            ti = table_params::threadinfo_type::make(threadinfo::TI_MAIN, -1);
         table_.initialize(*ti);
         key_gen_ = 0;
     }
 
     static void thread_init() {
         if (ti == nullptr)
-            ti = threadinfo::make(threadinfo::TI_PROCESS, TThread::id());
+            ti = table_params::threadinfo_type::make(threadinfo::TI_PROCESS, TThread::id());
+#if !STO_MASSTREE_POOL
         Transaction::tinfo[TThread::id()].trans_start_callback = []() {
             ti->rcu_start();
         };
         Transaction::tinfo[TThread::id()].trans_end_callback = []() {
             ti->rcu_stop();
         };
+#endif
     }
 
     uint64_t gen_key() {
         return fetch_and_add(&key_gen_, 1);
     }
+    // Skips gen_key() past n keys, as after loading rows keyed by them
+    void skip_keys(uint64_t n) {
+        if (key_gen_ < n)
+            key_gen_ = n;
+    }
 
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(const key_type& key, RowAccess acc) {
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
@@ -1040,7 +2224,7 @@ public:
         return sel_return_type(false, false, 0, nullptr);
     }
 
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
@@ -1056,9 +2240,28 @@ public:
         return sel_return_type(false, false, 0, nullptr);
     }
 
+    // Reads and validates only the columns Cols of the row at key, and
+    // returns copies of them (see DB_projection.hh)
+    template <typename V::NamedColumn... Cols>
+    std::tuple<bool, bool, projection<V, Cols...>>
+    select_row(const key_type& key) {
+        return select_projection<V, Cols...>(*this, key);
+    }
+
     // Split version select row
-    sel_split_return_type
+    [[nodiscard]] sel_split_return_type
     select_split_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
+        return find_split_row(key, accesses);
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(const key_type& key, static_accesses<Accs...> accesses) {
+        return find_split_row(key, accesses);
+    }
+
+    template <typename Accesses>
+    [[nodiscard]] sel_split_return_type
+    find_split_row(const key_type& key, const Accesses& accesses) {
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
         internal_elem *e = lp.value();
@@ -1074,14 +2277,79 @@ public:
         }
     }
 
-    sel_split_return_type
+    // Batched select_split_row, as in ordered_index
+    template <typename KeyOf, typename Callback>
+    bool select_split_rows(size_t n, KeyOf key_of,
+                           std::initializer_list<column_access_t> accesses, Callback callback) {
+        return find_split_rows(n, key_of, accesses, callback);
+    }
+    template <typename KeyOf, typename Callback, typename... Accs>
+    bool select_split_rows(size_t n, KeyOf key_of, static_accesses<Accs...> accesses, Callback callback) {
+        return find_split_rows(n, key_of, accesses, callback);
+    }
+
+    template <typename KeyOf, typename Accesses, typename Callback>
+    bool find_split_rows(size_t n, KeyOf key_of, const Accesses& accesses, Callback callback) {
+        internal_elem* es[select_batch];
+        for (size_t first = 0; first < n; first += select_batch) {
+            size_t m = std::min(n - first, select_batch);
+            for (size_t i = 0; i != m; ++i) {
+                key_type k = key_of(first + i);  // must outlive the cursor
+                unlocked_cursor_type lp(table_, k);
+                if (lp.find_unlocked(*ti)) {
+                    es[i] = lp.value();
+                    ::prefetch(es[i]);
+                } else {
+                    es[i] = nullptr;
+                    if (!register_internode_version(lp.node(), lp.full_version_value()))
+                        return false;
+                }
+            }
+            for (size_t i = 0; i != m; ++i) {
+                if (es[i]) {
+                    auto r = select_splits(reinterpret_cast<uintptr_t>(es[i]), accesses);
+                    if (!std::get<0>(r))
+                        return false;
+                    callback(first + i, std::get<1>(r), std::get<2>(r), std::get<3>(r));
+                } else
+                    callback(first + i, false, uintptr_t(0), SplitRecordAccessor<V>({ nullptr }));
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] sel_split_return_type
     select_splits(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
         using split_params = SplitParams<value_type>;
         auto e = reinterpret_cast<internal_elem*>(rid);
-        auto cell_accesses = mvcc_column_to_cell_accesses<split_params>(accesses);
-        bool found;
-        auto result = MvSplitAccessAll::run_select(&found, cell_accesses, this, e);
-        return {true, found, rid, SplitRecordAccessor<V>(result)};
+        std::array<access_t, split_params::num_splits> cell_accesses;
+        if constexpr (dynamic_split)
+            cell_accesses = split_params::dynamic_type::instance().template split_accesses<access_t>(
+                    row_layout(e, Sto::read_tid()), accesses);
+        else
+            cell_accesses = mvcc_column_to_cell_accesses<split_params>(accesses);
+        bool found, ok;
+        auto result = MvSplitAccessAll::run_select(&found, &ok, cell_accesses, this, e);
+        return {ok, found, rid, SplitRecordAccessor<V>(result)};
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_splits(uintptr_t rid, static_accesses<Accs...>) {
+        using split_params = SplitParams<value_type>;
+        // dynamic layouts map columns to splits at run time
+        if constexpr (dynamic_split)
+            return select_splits(rid, {column_access_t(Accs::column, Accs::access)...});
+        else {
+#if STO_PROFILE_COLUMNS
+            column_profile::record<value_type, std::initializer_list<column_access_t>>(
+                    {column_access_t(Accs::column, Accs::access)...});
+#endif
+            constexpr auto cell_accesses = mvcc_static_cell_accesses<split_params, Accs...>();
+            bool found, ok;
+            auto result = MvSplitAccessAll::run_select(&found, &ok, cell_accesses, this,
+                                                       reinterpret_cast<internal_elem*>(rid));
+            return {ok, found, rid, SplitRecordAccessor<V>(result)};
+        }
     }
 
     void update_row(uintptr_t rid, value_type* new_row) {
@@ -1097,12 +2365,30 @@ public:
         // they should be subclasses of the row commutator.
         // Internally this run_update() implementation below uses a down-cast to convert
         // row commutators to cell commutators.
-        MvSplitAccessAll::run_update(this, reinterpret_cast<internal_elem*>(rid), comm);
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        if constexpr (dynamic_split) {
+            // Data splits are whole rows, so the row commutator applies to
+            // each. A migration moves columns between splits, which a
+            // commutator can't, so it writes the row as read instead.
+            if (std::get<0>(Sto::find_write_item(this, item_key_t(e, 0)))) {
+                auto row = Sto::tx_alloc<value_type>();
+                read_dynamic_row(e, row);
+                comm.operate(*row);
+                MvSplitAccessAll::run_update(this, e, row);
+                return;
+            }
+            for (size_t i = 1; i < SplitParams<value_type>::num_splits; ++i) {
+                auto [found, item] = Sto::find_write_item(this, item_key_t(e, i));
+                if (found)
+                    item.add_commute(comm);
+            }
+        } else
+            MvSplitAccessAll::run_update(this, e, comm);
     }
 
     // insert assumes common case where the row doesn't exist in the table
     // if a row already exists, then use select (FOR UPDATE) instead
-    ins_return_type
+    [[nodiscard]] ins_return_type
     insert_row(const key_type& key, value_type *vptr, bool overwrite = false) {
         cursor_type lp(table_, key);
         bool found = lp.find_insert(*ti);
@@ -1192,7 +2478,7 @@ public:
         return ins_return_type(false, false);
     }
 
-    del_return_type
+    [[nodiscard]] del_return_type
     delete_row(const key_type& key) {
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
@@ -1239,11 +2525,22 @@ public:
     }
 
     template <typename Callback, bool Reverse>
-    bool range_scan(const key_type& begin, const key_type& end, Callback callback,
+    [[nodiscard]] bool range_scan(const key_type& begin, const key_type& end, Callback callback,
                     std::initializer_list<column_access_t> accesses,
                     bool phantom_protection = true, int limit = -1) {
         assert((limit == -1) || (limit > 0));
         auto cell_accesses = mvcc_column_to_cell_accesses<SplitParams<value_type>>(accesses);
+        if constexpr (dynamic_split) {
+            // rows in the scan may be in any layout, so every split is
+            // read, and written rows are rewritten whole
+            uint8_t each_cell = 0;
+            for (auto& ca : accesses)
+                each_cell |= static_cast<uint8_t>(ca.access);
+            if (each_cell & static_cast<uint8_t>(access_t::write))
+                each_cell = static_cast<uint8_t>(access_t::update);
+            std::fill(cell_accesses.begin(), cell_accesses.end(), static_cast<access_t>(each_cell));
+            cell_accesses[0] = static_cast<access_t>(each_cell | static_cast<uint8_t>(access_t::read));
+        }
         auto node_callback = [&] (leaf_type* node,
                                   typename unlocked_cursor_type::nodeversion_value_type version) {
             return ((!phantom_protection) || register_internode_version(node, version));
@@ -1264,8 +2561,23 @@ public:
     }
 
     template <typename Callback, bool Reverse>
-    bool range_scan(const key_type& begin, const key_type& end, Callback callback,
+    [[nodiscard]] bool range_scan(const key_type& begin, const key_type& end, Callback callback,
                     RowAccess access, bool phantom_protection = true, int limit = -1) {
+        return scan_rows<Callback, Reverse>(begin, end, false, callback, access, phantom_protection, limit);
+    }
+
+    // As in ordered_index
+    template <typename Callback>
+    [[nodiscard]] bool scan_last_n(const key_type& upper, int prefix_len, int n, Callback callback,
+                     RowAccess access, bool phantom_protection = true) {
+        Str u(upper);
+        return scan_rows<Callback, true>(upper, Str(u.data(), prefix_len), true,
+                                         callback, access, phantom_protection, n);
+    }
+
+    template <typename Callback, bool Reverse>
+    [[nodiscard]] bool scan_rows(const key_type& begin, Str boundary, bool prefix, Callback callback,
+                   RowAccess access, bool phantom_protection, int limit) {
         // TODO: Scan ignores blind writes right now
         access_t each_cell = access_t::none;
         if (access == RowAccess::ObserveValue || access == RowAccess::ObserveExists) {
@@ -1288,7 +2600,7 @@ public:
         };
 
         range_scanner<decltype(node_callback), decltype(value_callback), Reverse>
-                scanner(end, node_callback, value_callback, limit);
+                scanner(boundary, node_callback, value_callback, limit, prefix);
         if (Reverse)
             table_.rscan(begin, true, scanner, *ti);
         else
@@ -1308,6 +2620,171 @@ public:
         }
     }
 
+    // Versions of k's first split that a reader at read_tid walks, from the
+    // head to the version it reads, or 0 if k isn't in the index. Call
+    // inside a transaction whose read TID is at most read_tid; its epoch
+    // keeps the versions walked from being freed.
+    size_t chain_length(const key_type& k, TransactionTid::type read_tid) {
+        unlocked_cursor_type lp(table_, k);
+        if (!lp.find_unlocked(*ti))
+            return 0;
+        size_t n = 0;
+        for (auto h = lp.value()->template chain_at<0>()->head(); h; h = h->prev()) {
+            ++n;
+            if (h->wtid() <= read_tid && (h->status() & COMMITTED))
+                break;
+        }
+        return n;
+    }
+
+    // AS OF reads: the table as of tid, outside any transaction. Nothing is
+    // tracked or validated, so tid must stay readable (see SnapshotPin).
+    bool select_row_as_of(const key_type& k, TransactionTid::type tid, value_type* value_out) {
+        unlocked_cursor_type lp(table_, k);
+        if (!lp.find_unlocked(*ti))
+            return false;
+        return MvSplitAccessAll::run_get_as_of(value_out, lp.value(), tid);
+    }
+
+    // Calls callback(key, const value_type&) for rows in [begin, end) that
+    // existed as of tid, until it returns false or limit rows are seen
+    template <typename Callback, bool Reverse = false>
+    void range_scan_as_of(const key_type& begin, const key_type& end, TransactionTid::type tid,
+                          Callback callback, int limit = -1) {
+        assert((limit == -1) || (limit > 0));
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            value_type v;
+            ret = true;
+            count = MvSplitAccessAll::run_get_as_of(&v, e, tid);
+            return !count || callback(key_type(key), v);
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), Reverse>
+                scanner(end, node_callback, value_callback, limit);
+        if (Reverse)
+            table_.rscan(begin, true, scanner, *ti);
+        else
+            table_.scan(begin, true, scanner, *ti);
+    }
+
+    // range_scan_as_of over [begin, end), split into pieces at the tree's
+    // top internodes (scan_split_points) that helpers scan in parallel.
+    // Snapshot reads need no items, so nothing is merged back: callback(
+    // piece, key, value) runs on the helper threads, in key order within a
+    // piece but concurrently across pieces; returning false stops the scan.
+    // Without helpers this is range_scan_as_of, with every row in piece 0.
+    template <typename Callback>
+    void parallel_range_scan_as_of(const key_type& begin, const key_type& end, TransactionTid::type tid,
+                                   Callback callback, scan_helpers* helpers) {
+        if (!helpers) {
+            range_scan_as_of(begin, end, tid, [&] (const key_type& key, const value_type& value) {
+                    return callback(size_t(0), key, value);
+                });
+            return;
+        }
+        auto bounds = scan_split_points(table_, begin, end, 4 * helpers->size());
+        size_t npieces = bounds.size() + 1;
+        std::atomic<bool> stop(false);
+
+        helpers->run(npieces, [&] (size_t p) {
+            if (ti == nullptr)
+                thread_init();
+            auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+                return true;
+            };
+            auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+                if (stop.load(std::memory_order_relaxed))
+                    return false;
+                value_type v;
+                ret = true;
+                count = MvSplitAccessAll::run_get_as_of(&v, e, tid);
+                if (count && !callback(p, key_type(key), v))
+                    stop.store(true, std::memory_order_relaxed);
+                return true;
+            };
+            Str lo = p ? Str(bounds[p - 1].data(), bounds[p - 1].size()) : Str(begin);
+            Str hi = p + 1 != npieces ? Str(bounds[p].data(), bounds[p].size()) : Str(end);
+            range_scanner<decltype(node_callback), decltype(value_callback), false>
+                scanner(hi, node_callback, value_callback, -1);
+            ti->rcu_start();
+            table_.scan(lo, true, scanner, *ti);
+            ti->rcu_stop();
+        });
+    }
+
+    // Checkpoint of the keys in [begin, end) (an empty end is unbounded)
+    // as of snapshot tid: calls callback(key, value) for each row that
+    // existed then. Callers need thread_init().
+    template <typename Callback>
+    void checkpoint_range(Str begin, Str end, TransactionTid::type tid, Callback callback) {
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+        value_type v;
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            ret = true;
+            count = MvSplitAccessAll::run_get_as_of(&v, e, tid);
+            if (count)
+                callback(key_type(key), v);
+            return true;
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), false>
+                scanner(end, node_callback, value_callback, -1);
+        ti->rcu_start();
+        table_.scan(begin, true, scanner, *ti);
+        ti->rcu_stop();
+    }
+
+    // Calls callback(key, split_values) for every row that existed as of
+    // tid, in key order, with split_values[I] pointing at split I's version.
+    // For snapshot export (DB_snapshot.hh); callers need thread_init().
+    template <typename Callback>
+    void scan_splits_as_of(TransactionTid::type tid, Callback callback) {
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            std::array<void*, SplitParams<value_type>::num_splits> split_values;
+            ret = true;
+            count = MvSplitAccessAll::run_get_splits_as_of(split_values, e, tid);
+            return !count || callback(key_type(key), split_values);
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), false>
+                scanner(lcdf::Str(), node_callback, value_callback, -1);
+        ti->rcu_start();
+        table_.scan(lcdf::Str(), true, scanner, *ti);
+        ti->rcu_stop();
+    }
+
+    // Same over the keys in [begin, end) (an empty end is unbounded),
+    // looking up only the splits whose bits are set in splits (split 0
+    // always); the rest are null. For analytical scans (DB_analytics.hh);
+    // callers need thread_init().
+    template <typename Callback>
+    void range_scan_splits_as_of(Str begin, Str end, TransactionTid::type tid, uint64_t splits,
+                                 Callback callback) {
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            std::array<void*, SplitParams<value_type>::num_splits> split_values;
+            ret = true;
+            count = MvSplitAccessAll::run_get_splits_as_of(split_values, e, tid, splits);
+            return !count || callback(key_type(key), split_values);
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), false>
+                scanner(end, node_callback, value_callback, -1);
+        ti->rcu_start();
+        table_.scan(begin, true, scanner, *ti);
+        ti->rcu_stop();
+    }
+
     void nontrans_put(const key_type& k, const value_type& v) {
         cursor_type lp(table_, k);
         bool found = lp.find_insert(*ti);
@@ -1323,6 +2800,20 @@ public:
         }
     }
 
+    // Sorted bulk load, as in ordered_index
+    template <typename Iter>
+    void bulk_load(Iter begin, Iter end, int nthreads = 1) {
+        assert(std::is_sorted(begin, end, [](const auto& a, const auto& b) {
+                    return Str(a.first) < Str(b.first);
+                }));
+        for_each_load_range(begin, end, nthreads, [this](Iter first, Iter last) {
+                if (ti == nullptr)
+                    ti = table_params::threadinfo_type::make(threadinfo::TI_PROCESS, TThread::id());
+                for (; first != last; ++first)
+                    nontrans_put(first->first, first->second);
+            });
+    }
+
     template <typename TSplit>
     bool lock_impl_per_chain(TransItem& item, Transaction& txn, MvObject<TSplit>* chain) {
         return mvcc_chain_operations<K, V, DBParams>::lock_impl_per_chain(item, txn, chain);
@@ -1340,24 +2831,70 @@ public:
         mvcc_chain_operations<K, V, DBParams>::cleanup_impl_per_chain(item, committed, chain);
     }
 
+    // Layout of row e as of tid, for DynamicSplitParams rows
+    static uint8_t row_layout(internal_elem* e, TransactionTid::type tid) {
+        auto h = e->template chain_at<0>()->find(tid);
+        if (h->status_is(DELETED))
+            return SplitParams<value_type>::dynamic_type::instance().current();
+        return h->vp()->layout;
+    }
+
+    // Row e as this transaction read it, when it read every split
+    void read_dynamic_row(internal_elem* e, value_type* row) {
+        std::array<void*, SplitParams<value_type>::num_splits> splits;
+        splits[0] = Sto::item(this, item_key_t(e, 0)).template read_value<
+                typename MvObject<dynamic_layout_tag>::history_type*>()->vp();
+        for (size_t i = 1; i < splits.size(); ++i)
+            splits[i] = Sto::item(this, item_key_t(e, i)).template read_value<
+                    typename MvObject<value_type>::history_type*>()->vp();
+        SplitParams<value_type>::dynamic_type::instance().merge(row, splits);
+    }
+
+    // Charges a failed lock or check of a data split to its columns
+    void note_conflict(TransItem& item, Transaction& txn) {
+        if constexpr (dynamic_split) {
+            auto key = item.key<item_key_t>();
+            SplitParams<value_type>::dynamic_type::instance().record_conflict(
+                    row_layout(key.internal_elem_ptr(), txn.read_tid()), key.cell_num());
+        } else {
+            (void)item, (void)txn;
+        }
+    }
+
     // TObject interface methods
     bool lock(TransItem& item, Transaction& txn) override {
         assert(!is_internode(item));
         auto key = item.key<item_key_t>();
-        return MvSplitAccessAll::run_lock(key.cell_num(), txn, item, this, key.internal_elem_ptr());
+        bool result = MvSplitAccessAll::run_lock(key.cell_num(), txn, item, this, key.internal_elem_ptr());
+        if (!result) {
+            conflicts_->record(key_conflict_map::lock_failure, key_slice(key.internal_elem_ptr()->key));
+            if (dynamic_split)
+                note_conflict(item, txn);
+        }
+        return result;
     }
 
     bool check(TransItem& item, Transaction& txn) override {
+        if (leaf_set && is_leaf_set(item))
+            return check_leaf_set(item, txn);
         if (is_internode(item)) {
             node_type *n = get_internode_address(item);
             auto curr_nv = static_cast<leaf_type *>(n)->full_version_value();
             auto read_nv = item.template read_value<decltype(curr_nv)>();
             auto result = (curr_nv == read_nv);
-            TXP_ACCOUNT(txp_tpcc_check_abort1, txn.special_txp && !result);
+            TXP_DYN_ACCOUNT(txp_special::check_abort1, txn.special_txp && !result);
+            if (!result)
+                conflicts_->record(key_conflict_map::phantom, leaf_slice(n));
             return result;
         } else {
-            int cell_id = item.key<item_key_t>().cell_num();
-            return MvSplitAccessAll::run_check(cell_id, txn, item, this);
+            auto key = item.key<item_key_t>();
+            bool result = MvSplitAccessAll::run_check(key.cell_num(), txn, item, this);
+            if (!result) {
+                conflicts_->record(key_conflict_map::validation_failure, key_slice(key.internal_elem_ptr()->key));
+                if (dynamic_split)
+                    note_conflict(item, txn);
+            }
+            return result;
         }
     }
 
@@ -1382,12 +2919,23 @@ public:
     template <typename NodeCallback, typename ValueCallback, bool Reverse>
     class range_scanner {
     public:
-        range_scanner(const Str upper, NodeCallback ncb, ValueCallback vcb, int limit) :
-            boundary_(upper), boundary_compar_(false), scan_succeeded_(true), limit_(limit), scancount_(0),
+        // With prefix set, upper is a key prefix: the scan stops at the
+        // first key without it
+        range_scanner(const Str upper, NodeCallback ncb, ValueCallback vcb, int limit, bool prefix = false) :
+            boundary_(upper), boundary_compar_(false), prefix_(prefix), scan_succeeded_(true), limit_(limit), scancount_(0),
             node_callback_(ncb), value_callback_(vcb) {}
 
+        bool has_prefix(const Str& s) const {
+            return s.length() >= boundary_.length() && memcmp(s.data(), boundary_.data(), boundary_.length()) == 0;
+        }
+
         template <typename ITER, typename KEY>
         void check(const ITER& iter, const KEY& key) {
+            if (prefix_) {
+                // a leaf in a layer below the prefix holds only keys with it
+                boundary_compar_ = !(key.prefix_length() >= boundary_.length() && has_prefix(key.full_string()));
+                return;
+            }
             int min = std::min(boundary_.length(), key.prefix_length());
             int cmp = memcmp(boundary_.data(), key.full_string().data(), min);
             if (!Reverse) {
@@ -1406,8 +2954,16 @@ public:
         }
 
         template <typename ITER>
-        void visit_leaf(const ITER& iter, const Masstree::key<uint64_t>& key, threadinfo&) {
-            if (!node_callback_(iter.node(), iter.full_version_value())) {
+        void visit_leaf(const ITER& iter, const Masstree::key<uint64_t>& key, typename table_params::threadinfo_type&) {
+            // start loading the next leaf and this leaf's rows while its
+            // values are visited
+            auto n = iter.node();
+            if (auto next = Reverse ? n->prev_ : n->safe_next())
+                ::prefetch(next);
+            auto perm = iter.permutation();
+            for (int i = 0; i != perm.size(); ++i)
+                ::prefetch(n->lv_[perm[i]].value());
+            if (!node_callback_(n, iter.full_version_value())) {
                 scan_succeeded_ = false;
             }
             if (this->boundary_) {
@@ -1415,10 +2971,11 @@ public:
             }
         }
 
-        bool visit_value(const Masstree::key<uint64_t>& key, internal_elem *e, threadinfo&) {
+        bool visit_value(const Masstree::key<uint64_t>& key, internal_elem *e, typename table_params::threadinfo_type&) {
             if (this->boundary_compar_) {
-                if ((Reverse && (boundary_ >= key.full_string())) ||
-                    (!Reverse && (boundary_ <= key.full_string())))
+                if (prefix_ ? !has_prefix(key.full_string())
+                    : ((Reverse && (boundary_ >= key.full_string())) ||
+                       (!Reverse && (boundary_ <= key.full_string()))))
                     return false;
             }
             bool visited = false;
@@ -1440,6 +2997,7 @@ public:
 
         Str boundary_;
         bool boundary_compar_;
+        bool prefix_;
         bool scan_succeeded_;
         int limit_;
         int scancount_;
@@ -1451,6 +3009,7 @@ public:
 //private:
     table_type table_;
     uint64_t key_gen_;
+    std::unique_ptr<key_conflict_map> conflicts_{key_conflict_map::make<value_type>()};
 
     //static bool
     //access_all(std::array<access_t, internal_elem::num_versions>&, std::array<TransItem*, internal_elem::num_versions>&, internal_elem*) {
@@ -1479,12 +3038,40 @@ public:
         return (h->status_is(DELETED) && !has_insert(item));
     }
 
+    // A key's first 8 bytes, for key_conflict_map
+    static uint64_t key_slice(const key_type& k) {
+        Str s(k);
+        return string_slice<uint64_t>::make_comparable(s.data(), std::min(s.length(), 8));
+    }
+    // A leaf's first key, which phantoms in the leaf are charged to
+    static uint64_t leaf_slice(node_type* n) {
+        auto leaf = static_cast<leaf_type*>(n);
+        auto perm = leaf->permutation();
+        if (perm.size() == 0)
+            return 0;
+        if (leaf->is_layer(perm[0]))
+            return leaf->ikey0_[perm[0]];
+        return key_slice(leaf->lv_[perm[0]].value()->key);
+    }
+
     bool register_internode_version(node_type *node, nodeversion_value_type nodeversion) {
+        if constexpr (leaf_set) {
+            TransProxy item = Sto::item(this, leaf_set_key);
+            leaf_set_type* set = item.has_read() ? item.template read_value<leaf_set_type*>() : leaf_set_type::make();
+            item.add_read(set);
+            set->add(node, nodeversion);
+            return true;
+        }
         TransProxy item = Sto::item(this, get_internode_key(node));
             return item.add_read(nodeversion);
     }
     bool update_internode_version(node_type *node,
             nodeversion_value_type prev_nv, nodeversion_value_type new_nv) {
+        if constexpr (leaf_set) {
+            TransProxy item = Sto::item(this, leaf_set_key);
+            return !item.has_read()
+                || item.template read_value<leaf_set_type*>()->update(node, prev_nv, new_nv);
+        }
         TransProxy item = Sto::item(this, get_internode_key(node));
         if (!item.has_read()) {
             return true;
@@ -1530,6 +3117,18 @@ public:
     static bool is_internode(TransItem& item) {
         return (item.key<uintptr_t>() & internode_bit) != 0;
     }
+    static bool is_leaf_set(TransItem& item) {
+        return item.key<uintptr_t>() == leaf_set_key;
+    }
+    bool check_leaf_set(TransItem& item, Transaction& txn) {
+        node_type* n = item.template read_value<leaf_set_type*>()->check([] (node_type* n) {
+                return static_cast<leaf_type*>(n)->full_version_value();
+            });
+        TXP_DYN_ACCOUNT(txp_special::check_abort1, txn.special_txp && n);
+        if (n)
+            conflicts_->record(key_conflict_map::phantom, leaf_slice(n));
+        return !n;
+    }
     static node_type *get_internode_address(TransItem& item) {
         assert(is_internode(item));
         return reinterpret_cast<node_type *>(item.key<uintptr_t>() & ~internode_bit);
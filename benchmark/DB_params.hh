@@ -7,10 +7,10 @@ namespace db_params {
 
 // Benchmark parameters
 constexpr const char *db_params_id_names[] = {
-    "none", "default", "opaque", "2pl", "adaptive", "swiss", "tictoc", "mvcc"};
+    "none", "default", "opaque", "2pl", "adaptive", "swiss", "tictoc", "mvcc", "det"};
 
 enum class db_params_id : int {
-    None = 0, Default, Opaque, TwoPL, Adaptive, Swiss, TicToc, MVCC
+    None = 0, Default, Opaque, TwoPL, Adaptive, Swiss, TicToc, MVCC, Deterministic
 };
 
 inline std::ostream &operator<<(std::ostream &os, const db_params_id &id) {
@@ -43,6 +43,7 @@ public:
     static constexpr bool MVCC = false;
     static constexpr bool NodeTrack = false;
     static constexpr bool Commute = false;
+    static constexpr bool Deterministic = false;
 };
 
 class db_default_commute_params : public db_default_params {
@@ -112,6 +113,14 @@ public:
     static constexpr bool Commute = true;
 };
 
+// Deterministic batch execution (DB_deterministic.hh); the indexes are the
+// default ones, used outside transactions
+class db_det_params : public db_default_params {
+public:
+    static constexpr db_params_id Id = db_params_id::Deterministic;
+    static constexpr bool Deterministic = true;
+};
+
 class db_default_node_params : public db_default_params {
 public:
     static constexpr bool NodeTrack = true;
@@ -138,6 +147,9 @@ public:
     static constexpr double million = 1000000.0;
     static constexpr double billion = 1000.0 * million;
     static double processor_tsc_frequency; // in GHz
+    // Added to each worker's id to seed its workload generators; a fixed
+    // value reproduces a run's transaction stream
+    static inline uint64_t workload_seed = 0;
 };
 
 }; // namespace db_params
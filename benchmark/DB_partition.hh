@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include "compiler.hh"
+
+namespace bench {
+
+// Key-range partitions for shard-per-core execution. Each partition covers
+// ranges of keys 1..nkeys (TPC-C warehouse ids) and has a lock; a worker
+// owns its home partition, and every transaction holds the locks of the
+// partitions it touches for its whole run, retries included.
+//
+// Partition locks serialize a single-partition transaction with everything
+// else that can touch its data, so it commits without validating its reads
+// (Transaction::set_exclusive), as in H-Store. Transactions spanning
+// partitions take their locks in partition order and commit normally.
+class partition_map {
+public:
+    static constexpr int max_txn_partitions = 16;
+
+    partition_map(size_t nkeys, int nparts)
+        : part_of_(nkeys + 1, -1), nparts_(nparts), locks_(new part_lock[nparts]) {}
+
+    // Keys first..last (inclusive) belong to partition part
+    void assign(uint64_t first, uint64_t last, int part) {
+        always_assert(part >= 0 && part < nparts_, "bad partition");
+        for (uint64_t k = first; k <= last; ++k)
+            part_of_[k] = part;
+    }
+
+    int num_partitions() const {
+        return nparts_;
+    }
+    int partition_of(uint64_t key) const {
+        assert(part_of_[key] >= 0);
+        return part_of_[key];
+    }
+
+    class guard {
+    public:
+        // With no map, holds nothing: not serialized, never exclusive
+        guard(partition_map* map, int home)
+            : map_(map), nparts_(0), locked_(false) {
+            if (map_)
+                parts_[nparts_++] = home;
+        }
+        guard(partition_map* map, int home, uint64_t key)
+            : guard(map, home) {
+            add(key);
+        }
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+        ~guard() {
+            if (locked_)
+                for (int i = 0; i != nparts_; ++i)
+                    map_->locks_[parts_[i]].held.store(false, std::memory_order_release);
+        }
+
+        void add(uint64_t key) {
+            if (!map_)
+                return;
+            int p = map_->partition_of(key);
+            if (std::find(parts_, parts_ + nparts_, p) == parts_ + nparts_) {
+                always_assert(nparts_ != max_txn_partitions, "too many partitions");
+                parts_[nparts_++] = p;
+            }
+        }
+        template <typename It>
+        void add(It first, It last) {
+            for (; first != last; ++first)
+                add(*first);
+        }
+
+        // Locks the partitions added, in partition order
+        void lock() {
+            if (!map_)
+                return;
+            assert(!locked_);
+            std::sort(parts_, parts_ + nparts_);
+            for (int i = 0; i != nparts_; ++i) {
+                auto& held = map_->locks_[parts_[i]].held;
+                while (held.exchange(true, std::memory_order_acquire))
+                    while (held.load(std::memory_order_relaxed))
+                        relax_fence();
+            }
+            locked_ = true;
+        }
+
+        bool exclusive() const {
+            return locked_ && nparts_ == 1;
+        }
+        bool cross_partition() const {
+            return nparts_ > 1;
+        }
+
+    private:
+        partition_map* map_;
+        int parts_[max_txn_partitions];
+        int nparts_;
+        bool locked_;
+    };
+
+private:
+    struct alignas(CACHE_LINE_SIZE) part_lock {
+        std::atomic<bool> held{false};
+    };
+
+    std::vector<int> part_of_;
+    int nparts_;
+    std::unique_ptr<part_lock[]> locks_;
+};
+
+} // namespace bench
@@ -1,8 +1,18 @@
 #pragma once
 
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "SystemProfiler.hh"
 #include "Transaction.hh"
 #include "DB_params.hh"
+#include "DB_column_profile.hh"
+#include "DB_conflict_map.hh"
+#include "DB_latency.hh"
+#include "DB_timeseries.hh"
 
 namespace bench {
 
@@ -25,14 +35,74 @@ public:
         if (spawn_perf_)
             perf_pid_ = Profiler::spawn("perf", mode);
         start_tsc_ = read_tsc();
+        if (STO_PROFILE_TIMESERIES)
+            sampler_.start(STO_PROFILE_TIMESERIES);
     }
 
     uint64_t start_timestamp() const {
         return start_tsc_;
     }
 
+    // Machine-readable results: when a results file is set (by default from
+    // the STO_RESULTS_JSON environment variable), finish() appends one JSON
+    // document per run to it, holding the run's config entries, throughput,
+    // STO's counters and memory stats, and any latency histograms.
+    static std::string& results_file() {
+        static std::string f = getenv("STO_RESULTS_JSON") ? getenv("STO_RESULTS_JSON") : "";
+        return f;
+    }
+    static void set_results_file(std::string path) {
+        results_file() = std::move(path);
+    }
+
+    // Adds or replaces a config entry for the next document
+    void config(const std::string& key, const char* value) {
+        config_json(key, json_string(value));
+    }
+    void config(const std::string& key, const std::string& value) {
+        config_json(key, json_string(value));
+    }
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type config(const std::string& key, T value) {
+        std::ostringstream v;
+        if (std::is_same<T, bool>::value)
+            v << (value ? "true" : "false");
+        else
+            v << +value;
+        config_json(key, v.str());
+    }
+
+    // The entries every driver shares: its name, the concurrency control
+    // and its options, the thread count, and the GC epoch cycle
+    template <typename DBParams>
+    void describe(const char* benchmark, int threads) {
+        config("benchmark", benchmark);
+        config("dbid", db_params::db_params_id_names[static_cast<int>(DBParams::Id)]);
+        config("commute", DBParams::Commute);
+        config("node_tracking", DBParams::NodeTrack);
+        config("threads", threads);
+        config("placement", placement_name());
+        config("housekeeping_cpus", housekeeping_cpus().size());
+        config("gc_epoch_us", Transaction::get_epoch_cycle());
+        config("seed", constants::workload_seed);
+    }
+
+    static std::string json_string(const std::string& s) {
+        std::string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if (static_cast<unsigned char>(c) < 0x20)
+                out += ' ';
+            else
+                out += c;
+        }
+        return out + "\"";
+    }
+
     double finish(size_t num_txns) {
         end_tsc_ = read_tsc();
+        sampler_.stop();
         if (spawn_perf_) {
             bool ok = Profiler::stop(perf_pid_);
             always_assert(ok, "killing profiler");
@@ -46,6 +116,34 @@ public:
 
         // print STO stats
         Transaction::print_stats();
+        Transaction::print_memory_stats();
+#if STO_PROFILE_COLUMNS
+        if (column_profile::dump(STO_PROFILE_COLUMNS_FILE))
+            std::cout << "Column accesses written to " << STO_PROFILE_COLUMNS_FILE << std::endl;
+#endif
+        if (key_conflict_map::recorded()) {
+            key_conflict_map::report(std::cout);
+            if (key_conflict_map::dump(STO_CONFLICT_MAP_FILE))
+                std::cout << "Key conflict heatmap written to " << STO_CONFLICT_MAP_FILE << std::endl;
+        }
+        // recorded with STO_PROFILE_LATENCY, or by open-loop runs
+        if (latency_profile::recorded()) {
+            double ticks_per_us = constants::processor_tsc_frequency * 1000.0;
+            latency_profile::report(std::cout, ticks_per_us);
+            if (latency_profile::dump(STO_PROFILE_LATENCY_FILE, ticks_per_us))
+                std::cout << "Latency histograms written to " << STO_PROFILE_LATENCY_FILE << std::endl;
+        }
+
+        if (STO_PROFILE_TIMESERIES
+            && sampler_.dump(STO_PROFILE_TIMESERIES_FILE, constants::processor_tsc_frequency * constants::billion))
+            std::cout << "Time series written to " << STO_PROFILE_TIMESERIES_FILE << std::endl;
+
+        if (!results_file().empty()) {
+            std::ofstream out(results_file(), std::ios::app);
+            write_results(out, num_txns, elapsed_time);
+            if (out)
+                std::cout << "Results appended to " << results_file() << std::endl;
+        }
 
         // return elapsed ms
         return elapsed_time;
@@ -53,9 +151,36 @@ public:
 
 private:
     bool spawn_perf_;
+    std::vector<std::pair<std::string, std::string>> config_;
     pid_t perf_pid_;
     uint64_t start_tsc_;
     uint64_t end_tsc_;
+    timeseries_sampler sampler_;
+
+    void config_json(const std::string& key, std::string value) {
+        for (auto& kv : config_)
+            if (kv.first == key) {
+                kv.second = std::move(value);
+                return;
+            }
+        config_.emplace_back(key, std::move(value));
+    }
+
+    void write_results(std::ostream& out, size_t num_txns, double elapsed_ms) {
+        out << "{\"config\": {";
+        for (size_t i = 0; i != config_.size(); ++i)
+            out << (i ? ", " : "") << json_string(config_[i].first) << ": " << config_[i].second;
+        out << "},\n \"txns\": " << num_txns << ", \"elapsed_ms\": " << elapsed_ms
+            << ", \"throughput\": " << (double) num_txns / (elapsed_ms / 1000.0)
+            << ",\n \"sto\": ";
+        Transaction::print_stats_json(out);
+        out << ",\n \"latency\": ";
+        if (latency_profile::recorded())
+            latency_profile::dump(out, constants::processor_tsc_frequency * 1000.0);
+        else
+            out << "null\n";
+        out << "}" << std::endl;
+    }
 };
 
 }; // namespace bench
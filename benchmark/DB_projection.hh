@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+
+namespace bench {
+
+template <typename A, typename V>
+class RecordAccessor;
+
+// Type of column C of row type V and how to read it from a row or a
+// RecordAccessor. The codegen prints a specialization for every field of
+// a row type's @fields (sto-core/codegen, -c NAMESPACE).
+template <typename V, typename V::NamedColumn C>
+struct ColumnTraits;
+
+// Copies of the columns Cols of a row of type V, which is what
+// select_row<Cols...>(key) returns: the index reads and validates only the
+// cells holding Cols, and the transaction gets the columns it named rather
+// than a pointer to, or a copy of, the whole row.
+template <typename V, typename V::NamedColumn... Cols>
+class projection {
+public:
+    typedef typename V::NamedColumn NamedColumn;
+    static constexpr size_t num_columns = sizeof...(Cols);
+    static_assert(num_columns != 0, "empty projection");
+
+    projection() = default;
+    // Source is a V or a RecordAccessor of V
+    template <typename Source,
+              typename = std::enable_if_t<!std::is_same<Source, projection>::value>>
+    explicit projection(const Source& src)
+        : values_(ColumnTraits<V, Cols>::get(src)...) {}
+
+    template <NamedColumn C>
+    const auto& get() const {
+        static_assert(position<C>() != num_columns, "column not in projection");
+        return std::get<position<C>()>(values_);
+    }
+
+private:
+    template <NamedColumn C>
+    static constexpr size_t position() {
+        constexpr NamedColumn cols[] = {Cols...};
+        size_t i = 0;
+        while (i != num_columns && cols[i] != C)
+            ++i;
+        return i;
+    }
+
+    std::tuple<typename ColumnTraits<V, Cols>::type...> values_;
+};
+
+} // namespace bench
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "masstree.hh"
+#include "masstree_tcursor.hh"
+#include "Sto.hh"
+
+namespace bench {
+
+// Helper threads for parallel range scans (ordered_index::
+// parallel_range_scan and mvcc_ordered_index::parallel_range_scan_as_of).
+// run() hands them the pieces of one scan at a time and waits for them;
+// the calling transaction stays on its own thread.
+class scan_helpers {
+public:
+    // Starts n threads with STO ids first_tid, first_tid + 1, ...
+    scan_helpers(int n, int first_tid)
+        : job_(), npieces_(0), next_(0), running_(0), gen_(0), stop_(false) {
+        assert(n > 0);
+        for (int i = 0; i != n; ++i)
+            threads_.emplace_back(&scan_helpers::helper, this, first_tid + i);
+    }
+    ~scan_helpers() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : threads_)
+            t.join();
+    }
+    scan_helpers(const scan_helpers&) = delete;
+    scan_helpers& operator=(const scan_helpers&) = delete;
+
+    size_t size() const {
+        return threads_.size();
+    }
+
+    // Calls f(piece) on the helpers for each piece in [0, npieces) and
+    // returns when all have returned
+    void run(size_t npieces, const std::function<void(size_t)>& f) {
+        std::lock_guard<std::mutex> one_at_a_time(run_mu_);
+        std::unique_lock<std::mutex> lk(mu_);
+        job_ = &f;
+        npieces_ = npieces;
+        next_.store(0, std::memory_order_relaxed);
+        running_ = threads_.size();
+        ++gen_;
+        cv_.notify_all();
+        done_cv_.wait(lk, [this] { return running_ == 0; });
+        job_ = nullptr;
+    }
+
+private:
+    std::mutex run_mu_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(size_t)>* job_;
+    size_t npieces_;
+    std::atomic<size_t> next_;
+    size_t running_;
+    uint64_t gen_;
+    bool stop_;
+    std::vector<std::thread> threads_;
+
+    void helper(int tid) {
+        TThread::set_id(tid);
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lk(mu_);
+        while (true) {
+            cv_.wait(lk, [&] { return stop_ || gen_ != seen; });
+            if (stop_)
+                return;
+            seen = gen_;
+            auto job = job_;
+            size_t n = npieces_;
+            lk.unlock();
+            for (size_t p; (p = next_.fetch_add(1, std::memory_order_relaxed)) < n; )
+                (*job)(p);
+            lk.lock();
+            if (--running_ == 0)
+                done_cv_.notify_all();
+        }
+    }
+};
+
+// Up to n - 1 keys strictly between begin and end (an empty end is
+// unbounded), in order, at the boundaries of table's top internodes: the
+// split points of n pieces of a parallel scan. The internodes are read
+// without locks, so a concurrent split can unbalance the pieces, but the
+// pieces always cover [begin, end). Only the first layer's 8-byte slices
+// are used, so tables whose keys share a longer prefix get one piece.
+template <typename P>
+std::vector<std::string> scan_split_points(const Masstree::basic_table<P>& table, lcdf::Str begin,
+                                           lcdf::Str end, size_t n) {
+    typedef Masstree::node_base<P> node_type;
+    typedef Masstree::internode<P> internode_type;
+    std::vector<uint64_t> ikeys;
+    std::vector<node_type*> level{table.root()};
+    while (ikeys.size() + 1 < n && !level.empty()) {
+        std::vector<node_type*> next;
+        for (node_type* x : level) {
+            if (x->isleaf())
+                continue;
+            auto in = static_cast<internode_type*>(x);
+            auto v = in->stable();
+            int nk = in->nkeys_;
+            uint64_t keys[internode_type::width];
+            node_type* children[internode_type::width + 1];
+            std::copy(in->ikey0_, in->ikey0_ + nk, keys);
+            std::copy(in->child_, in->child_ + nk + 1, children);
+            if (in->has_changed(v))
+                continue;
+            ikeys.insert(ikeys.end(), keys, keys + nk);
+            next.insert(next.end(), children, children + nk + 1);
+        }
+        level.swap(next);
+    }
+    std::sort(ikeys.begin(), ikeys.end());
+    ikeys.erase(std::unique(ikeys.begin(), ikeys.end()), ikeys.end());
+
+    // A slice's keys are those at or above its bytes without trailing zeros
+    std::string lo = begin ? std::string(begin.data(), begin.length()) : std::string();
+    std::string hi = end ? std::string(end.data(), end.length()) : std::string();
+    std::vector<std::string> bounds;
+    for (uint64_t ikey : ikeys) {
+        uint64_t be = __builtin_bswap64(ikey);
+        std::string s(reinterpret_cast<const char*>(&be), sizeof(be));
+        s.erase(s.find_last_not_of('\0') + 1);
+        if (s > lo && (hi.empty() || s < hi))
+            bounds.push_back(std::move(s));
+    }
+    if (bounds.size() < n)
+        return bounds;
+    std::vector<std::string> picked;
+    for (size_t i = 1; i != n; ++i)
+        picked.push_back(std::move(bounds[i * bounds.size() / n]));
+    return picked;
+}
+
+} // namespace bench
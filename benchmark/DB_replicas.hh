@@ -0,0 +1,199 @@
+#pragma once
+
+#include <initializer_list>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <sched.h>
+
+#include "PlatformFeatures.hh"
+#include "Transaction.hh"
+#include "DB_index.hh"
+
+namespace bench {
+
+// The NUMA node replicated_index reads for the calling thread (-1 for
+// the first replica). Runner threads set it once they are pinned.
+inline int& replica_thread_node() {
+    static thread_local int node = -1;
+    return node;
+}
+inline void note_replica_thread_node() {
+    replica_thread_node() = topology_node_of_cpu(sched_getcpu());
+}
+
+// A read-mostly table with a copy of its index and rows on each of a set
+// of NUMA nodes. Reads go to the copy of the calling thread's node
+// (replica_thread_node()). Writes go to every copy: a select for writing
+// selects the row in all replicas with the same accesses, and update_row
+// buffers the new row, or commutator, in each. One commit then locks the
+// row's version in every replica and installs them all. A reader
+// validates its local copy only, and any writer of the row has that copy
+// locked. Rows come in through bulk_load or nontrans_put, which fill
+// every replica; transactional inserts and deletes aren't supported.
+//
+// This object's items only carry, in their stash, the replicas' row ids
+// of a row selected for writing; they never lock or validate anything.
+template <typename Index>
+class replicated_index : public TObject {
+public:
+    typedef Index index_type;
+    typedef typename Index::key_type key_type;
+    typedef typename Index::value_type value_type;
+    typedef typename Index::NamedColumn NamedColumn;
+    typedef typename Index::column_access_t column_access_t;
+    typedef typename Index::sel_split_return_type sel_split_return_type;
+    typedef commutators::Commutator<value_type> comm_type;
+
+    static constexpr size_t max_replicas = 8;
+
+    // A replica on each node in nodes, its structures allocated there; no
+    // nodes means a single copy, wherever it lands. args construct each
+    // replica's index.
+    template <typename... Args>
+    explicit replicated_index(const std::vector<int>& nodes, const Args&... args)
+        : nodes_(nodes) {
+        if (nodes_.empty())
+            nodes_.push_back(-1);
+        always_assert(nodes_.size() <= max_replicas, "too many replicas");
+        for (int node : nodes_) {
+            prefer_node(node);
+            replicas_.emplace_back(new Index(args...));
+        }
+        prefer_node(-1);
+    }
+
+    size_t num_replicas() const {
+        return replicas_.size();
+    }
+    Index& replica(size_t i) {
+        return *replicas_[i];
+    }
+    // The replica the calling thread reads
+    Index& local() {
+        int node = replica_thread_node();
+        for (size_t i = 0; i != nodes_.size(); ++i)
+            if (nodes_[i] == node)
+                return *replicas_[i];
+        return *replicas_[0];
+    }
+
+    void thread_init() {
+        for (auto& r : replicas_)
+            r->thread_init();
+    }
+
+    [[nodiscard]] sel_split_return_type
+    select_split_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
+        return find_split_row(key, accesses);
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(const key_type& key, static_accesses<Accs...> accesses) {
+        return find_split_row(key, accesses);
+    }
+
+    // rid must come from a select for writing (access_t::write or update)
+    void update_row(uintptr_t rid, value_type* new_row) {
+        for_each_copy(rid, [&](Index& r, uintptr_t copy) { r.update_row(copy, new_row); });
+    }
+    void update_row(uintptr_t rid, const comm_type& comm) {
+        for_each_copy(rid, [&](Index& r, uintptr_t copy) { r.update_row(copy, comm); });
+    }
+
+    template <typename... Args>
+    auto nontrans_get(const key_type& k, Args&&... args) {
+        return local().nontrans_get(k, std::forward<Args>(args)...);
+    }
+    void nontrans_put(const key_type& k, const value_type& v) {
+        for (auto& r : replicas_)
+            r->nontrans_put(k, v);
+    }
+    // Loads [begin, end) into every replica, with each replica's rows
+    // allocated on its node
+    template <typename Iter>
+    void bulk_load(Iter begin, Iter end) {
+        for (size_t i = 0; i != replicas_.size(); ++i) {
+            prefer_node(nodes_[i]);
+            replicas_[i]->bulk_load(begin, end);
+        }
+        prefer_node(-1);
+    }
+
+    bool lock(TransItem&, Transaction&) override {
+        return true;
+    }
+    bool check(TransItem&, Transaction&) override {
+        return true;
+    }
+    void install(TransItem&, Transaction&) override {
+    }
+    void unlock(TransItem&) override {
+    }
+
+private:
+    struct copy_rids {
+        uintptr_t rid[max_replicas];
+    };
+
+    std::vector<int> nodes_;
+    std::vector<std::unique_ptr<Index>> replicas_;
+
+    void prefer_node(int node) {
+        if (nodes_.size() > 1)
+            prefer_numa_node(node);
+    }
+
+    static bool writes(std::initializer_list<column_access_t> accesses) {
+        for (auto& a : accesses)
+            if (static_cast<uint8_t>(a.access) & static_cast<uint8_t>(access_t::write))
+                return true;
+        return false;
+    }
+    template <typename... Accs>
+    static constexpr bool writes(static_accesses<Accs...>) {
+        return ((static_cast<uint8_t>(Accs::access) & static_cast<uint8_t>(access_t::write)) || ...);
+    }
+
+    template <typename Accesses>
+    sel_split_return_type find_split_row(const key_type& key, const Accesses& accesses) {
+        Index& mine = local();
+        auto r = mine.select_split_row(key, accesses);
+        if (replicas_.size() == 1 || !writes(accesses) || !std::get<0>(r) || !std::get<1>(r))
+            return r;
+        auto item = Sto::item(this, std::get<2>(r));
+        if (item.has_stash())
+            return r;
+        auto copies = Sto::tx_alloc<copy_rids>();
+        for (size_t i = 0; i != replicas_.size(); ++i) {
+            if (replicas_[i].get() == &mine) {
+                copies->rid[i] = std::get<2>(r);
+                continue;
+            }
+            auto [ok, found, rid, value] = replicas_[i]->select_split_row(key, accesses);
+            (void)value;
+            always_assert(!ok || found, "replicas disagree on a row");
+            if (!ok)
+                return {false, false, 0, std::get<3>(r)};
+            copies->rid[i] = rid;
+        }
+        item.set_stash(copies);
+        return r;
+    }
+
+    template <typename F>
+    void for_each_copy(uintptr_t rid, F f) {
+        if (replicas_.size() == 1) {
+            f(*replicas_[0], rid);
+            return;
+        }
+        auto item = Sto::check_item(this, rid);
+        always_assert(item && item->has_stash(), "update of a row not selected for writing");
+        copy_rids* copies = item->template stash_value<copy_rids*>();
+        for (size_t i = 0; i != replicas_.size(); ++i)
+            f(*replicas_[i], copies->rid[i]);
+    }
+};
+
+} // namespace bench
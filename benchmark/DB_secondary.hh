@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "Transaction.hh"
+
+namespace bench {
+
+// Secondary index entries to add once the running transaction commits,
+// queued per thread. They are applied with nontrans_put after the
+// transaction has unlocked, so they cost no tset items and no commit
+// locks, and dropped if it aborts. Until then no transaction sees them,
+// including the one that queued them.
+class deferred_index_updates {
+public:
+    template <typename Index>
+    static void push(Index& index, const typename Index::key_type& k,
+                     const typename Index::value_type& v) {
+        typedef typename Index::key_type key_type;
+        typedef typename Index::value_type value_type;
+        static_assert(std::is_trivially_copyable<key_type>::value
+                      && std::is_trivially_copyable<value_type>::value,
+                      "deferred entries are copied as bytes");
+        queue& q = queue_;
+        if (q.hooked_id != TThread::id()) {
+            Transaction::tinfo[TThread::id()].trans_done_callback = finish;
+            q.hooked_id = TThread::id();
+        }
+        header h{&apply<Index>, &index, sizeof(key_type) + sizeof(value_type)};
+        size_t at = q.bytes.size();
+        q.bytes.resize(at + sizeof(h) + h.size);
+        memcpy(&q.bytes[at], &h, sizeof(h));
+        memcpy(&q.bytes[at + sizeof(h)], &k, sizeof(k));
+        memcpy(&q.bytes[at + sizeof(h) + sizeof(k)], &v, sizeof(v));
+    }
+
+    static bool empty() {
+        return queue_.bytes.empty();
+    }
+
+    // Applies the queued entries if the transaction committed, and drops
+    // them either way
+    static void finish(bool committed) {
+        queue& q = queue_;
+        if (committed)
+            for (size_t at = 0; at != q.bytes.size(); ) {
+                header h;
+                memcpy(&h, &q.bytes[at], sizeof(h));
+                h.apply(h.index, &q.bytes[at + sizeof(h)]);
+                at += sizeof(h) + h.size;
+            }
+        q.bytes.clear();
+    }
+
+private:
+    struct header {
+        void (*apply)(void* index, const char* entry);
+        void* index;
+        size_t size;
+    };
+    struct queue {
+        std::vector<char> bytes;
+        int hooked_id;
+        queue()
+            : hooked_id(-1) {}
+    };
+
+    template <typename Index>
+    static void apply(void* index, const char* entry) {
+        typedef typename Index::key_type key_type;
+        typedef typename Index::value_type value_type;
+        alignas(key_type) char k[sizeof(key_type)];
+        alignas(value_type) char v[sizeof(value_type)];
+        memcpy(k, entry, sizeof(k));
+        memcpy(v, entry + sizeof(k), sizeof(v));
+        static_cast<Index*>(index)->nontrans_put(*reinterpret_cast<const key_type*>(k),
+                                                  *reinterpret_cast<const value_type*>(v));
+    }
+
+    static inline thread_local queue queue_;
+};
+
+// A secondary index kept from the rows of a primary index: key_of(k, row)
+// gives the secondary key of primary key k and its row. Inserting a row
+// through insert_row() adds its secondary entry in the same transaction,
+// or, when deferred, through deferred_index_updates after it commits.
+// Deferral suits non-unique indexes whose keys embed the primary key, so
+// entries never collide, and whose readers can miss an entry for the
+// moment between a commit and its application.
+template <typename Primary, typename Secondary, typename KeyOf>
+class secondary_index {
+public:
+    typedef typename Primary::key_type key_type;
+    typedef typename Primary::value_type value_type;
+    typedef typename Secondary::key_type secondary_key_type;
+    typedef typename Secondary::value_type secondary_value_type;
+
+    secondary_index(Primary& primary, Secondary& secondary, bool deferred, KeyOf key_of = KeyOf())
+        : primary_(primary), secondary_(secondary), deferred_(deferred), key_of_(key_of) {}
+
+    Primary& primary() {
+        return primary_;
+    }
+    Secondary& secondary() {
+        return secondary_;
+    }
+    bool deferred() const {
+        return deferred_;
+    }
+
+    // Same results as Primary::insert_row; the secondary entry is added
+    // only when the primary key was absent
+    std::tuple<bool, bool>
+    insert_row(const key_type& k, value_type* vptr, secondary_value_type* svptr) {
+        auto [success, found] = primary_.insert_row(k, vptr, false);
+        if (!success || found)
+            return {success, found};
+        secondary_key_type sk = key_of_(k, *vptr);
+        if (deferred_) {
+            deferred_index_updates::push(secondary_, sk, *svptr);
+            return {true, false};
+        }
+        std::tie(success, found) = secondary_.insert_row(sk, svptr, false);
+        return {success, false};
+    }
+
+private:
+    Primary& primary_;
+    Secondary& secondary_;
+    bool deferred_;
+    KeyOf key_of_;
+};
+
+} // namespace bench
@@ -0,0 +1,662 @@
+#pragma once
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "PlatformFeatures.hh"
+#include "Sto.hh"
+#include "sampling.hh"
+#include "DB_latency.hh"
+
+namespace bench {
+
+// Wire format of txn_server, in host byte order: a request is a header
+// followed by length bytes of arguments for procedure proc, and its
+// response a header followed by length bytes of result. A connection's
+// responses come back in the order of its requests; id is the client's
+// and is echoed.
+struct server_request {
+    uint32_t length;
+    uint16_t proc;
+    uint16_t flags;
+    uint64_t id;
+};
+struct server_response {
+    uint32_t length;
+    uint16_t status;
+    uint16_t pad;
+    uint64_t id;
+};
+enum server_status : uint16_t {
+    status_ok = 0,
+    status_failed = 1,       // the procedure's own failure
+    status_no_proc = 2,
+    status_too_large = 3     // the connection is closed after this
+};
+
+// Serves stored procedures over TCP. Each of nworkers worker threads runs
+// its own event loop (epoll) on its own listening socket, bound to one
+// port with SO_REUSEPORT, so the kernel spreads connections over the
+// workers and a connection stays on its worker, pinned (set_affinity) to
+// one core. A worker runs as TThread id first_thread_id + i.
+//
+// Each pass of a worker's loop reads everything its ready connections
+// sent, runs the whole batch of requests, and writes each connection's
+// responses with one send, so pipelined requests share the loop's
+// syscalls. Procedures added with add_txn_procedure run inside a
+// transaction the worker opens, and up to group consecutive ones of a
+// batch share one transaction (all retry if it aborts on a conflict),
+// amortizing Transaction::start() and commit. A procedure that throws
+// user_abort fails only its own request: the transaction is rolled back
+// and the rest of the group runs again without it. Procedures added with
+// add_procedure run their own transactions.
+class txn_server {
+public:
+    // Reads its arguments [args, args + len), appends its result to out
+    // and returns a status. A transactional procedure may run again, with
+    // out cleared, when its transaction aborts on a conflict
+    // (Transaction::Abort, TXN_DO_E). To fail its request and undo its
+    // writes, it throws user_abort; the client gets status_failed and
+    // whatever the procedure appended to out.
+    typedef std::function<uint16_t(const char* args, size_t len, std::string& out, int worker)> procedure;
+    struct user_abort {};
+
+    struct params {
+        int nworkers = 1;
+        int port = 0;               // 0 picks a free one; see port()
+        int first_thread_id = 0;
+        bool pin = true;
+        unsigned group = 1;         // transactional requests per transaction
+        size_t max_request = 1 << 20;
+    };
+    struct stats {
+        uint64_t connections = 0;
+        uint64_t requests = 0;
+        uint64_t batches = 0;       // loop passes that ran requests
+        uint64_t transactions = 0;  // opened for transactional procedures
+    };
+
+    explicit txn_server(const params& p)
+        : params_(p), port_(p.port), stopping_(false), workers_(std::max(p.nworkers, 1)) {
+        params_.nworkers = workers_.size();
+        params_.group = std::max(params_.group, 1u);
+    }
+    ~txn_server() {
+        stop();
+    }
+
+    void add_procedure(uint16_t proc, procedure f) {
+        procs_[proc] = {std::move(f), false};
+    }
+    void add_txn_procedure(uint16_t proc, procedure f) {
+        procs_[proc] = {std::move(f), true};
+    }
+    // Runs f(i) on worker i before it serves, e.g. to initialize tables
+    // for the thread
+    void on_worker_start(std::function<void(int)> f) {
+        worker_init_ = std::move(f);
+    }
+
+    // Listens and starts the workers; false if a socket can't be bound
+    bool start() {
+        for (auto& w : workers_) {
+            w.listen_fd = listen_on(port_);
+            if (w.listen_fd < 0) {
+                close_listeners();
+                return false;
+            }
+            if (!port_) {
+                sockaddr_in a;
+                socklen_t len = sizeof(a);
+                getsockname(w.listen_fd, reinterpret_cast<sockaddr*>(&a), &len);
+                port_ = ntohs(a.sin_port);
+            }
+        }
+        for (int i = 0; i != params_.nworkers; ++i)
+            workers_[i].thread = std::thread(&txn_server::run_worker, this, i);
+        return true;
+    }
+    // Stops the workers and closes every connection
+    void stop() {
+        stopping_.store(true, std::memory_order_release);
+        for (auto& w : workers_)
+            if (w.thread.joinable())
+                w.thread.join();
+        close_listeners();
+    }
+
+    int port() const {
+        return port_;
+    }
+    stats statistics() const {
+        stats s;
+        for (auto& w : workers_) {
+            s.connections += w.connections.load(std::memory_order_relaxed);
+            s.requests += w.requests.load(std::memory_order_relaxed);
+            s.batches += w.batches.load(std::memory_order_relaxed);
+            s.transactions += w.transactions.load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    struct entry {
+        procedure f;
+        bool in_txn;
+    };
+    struct connection {
+        int fd;
+        std::vector<char> in;
+        size_t parsed = 0;          // bytes of in taken by the batch
+        std::string out;
+        size_t sent = 0;
+        bool want_write = false;    // EPOLLOUT registered
+        bool closing = false;
+    };
+    struct call {
+        connection* c;
+        server_request h;
+        size_t args;                // offset in c->in
+    };
+    struct __attribute__((aligned(128))) worker {
+        int listen_fd = -1;
+        std::thread thread;
+        std::atomic<uint64_t> connections{0};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> transactions{0};
+    };
+
+    static constexpr size_t read_chunk = 64 << 10;
+    // a connection whose responses back up this far isn't read until
+    // they drain
+    static constexpr size_t out_limit = 4 << 20;
+
+    params params_;
+    int port_;
+    std::atomic<bool> stopping_;
+    std::vector<worker> workers_;
+    std::unordered_map<uint16_t, entry> procs_;
+    std::function<void(int)> worker_init_;
+
+    static int listen_on(int port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0)
+            return -1;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+        sockaddr_in a = {};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_ANY);
+        a.sin_port = htons(port);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) != 0 || listen(fd, 1024) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    void close_listeners() {
+        for (auto& w : workers_)
+            if (w.listen_fd >= 0) {
+                close(w.listen_fd);
+                w.listen_fd = -1;
+            }
+    }
+
+    static void bump(std::atomic<uint64_t>& x, uint64_t n = 1) {
+        x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static void respond(connection* c, uint64_t id, uint16_t status, const std::string& result) {
+        server_response h = {uint32_t(result.size()), status, 0, id};
+        c->out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+        c->out.append(result);
+    }
+
+    // Reads what c sent and queues its complete requests
+    void read_requests(connection* c, std::vector<call>& batch) {
+        while (!c->closing && c->out.size() - c->sent < out_limit) {
+            size_t at = c->in.size();
+            c->in.resize(at + read_chunk);
+            ssize_t r = read(c->fd, &c->in[at], read_chunk);
+            c->in.resize(at + std::max(r, ssize_t(0)));
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (r <= 0)
+                c->closing = true;
+            else if (size_t(r) == read_chunk)
+                continue;
+            break;
+        }
+        while (c->in.size() - c->parsed >= sizeof(server_request)) {
+            server_request h;
+            memcpy(&h, &c->in[c->parsed], sizeof(h));
+            if (h.length > params_.max_request) {
+                respond(c, h.id, status_too_large, std::string());
+                c->closing = true;
+                break;
+            }
+            if (c->in.size() - c->parsed < sizeof(h) + h.length)
+                break;
+            batch.push_back({c, h, c->parsed + sizeof(h)});
+            c->parsed += sizeof(h) + h.length;
+        }
+    }
+
+    // Runs the batch, appending responses to their connections
+    void run_batch(int i, std::vector<call>& batch, std::vector<std::string>& outs,
+                   std::vector<uint16_t>& statuses, std::vector<bool>& failed) {
+        worker& w = workers_[i];
+        size_t b = 0;
+        while (b != batch.size()) {
+            auto it = procs_.find(batch[b].h.proc);
+            if (it == procs_.end()) {
+                respond(batch[b].c, batch[b].h.id, status_no_proc, std::string());
+                ++b;
+                continue;
+            }
+            const entry& p = it->second;
+            if (!p.in_txn) {
+                outs[0].clear();
+                uint16_t st = p.f(&batch[b].c->in[batch[b].args], batch[b].h.length, outs[0], i);
+                respond(batch[b].c, batch[b].h.id, st, outs[0]);
+                ++b;
+                continue;
+            }
+            // this and the transactional requests right after it
+            size_t e = b + 1;
+            while (e != batch.size() && e - b < params_.group) {
+                auto nx = procs_.find(batch[e].h.proc);
+                if (nx == procs_.end() || !nx->second.in_txn)
+                    break;
+                ++e;
+            }
+            std::fill(failed.begin(), failed.begin() + (e - b), false);
+            while (true) {
+                size_t k = b;
+                try {
+                    TRANSACTION_E {
+                        for (k = b; k != e; ++k) {
+                            if (failed[k - b])
+                                continue;
+                            outs[k - b].clear();
+                            statuses[k - b] = procs_.find(batch[k].h.proc)->second.f(
+                                &batch[k].c->in[batch[k].args], batch[k].h.length, outs[k - b], i);
+                        }
+                    } RETRY_E(true);
+                    break;
+                } catch (user_abort&) {
+                    // the guard rolled the transaction back; rerun the
+                    // others without request k
+                    failed[k - b] = true;
+                    statuses[k - b] = status_failed;
+                }
+            }
+            for (size_t k = b; k != e; ++k)
+                respond(batch[k].c, batch[k].h.id, statuses[k - b], outs[k - b]);
+            bump(w.transactions);
+            b = e;
+        }
+        bump(w.requests, batch.size());
+        bump(w.batches);
+    }
+
+    // Sends c's queued responses; false if c should close
+    static bool flush(int ep, connection* c) {
+        while (c->sent != c->out.size()) {
+            ssize_t r = send(c->fd, c->out.data() + c->sent, c->out.size() - c->sent, MSG_NOSIGNAL);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (r <= 0)
+                return false;
+            c->sent += r;
+        }
+        if (c->sent == c->out.size()) {
+            c->out.clear();
+            c->sent = 0;
+        }
+        bool want = !c->out.empty();
+        if (want != c->want_write) {
+            epoll_event ev = {};
+            ev.events = EPOLLIN | (want ? uint32_t(EPOLLOUT) : 0u);
+            ev.data.ptr = c;
+            epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+            c->want_write = want;
+        }
+        return true;
+    }
+
+    void run_worker(int i) {
+        worker& w = workers_[i];
+        TThread::set_id(params_.first_thread_id + i);
+        if (params_.pin)
+            set_affinity(i);
+        if (worker_init_)
+            worker_init_(i);
+
+        int ep = epoll_create1(0);
+        always_assert(ep >= 0);
+        epoll_event lev = {};
+        lev.events = EPOLLIN;
+        lev.data.ptr = nullptr;     // the listener
+        epoll_ctl(ep, EPOLL_CTL_ADD, w.listen_fd, &lev);
+
+        std::unordered_map<connection*, std::unique_ptr<connection>> conns;
+        std::vector<epoll_event> events(256);
+        std::vector<call> batch;
+        std::vector<connection*> touched;
+        std::vector<std::string> outs(params_.group);
+        std::vector<uint16_t> statuses(params_.group);
+        std::vector<bool> failed(params_.group);
+        while (!stopping_.load(std::memory_order_acquire)) {
+            int n = epoll_wait(ep, events.data(), events.size(), 10);
+            batch.clear();
+            touched.clear();
+            for (int k = 0; k < n; ++k) {
+                connection* c = static_cast<connection*>(events[k].data.ptr);
+                if (!c) {
+                    int fd;
+                    while ((fd = accept4(w.listen_fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                        int one = 1;
+                        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                        auto nc = std::make_unique<connection>();
+                        nc->fd = fd;
+                        epoll_event ev = {};
+                        ev.events = EPOLLIN;
+                        ev.data.ptr = nc.get();
+                        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+                        conns[nc.get()] = std::move(nc);
+                        bump(w.connections);
+                    }
+                    continue;
+                }
+                if (events[k].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                    read_requests(c, batch);
+                touched.push_back(c);
+            }
+            if (!batch.empty())
+                run_batch(i, batch, outs, statuses, failed);
+            for (connection* c : touched) {
+                if (c->fd < 0)
+                    continue;
+                if (c->parsed) {
+                    c->in.erase(c->in.begin(), c->in.begin() + c->parsed);
+                    c->parsed = 0;
+                }
+                if (!flush(ep, c) || (c->closing && c->out.empty())) {
+                    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, nullptr);
+                    close(c->fd);
+                    c->fd = -1;
+                }
+            }
+            for (connection* c : touched)
+                if (c->fd < 0)
+                    conns.erase(c);
+        }
+        for (auto& kv : conns)
+            close(kv.first->fd);
+        close(ep);
+    }
+};
+
+// A closed-loop load generator for txn_server. Each of nthreads threads
+// opens connections to the server and keeps depth requests outstanding
+// on each, pipelined; a request's latency runs from the send of the pass
+// that queued it to the arrival of its response. Threads send each
+// connection's new requests with one write per pass.
+class txn_client {
+public:
+    // Fills args with a request's arguments and returns its procedure
+    typedef std::function<uint16_t(std::string& args, sampling::xoshiro256ss& rng)> generator;
+
+    struct params {
+        std::string host = "127.0.0.1";
+        int port = 0;
+        int nthreads = 1;
+        int connections = 1;        // per thread
+        int depth = 1;              // outstanding requests per connection
+        double seconds = 10;
+        uint64_t requests = 0;      // per connection, if nonzero, to stop sooner
+        uint64_t seed = 0;
+    };
+    struct result {
+        uint64_t completed = 0;
+        uint64_t failed = 0;        // responses with a status other than ok
+        uint64_t bytes_sent = 0;
+        uint64_t bytes_received = 0;
+        double seconds = 0;
+        latency_histogram latency;  // nanoseconds
+
+        double throughput() const {
+            return seconds > 0 ? completed / seconds : 0;
+        }
+    };
+
+    explicit txn_client(const params& p)
+        : params_(p) {
+    }
+
+    // False if a connection fails
+    bool run(generator g, result& out) {
+        std::vector<result> results(params_.nthreads);
+        std::vector<char> ok(params_.nthreads, false);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t != params_.nthreads; ++t)
+            threads.emplace_back([&, t] { ok[t] = run_thread(t, g, results[t]); });
+        for (auto& th : threads)
+            th.join();
+        out = result();
+        out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (auto& r : results) {
+            out.completed += r.completed;
+            out.failed += r.failed;
+            out.bytes_sent += r.bytes_sent;
+            out.bytes_received += r.bytes_received;
+            out.latency.merge(r.latency);
+        }
+        return std::all_of(ok.begin(), ok.end(), [](char x) { return x; });
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct connection {
+        int fd = -1;
+        std::string out;
+        size_t sent = 0;
+        std::vector<char> in;
+        std::deque<clock::time_point> pending;  // send times, in request order
+        uint64_t issued = 0;
+        bool want_write = false;
+    };
+
+    params params_;
+
+    int connect_to() const {
+        addrinfo hints = {}, *res = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(params_.host.c_str(), std::to_string(params_.port).c_str(), &hints, &res) != 0)
+            return -1;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(res);
+        if (fd >= 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            int flags = fcntl(fd, F_GETFL);
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+        return fd;
+    }
+
+    void issue(connection& c, generator& g, sampling::xoshiro256ss& rng, std::string& args,
+               clock::time_point now) {
+        args.clear();
+        server_request h;
+        h.proc = g(args, rng);
+        h.length = args.size();
+        h.flags = 0;
+        h.id = c.issued++;
+        c.out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+        c.out.append(args);
+        c.pending.push_back(now);
+    }
+
+    bool run_thread(int t, generator& g, result& r) {
+        sampling::xoshiro256ss rng(params_.seed + t);
+        std::vector<connection> conns(params_.connections);
+        int ep = epoll_create1(0);
+        if (ep < 0)
+            return false;
+        bool ok = true;
+        for (auto& c : conns) {
+            c.fd = connect_to();
+            if (c.fd < 0) {
+                ok = false;
+                break;
+            }
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.ptr = &c;
+            epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev);
+        }
+
+        auto deadline = clock::now() + std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(params_.seconds));
+        auto more = [&](const connection& c, clock::time_point now) {
+            return now < deadline && (!params_.requests || c.issued < params_.requests);
+        };
+        std::string args;
+        auto now = clock::now();
+        if (ok)
+            for (auto& c : conns) {
+                while (int(c.pending.size()) < params_.depth && more(c, now))
+                    issue(c, g, rng, args, now);
+                ok = ok && send_out(ep, c, r);
+            }
+
+        std::vector<epoll_event> events(conns.size());
+        size_t outstanding = 0;
+        while (ok) {
+            outstanding = 0;
+            for (auto& c : conns)
+                outstanding += c.pending.size();
+            // after the deadline, drain what's outstanding for up to a second
+            now = clock::now();
+            if (!outstanding || now > deadline + std::chrono::seconds(1))
+                break;
+            int n = epoll_wait(ep, events.data(), events.size(), 10);
+            now = clock::now();
+            for (int k = 0; k < n && ok; ++k) {
+                connection& c = *static_cast<connection*>(events[k].data.ptr);
+                if (events[k].events & EPOLLOUT)
+                    ok = send_out(ep, c, r);
+                if (ok && (events[k].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                    ok = receive(c, r, now);
+                while (ok && int(c.pending.size()) < params_.depth && more(c, now))
+                    issue(c, g, rng, args, now);
+                ok = ok && send_out(ep, c, r);
+            }
+        }
+        for (auto& c : conns)
+            if (c.fd >= 0)
+                close(c.fd);
+        close(ep);
+        return ok && !outstanding;
+    }
+
+    static bool send_out(int ep, connection& c, result& r) {
+        while (c.sent != c.out.size()) {
+            ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (n <= 0)
+                return false;
+            c.sent += n;
+            r.bytes_sent += n;
+        }
+        if (c.sent == c.out.size()) {
+            c.out.clear();
+            c.sent = 0;
+        }
+        bool want = !c.out.empty();
+        if (want != c.want_write) {
+            epoll_event ev = {};
+            ev.events = EPOLLIN | (want ? uint32_t(EPOLLOUT) : 0u);
+            ev.data.ptr = &c;
+            epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &ev);
+            c.want_write = want;
+        }
+        return true;
+    }
+
+    static bool receive(connection& c, result& r, clock::time_point now) {
+        char buf[64 << 10];
+        bool open = true;
+        while (true) {
+            ssize_t n = read(c.fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (n <= 0) {
+                // count what came before the server hung up
+                open = false;
+                break;
+            }
+            c.in.insert(c.in.end(), buf, buf + n);
+            r.bytes_received += n;
+        }
+        size_t pos = 0;
+        while (c.in.size() - pos >= sizeof(server_response)) {
+            server_response h;
+            memcpy(&h, &c.in[pos], sizeof(h));
+            if (c.in.size() - pos < sizeof(h) + h.length)
+                break;
+            if (c.pending.empty())
+                return false;
+            r.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - c.pending.front()).count());
+            c.pending.pop_front();
+            ++r.completed;
+            if (h.status != status_ok)
+                ++r.failed;
+            if (h.status == status_too_large)
+                return false;
+            pos += sizeof(h) + h.length;
+        }
+        c.in.erase(c.in.begin(), c.in.begin() + pos);
+        return open;
+    }
+};
+
+} // namespace bench
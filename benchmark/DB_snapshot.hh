@@ -0,0 +1,206 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "AsyncIO.hh"
+#include "DB_index.hh"
+
+namespace bench {
+
+// Columnar snapshot of one MVCC table, as written by mvcc_snapshot_dumper:
+//
+//   [header, header_bytes][block 0][block 1]...[block nblocks-1]
+//
+// Each block is block_bytes long (page aligned) and holds up to
+// rows_per_block rows, stored column by column: the keys, then split 0,
+// split 1, ... (the SplitParams<value_type> column groups). Column c of
+// block b starts at
+//
+//   header_bytes + b * block_bytes + rows_per_block * column_offset[c]
+//
+// and holds byte images of the key or split struct, column_size[c] bytes
+// each, so the file can be mmapped and read back with the same types.
+struct mvcc_snapshot_header {
+    static constexpr size_t header_bytes = 4096;
+    static constexpr unsigned max_columns = 64;
+
+    char magic[8];          // "STOSNAP1"
+    uint64_t tid;           // snapshot read tid
+    uint64_t nrows;
+    uint64_t nblocks;
+    uint64_t block_bytes;
+    uint32_t rows_per_block;
+    uint32_t ncolumns;      // key column + one per split
+    uint64_t column_size[max_columns];
+    uint64_t column_offset[max_columns];  // sum of earlier column sizes
+};
+static_assert(sizeof(mvcc_snapshot_header) <= mvcc_snapshot_header::header_bytes,
+              "Snapshot header too large.");
+
+// Dumps an mvcc_ordered_index or mvcc_unordered_index as of a pinned
+// snapshot from a background thread. Rows are read outside any
+// transaction, so OLTP workers are never blocked; the pin does hold back
+// GC until the dump finishes. Blocks are written through AsyncIO, with
+// direct I/O where the file system allows it, while the next block
+// fills, so memory use is two blocks.
+template <typename IndexType>
+class mvcc_snapshot_dumper {
+public:
+    typedef typename IndexType::key_type key_type;
+    typedef typename IndexType::value_type value_type;
+    typedef SplitParams<value_type> split_params;
+    static constexpr size_t num_splits = split_params::num_splits;
+    static constexpr unsigned ncolumns = num_splits + 1;
+    static_assert(ncolumns <= mvcc_snapshot_header::max_columns, "Too many splits.");
+
+    // thread_id is the TThread id the dumper thread runs as
+    mvcc_snapshot_dumper(IndexType& index, std::string path, int thread_id,
+                         unsigned rows_per_block = 4096)
+        : index_(index), path_(std::move(path)), thread_id_(thread_id),
+          pin_slot_(-1), fd_(-1), ok_(true), block_rows_(0), block_(nullptr), spare_(nullptr),
+          io_(2) {
+        assert(rows_per_block > 0);
+        memset(&hdr_, 0, sizeof(hdr_));
+        memcpy(hdr_.magic, "STOSNAP1", sizeof(hdr_.magic));
+        hdr_.rows_per_block = rows_per_block;
+        hdr_.ncolumns = ncolumns;
+        init_columns(std::make_index_sequence<num_splits>());
+        uint64_t row_bytes = 0;
+        for (unsigned c = 0; c != ncolumns; ++c) {
+            hdr_.column_offset[c] = row_bytes;
+            row_bytes += hdr_.column_size[c];
+        }
+        const uint64_t page = mvcc_snapshot_header::header_bytes;
+        hdr_.block_bytes = (row_bytes * rows_per_block + page - 1) / page * page;
+    }
+    ~mvcc_snapshot_dumper() {
+        join();
+    }
+
+    // Pins the current snapshot and starts dumping it
+    void start() {
+        TransactionTid::type tid;
+        pin_slot_ = Transaction::pin_snapshot(tid);
+        start(tid);
+    }
+    // Starts dumping the snapshot at tid, which the caller keeps pinned
+    // (SnapshotPin) until join() returns; dumpers sharing a pin write
+    // files that agree with each other
+    void start(TransactionTid::type tid) {
+        assert(!thread_.joinable());
+        hdr_.tid = tid;
+        thread_ = std::thread(&mvcc_snapshot_dumper::run, this);
+    }
+    // Waits for the dump; false if the file couldn't be written
+    bool join() {
+        if (thread_.joinable())
+            thread_.join();
+        return ok_;
+    }
+
+    TransactionTid::type tid() const {
+        return hdr_.tid;
+    }
+    uint64_t rows() const {
+        return hdr_.nrows;
+    }
+
+private:
+    IndexType& index_;
+    std::string path_;
+    int thread_id_;
+    int pin_slot_;
+    int fd_;
+    bool ok_;
+    unsigned block_rows_;
+    mvcc_snapshot_header hdr_;
+    char* block_;   // being filled
+    char* spare_;   // being written, or free
+    AsyncIO io_;
+    std::thread thread_;
+
+    template <size_t... I>
+    void init_columns(std::index_sequence<I...>) {
+        hdr_.column_size[0] = sizeof(key_type);
+        ((hdr_.column_size[I + 1] =
+          sizeof(std::tuple_element_t<I, typename split_params::split_type_list>)), ...);
+    }
+
+    char* cell(unsigned c, unsigned row) {
+        return block_ + hdr_.rows_per_block * hdr_.column_offset[c]
+               + row * hdr_.column_size[c];
+    }
+
+    void run() {
+        TThread::set_id(thread_id_);
+        IndexType::thread_init();
+        const size_t page = mvcc_snapshot_header::header_bytes;
+        fd_ = AsyncIO::open_direct(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        void* p = nullptr;
+        if (fd_ < 0 || posix_memalign(&p, page, 2 * hdr_.block_bytes) != 0) {
+            ok_ = false;
+        } else {
+            memset(p, 0, 2 * hdr_.block_bytes);
+            block_ = reinterpret_cast<char*>(p);
+            spare_ = block_ + hdr_.block_bytes;
+            struct iovec iov = {p, 2 * hdr_.block_bytes};
+            io_.register_buffers(&iov, 1);
+            index_.scan_splits_as_of(hdr_.tid,
+                [this] (const key_type& key, const std::array<void*, num_splits>& split_values) {
+                    append(key, split_values);
+                    return ok_;
+                });
+            if (block_rows_)
+                flush_block();
+            // the header page, once both blocks are written
+            ok_ = io_.wait() && ok_;
+            memset(block_, 0, page);
+            memcpy(block_, &hdr_, sizeof(hdr_));
+            io_.write(fd_, block_, page, 0);
+            ok_ = io_.flush() && ok_;
+        }
+        if (fd_ >= 0 && ::close(fd_) != 0)
+            ok_ = false;
+        fd_ = -1;
+        free(p);
+        block_ = spare_ = nullptr;
+        if (pin_slot_ >= 0)
+            Transaction::unpin_snapshot(pin_slot_);
+        pin_slot_ = -1;
+    }
+
+    void append(const key_type& key, const std::array<void*, num_splits>& split_values) {
+        memcpy(cell(0, block_rows_), &key, sizeof(key_type));
+        for (unsigned i = 0; i != num_splits; ++i)
+            memcpy(cell(i + 1, block_rows_), split_values[i], hdr_.column_size[i + 1]);
+        ++hdr_.nrows;
+        if (++block_rows_ == hdr_.rows_per_block)
+            flush_block();
+    }
+
+    // Submits the block and switches buffers once the block before is
+    // written
+    void flush_block() {
+        // zero the unused tail of each column in a final, partial block
+        if (block_rows_ != hdr_.rows_per_block)
+            for (unsigned c = 0; c != ncolumns; ++c)
+                memset(cell(c, block_rows_), 0,
+                       (hdr_.rows_per_block - block_rows_) * hdr_.column_size[c]);
+        ok_ = io_.wait() && ok_;
+        io_.write(fd_, block_, hdr_.block_bytes,
+                  mvcc_snapshot_header::header_bytes + hdr_.nblocks * hdr_.block_bytes);
+        io_.submit();
+        std::swap(block_, spare_);
+        ++hdr_.nblocks;
+        block_rows_ = 0;
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace bench {
+
+// Byte-string equality and memcmp-style comparison for keys and string
+// columns. Strings of 16 bytes or more are compared 16 bytes at a time with
+// SSE2, which every x86-64 target has, so no runtime dispatch is needed; the
+// last chunk overlaps the previous one instead of running a byte loop.
+// Shorter strings go to memcmp, which the compiler inlines for a constant n.
+
+#if defined(__SSE2__)
+inline bool bytes_equal_sse2(const char* a, const char* b, size_t n) {
+    __m128i diff = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 < n; i += 16)
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+    i = n - 16;
+    diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xFFFF;
+}
+
+inline int bytes_compare_sse2(const char* a, const char* b, size_t n) {
+    for (size_t i = 0;; i += 16) {
+        if (i + 16 > n)
+            i = n - 16;
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        unsigned m = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) & 0xFFFF;
+        if (m) {
+            i += __builtin_ctz(m);
+            return int(static_cast<unsigned char>(a[i])) - int(static_cast<unsigned char>(b[i]));
+        }
+        if (i + 16 == n)
+            return 0;
+    }
+}
+#endif
+
+inline bool bytes_equal(const char* a, const char* b, size_t n) {
+#if defined(__SSE2__)
+    if (n >= 16)
+        return bytes_equal_sse2(a, b, n);
+#endif
+    return memcmp(a, b, n) == 0;
+}
+
+// < 0, 0, > 0 as memcmp
+inline int bytes_compare(const char* a, const char* b, size_t n) {
+#if defined(__SSE2__)
+    if (n >= 16)
+        return bytes_compare_sse2(a, b, n);
+#endif
+    return memcmp(a, b, n);
+}
+
+template <size_t N>
+inline bool bytes_equal(const void* a, const void* b) {
+    return bytes_equal(static_cast<const char*>(a), static_cast<const char*>(b), N);
+}
+
+template <size_t N>
+inline int bytes_compare(const void* a, const void* b) {
+    return bytes_compare(static_cast<const char*>(a), static_cast<const char*>(b), N);
+}
+
+// Hash of N bytes, for fixed-size keys: each 8-byte word is folded in with
+// a 64x64->128-bit multiply (as in wyhash), so a 16-byte key costs three
+// multiplies and the loop unrolls for constant N. Header-only, so index
+// users need not link a hash library.
+inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+template <size_t N>
+inline size_t hash_bytes(const void* p) {
+    constexpr uint64_t k0 = 0xa0761d6478bd642fULL, k1 = 0xe7037ed1a0b428dbULL;
+    auto s = static_cast<const char*>(p);
+    uint64_t h = k0 ^ N;
+    size_t i = 0;
+    for (; i + 8 <= N; i += 8) {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        h = hash_mix(h ^ w, k1);
+    }
+    if (i < N) {
+        uint64_t w = 0;
+        memcpy(&w, s + i, N - i);
+        h = hash_mix(h ^ w, k1);
+    }
+    return hash_mix(h ^ k0, k1 ^ N);
+}
+
+template <size_t ML>
+using string_length_t = std::conditional_t<(ML < 256), uint8_t,
+                                           std::conditional_t<(ML < 65536), uint16_t, uint32_t>>;
+
+// String of at most ML bytes stored as its length and bytes, without the
+// terminator of var_string or the padding of fix_string, so length() is
+// constant time and comparisons touch only the bytes in use. Trivially
+// copyable, so it can be part of a key.
+template <size_t ML>
+class __attribute__((packed)) inline_string {
+public:
+    static constexpr size_t max_length = ML;
+
+    inline_string() : len_(0) {}
+    inline_string(const char *c_str) {
+        assign(c_str, strlen(c_str));
+    }
+    inline_string(const std::string &str) {
+        assign(str.data(), str.length());
+    }
+    inline_string(const inline_string&) = default;
+    inline_string &operator=(const inline_string&) = default;
+
+    size_t length() const {
+        return len_;
+    }
+    const char *data() const {
+        return s_;
+    }
+    explicit operator std::string() const {
+        return std::string(s_, len_);
+    }
+
+    bool operator==(const inline_string &rhs) const {
+        return len_ == rhs.len_ && bytes_equal(s_, rhs.s_, len_);
+    }
+    bool operator!=(const inline_string &rhs) const {
+        return !(*this == rhs);
+    }
+    bool operator==(const char *c_str) const {
+        return strlen(c_str) == len_ && bytes_equal(s_, c_str, len_);
+    }
+    bool operator==(const std::string &str) const {
+        return str.length() == len_ && bytes_equal(s_, str.data(), len_);
+    }
+    bool operator<(const inline_string &rhs) const {
+        return compare(rhs) < 0;
+    }
+    int compare(const inline_string &rhs) const {
+        int c = bytes_compare(s_, rhs.s_, std::min<size_t>(len_, rhs.len_));
+        return c ? c : int(len_) - int(rhs.len_);
+    }
+
+private:
+    void assign(const char *str, size_t len) {
+        len_ = std::min(len, ML);
+        memcpy(s_, str, len_);
+    }
+
+    string_length_t<ML> len_;
+    char s_[ML];
+};
+
+// String of at most ML bytes, as inline_string, whose strings longer than
+// IL bytes move out of line: a row with a wide, mostly short column pays IL
+// bytes for it rather than ML. The string owns its overflow buffer, so it
+// is not trivially copyable: rows holding one must be copied with their
+// copy constructors and assignments, not memcpy, and it can't be part of a
+// key.
+template <size_t ML, size_t IL>
+class __attribute__((packed)) overflow_string {
+public:
+    static constexpr size_t max_length = ML;
+    static constexpr size_t inline_length = IL;
+    static_assert(IL >= sizeof(char*) && IL < ML, "bad inline length");
+
+    overflow_string() : len_(0) {}
+    overflow_string(const char *c_str) : len_(0) {
+        assign(c_str, strlen(c_str));
+    }
+    overflow_string(const std::string &str) : len_(0) {
+        assign(str.data(), str.length());
+    }
+    overflow_string(const overflow_string &other) : len_(0) {
+        assign(other.data(), other.len_);
+    }
+    overflow_string &operator=(const overflow_string &other) {
+        if (this != &other)
+            assign(other.data(), other.len_);
+        return *this;
+    }
+    ~overflow_string() {
+        if (overflowed())
+            delete[] out_of_line();
+    }
+
+    size_t length() const {
+        return len_;
+    }
+    bool overflowed() const {
+        return len_ > IL;
+    }
+    const char *data() const {
+        return overflowed() ? out_of_line() : s_;
+    }
+    explicit operator std::string() const {
+        return std::string(data(), len_);
+    }
+
+    bool operator==(const overflow_string &rhs) const {
+        return len_ == rhs.len_ && bytes_equal(data(), rhs.data(), len_);
+    }
+    bool operator!=(const overflow_string &rhs) const {
+        return !(*this == rhs);
+    }
+    bool operator==(const char *c_str) const {
+        return strlen(c_str) == len_ && bytes_equal(data(), c_str, len_);
+    }
+    bool operator==(const std::string &str) const {
+        return str.length() == len_ && bytes_equal(data(), str.data(), len_);
+    }
+    int compare(const overflow_string &rhs) const {
+        int c = bytes_compare(data(), rhs.data(), std::min<size_t>(len_, rhs.len_));
+        return c ? c : int(len_) - int(rhs.len_);
+    }
+
+private:
+    char *out_of_line() const {
+        char *p;
+        memcpy(&p, s_, sizeof(p));
+        return p;
+    }
+
+    // Reuses an overflow buffer, which always has room for ML bytes
+    void assign(const char *str, size_t len) {
+        len = std::min(len, ML);
+        if (len > IL) {
+            char *p = overflowed() ? out_of_line() : new char[ML];
+            memmove(p, str, len);
+            memcpy(s_, &p, sizeof(p));
+        } else {
+            if (overflowed()) {
+                char *p = out_of_line();
+                memmove(s_, str, len);
+                delete[] p;
+            } else {
+                memmove(s_, str, len);
+            }
+        }
+        len_ = len;
+    }
+
+    string_length_t<ML> len_;
+    char s_[IL];
+};
+
+} // namespace bench
@@ -5,6 +5,8 @@
 #include <string>
 #include <iostream>
 #include <cstring>
+#include <functional>
+#include <type_traits>
 #if defined(__APPLE__)
 #  include <libkern/OSByteOrder.h>
 #  define __bswap_16 OSSwapInt16
@@ -15,6 +17,7 @@
 #endif
 
 #include "str.hh"
+#include "DB_strings.hh"
 
 namespace bench {
 
@@ -119,11 +122,11 @@ public:
     fix_string(const fix_string&) = default;
 
     bool operator==(const char *c_str) const {
-        return strlen(c_str) == FL && !memcmp(s_, c_str, FL);
+        return strlen(c_str) == FL && bytes_equal<FL>(s_, c_str);
     }
 
     bool operator==(const fix_string &rhs) const {
-        return !memcmp(s_, rhs.s_, FL);
+        return bytes_equal<FL>(s_, rhs.s_);
     }
 
     char &operator[](size_t idx) {
@@ -197,8 +200,37 @@ struct masstree_key_adapter : public K {
     operator lcdf::Str() const {
         return lcdf::Str((const char *)this, sizeof(*this));
     }
+
+    // Byte-wise, as masstree orders keys
+    bool operator==(const masstree_key_adapter& other) const {
+        return bytes_equal<sizeof(*this)>(this, &other);
+    }
+    bool operator!=(const masstree_key_adapter& other) const {
+        return !(*this == other);
+    }
+    int compare(const masstree_key_adapter& other) const {
+        return bytes_compare<sizeof(*this)>(this, &other);
+    }
 };
 
+// Default hash policy of the hash indexes: the key type's std::hash if it
+// specializes one, else hash_bytes over the whole key. The fallback needs
+// a key without padding whose equality is byte equality (as for the packed
+// key structs); a key like inline_string, whose == ignores unused bytes,
+// must bring its own std::hash.
+template <typename K, typename = void>
+struct index_hash {
+    static_assert(std::has_unique_object_representations<K>::value,
+                  "key type has padding: specialize std::hash for it");
+    size_t operator()(const K& k) const {
+        return hash_bytes<sizeof(K)>(&k);
+    }
+};
+
+template <typename K>
+struct index_hash<K, std::void_t<decltype(std::hash<K>()(std::declval<const K&>()))>>
+    : public std::hash<K> {};
+
 }; // namespace bench
 
 template <size_t FL>
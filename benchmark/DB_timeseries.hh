@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Transaction.hh"
+
+// Sample commit, abort and GC counters every STO_PROFILE_TIMESERIES ms
+// while a benchmark runs (0: off). Sampling turns the profile counters
+// on (Transaction::set_profile_counters) in any build.
+#ifndef STO_PROFILE_TIMESERIES
+#define STO_PROFILE_TIMESERIES 0
+#endif
+
+// Where db_profiler writes the time series as CSV
+#ifndef STO_PROFILE_TIMESERIES_FILE
+#define STO_PROFILE_TIMESERIES_FILE "timeseries.csv"
+#endif
+
+namespace bench {
+
+// Background thread that snapshots the transaction counters of every
+// registered thread at a fixed interval, so that throughput, abort rates
+// and the RCU backlog can be followed over a run instead of only at its
+// end. Counters are read while their owners update them, so a sample may
+// lag by an increment or two.
+//
+// CSV columns: elapsed ms, then per second since the previous sample:
+// commits, aborts, aborts by reason, commits per thread; then the RCU
+// backlog and the global and active epochs at the sample.
+class timeseries_sampler {
+public:
+    struct abort_reason {
+        txp counter;
+        const char* name;
+    };
+    static constexpr abort_reason abort_reasons[] = {
+        {txp_lock_aborts, "lock"},
+        {txp_observe_lock_aborts, "observe_lock"},
+        {txp_commit_time_aborts, "commit_time"},
+        {txp_aborted_by_others, "by_others"},
+        {txp_budget_aborts, "budget"},
+        {txp_mvcc_lock_status_aborts, "mvcc_lock_status"},
+        {txp_mvcc_lock_vc_aborts, "mvcc_lock_vc"},
+        {txp_mvcc_lock_vis_aborts, "mvcc_lock_vis"},
+        {txp_mvcc_check_aborts, "mvcc_check"},
+        {txp_mvcc_intent_aborts, "mvcc_intent"}
+    };
+    static constexpr unsigned num_reasons = sizeof(abort_reasons) / sizeof(abort_reasons[0]);
+
+    struct sample {
+        uint64_t tsc;
+        uint64_t aborts;
+        uint64_t reasons[num_reasons];
+        uint64_t thread_commits[MAX_THREADS];
+        size_t rcu_backlog;
+        uint64_t global_epoch;
+        uint64_t active_epoch;
+    };
+
+    timeseries_sampler() = default;
+    timeseries_sampler(const timeseries_sampler&) = delete;
+    timeseries_sampler& operator=(const timeseries_sampler&) = delete;
+    ~timeseries_sampler() {
+        stop();
+    }
+
+    // Takes a first sample now, then one every interval_ms
+    void start(unsigned interval_ms) {
+        assert(!thread_.joinable() && interval_ms > 0);
+        Transaction::set_profile_counters(true);
+        samples_.clear();
+        samples_.push_back(take());
+        stop_ = false;
+        thread_ = std::thread([this, interval_ms]() {
+                std::unique_lock<std::mutex> lk(mutex_);
+                while (!cond_.wait_for(lk, std::chrono::milliseconds(interval_ms),
+                                       [this]() { return stop_; }))
+                    samples_.push_back(take());
+            });
+    }
+
+    // Takes a last sample, covering the rest of the run
+    void stop() {
+        if (!thread_.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_one();
+        thread_.join();
+        samples_.push_back(take());
+    }
+
+    const std::vector<sample>& samples() const {
+        return samples_;
+    }
+
+    static sample take() {
+        sample s = {};
+        TThread::for_each_active([&](int id) {
+                txp_counters& p = Transaction::tinfo[id].p_;
+                uint64_t starts = peek(p, txp_total_starts);
+                uint64_t aborts = peek(p, txp_total_aborts);
+                s.thread_commits[id] = starts > aborts ? starts - aborts : 0;
+            });
+        // aborts over all threads, including exited ones
+        for (auto& ti : Transaction::tinfo) {
+            s.aborts += peek(ti.p_, txp_total_aborts);
+            for (unsigned r = 0; r != num_reasons; ++r)
+                s.reasons[r] += peek(ti.p_, abort_reasons[r].counter);
+        }
+        s.rcu_backlog = Transaction::rcu_backlog();
+        s.global_epoch = Transaction::global_epochs.global_epoch.load(std::memory_order_relaxed);
+        s.active_epoch = Transaction::global_epochs.active_epoch.load(std::memory_order_relaxed);
+        s.tsc = read_tsc();
+        return s;
+    }
+
+    // One row per interval; per-thread columns for threads that committed
+    void dump(std::ostream& out, double ticks_per_sec) const {
+        std::vector<int> threads;
+        if (!samples_.empty())
+            for (int i = 0; i != MAX_THREADS; ++i)
+                if (samples_.back().thread_commits[i])
+                    threads.push_back(i);
+
+        out << "ms,commits_per_sec,aborts_per_sec";
+        for (auto& r : abort_reasons)
+            out << ",aborts_" << r.name << "_per_sec";
+        for (int t : threads)
+            out << ",thread" << t << "_commits_per_sec";
+        out << ",rcu_backlog,global_epoch,active_epoch" << std::endl;
+
+        for (size_t i = 1; i < samples_.size(); ++i) {
+            const sample& a = samples_[i - 1];
+            const sample& b = samples_[i];
+            double secs = double(b.tsc - a.tsc) / ticks_per_sec;
+            auto rate = [secs](uint64_t x, uint64_t y) {
+                return secs > 0 && y > x ? double(y - x) / secs : 0.0;
+            };
+            uint64_t ca = 0, cb = 0;
+            for (int t = 0; t != MAX_THREADS; ++t) {
+                ca += a.thread_commits[t];
+                cb += b.thread_commits[t];
+            }
+            out << double(b.tsc - samples_[0].tsc) / ticks_per_sec * 1000
+                << ',' << rate(ca, cb) << ',' << rate(a.aborts, b.aborts);
+            for (unsigned r = 0; r != num_reasons; ++r)
+                out << ',' << rate(a.reasons[r], b.reasons[r]);
+            for (int t : threads)
+                out << ',' << rate(a.thread_commits[t], b.thread_commits[t]);
+            out << ',' << b.rcu_backlog << ',' << b.global_epoch << ',' << b.active_epoch << std::endl;
+        }
+    }
+
+    bool dump(const char* filename, double ticks_per_sec) const {
+        std::ofstream out(filename);
+        dump(out, ticks_per_sec);
+        return bool(out);
+    }
+
+private:
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ = false;
+    std::vector<sample> samples_;
+
+    static uint64_t peek(txp_counters& p, unsigned c) {
+        if (!txp_helper<0, txp_count>::counter_exists(c))
+            return 0;
+        return __atomic_load_n(&p.p_[c], __ATOMIC_RELAXED);
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Sto.hh"
+
+namespace bench {
+
+// Access traces, for replaying recorded access patterns (trace_bench)
+// instead of a synthetic workload:
+//
+//   [trace_header, header_bytes][record 0][record 1]...[record nrecords-1]
+//
+// A record is one access: a table, a 64-bit key and an operation. A
+// transaction is a run of records, the first of which carries
+// trace_txn_begin; the trace holds no values, so a replay writes values of
+// its own. Records are fixed-size and the file is read through a mapping,
+// so a replayer reads its share of the trace at memory speed.
+
+enum class trace_op : uint8_t {
+    read = 0, update, insert, remove, scan
+};
+
+// trace_record::flags
+enum : uint8_t {
+    trace_txn_begin = 1
+};
+
+struct trace_record {
+    uint64_t key;
+    uint32_t arg;       // scan: rows to read, from key up
+    uint16_t table;
+    trace_op op;
+    uint8_t flags;
+
+    bool begins_txn() const {
+        return flags & trace_txn_begin;
+    }
+};
+static_assert(sizeof(trace_record) == 16, "Trace records must stay compact.");
+
+struct trace_header {
+    static constexpr size_t header_bytes = 64;
+    static constexpr uint32_t current_version = 1;
+
+    char magic[8];          // "STOTRACE"
+    uint32_t version;
+    uint32_t ntables;       // table ids are below this
+    uint64_t nrecords;
+    uint64_t ntxns;
+};
+static_assert(sizeof(trace_header) <= trace_header::header_bytes, "Trace header too large.");
+
+// Writes a trace file. Records are buffered; close() writes the header.
+class trace_writer {
+public:
+    explicit trace_writer(const std::string& path)
+        : fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)), ok_(fd_ >= 0),
+          offset_(trace_header::header_bytes), begin_(true) {
+        memset(&hdr_, 0, sizeof(hdr_));
+        memcpy(hdr_.magic, "STOTRACE", sizeof(hdr_.magic));
+        hdr_.version = trace_header::current_version;
+    }
+    ~trace_writer() {
+        close();
+    }
+    trace_writer(const trace_writer&) = delete;
+    trace_writer& operator=(const trace_writer&) = delete;
+
+    bool ok() const {
+        return ok_;
+    }
+
+    // The next record starts a transaction
+    void begin_txn() {
+        begin_ = true;
+    }
+    void add(uint16_t table, trace_op op, uint64_t key, uint32_t arg = 0) {
+        trace_record r;
+        r.key = key;
+        r.arg = arg;
+        r.table = table;
+        r.op = op;
+        r.flags = begin_ ? trace_txn_begin : 0;
+        add(r);
+    }
+    // Appends r as is, keeping its trace_txn_begin
+    void add(const trace_record& r) {
+        if (r.begins_txn() || !hdr_.nrecords)
+            ++hdr_.ntxns;
+        buf_.push_back(r);
+        if (!hdr_.nrecords)
+            buf_.back().flags |= trace_txn_begin;
+        begin_ = false;
+        hdr_.ntables = std::max(hdr_.ntables, uint32_t(r.table) + 1);
+        ++hdr_.nrecords;
+        if (buf_.size() == buffer_records)
+            flush();
+    }
+
+    // Writes the buffered records and the header; false if anything
+    // failed
+    bool close() {
+        if (fd_ < 0)
+            return ok_;
+        flush();
+        char page[trace_header::header_bytes] = {};
+        memcpy(page, &hdr_, sizeof(hdr_));
+        write_at(page, sizeof(page), 0);
+        if (::close(fd_) != 0)
+            ok_ = false;
+        fd_ = -1;
+        return ok_;
+    }
+
+private:
+    static constexpr size_t buffer_records = 1 << 16;
+
+    int fd_;
+    bool ok_;
+    off_t offset_;
+    bool begin_;
+    trace_header hdr_;
+    std::vector<trace_record> buf_;
+
+    void flush() {
+        size_t n = buf_.size() * sizeof(trace_record);
+        write_at(reinterpret_cast<const char*>(buf_.data()), n, offset_);
+        offset_ += n;
+        buf_.clear();
+    }
+
+    void write_at(const char* p, size_t size, off_t offset) {
+        while (ok_ && size) {
+            ssize_t n = ::pwrite(fd_, p, size, offset);
+            if (n < 0) {
+                if (errno != EINTR)
+                    ok_ = false;
+                continue;
+            }
+            p += n;
+            size -= n;
+            offset += n;
+        }
+    }
+};
+
+// A trace file, mapped read-only
+class trace_file {
+public:
+    typedef std::pair<const trace_record*, const trace_record*> range_type;
+
+    explicit trace_file(const std::string& path)
+        : data_(nullptr), size_(0), records_(nullptr) {
+        memset(&hdr_, 0, sizeof(hdr_));
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && size_t(st.st_size) >= trace_header::header_bytes) {
+            void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data_ = p;
+                size_ = st.st_size;
+            }
+        }
+        ::close(fd);
+        if (!data_)
+            return;
+        memcpy(&hdr_, data_, sizeof(hdr_));
+        if (memcmp(hdr_.magic, "STOTRACE", sizeof(hdr_.magic)) != 0
+            || hdr_.version != trace_header::current_version
+            || hdr_.nrecords > (size_ - trace_header::header_bytes) / sizeof(trace_record)) {
+            ::munmap(data_, size_);
+            data_ = nullptr;
+            return;
+        }
+        records_ = reinterpret_cast<const trace_record*>(
+            reinterpret_cast<const char*>(data_) + trace_header::header_bytes);
+        ::madvise(data_, size_, MADV_WILLNEED);
+    }
+    ~trace_file() {
+        if (data_)
+            ::munmap(data_, size_);
+    }
+    trace_file(const trace_file&) = delete;
+    trace_file& operator=(const trace_file&) = delete;
+
+    // False if the file is missing or not a trace
+    bool ok() const {
+        return data_ != nullptr;
+    }
+    const trace_header& header() const {
+        return hdr_;
+    }
+    const trace_record* begin() const {
+        return records_;
+    }
+    const trace_record* end() const {
+        return records_ + hdr_.nrecords;
+    }
+    size_t size() const {
+        return hdr_.nrecords;
+    }
+    size_t count(trace_op op) const {
+        return std::count_if(begin(), end(), [op] (const trace_record& r) { return r.op == op; });
+    }
+
+    // Splits the records into nparts contiguous runs of whole
+    // transactions, of about equal numbers of records; some runs are
+    // empty if there are fewer transactions than parts
+    std::vector<range_type> partition(unsigned nparts) const {
+        std::vector<range_type> parts;
+        const trace_record* b = begin();
+        for (unsigned i = 1; i <= nparts; ++i) {
+            const trace_record* e = i == nparts ? end() : begin() + size() * i / nparts;
+            e = std::max(e, b);
+            while (e != end() && !e->begins_txn())
+                ++e;
+            parts.emplace_back(b, e);
+            b = e;
+        }
+        return parts;
+    }
+
+    // The end of the transaction that starts at r
+    const trace_record* txn_end(const trace_record* r, const trace_record* limit) const {
+        for (++r; r != limit && !r->begins_txn(); ++r)
+            /* scan */;
+        return r;
+    }
+
+private:
+    void* data_;
+    size_t size_;
+    const trace_record* records_;
+    trace_header hdr_;
+};
+
+// Captures the committed transactions of a running program as a trace,
+// through Transaction::set_commit_observer. Each registered object is a
+// table; its items are turned into keys by its decoder, which can skip
+// items (e.g. node versions) by returning false. Items with a write are
+// recorded as updates, the others as reads. Threads record into their own
+// buffers, so the trace holds each thread's transactions in commit order,
+// one thread after another.
+class trace_recorder {
+public:
+    typedef std::function<bool(const TransItem&, uint64_t&)> decoder_type;
+
+    // Call before start()
+    static void add_table(const TObject* object, uint16_t table, decoder_type decode) {
+        tables_.push_back({object, table, std::move(decode)});
+    }
+    static void start() {
+        Transaction::set_commit_observer(observe);
+    }
+    static void stop() {
+        Transaction::set_commit_observer(nullptr);
+    }
+    // Writes what was recorded since the last clear(); call after stop()
+    static bool write(const std::string& path) {
+        trace_writer w(path);
+        for (auto& buf : buffers_)
+            for (auto& r : buf.records)
+                w.add(r);
+        return w.close();
+    }
+    static void clear() {
+        for (auto& buf : buffers_)
+            std::vector<trace_record>().swap(buf.records);
+        tables_.clear();
+    }
+
+private:
+    struct table {
+        const TObject* object;
+        uint16_t id;
+        decoder_type decode;
+    };
+    struct alignas(64) buffer {
+        std::vector<trace_record> records;
+    };
+
+    static inline std::vector<table> tables_;
+    static inline buffer buffers_[MAX_THREADS];
+
+    static void observe(const TransItem* items, unsigned n) {
+        auto& out = buffers_[TThread::id()].records;
+        uint8_t flags = trace_txn_begin;
+        for (const TransItem* it = items; it != items + n; ++it) {
+            if (!it->has_read() && !it->has_write())
+                continue;
+            for (auto& t : tables_) {
+                uint64_t key;
+                if (t.object != it->owner() || !t.decode(*it, key))
+                    continue;
+                trace_record r;
+                r.key = key;
+                r.arg = 0;
+                r.table = t.id;
+                r.op = it->has_write() ? trace_op::update : trace_op::read;
+                r.flags = flags;
+                out.push_back(r);
+                flags = 0;
+                break;
+            }
+        }
+    }
+};
+
+} // namespace bench
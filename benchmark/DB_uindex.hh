@@ -1,10 +1,52 @@
 #pragma once
 
 #include "DB_index.hh"
+#include "DB_buckets.hh"
 
 namespace bench {
+// Fields of an unordered_index node. Both layouts start with the chain
+// pointer and the cached hash of the key (so chain walks and resizes need
+// not rehash), which is all a walk past the node reads. By default the key
+// follows; with VersionsFirst (a selector's versions_first), the row's
+// versions and its leading columns do instead, and the key moves behind
+// the row. That keeps the version words in the node's first cache line
+// however long the key is, for an extra miss on the key of a row found.
+template <typename Elem, typename Key, typename Container, bool VersionsFirst>
+struct uindex_elem_fields {
+    Elem *next;
+    size_t key_hash;
+    Key key;
+    Container row_container;
+    bool deleted;
+
+    template <typename Row>
+    uindex_elem_fields(const Key& k, size_t h, TransactionTid::type v, bool insert, const Row& row)
+        : next(nullptr), key_hash(h), key(k), row_container(v, insert, row), deleted(false) {}
+};
+
+template <typename Elem, typename Key, typename Container>
+struct uindex_elem_fields<Elem, Key, Container, true> {
+    Elem *next;
+    size_t key_hash;
+    Container row_container;
+    bool deleted;
+    Key key;
+
+    template <typename Row>
+    uindex_elem_fields(const Key& k, size_t h, TransactionTid::type v, bool insert, const Row& row)
+        : next(nullptr), key_hash(h), row_container(v, insert, row), deleted(false), key(k) {}
+};
+
 // unordered index implemented as hashtable
-template <typename K, typename V, typename DBParams>
+//
+// With DeferInserts, insert_row leaves the buckets alone: new rows wait in
+// a per-thread map, which this transaction's selects, inserts and deletes
+// consult, and enter their bucket when lock() takes their row locks. An
+// aborted insert then never touches the table, so it neither bumps bucket
+// versions under other transactions' lookups nor leaves garbage to
+// reclaim. A conflicting insert of the same key makes lock() fail.
+template <typename K, typename V, typename DBParams, typename Hash = index_hash<K>,
+          bool DeferInserts = (STO_DEFER_INSERTS != 0)>
 class unordered_index : public index_common<K, V, DBParams>, public TObject {
 public:
     // Premable
@@ -30,6 +72,8 @@ public:
     using C::has_delete;
     using C::has_row_update;
     using C::has_row_cell;
+    using C::is_cell_commute;
+    using C::apply_commute;
 
     using C::sel_abort;
     using C::ins_abort;
@@ -37,26 +81,26 @@ public:
 
     using C::index_read_my_write;
 
+    static constexpr TransItem::flags_type deferred_bit = TransItem::user0_bit << 5u;
+
     typedef typename get_occ_version<DBParams>::type bucket_version_type;
 
-    typedef std::hash<K> Hash;
     typedef std::equal_to<K> Pred;
 
     // our hashtable is an array of linked lists.
     // an internal_elem is the node type for these linked lists
-    struct internal_elem {
-        internal_elem *next;
-        key_type key;
-        value_container_type row_container;
-        bool deleted;
+    struct internal_elem : pool_allocated<internal_elem>,
+                           uindex_elem_fields<internal_elem, key_type, value_container_type,
+                                              value_container_type::versions_first> {
+        typedef uindex_elem_fields<internal_elem, key_type, value_container_type,
+                                   value_container_type::versions_first> fields_type;
 
-        internal_elem(const key_type& k, const value_type& v, bool valid)
-            : next(nullptr), key(k),
-              row_container((valid ? Sto::initialized_tid() : (Sto::initialized_tid() | invalid_bit)), !valid, v),
-              deleted(false) {}
+        internal_elem(const key_type& k, size_t h, const value_type& v, bool valid)
+            : fields_type(k, h, (valid ? Sto::initialized_tid() : (Sto::initialized_tid() | invalid_bit)),
+                          !valid, v) {}
 
         version_type& version() {
-            return row_container.row_version();
+            return this->row_container.row_version();
         }
 
         bool valid() {
@@ -68,66 +112,92 @@ public:
     ~unordered_index() override {}
 
 private:
-    struct bucket_entry {
-        internal_elem *head;
-        // this is the bucket version number, which is incremented on insert
-        // we use it to make sure that an unsuccessful key lookup will still be
-        // unsuccessful at commit time (because this will always be true if no
-        // new inserts have occurred in this bucket)
-        bucket_version_type version;
-        bucket_entry() : head(nullptr), version(0) {}
-    };
-
-    typedef std::vector<bucket_entry> MapType;
-    // this is the hashtable itself, an array of bucket_entry's
+    // this is the hashtable itself, an array of bucket_entry's that grows
+    // as the table fills (see DB_buckets.hh)
+    typedef resizable_buckets<internal_elem, bucket_version_type> MapType;
+    typedef typename MapType::bucket_entry bucket_entry;
     MapType map_;
     Hash hasher_;
     Pred pred_;
 
     uint64_t key_gen_;
+    uint32_t log_id_ = 0;
+    bool immutable_ = false;
+
+    typedef std::unordered_map<key_type, internal_elem*, Hash, Pred> overlay_type;
+    std::vector<overlay_type> overlays_;    // pending inserts, by thread
 
     // used to mark whether a key is a bucket (for bucket version checks)
     // or a pointer (which will always have the lower 3 bits as 0)
     static constexpr uintptr_t bucket_bit = C::item_key_tag;
+    // keys looked up together by select_split_rows
+    static constexpr size_t select_batch = 16;
 
 public:
     // split version helper stuff
-    using index_t = unordered_index<K, V, DBParams>;
+    using index_t = unordered_index<K, V, DBParams, Hash, DeferInserts>;
     using column_access_t = typename split_version_helpers<index_t>::column_access_t;
     using item_key_t = typename split_version_helpers<index_t>::item_key_t;
     template <typename T>
     static constexpr auto column_to_cell_accesses
         = split_version_helpers<index_t>::template column_to_cell_accesses<T>;
+    template <typename T, typename... Accs>
+    static constexpr auto static_cell_accesses
+        = split_version_helpers<index_t>::template static_cell_accesses<T, Accs...>;
     template <typename T>
     static constexpr auto extract_item_list
         = split_version_helpers<index_t>::template extract_item_list<T>;
+    template <typename T>
+    static constexpr auto ro_access_all
+        = split_version_helpers<index_t>::template ro_access_all<T>;
 
     // Main constructor
     unordered_index(size_t size, Hash h = Hash(), Pred p = Pred()) :
-            map_(), hasher_(h), pred_(p), key_gen_(0) {
-        map_.resize(size);
+            map_(size), hasher_(h), pred_(p), key_gen_(0) {
+        if (DeferInserts)
+            overlays_.resize(MAX_THREADS, overlay_type(0, h, p));
     }
 
     inline size_t hash(const key_type& k) const {
         return hasher_(k);
     }
     inline size_t nbuckets() const {
-        return map_.size();
-    }
-    inline size_t find_bucket_idx(const key_type& k) const {
-        return hash(k) % nbuckets();
+        return map_.nbuckets();
     }
 
     uint64_t gen_key() {
         return fetch_and_add(&key_gen_, 1);
     }
 
+    // Logs this table's committed writes under id, a nonzero id unique
+    // among logged objects (TxnLog), as ordered_index::set_log_id does.
+    // Set before the index is used.
+    void set_log_id(uint32_t id) {
+        static_assert(std::is_trivially_copyable<key_type>::value
+                      && std::is_trivially_copyable<value_type>::value,
+                      "logged keys and rows are copied bytewise");
+        log_id_ = id;
+    }
+    uint32_t log_id() const {
+        return log_id_;
+    }
+
+    // Declares the table read-only from now on; set after loading, before
+    // transactions use it. Selects then add nothing to the tset: the rows
+    // can't change, so there is nothing to validate at commit. Updates,
+    // inserts and deletes become errors.
+    void set_immutable(bool on) {
+        immutable_ = on;
+    }
+    bool immutable() const {
+        return immutable_;
+    }
+
 #if 0
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(const key_type& k, RowAccess access) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
+        bucket_version_type buck_vers;
+        bucket_entry& buck = map_.find(hash(k), buck_vers);
         internal_elem *e = find_in_bucket(buck, k);
 
         if (e != nullptr) {
@@ -141,16 +211,38 @@ public:
     }
 #endif
 
-    sel_split_return_type
+    // Reads and validates only the columns Cols of the row at key, and
+    // returns copies of them (see DB_projection.hh)
+    template <typename V::NamedColumn... Cols>
+    std::tuple<bool, bool, projection<V, Cols...>>
+    select_row(const key_type& key) {
+        return select_projection<V, Cols...>(*this, key);
+    }
+
+    [[nodiscard]] sel_split_return_type
     select_split_row(const key_type& k, std::initializer_list<column_access_t> accesses) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
+        return find_split_row(k, accesses);
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(const key_type& k, static_accesses<Accs...> accesses) {
+        return find_split_row(k, accesses);
+    }
+
+    template <typename Accesses>
+    [[nodiscard]] sel_split_return_type
+    find_split_row(const key_type& k, const Accesses& accesses) {
+        if (internal_elem* p = find_pending(k))
+            return select_split_row(reinterpret_cast<uintptr_t>(p), accesses);
+        bucket_version_type buck_vers;
+        bucket_entry& buck = map_.find(hash(k), buck_vers);
         internal_elem *e = find_in_bucket(buck, k);
 
         if (e != nullptr) {
             return select_split_row(reinterpret_cast<uintptr_t>(e), accesses);
         } else {
+            if (immutable_)
+                return { true, false, 0, UniRecordAccessor<V>(nullptr) };
             if (!Sto::item(this, make_bucket_key(buck)).observe(buck_vers)) {
                 return { false, false, 0, UniRecordAccessor<V>(nullptr) };
             }
@@ -158,8 +250,64 @@ public:
         }
     }
 
+    // Batched select_split_row: calls callback(i, found, rid, value) for
+    // the keys key_of(0), ..., key_of(n - 1) in order, and returns false if
+    // the transaction must abort.
+    // The lookups of a batch run interleaved as bucket probes (see
+    // DB_buckets.hh), and the rows found are prefetched, before any item
+    // is registered, so the misses of a batch overlap.
+    template <typename KeyOf, typename Callback>
+    bool select_split_rows(size_t n, KeyOf key_of,
+                           std::initializer_list<column_access_t> accesses, Callback callback) {
+        return find_split_rows(n, key_of, accesses, callback);
+    }
+    template <typename KeyOf, typename Callback, typename... Accs>
+    bool select_split_rows(size_t n, KeyOf key_of, static_accesses<Accs...> accesses, Callback callback) {
+        return find_split_rows(n, key_of, accesses, callback);
+    }
+
+    template <typename KeyOf, typename Accesses, typename Callback>
+    bool find_split_rows(size_t n, KeyOf key_of, const Accesses& accesses, Callback callback) {
+        typename MapType::probe ps[select_batch];
+        size_t hs[select_batch];
+        for (size_t first = 0; first < n; first += select_batch) {
+            size_t m = std::min(n - first, select_batch);
+            for (size_t i = 0; i != m; ++i) {
+                hs[i] = hash(key_of(first + i));
+                ps[i] = typename MapType::probe(hs[i]);
+            }
+            map_.run_probes(ps, m, [&](size_t i) {
+                    key_type k = key_of(first + i);
+                    size_t h = hs[i];
+                    return [this, k, h](const internal_elem* e) {
+                        return e->key_hash == h && pred_(e->key, k);
+                    };
+                });
+            for (size_t i = 0; i != m; ++i)
+                if (internal_elem* e = ps[i].node())
+                    ::prefetch(&e->row_container);
+            for (size_t i = 0; i != m; ++i) {
+                internal_elem* e = ps[i].node();
+                if (!e && DeferInserts)
+                    e = find_pending(key_of(first + i));
+                if (e) {
+                    auto r = select_split_row(reinterpret_cast<uintptr_t>(e), accesses);
+                    if (!std::get<0>(r))
+                        return false;
+                    callback(first + i, std::get<1>(r), std::get<2>(r), std::get<3>(r));
+                } else {
+                    if (!immutable_
+                        && !Sto::item(this, make_bucket_key(ps[i].bucket())).observe(ps[i].version()))
+                        return false;
+                    callback(first + i, false, uintptr_t(0), UniRecordAccessor<V>(nullptr));
+                }
+            }
+        }
+        return true;
+    }
+
 #if 0
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
         auto e = reinterpret_cast<internal_elem*>(rid);
         bool ok = true;
@@ -202,13 +350,35 @@ public:
     }
 #endif
 
-    sel_split_return_type
+    [[nodiscard]] sel_split_return_type
     select_split_row(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
+        return select_split_cells(rid, column_to_cell_accesses<value_container_type>(accesses));
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(uintptr_t rid, static_accesses<Accs...>) {
+#if STO_PROFILE_COLUMNS
+        column_profile::record<value_type, std::initializer_list<column_access_t>>(
+                {column_access_t(Accs::column, Accs::access)...});
+#endif
+        constexpr auto cell_accesses = static_cell_accesses<value_container_type, Accs...>();
+        return select_split_cells(rid, cell_accesses);
+    }
+
+    [[nodiscard]] sel_split_return_type
+    select_split_cells(uintptr_t rid, const std::array<access_t, value_container_type::num_versions>& cell_accesses) {
         auto e = reinterpret_cast<internal_elem*>(rid);
+        if (immutable_)
+            return { true, true, rid, UniRecordAccessor<V>(&(e->row_container.row)) };
+        if constexpr (supports_ro_observe<version_type>::value) {
+            if (Sto::readonly()) {
+                if (!e->valid() || !ro_access_all<value_container_type>(cell_accesses, e->row_container))
+                    return {false, false, 0, UniRecordAccessor<V>(nullptr)};
+                return {true, true, rid, UniRecordAccessor<V>(&(e->row_container.row))};
+            }
+        }
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
 
-        auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
-
         std::array<TransItem*, value_container_type::num_versions> cell_items {};
         bool any_has_write;
         bool ok;
@@ -239,66 +409,77 @@ public:
     }
 
     void update_row(uintptr_t rid, value_type *new_row) {
+        always_assert(!immutable_, "write to an immutable table");
         auto e = reinterpret_cast<internal_elem*>(rid);
         auto row_item = Sto::item(this, item_key_t::row_item_key(e));
         row_item.acquire_write(e->version(), new_row);
     }
 
+    // Like update_row(rid, new_row), and registers f(*new_row, row) to run
+    // at commit (Sto::defer_update) on the live row, after validation and
+    // with the row's written columns locked. Hot columns selected with
+    // access_t::write and computed by f never join the read set. f may
+    // only read columns this transaction writes; others aren't locked.
+    template <typename F>
+    void defer_update_row(uintptr_t rid, value_type *new_row, F f) {
+        update_row(rid, new_row);
+        const value_type* row = &reinterpret_cast<internal_elem*>(rid)->row_container.row;
+        Sto::defer_update([=] { f(*new_row, *row); });
+    }
+
+    // Repeated updates of a row coalesce into the write already buffered:
+    // a commutator folds into an earlier one, or applies directly to a row
+    // this transaction inserted or replaced.
     void update_row(uintptr_t rid, const comm_type &comm) {
+        always_assert(!immutable_, "write to an immutable table");
         assert(&comm);
-        auto row_item = Sto::item(this, item_key_t::row_item_key(reinterpret_cast<internal_elem *>(rid)));
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        auto row_item = Sto::item(this, item_key_t::row_item_key(e));
+        if (fold_commute(row_item, comm))
+            return;
+        if (row_item.has_write() && !row_item.has_commute()) {
+            if (has_insert(row_item)) {
+                comm.operate(e->row_container.row);
+                return;
+            }
+            // null until update_row() hands over a new row
+            auto vptr = row_item.template raw_write_value<value_type*>();
+            if (has_row_update(row_item) && vptr) {
+                comm.operate(*vptr);
+                return;
+            }
+        }
         row_item.add_commute(comm);
     }
 
-    ins_return_type
+    [[nodiscard]] ins_return_type
     insert_row(const key_type& k, value_type *vptr, bool overwrite = false) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-
-        buck.version.lock_exclusive();
-        internal_elem* e = find_in_bucket(buck, k);
+        always_assert(!immutable_, "write to an immutable table");
+        if (DeferInserts)
+            return defer_insert(k, vptr, overwrite);
+        map_.help_migrate(node_hasher());
+        bucket_entry& buck = map_.lock(hash(k));
+        size_t depth = 0;
+        internal_elem* e = find_in_bucket(buck, k, &depth);
 
         if (e) {
             buck.version.unlock_exclusive();
-            auto row_item = Sto::item(this, item_key_t::row_item_key(e));
-            if (is_phantom(e, row_item))
-                return ins_abort;
-
-            if (index_read_my_write) {
-                if (has_delete(row_item)) {
-                    row_item.clear_flags(delete_bit).clear_write().template add_write<value_type *>(vptr);
-                    return { true, false };
-                }
-            }
-
-            if (overwrite) {
-                if (!version_adapter::select_for_overwrite(row_item, e->version(), vptr))
-                    return ins_abort;
-                if (index_read_my_write) {
-                    if (has_insert(row_item)) {
-                        copy_row(e, vptr);
-                    }
-                }
-            } else {
-                if (!row_item.observe(e->version()))
-                    return ins_abort;
-            }
-
-            return { true, true };
+            return insert_found(e, vptr, overwrite);
         } else {
             // insert the new row to the table and take note of bucket version changes
             auto buck_vers_0 = bucket_version_type(buck.version.unlocked_value());
-            insert_in_bucket(buck, k, vptr, false);
-            internal_elem *new_head = buck.head;
+            internal_elem *new_elem = insert_in_bucket(buck, k, vptr, false);
             auto buck_vers_1 = bucket_version_type(buck.version.unlocked_value());
 
             buck.version.unlock_exclusive();
+            map_.note_insert(buck, depth, node_hasher());
 
             // update bucket version in the read set (if any) since it's changed by ourselves
             auto bucket_item = Sto::item(this, make_bucket_key(buck));
             if (bucket_item.has_read())
                 bucket_item.update_read(buck_vers_0, buck_vers_1);
 
-            auto item = Sto::item(this, item_key_t::row_item_key(new_head));
+            auto item = Sto::item(this, item_key_t::row_item_key(new_elem));
             // XXX adding write is probably unnecessary, am I right?
             item.template add_write<value_type*>(vptr);
             item.add_flags(insert_bit);
@@ -307,14 +488,73 @@ public:
         }
     }
 
+private:
+    // insert_row of a key whose row e exists, or is pending in this
+    // transaction
+    ins_return_type insert_found(internal_elem* e, value_type* vptr, bool overwrite) {
+        auto row_item = Sto::item(this, item_key_t::row_item_key(e));
+        if (is_phantom(e, row_item))
+            return ins_abort;
+
+        if (index_read_my_write) {
+            if (has_delete(row_item)) {
+                row_item.clear_flags(delete_bit).clear_write().template add_write<value_type *>(vptr);
+                return { true, false };
+            }
+        }
+
+        if (overwrite) {
+            if (!version_adapter::select_for_overwrite(row_item, e->version(), vptr))
+                return ins_abort;
+            if (index_read_my_write) {
+                if (has_insert(row_item)) {
+                    copy_row(e, vptr);
+                }
+            }
+        } else {
+            if (!row_item.observe(e->version()))
+                return ins_abort;
+        }
+
+        return { true, true };
+    }
+
+    // insert_row with DeferInserts: a new row waits in the overlay
+    ins_return_type defer_insert(const key_type& k, value_type* vptr, bool overwrite) {
+        internal_elem* e = find_pending(k);
+        if (!e) {
+            bucket_version_type buck_vers;
+            e = find_in_bucket(map_.find(hash(k), buck_vers), k);
+        }
+        if (e)
+            return insert_found(e, vptr, overwrite);
+        // no bucket read needed: if another transaction inserts the key
+        // first, ours fails in lock()
+        e = new internal_elem(k, hash(k), vptr ? *vptr : value_type(), false /*!valid*/);
+        overlay().emplace(k, e);
+        auto item = Sto::item(this, item_key_t::row_item_key(e));
+        item.template add_write<value_type*>(vptr);
+        item.add_flags(insert_bit | deferred_bit);
+        return { true, false };
+    }
+
+public:
+
     // returns (success : bool, found : bool)
     // for rows that are not inserted by this transaction, the actual delete doesn't take place
     // until commit time
-    del_return_type
+    [[nodiscard]] del_return_type
     delete_row(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
+        always_assert(!immutable_, "write to an immutable table");
+        if (internal_elem* p = find_pending(k)) {
+            // our own insert, which never reached the table
+            Sto::item(this, item_key_t::row_item_key(p)).clear_write().clear_flags(insert_bit | deferred_bit);
+            overlay().erase(k);
+            Transaction::rcu_delete(p);
+            return { true, true };
+        }
+        bucket_version_type buck_vers;
+        bucket_entry& buck = map_.find(hash(k), buck_vers);
 
         internal_elem* e = find_in_bucket(buck, k);
         if (e) {
@@ -356,26 +596,63 @@ public:
 
     // non-transactional methods
     value_type* nontrans_get(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        internal_elem* e = find_in_bucket(buck, k);
+        size_t h = hash(k);
+        internal_elem* e = map_.nontrans_find(h, [&](const internal_elem* e) {
+                return e->key_hash == h && pred_(e->key, k);
+            });
         if (e == nullptr)
             return nullptr;
         return &(e->row_container.row);
     }
 
+    // Fuzzy checkpoint of bucket range part of nparts, alongside running
+    // transactions: calls callback(key, value) with a version-consistent
+    // copy of each committed row (tid is unused; rows are as of their
+    // copy). Returns false if a resize may have hidden rows from the walk,
+    // after which the part should be written again. Rows must be kept from
+    // being freed (a snapshot pin does).
+    template <typename Callback>
+    bool checkpoint_part(size_t part, size_t nparts, TransactionTid::type tid, Callback callback) {
+        (void)tid;
+        value_type v;
+        return map_.for_each_part(node_hasher(), part, nparts, [&](const bucket_entry& buck) {
+                MapType::for_each_node(buck, [&](internal_elem* e) {
+                        if (fuzzy_copy_row(e, v))
+                            callback(e->key, v);
+                    });
+            });
+    }
+
     void nontrans_put(const key_type& k, const value_type& v) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        buck.version.lock_exclusive();
-        internal_elem *e = find_in_bucket(buck, k);
+        map_.help_migrate(node_hasher());
+        bucket_entry& buck = map_.lock(hash(k));
+        size_t depth = 0;
+        internal_elem *e = find_in_bucket(buck, k, &depth);
         if (e == nullptr) {
-            internal_elem *new_head = new internal_elem(k, v, true);
-            new_head->next = buck.head;
-            buck.head = new_head;
+            internal_elem *new_elem = new internal_elem(k, hash(k), v, true);
+            MapType::insert(buck, new_elem->key_hash, new_elem);
         } else {
             copy_row(e, &v);
             buck.version.inc_nonopaque();
         }
         buck.version.unlock_exclusive();
+        if (e == nullptr)
+            map_.note_insert(buck, depth, node_hasher());
+    }
+    // Outside any transaction, as in recovery
+    bool nontrans_remove(const key_type& k) {
+        map_.help_migrate(node_hasher());
+        return remove(k);
+    }
+
+    // Loads (key, row) pairs from [begin, end), in any order, splitting
+    // the range across nthreads threads
+    template <typename Iter>
+    void bulk_load(Iter begin, Iter end, int nthreads = 1) {
+        for_each_load_range(begin, end, nthreads, [this](Iter first, Iter last) {
+                for (; first != last; ++first)
+                    nontrans_put(first->first, first->second);
+            });
     }
 
     // TObject interface methods
@@ -384,7 +661,11 @@ public:
         auto key = item.key<item_key_t>();
         auto e = key.internal_elem_ptr();
         if (key.is_row_item()) {
-            return txn.try_lock(item, e->version());
+            if (has_deferred(item))
+                return insert_pending(item, txn, e);
+            return is_cell_commute(item) || txn.try_lock(item, e->version());
+        } else if (is_cells_item(key)) {
+            return cell_versions::lock(txn, item, e->row_container);
         } else {
             return txn.try_lock(item, e->row_container.version_at(key.cell_num()));
         }
@@ -399,21 +680,41 @@ public:
             auto e = key.internal_elem_ptr();
             if (key.is_row_item())
                 return e->version().cp_check_version(txn, item);
+            else if (is_cells_item(key))
+                return cell_versions::check(item, e->row_container);
             else
                 return e->row_container.version_at(key.cell_num()).cp_check_version(txn, item);
         }
     }
 
+    const void* version_address(TransItem& item) const override {
+        if (is_bucket(item))
+            return &bucket_address(item)->version;
+        auto key = item.key<item_key_t>();
+        auto e = key.internal_elem_ptr();
+        if (key.is_row_item())
+            return &e->version();
+        else
+            return &e->row_container.version_at(key.cell_num());
+    }
+
     void install(TransItem& item, Transaction& txn) override {
         assert(!is_bucket(item));
         auto key = item.key<item_key_t>();
         auto e = key.internal_elem_ptr();
+        // the row before this install, to log what it changes
+        alignas(value_type) char before[sizeof(value_type)];
+        bool logged = log_id_ && txn.logging();
+        if (logged)
+            memcpy(before, &e->row_container.row, sizeof(value_type));
 
         if (key.is_row_item()) {
             if (has_delete(item)) {
                 assert(e->valid() && !e->deleted);
                 e->deleted = true;
                 fence();
+                if (logged)
+                    txn.log_delete(log_id_, &e->key, sizeof(key_type), txn.commit_tid());
                 txn.set_version(e->version());
                 return;
             }
@@ -421,12 +722,10 @@ public:
             if (!has_insert(item)) {
                 // update
                 if (item.has_commute()) {
-                    comm_type &comm = item.write_value<comm_type>();
-                    if (has_row_update(item)) {
-                        copy_row(e, comm);
-                    } else if (has_row_cell(item)) {
-                        e->row_container.install_cell(comm);
-                    }
+                    if (has_row_update(item))
+                        copy_row(e, item.write_value<comm_type>());
+                    else
+                        apply_commute(item, e);
                 } else {
                     auto vptr = item.write_value<value_type*>();
                     if (has_row_update(item)) {
@@ -436,20 +735,33 @@ public:
                     }
                 }
             }
-            txn.set_version_unlock(e->version(), item);
+            if (logged)
+                log_row(txn, e, before, has_insert(item));
+            if (is_cell_commute(item))
+                item.clear_needs_unlock();
+            else
+                txn.set_version_unlock(e->version(), item);
         } else {
             auto row_item = Sto::item(this, item_key_t::row_item_key(e));
             if (!has_row_update(row_item)) {
                 if (row_item.has_commute()) {
-                    comm_type &comm = row_item.template write_value<comm_type>();
-                    assert(&comm);
-                    e->row_container.install_cell(comm);
+                    apply_commute(row_item.item(), e);
                 } else {
                     auto vptr = row_item.template raw_write_value<value_type*>();
-                    e->row_container.install_cell(key.cell_num(), vptr);
+                    if (is_cells_item(key))
+                        cell_versions::for_each(cell_versions::written(item), [&](int cell) {
+                                e->row_container.install_cell(cell, vptr);
+                            });
+                    else
+                        e->row_container.install_cell(key.cell_num(), vptr);
                 }
             }
-            txn.set_version_unlock(e->row_container.version_at(key.cell_num()), item);
+            if (logged)
+                log_row(txn, e, before, false);
+            if (is_cells_item(key))
+                cell_versions::set_version_unlock(txn, item, e->row_container);
+            else
+                txn.set_version_unlock(e->row_container.version_at(key.cell_num()), item);
         }
     }
 
@@ -457,13 +769,25 @@ public:
         assert(!is_bucket(item));
         auto key = item.key<item_key_t>();
         auto e = key.internal_elem_ptr();
-        if (key.is_row_item())
-            e->version().cp_unlock(item);
+        if (key.is_row_item()) {
+            if (!is_cell_commute(item))
+                e->version().cp_unlock(item);
+        } else if (is_cells_item(key))
+            cell_versions::unlock(item, e->row_container);
         else
             e->row_container.version_at(key.cell_num()).cp_unlock(item);
     }
 
     void cleanup(TransItem& item, bool committed) override {
+        if (DeferInserts && has_insert(item)) {
+            internal_elem* e = item.key<item_key_t>().internal_elem_ptr();
+            overlay().erase(e->key);
+            if (has_deferred(item)) {
+                Transaction::rcu_delete(e);
+                item.clear_needs_unlock();
+                return;
+            }
+        }
         if (committed ? has_delete(item) : has_insert(item)) {
             assert(!is_bucket(item));
             auto key = item.key<item_key_t>();
@@ -475,17 +799,74 @@ public:
     }
 
 private:
+    static bool is_cells_item(const item_key_t& key) {
+        return value_container_type::cell_bitmap && !key.is_row_item();
+    }
+    static bool has_deferred(const TransItem& item) {
+        return (item.flags() & deferred_bit) != 0;
+    }
+
+    overlay_type& overlay() {
+        return overlays_[TThread::id()];
+    }
+    internal_elem* find_pending(const key_type& k) {
+        if (!DeferInserts)
+            return nullptr;
+        auto& ov = overlay();
+        auto it = ov.find(k);
+        return it == ov.end() ? nullptr : it->second;
+    }
+
+    // Enters a pending row into its bucket, with its row lock held
+    bool insert_pending(TransItem& item, Transaction& txn, internal_elem* e) {
+        if (!txn.try_lock(item, e->version()))
+            return false;
+        map_.help_migrate(node_hasher());
+        bucket_entry& buck = map_.lock(e->key_hash);
+        size_t depth = 0;
+        if (find_in_bucket(buck, e->key, &depth)) {
+            buck.version.unlock_exclusive();
+            return false;
+        }
+        auto buck_vers_0 = bucket_version_type(buck.version.unlocked_value());
+        MapType::insert(buck, e->key_hash, e);
+        buck.version.inc_nonopaque();
+        auto buck_vers_1 = bucket_version_type(buck.version.unlocked_value());
+        buck.version.unlock_exclusive();
+        map_.note_insert(buck, depth, node_hasher());
+        item.clear_flags(deferred_bit);
+        // our own read of the bucket stays current; cleanup() removes the
+        // row if the commit fails from here
+        auto bucket_item = txn.check_item(this, make_bucket_key(buck));
+        if (!bucket_item || !bucket_item.get().has_read())
+            return true;
+        if (bucket_item.get().template read_value<bucket_version_type>() != buck_vers_0)
+            return false;
+        bucket_item.get().update_read(buck_vers_0, buck_vers_1);
+        return true;
+    }
+
     static bool
-    access_all(std::array<access_t, value_container_type::num_versions>& cell_accesses, std::array<TransItem*, value_container_type::num_versions>& cell_items, value_container_type& row_container) {
+    access_all(const std::array<access_t, value_container_type::num_versions>& cell_accesses, std::array<TransItem*, value_container_type::num_versions>& cell_items, value_container_type& row_container) {
         for (size_t idx = 0; idx < cell_accesses.size(); ++idx) {
             auto& access = cell_accesses[idx];
             auto proxy = TransProxy(*Sto::transaction(), *cell_items[idx]);
+            if (value_container_type::cell_bitmap && idx != 0) {
+                if ((static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::read))
+                    && !cell_versions::observe(proxy, row_container, idx))
+                    return false;
+                if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::write))
+                    cell_versions::add_write(proxy, idx);
+                continue;
+            }
             if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::read)) {
                 if (!proxy.observe(row_container.version_at(idx)))
                     return false;
             }
             if (static_cast<uint8_t>(access) & static_cast<uint8_t>(access_t::write)) {
-                if (!proxy.acquire_write(row_container.version_at(idx)))
+                // keep a commutator an earlier update buffered, for the
+                // next update_row() to fold into
+                if (!proxy.has_commute() && !proxy.acquire_write(row_container.version_at(idx)))
                     return false;
                 if (proxy.item().key<item_key_t>().is_row_item()) {
                     proxy.item().add_flags(row_cell_bit);
@@ -497,62 +878,55 @@ private:
 
     // remove a k-v node during transactions (with locks)
     void _remove(internal_elem *el) {
-        bucket_entry& buck = map_[find_bucket_idx(el->key)];
-        buck.version.lock_exclusive();
-        internal_elem *prev = nullptr;
-        internal_elem *curr = buck.head;
-        while (curr != nullptr && curr != el) {
-            prev = curr;
-            curr = curr->next;
-        }
-        assert(curr);
-        if (prev != nullptr)
-            prev->next = curr->next;
-        else
-            buck.head = curr->next;
+        bucket_entry& buck = map_.lock(el->key_hash);
+        bool found = MapType::erase(buck, el);
+        assert(found);
+        (void) found;
         buck.version.unlock_exclusive();
-        Transaction::rcu_delete(curr);
+        Transaction::rcu_delete(el);
+    }
+    void log_row(Transaction& txn, internal_elem* e, const void* before, bool insert) {
+        if (insert)
+            txn.log_write(log_id_, &e->key, sizeof(key_type), &e->row_container.row,
+                          sizeof(value_type), txn.commit_tid());
+        else
+            txn.log_delta(log_id_, &e->key, sizeof(key_type), before, &e->row_container.row,
+                          sizeof(value_type), txn.commit_tid());
     }
+
     // non-transactional remove by key
     bool remove(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        buck.version.lock_exclusive();
-        internal_elem *prev = nullptr;
-        internal_elem *curr = buck.head;
-        while (curr != nullptr && !pred_(curr->key, k)) {
-            prev = curr;
-            curr = curr->next;
-        }
+        bucket_entry& buck = map_.lock(hash(k));
+        internal_elem *curr = find_in_bucket(buck, k);
         if (curr == nullptr) {
             buck.version.unlock_exclusive();
             return false;
         }
-        if (prev != nullptr)
-            prev->next = curr->next;
-        else
-            buck.head = curr->next;
+        MapType::erase(buck, curr);
         buck.version.unlock_exclusive();
         delete curr;
         return true;
     }
     // insert a k-v node to a bucket
-    void insert_in_bucket(bucket_entry& buck, const key_type& k, const value_type *v, bool valid) {
+    internal_elem *insert_in_bucket(bucket_entry& buck, const key_type& k, const value_type *v, bool valid) {
         assert(buck.version.is_locked());
 
-        internal_elem *new_head = new internal_elem(k, v ? *v : value_type(), valid);
-        internal_elem *curr_head = buck.head;
-
-        new_head->next = curr_head;
-        buck.head = new_head;
+        internal_elem *new_elem = new internal_elem(k, hash(k), v ? *v : value_type(), valid);
+        MapType::insert(buck, new_elem->key_hash, new_elem);
 
         buck.version.inc_nonopaque();
+        return new_elem;
+    }
+    // find a key's k-v node (internal_elem) within a bucket; *depth
+    // counts the overflow nodes passed
+    internal_elem *find_in_bucket(const bucket_entry& buck, const key_type& k, size_t* depth = nullptr) {
+        size_t h = hash(k);
+        return MapType::find_in(buck, h, [&](const internal_elem* e) {
+                return e->key_hash == h && pred_(e->key, k);
+            }, depth);
     }
-    // find a key's k-v node (internal_elem) within a bucket
-    internal_elem *find_in_bucket(const bucket_entry& buck, const key_type& k) {
-        internal_elem *curr = buck.head;
-        while (curr && !pred_(curr->key, k))
-            curr = curr->next;
-        return curr;
+    static auto node_hasher() {
+        return [](const internal_elem* e) { return e->key_hash; };
     }
 
     static bool is_phantom(internal_elem *e, const TransItem& item) {
@@ -582,7 +956,7 @@ private:
 };
 
 // MVCC variant
-template <typename K, typename V, typename DBParams>
+template <typename K, typename V, typename DBParams, typename Hash = index_hash<K>>
 class mvcc_unordered_index : public index_common<K, V, DBParams>, public TObject {
 public:
     // Premable
@@ -619,13 +993,12 @@ public:
 
     typedef typename get_occ_version<DBParams>::type bucket_version_type;
 
-    typedef std::hash<K> Hash;
     typedef std::equal_to<K> Pred;
 
 #if 0
     // our hashtable is an array of linked lists.
     // an internal_elem is the node type for these linked lists
-    struct internal_elem {
+    struct internal_elem : pool_allocated<internal_elem> {
         typedef typename SplitParams<value_type>::layout_type split_layout_type;
 
         internal_elem* next;
@@ -645,18 +1018,21 @@ public:
         }
     };
 #endif
-    struct KVNode {
+    struct KVNode : pool_allocated<KVNode> {
         KVNode* next;
+        // hash(elem.key), next to next so chain walks read one line
+        size_t key_hash;
         internal_elem elem;
 
         template <typename... Args>
-        KVNode(Args... args)
-            : next(nullptr), elem(std::forward<Args>(args)...) {
+        KVNode(size_t h, Args... args)
+            : next(nullptr), key_hash(h), elem(std::forward<Args>(args)...) {
         }
 
         static KVNode* from_chain(typename internal_elem::object0_type* chain) {
             auto* el = internal_elem::from_chain(chain);
-            size_t d = std::max(sizeof(KVNode::next), alignof(KVNode::elem));
+            constexpr size_t a = alignof(KVNode::elem);
+            size_t d = (sizeof(KVNode::next) + sizeof(KVNode::key_hash) + a - 1) / a * a;
             return reinterpret_cast<KVNode*>(reinterpret_cast<uintptr_t>(el) - d);
         }
     };
@@ -665,18 +1041,10 @@ public:
     ~mvcc_unordered_index() override {}
 
 private:
-    struct bucket_entry {
-        KVNode *head;
-        // this is the bucket version number, which is incremented on insert
-        // we use it to make sure that an unsuccessful key lookup will still be
-        // unsuccessful at commit time (because this will always be true if no
-        // new inserts have occurred in this bucket)
-        bucket_version_type version;
-        bucket_entry() : head(nullptr), version(0) {}
-    };
-
-    typedef std::vector<bucket_entry> MapType;
-    // this is the hashtable itself, an array of bucket_entry's
+    // this is the hashtable itself, an array of bucket_entry's that grows
+    // as the table fills (see DB_buckets.hh)
+    typedef resizable_buckets<KVNode, bucket_version_type> MapType;
+    typedef typename MapType::bucket_entry bucket_entry;
     MapType map_;
     Hash hasher_;
     Pred pred_;
@@ -686,33 +1054,35 @@ private:
     // used to mark whether a key is a bucket (for bucket version checks)
     // or a pointer (which will always have the lower 3 bits as 0)
     static constexpr uintptr_t bucket_bit = C::item_key_tag;
+    // keys looked up together by select_split_rows
+    static constexpr size_t select_batch = 16;
 
 public:
     // split version helper stuff
-    using index_t = mvcc_unordered_index<K, V, DBParams>;
+    using index_t = mvcc_unordered_index<K, V, DBParams, Hash>;
     friend split_version_helpers<index_t>;
     using column_access_t = typename split_version_helpers<index_t>::column_access_t;
     using item_key_t = typename split_version_helpers<index_t>::item_key_t;
     template <typename T> static constexpr auto mvcc_column_to_cell_accesses =
         split_version_helpers<index_t>::template mvcc_column_to_cell_accesses<T>;
+    template <typename T, typename... Accs> static constexpr auto mvcc_static_cell_accesses =
+        split_version_helpers<index_t>::template mvcc_static_cell_accesses<T, Accs...>;
     template <typename T> static constexpr auto extract_item_list =
         split_version_helpers<index_t>::template extract_item_list<T>;
     using MvSplitAccessAll = typename split_version_helpers<index_t>::template MvSplitAccessAll<SplitParams<value_type>>;
+    static_assert(!is_dynamic_split<SplitParams<value_type>>::value,
+                  "runtime split layouts need mvcc_ordered_index");
 
     // Main constructor
     mvcc_unordered_index(size_t size, Hash h = Hash(), Pred p = Pred()) :
-            map_(), hasher_(h), pred_(p), key_gen_(0) {
-        map_.resize(size);
+            map_(size), hasher_(h), pred_(p), key_gen_(0) {
     }
 
     inline size_t hash(const key_type& k) const {
         return hasher_(k);
     }
     inline size_t nbuckets() const {
-        return map_.size();
-    }
-    inline size_t find_bucket_idx(const key_type& k) const {
-        return hash(k) % nbuckets();
+        return map_.nbuckets();
     }
 
     uint64_t gen_key() {
@@ -720,11 +1090,10 @@ public:
     }
 
 #if 0
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(const key_type& k, RowAccess access) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
+        bucket_version_type buck_vers;
+        bucket_entry& buck = map_.find(hash(k), buck_vers);
         internal_elem *e = find_in_bucket(buck, k);
 
         if (e != nullptr) {
@@ -737,11 +1106,10 @@ public:
         }
     }
 
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(const key_type& k, std::initializer_list<column_access_t> accesses) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
+        bucket_version_type buck_vers;
+        bucket_entry& buck = map_.find(hash(k), buck_vers);
         internal_elem *e = find_in_bucket(buck, k);
 
         if (e != nullptr) {
@@ -754,7 +1122,7 @@ public:
         }
     }
 
-    sel_return_type
+    [[nodiscard]] sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
         auto e = reinterpret_cast<internal_elem*>(rid);
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
@@ -790,12 +1158,30 @@ public:
     }
 #endif
 
+    // Reads and validates only the columns Cols of the row at key, and
+    // returns copies of them (see DB_projection.hh)
+    template <typename V::NamedColumn... Cols>
+    std::tuple<bool, bool, projection<V, Cols...>>
+    select_row(const key_type& key) {
+        return select_projection<V, Cols...>(*this, key);
+    }
+
     // Split version select row
-    sel_split_return_type
+    [[nodiscard]] sel_split_return_type
     select_split_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
-        bucket_entry& buck = map_[find_bucket_idx(key)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
+        return find_split_row(key, accesses);
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_split_row(const key_type& key, static_accesses<Accs...> accesses) {
+        return find_split_row(key, accesses);
+    }
+
+    template <typename Accesses>
+    [[nodiscard]] sel_split_return_type
+    find_split_row(const key_type& key, const Accesses& accesses) {
+        bucket_version_type buck_vers;
+        bucket_entry& buck = map_.find(hash(key), buck_vers);
         KVNode *n = find_in_bucket(buck, key);
 
         if (n) {
@@ -811,14 +1197,78 @@ public:
         }
     }
 
-    sel_split_return_type
+    // Batched select_split_row: calls callback(i, found, rid, value) for
+    // the keys key_of(0), ..., key_of(n - 1) in order, and returns false if
+    // the transaction must abort.
+    // Each batch runs its bucket probes interleaved and prefetches the rows
+    // found before registering any item.
+    template <typename KeyOf, typename Callback>
+    bool select_split_rows(size_t n, KeyOf key_of,
+                           std::initializer_list<column_access_t> accesses, Callback callback) {
+        return find_split_rows(n, key_of, accesses, callback);
+    }
+    template <typename KeyOf, typename Callback, typename... Accs>
+    bool select_split_rows(size_t n, KeyOf key_of, static_accesses<Accs...> accesses, Callback callback) {
+        return find_split_rows(n, key_of, accesses, callback);
+    }
+
+    template <typename KeyOf, typename Accesses, typename Callback>
+    bool find_split_rows(size_t n, KeyOf key_of, const Accesses& accesses, Callback callback) {
+        typename MapType::probe ps[select_batch];
+        size_t hs[select_batch];
+        for (size_t first = 0; first < n; first += select_batch) {
+            size_t m = std::min(n - first, select_batch);
+            for (size_t i = 0; i != m; ++i) {
+                hs[i] = hash(key_of(first + i));
+                ps[i] = typename MapType::probe(hs[i]);
+            }
+            map_.run_probes(ps, m, [&](size_t i) {
+                    key_type k = key_of(first + i);
+                    size_t h = hs[i];
+                    return [this, k, h](const KVNode* n) {
+                        return n->key_hash == h && pred_(n->elem.key, k);
+                    };
+                });
+            for (size_t i = 0; i != m; ++i)
+                if (KVNode* n = ps[i].node())
+                    ::prefetch(&n->elem);
+            for (size_t i = 0; i != m; ++i) {
+                if (KVNode* n = ps[i].node()) {
+                    auto r = select_splits(reinterpret_cast<uintptr_t>(&n->elem), accesses);
+                    if (!std::get<0>(r))
+                        return false;
+                    callback(first + i, std::get<1>(r), std::get<2>(r), std::get<3>(r));
+                } else {
+                    if (!Sto::item(this, make_bucket_key(ps[i].bucket())).observe(ps[i].version()))
+                        return false;
+                    callback(first + i, false, uintptr_t(0), SplitRecordAccessor<V>({ nullptr }));
+                }
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] sel_split_return_type
     select_splits(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
         using split_params = SplitParams<value_type>;
         auto e = reinterpret_cast<internal_elem*>(rid);
         auto cell_accesses = mvcc_column_to_cell_accesses<split_params>(accesses);
-        bool found;
-        auto result = MvSplitAccessAll::run_select(&found, cell_accesses, this, e);
-        return {true, found, rid, SplitRecordAccessor<V>(result)};
+        bool found, ok;
+        auto result = MvSplitAccessAll::run_select(&found, &ok, cell_accesses, this, e);
+        return {ok, found, rid, SplitRecordAccessor<V>(result)};
+    }
+    template <typename... Accs>
+    [[nodiscard]] sel_split_return_type
+    select_splits(uintptr_t rid, static_accesses<Accs...>) {
+#if STO_PROFILE_COLUMNS
+        column_profile::record<value_type, std::initializer_list<column_access_t>>(
+                {column_access_t(Accs::column, Accs::access)...});
+#endif
+        constexpr auto cell_accesses = mvcc_static_cell_accesses<SplitParams<value_type>, Accs...>();
+        bool found, ok;
+        auto result = MvSplitAccessAll::run_select(&found, &ok, cell_accesses, this,
+                                                   reinterpret_cast<internal_elem*>(rid));
+        return {ok, found, rid, SplitRecordAccessor<V>(result)};
     }
 
     void update_row(uintptr_t rid, value_type* new_row) {
@@ -837,31 +1287,30 @@ public:
         MvSplitAccessAll::run_update(this, reinterpret_cast<internal_elem*>(rid), comm);
     }
 
-    ins_return_type
+    [[nodiscard]] ins_return_type
     insert_row(const key_type& k, value_type *vptr, bool overwrite = false) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-
-        buck.version.lock_exclusive();
-        KVNode* n = find_in_bucket(buck, k);
+        map_.help_migrate(node_hasher());
+        bucket_entry& buck = map_.lock(hash(k));
+        size_t depth = 0;
+        KVNode* n = find_in_bucket(buck, k, &depth);
+        bool inserted = !n;
 
         if (!n) {
             // insert the new row to the table and take note of bucket version changes
             auto buck_vers_0 = bucket_version_type(buck.version.unlocked_value());
-            insert_in_bucket(buck, k);
-            KVNode* new_head = buck.head;
+            n = insert_in_bucket(buck, k);
             auto buck_vers_1 = bucket_version_type(buck.version.unlocked_value());
 
             // update bucket version in the read set (if any) since it's changed by ourselves
             auto bucket_item = Sto::item(this, make_bucket_key(buck));
             if (bucket_item.has_read())
                 bucket_item.update_read(buck_vers_0, buck_vers_1);
-
-            n = new_head;
-            assert(n);
         }
 
         auto e = &n->elem;
         buck.version.unlock_exclusive();
+        if (inserted)
+            map_.note_insert(buck, depth, node_hasher());
         auto row_item = Sto::item(this, item_key_t(e, 0));
         auto h = e->template chain_at<0>()->find(txn_read_tid());
         if (is_phantom(h, row_item)) {
@@ -898,11 +1347,10 @@ public:
     // returns (success : bool, found : bool)
     // for rows that are not inserted by this transaction, the actual delete doesn't take place
     // until commit time
-    del_return_type
+    [[nodiscard]] del_return_type
     delete_row(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
+        bucket_version_type buck_vers;
+        bucket_entry& buck = map_.find(hash(k), buck_vers);
 
         KVNode* n = find_in_bucket(buck, k);
         if (n) {
@@ -946,8 +1394,10 @@ public:
 
     // non-transactional methods
     bool nontrans_get(const key_type& k, value_type* value_out) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        KVNode* n = find_in_bucket(buck, k);
+        size_t h = hash(k);
+        KVNode* n = map_.nontrans_find(h, [&](const KVNode* n) {
+                return n->key_hash == h && pred_(n->elem.key, k);
+            });
         if (n == nullptr) {
             return false;
         } else {
@@ -957,18 +1407,71 @@ public:
         }
     }
 
+    // AS OF read: the row as of tid, outside any transaction. Nothing is
+    // tracked or validated, so tid must stay readable (see SnapshotPin).
+    bool select_row_as_of(const key_type& k, TransactionTid::type tid, value_type* value_out) {
+        size_t h = hash(k);
+        KVNode* n = map_.nontrans_find(h, [&](const KVNode* n) {
+                return n->key_hash == h && pred_(n->elem.key, k);
+            });
+        if (n == nullptr)
+            return false;
+        return MvSplitAccessAll::run_get_as_of(value_out, &n->elem, tid);
+    }
+
+    // Calls callback(key, split_values) for every row that existed as of
+    // tid, in bucket order, with split_values[I] pointing at split I's
+    // version. For snapshot export (DB_snapshot.hh).
+    template <typename Callback>
+    void scan_splits_as_of(TransactionTid::type tid, Callback callback) {
+        std::array<void*, SplitParams<value_type>::num_splits> split_values;
+        bool more = true;
+        map_.for_each(node_hasher(), [&](const bucket_entry& buck) {
+                MapType::for_each_node(buck, [&](KVNode* n) {
+                        more = more && (!MvSplitAccessAll::run_get_splits_as_of(split_values, &n->elem, tid)
+                                        || callback(n->elem.key, split_values));
+                    });
+            });
+    }
+
+    // Checkpoint of bucket range part of nparts as of snapshot tid: calls
+    // callback(key, value) for each row that existed then. Returns false if
+    // a resize may have hidden rows from the walk (see unordered_index).
+    template <typename Callback>
+    bool checkpoint_part(size_t part, size_t nparts, TransactionTid::type tid, Callback callback) {
+        value_type v;
+        return map_.for_each_part(node_hasher(), part, nparts, [&](const bucket_entry& buck) {
+                MapType::for_each_node(buck, [&](KVNode* n) {
+                        if (MvSplitAccessAll::run_get_as_of(&v, &n->elem, tid))
+                            callback(n->elem.key, v);
+                    });
+            });
+    }
+
     void nontrans_put(const key_type& k, const value_type& v) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        buck.version.lock_exclusive();
-        KVNode* n = find_in_bucket(buck, k);
+        map_.help_migrate(node_hasher());
+        bucket_entry& buck = map_.lock(hash(k));
+        size_t depth = 0;
+        KVNode* n = find_in_bucket(buck, k, &depth);
+        bool inserted = !n;
         if (n == nullptr) {
-            KVNode* new_head = new KVNode(this, k);
-            new_head->next = buck.head;
-            buck.head = new_head;
-            n = new_head;
+            n = new KVNode(hash(k), this, k);
+            MapType::insert(buck, n->key_hash, n);
         }
         MvSplitAccessAll::run_nontrans_put(v, &n->elem);
         buck.version.unlock_exclusive();
+        if (inserted)
+            map_.note_insert(buck, depth, node_hasher());
+    }
+
+    // Loads (key, row) pairs from [begin, end), in any order, splitting
+    // the range across nthreads threads
+    template <typename Iter>
+    void bulk_load(Iter begin, Iter end, int nthreads = 1) {
+        for_each_load_range(begin, end, nthreads, [this](Iter first, Iter last) {
+                for (; first != last; ++first)
+                    nontrans_put(first->first, first->second);
+            });
     }
 
     template <typename TSplit>
@@ -1025,40 +1528,22 @@ public:
 private:
     // remove a k-v node during transactions (with locks)
     void _remove(KVNode *el) {
-        bucket_entry& buck = map_[find_bucket_idx(el->elem.key)];
-        buck.version.lock_exclusive();
-        KVNode *prev = nullptr;
-        KVNode *curr = buck.head;
-        while (curr != nullptr && curr != el) {
-            prev = curr;
-            curr = curr->next;
-        }
-        assert(curr);
-        if (prev != nullptr)
-            prev->next = curr->next;
-        else
-            buck.head = curr->next;
+        bucket_entry& buck = map_.lock(hash(el->elem.key));
+        bool found = MapType::erase(buck, el);
+        assert(found);
+        (void) found;
         buck.version.unlock_exclusive();
-        Transaction::rcu_delete(curr);
+        Transaction::rcu_delete(el);
     }
     // non-transactional remove by key
     bool remove(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        buck.version.lock_exclusive();
-        KVNode *prev = nullptr;
-        KVNode *curr = buck.head;
-        while (curr != nullptr && !pred_(curr->elem.key, k)) {
-            prev = curr;
-            curr = curr->next;
-        }
+        bucket_entry& buck = map_.lock(hash(k));
+        KVNode *curr = find_in_bucket(buck, k);
         if (curr == nullptr) {
             buck.version.unlock_exclusive();
             return false;
         }
-        if (prev != nullptr)
-            prev->next = curr->next;
-        else
-            buck.head = curr->next;
+        MapType::erase(buck, curr);
         buck.version.unlock_exclusive();
         delete curr;
         return true;
@@ -1070,17 +1555,13 @@ private:
         auto obj = hp->object();
         if (obj->find_latest(false) == hp) {
             auto el = KVNode::from_chain(obj);
-            auto table = reinterpret_cast<mvcc_unordered_index<K, V, DBParams>*>(el->elem.table);
-            bucket_entry& buck = table->map_[table->find_bucket_idx(el->elem.key)];
-            buck.version.lock_exclusive();
-            KVNode** pprev = &buck.head;
-            while (*pprev && *pprev != el) {
-                pprev = &(*pprev)->next;
-            }
-            assert(*pprev == el);
+            auto table = reinterpret_cast<index_t*>(el->elem.table);
+            bucket_entry& buck = table->map_.lock(el->key_hash);
             hp->status_poisoned();
             if (obj->find_latest(true) == hp) {
-                *pprev = el->next;
+                bool found = MapType::erase(buck, el);
+                assert(found);
+                (void) found;
                 buck.version.unlock_exclusive();
                 Transaction::rcu_call(gc_internal_elem, el);
             } else {
@@ -1091,28 +1572,30 @@ private:
     }
 
     static void gc_internal_elem(void* el_ptr) {
-        auto el = reinterpret_cast<internal_elem*>(el_ptr);
+        auto el = reinterpret_cast<KVNode*>(el_ptr);
         delete el;
     }
 
     // insert a k-v node to a bucket
-    void insert_in_bucket(bucket_entry& buck, const key_type& k) {
+    KVNode* insert_in_bucket(bucket_entry& buck, const key_type& k) {
         assert(buck.version.is_locked());
 
-        auto new_head = new KVNode(this, k);
-        auto curr_head = buck.head;
-
-        new_head->next = curr_head;
-        buck.head = new_head;
+        auto new_node = new KVNode(hash(k), this, k);
+        MapType::insert(buck, new_node->key_hash, new_node);
 
         buck.version.inc_nonopaque();
-    }
-    // find a key's k-v node within a bucket
-    KVNode *find_in_bucket(const bucket_entry& buck, const key_type& k) {
-        auto curr = buck.head;
-        while (curr && !pred_(curr->elem.key, k))
-            curr = curr->next;
-        return curr;
+        return new_node;
+    }
+    // find a key's k-v node within a bucket; *depth counts the overflow
+    // nodes passed
+    KVNode *find_in_bucket(const bucket_entry& buck, const key_type& k, size_t* depth = nullptr) {
+        size_t h = hash(k);
+        return MapType::find_in(buck, h, [&](const KVNode* n) {
+                return n->key_hash == h && pred_(n->elem.key, k);
+            }, depth);
+    }
+    static auto node_hasher() {
+        return [](const KVNode* n) { return n->key_hash; };
     }
 
     template <typename T>
@@ -0,0 +1,442 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+
+#include "Commutators.hh"
+#include "DB_index.hh"
+
+// Materialized views over a base table, maintained by the transactions
+// that write it and read with one row lookup in place of a scan.
+//
+// A view is an index of its own (the view index) with a row per group.
+// group_of(k, row) names the group of base row (k, row), and value_of(k,
+// row) the value it adds to it. The base table's writers call the view's
+// insert() (and, for aggregates, remove()) in the same transaction.
+// Maintenance is a commutative update of the group's row: with
+// DBParams::Commute it is written blind, as a commutator applied at
+// commit, so concurrent writers to one group don't conflict; otherwise
+// the row is also read, so they do. A group's row is inserted the first time
+// the group gets a value; under MVCC, the transaction that inserts it
+// can't add to the group again.
+//
+//   latest_view:     the largest value in the group, e.g. a customer's
+//                    latest order id; values are non-negative
+//   aggregate_view:  the number of rows in the group and their sum
+
+namespace bench {
+
+struct latest_row {
+    enum class NamedColumn : int { latest = 0 };
+
+    int64_t latest;
+};
+
+struct aggregate_row {
+    enum class NamedColumn : int { count = 0, sum };
+
+    int64_t count;
+    int64_t sum;
+};
+
+} // namespace bench
+
+namespace commutators {
+
+template <>
+class Commutator<bench::latest_row> {
+public:
+    Commutator() = default;
+    explicit Commutator(int64_t value) : value(value) {}
+
+    void operate(bench::latest_row& r) const {
+        if (value > r.latest)
+            r.latest = value;
+    }
+
+    bool fold(const Commutator& next) {
+        if (next.value > value)
+            value = next.value;
+        return true;
+    }
+
+private:
+    int64_t value;
+};
+
+template <>
+class Commutator<bench::aggregate_row> {
+public:
+    Commutator() = default;
+    Commutator(int64_t delta_count, int64_t delta_sum)
+        : delta_count(delta_count), delta_sum(delta_sum) {}
+
+    void operate(bench::aggregate_row& r) const {
+        r.count += delta_count;
+        r.sum += delta_sum;
+    }
+
+    bool fold(const Commutator& next) {
+        delta_count += next.delta_count;
+        delta_sum += next.delta_sum;
+        return true;
+    }
+
+private:
+    int64_t delta_count;
+    int64_t delta_sum;
+};
+
+} // namespace commutators
+
+namespace bench {
+
+// Applies comm to the row of group g in view, inserting comm applied to a
+// zero row if the group has none; false if the transaction must abort.
+// select(access) selects the group's row with every column at access.
+// Without DBParams::Commute the row is also read, so that concurrent
+// maintenance of the group conflicts.
+template <typename View, typename Select>
+bool update_view_row(View& view, const typename View::key_type& g,
+                     const typename View::comm_type& comm, Select select) {
+    typedef typename View::value_type row_type;
+    auto [success, found, rid, value] = select(View::Commute ? access_t::write : access_t::update);
+    (void)value;
+    if (!success)
+        return false;
+    if (found) {
+        // folds into this transaction's earlier updates of the group
+        view.update_row(rid, comm);
+        return true;
+    }
+    auto row = Sto::tx_alloc<row_type>();
+    *row = row_type();
+    comm.operate(*row);
+    // another transaction inserted the group first: retry, to update it
+    auto [ins_success, ins_found] = view.insert_row(g, row, false);
+    return ins_success && !ins_found;
+}
+
+template <typename View, typename GroupOf, typename ValueOf>
+class latest_view {
+public:
+    typedef typename View::key_type group_type;
+    typedef latest_row::NamedColumn nc;
+    static_assert(std::is_same<typename View::value_type, latest_row>::value,
+                  "latest_view needs an index of latest_row");
+
+    latest_view(View& view, GroupOf group_of = GroupOf(), ValueOf value_of = ValueOf())
+        : view_(view), group_of_(group_of), value_of_(value_of) {}
+
+    View& view() {
+        return view_;
+    }
+
+    // Raises the latest value of base row (k, row)'s group to
+    // value_of(k, row); false if the transaction must abort
+    template <typename K, typename V>
+    bool insert(const K& k, const V& row) {
+        group_type g = group_of_(k, row);
+        return update_view_row(view_, g, typename View::comm_type(value_of_(k, row)), [&] (access_t a) {
+                return view_.select_split_row(g, {{nc::latest, a}});
+            });
+    }
+
+    // Reads group g's latest value into *latest; returns {success, found}
+    std::tuple<bool, bool> read(const group_type& g, int64_t* latest) {
+        auto [success, found, rid, value] = view_.select_split_row(g, {{nc::latest, access_t::read}});
+        (void)rid;
+        if (success && found)
+            *latest = value.latest();
+        return {success, found};
+    }
+
+private:
+    View& view_;
+    GroupOf group_of_;
+    ValueOf value_of_;
+};
+
+template <typename View, typename GroupOf, typename ValueOf>
+class aggregate_view {
+public:
+    typedef typename View::key_type group_type;
+    typedef aggregate_row::NamedColumn nc;
+    static_assert(std::is_same<typename View::value_type, aggregate_row>::value,
+                  "aggregate_view needs an index of aggregate_row");
+
+    aggregate_view(View& view, GroupOf group_of = GroupOf(), ValueOf value_of = ValueOf())
+        : view_(view), group_of_(group_of), value_of_(value_of) {}
+
+    View& view() {
+        return view_;
+    }
+
+    // Adds base row (k, row) to its group; false if the transaction must
+    // abort
+    template <typename K, typename V>
+    bool insert(const K& k, const V& row) {
+        return add(group_of_(k, row), 1, value_of_(k, row));
+    }
+    // Takes base row (k, row) out of its group
+    template <typename K, typename V>
+    bool remove(const K& k, const V& row) {
+        return add(group_of_(k, row), -1, -int64_t(value_of_(k, row)));
+    }
+    // Base row k changed from old_row to new_row
+    template <typename K, typename V>
+    bool update(const K& k, const V& old_row, const V& new_row) {
+        group_type g = group_of_(k, new_row);
+        if (g == group_of_(k, old_row))
+            return add(g, 0, int64_t(value_of_(k, new_row)) - int64_t(value_of_(k, old_row)));
+        return remove(k, old_row) && insert(k, new_row);
+    }
+
+    // Reads group g's row count and sum; returns {success, found}
+    std::tuple<bool, bool> read(const group_type& g, int64_t* count, int64_t* sum) {
+        auto [success, found, rid, value] = view_.select_split_row(g,
+            {{nc::count, access_t::read}, {nc::sum, access_t::read}});
+        (void)rid;
+        if (success && found) {
+            *count = value.count();
+            *sum = value.sum();
+        }
+        return {success, found};
+    }
+
+private:
+    View& view_;
+    GroupOf group_of_;
+    ValueOf value_of_;
+
+    bool add(const group_type& g, int64_t delta_count, int64_t delta_sum) {
+        return update_view_row(view_, g, typename View::comm_type(delta_count, delta_sum), [&] (access_t a) {
+                return view_.select_split_row(g, {{nc::count, a}, {nc::sum, a}});
+            });
+    }
+};
+
+
+template <>
+struct SplitParams<latest_row> {
+  using split_type_list = std::tuple<latest_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const latest_row& in) -> latest_row {
+      latest_row out;
+      out.latest = in.latest;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](latest_row* out, const latest_row& in) -> void {
+      out->latest = in.latest;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, latest_row> {
+ public:
+
+  const int64_t& latest() const {
+    return impl().latest_impl();
+  }
+
+
+  void copy_into(latest_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<latest_row> : public RecordAccessor<UniRecordAccessor<latest_row>, latest_row> {
+ public:
+  UniRecordAccessor(const latest_row* const vptr) : vptr_(vptr) {}
+
+ private:
+
+  const int64_t& latest_impl() const {
+    return vptr_->latest;
+  }
+
+
+
+  void copy_into_impl(latest_row* dst) const {
+
+    if (vptr_) {
+      dst->latest = vptr_->latest;
+    }
+  }
+
+
+  const latest_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<latest_row>, latest_row>;
+};
+
+template <>
+class SplitRecordAccessor<latest_row> : public RecordAccessor<SplitRecordAccessor<latest_row>, latest_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<latest_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<latest_row*>(vptrs[0])) {}
+
+ private:
+
+  const int64_t& latest_impl() const {
+    return vptr_0_->latest;
+  }
+
+
+
+  void copy_into_impl(latest_row* dst) const {
+
+    if (vptr_0_) {
+      dst->latest = vptr_0_->latest;
+    }
+
+  }
+
+
+  const latest_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<latest_row>, latest_row>;
+};
+
+
+template <>
+struct SplitParams<aggregate_row> {
+  using split_type_list = std::tuple<aggregate_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const aggregate_row& in) -> aggregate_row {
+      aggregate_row out;
+      out.count = in.count;
+      out.sum = in.sum;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](aggregate_row* out, const aggregate_row& in) -> void {
+      out->count = in.count;
+      out->sum = in.sum;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, aggregate_row> {
+ public:
+
+  const int64_t& count() const {
+    return impl().count_impl();
+  }
+
+
+  const int64_t& sum() const {
+    return impl().sum_impl();
+  }
+
+
+  void copy_into(aggregate_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<aggregate_row> : public RecordAccessor<UniRecordAccessor<aggregate_row>, aggregate_row> {
+ public:
+  UniRecordAccessor(const aggregate_row* const vptr) : vptr_(vptr) {}
+
+ private:
+
+  const int64_t& count_impl() const {
+    return vptr_->count;
+  }
+
+
+  const int64_t& sum_impl() const {
+    return vptr_->sum;
+  }
+
+
+
+  void copy_into_impl(aggregate_row* dst) const {
+
+    if (vptr_) {
+      dst->count = vptr_->count;
+      dst->sum = vptr_->sum;
+    }
+  }
+
+
+  const aggregate_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<aggregate_row>, aggregate_row>;
+};
+
+template <>
+class SplitRecordAccessor<aggregate_row> : public RecordAccessor<SplitRecordAccessor<aggregate_row>, aggregate_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<aggregate_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<aggregate_row*>(vptrs[0])) {}
+
+ private:
+
+  const int64_t& count_impl() const {
+    return vptr_0_->count;
+  }
+
+
+  const int64_t& sum_impl() const {
+    return vptr_0_->sum;
+  }
+
+
+
+  void copy_into_impl(aggregate_row* dst) const {
+
+    if (vptr_0_) {
+      dst->count = vptr_0_->count;
+      dst->sum = vptr_0_->sum;
+    }
+
+  }
+
+
+  const aggregate_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<aggregate_row>, aggregate_row>;
+};
+
+} // namespace bench
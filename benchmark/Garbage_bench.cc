@@ -7,13 +7,14 @@
 
 double db_params::constants::processor_tsc_frequency;
 
-enum { opt_dbid = 1, opt_nthrs, opt_time, opt_dbsz };
+enum { opt_dbid = 1, opt_nthrs, opt_time, opt_dbsz, opt_rdpct, opt_skew, opt_readers, opt_hold, opt_sample };
 
 struct cmd_params {
     db_params::db_params_id dbid;
     size_t db_size;
     int num_threads;
     double time_limit;
+    garbage_bench::gc_params gc;
 
     cmd_params() : dbid(db_params::db_params_id::Default), db_size(256), num_threads(1), time_limit(10.0) {}
 };
@@ -23,6 +24,11 @@ static const Clp_Option options[] = {
     { "nthreads",   't', opt_nthrs, Clp_ValInt,     Clp_Optional },
     { "time",       'l', opt_time,  Clp_ValDouble,  Clp_Optional },
     { "dbsize",     'z', opt_dbsz,  Clp_ValInt,     Clp_Optional },
+    { "read-ratio", 'r', opt_rdpct, Clp_ValInt,     Clp_Optional },
+    { "skew",       's', opt_skew,  Clp_ValDouble,  Clp_Optional },
+    { "readers",    'R', opt_readers, Clp_ValInt,   Clp_Optional },
+    { "reader-hold", 0,  opt_hold,  Clp_ValDouble,  Clp_Optional },
+    { "sample-ms",   0,  opt_sample, Clp_ValDouble, Clp_Optional },
 };
 
 template <typename DBParams>
@@ -38,18 +44,28 @@ void execute(cmd_params& p) {
     auto time_limit = p.time_limit;
     std::cout << "Number of threads: " << nthreads << std::endl;
 
-    r_type_nopred r_nopred(nthreads, time_limit, db_nopred);
+    r_type_nopred r_nopred(nthreads, time_limit, db_nopred, p.gc);
+    // every start() is timed, so its RCU cleanup can be charged per thread
+    PhaseProfile::set_sample_period(1);
 
     size_t ncommits;
 
     auto advancer = std::thread(&Transaction::epoch_advancer, nullptr);
 
+    prof.describe<DBParams>("garbage", nthreads);
+    prof.config("time_limit", time_limit);
+    prof.config("db_size", p.db_size);
+    prof.config("read_pct", p.gc.read_pct);
+    prof.config("skew", p.gc.skew);
+    prof.config("readers", p.gc.num_readers);
     prof.start(Profiler::perf_mode::record);
     ncommits = r_nopred.run();
     prof.finish(ncommits);
 
     std::cout << "Cleaning up\n";
-    Transaction::rcu_release_all(advancer, nthreads);
+    Transaction::rcu_release_all(advancer, r_nopred.num_threads());
+
+    r_nopred.report(stdout);
 
     auto counters = Transaction::txp_counters_combined();
     auto ndreq = counters.p(txp_rcu_del_req);
@@ -105,6 +121,21 @@ int main(int argc, const char * const *argv) {
         case opt_time:
             p.time_limit = clp->val.d;
             break;
+        case opt_rdpct:
+            p.gc.read_pct = clp->val.i;
+            break;
+        case opt_skew:
+            p.gc.skew = clp->val.d;
+            break;
+        case opt_readers:
+            p.gc.num_readers = clp->val.i;
+            break;
+        case opt_hold:
+            p.gc.reader_hold_ms = clp->val.d;
+            break;
+        case opt_sample:
+            p.gc.sample_ms = clp->val.d;
+            break;
         default:
             ret_code = 1;
             clp_stop = true;
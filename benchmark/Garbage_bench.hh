@@ -1,6 +1,16 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
 #include <thread>
+#include <unistd.h>
+#include <sampling.hh>
 
 #include "DB_index.hh"
+#include "DB_latency.hh"
+#include "PhaseProfile.hh"
 #include "TBox.hh"
 #include "TCounter.hh"
 
@@ -169,77 +179,167 @@ void initialize_db(garbage_db<DBParams>& db, size_t db_size) {
     db.size() = db_size;
 }
 
+// What a run varies besides the thread count and time limit
+struct gc_params {
+    int read_pct = 0;            // transactions that only read their key
+    double skew = 0;             // Zipf skew of keys; 0 walks them in order
+    int num_readers = 0;         // long-running reader threads
+    double reader_hold_ms = 100; // how long each reader holds its snapshot
+    double sample_ms = 100;      // period of the memory and chain samples
+};
+
+// The process's resident set, from /proc/self/statm; 0 if unavailable
+inline size_t rss_bytes() {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    return n == 2 ? resident * size_t(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+// One sample of the monitor thread
+struct gc_sample {
+    double seconds;      // since the run started
+    size_t rss;
+    // version chains a reader at the oldest snapshot walks (MVCC only);
+    // chains[n] counts rows with a chain of n versions, the last bucket
+    // counting every longer chain
+    static constexpr size_t max_chain = 64;
+    std::array<size_t, max_chain + 1> chains;
+};
+
 template <typename DBParams>
 class garbage_runner {
 public:
     typedef garbage_row::NamedColumn nc;
-    void run_txn(size_t key) {
-        bool inc_inserts = false;
-        bool inc_deletes = false;
-        RWTRANSACTION {
-            inc_inserts = false;
-            inc_deletes = false;
-            auto [success, found, row, value] = db.table().select_split_row(garbage_key(key), {{nc::value, access_t::read}});
-            (void) row;
-            (void) value;
-            if (success) {
-                if (found) {
-                    std::tie(success, found) = db.table().delete_row(garbage_key(key));
-                    TXN_DO(success);
-                    if (found) {
-                        inc_deletes = true;
-                    }
-                } else {
-                    std::tie(success, found) = db.table().insert_row(garbage_key(key), Sto::tx_alloc<garbage_row>());
-                    TXN_DO(success);
-                    if (!found) {
-                        inc_inserts = true;
-                    }
-                }
-            }
-        } RETRY(true);
-        if (inc_inserts) {
-            TXP_INCREMENT(txp_gc_inserts);
-        }
-        if (inc_deletes) {
-            TXP_INCREMENT(txp_gc_deletes);
-        }
-    }
 
     // returns the total number of transactions committed
     size_t run() {
         std::vector<std::thread> thrs;
         std::vector<size_t> txn_cnts((size_t)num_runners, 0);
+        starts.assign((size_t)num_runners, bench::latency_histogram());
+        reader_commits = reader_aborts = 0;
+        done = false;
+        uint64_t tsc_begin = read_tsc();
         for (int i = 0; i < num_runners; ++i)
             thrs.emplace_back(
                 &garbage_runner::runner_thread, this, i, std::ref(txn_cnts[i]));
+        std::vector<std::thread> service;
+        for (int i = 0; i < params.num_readers; ++i)
+            service.emplace_back(&garbage_runner::reader_thread, this, num_runners + i);
+        service.emplace_back(&garbage_runner::monitor_thread, this,
+                             num_runners + params.num_readers, tsc_begin);
         for (auto& t : thrs)
             t.join();
+        done = true;
+        for (auto& t : service)
+            t.join();
         size_t combined_txn_count = 0;
         for (auto c : txn_cnts)
             combined_txn_count += c;
         return combined_txn_count;
     }
 
-    garbage_runner(int nthreads, double time_limit, garbage_db<DBParams>& database)
-        : num_runners(nthreads), tsc_elapse_limit(), db(database) {
+    // Memory over time, worst start() latencies, RCU time per runner, and
+    // the last chain length distribution
+    void report(FILE* f) const;
+
+    int num_threads() const {
+        return num_runners + params.num_readers + 1;
+    }
+
+    garbage_runner(int nthreads, double time_limit, garbage_db<DBParams>& database,
+                   const gc_params& p = gc_params())
+        : num_runners(nthreads), tsc_elapse_limit(), db(database), params(p) {
         using db_params::constants;
         tsc_elapse_limit = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
     }
 
 private:
+    // Runs body in a transaction until it commits, timing each start()
+    template <typename Body>
+    void run_timed(bool readonly, bench::latency_histogram& lat, Body body) {
+        TransactionLoopGuard guard;
+        while (true) {
+            uint64_t t0 = read_tsc();
+            if (readonly)
+                guard.start_readonly();
+            else
+                guard.start();
+            lat.record(read_tsc() - t0);
+            if (!readonly)
+                Sto::mvcc_rw_upgrade();
+            if (body() && guard.try_commit())
+                break;
+            if (!guard.may_retry())
+                break;
+        }
+    }
+
+    // Inserts key if it's absent, else deletes it
+    bool toggle_row(size_t key, bool& inserted, bool& deleted) {
+        inserted = deleted = false;
+        auto [success, found, row, value] = db.table().select_split_row(garbage_key(key), {{nc::value, access_t::read}});
+        (void) row;
+        (void) value;
+        TXN_CHECK(success);
+        if (found) {
+            std::tie(success, found) = db.table().delete_row(garbage_key(key));
+            TXN_CHECK(success);
+            deleted = found;
+        } else {
+            std::tie(success, found) = db.table().insert_row(garbage_key(key), Sto::tx_alloc<garbage_row>());
+            TXN_CHECK(success);
+            inserted = !found;
+        }
+        return true;
+    }
+
+    bool read_row(size_t key) {
+        auto [success, found, row, value] = db.table().select_split_row(garbage_key(key), {{nc::value, access_t::read}});
+        (void) found;
+        (void) row;
+        (void) value;
+        TXN_CHECK(success);
+        return true;
+    }
+
+    void run_txn(size_t key, bool read, bench::latency_histogram& lat) {
+        if (read) {
+            run_timed(true, lat, [&] { return read_row(key); });
+            return;
+        }
+        bool inserted = false;
+        bool deleted = false;
+        run_timed(false, lat, [&] { return toggle_row(key, inserted, deleted); });
+        if (inserted) {
+            TXP_INCREMENT(txp_gc_inserts);
+        }
+        if (deleted) {
+            TXP_INCREMENT(txp_gc_deletes);
+        }
+    }
+
     void runner_thread(int runner_id, size_t& committed_txns) {
         ::TThread::set_id(runner_id);
         db.table().thread_init();
         std::mt19937 gen(runner_id);
         std::uniform_int_distribution<uint64_t> dist(0, db.size() - 1);
+        sampling::xoshiro256ss rng(runner_id + 1);
+        std::unique_ptr<sampling::StoZipfRejectionSampler<uint64_t>> zipf;
+        if (params.skew > 0)
+            zipf.reset(new sampling::StoZipfRejectionSampler<uint64_t>(0, db.size() - 1, params.skew));
+        auto& lat = starts[runner_id];
 
         size_t thread_txn_count = 0;
         auto tsc_begin = read_tsc();
         size_t key = dist(gen) % db.size();
         while (true) {
-            run_txn(key);
-            key = (key + 1) % db.size();
+            bool read = params.read_pct > 0 && rng.below(100) < uint64_t(params.read_pct);
+            run_txn(key, read, lat);
+            key = zipf ? zipf->sample(rng) : (key + 1) % db.size();
             ++thread_txn_count;
             if ((thread_txn_count & 0xfful) == 0) {
                 if (read_tsc() - tsc_begin >= tsc_elapse_limit)
@@ -250,9 +350,126 @@ private:
         committed_txns = thread_txn_count;
     }
 
+    // Holds a read-only snapshot open for reader_hold_ms at a time, which
+    // keeps the versions it could read, and the epoch it started in, alive
+    void reader_thread(int id) {
+        ::TThread::set_id(id);
+        db.table().thread_init();
+        sampling::xoshiro256ss rng(id + 1);
+        auto hold = std::chrono::microseconds(int64_t(params.reader_hold_ms * 1000));
+        bench::latency_histogram lat;
+        while (!done) {
+            size_t key = rng.below(db.size());
+            bool first = true;
+            run_timed(true, lat, [&] {
+                    if (!first)
+                        ++reader_aborts;
+                    first = false;
+                    if (!read_row(key))
+                        return false;
+                    std::this_thread::sleep_for(hold);
+                    return read_row((key + 1) % db.size());
+                });
+            ++reader_commits;
+        }
+    }
+
+    void monitor_thread(int id, uint64_t tsc_begin) {
+        ::TThread::set_id(id);
+        db.table().thread_init();
+        using db_params::constants;
+        double ticks_per_s = constants::processor_tsc_frequency * constants::billion;
+        auto period = std::chrono::microseconds(int64_t(params.sample_ms * 1000));
+        while (true) {
+            gc_sample s;
+            s.seconds = (read_tsc() - tsc_begin) / ticks_per_s;
+            s.rss = rss_bytes();
+            s.chains.fill(0);
+            if constexpr (DBParams::MVCC) {
+                TRANSACTION {
+                    s.chains.fill(0);
+                    auto rtid = Sto::read_tid();
+                    for (size_t k = 0; k < db.size(); ++k) {
+                        size_t n = db.table().chain_length(garbage_key(k), rtid);
+                        ++s.chains[std::min(n, gc_sample::max_chain)];
+                    }
+                } RETRY(true);
+            }
+            samples.push_back(s);
+            if (done)
+                break;
+            std::this_thread::sleep_for(period);
+        }
+    }
+
     int num_runners;
     uint64_t tsc_elapse_limit;
     garbage_db<DBParams> db;
+    gc_params params;
+    std::atomic<bool> done;
+    std::atomic<size_t> reader_commits;
+    std::atomic<size_t> reader_aborts;
+    std::vector<bench::latency_histogram> starts;
+    std::vector<gc_sample> samples;
 };
 
+template <typename DBParams>
+void garbage_runner<DBParams>::report(FILE* f) const {
+    using db_params::constants;
+    double ticks_per_us = constants::processor_tsc_frequency * 1000;
+    if (samples.empty())
+        return;
+
+    fprintf(f, "Memory over time (s, RSS MB%s):\n",
+            DBParams::MVCC ? ", rows by chain length: mean/p99/max" : "");
+    for (auto& s : samples) {
+        fprintf(f, "  %7.2f %9.1f", s.seconds, s.rss / 1048576.0);
+        size_t rows = 0, sum = 0, max = 0;
+        for (size_t n = 1; n <= gc_sample::max_chain; ++n) {
+            rows += s.chains[n];
+            sum += n * s.chains[n];
+            if (s.chains[n])
+                max = n;
+        }
+        if (rows) {
+            size_t r99 = std::max(size_t(1), size_t(0.99 * rows + 0.5)), seen = 0, p99 = 0;
+            for (size_t n = 1; n <= gc_sample::max_chain && !p99; ++n)
+                if ((seen += s.chains[n]) >= r99)
+                    p99 = n;
+            fprintf(f, " %7.2f/%zu/%zu%s", double(sum) / rows, p99, max,
+                    max == gc_sample::max_chain ? "+" : "");
+        }
+        fprintf(f, "\n");
+    }
+    fprintf(f, "Peak RSS sampled: %.1f MB\n",
+            std::max_element(samples.begin(), samples.end(),
+                             [](const gc_sample& a, const gc_sample& b) { return a.rss < b.rss; })->rss / 1048576.0);
+
+    if (DBParams::MVCC) {
+        auto& last = samples.back();
+        fprintf(f, "Chain lengths at the end (versions: rows):");
+        for (size_t n = 1; n <= gc_sample::max_chain; ++n)
+            if (last.chains[n])
+                fprintf(f, " %zu%s: %zu", n, n == gc_sample::max_chain ? "+" : "", last.chains[n]);
+        fprintf(f, "\n");
+    }
+
+    bench::latency_histogram all;
+    fprintf(f, "Transaction::start() latency (us), per runner: p50/p99/max, RCU cleanup in start() ms\n");
+    for (int i = 0; i < num_runners; ++i) {
+        auto& h = starts[i];
+        all.merge(h);
+        auto rcu = PhaseProfile::thread_summary(i, ph_start_rcu);
+        fprintf(f, "  runner %2d: %.2f/%.2f/%.2f, %.2f\n", i,
+                h.quantile(0.5) / ticks_per_us, h.quantile(0.99) / ticks_per_us,
+                h.max() / ticks_per_us,
+                rcu.ticks * double(PhaseProfile::sample_period()) / ticks_per_us / 1000);
+    }
+    fprintf(f, "  all:       %.2f/%.2f/%.2f\n", all.quantile(0.5) / ticks_per_us,
+            all.quantile(0.99) / ticks_per_us, all.max() / ticks_per_us);
+    if (params.num_readers)
+        fprintf(f, "Long readers: %zu snapshots held, %zu attempts aborted\n",
+                reader_commits.load(), reader_aborts.load());
+}
+
 };
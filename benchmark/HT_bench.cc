@@ -14,7 +14,7 @@ using bench::db_profiler;
 
 enum {
     opt_dbid = 1, opt_nrdrs, opt_nwtrs, opt_mode, opt_time, opt_txns, opt_perf,
-    opt_pfcnt, opt_gc, opt_node, opt_comm, opt_nont, opt_rtsz, opt_bare
+    opt_pfcnt, opt_gc, opt_node, opt_comm, opt_nont, opt_rtsz, opt_bare, opt_layout
 };
 
 static const Clp_Option options[] = {
@@ -32,6 +32,7 @@ static const Clp_Option options[] = {
     { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate| Clp_Optional },
     { "nontrans",     'N', opt_nont,  Clp_NoVal,     Clp_Negate| Clp_Optional },
     { "bare",         'B', opt_bare,  Clp_NoVal,     Clp_Negate| Clp_Optional },
+    { "layout",       'L', opt_layout, Clp_ValString, Clp_Optional },
 };
 
 static inline void print_usage(const char *argv_0) {
@@ -63,7 +64,10 @@ static inline void print_usage(const char *argv_0) {
        << "  --commute (or -x)" << std::endl
        << "    Enable commutative updates in MVCC (default false)." << std::endl
        << "  --bare (or -B)" << std::endl
-       << "    Run bare framework experiments (default false)." << std::endl;
+       << "    Run bare framework experiments (default false)." << std::endl
+       << "  --layout=<STRING> (or -L<STRING>)" << std::endl
+       << "    Specify the hash table layout: chained or hopscotch (default chained)." << std::endl
+       << "    The hopscotch table does not support mvcc." << std::endl;
     std::cout << ss.str() << std::flush;
 }
 
@@ -408,6 +412,8 @@ public:
             case opt_bare:
                 bare = !clp->negated;
                 break;
+            case opt_layout:
+                break;
             default:
                 print_usage(argv[0]);
                 ret = 1;
@@ -501,6 +507,16 @@ public:
 
 };
 
+template <typename DBParams>
+static int execute_layout(bool hopscotch, int argc, const char *const *argv) {
+    if constexpr (!DBParams::MVCC) {
+        if (hopscotch) {
+            return ht_access<hopscotch_params<DBParams>>::execute(argc, argv);
+        }
+    }
+    return ht_access<DBParams>::execute(argc, argv);
+}
+
 }; // namespace ycsb
 
 using namespace htbench;
@@ -519,6 +535,7 @@ int main(int argc, const char *const *argv) {
     bool clp_stop = false;
     bool node_tracking = false;
     bool enable_commute = false;
+    bool hopscotch = false;
     while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
         switch (opt) {
         case opt_dbid:
@@ -537,6 +554,17 @@ int main(int argc, const char *const *argv) {
         case opt_comm:
             enable_commute = !clp->negated;
             break;
+        case opt_layout:
+            if (clp->val.s && strcmp(clp->val.s, "hopscotch") == 0) {
+                hopscotch = true;
+            } else if (!clp->val.s || strcmp(clp->val.s, "chained") != 0) {
+                std::cout << "Unsupported layout: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
         default:
             break;
         }
@@ -552,23 +580,28 @@ int main(int argc, const char *const *argv) {
     else
         constants::processor_tsc_frequency = cpu_freq;
 
+    if (hopscotch && dbid == db_params_id::MVCC) {
+        std::cerr << "The hopscotch layout does not support mvcc." << std::endl;
+        return 1;
+    }
+
     switch (dbid) {
     case db_params_id::Default:
         if (node_tracking && enable_commute) {
-            ret_code = ht_access<db_default_commute_node_params>::execute(argc, argv);
+            ret_code = execute_layout<db_default_commute_node_params>(hopscotch, argc, argv);
         } else if (node_tracking) {
-            ret_code = ht_access<db_default_node_params>::execute(argc, argv);
+            ret_code = execute_layout<db_default_node_params>(hopscotch, argc, argv);
         } else if (enable_commute) {
-            ret_code = ht_access<db_default_commute_params>::execute(argc, argv);
+            ret_code = execute_layout<db_default_commute_params>(hopscotch, argc, argv);
         } else {
-            ret_code = ht_access<db_default_params>::execute(argc, argv);
+            ret_code = execute_layout<db_default_params>(hopscotch, argc, argv);
         }
         break;
     case db_params_id::Opaque:
         if (enable_commute) {
-            ret_code = ht_access<db_opaque_commute_params>::execute(argc, argv);
+            ret_code = execute_layout<db_opaque_commute_params>(hopscotch, argc, argv);
         } else {
-            ret_code = ht_access<db_opaque_params>::execute(argc, argv);
+            ret_code = execute_layout<db_opaque_params>(hopscotch, argc, argv);
         }
         break;
     /*
@@ -587,20 +620,20 @@ int main(int argc, const char *const *argv) {
             std::cerr << "Warning: node tracking and commute options ignored." << std::endl;
         }
         if (enable_commute) {
-            ret_code = ht_access<db_tictoc_commute_params>::execute(argc, argv);
+            ret_code = execute_layout<db_tictoc_commute_params>(hopscotch, argc, argv);
         } else {
-            ret_code = ht_access<db_tictoc_params>::execute(argc, argv);
+            ret_code = execute_layout<db_tictoc_params>(hopscotch, argc, argv);
         }
         break;
     case db_params_id::MVCC:
         if (node_tracking && enable_commute) {
-            ret_code = ht_access<db_mvcc_commute_node_params>::execute(argc, argv);
+            ret_code = execute_layout<db_mvcc_commute_node_params>(hopscotch, argc, argv);
         } else if (node_tracking) {
-            ret_code = ht_access<db_mvcc_node_params>::execute(argc, argv);
+            ret_code = execute_layout<db_mvcc_node_params>(hopscotch, argc, argv);
         } else if (enable_commute) {
-            ret_code = ht_access<db_mvcc_commute_params>::execute(argc, argv);
+            ret_code = execute_layout<db_mvcc_commute_params>(hopscotch, argc, argv);
         } else {
-            ret_code = ht_access<db_mvcc_params>::execute(argc, argv);
+            ret_code = execute_layout<db_mvcc_params>(hopscotch, argc, argv);
         }
         break;
     default:
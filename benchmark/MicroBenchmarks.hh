@@ -214,6 +214,16 @@ void Tester<DSImpl, WLImpl>::execute() {
     prepopulate();
     std::cout << "Running" << std::endl;
 
+    profiler.config("benchmark", "micro");
+    profiler.config("dbid", db_params::db_params_id_names[static_cast<int>(params.dbid)]);
+    profiler.config("threads", params.nthreads);
+    profiler.config("time_limit", params.time_limit);
+    profiler.config("ops_per_txn", params.opspertrans);
+    profiler.config("ops_per_ro_txn", params.opspertrans_ro);
+    profiler.config("key_size", params.key_sz);
+    profiler.config("zipf_skew", params.zipf_skew);
+    profiler.config("readonly_percent", params.readonly_percent);
+    profiler.config("write_percent", params.write_percent);
     profiler.start(Profiler::perf_mode::record);
     auto num_commits = run_benchmark(profiler.start_timestamp());
     profiler.finish(num_commits);
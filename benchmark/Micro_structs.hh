@@ -79,7 +79,7 @@ public:
     explicit VerSel(type v) : vers_() { (void)v; }
     VerSel(type v, bool insert) : vers_() { (void)v; (void)insert; }
 
-    static int map_impl(int col_n) {
+    constexpr static int map_impl(int col_n) {
         uint64_t mask = ~(~0ul << vidx_width) ;
         int shift = col_n * vidx_width;
         return ((col_cell_map & (mask << shift)) >> shift);
@@ -119,11 +119,12 @@ class VerSel<two_version_row, VersImpl> : public VerSelBase<VerSel<two_version_r
 public:
     typedef VersImpl version_type;
     static constexpr size_t num_versions = 2;
+    static constexpr bool versions_first = true;
 
     explicit VerSel(type v) : vers_() { (void)v; }
     VerSel(type v, bool insert) : vers_() { (void)v; (void)insert; }
 
-    static int map_impl(int col_n) {
+    constexpr static int map_impl(int col_n) {
         uint64_t mask = ~(~0ul << vidx_width) ;
         int shift = col_n * vidx_width;
         return ((col_cell_map & (mask << shift)) >> shift);
@@ -165,11 +166,12 @@ class VerSel<four_version_row, VersImpl> : public VerSelBase<VerSel<four_version
 public:
     typedef VersImpl version_type;
     static constexpr size_t num_versions = 4;
+    static constexpr bool versions_first = true;
 
     explicit VerSel(type v) : vers_() { (void)v; }
     VerSel(type v, bool insert) : vers_() { (void)v; (void)insert; }
 
-    static int map_impl(int col_n) {
+    constexpr static int map_impl(int col_n) {
         uint64_t mask = ~(~0ul << vidx_width) ;
         int shift = col_n * vidx_width;
         return ((col_cell_map & (mask << shift)) >> shift);
@@ -215,11 +217,12 @@ class VerSel<eight_version_row, VersImpl> : public VerSelBase<VerSel<eight_versi
 public:
     typedef VersImpl version_type;
     static constexpr size_t num_versions = 8;
+    static constexpr bool versions_first = true;
 
     explicit VerSel(type v) : vers_() { (void)v; }
     VerSel(type v, bool insert) : vers_() { (void)v; (void)insert; }
 
-    static int map_impl(int col_n) {
+    constexpr static int map_impl(int col_n) {
         uint64_t mask = ~(~0ul << vidx_width) ;
         int shift = col_n * vidx_width;
         return ((col_cell_map & (mask << shift)) >> shift);
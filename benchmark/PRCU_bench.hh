@@ -15,6 +15,7 @@
 #include "DB_index.hh"
 #include "DB_params.hh"
 #include "Hashtable.hh"
+#include "HopscotchHashtable.hh"
 
 namespace prcubench {
 
@@ -25,6 +26,19 @@ using bench::unordered_index;
 
 static constexpr uint64_t ht_table_size = 10000000;
 
+// Runs the benchmark on HopscotchHashtable instead of the chained Hashtable
+template <typename DBParams>
+class hopscotch_params : public DBParams {
+public:
+    static constexpr bool Hopscotch = true;
+};
+
+template <typename DBParams, typename = void>
+struct uses_hopscotch : std::false_type {};
+template <typename DBParams>
+struct uses_hopscotch<DBParams, std::void_t<decltype(DBParams::Hopscotch)>>
+    : std::integral_constant<bool, DBParams::Hopscotch> {};
+
 template <typename DBParams>
 class ht_table {
 public:
@@ -46,7 +60,10 @@ public:
             Hashtable_opaque_params<ht_key, ht_value>,
             Hashtable_params<ht_key, ht_value>>
             > ht_params_type;
-    typedef Hashtable<ht_params_type> ht_table_type;
+    typedef std::conditional_t<
+        uses_hopscotch<DBParams>::value,
+        HopscotchHashtable<ht_params_type>,
+        Hashtable<ht_params_type>> ht_table_type;
     static constexpr auto BlindAccess = ht_table_type::BlindAccess;
     static constexpr auto ReadOnlyAccess = ht_table_type::ReadOnlyAccess;
     static constexpr auto ReadWriteAccess = ht_table_type::ReadWriteAccess;
@@ -82,10 +82,16 @@ int main(int argc, const char * const *argv) {
 
     size_t ncommits;
 
+    prof.describe<params>("predicate", nthreads);
+    prof.config("time_limit", time_limit);
+    prof.config("db_size", db_size);
+    prof.config("read_write", p.read_write);
+    prof.config("predicates", true);
     prof.start(Profiler::perf_mode::record);
     ncommits = r_wpred.run(!p.read_write);
     prof.finish(ncommits);
 
+    prof.config("predicates", false);
     prof.start(Profiler::perf_mode::record);
     ncommits = r_nopred.run(!p.read_write);
     prof.finish(ncommits);
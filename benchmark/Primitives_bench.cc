@@ -0,0 +1,566 @@
+// Microbenchmarks of STO core primitives, measured in isolation and single
+// threaded: tracking set lookups and insertions, key packing, the
+// transaction buffer, RCU callback sets, version locks, and MVCC version
+// chain lookups.
+//
+// Each benchmark runs its operation in a loop whose length is calibrated
+// until one run takes --min-time, then repeats that run --reps times and
+// reports the median and minimum time per operation. Compare builds (for
+// instance CICADA_HASHTABLE=1 against the default) by running both and
+// diffing the output.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "clp.h"
+#include "Sto.hh"
+#include "TRcu.hh"
+#include "TicTocVersions.hh"
+#include "TMvBox.hh"
+
+namespace primbench {
+
+// Keeps the compiler from discarding the computation of x
+template <typename T>
+inline void keep(const T& x) {
+    asm volatile("" : : "r,m"(x) : "memory");
+}
+
+class state {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    state(uint64_t iterations, unsigned arg)
+        : iterations_(iterations), arg_(arg), items_(1), stopped_(false) {
+    }
+
+    uint64_t iterations() const {
+        return iterations_;
+    }
+    unsigned arg() const {
+        return arg_;
+    }
+    // Each iteration performs n operations
+    void set_items_per_iteration(unsigned n) {
+        items_ = n;
+    }
+
+    // Restarts the clock; call after untimed setup
+    void start_timing() {
+        t0_ = clock::now();
+        stopped_ = false;
+    }
+    // Stops the clock; call before untimed teardown
+    void stop_timing() {
+        if (!stopped_) {
+            t1_ = clock::now();
+            stopped_ = true;
+        }
+    }
+
+    double seconds() const {
+        return std::chrono::duration<double>(t1_ - t0_).count();
+    }
+    double ns_per_op() const {
+        return seconds() * 1e9 / (double(iterations_) * items_);
+    }
+
+private:
+    uint64_t iterations_;
+    unsigned arg_;
+    unsigned items_;
+    bool stopped_;
+    clock::time_point t0_;
+    clock::time_point t1_;
+};
+
+struct benchmark {
+    const char* name;
+    void (*run)(state&);
+    std::vector<unsigned> args;   // one benchmark per argument; none: run once
+};
+
+// A tracked object that never conflicts
+class null_object : public TObject {
+public:
+    bool lock(TransItem&, Transaction&) override {
+        return true;
+    }
+    bool check(TransItem&, Transaction&) override {
+        return true;
+    }
+    void install(TransItem&, Transaction&) override {
+    }
+    void unlock(TransItem&) override {
+    }
+};
+
+static null_object object;
+
+static TransactionBuffer scratch;
+
+static void* xkey(uint64_t k) {
+    return Packer<uint64_t>::pack(scratch, k);
+}
+
+// Starts a transaction tracking items with keys [0, n)
+static Transaction& fill_tset(unsigned n) {
+    Sto::start_transaction();
+    for (uint64_t k = 0; k != n; ++k)
+        Sto::item(&object, k);
+    return *Sto::transaction();
+}
+
+// Ends the benchmark's transaction. Commits: aborting would make the
+// next start back off
+static void finish_txn() {
+    always_assert(Sto::try_commit(), "benchmark transaction aborted");
+}
+
+
+// Tracking set
+
+// Per item, including the transaction's start and commit
+static void item_insert(state& st) {
+    unsigned n = st.arg();
+    st.set_items_per_iteration(n);
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        Sto::start_transaction();
+        for (uint64_t k = 0; k != n; ++k)
+            keep(Sto::item(&object, k));
+        finish_txn();
+    }
+}
+
+static void item_hit(state& st) {
+    unsigned n = st.arg();
+    fill_tset(n);
+    st.start_timing();
+    uint64_t k = 0;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        keep(Sto::item(&object, k));
+        if (++k == n)
+            k = 0;
+    }
+    st.stop_timing();
+    finish_txn();
+}
+
+static void check_item_miss(state& st) {
+    unsigned n = st.arg();
+    fill_tset(n);
+    st.start_timing();
+    uint64_t k = n;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        keep(Sto::check_item(&object, k));
+        if (++k == 2 * uint64_t(n))
+            k = n;
+    }
+    st.stop_timing();
+    finish_txn();
+}
+
+// The alternative item indexes, driven directly over a filled tracking set.
+// In a default build, item/hit and check_item/miss above measure the
+// default hashtable on the same keys.
+template <typename H>
+static void index_build(state& st) {
+    unsigned n = st.arg();
+    Transaction& txn = fill_tset(n);
+    H h(txn);
+    st.set_items_per_iteration(n);
+    st.start_timing();
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        for (uint64_t k = 0; k != n; ++k)
+            h.put(&object, xkey(k), k);
+        h.clear(n);
+    }
+    st.stop_timing();
+    finish_txn();
+}
+
+// An index holding keys [0, n), sized as after a run of n-item transactions
+template <typename H>
+static void index_fill(H& h, unsigned n) {
+    for (unsigned round = 0; round != 2; ++round) {
+        if (round)
+            h.clear(n);
+        for (uint64_t k = 0; k != n; ++k)
+            h.put(&object, xkey(k), k);
+    }
+    for (uint64_t k = 0; k != n; ++k)
+        always_assert(h.find(&object, xkey(k)) == &Sto::item(&object, k).item());
+}
+
+template <typename H>
+static void index_find(state& st) {
+    unsigned n = st.arg();
+    Transaction& txn = fill_tset(n);
+    H h(txn);
+    index_fill(h, n);
+    st.start_timing();
+    uint64_t k = 0;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        keep(h.find(&object, xkey(k)));
+        if (++k == n)
+            k = 0;
+    }
+    st.stop_timing();
+    finish_txn();
+}
+
+template <typename H>
+static void index_miss(state& st) {
+    unsigned n = st.arg();
+    Transaction& txn = fill_tset(n);
+    H h(txn);
+    index_fill(h, n);
+    st.start_timing();
+    uint64_t k = n;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        keep(h.find(&object, xkey(k)));
+        if (++k == 2 * uint64_t(n))
+            k = n;
+    }
+    st.stop_timing();
+    finish_txn();
+}
+
+
+// Key packing and the transaction buffer
+
+struct wide_key {
+    uint64_t w[3];
+    bool operator==(const wide_key& x) const {
+        return memcmp(w, x.w, sizeof(w)) == 0;
+    }
+};
+
+static constexpr unsigned buffer_batch = 256;
+
+static void pack_simple(state& st) {
+    TransactionBuffer buf;
+    for (uint64_t i = 0; i != st.iterations(); ++i)
+        keep(Packer<uint64_t>::pack(buf, i));
+}
+
+static void pack_wide(state& st) {
+    TransactionBuffer buf;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        keep(Packer<wide_key>::pack(buf, wide_key{{i, i, i}}));
+        if (i % buffer_batch == buffer_batch - 1)
+            buf.clear();
+    }
+}
+
+// pack_unique of a key already in the buffer, with arg unique keys packed
+static void pack_unique_hit(state& st) {
+    unsigned n = st.arg();
+    TransactionBuffer buf;
+    for (uint64_t k = 0; k != n; ++k)
+        Packer<wide_key>::pack_unique(buf, wide_key{{k, k, k}});
+    st.start_timing();
+    uint64_t k = 0;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        keep(Packer<wide_key>::pack_unique(buf, wide_key{{k, k, k}}));
+        if (++k == n)
+            k = 0;
+    }
+    st.stop_timing();
+}
+
+template <size_t N>
+static void buffer_allocate(state& st) {
+    TransactionBuffer buf;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        keep(buf.allocate<std::array<char, N>>());
+        if (i % buffer_batch == buffer_batch - 1)
+            buf.clear();
+    }
+}
+
+static void buffer_allocate_string(state& st) {
+    TransactionBuffer buf;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        keep(buf.allocate<std::string>("a string longer than the small buffer"));
+        if (i % buffer_batch == buffer_batch - 1)
+            buf.clear();
+    }
+}
+
+
+// RCU callback sets
+
+static void rcu_noop(void*) {
+}
+
+static constexpr unsigned rcu_batch = 4096;
+
+// Adds callbacks, arg per epoch, cleaning every rcu_batch adds
+template <bool Lane>
+static void rcu_add_clean(state& st) {
+    unsigned per_epoch = st.arg();
+    static uint64_t argument;
+    TRcuSet set;
+    TRcuSet::epoch_type epoch = 1;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        if (Lane)
+            set.add<rcu_noop>(epoch, &argument);
+        else
+            set.add(epoch, rcu_noop, &argument);
+        if (i % per_epoch == per_epoch - 1)
+            ++epoch;
+        if (i % rcu_batch == rcu_batch - 1)
+            set.clean_until(++epoch);
+    }
+    set.clean_until(epoch + 1);
+}
+
+
+// Version locks
+
+// Exclusive lock and unlock, as data structures do around node updates
+template <typename V>
+static void version_lock_unlock(state& st) {
+    V v;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        v.lock_exclusive();
+        v.unlock_exclusive();
+    }
+    keep(v.value());
+}
+
+// The commit protocol's lock, then install of a new version. Eager
+// (2PL-style) versions take their write lock while executing; that lock
+// is part of the cycle here.
+template <typename V, bool Eager>
+static void version_commit(state& st) {
+    Sto::start_transaction();
+    TransItem& item = Sto::item(&object, 0).item();
+    V v;
+    typename V::type next = v.value();
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        if (Eager)
+            v.lock_exclusive();
+        if (!v.cp_try_lock(item, TThread::id()))
+            always_assert(false, "uncontended lock failed");
+        next += TransactionTid::increment_value;
+        v.cp_set_version_unlock(next);
+    }
+    keep(v.value());
+    finish_txn();
+}
+
+static void tictoc_commit(state& st) {
+    typedef TicTocVersion<> V;
+    Sto::start_transaction();
+    TransItem& item = Sto::item(&object, 0).item();
+    V v;
+    V::type ts = 1;
+    for (uint64_t i = 0; i != st.iterations(); ++i) {
+        if (!v.cp_try_lock(item, TThread::id()))
+            always_assert(false, "uncontended lock failed");
+        v.cp_set_version_unlock(++ts);
+    }
+    keep(v.value());
+    finish_txn();
+}
+
+
+// MVCC version chains
+
+class chain_box : public TMvBox<uint64_t> {
+public:
+    using TMvBox<uint64_t>::operator=;
+    const object_type& object() const {
+        return v_;
+    }
+};
+
+// Finds the oldest of arg committed versions, walking the whole chain
+static void mvcc_find(state& st) {
+    unsigned depth = st.arg();
+    static std::vector<chain_box*> boxes;   // MVCC objects are never freed
+    chain_box* box = new chain_box;
+    boxes.push_back(box);
+    std::vector<TransactionTid::type> wtids;
+    for (unsigned d = 0; d != depth; ++d) {
+        {
+            TransactionGuard guard;
+            *box = d;
+        }
+        wtids.push_back(box->object().head()->wtid());
+    }
+    auto tid = wtids.front();
+    always_assert(box->object().find(tid)->v() == 0);
+    st.start_timing();
+    for (uint64_t i = 0; i != st.iterations(); ++i)
+        keep(box->object().find(tid));
+    st.stop_timing();
+}
+
+
+static const std::vector<unsigned> tset_sizes = {1, 8, 64, 512, 2048};
+
+static const benchmark benchmarks[] = {
+    {"item/insert", item_insert, tset_sizes},
+    {"item/hit", item_hit, tset_sizes},
+    {"check_item/miss", check_item_miss, tset_sizes},
+    {"cicada_hashtable/build", index_build<CicadaHashtable>, tset_sizes},
+    {"cicada_hashtable/find", index_find<CicadaHashtable>, tset_sizes},
+    {"cicada_hashtable/miss", index_miss<CicadaHashtable>, tset_sizes},
+    {"adaptive_hashtable/build", index_build<AdaptiveHashtable>, tset_sizes},
+    {"adaptive_hashtable/find", index_find<AdaptiveHashtable>, tset_sizes},
+    {"adaptive_hashtable/miss", index_miss<AdaptiveHashtable>, tset_sizes},
+    {"packer/pack/8B", pack_simple, {}},
+    {"packer/pack/24B", pack_wide, {}},
+    {"packer/pack_unique_hit/24B", pack_unique_hit, {1, 8, 64}},
+    {"buffer/allocate/8B", buffer_allocate<8>, {}},
+    {"buffer/allocate/64B", buffer_allocate<64>, {}},
+    {"buffer/allocate/512B", buffer_allocate<512>, {}},
+    {"buffer/allocate/string", buffer_allocate_string, {}},
+    {"rcu/add_clean", rcu_add_clean<false>, {1, 64, 4096}},
+    {"rcu/lane_add_clean", rcu_add_clean<true>, {1, 64, 4096}},
+    {"version/TVersion/lock_unlock", version_lock_unlock<TVersion>, {}},
+    {"version/TVersion/commit", version_commit<TVersion, false>, {}},
+    {"version/TLockVersion/lock_unlock", version_lock_unlock<TLockVersion<false>>, {}},
+    {"version/TLockVersion/commit", version_commit<TLockVersion<false>, true>, {}},
+    {"version/TSwissVersion/lock_unlock", version_lock_unlock<TSwissVersion<false>>, {}},
+    {"version/TSwissVersion/commit", version_commit<TSwissVersion<false>, true>, {}},
+    {"version/TicTocVersion/commit", tictoc_commit, {}},
+    {"mvcc/find", mvcc_find, {1, 4, 16, 64}},
+};
+
+// Runs one benchmark and prints its line
+static void measure(const benchmark& b, const std::string& name, unsigned arg,
+                    double min_time, unsigned reps) {
+    // calibrate: grow the iteration count until a run takes min_time
+    uint64_t iterations = 1;
+    while (true) {
+        state st(iterations, arg);
+        st.start_timing();
+        b.run(st);
+        st.stop_timing();
+        double t = st.seconds();
+        if (t >= min_time || iterations >= (uint64_t(1) << 34))
+            break;
+        double scale = t > 0 ? 1.4 * min_time / t : 100;
+        iterations = std::max(iterations + 1, uint64_t(iterations * std::min(scale, 100.0)));
+    }
+
+    std::vector<double> ns;
+    for (unsigned r = 0; r != reps; ++r) {
+        state st(iterations, arg);
+        st.start_timing();
+        b.run(st);
+        st.stop_timing();
+        ns.push_back(st.ns_per_op());
+    }
+    std::sort(ns.begin(), ns.end());
+    printf("%-40s %12.2f %12.2f %14llu\n", name.c_str(), ns[ns.size() / 2], ns[0],
+           (unsigned long long) iterations);
+    fflush(stdout);
+}
+
+} // namespace primbench
+
+enum {
+    opt_filter = 1,
+    opt_mintime,
+    opt_reps,
+    opt_list
+};
+
+static const Clp_Option options[] = {
+    { "filter",   'f', opt_filter,  Clp_ValString, Clp_Optional },
+    { "min-time", 'l', opt_mintime, Clp_ValDouble, Clp_Optional },
+    { "reps",     'r', opt_reps,    Clp_ValUnsigned, Clp_Optional },
+    { "list",     0,   opt_list,    Clp_NoVal,     Clp_Optional }
+};
+
+static void print_usage(const char* prog) {
+    std::stringstream ss;
+    ss << "Usage: " << std::string(prog) << " [parameters...]" << std::endl
+       << "List of accepted parameters:" << std::endl
+       << "  --filter=STRING (-f), only run benchmarks whose names contain STRING" << std::endl
+       << "  --min-time=FLOAT (-l), seconds each timed run lasts at least, default 0.2" << std::endl
+       << "  --reps=NUMBER (-r), timed runs per benchmark, default 5" << std::endl
+       << "  --list, list benchmark names and exit" << std::endl;
+    std::cout << ss.str() << std::flush;
+}
+
+int main(int argc, const char* const* argv) {
+    using namespace primbench;
+    const char* filter = "";
+    double min_time = 0.2;
+    unsigned reps = 5;
+    bool list = false;
+
+    Clp_Parser* clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    int ret = 0;
+    int opt;
+    bool clp_stop = false;
+    while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
+        switch (opt) {
+        case opt_filter:
+            filter = clp->val.s;
+            break;
+        case opt_mintime:
+            min_time = clp->val.d;
+            break;
+        case opt_reps:
+            reps = std::max(clp->val.u, 1u);
+            break;
+        case opt_list:
+            list = true;
+            break;
+        default:
+            print_usage(argv[0]);
+            ret = 1;
+            clp_stop = true;
+            break;
+        }
+    }
+    Clp_DeleteParser(clp);
+    if (ret != 0)
+        return ret;
+
+    TThread::set_id(0);
+#if CICADA_HASHTABLE
+    const char* index = "CicadaHashtable";
+#elif ADAPTIVE_HASHTABLE
+    const char* index = "AdaptiveHashtable";
+#elif TSET_SIMD_SCAN
+    const char* index = "SIMD scan";
+#else
+    const char* index = "default hashtable";
+#endif
+    if (!list) {
+        printf("# item index: %s\n", index);
+        printf("%-40s %12s %12s %14s\n", "benchmark", "ns/op", "min ns/op", "iterations");
+    }
+
+    for (const benchmark& b : benchmarks) {
+        std::vector<unsigned> args = b.args;
+        if (args.empty())
+            args.push_back(0);
+        for (unsigned arg : args) {
+            std::string name = b.name;
+            if (!b.args.empty())
+                name += "/" + std::to_string(arg);
+            if (name.find(filter) == std::string::npos)
+                continue;
+            if (list)
+                printf("%s\n", name.c_str());
+            else
+                measure(b, name, arg, min_time, reps);
+        }
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include "Rubis_txns.hh"
 
 #include "DB_profiler.hh"
+#include "DB_loader.hh"
 #include "clp.h"
 
 using db_params::constants;
@@ -26,7 +27,7 @@ rubis::workload_mix_type rubis::workload_weightgram = {
 
 // @section: clp parser definitions
 enum {
-    opt_dbid = 1, opt_nthrs, opt_users, opt_items, opt_sigma, opt_time, opt_gc, opt_comm, opt_perf, opt_pfcnt
+    opt_dbid = 1, opt_nthrs, opt_users, opt_items, opt_sigma, opt_time, opt_gc, opt_comm, opt_perf, opt_pfcnt, opt_rofp, opt_blog
 };
 
 static const Clp_Option options[] = {
@@ -39,7 +40,9 @@ static const Clp_Option options[] = {
         { "garbage-collect", 'g', opt_gc, Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "perf",         'p', opt_perf,  Clp_NoVal,     Clp_Optional },
-        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional }
+        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "ro-fastpath",  'o', opt_rofp,  Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "bid-log",      0,   opt_blog,  Clp_NoVal,     Clp_Negate | Clp_Optional }
 };
 
 static inline void print_usage(const char *argv_0) {
@@ -65,7 +68,12 @@ static inline void print_usage(const char *argv_0) {
        << "  --perf (or -p)" << std::endl
        << "    Spawns perf profiler in record mode for the duration of the benchmark run." << std::endl
        << "  --perf-counter (or -c)" << std::endl
-       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl;
+       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl
+       << "  --ro-fastpath (or -o)" << std::endl
+       << "    Run ViewItem on the read-only fast path (default true)." << std::endl
+       << "  --bid-log" << std::endl
+       << "    PlaceBid appends to a per-item bid log, with commuting appends, instead of inserting into" << std::endl
+       << "    the bids table (default false). Combine with --commute to keep max bids as a commuting max." << std::endl;
     std::cout << ss.str() << std::flush;
 }
 
@@ -80,6 +88,7 @@ struct cmd_params {
     bool enable_comm;
     bool spawn_perf;
     bool perf_counter_mode;
+    bool bid_log;
 
     explicit cmd_params()
             : db_id(db_params::db_params_id::Default),
@@ -88,7 +97,7 @@ struct cmd_params {
               num_items(rubis::constants::num_items),
               item_sigma(rubis::constants::item_sigma),
               time(10.0), enable_gc(false), enable_comm(false),
-              spawn_perf(false), perf_counter_mode(false) {}
+              spawn_perf(false), perf_counter_mode(false), bid_log(false) {}
 };
 
 // @endsection: clp parser definitions
@@ -114,13 +123,18 @@ public:
         rp.num_users = p.num_users;
         rp.item_sigma = p.item_sigma;
         rp.user_sigma = rubis::constants::user_sigma;
+        rp.bid_log = p.bid_log;
 
         // Create DB
-        auto& db = *(new db_type());
+        auto& db = *(new db_type(std::max(p.num_items, (unsigned long)rubis::constants::num_items)));
 
-        // Load DB
-        loader_type loader(db);
-        loader.load();
+        // Load DB, on the CPU of runner 0: its tables aren't partitioned
+        bench::db_loader("rubis", 1, 1, [](int) { return 0; }).run([&](int) {
+                db.thread_init_all();
+                loader_type loader(db);
+                loader.load();
+                return uint64_t(0);
+            });
 
         // Start the GC thread if necessary
         std::thread advancer;
@@ -137,7 +151,15 @@ public:
         // for (int id = 0; id < p.num_threads; ++id)
         //     runners.push_back(runner_type(id, db, rp));
 
+        bench::latency_profile::name_types({"PlaceBid", "BuyNow", "ViewItem"});
         profiler_type profiler(p.spawn_perf);
+        profiler.describe<DBParams>("rubis", p.num_threads);
+        profiler.config("time_limit", p.time);
+        profiler.config("gc", p.enable_gc);
+        profiler.config("items", p.num_items);
+        profiler.config("users", p.num_users);
+        profiler.config("item_sigma", p.item_sigma);
+        profiler.config("bid_log", p.bid_log);
         profiler.start(p.perf_counter_mode ? Profiler::perf_mode::counters : Profiler::perf_mode::record);
 
         for (int t = 0; t < p.num_threads; ++t) {
@@ -212,6 +234,12 @@ int main(int argc, const char * const *argv) {
             case opt_pfcnt:
                 params.perf_counter_mode = !clp->negated;
                 break;
+            case opt_rofp:
+                Transaction::set_readonly_fast_path(!clp->negated);
+                break;
+            case opt_blog:
+                params.bid_log = !clp->negated;
+                break;
             default:
                 print_usage(argv[0]);
                 ret_code = 1;
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <chrono>
 #include <iomanip>
 #include <ctime>
+#include <memory>
 #include <sstream>
 #include <sampling.hh>
 #include <PlatformFeatures.hh>
@@ -15,7 +17,9 @@
 #include "Rubis_selectors.hh"
 #endif
 
+#include "TChunkedVector.hh"
 #include "DB_index.hh"
+#include "DB_latency.hh"
 #include "DB_params.hh"
 
 #if TABLE_FINE_GRAINED
@@ -47,11 +51,21 @@ public:
     typedef OIndex<item_key, item_row>     item_tbl_type;
     typedef OIndex<bid_key, bid_row>       bid_tbl_type;
     typedef OIndex<buynow_key, buynow_row> buynow_tbl_type;
+    typedef TChunkedVector<bid_entry>      bid_log_type;
 
-    explicit rubis_db()
+    explicit rubis_db(size_t num_items = constants::num_items)
         : tbl_items_(),
           tbl_bids_(),
-          tbl_buynow_() {}
+          tbl_buynow_(),
+          num_items_(num_items),
+          bid_logs_(new std::atomic<bid_log_type*>[num_items + 1]) {
+        for (size_t i = 0; i <= num_items; ++i)
+            bid_logs_[i].store(nullptr, std::memory_order_relaxed);
+    }
+    ~rubis_db() {
+        for (size_t i = 0; i <= num_items_; ++i)
+            delete bid_logs_[i].load(std::memory_order_relaxed);
+    }
 
     item_tbl_type& tbl_items() {
         return tbl_items_;
@@ -63,6 +77,26 @@ public:
         return tbl_buynow_;
     }
 
+    // The item's bid log, an alternative to the bids table for bids placed
+    // at run time. Bidders append to the end of the log, and appends from
+    // different transactions commute, so bidding on a hot item conflicts
+    // on neither a key range nor a size. A log is made on the item's first
+    // bid; an empty log and no log mean the same, so a lost race to make
+    // one is harmless.
+    bid_log_type& bid_log(uint64_t item_id) {
+        assert(item_id <= num_items_);
+        auto& slot = bid_logs_[item_id];
+        bid_log_type* log = slot.load(std::memory_order_acquire);
+        if (!log) {
+            auto fresh = new bid_log_type;
+            if (slot.compare_exchange_strong(log, fresh, std::memory_order_acq_rel))
+                log = fresh;
+            else
+                delete fresh;
+        }
+        return *log;
+    }
+
     void thread_init_all() {
         tbl_items_.thread_init();
         tbl_bids_.thread_init();
@@ -73,6 +107,8 @@ private:
     item_tbl_type   tbl_items_;
     bid_tbl_type    tbl_bids_;
     buynow_tbl_type tbl_buynow_;
+    size_t num_items_;
+    std::unique_ptr<std::atomic<bid_log_type*>[]> bid_logs_;
 };
 
 enum class TxnType : int { PlaceBid = 0, BuyNow, ViewItem };
@@ -90,6 +126,7 @@ struct run_params {
     uint64_t num_users;
     double item_sigma;
     double user_sigma;
+    bool bid_log;  // PlaceBid appends to rubis_db::bid_log, not the bids table
 };
 
 struct common_dists {
@@ -183,7 +220,7 @@ public:
     static constexpr bool Commute = DBParams::Commute;
 
     explicit rubis_runner(int id, db_type& database, const run_params& p)
-        : id(id), db(database), time_limit(p.time_limit), total_commits_(),
+        : id(id), db(database), time_limit(p.time_limit), bid_log(p.bid_log), total_commits_(),
           ig(id+1040, p.num_items, p.num_users, p.item_sigma, p.user_sigma) {};
 
     void run();
@@ -198,6 +235,7 @@ private:
     int id;
     db_type& db;
     uint64_t time_limit;
+    bool bid_log;
     size_t total_commits_;
     runtime_input_generator ig;
 };
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <cassert>
+#include <ostream>
 #include "DB_structs.hh"
 #include "str.hh"
 
@@ -140,6 +141,21 @@ struct bid_row {
     uint32_t date;
 };
 
+// A bid in an item's bid log (rubis_db::bid_log), the bids table row
+// plus the bidder
+struct bid_entry {
+    uint64_t user_id;
+    uint32_t quantity;
+    uint32_t bid;
+    uint32_t max_bid;
+    uint32_t date;
+};
+
+inline std::ostream& operator<<(std::ostream& w, const bid_entry& b) {
+    return w << "{user " << b.user_id << " bid " << b.bid << '/' << b.max_bid
+             << " x" << b.quantity << '}';
+}
+
 struct buynow_key_bare {
     uint64_t item_id;
     uint64_t user_id;
@@ -38,6 +38,9 @@ size_t rubis_runner<DBParams>::run_txn_placebid(uint64_t item_id, uint64_t user_
     }
     }
 
+    if (bid_log) {
+        db.bid_log(item_id).push_back({user_id, qty, bid, max_bid, ig.generate_date()});
+    } else {
     bid_key bk(item_id, user_id, db.tbl_bids().gen_key());
     auto br = Sto::tx_alloc<bid_row>();
     br->max_bid = max_bid;
@@ -51,6 +54,7 @@ size_t rubis_runner<DBParams>::run_txn_placebid(uint64_t item_id, uint64_t user_
     TXN_DO(abort);
     assert(!result);
     }
+    }
 
     } RETRY(true);
 
@@ -114,7 +118,7 @@ size_t rubis_runner<DBParams>::run_txn_viewitem(uint64_t item_id) {
     typedef item_row::NamedColumn nc;
     size_t execs = 0;
 
-    TRANSACTION {
+    ROTRANSACTION {
 
     ++execs;
 
@@ -145,6 +149,7 @@ void rubis_runner<DBParams>::run() {
         auto user_id = ig.generate_user_id();
         auto item_id = ig.generate_item_id();
         size_t retries = 0;
+        bench::latency_profile::timer lt;
         switch (t_type) {
             case TxnType::PlaceBid: {
                 uint32_t max_bid = 40;
@@ -162,6 +167,7 @@ void rubis_runner<DBParams>::run() {
                 always_assert(false, "unknown transaction type");
                 break;
         }
+        lt.record(static_cast<int>(t_type));
 
         ++cnt;
         if ((read_tsc() - tsc_begin) >= time_limit)
@@ -0,0 +1,511 @@
+#include <deque>
+#include <future>
+#include <limits>
+#include <sstream>
+#include <iostream>
+#include <thread>
+
+#include "YCSB_bench.hh"
+#include "PlatformFeatures.hh"
+#include "DB_loader.hh"
+#include "DB_server.hh"
+#include "TxnExecutor.hh"
+
+// YCSB's table behind a txn_server: each request reads or updates one
+// column of one row, and the server groups requests into transactions.
+// Run it with --client (elsewhere, or in another process) to load it.
+// With --executor, the same requests are submitted in-process to a
+// TxnExecutor instead, one transaction each.
+
+namespace ycsb {
+
+using namespace db_params;
+
+enum {
+    opt_dbid = 1, opt_nthrs, opt_time, opt_port, opt_group, opt_gc, opt_client, opt_host,
+    opt_conns, opt_depth, opt_write, opt_seed, opt_place, opt_hk, opt_exec, opt_steer,
+    opt_declare, opt_skew
+};
+
+static const Clp_Option options[] = {
+    { "dbid",         'i', opt_dbid,   Clp_ValString,   Clp_Optional },
+    { "nthreads",     't', opt_nthrs,  Clp_ValInt,      Clp_Optional },
+    { "time",         'l', opt_time,   Clp_ValDouble,   Clp_Optional },
+    { "port",         'P', opt_port,   Clp_ValInt,      Clp_Optional },
+    { "group",        'G', opt_group,  Clp_ValInt,      Clp_Optional },
+    { "gc",           'g', opt_gc,     Clp_NoVal,       Clp_Negate| Clp_Optional },
+    { "client",       'c', opt_client, Clp_NoVal,       Clp_Optional },
+    { "host",         'H', opt_host,   Clp_ValString,   Clp_Optional },
+    { "connections",  'n', opt_conns,  Clp_ValInt,      Clp_Optional },
+    { "depth",        'd', opt_depth,  Clp_ValInt,      Clp_Optional },
+    { "write-frac",   'w', opt_write,  Clp_ValDouble,   Clp_Optional },
+    { "seed",         'S', opt_seed,   Clp_ValUnsigned, Clp_Optional },
+    { "placement",    0,   opt_place,  Clp_ValString,   Clp_Optional },
+    { "housekeeping", 0,   opt_hk,    Clp_ValString, Clp_Optional },
+    { "executor",     'x', opt_exec,   Clp_NoVal,       Clp_Optional },
+    { "steer",        0,   opt_steer,  Clp_NoVal,       Clp_Negate| Clp_Optional },
+    { "conflict-aware", 0, opt_declare, Clp_NoVal,      Clp_Negate| Clp_Optional },
+    { "skew",         's', opt_skew,   Clp_ValDouble,   Clp_Optional },
+};
+
+static inline void print_usage(const char *argv_0) {
+    std::stringstream ss;
+    ss << "Usage of " << std::string(argv_0) << ":" << std::endl
+       << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
+       << "    Specify the type of DB concurrency control used: default or mvcc." << std::endl
+       << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
+       << "    Server workers, or client threads with --client (default 1)." << std::endl
+       << "  --time=<NUM> (or -l<NUM>)" << std::endl
+       << "    Seconds to serve, or to send requests with --client (default 10)." << std::endl
+       << "  --port=<NUM> (or -P<NUM>)" << std::endl
+       << "    TCP port to serve, or to connect to (default 7310)." << std::endl
+       << "  --group=<NUM> (or -G<NUM>)" << std::endl
+       << "    Pipelined requests the server runs in one transaction (default 8)." << std::endl
+       << "  --gc (or -g)" << std::endl
+       << "    Enable garbage collection (default false)." << std::endl
+       << "  --client (or -c)" << std::endl
+       << "    Generate load for a running server instead of serving." << std::endl
+       << "  --host=<STRING> (or -H<STRING>)" << std::endl
+       << "    Server to connect to with --client (default 127.0.0.1)." << std::endl
+       << "  --connections=<NUM> (or -n<NUM>)" << std::endl
+       << "    Connections per client thread (default 4)." << std::endl
+       << "  --depth=<NUM> (or -d<NUM>)" << std::endl
+       << "    Requests in flight per connection (default 16)." << std::endl
+       << "  --write-frac=<NUM> (or -w<NUM>)" << std::endl
+       << "    Fraction of requests that are updates (default 0.05)." << std::endl
+       << "  --skew=<NUM> (or -s<NUM>)" << std::endl
+       << "    Zipf skew of the rows requested; 0 is uniform (default 0)." << std::endl
+       << "  --seed=<NUM> (or -S<NUM>)" << std::endl
+       << "    Seed the client's request stream." << std::endl
+       << "  --placement=<POLICY>" << std::endl
+       << "    Where runner threads are pinned: scatter (round-robin over NUMA nodes, default), compact" << std::endl
+       << "    (node by node, SMT siblings together), physical-first (one thread per physical core before" << std::endl
+       << "    any SMT sibling), or file:<PATH> (the CPUs listed in PATH, in order). CPUs outside the" << std::endl
+       << "    process's cpuset are never used." << std::endl
+       << "  --housekeeping=<CPUS>" << std::endl
+       << "    Pin the epoch advancer, loggers and other service threads to CPUS (e.g. 0,1 or 0-1), and keep" << std::endl
+       << "    runner threads off them. Each service thread's CPU time is reported with the statistics." << std::endl
+       << "  --executor (or -x)" << std::endl
+       << "    Run the requests in-process on a transaction executor with --nthreads workers instead of" << std::endl
+       << "    serving them: --connections submitting threads each keep --depth transactions in flight." << std::endl
+       << "  --steer" << std::endl
+       << "    With --executor, send every transaction on a row to one worker (default false)." << std::endl
+       << "  --conflict-aware" << std::endl
+       << "    With --executor, declare each transaction's row, so that transactions on a contended row" << std::endl
+       << "    run on one worker and the rest run anywhere (default false)." << std::endl;
+    std::cout << ss.str() << std::flush;
+}
+
+enum { proc_read = 1, proc_update };
+
+// How --executor submits transactions: round-robin, by row (--steer), or
+// declaring the row (--conflict-aware)
+enum executor_routing { route_any, route_steer, route_declare };
+
+// Request arguments: the row and column, then for updates the new value
+struct server_op {
+    uint32_t key;
+    int16_t col_n;
+};
+
+// Rows, uniform or Zipf-distributed
+class row_chooser {
+public:
+    explicit row_chooser(double skew) {
+        if (skew > 0)
+            zipf_.reset(new sampling::StoZipfRejectionSampler<uint32_t>(0, ycsb_table_size - 1, skew));
+    }
+    uint32_t operator()(sampling::xoshiro256ss& rng) const {
+        return zipf_ ? zipf_->sample(rng) : rng() % ycsb_table_size;
+    }
+private:
+    std::unique_ptr<sampling::StoZipfRejectionSampler<uint32_t>> zipf_;
+};
+
+template <typename DBParams>
+class server_access {
+public:
+    typedef ycsb_value::NamedColumn nm;
+
+    static void prepopulate(ycsb_db<DBParams>& db, int nthreads) {
+        uint64_t segment_size = ycsb_table_size / nthreads;
+        bench::db_loader loader("ycsb", nthreads, nthreads, [](int part) { return part; });
+        loader.run([&](int part) {
+                ycsb_input_generator ig(part);
+                db.table_thread_init();
+                uint64_t key_end = part == nthreads - 1 ? ycsb_table_size : (part + 1) * segment_size;
+                for (uint64_t i = part * segment_size; i < key_end; ++i)
+                    db.ycsb_table().nontrans_put(ycsb_key(i), ig.random_ycsb_value<ycsb_value>());
+                return key_end - part * segment_size;
+            });
+    }
+
+    static uint16_t read(ycsb_db<DBParams>& db, const char* args, size_t len, std::string& out) {
+        server_op op;
+        if (len != sizeof(op))
+            return bench::status_failed;
+        memcpy(&op, args, sizeof(op));
+        if (op.key >= ycsb_table_size || op.col_n < 0 || op.col_n >= 2 * HALF_NUM_COLUMNS)
+            return bench::status_failed;
+        bool col_parity = op.col_n % 2;
+        auto [success, result, row, value]
+            = db.ycsb_table().select_split_row(ycsb_key(op.key),
+                {{col_parity ? nm::odd_columns : nm::even_columns, access_t::read}});
+        (void)row;
+        TXN_DO_E(success);
+        if (!result)
+            return bench::status_failed;
+        const col_type& c = col_parity ? value.odd_columns()[op.col_n/2] : value.even_columns()[op.col_n/2];
+        out.append(reinterpret_cast<const char*>(&c), sizeof(c));
+        return bench::status_ok;
+    }
+
+    static uint16_t update(ycsb_db<DBParams>& db, const char* args, size_t len, std::string&) {
+        server_op op;
+        if (len != sizeof(op) + sizeof(col_type))
+            return bench::status_failed;
+        memcpy(&op, args, sizeof(op));
+        if (op.key >= ycsb_table_size || op.col_n < 0 || op.col_n >= 2 * HALF_NUM_COLUMNS)
+            return bench::status_failed;
+        bool col_parity = op.col_n % 2;
+        auto [success, result, row, value]
+            = db.ycsb_table().select_split_row(ycsb_key(op.key),
+                {{col_parity ? nm::odd_columns : nm::even_columns, access_t::update}});
+        TXN_DO_E(success);
+        if (!result)
+            return bench::status_failed;
+        auto new_val = Sto::tx_alloc<ycsb_value>();
+        auto& cols = col_parity ? new_val->odd_columns : new_val->even_columns;
+        if (col_parity)
+            new_val->odd_columns = value.odd_columns();
+        else
+            new_val->even_columns = value.even_columns();
+        memcpy(&cols[op.col_n/2], args + sizeof(op), sizeof(col_type));
+        db.ycsb_table().update_row(row, new_val);
+        return bench::status_ok;
+    }
+
+    static int serve(int nthreads, int port, unsigned group, double time_limit, bool enable_gc) {
+        ycsb_db<DBParams> db;
+        std::cout << "Prepopulating database..." << std::endl;
+        prepopulate(db, std::max(nthreads, 8));
+        std::cout << "Prepopulation complete." << std::endl;
+
+        std::thread advancer;
+        if (enable_gc) {
+            Transaction::set_epoch_cycle(1000);
+            advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+        }
+
+        bench::txn_server::params p;
+        p.nworkers = nthreads;
+        p.port = port;
+        p.group = group;
+        bench::txn_server server(p);
+        // a group may mix reads and updates, so under MVCC every
+        // transaction reads as a read-write one
+        server.add_txn_procedure(proc_read, [&](const char* args, size_t len, std::string& out, int) {
+                if (DBParams::MVCC)
+                    Sto::mvcc_rw_upgrade();
+                return read(db, args, len, out);
+            });
+        server.add_txn_procedure(proc_update, [&](const char* args, size_t len, std::string& out, int) {
+                if (DBParams::MVCC)
+                    Sto::mvcc_rw_upgrade();
+                return update(db, args, len, out);
+            });
+        server.on_worker_start([&](int) { db.table_thread_init(); });
+        if (!server.start()) {
+            std::cerr << "Can't listen on port " << port << std::endl;
+            return 1;
+        }
+        std::cout << "Serving on port " << server.port() << " with " << nthreads
+                  << " workers (placement " << placement_name() << ") for " << time_limit
+                  << " seconds" << std::endl;
+        std::this_thread::sleep_for(std::chrono::duration<double>(time_limit));
+        server.stop();
+
+        auto s = server.statistics();
+        std::cout << "Served " << s.requests << " requests on " << s.connections << " connections, "
+                  << double(s.requests) / time_limit << " requests/sec; "
+                  << (s.batches ? double(s.requests) / s.batches : 0) << " per batch, "
+                  << (s.transactions ? double(s.requests) / s.transactions : 0) << " per transaction"
+                  << std::endl;
+        Transaction::print_stats();
+        Transaction::rcu_release_all(advancer, nthreads);
+        return 0;
+    }
+
+    static int run_executor(int nthreads, const bench::txn_client::params& cp, double write_frac,
+                            double skew, executor_routing route, bool enable_gc) {
+        ycsb_db<DBParams> db;
+        std::cout << "Prepopulating database..." << std::endl;
+        prepopulate(db, std::max(nthreads, 8));
+        std::cout << "Prepopulation complete." << std::endl;
+
+        std::thread advancer;
+        if (enable_gc) {
+            Transaction::set_epoch_cycle(1000);
+            advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+        }
+
+        TxnExecutor::params p;
+        p.nworkers = nthreads;
+        TxnExecutor ex(p);
+        ex.on_worker_start([&](int) { db.table_thread_init(); });
+        ex.start();
+
+        // submitters don't run transactions, so they leave the workers'
+        // thread ids alone
+        uint64_t write_threshold = uint64_t(write_frac * double(std::numeric_limits<uint64_t>::max()));
+        row_chooser rows(skew);
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(cp.seconds);
+        std::vector<bench::latency_histogram> latencies(cp.connections);
+        std::vector<uint64_t> completed(cp.connections, 0), failed(cp.connections, 0);
+        std::vector<std::thread> submitters;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < cp.connections; ++t)
+            submitters.emplace_back([&, t] {
+                sampling::xoshiro256ss rng(cp.seed + t);
+                std::deque<std::pair<std::future<uint16_t>, std::chrono::steady_clock::time_point>> inflight;
+                auto complete = [&] {
+                    auto& f = inflight.front();
+                    if (f.first.get() != bench::status_ok)
+                        ++failed[t];
+                    ++completed[t];
+                    latencies[t].record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - f.second).count());
+                    inflight.pop_front();
+                };
+                while (std::chrono::steady_clock::now() < end) {
+                    while (int(inflight.size()) >= cp.depth)
+                        complete();
+                    std::string args;
+                    server_op op;
+                    op.key = rows(rng);
+                    op.col_n = rng() % (2 * HALF_NUM_COLUMNS);
+                    args.append(reinterpret_cast<const char*>(&op), sizeof(op));
+                    bool is_update = rng() < write_threshold;
+                    if (is_update) {
+                        col_type v;
+                        memset(&v, 'a' + op.key % 26, sizeof(v));
+                        args.append(reinterpret_cast<const char*>(&v), sizeof(v));
+                    }
+                    auto txn = [&db, args = std::move(args), is_update] {
+                        std::string out;
+                        if (!is_update)
+                            return read(db, args.data(), args.size(), out);
+                        if (DBParams::MVCC)
+                            Sto::mvcc_rw_upgrade();
+                        return update(db, args.data(), args.size(), out);
+                    };
+                    std::future<uint16_t> f;
+                    if (route == route_declare)
+                        f = ex.submit(std::move(txn), std::vector<uint64_t>{op.key});
+                    else
+                        f = ex.submit(std::move(txn), route == route_steer ? uint64_t(op.key) + 1 : 0);
+                    inflight.emplace_back(std::move(f), std::chrono::steady_clock::now());
+                }
+                while (!inflight.empty())
+                    complete();
+            });
+        for (auto& s : submitters)
+            s.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ex.stop();
+
+        bench::latency_histogram latency;
+        uint64_t total = 0, total_failed = 0;
+        for (int t = 0; t < cp.connections; ++t) {
+            latency.merge(latencies[t]);
+            total += completed[t];
+            total_failed += failed[t];
+        }
+        auto s = ex.statistics();
+        std::cout << "Completed " << total << " transactions (" << total_failed << " failed) in "
+                  << seconds << " seconds, " << total / seconds << " txns/sec on " << nthreads
+                  << " workers (placement " << placement_name() << ")" << std::endl
+                  << "Latency: mean " << latency.mean() / 1000 << " us, p50 "
+                  << latency.quantile(0.5) / 1000.0 << " us, p99 "
+                  << latency.quantile(0.99) / 1000.0 << " us, p99.9 "
+                  << latency.quantile(0.999) / 1000.0 << " us" << std::endl
+                  << "Executor: " << s.retries << " retries after aborts (" << s.rerouted
+                  << " rerouted), " << s.steals << " steals";
+        if (route == route_steer)
+            std::cout << ", steered by row";
+        else if (route == route_declare)
+            std::cout << ", " << s.steered << " steered by contended row";
+        std::cout << std::endl;
+        Transaction::print_stats();
+        Transaction::rcu_release_all(advancer, nthreads);
+        return 0;
+    }
+};
+
+static int run_client(const bench::txn_client::params& p, double write_frac, double skew) {
+    uint64_t write_threshold = uint64_t(write_frac * double(std::numeric_limits<uint64_t>::max()));
+    row_chooser rows(skew);
+    bench::txn_client::result r;
+    bool ok = bench::txn_client(p).run([&](std::string& args, sampling::xoshiro256ss& rng) {
+            server_op op;
+            op.key = rows(rng);
+            op.col_n = rng() % (2 * HALF_NUM_COLUMNS);
+            args.append(reinterpret_cast<const char*>(&op), sizeof(op));
+            if (rng() >= write_threshold)
+                return uint16_t(proc_read);
+            col_type v;
+            memset(&v, 'a' + op.key % 26, sizeof(v));
+            args.append(reinterpret_cast<const char*>(&v), sizeof(v));
+            return uint16_t(proc_update);
+        }, r);
+    std::cout << "Completed " << r.completed << " requests (" << r.failed << " failed) in "
+              << r.seconds << " seconds, " << r.throughput() << " requests/sec" << std::endl
+              << "Latency: mean " << r.latency.mean() / 1000 << " us, p50 "
+              << r.latency.quantile(0.5) / 1000.0 << " us, p99 "
+              << r.latency.quantile(0.99) / 1000.0 << " us, p99.9 "
+              << r.latency.quantile(0.999) / 1000.0 << " us" << std::endl;
+    if (!ok)
+        std::cerr << "Lost a connection to " << p.host << ":" << p.port << std::endl;
+    return ok ? 0 : 1;
+}
+
+}; // namespace ycsb
+
+using namespace ycsb;
+using namespace db_params;
+
+double constants::processor_tsc_frequency;
+
+int main(int argc, const char *const *argv) {
+    db_params_id dbid = db_params_id::Default;
+    int num_threads = 1;
+    double time_limit = 10.0;
+    unsigned group = 8;
+    bool enable_gc = false;
+    bool client = false;
+    bool executor = false;
+    bool steer = false;
+    bool declare = false;
+    double write_frac = 0.05;
+    double skew = 0;
+    bench::txn_client::params cp;
+    cp.port = 7310;
+    cp.connections = 4;
+    cp.depth = 16;
+    int ret_code = 0;
+
+    Sto::global_init();
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+
+    int opt;
+    bool clp_stop = false;
+    while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
+        switch (opt) {
+        case opt_dbid:
+            dbid = parse_dbid(clp->val.s);
+            if (dbid != db_params_id::Default && dbid != db_params_id::MVCC) {
+                std::cout << "Unsupported DB CC id: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_nthrs:
+            num_threads = clp->val.i;
+            break;
+        case opt_time:
+            time_limit = clp->val.d;
+            break;
+        case opt_port:
+            cp.port = clp->val.i;
+            break;
+        case opt_group:
+            group = std::max(clp->val.i, 1);
+            break;
+        case opt_gc:
+            enable_gc = !clp->negated;
+            break;
+        case opt_client:
+            client = true;
+            break;
+        case opt_host:
+            cp.host = clp->val.s;
+            break;
+        case opt_conns:
+            cp.connections = std::max(clp->val.i, 1);
+            break;
+        case opt_depth:
+            cp.depth = std::max(clp->val.i, 1);
+            break;
+        case opt_write:
+            write_frac = std::min(std::max(clp->val.d, 0.0), 1.0);
+            break;
+        case opt_seed:
+            cp.seed = clp->val.u;
+            break;
+        case opt_place:
+            if (!set_placement(clp->val.s)) {
+                std::cout << "Unsupported thread placement: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_hk:
+            if (!set_housekeeping_cpus(clp->val.s)) {
+                std::cout << "Bad housekeeping CPU list: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_exec:
+            executor = true;
+            break;
+        case opt_steer:
+            steer = !clp->negated;
+            break;
+        case opt_declare:
+            declare = !clp->negated;
+            break;
+        case opt_skew:
+            skew = std::max(clp->val.d, 0.0);
+            break;
+        default:
+            print_usage(argv[0]);
+            ret_code = 1;
+            clp_stop = true;
+            break;
+        }
+    }
+
+    Clp_DeleteParser(clp);
+    if (ret_code != 0)
+        return ret_code;
+
+    if (client) {
+        cp.nthreads = num_threads;
+        cp.seconds = time_limit;
+        return run_client(cp, write_frac, skew);
+    }
+
+    auto cpu_freq = determine_cpu_freq();
+    if (cpu_freq == 0.0)
+        return 1;
+    else
+        constants::processor_tsc_frequency = cpu_freq;
+
+    if (executor) {
+        cp.seconds = time_limit;
+        auto route = steer ? route_steer : declare ? route_declare : route_any;
+        if (dbid == db_params_id::MVCC)
+            return server_access<db_mvcc_params>::run_executor(num_threads, cp, write_frac, skew, route, enable_gc);
+        return server_access<db_default_params>::run_executor(num_threads, cp, write_frac, skew, route, enable_gc);
+    }
+    if (dbid == db_params_id::MVCC)
+        return server_access<db_mvcc_params>::serve(num_threads, cp.port, group, time_limit, enable_gc);
+    return server_access<db_default_params>::serve(num_threads, cp.port, group, time_limit, enable_gc);
+}
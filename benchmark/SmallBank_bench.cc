@@ -0,0 +1,294 @@
+#include <thread>
+#include <clp.h>
+
+#include "SmallBank_bench.hh"
+#include "SmallBank_txns.hh"
+
+#include "DB_profiler.hh"
+#include "DB_loader.hh"
+
+using db_params::constants;
+using db_params::db_params_id;
+using db_params::db_default_params;
+using db_params::db_default_commute_params;
+using db_params::db_opaque_params;
+using db_params::db_opaque_commute_params;
+using db_params::db_swiss_params;
+using db_params::db_tictoc_params;
+using db_params::db_tictoc_commute_params;
+using db_params::db_mvcc_params;
+using db_params::db_mvcc_commute_params;
+using db_params::parse_dbid;
+
+// OLTP-Bench's default mix
+smallbank::workload_mix_type smallbank::workload_weightgram = {
+    {smallbank::TxnType::Amalgamate, 15.0},
+    {smallbank::TxnType::Balance, 15.0},
+    {smallbank::TxnType::DepositChecking, 15.0},
+    {smallbank::TxnType::SendPayment, 25.0},
+    {smallbank::TxnType::TransactSavings, 15.0},
+    {smallbank::TxnType::WriteCheck, 15.0}
+};
+
+// @section: clp parser definitions
+enum {
+    opt_dbid = 1, opt_nthrs, opt_accts, opt_hsize, opt_hpct, opt_time, opt_gc, opt_comm, opt_perf, opt_pfcnt, opt_rofp
+};
+
+static const Clp_Option options[] = {
+        { "dbid",         'i', opt_dbid,  Clp_ValString, Clp_Optional },
+        { "nthreads",     't', opt_nthrs, Clp_ValInt,    Clp_Optional },
+        { "accounts",     'a', opt_accts, Clp_ValUnsignedLong, Clp_Optional },
+        { "hotspot-size", 's', opt_hsize, Clp_ValUnsignedLong, Clp_Optional },
+        { "hotspot-pct",  'h', opt_hpct,  Clp_ValUnsigned, Clp_Optional },
+        { "time",         'l', opt_time,  Clp_ValDouble, Clp_Optional },
+        { "garbage-collect", 'g', opt_gc, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "perf",         'p', opt_perf,  Clp_NoVal,     Clp_Optional },
+        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "ro-fastpath",  'o', opt_rofp,  Clp_NoVal,     Clp_Negate | Clp_Optional }
+};
+
+static inline void print_usage(const char *argv_0) {
+    std::stringstream ss;
+    ss << "Usage of " << std::string(argv_0) << ":" << std::endl
+       << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
+       << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
+       << "      default, opaque, swiss, tictoc, mvcc" << std::endl
+       << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
+       << "    Specify the number of parallel worker threads (default 1)." << std::endl
+       << "  --accounts=<NUM> (or -a<NUM>)" << std::endl
+       << "    Specify the number of accounts (default " << smallbank::constants::num_accounts << ")." << std::endl
+       << "  --hotspot-size=<NUM> (or -s<NUM>)" << std::endl
+       << "    Specify the number of hotspot accounts (default " << smallbank::constants::hotspot_size << ")." << std::endl
+       << "  --hotspot-pct=<NUM> (or -h<NUM>)" << std::endl
+       << "    Specify the percentage of accesses that go to the hotspot (default "
+       << smallbank::constants::hotspot_pct << ")." << std::endl
+       << "  --time=<NUM> (or -l<NUM>)" << std::endl
+       << "    Specify the time (duration) for which the benchmark is run (default 10 seconds)." << std::endl
+       << "  --garbage-collect (or -g)" << std::endl
+       << "    Enable garbage collection/epoch advancer thread." << std::endl
+       << "  --commute (or -x)" << std::endl
+       << "    Enable commutative update support." << std::endl
+       << "  --perf (or -p)" << std::endl
+       << "    Spawns perf profiler in record mode for the duration of the benchmark run." << std::endl
+       << "  --perf-counter (or -c)" << std::endl
+       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl
+       << "  --ro-fastpath (or -o)" << std::endl
+       << "    Run Balance on the read-only fast path (default true)." << std::endl;
+    std::cout << ss.str() << std::flush;
+}
+
+struct cmd_params {
+    db_params::db_params_id db_id;
+    int num_threads;
+    unsigned long num_accounts;
+    unsigned long hotspot_size;
+    unsigned hotspot_pct;
+    double time;
+    bool enable_gc;
+    bool enable_comm;
+    bool spawn_perf;
+    bool perf_counter_mode;
+
+    explicit cmd_params()
+            : db_id(db_params::db_params_id::Default),
+              num_threads(1),
+              num_accounts(smallbank::constants::num_accounts),
+              hotspot_size(smallbank::constants::hotspot_size),
+              hotspot_pct(smallbank::constants::hotspot_pct),
+              time(10.0), enable_gc(false), enable_comm(false),
+              spawn_perf(false), perf_counter_mode(false) {}
+};
+
+// @endsection: clp parser definitions
+
+template <typename DBParams>
+class bench_access {
+public:
+    using db_type = smallbank::smallbank_db<DBParams>;
+    using loader_type = smallbank::smallbank_loader<DBParams>;
+    using runner_type = smallbank::smallbank_runner<DBParams>;
+    using profiler_type = bench::db_profiler;
+
+    static void runner_thread(int id, db_type& db, const smallbank::run_params& rp,
+                              size_t& txn_cnt, size_t& user_abort_cnt) {
+        runner_type r(id, db, rp);
+        r.run();
+        txn_cnt = r.total_commits();
+        user_abort_cnt = r.user_aborts();
+    }
+
+    static int execute(cmd_params p) {
+        smallbank::run_params rp{};
+        rp.time_limit = (uint64_t)(p.time * constants::processor_tsc_frequency * constants::billion);
+        rp.num_accounts = std::max(p.num_accounts, 2ul);
+        rp.hotspot_size = std::max(std::min(p.hotspot_size, rp.num_accounts), 1ul);
+        rp.hotspot_pct = std::min(p.hotspot_pct, 100u);
+        std::cout << "Accounts: " << rp.num_accounts << ", hotspot: " << rp.hotspot_size
+                  << " accounts, " << rp.hotspot_pct << "% of accesses" << std::endl;
+
+        // Create DB
+        auto& db = *(new db_type());
+
+        // Load DB, slices of the accounts by runner
+        int nparts = p.num_threads;
+        bench::db_loader("smallbank", nparts, p.num_threads, [](int part) { return part; }).run([&](int part) {
+                db.thread_init_all();
+                loader_type loader(db, part + 1);
+                return loader.load(rp.num_accounts * part / nparts + 1, rp.num_accounts * (part + 1) / nparts);
+            });
+
+        // Start the GC thread if necessary
+        std::thread advancer;
+        std::cout << "Garbage collection: " << (p.enable_gc ? "enabled" : "disabled") << std::endl;
+        if (p.enable_gc) {
+            advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+        }
+
+        // Execute benchmark
+        std::vector<std::thread> runner_threads;
+        std::vector<size_t> committed_txn_cnts((size_t)p.num_threads, 0);
+        std::vector<size_t> user_abort_cnts((size_t)p.num_threads, 0);
+
+        bench::latency_profile::name_types({"Amalgamate", "Balance", "DepositChecking", "SendPayment",
+                                            "TransactSavings", "WriteCheck"});
+        profiler_type profiler(p.spawn_perf);
+        profiler.describe<DBParams>("smallbank", p.num_threads);
+        profiler.config("time_limit", p.time);
+        profiler.config("gc", p.enable_gc);
+        profiler.config("accounts", rp.num_accounts);
+        profiler.config("hotspot_size", rp.hotspot_size);
+        profiler.config("hotspot_pct", rp.hotspot_pct);
+        profiler.start(p.perf_counter_mode ? Profiler::perf_mode::counters : Profiler::perf_mode::record);
+
+        for (int t = 0; t < p.num_threads; ++t) {
+            runner_threads.push_back(
+                    std::thread(runner_thread, t, std::ref(db), std::ref(rp),
+                                std::ref(committed_txn_cnts[t]), std::ref(user_abort_cnts[t]))
+            );
+        }
+        for (auto& t : runner_threads) {
+            t.join();
+        }
+
+        size_t total_commit_txns = 0;
+        for (auto c : committed_txn_cnts)
+            total_commit_txns += c;
+        size_t total_user_aborts = 0;
+        for (auto c : user_abort_cnts)
+            total_user_aborts += c;
+        std::cout << "User aborts (insufficient funds): " << total_user_aborts << std::endl;
+
+        profiler.finish(total_commit_txns);
+
+        Transaction::rcu_release_all(advancer, p.num_threads);
+
+        delete (&db);
+        return 0;
+    }
+};
+
+double constants::processor_tsc_frequency;
+
+int main(int argc, const char * const *argv) {
+    cmd_params params;
+
+    Sto::global_init();
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+
+    int ret_code = 0;
+    int opt;
+    bool clp_stop = false;
+    while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
+        switch (opt) {
+            case opt_dbid:
+                params.db_id = parse_dbid(clp->val.s);
+                if (params.db_id == db_params::db_params_id::None) {
+                    std::cout << "Unsupported DB CC id: "
+                              << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                    print_usage(argv[0]);
+                    ret_code = 1;
+                    clp_stop = true;
+                }
+                break;
+            case opt_nthrs:
+                params.num_threads = clp->val.i;
+                break;
+            case opt_accts:
+                params.num_accounts = clp->val.ul;
+                break;
+            case opt_hsize:
+                params.hotspot_size = clp->val.ul;
+                break;
+            case opt_hpct:
+                params.hotspot_pct = clp->val.u;
+                break;
+            case opt_time:
+                params.time = clp->val.d;
+                break;
+            case opt_gc:
+                params.enable_gc = !clp->negated;
+                break;
+            case opt_comm:
+                params.enable_comm = !clp->negated;
+                break;
+            case opt_perf:
+                params.spawn_perf = !clp->negated;
+                break;
+            case opt_pfcnt:
+                params.perf_counter_mode = !clp->negated;
+                break;
+            case opt_rofp:
+                Transaction::set_readonly_fast_path(!clp->negated);
+                break;
+            default:
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+                break;
+        }
+    }
+
+    Clp_DeleteParser(clp);
+    if (ret_code != 0)
+        return ret_code;
+
+    auto cpu_freq = determine_cpu_freq();
+    if (cpu_freq == 0.0)
+        return 1;
+    else
+        constants::processor_tsc_frequency = cpu_freq;
+
+    switch (params.db_id) {
+        case db_params_id::Default:
+            ret_code = params.enable_comm ?
+                       bench_access<db_default_commute_params>::execute(params) :
+                       bench_access<db_default_params>::execute(params);
+            break;
+        case db_params_id::Opaque:
+            ret_code = params.enable_comm ?
+                       bench_access<db_opaque_commute_params>::execute(params) :
+                       bench_access<db_opaque_params>::execute(params);
+            break;
+        case db_params_id::Swiss:
+            ret_code = bench_access<db_swiss_params>::execute(params);
+            break;
+        case db_params_id::TicToc:
+            ret_code = params.enable_comm ?
+                       bench_access<db_tictoc_commute_params>::execute(params) :
+                       bench_access<db_tictoc_params>::execute(params);
+            break;
+        case db_params_id::MVCC:
+            ret_code = params.enable_comm ?
+                       bench_access<db_mvcc_commute_params>::execute(params) :
+                       bench_access<db_mvcc_params>::execute(params);
+            break;
+        default:
+            std::cerr << "unknown db config parameter id" << std::endl;
+            ret_code = 1;
+            break;
+    };
+
+    return ret_code;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <iostream>
+#include <sampling.hh>
+#include <PlatformFeatures.hh>
+
+#include "SmallBank_structs.hh"
+#include "SmallBank_commutators.hh"
+
+#include "DB_index.hh"
+#include "DB_latency.hh"
+#include "DB_params.hh"
+
+#include "smallbank_split_params_default.hh"
+
+namespace smallbank {
+
+// Sizes and amounts as in the H-Store and OLTP-Bench SmallBank
+struct constants {
+    static constexpr uint64_t num_accounts = 1000000;
+    // Accounts 1..hotspot_size are the hotspot, which hotspot_pct percent
+    // of the customers a transaction picks come from
+    static constexpr uint64_t hotspot_size = 100;
+    static constexpr unsigned hotspot_pct = 90;
+
+    static constexpr uint32_t min_balance = 10000;
+    static constexpr uint32_t max_balance = 50000;
+
+    static constexpr float deposit_checking_amount = 1.3f;
+    static constexpr float transact_savings_amount = 20.2f;
+    static constexpr float send_payment_amount = 5.0f;
+    static constexpr float write_check_amount = 5.0f;
+};
+
+template <typename DBParams>
+class smallbank_db {
+public:
+    template <typename K, typename V>
+    using OIndex = typename std::conditional<
+            DBParams::MVCC,
+            mvcc_ordered_index<K, V, DBParams>,
+            ordered_index<K, V, DBParams>>::type;
+
+    typedef OIndex<accounts_key, accounts_row> accounts_tbl_type;
+    typedef OIndex<savings_key, savings_row>   savings_tbl_type;
+    typedef OIndex<checking_key, checking_row> checking_tbl_type;
+
+    explicit smallbank_db()
+        : tbl_accounts_(),
+          tbl_savings_(),
+          tbl_checking_() {}
+
+    accounts_tbl_type& tbl_accounts() {
+        return tbl_accounts_;
+    }
+    savings_tbl_type& tbl_savings() {
+        return tbl_savings_;
+    }
+    checking_tbl_type& tbl_checking() {
+        return tbl_checking_;
+    }
+
+    void thread_init_all() {
+        tbl_accounts_.thread_init();
+        tbl_savings_.thread_init();
+        tbl_checking_.thread_init();
+    }
+
+private:
+    accounts_tbl_type tbl_accounts_;
+    savings_tbl_type  tbl_savings_;
+    checking_tbl_type tbl_checking_;
+};
+
+enum class TxnType : int {
+    Amalgamate = 0, Balance, DepositChecking, SendPayment, TransactSavings, WriteCheck
+};
+
+using txn_dist_type = sampling::StoCustomDistribution<TxnType>;
+typedef txn_dist_type::weightgram_type workload_mix_type;
+typedef sampling::StoRandomDistribution<>::rng_type rng_type;
+
+extern workload_mix_type workload_weightgram;
+
+struct run_params {
+    uint64_t time_limit;
+    uint64_t num_accounts;
+    uint64_t hotspot_size;
+    unsigned hotspot_pct;
+};
+
+class input_generator {
+public:
+    input_generator(int seed, const run_params& p)
+        : rng(seed), txn_dist(rng, workload_weightgram), num_accounts(p.num_accounts),
+          hotspot_size(std::min(p.hotspot_size, p.num_accounts)), hotspot_pct(p.hotspot_pct),
+          hot_dist(1, hotspot_size), cold_dist(std::min(hotspot_size + 1, num_accounts), num_accounts),
+          pct_dist(0, 99) {}
+
+    TxnType next_transaction() {
+        return txn_dist.sample();
+    }
+
+    uint64_t customer_id() {
+        if (hotspot_size == num_accounts || pct_dist(rng) < hotspot_pct)
+            return hot_dist(rng);
+        return cold_dist(rng);
+    }
+    // Two different customers (given two accounts)
+    std::pair<uint64_t, uint64_t> customer_pair() {
+        uint64_t c0 = customer_id();
+        uint64_t c1 = customer_id();
+        if (c1 == c0)
+            c1 = c0 % num_accounts + 1;
+        return {c0, c1};
+    }
+
+private:
+    rng_type rng;
+    txn_dist_type txn_dist;
+    uint64_t num_accounts;
+    uint64_t hotspot_size;
+    unsigned hotspot_pct;
+    std::uniform_int_distribution<uint64_t> hot_dist;
+    std::uniform_int_distribution<uint64_t> cold_dist;
+    std::uniform_int_distribution<unsigned> pct_dist;
+};
+
+template <typename DBParams>
+class smallbank_runner {
+public:
+    typedef smallbank_db<DBParams> db_type;
+    static constexpr bool Commute = DBParams::Commute;
+
+    explicit smallbank_runner(int id, db_type& database, const run_params& p)
+        : id(id), db(database), time_limit(p.time_limit), total_commits_(), user_aborts_(),
+          ig(id + 1040, p) {}
+
+    void run();
+    size_t total_commits() const {
+        return total_commits_;
+    }
+    // Transactions that gave up on insufficient funds
+    size_t user_aborts() const {
+        return user_aborts_;
+    }
+
+    // Each returns false on a user abort
+    bool run_txn_amalgamate(uint64_t c0, uint64_t c1);
+    bool run_txn_balance(uint64_t c);
+    bool run_txn_deposit_checking(uint64_t c, float amount);
+    bool run_txn_send_payment(uint64_t c0, uint64_t c1, float amount);
+    bool run_txn_transact_savings(uint64_t c, float amount);
+    bool run_txn_write_check(uint64_t c, float amount);
+
+private:
+    int id;
+    db_type& db;
+    uint64_t time_limit;
+    size_t total_commits_;
+    size_t user_aborts_;
+    input_generator ig;
+};
+
+template <typename DBParams>
+class smallbank_loader {
+public:
+    typedef smallbank_db<DBParams> db_type;
+
+    smallbank_loader(db_type& database, int seed)
+        : db(database), rng(seed) {}
+
+    // Accounts first..last, with a savings and a checking balance each
+    uint64_t load(uint64_t first, uint64_t last) {
+        std::uniform_int_distribution<uint32_t> bal_dist(constants::min_balance, constants::max_balance);
+        for (uint64_t c = first; c <= last; ++c) {
+            accounts_row ar;
+            ar.name = "Customer " + std::to_string(c);
+            db.tbl_accounts().nontrans_put(accounts_key(c), ar);
+
+            savings_row sr;
+            sr.bal = bal_dist(rng);
+            db.tbl_savings().nontrans_put(savings_key(c), sr);
+
+            checking_row cr;
+            cr.bal = bal_dist(rng);
+            db.tbl_checking().nontrans_put(checking_key(c), cr);
+        }
+        return 3 * (last + 1 - first);
+    }
+
+private:
+    db_type& db;
+    rng_type rng;
+};
+
+}; // namespace smallbank
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Commutators.hh"
+#include "SmallBank_structs.hh"
+
+namespace commutators {
+
+using savings_row = smallbank::savings_row;
+using checking_row = smallbank::checking_row;
+
+template <>
+class Commutator<savings_row> {
+public:
+    Commutator() = default;
+    explicit Commutator(float delta) : delta(delta) {}
+
+    void operate(savings_row& val) const {
+        val.bal += delta;
+    }
+
+private:
+    float delta;
+};
+
+template <>
+class Commutator<checking_row> {
+public:
+    Commutator() = default;
+    explicit Commutator(float delta) : delta(delta) {}
+
+    void operate(checking_row& val) const {
+        val.bal += delta;
+    }
+
+private:
+    float delta;
+};
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <cassert>
+#include "DB_structs.hh"
+#include "str.hh"
+
+// Generated from utils/smallbank.json by utils/generate_schema.py
+
+namespace smallbank {
+
+using namespace bench;
+
+// New table: accounts
+
+struct __attribute__((packed)) accounts_key_bare {
+    int64_t custid;
+    explicit accounts_key_bare(int64_t p_custid)
+        : custid(bswap(p_custid)) {}
+
+    friend masstree_key_adapter<accounts_key_bare>;
+private:
+    accounts_key_bare() = default;
+};
+
+typedef masstree_key_adapter<accounts_key_bare> accounts_key;
+
+struct accounts_row {
+    enum class NamedColumn : int { name = 0 };
+
+    var_string<64> name;
+};
+
+// New table: savings
+
+struct __attribute__((packed)) savings_key_bare {
+    int64_t custid;
+    explicit savings_key_bare(int64_t p_custid)
+        : custid(bswap(p_custid)) {}
+
+    friend masstree_key_adapter<savings_key_bare>;
+private:
+    savings_key_bare() = default;
+};
+
+typedef masstree_key_adapter<savings_key_bare> savings_key;
+
+struct savings_row {
+    enum class NamedColumn : int { bal = 0 };
+
+    float bal;
+};
+
+// New table: checking
+
+struct __attribute__((packed)) checking_key_bare {
+    int64_t custid;
+    explicit checking_key_bare(int64_t p_custid)
+        : custid(bswap(p_custid)) {}
+
+    friend masstree_key_adapter<checking_key_bare>;
+private:
+    checking_key_bare() = default;
+};
+
+typedef masstree_key_adapter<checking_key_bare> checking_key;
+
+struct checking_row {
+    enum class NamedColumn : int { bal = 0 };
+
+    float bal;
+};
+
+}; // namespace smallbank
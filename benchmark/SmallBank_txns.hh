@@ -0,0 +1,317 @@
+#pragma once
+
+#include "SmallBank_bench.hh"
+
+namespace smallbank {
+
+// A transaction that finds insufficient funds sets user_abort and aborts
+// without retrying.
+
+template <typename DBParams>
+bool smallbank_runner<DBParams>::run_txn_amalgamate(uint64_t c0, uint64_t c1) {
+    typedef accounts_row::NamedColumn a_nc;
+    typedef savings_row::NamedColumn s_nc;
+    typedef checking_row::NamedColumn c_nc;
+
+    RWTRANSACTION {
+
+    for (auto c : {c0, c1}) {
+        auto [abort, result, row, value] = db.tbl_accounts().select_split_row(accounts_key(c),
+            {{a_nc::name, access_t::read}});
+        (void)row; (void)value;
+        TXN_DO(abort);
+        assert(result);
+    }
+
+    float total;
+    {
+    auto [abort, result, row, value] = db.tbl_savings().select_split_row(savings_key(c0),
+        {{s_nc::bal, access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    total = value.bal();
+    auto new_sv = Sto::tx_alloc<savings_row>();
+    new_sv->bal = 0;
+    db.tbl_savings().update_row(row, new_sv);
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_checking().select_split_row(checking_key(c0),
+        {{c_nc::bal, access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    total += value.bal();
+    auto new_cv = Sto::tx_alloc<checking_row>();
+    new_cv->bal = 0;
+    db.tbl_checking().update_row(row, new_cv);
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_checking().select_split_row(checking_key(c1),
+        {{c_nc::bal, Commute ? access_t::write : access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    if constexpr (Commute) {
+        (void)value;
+        commutators::Commutator<checking_row> comm(total);
+        db.tbl_checking().update_row(row, comm);
+    } else {
+        auto new_cv = Sto::tx_alloc<checking_row>();
+        new_cv->bal = value.bal() + total;
+        db.tbl_checking().update_row(row, new_cv);
+    }
+    }
+
+    } RETRY(true);
+
+    return true;
+}
+
+template <typename DBParams>
+bool smallbank_runner<DBParams>::run_txn_balance(uint64_t c) {
+    typedef accounts_row::NamedColumn a_nc;
+    typedef savings_row::NamedColumn s_nc;
+    typedef checking_row::NamedColumn c_nc;
+    float total = 0;
+    (void)total;
+
+    ROTRANSACTION {
+
+    {
+    auto [abort, result, row, value] = db.tbl_accounts().select_split_row(accounts_key(c),
+        {{a_nc::name, access_t::read}});
+    (void)row; (void)value;
+    TXN_DO(abort);
+    assert(result);
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_savings().select_split_row(savings_key(c),
+        {{s_nc::bal, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    total = value.bal();
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_checking().select_split_row(checking_key(c),
+        {{c_nc::bal, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    total += value.bal();
+    }
+
+    } RETRY(true);
+
+    return true;
+}
+
+template <typename DBParams>
+bool smallbank_runner<DBParams>::run_txn_deposit_checking(uint64_t c, float amount) {
+    typedef accounts_row::NamedColumn a_nc;
+    typedef checking_row::NamedColumn c_nc;
+
+    RWTRANSACTION {
+
+    {
+    auto [abort, result, row, value] = db.tbl_accounts().select_split_row(accounts_key(c),
+        {{a_nc::name, access_t::read}});
+    (void)row; (void)value;
+    TXN_DO(abort);
+    assert(result);
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_checking().select_split_row(checking_key(c),
+        {{c_nc::bal, Commute ? access_t::write : access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    if constexpr (Commute) {
+        (void)value;
+        commutators::Commutator<checking_row> comm(amount);
+        db.tbl_checking().update_row(row, comm);
+    } else {
+        auto new_cv = Sto::tx_alloc<checking_row>();
+        new_cv->bal = value.bal() + amount;
+        db.tbl_checking().update_row(row, new_cv);
+    }
+    }
+
+    } RETRY(true);
+
+    return true;
+}
+
+template <typename DBParams>
+bool smallbank_runner<DBParams>::run_txn_send_payment(uint64_t c0, uint64_t c1, float amount) {
+    typedef accounts_row::NamedColumn a_nc;
+    typedef checking_row::NamedColumn c_nc;
+    bool user_abort = false;
+
+    RWTRANSACTION {
+
+    user_abort = false;
+    for (auto c : {c0, c1}) {
+        auto [abort, result, row, value] = db.tbl_accounts().select_split_row(accounts_key(c),
+            {{a_nc::name, access_t::read}});
+        (void)row; (void)value;
+        TXN_DO(abort);
+        assert(result);
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_checking().select_split_row(checking_key(c0),
+        {{c_nc::bal, access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    user_abort = value.bal() < amount;
+    TXN_DO(!user_abort);
+    auto new_cv = Sto::tx_alloc<checking_row>();
+    new_cv->bal = value.bal() - amount;
+    db.tbl_checking().update_row(row, new_cv);
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_checking().select_split_row(checking_key(c1),
+        {{c_nc::bal, Commute ? access_t::write : access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    if constexpr (Commute) {
+        (void)value;
+        commutators::Commutator<checking_row> comm(amount);
+        db.tbl_checking().update_row(row, comm);
+    } else {
+        auto new_cv = Sto::tx_alloc<checking_row>();
+        new_cv->bal = value.bal() + amount;
+        db.tbl_checking().update_row(row, new_cv);
+    }
+    }
+
+    } RETRY(!user_abort);
+
+    return !user_abort;
+}
+
+template <typename DBParams>
+bool smallbank_runner<DBParams>::run_txn_transact_savings(uint64_t c, float amount) {
+    typedef accounts_row::NamedColumn a_nc;
+    typedef savings_row::NamedColumn s_nc;
+    bool user_abort = false;
+
+    RWTRANSACTION {
+
+    user_abort = false;
+    {
+    auto [abort, result, row, value] = db.tbl_accounts().select_split_row(accounts_key(c),
+        {{a_nc::name, access_t::read}});
+    (void)row; (void)value;
+    TXN_DO(abort);
+    assert(result);
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_savings().select_split_row(savings_key(c),
+        {{s_nc::bal, access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    user_abort = value.bal() < amount;
+    TXN_DO(!user_abort);
+    auto new_sv = Sto::tx_alloc<savings_row>();
+    new_sv->bal = value.bal() - amount;
+    db.tbl_savings().update_row(row, new_sv);
+    }
+
+    } RETRY(!user_abort);
+
+    return !user_abort;
+}
+
+template <typename DBParams>
+bool smallbank_runner<DBParams>::run_txn_write_check(uint64_t c, float amount) {
+    typedef accounts_row::NamedColumn a_nc;
+    typedef savings_row::NamedColumn s_nc;
+    typedef checking_row::NamedColumn c_nc;
+
+    RWTRANSACTION {
+
+    {
+    auto [abort, result, row, value] = db.tbl_accounts().select_split_row(accounts_key(c),
+        {{a_nc::name, access_t::read}});
+    (void)row; (void)value;
+    TXN_DO(abort);
+    assert(result);
+    }
+    float savings;
+    {
+    auto [abort, result, row, value] = db.tbl_savings().select_split_row(savings_key(c),
+        {{s_nc::bal, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    savings = value.bal();
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_checking().select_split_row(checking_key(c),
+        {{c_nc::bal, access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    // overdrafts pay a penalty of 1
+    auto new_cv = Sto::tx_alloc<checking_row>();
+    new_cv->bal = value.bal() - (savings + value.bal() < amount ? amount + 1 : amount);
+    db.tbl_checking().update_row(row, new_cv);
+    }
+
+    } RETRY(true);
+
+    return true;
+}
+
+template <typename DBParams>
+void smallbank_runner<DBParams>::run() {
+    ::TThread::set_id(id);
+    set_affinity(id);
+    db.thread_init_all();
+
+    auto tsc_begin = read_tsc();
+    size_t cnt = 0;
+    size_t user_aborts = 0;
+    while (true) {
+        auto t_type = ig.next_transaction();
+        bool committed = true;
+        bench::latency_profile::timer lt;
+        switch (t_type) {
+            case TxnType::Amalgamate: {
+                auto [c0, c1] = ig.customer_pair();
+                committed = run_txn_amalgamate(c0, c1);
+                break;
+            }
+            case TxnType::Balance:
+                committed = run_txn_balance(ig.customer_id());
+                break;
+            case TxnType::DepositChecking:
+                committed = run_txn_deposit_checking(ig.customer_id(), constants::deposit_checking_amount);
+                break;
+            case TxnType::SendPayment: {
+                auto [c0, c1] = ig.customer_pair();
+                committed = run_txn_send_payment(c0, c1, constants::send_payment_amount);
+                break;
+            }
+            case TxnType::TransactSavings:
+                committed = run_txn_transact_savings(ig.customer_id(), constants::transact_savings_amount);
+                break;
+            case TxnType::WriteCheck:
+                committed = run_txn_write_check(ig.customer_id(), constants::write_check_amount);
+                break;
+            default:
+                always_assert(false, "unknown transaction type");
+                break;
+        }
+        lt.record(static_cast<int>(t_type));
+
+        if (committed)
+            ++cnt;
+        else
+            ++user_aborts;
+        if ((read_tsc() - tsc_begin) >= time_limit)
+            break;
+    }
+
+    total_commits_ = cnt;
+    user_aborts_ = user_aborts;
+}
+
+}; // namespace smallbank
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+
+#include "DB_analytics.hh"
+#include "TPCC_structs.hh"
+
+namespace tpcc {
+
+template <typename DBParams>
+class tpcc_db;
+
+// CH-benCHmark style analytical queries over the order-line tables of an
+// MVCC TPC-C database, for analytic threads running beside the TPC-C
+// runners. Each query reads every warehouse as of one pinned snapshot
+// with bench::snapshot_scanner, so it sees a consistent database and never
+// aborts or blocks a runner.
+//
+//   Q1: SELECT ol_number, SUM(ol_quantity), SUM(ol_amount), COUNT(*)
+//       FROM order_line WHERE ol_delivery_d > since GROUP BY ol_number
+//   Q6: SELECT SUM(ol_amount) FROM order_line
+//       WHERE ol_delivery_d BETWEEN lo AND hi AND ol_quantity BETWEEN 1 AND 100000
+template <typename DBParams>
+class tpcc_analytics {
+public:
+    typedef typename tpcc_db<DBParams>::ol_table_type ol_table_type;
+    typedef SplitParams<orderline_value> ol_split_params;
+
+    // batch columns
+    enum : size_t { c_number = 0, c_quantity, c_amount, c_delivery_d, num_columns };
+    static constexpr size_t max_ol_number = 15;
+    // the range of tpcc_input_generator::gen_date()
+    static constexpr uint32_t first_date = 1505244122;
+    static constexpr uint32_t last_date = 1599938522;
+
+    struct q1_result {
+        std::array<int64_t, max_ol_number + 1> sum_quantity;
+        std::array<int64_t, max_ol_number + 1> sum_amount;
+        std::array<int64_t, max_ol_number + 1> count;
+    };
+
+    explicit tpcc_analytics(tpcc_db<DBParams>& db)
+        : db_(db), scanner_(query_splits()), rows_(0) {
+    }
+
+    q1_result run_q1(TransactionTid::type tid, uint32_t since) {
+        q1_result r;
+        r.sum_quantity.fill(0);
+        r.sum_amount.fill(0);
+        r.count.fill(0);
+        for_each_warehouse(tid, [&] (batch_type& b) {
+            b.filter(c_delivery_d, int64_t(since) + 1, INT64_MAX);
+            uint64_t delivered[batch_type::words];
+            memcpy(delivered, b.sel, sizeof(delivered));
+            for (size_t n = 1; n <= max_ol_number; ++n) {
+                memcpy(b.sel, delivered, sizeof(delivered));
+                b.filter(c_number, n, n);
+                r.sum_quantity[n] += b.sum(c_quantity);
+                r.sum_amount[n] += b.sum(c_amount);
+                r.count[n] += b.count();
+            }
+        });
+        return r;
+    }
+
+    int64_t run_q6(TransactionTid::type tid, uint32_t lo, uint32_t hi) {
+        int64_t revenue = 0;
+        for_each_warehouse(tid, [&] (batch_type& b) {
+            b.filter(c_delivery_d, lo, hi);
+            b.filter(c_quantity, 1, 100000);
+            revenue += b.sum(c_amount);
+        });
+        return revenue;
+    }
+
+    // order lines read by all queries so far
+    uint64_t rows() const {
+        return rows_;
+    }
+
+private:
+    typedef bench::snapshot_scanner<ol_table_type, num_columns> scanner_type;
+    typedef typename scanner_type::batch_type batch_type;
+
+    tpcc_db<DBParams>& db_;
+    scanner_type scanner_;
+    uint64_t rows_;
+
+    // The splits holding the columns the queries read
+    static uint64_t query_splits() {
+        typedef orderline_value::NamedColumn nc;
+        uint64_t splits = 0;
+        for (nc c : {nc::ol_quantity, nc::ol_amount, nc::ol_delivery_d})
+            splits |= uint64_t(1) << ol_split_params::map(static_cast<int>(c));
+        return splits;
+    }
+
+    template <typename Consume>
+    void for_each_warehouse(TransactionTid::type tid, Consume consume) {
+        auto extract = [] (const orderline_key& key, const auto& split_values, batch_type& b, size_t row) {
+            SplitRecordAccessor<orderline_value> olv(split_values);
+            b.columns[c_number][row] = key.get_ol_number();
+            b.columns[c_quantity][row] = olv.ol_quantity();
+            b.columns[c_amount][row] = olv.ol_amount();
+            b.columns[c_delivery_d][row] = olv.ol_delivery_d();
+        };
+        for (int w = 1; w <= db_.num_warehouses(); ++w)
+            rows_ += scanner_.scan(db_.tbl_orderlines(w), lcdf::Str(), lcdf::Str(), tid, extract, consume);
+    }
+};
+
+} // namespace tpcc
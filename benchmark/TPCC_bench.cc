@@ -24,10 +24,42 @@ const Clp_Option options[] = {
         { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "gc",           'g', opt_gc,    Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "gc-rate",      'r', opt_gr,    Clp_ValInt,    Clp_Optional },
+        { "gc-adaptive",  'a', opt_gca,   Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "node",         'n', opt_node,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "verbose",      'v', opt_verb,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "mix",          'm', opt_mix,   Clp_ValInt,    Clp_Optional },
+        { "ro-fastpath",  'o', opt_rofp,  Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "sorted-locks", 'L', opt_slock, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "flatten-threads", 'F', opt_flat, Clp_ValInt,  Clp_Optional },
+        { "snapshot-dump", 'D', opt_snap, Clp_ValString, Clp_Optional },
+        { "cm-policy",    'C', opt_cm,    Clp_ValString, Clp_Optional },
+        { "alloc",        'A', opt_alloc, Clp_ValString, Clp_Optional },
+        { "partitioned",  'P', opt_part,  Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "cross-pct",    'X', opt_xpct,  Clp_ValInt,    Clp_Optional },
+        { "random-home",  'H', opt_rhome, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "arrival-rate", 'R', opt_rate,  Clp_ValDouble, Clp_Optional },
+        { "poisson",      'Q', opt_pois,  Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "sweep-threads", 'T', opt_swthr, Clp_ValString, Clp_Optional },
+        { "sweep-mixes",  'M', opt_swmix, Clp_ValString, Clp_Optional },
+        { "profile-counters", 'K', opt_txp, Clp_NoVal,   Clp_Negate | Clp_Optional },
+        { "conflict-report", 'J', opt_conf, Clp_ValUnsigned, Clp_Optional },
+        { "pmu",          'U', opt_pmu,   Clp_NoVal,     Clp_Optional },
+        { "phase-timers", 'Z', opt_phase, Clp_ValUnsigned, Clp_Optional },
+        { "trace",        'Y', opt_trace, Clp_ValString, Clp_Optional },
+        { "abort-cost",   'B', opt_abcost, Clp_NoVal,    Clp_Optional },
+        { "seed",         'S', opt_seed,  Clp_ValUnsigned, Clp_Optional },
+        { "log-dir",      'W', opt_log,   Clp_ValString, Clp_Optional },
+        { "db-image",     'I', opt_image, Clp_ValString, Clp_Optional },
+        { "placement",    0,   opt_place, Clp_ValString, Clp_Optional },
+        { "housekeeping", 0,   opt_hk,    Clp_ValString, Clp_Optional },
+        { "numa-warehouses", 'N', opt_numa, Clp_NoVal,   Clp_Negate | Clp_Optional },
+        { "opacity-extensions", 0, opt_oext, Clp_ValUnsigned, Clp_Optional },
+        { "replicate-items", 0, opt_ritems, Clp_NoVal, Clp_Negate | Clp_Optional },
+        { "analytic-threads", 0, opt_olap, Clp_ValInt,  Clp_Optional },
+        { "defer-hot",    0,   opt_defer, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "repairs",      0,   opt_repair, Clp_ValUnsigned, Clp_Optional },
+        { "conflict-map", 0,   opt_cmap,  Clp_ValUnsigned, Clp_Optional },
 };
 
 const char* workload_mix_names[] = { "Full", "NO-only", "NO+P-only" };
@@ -42,7 +74,9 @@ void print_usage(const char *argv_0) {
     ss << "Usage of " << std::string(argv_0) << ":" << std::endl
        << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
        << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
-       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode" << std::endl
+       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode, det" << std::endl
+       << "      (det runs transactions in deterministic batches, locking their declared keys in" << std::endl
+       << "      batch order instead of validating)" << std::endl
        << "  --nwarehouses=<NUM> (or -w<NUM>)" << std::endl
        << "    Specify the number of warehouses (default 1)." << std::endl
        << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
@@ -57,6 +91,8 @@ void print_usage(const char *argv_0) {
        << "    Enable garbage collection (default false)." << std::endl
        << "  --gc-rate=<NUM> (or -r<NUM>)" << std::endl
        << "    Number of microseconds between GC epochs. Defaults to 100000." << std::endl
+       << "  --gc-adaptive (or -a)" << std::endl
+       << "    Adapt the GC epoch cycle to the garbage backlog, between gc-rate/10 and gc-rate*10 (default false)." << std::endl
        << "  --node (or -n)" << std::endl
        << "    Enable node tracking (default false)." << std::endl
        << "  --commute (or -x)" << std::endl
@@ -67,7 +103,100 @@ void print_usage(const char *argv_0) {
        << "    Specify workload mix:" << std::endl
        << "    0. Full mix (default)" << std::endl
        << "    1. New-order only" << std::endl
-       << "    2. New-order plus Payment only" << std::endl;
+       << "    2. New-order plus Payment only" << std::endl
+       << "  --ro-fastpath (or -o)" << std::endl
+       << "    Run Order-Status and Stock-Level on the read-only fast path (default true)." << std::endl
+       << "  --sorted-locks (or -L)" << std::endl
+       << "    Take commit locks in sorted order, waiting instead of aborting (default false)." << std::endl
+       << "  --flatten-threads=<NUM> (or -F<NUM>)" << std::endl
+       << "    Run NUM background MVCC flattening threads, pinned after the workers (BG_FLATTEN=1 builds, default 0)." << std::endl
+       << "  --snapshot-dump=<PATH> (or -D<PATH>)" << std::endl
+       << "    At the start of the run, dump warehouse 1's customer and stock tables as of one snapshot" << std::endl
+       << "    to PATH.customer and PATH.stock, in the background (MVCC only)." << std::endl
+       << "  --analytic-threads=<NUM>" << std::endl
+       << "    Run NUM CH-benCHmark analytic threads beside the workers, each running Q1 and Q6 over all" << std::endl
+       << "    order lines as of a pinned snapshot, and report their query throughput (MVCC only, default 0)." << std::endl
+       << "  --defer-hot" << std::endl
+       << "    Have Payment add to w_ytd and d_ytd at commit, after validation, instead of reading them" << std::endl
+       << "    (deferred updates; not for MVCC or --commute, default false)." << std::endl
+       << "  --repairs=<NUM>" << std::endl
+       << "    When a New-order stock read fails validation, rerun that warehouse's stock updates at" << std::endl
+       << "    commit, keeping the locks, up to NUM times before aborting (not for MVCC, default 0)." << std::endl
+       << "  --cm-policy=<STRING> (or -C<STRING>)" << std::endl
+       << "    Contention management policy: none, greedy (default), karma, polka." << std::endl
+       << "  --alloc=<STRING> (or -A<STRING>)" << std::endl
+       << "    Allocator for table rows, index elements and MVCC versions: default (the malloc this binary" << std::endl
+       << "    was built with: libc, jemalloc or rpmalloc), hugepage-arena (2MB slabs per NUMA node), or" << std::endl
+       << "    pmem:<PATH> (the same slabs in a file on a DAX file system; MVCC commits flush their versions)." << std::endl
+       << "  --partitioned (or -P)" << std::endl
+       << "    Give each thread a partition of the warehouses. Transactions within their own partition commit" << std::endl
+       << "    without read validation, serialized by partition locks; others lock every partition they touch" << std::endl
+       << "    and commit normally. Needs at least as many warehouses as threads (default false)." << std::endl
+       << "  --cross-pct=<NUM> (or -X<NUM>)" << std::endl
+       << "    Percentage of New-Order and Payment transactions that touch a remote warehouse" << std::endl
+       << "    (default: the spec's 1% per order line and 15% of payments)." << std::endl
+       << "  --random-home (or -H)" << std::endl
+       << "    Pick each transaction's home warehouse at random from all warehouses, instead of from" << std::endl
+       << "    the thread's own share of them (default false)." << std::endl
+       << "  --numa-warehouses (or -N)" << std::endl
+       << "    Give each NUMA node a contiguous block of the warehouses: their tables are allocated on" << std::endl
+       << "    the node, loaded by threads on the node, and each thread runs on the node of its first" << std::endl
+       << "    home warehouse (default false, which leaves data where the loaders first touch it)." << std::endl
+       << "  --replicate-items" << std::endl
+       << "    With --numa-warehouses, give each node its own copy of the read-only item table, so" << std::endl
+       << "    New-Order reads items from local memory (default false)." << std::endl
+       << "  --arrival-rate=<NUM> (or -R<NUM>)" << std::endl
+       << "    Run open-loop: transactions arrive at each thread at NUM per second, and their latency" << std::endl
+       << "    counts from the scheduled arrival (default 0, closed loop)." << std::endl
+       << "  --poisson (or -Q)" << std::endl
+       << "    Make open-loop arrivals a Poisson process instead of evenly spaced (default false)." << std::endl
+       << "  --sweep-threads=<LIST> (or -T<LIST>)" << std::endl
+       << "    Run once per comma-separated thread count, on tables populated once (overrides --nthreads)." << std::endl
+       << "  --sweep-mixes=<LIST> (or -M<LIST>)" << std::endl
+       << "    Run once per workload mix in the list, for each thread count (overrides --mix)." << std::endl
+       << "  --profile-counters (or -K)" << std::endl
+       << "    Count commits, aborts by reason and per-transaction stages, and print them after the run" << std::endl
+       << "    (default: on in STO_PROFILE_COUNTERS builds)." << std::endl
+       << "  --conflict-report[=<NUM>] (or -J[<NUM>])" << std::endl
+       << "    Attribute aborts to the tables and keys that caused them, and print the top ones after" << std::endl
+       << "    the run. With NUM, keys are hashed into NUM buckets (default: exact keys)." << std::endl
+       << "  --pmu (or -U)" << std::endl
+       << "    Read cycles, instructions, LLC and dTLB misses around each transaction type (and, in" << std::endl
+       << "    STO_TSC_PROFILE builds, each commit phase) and print IPC and miss rates after the run." << std::endl
+       << "  --phase-timers[=<NUM>] (or -Z[<NUM>])" << std::endl
+       << "    Time the phases of one transaction attempt in NUM per thread (start, execution, commit lock," << std::endl
+       << "    check and install, cleanup, lock waits, MVCC flattening) and print totals and" << std::endl
+       << "    per-attempt distributions after the run (default NUM 100; 0 turns it off)." << std::endl
+       << "  --abort-cost (or -B)" << std::endl
+       << "    Measure the cycles wasted in aborted attempts, by transaction type and abort reason," << std::endl
+       << "    and the distribution of retries per transaction, and print them after the run." << std::endl
+       << "  --seed=<NUM> (or -S<NUM>)" << std::endl
+       << "    Seed the input generators with NUM plus each worker's id (default 0), for reproducible runs." << std::endl
+       << "  --trace=<FILE> (or -Y<FILE>)" << std::endl
+       << "    Record transaction lifecycle events in per-thread ring buffers and write the newest as" << std::endl
+       << "    Chrome trace JSON to FILE after the run, or on SIGUSR2 while it runs with --gc." << std::endl
+       << "  --log-dir=<DIR> (or -W<DIR>)" << std::endl
+       << "    Run TxnLog's loggers, one per four threads, writing to DIR, and report each transaction" << std::endl
+       << "    type's latency to durability alongside its latency (implies --gc). OCC tables log the" << std::endl
+       << "    words each update changes; MVCC tables log nothing." << std::endl
+       << "  --db-image=<DIR> (or -I<DIR>)" << std::endl
+       << "    Thaw the loaded database from the image in DIR instead of prepopulating it; without a" << std::endl
+       << "    matching image, prepopulate and freeze the database into DIR for later runs." << std::endl
+       << "  --placement=<POLICY>" << std::endl
+       << "    Where runner threads are pinned: scatter (round-robin over NUMA nodes, default), compact" << std::endl
+       << "    (node by node, SMT siblings together), physical-first (one thread per physical core before" << std::endl
+       << "    any SMT sibling), or file:<PATH> (the CPUs listed in PATH, in order). CPUs outside the" << std::endl
+       << "    process's cpuset are never used." << std::endl
+       << "  --opacity-extensions=<NUM>" << std::endl
+       << "    With opaque DB types, abort a transaction attempt instead of revalidating its read set" << std::endl
+       << "    after NUM snapshot extensions (default 0, no limit)." << std::endl
+       << "  --housekeeping=<CPUS>" << std::endl
+       << "    Pin the epoch advancer, loggers and other service threads to CPUS (e.g. 0,1 or 0-1), and keep" << std::endl
+       << "    runner threads off them. Each service thread's CPU time is reported with the statistics." << std::endl
+       << "  --conflict-map[=<NUM>]" << std::endl
+       << "    Sample the ordered indexes' commit lock, validation and phantom failures by the first NUM" << std::endl
+       << "    bytes of their keys (default 2), print the hottest prefixes after the run and write the" << std::endl
+       << "    heatmap to " STO_CONFLICT_MAP_FILE "." << std::endl;
 
     std::cout << ss.str() << std::flush;
 }
@@ -139,6 +268,42 @@ int main(int argc, const char *const *argv) {
         case opt_comm:
             enable_commute = !clp->negated;
             break;
+        case opt_cm:
+            if (!ContentionManager::set_policy(clp->val.s)) {
+                std::cout << "Unsupported contention management policy: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_place:
+            if (!set_placement(clp->val.s)) {
+                std::cout << "Unsupported thread placement: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_hk:
+            if (!set_housekeeping_cpus(clp->val.s)) {
+                std::cout << "Bad housekeeping CPU list: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_alloc:
+            if (!HugeArena::select(clp->val.s)) {
+                std::cout << "Unsupported allocator: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
         default:
             break;
         }
@@ -147,6 +312,7 @@ int main(int argc, const char *const *argv) {
     Clp_DeleteParser(clp);
     if (ret_code != 0)
         return ret_code;
+    std::cout << "Table allocator: " << HugeArena::selected() << std::endl;
 
     switch (dbid) {
     case db_params_id::Default:
@@ -207,6 +373,12 @@ int main(int argc, const char *const *argv) {
             ret_code = tpcc_m(argc, argv);
         }
         break;
+    case db_params_id::Deterministic:
+        if (node_tracking || enable_commute) {
+            std::cerr << "Warning: node tracking and commute options ignored." << std::endl;
+        }
+        ret_code = tpcc_det(argc, argv);
+        break;
     default:
         std::cerr << "unsupported db config parameter id" << std::endl;
         ret_code = 1;
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <memory>
 #include <random>
+#include <sstream>
 #include <string>
 #include <thread>
 
@@ -19,9 +22,16 @@
 #include "TPCC_selectors.hh"
 #endif
 
+#include "DB_deterministic.hh"
+#include "DB_image.hh"
 #include "DB_index.hh"
+#include "DB_loader.hh"
 #include "DB_params.hh"
+#include "DB_partition.hh"
 #include "DB_profiler.hh"
+#include "DB_secondary.hh"
+#include "DB_snapshot.hh"
+#include "DB_views.hh"
 #include "PlatformFeatures.hh"
 
 #if TABLE_FINE_GRAINED
@@ -30,6 +40,8 @@
 #include "tpcc_split_params_default.hh"
 #endif
 
+#include "TPCC_analytics.hh"
+
 #define A_GEN_CUSTOMER_ID           1023
 #define A_GEN_ITEM_ID               8191
 
@@ -39,7 +51,10 @@
 // @section: clp parser definitions
 enum {
     opt_dbid = 1, opt_nwhs, opt_nthrs, opt_time, opt_perf, opt_pfcnt, opt_gc,
-    opt_gr, opt_node, opt_comm, opt_verb, opt_mix
+    opt_gr, opt_node, opt_comm, opt_verb, opt_mix, opt_rofp, opt_slock, opt_flat, opt_gca, opt_snap, opt_cm,
+    opt_alloc, opt_part, opt_xpct, opt_rate, opt_pois, opt_swthr, opt_swmix, opt_rhome, opt_txp, opt_conf,
+    opt_pmu, opt_phase, opt_trace, opt_abcost, opt_seed, opt_log, opt_image, opt_place, opt_numa, opt_hk, opt_oext, opt_ritems,
+    opt_olap, opt_defer, opt_repair, opt_cmap
 };
 
 extern const char* workload_mix_names[];
@@ -68,19 +83,81 @@ extern int tpcc_tc(int, char const* const*);
 extern int tpcc_tn(int, char const* const*);
 extern int tpcc_tcn(int, char const* const*);
 
+extern int tpcc_det(int, char const* const*);
+
 namespace tpcc {
 
 using namespace db_params;
 using bench::db_profiler;
 
+// Per-transaction stage, commit and abort counts (see txp_registry)
+struct txp_tpcc {
+    static inline const unsigned no_aborts  = txp_registry::add("tpcc_no_aborts");
+    static inline const unsigned no_commits = txp_registry::add("tpcc_no_commits");
+    static inline const unsigned no_stage1  = txp_registry::add("tpcc_no_stage1");
+    static inline const unsigned no_stage2  = txp_registry::add("tpcc_no_stage2");
+    static inline const unsigned no_stage3  = txp_registry::add("tpcc_no_stage3");
+    static inline const unsigned no_stage4  = txp_registry::add("tpcc_no_stage4");
+    static inline const unsigned no_stage5  = txp_registry::add("tpcc_no_stage5");
+    static inline const unsigned pm_aborts  = txp_registry::add("tpcc_pm_aborts");
+    static inline const unsigned pm_commits = txp_registry::add("tpcc_pm_commits");
+    static inline const unsigned pm_stage1  = txp_registry::add("tpcc_pm_stage1");
+    static inline const unsigned pm_stage2  = txp_registry::add("tpcc_pm_stage2");
+    static inline const unsigned pm_stage3  = txp_registry::add("tpcc_pm_stage3");
+    static inline const unsigned pm_stage4  = txp_registry::add("tpcc_pm_stage4");
+    static inline const unsigned pm_stage5  = txp_registry::add("tpcc_pm_stage5");
+    static inline const unsigned pm_stage6  = txp_registry::add("tpcc_pm_stage6");
+    static inline const unsigned os_aborts  = txp_registry::add("tpcc_os_aborts");
+    static inline const unsigned os_commits = txp_registry::add("tpcc_os_commits");
+    static inline const unsigned dl_stage1  = txp_registry::add("tpcc_dl_stage1");
+    static inline const unsigned dl_stage2  = txp_registry::add("tpcc_dl_stage2");
+    static inline const unsigned dl_stage3  = txp_registry::add("tpcc_dl_stage3");
+    static inline const unsigned dl_stage4  = txp_registry::add("tpcc_dl_stage4");
+    static inline const unsigned dl_stage5  = txp_registry::add("tpcc_dl_stage5");
+    static inline const unsigned dl_aborts  = txp_registry::add("tpcc_dl_aborts");
+    static inline const unsigned dl_commits = txp_registry::add("tpcc_dl_commits");
+    static inline const unsigned st_aborts  = txp_registry::add("tpcc_st_aborts");
+    static inline const unsigned st_commits = txp_registry::add("tpcc_st_commits");
+};
+
+// PMU phases for each transaction type (see PmuProfile)
+struct pmu_tpcc {
+    static inline const unsigned new_order    = PmuProfile::add_phase("new_order");
+    static inline const unsigned payment      = PmuProfile::add_phase("payment");
+    static inline const unsigned order_status = PmuProfile::add_phase("order_status");
+    static inline const unsigned delivery     = PmuProfile::add_phase("delivery");
+    static inline const unsigned stock_level  = PmuProfile::add_phase("stock_level");
+};
+
+// Abort cost types (see AbortProfile)
+struct abort_tpcc {
+    static inline const unsigned new_order    = AbortProfile::add_type("new_order");
+    static inline const unsigned payment      = AbortProfile::add_type("payment");
+    static inline const unsigned order_status = AbortProfile::add_type("order_status");
+    static inline const unsigned delivery     = AbortProfile::add_type("delivery");
+    static inline const unsigned stock_level  = AbortProfile::add_type("stock_level");
+};
+
+// Attributes one transaction to its type in both profiles
+class tpcc_type_scope {
+public:
+    tpcc_type_scope(unsigned pmu_phase, unsigned abort_type)
+        : pmu_(pmu_phase), type_(abort_type) {
+    }
+
+private:
+    PmuProfile::scope pmu_;
+    AbortProfile::type_scope type_;
+};
+
 class tpcc_input_generator {
 public:
     static const char * last_names[];
 
     tpcc_input_generator(int id, int num_whs)
-            : gen(id), num_whs_(uint64_t(num_whs)) {}
+            : gen(constants::workload_seed + id), num_whs_(uint64_t(num_whs)) {}
     explicit tpcc_input_generator(int num_whs)
-            : gen(0), num_whs_(uint64_t(num_whs)) {}
+            : gen(constants::workload_seed), num_whs_(uint64_t(num_whs)) {}
 
     uint64_t nurand(uint64_t a, uint64_t c, uint64_t x, uint64_t y) {
         uint64_t r1 = (random(0, a) | random(x, y)) + c;
@@ -150,6 +227,36 @@ class tpcc_access;
 #define TPCC_HASH_INDEX 1
 #endif
 
+// Add new orders to the order-by-customer index after they commit
+#ifndef TPCC_DEFERRED_OCI
+#define TPCC_DEFERRED_OCI 0
+#endif
+
+// Order-by-customer index key of an order
+struct order_cidx_key_of {
+    order_cidx_key operator()(const order_key& k, const order_value& v) const {
+        return order_cidx_key(bswap(k.o_w_id), bswap(k.o_d_id), v.o_c_id, bswap(k.o_id));
+    }
+};
+
+// Keep each customer's latest order id in a view maintained by new-order,
+// so order-status reads it instead of scanning the order-by-customer index
+#ifndef TPCC_LATEST_ORDER_VIEW
+#define TPCC_LATEST_ORDER_VIEW 0
+#endif
+
+// Latest-order view group and value of an order
+struct order_customer_of {
+    customer_key operator()(const order_key& k, const order_value& v) const {
+        return customer_key(bswap(k.o_w_id), bswap(k.o_d_id), v.o_c_id);
+    }
+};
+struct order_id_of {
+    int64_t operator()(const order_key& k, const order_value&) const {
+        return bswap(k.o_id);
+    }
+};
+
 template <typename DBParams>
 class tpcc_db {
 public:
@@ -180,8 +287,14 @@ public:
     typedef OIndex<order_key, bench::dummy_row>          no_table_type;
     typedef UIndex<item_key, item_value>                 it_table_type;
     typedef OIndex<history_key, history_value>           ht_table_type;
+    typedef UIndex<customer_key, bench::latest_row>      lo_table_type;
+
+    typedef bench::secondary_index<od_table_type, oi_table_type, order_cidx_key_of> od_oi_type;
+    typedef bench::latest_view<lo_table_type, order_customer_of, order_id_of> lo_view_type;
 
-    explicit inline tpcc_db(int num_whs);
+    // With wh_nodes, warehouse w's tables are allocated on NUMA node
+    // wh_nodes[w - 1]
+    explicit inline tpcc_db(int num_whs, const std::vector<int>& wh_nodes = {});
     explicit inline tpcc_db(const std::string& db_file_name) = delete;
     inline ~tpcc_db();
     void thread_init_all();
@@ -189,6 +302,10 @@ public:
     int num_warehouses() const {
         return static_cast<int>(num_whs_);
     }
+    // NUMA node of warehouse w's data, or -1 if it has none
+    int node_of_warehouse(uint64_t w_id) const {
+        return wh_nodes_.empty() ? -1 : wh_nodes_[w_id - 1];
+    }
     wh_table_type& tbl_warehouses() {
         return tbl_whs_;
     }
@@ -213,12 +330,38 @@ public:
     oi_table_type& tbl_order_customer_index(uint64_t w_id) {
         return tbl_oci_[w_id - 1];
     }
+    // the orders table with its order-by-customer index
+    od_oi_type tbl_orders_indexed(uint64_t w_id) {
+        return od_oi_type(tbl_orders(w_id), tbl_order_customer_index(w_id), TPCC_DEFERRED_OCI);
+    }
+    // each customer's latest order id; only with TPCC_LATEST_ORDER_VIEW
+    lo_table_type& tbl_latest_orders(uint64_t w_id) {
+        return tbl_los_[w_id - 1];
+    }
+    lo_view_type latest_orders(uint64_t w_id) {
+        return lo_view_type(tbl_latest_orders(w_id));
+    }
     no_table_type& tbl_neworders(uint64_t w_id) {
         return tbl_nos_[w_id - 1];
     }
     it_table_type& tbl_items() {
         return *tbl_its_;
     }
+    // The item table for transactions of home warehouse w: its node's
+    // replica if replicate_items() made one, else the primary
+    it_table_type& tbl_items(uint64_t w_id) {
+        int node = node_of_warehouse(w_id);
+        if (node >= 0 && size_t(node) < item_replicas_.size() && item_replicas_[node])
+            return *item_replicas_[node];
+        return *tbl_its_;
+    }
+    // Copies the loaded item table to every warehouse node, allocated on
+    // that node. The copies are not kept in sync, so the item table must
+    // not change afterwards (set_immutable).
+    inline void replicate_items();
+    const std::vector<it_table_type*>& item_replicas() const {
+        return item_replicas_;
+    }
     ht_table_type& tbl_histories(uint64_t w_id) {
         return tbl_hts_[w_id - 1];
     }
@@ -228,10 +371,20 @@ public:
     tpcc_delivery_queue& delivery_queue() {
         return dlvy_queue_;
     }
+    // warehouse partitions of --partitioned runs; null otherwise
+    bench::partition_map* partitions() {
+        return parts_.get();
+    }
+    void set_partitions(bench::partition_map* parts) {
+        parts_.reset(parts);
+    }
 
 private:
     size_t num_whs_;
+    std::vector<int> wh_nodes_;
     it_table_type *tbl_its_;
+    // indexed by NUMA node; null for nodes without warehouses
+    std::vector<it_table_type*> item_replicas_;
 
     wh_table_type tbl_whs_;
     std::vector<dt_table_type> tbl_dts_;
@@ -244,9 +397,11 @@ private:
     std::vector<oi_table_type> tbl_oci_;
     std::vector<no_table_type> tbl_nos_;
     std::vector<ht_table_type> tbl_hts_;
+    std::vector<lo_table_type> tbl_los_;
 
     tpcc_oid_generator oid_gen_;
     tpcc_delivery_queue dlvy_queue_;
+    std::unique_ptr<bench::partition_map> parts_;
 
     friend class tpcc_access<DBParams>;
 };
@@ -263,9 +418,11 @@ public:
         stock_level
     };
 
-    tpcc_runner(int id, tpcc_db<DBParams>& database, uint64_t w_start, uint64_t w_end, uint64_t w_own, int mix)
-        : ig(id, database.num_warehouses()), db(database), mix(mix), runner_id(id),
-          w_id_start(w_start), w_id_end(w_end), w_id_owned(w_own) {}
+    tpcc_runner(int id, tpcc_db<DBParams>& database, uint64_t w_start, uint64_t w_end, uint64_t w_own, int mix,
+                int cross_pct = -1)
+        : ig(id, database.num_warehouses()), db(database),
+          oids(database.oid_generator(), database.num_warehouses(), TPCC_OID_LEASE), mix(mix), runner_id(id),
+          w_id_start(w_start), w_id_end(w_end), w_id_owned(w_own), cross_pct(cross_pct) {}
 
     inline txn_type next_transaction() {
         uint64_t x = ig.random(1, 100);
@@ -290,25 +447,122 @@ public:
             return txn_type::payment;
     }
 
-    inline void run_txn_neworder();
-    inline void run_txn_payment();
-    inline void run_txn_orderstatus();
-    inline void run_txn_delivery(uint64_t wid,
+    // A transaction's inputs, drawn from ig before it runs
+    struct neworder_input {
+        uint64_t q_w_id, q_d_id, q_c_id, num_items;
+        uint64_t ol_i_ids[15];
+        uint64_t ol_supply_w_ids[15];
+        uint64_t ol_quantities[15];
+        uint32_t o_entry_d;
+        bool all_local;
+    };
+    struct payment_input {
+        uint64_t q_w_id, q_d_id, q_c_w_id, q_c_d_id, q_c_id;
+        bool by_name;
+        std::string last_name;
+        int64_t h_amount;
+        uint32_t h_date;
+    };
+    struct orderstatus_input {
+        uint64_t q_w_id, q_d_id, q_c_id;
+        bool by_name;
+        std::string last_name;
+    };
+    struct delivery_input {
+        uint64_t q_w_id, carrier_id;
+        uint32_t delivery_date;
+    };
+    struct stocklevel_input {
+        uint64_t q_w_id, q_d_id;
+        int32_t threshold;
+    };
+
+    inline neworder_input gen_neworder();
+    inline payment_input gen_payment();
+    inline orderstatus_input gen_orderstatus();
+    inline delivery_input gen_delivery(uint64_t wid);
+    inline stocklevel_input gen_stocklevel();
+
+    inline void run_txn_neworder(const neworder_input& in);
+    inline void run_txn_payment(const payment_input& in);
+    inline void run_txn_orderstatus(const orderstatus_input& in);
+    inline void run_txn_delivery(const delivery_input& in,
         std::array<uint64_t, NUM_DISTRICTS_PER_WAREHOUSE>& last_delivered);
-    inline void run_txn_stocklevel();
+    inline void run_txn_stocklevel(const stocklevel_input& in);
+
+    void run_txn_neworder() {
+        run_txn_neworder(gen_neworder());
+    }
+    void run_txn_payment() {
+        run_txn_payment(gen_payment());
+    }
+    void run_txn_orderstatus() {
+        run_txn_orderstatus(gen_orderstatus());
+    }
+    void run_txn_delivery(uint64_t wid, std::array<uint64_t, NUM_DISTRICTS_PER_WAREHOUSE>& last_delivered) {
+        run_txn_delivery(gen_delivery(wid), last_delivered);
+    }
+    void run_txn_stocklevel() {
+        run_txn_stocklevel(gen_stocklevel());
+    }
 
     inline uint64_t owned_warehouse() const {
         return w_id_owned;
     }
 
+    // Payment updates w_ytd and d_ytd with deferred updates (OCC only)
+    static inline bool defer_hot_rows = false;
+
 private:
+    // Guard for a transaction on warehouse w_id: with partitions, add the
+    // other warehouses it touches, then lock() before starting it. Partition
+    // i is runner i's.
+    bench::partition_map::guard partition_guard(uint64_t w_id) {
+        return bench::partition_map::guard(db.partitions(), runner_id, w_id);
+    }
+
+    bool defers_hot_rows() const {
+        return !Commute && !DBParams::MVCC && defer_hot_rows;
+    }
+
+    // Runs f as a repair step (Transaction::repair_step), except under
+    // MVCC, where lock() has already consumed the write values a rerun
+    // would replace
+    template <typename F>
+    static bool run_repairable(const F& f) {
+        if constexpr (DBParams::MVCC)
+            return f();
+        else
+            return Sto::repair_step(f);
+    }
+
+    // Updates a hot row to new_row, a copy of it, with f(new_row, row)
+    // computing the hot columns from the current row: at commit with
+    // defers_hot_rows(), from the row as read otherwise
+    template <typename Table, typename F>
+    void update_hot_row(Table& table, uintptr_t row, typename Table::value_type* new_row, F f) {
+        if constexpr (!Commute && !DBParams::MVCC) {
+            if (defer_hot_rows) {
+                table.defer_update_row(row, new_row, f);
+                return;
+            }
+        }
+        typename Table::value_type current = *new_row;
+        f(*new_row, current);
+        table.update_row(row, new_row);
+    }
+
     tpcc_input_generator ig;
     tpcc_db<DBParams>& db;
+    tpcc_oid_cache oids;
     int mix;
     int runner_id;
     uint64_t w_id_start;
     uint64_t w_id_end;
     uint64_t w_id_owned;
+    // share (%) of New-Order and Payment that touch a remote warehouse; <0
+    // follows the spec's per-item and per-customer odds
+    int cross_pct;
 
     friend class tpcc_access<DBParams>;
 };
@@ -322,14 +576,24 @@ public:
         : ig(id, database.num_warehouses()), db(database), worker_id(id) {}
 
     inline void fill_items(uint64_t iid_begin, uint64_t iid_xend);
-    inline void fill_warehouses();
+    inline void fill_warehouse(uint64_t wid);
     inline void expand_warehouse(uint64_t wid);
     inline void expand_districts(uint64_t wid);
     inline void expand_customers(uint64_t wid);
 
     inline void run();
 
+    uint64_t rows() const {
+        return rows_;
+    }
+
 private:
+    template <typename Table, typename K, typename V>
+    void put(Table& table, const K& k, const V& v) {
+        table.nontrans_put(k, v);
+        ++rows_;
+    }
+
     inline std::string random_a_string(int x, int y);
     inline std::string random_n_string(int x, int y);
     inline std::string random_state_name();
@@ -339,6 +603,7 @@ private:
     tpcc_input_generator ig;
     tpcc_db<DBParams>& db;
     int worker_id;
+    uint64_t rows_ = 0;
 };
 
 template <typename DBParams>
@@ -346,15 +611,21 @@ pthread_barrier_t tpcc_prepopulator<DBParams>::sync_barrier;
 
 
 template <typename DBParams>
-tpcc_db<DBParams>::tpcc_db(int num_whs)
+tpcc_db<DBParams>::tpcc_db(int num_whs, const std::vector<int>& wh_nodes)
     : num_whs_(num_whs),
+      wh_nodes_(wh_nodes),
       tbl_whs_(256),
-      oid_gen_() {
+      oid_gen_(num_whs),
+      dlvy_queue_(num_whs) {
     //constexpr size_t num_districts = NUM_DISTRICTS_PER_WAREHOUSE;
     //constexpr size_t num_customers = NUM_CUSTOMERS_PER_DISTRICT * NUM_DISTRICTS_PER_WAREHOUSE;
 
     tbl_its_ = new it_table_type(999983/*NUM_ITEMS * 2*/);
     for (auto i = 0; i < num_whs; ++i) {
+        // the tables' buckets are touched here, so their pages come from
+        // the preferred node
+        if (!wh_nodes_.empty())
+            prefer_numa_node(wh_nodes_[i]);
         tbl_dts_.emplace_back(32/*num_districts * 2*/);
         tbl_cus_.emplace_back(999983/*num_customers * 2*/);
         tbl_ods_.emplace_back(999983/*num_customers * 10 * 2*/);
@@ -364,17 +635,46 @@ tpcc_db<DBParams>::tpcc_db(int num_whs)
         tbl_oci_.emplace_back(999983/*num_customers * 2*/);
         tbl_nos_.emplace_back(999983/*num_customers * 10 * 2*/);
         tbl_hts_.emplace_back(999983/*num_customers * 2*/);
+        if (TPCC_LATEST_ORDER_VIEW)
+            tbl_los_.emplace_back(999983/*num_customers * 2*/);
     }
+    if (!wh_nodes_.empty())
+        prefer_numa_node(-1);
 }
 
 template <typename DBParams>
 tpcc_db<DBParams>::~tpcc_db() {
+    for (auto t : item_replicas_)
+        delete t;
     delete tbl_its_;
 }
 
+template <typename DBParams>
+void tpcc_db<DBParams>::replicate_items() {
+    for (int node : wh_nodes_) {
+        if (size_t(node) >= item_replicas_.size())
+            item_replicas_.resize(node + 1, nullptr);
+        if (item_replicas_[node])
+            continue;
+        // rows are allocated by this thread, so they land on the preferred
+        // node whichever CPU it runs on
+        prefer_numa_node(node);
+        auto replica = new it_table_type(999983);
+        replica->thread_init();
+        tbl_its_->checkpoint_part(0, 1, 0, [&](const item_key& k, const item_value& v) {
+                replica->nontrans_put(k, v);
+            });
+        item_replicas_[node] = replica;
+    }
+    prefer_numa_node(-1);
+}
+
 template <typename DBParams>
 void tpcc_db<DBParams>::thread_init_all() {
     tbl_its_->thread_init();
+    for (auto t : item_replicas_)
+        if (t)
+            t->thread_init();
     tbl_whs_.thread_init();
     for (auto& t : tbl_dts_)
         t.thread_init();
@@ -394,6 +694,8 @@ void tpcc_db<DBParams>::thread_init_all() {
         t.thread_init();
     for (auto& t : tbl_hts_)
         t.thread_init();
+    for (auto& t : tbl_los_)
+        t.thread_init();
 }
 
 // @section: db prepopulation functions
@@ -414,26 +716,25 @@ void tpcc_prepopulator<DBParams>::fill_items(uint64_t iid_begin, uint64_t iid_xe
             (void)placed;
         }
 
-        db.tbl_items().nontrans_put(ik, iv);
+        put(db.tbl_items(), ik, iv);
     }
 }
 
 template<typename DBParams>
-void tpcc_prepopulator<DBParams>::fill_warehouses() {
-    for (uint64_t wid = 1; wid <= ig.num_warehouses(); ++wid) {
-        warehouse_key wk(wid);
-        warehouse_value wv {};
-        wv.w_name = random_a_string(6, 10);
-        wv.w_street_1 = random_a_string(10, 20);
-        wv.w_street_2 = random_a_string(10, 20);
-        wv.w_city = random_a_string(10, 20);
-        wv.w_state = random_state_name();
-        wv.w_zip = random_zip_code();
-        wv.w_tax = ig.random(0, 2000);
-        wv.w_ytd = 30000000;
-
-        db.tbl_warehouses().nontrans_put(wk, wv);
-    }
+void tpcc_prepopulator<DBParams>::fill_warehouse(uint64_t wid) {
+    db.oid_generator().init_warehouse(wid);
+    warehouse_key wk(wid);
+    warehouse_value wv {};
+    wv.w_name = random_a_string(6, 10);
+    wv.w_street_1 = random_a_string(10, 20);
+    wv.w_street_2 = random_a_string(10, 20);
+    wv.w_city = random_a_string(10, 20);
+    wv.w_state = random_state_name();
+    wv.w_zip = random_zip_code();
+    wv.w_tax = ig.random(0, 2000);
+    wv.w_ytd = 30000000;
+
+    put(db.tbl_warehouses(), wk, wv);
 }
 
 template<typename DBParams>
@@ -456,7 +757,7 @@ void tpcc_prepopulator<DBParams>::expand_warehouse(uint64_t wid) {
             (void)placed;
         }
 
-        db.tbl_stocks(wid).nontrans_put(sk, sv);
+        put(db.tbl_stocks(wid), sk, sv);
     }
 
     for (uint64_t did = 1; did <= NUM_DISTRICTS_PER_WAREHOUSE; ++did) {
@@ -473,7 +774,7 @@ void tpcc_prepopulator<DBParams>::expand_warehouse(uint64_t wid) {
         dv.d_ytd = 3000000;
         //dv.d_next_o_id = 3001;
 
-        db.tbl_districts(wid).nontrans_put(dk, dv);
+        put(db.tbl_districts(wid), dk, dv);
     }
 }
 
@@ -506,7 +807,7 @@ void tpcc_prepopulator<DBParams>::expand_districts(uint64_t wid) {
             cv.c_delivery_cnt = 0;
             cv.c_data = random_a_string(300, 500);
 
-            db.tbl_customers(wid).nontrans_put(ck, cv);
+            put(db.tbl_customers(wid), ck, cv);
 
             customer_idx_key cik(wid, did, cv.c_last);
             cids_map[cik].push_front(cid);
@@ -516,7 +817,7 @@ void tpcc_prepopulator<DBParams>::expand_districts(uint64_t wid) {
     for (auto kv : cids_map) {
         customer_idx_value civ;
         civ.c_ids = kv.second;
-        db.tbl_customer_index(wid).nontrans_put(kv.first, civ);
+        put(db.tbl_customer_index(wid), kv.first, civ);
     }
 }
 
@@ -538,7 +839,7 @@ void tpcc_prepopulator<DBParams>::expand_customers(uint64_t wid) {
 #else
             history_key hk(wid, did, cid, db.tbl_histories(wid).gen_key());
 #endif
-            db.tbl_histories(wid).nontrans_put(hk, hv);
+            put(db.tbl_histories(wid), hk, hv);
         }
     }
 
@@ -547,6 +848,8 @@ void tpcc_prepopulator<DBParams>::expand_customers(uint64_t wid) {
         for (uint64_t n = 1; n <= NUM_CUSTOMERS_PER_DISTRICT; ++n)
             cid_perm.push_back(n);
         random_shuffle(cid_perm);
+        // the order-by-customer index is loaded in key order afterwards
+        std::vector<uint64_t> cid_oids(NUM_CUSTOMERS_PER_DISTRICT + 1);
 
         for (uint64_t i = 1; i <= NUM_CUSTOMERS_PER_DISTRICT; ++i) {
             uint64_t oid = i;
@@ -561,10 +864,8 @@ void tpcc_prepopulator<DBParams>::expand_customers(uint64_t wid) {
             ov.o_ol_cnt = ol_count;
             ov.o_all_local = 1;
 
-            order_cidx_key ock(wid, did, ov.o_c_id, oid);
-
-            db.tbl_orders(wid).nontrans_put(ok, ov);
-            db.tbl_order_customer_index(wid).nontrans_put(ock, {});
+            put(db.tbl_orders(wid), ok, ov);
+            cid_oids[ov.o_c_id] = oid;
 
             for (uint64_t on = 1; on <= ol_count; ++on) {
                 orderline_key olk(wid, did, oid, on);
@@ -577,12 +878,27 @@ void tpcc_prepopulator<DBParams>::expand_customers(uint64_t wid) {
                 olv.ol_amount = (oid < 2101) ? 0 : (int) ig.random(1, 999999);
                 olv.ol_dist_info = random_a_string(24, 24);
 
-                db.tbl_orderlines(wid).nontrans_put(olk, olv);
+                put(db.tbl_orderlines(wid), olk, olv);
             }
 
             if (oid >= 2101) {
                 order_key nok(wid, did, oid);
-                db.tbl_neworders(wid).nontrans_put(nok, {});
+                put(db.tbl_neworders(wid), nok, bench::dummy_row());
+            }
+        }
+
+        std::vector<std::pair<order_cidx_key, bench::dummy_row>> ocis;
+        ocis.reserve(NUM_CUSTOMERS_PER_DISTRICT);
+        for (uint64_t cid = 1; cid <= NUM_CUSTOMERS_PER_DISTRICT; ++cid)
+            ocis.emplace_back(order_cidx_key(wid, did, cid, cid_oids[cid]), bench::dummy_row());
+        db.tbl_order_customer_index(wid).bulk_load(ocis.begin(), ocis.end());
+        rows_ += ocis.size();
+
+        if (TPCC_LATEST_ORDER_VIEW) {
+            for (uint64_t cid = 1; cid <= NUM_CUSTOMERS_PER_DISTRICT; ++cid) {
+                bench::latest_row lr;
+                lr.latest = cid_oids[cid];
+                put(db.tbl_latest_orders(wid), customer_key(wid, did, cid), lr);
             }
         }
     }
@@ -594,13 +910,11 @@ void tpcc_prepopulator<DBParams>::run() {
     int r;
 
     always_assert(worker_id >= 1, "prepopulator worker id range error");
-    // set affinity so that the warehouse is filled at the corresponding numa node
-    set_affinity(worker_id - 1);
 
-    if (worker_id == 1) {
-        fill_items(1, 100001);
-        fill_warehouses();
-    }
+    // every worker loads a slice of the items
+    uint64_t nwh = ig.num_warehouses();
+    fill_items(1 + NUM_ITEMS * (worker_id - 1) / nwh, 1 + NUM_ITEMS * worker_id / nwh);
+    fill_warehouse((uint64_t) worker_id);
 
     // barrier
     r = pthread_barrier_wait(&sync_barrier);
@@ -674,30 +988,201 @@ void tpcc_prepopulator<DBParams>::random_shuffle(std::vector<uint64_t> &v) {
 template <typename DBParams>
 class tpcc_access {
 public:
-    static void prepopulation_worker(tpcc_db<DBParams> &db, int worker_id) {
+    static uint64_t prepopulation_worker(tpcc_db<DBParams> &db, int worker_id) {
         tpcc_prepopulator<DBParams> pop(worker_id, db);
         db.thread_init_all();
         pop.run();
+        return pop.rows();
+    }
+
+    // The runner whose warehouse range run_benchmark gives w_id
+    static int runner_of_warehouse(int w_id, int num_warehouses, int num_runners) {
+        int q = num_warehouses / num_runners;
+        int r = num_warehouses % num_runners;
+        if (q == 0)
+            return w_id - 1;
+        int i = w_id - 1;
+        return (i < r * (q + 1)) ? i / (q + 1) : r + (i - r * (q + 1)) / q;
+    }
+
+    // The first home warehouse run_benchmark gives runner i
+    static int home_warehouse_of_runner(int i, int num_warehouses, int num_runners) {
+        int q = num_warehouses / num_runners;
+        int r = num_warehouses % num_runners;
+        if (q == 0)
+            return i / ((num_runners + num_warehouses - 1) / num_warehouses) + 1;
+        return (i < r) ? i * (q + 1) + 1 : r * (q + 1) + (i - r) * q + 1;
+    }
+
+    // Splits the warehouses into one contiguous block per NUMA node
+    static std::vector<int> warehouse_nodes(int num_warehouses) {
+        std::vector<int> nodes = topology_nodes_in_use(), wh_nodes;
+        for (int i = 0; i < num_warehouses; ++i)
+            wh_nodes.push_back(nodes[size_t(i) * nodes.size() / num_warehouses]);
+        return wh_nodes;
     }
 
-    static void prepopulate_db(tpcc_db<DBParams> &db) {
+    // With warehouse nodes, pins each of num_runners runners to the node
+    // of its first home warehouse
+    static void pin_runners_to_warehouses(tpcc_db<DBParams>& db, int num_runners) {
+        if (db.node_of_warehouse(1) < 0)
+            return;
+        std::vector<int> nodes;
+        for (int i = 0; i < num_runners; ++i)
+            nodes.push_back(db.node_of_warehouse(home_warehouse_of_runner(i, db.num_warehouses(), num_runners)));
+        set_runner_nodes(nodes);
+    }
+
+    // One loader per warehouse, on the CPU of the runner that owns it, or
+    // with warehouse nodes on a CPU of the warehouse's node
+    static void prepopulate_db(tpcc_db<DBParams> &db, int num_runners) {
         int r;
-        r = pthread_barrier_init(&tpcc_prepopulator<DBParams>::sync_barrier, nullptr, db.num_warehouses());
+        int nwh = db.num_warehouses();
+        r = pthread_barrier_init(&tpcc_prepopulator<DBParams>::sync_barrier, nullptr, nwh);
         always_assert(r == 0, "pthread_barrier_init failed");
 
-        std::vector<std::thread> prepop_thrs;
-        for (int i = 1; i <= db.num_warehouses(); ++i)
-            prepop_thrs.emplace_back(prepopulation_worker, std::ref(db), i);
-        for (auto &t : prepop_thrs)
-            t.join();
+        bool by_node = db.node_of_warehouse(1) >= 0;
+        if (by_node) {
+            std::vector<int> nodes;
+            for (int w = 1; w <= nwh; ++w)
+                nodes.push_back(db.node_of_warehouse(w));
+            set_runner_nodes(nodes);
+        }
+        bench::db_loader loader("tpcc", nwh, nwh, [=](int part) {
+                return by_node ? part : runner_of_warehouse(part + 1, nwh, num_runners);
+            });
+        loader.run([&](int part) {
+                return prepopulation_worker(db, part + 1);
+            });
 
         r = pthread_barrier_destroy(&tpcc_prepopulator<DBParams>::sync_barrier);
         always_assert(r == 0, "pthread_barrier_destroy failed");
+        if (by_node)
+            set_runner_nodes({});
+    }
+
+    // Every table, for freezing and thawing the loaded database
+    static std::string image_tag(tpcc_db<DBParams>& db) {
+        std::stringstream tag;
+        tag << "tpcc " << DBParams::Id << " warehouses " << db.num_warehouses()
+            << " hash " << TPCC_HASH_INDEX << " packed " << TPCC_PACKED_KEYS
+            << " fine " << TABLE_FINE_GRAINED << " seqhist " << HISTORY_SEQ_INSERT
+            << " loview " << TPCC_LATEST_ORDER_VIEW;
+        return tag.str();
+    }
+    static void add_image_tables(tpcc_db<DBParams>& db, bench::db_image& image) {
+        image.add_table("item", db.tbl_items());
+        image.add_table("warehouse", db.tbl_warehouses());
+        for (int w = 1; w <= db.num_warehouses(); ++w) {
+            std::string sfx = "." + std::to_string(w);
+            image.add_table("district" + sfx, db.tbl_districts(w));
+            image.add_table("customer" + sfx, db.tbl_customers(w));
+            image.add_table("order" + sfx, db.tbl_orders(w));
+            image.add_table("orderline" + sfx, db.tbl_orderlines(w));
+            image.add_table("stock" + sfx, db.tbl_stocks(w));
+            image.add_table("customer_idx" + sfx, db.tbl_customer_index(w));
+            image.add_table("order_cidx" + sfx, db.tbl_order_customer_index(w));
+            image.add_table("neworder" + sfx, db.tbl_neworders(w));
+            image.add_table("history" + sfx, db.tbl_histories(w));
+            if (TPCC_LATEST_ORDER_VIEW)
+                image.add_table("latest_order" + sfx, db.tbl_latest_orders(w));
+        }
+    }
+
+    // Has every table that can log its writes do so (TxnLog), each under
+    // its own id. OCC indexes of trivially copyable rows can; MVCC
+    // indexes and the customer name index log nothing.
+    template <typename Index, typename = void>
+    struct loggable : std::false_type {};
+    template <typename Index>
+    struct loggable<Index, std::void_t<decltype(std::declval<Index&>().set_log_id(0u))>>
+        : std::integral_constant<bool, std::is_trivially_copyable<typename Index::key_type>::value
+                                       && std::is_trivially_copyable<typename Index::value_type>::value> {};
+    template <typename Index>
+    static void log_table(Index& index, uint32_t id) {
+        if constexpr (loggable<Index>::value)
+            index.set_log_id(id);
+    }
+    static void log_tables(tpcc_db<DBParams>& db) {
+        uint32_t id = 0;
+        log_table(db.tbl_items(), ++id);
+        log_table(db.tbl_warehouses(), ++id);
+        for (int w = 1; w <= db.num_warehouses(); ++w) {
+            log_table(db.tbl_districts(w), ++id);
+            log_table(db.tbl_customers(w), ++id);
+            log_table(db.tbl_orders(w), ++id);
+            log_table(db.tbl_orderlines(w), ++id);
+            log_table(db.tbl_stocks(w), ++id);
+            log_table(db.tbl_order_customer_index(w), ++id);
+            log_table(db.tbl_neworders(w), ++id);
+            log_table(db.tbl_histories(w), ++id);
+        }
+        // after the others, so their ids don't depend on the view
+        if (TPCC_LATEST_ORDER_VIEW)
+            for (int w = 1; w <= db.num_warehouses(); ++w)
+                log_table(db.tbl_latest_orders(w), ++id);
+    }
+
+    // The item table is never written after loading, so item reads
+    // need no tracking. MVCC indexes have no immutable mode.
+    template <typename Index, typename = void>
+    struct immutable_capable : std::false_type {};
+    template <typename Index>
+    struct immutable_capable<Index, std::void_t<decltype(std::declval<Index&>().set_immutable(true))>>
+        : std::true_type {};
+    typedef typename tpcc_db<DBParams>::it_table_type it_table_type;
+    static void mark_immutable_tables(tpcc_db<DBParams>& db) {
+        if constexpr (immutable_capable<it_table_type>::value) {
+            db.tbl_items().set_immutable(true);
+            for (auto t : db.item_replicas())
+                if (t)
+                    t->set_immutable(true);
+        }
+    }
+    // With warehouse nodes, gives each node its own copy of the item
+    // table. Only immutable tables can be replicated; false otherwise.
+    static bool replicate_item_table(tpcc_db<DBParams>& db) {
+        if constexpr (immutable_capable<it_table_type>::value) {
+            if (db.node_of_warehouse(1) < 0)
+                return false;
+            db.replicate_items();
+            return true;
+        } else
+            return false;
+    }
+
+    // Loads the database from the image in dir if there is one, else
+    // prepopulates it and freezes it there. False if an image exists
+    // but can't be thawed, which leaves the tables partly loaded.
+    static bool load_db_image(tpcc_db<DBParams>& db, const std::string& dir, int num_runners) {
+        bench::db_image image(dir, image_tag(db), num_runners);
+        add_image_tables(db, image);
+        if (!image.exists()) {
+            prepopulate_db(db, num_runners);
+            if (image.freeze())
+                std::cout << "Froze " << image.frozen_rows() << " rows into " << dir << " in "
+                          << std::fixed << std::setprecision(2) << image.freeze_seconds() << " s" << std::endl;
+            else
+                std::cout << "Warning: can't freeze the database into " << dir << std::endl;
+            return true;
+        }
+        db.thread_init_all();
+        if (!image.thaw())
+            return false;
+        // what prepopulation sets up besides the tables
+        for (int w = 1; w <= db.num_warehouses(); ++w) {
+            db.oid_generator().init_warehouse(w);
+            db.tbl_histories(w).skip_keys(NUM_DISTRICTS_PER_WAREHOUSE * NUM_CUSTOMERS_PER_DISTRICT);
+        }
+        std::cout << "Thawed " << image.thawed_rows() << " rows from " << dir << " in "
+                  << std::fixed << std::setprecision(2) << image.thaw_seconds() << " s" << std::endl;
+        return true;
     }
 
     static void tpcc_runner_thread(tpcc_db<DBParams>& db, db_profiler& prof, int runner_id, uint64_t w_start,
-                                   uint64_t w_end, uint64_t w_own, double time_limit, int mix, uint64_t& txn_cnt) {
-        tpcc_runner<DBParams> runner(runner_id, db, w_start, w_end, w_own, mix);
+                                   uint64_t w_end, uint64_t w_own, double time_limit, int mix, int cross_pct,
+                                   bench::arrival_params load, uint64_t& txn_cnt) {
+        tpcc_runner<DBParams> runner(runner_id, db, w_start, w_end, w_own, mix, cross_pct);
         typedef typename tpcc_runner<DBParams>::txn_type txn_type;
 
         uint64_t local_cnt = 0;
@@ -711,6 +1196,8 @@ public:
 
         uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
         auto start_t = prof.start_timestamp();
+        bench::arrival_schedule arrivals(load, constants::processor_tsc_frequency * constants::billion,
+                                         start_t, constants::workload_seed + runner_id);
 
         while (true) {
             // Executed enqueued delivery transactions, if any
@@ -722,7 +1209,12 @@ public:
 
                 if (num_to_run > 0) {
                     for (num_run = 0; num_run < num_to_run; ++num_run) {
-                        runner.run_txn_delivery(own_w_id, last_delivered);
+                        bench::latency_profile::timer lt;
+                        {
+                            tpcc_type_scope scope(pmu_tpcc::delivery, abort_tpcc::delivery);
+                            runner.run_txn_delivery(own_w_id, last_delivered);
+                        }
+                        lt.record(static_cast<int>(txn_type::delivery) - 1);
                         if ((read_tsc() - start_t) >= tsc_diff) {
                             stop = true;
                             ++num_run;
@@ -737,21 +1229,26 @@ public:
                 }
             }
 
-            auto curr_t = read_tsc();
-            if ((curr_t - start_t) >= tsc_diff)
+            if (!arrivals.wait(start_t + tsc_diff))
                 break;
 
             txn_type t = runner.next_transaction();
             switch (t) {
-                case txn_type::new_order:
+                case txn_type::new_order: {
+                    tpcc_type_scope scope(pmu_tpcc::new_order, abort_tpcc::new_order);
                     runner.run_txn_neworder();
                     break;
-                case txn_type::payment:
+                }
+                case txn_type::payment: {
+                    tpcc_type_scope scope(pmu_tpcc::payment, abort_tpcc::payment);
                     runner.run_txn_payment();
                     break;
-                case txn_type::order_status:
+                }
+                case txn_type::order_status: {
+                    tpcc_type_scope scope(pmu_tpcc::order_status, abort_tpcc::order_status);
                     runner.run_txn_orderstatus();
                     break;
+                }
                 case txn_type::delivery: {
                     uint64_t q_w_id = runner.ig.random(w_start, w_end);
                     // All warehouse delivery transactions are delegated to
@@ -759,36 +1256,212 @@ public:
                     // TPC-C spec with regard to deferred execution.
                     // Do not count enqueued transactions as executed.
                     db.delivery_queue().enqueue(q_w_id);
-                    --local_cnt;
-                    break;
+                    continue;
                 }
-                case txn_type::stock_level:
+                case txn_type::stock_level: {
+                    tpcc_type_scope scope(pmu_tpcc::stock_level, abort_tpcc::stock_level);
                     runner.run_txn_stocklevel();
                     break;
+                }
                 default:
                     fprintf(stderr, "r:%d unknown txn type\n", runner_id);
                     assert(false);
                     break;
             };
 
+            arrivals.record(static_cast<int>(t) - 1);
             ++local_cnt;
         }
 
         txn_cnt = local_cnt;
     }
 
+    // Deterministic mode (db_det_params). A transaction's inputs are drawn
+    // when its batch is generated, and it locks, by warehouse and district:
+    // the warehouse and district YTDs (payment), a district's customers
+    // (payment and delivery write, order-status reads), its orders, new
+    // orders and order lines (new-order and delivery write, order-status
+    // and stock-level read) and each stock row new-order updates. Tax
+    // rates, items and customer names are never written and need no lock;
+    // stock-level's stock reads go unlocked, as its isolation allows. The
+    // bodies are the transactions above, run without read validation.
+    struct det_txn {
+        typename tpcc_runner<DBParams>::txn_type type;
+        typename tpcc_runner<DBParams>::neworder_input no;
+        typename tpcc_runner<DBParams>::payment_input pm;
+        typename tpcc_runner<DBParams>::orderstatus_input os;
+        typename tpcc_runner<DBParams>::delivery_input dl;
+        typename tpcc_runner<DBParams>::stocklevel_input sl;
+    };
+    enum class det_class : uint64_t {
+        w_ytd = 1, d_ytd, customers, orders, stock
+    };
+    static uint64_t det_key(det_class c, uint64_t w_id, uint64_t d_id = 0, uint64_t i_id = 0) {
+        return (uint64_t(c) << 56) | (w_id << 36) | (d_id << 28) | i_id;
+    }
+
+    static void det_declare(tpcc_runner<DBParams>& runner, det_txn& txn, bench::det_lockset& locks) {
+        typedef typename tpcc_runner<DBParams>::txn_type txn_type;
+        txn.type = runner.next_transaction();
+        switch (txn.type) {
+            case txn_type::new_order: {
+                auto& in = txn.no = runner.gen_neworder();
+                locks.write(det_key(det_class::orders, in.q_w_id, in.q_d_id));
+                for (uint64_t i = 0; i < in.num_items; ++i)
+                    locks.write(det_key(det_class::stock, in.ol_supply_w_ids[i], 0, in.ol_i_ids[i]));
+                break;
+            }
+            case txn_type::payment: {
+                auto& in = txn.pm = runner.gen_payment();
+                locks.write(det_key(det_class::w_ytd, in.q_w_id));
+                locks.write(det_key(det_class::d_ytd, in.q_w_id, in.q_d_id));
+                locks.write(det_key(det_class::customers, in.q_c_w_id, in.q_c_d_id));
+                break;
+            }
+            case txn_type::order_status: {
+                auto& in = txn.os = runner.gen_orderstatus();
+                locks.read(det_key(det_class::customers, in.q_w_id, in.q_d_id));
+                locks.read(det_key(det_class::orders, in.q_w_id, in.q_d_id));
+                break;
+            }
+            case txn_type::delivery: {
+                // runs in its batch rather than through the delivery queue
+                auto& in = txn.dl = runner.gen_delivery(runner.ig.random(runner.w_id_start, runner.w_id_end));
+                for (uint64_t d_id = 1; d_id <= NUM_DISTRICTS_PER_WAREHOUSE; ++d_id) {
+                    locks.write(det_key(det_class::orders, in.q_w_id, d_id));
+                    locks.write(det_key(det_class::customers, in.q_w_id, d_id));
+                }
+                break;
+            }
+            case txn_type::stock_level: {
+                auto& in = txn.sl = runner.gen_stocklevel();
+                locks.read(det_key(det_class::orders, in.q_w_id, in.q_d_id));
+                break;
+            }
+        }
+    }
+
+    // last_delivered holds each warehouse's last delivered order ids, used
+    // under its districts' order locks
+    static void tpcc_det_runner_thread(tpcc_db<DBParams>& db, db_profiler& prof, bench::det_engine<det_txn>& engine,
+                                       int runner_id, uint64_t w_start, uint64_t w_end, double time_limit, int mix,
+                                       int cross_pct,
+                                       std::vector<std::array<uint64_t, NUM_DISTRICTS_PER_WAREHOUSE>>& last_delivered,
+                                       uint64_t& txn_cnt) {
+        tpcc_runner<DBParams> runner(runner_id, db, w_start, w_end, 0, mix, cross_pct);
+        typedef typename tpcc_runner<DBParams>::txn_type txn_type;
+
+        ::TThread::set_id(runner_id);
+        set_affinity(runner_id);
+        db.thread_init_all();
+
+        uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
+        auto start_t = prof.start_timestamp();
+
+        txn_cnt = engine.run(runner_id,
+            [&] (det_txn& txn, bench::det_lockset& locks) {
+                det_declare(runner, txn, locks);
+            },
+            [&] (det_txn& txn) {
+                switch (txn.type) {
+                    case txn_type::new_order: {
+                        tpcc_type_scope scope(pmu_tpcc::new_order, abort_tpcc::new_order);
+                        runner.run_txn_neworder(txn.no);
+                        break;
+                    }
+                    case txn_type::payment: {
+                        tpcc_type_scope scope(pmu_tpcc::payment, abort_tpcc::payment);
+                        runner.run_txn_payment(txn.pm);
+                        break;
+                    }
+                    case txn_type::order_status: {
+                        tpcc_type_scope scope(pmu_tpcc::order_status, abort_tpcc::order_status);
+                        runner.run_txn_orderstatus(txn.os);
+                        break;
+                    }
+                    case txn_type::delivery: {
+                        tpcc_type_scope scope(pmu_tpcc::delivery, abort_tpcc::delivery);
+                        runner.run_txn_delivery(txn.dl, last_delivered[txn.dl.q_w_id]);
+                        break;
+                    }
+                    case txn_type::stock_level: {
+                        tpcc_type_scope scope(pmu_tpcc::stock_level, abort_tpcc::stock_level);
+                        runner.run_txn_stocklevel(txn.sl);
+                        break;
+                    }
+                }
+            },
+            [&] { return read_tsc() - start_t >= tsc_diff; });
+    }
+
+    // A CH-benCHmark analytic thread: runs Q1 and Q6 in turn, each on a
+    // newly pinned snapshot, for time_limit seconds
+    static void analytic_thread(tpcc_db<DBParams>& db, int thread_id, double time_limit,
+                                uint64_t& query_cnt, uint64_t& row_cnt) {
+        typedef tpcc_analytics<DBParams> analytics_type;
+        ::TThread::set_id(thread_id);
+        db.thread_init_all();
+        analytics_type queries(db);
+        uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
+        auto start_t = read_tsc();
+        uint64_t n = 0;
+        while (read_tsc() - start_t < tsc_diff) {
+            SnapshotPin pin;
+            if (n % 2 == 0)
+                (void) queries.run_q1(pin.tid(), analytics_type::first_date);
+            else
+                (void) queries.run_q6(pin.tid(), analytics_type::first_date, analytics_type::last_date);
+            ++n;
+        }
+        query_cnt = n;
+        row_cnt = queries.rows();
+    }
+
     static uint64_t run_benchmark(tpcc_db<DBParams>& db, db_profiler& prof, int num_runners,
-                                  double time_limit, int mix, const bool verbose) {
+                                  double time_limit, int mix, int cross_pct, bool partitioned,
+                                  bool random_home, bench::arrival_params load, const bool verbose) {
         int q = db.num_warehouses() / num_runners;
         int r = db.num_warehouses() % num_runners;
 
         std::vector<std::thread> runner_thrs;
         std::vector<uint64_t> txn_cnts(size_t(num_runners), 0);
+        bench::latency_profile::name_types({"new_order", "payment", "order_status", "delivery", "stock_level"});
 
         int nwh = db.num_warehouses();
         auto calc_own_w_id = [nwh](int rid) {
             return (rid >= nwh) ? 0 : (rid + 1);
         };
+        // With random homes every runner draws each transaction's home
+        // warehouse from all of them; it still owns, and delivers for, its
+        // own warehouse
+        auto home_start = [&](int w) {
+            return random_home ? 1 : w;
+        };
+        auto home_end = [&](int w) {
+            return random_home ? nwh : w;
+        };
+
+        pin_runners_to_warehouses(db, num_runners);
+
+        std::unique_ptr<bench::det_engine<det_txn>> engine;
+        std::vector<std::array<uint64_t, NUM_DISTRICTS_PER_WAREHOUSE>> last_delivered;
+        if (DBParams::Deterministic) {
+            engine.reset(new bench::det_engine<det_txn>(num_runners));
+            last_delivered.resize(nwh + 1);
+        }
+        auto start_runner = [&](int i, int w_start, int w_end) {
+            if constexpr (DBParams::Deterministic)
+                runner_thrs.emplace_back(tpcc_det_runner_thread, std::ref(db), std::ref(prof), std::ref(*engine),
+                                         i, w_start, w_end, time_limit, mix, cross_pct,
+                                         std::ref(last_delivered), std::ref(txn_cnts[i]));
+            else
+                runner_thrs.emplace_back(tpcc_runner_thread, std::ref(db), std::ref(prof),
+                                         i, w_start, w_end, calc_own_w_id(i), time_limit, mix,
+                                         cross_pct, load, std::ref(txn_cnts[i]));
+        };
+
+        // replaces the partitions of an earlier run in the same process
+        db.set_partitions(partitioned ? new bench::partition_map(db.num_warehouses(), num_runners) : nullptr);
 
         if (q == 0) {
             q = (num_runners + db.num_warehouses() - 1) / db.num_warehouses();
@@ -800,10 +1473,10 @@ public:
                     qq += q;
                 }
                 if (verbose) {
-                    fprintf(stdout, "runner %d: [%d, %d], own: %d\n", i, wid, wid, calc_own_w_id(i));
+                    fprintf(stdout, "runner %d: [%d, %d], own: %d\n", i, home_start(wid), home_end(wid),
+                            calc_own_w_id(i));
                 }
-                runner_thrs.emplace_back(tpcc_runner_thread, std::ref(db), std::ref(prof),
-                                         i, wid, wid, calc_own_w_id(i), time_limit, mix, std::ref(txn_cnts[i]));
+                start_runner(i, home_start(wid), home_end(wid));
             }
         } else {
             int last_xend = 1;
@@ -815,11 +1488,12 @@ public:
                     --r;
                 }
                 if (verbose) {
-                    fprintf(stdout, "runner %d: [%d, %d], own: %d\n", i, last_xend, next_xend - 1, calc_own_w_id(i));
+                    fprintf(stdout, "runner %d: [%d, %d], own: %d\n", i, home_start(last_xend),
+                            home_end(next_xend - 1), calc_own_w_id(i));
                 }
-                runner_thrs.emplace_back(tpcc_runner_thread, std::ref(db), std::ref(prof),
-                                         i, last_xend, next_xend - 1, calc_own_w_id(i), time_limit, mix,
-                                         std::ref(txn_cnts[i]));
+                if (partitioned)
+                    db.partitions()->assign(last_xend, next_xend - 1, i);
+                start_runner(i, home_start(last_xend), home_end(next_xend - 1));
                 last_xend = next_xend;
             }
 
@@ -835,6 +1509,20 @@ public:
         return total_txn_cnt;
     }
 
+    // Parses a comma-separated list of integers in [lo, hi]
+    static bool parse_sweep(const char* s, int lo, int hi, std::vector<int>& out) {
+        out.clear();
+        while (s && *s) {
+            char* end;
+            long v = strtol(s, &end, 10);
+            if (end == s || v < lo || v > hi || (*end && *end != ','))
+                return false;
+            out.push_back(int(v));
+            s = *end ? end + 1 : end;
+        }
+        return !out.empty();
+    }
+
     static int execute(int argc, const char *const *argv) {
         std::cout << "*** DBParams::Id = " << DBParams::Id << std::endl;
         std::cout << "*** DBParams::Commute = " << std::boolalpha << DBParams::Commute << std::endl;
@@ -848,7 +1536,21 @@ public:
         double time_limit = 10.0;
         bool enable_gc = false;
         unsigned gc_rate = Transaction::get_epoch_cycle();
+        bool gc_adaptive = false;
         bool verbose = false;
+        int flatten_threads = 0;
+        int analytic_threads = 0;
+        const char* snapshot_path = nullptr;
+        const char* trace_path = nullptr;
+        const char* log_dir = nullptr;
+        const char* image_dir = nullptr;
+        bool partitioned = false;
+        int cross_pct = -1;
+        bool random_home = false;
+        bool numa_warehouses = false;
+        bool replicate_items = false;
+        bench::arrival_params load;
+        std::vector<int> sweep_threads, sweep_mixes;
 
         Clp_Parser *clp = Clp_NewParser(argc, argv, noptions, options);
 
@@ -879,6 +1581,9 @@ public:
                 case opt_gr:
                     gc_rate = clp->val.i;
                     break;
+                case opt_gca:
+                    gc_adaptive = !clp->negated;
+                    break;
                 case opt_node:
                     break;
                 case opt_comm:
@@ -892,6 +1597,106 @@ public:
                         mix = 0;
                     }
                     break;
+                case opt_rofp:
+                    Transaction::set_readonly_fast_path(!clp->negated);
+                    break;
+                case opt_txp:
+                    Transaction::set_profile_counters(!clp->negated);
+                    break;
+                case opt_conf:
+                    ConflictProfile::enable(clp->have_val ? clp->val.u : 0);
+                    break;
+                case opt_pmu:
+                    if (!PmuProfile::enable())
+                        std::cerr << "Warning: can't open hardware performance counters, --pmu ignored." << std::endl;
+                    break;
+                case opt_phase:
+                    PhaseProfile::set_sample_period(clp->have_val ? clp->val.u : 100);
+                    break;
+                case opt_abcost:
+                    AbortProfile::enable();
+                    break;
+                case opt_seed:
+                    constants::workload_seed = clp->val.u;
+                    break;
+                case opt_trace:
+                    trace_path = clp->val.s;
+                    TxnTrace::enable();
+                    TxnTrace::dump_on_signal(SIGUSR2, trace_path);
+                    break;
+                case opt_log:
+                    log_dir = clp->val.s;
+                    break;
+                case opt_image:
+                    image_dir = clp->val.s;
+                    break;
+                case opt_slock:
+                    Transaction::set_sorted_locking_default(!clp->negated);
+                    break;
+                case opt_flat:
+                    flatten_threads = clp->val.i;
+                    break;
+                case opt_snap:
+                    snapshot_path = clp->val.s;
+                    break;
+                case opt_olap:
+                    analytic_threads = std::max(clp->val.i, 0);
+                    break;
+                case opt_defer:
+                    tpcc_runner<DBParams>::defer_hot_rows = !clp->negated;
+                    break;
+                case opt_cmap:
+                    bench::key_conflict_map::enable(clp->have_val ? clp->val.u : 2);
+                    break;
+                case opt_repair:
+                    Transaction::set_repair_limit(clp->val.u);
+                    break;
+                case opt_cm:
+                    break;
+                case opt_place:
+                    break;
+                case opt_hk:
+                    break;
+                case opt_alloc:
+                    break;
+                case opt_part:
+                    partitioned = !clp->negated;
+                    break;
+                case opt_xpct:
+                    cross_pct = std::min(clp->val.i, 100);
+                    break;
+                case opt_rhome:
+                    random_home = !clp->negated;
+                    break;
+                case opt_numa:
+                    numa_warehouses = !clp->negated;
+                    break;
+                case opt_ritems:
+                    replicate_items = !clp->negated;
+                    break;
+                case opt_oext:
+                    Transaction::set_opacity_extension_limit(clp->val.u);
+                    break;
+                case opt_rate:
+                    load.rate = std::max(clp->val.d, 0.0);
+                    break;
+                case opt_pois:
+                    load.poisson = !clp->negated;
+                    break;
+                case opt_swthr:
+                    if (!parse_sweep(clp->val.s, 1, MAX_THREADS, sweep_threads)) {
+                        std::cout << "Bad thread count list: " << clp->val.s << std::endl;
+                        ret = 1;
+                        clp_stop = true;
+                    }
+                    break;
+                case opt_swmix:
+                    if (!parse_sweep(clp->val.s, 0, 2, sweep_mixes)) {
+                        std::cout << "Bad workload mix list: " << clp->val.s << std::endl;
+                        ret = 1;
+                        clp_stop = true;
+                    }
+                    break;
                 default:
                     ::print_usage(argv[0]);
                     ret = 1;
@@ -903,8 +1708,41 @@ public:
         Clp_DeleteParser(clp);
         if (ret != 0)
             return ret;
+        if (log_dir) {
+            if (!TxnLog::start(log_dir)) {
+                std::cout << "Can't create logs in " << log_dir << std::endl;
+                return 1;
+            }
+            TxnLog::stop();
+        }
 
-        std::cout << "Selected workload mix: " << std::string(workload_mix_names[mix]) << std::endl;
+        if (sweep_threads.empty())
+            sweep_threads.push_back(num_threads);
+        if (sweep_mixes.empty())
+            sweep_mixes.push_back(mix);
+        // the largest run sizes the loader, flatteners and thread ids
+        num_threads = *std::max_element(sweep_threads.begin(), sweep_threads.end());
+        bool sweep = sweep_threads.size() > 1 || sweep_mixes.size() > 1;
+        if (sweep)
+            std::cout << "Sweep: " << sweep_threads.size() << " thread counts x "
+                      << sweep_mixes.size() << " mixes, " << time_limit << " s each" << std::endl;
+        else
+            std::cout << "Selected workload mix: " << std::string(workload_mix_names[sweep_mixes[0]]) << std::endl;
+        if (DBParams::Deterministic && (partitioned || load.rate > 0)) {
+            std::cout << "Warning: --partitioned and --arrival-rate are ignored in deterministic mode" << std::endl;
+            partitioned = false;
+            load.rate = 0;
+        }
+        if (partitioned && num_threads > num_warehouses)
+            std::cout << "Warning: --partitioned needs a warehouse per thread, ignored when threads outnumber warehouses"
+                      << std::endl;
+        else if (partitioned && !sweep)
+            std::cout << "Partitioned execution: " << num_threads << " partitions" << std::endl;
+        if (random_home)
+            std::cout << "Home warehouses: random per transaction" << std::endl;
+        if (load.rate > 0)
+            std::cout << "Open loop: " << load.rate << " txns/sec per thread, "
+                      << (load.poisson ? "Poisson" : "constant") << " arrivals" << std::endl;
 
         auto profiler_mode = counter_mode ?
                              Profiler::perf_mode::counters : Profiler::perf_mode::record;
@@ -919,27 +1757,164 @@ public:
                       << (counter_mode ? "counter" : "record") << " mode" << std::endl;
         }
 
+        std::vector<int> wh_nodes;
+        if (numa_warehouses) {
+            wh_nodes = warehouse_nodes(num_warehouses);
+            std::cout << "Warehouse NUMA affinity:";
+            for (int w = 1; w <= num_warehouses; ++w)
+                if (w == 1 || wh_nodes[w - 1] != wh_nodes[w - 2])
+                    std::cout << (w == 1 ? " " : "; ") << "node " << wh_nodes[w - 1] << " from warehouse " << w;
+            std::cout << std::endl;
+        }
+
         db_profiler prof(spawn_perf);
-        tpcc_db<DBParams> db(num_warehouses);
+        tpcc_db<DBParams> db(num_warehouses, wh_nodes);
 
         std::cout << "Prepopulating database..." << std::endl;
-        prepopulate_db(db);
+        if (image_dir) {
+            if (!load_db_image(db, image_dir, num_threads)) {
+                std::cout << "Can't thaw the database image in " << image_dir << std::endl;
+                return 1;
+            }
+        } else
+            prepopulate_db(db, num_threads);
         std::cout << "Prepopulation complete." << std::endl;
+        if (replicate_items) {
+            if (replicate_item_table(db))
+                std::cout << "Item table replicated on each warehouse node." << std::endl;
+            else
+                std::cout << "Item table not replicated: needs --numa-warehouses and an OCC index." << std::endl;
+        }
+        mark_immutable_tables(db);
+        if (HugeArena::enabled())
+            std::cout << "Hugepage arena: " << (HugeArena::mapped_bytes() >> 20) << " MB mapped, "
+                      << (HugeArena::hugetlb_bytes() >> 20) << " MB on hugetlb pages" << std::endl;
+
+        if (log_dir)
+            log_tables(db);
+        if (log_dir && !enable_gc) {
+            std::cout << "Info: logging needs the epoch advancer, enabling garbage collection" << std::endl;
+            enable_gc = true;
+        }
 
         std::thread advancer;
         std::cout << "Garbage collection: ";
         if (enable_gc) {
             std::cout << "enabled, running every " << gc_rate / 1000.0 << " ms";
             Transaction::set_epoch_cycle(gc_rate);
+            if (gc_adaptive) {
+                std::cout << " (adaptive)";
+                Transaction::set_adaptive_epoch_cycle(std::max(gc_rate / 10, 1u), gc_rate * 10);
+            }
             advancer = std::thread(&Transaction::epoch_advancer, nullptr);
         } else {
             std::cout << "disabled";
         }
         std::cout << std::endl << std::flush;
 
-        prof.start(profiler_mode);
-        auto num_trans = run_benchmark(db, prof, num_threads, time_limit, mix, verbose);
-        prof.finish(num_trans);
+        if (flatten_threads > 0) {
+#if MVCC_BG_FLATTEN
+            std::cout << "Background flattening: " << flatten_threads << " threads" << std::endl;
+            MvFlattener::start(flatten_threads, num_threads, num_threads);
+#else
+            std::cout << "Warning: --flatten-threads needs BG_FLATTEN=1, ignored" << std::endl;
+            flatten_threads = 0;
+#endif
+        }
+
+        std::unique_ptr<bench::mvcc_snapshot_dumper<cu_table_type>> cu_dump;
+        std::unique_ptr<bench::mvcc_snapshot_dumper<st_table_type>> st_dump;
+        std::unique_ptr<SnapshotPin> dump_pin;  // one snapshot for both tables
+        int dump_threads = 0;
+        if (snapshot_path) {
+            if constexpr (DBParams::MVCC) {
+                int tid = num_threads + flatten_threads;
+                cu_dump.reset(new bench::mvcc_snapshot_dumper<cu_table_type>(
+                        db.tbl_customers(1), std::string(snapshot_path) + ".customer", tid));
+                st_dump.reset(new bench::mvcc_snapshot_dumper<st_table_type>(
+                        db.tbl_stocks(1), std::string(snapshot_path) + ".stock", tid + 1));
+                dump_threads = 2;
+            } else {
+                std::cout << "Warning: --snapshot-dump needs an MVCC dbid, ignored" << std::endl;
+            }
+        }
+
+        if (analytic_threads && !DBParams::MVCC) {
+            std::cout << "Warning: --analytic-threads needs an MVCC dbid, ignored" << std::endl;
+            analytic_threads = 0;
+        }
+        int analytic_base = num_threads + flatten_threads + dump_threads;
+        always_assert(analytic_base + analytic_threads <= MAX_THREADS, "too many threads");
+        if (analytic_threads)
+            std::cout << "CH-benCHmark: " << analytic_threads << " analytic threads" << std::endl;
+
+        // Every run of a sweep reuses the tables as the runs before it left
+        // them; only the first one takes the snapshot dump
+        bool first_run = true;
+        for (int nthreads : sweep_threads)
+            for (int run_mix : sweep_mixes) {
+                bool run_partitioned = partitioned && nthreads <= num_warehouses;
+                if (sweep) {
+                    std::cout << "=== " << nthreads << " threads, mix " << workload_mix_names[run_mix]
+                              << (run_partitioned ? ", partitioned" : "") << std::endl;
+                    Transaction::clear_stats();
+                }
+                prof.describe<DBParams>("tpcc", nthreads);
+                prof.config("warehouses", num_warehouses);
+                prof.config("mix", workload_mix_names[run_mix]);
+                prof.config("time_limit", time_limit);
+                prof.config("gc", enable_gc);
+                prof.config("partitioned", run_partitioned);
+                prof.config("numa_warehouses", numa_warehouses);
+                prof.config("replicate_items", replicate_items);
+                prof.config("arrival_rate", load.rate);
+                prof.config("logging", log_dir != nullptr);
+                prof.config("analytic_threads", analytic_threads);
+                // a logger per four workers
+                if (log_dir)
+                    always_assert(TxnLog::start(log_dir, (nthreads + 3) / 4));
+                prof.start(profiler_mode);
+                if (dump_threads && first_run) {
+                    dump_pin.reset(new SnapshotPin);
+                    cu_dump->start(dump_pin->tid());
+                    st_dump->start(dump_pin->tid());
+                }
+                std::vector<std::thread> analytic_thrs;
+                std::vector<uint64_t> query_cnts(analytic_threads, 0), row_cnts(analytic_threads, 0);
+                if constexpr (DBParams::MVCC)
+                    for (int i = 0; i < analytic_threads; ++i)
+                        analytic_thrs.emplace_back(analytic_thread, std::ref(db), analytic_base + i, time_limit,
+                                                   std::ref(query_cnts[i]), std::ref(row_cnts[i]));
+                auto num_trans = run_benchmark(db, prof, nthreads, time_limit, run_mix, cross_pct,
+                                               run_partitioned, random_home, load, verbose);
+                for (auto& t : analytic_thrs)
+                    t.join();
+                if (analytic_threads) {
+                    uint64_t queries = 0, rows = 0;
+                    for (int i = 0; i < analytic_threads; ++i) {
+                        queries += query_cnts[i];
+                        rows += row_cnts[i];
+                    }
+                    std::cout << "Analytic queries: " << queries << " (" << queries / time_limit
+                              << " queries/sec), " << rows << " order lines scanned" << std::endl;
+                }
+                // acknowledges the commits still waiting for durability
+                if (log_dir)
+                    TxnLog::stop();
+                prof.finish(num_trans);
+                first_run = false;
+            }
+
+        if (dump_threads) {
+            // join both before reading either's results
+            bool cu_ok = cu_dump->join();
+            bool st_ok = st_dump->join();
+            bool ok = cu_ok && st_ok;
+            dump_pin.reset();
+            std::cout << "Snapshot dump " << (ok ? "written" : "FAILED") << ": "
+                      << cu_dump->rows() << " customers, " << st_dump->rows()
+                      << " stocks as of tid " << cu_dump->tid() << std::endl;
+        }
 
         size_t remaining_deliveries = 0;
         for (int wh = 1; wh <= db.num_warehouses(); wh++) {
@@ -947,7 +1922,19 @@ public:
         }
         std::cout << "Remaining unresolved deliveries: " << remaining_deliveries << std::endl;
 
-        Transaction::rcu_release_all(advancer, num_threads);
+        if (trace_path) {
+            TxnTrace::disable();
+            if (TxnTrace::dump(trace_path))
+                std::cout << "Trace written to " << trace_path << std::endl;
+            else
+                std::cerr << "Can't write trace to " << trace_path << std::endl;
+        }
+
+#if MVCC_BG_FLATTEN
+        if (flatten_threads > 0)
+            MvFlattener::stop();
+#endif
+        Transaction::rcu_release_all(advancer, num_threads + flatten_threads + dump_threads + analytic_threads);
 
         return 0;
     }
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Commutators.hh"
+#include "MVCCTypes.hh"
 #include "TPCC_structs.hh"
 
 namespace commutators {
@@ -44,6 +45,11 @@ public:
         w.w_ytd += (uint64_t)delta_ytd;
     }
 
+    bool fold(const Commutator& next) {
+        delta_ytd += next.delta_ytd;
+        return true;
+    }
+
 private:
     int64_t delta_ytd;
     friend Commutator<warehouse_value_frequpd>;
@@ -85,6 +91,11 @@ public:
         d.d_ytd += delta_ytd;
     }
 
+    bool fold(const Commutator& next) {
+        delta_ytd += next.delta_ytd;
+        return true;
+    }
+
 private:
     int64_t delta_ytd;
     friend Commutator<district_value_frequpd>;
@@ -208,6 +219,11 @@ public:
     void operate(order_value& ov) const {
         ov.o_carrier_id = write_carrier_id;
     }
+
+    bool fold(const Commutator& next) {
+        write_carrier_id = next.write_carrier_id;
+        return true;
+    }
 private:
     uint64_t write_carrier_id;
 
@@ -248,6 +264,11 @@ public:
     void operate(orderline_value& ol) const {
         ol.ol_delivery_d = write_delivery_d;
     }
+
+    bool fold(const Commutator& next) {
+        write_delivery_d = next.write_delivery_d;
+        return true;
+    }
 private:
     uint32_t write_delivery_d;
 
@@ -336,3 +357,12 @@ public:
 };
 
 }
+
+// Payment updates w_ytd/d_ytd on every transaction; keep several of their
+// versions inside the row
+template <>
+struct mvcc_inline_slots<tpcc::warehouse_value_frequpd>
+    : std::integral_constant<unsigned, 4> {};
+template <>
+struct mvcc_inline_slots<tpcc::district_value_frequpd>
+    : std::integral_constant<unsigned, 4> {};
@@ -259,7 +259,7 @@ public:
     explicit VerSel(type v) : vers_() { (void)v; }
     VerSel(type v, bool insert) : vers_() { (void)v; (void)insert; }
 
-    static int map_impl(int col_n) {
+    constexpr static int map_impl(int col_n) {
         typedef tpcc::stock_value::NamedColumn nc;
         if (col_n <= static_cast<int>(nc::s_remote_cnt))
             return 0;
@@ -2,10 +2,11 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <cassert>
 
 #include "DB_structs.hh"
-#include "xxhash.h"
+#include "DB_keypack.hh"
 #include "str.hh" // lcdf::Str
 
 #define NUM_DISTRICTS_PER_WAREHOUSE 10
@@ -24,62 +25,129 @@
 #define HISTORY_SEQ_INSERT 0
 #endif
 
-namespace tpcc {
+// Bit-pack customer, order-customer, order-line and stock keys (packed_key):
+// warehouse ids < 2^16, item and order ids < 2^32
+#ifndef TPCC_PACKED_KEYS
+#define TPCC_PACKED_KEYS 0
+#endif
 
-// singleton class used for fast oid generation
-// this is a replacement for the d_next_o_id field in district tables to
-// avoid excessive aborts when used with STO concurrency control
+// Order ids a runner leases per district at a time (tpcc_oid_cache)
+#ifndef TPCC_OID_LEASE
+#define TPCC_OID_LEASE 1
+#endif
+
+namespace tpcc {
 
 using namespace bench;
 
+// Order ids, a replacement for the d_next_o_id field in district tables to
+// avoid excessive aborts when used with STO concurrency control. Counters
+// take a cache line each, and a warehouse's are allocated by init_warehouse,
+// called by the loader pinned to the warehouse's runner, so they live on
+// that runner's node.
 class tpcc_oid_generator {
 public:
-    static constexpr size_t max_whs = 64;
-    static constexpr size_t max_dts = 16;
-
-    tpcc_oid_generator() {
-        for (auto &oid_gen : oid_gens) {
-            for (uint64_t &j : oid_gen) {
-                j = 3001;
-            }
-        }
+    explicit tpcc_oid_generator(size_t num_whs)
+        : whs_(num_whs) {}
+    tpcc_oid_generator(const tpcc_oid_generator&) = delete;
+    tpcc_oid_generator& operator=(const tpcc_oid_generator&) = delete;
+    ~tpcc_oid_generator() {
+        for (auto whp : whs_)
+            delete whp;
+    }
+
+    void init_warehouse(uint64_t wid) {
+        if (!whs_[wid - 1])
+            whs_[wid - 1] = new warehouse_oids;
     }
 
     uint64_t next(uint64_t wid, uint64_t did) {
-        return fetch_and_add(&(oid_gens[wid % max_whs][did % max_dts]), 1);
+        return lease(wid, did, 1);
+    }
+
+    // Reserves n consecutive ids and returns the first
+    uint64_t lease(uint64_t wid, uint64_t did, uint64_t n) {
+        return fetch_and_add(&counter(wid, did), n);
     }
 
+    // The next id not yet handed out
     uint64_t get(uint64_t wid, uint64_t did) const {
-        return oid_gens[wid % max_whs][did % max_dts];
+        return const_cast<tpcc_oid_generator*>(this)->counter(wid, did);
     }
 
 private:
-    uint64_t oid_gens[max_whs][max_dts];
+    struct alignas(CACHE_LINE_SIZE) district_oid {
+        uint64_t next = 3001;
+    };
+    struct warehouse_oids {
+        district_oid dts[NUM_DISTRICTS_PER_WAREHOUSE];
+    };
+
+    uint64_t& counter(uint64_t wid, uint64_t did) {
+        assert(whs_[wid - 1] && did >= 1 && did <= NUM_DISTRICTS_PER_WAREHOUSE);
+        return whs_[wid - 1]->dts[did - 1].next;
+    }
+
+    std::vector<warehouse_oids*> whs_;
 };
 
-class tpcc_delivery_queue {
+// A runner's order ids: leased from the generator batch ids at a time per
+// district, so that the shared counters see one fetch_and_add per batch.
+// Ids a runner leased but has not used yet are gaps in the district's
+// orders until it does; a batch of 1 leases nothing.
+class tpcc_oid_cache {
 public:
-    static constexpr size_t max_whs = 64;
+    tpcc_oid_cache(tpcc_oid_generator& gen, size_t num_whs, uint64_t batch)
+        : gen_(gen), batch_(batch),
+          leases_(batch > 1 ? num_whs * NUM_DISTRICTS_PER_WAREHOUSE : 0) {}
 
-    tpcc_delivery_queue() {
-        bzero(num_enqueued, sizeof(num_enqueued));
+    uint64_t next(uint64_t wid, uint64_t did) {
+        if (batch_ <= 1)
+            return gen_.next(wid, did);
+        auto& l = leases_[(wid - 1) * NUM_DISTRICTS_PER_WAREHOUSE + did - 1];
+        if (l.next == l.end) {
+            l.next = gen_.lease(wid, did, batch_);
+            l.end = l.next + batch_;
+        }
+        return l.next++;
     }
 
+private:
+    struct range {
+        uint64_t next = 0;
+        uint64_t end = 0;
+    };
+
+    tpcc_oid_generator& gen_;
+    uint64_t batch_;
+    std::vector<range> leases_;
+};
+
+// Delivery transactions waiting for each warehouse's owner
+class tpcc_delivery_queue {
+public:
+    explicit tpcc_delivery_queue(size_t num_whs)
+        : num_enqueued_(num_whs) {}
+
     void enqueue(uint64_t wid) {
-        fetch_and_add(&num_enqueued[wid - 1], 1);
+        fetch_and_add(&num_enqueued_[wid - 1].n, 1);
     }
 
     uint64_t read(uint64_t wid) const {
         acquire_fence();
-        return num_enqueued[wid - 1];
+        return num_enqueued_[wid - 1].n;
     }
 
     void dequeue(uint64_t wid, uint64_t n) {
-        fetch_and_add(&num_enqueued[wid - 1], -n);
+        fetch_and_add(&num_enqueued_[wid - 1].n, -n);
     }
 
 private:
-    uint64_t num_enqueued[max_whs];
+    struct alignas(CACHE_LINE_SIZE) counter {
+        uint64_t n = 0;
+    };
+
+    std::vector<counter> num_enqueued_;
 };
 
 // WAREHOUSE
@@ -219,7 +287,7 @@ struct customer_idx_key {
     }
 
     bool operator==(const customer_idx_key& other) const {
-        return !memcmp(this, &other, sizeof(*this));
+        return bytes_equal<sizeof(*this)>(this, &other);
     }
     bool operator!=(const customer_idx_key& other) const {
         return !((*this) == other);
@@ -244,18 +312,23 @@ struct customer_idx_value {
 };
 
 struct customer_key {
+#if TPCC_PACKED_KEYS
+    customer_key(uint64_t wid, uint64_t did, uint64_t cid)
+        : packed(wid, did, cid) {}
+#else
     customer_key(uint64_t wid, uint64_t did, uint64_t cid) {
         c_w_id = bswap(wid);
         c_d_id = bswap(did);
         c_id = bswap(cid);
     }
+#endif
     customer_key(const lcdf::Str& mt_key) {
         assert(mt_key.length() == sizeof(*this));
         memcpy(this, mt_key.data(), sizeof(*this));
     }
 
     bool operator==(const customer_key& other) const {
-        return (c_w_id == other.c_w_id) && (c_d_id == other.c_d_id) && (c_id == other.c_id);
+        return bytes_equal<sizeof(*this)>(this, &other);
     }
     bool operator!=(const customer_key& other) const {
         return !(*this == other);
@@ -264,6 +337,25 @@ struct customer_key {
         return lcdf::Str((const char *)this, sizeof(*this));
     }
 
+#if TPCC_PACKED_KEYS
+    uint64_t get_w_id() const {
+        return packed.get<0>();
+    }
+    uint64_t get_d_id() const {
+        return packed.get<1>();
+    }
+    uint64_t get_c_id() const {
+        return packed.get<2>();
+    }
+
+    packed_key<16, 8, 32> packed;
+#else
+    uint64_t get_w_id() const {
+        return bswap(c_w_id);
+    }
+    uint64_t get_d_id() const {
+        return bswap(c_d_id);
+    }
     uint64_t get_c_id() const {
         return bswap(c_id);
     }
@@ -271,6 +363,7 @@ struct customer_key {
     uint64_t c_w_id;
     uint64_t c_d_id;
     uint64_t c_id;
+#endif
 };
 
 // Split customer table
@@ -416,12 +509,17 @@ struct history_value {
 // ORDER
 
 struct order_cidx_key {
+#if TPCC_PACKED_KEYS
+    order_cidx_key(uint64_t wid, uint64_t did, uint64_t cid, uint64_t oid)
+        : packed(wid, did, cid, oid) {}
+#else
     order_cidx_key(uint64_t wid, uint64_t did, uint64_t cid, uint64_t oid) {
         o_w_id = bswap(wid);
         o_d_id = bswap(did);
         o_c_id = bswap(cid);
         o_id = bswap(oid);
     }
+#endif
 
     order_cidx_key(const lcdf::Str& mt_key) {
         assert(mt_key.length() == sizeof(*this));
@@ -429,7 +527,7 @@ struct order_cidx_key {
     }
 
     bool operator==(const order_cidx_key& other) const {
-        return !memcmp(this, &other, sizeof(*this));
+        return bytes_equal<sizeof(*this)>(this, &other);
     }
     bool operator!=(const order_cidx_key& other) const {
         return !((*this) == other);
@@ -439,10 +537,22 @@ struct order_cidx_key {
         return lcdf::Str((const char *)this, sizeof(*this));
     }
 
+#if TPCC_PACKED_KEYS
+    uint64_t get_o_id() const {
+        return packed.get<3>();
+    }
+
+    packed_key<16, 8, 16, 32> packed;
+#else
+    uint64_t get_o_id() const {
+        return bswap(o_id);
+    }
+
     uint64_t o_w_id;
     uint64_t o_d_id;
     uint64_t o_c_id;
     uint64_t o_id;
+#endif
 };
 
 struct order_key {
@@ -506,20 +616,24 @@ struct order_value{
 // ORDER-LINE
 
 struct orderline_key {
+#if TPCC_PACKED_KEYS
+    orderline_key(uint64_t w, uint64_t d, uint64_t o, uint64_t n)
+        : packed(w, d, o, n) {}
+#else
     orderline_key(uint64_t w, uint64_t d, uint64_t o, uint64_t n) {
         ol_w_id = bswap(w);
         ol_d_id = bswap(d);
         ol_o_id = bswap(o);
         ol_number = bswap(n);
     }
+#endif
 
     orderline_key(const lcdf::Str& mt_key) {
         assert(mt_key.length() == sizeof(*this));
         memcpy(this, mt_key.data(), sizeof(*this));
     }
     bool operator==(const orderline_key& other) const {
-        return (ol_w_id == other.ol_w_id) && (ol_d_id == other.ol_d_id) &&
-            (ol_o_id == other.ol_o_id) && (ol_number == other.ol_number);
+        return bytes_equal<sizeof(*this)>(this, &other);
     }
     bool operator!=(const orderline_key& other) const {
         return !(*this == other);
@@ -528,10 +642,22 @@ struct orderline_key {
         return lcdf::Str((const char *)this, sizeof(*this));
     }
 
+#if TPCC_PACKED_KEYS
+    uint64_t get_ol_number() const {
+        return packed.get<3>();
+    }
+
+    packed_key<16, 8, 32, 8> packed;
+#else
+    uint64_t get_ol_number() const {
+        return bswap(ol_number);
+    }
+
     uint64_t ol_w_id;
     uint64_t ol_d_id;
     uint64_t ol_o_id;
     uint64_t ol_number;
+#endif
 };
 
 struct orderline_value_infreq {
@@ -601,17 +727,21 @@ struct item_value {
 // STOCK
 
 struct stock_key {
+#if TPCC_PACKED_KEYS
+    stock_key(uint64_t w, uint64_t i) : packed(w, i) {}
+#else
     stock_key(uint64_t w, uint64_t i) {
         s_w_id = bswap(w);
         s_i_id = bswap(i);
     }
+#endif
 
     stock_key(const lcdf::Str& mt_key) {
         assert(mt_key.length() == sizeof(*this));
         memcpy(this, mt_key.data(), sizeof(*this));
     }
     bool operator==(const stock_key& other) const {
-        return (s_w_id == other.s_w_id) && (s_i_id == other.s_i_id);
+        return bytes_equal<sizeof(*this)>(this, &other);
     }
     bool operator!=(const stock_key& other) const {
         return !(*this == other);
@@ -620,8 +750,12 @@ struct stock_key {
         return lcdf::Str((const char *)this, sizeof(*this));
     }
 
+#if TPCC_PACKED_KEYS
+    packed_key<16, 32> packed;
+#else
     uint64_t s_w_id;
     uint64_t s_i_id;
+#endif
 };
 
 struct stock_value_infreq {
@@ -656,8 +790,6 @@ struct stock_value {
 
 namespace std {
 
-static constexpr size_t xxh_seed = 0xdeadbeefdeadbeef;
-
 using bench::var_string;
 using bench::fix_string;
 using bench::bswap;
@@ -665,14 +797,14 @@ using bench::bswap;
 template <size_t ML>
 struct hash<var_string<ML>> {
     size_t operator()(const var_string<ML>& arg) const {
-        return XXH64(arg.s_, ML + 1, xxh_seed);
+        return bench::hash_bytes<ML + 1>(arg.s_);
     }
 };
 
 template <size_t FL>
 struct hash<fix_string<FL>> {
     size_t operator()(const fix_string<FL>& arg) const {
-        return XXH64(arg.s_, FL, xxh_seed);
+        return bench::hash_bytes<FL>(arg.s_);
     }
 };
 
@@ -691,7 +823,7 @@ inline ostream& operator<<(ostream& os, const tpcc::warehouse_key& wk) {
 template <>
 struct hash<tpcc::district_key> {
     size_t operator()(const tpcc::district_key& arg) const {
-        return XXH64(&arg, sizeof(tpcc::district_key), xxh_seed);
+        return bench::hash_bytes<sizeof(tpcc::district_key)>(&arg);
     }
 };
 
@@ -705,22 +837,22 @@ inline ostream& operator<<(ostream& os, const tpcc::district_key& dk) {
 template <>
 struct hash<tpcc::customer_key> {
     size_t operator()(const tpcc::customer_key& arg) const {
-        return XXH64(&arg, sizeof(tpcc::customer_key), xxh_seed);
+        return bench::hash_bytes<sizeof(tpcc::customer_key)>(&arg);
     }
 };
 
 inline ostream& operator<<(ostream& os, const tpcc::customer_key& ck) {
     os << "customer_key:w="
-       << bswap(ck.c_w_id) << ",d="
-       << bswap(ck.c_d_id) << ",c="
-       << bswap(ck.c_id);
+       << ck.get_w_id() << ",d="
+       << ck.get_d_id() << ",c="
+       << ck.get_c_id();
     return os;
 }
 
 template <>
 struct hash<tpcc::history_key> {
     size_t operator()(const tpcc::history_key& arg) const {
-        return XXH64(&arg, sizeof(tpcc::history_key), xxh_seed);
+        return bench::hash_bytes<sizeof(tpcc::history_key)>(&arg);
     }
 };
 
@@ -732,7 +864,7 @@ inline ostream& operator<<(ostream& os, const tpcc::history_key&) {
 template <>
 struct hash<tpcc::order_key> {
     size_t operator()(const tpcc::order_key& arg) const {
-        return XXH64(&arg, sizeof(tpcc::order_key), xxh_seed);
+        return bench::hash_bytes<sizeof(tpcc::order_key)>(&arg);
     }
 };
 
@@ -745,7 +877,7 @@ inline ostream& operator<<(ostream& os, const tpcc::order_key& ok) {
 template <>
 struct hash<tpcc::orderline_key> {
     size_t operator()(const tpcc::orderline_key& arg) const {
-        return XXH64(&arg, sizeof(tpcc::orderline_key), xxh_seed);
+        return bench::hash_bytes<sizeof(tpcc::orderline_key)>(&arg);
     }
 };
 
@@ -765,14 +897,14 @@ struct hash<tpcc::item_key> {
 template <>
 struct hash<tpcc::stock_key> {
     size_t operator()(const tpcc::stock_key& arg) const {
-        return XXH64(&arg, sizeof(tpcc::stock_key), xxh_seed);
+        return bench::hash_bytes<sizeof(tpcc::stock_key)>(&arg);
     }
 };
 
 template <>
 struct hash<tpcc::customer_idx_key> {
     size_t operator()(const tpcc::customer_idx_key& arg) const {
-        return XXH64(&arg, sizeof(tpcc::customer_idx_key), xxh_seed);
+        return bench::hash_bytes<sizeof(tpcc::customer_idx_key)>(&arg);
     }
 };
 
@@ -10,26 +10,22 @@
 namespace tpcc {
 
 template <typename DBParams>
-void tpcc_runner<DBParams>::run_txn_neworder() {
-    typedef warehouse_value::NamedColumn wh_nc;
-    typedef district_value::NamedColumn dt_nc;
-    typedef customer_value::NamedColumn cu_nc;
-    typedef item_value::NamedColumn it_nc;
-    typedef stock_value::NamedColumn st_nc;
-
-    uint64_t q_w_id  = ig.random(w_id_start, w_id_end);
-    uint64_t q_d_id = ig.random(1, 10);
-    uint64_t q_c_id = ig.gen_customer_id();
-    uint64_t num_items = ig.random(5, 15);
+auto tpcc_runner<DBParams>::gen_neworder() -> neworder_input {
+    neworder_input in;
+    uint64_t q_w_id = in.q_w_id = ig.random(w_id_start, w_id_end);
+    in.q_d_id = ig.random(1, 10);
+    in.q_c_id = ig.gen_customer_id();
+    uint64_t num_items = in.num_items = ig.random(5, 15);
     //uint64_t rbk = ig.random(1, 100); //XXX no rollbacks
 
-    uint64_t ol_i_ids[15];
-    uint64_t ol_supply_w_ids[15];
-    uint64_t ol_quantities[15];
+    in.o_entry_d = ig.gen_date();
 
-    uint32_t o_entry_d = ig.gen_date();
+    in.all_local = true;
 
-    bool all_local = true;
+    // with a cross-warehouse share, that share of orders has one remote line
+    uint64_t remote_line = num_items;
+    if (cross_pct >= 0 && ig.num_warehouses() > 1 && ig.random(1, 100) <= uint64_t(cross_pct))
+        remote_line = ig.random(0, num_items - 1);
 
     for (uint64_t i = 0; i < num_items; ++i) {
         uint64_t ol_i_id = ig.gen_item_id();
@@ -37,20 +33,41 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
         //if ((i == (num_items - 1)) && rbk == 1)
         //    ol_i_ids[i] = 0;
         //else
-        ol_i_ids[i] = ol_i_id;
+        in.ol_i_ids[i] = ol_i_id;
 
-        bool supply_from_remote = (ig.num_warehouses() > 1) && (ig.random(1, 100) == 1);
+        bool supply_from_remote = (ig.num_warehouses() > 1)
+                                  && (cross_pct < 0 ? ig.random(1, 100) == 1 : i == remote_line);
         uint64_t ol_s_w_id = q_w_id;
         if (supply_from_remote) {
             do {
                 ol_s_w_id = ig.random(1, ig.num_warehouses());
             } while (ol_s_w_id == q_w_id);
-            all_local = false;
+            in.all_local = false;
         }
-        ol_supply_w_ids[i] = ol_s_w_id;
+        in.ol_supply_w_ids[i] = ol_s_w_id;
 
-        ol_quantities[i] = ig.random(1, 10);
+        in.ol_quantities[i] = ig.random(1, 10);
     }
+    return in;
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_neworder(const neworder_input& in) {
+    typedef warehouse_value::NamedColumn wh_nc;
+    typedef district_value::NamedColumn dt_nc;
+    typedef customer_value::NamedColumn cu_nc;
+    typedef item_value::NamedColumn it_nc;
+    typedef stock_value::NamedColumn st_nc;
+
+    const uint64_t q_w_id = in.q_w_id;
+    const uint64_t q_d_id = in.q_d_id;
+    const uint64_t q_c_id = in.q_c_id;
+    const uint64_t num_items = in.num_items;
+    const uint64_t* ol_i_ids = in.ol_i_ids;
+    const uint64_t* ol_supply_w_ids = in.ol_supply_w_ids;
+    const uint64_t* ol_quantities = in.ol_quantities;
+    const uint32_t o_entry_d = in.o_entry_d;
+    const bool all_local = in.all_local;
 
     // holding outputs of the transaction
     var_string<16> out_cus_last;
@@ -62,8 +79,60 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
 
     size_t starts = 0;
 
+    // The stock updates run as repair steps (see run_repairable), one per
+    // supplying warehouse, so what they use lives outside the transaction
+    // body: a repair reruns them at commit.
+    fix_string<24> s_dists[15];
+    uint64_t st_items[15];
+    constexpr access_t stock_update = Commute ? access_t::write : access_t::update;
+    auto update_stocks = [&](uint64_t wid, const uint64_t* items, size_t n) {
+        return db.tbl_stocks(wid).select_split_rows(n,
+            [&](size_t j) { return stock_key(wid, ol_i_ids[items[j]]); },
+            static_accesses<col_access<st_nc::s_quantity, stock_update>,
+                            col_access<st_nc::s_ytd, stock_update>,
+                            col_access<st_nc::s_order_cnt, stock_update>,
+                            col_access<st_nc::s_remote_cnt, stock_update>,
+                            col_access<st_nc::s_dists>,
+                            col_access<st_nc::s_data>>(),
+            [&](size_t j, bool result, uintptr_t row, const auto& value) {
+                (void)result;
+                assert(result);
+                uint64_t i = items[j];
+                uint64_t qty = ol_quantities[i];
+                int32_t s_quantity = value.s_quantity();
+                s_dists[i] = value.s_dists()[q_d_id - 1];
+                //auto s_data = sv->s_data;
+                //if (i_data.contains("ORIGINAL") && s_data.contains("ORIGINAL"))
+                //    out_brand_generic[i] = 'B';
+                //else
+                //    out_brand_generic[i] = 'G';
+
+                if constexpr (Commute) {
+                    commutators::Commutator<stock_value> comm(qty, wid != q_w_id);
+                    db.tbl_stocks(wid).update_row(row, comm);
+                } else {
+                    stock_value* new_sv = Sto::tx_alloc<stock_value>();
+                    value.copy_into(new_sv);
+                    if ((s_quantity - 10) >= (int32_t) qty)
+                        new_sv->s_quantity -= qty;
+                    else
+                        new_sv->s_quantity += (91 - (int32_t) qty);
+                    new_sv->s_ytd += qty;
+                    new_sv->s_order_cnt += 1;
+                    if (wid != q_w_id)
+                        new_sv->s_remote_cnt += 1;
+                    db.tbl_stocks(wid).update_row(row, new_sv);
+                }
+            });
+    };
+
+    auto parts = partition_guard(q_w_id);
+    parts.add(ol_supply_w_ids, ol_supply_w_ids + num_items);
+    parts.lock();
+
     // begin txn
     RWTXN {
+    Sto::set_exclusive(DBParams::Deterministic || parts.exclusive());
     ++starts;
 
     int64_t wh_tax_rate, dt_tax_rate;
@@ -72,7 +141,7 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
     {
     warehouse_key wk(q_w_id);
     auto [abort, result, row, value] = db.tbl_warehouses().select_split_row(wk,
-        {{wh_nc::w_tax, access_t::read}}
+        static_accesses<col_access<wh_nc::w_tax>>()
     );
     (void)row; (void)result;
     CHK(abort);
@@ -83,16 +152,16 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
     {
     district_key dk(q_w_id, q_d_id);
     auto [abort, result, row, value] = db.tbl_districts(q_w_id).select_split_row(dk,
-        {{dt_nc::d_tax, access_t::read}}
+        static_accesses<col_access<dt_nc::d_tax>>()
     );
     (void)row; (void)result;
     CHK(abort);
     assert(result);
 
-    TXP_INCREMENT(txp_tpcc_no_stage1);
+    TXP_DYN_INCREMENT(txp_tpcc::no_stage1);
 
     dt_tax_rate = value.d_tax();
-    dt_next_oid = db.oid_generator().next(q_w_id, q_d_id);
+    dt_next_oid = oids.next(q_w_id, q_d_id);
     //dt_next_oid = new_dv->d_next_o_id ++;
     //db.tbl_districts(q_w_id).update_row(row, new_dv);
     }
@@ -101,15 +170,15 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
     {
     customer_key ck(q_w_id, q_d_id, q_c_id);
     auto [abort, result, row, value] = db.tbl_customers(q_w_id).select_split_row(ck,
-        {{cu_nc::c_discount, access_t::read},
-         {cu_nc::c_last, access_t::read},
-         {cu_nc::c_credit, access_t::read}}
+        static_accesses<col_access<cu_nc::c_discount>,
+                        col_access<cu_nc::c_last>,
+                        col_access<cu_nc::c_credit>>()
     );
     (void)row; (void)result;
     CHK(abort);
     assert(result);
 
-    TXP_INCREMENT(txp_tpcc_no_stage2);
+    TXP_DYN_INCREMENT(txp_tpcc::no_stage2);
 
     cus_discount = value.c_discount();
     out_cus_last = value.c_last();
@@ -117,7 +186,6 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
     }
 
     order_key ok(q_w_id, q_d_id, dt_next_oid);
-    order_cidx_key ock(q_w_id, q_d_id, q_c_id, dt_next_oid);
     order_value* ov = Sto::tx_alloc<order_value>();
     ov->o_c_id = q_c_id;
     ov->o_carrier_id = 0;
@@ -126,86 +194,75 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
     ov->o_ol_cnt = num_items;
 
     {
-    auto [abort, result] = db.tbl_orders(q_w_id).insert_row(ok, ov, false);
+    auto [abort, result] = db.tbl_orders_indexed(q_w_id).insert_row(ok, ov, &bench::dummy_row::row);
     (void)result;
     CHK(abort);
     assert(!result);
 
+    if (TPCC_LATEST_ORDER_VIEW)
+        CHK(db.latest_orders(q_w_id).insert(ok, *ov));
+
     std::tie(abort, result) = db.tbl_neworders(q_w_id).insert_row(ok, &bench::dummy_row::row, false);
     (void)result;
     CHK(abort);
     assert(!result);
-    std::tie(abort, result) = db.tbl_order_customer_index(q_w_id).insert_row(ock, &bench::dummy_row::row, false);
-    (void)result;
-    CHK(abort);
-    assert(!result);
     }
 
-    TXP_INCREMENT(txp_tpcc_no_stage3);
+    TXP_DYN_INCREMENT(txp_tpcc::no_stage3);
+
+    TXP_DYN_ACCOUNT(txp_tpcc::no_stage4, num_items);
+
+    uint32_t i_prices[15];
 
-    TXP_ACCOUNT(txp_tpcc_no_stage4, num_items);
+    // all items are read in one batch, and so are the stocks of each
+    // supplying warehouse
+    bool items_ok = true;
+    bool success = db.tbl_items(q_w_id).select_split_rows(num_items,
+        [&](size_t i) { return item_key(ol_i_ids[i]); },
+        static_accesses<col_access<it_nc::i_im_id>,
+                        col_access<it_nc::i_price>,
+                        col_access<it_nc::i_name>,
+                        col_access<it_nc::i_data>>(),
+        [&](size_t i, bool result, uintptr_t, const auto& value) {
+            (void)result;
+            assert(result);
+            items_ok = items_ok && value.i_im_id() != 0;
+            i_prices[i] = value.i_price();
+            out_item_names[i] = value.i_name();
+            //auto i_data = reinterpret_cast<const item_value *>(value)->i_data;
+        });
+    CHK(success);
+    CHK(items_ok);
+
+    // the home warehouse's items in one step, then each remote item
+    size_t num_home = 0, num_st = 0;
+    for (uint64_t i = 0; i < num_items; ++i)
+        if (ol_supply_w_ids[i] == q_w_id)
+            st_items[num_home++] = i;
+    num_st = num_home;
+    for (uint64_t i = 0; i < num_items; ++i)
+        if (ol_supply_w_ids[i] != q_w_id)
+            st_items[num_st++] = i;
+    success = run_repairable([&update_stocks, wid = q_w_id, items = st_items, num_home] {
+        return update_stocks(wid, items, num_home);
+    });
+    CHK(success);
+    for (size_t j = num_home; j < num_st; ++j) {
+        success = run_repairable([&update_stocks, wid = ol_supply_w_ids[st_items[j]], items = st_items + j] {
+            return update_stocks(wid, items, 1);
+        });
+        CHK(success);
+    }
 
+    // The order lines use the s_dists these steps read, but they don't
+    // depend on the steps: no transaction writes s_dists
     for (uint64_t i = 0; i < num_items; ++i) {
         uint64_t iid = ol_i_ids[i];
         uint64_t wid = ol_supply_w_ids[i];
         uint64_t qty = ol_quantities[i];
-        uint64_t oid;
-        uint32_t i_price;
 
         {
-        auto [abort, result, row, value] = db.tbl_items().select_split_row(item_key(iid),
-            {{it_nc::i_im_id, access_t::read},
-             {it_nc::i_price, access_t::read},
-             {it_nc::i_name, access_t::read},
-             {it_nc::i_data, access_t::read}});
-        (void)row; (void)result;
-        CHK(abort);
-        assert(result);
-        oid = value.i_im_id();
-        CHK(oid != 0);
-        i_price = value.i_price();
-        out_item_names[i] = value.i_name();
-        //auto i_data = reinterpret_cast<const item_value *>(value)->i_data;
-        }
-
-        {
-        auto [abort, result, row, value] = db.tbl_stocks(wid).select_split_row(stock_key(wid, iid),
-            {{st_nc::s_quantity, Commute ? access_t::write : access_t::update},
-             {st_nc::s_ytd, Commute ? access_t::write : access_t::update},
-             {st_nc::s_order_cnt, Commute ? access_t::write : access_t::update},
-             {st_nc::s_remote_cnt, Commute ? access_t::write : access_t::update},
-             {st_nc::s_dists, access_t::read },
-             {st_nc::s_data, access_t::read }}
-        );
-        (void)result;
-        CHK(abort);
-        assert(result);
-        int32_t s_quantity = value.s_quantity();
-        auto s_dist = value.s_dists()[q_d_id - 1];
-        //auto s_data = sv->s_data;
-        //if (i_data.contains("ORIGINAL") && s_data.contains("ORIGINAL"))
-        //    out_brand_generic[i] = 'B';
-        //else
-        //    out_brand_generic[i] = 'G';
-
-        if constexpr (Commute) {
-            commutators::Commutator<stock_value> comm(qty, wid != q_w_id);
-            db.tbl_stocks(wid).update_row(row, comm);
-        } else {
-            stock_value* new_sv = Sto::tx_alloc<stock_value>();
-            value.copy_into(new_sv);
-            if ((s_quantity - 10) >= (int32_t) qty)
-                new_sv->s_quantity -= qty;
-            else
-                new_sv->s_quantity += (91 - (int32_t) qty);
-            new_sv->s_ytd += qty;
-            new_sv->s_order_cnt += 1;
-            if (wid != q_w_id)
-                new_sv->s_remote_cnt += 1;
-            db.tbl_stocks(wid).update_row(row, new_sv);
-        }
-
-        double ol_amount = qty * i_price/100.0;
+        double ol_amount = qty * i_prices[i]/100.0;
 
         orderline_key olk(q_w_id, q_d_id, dt_next_oid, i + 1);
         orderline_value *olv = Sto::tx_alloc<orderline_value>();
@@ -214,16 +271,16 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
         olv->ol_delivery_d = 0;
         olv->ol_quantity = qty;
         olv->ol_amount = ol_amount;
-        olv->ol_dist_info = s_dist;
+        olv->ol_dist_info = s_dists[i];
 
-        std::tie(abort, result) = db.tbl_orderlines(q_w_id).insert_row(olk, olv, false);
+        auto [abort, result] = db.tbl_orderlines(q_w_id).insert_row(olk, olv, false);
         (void)result;
         CHK(abort);
         assert(!result);
 
         out_total_amount += ol_amount * (1.0 - cus_discount/100.0) * (1.0 + (wh_tax_rate + dt_tax_rate)/100.0);
 
-        TXP_INCREMENT(txp_tpcc_no_stage5);
+        TXP_DYN_INCREMENT(txp_tpcc::no_stage5);
         }
     }
 
@@ -231,46 +288,59 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
     // retry until commits
     } TEND(true);
 
-    TXP_INCREMENT(txp_tpcc_no_commits);
-    TXP_ACCOUNT(txp_tpcc_no_aborts, starts - 1);
+    TXP_DYN_INCREMENT(txp_tpcc::no_commits);
+    TXP_DYN_ACCOUNT(txp_tpcc::no_aborts, starts - 1);
 }
 
 template <typename DBParams>
-void tpcc_runner<DBParams>::run_txn_payment() {
-    typedef warehouse_value::NamedColumn wh_nc;
-    typedef district_value::NamedColumn dt_nc;
-    typedef customer_value::NamedColumn cu_nc;
+auto tpcc_runner<DBParams>::gen_payment() -> payment_input {
+    payment_input in;
+    in.q_w_id = ig.random(w_id_start, w_id_end);
+    in.q_d_id = ig.random(1, 10);
 
-    uint64_t q_w_id = ig.random(w_id_start, w_id_end);
-    uint64_t q_d_id = ig.random(1, 10);
-
-    uint64_t q_c_w_id, q_c_d_id, q_c_id;
-    std::string last_name;
     auto x = ig.random(1, 100);
     auto y = ig.random(1, 100);
 
-    bool is_home = (ig.num_warehouses() == 1) || (x <= 85);
-    bool by_name = (y <= 60);
+    bool is_home = (ig.num_warehouses() == 1) || (x > uint64_t(cross_pct < 0 ? 15 : cross_pct));
+    in.by_name = (y <= 60);
 
     if (is_home) {
-        q_c_w_id = q_w_id;
-        q_c_d_id = q_d_id;
+        in.q_c_w_id = in.q_w_id;
+        in.q_c_d_id = in.q_d_id;
     } else {
         do {
-            q_c_w_id = ig.random(1, ig.num_warehouses());
-        } while (q_c_w_id == q_w_id);
-        q_c_d_id = ig.random(1, 10);
+            in.q_c_w_id = ig.random(1, ig.num_warehouses());
+        } while (in.q_c_w_id == in.q_w_id);
+        in.q_c_d_id = ig.random(1, 10);
     }
 
-    if (by_name) {
-        last_name = ig.gen_customer_last_name_run();
-        q_c_id = 0;
+    if (in.by_name) {
+        in.last_name = ig.gen_customer_last_name_run();
+        in.q_c_id = 0;
     } else {
-        q_c_id = ig.gen_customer_id();
+        in.q_c_id = ig.gen_customer_id();
     }
 
-    int64_t h_amount = ig.random(100, 500000);
-    uint32_t h_date = ig.gen_date();
+    in.h_amount = ig.random(100, 500000);
+    in.h_date = ig.gen_date();
+    return in;
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_payment(const payment_input& in) {
+    typedef warehouse_value::NamedColumn wh_nc;
+    typedef district_value::NamedColumn dt_nc;
+    typedef customer_value::NamedColumn cu_nc;
+
+    const uint64_t q_w_id = in.q_w_id;
+    const uint64_t q_d_id = in.q_d_id;
+    const uint64_t q_c_w_id = in.q_c_w_id;
+    const uint64_t q_c_d_id = in.q_c_d_id;
+    uint64_t q_c_id = in.q_c_id;
+    const std::string& last_name = in.last_name;
+    const bool by_name = in.by_name;
+    const int64_t h_amount = in.h_amount;
+    const uint32_t h_date = in.h_date;
 
     // holding outputs of the transaction
     var_string<10> out_w_name, out_d_name;
@@ -296,9 +366,17 @@ void tpcc_runner<DBParams>::run_txn_payment() {
 
     size_t starts = 0;
 
+    auto parts = partition_guard(q_w_id);
+    parts.add(q_c_w_id);
+    parts.lock();
+
+    // deferred ytd updates write the columns without reading them
+    const access_t ytd_access = (Commute || defers_hot_rows()) ? access_t::write : access_t::update;
+
     // begin txn
     RWTXN {
     Sto::transaction()->special_txp = true;
+    Sto::set_exclusive(DBParams::Deterministic || parts.exclusive());
     ++starts;
 
     // select warehouse row for update and retrieve warehouse info
@@ -311,7 +389,7 @@ void tpcc_runner<DBParams>::run_txn_payment() {
          {wh_nc::w_city, access_t::read},
          {wh_nc::w_state, access_t::read},
          {wh_nc::w_zip, access_t::read},
-         {wh_nc::w_ytd, Commute ? access_t::write : access_t::update}}
+         {wh_nc::w_ytd, ytd_access}}
     );
     (void)result;
     CHK(success);
@@ -330,8 +408,10 @@ void tpcc_runner<DBParams>::run_txn_payment() {
     } else {
         auto new_wv = Sto::tx_alloc<warehouse_value>();
         value.copy_into(new_wv);
-        new_wv->w_ytd += h_amount;
-        db.tbl_warehouses().update_row(row, new_wv);
+        update_hot_row(db.tbl_warehouses(), row, new_wv,
+            [h_amount](warehouse_value& nv, const warehouse_value& wv) {
+                nv.w_ytd = wv.w_ytd + h_amount;
+            });
     }
     }
 
@@ -345,7 +425,7 @@ void tpcc_runner<DBParams>::run_txn_payment() {
          {dt_nc::d_city, access_t::read},
          {dt_nc::d_state, access_t::read},
          {dt_nc::d_zip, access_t::read},
-         {dt_nc::d_ytd, Commute ? access_t::write : access_t::update}}
+         {dt_nc::d_ytd, ytd_access}}
     );
     (void)result;
     CHK(success);
@@ -357,7 +437,7 @@ void tpcc_runner<DBParams>::run_txn_payment() {
     out_d_state = value.d_state();
     out_d_zip = value.d_zip();
 
-    TXP_INCREMENT(txp_tpcc_pm_stage1);
+    TXP_DYN_INCREMENT(txp_tpcc::pm_stage1);
 
     if constexpr (Commute) {
         // update district ytd commutatively
@@ -366,12 +446,13 @@ void tpcc_runner<DBParams>::run_txn_payment() {
     } else {
         auto new_dv = Sto::tx_alloc<district_value>();
         value.copy_into(new_dv);
-        // update district ytd in-place
-        new_dv->d_ytd += h_amount;
-        db.tbl_districts(q_w_id).update_row(row, new_dv);
+        update_hot_row(db.tbl_districts(q_w_id), row, new_dv,
+            [h_amount](district_value& nv, const district_value& dv) {
+                nv.d_ytd = dv.d_ytd + h_amount;
+            });
     }
 
-    TXP_INCREMENT(txp_tpcc_pm_stage2);
+    TXP_DYN_INCREMENT(txp_tpcc::pm_stage2);
     }
 
     // select and update customer
@@ -393,7 +474,7 @@ void tpcc_runner<DBParams>::run_txn_payment() {
         always_assert(q_c_id != 0, "q_c_id invalid when selecting customer by c_id");
     }
 
-    TXP_INCREMENT(txp_tpcc_pm_stage3);
+    TXP_DYN_INCREMENT(txp_tpcc::pm_stage3);
 
     customer_key ck(q_c_w_id, q_c_d_id, q_c_id);
     auto [success, result, row, value] = db.tbl_customers(q_c_w_id).select_split_row(ck,
@@ -409,7 +490,7 @@ void tpcc_runner<DBParams>::run_txn_payment() {
     CHK(success);
     assert(result);
 
-    TXP_INCREMENT(txp_tpcc_pm_stage4);
+    TXP_DYN_INCREMENT(txp_tpcc::pm_stage4);
 
     out_c_since = value.c_since();
     out_c_credit_lim = value.c_credit_lim();
@@ -438,7 +519,7 @@ void tpcc_runner<DBParams>::run_txn_payment() {
         db.tbl_customers(q_c_w_id).update_row(row, new_cv);
     }
 
-    TXP_INCREMENT(txp_tpcc_pm_stage5);
+    TXP_DYN_INCREMENT(txp_tpcc::pm_stage5);
 
     // insert to history table
     history_value *hv = Sto::tx_alloc<history_value>();
@@ -460,35 +541,43 @@ void tpcc_runner<DBParams>::run_txn_payment() {
     assert(success);
     assert(!result);
 
-    TXP_INCREMENT(txp_tpcc_pm_stage6);
+    TXP_DYN_INCREMENT(txp_tpcc::pm_stage6);
 
     // commit txn
     // retry until commits
     } TEND(true);
 
-    TXP_INCREMENT(txp_tpcc_pm_commits);
-    TXP_ACCOUNT(txp_tpcc_pm_aborts, starts - 1);
+    TXP_DYN_INCREMENT(txp_tpcc::pm_commits);
+    TXP_DYN_ACCOUNT(txp_tpcc::pm_aborts, starts - 1);
 }
 
 template <typename DBParams>
-void tpcc_runner<DBParams>::run_txn_orderstatus() {
-    typedef customer_value::NamedColumn cu_nc;
-    typedef order_value::NamedColumn od_nc;
-    typedef orderline_value::NamedColumn ol_nc;
-    uint64_t q_w_id = ig.random(w_id_start, w_id_end);
-    uint64_t q_d_id = ig.random(1, 10);
-
-    std::string last_name;
-    uint64_t q_c_id;
+auto tpcc_runner<DBParams>::gen_orderstatus() -> orderstatus_input {
+    orderstatus_input in;
+    in.q_w_id = ig.random(w_id_start, w_id_end);
+    in.q_d_id = ig.random(1, 10);
 
     auto x = ig.random(1, 100);
-    bool by_name = (x <= 60);
-    if (by_name) {
-        last_name = ig.gen_customer_last_name_run();
-        q_c_id = 0;
+    in.by_name = (x <= 60);
+    if (in.by_name) {
+        in.last_name = ig.gen_customer_last_name_run();
+        in.q_c_id = 0;
     } else {
-        q_c_id = ig.gen_customer_id();
+        in.q_c_id = ig.gen_customer_id();
     }
+    return in;
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_orderstatus(const orderstatus_input& in) {
+    typedef customer_value::NamedColumn cu_nc;
+    typedef order_value::NamedColumn od_nc;
+    typedef orderline_value::NamedColumn ol_nc;
+    const uint64_t q_w_id = in.q_w_id;
+    const uint64_t q_d_id = in.q_d_id;
+    const std::string& last_name = in.last_name;
+    uint64_t q_c_id = in.q_c_id;
+    const bool by_name = in.by_name;
 
     // holding outputs of the transaction
     var_string<16> out_c_first, out_c_last;
@@ -507,7 +596,11 @@ void tpcc_runner<DBParams>::run_txn_orderstatus() {
 
     size_t starts = 0;
 
-    TXN {
+    auto parts = partition_guard(q_w_id);
+    parts.lock();
+
+    TXN_RO {
+    Sto::set_exclusive(DBParams::Deterministic || parts.exclusive());
     ++starts;
 
     if (by_name) {
@@ -547,17 +640,24 @@ void tpcc_runner<DBParams>::run_txn_orderstatus() {
 
     // find the highest order placed by customer q_c_id
     uint64_t cus_o_id = 0;
-    auto scan_callback = [&] (const order_cidx_key& key, const auto&) -> bool {
-        cus_o_id = bswap(key.o_id);
-        return true;
-    };
+    if (TPCC_LATEST_ORDER_VIEW) {
+        int64_t latest = 0;
+        auto [success, result] = db.latest_orders(q_w_id).read(customer_key(q_w_id, q_d_id, q_c_id), &latest);
+        CHK(success);
+        if (result)
+            cus_o_id = latest;
+    } else {
+        auto scan_callback = [&] (const order_cidx_key& key, const auto&) -> bool {
+            cus_o_id = key.get_o_id();
+            return true;
+        };
 
-    order_cidx_key k0(q_w_id, q_d_id, q_c_id, 0);
-    order_cidx_key k1(q_w_id, q_d_id, q_c_id, std::numeric_limits<uint64_t>::max());
+        order_cidx_key k1(q_w_id, q_d_id, q_c_id, std::numeric_limits<uint64_t>::max());
 
-    bool scan_success = db.tbl_order_customer_index(q_w_id)
-            .template range_scan<decltype(scan_callback), true/*reverse*/>(k1, k0, scan_callback, RowAccess::ObserveExists, true, 1/*reverse scan for only 1 item*/);
-    CHK(scan_success);
+        bool scan_success = db.tbl_order_customer_index(q_w_id)
+                .scan_last_n(k1, offsetof(order_cidx_key, o_id), 1, scan_callback, RowAccess::ObserveExists);
+        CHK(scan_success);
+    }
 
     if (cus_o_id > 0) {
         order_key ok(q_w_id, q_d_id, cus_o_id);
@@ -584,7 +684,7 @@ void tpcc_runner<DBParams>::run_txn_orderstatus() {
         orderline_key olk0(q_w_id, q_d_id, cus_o_id, 0);
         orderline_key olk1(q_w_id, q_d_id, cus_o_id, std::numeric_limits<uint64_t>::max());
 
-        scan_success = db.tbl_orderlines(q_w_id)
+        bool scan_success = db.tbl_orderlines(q_w_id)
                 .template range_scan<decltype(ol_scan_callback), false/*reverse*/>(olk0, olk1, ol_scan_callback,
                         {{ol_nc::ol_i_id, access_t::read},
                          {ol_nc::ol_supply_w_id, access_t::read},
@@ -601,19 +701,29 @@ void tpcc_runner<DBParams>::run_txn_orderstatus() {
     // retry until commits
     } TEND(true);
 
-    TXP_INCREMENT(txp_tpcc_os_commits);
-    TXP_ACCOUNT(txp_tpcc_os_aborts, starts - 1);
+    TXP_DYN_INCREMENT(txp_tpcc::os_commits);
+    TXP_DYN_ACCOUNT(txp_tpcc::os_aborts, starts - 1);
 }
 
 template <typename DBParams>
-void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id,
+auto tpcc_runner<DBParams>::gen_delivery(uint64_t q_w_id) -> delivery_input {
+    delivery_input in;
+    in.q_w_id = q_w_id;
+    in.carrier_id = ig.random(1, 10);
+    in.delivery_date = ig.gen_date();
+    return in;
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_delivery(const delivery_input& in,
                                              std::array<uint64_t, NUM_DISTRICTS_PER_WAREHOUSE>& last_delivered) {
     typedef order_value::NamedColumn od_nc;
     typedef orderline_value::NamedColumn ol_nc;
     typedef customer_value::NamedColumn cu_nc;
 
-    uint64_t carrier_id = ig.random(1, 10);
-    uint32_t delivery_date = ig.gen_date();
+    const uint64_t q_w_id = in.q_w_id;
+    const uint64_t carrier_id = in.carrier_id;
+    const uint32_t delivery_date = in.delivery_date;
 
     uint64_t order_id;
     std::array<uint64_t, NUM_DISTRICTS_PER_WAREHOUSE> delivered_order_ids;
@@ -627,9 +737,13 @@ void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id,
 
     size_t starts = 0;
 
-    TXP_INCREMENT(txp_tpcc_dl_stage1);
+    TXP_DYN_INCREMENT(txp_tpcc::dl_stage1);
+
+    auto parts = partition_guard(q_w_id);
+    parts.lock();
 
     RWTXN {
+    Sto::set_exclusive(DBParams::Deterministic || parts.exclusive());
     ++starts;
 
     for (uint64_t q_d_id = 1; q_d_id <= 10; ++q_d_id) {
@@ -644,7 +758,7 @@ void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id,
         CHK(scan_success);
         //Sto::print_read_set_size("1");
 
-        TXP_INCREMENT(txp_tpcc_dl_stage2);
+        TXP_DYN_INCREMENT(txp_tpcc::dl_stage2);
 
         delivered_order_ids[q_d_id - 1] = order_id;
         if (order_id == 0)
@@ -670,7 +784,7 @@ void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id,
         CHK(success);
         assert(result);
 
-        TXP_INCREMENT(txp_tpcc_dl_stage4);
+        TXP_DYN_INCREMENT(txp_tpcc::dl_stage4);
 
         q_c_id = value.o_c_id();
         assert(q_c_id != 0);
@@ -699,7 +813,7 @@ void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id,
             CHK(success);
             assert(result);
 
-            TXP_INCREMENT(txp_tpcc_dl_stage3);
+            TXP_DYN_INCREMENT(txp_tpcc::dl_stage3);
 
             ol_amount_sum += value.ol_amount();
 
@@ -725,7 +839,7 @@ void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id,
         CHK(success);
         assert(result);
 
-        TXP_INCREMENT(txp_tpcc_dl_stage5);
+        TXP_DYN_INCREMENT(txp_tpcc::dl_stage5);
 
         if constexpr (Commute) {
             commutators::Commutator<customer_value> commutator((int64_t)ol_amount_sum);
@@ -744,18 +858,27 @@ void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id,
 
     last_delivered = delivered_order_ids;
 
-    TXP_INCREMENT(txp_tpcc_dl_commits);
-    TXP_ACCOUNT(txp_tpcc_dl_aborts, starts - 1);
+    TXP_DYN_INCREMENT(txp_tpcc::dl_commits);
+    TXP_DYN_ACCOUNT(txp_tpcc::dl_aborts, starts - 1);
 }
 
 template <typename DBParams>
-void tpcc_runner<DBParams>::run_txn_stocklevel(){
+auto tpcc_runner<DBParams>::gen_stocklevel() -> stocklevel_input {
+    stocklevel_input in;
+    in.q_w_id = ig.random(w_id_start, w_id_end);
+    in.q_d_id = ig.random(1, 10);
+    in.threshold = (int32_t)ig.random(10, 20);
+    return in;
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_stocklevel(const stocklevel_input& in) {
     typedef orderline_value::NamedColumn ol_nc;
     typedef stock_value::NamedColumn st_nc;
 
-    uint64_t q_w_id = ig.random(w_id_start, w_id_end);
-    uint64_t q_d_id = ig.random(1, 10);
-    auto threshold = (int32_t)ig.random(10, 20);
+    const uint64_t q_w_id = in.q_w_id;
+    const uint64_t q_d_id = in.q_d_id;
+    const int32_t threshold = in.threshold;
 
     std::set<uint64_t> ol_iids;
 
@@ -770,7 +893,11 @@ void tpcc_runner<DBParams>::run_txn_stocklevel(){
 
     size_t starts = 0;
 
-    TXN {
+    auto parts = partition_guard(q_w_id);
+    parts.lock();
+
+    TXN_RO {
+    Sto::set_exclusive(DBParams::Deterministic || parts.exclusive());
     ++starts;
 
     ol_iids.clear();
@@ -786,23 +913,23 @@ void tpcc_runner<DBParams>::run_txn_stocklevel(){
             );
     CHK(scan_success);
 
-    for (auto iid : ol_iids) {
-        stock_key sk(q_w_id, iid);
-        auto [success, result, row, value] = db.tbl_stocks(q_w_id).select_split_row(sk,
-            {{st_nc::s_quantity, access_t::read}}
-        );
-        (void)row; (void)result;
-        CHK(success);
-        assert(result);
-        if(value.s_quantity() < threshold) {
-            out_count += 1;
-        }
-    }
+    std::vector<uint64_t> iids(ol_iids.begin(), ol_iids.end());
+    bool success = db.tbl_stocks(q_w_id).select_split_rows(iids.size(),
+        [&](size_t i) { return stock_key(q_w_id, iids[i]); },
+        {{st_nc::s_quantity, access_t::read}},
+        [&](size_t, bool result, uintptr_t, const auto& value) {
+            (void)result;
+            assert(result);
+            if(value.s_quantity() < threshold) {
+                out_count += 1;
+            }
+        });
+    CHK(success);
 
     } TEND(true);
 
-    TXP_INCREMENT(txp_tpcc_st_commits);
-    TXP_ACCOUNT(txp_tpcc_st_aborts, starts - 1);
+    TXP_DYN_INCREMENT(txp_tpcc::st_commits);
+    TXP_DYN_ACCOUNT(txp_tpcc::st_aborts, starts - 1);
 }
 
 }; // namespace tpcc
@@ -0,0 +1,252 @@
+#include <thread>
+#include <clp.h>
+
+#include "TPCE_bench.hh"
+#include "TPCE_txns.hh"
+
+#include "DB_profiler.hh"
+#include "DB_loader.hh"
+
+using db_params::constants;
+using db_params::db_params_id;
+using db_params::db_default_params;
+using db_params::db_opaque_params;
+using db_params::db_swiss_params;
+// TicToc requires node tracking for phantom protection
+using db_params::db_tictoc_node_params;
+using db_params::db_mvcc_params;
+using db_params::parse_dbid;
+
+// TPC-E's mix, over the transactions implemented here
+tpce::workload_mix_type tpce::workload_weightgram = {
+    {tpce::TxnType::TradeOrder, 10.1},
+    {tpce::TxnType::TradeResult, 10.0},
+    {tpce::TxnType::MarketFeed, 1.0},
+    {tpce::TxnType::CustomerPosition, 13.0},
+    {tpce::TxnType::TradeStatus, 19.0},
+    {tpce::TxnType::SecurityDetail, 14.0},
+    {tpce::TxnType::MarketWatch, 18.0}
+};
+
+// @section: clp parser definitions
+enum {
+    opt_dbid = 1, opt_nthrs, opt_custs, opt_time, opt_gc, opt_perf, opt_pfcnt, opt_rofp
+};
+
+static const Clp_Option options[] = {
+        { "dbid",         'i', opt_dbid,  Clp_ValString, Clp_Optional },
+        { "nthreads",     't', opt_nthrs, Clp_ValInt,    Clp_Optional },
+        { "customers",    'u', opt_custs, Clp_ValUnsignedLong, Clp_Optional },
+        { "time",         'l', opt_time,  Clp_ValDouble, Clp_Optional },
+        { "garbage-collect", 'g', opt_gc, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "perf",         'p', opt_perf,  Clp_NoVal,     Clp_Optional },
+        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "ro-fastpath",  'o', opt_rofp,  Clp_NoVal,     Clp_Negate | Clp_Optional }
+};
+
+static inline void print_usage(const char *argv_0) {
+    std::stringstream ss;
+    ss << "Usage of " << std::string(argv_0) << ":" << std::endl
+       << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
+       << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
+       << "      default, opaque, swiss, tictoc, mvcc" << std::endl
+       << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
+       << "    Specify the number of parallel worker threads (default 1)." << std::endl
+       << "  --customers=<NUM> (or -u<NUM>)" << std::endl
+       << "    Specify the number of customers, rounded up to a multiple of "
+       << tpce::constants::customers_per_unit << " (default " << tpce::constants::default_customers << ")." << std::endl
+       << "  --time=<NUM> (or -l<NUM>)" << std::endl
+       << "    Specify the time (duration) for which the benchmark is run (default 10 seconds)." << std::endl
+       << "  --garbage-collect (or -g)" << std::endl
+       << "    Enable garbage collection/epoch advancer thread." << std::endl
+       << "  --perf (or -p)" << std::endl
+       << "    Spawns perf profiler in record mode for the duration of the benchmark run." << std::endl
+       << "  --perf-counter (or -c)" << std::endl
+       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl
+       << "  --ro-fastpath (or -o)" << std::endl
+       << "    Run the read-only transactions on the read-only fast path (default true)." << std::endl;
+    std::cout << ss.str() << std::flush;
+}
+
+struct cmd_params {
+    db_params::db_params_id db_id;
+    int num_threads;
+    unsigned long num_customers;
+    double time;
+    bool enable_gc;
+    bool spawn_perf;
+    bool perf_counter_mode;
+
+    explicit cmd_params()
+            : db_id(db_params::db_params_id::Default),
+              num_threads(1),
+              num_customers(tpce::constants::default_customers),
+              time(10.0), enable_gc(false),
+              spawn_perf(false), perf_counter_mode(false) {}
+};
+
+// @endsection: clp parser definitions
+
+template <typename DBParams>
+class bench_access {
+public:
+    using db_type = tpce::tpce_db<DBParams>;
+    using loader_type = tpce::tpce_loader<DBParams>;
+    using runner_type = tpce::tpce_runner<DBParams>;
+    using profiler_type = bench::db_profiler;
+
+    static void runner_thread(int id, db_type& db, uint64_t time_limit, size_t& txn_cnt) {
+        runner_type r(id, db, time_limit);
+        r.run();
+        txn_cnt = r.total_commits();
+    }
+
+    static int execute(cmd_params p) {
+        uint64_t time_limit = (uint64_t)(p.time * constants::processor_tsc_frequency * constants::billion);
+        uint64_t unit = tpce::constants::customers_per_unit;
+        uint64_t num_customers = std::max((p.num_customers + unit - 1) / unit, 1ul) * unit;
+
+        // Create DB
+        auto& db = *(new db_type(num_customers));
+        std::cout << "Customers: " << num_customers << ", securities: " << db.scale().securities() << std::endl;
+
+        // Load DB: the market on the first loader, customers split by runner
+        int nparts = p.num_threads;
+        bench::db_loader("tpce", nparts, p.num_threads, [](int part) { return part; }).run([&](int part) {
+                db.thread_init_all();
+                loader_type loader(db, part + 1);
+                uint64_t rows = part == 0 ? loader.load_market() : 0;
+                uint64_t first = num_customers * part / nparts + 1;
+                uint64_t last = num_customers * (part + 1) / nparts;
+                return rows + loader.load_customers(first, last);
+            });
+
+        // Start the GC thread if necessary
+        std::thread advancer;
+        std::cout << "Garbage collection: " << (p.enable_gc ? "enabled" : "disabled") << std::endl;
+        if (p.enable_gc) {
+            advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+        }
+
+        // Execute benchmark
+        std::vector<std::thread> runner_threads;
+        std::vector<size_t> committed_txn_cnts((size_t)p.num_threads, 0);
+
+        bench::latency_profile::name_types({"TradeOrder", "TradeResult", "MarketFeed", "CustomerPosition",
+                                            "TradeStatus", "SecurityDetail", "MarketWatch"});
+        profiler_type profiler(p.spawn_perf);
+        profiler.describe<DBParams>("tpce", p.num_threads);
+        profiler.config("time_limit", p.time);
+        profiler.config("gc", p.enable_gc);
+        profiler.config("customers", num_customers);
+        profiler.start(p.perf_counter_mode ? Profiler::perf_mode::counters : Profiler::perf_mode::record);
+
+        for (int t = 0; t < p.num_threads; ++t) {
+            runner_threads.push_back(
+                    std::thread(runner_thread, t, std::ref(db), time_limit, std::ref(committed_txn_cnts[t]))
+            );
+        }
+        for (auto& t : runner_threads) {
+            t.join();
+        }
+
+        size_t total_commit_txns = 0;
+        for (auto c : committed_txn_cnts)
+            total_commit_txns += c;
+
+        profiler.finish(total_commit_txns);
+
+        Transaction::rcu_release_all(advancer, p.num_threads);
+
+        delete (&db);
+        return 0;
+    }
+};
+
+bench::dummy_row bench::dummy_row::row;
+double constants::processor_tsc_frequency;
+
+int main(int argc, const char * const *argv) {
+    cmd_params params;
+
+    Sto::global_init();
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+
+    int ret_code = 0;
+    int opt;
+    bool clp_stop = false;
+    while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
+        switch (opt) {
+            case opt_dbid:
+                params.db_id = parse_dbid(clp->val.s);
+                if (params.db_id == db_params::db_params_id::None) {
+                    std::cout << "Unsupported DB CC id: "
+                              << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                    print_usage(argv[0]);
+                    ret_code = 1;
+                    clp_stop = true;
+                }
+                break;
+            case opt_nthrs:
+                params.num_threads = clp->val.i;
+                break;
+            case opt_custs:
+                params.num_customers = clp->val.ul;
+                break;
+            case opt_time:
+                params.time = clp->val.d;
+                break;
+            case opt_gc:
+                params.enable_gc = !clp->negated;
+                break;
+            case opt_perf:
+                params.spawn_perf = !clp->negated;
+                break;
+            case opt_pfcnt:
+                params.perf_counter_mode = !clp->negated;
+                break;
+            case opt_rofp:
+                Transaction::set_readonly_fast_path(!clp->negated);
+                break;
+            default:
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+                break;
+        }
+    }
+
+    Clp_DeleteParser(clp);
+    if (ret_code != 0)
+        return ret_code;
+
+    auto cpu_freq = determine_cpu_freq();
+    if (cpu_freq == 0.0)
+        return 1;
+    else
+        constants::processor_tsc_frequency = cpu_freq;
+
+    switch (params.db_id) {
+        case db_params_id::Default:
+            ret_code = bench_access<db_default_params>::execute(params);
+            break;
+        case db_params_id::Opaque:
+            ret_code = bench_access<db_opaque_params>::execute(params);
+            break;
+        case db_params_id::Swiss:
+            ret_code = bench_access<db_swiss_params>::execute(params);
+            break;
+        case db_params_id::TicToc:
+            ret_code = bench_access<db_tictoc_node_params>::execute(params);
+            break;
+        case db_params_id::MVCC:
+            ret_code = bench_access<db_mvcc_params>::execute(params);
+            break;
+        default:
+            std::cerr << "unknown db config parameter id" << std::endl;
+            ret_code = 1;
+            break;
+    };
+
+    return ret_code;
+}
@@ -0,0 +1,556 @@
+#pragma once
+
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <vector>
+#include <sampling.hh>
+#include <PlatformFeatures.hh>
+
+#include "TPCE_structs.hh"
+#include "DB_index.hh"
+#include "DB_latency.hh"
+#include "DB_params.hh"
+
+#include "tpce_split_params_default.hh"
+
+namespace tpce {
+
+// Table sizes per TPC-E load unit of 1000 customers, except that the daily
+// market history covers a year of trading days rather than five, and each
+// account starts with a short trade history
+struct constants {
+    static constexpr uint64_t customers_per_unit = 1000;
+    static constexpr uint64_t securities_per_unit = 685;
+    static constexpr uint64_t companies_per_unit = 500;
+    static constexpr uint64_t customers_per_broker = 100;
+    static constexpr uint64_t accounts_per_customer = 5;
+    static constexpr uint64_t holdings_per_account = 10;
+    static constexpr uint64_t watch_items_per_customer = 100;
+    static constexpr uint64_t trades_per_account = 10;
+    static constexpr uint32_t num_market_days = 260;
+    static constexpr uint64_t default_customers = 5000;
+
+    // Market-Feed ticker length, Trade-Status history length, and the
+    // range of days Security-Detail reads
+    static constexpr int ticker_size = 20;
+    static constexpr int trade_status_rows = 50;
+    static constexpr int min_detail_days = 5;
+    static constexpr int max_detail_days = 20;
+
+    // Per customer tier (1-3): fixed charge per trade, and commission as a
+    // percentage of the trade's value
+    static constexpr float charge[3] = {12.0f, 9.0f, 6.0f};
+    static constexpr float commission_pct[3] = {0.5f, 0.4f, 0.3f};
+};
+
+// Ids of the rows that the loader creates for a number of customers
+// (a multiple of customers_per_unit). Accounts are numbered so that a
+// customer's accounts form one range.
+class tpce_scale {
+public:
+    explicit tpce_scale(uint64_t num_customers)
+        : customers_(num_customers),
+          units_(std::max(num_customers / constants::customers_per_unit, uint64_t(1))) {}
+
+    uint64_t customers() const {
+        return customers_;
+    }
+    uint64_t accounts() const {
+        return customers_ * constants::accounts_per_customer;
+    }
+    uint64_t brokers() const {
+        return std::max(customers_ / constants::customers_per_broker, uint64_t(1));
+    }
+    uint64_t securities() const {
+        return units_ * constants::securities_per_unit;
+    }
+    uint64_t companies() const {
+        return units_ * constants::companies_per_unit;
+    }
+
+    // Account i (0-based) of customer c_id
+    uint64_t account_of(uint64_t c_id, uint64_t i) const {
+        return (c_id - 1) * constants::accounts_per_customer + i + 1;
+    }
+    uint64_t broker_of(uint64_t ca_id) const {
+        return (ca_id - 1) % brokers() + 1;
+    }
+    uint64_t company_of(uint64_t s_id) const {
+        return (s_id - 1) % companies() + 1;
+    }
+
+private:
+    uint64_t customers_;
+    uint64_t units_;
+};
+
+// Symbols sort in s_id order and between symbol_lo() and symbol_hi(),
+// which bound scans over a prefix of (id, symbol) keys
+inline symbol_type security_symbol(uint64_t s_id) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "S%09llu", static_cast<unsigned long long>(s_id));
+    return symbol_type(buf);
+}
+inline symbol_type symbol_lo() {
+    return symbol_type();
+}
+inline symbol_type symbol_hi() {
+    return symbol_type("~");
+}
+
+// Trade types are T(market|limit)(buy|sell)
+inline bool is_sell(const fix_string<3>& tt_id) {
+    return tt_id[2] == 'S';
+}
+inline bool is_limit(const fix_string<3>& tt_id) {
+    return tt_id[1] == 'L';
+}
+
+inline uint32_t now_dts() {
+    auto duration = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(duration).count());
+}
+
+template <typename DBParams>
+class tpce_db {
+public:
+    template <typename K, typename V>
+    using OIndex = typename std::conditional<
+            DBParams::MVCC,
+            mvcc_ordered_index<K, V, DBParams>,
+            ordered_index<K, V, DBParams>>::type;
+
+    typedef OIndex<customer_key, customer_row>                 cu_table_type;
+    typedef OIndex<customer_account_key, customer_account_row> ca_table_type;
+    typedef OIndex<broker_key, broker_row>                     br_table_type;
+    typedef OIndex<company_key, company_row>                   co_table_type;
+    typedef OIndex<security_key, security_row>                 se_table_type;
+    typedef OIndex<daily_market_key, daily_market_row>         dm_table_type;
+    typedef OIndex<last_trade_key, last_trade_row>             lt_table_type;
+    typedef OIndex<trade_key, trade_row>                       tr_table_type;
+    typedef OIndex<trade_ca_key, bench::dummy_row>             tc_table_type;
+    typedef OIndex<trade_request_key, trade_request_row>       rq_table_type;
+    typedef OIndex<trade_history_key, trade_history_row>       th_table_type;
+    typedef OIndex<holding_summary_key, holding_summary_row>   hs_table_type;
+    typedef OIndex<settlement_key, settlement_row>             st_table_type;
+    typedef OIndex<watch_item_key, bench::dummy_row>           wi_table_type;
+
+    explicit tpce_db(uint64_t num_customers)
+        : scale_(num_customers) {}
+
+    const tpce_scale& scale() const {
+        return scale_;
+    }
+
+    cu_table_type& tbl_customers() {
+        return tbl_customers_;
+    }
+    ca_table_type& tbl_accounts() {
+        return tbl_accounts_;
+    }
+    br_table_type& tbl_brokers() {
+        return tbl_brokers_;
+    }
+    co_table_type& tbl_companies() {
+        return tbl_companies_;
+    }
+    se_table_type& tbl_securities() {
+        return tbl_securities_;
+    }
+    dm_table_type& tbl_daily_market() {
+        return tbl_daily_market_;
+    }
+    lt_table_type& tbl_last_trades() {
+        return tbl_last_trades_;
+    }
+    tr_table_type& tbl_trades() {
+        return tbl_trades_;
+    }
+    tc_table_type& tbl_trades_by_account() {
+        return tbl_trades_by_account_;
+    }
+    rq_table_type& tbl_trade_requests() {
+        return tbl_trade_requests_;
+    }
+    th_table_type& tbl_trade_history() {
+        return tbl_trade_history_;
+    }
+    hs_table_type& tbl_holding_summaries() {
+        return tbl_holding_summaries_;
+    }
+    st_table_type& tbl_settlements() {
+        return tbl_settlements_;
+    }
+    wi_table_type& tbl_watch_items() {
+        return tbl_watch_items_;
+    }
+
+    void thread_init_all() {
+        tbl_customers_.thread_init();
+        tbl_accounts_.thread_init();
+        tbl_brokers_.thread_init();
+        tbl_companies_.thread_init();
+        tbl_securities_.thread_init();
+        tbl_daily_market_.thread_init();
+        tbl_last_trades_.thread_init();
+        tbl_trades_.thread_init();
+        tbl_trades_by_account_.thread_init();
+        tbl_trade_requests_.thread_init();
+        tbl_trade_history_.thread_init();
+        tbl_holding_summaries_.thread_init();
+        tbl_settlements_.thread_init();
+        tbl_watch_items_.thread_init();
+    }
+
+private:
+    tpce_scale scale_;
+
+    cu_table_type tbl_customers_;
+    ca_table_type tbl_accounts_;
+    br_table_type tbl_brokers_;
+    co_table_type tbl_companies_;
+    se_table_type tbl_securities_;
+    dm_table_type tbl_daily_market_;
+    lt_table_type tbl_last_trades_;
+    tr_table_type tbl_trades_;
+    tc_table_type tbl_trades_by_account_;
+    rq_table_type tbl_trade_requests_;
+    th_table_type tbl_trade_history_;
+    hs_table_type tbl_holding_summaries_;
+    st_table_type tbl_settlements_;
+    wi_table_type tbl_watch_items_;
+};
+
+enum class TxnType : int {
+    TradeOrder = 0, TradeResult, MarketFeed, CustomerPosition, TradeStatus, SecurityDetail, MarketWatch
+};
+
+using txn_dist_type = sampling::StoCustomDistribution<TxnType>;
+typedef txn_dist_type::weightgram_type workload_mix_type;
+typedef sampling::StoRandomDistribution<>::rng_type rng_type;
+
+extern workload_mix_type workload_weightgram;
+
+class input_generator {
+public:
+    input_generator(int seed, const tpce_scale& scale)
+        : rng(seed), scale(scale), txn_dist(rng, workload_weightgram) {}
+
+    TxnType next_transaction() {
+        return txn_dist.sample();
+    }
+
+    uint64_t random(uint64_t lo, uint64_t hi) {
+        return std::uniform_int_distribution<uint64_t>(lo, hi)(rng);
+    }
+    double uniform(double lo, double hi) {
+        return std::uniform_real_distribution<double>(lo, hi)(rng);
+    }
+
+    uint64_t customer_id() {
+        return random(1, scale.customers());
+    }
+    uint64_t account_id(uint64_t c_id) {
+        return scale.account_of(c_id, random(0, constants::accounts_per_customer - 1));
+    }
+    uint64_t security_id() {
+        return random(1, scale.securities());
+    }
+    int32_t trade_qty() {
+        return static_cast<int32_t>(random(1, 8) * 100);
+    }
+
+private:
+    rng_type rng;
+    const tpce_scale& scale;
+    txn_dist_type txn_dist;
+};
+
+template <typename DBParams>
+class tpce_runner {
+public:
+    typedef tpce_db<DBParams> db_type;
+
+    tpce_runner(int id, db_type& database, uint64_t time_limit)
+        : id(id), db(database), time_limit(time_limit), total_commits_(),
+          ig(id + 1040, database.scale()) {}
+
+    void run();
+    size_t total_commits() const {
+        return total_commits_;
+    }
+
+    void run_txn_trade_order(uint64_t ca_id, uint64_t s_id, bool sell, bool limit, int32_t qty, double limit_factor);
+    void run_txn_trade_result(uint64_t t_id);
+    void run_txn_market_feed(const std::vector<std::pair<uint64_t, double>>& ticker);
+    void run_txn_customer_position(uint64_t c_id);
+    void run_txn_trade_status(uint64_t ca_id);
+    void run_txn_security_detail(uint64_t s_id, uint32_t start_day, int ndays);
+    void run_txn_market_watch(uint64_t c_id, uint32_t start_day);
+
+private:
+    int id;
+    db_type& db;
+    uint64_t time_limit;
+    size_t total_commits_;
+    input_generator ig;
+    // Submitted trades awaiting Trade-Result, standing in for the market
+    // exchange emulator: market orders from this runner's Trade-Orders and
+    // limit orders its Market-Feeds triggered
+    std::deque<uint64_t> pending_trades;
+};
+
+template <typename DBParams>
+class tpce_loader {
+public:
+    typedef tpce_db<DBParams> db_type;
+
+    tpce_loader(db_type& database, int seed)
+        : db(database), rng(seed) {}
+
+    // Brokers, companies, securities and their market data
+    uint64_t load_market();
+    // Customers first..last with their accounts, holdings, watch lists
+    // and past trades
+    uint64_t load_customers(uint64_t first, uint64_t last);
+
+    // Price of security s_id before the first market day
+    static float initial_price(uint64_t s_id) {
+        return 20.0f + static_cast<float>((s_id * 7919) % 800) / 10.0f;
+    }
+    // Closing price of security s_id on market day d
+    static float closing_price(uint64_t s_id, uint32_t d) {
+        uint64_t h = (s_id * 0x9e3779b97f4a7c15ull) ^ (uint64_t(d) * 0xbf58476d1ce4e5b9ull);
+        return initial_price(s_id) * (0.8f + static_cast<float>((h >> 33) % 4000) / 10000.0f);
+    }
+
+private:
+    db_type& db;
+    rng_type rng;
+
+    uint64_t random(uint64_t lo, uint64_t hi) {
+        return std::uniform_int_distribution<uint64_t>(lo, hi)(rng);
+    }
+};
+
+template <typename DBParams>
+uint64_t tpce_loader<DBParams>::load_market() {
+    auto& scale = db.scale();
+    uint64_t rows = 0;
+
+    for (uint64_t b_id = 1; b_id <= scale.brokers(); ++b_id) {
+        broker_row br;
+        br.b_st_id = "ACTV";
+        br.b_name = "Broker " + std::to_string(b_id);
+        br.b_num_trades = 0;
+        br.b_comm_total = 0;
+        db.tbl_brokers().nontrans_put(broker_key(b_id), br);
+        ++rows;
+    }
+
+    for (uint64_t co_id = 1; co_id <= scale.companies(); ++co_id) {
+        company_row cr;
+        cr.co_st_id = "ACTV";
+        cr.co_name = "Company " + std::to_string(co_id);
+        cr.co_in_id = "IN";
+        cr.co_sp_rate = "AAA";
+        cr.co_ceo = "CEO " + std::to_string(co_id);
+        cr.co_ad_id = static_cast<int64_t>(co_id);
+        cr.co_desc = "Description of company " + std::to_string(co_id);
+        cr.co_open_date = static_cast<uint32_t>(random(0, 36500));
+        db.tbl_companies().nontrans_put(company_key(co_id), cr);
+        ++rows;
+    }
+
+    for (uint64_t s_id = 1; s_id <= scale.securities(); ++s_id) {
+        auto symb = security_symbol(s_id);
+        security_row sr;
+        sr.s_issue = "COMMON";
+        sr.s_st_id = "ACTV";
+        sr.s_name = "Security " + std::to_string(s_id);
+        sr.s_ex_id = s_id % 2 ? "NYSE" : "NASDAQ";
+        sr.s_co_id = static_cast<int64_t>(scale.company_of(s_id));
+        sr.s_num_out = static_cast<int64_t>(random(1000000, 10000000000ull));
+        sr.s_start_date = 0;
+        sr.s_exch_date = 0;
+        sr.s_pe = static_cast<float>(random(100, 12000)) / 100.0f;
+        sr.s_52wk_high = initial_price(s_id) * 1.2f;
+        sr.s_52wk_high_date = 0;
+        sr.s_52wk_low = initial_price(s_id) * 0.8f;
+        sr.s_52wk_low_date = 0;
+        sr.s_dividend = static_cast<float>(random(0, 1000)) / 100.0f;
+        sr.s_yield = static_cast<float>(random(0, 1200)) / 100.0f;
+        db.tbl_securities().nontrans_put(security_key(symb), sr);
+
+        for (uint32_t d = 0; d != constants::num_market_days; ++d) {
+            daily_market_row dr;
+            dr.dm_close = closing_price(s_id, d);
+            dr.dm_high = dr.dm_close * 1.05f;
+            dr.dm_low = dr.dm_close * 0.95f;
+            dr.dm_vol = static_cast<int64_t>(random(1000, 1000000));
+            db.tbl_daily_market().nontrans_put(daily_market_key(symb, d), dr);
+        }
+
+        last_trade_row lr;
+        lr.lt_dts = now_dts();
+        lr.lt_price = closing_price(s_id, constants::num_market_days - 1);
+        lr.lt_open_price = lr.lt_price;
+        lr.lt_vol = 0;
+        db.tbl_last_trades().nontrans_put(last_trade_key(symb), lr);
+        rows += constants::num_market_days + 2;
+    }
+    return rows;
+}
+
+template <typename DBParams>
+uint64_t tpce_loader<DBParams>::load_customers(uint64_t first, uint64_t last) {
+    auto& scale = db.scale();
+    uint64_t rows = 0;
+    uint32_t now = now_dts();
+
+    for (uint64_t c_id = first; c_id <= last; ++c_id) {
+        customer_row cr;
+        cr.c_tax_id = "TAX" + std::to_string(c_id);
+        cr.c_st_id = "ACTV";
+        cr.c_l_name = "Last" + std::to_string(c_id % 1000);
+        cr.c_f_name = "First" + std::to_string(c_id);
+        cr.c_m_name = "M";
+        cr.c_gndr = c_id % 2 ? "M" : "F";
+        // 20% tier 1, 60% tier 2, 20% tier 3
+        auto x = random(1, 10);
+        cr.c_tier = x <= 2 ? 1 : (x <= 8 ? 2 : 3);
+        cr.c_dob = static_cast<uint32_t>(random(0, 36500));
+        cr.c_ad_id = static_cast<int64_t>(c_id);
+        cr.c_ctry_1 = "011";
+        cr.c_area_1 = "617";
+        cr.c_local_1 = "5550100";
+        cr.c_email_1 = "c" + std::to_string(c_id) + "@example.com";
+        db.tbl_customers().nontrans_put(customer_key(c_id), cr);
+        ++rows;
+
+        for (uint64_t a = 0; a != constants::accounts_per_customer; ++a) {
+            uint64_t ca_id = scale.account_of(c_id, a);
+            customer_account_row ar;
+            ar.ca_b_id = static_cast<int64_t>(scale.broker_of(ca_id));
+            ar.ca_c_id = static_cast<int64_t>(c_id);
+            ar.ca_name = "Account " + std::to_string(ca_id);
+            ar.ca_tax_st = static_cast<int32_t>(random(0, 2));
+            ar.ca_bal = static_cast<float>(random(1000000, 100000000)) / 100.0f;
+            db.tbl_accounts().nontrans_put(customer_account_key(ca_id), ar);
+            ++rows;
+
+            for (uint64_t h = 0; h != constants::holdings_per_account; ++h) {
+                holding_summary_row hr;
+                hr.hs_qty = static_cast<int32_t>(random(1, 8) * 100);
+                holding_summary_key hk(ca_id, security_symbol(random(1, scale.securities())));
+                db.tbl_holding_summaries().nontrans_put(hk, hr);
+                ++rows;
+            }
+
+            for (uint64_t t = 0; t != constants::trades_per_account; ++t) {
+                uint64_t t_id = db.tbl_trades().gen_key();
+                uint64_t s_id = random(1, scale.securities());
+                trade_row tr;
+                tr.t_dts = now - static_cast<uint32_t>(random(1, 86400 * 30));
+                tr.t_st_id = "CMPT";
+                tr.t_tt_id = random(0, 1) ? "TMB" : "TMS";
+                tr.t_is_cash = 1;
+                tr.t_s_symb = security_symbol(s_id);
+                tr.t_qty = static_cast<int32_t>(random(1, 8) * 100);
+                tr.t_bid_price = initial_price(s_id);
+                tr.t_ca_id = static_cast<int64_t>(ca_id);
+                tr.t_exec_name = cr.c_f_name.c_str();
+                tr.t_trade_price = tr.t_bid_price;
+                tr.t_chrg = constants::charge[cr.c_tier - 1];
+                tr.t_comm = tr.t_trade_price * tr.t_qty * constants::commission_pct[cr.c_tier - 1] / 100.0f;
+                tr.t_tax = 0;
+                tr.t_lifo = 1;
+                db.tbl_trades().nontrans_put(trade_key(t_id), tr);
+                db.tbl_trades_by_account().nontrans_put(trade_ca_key(ca_id, t_id), bench::dummy_row());
+
+                trade_history_row hr;
+                hr.th_dts = tr.t_dts;
+                db.tbl_trade_history().nontrans_put(trade_history_key(t_id, "CMPT"), hr);
+                rows += 3;
+            }
+        }
+
+        for (uint64_t w = 0; w != constants::watch_items_per_customer; ++w) {
+            watch_item_key wk(c_id, security_symbol(random(1, scale.securities())));
+            db.tbl_watch_items().nontrans_put(wk, bench::dummy_row());
+            ++rows;
+        }
+    }
+    return rows;
+}
+
+template <typename DBParams>
+void tpce_runner<DBParams>::run() {
+    ::TThread::set_id(id);
+    set_affinity(id);
+    db.thread_init_all();
+
+    auto tsc_begin = read_tsc();
+    size_t cnt = 0;
+    std::vector<std::pair<uint64_t, double>> ticker;
+    while (true) {
+        auto t_type = ig.next_transaction();
+        // nothing to complete yet: order instead
+        if (t_type == TxnType::TradeResult && pending_trades.empty())
+            t_type = TxnType::TradeOrder;
+        bench::latency_profile::timer lt;
+        switch (t_type) {
+            case TxnType::TradeOrder: {
+                uint64_t c_id = ig.customer_id();
+                // 60% market orders, half of all orders sells
+                bool limit = ig.random(1, 100) > 60;
+                run_txn_trade_order(ig.account_id(c_id), ig.security_id(), ig.random(0, 1), limit,
+                                    ig.trade_qty(), ig.uniform(0.9, 1.1));
+                break;
+            }
+            case TxnType::TradeResult: {
+                uint64_t t_id = pending_trades.front();
+                pending_trades.pop_front();
+                run_txn_trade_result(t_id);
+                break;
+            }
+            case TxnType::MarketFeed:
+                ticker.clear();
+                for (int i = 0; i != constants::ticker_size; ++i)
+                    ticker.emplace_back(ig.security_id(), ig.uniform(0.95, 1.05));
+                run_txn_market_feed(ticker);
+                break;
+            case TxnType::CustomerPosition:
+                run_txn_customer_position(ig.customer_id());
+                break;
+            case TxnType::TradeStatus:
+                run_txn_trade_status(ig.account_id(ig.customer_id()));
+                break;
+            case TxnType::SecurityDetail: {
+                int ndays = static_cast<int>(ig.random(constants::min_detail_days, constants::max_detail_days));
+                run_txn_security_detail(ig.security_id(),
+                                        static_cast<uint32_t>(ig.random(0, constants::num_market_days - ndays)),
+                                        ndays);
+                break;
+            }
+            case TxnType::MarketWatch:
+                run_txn_market_watch(ig.customer_id(),
+                                     static_cast<uint32_t>(ig.random(0, constants::num_market_days - 1)));
+                break;
+            default:
+                always_assert(false, "unknown transaction type");
+                break;
+        }
+        lt.record(static_cast<int>(t_type));
+
+        ++cnt;
+        if ((read_tsc() - tsc_begin) >= time_limit)
+            break;
+    }
+
+    total_commits_ = cnt;
+}
+
+}; // namespace tpce
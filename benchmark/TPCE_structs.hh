@@ -46,11 +46,44 @@ struct taxrate_row {
     float          tx_rate;
 };
 
-struct customer_key {
-    int64_t c_id;
+struct customer_key_bare {
+    uint64_t c_id;
+
+    explicit customer_key_bare(uint64_t id) : c_id(bswap(id)) {}
+    friend masstree_key_adapter<customer_key_bare>;
+private:
+    customer_key_bare() = default;
 };
 
+typedef masstree_key_adapter<customer_key_bare> customer_key;
+
 struct customer_row {
+    enum class NamedColumn : int {
+        c_tax_id = 0,
+        c_st_id,
+        c_l_name,
+        c_f_name,
+        c_m_name,
+        c_gndr,
+        c_tier,
+        c_dob,
+        c_ad_id,
+        c_ctry_1,
+        c_area_1,
+        c_local_1,
+        c_ext_1,
+        c_ctry_2,
+        c_area_2,
+        c_local_2,
+        c_ext_2,
+        c_ctry_3,
+        c_area_3,
+        c_local_3,
+        c_ext_3,
+        c_email_1,
+        c_email_2
+    };
+
     var_string<20> c_tax_id;
     fix_string<4>  c_st_id;
     var_string<30> c_l_name;
@@ -108,11 +141,29 @@ struct industry_row {
     fix_string<2>  in_sc_id;
 };
 
-struct company_key {
-    int64_t co_id;
+struct company_key_bare {
+    uint64_t co_id;
+
+    explicit company_key_bare(uint64_t id) : co_id(bswap(id)) {}
+    friend masstree_key_adapter<company_key_bare>;
+private:
+    company_key_bare() = default;
 };
 
+typedef masstree_key_adapter<company_key_bare> company_key;
+
 struct company_row {
+    enum class NamedColumn : int {
+        co_st_id = 0,
+        co_name,
+        co_in_id,
+        co_sp_rate,
+        co_ceo,
+        co_ad_id,
+        co_desc,
+        co_open_date
+    };
+
     fix_string<4>   co_st_id;
     var_string<60>  co_name;
     fix_string<2>   co_in_id;
@@ -129,11 +180,38 @@ struct company_competitor_key {
     fix_string<2> cp_in_id;
 };
 
-struct security_key {
-    fix_string<15> s_symb;
+typedef fix_string<15> symbol_type;
+
+struct security_key_bare {
+    symbol_type s_symb;
+
+    explicit security_key_bare(const symbol_type& symb) : s_symb(symb) {}
+    friend masstree_key_adapter<security_key_bare>;
+private:
+    security_key_bare() = default;
 };
 
+typedef masstree_key_adapter<security_key_bare> security_key;
+
 struct security_row {
+    enum class NamedColumn : int {
+        s_issue = 0,
+        s_st_id,
+        s_name,
+        s_ex_id,
+        s_co_id,
+        s_num_out,
+        s_start_date,
+        s_exch_date,
+        s_pe,
+        s_52wk_high,
+        s_52wk_high_date,
+        s_52wk_low,
+        s_52wk_low_date,
+        s_dividend,
+        s_yield
+    };
+
     fix_string<6>  s_issue;
     fix_string<4>  s_st_id;
     var_string<70> s_name;
@@ -151,12 +229,28 @@ struct security_row {
     float          s_yield;
 };
 
-struct daily_market_key {
-    uint32_t       dm_date;
-    fix_string<15> dm_s_symb;
+// By security first, so that a security's history is one range
+struct __attribute__((packed)) daily_market_key_bare {
+    symbol_type dm_s_symb;
+    uint32_t    dm_date;
+
+    explicit daily_market_key_bare(const symbol_type& symb, uint32_t date)
+        : dm_s_symb(symb), dm_date(bswap(date)) {}
+    friend masstree_key_adapter<daily_market_key_bare>;
+private:
+    daily_market_key_bare() = default;
 };
 
+typedef masstree_key_adapter<daily_market_key_bare> daily_market_key;
+
 struct daily_market_row {
+    enum class NamedColumn : int {
+        dm_close = 0,
+        dm_high,
+        dm_low,
+        dm_vol
+    };
+
     float   dm_close;
     float   dm_high;
     float   dm_low;
@@ -183,11 +277,25 @@ struct financial_row {
     int64_t  fi_out_dilut;
 };
 
-struct last_trade_key {
-    fix_string<15> lt_s_symb;
+struct last_trade_key_bare {
+    symbol_type lt_s_symb;
+
+    explicit last_trade_key_bare(const symbol_type& symb) : lt_s_symb(symb) {}
+    friend masstree_key_adapter<last_trade_key_bare>;
+private:
+    last_trade_key_bare() = default;
 };
 
+typedef masstree_key_adapter<last_trade_key_bare> last_trade_key;
+
 struct last_trade_row {
+    enum class NamedColumn : int {
+        lt_dts = 0,
+        lt_price,
+        lt_open_price,
+        lt_vol
+    };
+
     uint32_t lt_dts;
     float    lt_price;
     float    lt_open_price;
@@ -214,11 +322,25 @@ struct news_xref_key {
 
 // Broker tables 1/3
 
-struct broker_key {
-    int64_t b_id;
+struct broker_key_bare {
+    uint64_t b_id;
+
+    explicit broker_key_bare(uint64_t id) : b_id(bswap(id)) {}
+    friend masstree_key_adapter<broker_key_bare>;
+private:
+    broker_key_bare() = default;
 };
 
+typedef masstree_key_adapter<broker_key_bare> broker_key;
+
 struct broker_row {
+    enum class NamedColumn : int {
+        b_st_id = 0,
+        b_name,
+        b_num_trades,
+        b_comm_total
+    };
+
     fix_string<4>   b_st_id;
     var_string<100> b_name;
     int32_t         b_num_trades;
@@ -227,11 +349,26 @@ struct broker_row {
 
 // Customer tables 2/2
 
-struct customer_account_key {
-    int64_t ca_id;
+struct customer_account_key_bare {
+    uint64_t ca_id;
+
+    explicit customer_account_key_bare(uint64_t id) : ca_id(bswap(id)) {}
+    friend masstree_key_adapter<customer_account_key_bare>;
+private:
+    customer_account_key_bare() = default;
 };
 
+typedef masstree_key_adapter<customer_account_key_bare> customer_account_key;
+
 struct customer_account_row {
+    enum class NamedColumn : int {
+        ca_b_id = 0,
+        ca_c_id,
+        ca_name,
+        ca_tax_st,
+        ca_bal
+    };
+
     int64_t        ca_b_id;
     int64_t        ca_c_id;
     var_string<50> ca_name;
@@ -267,11 +404,51 @@ struct trade_type_row {
     int32_t        tt_is_mrkt;
 };
 
-struct trade_key {
-    int64_t t_id;
+struct trade_key_bare {
+    uint64_t t_id;
+
+    explicit trade_key_bare(uint64_t id) : t_id(bswap(id)) {}
+    friend masstree_key_adapter<trade_key_bare>;
+private:
+    trade_key_bare() = default;
+};
+
+typedef masstree_key_adapter<trade_key_bare> trade_key;
+
+// Index of trades by account (T_CA_ID); rows are dummy_row
+struct trade_ca_key_bare {
+    uint64_t t_ca_id;
+    uint64_t t_id;
+
+    explicit trade_ca_key_bare(uint64_t ca_id, uint64_t id) : t_ca_id(bswap(ca_id)), t_id(bswap(id)) {}
+    uint64_t get_t_id() const {
+        return bswap(t_id);
+    }
+    friend masstree_key_adapter<trade_ca_key_bare>;
+private:
+    trade_ca_key_bare() = default;
 };
 
+typedef masstree_key_adapter<trade_ca_key_bare> trade_ca_key;
+
 struct trade_row {
+    enum class NamedColumn : int {
+        t_dts = 0,
+        t_st_id,
+        t_tt_id,
+        t_is_cash,
+        t_s_symb,
+        t_qty,
+        t_bid_price,
+        t_ca_id,
+        t_exec_name,
+        t_trade_price,
+        t_chrg,
+        t_comm,
+        t_tax,
+        t_lifo
+    };
+
     uint32_t       t_dts;
     fix_string<4>  t_st_id;
     fix_string<3>  t_tt_id;
@@ -288,31 +465,67 @@ struct trade_row {
     int32_t        t_lifo;
 };
 
-struct settlement_key {
-    int64_t se_t_id;
+struct settlement_key_bare {
+    uint64_t se_t_id;
+
+    explicit settlement_key_bare(uint64_t id) : se_t_id(bswap(id)) {}
+    friend masstree_key_adapter<settlement_key_bare>;
+private:
+    settlement_key_bare() = default;
 };
 
+typedef masstree_key_adapter<settlement_key_bare> settlement_key;
+
 struct settlement_row {
+    enum class NamedColumn : int {
+        se_cash_type = 0,
+        se_cash_due_date,
+        se_amt
+    };
+
     var_string<40> se_cash_type;
     uint32_t       se_cash_due_date;
     float          se_amt;
 };
 
-struct trade_history_key {
-    int64_t       th_t_id;
+struct __attribute__((packed)) trade_history_key_bare {
+    uint64_t      th_t_id;
     fix_string<4> th_st_id;
+
+    explicit trade_history_key_bare(uint64_t t_id, const char* st_id) : th_t_id(bswap(t_id)), th_st_id(st_id) {}
+    friend masstree_key_adapter<trade_history_key_bare>;
+private:
+    trade_history_key_bare() = default;
 };
 
+typedef masstree_key_adapter<trade_history_key_bare> trade_history_key;
+
 struct trade_history_row {
+    enum class NamedColumn : int {
+        th_dts = 0
+    };
+
     uint32_t th_dts;
 };
 
-struct holding_summary_key {
-    int64_t hs_ca_id;
-    fix_string<15> hs_s_symb;
+struct __attribute__((packed)) holding_summary_key_bare {
+    uint64_t    hs_ca_id;
+    symbol_type hs_s_symb;
+
+    explicit holding_summary_key_bare(uint64_t ca_id, const symbol_type& symb)
+        : hs_ca_id(bswap(ca_id)), hs_s_symb(symb) {}
+    friend masstree_key_adapter<holding_summary_key_bare>;
+private:
+    holding_summary_key_bare() = default;
 };
 
+typedef masstree_key_adapter<holding_summary_key_bare> holding_summary_key;
+
 struct holding_summary_row {
+    enum class NamedColumn : int {
+        hs_qty = 0
+    };
+
     int32_t hs_qty;
 };
 
@@ -346,11 +559,20 @@ struct watch_list_row {
     int64_t wl_c_id;
 };
 
-struct watch_item_key {
-    int64_t        wi_wl_id;
-    fix_string<15> wi_s_symb;
+// Rows are dummy_row
+struct __attribute__((packed)) watch_item_key_bare {
+    uint64_t    wi_wl_id;
+    symbol_type wi_s_symb;
+
+    explicit watch_item_key_bare(uint64_t wl_id, const symbol_type& symb)
+        : wi_wl_id(bswap(wl_id)), wi_s_symb(symb) {}
+    friend masstree_key_adapter<watch_item_key_bare>;
+private:
+    watch_item_key_bare() = default;
 };
 
+typedef masstree_key_adapter<watch_item_key_bare> watch_item_key;
+
 // Broker tables 3/3
 
 struct cash_transaction_key {
@@ -384,11 +606,32 @@ struct commission_rate_row {
     float   cr_rate;
 };
 
-struct trade_request_key {
-    int64_t tr_t_id;
+// By security first: Market-Feed looks for the requests its prices trigger
+struct __attribute__((packed)) trade_request_key_bare {
+    symbol_type tr_s_symb;
+    uint64_t    tr_t_id;
+
+    explicit trade_request_key_bare(const symbol_type& symb, uint64_t t_id)
+        : tr_s_symb(symb), tr_t_id(bswap(t_id)) {}
+    uint64_t get_t_id() const {
+        return bswap(tr_t_id);
+    }
+    friend masstree_key_adapter<trade_request_key_bare>;
+private:
+    trade_request_key_bare() = default;
 };
 
+typedef masstree_key_adapter<trade_request_key_bare> trade_request_key;
+
 struct trade_request_row {
+    enum class NamedColumn : int {
+        tr_tt_id = 0,
+        tr_s_symb,
+        tr_qty,
+        tr_bid_price,
+        tr_ca_id
+    };
+
     fix_string<3>  tr_tt_id;
     fix_string<15> tr_s_symb;
     int32_t        tr_qty;
@@ -0,0 +1,624 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+#include "TPCE_bench.hh"
+
+namespace tpce {
+
+template <typename DBParams>
+void tpce_runner<DBParams>::run_txn_trade_order(uint64_t ca_id, uint64_t s_id, bool sell, bool limit,
+                                                int32_t qty, double limit_factor) {
+    typedef customer_account_row::NamedColumn ca_nc;
+    typedef customer_row::NamedColumn cu_nc;
+    typedef last_trade_row::NamedColumn lt_nc;
+    typedef holding_summary_row::NamedColumn hs_nc;
+
+    auto symb = security_symbol(s_id);
+    fix_string<3> tt_id(limit ? (sell ? "TLS" : "TLB") : (sell ? "TMS" : "TMB"));
+    uint64_t t_id = db.tbl_trades().gen_key();
+    uint32_t now = now_dts();
+
+    RWTRANSACTION {
+
+    uint64_t c_id;
+    {
+    auto [abort, result, row, value] = db.tbl_accounts().select_split_row(customer_account_key(ca_id),
+        {{ca_nc::ca_b_id, access_t::read},
+         {ca_nc::ca_c_id, access_t::read},
+         {ca_nc::ca_tax_st, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    c_id = value.ca_c_id();
+    }
+
+    int32_t tier;
+    var_string<64> exec_name;
+    {
+    auto [abort, result, row, value] = db.tbl_customers().select_split_row(customer_key(c_id),
+        {{cu_nc::c_f_name, access_t::read},
+         {cu_nc::c_tier, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    tier = value.c_tier();
+    exec_name = value.c_f_name().c_str();
+    }
+
+    float price;
+    {
+    auto [abort, result, row, value] = db.tbl_last_trades().select_split_row(last_trade_key(symb),
+        {{lt_nc::lt_price, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    price = value.lt_price();
+    }
+
+    // what a sell would leave of the holding; sells may go short
+    if (sell) {
+        auto [abort, result, row, value] = db.tbl_holding_summaries().select_split_row(
+            holding_summary_key(ca_id, symb), {{hs_nc::hs_qty, access_t::read}});
+        (void)row; (void)value; (void)result;
+        TXN_DO(abort);
+    }
+
+    auto tr = Sto::tx_alloc<trade_row>();
+    tr->t_dts = now;
+    tr->t_st_id = limit ? "PNDG" : "SBMT";
+    tr->t_tt_id = tt_id;
+    tr->t_is_cash = 1;
+    tr->t_s_symb = symb;
+    tr->t_qty = qty;
+    tr->t_bid_price = limit ? static_cast<float>(price * limit_factor) : price;
+    tr->t_ca_id = static_cast<int64_t>(ca_id);
+    tr->t_exec_name = exec_name;
+    tr->t_trade_price = 0;
+    tr->t_chrg = constants::charge[tier - 1];
+    tr->t_comm = 0;
+    tr->t_tax = 0;
+    tr->t_lifo = 1;
+
+    {
+    auto [abort, result] = db.tbl_trades().insert_row(trade_key(t_id), tr);
+    (void)result;
+    TXN_DO(abort);
+    assert(!result);
+    }
+    {
+    auto [abort, result] = db.tbl_trades_by_account().insert_row(trade_ca_key(ca_id, t_id),
+                                                                 &bench::dummy_row::row);
+    (void)result;
+    TXN_DO(abort);
+    assert(!result);
+    }
+    if (limit) {
+        auto rq = Sto::tx_alloc<trade_request_row>();
+        rq->tr_tt_id = tt_id;
+        rq->tr_s_symb = symb;
+        rq->tr_qty = qty;
+        rq->tr_bid_price = tr->t_bid_price;
+        rq->tr_ca_id = static_cast<int64_t>(ca_id);
+        auto [abort, result] = db.tbl_trade_requests().insert_row(trade_request_key(symb, t_id), rq);
+        (void)result;
+        TXN_DO(abort);
+        assert(!result);
+    }
+    {
+    auto th = Sto::tx_alloc<trade_history_row>();
+    th->th_dts = now;
+    auto [abort, result] = db.tbl_trade_history().insert_row(trade_history_key(t_id, limit ? "PNDG" : "SBMT"), th);
+    (void)result;
+    TXN_DO(abort);
+    assert(!result);
+    }
+
+    } RETRY(true);
+
+    if (!limit)
+        pending_trades.push_back(t_id);
+}
+
+template <typename DBParams>
+void tpce_runner<DBParams>::run_txn_trade_result(uint64_t t_id) {
+    typedef trade_row::NamedColumn tr_nc;
+    typedef customer_account_row::NamedColumn ca_nc;
+    typedef customer_row::NamedColumn cu_nc;
+    typedef last_trade_row::NamedColumn lt_nc;
+    typedef holding_summary_row::NamedColumn hs_nc;
+    typedef broker_row::NamedColumn br_nc;
+
+    uint32_t now = now_dts();
+
+    RWTRANSACTION {
+
+    uintptr_t trade_rid;
+    auto new_tr = Sto::tx_alloc<trade_row>();
+    {
+    auto [abort, result, row, value] = db.tbl_trades().select_split_row(trade_key(t_id),
+        {{tr_nc::t_st_id, access_t::update},
+         {tr_nc::t_dts, access_t::update},
+         {tr_nc::t_trade_price, access_t::update},
+         {tr_nc::t_comm, access_t::update},
+         {tr_nc::t_tt_id, access_t::read},
+         {tr_nc::t_s_symb, access_t::read},
+         {tr_nc::t_qty, access_t::read},
+         {tr_nc::t_ca_id, access_t::read},
+         {tr_nc::t_chrg, access_t::read},
+         {tr_nc::t_is_cash, access_t::read}});
+    TXN_DO(abort);
+    assert(result);
+    trade_rid = row;
+    value.copy_into(new_tr);
+    }
+    uint64_t ca_id = new_tr->t_ca_id;
+    bool sell = is_sell(new_tr->t_tt_id);
+    int32_t qty = new_tr->t_qty;
+
+    float price;
+    {
+    auto [abort, result, row, value] = db.tbl_last_trades().select_split_row(last_trade_key(new_tr->t_s_symb),
+        {{lt_nc::lt_price, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    price = value.lt_price();
+    }
+
+    {
+    holding_summary_key hk(ca_id, new_tr->t_s_symb);
+    auto [abort, result, row, value] = db.tbl_holding_summaries().select_split_row(hk,
+        {{hs_nc::hs_qty, access_t::update}});
+    TXN_DO(abort);
+    int32_t hs_qty = (result ? value.hs_qty() : 0) + (sell ? -qty : qty);
+    if (result && hs_qty == 0) {
+        auto [abort, found] = db.tbl_holding_summaries().delete_row(hk);
+        (void)found;
+        TXN_DO(abort);
+    } else if (result) {
+        auto new_hs = Sto::tx_alloc<holding_summary_row>();
+        new_hs->hs_qty = hs_qty;
+        db.tbl_holding_summaries().update_row(row, new_hs);
+    } else {
+        auto new_hs = Sto::tx_alloc<holding_summary_row>();
+        new_hs->hs_qty = hs_qty;
+        auto [abort, found] = db.tbl_holding_summaries().insert_row(hk, new_hs);
+        (void)found;
+        TXN_DO(abort);
+    }
+    }
+
+    uint64_t b_id, c_id;
+    auto new_ca = Sto::tx_alloc<customer_account_row>();
+    {
+    auto [abort, result, row, value] = db.tbl_accounts().select_split_row(customer_account_key(ca_id),
+        {{ca_nc::ca_b_id, access_t::read},
+         {ca_nc::ca_c_id, access_t::read},
+         {ca_nc::ca_bal, access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    value.copy_into(new_ca);
+    b_id = new_ca->ca_b_id;
+    c_id = new_ca->ca_c_id;
+
+    int32_t tier;
+    {
+    auto [abort, result, row, value] = db.tbl_customers().select_split_row(customer_key(c_id),
+        {{cu_nc::c_tier, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    tier = value.c_tier();
+    }
+
+    float amount = price * qty;
+    new_tr->t_comm = amount * constants::commission_pct[tier - 1] / 100.0f;
+    new_ca->ca_bal += (sell ? amount : -amount) - new_tr->t_chrg - new_tr->t_comm;
+    db.tbl_accounts().update_row(row, new_ca);
+    }
+
+    {
+    auto [abort, result, row, value] = db.tbl_brokers().select_split_row(broker_key(b_id),
+        {{br_nc::b_num_trades, access_t::update},
+         {br_nc::b_comm_total, access_t::update}});
+    TXN_DO(abort);
+    assert(result);
+    auto new_br = Sto::tx_alloc<broker_row>();
+    value.copy_into(new_br);
+    new_br->b_num_trades += 1;
+    new_br->b_comm_total += new_tr->t_comm;
+    db.tbl_brokers().update_row(row, new_br);
+    }
+
+    new_tr->t_st_id = "CMPT";
+    new_tr->t_dts = now;
+    new_tr->t_trade_price = price;
+    db.tbl_trades().update_row(trade_rid, new_tr);
+
+    {
+    auto th = Sto::tx_alloc<trade_history_row>();
+    th->th_dts = now;
+    auto [abort, result] = db.tbl_trade_history().insert_row(trade_history_key(t_id, "CMPT"), th);
+    (void)result;
+    TXN_DO(abort);
+    }
+    {
+    // settles two days later
+    auto se = Sto::tx_alloc<settlement_row>();
+    se->se_cash_type = new_tr->t_is_cash ? "Cash Account" : "Margin";
+    se->se_cash_due_date = now + 2 * 86400;
+    se->se_amt = price * qty;
+    auto [abort, result] = db.tbl_settlements().insert_row(settlement_key(t_id), se);
+    (void)result;
+    TXN_DO(abort);
+    assert(!result);
+    }
+
+    } RETRY(true);
+}
+
+template <typename DBParams>
+void tpce_runner<DBParams>::run_txn_market_feed(const std::vector<std::pair<uint64_t, double>>& ticker) {
+    typedef last_trade_row::NamedColumn lt_nc;
+    typedef trade_request_row::NamedColumn rq_nc;
+    typedef trade_row::NamedColumn tr_nc;
+
+    uint32_t now = now_dts();
+    std::vector<uint64_t> triggered;
+
+    RWTRANSACTION {
+
+    triggered.clear();
+    for (auto& [s_id, change] : ticker) {
+        auto symb = security_symbol(s_id);
+
+        float price;
+        {
+        auto [abort, result, row, value] = db.tbl_last_trades().select_split_row(last_trade_key(symb),
+            {{lt_nc::lt_dts, access_t::update},
+             {lt_nc::lt_price, access_t::update},
+             {lt_nc::lt_vol, access_t::update}});
+        TXN_DO(abort);
+        assert(result);
+        auto new_lr = Sto::tx_alloc<last_trade_row>();
+        value.copy_into(new_lr);
+        new_lr->lt_price = std::max(static_cast<float>(new_lr->lt_price * change), 1.0f);
+        new_lr->lt_vol += 100;
+        new_lr->lt_dts = now;
+        db.tbl_last_trades().update_row(row, new_lr);
+        price = new_lr->lt_price;
+        }
+
+        // limit orders the new price triggers
+        std::vector<uint64_t> hits;
+        auto scan_callback = [&] (const trade_request_key& key, const auto& scan_value) -> bool {
+            auto rq = (typename db_type::rq_table_type::accessor_t)(scan_value);
+            if (is_sell(rq.tr_tt_id()) ? rq.tr_bid_price() <= price : rq.tr_bid_price() >= price)
+                hits.push_back(key.get_t_id());
+            return true;
+        };
+        bool scan_success = db.tbl_trade_requests()
+                .template range_scan<decltype(scan_callback), false/*reverse*/>(
+                        trade_request_key(symb, 0), trade_request_key(symb, std::numeric_limits<uint64_t>::max()),
+                        scan_callback, {{rq_nc::tr_tt_id, access_t::read}, {rq_nc::tr_bid_price, access_t::read}});
+        TXN_DO(scan_success);
+
+        for (auto t_id : hits) {
+            {
+            auto [abort, found] = db.tbl_trade_requests().delete_row(trade_request_key(symb, t_id));
+            (void)found;
+            TXN_DO(abort);
+            }
+            {
+            auto [abort, result, row, value] = db.tbl_trades().select_split_row(trade_key(t_id),
+                {{tr_nc::t_st_id, access_t::update},
+                 {tr_nc::t_dts, access_t::update}});
+            TXN_DO(abort);
+            assert(result);
+            auto new_tr = Sto::tx_alloc<trade_row>();
+            value.copy_into(new_tr);
+            new_tr->t_st_id = "SBMT";
+            new_tr->t_dts = now;
+            db.tbl_trades().update_row(row, new_tr);
+            }
+            {
+            auto th = Sto::tx_alloc<trade_history_row>();
+            th->th_dts = now;
+            auto [abort, result] = db.tbl_trade_history().insert_row(trade_history_key(t_id, "SBMT"), th);
+            (void)result;
+            TXN_DO(abort);
+            }
+            triggered.push_back(t_id);
+        }
+    }
+
+    } RETRY(true);
+
+    pending_trades.insert(pending_trades.end(), triggered.begin(), triggered.end());
+}
+
+template <typename DBParams>
+void tpce_runner<DBParams>::run_txn_customer_position(uint64_t c_id) {
+    typedef customer_row::NamedColumn cu_nc;
+    typedef customer_account_row::NamedColumn ca_nc;
+    typedef holding_summary_row::NamedColumn hs_nc;
+    typedef last_trade_row::NamedColumn lt_nc;
+
+    auto& scale = db.scale();
+    var_string<30> out_l_name, out_f_name;
+    float out_cash = 0, out_assets = 0;
+    (void)out_cash; (void)out_assets;
+
+    ROTRANSACTION {
+
+    {
+    auto [abort, result, row, value] = db.tbl_customers().select_split_row(customer_key(c_id),
+        {{cu_nc::c_st_id, access_t::read},
+         {cu_nc::c_l_name, access_t::read},
+         {cu_nc::c_f_name, access_t::read},
+         {cu_nc::c_tier, access_t::read},
+         {cu_nc::c_dob, access_t::read},
+         {cu_nc::c_email_1, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    out_l_name = value.c_l_name();
+    out_f_name = value.c_f_name();
+    }
+
+    out_cash = 0;
+    out_assets = 0;
+    std::vector<uint64_t> accounts;
+    auto ca_callback = [&] (const customer_account_key& key, const auto& scan_value) -> bool {
+        auto ca = (typename db_type::ca_table_type::accessor_t)(scan_value);
+        out_cash += ca.ca_bal();
+        accounts.push_back(bswap(key.ca_id));
+        return true;
+    };
+    bool scan_success = db.tbl_accounts().template range_scan<decltype(ca_callback), false/*reverse*/>(
+            customer_account_key(scale.account_of(c_id, 0)),
+            customer_account_key(scale.account_of(c_id, constants::accounts_per_customer - 1)),
+            ca_callback, {{ca_nc::ca_bal, access_t::read}});
+    TXN_DO(scan_success);
+
+    std::vector<std::pair<symbol_type, int32_t>> holdings;
+    for (auto ca_id : accounts) {
+        holdings.clear();
+        auto hs_callback = [&] (const holding_summary_key& key, const auto& scan_value) -> bool {
+            auto hs = (typename db_type::hs_table_type::accessor_t)(scan_value);
+            holdings.emplace_back(key.hs_s_symb, hs.hs_qty());
+            return true;
+        };
+        scan_success = db.tbl_holding_summaries().template range_scan<decltype(hs_callback), false/*reverse*/>(
+                holding_summary_key(ca_id, symbol_lo()), holding_summary_key(ca_id, symbol_hi()),
+                hs_callback, {{hs_nc::hs_qty, access_t::read}});
+        TXN_DO(scan_success);
+
+        for (auto& [symb, qty] : holdings) {
+            auto [abort, result, row, value] = db.tbl_last_trades().select_split_row(last_trade_key(symb),
+                {{lt_nc::lt_price, access_t::read}});
+            (void)row;
+            TXN_DO(abort);
+            assert(result);
+            out_assets += value.lt_price() * qty;
+        }
+    }
+
+    } RETRY(true);
+}
+
+template <typename DBParams>
+void tpce_runner<DBParams>::run_txn_trade_status(uint64_t ca_id) {
+    typedef customer_account_row::NamedColumn ca_nc;
+    typedef customer_row::NamedColumn cu_nc;
+    typedef broker_row::NamedColumn br_nc;
+    typedef trade_row::NamedColumn tr_nc;
+    typedef security_row::NamedColumn se_nc;
+
+    var_string<70> out_s_name;
+    var_string<100> out_b_name;
+    var_string<30> out_l_name;
+    fix_string<4> out_st_id;
+
+    ROTRANSACTION {
+
+    std::vector<uint64_t> trades;
+    auto scan_callback = [&] (const trade_ca_key& key, const auto&) -> bool {
+        trades.push_back(key.get_t_id());
+        return true;
+    };
+    trade_ca_key upper(ca_id, std::numeric_limits<uint64_t>::max());
+    bool scan_success = db.tbl_trades_by_account().scan_last_n(upper, offsetof(trade_ca_key, t_id),
+            constants::trade_status_rows, scan_callback, RowAccess::ObserveExists);
+    TXN_DO(scan_success);
+
+    for (auto t_id : trades) {
+        symbol_type symb;
+        {
+        auto [abort, result, row, value] = db.tbl_trades().select_split_row(trade_key(t_id),
+            {{tr_nc::t_dts, access_t::read},
+             {tr_nc::t_st_id, access_t::read},
+             {tr_nc::t_tt_id, access_t::read},
+             {tr_nc::t_is_cash, access_t::read},
+             {tr_nc::t_s_symb, access_t::read},
+             {tr_nc::t_qty, access_t::read},
+             {tr_nc::t_exec_name, access_t::read},
+             {tr_nc::t_chrg, access_t::read}});
+        (void)row;
+        TXN_DO(abort);
+        assert(result);
+        symb = value.t_s_symb();
+        out_st_id = value.t_st_id();
+        }
+        auto [abort, result, row, value] = db.tbl_securities().select_split_row(security_key(symb),
+            {{se_nc::s_name, access_t::read},
+             {se_nc::s_ex_id, access_t::read}});
+        (void)row;
+        TXN_DO(abort);
+        assert(result);
+        out_s_name = value.s_name();
+    }
+
+    uint64_t b_id, c_id;
+    {
+    auto [abort, result, row, value] = db.tbl_accounts().select_split_row(customer_account_key(ca_id),
+        {{ca_nc::ca_b_id, access_t::read},
+         {ca_nc::ca_c_id, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    b_id = value.ca_b_id();
+    c_id = value.ca_c_id();
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_customers().select_split_row(customer_key(c_id),
+        {{cu_nc::c_l_name, access_t::read},
+         {cu_nc::c_f_name, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    out_l_name = value.c_l_name();
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_brokers().select_split_row(broker_key(b_id),
+        {{br_nc::b_name, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    out_b_name = value.b_name();
+    }
+
+    } RETRY(true);
+}
+
+template <typename DBParams>
+void tpce_runner<DBParams>::run_txn_security_detail(uint64_t s_id, uint32_t start_day, int ndays) {
+    typedef security_row::NamedColumn se_nc;
+    typedef company_row::NamedColumn co_nc;
+    typedef daily_market_row::NamedColumn dm_nc;
+    typedef last_trade_row::NamedColumn lt_nc;
+
+    auto symb = security_symbol(s_id);
+    var_string<60> out_co_name;
+    float out_close = 0, out_price = 0;
+    (void)out_close; (void)out_price;
+
+    ROTRANSACTION {
+
+    uint64_t co_id;
+    {
+    auto [abort, result, row, value] = db.tbl_securities().select_split_row(security_key(symb),
+        {{se_nc::s_name, access_t::read},
+         {se_nc::s_ex_id, access_t::read},
+         {se_nc::s_co_id, access_t::read},
+         {se_nc::s_num_out, access_t::read},
+         {se_nc::s_pe, access_t::read},
+         {se_nc::s_52wk_high, access_t::read},
+         {se_nc::s_52wk_low, access_t::read},
+         {se_nc::s_dividend, access_t::read},
+         {se_nc::s_yield, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    co_id = value.s_co_id();
+    }
+    {
+    auto [abort, result, row, value] = db.tbl_companies().select_split_row(company_key(co_id),
+        {{co_nc::co_name, access_t::read},
+         {co_nc::co_ceo, access_t::read},
+         {co_nc::co_desc, access_t::read},
+         {co_nc::co_sp_rate, access_t::read},
+         {co_nc::co_open_date, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    out_co_name = value.co_name();
+    }
+
+    auto scan_callback = [&] (const daily_market_key&, const auto& scan_value) -> bool {
+        auto dm = (typename db_type::dm_table_type::accessor_t)(scan_value);
+        out_close = dm.dm_close();
+        return true;
+    };
+    bool scan_success = db.tbl_daily_market().template range_scan<decltype(scan_callback), false/*reverse*/>(
+            daily_market_key(symb, start_day), daily_market_key(symb, start_day + ndays - 1), scan_callback,
+            {{dm_nc::dm_close, access_t::read},
+             {dm_nc::dm_high, access_t::read},
+             {dm_nc::dm_low, access_t::read},
+             {dm_nc::dm_vol, access_t::read}}, true, ndays);
+    TXN_DO(scan_success);
+
+    {
+    auto [abort, result, row, value] = db.tbl_last_trades().select_split_row(last_trade_key(symb),
+        {{lt_nc::lt_price, access_t::read},
+         {lt_nc::lt_open_price, access_t::read},
+         {lt_nc::lt_vol, access_t::read}});
+    (void)row;
+    TXN_DO(abort);
+    assert(result);
+    out_price = value.lt_price();
+    }
+
+    } RETRY(true);
+}
+
+template <typename DBParams>
+void tpce_runner<DBParams>::run_txn_market_watch(uint64_t c_id, uint32_t start_day) {
+    typedef last_trade_row::NamedColumn lt_nc;
+    typedef security_row::NamedColumn se_nc;
+    typedef daily_market_row::NamedColumn dm_nc;
+
+    double out_pct_change = 0;
+    (void)out_pct_change;
+
+    ROTRANSACTION {
+
+    std::vector<symbol_type> symbols;
+    auto scan_callback = [&] (const watch_item_key& key, const auto&) -> bool {
+        symbols.push_back(key.wi_s_symb);
+        return true;
+    };
+    bool scan_success = db.tbl_watch_items().template range_scan<decltype(scan_callback), false/*reverse*/>(
+            watch_item_key(c_id, symbol_lo()), watch_item_key(c_id, symbol_hi()), scan_callback,
+            RowAccess::ObserveExists);
+    TXN_DO(scan_success);
+
+    double old_cap = 0, new_cap = 0;
+    for (auto& symb : symbols) {
+        float price, close;
+        int64_t num_out;
+        {
+        auto [abort, result, row, value] = db.tbl_last_trades().select_split_row(last_trade_key(symb),
+            {{lt_nc::lt_price, access_t::read}});
+        (void)row;
+        TXN_DO(abort);
+        assert(result);
+        price = value.lt_price();
+        }
+        {
+        auto [abort, result, row, value] = db.tbl_securities().select_split_row(security_key(symb),
+            {{se_nc::s_num_out, access_t::read}});
+        (void)row;
+        TXN_DO(abort);
+        assert(result);
+        num_out = value.s_num_out();
+        }
+        {
+        auto [abort, result, row, value] = db.tbl_daily_market().select_split_row(daily_market_key(symb, start_day),
+            {{dm_nc::dm_close, access_t::read}});
+        (void)row;
+        TXN_DO(abort);
+        assert(result);
+        close = value.dm_close();
+        }
+        old_cap += double(num_out) * close;
+        new_cap += double(num_out) * price;
+    }
+    out_pct_change = old_cap != 0 ? 100.0 * (new_cap / old_cap - 1) : 0;
+
+    } RETRY(true);
+}
+
+}; // namespace tpce
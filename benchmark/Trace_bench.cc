@@ -0,0 +1,301 @@
+#include <sstream>
+#include <thread>
+#include <clp.h>
+
+#include "Trace_bench.hh"
+#include "Trace_txns.hh"
+
+#include "DB_profiler.hh"
+#include "DB_loader.hh"
+
+using db_params::constants;
+using db_params::db_params_id;
+using db_params::db_default_params;
+using db_params::db_opaque_params;
+using db_params::db_2pl_params;
+using db_params::db_adaptive_params;
+using db_params::db_swiss_params;
+using db_params::db_tictoc_params;
+using db_params::db_mvcc_params;
+using db_params::db_det_params;
+using db_params::parse_dbid;
+
+// @section: clp parser definitions
+enum {
+    opt_trace = 1, opt_dbid, opt_nthrs, opt_time, opt_gc, opt_perf, opt_pfcnt
+};
+
+static const Clp_Option options[] = {
+        { "trace",        'f', opt_trace, Clp_ValString, Clp_Optional },
+        { "dbid",         'i', opt_dbid,  Clp_ValString, Clp_Optional },
+        { "nthreads",     't', opt_nthrs, Clp_ValInt,    Clp_Optional },
+        { "time",         'l', opt_time,  Clp_ValDouble, Clp_Optional },
+        { "garbage-collect", 'g', opt_gc, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "perf",         'p', opt_perf,  Clp_NoVal,     Clp_Optional },
+        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional }
+};
+
+static inline void print_usage(const char *argv_0) {
+    std::stringstream ss;
+    ss << "Usage of " << std::string(argv_0) << ":" << std::endl
+       << "  --trace=<PATH> (or -f<PATH>)" << std::endl
+       << "    Replay the access trace at PATH (DB_trace.hh), written by bench::trace_writer or" << std::endl
+       << "    captured with bench::trace_recorder. Required." << std::endl
+       << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
+       << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
+       << "      default, opaque, 2pl, adaptive, swiss, tictoc, mvcc, det" << std::endl
+       << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
+       << "    Specify the number of parallel worker threads (default 1). The trace is split into" << std::endl
+       << "    that many runs of whole transactions, each replayed by one thread in a cycle." << std::endl
+       << "  --time=<NUM> (or -l<NUM>)" << std::endl
+       << "    Specify the time (duration) for which the benchmark is run (default 10 seconds)." << std::endl
+       << "  --garbage-collect (or -g)" << std::endl
+       << "    Enable garbage collection/epoch advancer thread." << std::endl
+       << "  --perf (or -p)" << std::endl
+       << "    Spawns perf profiler in record mode for the duration of the benchmark run." << std::endl
+       << "  --perf-counter (or -c)" << std::endl
+       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl;
+    std::cout << ss.str() << std::flush;
+}
+
+struct cmd_params {
+    db_params::db_params_id db_id;
+    const char* trace_path;
+    int num_threads;
+    double time;
+    bool enable_gc;
+    bool spawn_perf;
+    bool perf_counter_mode;
+
+    explicit cmd_params()
+            : db_id(db_params::db_params_id::Default), trace_path(nullptr),
+              num_threads(1), time(10.0), enable_gc(false),
+              spawn_perf(false), perf_counter_mode(false) {}
+};
+
+// @endsection: clp parser definitions
+
+template <typename DBParams>
+class bench_access {
+public:
+    using db_type = trace::trace_db<DBParams>;
+    using runner_type = trace::trace_runner<DBParams>;
+    using profiler_type = bench::db_profiler;
+
+    static void runner_thread(int id, db_type& db, const bench::trace_file& file,
+                              bench::trace_file::range_type part, uint64_t time_limit,
+                              size_t& txn_cnt) {
+        ::TThread::set_id(id);
+        set_affinity(id);
+        db.thread_init_all();
+        runner_type r(id, db, file, part);
+        size_t n = 0;
+        if (part.first != part.second) {
+            auto tsc_begin = read_tsc();
+            while (read_tsc() - tsc_begin < time_limit) {
+                r.run_txn(r.next_txn());
+                ++n;
+            }
+        }
+        txn_cnt = n;
+    }
+
+    static void det_runner_thread(int id, db_type& db, const bench::trace_file& file,
+                                  bench::trace_file::range_type part, uint64_t time_limit,
+                                  bench::det_engine<trace::trace_txn>& engine, size_t& txn_cnt) {
+        ::TThread::set_id(id);
+        set_affinity(id);
+        db.thread_init_all();
+        runner_type r(id, db, file, part);
+        auto tsc_begin = read_tsc();
+        txn_cnt = engine.run(id,
+            [&] (trace::trace_txn& txn, bench::det_lockset& locks) {
+                txn = r.next_txn();
+                r.det_declare(txn, locks);
+            },
+            [&] (trace::trace_txn& txn) {
+                r.det_run_txn(txn);
+            },
+            [&] { return read_tsc() - tsc_begin >= time_limit; });
+    }
+
+    static int execute(cmd_params p, const bench::trace_file& file) {
+        if (DBParams::Deterministic && file.count(bench::trace_op::scan)) {
+            std::cerr << "Traces with scans can't run in deterministic mode." << std::endl;
+            return 1;
+        }
+        uint64_t time_limit = (uint64_t)(p.time * constants::processor_tsc_frequency * constants::billion);
+        auto parts = file.partition(p.num_threads);
+        for (auto& part : parts)
+            if (part.first == part.second) {
+                std::cerr << "Warning: fewer transactions than threads; some threads stay idle." << std::endl;
+                break;
+            }
+
+        // Create DB
+        auto& db = *(new db_type(file.header().ntables));
+
+        // Load DB, each runner's part of the trace
+        bench::db_loader("trace", p.num_threads, p.num_threads, [](int part) { return part; }).run([&](int part) {
+                db.thread_init_all();
+                return db.load(parts[part].first, parts[part].second);
+            });
+
+        // Start the GC thread if necessary
+        std::thread advancer;
+        std::cout << "Garbage collection: " << (p.enable_gc ? "enabled" : "disabled") << std::endl;
+        if (p.enable_gc) {
+            advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+        }
+
+        // Execute benchmark
+        std::vector<std::thread> runner_threads;
+        std::vector<size_t> committed_txn_cnts((size_t)p.num_threads, 0);
+        std::unique_ptr<bench::det_engine<trace::trace_txn>> engine;
+        if (DBParams::Deterministic)
+            engine.reset(new bench::det_engine<trace::trace_txn>(p.num_threads));
+
+        profiler_type profiler(p.spawn_perf);
+        profiler.describe<DBParams>("trace", p.num_threads);
+        profiler.config("trace", std::string(p.trace_path));
+        profiler.config("time_limit", p.time);
+        profiler.config("gc", p.enable_gc);
+        profiler.config("tables", file.header().ntables);
+        profiler.config("records", file.size());
+        profiler.config("txns", file.header().ntxns);
+        profiler.start(p.perf_counter_mode ? Profiler::perf_mode::counters : Profiler::perf_mode::record);
+
+        for (int t = 0; t < p.num_threads; ++t) {
+            if constexpr (DBParams::Deterministic) {
+                runner_threads.push_back(
+                        std::thread(det_runner_thread, t, std::ref(db), std::ref(file), parts[t], time_limit,
+                                    std::ref(*engine), std::ref(committed_txn_cnts[t])));
+            } else {
+                runner_threads.push_back(
+                        std::thread(runner_thread, t, std::ref(db), std::ref(file), parts[t], time_limit,
+                                    std::ref(committed_txn_cnts[t])));
+            }
+        }
+        for (auto& t : runner_threads) {
+            t.join();
+        }
+
+        size_t total_commit_txns = 0;
+        for (auto c : committed_txn_cnts)
+            total_commit_txns += c;
+
+        profiler.finish(total_commit_txns);
+
+        Transaction::rcu_release_all(advancer, p.num_threads);
+
+        delete (&db);
+        return 0;
+    }
+};
+
+double constants::processor_tsc_frequency;
+
+int main(int argc, const char * const *argv) {
+    cmd_params params;
+
+    Sto::global_init();
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+
+    int ret_code = 0;
+    int opt;
+    bool clp_stop = false;
+    while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
+        switch (opt) {
+            case opt_trace:
+                params.trace_path = clp->val.s;
+                break;
+            case opt_dbid:
+                params.db_id = parse_dbid(clp->val.s);
+                if (params.db_id == db_params::db_params_id::None) {
+                    std::cout << "Unsupported DB CC id: "
+                              << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                    print_usage(argv[0]);
+                    ret_code = 1;
+                    clp_stop = true;
+                }
+                break;
+            case opt_nthrs:
+                params.num_threads = clp->val.i;
+                break;
+            case opt_time:
+                params.time = clp->val.d;
+                break;
+            case opt_gc:
+                params.enable_gc = !clp->negated;
+                break;
+            case opt_perf:
+                params.spawn_perf = !clp->negated;
+                break;
+            case opt_pfcnt:
+                params.perf_counter_mode = !clp->negated;
+                break;
+            default:
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+                break;
+        }
+    }
+
+    std::string trace_path = params.trace_path ? params.trace_path : "";
+    Clp_DeleteParser(clp);
+    if (ret_code != 0)
+        return ret_code;
+    if (trace_path.empty() || params.num_threads < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    params.trace_path = trace_path.c_str();
+
+    bench::trace_file file(trace_path);
+    if (!file.ok()) {
+        std::cerr << "Can't read trace " << trace_path << std::endl;
+        return 1;
+    }
+    std::cout << "Trace: " << file.header().ntxns << " transactions, " << file.size() << " records, "
+              << file.header().ntables << " tables" << std::endl;
+
+    auto cpu_freq = determine_cpu_freq();
+    if (cpu_freq == 0.0)
+        return 1;
+    else
+        constants::processor_tsc_frequency = cpu_freq;
+
+    switch (params.db_id) {
+        case db_params_id::Default:
+            ret_code = bench_access<db_default_params>::execute(params, file);
+            break;
+        case db_params_id::Opaque:
+            ret_code = bench_access<db_opaque_params>::execute(params, file);
+            break;
+        case db_params_id::TwoPL:
+            ret_code = bench_access<db_2pl_params>::execute(params, file);
+            break;
+        case db_params_id::Adaptive:
+            ret_code = bench_access<db_adaptive_params>::execute(params, file);
+            break;
+        case db_params_id::Swiss:
+            ret_code = bench_access<db_swiss_params>::execute(params, file);
+            break;
+        case db_params_id::TicToc:
+            ret_code = bench_access<db_tictoc_params>::execute(params, file);
+            break;
+        case db_params_id::MVCC:
+            ret_code = bench_access<db_mvcc_params>::execute(params, file);
+            break;
+        case db_params_id::Deterministic:
+            ret_code = bench_access<db_det_params>::execute(params, file);
+            break;
+        default:
+            std::cerr << "unknown db config parameter id" << std::endl;
+            ret_code = 1;
+            break;
+    };
+
+    return ret_code;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "Trace_structs.hh"
+
+#include "DB_index.hh"
+#include "DB_params.hh"
+#include "DB_trace.hh"
+#include "DB_deterministic.hh"
+
+#include "trace_split_params_default.hh"
+
+namespace trace {
+
+using bench::trace_file;
+using bench::trace_op;
+using bench::trace_record;
+
+// One table per table id of the trace
+template <typename DBParams>
+class trace_db {
+public:
+    template <typename K, typename V>
+    using OIndex = typename std::conditional<
+            DBParams::MVCC,
+            mvcc_ordered_index<K, V, DBParams>,
+            ordered_index<K, V, DBParams>>::type;
+
+    typedef OIndex<trace_key, trace_row> table_type;
+
+    explicit trace_db(unsigned ntables) {
+        for (unsigned i = 0; i != ntables; ++i)
+            tables_.emplace_back(new table_type());
+    }
+
+    table_type& table(uint16_t id) {
+        return *tables_[id];
+    }
+    unsigned ntables() const {
+        return tables_.size();
+    }
+
+    void thread_init_all() {
+        for (auto& t : tables_)
+            t->thread_init();
+    }
+
+    // Loads every key that the records in [first, last) access other than
+    // by inserting; returns the number of puts
+    uint64_t load(const trace_record* first, const trace_record* last);
+
+private:
+    std::vector<std::unique_ptr<table_type>> tables_;
+};
+
+// A transaction of the trace: its records
+struct trace_txn {
+    const trace_record* begin;
+    const trace_record* end;
+};
+
+// Replays one part of a trace, from trace_file::partition(), in a cycle
+template <typename DBParams>
+class trace_runner {
+public:
+    typedef trace_db<DBParams> db_type;
+
+    trace_runner(int id, db_type& database, const trace_file& file, trace_file::range_type part)
+        : id(id), db(database), file(file), first(part.first), last(part.second), next(part.first) {}
+
+    // The part's next transaction, starting over at its end; empty if the
+    // part is
+    trace_txn next_txn() {
+        if (first == last)
+            return {first, last};
+        trace_txn txn{next, file.txn_end(next, last)};
+        next = txn.end == last ? first : txn.end;
+        return txn;
+    }
+
+    void run_txn(const trace_txn& txn);
+
+    // Deterministic mode (db_det_params): declares the locks of txn's
+    // records, then runs it with the tables' nontrans accessors once they
+    // are held. Scans aren't supported, since their keys aren't known up
+    // front.
+    void det_declare(const trace_txn& txn, bench::det_lockset& locks);
+    void det_run_txn(const trace_txn& txn);
+
+private:
+    int id;
+    db_type& db;
+    const trace_file& file;
+    const trace_record* first;
+    const trace_record* last;
+    const trace_record* next;
+};
+
+}; // namespace trace
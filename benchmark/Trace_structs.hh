@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cassert>
+#include "DB_structs.hh"
+#include "str.hh"
+
+namespace trace {
+
+using namespace bench;
+
+// The tables a trace is replayed against all have this shape: the trace's
+// 64-bit key, in key order, and one column the replay reads and writes.
+
+struct __attribute__((packed)) trace_key_bare {
+    uint64_t key;
+    explicit trace_key_bare(uint64_t p_key)
+        : key(bswap(p_key)) {}
+
+    friend masstree_key_adapter<trace_key_bare>;
+private:
+    trace_key_bare() = default;
+};
+
+typedef masstree_key_adapter<trace_key_bare> trace_key;
+
+struct trace_row {
+    enum class NamedColumn : int { val = 0 };
+
+    int64_t val;
+};
+
+}; // namespace trace
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <limits>
+
+#include "Trace_bench.hh"
+
+namespace trace {
+
+template <typename DBParams>
+uint64_t trace_db<DBParams>::load(const trace_record* first, const trace_record* last) {
+    trace_row row;
+    row.val = 0;
+    uint64_t n = 0;
+    for (auto r = first; r != last; ++r)
+        if (r->op != trace_op::insert) {
+            table(r->table).nontrans_put(trace_key(r->key), row);
+            ++n;
+        }
+    return n;
+}
+
+// Reads read the column, updates increment it, inserts overwrite any row
+// already there and scans read up to arg rows from the key (to the end
+// of the table if arg is 0). Missing rows are skipped, since a replay
+// that wraps around finds the rows the trace removed gone.
+template <typename DBParams>
+void trace_runner<DBParams>::run_txn(const trace_txn& txn) {
+    typedef trace_row::NamedColumn nc;
+    typedef typename db_type::table_type table_type;
+    int64_t output = 0;
+    bool rw = std::any_of(txn.begin, txn.end, [] (const trace_record& r) {
+            return r.op != trace_op::read && r.op != trace_op::scan;
+        });
+
+    TRANSACTION {
+        if (DBParams::MVCC && rw) {
+            Sto::mvcc_rw_upgrade();
+        }
+        for (auto r = txn.begin; r != txn.end; ++r) {
+            auto& table = db.table(r->table);
+            switch (r->op) {
+            case trace_op::read: {
+                auto [success, result, row, value]
+                    = table.select_split_row(trace_key(r->key), {{nc::val, access_t::read}});
+                (void)row;
+                TXN_DO(success);
+                if (result)
+                    output += value.val();
+                break;
+            }
+            case trace_op::update: {
+                auto [success, result, row, value]
+                    = table.select_split_row(trace_key(r->key), {{nc::val, access_t::update}});
+                TXN_DO(success);
+                if (result) {
+                    auto new_row = Sto::tx_alloc<trace_row>();
+                    new_row->val = value.val() + 1;
+                    table.update_row(row, new_row);
+                }
+                break;
+            }
+            case trace_op::insert: {
+                auto new_row = Sto::tx_alloc<trace_row>();
+                new_row->val = 0;
+                auto [success, result] = table.insert_row(trace_key(r->key), new_row, true);
+                (void)result;
+                TXN_DO(success);
+                break;
+            }
+            case trace_op::remove: {
+                auto [success, result] = table.delete_row(trace_key(r->key));
+                (void)result;
+                TXN_DO(success);
+                break;
+            }
+            case trace_op::scan: {
+                auto scan_callback = [&] (const trace_key&, const auto& scan_value) -> bool {
+                    output += ((typename table_type::accessor_t)(scan_value)).val();
+                    return true;
+                };
+                bool success = table.template range_scan<decltype(scan_callback), false/*reverse*/>(
+                        trace_key(r->key), trace_key(std::numeric_limits<uint64_t>::max()), scan_callback,
+                        {{nc::val, access_t::read}}, true, r->arg ? int(r->arg) : -1);
+                TXN_DO(success);
+                break;
+            }
+            }
+        }
+    } RETRY(true);
+    (void)output;
+}
+
+template <typename DBParams>
+void trace_runner<DBParams>::det_declare(const trace_txn& txn, bench::det_lockset& locks) {
+    for (auto r = txn.begin; r != txn.end; ++r) {
+        // keys of different tables can share a lock, which only orders
+        // more transactions than necessary
+        uint64_t key = r->key ^ (uint64_t(r->table) << 48);
+        if (r->op == trace_op::read)
+            locks.read(key);
+        else
+            locks.write(key);
+    }
+}
+
+template <typename DBParams>
+void trace_runner<DBParams>::det_run_txn(const trace_txn& txn) {
+    int64_t output = 0;
+    for (auto r = txn.begin; r != txn.end; ++r) {
+        auto& table = db.table(r->table);
+        switch (r->op) {
+        case trace_op::read:
+            if (trace_row* v = table.nontrans_get(trace_key(r->key)))
+                output += v->val;
+            break;
+        case trace_op::update:
+            if (trace_row* v = table.nontrans_get(trace_key(r->key)))
+                ++v->val;
+            break;
+        case trace_op::insert: {
+            trace_row row;
+            row.val = 0;
+            table.nontrans_put(trace_key(r->key), row);
+            break;
+        }
+        case trace_op::remove:
+            table.nontrans_remove(trace_key(r->key));
+            break;
+        case trace_op::scan:
+            always_assert(false, "scans can't run in deterministic mode");
+            break;
+        }
+    }
+    (void)output;
+}
+
+}; // namespace trace
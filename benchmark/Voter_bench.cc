@@ -18,13 +18,14 @@ using db_params::parse_dbid;
 
 // @section: clp parser definitions
 enum {
-    opt_dbid = 1, opt_nthrs, opt_time, opt_perf, opt_pfcnt
+    opt_dbid = 1, opt_nthrs, opt_time, opt_tally, opt_perf, opt_pfcnt
 };
 
 static const Clp_Option options[] = {
         { "dbid",         'i', opt_dbid,  Clp_ValString, Clp_Optional },
         { "nthreads",     't', opt_nthrs, Clp_ValInt,    Clp_Optional },
         { "time",         'l', opt_time,  Clp_ValDouble, Clp_Optional },
+        { "tally",        'y', opt_tally, Clp_ValString, Clp_Optional },
         { "perf",         'p', opt_perf,  Clp_NoVal,     Clp_Optional },
         { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate| Clp_Optional }
 };
@@ -39,6 +40,10 @@ static inline void print_usage(const char *argv_0) {
        << "    Specify the number of parallel worker threads (default 1)." << std::endl
        << "  --time=<NUM> (or -l<NUM>)" << std::endl
        << "    Specify the time (duration) for which the benchmark is run (default 10 seconds)." << std::endl
+       << "  --tally=<STRING> (or -y<STRING>)" << std::endl
+       << "    Specify how votes by contestant and state are counted. Can be one of the followings:" << std::endl
+       << "      row (one view row each, default), sharded (one commutative counter per thread each)," << std::endl
+       << "      compare (run row, then sharded, and report the speedup)" << std::endl
        << "  --perf (or -p)" << std::endl
        << "    Spawns perf profiler in record mode for the duration of the benchmark run." << std::endl
        << "  --perf-counter (or -c)" << std::endl
@@ -46,19 +51,36 @@ static inline void print_usage(const char *argv_0) {
     std::cout << ss.str() << std::flush;
 }
 
+enum class tally_mode : int { Row = 0, Sharded, Compare };
+
 struct cmd_params {
     db_params::db_params_id db_id;
     int num_threads;
     double time;
+    tally_mode tally;
     bool spwan_perf;
     bool perf_counter_mode;
 
     explicit cmd_params()
             : db_id(db_params::db_params_id::Default),
-              num_threads(1), time(10.0),
+              num_threads(1), time(10.0), tally(tally_mode::Row),
               spwan_perf(false), perf_counter_mode(false) {}
 };
 
+static bool parse_tally(const char* s, tally_mode& mode) {
+    if (s == nullptr)
+        return false;
+    if (strcmp(s, "row") == 0)
+        mode = tally_mode::Row;
+    else if (strcmp(s, "sharded") == 0)
+        mode = tally_mode::Sharded;
+    else if (strcmp(s, "compare") == 0)
+        mode = tally_mode::Compare;
+    else
+        return false;
+    return true;
+}
+
 // @endsection: clp parser definitions
 
 template <typename DBParams>
@@ -75,8 +97,24 @@ public:
     }
 
     static int execute(cmd_params p) {
+        if (p.tally != tally_mode::Compare) {
+            run(p, p.tally == tally_mode::Sharded);
+            return 0;
+        }
+        std::cout << "=== Tally: row" << std::endl;
+        double row_tput = run(p, false);
+        std::cout << "=== Tally: sharded" << std::endl;
+        Transaction::clear_stats();
+        double sharded_tput = run(p, true);
+        std::cout << "Speedup (sharded/row): " << std::fixed << std::setprecision(2)
+                  << sharded_tput / row_tput << "x" << std::endl;
+        return 0;
+    }
+
+    // Returns the throughput in txns/ms
+    static double run(const cmd_params& p, bool sharded) {
         // Create DB
-        auto& db = *(new db_type());
+        auto& db = *(new db_type(p.num_threads));
 
         // Load DB
         loader_type loader(db);
@@ -88,9 +126,13 @@ public:
         std::vector<size_t> committed_txn_cnts((size_t)p.num_threads, 0);
 
         for (int id = 0; id < p.num_threads; ++id)
-            runners.push_back(runner_type(id, db, p.time));
+            runners.push_back(runner_type(id, db, p.time, sharded));
 
+        bench::latency_profile::name_types({"Vote"});
         profiler_type profiler(p.spwan_perf);
+        profiler.describe<DBParams>("voter", p.num_threads);
+        profiler.config("time_limit", p.time);
+        profiler.config("tally", sharded ? "sharded" : "row");
         profiler.start(p.perf_counter_mode ? Profiler::perf_mode::counters : Profiler::perf_mode::record);
 
         for (int t = 0; t < p.num_threads; ++t)
@@ -104,10 +146,19 @@ public:
         for (auto c : committed_txn_cnts)
             total_commit_txns += c;
 
-        profiler.finish(total_commit_txns);
+        double elapsed_ms = profiler.finish(total_commit_txns);
+
+        if (sharded) {
+            ::TThread::set_id(0);
+            auto votes = runners[0].run_txn_results();
+            std::cout << "Votes by contestant:";
+            for (auto v : votes)
+                std::cout << " " << v;
+            std::cout << std::endl;
+        }
 
         delete (&db);
-        return 0;
+        return total_commit_txns / elapsed_ms;
     }
 };
 
@@ -143,6 +194,15 @@ int main(int argc, const char * const *argv) {
             case opt_time:
                 params.time = clp->val.d;
                 break;
+            case opt_tally:
+                if (!parse_tally(clp->val.s, params.tally)) {
+                    std::cout << "Unsupported tally mode: "
+                              << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                    print_usage(argv[0]);
+                    ret_code = 1;
+                    clp_stop = true;
+                }
+                break;
             case opt_perf:
                 params.spwan_perf = !clp->negated;
                 break;
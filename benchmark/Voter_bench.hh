@@ -1,10 +1,13 @@
 #pragma once
 
+#include <array>
 #include <iomanip>
+#include <memory>
 #include <PlatformFeatures.hh>
 #include "sampling.hh"
 #include "Voter_structs.hh"
 #include "DB_index.hh"
+#include "DB_latency.hh"
 #include "DB_params.hh"
 
 namespace voter {
@@ -14,6 +17,70 @@ struct constants {
     static constexpr int64_t max_votes_per_phone_number = 1000;
 };
 
+extern std::vector<std::string> area_codes;
+extern std::vector<std::string> area_code_state_map;
+extern std::vector<std::string> contestant_names;
+
+// Votes by contestant and state, kept as one commutative counter per
+// runner thread (stripe) instead of one view row, so that votes for the
+// same contestant do not conflict. Reads sum the stripes.
+template <typename DBParams>
+class sharded_tally {
+public:
+    typedef bench::TCommuteIntegerBox<DBParams> counter_type;
+
+    explicit sharded_tally(int num_stripes)
+        : num_stripes_(num_stripes), num_states_(0) {
+        state_ids_.fill(-1);
+        for (auto& st : area_code_state_map) {
+            always_assert(st.size() == 2 && isupper(st[0]) && isupper(st[1]));
+            auto& sid = state_ids_[slot(st[0], st[1])];
+            if (sid < 0)
+                sid = num_states_++;
+        }
+        counters_.reset(new padded_counter[constants::num_contestants * num_states_ * num_stripes_]);
+    }
+
+    void increment(int32_t contestant, const fix_string<2>& state) {
+        counter(contestant, state_id(state), TThread::id() % num_stripes_).increment(1);
+    }
+
+    std::pair<bool, int64_t> read(int32_t contestant) {
+        int64_t total = 0;
+        for (int st = 0; st < num_states_; ++st)
+            for (int s = 0; s < num_stripes_; ++s) {
+                auto [ok, v] = counter(contestant, st, s).read();
+                if (!ok)
+                    return {false, 0};
+                total += v;
+            }
+        return {true, total};
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) padded_counter {
+        counter_type c;
+    };
+
+    static int slot(char a, char b) {
+        return (a - 'A') * 26 + (b - 'A');
+    }
+    int state_id(const fix_string<2>& state) const {
+        int sid = state_ids_[slot(state[0], state[1])];
+        assert(sid >= 0);
+        return sid;
+    }
+    counter_type& counter(int32_t contestant, int st, int stripe) {
+        assert(contestant >= 0 && contestant < constants::num_contestants);
+        return counters_[(contestant * num_states_ + st) * num_stripes_ + stripe].c;
+    }
+
+    int num_stripes_;
+    int num_states_;
+    std::array<int, 26 * 26> state_ids_;
+    std::unique_ptr<padded_counter[]> counters_;
+};
+
 template<typename DBParams>
 class voter_db {
 public:
@@ -26,12 +93,13 @@ public:
     typedef OIndex<v_votes_phone_key, v_votes_phone_row> v_votesphone_idx_type;
     typedef OIndex<v_votes_id_state_key, v_votes_id_state_row> v_votesidst_idx_type;
 
-    explicit voter_db()
+    explicit voter_db(int num_stripes)
         : tbl_contestant_(),
           tbl_areacodestate_(),
           tbl_votes_(),
           idx_votesphone_(),
-          idx_votesidst_() {}
+          idx_votesidst_(),
+          tally_(num_stripes) {}
 
     contestant_tbl_type& tbl_contestant() {
         return tbl_contestant_;
@@ -48,6 +116,9 @@ public:
     v_votesidst_idx_type& view_votes_by_id_state() {
         return idx_votesidst_;
     }
+    sharded_tally<DBParams>& tally() {
+        return tally_;
+    }
 
     void thread_init_all() {
         tbl_contestant_.thread_init();
@@ -63,12 +134,9 @@ private:
     votes_tbl_type         tbl_votes_;
     v_votesphone_idx_type  idx_votesphone_;
     v_votesidst_idx_type   idx_votesidst_;
+    sharded_tally<DBParams> tally_;
 };
 
-extern std::vector<std::string> area_codes;
-extern std::vector<std::string> area_code_state_map;
-extern std::vector<std::string> contestant_names;
-
 extern void initialize_data();
 
 typedef typename sampling::StoRandomDistribution<>::rng_type rng_type;
@@ -134,8 +202,8 @@ class voter_runner {
 public:
     typedef voter_db<DBParams> db_type;
 
-    explicit voter_runner(int rid, db_type& database, double time_limit)
-        : id(rid), db(database), ig(rid+1040), tsc_elapse_limit(),
+    explicit voter_runner(int rid, db_type& database, double time_limit, bool sharded)
+        : id(rid), db(database), ig(rid+1040), tsc_elapse_limit(), sharded(sharded),
           stat_committed_txns() {
         tsc_elapse_limit = static_cast<uint64_t>(time_limit
                                                  * db_params::constants::processor_tsc_frequency
@@ -148,6 +216,10 @@ public:
         return stat_committed_txns;
     }
 
+    // Votes per contestant in db.tally() (sharded runs only), summed over
+    // states and stripes
+    std::vector<int64_t> run_txn_results();
+
 private:
     void run_txn_vote(const phone_number_str& tel, int32_t contestant_number);
     bool vote_inner(const phone_number_str& tel, int32_t contestant_number);
@@ -156,6 +228,9 @@ private:
     db_type& db;
     input_generator ig;
     uint64_t tsc_elapse_limit;
+    // count votes by contestant and state in db.tally() rather than
+    // in the votes by id and state view
+    bool sharded;
 
     size_t stat_committed_txns;
 };
@@ -205,7 +280,9 @@ void voter_runner<DBParams>::run() {
         phone_number_str tel;
         std::tie(cn, tel) = ig.generate_phone_call();
 
+        bench::latency_profile::timer lt;
         run_txn_vote(tel, cn);
+        lt.record(0);
 
         ++cnt;
         if (((cnt & 0xfffu) == 0) && ((read_tsc() - begin_tsc) >= tsc_elapse_limit))
@@ -71,6 +71,11 @@ bool voter_runner<DBParams>::vote_inner(const phone_number_str& tel, int32_t id)
         return false;
     assert(!result);
 
+    if (sharded) {
+        db.tally().increment(id, vr->state);
+        return true;
+    }
+
     // maintain view: votes by id and state
     std::tie(success, result, row, value) = db.view_votes_by_id_state().select_row(v_votes_id_state_key(id, vr->state), RowAccess::UpdateValue);
     if (!success)
@@ -90,4 +95,18 @@ bool voter_runner<DBParams>::vote_inner(const phone_number_str& tel, int32_t id)
     return true;
 }
 
+template <typename DBParams>
+std::vector<int64_t> voter_runner<DBParams>::run_txn_results() {
+    std::vector<int64_t> votes;
+    TRANSACTION {
+        votes.clear();
+        for (int32_t c = 0; c < constants::num_contestants; ++c) {
+            auto [success, count] = db.tally().read(c);
+            TXN_DO(success);
+            votes.push_back(count);
+        }
+    } RETRY(true);
+    return votes;
+}
+
 };
@@ -5,6 +5,7 @@
 #include "Wikipedia_txns.hh"
 
 #include "DB_profiler.hh"
+#include "DB_loader.hh"
 #include "clp.h"
 
 using db_params::constants;
@@ -27,7 +28,7 @@ int* wikipedia::wikipedia_loader<DBParams>::page_last_rev_lens = nullptr;
 
 // @section: clp parser definitions
 enum {
-    opt_dbid = 1, opt_nthrs, opt_users, opt_pages, opt_time, opt_gc, opt_comm, opt_perf, opt_pfcnt
+    opt_dbid = 1, opt_nthrs, opt_users, opt_pages, opt_time, opt_gc, opt_comm, opt_perf, opt_pfcnt, opt_si, opt_cm, opt_place, opt_hk, opt_pcache, opt_rusers
 };
 
 static const Clp_Option options[] = {
@@ -39,7 +40,13 @@ static const Clp_Option options[] = {
         { "garbage-collect", 'b', opt_gc, Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "perf",         'p', opt_perf,  Clp_NoVal,     Clp_Optional },
-        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional }
+        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "snapshot-isolation", 's', opt_si, Clp_NoVal,  Clp_Negate | Clp_Optional },
+        { "cm-policy",    'C', opt_cm,    Clp_ValString, Clp_Optional },
+        { "placement",    0,   opt_place, Clp_ValString, Clp_Optional },
+        { "housekeeping", 0,   opt_hk,    Clp_ValString, Clp_Optional },
+        { "page-cache",   0,   opt_pcache, Clp_NoVal,    Clp_Negate | Clp_Optional },
+        { "replicate-users", 0, opt_rusers, Clp_NoVal,   Clp_Negate | Clp_Optional }
 };
 
 static inline void print_usage(const char *argv_0) {
@@ -49,7 +56,7 @@ static inline void print_usage(const char *argv_0) {
        << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
        << "      default, opaque, 2pl, adaptive, swiss, tictoc" << std::endl
        << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
-       << "    Specify the number of parallel worker threads (default 1)." << std::endl
+       << "    Specify the number of parallel worker threads (default 1), which also load the database." << std::endl
        << "  --scaleusers=<NUM> (or -u<NUM>)" << std::endl
        << "    Specify the scale factor of the number of users (default 10)." << std::endl
        << "  --scalepages=<NUM> (or -g<NUM>)" << std::endl
@@ -63,7 +70,25 @@ static inline void print_usage(const char *argv_0) {
        << "  --perf (or -p)" << std::endl
        << "    Spawns perf profiler in record mode for the duration of the benchmark run." << std::endl
        << "  --perf-counter (or -c)" << std::endl
-       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl;
+       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl
+       << "  --snapshot-isolation (or -s)" << std::endl
+       << "    Run page reads under snapshot isolation (MVCC only, default false)." << std::endl
+       << "  --page-cache" << std::endl
+       << "    Give each runner a read-through cache of page texts for getPage*, checked against the" << std::endl
+       << "    page's latest revision in every transaction (default false)." << std::endl
+       << "  --replicate-users" << std::endl
+       << "    Give each NUMA node in use its own copy of the user table, read from the runner's node;" << std::endl
+       << "    updates of a user write every copy in the same commit (default false)." << std::endl
+       << "  --cm-policy=<STRING> (or -C<STRING>)" << std::endl
+       << "    Contention management policy: none, greedy (default), karma, polka." << std::endl
+       << "  --placement=<POLICY>" << std::endl
+       << "    Where runner threads are pinned: scatter (round-robin over NUMA nodes, default), compact" << std::endl
+       << "    (node by node, SMT siblings together), physical-first (one thread per physical core before" << std::endl
+       << "    any SMT sibling), or file:<PATH> (the CPUs listed in PATH, in order). CPUs outside the" << std::endl
+       << "    process's cpuset are never used." << std::endl
+       << "  --housekeeping=<CPUS>" << std::endl
+       << "    Pin the epoch advancer, loggers and other service threads to CPUS (e.g. 0,1 or 0-1), and keep" << std::endl
+       << "    runner threads off them. Each service thread's CPU time is reported with the statistics." << std::endl;
     std::cout << ss.str() << std::flush;
 }
 
@@ -77,12 +102,16 @@ struct cmd_params {
     bool enable_comm;
     bool spawn_perf;
     bool perf_counter_mode;
+    bool enable_si;
+    bool enable_page_cache;
+    bool replicate_users;
 
     explicit cmd_params()
         : db_id(db_params::db_params_id::Default),
           num_threads(1), scale_user(10), scale_page(10),
           time(10.0), enable_gc(false), enable_comm(false),
-          spawn_perf(false), perf_counter_mode(false) {}
+          spawn_perf(false), perf_counter_mode(false), enable_si(false),
+          enable_page_cache(false), replicate_users(false) {}
 };
 
 // @endsection: clp parser definitions
@@ -103,13 +132,15 @@ public:
     static int execute(cmd_params p) {
         size_t num_users = wikipedia::constants::users * (size_t)p.scale_user;
         size_t num_pages = wikipedia::constants::pages * (size_t)p.scale_page;
-        wikipedia::load_params lp = {num_users, num_pages};
+        wikipedia::load_params lp = {num_users, num_pages, p.num_threads};
         wikipedia::run_params rp(num_users, num_pages, p.time, wikipedia::workload_weightgram);
+        rp.si_page_reads = p.enable_si;
+        rp.page_cache_slots = p.enable_page_cache ? num_pages : 0;
 
         // Create DB
-        auto& db = *(new db_type());
+        auto& db = *(new db_type(p.replicate_users ? topology_nodes_in_use() : std::vector<int>()));
 
-        // Load DB
+        // Load DB in chunks of pages or users, one thread per runner
         loader_type loader(db, lp);
         loader.load();
 
@@ -130,7 +161,17 @@ public:
             runners.push_back(runner_type(id, db, rp));
         }
 
+        bench::latency_profile::name_types({"AddWatchList", "GetPageAnon", "GetPageAuth",
+                                            "RemoveWatchList", "ListPageNameSpace", "UpdatePage"});
         profiler_type profiler(p.spawn_perf);
+        profiler.describe<DBParams>("wikipedia", p.num_threads);
+        profiler.config("time_limit", p.time);
+        profiler.config("gc", p.enable_gc);
+        profiler.config("scale_user", p.scale_user);
+        profiler.config("scale_page", p.scale_page);
+        profiler.config("si_page_reads", p.enable_si);
+        profiler.config("page_cache", p.enable_page_cache);
+        profiler.config("replicate_users", p.replicate_users);
         profiler.start(p.perf_counter_mode ? Profiler::perf_mode::counters : Profiler::perf_mode::record);
 
         for (int t = 0; t < p.num_threads; ++t) {
@@ -148,6 +189,15 @@ public:
         }
         profiler.finish(total_commit_txns);
 
+        if (p.enable_page_cache) {
+            size_t hits = 0, misses = 0;
+            for (auto& r : runners) {
+                hits += r.page_cache_stats().hits;
+                misses += r.page_cache_stats().misses;
+            }
+            std::cout << "Page cache: " << hits << " hits, " << misses << " misses" << std::endl;
+        }
+
         Transaction::rcu_release_all(advancer, p.num_threads);
 
         //print_abort_histogram(runners);
@@ -230,6 +280,42 @@ int main(int argc, const char * const *argv) {
         case opt_pfcnt:
             params.perf_counter_mode = !clp->negated;
             break;
+        case opt_si:
+            params.enable_si = !clp->negated;
+            break;
+        case opt_pcache:
+            params.enable_page_cache = !clp->negated;
+            break;
+        case opt_rusers:
+            params.replicate_users = !clp->negated;
+            break;
+        case opt_cm:
+            if (!ContentionManager::set_policy(clp->val.s)) {
+                std::cout << "Unsupported contention management policy: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_place:
+            if (!set_placement(clp->val.s)) {
+                std::cout << "Unsupported thread placement: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_hk:
+            if (!set_housekeeping_cpus(clp->val.s)) {
+                std::cout << "Bad housekeeping CPU list: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
         default:
             print_usage(argv[0]);
             ret_code = 1;
@@ -3,6 +3,9 @@
 #include <iostream>
 #include <iomanip>
 #include <ctime>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <sstream>
 #include <sampling.hh>
 #include <PlatformFeatures.hh>
@@ -16,7 +19,9 @@
 #endif
 
 #include "DB_index.hh"
+#include "DB_latency.hh"
 #include "DB_params.hh"
+#include "DB_replicas.hh"
 
 #if TABLE_FINE_GRAINED
 #include "wiki_split_params_ts.hh"
@@ -33,7 +38,7 @@ struct constants {
     static constexpr int pages = 1000;
     static constexpr int users = 2000;
     static constexpr int max_watches_per_user = 1000;
-    static constexpr int batch_size = 1000;
+    static constexpr int batch_size = 1000;  // pages or users per load chunk
 
     static constexpr double num_watches_per_user_sigma = 1.75;
     static constexpr double page_id_sigma = 1.0001;
@@ -55,7 +60,7 @@ public:
     //typedef OIndex<ipblocks_user_idx_key, ipblocks_user_idx_row>         ipb_user_idx_type;
     typedef OIndex<logging_key, logging_row>                             log_tbl_type;
     typedef OIndex<page_key, page_row>                                   page_tbl_type;
-    typedef OIndex<useracct_key, useracct_row>                           user_tbl_type;
+    typedef bench::replicated_index<OIndex<useracct_key, useracct_row>> user_tbl_type;
     typedef OIndex<page_idx_key, page_idx_row>                           page_idx_type;
     //typedef OIndex<page_restrictions_key, page_restrictions_row>         pr_tbl_type;
     //typedef OIndex<page_restrictions_idx_key, page_restrictions_idx_row> pr_idx_type;
@@ -67,7 +72,9 @@ public:
     typedef OIndex<watchlist_key, watchlist_row>                         wl_tbl_type;
     typedef OIndex<watchlist_idx_key, watchlist_idx_row>                 wl_idx_type;
 
-    explicit wikipedia_db() :
+    // user_nodes: the NUMA nodes that get a copy of the user table (none
+    // for a single copy)
+    explicit wikipedia_db(const std::vector<int>& user_nodes = {}) :
         //tbl_ipb_(),
         //idx_ipb_addr_(),
         //idx_ipb_user_(),
@@ -79,7 +86,7 @@ public:
         tbl_rc_(),
         tbl_rev_(),
         tbl_text_(),
-        tbl_user_(),
+        tbl_user_(user_nodes),
         idx_user_(),
         //tbl_ug_(),
         tbl_wl_(),
@@ -195,14 +202,18 @@ struct run_params {
     uint64_t num_pages;
     double time_limit;
     workload_mix_type workload_mix;
+    bool si_page_reads;  // run getPage* under MVCC snapshot isolation
+    size_t page_cache_slots;  // per-runner page_cache size, 0 for none
 
     run_params(size_t nu, size_t np, double t, const workload_mix_type& wl) :
-        num_users(nu), num_pages(np), time_limit(t), workload_mix(wl) {}
+        num_users(nu), num_pages(np), time_limit(t), workload_mix(wl),
+        si_page_reads(false), page_cache_slots(0) {}
 };
 
 struct load_params {
     uint64_t num_users;
     uint64_t num_pages;
+    int num_threads = 1;
 };
 
 // Pre-processed input distribution from wikibench trace (from OLTPBench)
@@ -365,6 +376,10 @@ public:
 
         return permute_text(std::move(str));
     }
+    // Restarts the generator's random stream
+    void reseed(std::seed_seq& seed) {
+        dists.thread_rng.seed(seed);
+    }
     std::string generate_page_title(int page_id) {
         rng_type g(page_id);
         auto title_len = dists.page_title_len_dist.sample(g);
@@ -470,6 +485,69 @@ private:
     loadtime_dists l_dists;
 };
 
+// A runner's read-through cache of (page, latest revision, text) tuples
+// for getPage*. A transaction that finds a page here still reads the page
+// row's page_latest, and uses the entry only if it names the same
+// revision; so an updatePage that commits invalidates the entry by
+// version, and the read stays serializable. That makes the idx_page,
+// revision and text probes safe to skip: pages never change title, and
+// revision and text rows are never updated once inserted. Entries are
+// only installed after a commit. Direct-mapped; a slot holds one page.
+class page_cache {
+public:
+    struct entry {
+        int32_t name_space = 0;
+        std::string title;
+        int32_t page_id = 0;
+        int32_t rev_id = 0;
+        int32_t text_id = 0;
+        std::string text;
+    };
+
+    explicit page_cache(size_t nslots)
+        : slots_(nslots) {}
+
+    bool enabled() const {
+        return !slots_.empty();
+    }
+
+    const entry* find(int name_space, const std::string& title) const {
+        if (!enabled())
+            return nullptr;
+        auto& e = slot(name_space, title);
+        if (e.page_id == 0 || e.name_space != name_space || e.title != title)
+            return nullptr;
+        return &e;
+    }
+
+    void install(int name_space, const std::string& title, int32_t page_id,
+                 int32_t rev_id, int32_t text_id, const std::string& text) {
+        if (!enabled())
+            return;
+        auto& e = slot(name_space, title);
+        e.name_space = name_space;
+        e.title = title;
+        e.page_id = page_id;
+        e.rev_id = rev_id;
+        e.text_id = text_id;
+        e.text = text;
+    }
+
+    size_t hits = 0;
+    size_t misses = 0;
+
+private:
+    std::vector<entry> slots_;
+
+    entry& slot(int name_space, const std::string& title) {
+        size_t h = std::hash<std::string>()(title) * 31 + (size_t)name_space;
+        return slots_[h % slots_.size()];
+    }
+    const entry& slot(int name_space, const std::string& title) const {
+        return const_cast<page_cache*>(this)->slot(name_space, title);
+    }
+};
+
 template <typename DBParams>
 class wikipedia_runner {
 public:
@@ -480,7 +558,8 @@ public:
     wikipedia_runner(int runner_id, db_type& database, const run_params& params)
         : id(runner_id), db(database),
           ig(runner_id, params.num_users, params.num_pages, params.workload_mix),
-          tsc_elapse_limit(), stats_aborts_by_txn(workload_weightgram.size(), 0ul) {
+          tsc_elapse_limit(), si_page_reads(params.si_page_reads),
+          pcache(params.page_cache_slots), stats_aborts_by_txn(workload_weightgram.size(), 0ul) {
         tsc_elapse_limit =
                 (uint64_t)(params.time_limit * db_params::constants::processor_tsc_frequency * db_params::constants::billion);
     }
@@ -508,16 +587,35 @@ public:
         return stats_aborts_by_txn;
     }
 
+    const page_cache& page_cache_stats() const {
+        return pcache;
+    }
+
 private:
     bool txn_updatePage_inner(int text_id, int page_id, const std::string& page_title,
                               const std::string& page_text, int page_name_space, int user_id,
                               const std::string& user_ip, const std::string& user_text,
                               int rev_id, const std::string& rev_comment, int rev_minor_edit,
                               size_t& nstarts);
+    // Counts a committed getPage* read, and installs the page if it missed
+    void note_page_read(const page_cache::entry* hit, int name_space,
+                        const std::string& page_title, const article_type& art) {
+        if (!pcache.enabled())
+            return;
+        if (hit)
+            ++pcache.hits;
+        else {
+            ++pcache.misses;
+            pcache.install(name_space, page_title, art.page_id, art.rev_id, art.text_id, art.old_text);
+        }
+    }
+
     int id;
     db_type& db;
     runtime_input_generator ig;
     uint64_t tsc_elapse_limit;
+    bool si_page_reads;
+    page_cache pcache;
     size_t stats_total_commits;
     std::vector<size_t> stats_aborts_by_txn;
 };
@@ -531,7 +629,7 @@ public:
 
     explicit wikipedia_loader(wikipedia_db<DBParams>& wdb, const load_params& params)
             : num_users((int)params.num_users), num_pages((int)params.num_pages),
-              db(wdb), ig(6332, params.num_users, params.num_pages) {}
+              num_threads(std::max(params.num_threads, 1)), db(wdb) {}
 
     void load();
 
@@ -565,16 +663,31 @@ private:
     void load_watchlist();
     void load_revision();
 
+    // Calls load(chunk, first, last, ig) for each chunk of batch_size ids
+    // in [1, nitems], in parallel, to generate ids [first, last) and bulk
+    // load them; only a chunk's rows are buffered at a time. ig is
+    // reseeded from phase and chunk, so the data doesn't depend on which
+    // thread loads which chunk. With a name, reports the rows loaded.
+    template <typename F>
+    void for_each_chunk(int nitems, int phase, const char* name, F load);
+    // Generators hold a dozen distributions, each with its own tables,
+    // so chunks borrow them rather than build their own
+    std::unique_ptr<loadtime_input_generator> borrow_generator();
+    void return_generator(std::unique_ptr<loadtime_input_generator> ig);
+
     int num_users;
     int num_pages;
+    int num_threads;
     wikipedia_db<DBParams>& db;
-    loadtime_input_generator ig;
+    std::mutex igs_mu;
+    std::vector<std::unique_ptr<loadtime_input_generator>> igs;
 };
 
 template <typename DBParams>
 void wikipedia_runner<DBParams>::run() {
     ::TThread::set_id(id);
     set_affinity(id);
+    bench::note_replica_thread_node();
     db.thread_init_all();
 
     auto tsc_begin = read_tsc();
@@ -586,6 +699,7 @@ void wikipedia_runner<DBParams>::run() {
         auto page_ns = ig.generate_page_namespace(page_id);
         auto page_title = ig.generate_page_title(page_id);
         size_t retries = 0;
+        bench::latency_profile::timer lt;
         switch (t_type) {
             case TxnType::AddWatchList:
                 retries = run_txn_addWatchList(user_id, page_ns, page_title);
@@ -620,6 +734,7 @@ void wikipedia_runner<DBParams>::run() {
                 break;
         }
 
+        lt.record(static_cast<int>(t_type));
         stats_aborts_by_txn.at(static_cast<size_t>(t_type)) += retries;
 
         ++cnt;
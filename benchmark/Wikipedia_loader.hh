@@ -1,10 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <numeric>
 #include <set>
+#include <thread>
+#include <vector>
+#include "DB_loader.hh"
 #include "Wikipedia_bench.hh"
 
 namespace wikipedia {
 
+// Load phases, which seed the chunks' generators
+enum { load_revision_phase = 1, load_useracct_phase, load_page_phase, load_watchlist_phase };
+
 template <typename DBParams>
 void wikipedia_loader<DBParams>::load() {
     std::cout << "Loading database..." << std::endl;
@@ -15,140 +24,250 @@ void wikipedia_loader<DBParams>::load() {
     load_page();
     load_watchlist();
     wikipedia_loader::free_scratch_space();
+    igs.clear();
 
     std::cout << "Loaded." << std::endl;
 }
 
 template <typename DBParams>
-void wikipedia_loader<DBParams>::load_useracct() {
-    for (int uid = 1; uid <= num_users; ++uid) {
-        useracct_row u_r;
-        u_r.user_name = ig.generate_user_name();
-        u_r.user_real_name = ig.generate_user_real_name();
-        u_r.user_password = "password";
-        u_r.user_newpassword = "newpassword";
-        u_r.user_newpass_time = ig.curr_timestamp_string();
-        u_r.user_email = "user@example.com";
-        u_r.user_options = "fake_longoptionslist";
-        u_r.user_touched = ig.curr_timestamp_string();
-        u_r.user_token = ig.generate_user_token();
-        u_r.user_email_authenticated = "null";
-        u_r.user_email_token = "null";
-        u_r.user_email_token_expires = "null";
-        u_r.user_registration = "null";
-        u_r.user_editcount = user_revision_cnts[uid - 1];
-
-        db.tbl_useracct().nontrans_put(useracct_key(uid), u_r);
+std::unique_ptr<loadtime_input_generator> wikipedia_loader<DBParams>::borrow_generator() {
+    {
+        std::lock_guard<std::mutex> lk(igs_mu);
+        if (!igs.empty()) {
+            auto ig = std::move(igs.back());
+            igs.pop_back();
+            return ig;
+        }
     }
+    return std::make_unique<loadtime_input_generator>(6332, num_users, num_pages);
 }
 
 template <typename DBParams>
-void wikipedia_loader<DBParams>::load_page() {
-    for (int pid = 1; pid <= num_pages; ++pid) {
-        int page_ns = ig.generate_page_namespace(pid);
-        auto page_title = ig.generate_page_title(pid);
-        auto page_restrictions = ig.generate_page_restrictions();
-        page_row pg_r;
-        pg_r.page_namespace = page_ns;
-        pg_r.page_title = page_title;
-        pg_r.page_restrictions = page_restrictions;
-        pg_r.page_counter = 0;
-        pg_r.page_is_redirect = 0;
-        pg_r.page_is_new = 0;
-        pg_r.page_random = ig.generate_page_random();
-        pg_r.page_touched = ig.curr_timestamp_string();
-        pg_r.page_latest = page_last_rev_ids[pid - 1];
-        pg_r.page_len = page_last_rev_lens[pid - 1];
-
-        db.tbl_page().nontrans_put(page_key(pid), pg_r);
-
-        page_idx_row pi_r{};
-        pi_r.page_id = pid;
-        db.idx_page().nontrans_put(page_idx_key(page_ns, page_title), pi_r);
+void wikipedia_loader<DBParams>::return_generator(std::unique_ptr<loadtime_input_generator> ig) {
+    std::lock_guard<std::mutex> lk(igs_mu);
+    igs.push_back(std::move(ig));
+}
+
+template <typename DBParams>
+template <typename F>
+void wikipedia_loader<DBParams>::for_each_chunk(int nitems, int phase, const char* name, F load) {
+    int nchunks = (nitems + constants::batch_size - 1) / constants::batch_size;
+    auto run = [&](int c) {
+        db.thread_init_all();
+        auto ig = borrow_generator();
+        std::seed_seq seed{6332, phase, c};
+        ig->reseed(seed);
+        int first = c * constants::batch_size + 1;
+        uint64_t n = load(c, first, std::min(first + constants::batch_size, nitems + 1), *ig);
+        return_generator(std::move(ig));
+        return n;
+    };
+    if (name) {
+        int nthreads = num_threads;
+        bench::db_loader(name, nchunks, nthreads, [nthreads](int c) { return c % nthreads; }).run(run);
+        return;
     }
+    std::atomic<int> next(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < std::min(num_threads, nchunks); ++t)
+        threads.emplace_back([&] {
+                int c;
+                while ((c = next.fetch_add(1)) < nchunks)
+                    run(c);
+            });
+    for (auto& th : threads)
+        th.join();
+}
+
+template <typename DBParams>
+void wikipedia_loader<DBParams>::load_useracct() {
+    for_each_chunk(num_users, load_useracct_phase, "wikipedia useracct",
+                   [&](int, int first, int last, loadtime_input_generator& ig) {
+        std::vector<std::pair<useracct_key, useracct_row>> users;
+        users.reserve(last - first);
+        for (int uid = first; uid != last; ++uid) {
+            useracct_row u_r;
+            u_r.user_name = ig.generate_user_name();
+            u_r.user_real_name = ig.generate_user_real_name();
+            u_r.user_password = "password";
+            u_r.user_newpassword = "newpassword";
+            u_r.user_newpass_time = ig.curr_timestamp_string();
+            u_r.user_email = "user@example.com";
+            u_r.user_options = "fake_longoptionslist";
+            u_r.user_touched = ig.curr_timestamp_string();
+            u_r.user_token = ig.generate_user_token();
+            u_r.user_email_authenticated = "null";
+            u_r.user_email_token = "null";
+            u_r.user_email_token_expires = "null";
+            u_r.user_registration = "null";
+            u_r.user_editcount = user_revision_cnts[uid - 1];
+
+            users.emplace_back(useracct_key(uid), u_r);
+        }
+        db.tbl_useracct().bulk_load(users.begin(), users.end());
+        return users.size();
+    });
+}
+
+// Sorts a chunk's rows by key, for bulk_load
+template <typename Pairs>
+static void sort_by_key(Pairs& rows) {
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+            return lcdf::Str(a.first) < lcdf::Str(b.first);
+        });
+}
+
+template <typename DBParams>
+void wikipedia_loader<DBParams>::load_page() {
+    for_each_chunk(num_pages, load_page_phase, "wikipedia page",
+                   [&](int, int first, int last, loadtime_input_generator& ig) {
+        std::vector<std::pair<page_key, page_row>> pages;
+        std::vector<std::pair<page_idx_key, page_idx_row>> titles;
+        pages.reserve(last - first);
+        titles.reserve(last - first);
+        for (int pid = first; pid != last; ++pid) {
+            int page_ns = ig.generate_page_namespace(pid);
+            auto page_title = ig.generate_page_title(pid);
+            auto page_restrictions = ig.generate_page_restrictions();
+            page_row pg_r;
+            pg_r.page_namespace = page_ns;
+            pg_r.page_title = page_title;
+            pg_r.page_restrictions = page_restrictions;
+            pg_r.page_counter = 0;
+            pg_r.page_is_redirect = 0;
+            pg_r.page_is_new = 0;
+            pg_r.page_random = ig.generate_page_random();
+            pg_r.page_touched = ig.curr_timestamp_string();
+            pg_r.page_latest = page_last_rev_ids[pid - 1];
+            pg_r.page_len = page_last_rev_lens[pid - 1];
+
+            pages.emplace_back(page_key(pid), pg_r);
+
+            page_idx_row pi_r{};
+            pi_r.page_id = pid;
+            titles.emplace_back(page_idx_key(page_ns, page_title), pi_r);
+        }
+        db.tbl_page().bulk_load(pages.begin(), pages.end());
+        sort_by_key(titles);
+        db.idx_page().bulk_load(titles.begin(), titles.end());
+        return pages.size() + titles.size();
+    });
 }
 
 template <typename DBParams>
 void wikipedia_loader<DBParams>::load_watchlist() {
-    std::set<int> user_pages;
-    for (int uid = 1; uid <= num_users; ++uid) {
-        user_pages.clear();
-        auto num_watches = ig.generate_num_watches();
-        for (int wid = 1; wid <= num_watches; ++wid) {
-            int page_id;
-            if (num_watches == constants::max_watches_per_user) {
-                page_id = wid + 1;
-            } else {
-                while (true) {
-                    page_id = ig.generate_page_id();
-                    if (user_pages.find(page_id) == user_pages.end()) {
-                        break;
+    for_each_chunk(num_users, load_watchlist_phase, "wikipedia watchlist",
+                   [&](int, int first, int last, loadtime_input_generator& ig) {
+        std::vector<std::pair<watchlist_key, watchlist_row>> watches;
+        std::vector<std::pair<watchlist_idx_key, watchlist_idx_row>> watchers;
+        std::set<int> user_pages;
+        for (int uid = first; uid != last; ++uid) {
+            user_pages.clear();
+            auto num_watches = ig.generate_num_watches();
+            for (int wid = 1; wid <= num_watches; ++wid) {
+                int page_id;
+                if (num_watches == constants::max_watches_per_user) {
+                    page_id = wid + 1;
+                } else {
+                    while (true) {
+                        page_id = ig.generate_page_id();
+                        if (user_pages.find(page_id) == user_pages.end()) {
+                            break;
+                        }
                     }
                 }
-            }
 
-            user_pages.insert(page_id);
+                user_pages.insert(page_id);
 
-            auto ns = ig.generate_page_namespace(page_id);
-            auto title = ig.generate_page_title(page_id);
-            watchlist_key wl_k(uid, ns, title);
-            watchlist_idx_key wl_i_k(ns, title, uid);
-            watchlist_row wl_r;
-            wl_r.wl_notificationtimestamp = "null";
+                auto ns = ig.generate_page_namespace(page_id);
+                auto title = ig.generate_page_title(page_id);
+                watchlist_row wl_r;
+                wl_r.wl_notificationtimestamp = "null";
 
-            db.tbl_watchlist().nontrans_put(wl_k, wl_r);
-            db.idx_watchlist().nontrans_put(wl_i_k, watchlist_idx_row());
+                watches.emplace_back(watchlist_key(uid, ns, title), wl_r);
+                watchers.emplace_back(watchlist_idx_key(ns, title, uid), watchlist_idx_row());
+            }
         }
-    }
+        sort_by_key(watches);
+        db.tbl_watchlist().bulk_load(watches.begin(), watches.end());
+        sort_by_key(watchers);
+        db.idx_watchlist().bulk_load(watchers.begin(), watchers.end());
+        return watches.size() + watchers.size();
+    });
 }
 
 template <typename DBParams>
 void wikipedia_loader<DBParams>::load_revision() {
+    // Revision (and text) ids are dense and in page order, as one loader
+    // would assign them: count each chunk's revisions, then load each
+    // chunk into its share of the ids
+    int nchunks = (num_pages + constants::batch_size - 1) / constants::batch_size;
+    std::vector<int> first_rev(nchunks + 1, 0);
+    for_each_chunk(num_pages, load_revision_phase, nullptr,
+                   [&](int c, int first, int last, loadtime_input_generator& ig) {
+        for (int pid = first; pid != last; ++pid)
+            first_rev[c + 1] += ig.generate_num_revisions();
+        return 0;
+    });
+    std::partial_sum(first_rev.begin(), first_rev.end(), first_rev.begin());
 
-    for (int pid = 1; pid <= num_pages; ++pid) {
-        auto num_revs = ig.generate_num_revisions();
-        auto old_text = ig.generate_random_old_text();
-        auto old_text_len = old_text.length();
-
-        for (int i = 0; i < num_revs; ++i) {
-            auto tr_id = (int)db.tbl_revision().gen_key(); // rev id
-            auto tx_id = (int)db.tbl_text().gen_key(); // text id
-            always_assert(tx_id == tr_id, "text_id and rev_id should be the same at load time");
-
-            auto uid = ig.generate_user_id();
-            ++user_revision_cnts[uid - 1];
-            if (i > 0) {
-                old_text = ig.generate_rev_text(old_text);
-                old_text_len = old_text.length();
-            }
+    for_each_chunk(num_pages, load_revision_phase, "wikipedia revision",
+                   [&](int c, int first, int last, loadtime_input_generator& ig) {
+        // the same stream as the count above
+        std::vector<int> num_revs(last - first);
+        for (auto& n : num_revs)
+            n = ig.generate_num_revisions();
+        std::vector<std::pair<text_key, text_row>> texts;
+        std::vector<std::pair<revision_key, revision_row>> revisions;
+        texts.reserve(first_rev[c + 1] - first_rev[c]);
+        revisions.reserve(first_rev[c + 1] - first_rev[c]);
 
-            text_key t_k(tx_id);
-            text_row t_r;
-            t_r.old_text = new char[old_text_len + 1];
-            memcpy(t_r.old_text, old_text.c_str(), old_text_len + 1);
-            t_r.old_flags = "utf-8";
-            t_r.old_page = pid;
-            db.tbl_text().nontrans_put(t_k, t_r);
-
-            revision_key r_k(tr_id);
-            revision_row r_r;
-            r_r.rev_page = pid;
-            r_r.rev_text_id = tr_id;
-            r_r.rev_comment = ig.generate_rev_comment();
-            r_r.rev_user = uid;
-            r_r.rev_user_text = "I am a good user";
-            r_r.rev_timestamp = ig.curr_timestamp_string();
-            r_r.rev_minor_edit = ig.generate_rev_minor_edit();
-            r_r.rev_deleted = 0;
-            r_r.rev_len = (int)old_text_len;
-            r_r.rev_parent_id = 0;
-
-            db.tbl_revision().nontrans_put(r_k, r_r);
-
-            page_last_rev_ids[pid - 1] = tr_id;
-            page_last_rev_lens[pid - 1] = tr_id;
+        int rev_id = first_rev[c];
+        for (int pid = first; pid != last; ++pid) {
+            auto old_text = ig.generate_random_old_text();
+            auto old_text_len = old_text.length();
+
+            for (int i = 0; i < num_revs[pid - first]; ++i, ++rev_id) {
+                auto uid = ig.generate_user_id();
+                __atomic_fetch_add(&user_revision_cnts[uid - 1], 1, __ATOMIC_RELAXED);
+                if (i > 0) {
+                    old_text = ig.generate_rev_text(old_text);
+                    old_text_len = old_text.length();
+                }
+
+                // a revision's text has its id
+                text_row t_r;
+                t_r.old_text = new char[old_text_len + 1];
+                memcpy(t_r.old_text, old_text.c_str(), old_text_len + 1);
+                t_r.old_flags = "utf-8";
+                t_r.old_page = pid;
+                texts.emplace_back(text_key(rev_id), t_r);
+
+                revision_row r_r;
+                r_r.rev_page = pid;
+                r_r.rev_text_id = rev_id;
+                r_r.rev_comment = ig.generate_rev_comment();
+                r_r.rev_user = uid;
+                r_r.rev_user_text = "I am a good user";
+                r_r.rev_timestamp = ig.curr_timestamp_string();
+                r_r.rev_minor_edit = ig.generate_rev_minor_edit();
+                r_r.rev_deleted = 0;
+                r_r.rev_len = (int)old_text_len;
+                r_r.rev_parent_id = 0;
+                revisions.emplace_back(revision_key(rev_id), r_r);
+
+                page_last_rev_ids[pid - 1] = rev_id;
+                page_last_rev_lens[pid - 1] = (int)old_text_len;
+            }
         }
-    }
+        db.tbl_text().bulk_load(texts.begin(), texts.end());
+        db.tbl_revision().bulk_load(revisions.begin(), revisions.end());
+        return texts.size() + revisions.size();
+    });
+
+    // new revisions and texts take the ids after these
+    db.tbl_revision().skip_keys(first_rev[nchunks]);
+    db.tbl_text().skip_keys(first_rev[nchunks]);
 }
 
 }; // namespace wikipedia
@@ -12,12 +12,6 @@
         return false; \
     }
 
-#define TXN_CHECK(op) \
-    if (!(op)) { \
-        Sto::transaction()->silent_abort(); \
-        return false; \
-    }
-
 namespace wikipedia {
 
 template <typename DBParams>
@@ -128,8 +122,9 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAnony
     (void)for_select;
     size_t nexecs = 0;
     article_type art;
+    const page_cache::entry* cached = nullptr;
 
-    TRANSACTION {
+    SITRANSACTION(si_page_reads) {
 
     ++nexecs;
 
@@ -137,7 +132,10 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAnony
     int32_t rev_id;
     int32_t rev_text_id;
 
-    {
+    cached = pcache.find(name_space, page_title);
+    if (cached) {
+        page_id = cached->page_id;
+    } else {
     auto [abort, result, row, value] = db.idx_page().select_split_row(page_idx_key(name_space, page_title), {{pi_nc::page_id, access_t::read}});
     (void)row; (void)result;
     TXN_DO(abort);
@@ -192,6 +190,14 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAnony
     }
     */
 
+    if (cached && cached->rev_id == rev_id) {
+        art.text_id = cached->text_id;
+        art.page_id = page_id;
+        art.rev_id = rev_id;
+        art.old_text = cached->text;
+        art.user_text = user_ip;
+    } else {
+    cached = nullptr;
     {
     auto [abort, result, row, value] = db.tbl_revision().select_split_row(revision_key(rev_id),
         {{rev_nc::rev_text_id, access_t::read}});
@@ -214,9 +220,12 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAnony
     art.old_text = std::string(value.old_text());
     art.user_text = user_ip;
     }
+    }
 
     } RETRY(true);
 
+    note_page_read(cached, name_space, page_title, art);
+
     return {nexecs - 1, art};
 }
 
@@ -237,8 +246,9 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAuthe
     (void)for_select;
     size_t nexecs = 0;
     article_type art;
+    const page_cache::entry* cached = nullptr;
 
-    TRANSACTION {
+    SITRANSACTION(si_page_reads) {
 
     ++nexecs;
 
@@ -261,7 +271,10 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAuthe
 
     // From this point is pretty much the same as getPageAnonymous 
 
-    {
+    cached = pcache.find(name_space, page_title);
+    if (cached) {
+        page_id = cached->page_id;
+    } else {
     auto [abort, result, row, value] = db.idx_page().select_split_row(page_idx_key(name_space, page_title),
         {{pi_nc::page_id, access_t::read}});
     (void)result; (void)row;
@@ -316,6 +329,14 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAuthe
     }
     */
 
+    if (cached && cached->rev_id == rev_id) {
+        art.text_id = cached->text_id;
+        art.page_id = page_id;
+        art.rev_id = rev_id;
+        art.old_text = cached->text;
+        art.user_text = user_ip;
+    } else {
+    cached = nullptr;
     {
     auto [abort, result, row, value] = db.tbl_revision().select_split_row(revision_key(rev_id),
         {{rev_nc::rev_text_id, access_t::read}});
@@ -338,9 +359,12 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAuthe
     art.old_text = std::string(value.old_text());
     art.user_text = user_ip;
     }
+    }
 
     } RETRY(true);
 
+    note_page_read(cached, name_space, page_title, art);
+
     return {nexecs - 1, art};
 }
 
@@ -524,6 +548,8 @@ bool wikipedia_runner<DBParams>::txn_updatePage_inner(int text_id,
     if (!watching_users.empty()) {
         // update watchlist for each user watching
         INTERACTIVE_TXN_COMMIT;
+        pcache.install(page_name_space, page_title, page_id, bswap(new_rev_k.rev_id),
+                       bswap(new_text_k.old_id), page_text);
 
         RWTRANSACTION {
 
@@ -639,6 +665,8 @@ bool wikipedia_runner<DBParams>::txn_updatePage_inner(int text_id,
     }
 
     INTERACTIVE_TXN_COMMIT;
+    pcache.install(page_name_space, page_title, page_id, bswap(new_rev_k.rev_id),
+                   bswap(new_text_k.old_id), page_text);
 
     return true;
 }
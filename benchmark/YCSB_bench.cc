@@ -6,6 +6,7 @@
 #include "YCSB_txns.hh"
 #include "PlatformFeatures.hh"
 #include "DB_profiler.hh"
+#include "DB_loader.hh"
 
 namespace ycsb {
 
@@ -14,7 +15,7 @@ using bench::db_profiler;
 
 enum {
     opt_dbid = 1, opt_nthrs, opt_mode, opt_time, opt_perf, opt_pfcnt, opt_gc,
-    opt_node, opt_comm
+    opt_node, opt_comm, opt_cm, opt_rate, opt_pois, opt_strm, opt_core, opt_seed, opt_place, opt_hk
 };
 
 static const Clp_Option options[] = {
@@ -27,6 +28,14 @@ static const Clp_Option options[] = {
     { "gc",           'g', opt_gc,    Clp_NoVal,     Clp_Negate| Clp_Optional },
     { "node",         'n', opt_node,  Clp_NoVal,     Clp_Negate| Clp_Optional },
     { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate| Clp_Optional },
+    { "cm-policy",    'C', opt_cm,    Clp_ValString, Clp_Optional },
+    { "arrival-rate", 'R', opt_rate,  Clp_ValDouble, Clp_Optional },
+    { "poisson",      'Q', opt_pois,  Clp_NoVal,     Clp_Negate| Clp_Optional },
+    { "stream",       's', opt_strm,  Clp_NoVal,     Clp_Negate| Clp_Optional },
+    { "core",         'w', opt_core,  Clp_ValString, Clp_Optional },
+    { "seed",         'S', opt_seed,  Clp_ValUnsigned, Clp_Optional },
+    { "placement",    0,   opt_place, Clp_ValString, Clp_Optional },
+    { "housekeeping", 0,   opt_hk,    Clp_ValString, Clp_Optional },
 };
 
 static inline void print_usage(const char *argv_0) {
@@ -34,11 +43,15 @@ static inline void print_usage(const char *argv_0) {
     ss << "Usage of " << std::string(argv_0) << ":" << std::endl
        << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
        << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
-       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode" << std::endl
+       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode, det" << std::endl
+       << "      (det runs transactions in deterministic batches, locking their declared keys in" << std::endl
+       << "      batch order instead of validating)" << std::endl
        << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
        << "    Specify the number of threads (or TPCC workers/terminals, default 1)." << std::endl
        << "  --mode=<CHAR> (or -m<CHAR>)" << std::endl
        << "    Specify which YCSB variant to run (A/B/C, default C)." << std::endl
+       << "  --core=<CHAR> (or -w<CHAR>)" << std::endl
+       << "    Run a YCSB core workload instead (A-F), one operation per transaction on an ordered table." << std::endl
        << "  --time=<NUM> (or -l<NUM>)" << std::endl
        << "    Specify the time (duration) for which the benchmark is run (default 10 seconds)." << std::endl
        << "  --perf (or -p)" << std::endl
@@ -50,14 +63,34 @@ static inline void print_usage(const char *argv_0) {
        << "  --node (or -n)" << std::endl
        << "    Enable node tracking (default false)." << std::endl
        << "  --commute (or -x)" << std::endl
-       << "    Enable commutative updates in MVCC (default false)." << std::endl;
+       << "    Enable commutative updates in MVCC (default false)." << std::endl
+       << "  --cm-policy=<STRING> (or -C<STRING>)" << std::endl
+       << "    Contention management policy: none, greedy (default), karma, polka." << std::endl
+       << "  --arrival-rate=<NUM> (or -R<NUM>)" << std::endl
+       << "    Run open-loop: transactions arrive at each thread at NUM per second, and their latency" << std::endl
+       << "    counts from the scheduled arrival (default 0, closed loop)." << std::endl
+       << "  --poisson (or -Q)" << std::endl
+       << "    Make open-loop arrivals a Poisson process instead of evenly spaced (default false)." << std::endl
+       << "  --stream (or -s)" << std::endl
+       << "    Generate each transaction as it runs instead of replaying a pre-generated trace" << std::endl
+       << "    (default false; traces are reproducible, streams start at once in constant memory)." << std::endl
+       << "  --seed=<NUM> (or -S<NUM>)" << std::endl
+       << "    Seed the workload generators with NUM plus each thread's id (default 0)." << std::endl
+       << "  --placement=<POLICY>" << std::endl
+       << "    Where runner threads are pinned: scatter (round-robin over NUMA nodes, default), compact" << std::endl
+       << "    (node by node, SMT siblings together), physical-first (one thread per physical core before" << std::endl
+       << "    any SMT sibling), or file:<PATH> (the CPUs listed in PATH, in order). CPUs outside the" << std::endl
+       << "    process's cpuset are never used." << std::endl
+       << "  --housekeeping=<CPUS>" << std::endl
+       << "    Pin the epoch advancer, loggers and other service threads to CPUS (e.g. 0,1 or 0-1), and keep" << std::endl
+       << "    runner threads off them. Each service thread's CPU time is reported with the statistics." << std::endl;
     std::cout << ss.str() << std::flush;
 }
 
 
 template <typename DBParams>
-void ycsb_prepopulation_thread(int thread_id, ycsb_db<DBParams>& db, uint64_t key_begin, uint64_t key_end) {
-    set_affinity(thread_id);
+uint64_t ycsb_prepopulation_thread(int thread_id, ycsb_db<DBParams>& db, uint64_t key_begin, uint64_t key_end,
+                                   bool ordered) {
     ycsb_input_generator ig(thread_id);
     db.table_thread_init();
     for (uint64_t i = key_begin; i < key_end; ++i) {
@@ -65,29 +98,26 @@ void ycsb_prepopulation_thread(int thread_id, ycsb_db<DBParams>& db, uint64_t ke
         db.ycsb_half_tables(true).nontrans_put(ycsb_key(i), ig.random_ycsb_value<ycsb_half_value>());
         db.ycsb_half_tables(false).nontrans_put(ycsb_key(i), ig.random_ycsb_value<ycsb_half_value>());
 #else
-        db.ycsb_table().nontrans_put(ycsb_key(i), ig.random_ycsb_value<ycsb_value>());
+        if (ordered)
+            db.ycsb_otable().nontrans_put(ycsb_okey(i), ig.random_ycsb_value<ycsb_value>());
+        else
+            db.ycsb_table().nontrans_put(ycsb_key(i), ig.random_ycsb_value<ycsb_value>());
 #endif
     }
+    return key_end - key_begin;
 }
 
 template <typename DBParams>
-void ycsb_db<DBParams>::prepopulate() {
-    static constexpr uint64_t nthreads = 32;
-    uint64_t key_begin, key_end;
+void ycsb_db<DBParams>::prepopulate(bool ordered) {
+    static constexpr int nthreads = 32;
     uint64_t segment_size = ycsb_table_size / nthreads;
-    key_begin = 0;
-    key_end = segment_size;
 
-    std::vector<std::thread> prepopulators;
-
-    for (uint64_t tid = 0; tid < nthreads; ++tid) {
-        prepopulators.emplace_back(ycsb_prepopulation_thread<DBParams>, (int)tid, std::ref(*this), key_begin, key_end);
-        key_begin += segment_size;
-        key_end += segment_size;
-    }
-
-    for (auto& t : prepopulators)
-        t.join();
+    // the table isn't partitioned, so loader t runs where runner t would
+    bench::db_loader loader("ycsb", nthreads, nthreads, [](int part) { return part; });
+    loader.run([&](int part) {
+            uint64_t key_begin = part * segment_size;
+            return ycsb_prepopulation_thread<DBParams>(part, *this, key_begin, key_begin + segment_size, ordered);
+        });
 }
 
 template <typename DBParams>
@@ -101,7 +131,8 @@ public:
         uint64_t collapse2_count;
     };
 
-    static void ycsb_runner_thread(ycsb_db<DBParams>& db, db_profiler& prof, ycsb_runner<DBParams>& runner, double time_limit, results& txn_result) {
+    static void ycsb_runner_thread(ycsb_db<DBParams>& db, db_profiler& prof, ycsb_runner<DBParams>& runner, double time_limit,
+                                   bench::arrival_params load, bool stream, results& txn_result) {
         uint64_t local_cnt = 0;
         uint64_t collapse_cnt[2] = {0, 0};
         db.table_thread_init();
@@ -111,20 +142,25 @@ public:
 
         uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
         auto start_t = prof.start_timestamp();
+        bench::arrival_schedule arrivals(load, constants::processor_tsc_frequency * constants::billion,
+                                         start_t, constants::workload_seed + runner.id());
 
         auto it = runner.workload.begin();
+        ycsb_txn_t streamed;
 
         while (true) {
-            auto curr_t = read_tsc();
-            if ((curr_t - start_t) >= tsc_diff)
+            if (!arrivals.wait(start_t + tsc_diff))
                 break;
 
-            runner.run_txn(*it);
-            if (it->collapse_type) {
-                ++collapse_cnt[it->collapse_type - 1];
+            if (stream)
+                runner.next_txn(streamed);
+            const ycsb_txn_t& txn = stream ? streamed : *it;
+            runner.run_txn(txn);
+            arrivals.record(txn.rw_txn);
+            if (txn.collapse_type) {
+                ++collapse_cnt[txn.collapse_type - 1];
             }
-            ++it;
-            if (it == runner.workload.end())
+            if (!stream && ++it == runner.workload.end())
                 it = runner.workload.begin();
 
             ++local_cnt;
@@ -135,7 +171,43 @@ public:
         txn_result.collapse2_count = collapse_cnt[1];
     }
 
-    static void workload_generation(std::vector<ycsb_runner<DBParams>>& runners, mode_id mode) {
+    // Runner thread of the deterministic mode: the runners' transactions
+    // run in batches through engine, with no arrival schedule
+    static void ycsb_det_runner_thread(ycsb_db<DBParams>& db, db_profiler& prof, ycsb_runner<DBParams>& runner,
+                                       bench::det_engine<ycsb_txn_t>& engine, double time_limit, bool stream,
+                                       results& txn_result) {
+        uint64_t collapse_cnt[2] = {0, 0};
+        db.table_thread_init();
+
+        ::TThread::set_id(runner.id());
+        set_affinity(runner.id());
+
+        uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
+        auto start_t = prof.start_timestamp();
+        auto it = runner.workload.begin();
+
+        txn_result.count = engine.run(runner.id(),
+            [&] (ycsb_txn_t& txn, bench::det_lockset& locks) {
+                if (stream)
+                    runner.next_txn(txn);
+                else {
+                    txn = *it;
+                    if (++it == runner.workload.end())
+                        it = runner.workload.begin();
+                }
+                runner.det_declare(txn, locks);
+            },
+            [&] (ycsb_txn_t& txn) {
+                runner.det_run_txn(txn);
+                if (txn.collapse_type)
+                    ++collapse_cnt[txn.collapse_type - 1];
+            },
+            [&] { return read_tsc() - start_t >= tsc_diff; });
+        txn_result.collapse1_count = collapse_cnt[0];
+        txn_result.collapse2_count = collapse_cnt[1];
+    }
+
+    static void workload_generation(std::vector<ycsb_runner<DBParams>>& runners, mode_id mode, bool stream) {
         std::vector<std::thread> thrs;
         int tsize = 16;
         if (mode == mode_id::ReadOnly) {
@@ -148,23 +220,37 @@ public:
             tsize = -3;
         }
         for (uint64_t i = 0; i < runners.size(); ++i) {
-            thrs.emplace_back(
-                    &ycsb_runner<DBParams>::gen_workload, std::ref(runners[i]), i, tsize);
+            if (stream)
+                runners[i].stream_init(i, tsize);
+            else
+                thrs.emplace_back(
+                        &ycsb_runner<DBParams>::gen_workload, std::ref(runners[i]), i, tsize);
         }
         for (auto& t : thrs)
             t.join();
     }
 
-    static results run_benchmark(ycsb_db<DBParams>& db, db_profiler& prof, std::vector<ycsb_runner<DBParams>>& runners, double time_limit) {
+    static results run_benchmark(ycsb_db<DBParams>& db, db_profiler& prof, std::vector<ycsb_runner<DBParams>>& runners, double time_limit,
+                                 bench::arrival_params load, bool stream) {
         int num_runners = runners.size();
         std::vector<std::thread> runner_thrs;
         std::vector<results> txn_cnts;
         txn_cnts.resize(num_runners);
 
+        std::unique_ptr<bench::det_engine<ycsb_txn_t>> engine;
+        if (DBParams::Deterministic)
+            engine.reset(new bench::det_engine<ycsb_txn_t>(num_runners));
+
         for (int i = 0; i < num_runners; ++i) {
-            txn_cnts.emplace_back();
+            if constexpr (DBParams::Deterministic) {
+                runner_thrs.emplace_back(ycsb_det_runner_thread, std::ref(db), std::ref(prof),
+                                         std::ref(runners[i]), std::ref(*engine), time_limit, stream,
+                                         std::ref(txn_cnts[i]));
+                continue;
+            }
             runner_thrs.emplace_back(ycsb_runner_thread, std::ref(db), std::ref(prof),
-                                     std::ref(runners[i]), time_limit, std::ref(txn_cnts[i]));
+                                     std::ref(runners[i]), time_limit, load, stream,
+                                     std::ref(txn_cnts[i]));
         }
 
         for (auto &t : runner_thrs)
@@ -189,6 +275,9 @@ public:
         mode_id mode = mode_id::ReadOnly;
         double time_limit = 10.0;
         bool enable_gc = false;
+        bench::arrival_params load;
+        bool stream = false;
+        mode_id core = mode_id::ReadOnly;
 
         Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
 
@@ -245,6 +334,34 @@ public:
                 break;
             case opt_comm:
                 break;
+            case opt_cm:
+                break;
+            case opt_place:
+                break;
+            case opt_hk:
+                break;
+            case opt_rate:
+                load.rate = std::max(clp->val.d, 0.0);
+                break;
+            case opt_pois:
+                load.poisson = !clp->negated;
+                break;
+            case opt_strm:
+                stream = !clp->negated;
+                break;
+            case opt_seed:
+                db_params::constants::workload_seed = clp->val.u;
+                break;
+            case opt_core: {
+                char c = clp->val.s ? *clp->val.s : 0;
+                if (c < 'A' || c > 'F') {
+                    print_usage(argv[0]);
+                    ret = 1;
+                    clp_stop = true;
+                } else
+                    core = mode_id(int(mode_id::CoreA) + (c - 'A'));
+                break;
+            }
             default:
                 print_usage(argv[0]);
                 ret = 1;
@@ -270,11 +387,16 @@ public:
                       << (counter_mode ? "counter" : "record") << " mode" << std::endl;
         }
 
+        if (is_core_mode(core)) {
+            mode = core;
+            std::cout << "YCSB core workload " << char('A' + (int(core) - int(mode_id::CoreA))) << std::endl;
+        }
+
         db_profiler prof(spawn_perf);
         ycsb_db<DBParams> db;
 
         std::cout << "Prepopulating database..." << std::endl;
-        db.prepopulate();
+        db.prepopulate(is_core_mode(mode));
         std::cout << "Prepopulation complete." << std::endl;
 
         std::vector<ycsb_runner<DBParams>> runners;
@@ -283,8 +405,8 @@ public:
         }
 
         std::thread advancer;
-        std::cout << "Generating workload..." << std::endl;
-        workload_generation(runners, mode);
+        std::cout << (stream ? "Streaming workload..." : "Generating workload...") << std::endl;
+        workload_generation(runners, mode, stream);
         std::cout << "Done." << std::endl;
         std::cout << "Garbage collection: ";
         if (enable_gc) {
@@ -294,10 +416,24 @@ public:
         } else {
             std::cout << "disabled";
         }
-        std::cout << std::endl << std::flush;
-
+        std::cout << std::endl;
+        if (DBParams::Deterministic && load.rate > 0) {
+            std::cerr << "Warning: arrival rate ignored in deterministic mode." << std::endl;
+            load.rate = 0;
+        }
+        if (load.rate > 0)
+            std::cout << "Open loop: " << load.rate << " txns/sec per thread, "
+                      << (load.poisson ? "Poisson" : "constant") << " arrivals" << std::endl;
+        std::cout << std::flush;
+
+        bench::latency_profile::name_types({"read_only", "read_write"});
+        prof.describe<DBParams>("ycsb", num_threads);
+        prof.config("mode", int(mode));
+        prof.config("time_limit", time_limit);
+        prof.config("gc", enable_gc);
+        prof.config("arrival_rate", load.rate);
         prof.start(profiler_mode);
-        auto result = run_benchmark(db, prof, runners, time_limit);
+        auto result = run_benchmark(db, prof, runners, time_limit, load, stream);
         auto elapsed_ms = prof.finish(result.count);
         if (result.collapse1_count || result.collapse2_count) {
             std::cout << "Collapse 1 throughput: " << (double)result.collapse1_count / (elapsed_ms / 1000) << " txns/sec" << std::endl;
@@ -347,6 +483,33 @@ int main(int argc, const char *const *argv) {
         case opt_comm:
             enable_commute = !clp->negated;
             break;
+        case opt_cm:
+            if (!ContentionManager::set_policy(clp->val.s)) {
+                std::cout << "Unsupported contention management policy: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_place:
+            if (!set_placement(clp->val.s)) {
+                std::cout << "Unsupported thread placement: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
+        case opt_hk:
+            if (!set_housekeeping_cpus(clp->val.s)) {
+                std::cout << "Bad housekeeping CPU list: "
+                    << ((clp->val.s == nullptr) ? "" : std::string(clp->val.s)) << std::endl;
+                print_usage(argv[0]);
+                ret_code = 1;
+                clp_stop = true;
+            }
+            break;
         default:
             break;
         }
@@ -409,6 +572,12 @@ int main(int argc, const char *const *argv) {
             ret_code = ycsb_access<db_mvcc_params>::execute(argc, argv);
         }
         break;
+    case db_params_id::Deterministic:
+        if (node_tracking || enable_commute) {
+            std::cerr << "Warning: node tracking and commute options ignored." << std::endl;
+        }
+        ret_code = ycsb_access<db_det_params>::execute(argc, argv);
+        break;
     default:
         std::cerr << "unknown db config parameter id" << std::endl;
         ret_code = 1;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include "compiler.hh"
@@ -14,6 +16,7 @@
 #endif
 #include "DB_index.hh"
 #include "DB_params.hh"
+#include "DB_deterministic.hh"
 
 #if TABLE_FINE_GRAINED
 #include "ycsb_split_params_ts.hh"
@@ -21,6 +24,16 @@
 #include "ycsb_split_params_default.hh"
 #endif
 
+// Build the ordered table on the adaptive radix tree instead of Masstree
+#ifndef YCSB_ART_INDEX
+#define YCSB_ART_INDEX 0
+#endif
+
+// Build the ordered table on the optimistic B+tree instead of Masstree
+#ifndef YCSB_BTREE_INDEX
+#define YCSB_BTREE_INDEX 0
+#endif
+
 namespace ycsb {
 
 using bench::mvcc_ordered_index;
@@ -36,37 +49,61 @@ public:
     template <typename K, typename V>
     using OIndex = typename std::conditional<DBParams::MVCC,
           mvcc_ordered_index<K, V, DBParams>,
-          ordered_index<K, V, DBParams>>::type;
+          bench::ordered_index_on<YCSB_ART_INDEX ? bench::ordered_engine::art
+                                  : YCSB_BTREE_INDEX ? bench::ordered_engine::btree
+                                  : bench::ordered_engine::masstree,
+                                  K, V, DBParams>>::type;
     template <typename K, typename V>
     using UIndex = typename std::conditional<DBParams::MVCC,
         mvcc_unordered_index<K, V, DBParams>,
         unordered_index<K, V, DBParams>>::type;
 
     typedef UIndex<ycsb_key, ycsb_value> ycsb_table_type;
+    // the core workloads' table; scans need key order
+    typedef OIndex<ycsb_okey, ycsb_value> ycsb_otable_type;
 
-    explicit ycsb_db() : ycsb_table_(ycsb_table_size) {}
+    explicit ycsb_db() : ycsb_table_(ycsb_table_size), ycsb_otable_(ycsb_table_size), next_key_(ycsb_table_size) {}
 
     ycsb_table_type& ycsb_table() {
         return ycsb_table_;
     }
+    ycsb_otable_type& ycsb_otable() {
+        return ycsb_otable_;
+    }
 
     void table_thread_init() {
         ycsb_table_.thread_init();
+        ycsb_otable_.thread_init();
     }
 
-    void prepopulate();
+    // Loads keys [0, ycsb_table_size) into one of the tables
+    void prepopulate(bool ordered);
+
+    // Keys handed out so far, loaded or claimed for insert
+    uint64_t key_count() const {
+        return next_key_.load(std::memory_order_relaxed);
+    }
+    uint64_t claim_key() {
+        return next_key_.fetch_add(1, std::memory_order_relaxed);
+    }
 
 private:
     ycsb_table_type ycsb_table_;
+    ycsb_otable_type ycsb_otable_;
+    std::atomic<uint64_t> next_key_;
 };
 
 struct ycsb_op_t {
-    ycsb_op_t() : is_write(), key(), col_n() {}
+    ycsb_op_t() : is_write(), key(), col_n(), kind(), latest(), scan_len() {}
     ycsb_op_t(bool w, uint32_t k, int32_t c)
-            : is_write(w), key(k), col_n(c) {}
+            : is_write(w), key(k), col_n(c), kind(w ? ycsb_op_kind::update : ycsb_op_kind::read),
+              latest(), scan_len() {}
     bool is_write;
     uint32_t key;
     int16_t col_n;
+    ycsb_op_kind kind;
+    bool latest;        // key counts back from the newest key
+    uint16_t scan_len;
     col_type write_value;
 };
 
@@ -108,17 +145,30 @@ public:
                 write_threshold = (uint32_t) (std::numeric_limits<uint32_t>::max()/20);
                 break;
             default:
+                // core workloads: YCSB's request distribution constant
+                dd = new sampling::StoZipfDistribution<>(ig.generator(), 0, ycsb_table_size - 1, 0.99);
                 break;
         }
     }
 
+    // Pre-generates a fixed trace into workload, replayed in a cycle
     inline void gen_workload(uint64_t threadid, int txn_size);
+    // Or generates each transaction as it runs, with constant memory
+    inline void stream_init(uint64_t threadid, int txn_size);
+    inline void next_txn(ycsb_txn_t& txn);
 
     int id() const {
         return runner_id;
     }
 
     inline void run_txn(const ycsb_txn_t& txn);
+    inline void run_core_txn(const ycsb_txn_t& txn);
+
+    // Deterministic mode (db_det_params): declares txn's locks, first
+    // resolving its latest keys and claiming its insert keys, then runs it
+    // with the tables' nontrans accessors once the locks are held
+    inline void det_declare(ycsb_txn_t& txn, bench::det_lockset& locks);
+    inline void det_run_txn(const ycsb_txn_t& txn);
 
     std::vector<ycsb_txn_t> workload;
 
@@ -132,6 +182,19 @@ private:
     sampling::StoRandomDistribution<> *dd;
 
     uint32_t write_threshold;
+
+    std::unique_ptr<sampling::xoshiro256ss> stream_rng;
+    std::unique_ptr<sampling::StoZipfRejectionSampler<uint32_t>> stream_zipf;
+    uint64_t stream_tid = 0;
+    int stream_txn_size = 0;
+    std::vector<uint32_t> key_buf;
+
+    template <typename KeyGen, typename RandGen>
+    inline void make_txn(ycsb_txn_t& txn, uint64_t threadid, int txn_size, KeyGen&& key, RandGen&& rand);
+    template <typename KeyGen, typename RandGen>
+    inline void make_core_txn(ycsb_txn_t& txn, KeyGen&& key, RandGen&& rand);
+    template <typename Table, typename Value>
+    inline void update_column(Table& table, uintptr_t row, const Value& value, const ycsb_op_t& op);
 };
 
 }; // namespace ycsb
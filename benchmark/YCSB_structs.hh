@@ -3,6 +3,7 @@
 #include <string>
 #include <random>
 
+#include "DB_params.hh"
 #include "DB_structs.hh" // bench::fix_string
 #include "str.hh" // lcdf::Str
 #include "Interface.hh"
@@ -10,13 +11,25 @@
 
 namespace ycsb {
 
+using bench::bswap;
 using bench::fix_string;
 using bench::get_version;
 using bench::version_adapter;
 
 enum class mode_id : int {
     ReadOnly = 0, MediumContention, HighContention,
-    WriteCollapse, RWCollapse, ReadCollapse
+    WriteCollapse, RWCollapse, ReadCollapse,
+    // the YCSB core workloads A-F, on the ordered table
+    CoreA, CoreB, CoreC, CoreD, CoreE, CoreF
+};
+
+inline bool is_core_mode(mode_id mode) {
+    return mode >= mode_id::CoreA;
+}
+
+// Operations of the core workloads; the other modes only read and update
+enum class ycsb_op_kind : uint8_t {
+    read = 0, update, insert, scan, read_modify_write
 };
 
 struct ycsb_key {
@@ -38,6 +51,27 @@ struct ycsb_key {
     uint64_t w_id;
 };
 
+// Key of the ordered table: big-endian, so that scans run in key order
+struct ycsb_okey {
+    ycsb_okey(uint64_t id) {
+        w_id = bswap(id);
+    }
+    bool operator==(const ycsb_okey& other) const {
+        return w_id == other.w_id;
+    }
+    bool operator!=(const ycsb_okey& other) const {
+        return !(*this == other);
+    }
+    operator lcdf::Str() const {
+        return lcdf::Str((const char *)this, sizeof(*this));
+    }
+    uint64_t id() const {
+        return bswap(w_id);
+    }
+
+    uint64_t w_id;
+};
+
 #define COL_WIDTH 100
 #define HALF_NUM_COLUMNS 5
 typedef fix_string<COL_WIDTH> col_type;
@@ -69,7 +103,7 @@ struct ycsb_value {
 class ycsb_input_generator {
 public:
     ycsb_input_generator(int thread_id)
-            : gen(thread_id), dis(0, 61) {}
+            : gen(db_params::constants::workload_seed + thread_id), dis(0, 61) {}
 
     template <typename value_type>
     value_type random_ycsb_value() {
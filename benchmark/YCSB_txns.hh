@@ -1,7 +1,7 @@
 #pragma once
 
 
-#include <set>
+#include <algorithm>
 #include "YCSB_bench.hh"
 
 namespace ycsb {
@@ -11,74 +11,222 @@ static constexpr uint64_t max_txns = 200000;
 template <typename DBParams>
 void ycsb_runner<DBParams>::gen_workload(uint64_t threadid, int txn_size) {
     dist_init();
+    for (uint64_t i = 0; i < (txn_size < 0 ? 20 : max_txns); ++i) {
+        ycsb_txn_t txn {};
+        auto key = [this]() { return uint32_t(dd->sample()); };
+        auto rand = [this]() { return uint32_t(ud->sample()); };
+        if (is_core_mode(mode))
+            make_core_txn(txn, key, rand);
+        else
+            make_txn(txn, threadid, txn_size, key, rand);
+        workload.push_back(std::move(txn));
+    }
+}
+
+template <typename DBParams>
+void ycsb_runner<DBParams>::stream_init(uint64_t threadid, int txn_size) {
+    stream_rng.reset(new sampling::xoshiro256ss(db_params::constants::workload_seed + threadid + 1));
+    double skew = 0;
+    switch (mode) {
+        case mode_id::ReadOnly:
+            write_threshold = 0;
+            break;
+        case mode_id::HighContention:
+            skew = 0.99;
+            write_threshold = (uint32_t) (std::numeric_limits<uint32_t>::max()/2);
+            break;
+        default:
+            skew = is_core_mode(mode) ? 0.99 : 0.8;
+            write_threshold = (uint32_t) (std::numeric_limits<uint32_t>::max()/20);
+            break;
+    }
+    if (skew > 0)
+        stream_zipf.reset(new sampling::StoZipfRejectionSampler<uint32_t>(0, ycsb_table_size - 1, skew));
+    stream_tid = threadid;
+    stream_txn_size = txn_size;
+}
+
+template <typename DBParams>
+void ycsb_runner<DBParams>::next_txn(ycsb_txn_t& txn) {
+    auto& rng = *stream_rng;
+    auto* zipf = stream_zipf.get();
+    auto key = [&]() { return zipf ? zipf->sample(rng) : uint32_t(rng.below(ycsb_table_size)); };
+    auto rand = [&]() { return uint32_t(rng()); };
+    if (is_core_mode(mode))
+        make_core_txn(txn, key, rand);
+    else
+        make_txn(txn, stream_tid, stream_txn_size, key, rand);
+}
+
+// Operation mix of a core workload, in percent, as in YCSB's workloads/
+struct ycsb_core_mix {
+    int read, update, insert, scan, read_modify_write;
+    bool latest;  // request distribution: latest rather than zipfian
+};
+
+inline ycsb_core_mix core_mix_of(mode_id mode) {
+    switch (mode) {
+        case mode_id::CoreA: return {50, 50, 0, 0, 0, false};
+        case mode_id::CoreB: return {95, 5, 0, 0, 0, false};
+        case mode_id::CoreC: return {100, 0, 0, 0, 0, false};
+        case mode_id::CoreD: return {95, 0, 5, 0, 0, true};
+        case mode_id::CoreE: return {0, 0, 5, 95, 0, false};
+        case mode_id::CoreF: return {50, 0, 0, 0, 50, false};
+        default: always_assert(false, "not a core workload"); return {};
+    }
+}
+
+// Spreads zipfian ranks over the key space, like YCSB's scrambled zipfian,
+// so the popular keys are not neighbors (FNV-1a)
+inline uint32_t ycsb_scramble(uint32_t rank) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (int i = 0; i != 4; ++i, rank >>= 8)
+        h = (h ^ (rank & 0xFF)) * 0x100000001B3ULL;
+    return uint32_t(h % ycsb_table_size);
+}
+
+// One operation per transaction, as YCSB's clients issue them. Keys are
+// drawn from the loaded range; with the latest distribution, a key is a
+// zipfian rank counted back from the newest key when the operation runs.
+template <typename DBParams>
+template <typename KeyGen, typename RandGen>
+void ycsb_runner<DBParams>::make_core_txn(ycsb_txn_t& txn, KeyGen&& key, RandGen&& rand) {
+    auto mix = core_mix_of(mode);
+    txn.ops.resize(1);
+    ycsb_op_t& op = txn.ops[0];
+    int pct = rand() % 100;
+    if ((pct -= mix.read) < 0)
+        op.kind = ycsb_op_kind::read;
+    else if ((pct -= mix.update) < 0)
+        op.kind = ycsb_op_kind::update;
+    else if ((pct -= mix.insert) < 0)
+        op.kind = ycsb_op_kind::insert;
+    else if ((pct -= mix.scan) < 0)
+        op.kind = ycsb_op_kind::scan;
+    else
+        op.kind = ycsb_op_kind::read_modify_write;
+    op.latest = mix.latest;
+    op.key = mix.latest ? key() : ycsb_scramble(key());
+    op.col_n = rand() % (2*HALF_NUM_COLUMNS);
+    op.scan_len = op.kind == ycsb_op_kind::scan ? 1 + rand() % 100 : 0;
+    op.is_write = op.kind == ycsb_op_kind::update || op.kind == ycsb_op_kind::insert
+        || op.kind == ycsb_op_kind::read_modify_write;
+    if (op.is_write)
+        ig.random_ycsb_col_value_inplace(&op.write_value);
+    txn.collapse_type = 0;
+    txn.rw_txn = op.is_write;
+}
+
+// Fills txn with txn_size distinct keys, in key order, drawn from key();
+// rand() gives uniform 32-bit values for the write and column choices.
+// txn_size < 0 selects a collapse experiment instead.
+template <typename DBParams>
+template <typename KeyGen, typename RandGen>
+void ycsb_runner<DBParams>::make_txn(ycsb_txn_t& txn, uint64_t threadid, int txn_size,
+                                     KeyGen&& key, RandGen&& rand) {
     const int collapse = txn_size < 0 ? -txn_size : 0;
     int tsz_factor = 1;  // For collapse experiments
     bool write_first = false;  // For collapse experiments
-    for (uint64_t i = 0; i < (collapse ? 20 : max_txns); ++i) {
-        ycsb_txn_t txn {};
-        std::set<uint32_t> key_set;
-        uint8_t collapse_type = 0;
-        if (collapse) {
-            // Type 1 is read-write, type 2 is write-only
-            if (collapse == 1) {
-                collapse_type = threadid ? 1 : 2;
-                txn_size = 16;
-                tsz_factor = 1;
-                write_first = false;
-            } else if (collapse == 2) {
-                collapse_type = threadid ? 1 : 2;
-                txn_size = 16;
-                tsz_factor = 1;
-                write_first = true;
-            } else if (collapse == 3) {
-                collapse_type = threadid ? 2 : 1;
-                txn_size = 16;
-                tsz_factor = collapse_type == 2 ? 64 : 1;
-                write_first = true;
-            }
+    uint8_t collapse_type = 0;
+    if (collapse) {
+        // Type 1 is read-write, type 2 is write-only
+        txn_size = 16;
+        if (collapse == 1) {
+            collapse_type = threadid ? 1 : 2;
+        } else if (collapse == 2) {
+            collapse_type = threadid ? 1 : 2;
+            write_first = true;
+        } else if (collapse == 3) {
+            collapse_type = threadid ? 2 : 1;
+            tsz_factor = collapse_type == 2 ? 64 : 1;
+            write_first = true;
         }
-        txn.ops.reserve(txn_size);
+    }
+
+    auto& keys = key_buf;
+    keys.clear();
+    if (collapse) {
+        uint32_t k = key() % (txn_size * tsz_factor);
+        for (int j = 0; j < txn_size; ++j) {
+            keys.push_back(k);
+            k = (k + 1) % (txn_size * tsz_factor);
+        }
+    } else {
+        for (int j = 0; j < txn_size; ++j) {
+            uint32_t k;
+            do {
+                k = key();
+            } while (std::find(keys.begin(), keys.end(), k) != keys.end());
+            keys.push_back(k);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    txn.ops.resize(keys.size());
+    bool any_write = false;
+    for (size_t j = 0; j != keys.size(); ++j) {
+        ycsb_op_t& op = txn.ops[j];
         if (collapse) {
-            uint32_t key = dd->sample() % (txn_size * tsz_factor);
-            for (int j = 0; j < txn_size; ++j) {
-                key_set.insert(key);
-                key = (key + 1) % (txn_size * tsz_factor);
-            }
+            op.is_write = (collapse_type == 2) || (write_first && j == 0);
         } else {
-            for (int j = 0; j < txn_size; ++j) {
-                uint32_t key;
-                do {
-                    key = dd->sample();
-                } while (key_set.find(key) != key_set.end());
-                key_set.insert(key);
-            }
+            op.is_write = rand() < write_threshold;
         }
-        bool any_write = false;
-        for (auto it = key_set.begin(); it != key_set.end(); ++it) {
-            ycsb_op_t op {};
-            if (collapse) {
-                op.is_write = (collapse_type == 2) || (write_first && it == key_set.begin());
-                txn.collapse_type = collapse_type;
-            } else {
-                op.is_write = ud->sample() < write_threshold;
-            }
-            op.key = *it;
-            op.col_n = ud->sample() % (2*HALF_NUM_COLUMNS); /*column number*/
-            if (op.is_write) {
-                any_write = true;
-                ig.random_ycsb_col_value_inplace(&op.write_value);
-            }
-            txn.ops.push_back(std::move(op));
+        op.key = keys[j];
+        op.col_n = rand() % (2*HALF_NUM_COLUMNS); /*column number*/
+        if (op.is_write) {
+            any_write = true;
+            ig.random_ycsb_col_value_inplace(&op.write_value);
         }
-        txn.rw_txn = any_write;
-        workload.push_back(std::move(txn));
     }
+    txn.collapse_type = collapse_type;
+    txn.rw_txn = any_write;
 }
 
 using bench::access_t;
 
+// Writes op's column into row, whose current value is value
+template <typename DBParams>
+template <typename Table, typename Value>
+void ycsb_runner<DBParams>::update_column(Table& table, uintptr_t row, const Value& value, const ycsb_op_t& op) {
+    bool col_parity = op.col_n % 2;
+    (void)value; (void)col_parity;
+    if constexpr (Commute) {
+        commutators::Commutator<ycsb_value> comm(op.col_n, op.write_value);
+        table.update_row(row, comm);
+#if TABLE_FINE_GRAINED
+    } else if (DBParams::MVCC) {
+        // MVCC loop also does a tx_alloc, so we don't need to do
+        // one here
+        ycsb_value new_val_base;
+        ycsb_value* new_val = &new_val_base;
+        if (col_parity) {
+            new_val->odd_columns = value.odd_columns();
+            new_val->odd_columns[op.col_n/2] = op.write_value;
+        } else {
+            new_val->even_columns = value.even_columns();
+            new_val->even_columns[op.col_n/2] = op.write_value;
+        }
+        table.update_row(row, new_val);
+#endif
+    } else {
+        auto new_val = Sto::tx_alloc<ycsb_value>();
+        if (col_parity) {
+            new_val->odd_columns = value.odd_columns();
+            new_val->odd_columns[op.col_n/2] = op.write_value;
+        } else {
+            new_val->even_columns = value.even_columns();
+            new_val->even_columns[op.col_n/2] = op.write_value;
+        }
+        table.update_row(row, new_val);
+    }
+}
+
 template <typename DBParams>
 void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
+    if (is_core_mode(mode)) {
+        run_core_txn(txn);
+        return;
+    }
     col_type output;
     typedef ycsb_value::NamedColumn nm;
 
@@ -102,35 +250,7 @@ void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
                 TXN_DO(success);
                 assert(result);
 
-                if constexpr (Commute) {
-                    commutators::Commutator<ycsb_value> comm(op.col_n, op.write_value);
-                    db.ycsb_table().update_row(row, comm);
-#if TABLE_FINE_GRAINED
-                } else if (DBParams::MVCC) {
-                    // MVCC loop also does a tx_alloc, so we don't need to do
-                    // one here
-                    ycsb_value new_val_base;
-                    ycsb_value* new_val = &new_val_base;
-                    if (col_parity) {
-                        new_val->odd_columns = value.odd_columns();
-                        new_val->odd_columns[op.col_n/2] = op.write_value;
-                    } else {
-                        new_val->even_columns = value.even_columns();
-                        new_val->even_columns[op.col_n/2] = op.write_value;
-                    }
-                    db.ycsb_table().update_row(row, new_val);
-#endif
-                } else {
-                    auto new_val = Sto::tx_alloc<ycsb_value>();
-                    if (col_parity) {
-                        new_val->odd_columns = value.odd_columns();
-                        new_val->odd_columns[op.col_n/2] = op.write_value;
-                    } else {
-                        new_val->even_columns = value.even_columns();
-                        new_val->even_columns[op.col_n/2] = op.write_value;
-                    }
-                    db.ycsb_table().update_row(row, new_val);
-                }
+                update_column(db.ycsb_table(), row, value, op);
             } else {
                 ycsb_key key(op.key);
                 auto [success, result, row, value]
@@ -149,4 +269,149 @@ void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
     } RETRY(true);
 }
 
+template <typename DBParams>
+void ycsb_runner<DBParams>::run_core_txn(const ycsb_txn_t& txn) {
+    col_type output;
+    typedef ycsb_value::NamedColumn nm;
+    typedef typename ycsb_db<DBParams>::ycsb_otable_type table_type;
+    auto& table = db.ycsb_otable();
+
+    (void)output;
+
+    TRANSACTION {
+        if (DBParams::MVCC && txn.rw_txn) {
+            Sto::mvcc_rw_upgrade();
+        }
+        for (auto& op : txn.ops) {
+            bool col_parity = op.col_n % 2;
+            auto col_group = col_parity ? nm::odd_columns : nm::even_columns;
+            uint64_t k = op.key;
+            if (op.latest) {
+                uint64_t newest = db.key_count() - 1;
+                k = newest - std::min(k, newest);
+            }
+            switch (op.kind) {
+            case ycsb_op_kind::read: {
+                auto [success, result, row, value]
+                    = table.select_split_row(ycsb_okey(k), {{col_group, access_t::read}});
+                (void)row;
+                TXN_DO(success);
+                // a latest key can be claimed and not yet inserted
+                if (result)
+                    output = col_parity ? value.odd_columns()[op.col_n/2] : value.even_columns()[op.col_n/2];
+                break;
+            }
+            case ycsb_op_kind::update:
+            case ycsb_op_kind::read_modify_write: {
+                bool blind = Commute && op.kind == ycsb_op_kind::update;
+                auto [success, result, row, value]
+                    = table.select_split_row(ycsb_okey(k),
+                    {{col_group, blind ? access_t::write : access_t::update}}
+                );
+                (void)result;
+                TXN_DO(success);
+                assert(result);
+                if (op.kind == ycsb_op_kind::read_modify_write)
+                    output = col_parity ? value.odd_columns()[op.col_n/2] : value.even_columns()[op.col_n/2];
+                update_column(table, row, value, op);
+                break;
+            }
+            case ycsb_op_kind::insert: {
+                auto new_val = Sto::tx_alloc<ycsb_value>();
+                new_val->odd_columns.fill(op.write_value);
+                new_val->even_columns.fill(op.write_value);
+                auto [success, result] = table.insert_row(ycsb_okey(db.claim_key()), new_val);
+                (void)result;
+                TXN_DO(success);
+                assert(!result);
+                break;
+            }
+            case ycsb_op_kind::scan: {
+                auto scan_callback = [&] (const ycsb_okey&, const auto& scan_value) -> bool {
+                    auto v = (typename table_type::accessor_t)(scan_value);
+                    output = col_parity ? v.odd_columns()[op.col_n/2] : v.even_columns()[op.col_n/2];
+                    return true;
+                };
+                bool success = table.template range_scan<decltype(scan_callback), false/*reverse*/>(
+                        ycsb_okey(k), ycsb_okey(std::numeric_limits<uint64_t>::max()), scan_callback,
+                        {{col_group, access_t::read}}, true, op.scan_len);
+                TXN_DO(success);
+                break;
+            }
+            }
+        }
+    } RETRY(true);
+}
+
+template <typename DBParams>
+void ycsb_runner<DBParams>::det_declare(ycsb_txn_t& txn, bench::det_lockset& locks) {
+    for (auto& op : txn.ops) {
+        if (op.latest) {
+            uint64_t newest = db.key_count() - 1;
+            op.key = newest - std::min(uint64_t(op.key), newest);
+            op.latest = false;
+        }
+        if (op.kind == ycsb_op_kind::insert)
+            op.key = db.claim_key();
+        if (op.kind == ycsb_op_kind::scan) {
+            // the keys are dense, so a scan reads the next scan_len keys
+            for (uint64_t k = op.key; k != uint64_t(op.key) + op.scan_len; ++k)
+                locks.read(k);
+        } else if (op.is_write)
+            locks.write(op.key);
+        else
+            locks.read(op.key);
+    }
+}
+
+template <typename DBParams>
+void ycsb_runner<DBParams>::det_run_txn(const ycsb_txn_t& txn) {
+    col_type output;
+    (void)output;
+    auto column = [] (ycsb_value* v, const ycsb_op_t& op) -> col_type& {
+        return op.col_n % 2 ? v->odd_columns[op.col_n/2] : v->even_columns[op.col_n/2];
+    };
+
+    for (auto& op : txn.ops) {
+        if (!is_core_mode(mode)) {
+            ycsb_value* v = db.ycsb_table().nontrans_get(ycsb_key(op.key));
+            assert(v);
+            if (op.is_write)
+                column(v, op) = op.write_value;
+            else
+                output = column(v, op);
+            continue;
+        }
+        auto& table = db.ycsb_otable();
+        switch (op.kind) {
+        case ycsb_op_kind::read:
+            // a latest key can be claimed and not yet inserted
+            if (ycsb_value* v = table.nontrans_get(ycsb_okey(op.key)))
+                output = column(v, op);
+            break;
+        case ycsb_op_kind::update:
+        case ycsb_op_kind::read_modify_write: {
+            ycsb_value* v = table.nontrans_get(ycsb_okey(op.key));
+            assert(v);
+            if (op.kind == ycsb_op_kind::read_modify_write)
+                output = column(v, op);
+            column(v, op) = op.write_value;
+            break;
+        }
+        case ycsb_op_kind::insert: {
+            ycsb_value new_val;
+            new_val.odd_columns.fill(op.write_value);
+            new_val.even_columns.fill(op.write_value);
+            table.nontrans_put(ycsb_okey(op.key), new_val);
+            break;
+        }
+        case ycsb_op_kind::scan:
+            for (uint64_t k = op.key; k != uint64_t(op.key) + op.scan_len; ++k)
+                if (ycsb_value* v = table.nontrans_get(ycsb_okey(k)))
+                    output = column(v, op);
+            break;
+        }
+    }
+}
+
 };
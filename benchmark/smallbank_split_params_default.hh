@@ -0,0 +1,309 @@
+namespace bench {
+
+
+template <>
+struct SplitParams<smallbank::accounts_row> {
+  using split_type_list = std::tuple<smallbank::accounts_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const smallbank::accounts_row& in) -> smallbank::accounts_row {
+      smallbank::accounts_row out;
+      out.name = in.name;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](smallbank::accounts_row* out, const smallbank::accounts_row& in) -> void {
+      out->name = in.name;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, smallbank::accounts_row> {
+ public:
+  
+  const var_string<64>& name() const {
+    return impl().name_impl();
+  }
+
+
+  void copy_into(smallbank::accounts_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<smallbank::accounts_row> : public RecordAccessor<UniRecordAccessor<smallbank::accounts_row>, smallbank::accounts_row> {
+ public:
+  UniRecordAccessor(const smallbank::accounts_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const var_string<64>& name_impl() const {
+    return vptr_->name;
+  }
+
+
+  
+  void copy_into_impl(smallbank::accounts_row* dst) const {
+    
+    if (vptr_) {
+      dst->name = vptr_->name;
+    }
+  }
+
+
+  const smallbank::accounts_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<smallbank::accounts_row>, smallbank::accounts_row>;
+};
+
+template <>
+class SplitRecordAccessor<smallbank::accounts_row> : public RecordAccessor<SplitRecordAccessor<smallbank::accounts_row>, smallbank::accounts_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<smallbank::accounts_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<smallbank::accounts_row*>(vptrs[0])) {}
+
+ private:
+  
+  const var_string<64>& name_impl() const {
+    return vptr_0_->name;
+  }
+
+
+  
+  void copy_into_impl(smallbank::accounts_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->name = vptr_0_->name;
+    }
+
+  }
+
+
+  const smallbank::accounts_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<smallbank::accounts_row>, smallbank::accounts_row>;
+};
+
+
+template <>
+struct SplitParams<smallbank::savings_row> {
+  using split_type_list = std::tuple<smallbank::savings_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const smallbank::savings_row& in) -> smallbank::savings_row {
+      smallbank::savings_row out;
+      out.bal = in.bal;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](smallbank::savings_row* out, const smallbank::savings_row& in) -> void {
+      out->bal = in.bal;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, smallbank::savings_row> {
+ public:
+  
+  const float& bal() const {
+    return impl().bal_impl();
+  }
+
+
+  void copy_into(smallbank::savings_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<smallbank::savings_row> : public RecordAccessor<UniRecordAccessor<smallbank::savings_row>, smallbank::savings_row> {
+ public:
+  UniRecordAccessor(const smallbank::savings_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const float& bal_impl() const {
+    return vptr_->bal;
+  }
+
+
+  
+  void copy_into_impl(smallbank::savings_row* dst) const {
+    
+    if (vptr_) {
+      dst->bal = vptr_->bal;
+    }
+  }
+
+
+  const smallbank::savings_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<smallbank::savings_row>, smallbank::savings_row>;
+};
+
+template <>
+class SplitRecordAccessor<smallbank::savings_row> : public RecordAccessor<SplitRecordAccessor<smallbank::savings_row>, smallbank::savings_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<smallbank::savings_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<smallbank::savings_row*>(vptrs[0])) {}
+
+ private:
+  
+  const float& bal_impl() const {
+    return vptr_0_->bal;
+  }
+
+
+  
+  void copy_into_impl(smallbank::savings_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->bal = vptr_0_->bal;
+    }
+
+  }
+
+
+  const smallbank::savings_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<smallbank::savings_row>, smallbank::savings_row>;
+};
+
+
+template <>
+struct SplitParams<smallbank::checking_row> {
+  using split_type_list = std::tuple<smallbank::checking_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const smallbank::checking_row& in) -> smallbank::checking_row {
+      smallbank::checking_row out;
+      out.bal = in.bal;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](smallbank::checking_row* out, const smallbank::checking_row& in) -> void {
+      out->bal = in.bal;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, smallbank::checking_row> {
+ public:
+  
+  const float& bal() const {
+    return impl().bal_impl();
+  }
+
+
+  void copy_into(smallbank::checking_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<smallbank::checking_row> : public RecordAccessor<UniRecordAccessor<smallbank::checking_row>, smallbank::checking_row> {
+ public:
+  UniRecordAccessor(const smallbank::checking_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const float& bal_impl() const {
+    return vptr_->bal;
+  }
+
+
+  
+  void copy_into_impl(smallbank::checking_row* dst) const {
+    
+    if (vptr_) {
+      dst->bal = vptr_->bal;
+    }
+  }
+
+
+  const smallbank::checking_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<smallbank::checking_row>, smallbank::checking_row>;
+};
+
+template <>
+class SplitRecordAccessor<smallbank::checking_row> : public RecordAccessor<SplitRecordAccessor<smallbank::checking_row>, smallbank::checking_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<smallbank::checking_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<smallbank::checking_row*>(vptrs[0])) {}
+
+ private:
+  
+  const float& bal_impl() const {
+    return vptr_0_->bal;
+  }
+
+
+  
+  void copy_into_impl(smallbank::checking_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->bal = vptr_0_->bal;
+    }
+
+  }
+
+
+  const smallbank::checking_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<smallbank::checking_row>, smallbank::checking_row>;
+};
+
+} // namespace bench
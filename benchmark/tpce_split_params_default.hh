@@ -0,0 +1,2652 @@
+namespace bench {
+
+
+template <>
+struct SplitParams<tpce::customer_row> {
+  using split_type_list = std::tuple<tpce::customer_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::customer_row& in) -> tpce::customer_row {
+      tpce::customer_row out;
+      out.c_tax_id = in.c_tax_id;
+      out.c_st_id = in.c_st_id;
+      out.c_l_name = in.c_l_name;
+      out.c_f_name = in.c_f_name;
+      out.c_m_name = in.c_m_name;
+      out.c_gndr = in.c_gndr;
+      out.c_tier = in.c_tier;
+      out.c_dob = in.c_dob;
+      out.c_ad_id = in.c_ad_id;
+      out.c_ctry_1 = in.c_ctry_1;
+      out.c_area_1 = in.c_area_1;
+      out.c_local_1 = in.c_local_1;
+      out.c_ext_1 = in.c_ext_1;
+      out.c_ctry_2 = in.c_ctry_2;
+      out.c_area_2 = in.c_area_2;
+      out.c_local_2 = in.c_local_2;
+      out.c_ext_2 = in.c_ext_2;
+      out.c_ctry_3 = in.c_ctry_3;
+      out.c_area_3 = in.c_area_3;
+      out.c_local_3 = in.c_local_3;
+      out.c_ext_3 = in.c_ext_3;
+      out.c_email_1 = in.c_email_1;
+      out.c_email_2 = in.c_email_2;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::customer_row* out, const tpce::customer_row& in) -> void {
+      out->c_tax_id = in.c_tax_id;
+      out->c_st_id = in.c_st_id;
+      out->c_l_name = in.c_l_name;
+      out->c_f_name = in.c_f_name;
+      out->c_m_name = in.c_m_name;
+      out->c_gndr = in.c_gndr;
+      out->c_tier = in.c_tier;
+      out->c_dob = in.c_dob;
+      out->c_ad_id = in.c_ad_id;
+      out->c_ctry_1 = in.c_ctry_1;
+      out->c_area_1 = in.c_area_1;
+      out->c_local_1 = in.c_local_1;
+      out->c_ext_1 = in.c_ext_1;
+      out->c_ctry_2 = in.c_ctry_2;
+      out->c_area_2 = in.c_area_2;
+      out->c_local_2 = in.c_local_2;
+      out->c_ext_2 = in.c_ext_2;
+      out->c_ctry_3 = in.c_ctry_3;
+      out->c_area_3 = in.c_area_3;
+      out->c_local_3 = in.c_local_3;
+      out->c_ext_3 = in.c_ext_3;
+      out->c_email_1 = in.c_email_1;
+      out->c_email_2 = in.c_email_2;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::customer_row> {
+ public:
+  
+  const var_string<20>& c_tax_id() const {
+    return impl().c_tax_id_impl();
+  }
+
+  
+  const fix_string<4>& c_st_id() const {
+    return impl().c_st_id_impl();
+  }
+
+  
+  const var_string<30>& c_l_name() const {
+    return impl().c_l_name_impl();
+  }
+
+  
+  const var_string<30>& c_f_name() const {
+    return impl().c_f_name_impl();
+  }
+
+  
+  const fix_string<1>& c_m_name() const {
+    return impl().c_m_name_impl();
+  }
+
+  
+  const fix_string<1>& c_gndr() const {
+    return impl().c_gndr_impl();
+  }
+
+  
+  const int32_t& c_tier() const {
+    return impl().c_tier_impl();
+  }
+
+  
+  const uint32_t& c_dob() const {
+    return impl().c_dob_impl();
+  }
+
+  
+  const int64_t& c_ad_id() const {
+    return impl().c_ad_id_impl();
+  }
+
+  
+  const fix_string<3>& c_ctry_1() const {
+    return impl().c_ctry_1_impl();
+  }
+
+  
+  const fix_string<3>& c_area_1() const {
+    return impl().c_area_1_impl();
+  }
+
+  
+  const fix_string<10>& c_local_1() const {
+    return impl().c_local_1_impl();
+  }
+
+  
+  const fix_string<5>& c_ext_1() const {
+    return impl().c_ext_1_impl();
+  }
+
+  
+  const fix_string<3>& c_ctry_2() const {
+    return impl().c_ctry_2_impl();
+  }
+
+  
+  const fix_string<3>& c_area_2() const {
+    return impl().c_area_2_impl();
+  }
+
+  
+  const fix_string<10>& c_local_2() const {
+    return impl().c_local_2_impl();
+  }
+
+  
+  const fix_string<5>& c_ext_2() const {
+    return impl().c_ext_2_impl();
+  }
+
+  
+  const fix_string<3>& c_ctry_3() const {
+    return impl().c_ctry_3_impl();
+  }
+
+  
+  const fix_string<3>& c_area_3() const {
+    return impl().c_area_3_impl();
+  }
+
+  
+  const fix_string<10>& c_local_3() const {
+    return impl().c_local_3_impl();
+  }
+
+  
+  const fix_string<5>& c_ext_3() const {
+    return impl().c_ext_3_impl();
+  }
+
+  
+  const var_string<50>& c_email_1() const {
+    return impl().c_email_1_impl();
+  }
+
+  
+  const var_string<50>& c_email_2() const {
+    return impl().c_email_2_impl();
+  }
+
+
+  void copy_into(tpce::customer_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::customer_row> : public RecordAccessor<UniRecordAccessor<tpce::customer_row>, tpce::customer_row> {
+ public:
+  UniRecordAccessor(const tpce::customer_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const var_string<20>& c_tax_id_impl() const {
+    return vptr_->c_tax_id;
+  }
+
+  
+  const fix_string<4>& c_st_id_impl() const {
+    return vptr_->c_st_id;
+  }
+
+  
+  const var_string<30>& c_l_name_impl() const {
+    return vptr_->c_l_name;
+  }
+
+  
+  const var_string<30>& c_f_name_impl() const {
+    return vptr_->c_f_name;
+  }
+
+  
+  const fix_string<1>& c_m_name_impl() const {
+    return vptr_->c_m_name;
+  }
+
+  
+  const fix_string<1>& c_gndr_impl() const {
+    return vptr_->c_gndr;
+  }
+
+  
+  const int32_t& c_tier_impl() const {
+    return vptr_->c_tier;
+  }
+
+  
+  const uint32_t& c_dob_impl() const {
+    return vptr_->c_dob;
+  }
+
+  
+  const int64_t& c_ad_id_impl() const {
+    return vptr_->c_ad_id;
+  }
+
+  
+  const fix_string<3>& c_ctry_1_impl() const {
+    return vptr_->c_ctry_1;
+  }
+
+  
+  const fix_string<3>& c_area_1_impl() const {
+    return vptr_->c_area_1;
+  }
+
+  
+  const fix_string<10>& c_local_1_impl() const {
+    return vptr_->c_local_1;
+  }
+
+  
+  const fix_string<5>& c_ext_1_impl() const {
+    return vptr_->c_ext_1;
+  }
+
+  
+  const fix_string<3>& c_ctry_2_impl() const {
+    return vptr_->c_ctry_2;
+  }
+
+  
+  const fix_string<3>& c_area_2_impl() const {
+    return vptr_->c_area_2;
+  }
+
+  
+  const fix_string<10>& c_local_2_impl() const {
+    return vptr_->c_local_2;
+  }
+
+  
+  const fix_string<5>& c_ext_2_impl() const {
+    return vptr_->c_ext_2;
+  }
+
+  
+  const fix_string<3>& c_ctry_3_impl() const {
+    return vptr_->c_ctry_3;
+  }
+
+  
+  const fix_string<3>& c_area_3_impl() const {
+    return vptr_->c_area_3;
+  }
+
+  
+  const fix_string<10>& c_local_3_impl() const {
+    return vptr_->c_local_3;
+  }
+
+  
+  const fix_string<5>& c_ext_3_impl() const {
+    return vptr_->c_ext_3;
+  }
+
+  
+  const var_string<50>& c_email_1_impl() const {
+    return vptr_->c_email_1;
+  }
+
+  
+  const var_string<50>& c_email_2_impl() const {
+    return vptr_->c_email_2;
+  }
+
+
+  
+  void copy_into_impl(tpce::customer_row* dst) const {
+    
+    if (vptr_) {
+      dst->c_tax_id = vptr_->c_tax_id;
+      dst->c_st_id = vptr_->c_st_id;
+      dst->c_l_name = vptr_->c_l_name;
+      dst->c_f_name = vptr_->c_f_name;
+      dst->c_m_name = vptr_->c_m_name;
+      dst->c_gndr = vptr_->c_gndr;
+      dst->c_tier = vptr_->c_tier;
+      dst->c_dob = vptr_->c_dob;
+      dst->c_ad_id = vptr_->c_ad_id;
+      dst->c_ctry_1 = vptr_->c_ctry_1;
+      dst->c_area_1 = vptr_->c_area_1;
+      dst->c_local_1 = vptr_->c_local_1;
+      dst->c_ext_1 = vptr_->c_ext_1;
+      dst->c_ctry_2 = vptr_->c_ctry_2;
+      dst->c_area_2 = vptr_->c_area_2;
+      dst->c_local_2 = vptr_->c_local_2;
+      dst->c_ext_2 = vptr_->c_ext_2;
+      dst->c_ctry_3 = vptr_->c_ctry_3;
+      dst->c_area_3 = vptr_->c_area_3;
+      dst->c_local_3 = vptr_->c_local_3;
+      dst->c_ext_3 = vptr_->c_ext_3;
+      dst->c_email_1 = vptr_->c_email_1;
+      dst->c_email_2 = vptr_->c_email_2;
+    }
+  }
+
+
+  const tpce::customer_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::customer_row>, tpce::customer_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::customer_row> : public RecordAccessor<SplitRecordAccessor<tpce::customer_row>, tpce::customer_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::customer_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::customer_row*>(vptrs[0])) {}
+
+ private:
+  
+  const var_string<20>& c_tax_id_impl() const {
+    return vptr_0_->c_tax_id;
+  }
+
+  
+  const fix_string<4>& c_st_id_impl() const {
+    return vptr_0_->c_st_id;
+  }
+
+  
+  const var_string<30>& c_l_name_impl() const {
+    return vptr_0_->c_l_name;
+  }
+
+  
+  const var_string<30>& c_f_name_impl() const {
+    return vptr_0_->c_f_name;
+  }
+
+  
+  const fix_string<1>& c_m_name_impl() const {
+    return vptr_0_->c_m_name;
+  }
+
+  
+  const fix_string<1>& c_gndr_impl() const {
+    return vptr_0_->c_gndr;
+  }
+
+  
+  const int32_t& c_tier_impl() const {
+    return vptr_0_->c_tier;
+  }
+
+  
+  const uint32_t& c_dob_impl() const {
+    return vptr_0_->c_dob;
+  }
+
+  
+  const int64_t& c_ad_id_impl() const {
+    return vptr_0_->c_ad_id;
+  }
+
+  
+  const fix_string<3>& c_ctry_1_impl() const {
+    return vptr_0_->c_ctry_1;
+  }
+
+  
+  const fix_string<3>& c_area_1_impl() const {
+    return vptr_0_->c_area_1;
+  }
+
+  
+  const fix_string<10>& c_local_1_impl() const {
+    return vptr_0_->c_local_1;
+  }
+
+  
+  const fix_string<5>& c_ext_1_impl() const {
+    return vptr_0_->c_ext_1;
+  }
+
+  
+  const fix_string<3>& c_ctry_2_impl() const {
+    return vptr_0_->c_ctry_2;
+  }
+
+  
+  const fix_string<3>& c_area_2_impl() const {
+    return vptr_0_->c_area_2;
+  }
+
+  
+  const fix_string<10>& c_local_2_impl() const {
+    return vptr_0_->c_local_2;
+  }
+
+  
+  const fix_string<5>& c_ext_2_impl() const {
+    return vptr_0_->c_ext_2;
+  }
+
+  
+  const fix_string<3>& c_ctry_3_impl() const {
+    return vptr_0_->c_ctry_3;
+  }
+
+  
+  const fix_string<3>& c_area_3_impl() const {
+    return vptr_0_->c_area_3;
+  }
+
+  
+  const fix_string<10>& c_local_3_impl() const {
+    return vptr_0_->c_local_3;
+  }
+
+  
+  const fix_string<5>& c_ext_3_impl() const {
+    return vptr_0_->c_ext_3;
+  }
+
+  
+  const var_string<50>& c_email_1_impl() const {
+    return vptr_0_->c_email_1;
+  }
+
+  
+  const var_string<50>& c_email_2_impl() const {
+    return vptr_0_->c_email_2;
+  }
+
+
+  
+  void copy_into_impl(tpce::customer_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->c_tax_id = vptr_0_->c_tax_id;
+      dst->c_st_id = vptr_0_->c_st_id;
+      dst->c_l_name = vptr_0_->c_l_name;
+      dst->c_f_name = vptr_0_->c_f_name;
+      dst->c_m_name = vptr_0_->c_m_name;
+      dst->c_gndr = vptr_0_->c_gndr;
+      dst->c_tier = vptr_0_->c_tier;
+      dst->c_dob = vptr_0_->c_dob;
+      dst->c_ad_id = vptr_0_->c_ad_id;
+      dst->c_ctry_1 = vptr_0_->c_ctry_1;
+      dst->c_area_1 = vptr_0_->c_area_1;
+      dst->c_local_1 = vptr_0_->c_local_1;
+      dst->c_ext_1 = vptr_0_->c_ext_1;
+      dst->c_ctry_2 = vptr_0_->c_ctry_2;
+      dst->c_area_2 = vptr_0_->c_area_2;
+      dst->c_local_2 = vptr_0_->c_local_2;
+      dst->c_ext_2 = vptr_0_->c_ext_2;
+      dst->c_ctry_3 = vptr_0_->c_ctry_3;
+      dst->c_area_3 = vptr_0_->c_area_3;
+      dst->c_local_3 = vptr_0_->c_local_3;
+      dst->c_ext_3 = vptr_0_->c_ext_3;
+      dst->c_email_1 = vptr_0_->c_email_1;
+      dst->c_email_2 = vptr_0_->c_email_2;
+    }
+
+  }
+
+
+  const tpce::customer_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::customer_row>, tpce::customer_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::customer_account_row> {
+  using split_type_list = std::tuple<tpce::customer_account_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::customer_account_row& in) -> tpce::customer_account_row {
+      tpce::customer_account_row out;
+      out.ca_b_id = in.ca_b_id;
+      out.ca_c_id = in.ca_c_id;
+      out.ca_name = in.ca_name;
+      out.ca_tax_st = in.ca_tax_st;
+      out.ca_bal = in.ca_bal;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::customer_account_row* out, const tpce::customer_account_row& in) -> void {
+      out->ca_b_id = in.ca_b_id;
+      out->ca_c_id = in.ca_c_id;
+      out->ca_name = in.ca_name;
+      out->ca_tax_st = in.ca_tax_st;
+      out->ca_bal = in.ca_bal;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::customer_account_row> {
+ public:
+  
+  const int64_t& ca_b_id() const {
+    return impl().ca_b_id_impl();
+  }
+
+  
+  const int64_t& ca_c_id() const {
+    return impl().ca_c_id_impl();
+  }
+
+  
+  const var_string<50>& ca_name() const {
+    return impl().ca_name_impl();
+  }
+
+  
+  const int32_t& ca_tax_st() const {
+    return impl().ca_tax_st_impl();
+  }
+
+  
+  const float& ca_bal() const {
+    return impl().ca_bal_impl();
+  }
+
+
+  void copy_into(tpce::customer_account_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::customer_account_row> : public RecordAccessor<UniRecordAccessor<tpce::customer_account_row>, tpce::customer_account_row> {
+ public:
+  UniRecordAccessor(const tpce::customer_account_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const int64_t& ca_b_id_impl() const {
+    return vptr_->ca_b_id;
+  }
+
+  
+  const int64_t& ca_c_id_impl() const {
+    return vptr_->ca_c_id;
+  }
+
+  
+  const var_string<50>& ca_name_impl() const {
+    return vptr_->ca_name;
+  }
+
+  
+  const int32_t& ca_tax_st_impl() const {
+    return vptr_->ca_tax_st;
+  }
+
+  
+  const float& ca_bal_impl() const {
+    return vptr_->ca_bal;
+  }
+
+
+  
+  void copy_into_impl(tpce::customer_account_row* dst) const {
+    
+    if (vptr_) {
+      dst->ca_b_id = vptr_->ca_b_id;
+      dst->ca_c_id = vptr_->ca_c_id;
+      dst->ca_name = vptr_->ca_name;
+      dst->ca_tax_st = vptr_->ca_tax_st;
+      dst->ca_bal = vptr_->ca_bal;
+    }
+  }
+
+
+  const tpce::customer_account_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::customer_account_row>, tpce::customer_account_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::customer_account_row> : public RecordAccessor<SplitRecordAccessor<tpce::customer_account_row>, tpce::customer_account_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::customer_account_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::customer_account_row*>(vptrs[0])) {}
+
+ private:
+  
+  const int64_t& ca_b_id_impl() const {
+    return vptr_0_->ca_b_id;
+  }
+
+  
+  const int64_t& ca_c_id_impl() const {
+    return vptr_0_->ca_c_id;
+  }
+
+  
+  const var_string<50>& ca_name_impl() const {
+    return vptr_0_->ca_name;
+  }
+
+  
+  const int32_t& ca_tax_st_impl() const {
+    return vptr_0_->ca_tax_st;
+  }
+
+  
+  const float& ca_bal_impl() const {
+    return vptr_0_->ca_bal;
+  }
+
+
+  
+  void copy_into_impl(tpce::customer_account_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->ca_b_id = vptr_0_->ca_b_id;
+      dst->ca_c_id = vptr_0_->ca_c_id;
+      dst->ca_name = vptr_0_->ca_name;
+      dst->ca_tax_st = vptr_0_->ca_tax_st;
+      dst->ca_bal = vptr_0_->ca_bal;
+    }
+
+  }
+
+
+  const tpce::customer_account_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::customer_account_row>, tpce::customer_account_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::broker_row> {
+  using split_type_list = std::tuple<tpce::broker_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::broker_row& in) -> tpce::broker_row {
+      tpce::broker_row out;
+      out.b_st_id = in.b_st_id;
+      out.b_name = in.b_name;
+      out.b_num_trades = in.b_num_trades;
+      out.b_comm_total = in.b_comm_total;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::broker_row* out, const tpce::broker_row& in) -> void {
+      out->b_st_id = in.b_st_id;
+      out->b_name = in.b_name;
+      out->b_num_trades = in.b_num_trades;
+      out->b_comm_total = in.b_comm_total;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::broker_row> {
+ public:
+  
+  const fix_string<4>& b_st_id() const {
+    return impl().b_st_id_impl();
+  }
+
+  
+  const var_string<100>& b_name() const {
+    return impl().b_name_impl();
+  }
+
+  
+  const int32_t& b_num_trades() const {
+    return impl().b_num_trades_impl();
+  }
+
+  
+  const float& b_comm_total() const {
+    return impl().b_comm_total_impl();
+  }
+
+
+  void copy_into(tpce::broker_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::broker_row> : public RecordAccessor<UniRecordAccessor<tpce::broker_row>, tpce::broker_row> {
+ public:
+  UniRecordAccessor(const tpce::broker_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const fix_string<4>& b_st_id_impl() const {
+    return vptr_->b_st_id;
+  }
+
+  
+  const var_string<100>& b_name_impl() const {
+    return vptr_->b_name;
+  }
+
+  
+  const int32_t& b_num_trades_impl() const {
+    return vptr_->b_num_trades;
+  }
+
+  
+  const float& b_comm_total_impl() const {
+    return vptr_->b_comm_total;
+  }
+
+
+  
+  void copy_into_impl(tpce::broker_row* dst) const {
+    
+    if (vptr_) {
+      dst->b_st_id = vptr_->b_st_id;
+      dst->b_name = vptr_->b_name;
+      dst->b_num_trades = vptr_->b_num_trades;
+      dst->b_comm_total = vptr_->b_comm_total;
+    }
+  }
+
+
+  const tpce::broker_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::broker_row>, tpce::broker_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::broker_row> : public RecordAccessor<SplitRecordAccessor<tpce::broker_row>, tpce::broker_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::broker_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::broker_row*>(vptrs[0])) {}
+
+ private:
+  
+  const fix_string<4>& b_st_id_impl() const {
+    return vptr_0_->b_st_id;
+  }
+
+  
+  const var_string<100>& b_name_impl() const {
+    return vptr_0_->b_name;
+  }
+
+  
+  const int32_t& b_num_trades_impl() const {
+    return vptr_0_->b_num_trades;
+  }
+
+  
+  const float& b_comm_total_impl() const {
+    return vptr_0_->b_comm_total;
+  }
+
+
+  
+  void copy_into_impl(tpce::broker_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->b_st_id = vptr_0_->b_st_id;
+      dst->b_name = vptr_0_->b_name;
+      dst->b_num_trades = vptr_0_->b_num_trades;
+      dst->b_comm_total = vptr_0_->b_comm_total;
+    }
+
+  }
+
+
+  const tpce::broker_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::broker_row>, tpce::broker_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::security_row> {
+  using split_type_list = std::tuple<tpce::security_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::security_row& in) -> tpce::security_row {
+      tpce::security_row out;
+      out.s_issue = in.s_issue;
+      out.s_st_id = in.s_st_id;
+      out.s_name = in.s_name;
+      out.s_ex_id = in.s_ex_id;
+      out.s_co_id = in.s_co_id;
+      out.s_num_out = in.s_num_out;
+      out.s_start_date = in.s_start_date;
+      out.s_exch_date = in.s_exch_date;
+      out.s_pe = in.s_pe;
+      out.s_52wk_high = in.s_52wk_high;
+      out.s_52wk_high_date = in.s_52wk_high_date;
+      out.s_52wk_low = in.s_52wk_low;
+      out.s_52wk_low_date = in.s_52wk_low_date;
+      out.s_dividend = in.s_dividend;
+      out.s_yield = in.s_yield;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::security_row* out, const tpce::security_row& in) -> void {
+      out->s_issue = in.s_issue;
+      out->s_st_id = in.s_st_id;
+      out->s_name = in.s_name;
+      out->s_ex_id = in.s_ex_id;
+      out->s_co_id = in.s_co_id;
+      out->s_num_out = in.s_num_out;
+      out->s_start_date = in.s_start_date;
+      out->s_exch_date = in.s_exch_date;
+      out->s_pe = in.s_pe;
+      out->s_52wk_high = in.s_52wk_high;
+      out->s_52wk_high_date = in.s_52wk_high_date;
+      out->s_52wk_low = in.s_52wk_low;
+      out->s_52wk_low_date = in.s_52wk_low_date;
+      out->s_dividend = in.s_dividend;
+      out->s_yield = in.s_yield;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::security_row> {
+ public:
+  
+  const fix_string<6>& s_issue() const {
+    return impl().s_issue_impl();
+  }
+
+  
+  const fix_string<4>& s_st_id() const {
+    return impl().s_st_id_impl();
+  }
+
+  
+  const var_string<70>& s_name() const {
+    return impl().s_name_impl();
+  }
+
+  
+  const fix_string<6>& s_ex_id() const {
+    return impl().s_ex_id_impl();
+  }
+
+  
+  const int64_t& s_co_id() const {
+    return impl().s_co_id_impl();
+  }
+
+  
+  const int64_t& s_num_out() const {
+    return impl().s_num_out_impl();
+  }
+
+  
+  const uint32_t& s_start_date() const {
+    return impl().s_start_date_impl();
+  }
+
+  
+  const uint32_t& s_exch_date() const {
+    return impl().s_exch_date_impl();
+  }
+
+  
+  const float& s_pe() const {
+    return impl().s_pe_impl();
+  }
+
+  
+  const float& s_52wk_high() const {
+    return impl().s_52wk_high_impl();
+  }
+
+  
+  const uint32_t& s_52wk_high_date() const {
+    return impl().s_52wk_high_date_impl();
+  }
+
+  
+  const float& s_52wk_low() const {
+    return impl().s_52wk_low_impl();
+  }
+
+  
+  const uint32_t& s_52wk_low_date() const {
+    return impl().s_52wk_low_date_impl();
+  }
+
+  
+  const float& s_dividend() const {
+    return impl().s_dividend_impl();
+  }
+
+  
+  const float& s_yield() const {
+    return impl().s_yield_impl();
+  }
+
+
+  void copy_into(tpce::security_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::security_row> : public RecordAccessor<UniRecordAccessor<tpce::security_row>, tpce::security_row> {
+ public:
+  UniRecordAccessor(const tpce::security_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const fix_string<6>& s_issue_impl() const {
+    return vptr_->s_issue;
+  }
+
+  
+  const fix_string<4>& s_st_id_impl() const {
+    return vptr_->s_st_id;
+  }
+
+  
+  const var_string<70>& s_name_impl() const {
+    return vptr_->s_name;
+  }
+
+  
+  const fix_string<6>& s_ex_id_impl() const {
+    return vptr_->s_ex_id;
+  }
+
+  
+  const int64_t& s_co_id_impl() const {
+    return vptr_->s_co_id;
+  }
+
+  
+  const int64_t& s_num_out_impl() const {
+    return vptr_->s_num_out;
+  }
+
+  
+  const uint32_t& s_start_date_impl() const {
+    return vptr_->s_start_date;
+  }
+
+  
+  const uint32_t& s_exch_date_impl() const {
+    return vptr_->s_exch_date;
+  }
+
+  
+  const float& s_pe_impl() const {
+    return vptr_->s_pe;
+  }
+
+  
+  const float& s_52wk_high_impl() const {
+    return vptr_->s_52wk_high;
+  }
+
+  
+  const uint32_t& s_52wk_high_date_impl() const {
+    return vptr_->s_52wk_high_date;
+  }
+
+  
+  const float& s_52wk_low_impl() const {
+    return vptr_->s_52wk_low;
+  }
+
+  
+  const uint32_t& s_52wk_low_date_impl() const {
+    return vptr_->s_52wk_low_date;
+  }
+
+  
+  const float& s_dividend_impl() const {
+    return vptr_->s_dividend;
+  }
+
+  
+  const float& s_yield_impl() const {
+    return vptr_->s_yield;
+  }
+
+
+  
+  void copy_into_impl(tpce::security_row* dst) const {
+    
+    if (vptr_) {
+      dst->s_issue = vptr_->s_issue;
+      dst->s_st_id = vptr_->s_st_id;
+      dst->s_name = vptr_->s_name;
+      dst->s_ex_id = vptr_->s_ex_id;
+      dst->s_co_id = vptr_->s_co_id;
+      dst->s_num_out = vptr_->s_num_out;
+      dst->s_start_date = vptr_->s_start_date;
+      dst->s_exch_date = vptr_->s_exch_date;
+      dst->s_pe = vptr_->s_pe;
+      dst->s_52wk_high = vptr_->s_52wk_high;
+      dst->s_52wk_high_date = vptr_->s_52wk_high_date;
+      dst->s_52wk_low = vptr_->s_52wk_low;
+      dst->s_52wk_low_date = vptr_->s_52wk_low_date;
+      dst->s_dividend = vptr_->s_dividend;
+      dst->s_yield = vptr_->s_yield;
+    }
+  }
+
+
+  const tpce::security_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::security_row>, tpce::security_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::security_row> : public RecordAccessor<SplitRecordAccessor<tpce::security_row>, tpce::security_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::security_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::security_row*>(vptrs[0])) {}
+
+ private:
+  
+  const fix_string<6>& s_issue_impl() const {
+    return vptr_0_->s_issue;
+  }
+
+  
+  const fix_string<4>& s_st_id_impl() const {
+    return vptr_0_->s_st_id;
+  }
+
+  
+  const var_string<70>& s_name_impl() const {
+    return vptr_0_->s_name;
+  }
+
+  
+  const fix_string<6>& s_ex_id_impl() const {
+    return vptr_0_->s_ex_id;
+  }
+
+  
+  const int64_t& s_co_id_impl() const {
+    return vptr_0_->s_co_id;
+  }
+
+  
+  const int64_t& s_num_out_impl() const {
+    return vptr_0_->s_num_out;
+  }
+
+  
+  const uint32_t& s_start_date_impl() const {
+    return vptr_0_->s_start_date;
+  }
+
+  
+  const uint32_t& s_exch_date_impl() const {
+    return vptr_0_->s_exch_date;
+  }
+
+  
+  const float& s_pe_impl() const {
+    return vptr_0_->s_pe;
+  }
+
+  
+  const float& s_52wk_high_impl() const {
+    return vptr_0_->s_52wk_high;
+  }
+
+  
+  const uint32_t& s_52wk_high_date_impl() const {
+    return vptr_0_->s_52wk_high_date;
+  }
+
+  
+  const float& s_52wk_low_impl() const {
+    return vptr_0_->s_52wk_low;
+  }
+
+  
+  const uint32_t& s_52wk_low_date_impl() const {
+    return vptr_0_->s_52wk_low_date;
+  }
+
+  
+  const float& s_dividend_impl() const {
+    return vptr_0_->s_dividend;
+  }
+
+  
+  const float& s_yield_impl() const {
+    return vptr_0_->s_yield;
+  }
+
+
+  
+  void copy_into_impl(tpce::security_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->s_issue = vptr_0_->s_issue;
+      dst->s_st_id = vptr_0_->s_st_id;
+      dst->s_name = vptr_0_->s_name;
+      dst->s_ex_id = vptr_0_->s_ex_id;
+      dst->s_co_id = vptr_0_->s_co_id;
+      dst->s_num_out = vptr_0_->s_num_out;
+      dst->s_start_date = vptr_0_->s_start_date;
+      dst->s_exch_date = vptr_0_->s_exch_date;
+      dst->s_pe = vptr_0_->s_pe;
+      dst->s_52wk_high = vptr_0_->s_52wk_high;
+      dst->s_52wk_high_date = vptr_0_->s_52wk_high_date;
+      dst->s_52wk_low = vptr_0_->s_52wk_low;
+      dst->s_52wk_low_date = vptr_0_->s_52wk_low_date;
+      dst->s_dividend = vptr_0_->s_dividend;
+      dst->s_yield = vptr_0_->s_yield;
+    }
+
+  }
+
+
+  const tpce::security_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::security_row>, tpce::security_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::company_row> {
+  using split_type_list = std::tuple<tpce::company_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::company_row& in) -> tpce::company_row {
+      tpce::company_row out;
+      out.co_st_id = in.co_st_id;
+      out.co_name = in.co_name;
+      out.co_in_id = in.co_in_id;
+      out.co_sp_rate = in.co_sp_rate;
+      out.co_ceo = in.co_ceo;
+      out.co_ad_id = in.co_ad_id;
+      out.co_desc = in.co_desc;
+      out.co_open_date = in.co_open_date;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::company_row* out, const tpce::company_row& in) -> void {
+      out->co_st_id = in.co_st_id;
+      out->co_name = in.co_name;
+      out->co_in_id = in.co_in_id;
+      out->co_sp_rate = in.co_sp_rate;
+      out->co_ceo = in.co_ceo;
+      out->co_ad_id = in.co_ad_id;
+      out->co_desc = in.co_desc;
+      out->co_open_date = in.co_open_date;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::company_row> {
+ public:
+  
+  const fix_string<4>& co_st_id() const {
+    return impl().co_st_id_impl();
+  }
+
+  
+  const var_string<60>& co_name() const {
+    return impl().co_name_impl();
+  }
+
+  
+  const fix_string<2>& co_in_id() const {
+    return impl().co_in_id_impl();
+  }
+
+  
+  const fix_string<4>& co_sp_rate() const {
+    return impl().co_sp_rate_impl();
+  }
+
+  
+  const var_string<100>& co_ceo() const {
+    return impl().co_ceo_impl();
+  }
+
+  
+  const int64_t& co_ad_id() const {
+    return impl().co_ad_id_impl();
+  }
+
+  
+  const var_string<150>& co_desc() const {
+    return impl().co_desc_impl();
+  }
+
+  
+  const uint32_t& co_open_date() const {
+    return impl().co_open_date_impl();
+  }
+
+
+  void copy_into(tpce::company_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::company_row> : public RecordAccessor<UniRecordAccessor<tpce::company_row>, tpce::company_row> {
+ public:
+  UniRecordAccessor(const tpce::company_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const fix_string<4>& co_st_id_impl() const {
+    return vptr_->co_st_id;
+  }
+
+  
+  const var_string<60>& co_name_impl() const {
+    return vptr_->co_name;
+  }
+
+  
+  const fix_string<2>& co_in_id_impl() const {
+    return vptr_->co_in_id;
+  }
+
+  
+  const fix_string<4>& co_sp_rate_impl() const {
+    return vptr_->co_sp_rate;
+  }
+
+  
+  const var_string<100>& co_ceo_impl() const {
+    return vptr_->co_ceo;
+  }
+
+  
+  const int64_t& co_ad_id_impl() const {
+    return vptr_->co_ad_id;
+  }
+
+  
+  const var_string<150>& co_desc_impl() const {
+    return vptr_->co_desc;
+  }
+
+  
+  const uint32_t& co_open_date_impl() const {
+    return vptr_->co_open_date;
+  }
+
+
+  
+  void copy_into_impl(tpce::company_row* dst) const {
+    
+    if (vptr_) {
+      dst->co_st_id = vptr_->co_st_id;
+      dst->co_name = vptr_->co_name;
+      dst->co_in_id = vptr_->co_in_id;
+      dst->co_sp_rate = vptr_->co_sp_rate;
+      dst->co_ceo = vptr_->co_ceo;
+      dst->co_ad_id = vptr_->co_ad_id;
+      dst->co_desc = vptr_->co_desc;
+      dst->co_open_date = vptr_->co_open_date;
+    }
+  }
+
+
+  const tpce::company_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::company_row>, tpce::company_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::company_row> : public RecordAccessor<SplitRecordAccessor<tpce::company_row>, tpce::company_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::company_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::company_row*>(vptrs[0])) {}
+
+ private:
+  
+  const fix_string<4>& co_st_id_impl() const {
+    return vptr_0_->co_st_id;
+  }
+
+  
+  const var_string<60>& co_name_impl() const {
+    return vptr_0_->co_name;
+  }
+
+  
+  const fix_string<2>& co_in_id_impl() const {
+    return vptr_0_->co_in_id;
+  }
+
+  
+  const fix_string<4>& co_sp_rate_impl() const {
+    return vptr_0_->co_sp_rate;
+  }
+
+  
+  const var_string<100>& co_ceo_impl() const {
+    return vptr_0_->co_ceo;
+  }
+
+  
+  const int64_t& co_ad_id_impl() const {
+    return vptr_0_->co_ad_id;
+  }
+
+  
+  const var_string<150>& co_desc_impl() const {
+    return vptr_0_->co_desc;
+  }
+
+  
+  const uint32_t& co_open_date_impl() const {
+    return vptr_0_->co_open_date;
+  }
+
+
+  
+  void copy_into_impl(tpce::company_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->co_st_id = vptr_0_->co_st_id;
+      dst->co_name = vptr_0_->co_name;
+      dst->co_in_id = vptr_0_->co_in_id;
+      dst->co_sp_rate = vptr_0_->co_sp_rate;
+      dst->co_ceo = vptr_0_->co_ceo;
+      dst->co_ad_id = vptr_0_->co_ad_id;
+      dst->co_desc = vptr_0_->co_desc;
+      dst->co_open_date = vptr_0_->co_open_date;
+    }
+
+  }
+
+
+  const tpce::company_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::company_row>, tpce::company_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::daily_market_row> {
+  using split_type_list = std::tuple<tpce::daily_market_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::daily_market_row& in) -> tpce::daily_market_row {
+      tpce::daily_market_row out;
+      out.dm_close = in.dm_close;
+      out.dm_high = in.dm_high;
+      out.dm_low = in.dm_low;
+      out.dm_vol = in.dm_vol;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::daily_market_row* out, const tpce::daily_market_row& in) -> void {
+      out->dm_close = in.dm_close;
+      out->dm_high = in.dm_high;
+      out->dm_low = in.dm_low;
+      out->dm_vol = in.dm_vol;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::daily_market_row> {
+ public:
+  
+  const float& dm_close() const {
+    return impl().dm_close_impl();
+  }
+
+  
+  const float& dm_high() const {
+    return impl().dm_high_impl();
+  }
+
+  
+  const float& dm_low() const {
+    return impl().dm_low_impl();
+  }
+
+  
+  const int64_t& dm_vol() const {
+    return impl().dm_vol_impl();
+  }
+
+
+  void copy_into(tpce::daily_market_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::daily_market_row> : public RecordAccessor<UniRecordAccessor<tpce::daily_market_row>, tpce::daily_market_row> {
+ public:
+  UniRecordAccessor(const tpce::daily_market_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const float& dm_close_impl() const {
+    return vptr_->dm_close;
+  }
+
+  
+  const float& dm_high_impl() const {
+    return vptr_->dm_high;
+  }
+
+  
+  const float& dm_low_impl() const {
+    return vptr_->dm_low;
+  }
+
+  
+  const int64_t& dm_vol_impl() const {
+    return vptr_->dm_vol;
+  }
+
+
+  
+  void copy_into_impl(tpce::daily_market_row* dst) const {
+    
+    if (vptr_) {
+      dst->dm_close = vptr_->dm_close;
+      dst->dm_high = vptr_->dm_high;
+      dst->dm_low = vptr_->dm_low;
+      dst->dm_vol = vptr_->dm_vol;
+    }
+  }
+
+
+  const tpce::daily_market_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::daily_market_row>, tpce::daily_market_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::daily_market_row> : public RecordAccessor<SplitRecordAccessor<tpce::daily_market_row>, tpce::daily_market_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::daily_market_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::daily_market_row*>(vptrs[0])) {}
+
+ private:
+  
+  const float& dm_close_impl() const {
+    return vptr_0_->dm_close;
+  }
+
+  
+  const float& dm_high_impl() const {
+    return vptr_0_->dm_high;
+  }
+
+  
+  const float& dm_low_impl() const {
+    return vptr_0_->dm_low;
+  }
+
+  
+  const int64_t& dm_vol_impl() const {
+    return vptr_0_->dm_vol;
+  }
+
+
+  
+  void copy_into_impl(tpce::daily_market_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->dm_close = vptr_0_->dm_close;
+      dst->dm_high = vptr_0_->dm_high;
+      dst->dm_low = vptr_0_->dm_low;
+      dst->dm_vol = vptr_0_->dm_vol;
+    }
+
+  }
+
+
+  const tpce::daily_market_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::daily_market_row>, tpce::daily_market_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::last_trade_row> {
+  using split_type_list = std::tuple<tpce::last_trade_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::last_trade_row& in) -> tpce::last_trade_row {
+      tpce::last_trade_row out;
+      out.lt_dts = in.lt_dts;
+      out.lt_price = in.lt_price;
+      out.lt_open_price = in.lt_open_price;
+      out.lt_vol = in.lt_vol;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::last_trade_row* out, const tpce::last_trade_row& in) -> void {
+      out->lt_dts = in.lt_dts;
+      out->lt_price = in.lt_price;
+      out->lt_open_price = in.lt_open_price;
+      out->lt_vol = in.lt_vol;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::last_trade_row> {
+ public:
+  
+  const uint32_t& lt_dts() const {
+    return impl().lt_dts_impl();
+  }
+
+  
+  const float& lt_price() const {
+    return impl().lt_price_impl();
+  }
+
+  
+  const float& lt_open_price() const {
+    return impl().lt_open_price_impl();
+  }
+
+  
+  const int64_t& lt_vol() const {
+    return impl().lt_vol_impl();
+  }
+
+
+  void copy_into(tpce::last_trade_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::last_trade_row> : public RecordAccessor<UniRecordAccessor<tpce::last_trade_row>, tpce::last_trade_row> {
+ public:
+  UniRecordAccessor(const tpce::last_trade_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const uint32_t& lt_dts_impl() const {
+    return vptr_->lt_dts;
+  }
+
+  
+  const float& lt_price_impl() const {
+    return vptr_->lt_price;
+  }
+
+  
+  const float& lt_open_price_impl() const {
+    return vptr_->lt_open_price;
+  }
+
+  
+  const int64_t& lt_vol_impl() const {
+    return vptr_->lt_vol;
+  }
+
+
+  
+  void copy_into_impl(tpce::last_trade_row* dst) const {
+    
+    if (vptr_) {
+      dst->lt_dts = vptr_->lt_dts;
+      dst->lt_price = vptr_->lt_price;
+      dst->lt_open_price = vptr_->lt_open_price;
+      dst->lt_vol = vptr_->lt_vol;
+    }
+  }
+
+
+  const tpce::last_trade_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::last_trade_row>, tpce::last_trade_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::last_trade_row> : public RecordAccessor<SplitRecordAccessor<tpce::last_trade_row>, tpce::last_trade_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::last_trade_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::last_trade_row*>(vptrs[0])) {}
+
+ private:
+  
+  const uint32_t& lt_dts_impl() const {
+    return vptr_0_->lt_dts;
+  }
+
+  
+  const float& lt_price_impl() const {
+    return vptr_0_->lt_price;
+  }
+
+  
+  const float& lt_open_price_impl() const {
+    return vptr_0_->lt_open_price;
+  }
+
+  
+  const int64_t& lt_vol_impl() const {
+    return vptr_0_->lt_vol;
+  }
+
+
+  
+  void copy_into_impl(tpce::last_trade_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->lt_dts = vptr_0_->lt_dts;
+      dst->lt_price = vptr_0_->lt_price;
+      dst->lt_open_price = vptr_0_->lt_open_price;
+      dst->lt_vol = vptr_0_->lt_vol;
+    }
+
+  }
+
+
+  const tpce::last_trade_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::last_trade_row>, tpce::last_trade_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::trade_row> {
+  using split_type_list = std::tuple<tpce::trade_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::trade_row& in) -> tpce::trade_row {
+      tpce::trade_row out;
+      out.t_dts = in.t_dts;
+      out.t_st_id = in.t_st_id;
+      out.t_tt_id = in.t_tt_id;
+      out.t_is_cash = in.t_is_cash;
+      out.t_s_symb = in.t_s_symb;
+      out.t_qty = in.t_qty;
+      out.t_bid_price = in.t_bid_price;
+      out.t_ca_id = in.t_ca_id;
+      out.t_exec_name = in.t_exec_name;
+      out.t_trade_price = in.t_trade_price;
+      out.t_chrg = in.t_chrg;
+      out.t_comm = in.t_comm;
+      out.t_tax = in.t_tax;
+      out.t_lifo = in.t_lifo;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::trade_row* out, const tpce::trade_row& in) -> void {
+      out->t_dts = in.t_dts;
+      out->t_st_id = in.t_st_id;
+      out->t_tt_id = in.t_tt_id;
+      out->t_is_cash = in.t_is_cash;
+      out->t_s_symb = in.t_s_symb;
+      out->t_qty = in.t_qty;
+      out->t_bid_price = in.t_bid_price;
+      out->t_ca_id = in.t_ca_id;
+      out->t_exec_name = in.t_exec_name;
+      out->t_trade_price = in.t_trade_price;
+      out->t_chrg = in.t_chrg;
+      out->t_comm = in.t_comm;
+      out->t_tax = in.t_tax;
+      out->t_lifo = in.t_lifo;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::trade_row> {
+ public:
+  
+  const uint32_t& t_dts() const {
+    return impl().t_dts_impl();
+  }
+
+  
+  const fix_string<4>& t_st_id() const {
+    return impl().t_st_id_impl();
+  }
+
+  
+  const fix_string<3>& t_tt_id() const {
+    return impl().t_tt_id_impl();
+  }
+
+  
+  const int32_t& t_is_cash() const {
+    return impl().t_is_cash_impl();
+  }
+
+  
+  const fix_string<15>& t_s_symb() const {
+    return impl().t_s_symb_impl();
+  }
+
+  
+  const int32_t& t_qty() const {
+    return impl().t_qty_impl();
+  }
+
+  
+  const float& t_bid_price() const {
+    return impl().t_bid_price_impl();
+  }
+
+  
+  const int64_t& t_ca_id() const {
+    return impl().t_ca_id_impl();
+  }
+
+  
+  const var_string<64>& t_exec_name() const {
+    return impl().t_exec_name_impl();
+  }
+
+  
+  const float& t_trade_price() const {
+    return impl().t_trade_price_impl();
+  }
+
+  
+  const float& t_chrg() const {
+    return impl().t_chrg_impl();
+  }
+
+  
+  const float& t_comm() const {
+    return impl().t_comm_impl();
+  }
+
+  
+  const float& t_tax() const {
+    return impl().t_tax_impl();
+  }
+
+  
+  const int32_t& t_lifo() const {
+    return impl().t_lifo_impl();
+  }
+
+
+  void copy_into(tpce::trade_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::trade_row> : public RecordAccessor<UniRecordAccessor<tpce::trade_row>, tpce::trade_row> {
+ public:
+  UniRecordAccessor(const tpce::trade_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const uint32_t& t_dts_impl() const {
+    return vptr_->t_dts;
+  }
+
+  
+  const fix_string<4>& t_st_id_impl() const {
+    return vptr_->t_st_id;
+  }
+
+  
+  const fix_string<3>& t_tt_id_impl() const {
+    return vptr_->t_tt_id;
+  }
+
+  
+  const int32_t& t_is_cash_impl() const {
+    return vptr_->t_is_cash;
+  }
+
+  
+  const fix_string<15>& t_s_symb_impl() const {
+    return vptr_->t_s_symb;
+  }
+
+  
+  const int32_t& t_qty_impl() const {
+    return vptr_->t_qty;
+  }
+
+  
+  const float& t_bid_price_impl() const {
+    return vptr_->t_bid_price;
+  }
+
+  
+  const int64_t& t_ca_id_impl() const {
+    return vptr_->t_ca_id;
+  }
+
+  
+  const var_string<64>& t_exec_name_impl() const {
+    return vptr_->t_exec_name;
+  }
+
+  
+  const float& t_trade_price_impl() const {
+    return vptr_->t_trade_price;
+  }
+
+  
+  const float& t_chrg_impl() const {
+    return vptr_->t_chrg;
+  }
+
+  
+  const float& t_comm_impl() const {
+    return vptr_->t_comm;
+  }
+
+  
+  const float& t_tax_impl() const {
+    return vptr_->t_tax;
+  }
+
+  
+  const int32_t& t_lifo_impl() const {
+    return vptr_->t_lifo;
+  }
+
+
+  
+  void copy_into_impl(tpce::trade_row* dst) const {
+    
+    if (vptr_) {
+      dst->t_dts = vptr_->t_dts;
+      dst->t_st_id = vptr_->t_st_id;
+      dst->t_tt_id = vptr_->t_tt_id;
+      dst->t_is_cash = vptr_->t_is_cash;
+      dst->t_s_symb = vptr_->t_s_symb;
+      dst->t_qty = vptr_->t_qty;
+      dst->t_bid_price = vptr_->t_bid_price;
+      dst->t_ca_id = vptr_->t_ca_id;
+      dst->t_exec_name = vptr_->t_exec_name;
+      dst->t_trade_price = vptr_->t_trade_price;
+      dst->t_chrg = vptr_->t_chrg;
+      dst->t_comm = vptr_->t_comm;
+      dst->t_tax = vptr_->t_tax;
+      dst->t_lifo = vptr_->t_lifo;
+    }
+  }
+
+
+  const tpce::trade_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::trade_row>, tpce::trade_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::trade_row> : public RecordAccessor<SplitRecordAccessor<tpce::trade_row>, tpce::trade_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::trade_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::trade_row*>(vptrs[0])) {}
+
+ private:
+  
+  const uint32_t& t_dts_impl() const {
+    return vptr_0_->t_dts;
+  }
+
+  
+  const fix_string<4>& t_st_id_impl() const {
+    return vptr_0_->t_st_id;
+  }
+
+  
+  const fix_string<3>& t_tt_id_impl() const {
+    return vptr_0_->t_tt_id;
+  }
+
+  
+  const int32_t& t_is_cash_impl() const {
+    return vptr_0_->t_is_cash;
+  }
+
+  
+  const fix_string<15>& t_s_symb_impl() const {
+    return vptr_0_->t_s_symb;
+  }
+
+  
+  const int32_t& t_qty_impl() const {
+    return vptr_0_->t_qty;
+  }
+
+  
+  const float& t_bid_price_impl() const {
+    return vptr_0_->t_bid_price;
+  }
+
+  
+  const int64_t& t_ca_id_impl() const {
+    return vptr_0_->t_ca_id;
+  }
+
+  
+  const var_string<64>& t_exec_name_impl() const {
+    return vptr_0_->t_exec_name;
+  }
+
+  
+  const float& t_trade_price_impl() const {
+    return vptr_0_->t_trade_price;
+  }
+
+  
+  const float& t_chrg_impl() const {
+    return vptr_0_->t_chrg;
+  }
+
+  
+  const float& t_comm_impl() const {
+    return vptr_0_->t_comm;
+  }
+
+  
+  const float& t_tax_impl() const {
+    return vptr_0_->t_tax;
+  }
+
+  
+  const int32_t& t_lifo_impl() const {
+    return vptr_0_->t_lifo;
+  }
+
+
+  
+  void copy_into_impl(tpce::trade_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->t_dts = vptr_0_->t_dts;
+      dst->t_st_id = vptr_0_->t_st_id;
+      dst->t_tt_id = vptr_0_->t_tt_id;
+      dst->t_is_cash = vptr_0_->t_is_cash;
+      dst->t_s_symb = vptr_0_->t_s_symb;
+      dst->t_qty = vptr_0_->t_qty;
+      dst->t_bid_price = vptr_0_->t_bid_price;
+      dst->t_ca_id = vptr_0_->t_ca_id;
+      dst->t_exec_name = vptr_0_->t_exec_name;
+      dst->t_trade_price = vptr_0_->t_trade_price;
+      dst->t_chrg = vptr_0_->t_chrg;
+      dst->t_comm = vptr_0_->t_comm;
+      dst->t_tax = vptr_0_->t_tax;
+      dst->t_lifo = vptr_0_->t_lifo;
+    }
+
+  }
+
+
+  const tpce::trade_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::trade_row>, tpce::trade_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::trade_request_row> {
+  using split_type_list = std::tuple<tpce::trade_request_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::trade_request_row& in) -> tpce::trade_request_row {
+      tpce::trade_request_row out;
+      out.tr_tt_id = in.tr_tt_id;
+      out.tr_s_symb = in.tr_s_symb;
+      out.tr_qty = in.tr_qty;
+      out.tr_bid_price = in.tr_bid_price;
+      out.tr_ca_id = in.tr_ca_id;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::trade_request_row* out, const tpce::trade_request_row& in) -> void {
+      out->tr_tt_id = in.tr_tt_id;
+      out->tr_s_symb = in.tr_s_symb;
+      out->tr_qty = in.tr_qty;
+      out->tr_bid_price = in.tr_bid_price;
+      out->tr_ca_id = in.tr_ca_id;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::trade_request_row> {
+ public:
+  
+  const fix_string<3>& tr_tt_id() const {
+    return impl().tr_tt_id_impl();
+  }
+
+  
+  const fix_string<15>& tr_s_symb() const {
+    return impl().tr_s_symb_impl();
+  }
+
+  
+  const int32_t& tr_qty() const {
+    return impl().tr_qty_impl();
+  }
+
+  
+  const float& tr_bid_price() const {
+    return impl().tr_bid_price_impl();
+  }
+
+  
+  const int64_t& tr_ca_id() const {
+    return impl().tr_ca_id_impl();
+  }
+
+
+  void copy_into(tpce::trade_request_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::trade_request_row> : public RecordAccessor<UniRecordAccessor<tpce::trade_request_row>, tpce::trade_request_row> {
+ public:
+  UniRecordAccessor(const tpce::trade_request_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const fix_string<3>& tr_tt_id_impl() const {
+    return vptr_->tr_tt_id;
+  }
+
+  
+  const fix_string<15>& tr_s_symb_impl() const {
+    return vptr_->tr_s_symb;
+  }
+
+  
+  const int32_t& tr_qty_impl() const {
+    return vptr_->tr_qty;
+  }
+
+  
+  const float& tr_bid_price_impl() const {
+    return vptr_->tr_bid_price;
+  }
+
+  
+  const int64_t& tr_ca_id_impl() const {
+    return vptr_->tr_ca_id;
+  }
+
+
+  
+  void copy_into_impl(tpce::trade_request_row* dst) const {
+    
+    if (vptr_) {
+      dst->tr_tt_id = vptr_->tr_tt_id;
+      dst->tr_s_symb = vptr_->tr_s_symb;
+      dst->tr_qty = vptr_->tr_qty;
+      dst->tr_bid_price = vptr_->tr_bid_price;
+      dst->tr_ca_id = vptr_->tr_ca_id;
+    }
+  }
+
+
+  const tpce::trade_request_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::trade_request_row>, tpce::trade_request_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::trade_request_row> : public RecordAccessor<SplitRecordAccessor<tpce::trade_request_row>, tpce::trade_request_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::trade_request_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::trade_request_row*>(vptrs[0])) {}
+
+ private:
+  
+  const fix_string<3>& tr_tt_id_impl() const {
+    return vptr_0_->tr_tt_id;
+  }
+
+  
+  const fix_string<15>& tr_s_symb_impl() const {
+    return vptr_0_->tr_s_symb;
+  }
+
+  
+  const int32_t& tr_qty_impl() const {
+    return vptr_0_->tr_qty;
+  }
+
+  
+  const float& tr_bid_price_impl() const {
+    return vptr_0_->tr_bid_price;
+  }
+
+  
+  const int64_t& tr_ca_id_impl() const {
+    return vptr_0_->tr_ca_id;
+  }
+
+
+  
+  void copy_into_impl(tpce::trade_request_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->tr_tt_id = vptr_0_->tr_tt_id;
+      dst->tr_s_symb = vptr_0_->tr_s_symb;
+      dst->tr_qty = vptr_0_->tr_qty;
+      dst->tr_bid_price = vptr_0_->tr_bid_price;
+      dst->tr_ca_id = vptr_0_->tr_ca_id;
+    }
+
+  }
+
+
+  const tpce::trade_request_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::trade_request_row>, tpce::trade_request_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::trade_history_row> {
+  using split_type_list = std::tuple<tpce::trade_history_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::trade_history_row& in) -> tpce::trade_history_row {
+      tpce::trade_history_row out;
+      out.th_dts = in.th_dts;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::trade_history_row* out, const tpce::trade_history_row& in) -> void {
+      out->th_dts = in.th_dts;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::trade_history_row> {
+ public:
+  
+  const uint32_t& th_dts() const {
+    return impl().th_dts_impl();
+  }
+
+
+  void copy_into(tpce::trade_history_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::trade_history_row> : public RecordAccessor<UniRecordAccessor<tpce::trade_history_row>, tpce::trade_history_row> {
+ public:
+  UniRecordAccessor(const tpce::trade_history_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const uint32_t& th_dts_impl() const {
+    return vptr_->th_dts;
+  }
+
+
+  
+  void copy_into_impl(tpce::trade_history_row* dst) const {
+    
+    if (vptr_) {
+      dst->th_dts = vptr_->th_dts;
+    }
+  }
+
+
+  const tpce::trade_history_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::trade_history_row>, tpce::trade_history_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::trade_history_row> : public RecordAccessor<SplitRecordAccessor<tpce::trade_history_row>, tpce::trade_history_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::trade_history_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::trade_history_row*>(vptrs[0])) {}
+
+ private:
+  
+  const uint32_t& th_dts_impl() const {
+    return vptr_0_->th_dts;
+  }
+
+
+  
+  void copy_into_impl(tpce::trade_history_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->th_dts = vptr_0_->th_dts;
+    }
+
+  }
+
+
+  const tpce::trade_history_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::trade_history_row>, tpce::trade_history_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::holding_summary_row> {
+  using split_type_list = std::tuple<tpce::holding_summary_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::holding_summary_row& in) -> tpce::holding_summary_row {
+      tpce::holding_summary_row out;
+      out.hs_qty = in.hs_qty;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::holding_summary_row* out, const tpce::holding_summary_row& in) -> void {
+      out->hs_qty = in.hs_qty;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::holding_summary_row> {
+ public:
+  
+  const int32_t& hs_qty() const {
+    return impl().hs_qty_impl();
+  }
+
+
+  void copy_into(tpce::holding_summary_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::holding_summary_row> : public RecordAccessor<UniRecordAccessor<tpce::holding_summary_row>, tpce::holding_summary_row> {
+ public:
+  UniRecordAccessor(const tpce::holding_summary_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const int32_t& hs_qty_impl() const {
+    return vptr_->hs_qty;
+  }
+
+
+  
+  void copy_into_impl(tpce::holding_summary_row* dst) const {
+    
+    if (vptr_) {
+      dst->hs_qty = vptr_->hs_qty;
+    }
+  }
+
+
+  const tpce::holding_summary_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::holding_summary_row>, tpce::holding_summary_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::holding_summary_row> : public RecordAccessor<SplitRecordAccessor<tpce::holding_summary_row>, tpce::holding_summary_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::holding_summary_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::holding_summary_row*>(vptrs[0])) {}
+
+ private:
+  
+  const int32_t& hs_qty_impl() const {
+    return vptr_0_->hs_qty;
+  }
+
+
+  
+  void copy_into_impl(tpce::holding_summary_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->hs_qty = vptr_0_->hs_qty;
+    }
+
+  }
+
+
+  const tpce::holding_summary_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::holding_summary_row>, tpce::holding_summary_row>;
+};
+
+
+template <>
+struct SplitParams<tpce::settlement_row> {
+  using split_type_list = std::tuple<tpce::settlement_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const tpce::settlement_row& in) -> tpce::settlement_row {
+      tpce::settlement_row out;
+      out.se_cash_type = in.se_cash_type;
+      out.se_cash_due_date = in.se_cash_due_date;
+      out.se_amt = in.se_amt;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](tpce::settlement_row* out, const tpce::settlement_row& in) -> void {
+      out->se_cash_type = in.se_cash_type;
+      out->se_cash_due_date = in.se_cash_due_date;
+      out->se_amt = in.se_amt;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, tpce::settlement_row> {
+ public:
+  
+  const var_string<40>& se_cash_type() const {
+    return impl().se_cash_type_impl();
+  }
+
+  
+  const uint32_t& se_cash_due_date() const {
+    return impl().se_cash_due_date_impl();
+  }
+
+  
+  const float& se_amt() const {
+    return impl().se_amt_impl();
+  }
+
+
+  void copy_into(tpce::settlement_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<tpce::settlement_row> : public RecordAccessor<UniRecordAccessor<tpce::settlement_row>, tpce::settlement_row> {
+ public:
+  UniRecordAccessor(const tpce::settlement_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const var_string<40>& se_cash_type_impl() const {
+    return vptr_->se_cash_type;
+  }
+
+  
+  const uint32_t& se_cash_due_date_impl() const {
+    return vptr_->se_cash_due_date;
+  }
+
+  
+  const float& se_amt_impl() const {
+    return vptr_->se_amt;
+  }
+
+
+  
+  void copy_into_impl(tpce::settlement_row* dst) const {
+    
+    if (vptr_) {
+      dst->se_cash_type = vptr_->se_cash_type;
+      dst->se_cash_due_date = vptr_->se_cash_due_date;
+      dst->se_amt = vptr_->se_amt;
+    }
+  }
+
+
+  const tpce::settlement_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<tpce::settlement_row>, tpce::settlement_row>;
+};
+
+template <>
+class SplitRecordAccessor<tpce::settlement_row> : public RecordAccessor<SplitRecordAccessor<tpce::settlement_row>, tpce::settlement_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<tpce::settlement_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<tpce::settlement_row*>(vptrs[0])) {}
+
+ private:
+  
+  const var_string<40>& se_cash_type_impl() const {
+    return vptr_0_->se_cash_type;
+  }
+
+  
+  const uint32_t& se_cash_due_date_impl() const {
+    return vptr_0_->se_cash_due_date;
+  }
+
+  
+  const float& se_amt_impl() const {
+    return vptr_0_->se_amt;
+  }
+
+
+  
+  void copy_into_impl(tpce::settlement_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->se_cash_type = vptr_0_->se_cash_type;
+      dst->se_cash_due_date = vptr_0_->se_cash_due_date;
+      dst->se_amt = vptr_0_->se_amt;
+    }
+
+  }
+
+
+  const tpce::settlement_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<tpce::settlement_row>, tpce::settlement_row>;
+};
+
+} // namespace bench
@@ -0,0 +1,105 @@
+namespace bench {
+
+
+template <>
+struct SplitParams<trace::trace_row> {
+  using split_type_list = std::tuple<trace::trace_row>;
+  using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;
+  static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;
+
+  static constexpr auto split_builder = std::make_tuple(
+    [](const trace::trace_row& in) -> trace::trace_row {
+      trace::trace_row out;
+      out.val = in.val;
+      return out;
+    }
+  );
+
+  static constexpr auto split_merger = std::make_tuple(
+    [](trace::trace_row* out, const trace::trace_row& in) -> void {
+      out->val = in.val;
+    }
+  );
+
+  static constexpr auto map = [](int col_n) -> int {
+    (void)col_n;
+    return 0;
+  };
+};
+
+
+template <typename A>
+class RecordAccessor<A, trace::trace_row> {
+ public:
+  
+  const int64_t& val() const {
+    return impl().val_impl();
+  }
+
+
+  void copy_into(trace::trace_row* dst) const {
+    return impl().copy_into_impl(dst);
+  }
+
+ private:
+  const A& impl() const {
+    return *static_cast<const A*>(this);
+  }
+};
+
+template <>
+class UniRecordAccessor<trace::trace_row> : public RecordAccessor<UniRecordAccessor<trace::trace_row>, trace::trace_row> {
+ public:
+  UniRecordAccessor(const trace::trace_row* const vptr) : vptr_(vptr) {}
+
+ private:
+  
+  const int64_t& val_impl() const {
+    return vptr_->val;
+  }
+
+
+  
+  void copy_into_impl(trace::trace_row* dst) const {
+    
+    if (vptr_) {
+      dst->val = vptr_->val;
+    }
+  }
+
+
+  const trace::trace_row* vptr_;
+  friend RecordAccessor<UniRecordAccessor<trace::trace_row>, trace::trace_row>;
+};
+
+template <>
+class SplitRecordAccessor<trace::trace_row> : public RecordAccessor<SplitRecordAccessor<trace::trace_row>, trace::trace_row> {
+ public:
+   static constexpr size_t num_splits = SplitParams<trace::trace_row>::num_splits;
+
+   SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)
+     : vptr_0_(reinterpret_cast<trace::trace_row*>(vptrs[0])) {}
+
+ private:
+  
+  const int64_t& val_impl() const {
+    return vptr_0_->val;
+  }
+
+
+  
+  void copy_into_impl(trace::trace_row* dst) const {
+    
+    if (vptr_0_) {
+      dst->val = vptr_0_->val;
+    }
+
+  }
+
+
+  const trace::trace_row* vptr_0_;
+
+  friend RecordAccessor<SplitRecordAccessor<trace::trace_row>, trace::trace_row>;
+};
+
+} // namespace bench
@@ -18,7 +18,8 @@ def to_cpp_type(type_name, length, scale):
         return '{}<{}>'.format(datatype_map[type_name], length)
     else:
         if type_name == 'NUMBER':
-            if scale != None:
+            # NUMBER(n,0) is an integer
+            if scale:
                 return datatype_map['float']
             elif length > 10:
                 return datatype_map['big_int']
@@ -40,35 +41,41 @@ def is_integral_type(col):
     cpp_type = to_cpp_type(col.data_type, col.length, col.scale)
     return (cpp_type in ['int32_t', 'int64_t'])
 
+def key_columns(table):
+    return [col for col in table.columns.values() if col.primary_key or col.unique]
+
+def value_columns(table):
+    return [col for col in table.columns.values() if not col.primary_key and not col.unique]
+
 for ddl_string in ddl_string_list:
     table = DdlParse().parse(ddl=ddl_string, source_database=DdlParse.DATABASE.oracle)
     print("// New table: {}\n".format(table.name))
 
-    print("struct __attribute__((packed)) {}_key {{".format(table.name))
-    for col in table.columns.values():
-        if col.primary_key or col.unique:
-            print("    {} {};".format(to_cpp_type(col.data_type, col.length, col.scale), col.name))
-    ctr = "    explicit {}_key(".format(table.name)
+    bare = "{}_key_bare".format(table.name)
+    print("struct __attribute__((packed)) {} {{".format(bare))
+    for col in key_columns(table):
+        print("    {} {};".format(to_cpp_type(col.data_type, col.length, col.scale), col.name))
     param_list = []
     init_list = []
-    for col in table.columns.values():
-        if col.primary_key or col.unique:
-            param_list.append("{} {}".format(to_cpp_type(col.data_type, col.length, col.scale), "p_{}".format(col.name)))
-    ctr += ", ".join(param_list)
-    ctr += ")\n        : "
-    for col in table.columns.values():
-        if col.primary_key or col.unique:
-            if is_integral_type(col):
-                init_list.append("{}(bswap({}))".format(col.name, "p_{}".format(col.name)))
-            else:
-                init_list.append("{}(({}))".format(col.name, "p_{}".format(col.name)))
-    ctr += ", ".join(init_list)
-    ctr += " {}"
-    print(ctr)
+    for col in key_columns(table):
+        param_list.append("{} p_{}".format(to_cpp_type(col.data_type, col.length, col.scale), col.name))
+        if is_integral_type(col):
+            init_list.append("{}(bswap(p_{}))".format(col.name, col.name))
+        else:
+            init_list.append("{}(p_{})".format(col.name, col.name))
+    print("    explicit {}({})".format(bare, ", ".join(param_list)))
+    print("        : {} {{}}\n".format(", ".join(init_list)))
+    print("    friend masstree_key_adapter<{}>;".format(bare))
+    print("private:")
+    print("    {}() = default;".format(bare))
     print("};\n")
+    print("typedef masstree_key_adapter<{}> {}_key;\n".format(bare, table.name))
 
     print("struct {}_row {{".format(table.name))
-    for col in table.columns.values():
-        if not col.primary_key and not col.unique:
-            print("    {} {};".format(to_cpp_type(col.data_type, col.length, col.scale), col.name))
+    names = [col.name for col in value_columns(table)]
+    indent = " " * len("    enum class NamedColumn : int { ")
+    print("    enum class NamedColumn : int {{ {} = 0{} }};\n".format(
+        names[0], "".join(",\n{}{}".format(indent, n) for n in names[1:])))
+    for col in value_columns(table):
+        print("    {} {};".format(to_cpp_type(col.data_type, col.length, col.scale), col.name))
     print("};\n")
@@ -0,0 +1,79 @@
+#!/usr/bin/python3
+
+# Compares two files of benchmark results documents (STO_RESULTS_JSON, see
+# run/perf_suite.sh) configuration by configuration. Runs match when their
+# "config" objects are identical. A configuration regressed when its mean
+# throughput dropped by more than the threshold and a one-sided permutation
+# test on the trials says the drop is significant. Exits 1 on any regression.
+
+import argparse, itertools, json, math, random, sys
+
+def load(path):
+    runs = {}
+    decoder = json.JSONDecoder()
+    with open(path) as f:
+        text = f.read()
+    pos = 0
+    while True:
+        while pos < len(text) and text[pos].isspace():
+            pos += 1
+        if pos == len(text):
+            return runs
+        doc, pos = decoder.raw_decode(text, pos)
+        key = json.dumps(doc['config'], sort_keys=True)
+        runs.setdefault(key, []).append(doc['throughput'])
+
+def mean(xs):
+    return sum(xs) / len(xs)
+
+def p_lower(base, cur, rounds=20000):
+    """P(mean of a random split's 'current' side <= observed), under the
+    null hypothesis that both samples come from one distribution"""
+    pooled = base + cur
+    observed = mean(cur)
+    n = len(cur)
+    if math.comb(len(pooled), n) <= rounds:
+        splits = list(itertools.combinations(pooled, n))
+    else:
+        rng = random.Random(0)
+        splits = [rng.sample(pooled, n) for _ in range(rounds)]
+    return sum(1 for s in splits if mean(s) <= observed + 1e-9) / len(splits)
+
+def describe(key):
+    config = json.loads(key)
+    names = ['benchmark', 'dbid', 'threads', 'warehouses', 'mix', 'mode']
+    return ' '.join('{}={}'.format(k, config[k]) for k in names if k in config)
+
+def main():
+    parser = argparse.ArgumentParser(description='Flag throughput regressions against a baseline.')
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--threshold', type=float, default=2.0,
+                        help='smallest drop to report, in percent (default 2)')
+    parser.add_argument('--alpha', type=float, default=0.05,
+                        help='significance level (default 0.05)')
+    args = parser.parse_args()
+
+    base = load(args.baseline)
+    cur = load(args.current)
+    regressions = 0
+    for key in sorted(cur):
+        if key not in base:
+            print('{:60s} no baseline'.format(describe(key)))
+            continue
+        b, c = base[key], cur[key]
+        change = 100.0 * (mean(c) - mean(b)) / mean(b)
+        p = p_lower(b, c)
+        regressed = change < -args.threshold and p < args.alpha
+        regressions += regressed
+        print('{:60s} {:12.0f} -> {:12.0f} txns/s {:+6.1f}% (p={:.3f}, n={}/{}){}'.format(
+            describe(key), mean(b), mean(c), change, p, len(b), len(c),
+            '  REGRESSION' if regressed else ''))
+    for key in sorted(set(base) - set(cur)):
+        print('{:60s} missing from {}'.format(describe(key), args.current))
+    if regressions:
+        print('{} configuration(s) regressed'.format(regressions))
+    sys.exit(1 if regressions else 0)
+
+if __name__ == '__main__':
+    main()
@@ -25,7 +25,7 @@
 // Inherit from this class as needed
 template <
     typename K, typename V,
-    typename H=std::hash<K>, typename P=std::equal_to<K>>
+    typename H=bench::index_hash<K>, typename P=std::equal_to<K>>
 class Hashtable_params {
 public:
     typedef K Key;
@@ -106,7 +106,7 @@ public:
 
 template <
     typename K, typename V,
-    typename H=std::hash<K>, typename P=std::equal_to<K>>
+    typename H=bench::index_hash<K>, typename P=std::equal_to<K>>
 class Hashtable_mvcc_params : public Hashtable_params<K, V, H, P> {
 public:
     static constexpr bool MVCC = true;
@@ -114,7 +114,7 @@ public:
 
 template <
     typename K, typename V,
-    typename H=std::hash<K>, typename P=std::equal_to<K>>
+    typename H=bench::index_hash<K>, typename P=std::equal_to<K>>
 class Hashtable_opaque_params : public Hashtable_params<K, V, H, P> {
 public:
     static constexpr bool Opacity = true;
@@ -169,14 +169,15 @@ private:
         key_type key;
         value_container_type row_container;
         bool deleted;
+        size_t key_hash;  // hash(key)
 
-        occ_internal_elem(const key_type& k, const value_type& v, bool valid)
+        occ_internal_elem(const key_type& k, size_t h, const value_type& v, bool valid)
             : next(nullptr), key(k),
               row_container(
                       Sto::initialized_tid() |
                       ((!enable_stm || valid) ? 0 : invalid_bit),
                       !valid, v),
-              deleted(false) {}
+              deleted(false), key_hash(h) {}
 
         version_type& version() {
             return row_container.row_version();
@@ -192,8 +193,9 @@ private:
         mvcc_internal_elem* next;
         key_type key;
         object_type obj;
+        size_t key_hash;  // hash(key)
 
-        mvcc_internal_elem(const key_type& k): next(nullptr), key(k), obj() {}
+        mvcc_internal_elem(const key_type& k, size_t h): next(nullptr), key(k), obj(), key_hash(h) {}
     };
 
 public:
@@ -262,9 +264,10 @@ public:
         bucket_entry& buck = map_[find_bucket_idx(key)];
         buck.version.lock_exclusive();
 
+        size_t h = hash(key);
         internal_elem* prev = nullptr;
         internal_elem* curr = buck.head;
-        while (curr && !pred_(curr->key, key)) {
+        while (curr && !(curr->key_hash == h && pred_(curr->key, key))) {
             prev = curr;
             curr = curr->next;
         }
@@ -309,10 +312,10 @@ public:
         if (!e) {
             internal_elem* new_head;
             if constexpr (Params::MVCC) {
-                new_head = new internal_elem(key);
+                new_head = new internal_elem(key, hash(key));
                 new_head->obj.nontrans_access() = value;
             } else {
-                new_head = new internal_elem(key, value, true);
+                new_head = new internal_elem(key, hash(key), value, true);
             }
             new_head->next = buck.head;
             buck.head = new_head;
@@ -798,7 +801,7 @@ private:
         auto el = reinterpret_cast<internal_elem*>(ele_ptr);
         auto hp = reinterpret_cast<history_type*>(history_ptr);
 
-        bucket_entry& buck = ht->map_[ht->find_bucket_idx(el->key)];
+        bucket_entry& buck = ht->map_[el->key_hash % ht->nbuckets()];
         buck.version.lock_exclusive();
 
         internal_elem* prev = nullptr;
@@ -848,10 +851,12 @@ private:
         return Sto::read_tid();
     }
 
-    // Find a key's corresponding internal_elem in a bucket
+    // Find a key's corresponding internal_elem in a bucket; the cached
+    // hashes screen out most other keys without a key comparison
     internal_elem* find_in_bucket(const bucket_entry& buck, const key_type& k) {
+        size_t h = hash(k);
         internal_elem* curr = buck.head;
-        while (curr && !pred_(curr->key, k)) {
+        while (curr && !(curr->key_hash == h && pred_(curr->key, k))) {
             curr = curr->next;
         }
         return curr;
@@ -864,7 +869,7 @@ private:
         assert(buck.version.is_locked());
 
         internal_elem* new_head = new internal_elem(
-                k, v ? *v : value_type(), valid);
+                k, hash(k), v ? *v : value_type(), valid);
         internal_elem* curr_head = buck.head;
 
         new_head->next = curr_head;
@@ -875,7 +880,7 @@ private:
 
     // Remove an internal_elem during transactions, with locks
     void remove(internal_elem* e) {
-        bucket_entry& buck = map_[find_bucket_idx(e->key)];
+        bucket_entry& buck = map_[e->key_hash % nbuckets()];
         buck.version.lock_exclusive();
 
         internal_elem* prev = nullptr;
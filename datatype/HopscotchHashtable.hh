@@ -0,0 +1,731 @@
+#pragma once
+
+#include <vector>
+#include "Sto.hh"
+#include "Hashtable.hh"
+
+// A transactional hash map with the interface of Hashtable but an open
+// addressed, hopscotch layout: every key lives within neighborhood slots of
+// its home bucket, so a lookup inspects a bounded, mostly contiguous run of
+// slots instead of walking a chain. Each home bucket keeps a bitmap of the
+// neighborhood slots holding its keys and a version for phantom protection;
+// each slot keeps a hash tag that is compared before the key.
+//
+// Rows are heap elements referenced from the slots, so references handed
+// out by transGet stay valid while inserts displace slots and while the
+// table grows. A failed insert (no free slot can be moved into the
+// neighborhood) doubles the table online: the resizing thread freezes the
+// old table bucket by bucket and publishes the new one when done. Lookups
+// of present keys never wait on a resize; lookups of absent keys, inserts
+// and removals that reach a frozen bucket wait for the new table.
+//
+// OCC only; use Hashtable for MVCC. No more than `neighborhood` keys may
+// share a hash value.
+template <typename Params>
+class HopscotchHashtable : public TObject {
+public:
+    static_assert(!Params::MVCC, "HopscotchHashtable does not support MVCC");
+
+    typedef typename Params::Key key_type;
+    typedef typename Params::Value value_type;
+    typedef commutators::Commutator<value_type> comm_type;
+    typedef typename Params::Hash Hash;
+    typedef typename Params::Pred Pred;
+    typedef typename std::conditional_t<Params::Opacity, TVersion, TNonopaqueVersion> version_type;
+    typedef IndexValueContainer<value_type, version_type> value_container_type;
+
+    typedef HashtableAccessMethod AccessMethod;
+    typedef typename Hashtable_results<value_type>::delete_result_type delete_result_type;
+    typedef typename Hashtable_results<value_type>::insert_result_type insert_result_type;
+    typedef typename Hashtable_results<value_type>::select_result_type select_result_type;
+
+    static constexpr AccessMethod BlindAccess = AccessMethod::Blind;
+    static constexpr AccessMethod ReadOnlyAccess = AccessMethod::ReadOnly;
+    static constexpr AccessMethod ReadWriteAccess = AccessMethod::ReadWrite;
+
+    // Slots a key may live in, starting at its home bucket
+    static constexpr size_t neighborhood = 32;
+    // How far past its home an insert searches for a free slot to move in
+    static constexpr size_t max_probe = 16 * neighborhood;
+
+    struct internal_elem {
+        key_type key;
+        value_container_type row_container;
+        bool deleted;
+
+        internal_elem(const key_type& k, const value_type& v, bool valid)
+            : key(k),
+              row_container(
+                      Sto::initialized_tid() | (valid ? 0 : invalid_bit),
+                      !valid, v),
+              deleted(false) {}
+
+        version_type& version() {
+            return row_container.row_version();
+        }
+
+        bool valid() {
+            return !(version().value() & invalid_bit);
+        }
+    };
+
+private:
+    static constexpr uintptr_t bucket_bit = 1U << 0;
+
+    static constexpr typename version_type::type invalid_bit = TransactionTid::user_bit;
+
+    static constexpr TransItem::flags_type insert_bit = TransItem::user0_bit;
+    static constexpr TransItem::flags_type delete_bit = TransItem::user0_bit << 1;
+    static constexpr TransItem::flags_type update_bit = TransItem::user0_bit << 2;
+
+    // A slot, which is also the home bucket of the keys hashing to it
+    struct bucket_entry {
+        // bumped whenever hop changes, so that an unsuccessful lookup will
+        // still be unsuccessful at commit time if the version is unchanged
+        version_type version;
+        // bit i is set if slot (this + i) holds a key whose home is here
+        uint32_t hop;
+        // hash tag of the key in this slot
+        uint32_t tag;
+        internal_elem* elem;
+        bucket_entry() : version(0), hop(0), tag(0), elem(nullptr) {}
+    };
+    static_assert(neighborhood <= 32, "hop bitmap is 32 bits");
+
+    struct table_type {
+        size_t mask;
+        // set once a resize into a larger table has started
+        table_type* next;
+        // the last neighborhood - 1 slots are not home to any key
+        std::vector<bucket_entry> slots;
+
+        explicit table_type(size_t nbuckets)
+            : mask(nbuckets - 1), next(nullptr),
+              slots(nbuckets + neighborhood - 1) {
+            assert((nbuckets & mask) == 0);
+        }
+
+        bucket_entry& home(size_t h) {
+            return slots[h & mask];
+        }
+    };
+
+public:
+    HopscotchHashtable(
+            uint32_t size = Params::Capacity, Hash h = Hash(),
+            Pred p = Pred()) :
+            table_(new table_type(round_up(size))), hasher_(h), pred_(p) {
+    }
+
+    ~HopscotchHashtable() {
+        for (size_t i = 0; i <= table_->mask; ++i) {
+            bucket_entry* buck = &table_->slots[i];
+            for (uint32_t hop = buck->hop; hop; hop &= hop - 1) {
+                delete buck[__builtin_ctz(hop)].elem;
+            }
+        }
+        delete table_;
+    }
+
+    static bool has_delete(const TransItem& item) {
+        return (item.flags() & delete_bit) != 0;
+    }
+
+    static bool has_insert(const TransItem& item) {
+        return (item.flags() & insert_bit) != 0;
+    }
+
+    static bool has_update(const TransItem& item) {
+        return (item.flags() & update_bit) != 0;
+    }
+
+    inline size_t hash(const key_type& k) const {
+        return hasher_(k);
+    }
+    inline size_t nbuckets() const {
+        return table_->mask + 1;
+    }
+
+    bool nontrans_delete(const key_type& key) {
+        size_t h = hash(key);
+        table_type* t;
+        bucket_entry& buck = lock_home(h, t);
+        internal_elem* e = find_locked(buck, key, tag_of(h));
+        if (e) {
+            unlink(buck, e);
+        }
+        buck.version.unlock_exclusive();
+        delete e;
+        return e != nullptr;
+    }
+
+    value_type* nontrans_get(const key_type& key) {
+        table_type* t;
+        bucket_entry* buck;
+        version_type vers;
+        internal_elem* e = find(key, t, buck, vers);
+        if (!e || !e->valid() || e->deleted) {
+            return nullptr;
+        }
+        return &(e->row_container.row);
+    }
+
+    void nontrans_put(const key_type& key, const value_type& value) {
+        size_t h = hash(key);
+        internal_elem* new_elem = nullptr;
+        while (true) {
+            table_type* t;
+            bucket_entry& buck = lock_home(h, t);
+            internal_elem* e = find_locked(buck, key, tag_of(h));
+            if (e) {
+                assert(!new_elem);
+                copy_row(e, &value);
+                buck.version.unlock_exclusive();
+                return;
+            }
+            if (!new_elem) {
+                new_elem = new internal_elem(key, value, true);
+            }
+            bool placed = place(*t, buck, new_elem, tag_of(h));
+            buck.version.unlock_exclusive();
+            if (placed) {
+                return;
+            }
+            grow(t);
+        }
+    }
+
+    // Transactional delete of the given key.
+    delete_result_type transDelete(const key_type& key) {
+        table_type* t;
+        bucket_entry* buck;
+        version_type buck_vers;
+        internal_elem* e = find(key, t, buck, buck_vers);
+
+        if (e) {
+            auto item = Sto::item(this, e);
+            bool valid = e->valid();
+            if (is_phantom(e, item)) {
+                return delete_result_type::Abort;
+            }
+
+            if (Params::ReadMyWrite && has_insert(item)) {
+                if (!valid && has_insert(item)) {
+                    // Deleting own insert
+                    remove(e);
+                    // Make item ignored and queue for gc later
+                    item.remove_read().remove_write().clear_flags(
+                            insert_bit | delete_bit);
+                    // The key is absent now; a miss keeps it that way
+                    find(key, t, buck, buck_vers);
+                    Sto::item(this, make_bucket_key(*buck)).observe(buck_vers);
+                    return { .abort = false, .success = true };
+                }
+
+                assert(valid);
+
+                if (has_delete(item)) {
+                    return delete_result_type::Fail;
+                }
+            }
+
+            // Add this to read set
+            if (!item.observe(e->version())) {
+                return delete_result_type::Abort;
+            }
+            item.add_write();
+            fence();
+
+            // Double check deleted status after observation
+            if (e->deleted) {  // Another thread beat us to it
+                return delete_result_type::Abort;
+            }
+
+            item.add_flags(delete_bit);
+            return { .abort = false, .success = true };
+        }
+
+        // Item not found, so observe the bucket for changes
+        auto buck_item = Sto::item(this, make_bucket_key(*buck));
+        if (!buck_item.observe(buck_vers)) {
+            return delete_result_type::Abort;
+        }
+
+        return delete_result_type::Fail;
+    }
+
+    // Transactional get on the given key.
+    select_result_type transGet(const key_type& key, const AccessMethod access) {
+        table_type* t;
+        bucket_entry* buck;
+        version_type buck_vers;
+        internal_elem* e = find(key, t, buck, buck_vers);
+
+        if (e) {
+            return transGet(reinterpret_cast<uintptr_t>(e), access);
+        }
+
+        if (!Sto::item(this, make_bucket_key(*buck)).observe(buck_vers)) {
+            return select_result_type::Abort;
+        }
+
+        return select_result_type::Fail;
+    }
+
+    // Transactional get on the given reference.
+    select_result_type transGet(uintptr_t ref, const AccessMethod access) {
+        auto e = reinterpret_cast<internal_elem*>(ref);
+        TransProxy item = Sto::item(this, e);
+
+        if (is_phantom(e, item)) {
+            return select_result_type::Abort;
+        }
+
+        if (Params::ReadMyWrite) {
+            if (has_delete(item)) {
+                return select_result_type::Fail;
+            }
+
+            if (has_update(item)) {
+                value_type* vp = nullptr;
+                if (has_insert(item)) {
+                    vp = &(e->row_container.row);
+                } else {
+                    vp = item.template raw_write_value<value_type*>();
+                }
+                assert(vp);
+                return {
+                    .abort = false, .success = true, .ref = ref, .value = vp };
+            }
+        }
+
+        value_type* vp = nullptr;
+        switch (access) {
+            case Blind:
+                // Do nothing
+                break;
+            case ReadOnly:
+                if (!item.observe(e->version())) {
+                    return select_result_type::Abort;
+                }
+                vp = &(e->row_container.row);
+                break;
+            case ReadWrite: {
+                bool abort = !item.observe(e->version());
+                if (!abort) {
+                    item.add_write();
+                }
+                item.add_flags(update_bit);
+
+                if (abort) {
+                    return select_result_type::Abort;
+                }
+                vp = &(e->row_container.row);
+                break;
+            }
+        }
+
+        return {
+            .abort = false, .success = true, .ref = ref, .value = vp };
+    }
+
+    // Transactional put on the given key. By default, will not overwrite the
+    // existing value if the key already exists in the table.
+    insert_result_type transPut(
+            const key_type& key, value_type* value, const bool overwrite=false) {
+        size_t h = hash(key);
+        internal_elem* new_elem = nullptr;
+        while (true) {
+            table_type* t;
+            bucket_entry& buck = lock_home(h, t);
+            internal_elem* e = find_locked(buck, key, tag_of(h));
+
+            // Key is already in table
+            if (e) {
+                buck.version.unlock_exclusive();
+                assert(!new_elem);
+
+                auto item = Sto::item(this, e);
+                if (is_phantom(e, item)) {
+                    return insert_result_type::Abort;
+                }
+
+                if (Params::ReadMyWrite) {
+                    if (has_delete(item)) {
+                        item.clear_flags(delete_bit).clear_write().
+                            template add_write<value_type*>(value);
+                        return insert_result_type::Fail;
+                    }
+                }
+
+                if (overwrite) {
+                    item.template add_write<value_type*>(value);
+                    if (Params::ReadMyWrite) {
+                        if (has_insert(item)) {
+                            copy_row(e, value);
+                        }
+                    }
+                } else {
+                    if (!item.observe(e->version())) {
+                        return insert_result_type::Abort;
+                    }
+                }
+
+                return { .abort = false, .success = true, .existed = true };
+            }
+
+            // Key is not already in table
+
+            // Insert the new row and check bucket version for changes
+            if (!new_elem) {
+                new_elem = new internal_elem(
+                        key, value ? *value : value_type(), false);
+            }
+            auto buck_vers_0 = version_type(buck.version.unlocked_value());
+            if (!place(*t, buck, new_elem, tag_of(h))) {
+                buck.version.unlock_exclusive();
+                grow(t);
+                continue;
+            }
+            auto buck_vers_1 = version_type(buck.version.unlocked_value());
+            buck.version.unlock_exclusive();
+
+            // Update bucket version in read set
+            auto buck_item = Sto::item(this, make_bucket_key(buck));
+            if (buck_item.has_read()) {
+                buck_item.update_read(buck_vers_0, buck_vers_1);
+            }
+
+            // Finish the write
+            auto item = Sto::item(this, new_elem);
+            item.template add_write<value_type*>(value);
+            item.add_flags(insert_bit);
+
+            return { .abort = false, .success = true, .existed = false };
+        }
+    }
+
+    // Transactional update on the given reference. Since the reference is
+    // given, it is assumed that the row already exists.
+    void transUpdate(uintptr_t ref, value_type* value) {
+        auto e = reinterpret_cast<internal_elem*>(ref);
+        auto item = Sto::item(this, e);
+        item.acquire_write(e->version(), value);
+    }
+
+    // Transactional update on the given reference. Since the reference is
+    // given, it is assumed that the row already exists.
+    void transUpdate(uintptr_t ref, const comm_type& comm) {
+        auto e = reinterpret_cast<internal_elem*>(ref);
+        auto item = Sto::item(this, e);
+        item.add_commute(&comm);
+    }
+
+    // TObject interface method
+    bool lock(TransItem& item, Transaction& txn) override {
+        assert(!is_bucket(item));
+        auto e = item.key<internal_elem*>();
+        return txn.try_lock(item, e->version());
+    }
+
+    // TObject interface method
+    bool check(TransItem& item, Transaction& txn) override {
+        if (is_bucket(item)) {
+            bucket_entry& buck = *bucket_address(item);
+            return buck.version.cp_check_version(txn, item);
+        }
+        auto e = item.key<internal_elem*>();
+        return e->version().cp_check_version(txn, item);
+    }
+
+    // TObject interface method
+    void install(TransItem& item, Transaction& txn) override {
+        assert(!is_bucket(item));
+        auto e = item.key<internal_elem*>();
+
+        if (has_delete(item)) {
+            assert(e->valid() && !e->deleted);
+            e->deleted = true;
+            fence();
+            txn.set_version(e->version());
+            return;
+        }
+
+        // Is an update
+        if (!has_insert(item)) {
+            if (item.has_commute()) {
+                comm_type &comm = *item.write_value<comm_type*>();
+                copy_row(e, comm);
+            } else {
+                auto value = item.write_value<value_type*>();
+                copy_row(e, value);
+            }
+        }
+
+        txn.set_version_unlock(e->version(), item);
+    }
+
+    // TObject interface method
+    void unlock(TransItem& item) override {
+        assert(!is_bucket(item));
+        auto e = item.key<internal_elem*>();
+        e->version().cp_unlock(item);
+    }
+
+    // TObject interface method
+    void cleanup(TransItem& item, bool committed) override {
+        if (committed ? has_delete(item) : has_insert(item)) {
+            assert(!is_bucket(item));
+            auto e = item.key<internal_elem*>();
+            assert(!e->valid() || e->deleted);
+            remove(e);
+            item.clear_needs_unlock();
+        }
+    }
+
+private:
+    static size_t round_up(size_t n) {
+        size_t nbuckets = 1;
+        while (nbuckets < n) {
+            nbuckets <<= 1;
+        }
+        return nbuckets;
+    }
+
+    // Tags come from the top bits of a multiplicative rehash, so that keys
+    // sharing a home bucket (the low bits) rarely share a tag
+    static uint32_t tag_of(size_t h) {
+        return uint32_t((h * 0x9E3779B97F4A7C15ULL) >> 32);
+    }
+
+    static bucket_entry* bucket_address(const TransItem& item) {
+        uintptr_t bucket_key = item.key<uintptr_t>();
+        return reinterpret_cast<bucket_entry*>(bucket_key & ~bucket_bit);
+    }
+
+    static bool is_bucket(const TransItem& item) {
+        return item.key<uintptr_t>() & bucket_bit;
+    }
+
+    static bool is_phantom(internal_elem* e, const TransItem& item) {
+        return (!e->valid() && !has_insert(item));
+    }
+
+    static uintptr_t make_bucket_key(const bucket_entry& bucket) {
+        return (reinterpret_cast<uintptr_t>(&bucket) | bucket_bit);
+    }
+
+    static void copy_row(internal_elem *e, comm_type &comm) {
+        comm.operate(e->row_container.row);
+    }
+
+    static void copy_row(internal_elem* e, const value_type* value) {
+        if (value) {
+            e->row_container.row = *value;
+        }
+    }
+
+    static bool try_lock(bucket_entry& buck) {
+        return TransactionTid::try_lock(
+                const_cast<typename version_type::type&>(buck.version.value()));
+    }
+
+    // Scan a home bucket's neighborhood for a key
+    internal_elem* scan(const bucket_entry& buck, const key_type& k, uint32_t tag) {
+        for (uint32_t hop = buck.hop; hop; hop &= hop - 1) {
+            const bucket_entry& slot = (&buck)[__builtin_ctz(hop)];
+            internal_elem* e = slot.elem;
+            if (slot.tag == tag && e && pred_(e->key, k)) {
+                return e;
+            }
+        }
+        return nullptr;
+    }
+
+    internal_elem* find_locked(bucket_entry& buck, const key_type& k, uint32_t tag) {
+        assert(buck.version.is_locked_here());
+        return scan(buck, k, tag);
+    }
+
+    // Find a key in the current table. On a miss, t and buck name the key's
+    // home bucket and vers is a version under which the neighborhood held
+    // no such key.
+    internal_elem* find(const key_type& k, table_type*& t, bucket_entry*& buck, version_type& vers) {
+        size_t h = hash(k);
+        uint32_t tag = tag_of(h);
+        while (true) {
+            t = table_;
+            acquire_fence();
+            buck = &t->home(h);
+            vers = buck->version;
+            fence();
+            // A hit is good whatever the bucket is doing: elements never
+            // move in memory
+            if (internal_elem* e = scan(*buck, k, tag)) {
+                return e;
+            }
+            fence();
+            if (!vers.is_locked() && buck->version.value() == vers.value()) {
+                return nullptr;
+            }
+            if (t->next) {
+                wait_for_resize(t);
+            } else {
+                relax_fence();
+            }
+        }
+    }
+
+    // Lock a key's home bucket in the current table
+    bucket_entry& lock_home(size_t h, table_type*& t) {
+        while (true) {
+            t = table_;
+            acquire_fence();
+            bucket_entry& buck = t->home(h);
+            if (try_lock(buck)) {
+                return buck;
+            }
+            if (t->next) {
+                wait_for_resize(t);
+            } else {
+                relax_fence();
+            }
+        }
+    }
+
+    void wait_for_resize(table_type* t) {
+        while (table_ == t) {
+            relax_fence();
+        }
+        acquire_fence();
+    }
+
+    // Put e into the neighborhood of home, whose lock the caller holds,
+    // moving other keys (whose homes must be locked in turn) towards their
+    // homes to make room. Returns false if no room can be made.
+    bool place(table_type& t, bucket_entry& home, internal_elem* e, uint32_t tag) {
+        size_t b = &home - t.slots.data();
+        size_t end = std::min(b + max_probe, t.slots.size());
+        size_t f = b;
+        while (f != end && (t.slots[f].elem
+                            || !bool_cmpxchg(&t.slots[f].elem, (internal_elem*) nullptr, e))) {
+            ++f;
+        }
+        if (f == end) {
+            return false;
+        }
+
+        while (f - b >= neighborhood) {
+            // Swap e with the closest-to-home key whose own neighborhood
+            // reaches slot f
+            bool moved = false;
+            for (size_t c = f - neighborhood + 1; c < f && c <= t.mask && !moved; ++c) {
+                bucket_entry& cbuck = t.slots[c];
+                if (!try_lock(cbuck)) {
+                    continue;
+                }
+                uint32_t hop = cbuck.hop & ((uint32_t(1) << (f - c)) - 1);
+                if (hop) {
+                    size_t j = c + __builtin_ctz(hop);
+                    t.slots[f].tag = t.slots[j].tag;
+                    t.slots[f].elem = t.slots[j].elem;
+                    fence();
+                    cbuck.hop = (cbuck.hop | (uint32_t(1) << (f - c)))
+                        & ~(uint32_t(1) << (j - c));
+                    t.slots[j].elem = e;
+                    cbuck.version.inc_nonopaque();
+                    f = j;
+                    moved = true;
+                }
+                cbuck.version.unlock_exclusive();
+            }
+            if (!moved) {
+                t.slots[f].elem = nullptr;
+                return false;
+            }
+        }
+
+        t.slots[f].tag = tag;
+        fence();
+        home.hop |= uint32_t(1) << (f - b);
+        home.version.inc_nonopaque();
+        return true;
+    }
+
+    // Remove e from the neighborhood of home, whose lock the caller holds
+    void unlink(bucket_entry& home, internal_elem* e) {
+        bucket_entry* buck = &home;
+        for (uint32_t hop = buck->hop; hop; hop &= hop - 1) {
+            int i = __builtin_ctz(hop);
+            if (buck[i].elem == e) {
+                home.hop &= ~(uint32_t(1) << i);
+                fence();
+                buck[i].elem = nullptr;
+                home.version.inc_nonopaque();
+                return;
+            }
+        }
+        assert(false && "element not in its home neighborhood");
+    }
+
+    // Remove an internal_elem during transactions, with locks
+    void remove(internal_elem* e) {
+        table_type* t;
+        bucket_entry& buck = lock_home(hash(e->key), t);
+        unlink(buck, e);
+        buck.version.unlock_exclusive();
+        Transaction::rcu_delete(e);
+    }
+
+    // Replace t with a table of twice the buckets. One thread resizes;
+    // the others wait for it.
+    void grow(table_type* t) {
+        size_t n = 2 * (t->mask + 1);
+        table_type* nt = new table_type(n);
+        if (!bool_cmpxchg(&t->next, (table_type*) nullptr, nt)) {
+            delete nt;
+            wait_for_resize(t);
+            return;
+        }
+
+        // Freeze the old table. Inserts and removals still working in it
+        // finish first; the ones after see t->next and wait.
+        for (size_t b = 0; b <= t->mask; ++b) {
+            t->slots[b].version.lock_exclusive();
+        }
+        while (!migrate(*t, *nt)) {
+            n *= 2;
+            always_assert(n <= (size_t(1) << 40), "too many keys share a hash");
+            delete nt;
+            nt = new table_type(n);
+            t->next = nt;
+        }
+
+        fence();
+        table_ = nt;
+        Transaction::rcu_delete(t);
+    }
+
+    // Copy the elements of frozen table t into private table nt
+    bool migrate(table_type& t, table_type& nt) {
+        for (size_t b = 0; b <= t.mask; ++b) {
+            bucket_entry* buck = &t.slots[b];
+            for (uint32_t hop = buck->hop; hop; hop &= hop - 1) {
+                bucket_entry& slot = buck[__builtin_ctz(hop)];
+                size_t h = hash(slot.elem->key);
+                bucket_entry& nbuck = nt.home(h);
+                nbuck.version.lock_exclusive();
+                bool placed = place(nt, nbuck, slot.elem, slot.tag);
+                nbuck.version.unlock_exclusive();
+                if (!placed) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    table_type* table_;
+    Hash hasher_;
+    Pred pred_;
+};
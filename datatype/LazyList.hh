@@ -0,0 +1,512 @@
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include "Sto.hh"
+#include "TransAlloc.hh"
+
+template <typename T, typename Compare, bool Opacity> class LazyListIterator;
+
+// A transactional sorted set, implemented as a lazy list (Heller et al.).
+//
+// List validates traversals against one list-wide version, which every
+// committed insert or delete bumps, and serializes structural changes
+// under one list lock; so any two writers conflict, and a writer anywhere
+// aborts every reader that missed a key or read the size. Here a
+// traversal takes no locks and validates only the nodes it stopped at.
+//
+// Every node has two versions. The value version protects the node's
+// existence; it carries insert_bit while the node is a phantom, linked by
+// a transaction that has not yet committed. The node version protects
+// the gap between the node and its successor, and is bumped whenever
+// that successor changes. A structural change locks only the node
+// version of the predecessor, then checks that the predecessor is still
+// linked and still points at the expected successor. An absent lookup
+// observes the node version of its predecessor, so it conflicts only
+// with inserts into that gap. An insert links its phantom right away and
+// reads no gap, so inserts of different keys never conflict. Deleted
+// nodes stay linked until the deleting transaction commits, then are
+// unlinked and freed through RCU.
+//
+// The size is commutative: inserts and deletes add blind deltas to one
+// size item, and only size() observes its version.
+template <typename T, typename Compare = std::less<T>, bool Opacity = true>
+class LazyList : public TObject {
+    friend class LazyListIterator<T, Compare, Opacity>;
+
+public:
+    typedef typename std::conditional<Opacity, TVersion, TNonopaqueVersion>::type version_type;
+    typedef LazyListIterator<T, Compare, Opacity> iterator;
+
+    static constexpr TransactionTid::type insert_bit = TransactionTid::user_bit;
+    static constexpr TransItem::flags_type insert_tag = TransItem::user0_bit;
+    static constexpr TransItem::flags_type delete_tag = TransItem::user0_bit << 1;
+
+    explicit LazyList(Compare comp = Compare())
+        : head_(TransAlloc::pool_new<node>(T(), version_type())), size_(0), comp_(comp) {
+    }
+    ~LazyList() {
+        node* n = head_;
+        while (n) {
+            node* next = n->next;
+            TransAlloc::pool_delete(n);
+            n = next;
+        }
+    }
+    LazyList(const LazyList&) = delete;
+    LazyList& operator=(const LazyList&) = delete;
+
+    // Returns the element equal to elem, or nullptr
+    const T* transFind(const T& elem) const {
+        node* n = lookup(elem);
+        return n ? &n->val : nullptr;
+    }
+    bool transContains(const T& elem) const {
+        return lookup(elem) != nullptr;
+    }
+    // Returns true if elem was absent
+    bool transInsert(const T& elem);
+    // Returns true if elem was present
+    bool transDelete(const T& elem);
+
+    size_t size() const {
+        auto size_item = Sto::item(const_cast<LazyList*>(this), size_key);
+        if (!size_item.has_read() && !size_item.observe(sizeversion_))
+            throw Transaction::Abort();
+        ssize_t offset = size_item.has_write() ? size_item.template write_value<ssize_t>() : 0;
+        return size_ + offset;
+    }
+
+    // Iteration observes the gaps passed over, so a scan conflicts with
+    // inserts into the range it covered and nothing else
+    iterator begin() const {
+        return iterator(this, next_present(head_));
+    }
+    iterator end() const {
+        return iterator(this, nullptr);
+    }
+
+    // nontransactional methods; not safe to run concurrently with
+    // transactions on the same list
+    bool insert(const T& elem);
+    bool nontrans_contains(const T& elem) const {
+        node* pred;
+        node* curr;
+        return find_position(elem, pred, curr);
+    }
+    bool nontrans_remove(const T& elem);
+    size_t nontrans_size() const {
+        return size_;
+    }
+
+    // transactional methods
+    bool lock(TransItem& item, Transaction& txn) override {
+        if (item.key<uintptr_t>() == size_key)
+            return txn.try_lock(item, sizeversion_);
+        node* n = item.key<node*>();
+        return txn.try_lock(item, n->vers) && !n->deleted;
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        uintptr_t key = item.key<uintptr_t>();
+        if (key == size_key)
+            return sizeversion_.cp_check_version(txn, item);
+        else if (key & gap_bit)
+            return reinterpret_cast<node*>(key - gap_bit)->nodevers.cp_check_version(txn, item);
+        else
+            return item.key<node*>()->vers.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        if (item.key<uintptr_t>() == size_key) {
+            size_ += item.template write_value<ssize_t>();
+            txn.set_version_unlock(sizeversion_, item);
+            return;
+        }
+        node* n = item.key<node*>();
+        if (has_delete(item)) {
+            // stays locked; cleanup unlinks it
+            n->deleted = true;
+            release_fence();
+            txn.set_version(n->vers);
+        } else {
+            // clears insert_bit
+            txn.set_version_unlock(n->vers, item);
+        }
+    }
+    void unlock(TransItem& item) override {
+        if (item.key<uintptr_t>() == size_key)
+            sizeversion_.cp_unlock(item);
+        else
+            item.key<node*>()->vers.cp_unlock(item);
+    }
+    void cleanup(TransItem& item, bool committed) override {
+        if (item.key<uintptr_t>() == size_key)
+            return;
+        if (committed ? has_delete(item) : has_insert(item)) {
+            node* n = item.key<node*>();
+            unlink(n);
+            item.clear_needs_unlock();
+            TransAlloc::rcu_pool_delete(n);
+        }
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        uintptr_t key = item.key<uintptr_t>();
+        w << "{LazyList " << (void*) this;
+        if (key == size_key)
+            w << " size";
+        else if (key & gap_bit)
+            w << " gap " << (void*) (key - gap_bit);
+        else {
+            node* n = item.key<node*>();
+            w << " " << (void*) n << ".v" << n->vers.value();
+            if (has_insert(item))
+                w << " I";
+            if (has_delete(item))
+                w << " D";
+        }
+        if (item.has_read())
+            w << " R" << item.read_value<version_type>();
+        w << "}";
+    }
+
+private:
+    struct node {
+        T val;
+        // existence; insert_bit while a phantom
+        version_type vers;
+        // the gap to next; locked by structural changes
+        version_type nodevers;
+        bool marked;
+        bool deleted;
+        node* next;
+
+        node(const T& v, version_type vs)
+            : val(v), vers(vs), nodevers(), marked(false), deleted(false), next(nullptr) {
+        }
+    };
+
+    // Item keys: a node, a node's gap (node | gap_bit), or the size
+    static constexpr uintptr_t gap_bit = 1;
+    static constexpr uintptr_t size_key = 2;
+
+    node* head_;
+    size_t size_;
+    mutable version_type sizeversion_;
+    Compare comp_;
+
+    static bool has_insert(const TransItem& item) {
+        return item.flags() & insert_tag;
+    }
+    static bool has_delete(const TransItem& item) {
+        return item.flags() & delete_tag;
+    }
+    static bool is_phantom(node* n, const TransItem& item) {
+        return (n->vers.value() & insert_bit) && !has_insert(item);
+    }
+    // A node that is being (or is about to be) unlinked; lookups wait for
+    // it to go
+    static bool is_unsettled(node* n) {
+        bool result = n->marked || n->deleted;
+        acquire_fence();
+        return result;
+    }
+
+    // Sets pred to the last node before elem and curr to its successor;
+    // returns true if curr equals elem
+    bool find_position(const T& elem, node*& pred, node*& curr) const {
+        pred = head_;
+        curr = pred->next;
+        acquire_fence();
+        while (curr && comp_(curr->val, elem)) {
+            pred = curr;
+            curr = pred->next;
+            acquire_fence();
+        }
+        return curr && !comp_(elem, curr->val);
+    }
+
+    static version_type stable_nodeversion(node* n) {
+        while (true) {
+            version_type v = n->nodevers;
+            if (!v.is_locked()) {
+                acquire_fence();
+                return v;
+            }
+            relax_fence();
+        }
+    }
+
+    TransProxy gap_item(node* n) const {
+        return Sto::item(const_cast<LazyList*>(this), reinterpret_cast<uintptr_t>(n) | gap_bit);
+    }
+
+    // Observes that nothing lies between pred and succ; false if they are
+    // no longer adjacent
+    bool observe_gap(node* pred, node* succ) const {
+        version_type v = stable_nodeversion(pred);
+        if (pred->marked || pred->next != succ)
+            return false;
+        if (!gap_item(pred).observe(v))
+            throw Transaction::Abort();
+        return true;
+    }
+
+    // Returns the node for elem, observing it, or nullptr, observing its
+    // absence. Aborts on another transaction's phantom.
+    node* lookup(const T& elem) const {
+        node* pred;
+        node* curr;
+        while (true) {
+            if (!find_position(elem, pred, curr)) {
+                if (observe_gap(pred, curr))
+                    return nullptr;
+            } else if (!is_unsettled(curr)) {
+                auto item = Sto::item(const_cast<LazyList*>(this), curr);
+                if (is_phantom(curr, item))
+                    throw Transaction::Abort();
+                if (has_delete(item))
+                    return nullptr;
+                if (!has_insert(item) && !item.observe(curr->vers))
+                    throw Transaction::Abort();
+                if (curr->deleted)
+                    throw Transaction::Abort();
+                return curr;
+            }
+            relax_fence();
+        }
+    }
+
+    // The first node after n visible to this transaction, observing every
+    // gap on the way
+    node* next_present(node* n) const {
+        while (true) {
+            version_type v = stable_nodeversion(n);
+            node* next = n->next;
+            acquire_fence();
+            if (n->marked)
+                throw Transaction::Abort();
+            if (!gap_item(n).observe(v))
+                throw Transaction::Abort();
+            if (!next)
+                return nullptr;
+            if (is_unsettled(next)) {
+                relax_fence();
+                continue;
+            }
+            auto item = Sto::item(const_cast<LazyList*>(this), next);
+            if (is_phantom(next, item))
+                throw Transaction::Abort();
+            if (!has_delete(item)) {
+                if (!has_insert(item) && !item.observe(next->vers))
+                    throw Transaction::Abort();
+                if (next->deleted)
+                    throw Transaction::Abort();
+                return next;
+            }
+            n = next;
+        }
+    }
+
+    // Locks pred and checks that it is still linked to succ. On failure
+    // pred is unlocked again.
+    static bool lock_pred(node* pred, node* succ, bool inserting) {
+        pred->nodevers.lock_exclusive();
+        if (pred->marked || pred->next != succ
+            || (inserting && succ && succ->marked)) {
+            pred->nodevers.unlock_exclusive();
+            return false;
+        }
+        return true;
+    }
+
+    // Links a new node for elem between pred and succ. Returns nullptr if
+    // they are no longer adjacent. gapv gets pred's node version before
+    // and after.
+    static node* link(const T& elem, node* pred, node* succ, version_type vers, version_type* gapv) {
+        if (!lock_pred(pred, succ, true))
+            return nullptr;
+        node* n = TransAlloc::pool_new<node>(elem, vers);
+        n->next = succ;
+        release_fence();
+        pred->next = n;
+        gapv[0] = version_type(pred->nodevers.unlocked_value());
+        pred->nodevers.inc_nonopaque();
+        gapv[1] = version_type(pred->nodevers.unlocked_value());
+        pred->nodevers.unlock_exclusive();
+        return n;
+    }
+
+    // Unlinks n, which no other thread may unlink
+    void unlink(node* n) {
+        node* pred;
+        node* curr;
+        n->nodevers.lock_exclusive();
+        n->marked = true;
+        fence();
+        while (true) {
+            find_position(n->val, pred, curr);
+            if (lock_pred(pred, n, false)) {
+                pred->next = n->next;
+                pred->nodevers.inc_nonopaque();
+                // gap readers of n must see the change too
+                n->nodevers.inc_nonopaque();
+                pred->nodevers.unlock_exclusive();
+                n->nodevers.unlock_exclusive();
+                return;
+            }
+            relax_fence();
+        }
+    }
+
+    // increment or decrement the offset size of the transaction's list
+    void change_size_offset(ssize_t delta) {
+        auto size_item = Sto::item(this, size_key);
+        ssize_t prev_offset = size_item.has_write() ? size_item.template write_value<ssize_t>() : 0;
+        size_item.add_write(prev_offset + delta);
+    }
+};
+
+template <typename T, typename Compare, bool Opacity>
+bool LazyList<T, Compare, Opacity>::transInsert(const T& elem) {
+    node* pred;
+    node* curr;
+    while (true) {
+        if (find_position(elem, pred, curr)) {
+            if (is_unsettled(curr)) {
+                relax_fence();
+                continue;
+            }
+            auto item = Sto::item(this, curr);
+            if (is_phantom(curr, item))
+                throw Transaction::Abort();
+            if (has_delete(item)) {
+                // re-inserting an element this transaction deleted
+                item.clear_flags(delete_tag);
+                if (!has_insert(item))
+                    item.clear_write();
+                change_size_offset(1);
+                return true;
+            }
+            // a failed insert must still find elem at commit
+            if (!has_insert(item) && (!item.observe(curr->vers) || curr->deleted))
+                throw Transaction::Abort();
+            return false;
+        }
+        version_type gapv[2];
+        node* n = link(elem, pred, curr, version_type(Sto::initialized_tid() | insert_bit), gapv);
+        if (!n)
+            continue;
+        auto gitem = gap_item(pred);
+        if (gitem.has_read())
+            gitem.update_read(gapv[0], gapv[1]);
+        Sto::item(this, n).add_write().add_flags(insert_tag);
+        change_size_offset(1);
+        return true;
+    }
+}
+
+template <typename T, typename Compare, bool Opacity>
+bool LazyList<T, Compare, Opacity>::transDelete(const T& elem) {
+    node* pred;
+    node* curr;
+    while (true) {
+        if (!find_position(elem, pred, curr)) {
+            if (observe_gap(pred, curr))
+                return false;
+            relax_fence();
+            continue;
+        }
+        if (is_unsettled(curr)) {
+            relax_fence();
+            continue;
+        }
+        auto item = Sto::item(this, curr);
+        if (is_phantom(curr, item))
+            throw Transaction::Abort();
+        if (has_delete(item))
+            return false;
+        // a deleted insert stays a phantom until commit, when cleanup
+        // unlinks it
+        if (!has_insert(item)) {
+            if (!item.observe(curr->vers) || curr->deleted)
+                throw Transaction::Abort();
+            item.add_write();
+        }
+        item.add_flags(delete_tag);
+        change_size_offset(-1);
+        return true;
+    }
+}
+
+template <typename T, typename Compare, bool Opacity>
+bool LazyList<T, Compare, Opacity>::insert(const T& elem) {
+    node* pred;
+    node* curr;
+    while (true) {
+        if (find_position(elem, pred, curr))
+            return false;
+        version_type gapv[2];
+        if (link(elem, pred, curr, version_type(Sto::initialized_tid()), gapv)) {
+            ++size_;
+            return true;
+        }
+    }
+}
+
+template <typename T, typename Compare, bool Opacity>
+bool LazyList<T, Compare, Opacity>::nontrans_remove(const T& elem) {
+    node* pred;
+    node* curr;
+    if (!find_position(elem, pred, curr))
+        return false;
+    unlink(curr);
+    TransAlloc::pool_delete(curr);
+    --size_;
+    return true;
+}
+
+// Forward iterator over a LazyList's elements
+template <typename T, typename Compare, bool Opacity>
+class LazyListIterator {
+public:
+    typedef LazyList<T, Compare, Opacity> list_type;
+    typedef typename list_type::node node_type;
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    LazyListIterator(const list_type* list, node_type* n)
+        : list_(list), node_(n) {
+    }
+
+    bool operator==(const LazyListIterator& x) const {
+        return list_ == x.list_ && node_ == x.node_;
+    }
+    bool operator!=(const LazyListIterator& x) const {
+        return !(*this == x);
+    }
+
+    const T& operator*() const {
+        return node_->val;
+    }
+    const T* operator->() const {
+        return &node_->val;
+    }
+
+    LazyListIterator& operator++() {
+        node_ = list_->next_present(node_);
+        return *this;
+    }
+    LazyListIterator operator++(int) {
+        LazyListIterator clone(*this);
+        ++*this;
+        return clone;
+    }
+
+private:
+    const list_type* list_;
+    node_type* node_;
+};
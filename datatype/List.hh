@@ -5,6 +5,7 @@
 
 #ifndef STO_NO_STM
 #include "Transaction.hh"
+#include "TransAlloc.hh"
 #endif
 
 template<typename T>
@@ -126,7 +127,7 @@ public:
       *inserted = true;
     lock(listlock_);
     if (!Sorted && !Duplicates) {
-      list_node *new_head = new list_node(elem, head_, Txnal);
+      list_node *new_head = TransAlloc::pool_new<list_node>(elem, head_, Txnal);
       head_ = new_head;
       unlock(listlock_);
       return new_head;
@@ -147,7 +148,7 @@ public:
       prev = cur;
       cur = cur->next;
     }
-    auto ret = new list_node(elem, cur, Txnal);
+    auto ret = TransAlloc::pool_new<list_node>(elem, cur, Txnal);
     if (prev) {
         prev->next = ret;
     } else {
@@ -192,9 +193,9 @@ public:
             head_ = cur->next;
         }
         if (Txnal) {
-          Transaction::rcu_delete(cur);
+          TransAlloc::rcu_pool_delete(cur);
         } else {
-          delete cur;
+          TransAlloc::pool_delete(cur);
         }
         if (!Txnal)
           listsize_--;
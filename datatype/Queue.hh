@@ -206,13 +206,12 @@ private:
     }
 
     bool check(TransItem& item, Transaction& t) override {
-        (void) t;
         // check if was a pop or front 
         if (item.key<int>() == -2)
-            return item.check_version(headversion_);
+            return headversion_.cp_check_version(t, item);
         // check if we read off the write_list (and locked tailversion)
         else if (item.key<int>() == -1)
-            return item.check_version(tailversion_);
+            return tailversion_.cp_check_version(t, item);
         // shouldn't reach this
         assert(0);
         return false;
@@ -227,7 +226,7 @@ private:
             // only increment head if item popped from actual q
             if (!is_rw(item))
                 head_ = (head_+1) % BUF_SIZE;
-            headversion_.set_version(txn.commit_tid());
+            txn.set_version(headversion_);
         }
         // install pushes
         else if (item.key<int>() == -1) {
@@ -249,15 +248,15 @@ private:
                 tail_ = (tail_+1) % BUF_SIZE;
             }
 
-            tailversion_.set_version(txn.commit_tid());
+            txn.set_version(tailversion_);
         }
     }
     
     void unlock(TransItem& item) override {
         if (item.key<int>() == -1)
-            tailversion_.unlock();
+            tailversion_.cp_unlock(item);
         else if (item.key<int>() == -2)
-            headversion_.unlock();
+            headversion_.cp_unlock(item);
     }
 
     T queueSlots[BUF_SIZE];
@@ -9,6 +9,7 @@
 
 #ifndef STO_NO_STM
 #include "Transaction.hh"
+#include "TransAlloc.hh"
 #endif
 
 #define DEBUG 0
@@ -91,7 +92,7 @@ public:
         return item.check_version(vers_);
     }
     void install(TransItem& item, const Transaction& txn) {
-        val_.write(item.template write_value<T>());
+        val_.write(std::move(item.template write_value<T>()));
         txn.set_version(vers_);
     }
 
@@ -482,10 +483,7 @@ private:
 #if DEBUG
             stats_.absent_insert++;
 #endif
-            // use in-place constructor so that we don't mix up c++'s new and c's free()
-            // XXX(nate): we'd need to an rcu delete if T is a nontrivial type.
-            wrapper_type* n = (wrapper_type*)malloc(sizeof(wrapper_type));
-            new (n) wrapper_type(rbpair<K, T>(key, T()));
+            wrapper_type* n = TransAlloc::pool_new<wrapper_type>(rbpair<K, T>(key, T()));
             // insert new node under parent
             bool side = (found_p.node() == nullptr)? false :
                     wrapper_tree_.r_.node_compare(*n, *found_p.node()) > 0;
@@ -1006,7 +1004,7 @@ void RBTree<K, T, GlobalSize>::install(TransItem& item, Transaction& t) {
 
             e->version().set_version(t.commit_tid());
             e->install_nv(t);
-            Transaction::rcu_free(e);
+            TransAlloc::rcu_pool_delete(e);
         } else {
             // inserts/updates should be handled the same way
             e->install(item, t);
@@ -1029,7 +1027,7 @@ void RBTree<K, T, GlobalSize>::cleanup(TransItem& item, bool committed) {
             unlock_write(&treelock_);
             // invalidate the nodeversion after we erase
             e->nodeversion().set_nonopaque();
-            Transaction::rcu_free(e);
+            TransAlloc::rcu_pool_delete(e);
         }
     }
 }
@@ -1170,8 +1168,7 @@ bool RBTree<K, T, GlobalSize>::nontrans_insert(const K& key, const T& value) {
     if (!found) {
         size_++;
         rbnodeptr<wrapper_type> p = std::get<0>(results);
-        wrapper_type* n = (wrapper_type*)malloc(sizeof(wrapper_type));
-        new (n) wrapper_type(rbpair<K, T>(key, value));
+        wrapper_type* n = TransAlloc::pool_new<wrapper_type>(rbpair<K, T>(key, value));
         erase_inserted(n->version());
         bool side = (p.node() == nullptr) ? false : (wrapper_tree_.r_.node_compare(*n, *p.node()) > 0);
         wrapper_tree_.insert_commit(n, p, side);
@@ -1219,7 +1216,7 @@ bool RBTree<K, T, GlobalSize>::nontrans_remove(const K& key) {
         size_--;
         wrapper_type* n = std::get<0>(results);
         wrapper_tree_.erase(*n);
-        free(n);
+        TransAlloc::pool_delete(n);
     }
     unlock_write(&treelock_);
     return found;
@@ -1240,7 +1237,7 @@ bool RBTree<K, T, GlobalSize>::nontrans_remove(const K& key, T& oldval) {
 	// set the old value for the caller
 	oldval = n->writeable_value();
         wrapper_tree_.erase(*n);
-        free(n);
+        TransAlloc::pool_delete(n);
     }
     unlock_write(&treelock_);
     return found;
@@ -98,7 +98,7 @@ public:
     }
     void install(TransItem& item, Transaction& txn) override {
         size_type i = item.key<size_type>();
-        data_[i].v.write(item.write_value<T>());
+        data_[i].v.write(std::move(item.write_value<T>()));
         txn.set_version_unlock(data_[i].version, item);
     }
     void unlock(TransItem& item) override {
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <vector>
 #include "Sto.hh"
 #include "TArrayProxy.hh"
+#include "CellVersions.hh"
 
 template <typename T, unsigned N, template <typename> class W = TOpaqueWrapped>
 class TArray : public TObject {
@@ -39,6 +41,13 @@ public:
     // transGet and friends
     bool transGet(size_type i, value_type& ret) const {
         assert(i < N);
+        if constexpr (has_read_readonly<W<T>>::value) {
+            if (Sto::readonly()) {
+                auto result = data_[i].v.read_readonly(data_[i].vers);
+                ret = result.second;
+                return result.first;
+            }
+        }
         auto item = Sto::item(this, i);
         if (item.has_write()) {
             ret = item.template write_value<T>();
@@ -52,6 +61,14 @@ public:
     }
     value_type transGet_throws(size_type i) const {
         assert(i < N);
+        if constexpr (has_read_readonly<W<T>>::value) {
+            if (Sto::readonly()) {
+                auto result = data_[i].v.read_readonly(data_[i].vers);
+                if (!result.first)
+                    throw Transaction::Abort();
+                return result.second;
+            }
+        }
         auto item = Sto::item(this, i);
         if (item.has_write()) {
             return item.template write_value<T>();
@@ -72,6 +89,44 @@ public:
         transPut(i, x);
     }
 
+    // Bulk reads: transGet_range reads elements [first, last) into ret
+    // under one item, whose read value snapshots every version in the
+    // range; commit validates the snapshot in one vector pass. Elements
+    // this transaction wrote read back as written. Versions that aren't
+    // validated by value alone fall back to one item per element.
+    bool transGet_range(size_type first, size_type last, value_type* ret) const {
+        assert(first <= last && last <= N);
+        if constexpr (has_read_readonly<W<T>>::value) {
+            if (Sto::readonly()) {
+                for (size_type i = first; i != last; ++i) {
+                    auto result = data_[i].v.read_readonly(data_[i].vers);
+                    if (!result.first)
+                        return false;
+                    ret[i - first] = result.second;
+                }
+                return true;
+            }
+        }
+        if constexpr (cell_versions::supported<version_type>::value) {
+            return read_range(first, last, ret);
+        } else {
+            for (size_type i = first; i != last; ++i)
+                if (!transGet(i, ret[i - first]))
+                    return false;
+            return true;
+        }
+    }
+    void transGet_range_throws(size_type first, size_type last, value_type* ret) const {
+        if (!transGet_range(first, last, ret))
+            throw Transaction::Abort();
+    }
+    // Bulk writes stay per element: each written version is locked anyway
+    void transPut_range(size_type first, size_type last, const value_type* x) const {
+        assert(first <= last && last <= N);
+        for (size_type i = first; i != last; ++i)
+            transPut(i, x[i - first]);
+    }
+
     get_type nontrans_get(size_type i) const {
         assert(i < N);
         return data_[i].v.access();
@@ -90,11 +145,20 @@ public:
         return txn.try_lock(item, data_[item.key<size_type>()].vers);
     }
     bool check(TransItem& item, Transaction& txn) override {
+        if constexpr (cell_versions::supported<version_type>::value) {
+            if (is_range(item))
+                return check_range(item, txn);
+        }
         return data_[item.key<size_type>()].vers.cp_check_version(txn, item);
     }
+    const void* version_address(TransItem& item) const override {
+        if (is_range(item))
+            return &data_[range_first(item)].vers;
+        return &data_[item.key<size_type>()].vers;
+    }
     void install(TransItem& item, Transaction& txn) override {
         size_type i = item.key<size_type>();
-        data_[i].v.write(item.write_value<T>());
+        data_[i].v.write(std::move(item.write_value<T>()));
         txn.set_version_unlock(data_[i].vers, item);
     }
     void unlock(TransItem& item) override {
@@ -108,6 +172,60 @@ private:
     };
     elem data_[N];
 
+    // Range items are keyed by their bounds, with range_bit set so they
+    // can't collide with element indexes
+    typedef cell_versions::type snapshot_type;
+    static constexpr uint64_t range_bit = uint64_t(1) << 63;
+    static uint64_t range_key(size_type first, size_type last) {
+        return range_bit | (uint64_t(last) << 32) | first;
+    }
+    static bool is_range(const TransItem& item) {
+        return item.key<uint64_t>() & range_bit;
+    }
+    static size_type range_first(const TransItem& item) {
+        return size_type(item.key<uint64_t>());
+    }
+
+    bool read_range(size_type first, size_type last, value_type* ret) const {
+        auto item = Sto::item(this, range_key(first, last));
+        std::vector<snapshot_type> snap(last - first);
+        bool own_writes = Sto::any_writes();
+        for (size_type i = first; i != last; ++i) {
+            const elem& e = data_[i];
+            snapshot_type v = e.vers.value();
+            fence();
+            if (!own_writes || !own_write(i, ret[i - first]))
+                ret[i - first] = e.v.access();
+            fence();
+            if (e.vers.value() != v
+                || !const_cast<version_type&>(e.vers).observe_read(item.item(), false))
+                return false;
+            snap[i - first] = v;
+        }
+        if (item.has_read())
+            // a repeated range read must see the same versions
+            return item.template read_value<std::vector<snapshot_type>>() == snap;
+        if (std::is_same<version_type, TNonopaqueVersion>::value)
+            return item.add_read(std::move(snap));
+        else
+            return item.add_read_opaque(std::move(snap));
+    }
+    bool own_write(size_type i, value_type& ret) const {
+        auto item = Sto::check_item(this, i);
+        if (!item || !item.get().has_write())
+            return false;
+        ret = item.get().template write_value<T>();
+        return true;
+    }
+    bool check_range(TransItem& item, Transaction& txn) {
+        size_type first = range_first(item);
+        auto& snap = item.read_value<std::vector<snapshot_type>>();
+        static_assert(sizeof(elem) % sizeof(snapshot_type) == 0, "versions must be word-aligned");
+        return cell_versions::check_range_kernel(reinterpret_cast<const snapshot_type*>(&data_[first].vers),
+                                                 sizeof(elem) / sizeof(snapshot_type),
+                                                 snap.data(), snap.size(), txn.threadid());
+    }
+
     friend class iterator;
     friend class const_iterator;
 };
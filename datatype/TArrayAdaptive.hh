@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include "Sto.hh"
 #include "TArrayProxy.hh"
 
@@ -16,6 +17,16 @@ public:
     typedef TConstArrayProxy<TArrayAdaptive<T, N, W> > const_proxy_type;
     typedef TArrayProxy<TArrayAdaptive<T, N, W> > proxy_type;
 
+    // adaptive: slots that keep conflicting write-lock at first access,
+    // the rest follow the version's read-mode hint. The fixed policies
+    // exist mainly for comparison.
+    enum class lock_policy { adaptive, optimistic, locked };
+
+    static constexpr int16_t conflict_delta = 8;
+    static constexpr int16_t hot_threshold = 32;
+    static constexpr int16_t heat_limit = 64;
+    static constexpr unsigned decay_period = 8;
+
     size_type size() const {
         return N;
     }
@@ -36,17 +47,43 @@ public:
     inline const_iterator begin() const;
     inline const_iterator end() const;
 
+    void set_policy(lock_policy p) {
+        policy_ = p;
+    }
+    lock_policy policy() const {
+        return policy_;
+    }
+    bool is_hot(size_type i) const {
+        assert(i < N);
+        return data_[i].heat.hot.load(std::memory_order_relaxed);
+    }
+
     // transGet and friends
     bool transGet(size_type i, value_type& ret) const {
         assert(i < N);
         //printf("read [%lu]\n", i);
         auto item = Sto::item(this, i);
-        if (item.has_write()) {
+        if (item.has_flag(lock_only_bit)) {
+            // we hold the write lock, so the value can't move
+            ret = data_[i].v.access();
+            return true;
+        } else if (item.has_write()) {
             ret = item.template write_value<T>();
             return true;
-        }
-        else {
+        } else if (!item.has_read() && lock_at_access(i)) {
+            if (!item.acquire_write(data_[i].vers)) {
+                data_[i].heat.conflict();
+                return false;
+            }
+            item.add_flags(lock_only_bit);
+            ret = data_[i].v.access();
+            return true;
+        } else {
+            if (policy_ == lock_policy::optimistic)
+                item.cc_mode(CCMode::opt);
             auto result = data_[i].v.read(item, data_[i].vers);
+            if (!result.first)
+                data_[i].heat.conflict();
             ret = result.second;
             return result.first;
         }
@@ -61,7 +98,17 @@ public:
     bool transPut(size_type i, T x) {
         assert(i < N);
         //printf("write [%lu] = %lu\n", i, x);
-        return Sto::item(this, i).acquire_write(data_[i].vers, x);
+        auto item = Sto::item(this, i);
+        if (item.has_flag(lock_only_bit)) {
+            // locked by an earlier transGet; turn it into a real write
+            item.clear_flags(lock_only_bit).clear_write().add_write(x);
+            return true;
+        }
+        if (!item.acquire_write(data_[i].vers, x)) {
+            data_[i].heat.conflict();
+            return false;
+        }
+        return true;
     }
     void transPut_throws(size_type i, T x) {
         bool ok = transPut(i, x);
@@ -87,11 +134,21 @@ public:
         return txn.try_lock(item, data_[item.key<size_type>()].vers);
     }
     bool check(TransItem& item, Transaction& txn) override {
-        return data_[item.key<size_type>()].vers.cp_check_version(txn, item);
+        auto& e = data_[item.key<size_type>()];
+        bool ok = e.vers.cp_check_version(txn, item);
+        if (ok)
+            e.heat.decay();
+        else
+            e.heat.conflict();
+        return ok;
     }
     void install(TransItem& item, Transaction& txn) override {
         size_type i = item.key<size_type>();
-        data_[i].v.write(item.write_value<T>());
+        data_[i].heat.decay();
+        // lock-only items leave the version alone; unlock() releases them
+        if (item.has_flag(lock_only_bit))
+            return;
+        data_[i].v.write(std::move(item.write_value<T>()));
         txn.set_version_unlock(data_[i].vers, item);
     }
     void unlock(TransItem& item) override {
@@ -99,11 +156,51 @@ public:
     }
 
 private:
+    // A write-locked item that was only read: install() skips it
+    static constexpr TransItem::flags_type lock_only_bit = TransItem::user0_bit;
+
+    // Per-slot contention score. Conflicts on the slot (failed accesses
+    // and failed validations) add conflict_delta; commits touching it
+    // drain one point every decay_period. A slot turns hot at
+    // hot_threshold and cools only once the score drains to zero, so one
+    // quiet stretch doesn't flip it back. Updates are lossy on purpose.
+    struct slot_heat {
+        std::atomic<int16_t> score{0};
+        std::atomic<bool> hot{false};
+
+        void conflict() {
+            int16_t x = std::min<int16_t>(heat_limit, score.load(std::memory_order_relaxed) + conflict_delta);
+            score.store(x, std::memory_order_relaxed);
+            if (x >= hot_threshold && !hot.load(std::memory_order_relaxed))
+                hot.store(true, std::memory_order_relaxed);
+        }
+        void decay() {
+            if (++tick_ % decay_period)
+                return;
+            int16_t x = score.load(std::memory_order_relaxed);
+            if (x == 0)
+                return;
+            score.store(x - 1, std::memory_order_relaxed);
+            if (x == 1 && hot.load(std::memory_order_relaxed))
+                hot.store(false, std::memory_order_relaxed);
+        }
+    };
+
     struct elem {
         mutable version_type vers;
         W<T> v;
+        mutable slot_heat heat;
     };
     elem data_[N];
+    lock_policy policy_ = lock_policy::adaptive;
+
+    static inline thread_local unsigned tick_;
+
+    bool lock_at_access(size_type i) const {
+        return policy_ == lock_policy::locked
+            || (policy_ == lock_policy::adaptive
+                && data_[i].heat.hot.load(std::memory_order_relaxed));
+    }
 
     friend class iterator;
     friend class const_iterator;
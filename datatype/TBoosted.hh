@@ -0,0 +1,162 @@
+#pragma once
+
+#include <functional>
+#include "Sto.hh"
+#include "Boosting_locks.hh"
+
+// Transactional boosting as an STO object. Operations run directly on a
+// thread-safe structure; transactions stay isolated because each key's
+// abstract lock is held until the transaction ends, and they stay atomic
+// because every update logs its inverse, which runs if the transaction
+// aborts. The structure needs no versions, so a lock-free container can
+// join STO transactions unchanged, next to ordinary OCC objects.
+//
+// Abstract locks are striped: keys hashing to the same stripe share a lock,
+// which can only add conflicts. A lock that stays taken past the spin
+// bound aborts the transaction, which also breaks deadlocks.
+template <typename K, typename Hash = std::hash<K>, unsigned NLocks = 1024>
+class TBoosted : public TObject {
+public:
+    typedef std::function<void()> undo_type;
+
+    explicit TBoosted(Hash h = Hash())
+        : hash_(h) {
+    }
+
+    // Holds k's abstract lock in shared mode until the transaction ends
+    void read_lock(const K& k) {
+        RWLock* lock = lock_for(k);
+        auto item = Sto::item(this, lock);
+        if (!item.has_write()) {
+            if (!lock->tryReadLock(READ_SPIN))
+                Sto::abort();
+            item.add_write(read_mode);
+        }
+    }
+    // Holds k's abstract lock exclusively until the transaction ends
+    void write_lock(const K& k) {
+        RWLock* lock = lock_for(k);
+        auto item = Sto::item(this, lock);
+        if (!item.has_write()) {
+            if (!lock->tryWriteLock(WRITE_SPIN))
+                Sto::abort();
+            item.add_write(write_mode);
+        } else if (item.template write_value<uintptr_t>() == read_mode) {
+            if (!lock->tryUpgrade(WRITE_SPIN))
+                Sto::abort();
+            item.add_write(write_mode);
+        }
+    }
+
+    // Logs the inverse of an update already applied under write_lock().
+    // Inverses run newest first, and only if the transaction aborts.
+    template <typename F>
+    void on_abort(F&& inverse) {
+        Sto::new_item(this, static_cast<RWLock*>(nullptr))
+            .add_write(undo_type(std::forward<F>(inverse)));
+    }
+
+    bool lock(TransItem&, Transaction&) override {
+        return true;
+    }
+    bool check(TransItem&, Transaction&) override {
+        return true;
+    }
+    void install(TransItem&, Transaction&) override {
+    }
+    void unlock(TransItem&) override {
+    }
+    // Abort cleanup visits items newest first, so each inverse runs
+    // before the lock that covers it is released
+    void cleanup(TransItem& item, bool committed) override {
+        RWLock* lock = item.key<RWLock*>();
+        if (!lock) {
+            if (!committed)
+                item.write_value<undo_type>()();
+        } else if (item.write_value<uintptr_t>() == write_mode)
+            lock->writeUnlock();
+        else
+            lock->readUnlock();
+    }
+
+private:
+    static constexpr uintptr_t read_mode = 1;
+    static constexpr uintptr_t write_mode = 2;
+
+    RWLock locks_[NLocks];
+    Hash hash_;
+
+    RWLock* lock_for(const K& k) {
+        return &locks_[hash_(k) % NLocks];
+    }
+};
+
+
+// A boosted map. Map must be safe for concurrent use and provide
+//     bool find(const K&, V&) const;
+//     bool insert(const K&, const V&);     // false if present
+//     bool erase(const K&, V& old);        // false if absent
+//     bool put(const K&, const V&, V& old); // true if it was present
+template <typename K, typename V, typename Map, typename Hash = std::hash<K>>
+class TBoostedMap : public TBoosted<K, Hash> {
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef Map map_type;
+
+    template <typename... Args>
+    explicit TBoostedMap(Args&&... args)
+        : map_(std::forward<Args>(args)...) {
+    }
+
+    bool transGet(const K& k, V& v) {
+        this->read_lock(k);
+        return map_.find(k, v);
+    }
+    // Returns false, changing nothing, if k is present
+    bool transInsert(const K& k, const V& v) {
+        this->write_lock(k);
+        if (!map_.insert(k, v))
+            return false;
+        this->on_abort([this, k] {
+                V old;
+                map_.erase(k, old);
+            });
+        return true;
+    }
+    // Returns false if k is absent
+    bool transDelete(const K& k) {
+        this->write_lock(k);
+        V old;
+        if (!map_.erase(k, old))
+            return false;
+        this->on_abort([this, k, old] {
+                map_.insert(k, old);
+            });
+        return true;
+    }
+    // Returns true if k was present
+    bool transPut(const K& k, const V& v) {
+        this->write_lock(k);
+        V old;
+        bool existed = map_.put(k, v, old);
+        if (existed)
+            this->on_abort([this, k, old] {
+                    V cur;
+                    map_.put(k, old, cur);
+                });
+        else
+            this->on_abort([this, k] {
+                    V cur;
+                    map_.erase(k, cur);
+                });
+        return existed;
+    }
+
+    Map& nontrans_map() {
+        return map_;
+    }
+
+private:
+    Map map_;
+};
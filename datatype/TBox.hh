@@ -16,8 +16,14 @@ public:
     }
 
     std::pair<bool, read_type> read_nothrow() const {
+        if constexpr (has_read_readonly<W>::value) {
+            if (Sto::readonly())
+                return v_.read_readonly(vers_);
+        }
         auto item = Sto::item(this, 0);
-        if (item.has_write())
+        if (item.has_flag(in_place_bit))
+            return {true, v_.access()};
+        else if (item.has_write())
             return {true, item.template write_value<T>()};
         else
             return v_.read(item, vers_);
@@ -32,14 +38,53 @@ public:
     }
 
     void write(const T& x) {
-        Sto::item(this, 0).acquire_write(vers_, x);
+        auto item = Sto::item(this, 0);
+        if (item.has_flag(in_place_bit))
+            v_.access() = x;
+        else
+            item.acquire_write(vers_, x);
     }
     void write(T&& x) {
-        Sto::item(this, 0).acquire_write(vers_, std::move(x));
+        auto item = Sto::item(this, 0);
+        if (item.has_flag(in_place_bit))
+            v_.access() = std::move(x);
+        else
+            item.acquire_write(vers_, std::move(x));
     }
     template <typename... Args>
     void write(Args&&... args) {
-        Sto::item(this, 0).template acquire_write<T>(vers_, std::forward<Args>(args)...);
+        auto item = Sto::item(this, 0);
+        if (item.has_flag(in_place_bit))
+            v_.access() = T(std::forward<Args>(args)...);
+        else
+            item.template acquire_write<T>(vers_, std::forward<Args>(args)...);
+    }
+
+    // Eager update for boxes whose writes lock at access time (TLockVersion,
+    // e.g. TLockWrapped): takes the write lock, saves the current value in
+    // the transaction's scratch space, and returns the value itself to
+    // modify. Install then has nothing to copy, which matters for large
+    // values; an abort copies the saved value back. The version is marked
+    // dirty until the transaction ends, so optimistic readers can't
+    // validate against the uncommitted value.
+    T& update_in_place() {
+        static_assert(std::is_same<version_type, TLockVersion<false>>::value
+                      || std::is_same<version_type, TLockVersion<true>>::value,
+                      "in-place updates need write locks taken at access time");
+        static_assert(std::is_trivially_copyable<T>::value, "undo copies are bytewise");
+        auto item = Sto::item(this, 0);
+        if (item.has_flag(in_place_bit))
+            return v_.access();
+        bool pending = item.has_write();
+        if (!pending && !item.acquire_write(vers_))
+            throw Transaction::Abort();
+        // we hold the write lock from here on
+        T* undo = Sto::tx_alloc(&v_.access());
+        if (pending)
+            v_.write(std::move(item.template write_value<T>()));
+        vers_.cp_try_lock(item, TThread::id());
+        item.clear_write().add_write(undo).add_flags(in_place_bit);
+        return v_.access();
     }
 
     operator read_type() const {
@@ -76,6 +121,16 @@ public:
         v_.access() = std::move(x);
     }
 
+    // Logs this box's committed writes under id, a nonzero id unique among
+    // logged objects (TxnLog)
+    void set_log_id(uint32_t id) {
+        static_assert(std::is_trivially_copyable<T>::value, "logged values are copied bytewise");
+        log_id_ = id;
+    }
+    uint32_t log_id() const {
+        return log_id_;
+    }
+
     // transactional methods
     bool lock(TransItem& item, Transaction& txn) override {
         return txn.try_lock(item, vers_);
@@ -83,23 +138,45 @@ public:
     bool check(TransItem& item, Transaction& txn) override {
         return vers_.cp_check_version(txn, item);
     }
+    const void* version_address(TransItem&) const override {
+        return &vers_;
+    }
     void install(TransItem& item, Transaction& txn) override {
-        v_.write(std::move(item.template write_value<T>()));
+        if (!item.has_flag(in_place_bit))
+            v_.write(std::move(item.template write_value<T>()));
+        if (log_id_)
+            txn.log_write(log_id_, nullptr, 0, &v_.access(), sizeof(T), vers_.cp_commit_tid(txn));
         txn.set_version_unlock(vers_, item);
     }
     void unlock(TransItem& item) override {
         vers_.cp_unlock(item);
     }
+    void cleanup(TransItem& item, bool committed) override {
+        // only update_in_place's trivially copyable T get in_place_bit
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            if (!committed && item.has_flag(in_place_bit)) {
+                // still write-locked: unlock() runs after cleanup
+                memcpy(&v_.access(), item.template write_value<T*>(), sizeof(T));
+                vers_.inc_nonopaque();
+            }
+        }
+    }
     void print(std::ostream& w, const TransItem& item) const override {
         w << "{TBox<" << typeid(T).name() << "> " << (void*) this;
         if (item.has_read())
             w << " R" << item.read_value<version_type>();
-        if (item.has_write())
+        if (item.has_flag(in_place_bit))
+            w << " =in-place";
+        else if (item.has_write())
             w << " =" << item.write_value<T>();
         w << "}";
     }
 
 protected:
+    // write value is the undo copy; the new value is already in v_
+    static constexpr TransItem::flags_type in_place_bit = TransItem::user0_bit;
+
     version_type vers_;
     W v_;
+    uint32_t log_id_ = 0;
 };
@@ -0,0 +1,463 @@
+#pragma once
+#include <atomic>
+#include <sched.h>
+#include <vector>
+#include "TWrapped.hh"
+#include "TArrayProxy.hh"
+#include "TIntPredicate.hh"
+
+// A transactional vector with chunked storage.
+//
+// Elements live in a directory of chunks whose sizes double (first_chunk,
+// 2*first_chunk, ...). Chunks are allocated on demand and never move, so
+// growth doesn't relocate elements and element versions stay put.
+//
+// Unlike TVector, push_back doesn't lock the size. A transaction that only
+// appends (and never looks at the size) reserves its slots at install time
+// with a fetch-and-add and then publishes them in reservation order; two
+// such appenders commute. A transaction that observes the size, or pops
+// elements it didn't push, takes the size lock instead and appends at the
+// size it validated. Size observations are validated by value, so they
+// abort only when concurrent appends or pops actually contradict them.
+template <typename T, template <typename> class W = TOpaqueWrapped>
+class TChunkedVector : public TObject {
+public:
+    using size_type = int;
+    using difference_type = int;
+    typedef typename W<T>::version_type version_type;
+private:
+    static constexpr int first_chunk_shift = 6;
+    static constexpr size_type first_chunk = size_type(1) << first_chunk_shift;
+    static constexpr int max_chunks = 31 - first_chunk_shift;
+    static constexpr size_type max_size = first_chunk * ((size_type(1) << max_chunks) - 1);
+
+    using pred_type = TIntRange<size_type>;
+    using key_type = int;
+    static constexpr key_type size_key = -1;
+    static constexpr key_type tail_key = -2;
+    /* size_key exists if the transaction observed the size. Its
+       predicate_value records constraints on the size, and its
+       xwrite_value is the size the transaction first saw.
+       tail_key exists if the transaction pushed or popped. Its write_value
+       is a tail_type: `pops` elements are removed from the end of the
+       committed vector, then `pushes` are appended. A transaction only pops
+       committed elements once its own pushes are gone, so at most one of
+       these is nonempty. Popped elements also get element items with
+       pop_bit, which lock them and mark them dead at install. */
+    struct tail_type {
+        size_type pops = 0;
+        std::vector<T> pushes;
+    };
+
+    static constexpr TransItem::flags_type pop_bit = TransItem::user0_bit;
+    static constexpr TransItem::flags_type onlyexists_bit = pop_bit << 1;
+    static constexpr typename version_type::type dead_bit = TransactionTid::user_bit;
+    // spins on an earlier appender's publish before yielding the CPU
+    static constexpr unsigned publish_spins = 64;
+public:
+    using size_proxy = TIntRangeProxy<size_type>;
+    typedef T value_type;
+    typedef typename W<T>::read_type get_type;
+    typedef TConstArrayProxy<TChunkedVector<T, W> > const_proxy_type;
+    typedef TArrayProxy<TChunkedVector<T, W> > proxy_type;
+    typedef proxy_type reference;
+    typedef const_proxy_type const_reference;
+
+    TChunkedVector()
+        : size_(0), reserved_(0), pending_(0) {
+        for (auto& c : chunks_)
+            c.store(nullptr, std::memory_order_relaxed);
+    }
+    ~TChunkedVector() {
+        for (auto& c : chunks_)
+            delete[] c.load(std::memory_order_relaxed);
+    }
+
+    size_proxy size() const {
+        auto sitem = size_item();
+        size_type delta = 0;
+        if (auto titem = Sto::check_item(this, tail_key)) {
+            auto& tail = titem.get().template write_value<tail_type>();
+            delta = size_type(tail.pushes.size()) - tail.pops;
+        }
+        return size_proxy(&size_predicate(sitem), original_size(sitem), delta);
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const_proxy_type operator[](size_type i) const {
+        return const_proxy_type(this, i);
+    }
+    proxy_type operator[](size_type i) {
+        return proxy_type(this, i);
+    }
+    const_proxy_type front() const {
+        return const_proxy_type(this, 0);
+    }
+    proxy_type front() {
+        return proxy_type(this, 0);
+    }
+    const_proxy_type back() const {
+        return const_proxy_type(this, back_index());
+    }
+    proxy_type back() {
+        return proxy_type(this, back_index());
+    }
+
+    void push_back(T x) {
+        auto titem = tail_item();
+        auto& tail = titem.template write_value<tail_type>();
+        if (tail.pops) {
+            // refill the slot popped last
+            size_type i = original_size(size_item()) - tail.pops;
+            Sto::item(this, i).clear_write().clear_flags(pop_bit).add_write(std::move(x));
+            --tail.pops;
+        } else
+            tail.pushes.push_back(std::move(x));
+    }
+    void pop_back() {
+        auto titem = tail_item();
+        auto& tail = titem.template write_value<tail_type>();
+        if (!tail.pushes.empty()) {
+            tail.pushes.pop_back();
+            return;
+        }
+        auto sitem = size_item();
+        size_type sz = original_size(sitem);
+        size_predicate(sitem).observe(sz);
+        if (tail.pops == sz)
+            version_type::opaque_throw(std::out_of_range("TChunkedVector::pop_back"));
+        ++tail.pops;
+        Sto::item(this, sz - tail.pops).add_write().add_flags(pop_bit);
+    }
+
+    void nontrans_push_back(T x) {
+        size_type sz = size_.load(std::memory_order_relaxed);
+        assert(sz < max_size);
+        elem& e = slot(sz);
+        e.v.write(std::move(x));
+        e.vers = version_type(Sto::initialized_tid());
+        size_.store(sz + 1, std::memory_order_release);
+        reserved_.store(sz + 1, std::memory_order_relaxed);
+    }
+
+    // transGet and friends
+    std::pair<bool, get_type> transGet(size_type i) const {
+        size_type base;
+        if (auto tail = own_pushes(i, base)) {
+            if (i - base >= size_type(tail->pushes.size()))
+                goto out_of_range;
+            return {true, tail->pushes[i - base]};
+        }
+        {
+            TransProxy item = Sto::item(this, i);
+            if (item.has_write()) {
+                if (item.has_flag(pop_bit))
+                    goto out_of_range;
+                return {true, item.template write_value<T>()};
+            }
+            if (i < 0 || i >= max_size)
+                goto out_of_range;
+            elem& e = slot(i);
+            auto result = e.v.read(item, e.vers);
+            if (!result.first)
+                throw Transaction::Abort();
+            if (item.read_value<version_type>().value() & dead_bit)
+                goto out_of_range;
+            return result;
+        }
+    out_of_range:
+        version_type::opaque_throw(std::out_of_range("TChunkedVector::transGet"));
+    }
+    get_type transGet_throws(size_type i) const {
+        auto result = transGet(i);
+        if (!result.first) {
+          throw Transaction::Abort();
+        }
+        return result.second;
+    }
+    bool transPut(size_type i, T x) {
+        size_type base;
+        if (auto tail = own_pushes(i, base)) {
+            if (i - base >= size_type(tail->pushes.size()))
+                return false;
+            tail->pushes[i - base] = std::move(x);
+            return true;
+        }
+        auto item = Sto::item(this, i);
+        if (item.has_flag(pop_bit)
+            || (!item.has_read() && !item.has_write() && !put_in_range(item, i)))
+            return false;
+        item.add_write(std::move(x));
+        return true;
+    }
+    void transPut_throws(size_type i, T x) {
+        if (!transPut(i, x)) {
+            version_type::opaque_throw(std::out_of_range("TChunkedVector::transPut"));
+        }
+    }
+
+    size_type nontrans_size() const {
+        return size_.load(std::memory_order_acquire);
+    }
+    get_type nontrans_get(size_type i) const {
+        assert(i < nontrans_size());
+        return slot(i).v.access();
+    }
+    void nontrans_put(size_type i, const T& x) {
+        assert(i < nontrans_size());
+        slot(i).v.access() = x;
+    }
+    void nontrans_put(size_type i, T&& x) {
+        assert(i < nontrans_size());
+        slot(i).v.access() = std::move(x);
+    }
+
+    // transactional methods
+    bool check_predicate(TransItem& item, Transaction& txn, bool) override {
+        // size_ is stable while size_vers_ is unlocked and nobody is
+        // between locking an append and publishing it
+        pred_type pred = item.template predicate_value<pred_type>();
+        auto v = size_vers_.value();
+        if (TransactionTid::is_locked_elsewhere(v, txn.threadid()))
+            return false;
+        fence();
+        if (pending_.load() != 0)
+            return false;
+        size_type sz = size_.load(std::memory_order_acquire);
+        fence();
+        return size_vers_.value() == v && pred.verify(sz);
+    }
+    bool lock(TransItem& item, Transaction& txn) override {
+        auto key = item.template key<key_type>();
+        if (key == tail_key) {
+            if (txn.check_item(this, size_key)) {
+                // appends land at the size this transaction validated
+                if (!txn.try_lock(item, size_vers_))
+                    return false;
+                fence();
+                auto sitem = txn.check_item(this, size_key).get();
+                if (pending_.load() != 0 || !size_predicate(sitem).verify(size_.load())) {
+                    size_vers_.cp_unlock(item);
+                    return false;
+                }
+                return true;
+            }
+            pending_.fetch_add(1);
+            if (size_vers_.is_locked()) {
+                pending_.fetch_sub(1);
+                return false;
+            }
+            return true;
+        } else
+            return txn.try_lock(item, slot(key).vers);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        auto key = item.template key<key_type>();
+        assert(key >= 0);
+        if (item.has_flag(onlyexists_bit))
+            return !(slot(key).vers.snapshot(item, txn) & dead_bit);
+        else
+            return slot(key).vers.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        auto key = item.template key<key_type>();
+        if (key != tail_key) {
+            elem& e = slot(key);
+            if (!item.has_flag(pop_bit))
+                e.v.write(std::move(item.template write_value<T>()));
+            txn.set_version_unlock(e.vers, item, item.has_flag(pop_bit) ? dead_bit : 0);
+            return;
+        }
+
+        auto& tail = item.template write_value<tail_type>();
+        size_type n = tail.pushes.size();
+        bool exclusive = txn.check_item(this, size_key);
+        size_type base;
+        if (exclusive)
+            base = size_.load(std::memory_order_relaxed) - tail.pops;
+        else
+            base = reserved_.fetch_add(n);
+        assert(base + n <= max_size);
+        for (size_type i = 0; i != n; ++i) {
+            elem& e = slot(base + i);
+            e.vers.lock_exclusive();
+            e.v.write(std::move(tail.pushes[i]));
+            txn.set_version(e.vers);
+            e.vers.unlock_exclusive();
+        }
+        if (exclusive) {
+            reserved_.store(base + n, std::memory_order_relaxed);
+            size_.store(base + n, std::memory_order_release);
+            txn.set_version_unlock(size_vers_, item);
+        } else {
+            // publish in reservation order. Everyone ahead of us is past
+            // validation, but may have been preempted, so yield after a
+            // few spins rather than convoy behind it
+            for (unsigned spins = 0; size_.load(std::memory_order_acquire) != base; ++spins) {
+                if (spins < publish_spins)
+                    relax_fence();
+                else
+                    sched_yield();
+            }
+            size_.store(base + n, std::memory_order_release);
+            pending_.fetch_sub(1);
+            item.clear_needs_unlock();
+        }
+    }
+    void unlock(TransItem& item) override {
+        auto key = item.template key<key_type>();
+        if (key != tail_key)
+            slot(key).vers.cp_unlock(item);
+        else if (TransactionTid::is_locked_here(size_vers_.value()))
+            size_vers_.cp_unlock(item);
+        else
+            pending_.fetch_sub(1);
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        w << "{TChunkedVector<" << typeid(T).name() << "> " << (void*) this;
+        key_type key = item.key<key_type>();
+        if (key == size_key) {
+            w << ".size @" << original_size(item);
+            if (item.has_predicate())
+                w << ' ' << item.predicate_value<pred_type>();
+        } else if (key == tail_key) {
+            auto& tail = item.write_value<tail_type>();
+            w << ".tail";
+            if (tail.pops)
+                w << " -" << tail.pops;
+            if (!tail.pushes.empty())
+                w << " +" << tail.pushes.size();
+        } else {
+            w << "[" << key << "]";
+            if (item.has_read())
+                w << " R" << item.read_value<version_type>();
+            if (item.has_write() && item.has_flag(pop_bit))
+                w << " =X";
+            else if (item.has_write())
+                w << " =" << item.write_value<T>();
+        }
+        w << "}";
+    }
+    void print(std::ostream& w) const;
+
+private:
+    struct elem {
+        version_type vers;
+        W<T> v;
+
+        elem()
+            : vers(dead_bit) {
+        }
+    };
+    mutable std::atomic<elem*> chunks_[max_chunks];
+    std::atomic<size_type> size_;     // published size
+    std::atomic<size_type> reserved_; // slots handed to appenders
+    std::atomic<int> pending_;        // appenders between lock and install
+    version_type size_vers_;          // locked by size-changing commits
+
+    elem* chunk(int c) const {
+        elem* ch = chunks_[c].load(std::memory_order_acquire);
+        if (!ch) {
+            elem* fresh = new elem[first_chunk << c];
+            if (chunks_[c].compare_exchange_strong(ch, fresh))
+                ch = fresh;
+            else
+                delete[] fresh;
+        }
+        return ch;
+    }
+    elem& slot(size_type i) const {
+        unsigned x = unsigned(i) + first_chunk;
+        int c = 31 - __builtin_clz(x) - first_chunk_shift;
+        return chunk(c)[x - (unsigned(first_chunk) << c)];
+    }
+
+    // size helpers
+    TransProxy size_item() const {
+        auto item = Sto::item(this, size_key);
+        if (!item.has_predicate()) {
+            item.set_predicate(pred_type::unconstrained());
+            item.template xwrite_value<size_type>() = size_.load(std::memory_order_acquire);
+        }
+        return item;
+    }
+    TransProxy tail_item() {
+        auto item = Sto::item(this, tail_key);
+        if (!item.has_write())
+            item.add_write(tail_type());
+        return item;
+    }
+    static pred_type& size_predicate(TransProxy sitem) {
+        return sitem.template predicate_value<pred_type>();
+    }
+    static size_type original_size(TransProxy sitem) {
+        return sitem.template xwrite_value<size_type>();
+    }
+    static size_type original_size(const TransItem& sitem) {
+        return sitem.template xwrite_value<size_type>();
+    }
+    size_type back_index() const {
+        auto sitem = size_item();
+        size_type sz = original_size(sitem);
+        size_predicate(sitem).observe(sz);
+        if (auto titem = Sto::check_item(this, tail_key)) {
+            auto& tail = titem.get().template write_value<tail_type>();
+            sz += size_type(tail.pushes.size()) - tail.pops;
+        }
+        if (!sz)
+            version_type::opaque_throw(std::out_of_range("TChunkedVector::back"));
+        return sz - 1;
+    }
+    // If this transaction has pushes and `i` is past the size it observed,
+    // return its tail and set `base` to the index of its first push.
+    const tail_type* own_pushes(size_type i, size_type& base) const {
+        auto titem = Sto::check_item(this, tail_key);
+        if (!titem || titem.get().template write_value<tail_type>().pushes.empty())
+            return nullptr;
+        // don't observe the size for reads that can't hit a push
+        auto oitem = Sto::check_item(this, size_key);
+        if (i < (oitem ? original_size(oitem.get()) : size_.load(std::memory_order_acquire)))
+            return nullptr;
+        auto sitem = size_item();
+        base = original_size(sitem);
+        if (i < base)
+            return nullptr;
+        size_predicate(sitem).observe(base);
+        return &titem.get().template write_value<tail_type>();
+    }
+    tail_type* own_pushes(size_type i, size_type& base) {
+        return const_cast<tail_type*>(static_cast<const TChunkedVector<T, W>*>(this)->own_pushes(i, base));
+    }
+    bool put_in_range(TransProxy& item, size_type i) const {
+        if (i < 0 || i >= max_size)
+            return false;
+        elem& e = slot(i);
+        item.observe(e.vers);
+        item.add_flags(onlyexists_bit);
+        return !(item.read_value<version_type>().value() & dead_bit);
+    }
+};
+
+
+template <typename T, template <typename> class W>
+void TChunkedVector<T, W>::print(std::ostream& w) const {
+    size_type sz = nontrans_size();
+    w << "TChunkedVector<" << typeid(T).name() << ">{" << (void*) this
+      << "size=" << sz << '@' << size_vers_ << " [";
+    for (size_type i = 0; i < sz && i < 10; ++i) {
+        if (i)
+            w << ", ";
+        w << slot(i).v.access() << '@' << slot(i).vers;
+    }
+    if (sz > 10)
+        w << "...";
+    w << "]}";
+}
+
+template <typename T, template <typename> class W>
+std::ostream& operator<<(std::ostream& w, const TChunkedVector<T, W>& v) {
+    v.print(w);
+    return w;
+}
@@ -63,7 +63,7 @@ public:
 
     void install(TransItem &item, Transaction &txn) override {
         size_type i = item.key<size_type>();
-        data_[i].v.write(item.write_value<T>());
+        data_[i].v.write(std::move(item.write_value<T>()));
         txn.set_version_unlock(data_[i].vers, item);
     }
 
@@ -86,6 +86,9 @@ using TOCCArray = TFlexArray<T, N, TNonopaqueWrapped>;
 template <typename T, unsigned N>
 using TAdaptiveArray = TFlexArray<T, N, TAdaptiveNonopaqueWrapped>;
 
+template <typename T, unsigned N>
+using T2PLArray = TFlexArray<T, N, TLockNonopaqueWrapped>;
+
 template <typename T, unsigned N>
 using TSwissArray = TFlexArray<T, N, TSwissNonopaqueWrapped>;
 
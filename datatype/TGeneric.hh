@@ -1,12 +1,78 @@
 #pragma once
+#include <atomic>
+#include <algorithm>
+#include <new>
 #include "Transaction.hh"
 #include "TWrapped.hh"
 
+// Words are mapped onto a table of versions by address, so distinct words
+// that hash to one version conflict falsely. The table size and layout are
+// chosen at construction and can be changed by nontrans_resize. The dense
+// layout packs several versions per cache line; the striped layout gives
+// each version its own line, so hot words don't share lines with each
+// other's versions. check() counts how many validation failures were
+// false, i.e. the version was last bumped for a different word
+// (approximate: a failure caused by a concurrent lock counts by the last
+// installed word).
 template <template <typename> class W = TOpaqueWrapped>
 class TBasicGeneric : public TObject {
 public:
     typedef typename W<int>::version_type version_type;
-    static constexpr unsigned table_size = 1 << 15;
+    static constexpr unsigned default_table_size = 1 << 15;
+
+    enum table_layout { dense, striped };
+
+    explicit TBasicGeneric(unsigned size = default_table_size, table_layout layout = dense)
+        : table_(nullptr), check_failures_(0), false_conflicts_(0) {
+        allocate(size, layout, version_type());
+    }
+    ~TBasicGeneric() {
+        deallocate();
+    }
+    TBasicGeneric(const TBasicGeneric&) = delete;
+    TBasicGeneric& operator=(const TBasicGeneric&) = delete;
+
+    unsigned table_size() const {
+        return mask_ + 1;
+    }
+    table_layout layout() const {
+        return stride_ == sizeof(slot) ? dense : striped;
+    }
+    // Replaces the version table. Only call at a quiescent point, when no
+    // transaction has items on this object. The new versions start at the
+    // newest old version, so no version appears to go backwards.
+    void nontrans_resize(unsigned size, table_layout layout) {
+        typename version_type::type newest = 0;
+        for (unsigned i = 0; i != table_size(); ++i)
+            newest = std::max(newest, TransactionTid::unlocked(at(i).vers.value()));
+        deallocate();
+        allocate(size, layout, version_type(newest));
+    }
+
+    struct stats_type {
+        uint64_t check_failures;
+        uint64_t false_conflicts;
+    };
+    stats_type stats() const {
+        return {check_failures_.load(std::memory_order_relaxed),
+                false_conflicts_.load(std::memory_order_relaxed)};
+    }
+    // Fraction of validation failures that were false conflicts
+    double false_conflict_rate() const {
+        stats_type st = stats();
+        return st.check_failures ? double(st.false_conflicts) / st.check_failures : 0;
+    }
+    void clear_stats() {
+        check_failures_.store(0, std::memory_order_relaxed);
+        false_conflicts_.store(0, std::memory_order_relaxed);
+    }
+    void report(FILE* f) const {
+        stats_type st = stats();
+        fprintf(f, "$ TGeneric %p: %u %s versions, %llu check failures, %llu false (%.1f%%)\n",
+                (void*) this, table_size(), layout() == dense ? "dense" : "striped",
+                (unsigned long long) st.check_failures, (unsigned long long) st.false_conflicts,
+                100 * false_conflict_rate());
+    }
 
     template <typename T>
     T read(T* word) {
@@ -19,7 +85,10 @@ public:
             assert(it.shifted_user_flags() == sizeof(T));
             return it.template write_value<T>();
         }
-        return W<T>::read(word, it, version(word)).second;
+        auto result = W<T>::read(word, it, version(word));
+        if (!result.first)
+            throw Transaction::Abort();
+        return result.second;
     }
     template <typename T, typename U>
     void write(T* word, U value) {
@@ -34,13 +103,26 @@ public:
         return vers.is_locked_here() || txn.try_lock(item, vers);
     }
     bool check(TransItem& item, Transaction& txn) override {
-        return version(item.template key<void*>()).cp_check_version(txn, item);
+        void* word = item.template key<void*>();
+        slot& s = at(word);
+        // another word's write may have locked this version for us
+        if (s.vers.is_locked_here() && !item.has_write()) {
+            if (s.vers.check_version(item.template read_value<version_type>()))
+                return true;
+        } else if (s.vers.cp_check_version(txn, item))
+            return true;
+        check_failures_.fetch_add(1, std::memory_order_relaxed);
+        if (s.last.load(std::memory_order_relaxed) != word)
+            false_conflicts_.fetch_add(1, std::memory_order_relaxed);
+        return false;
     }
     void install(TransItem& item, Transaction& txn) override {
         void* word = item.template key<void*>();
         void* data = item.template write_value<void*>();
         memcpy(word, &data, item.shifted_user_flags());
-        txn.set_version(version(word));
+        slot& s = at(word);
+        s.last.store(word, std::memory_order_relaxed);
+        txn.set_version(s.vers);
     }
     void unlock(TransItem& item) override {
         version_type& vers = version(item.template key<void*>());
@@ -57,10 +139,49 @@ public:
     }
 
 private:
-    version_type table_[table_size];
+    struct slot {
+        version_type vers;
+        std::atomic<void*> last;    // word of the last install
+
+        explicit slot(const version_type& v)
+            : vers(v), last(nullptr) {
+        }
+    };
+
+    char* table_;
+    unsigned mask_;
+    unsigned stride_;
+    std::atomic<uint64_t> check_failures_;
+    std::atomic<uint64_t> false_conflicts_;
 
+    void allocate(unsigned size, table_layout layout, const version_type& v) {
+        unsigned n = 1;
+        while (n < size)
+            n <<= 1;
+        mask_ = n - 1;
+        stride_ = layout == dense ? sizeof(slot) : round_up(sizeof(slot), CACHE_LINE_SIZE);
+        table_ = static_cast<char*>(::operator new(size_t(n) * stride_, std::align_val_t(CACHE_LINE_SIZE)));
+        for (unsigned i = 0; i != n; ++i)
+            new (table_ + size_t(i) * stride_) slot(v);
+    }
+    void deallocate() {
+        for (unsigned i = 0; i != table_size(); ++i)
+            at(i).~slot();
+        ::operator delete(table_, std::align_val_t(CACHE_LINE_SIZE));
+        table_ = nullptr;
+    }
+    static unsigned round_up(unsigned x, unsigned to) {
+        return (x + to - 1) / to * to;
+    }
+
+    slot& at(unsigned i) const {
+        return *reinterpret_cast<slot*>(table_ + size_t(i) * stride_);
+    }
+    slot& at(void* k) const {
+        return at(unsigned(reinterpret_cast<uintptr_t>(k) >> 3) & mask_);
+    }
     inline version_type& version(void* k) {
-        return table_[(reinterpret_cast<uintptr_t>(k) >> 3) % table_size];
+        return at(k).vers;
     }
 };
 
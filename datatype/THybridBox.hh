@@ -0,0 +1,201 @@
+#pragma once
+
+#include "Sto.hh"
+#include "MVCC.hh"
+
+// A box that switches between single-version OCC and an MVCC chain at
+// runtime, depending on how it is used.
+//
+// Read-write transactions always go through the OCC version (vers_), like
+// TBox. Read-only transactions read the Sto::read_tid() snapshot without
+// recording anything, like TMvBox. In OCC mode (CCMode::opt) that only
+// works if the box hasn't been written (or locked) since the snapshot;
+// otherwise the reader aborts and the miss is counted. After promote_after misses the
+// next writer promotes the box to CCMode::mvcc: from then on every commit
+// also appends to an MvObject chain, and stale snapshots are served from
+// it. A box that goes demote_after writes without serving a stale snapshot
+// drops back to OCC.
+//
+// Because read-only reads come from the read_tid() snapshot, don't mix
+// THybridBox with single-version objects in one read-only transaction.
+template <typename T>
+class THybridBox : public TObject {
+public:
+    typedef T read_type;
+    typedef TVersion version_type;
+    typedef TransactionTid::type tid_type;
+
+    static constexpr unsigned promote_after = 4;
+    static constexpr unsigned demote_after = 1024;
+
+    THybridBox()
+        : v_(), mv_since_(0), ro_misses_(0), writes_(0), mv_hits_(false) {
+    }
+    template <typename... Args>
+    explicit THybridBox(Args&&... args)
+        : v_(std::forward<Args>(args)...), mv_since_(0), ro_misses_(0),
+          writes_(0), mv_hits_(false) {
+    }
+
+    std::pair<bool, read_type> read_nothrow() const {
+        if (Sto::readonly())
+            return read_snapshot(Sto::read_tid());
+        auto item = Sto::item(this, 0);
+        if (item.has_write())
+            return {true, item.template write_value<T>()};
+        else
+            return v_.read(item, vers_);
+    }
+
+    read_type read() const {
+        auto result = read_nothrow();
+        if (!result.first)
+            throw Transaction::Abort();
+        else
+            return result.second;
+    }
+
+    void write(const T& x) {
+        Sto::item(this, 0).acquire_write(vers_, x);
+    }
+    void write(T&& x) {
+        Sto::item(this, 0).acquire_write(vers_, std::move(x));
+    }
+
+    operator read_type() const {
+        return read();
+    }
+    THybridBox<T>& operator=(const T& x) {
+        write(x);
+        return *this;
+    }
+    THybridBox<T>& operator=(T&& x) {
+        write(std::move(x));
+        return *this;
+    }
+    THybridBox<T>& operator=(const THybridBox<T>& x) {
+        write(x.read());
+        return *this;
+    }
+
+    // Current representation: CCMode::opt or CCMode::mvcc
+    CCMode cc_mode() const {
+        return mv_since_.load(std::memory_order_acquire) ? CCMode::mvcc : CCMode::opt;
+    }
+
+    const T& nontrans_read() const {
+        return v_.access();
+    }
+    void nontrans_write(const T& x) {
+        assert(!mv_since_.load(std::memory_order_relaxed));
+        v_.access() = x;
+    }
+
+    // transactional methods
+    bool lock(TransItem& item, Transaction& txn) override {
+        return txn.try_lock(item, vers_);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        return vers_.cp_check_version(txn, item);
+    }
+    const void* version_address(TransItem&) const override {
+        return &vers_;
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        // We hold the lock, so chain appends are in commit-tid order
+        const T& x = item.template write_value<T>();
+        tid_type since = mv_since_.load(std::memory_order_relaxed);
+        if (!since) {
+            if (ro_misses_.load(std::memory_order_relaxed) >= promote_after) {
+                // seed the chain with the version stale snapshots need
+                since = tid_of(vers_.value());
+                mv_append(since, v_.access());
+                mv_append(txn.commit_tid(), x);
+                reset_stats();
+                mv_since_.store(since | mvcc_bit, std::memory_order_release);
+            }
+        } else {
+            if (++writes_ >= demote_after) {
+                bool hits = mv_hits_.load(std::memory_order_relaxed);
+                reset_stats();
+                if (!hits) {
+                    since = 0;
+                    mv_since_.store(0, std::memory_order_release);
+                }
+            }
+            if (since)
+                mv_append(txn.commit_tid(), x);
+        }
+        v_.write(x);
+        txn.set_version_unlock(vers_, item);
+    }
+    void unlock(TransItem& item) override {
+        vers_.cp_unlock(item);
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        w << "{THybridBox<" << typeid(T).name() << "> " << (void*) this;
+        if (item.has_read())
+            w << " R" << item.read_value<version_type>();
+        if (item.has_write())
+            w << " =" << item.write_value<T>();
+        w << "}";
+    }
+
+protected:
+    typedef MvObject<T> object_type;
+    typedef typename object_type::history_type history_type;
+
+    version_type vers_;
+    TOpaqueWrapped<T> v_;
+    object_type mv_;
+    // commit tid the chain is complete from, | mvcc_bit; 0 in OCC mode
+    std::atomic<tid_type> mv_since_;
+    mutable std::atomic<unsigned> ro_misses_;
+    unsigned writes_;  // under the lock
+    mutable std::atomic<bool> mv_hits_;
+
+    static constexpr tid_type mvcc_bit = 1;
+
+    static tid_type tid_of(tid_type v) {
+        return v & TransactionTid::max_value;
+    }
+
+    std::pair<bool, read_type> read_snapshot(tid_type rtid) const {
+        while (true) {
+            version_type v0 = vers_;
+            fence();
+            if (!v0.is_locked()) {
+                if (tid_of(v0.value()) <= rtid) {
+                    T result = v_.access();
+                    fence();
+                    if (vers_ == v0)
+                        return {true, result};
+                    continue;
+                }
+            }
+            // written (or being written) since the snapshot
+            tid_type since = mv_since_.load(std::memory_order_acquire);
+            if (since && (since & ~mvcc_bit) <= rtid) {
+                if (!mv_hits_.load(std::memory_order_relaxed))
+                    mv_hits_.store(true, std::memory_order_relaxed);
+                return {true, mv_.find(rtid)->v()};
+            }
+            ro_misses_.fetch_add(1, std::memory_order_relaxed);
+            TXP_INCREMENT(txp_observe_lock_aborts);
+            return {false, T()};
+        }
+    }
+
+    void mv_append(tid_type tid, const T& x) {
+        history_type* h = mv_.new_history(tid, x);
+        bool ok = mv_.template cp_lock<false>(tid, h);
+        always_assert(ok, "THybridBox chain append");
+        mv_.cp_install(h);
+    }
+
+    void reset_stats() {
+        ro_misses_.store(0, std::memory_order_relaxed);
+        writes_ = 0;
+        mv_hits_.store(false, std::memory_order_relaxed);
+    }
+};
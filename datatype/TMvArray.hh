@@ -4,7 +4,10 @@
 #include "TArrayProxy.hh"
 #include "MVCC.hh"
 
-template <typename T, unsigned N>
+// With Slots, each element keeps a ring of that many versions inline
+// (MvRingObject), so writes don't allocate; the array must then outlive
+// GC of its versions.
+template <typename T, unsigned N, unsigned Slots = mvcc_ring_slots<T>::value>
 class TMvArray : public TObject {
 public:
     class iterator;
@@ -13,8 +16,8 @@ public:
     typedef T get_type;
     typedef unsigned size_type;
     typedef int difference_type;
-    typedef TConstArrayProxy<TMvArray<T, N> > const_proxy_type;
-    typedef TArrayProxy<TMvArray<T, N> > proxy_type;
+    typedef TConstArrayProxy<TMvArray<T, N, Slots> > const_proxy_type;
+    typedef TArrayProxy<TMvArray<T, N, Slots> > proxy_type;
     typedef typename commutators::Commutator<T> comm_type;
 
     size_type size() const {
@@ -40,6 +43,10 @@ public:
     // transGet and friends
     bool transGet(size_type i, value_type& ret) const {
         assert(i < N);
+        if (Sto::snapshot_isolation()) {
+            ret = snapshot_get(i);
+            return true;
+        }
         auto item = Sto::item(this, i);
         if (item.has_write()) {
             ret = item.template write_value<T>();
@@ -54,6 +61,8 @@ public:
     }
     value_type transGet_throws(size_type i) const {
         assert(i < N);
+        if (Sto::snapshot_isolation())
+            return snapshot_get(i);
         auto item = Sto::item(this, i);
         if (item.has_write()) {
             return item.template write_value<T>();
@@ -149,7 +158,7 @@ public:
     }
 
 private:
-    typedef MvObject<T> object_type;
+    typedef mv_object_t<T, Slots> object_type;
     typedef typename object_type::history_type history_type;
 
     struct elem {
@@ -157,19 +166,27 @@ private:
     };
     elem data_[N];
 
+    // Snapshot-isolation read: no TransItem unless element i was written
+    value_type snapshot_get(size_type i) const {
+        auto item = Sto::check_item(this, i);
+        if (item && item->has_write())
+            return item->template write_value<T>();
+        return data_[i].v.find(Sto::read_tid())->v();
+    }
+
     friend class iterator;
     friend class const_iterator;
 };
 
 
-template <typename T, unsigned N>
-class TMvArray<T, N>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
+template <typename T, unsigned N, unsigned Slots>
+class TMvArray<T, N, Slots>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
 public:
-    typedef TMvArray<T, N> array_type;
+    typedef TMvArray<T, N, Slots> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    const_iterator(const TMvArray<T, N>* a, size_type i)
+    const_iterator(const TMvArray<T, N, Slots>* a, size_type i)
         : a_(const_cast<array_type*>(a)), i_(i) {
     }
 
@@ -241,14 +258,14 @@ protected:
     size_type i_;
 };
 
-template <typename T, unsigned N>
-class TMvArray<T, N>::iterator : public const_iterator {
+template <typename T, unsigned N, unsigned Slots>
+class TMvArray<T, N, Slots>::iterator : public const_iterator {
 public:
-    typedef TMvArray<T, N> array_type;
+    typedef TMvArray<T, N, Slots> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    iterator(const TMvArray<T, N>* a, size_type i)
+    iterator(const TMvArray<T, N, Slots>* a, size_type i)
         : const_iterator(a, i) {
     }
 
@@ -288,32 +305,32 @@ public:
     }
 };
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::begin() -> iterator {
+template <typename T, unsigned N, unsigned Slots>
+inline auto TMvArray<T, N, Slots>::begin() -> iterator {
     return iterator(this, 0);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::end() -> iterator {
+template <typename T, unsigned N, unsigned Slots>
+inline auto TMvArray<T, N, Slots>::end() -> iterator {
     return iterator(this, N);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::cbegin() const -> const_iterator {
+template <typename T, unsigned N, unsigned Slots>
+inline auto TMvArray<T, N, Slots>::cbegin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::cend() const -> const_iterator {
+template <typename T, unsigned N, unsigned Slots>
+inline auto TMvArray<T, N, Slots>::cend() const -> const_iterator {
     return const_iterator(this, N);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::begin() const -> const_iterator {
+template <typename T, unsigned N, unsigned Slots>
+inline auto TMvArray<T, N, Slots>::begin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::end() const -> const_iterator {
+template <typename T, unsigned N, unsigned Slots>
+inline auto TMvArray<T, N, Slots>::end() const -> const_iterator {
     return const_iterator(this, N);
 }
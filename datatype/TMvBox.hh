@@ -5,7 +5,10 @@
 
 class TMvBoxAccess;
 
-template <typename T>
+// With Slots, the box keeps a ring of that many versions inline
+// (MvRingObject), so writes don't allocate; it must then outlive GC of its
+// versions.
+template <typename T, unsigned Slots = mvcc_ring_slots<T>::value>
 class TMvBox : public TObject {
 public:
     typedef T read_type;
@@ -19,6 +22,18 @@ public:
     }
 
     std::pair<bool, read_type> read_nothrow() const {
+        if (Sto::readonly()) {
+            // the read snapshot is stable; nothing to validate
+            history_type *h = v_.find(Sto::read_tid());
+            return {true, h->v()};
+        }
+        if (Sto::snapshot_isolation()) {
+            auto item = Sto::check_item(this, 0);
+            if (item && item->has_write())
+                return {true, item->template write_value<T>()};
+            history_type *h = v_.find(Sto::read_tid());
+            return {true, h->v()};
+        }
         auto item = Sto::item(this, 0);
         if (item.has_write())
             return {true, item.template write_value<T>()};
@@ -51,11 +66,11 @@ public:
     operator read_type() const {
         return read();
     }
-    TMvBox<T>& operator=(const T& x) {
+    TMvBox& operator=(const T& x) {
         write(x);
         return *this;
     }
-    TMvBox<T>& operator=(T&& x) {
+    TMvBox& operator=(T&& x) {
         write(std::move(x));
         return *this;
     }
@@ -64,7 +79,7 @@ public:
     //    write(std::forward<V>(x));
     //    return *this;
     //}
-    TMvBox<T>& operator=(const TMvBox<T>& x) {
+    TMvBox& operator=(const TMvBox& x) {
         write(x.read());
         return *this;
     }
@@ -91,12 +106,18 @@ public:
                 return false;
             }
         }
-        history_type *h;
+        history_type *h = nullptr;
         if (item.has_commute()) {
             auto wval = item.template write_value<comm_type>();
             h = v_.new_history(Sto::commit_tid(), std::move(wval));
         } else {
-            h = v_.new_history(Sto::commit_tid(), item.write_value<T>());
+            if (item.has_read()) {
+                h = v_.new_sparse_history(Sto::commit_tid(), item.read_value<history_type*>(),
+                                          &item.write_value<T>());
+            }
+            if (!h) {
+                h = v_.new_history(Sto::commit_tid(), item.write_value<T>());
+            }
         }
         bool result = v_.cp_lock(Sto::commit_tid(), h);
         if (!result && !h->status_is(MvStatus::ABORTED)) {
@@ -141,7 +162,7 @@ public:
     }
 
 protected:
-    typedef MvObject<T> object_type;
+    typedef mv_object_t<T, Slots> object_type;
     typedef typename object_type::history_type history_type;
 
     object_type v_;
@@ -166,9 +187,13 @@ public:
 // For unit tests to be able to access the underlying MVCC object...
 class TMvBoxAccess {
 public:
-    template <typename T>
-    static MvHistory<T>* head(const TMvBox<T> &box) {
+    template <typename T, unsigned Slots>
+    static MvHistory<T>* head(const TMvBox<T, Slots> &box) {
         auto rtid = Sto::read_tid();
         return box.v_.find(rtid);
     }
+    template <typename T, unsigned Slots>
+    static MvHistory<T>* find(const TMvBox<T, Slots> &box, TransactionTid::type tid) {
+        return box.v_.find(tid);
+    }
 };
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TWrapped.hh"
+
+// A transactional max-priority queue with relaxed ordering (a multiqueue).
+//
+// PriorityQueue keeps one heap, so every pop reads and writes its root and
+// all dequeuers conflict. Here the elements are spread over several
+// sub-queues, each with its own version. A push goes to the pushing
+// thread's home sub-queue. A pop samples two sub-queues at random and
+// takes the larger of their maxima, so pops conflict only when they pick
+// the same sub-queue, and a push conflicts only with pops that read its
+// home sub-queue. The popped element is not necessarily the global
+// maximum, but its expected rank is O(number of sub-queues).
+//
+// A pop that finds both samples empty scans every sub-queue before it
+// reports the queue empty; that emptiness is validated at commit. A
+// transaction's own pushes compete with the shared elements it samples.
+template <typename T, template <typename> class W = TOpaqueWrapped>
+class TRelaxedPriorityQueue : public TObject {
+public:
+    typedef typename W<T>::version_type version_type;
+
+    explicit TRelaxedPriorityQueue(unsigned nqueues = default_nqueues())
+        : qs_(std::max(nqueues, 1u)) {
+    }
+
+    static unsigned default_nqueues() {
+        return 2 * std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    unsigned nqueues() const {
+        return qs_.size();
+    }
+
+    // NONTRANSACTIONAL PUSH/POP/SIZE
+    void nontrans_push(const T& v) {
+        subqueue& q = qs_[home()];
+        TransactionTid::lock(q.mutex);
+        q.elems.insert(v);
+        TransactionTid::unlock(q.mutex);
+    }
+    // Removes the global maximum
+    bool nontrans_pop(T& v) {
+        subqueue* best = nullptr;
+        for (auto& q : qs_)
+            if (!q.elems.empty() && (!best || *best->elems.begin() < *q.elems.begin()))
+                best = &q;
+        if (!best)
+            return false;
+        v = *best->elems.begin();
+        best->elems.erase(best->elems.begin());
+        return true;
+    }
+    size_t nontrans_size() const {
+        size_t n = 0;
+        for (auto& q : qs_)
+            n += q.elems.size();
+        return n;
+    }
+
+    // TRANSACTIONAL CALLS
+    void push(const T& v) {
+        pending(Sto::item(this, home())).pushes.push_back(v);
+    }
+
+    // Removes a high-priority element; false if the queue is empty
+    bool pop() {
+        T v;
+        return pop(v);
+    }
+    bool pop(T& v) {
+        auto& gen = TThread::gen[TThread::id()].gen;
+        unsigned a = gen() % qs_.size(), b = gen() % qs_.size();
+        int best = -1;
+        peek(a, best, v);
+        if (b != a)
+            peek(b, best, v);
+        for (unsigned i = 0; best < 0 && i != qs_.size(); ++i)
+            if (i != a && i != b)
+                peek(i, best, v);
+
+        auto hitem = Sto::item(this, home());
+        if (hitem.has_write()) {
+            auto& pushes = hitem.template write_value<pending_type>().pushes;
+            auto it = std::max_element(pushes.begin(), pushes.end());
+            if (it != pushes.end() && (best < 0 || v < *it)) {
+                v = std::move(*it);
+                *it = std::move(pushes.back());
+                pushes.pop_back();
+                return true;
+            }
+        }
+        if (best < 0)
+            return false;
+        ++pending(Sto::item(this, best)).pops;
+        return true;
+    }
+
+    // transactional methods
+    bool lock(TransItem& item, Transaction& txn) override {
+        return txn.try_lock(item, qs_[item.key<int>()].vers);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        return qs_[item.key<int>()].vers.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        subqueue& q = qs_[item.key<int>()];
+        auto& p = item.template write_value<pending_type>();
+        TransactionTid::lock(q.mutex);
+        auto end = q.elems.begin();
+        std::advance(end, p.pops);
+        q.elems.erase(q.elems.begin(), end);
+        for (auto& v : p.pushes)
+            q.elems.insert(std::move(v));
+        TransactionTid::unlock(q.mutex);
+        txn.set_version_unlock(q.vers, item);
+    }
+    void unlock(TransItem& item) override {
+        qs_[item.key<int>()].vers.cp_unlock(item);
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        w << "{TRelaxedPriorityQueue " << (void*) this << " q" << item.key<int>();
+        if (item.has_read())
+            w << " R" << item.read_value<version_type>();
+        if (item.has_write()) {
+            auto& p = item.template write_value<pending_type>();
+            w << " -" << p.pops << " +" << p.pushes.size();
+        }
+        w << "}";
+    }
+
+private:
+    // A transaction's effect on one sub-queue: remove its `pops` largest
+    // elements, then add `pushes`
+    struct pending_type {
+        unsigned pops = 0;
+        std::vector<T> pushes;
+    };
+
+    struct alignas(128) subqueue {
+        version_type vers;
+        // Guards elems against readers running during an install; the
+        // transactional state is in vers
+        TransactionTid::type mutex = 0;
+        std::multiset<T, std::greater<T>> elems;
+    };
+
+    unsigned home() const {
+        return TThread::id() % qs_.size();
+    }
+
+    static pending_type& pending(TransProxy item) {
+        if (!item.has_write())
+            item.add_write(pending_type());
+        return item.template write_value<pending_type>();
+    }
+
+    // Observes sub-queue i; if its largest element not yet popped by this
+    // transaction beats v, makes i the best candidate
+    void peek(unsigned i, int& best, T& v) {
+        subqueue& q = qs_[i];
+        auto item = Sto::item(this, i);
+        unsigned popped = item.has_write() ? item.template write_value<pending_type>().pops : 0;
+        TransactionTid::lock(q.mutex);
+        if (!item.observe(q.vers)) {
+            TransactionTid::unlock(q.mutex);
+            throw Transaction::Abort();
+        }
+        if (q.elems.size() > popped) {
+            auto it = q.elems.begin();
+            std::advance(it, popped);
+            if (best < 0 || v < *it) {
+                v = *it;
+                best = i;
+            }
+        }
+        TransactionTid::unlock(q.mutex);
+    }
+
+    std::vector<subqueue> qs_;
+};
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include "Sto.hh"
+#include "TWrapped.hh"
+
+// A transactional FIFO queue that scales where Queue serializes everything
+// on its head and tail versions.
+//
+// Elements live in a linked list of fixed-size segments. Each slot has its
+// own version and moves from empty to full (pushed) to taken (popped).
+// Pushes only write: a transaction's pushes are appended at commit, under
+// a short lock on the tail version, and never abort each other. A pop
+// claims the first full slot optimistically; at commit it locks just that
+// slot, so pops conflict only when they claim the same element, and never
+// conflict with pushes. The tail version is read only by a pop or front
+// that finds the queue empty, since emptiness is invalidated by any push.
+//
+// Pops and fronts see the transaction's own pushes once the shared queue
+// is empty, as Queue does. Segments are freed through RCU once every slot
+// in them is taken.
+template <typename T, unsigned SegmentSize = 1024,
+          template <typename> class W = TOpaqueWrapped>
+class TSegmentedQueue : public TObject {
+public:
+    typedef typename W<T>::version_type version_type;
+
+    static constexpr TransItem::flags_type pop_bit = TransItem::user0_bit;
+
+    TSegmentedQueue()
+        : head_(0), tail_(0) {
+        segment* seg = new segment(0);
+        head_seg_.store(seg, std::memory_order_relaxed);
+        tail_seg_ = seg;
+    }
+    ~TSegmentedQueue() {
+        segment* seg = head_seg_.load(std::memory_order_relaxed);
+        while (seg) {
+            segment* next = seg->next.load(std::memory_order_relaxed);
+            delete seg;
+            seg = next;
+        }
+    }
+
+    // NONTRANSACTIONAL PUSH/POP/EMPTY
+    void nontrans_push(const T& v) {
+        append(v);
+    }
+    bool nontrans_pop(T& v) {
+        slot* s = first_slot();
+        if (!s)
+            return false;
+        v = s->value;
+        s->state.store(taken, std::memory_order_release);
+        advance_head();
+        return true;
+    }
+    bool nontrans_empty() const {
+        return !first_slot();
+    }
+    // Elements not yet popped
+    size_t nontrans_size() const {
+        size_t n = 0;
+        for_each_slot([&] (slot& s) {
+            n += s.state.load(std::memory_order_relaxed) == full;
+            return true;
+        });
+        return n;
+    }
+
+    // TRANSACTIONAL CALLS
+    void push(const T& v) {
+        auto item = Sto::item(this, tail_key);
+        if (item.has_write())
+            item.template write_value<pending_type>().push_back(v);
+        else
+            item.add_write(pending_type{v});
+    }
+
+    // Removes the front element; false if the queue is empty
+    bool pop() {
+        T v;
+        return pop(v);
+    }
+    bool pop(T& v) {
+        while (true) {
+            slot* s = first_slot();
+            if (!s)
+                return pop_own(v);
+            if (observe_slot(s)) {
+                v = s->value;
+                Sto::item(this, s).add_write().add_flags(pop_bit);
+                return true;
+            }
+        }
+    }
+
+    // Reads the front element; false if the queue is empty
+    bool front(T& v) {
+        slot* s;
+        do {
+            s = first_slot();
+        } while (s && !observe_slot(s));
+        if (!s) {
+            observe_empty();
+            auto titem = Sto::item(this, tail_key);
+            if (titem.has_write() && !titem.template write_value<pending_type>().empty()) {
+                v = titem.template write_value<pending_type>().front();
+                return true;
+            }
+            return false;
+        }
+        v = s->value;
+        return true;
+    }
+
+    // transactional methods
+    bool lock(TransItem& item, Transaction& txn) override {
+        if (is_tail(item))
+            return txn.try_lock(item, tailversion_);
+        return txn.try_lock(item, item.key<slot*>()->vers);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        if (is_tail(item))
+            return tailversion_.cp_check_version(txn, item);
+        return item.key<slot*>()->vers.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        if (is_tail(item)) {
+            for (auto& v : item.template write_value<pending_type>())
+                append(v);
+            txn.set_version_unlock(tailversion_, item);
+        } else {
+            slot* s = item.key<slot*>();
+            s->state.store(taken, std::memory_order_release);
+            txn.set_version_unlock(s->vers, item);
+            advance_head();
+        }
+    }
+    void unlock(TransItem& item) override {
+        if (is_tail(item))
+            tailversion_.cp_unlock(item);
+        else
+            item.key<slot*>()->vers.cp_unlock(item);
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        w << "{TSegmentedQueue " << (void*) this;
+        if (is_tail(item)) {
+            w << " tail";
+            if (item.has_write())
+                w << " +" << item.template write_value<pending_type>().size();
+        } else
+            w << " slot " << (void*) item.key<slot*>() << (item.has_flag(pop_bit) ? " pop" : "");
+        if (item.has_read())
+            w << " R" << item.read_value<version_type>();
+        w << "}";
+    }
+
+private:
+    typedef std::deque<T> pending_type;
+
+    enum : uint8_t { empty = 0, full = 1, taken = 2 };
+
+    struct slot {
+        version_type vers;
+        std::atomic<uint8_t> state;
+        T value;
+
+        slot()
+            : state(empty) {
+        }
+    };
+    struct segment {
+        uint64_t base;   // queue index of slots[0]
+        std::atomic<segment*> next;
+        slot slots[SegmentSize];
+
+        explicit segment(uint64_t b)
+            : base(b), next(nullptr) {
+        }
+    };
+
+    static constexpr slot* tail_key = nullptr;
+
+    static bool is_tail(const TransItem& item) {
+        return item.key<slot*>() == tail_key;
+    }
+
+    // Calls f on each slot from the head hint on until f returns false or
+    // an empty slot ends the queue
+    template <typename F>
+    void for_each_slot(F f) const {
+        segment* seg = head_seg_.load(std::memory_order_acquire);
+        uint64_t i = std::max(head_.load(std::memory_order_acquire), seg->base);
+        while (true) {
+            if (i >= seg->base + SegmentSize) {
+                seg = seg->next.load(std::memory_order_acquire);
+                continue;
+            }
+            slot& s = seg->slots[i - seg->base];
+            if (s.state.load(std::memory_order_acquire) == empty || !f(s))
+                return;
+            ++i;
+        }
+    }
+
+    // First full slot this transaction hasn't popped, or null
+    slot* first_slot() const {
+        slot* found = nullptr;
+        bool in_txn = Sto::in_progress();
+        for_each_slot([&] (slot& s) {
+            if (s.state.load(std::memory_order_acquire) != full)
+                return true;
+            if (in_txn) {
+                auto item = Sto::check_item(this, &s);
+                if (item && (*item).has_flag(pop_bit))
+                    return true;
+            }
+            found = &s;
+            return false;
+        });
+        return found;
+    }
+
+    // Observes a full slot; false if a concurrent pop took it first
+    bool observe_slot(slot* s) {
+        // a pop committing on this slot holds its lock only briefly, and
+        // skipping ahead of it would break FIFO order if it aborted
+        while (s->vers.is_locked_elsewhere())
+            relax_fence();
+        if (s->state.load(std::memory_order_acquire) != full)
+            return false;
+        auto item = Sto::item(this, s);
+        if (!item.observe(s->vers))
+            throw Transaction::Abort();
+        // taken between the state check and the observation
+        if (s->state.load(std::memory_order_acquire) != full)
+            throw Transaction::Abort();
+        return true;
+    }
+
+    // Emptiness holds until some push commits
+    void observe_empty() {
+        auto titem = Sto::item(this, tail_key);
+        if (!titem.observe(tailversion_))
+            throw Transaction::Abort();
+        // a push that installed between our scan and the observation
+        if (first_slot())
+            throw Transaction::Abort();
+    }
+
+    // The shared queue is empty: pop from this transaction's own pushes
+    bool pop_own(T& v) {
+        observe_empty();
+        auto titem = Sto::item(this, tail_key);
+        if (!titem.has_write())
+            return false;
+        auto& pending = titem.template write_value<pending_type>();
+        if (pending.empty())
+            return false;
+        v = std::move(pending.front());
+        pending.pop_front();
+        return true;
+    }
+
+    // Called with the tail locked (or nontransactionally)
+    void append(const T& v) {
+        segment* seg = tail_seg_;
+        slot& s = seg->slots[tail_ - seg->base];
+        s.value = v;
+        ++tail_;
+        // link the next segment before the last slot can be popped, so a
+        // head past this segment always has somewhere to go
+        if (tail_ == seg->base + SegmentSize) {
+            tail_seg_ = new segment(tail_);
+            seg->next.store(tail_seg_, std::memory_order_release);
+        }
+        s.state.store(full, std::memory_order_release);
+    }
+
+    // Moves the head hint past taken slots, retiring the segments it leaves
+    void advance_head() {
+        segment* seg = head_seg_.load(std::memory_order_acquire);
+        uint64_t h = head_.load(std::memory_order_acquire);
+        while (true) {
+            if (h >= seg->base + SegmentSize) {
+                segment* next = seg->next.load(std::memory_order_acquire);
+                if (head_seg_.compare_exchange_strong(seg, next, std::memory_order_acq_rel)) {
+                    if (Sto::in_progress())
+                        Transaction::rcu_delete(seg);
+                    else
+                        delete seg;
+                    seg = next;
+                }
+                continue;
+            }
+            if (h < seg->base)
+                h = seg->base;
+            slot& s = seg->slots[h - seg->base];
+            if (s.state.load(std::memory_order_acquire) != taken)
+                return;
+            if (head_.compare_exchange_weak(h, h + 1, std::memory_order_acq_rel))
+                ++h;
+        }
+    }
+
+    std::atomic<uint64_t> head_;          // hint: slots before it are taken
+    std::atomic<segment*> head_seg_;
+    uint64_t tail_;                       // protected by tailversion_
+    segment* tail_seg_;
+    version_type tailversion_;
+};
@@ -0,0 +1,663 @@
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <optional>
+#include "Sto.hh"
+#include "TWrapped.hh"
+
+template <typename K, typename T, bool GlobalSize, typename Compare> class TSkipListIterator;
+template <typename K, typename T, bool GlobalSize, typename Compare> class TSkipListProxy;
+
+// A transactional ordered map, implemented as a skiplist.
+//
+// RBTree serializes structural changes under one tree lock, and its
+// rebalancing touches nodes far from the changed key, so inserts into
+// unrelated key ranges conflict. A skiplist needs no rebalancing. This is
+// a lazy skiplist (Herlihy et al.): traversals take no locks, and a
+// structural change locks only the predecessors of the node it links or
+// unlinks.
+//
+// Every node has two versions. The value version protects the node's value
+// and its existence; it carries insert_bit while the node is a phantom,
+// linked by a transaction that has not yet committed. The node version
+// protects the gap between the node and its level-0 successor, and is
+// bumped whenever that successor changes. An absent lookup observes the
+// node version of its level-0 predecessor, so it conflicts only with
+// inserts into that gap. An insert links its phantom right away and reads
+// no gap, so inserts of different keys never conflict. Erased nodes stay
+// linked until the erasing transaction commits, then are unlinked and
+// freed through RCU.
+//
+// With GlobalSize, size() is tracked as in RBTree: inserts and erases add
+// blind deltas to one size item, which size() observes.
+template <typename K, typename T, bool GlobalSize = false, typename Compare = std::less<K>>
+class TSkipList : public TObject {
+    friend class TSkipListIterator<K, T, GlobalSize, Compare>;
+    friend class TSkipListProxy<K, T, GlobalSize, Compare>;
+
+public:
+    typedef TWrapped<T> wrapped_type;
+    typedef typename wrapped_type::version_type version_type;
+    typedef TSkipListIterator<K, T, GlobalSize, Compare> iterator;
+    typedef TSkipListProxy<K, T, GlobalSize, Compare> proxy_type;
+
+    static constexpr int max_height = 24;
+    static constexpr TransactionTid::type insert_bit = TransactionTid::user_bit;
+    static constexpr TransItem::flags_type insert_tag = TransItem::user0_bit;
+    static constexpr TransItem::flags_type delete_tag = TransItem::user0_bit << 1;
+
+    explicit TSkipList(Compare comp = Compare())
+        : head_(make_node(K(), max_height, version_type())), size_(0), comp_(comp) {
+        head_->fully_linked = true;
+    }
+    ~TSkipList() {
+        node* n = head_;
+        while (n) {
+            node* next = n->next[0];
+            free_node(n);
+            n = next;
+        }
+    }
+    TSkipList(const TSkipList&) = delete;
+    TSkipList& operator=(const TSkipList&) = delete;
+
+    // capacity
+    size_t size() const {
+        always_assert(GlobalSize);
+        auto size_item = Sto::item(const_cast<TSkipList*>(this), size_key);
+        if (!size_item.has_read() && !size_item.observe(sizeversion_))
+            throw Transaction::Abort();
+        ssize_t offset = size_item.has_write() ? size_item.template write_value<ssize_t>() : 0;
+        return size_ + offset;
+    }
+
+    // lookup
+    size_t count(const K& key) const {
+        return lookup(key) != nullptr;
+    }
+    iterator find(const K& key) {
+        return iterator(this, lookup(key));
+    }
+    iterator begin() {
+        return iterator(this, next_present(head_));
+    }
+    iterator end() {
+        return iterator(this, nullptr);
+    }
+    // The first element whose key is not less than key
+    iterator lower_bound(const K& key) {
+        node* preds[max_height];
+        node* succs[max_height];
+        find_position(key, preds, succs);
+        node* n = preds[0];
+        while (n->marked) {
+            relax_fence();
+            find_position(key, preds, succs);
+            n = preds[0];
+        }
+        do {
+            n = next_present(n);
+        } while (n && comp_(n->key, key));
+        return iterator(this, n);
+    }
+
+    // element access
+    proxy_type operator[](const K& key) {
+        return proxy_type(*this, find_or_insert(key).first);
+    }
+
+    // modifiers
+    // Inserts (key, value) if key is absent; returns true if it inserted
+    bool insert(const K& key, const T& value) {
+        auto r = find_or_insert(key);
+        auto item = Sto::item(this, r.first);
+        if (r.second)
+            item.add_write(value);
+        else if (!item.has_write() && !item.observe(r.first->vers))
+            throw Transaction::Abort();
+        return r.second;
+    }
+    size_t erase(const K& key);
+
+    // nontransactional methods; not safe to run concurrently with
+    // transactions on the same list
+    bool nontrans_insert(const K& key, const T& value);
+    bool nontrans_contains(const K& key) const {
+        return nontrans_lookup(key) != nullptr;
+    }
+    bool nontrans_find(const K& key, T& value) const {
+        node* n = nontrans_lookup(key);
+        if (n)
+            value = n->value.access();
+        return n != nullptr;
+    }
+    bool nontrans_remove(const K& key);
+    size_t nontrans_size() const {
+        size_t n = 0;
+        for (node* x = head_->next[0]; x; x = x->next[0])
+            ++n;
+        return n;
+    }
+
+    // transactional methods
+    bool lock(TransItem& item, Transaction& txn) override {
+        if (item.key<uintptr_t>() == size_key)
+            return txn.try_lock(item, sizeversion_);
+        node* n = item.key<node*>();
+        // A blind write loses to a committed erase
+        return txn.try_lock(item, n->vers) && !n->deleted;
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        uintptr_t key = item.key<uintptr_t>();
+        if (key == size_key)
+            return sizeversion_.cp_check_version(txn, item);
+        else if (key & gap_bit)
+            return reinterpret_cast<node*>(key - gap_bit)->nodevers.cp_check_version(txn, item);
+        else
+            return item.key<node*>()->vers.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        if (item.key<uintptr_t>() == size_key) {
+            size_ += item.template write_value<ssize_t>();
+            txn.set_version_unlock(sizeversion_, item);
+            return;
+        }
+        node* n = item.key<node*>();
+        if (has_delete(item)) {
+            // stays locked; cleanup unlinks it
+            n->deleted = true;
+            release_fence();
+            txn.set_version(n->vers);
+            return;
+        }
+        n->value.write(item.template write_value<T>());
+        txn.set_version_unlock(n->vers, item);
+    }
+    void unlock(TransItem& item) override {
+        if (item.key<uintptr_t>() == size_key)
+            sizeversion_.cp_unlock(item);
+        else
+            item.key<node*>()->vers.cp_unlock(item);
+    }
+    void cleanup(TransItem& item, bool committed) override {
+        if (item.key<uintptr_t>() == size_key)
+            return;
+        if (committed ? has_delete(item) : has_insert(item)) {
+            node* n = item.key<node*>();
+            unlink(n);
+            item.clear_needs_unlock();
+            Transaction::rcu_call(free_node, n);
+        }
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        uintptr_t key = item.key<uintptr_t>();
+        w << "{TSkipList " << (void*) this;
+        if (key == size_key)
+            w << " size";
+        else if (key & gap_bit)
+            w << " gap " << (void*) (key - gap_bit);
+        else {
+            node* n = item.key<node*>();
+            w << " " << (void*) n << ".v" << n->vers.value();
+            if (has_insert(item))
+                w << " I";
+            if (has_delete(item))
+                w << " D";
+        }
+        if (item.has_read())
+            w << " R" << item.read_value<version_type>();
+        w << "}";
+    }
+
+private:
+    struct node {
+        K key;
+        wrapped_type value;
+        // value and existence; insert_bit while a phantom
+        version_type vers;
+        // the gap to next[0]; locked by structural changes
+        version_type nodevers;
+        bool fully_linked;
+        bool marked;
+        bool deleted;
+        int height;
+        node* next[1];
+
+        node(const K& k, int h, version_type v)
+            : key(k), value(), vers(v), nodevers(), fully_linked(false),
+              marked(false), deleted(false), height(h) {
+            for (int i = 0; i != h; ++i)
+                next[i] = nullptr;
+        }
+    };
+
+    // Item keys: a node, a node's gap (node | gap_bit), or the size
+    static constexpr uintptr_t gap_bit = 1;
+    static constexpr uintptr_t size_key = 2;
+
+    node* head_;
+    size_t size_;
+    mutable version_type sizeversion_;
+    Compare comp_;
+
+    static node* make_node(const K& key, int height, version_type v) {
+        void* p = ::malloc(sizeof(node) + (height - 1) * sizeof(node*));
+        return new (p) node(key, height, v);
+    }
+    static void free_node(void* p) {
+        reinterpret_cast<node*>(p)->~node();
+        ::free(p);
+    }
+    static int random_height() {
+        uint32_t r = TThread::gen[TThread::id()].gen();
+        return 1 + __builtin_ctz(r | (1U << (max_height - 1)));
+    }
+
+    static bool has_insert(const TransItem& item) {
+        return item.flags() & insert_tag;
+    }
+    static bool has_delete(const TransItem& item) {
+        return item.flags() & delete_tag;
+    }
+    static bool is_phantom(node* n, const TransItem& item) {
+        return (n->vers.value() & insert_bit) && !has_insert(item);
+    }
+    // A node that is still being linked, or is being (or is about to be)
+    // unlinked; lookups wait for it to settle
+    static bool is_unsettled(node* n) {
+        bool result = !n->fully_linked || n->marked || n->deleted;
+        acquire_fence();
+        return result;
+    }
+
+    // Fills preds and succs with the neighbors of key at every level;
+    // returns the highest level at which key was found, or -1
+    int find_position(const K& key, node** preds, node** succs) const {
+        int found = -1;
+        node* pred = head_;
+        for (int level = max_height - 1; level >= 0; --level) {
+            node* curr = pred->next[level];
+            acquire_fence();
+            while (curr && comp_(curr->key, key)) {
+                pred = curr;
+                curr = pred->next[level];
+                acquire_fence();
+            }
+            if (found < 0 && curr && !comp_(key, curr->key))
+                found = level;
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return found;
+    }
+
+    static version_type stable_nodeversion(node* n) {
+        while (true) {
+            version_type v = n->nodevers;
+            if (!v.is_locked()) {
+                acquire_fence();
+                return v;
+            }
+            relax_fence();
+        }
+    }
+
+    // Observes that nothing lies between pred and succ; false if they are
+    // no longer adjacent
+    bool observe_gap(node* pred, node* succ) const {
+        version_type v = stable_nodeversion(pred);
+        if (pred->marked || pred->next[0] != succ)
+            return false;
+        auto item = Sto::item(const_cast<TSkipList*>(this), reinterpret_cast<uintptr_t>(pred) | gap_bit);
+        if (!item.observe(v))
+            throw Transaction::Abort();
+        return true;
+    }
+
+    // Returns the node for key, observing it, or nullptr, observing its
+    // absence. Aborts on another transaction's phantom.
+    node* lookup(const K& key) const {
+        node* preds[max_height];
+        node* succs[max_height];
+        while (true) {
+            int level = find_position(key, preds, succs);
+            if (level < 0) {
+                if (observe_gap(preds[0], succs[0]))
+                    return nullptr;
+            } else {
+                node* n = succs[level];
+                if (!is_unsettled(n)) {
+                    auto item = Sto::item(const_cast<TSkipList*>(this), n);
+                    if (is_phantom(n, item))
+                        throw Transaction::Abort();
+                    if (has_delete(item))
+                        return nullptr;
+                    if (!has_insert(item) && !item.observe(n->vers))
+                        throw Transaction::Abort();
+                    if (n->deleted)
+                        throw Transaction::Abort();
+                    return n;
+                }
+            }
+            relax_fence();
+        }
+    }
+
+    // The first node after n visible to this transaction, observing every
+    // gap on the way
+    node* next_present(node* n) const {
+        while (true) {
+            version_type v = stable_nodeversion(n);
+            node* next = n->next[0];
+            acquire_fence();
+            if (n->marked)
+                throw Transaction::Abort();
+            auto gap_item = Sto::item(const_cast<TSkipList*>(this), reinterpret_cast<uintptr_t>(n) | gap_bit);
+            if (!gap_item.observe(v))
+                throw Transaction::Abort();
+            if (!next)
+                return nullptr;
+            if (is_unsettled(next)) {
+                relax_fence();
+                continue;
+            }
+            auto item = Sto::item(const_cast<TSkipList*>(this), next);
+            if (is_phantom(next, item))
+                throw Transaction::Abort();
+            if (!has_delete(item)) {
+                if (!has_insert(item) && !item.observe(next->vers))
+                    throw Transaction::Abort();
+                if (next->deleted)
+                    throw Transaction::Abort();
+                return next;
+            }
+            n = next;
+        }
+    }
+
+    // Locks the distinct predecessors at levels [0, height) and checks that
+    // each still links to its successor. On return, levels [0, locked) are
+    // locked, whether or not the check passed.
+    static bool lock_preds(node** preds, node** succs, int height, bool inserting, int& locked) {
+        locked = 0;
+        for (int level = 0; level != height; ++level) {
+            node* pred = preds[level];
+            if (level == 0 || pred != preds[level - 1])
+                pred->nodevers.lock_exclusive();
+            locked = level + 1;
+            node* succ = succs[level];
+            if (pred->marked || pred->next[level] != succ
+                || (inserting && succ && succ->marked))
+                return false;
+        }
+        return true;
+    }
+    static void unlock_preds(node** preds, int locked) {
+        for (int level = 0; level != locked; ++level)
+            if (level == 0 || preds[level] != preds[level - 1])
+                preds[level]->nodevers.unlock_exclusive();
+    }
+
+    // Links a new node for key between preds and succs. Returns nullptr if
+    // they changed. gapv gets the level-0 predecessor's node version before
+    // and after.
+    node* link(const K& key, node** preds, node** succs, version_type vers, version_type* gapv) {
+        int height = random_height();
+        int locked;
+        if (!lock_preds(preds, succs, height, true, locked)) {
+            unlock_preds(preds, locked);
+            return nullptr;
+        }
+        node* n = make_node(key, height, vers);
+        for (int level = 0; level != height; ++level)
+            n->next[level] = succs[level];
+        release_fence();
+        for (int level = 0; level != height; ++level)
+            preds[level]->next[level] = n;
+        gapv[0] = version_type(preds[0]->nodevers.unlocked_value());
+        preds[0]->nodevers.inc_nonopaque();
+        gapv[1] = version_type(preds[0]->nodevers.unlocked_value());
+        n->fully_linked = true;
+        unlock_preds(preds, locked);
+        return n;
+    }
+
+    // Unlinks n, which no other thread may unlink
+    void unlink(node* n) {
+        node* preds[max_height];
+        node* succs[max_height];
+        n->nodevers.lock_exclusive();
+        n->marked = true;
+        fence();
+        while (true) {
+            find_position(n->key, preds, succs);
+            int locked;
+            if (lock_preds(preds, succs, n->height, false, locked)) {
+                for (int level = n->height - 1; level >= 0; --level)
+                    preds[level]->next[level] = n->next[level];
+                preds[0]->nodevers.inc_nonopaque();
+                // gap readers of n must see the change too
+                n->nodevers.inc_nonopaque();
+                unlock_preds(preds, locked);
+                n->nodevers.unlock_exclusive();
+                return;
+            }
+            unlock_preds(preds, locked);
+            relax_fence();
+        }
+    }
+
+    // increment or decrement the offset size of the transaction's list
+    void change_size_offset(ssize_t delta) {
+        if (!GlobalSize)
+            return;
+        auto size_item = Sto::item(this, size_key);
+        ssize_t prev_offset = size_item.has_write() ? size_item.template write_value<ssize_t>() : 0;
+        size_item.add_write(prev_offset + delta);
+    }
+
+    // Returns the node for key and whether this call made key present. A
+    // new node is a phantom written by this transaction with value T().
+    std::pair<node*, bool> find_or_insert(const K& key) {
+        node* preds[max_height];
+        node* succs[max_height];
+        while (true) {
+            int level = find_position(key, preds, succs);
+            if (level >= 0) {
+                node* n = succs[level];
+                if (is_unsettled(n)) {
+                    relax_fence();
+                    continue;
+                }
+                auto item = Sto::item(this, n);
+                if (is_phantom(n, item))
+                    throw Transaction::Abort();
+                if (!has_delete(item))
+                    return {n, false};
+                // re-inserting a key this transaction erased
+                item.clear_flags(delete_tag).clear_write().add_write(T());
+                change_size_offset(1);
+                return {n, true};
+            }
+            version_type gapv[2];
+            node* n = link(key, preds, succs, version_type(Sto::initialized_tid() | insert_bit), gapv);
+            if (!n)
+                continue;
+            auto gap_item = Sto::item(this, reinterpret_cast<uintptr_t>(preds[0]) | gap_bit);
+            if (gap_item.has_read())
+                gap_item.update_read(gapv[0], gapv[1]);
+            Sto::item(this, n).add_write(T()).add_flags(insert_tag);
+            change_size_offset(1);
+            return {n, true};
+        }
+    }
+
+    node* nontrans_lookup(const K& key) const {
+        node* preds[max_height];
+        node* succs[max_height];
+        int level = find_position(key, preds, succs);
+        return level >= 0 ? succs[level] : nullptr;
+    }
+};
+
+template <typename K, typename T, bool GlobalSize, typename Compare>
+size_t TSkipList<K, T, GlobalSize, Compare>::erase(const K& key) {
+    node* preds[max_height];
+    node* succs[max_height];
+    while (true) {
+        int level = find_position(key, preds, succs);
+        if (level < 0) {
+            if (observe_gap(preds[0], succs[0]))
+                return 0;
+            relax_fence();
+            continue;
+        }
+        node* n = succs[level];
+        if (is_unsettled(n)) {
+            relax_fence();
+            continue;
+        }
+        auto item = Sto::item(this, n);
+        if (is_phantom(n, item))
+            throw Transaction::Abort();
+        if (has_delete(item))
+            return 0;
+        // an erased insert stays a phantom until commit, when cleanup
+        // unlinks it
+        if (!has_insert(item)) {
+            if (!item.observe(n->vers) || n->deleted)
+                throw Transaction::Abort();
+            item.add_write();
+        }
+        item.add_flags(delete_tag);
+        change_size_offset(-1);
+        return 1;
+    }
+}
+
+template <typename K, typename T, bool GlobalSize, typename Compare>
+bool TSkipList<K, T, GlobalSize, Compare>::nontrans_insert(const K& key, const T& value) {
+    node* preds[max_height];
+    node* succs[max_height];
+    while (true) {
+        int level = find_position(key, preds, succs);
+        if (level >= 0)
+            return false;
+        version_type gapv[2];
+        node* n = link(key, preds, succs, version_type(Sto::initialized_tid()), gapv);
+        if (n) {
+            n->value.access() = value;
+            ++size_;
+            return true;
+        }
+    }
+}
+
+template <typename K, typename T, bool GlobalSize, typename Compare>
+bool TSkipList<K, T, GlobalSize, Compare>::nontrans_remove(const K& key) {
+    node* n = nontrans_lookup(key);
+    if (!n)
+        return false;
+    unlink(n);
+    free_node(n);
+    --size_;
+    return true;
+}
+
+// Forward iterator over a TSkipList. Dereferencing yields a pair of the
+// key and a proxy for the value. Stepping observes the gaps passed over,
+// so a scan conflicts with inserts into the range it covered.
+template <typename K, typename T, bool GlobalSize, typename Compare>
+class TSkipListIterator {
+public:
+    typedef TSkipList<K, T, GlobalSize, Compare> list_type;
+    typedef typename list_type::node node_type;
+    typedef TSkipListProxy<K, T, GlobalSize, Compare> proxy_type;
+    typedef std::pair<const K, proxy_type> proxy_pair_type;
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef proxy_pair_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef proxy_pair_type* pointer;
+    typedef proxy_pair_type& reference;
+
+    TSkipListIterator(const list_type* list, node_type* n)
+        : list_(const_cast<list_type*>(list)), node_(n) {
+    }
+    TSkipListIterator(const TSkipListIterator& x)
+        : list_(x.list_), node_(x.node_) {
+    }
+    TSkipListIterator& operator=(const TSkipListIterator& x) {
+        list_ = x.list_;
+        node_ = x.node_;
+        pair_.reset();
+        return *this;
+    }
+
+    bool operator==(const TSkipListIterator& x) const {
+        return list_ == x.list_ && node_ == x.node_;
+    }
+    bool operator!=(const TSkipListIterator& x) const {
+        return !(*this == x);
+    }
+
+    proxy_pair_type& operator*() {
+        if (!pair_)
+            pair_.emplace(node_->key, proxy_type(*list_, node_));
+        return *pair_;
+    }
+    proxy_pair_type* operator->() {
+        return &**this;
+    }
+
+    TSkipListIterator& operator++() {
+        node_ = list_->next_present(node_);
+        pair_.reset();
+        return *this;
+    }
+    TSkipListIterator operator++(int) {
+        TSkipListIterator clone(*this);
+        ++*this;
+        return clone;
+    }
+
+private:
+    list_type* list_;
+    node_type* node_;
+    std::optional<proxy_pair_type> pair_;
+};
+
+// Returned by TSkipList::operator[] and iterators; separates reads of the
+// value from writes
+template <typename K, typename T, bool GlobalSize, typename Compare>
+class TSkipListProxy {
+public:
+    typedef TSkipList<K, T, GlobalSize, Compare> list_type;
+    typedef typename list_type::node node_type;
+
+    TSkipListProxy(list_type& list, node_type* n)
+        : list_(list), node_(n) {
+    }
+
+    operator T() const {
+        auto item = Sto::item(&list_, node_);
+        if (item.has_write())
+            return item.template write_value<T>();
+        auto result = node_->value.read(item, node_->vers);
+        if (!result.first)
+            throw Transaction::Abort();
+        return result.second;
+    }
+    TSkipListProxy& operator=(const T& value) {
+        Sto::item(&list_, node_).add_write(value);
+        return *this;
+    }
+    TSkipListProxy& operator=(const TSkipListProxy& x) {
+        return *this = x.operator T();
+    }
+
+private:
+    list_type& list_;
+    node_type* node_;
+};
@@ -0,0 +1,156 @@
+#pragma once
+#include "Sto.hh"
+#include "TWrapped.hh"
+
+// A transactional counter for write-heavy use.
+//
+// TCounter installs every increment into one value under one version, so
+// concurrent incrementers serialize on a single cache line at commit.
+// TStripedCounter splits the value over NStripes padded stripes, each with
+// its own version; the counter's value is their sum. An increment is a
+// blind delta on the committing thread's stripe, so increments from
+// threads on different stripes share nothing. A read sums every stripe
+// and observes every stripe's version, so it conflicts with any
+// concurrent increment; reads cost O(NStripes) and should be rare.
+// Comparisons read the whole value (there are no predicates as in
+// TCounter).
+template <typename T, typename W = TWrapped<T>, unsigned NStripes = 16>
+class TStripedCounter : public TObject {
+public:
+    typedef typename W::version_type version_type;
+    static constexpr TransItem::flags_type delta_bit = TransItem::user0_bit;
+    static constexpr TransItem::flags_type assigned_bit = TransItem::user0_bit << 1;
+
+    TStripedCounter() {
+    }
+    explicit TStripedCounter(T x) {
+        nontrans_write(x);
+    }
+
+    operator T() const {
+        T result = T();
+        for (unsigned i = 0; i != NStripes; ++i) {
+            auto item = Sto::item(this, i);
+            if (!item.has_flag(assigned_bit)) {
+                auto r = stripes_[i].v.read(item, stripes_[i].vers);
+                if (!r.first)
+                    throw Transaction::Abort();
+                result += r.second;
+            }
+            if (item.has_write())
+                result += item.template write_value<T>();
+        }
+        return result;
+    }
+
+    // Assigning writes every stripe
+    TStripedCounter<T, W, NStripes>& operator=(T x) {
+        unsigned h = home();
+        for (unsigned i = 0; i != NStripes; ++i)
+            Sto::item(this, i).add_write(i == h ? x : T()).assign_flags(assigned_bit);
+        return *this;
+    }
+    TStripedCounter<T, W, NStripes>& operator=(const TStripedCounter<T, W, NStripes>& x) {
+        return *this = x.operator T();
+    }
+
+    T nontrans_read() const {
+        T result = T();
+        for (auto& s : stripes_)
+            result += s.v.access();
+        return result;
+    }
+    void nontrans_write(T x) {
+        for (auto& s : stripes_)
+            s.v.access() = T();
+        stripes_[0].v.access() = x;
+    }
+
+    bool operator==(T x) const {
+        return this->operator T() == x;
+    }
+    bool operator!=(T x) const {
+        return this->operator T() != x;
+    }
+    bool operator<(T x) const {
+        return this->operator T() < x;
+    }
+    bool operator<=(T x) const {
+        return this->operator T() <= x;
+    }
+    bool operator>=(T x) const {
+        return this->operator T() >= x;
+    }
+    bool operator>(T x) const {
+        return this->operator T() > x;
+    }
+
+    TStripedCounter<T, W, NStripes>& operator+=(T delta) {
+        auto item = Sto::item(this, home());
+        item.add_write(item.template write_value<T>(T()) + delta);
+        if (!item.has_flag(assigned_bit))
+            item.add_flags(delta_bit);
+        return *this;
+    }
+    TStripedCounter<T, W, NStripes>& operator-=(T delta) {
+        return *this += -delta;
+    }
+    TStripedCounter<T, W, NStripes>& operator++() {
+        return *this += 1;
+    }
+    void operator++(int) {
+        *this += 1;
+    }
+    TStripedCounter<T, W, NStripes>& operator--() {
+        return *this -= 1;
+    }
+    void operator--(int) {
+        *this -= 1;
+    }
+
+    // transactional methods
+    bool lock(TransItem& item, Transaction& txn) override {
+        return txn.try_lock(item, stripe(item).vers);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        return stripe(item).vers.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        stripe_type& s = stripe(item);
+        T result = item.template write_value<T>();
+        if (item.has_flag(delta_bit))
+            result += s.v.access();
+        s.v.write(result);
+        txn.set_version_unlock(s.vers, item);
+    }
+    void unlock(TransItem& item) override {
+        stripe(item).vers.cp_unlock(item);
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        const stripe_type& s = stripes_[item.key<unsigned>()];
+        w << "{StripedCounter " << (void*) this << "[" << item.key<unsigned>()
+          << "]=" << s.v.access() << ".v" << s.vers.value();
+        if (item.has_read())
+            w << " R" << item.read_value<version_type>();
+        if (item.has_write() && item.has_flag(delta_bit))
+            w << " Δ" << item.template write_value<T>();
+        else if (item.has_write())
+            w << " =" << item.template write_value<T>();
+        w << "}";
+    }
+
+private:
+    struct __attribute__((aligned(128))) stripe_type {
+        version_type vers;
+        W v;
+    };
+
+    stripe_type stripes_[NStripes];
+
+    static unsigned home() {
+        return TThread::id() % NStripes;
+    }
+    stripe_type& stripe(const TransItem& item) {
+        return stripes_[item.key<unsigned>()];
+    }
+};
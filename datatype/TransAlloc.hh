@@ -1,54 +1,174 @@
 #pragma once
+#include <new>
+#include <utility>
+#include <vector>
 #include "config.h"
 #include "compiler.hh"
 #include "Interface.hh"
 #include "Transaction.hh"
+#include "ObjectPool.hh"
 
+// Transactional allocation with per-thread pools.
+//
+// Blocks of up to max_pooled bytes come from the calling thread's
+// object_pool free list for their 16-byte size class; larger ones come
+// from malloc. A transaction's allocations and frees go to a per-thread
+// log behind a single TransItem per TransAlloc rather than one item each.
+// At commit, logged frees are handed to RCU; at abort, logged allocations
+// are (the caller may already have linked them into a shared structure).
+// Pooled blocks are handed over through RCU lanes, so each batch of
+// blocks of one class returns to the pool in one callback, and once the
+// pools are warm neither path reaches the global allocator.
+//
+// The static pool_* helpers are the same pools without the log, for data
+// structures that track their own inserts and removals (List, RBTree).
 class TransAlloc : public TObject {
 public:
-    static constexpr TransItem::flags_type alloc_flag = TransItem::user0_bit;
     typedef void (*free_type)(void*);
 
-    // used to free things only if successful commit
+    static constexpr size_t granule = 16;
+    static constexpr size_t max_pooled = 512;
+
+    // used to free things only if successful commit; ptr must come from
+    // malloc()
     void transFree(void *ptr) {
-        Sto::new_item(this, ptr).template add_write<free_type, free_type>(::free);
+        log(ptr, &Transaction::rcu_free, false);
+    }
+
+    // frees a block from transMalloc(sz) only if successful commit
+    void transFree(void *ptr, size_t sz) {
+        log(ptr, rcu_releaser(sz), false);
     }
 
-    // malloc() which will be freed on abort
+    // allocation which will be freed on abort; free with transFree(ptr, sz)
     void* transMalloc(size_t sz) {
-        void *ptr = malloc(sz);
-        Sto::new_item(this, ptr).template add_write<free_type, free_type>(::free).add_flags(alloc_flag);
+        void *ptr = pool_allocate(sz);
+        log(ptr, rcu_releaser(sz), true);
         return ptr;
     }
 
-    // delete which only applies if transaction commits
+    // delete which only applies if transaction commits; x must come from
+    // transNew or pool_new
     template <typename T>
     void transDelete(T *x) {
-        Sto::new_item(this, x).template add_write<free_type, free_type>(&ObjectDestroyer<T>::destroy_and_free);
+        log(x, &rcu_pool_delete<T>, false);
     }
 
     // new which will be delete'd on abort.
     // arguments go to T's constructor
     template <typename T, typename... Args>
     T* transNew(Args&&... args) {
-        T* x = new T(std::forward<Args>(args)...);
-        Sto::new_item(this, x).template add_write<free_type, free_type>(&ObjectDestroyer<T>::destroy_and_free).add_flags(alloc_flag);
+        T* x = pool_new<T>(std::forward<Args>(args)...);
+        log(x, &rcu_pool_delete<T>, true);
         return x;
     }
 
+    // Pools, usable outside transactions. Blocks must be released with the
+    // size they were allocated with.
+    static void* pool_allocate(size_t sz) {
+        return sz <= max_pooled ? size_ops(sz).allocate() : ::malloc(sz);
+    }
+    static void pool_release(void* ptr, size_t sz) {
+        if (sz <= max_pooled)
+            size_ops(sz).release(ptr);
+        else
+            ::free(ptr);
+    }
+    // releases once no running transaction can hold ptr
+    static void rcu_pool_release(void* ptr, size_t sz) {
+        if (sz <= max_pooled)
+            size_ops(sz).rcu_release(ptr);
+        else
+            Transaction::rcu_free(ptr);
+    }
+
+    template <typename T, typename... Args>
+    static T* pool_new(Args&&... args) {
+        static_assert(alignof(T) <= granule, "pooled objects are 16-byte aligned");
+        return new (pool_allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+    template <typename T>
+    static void pool_delete(T* x) {
+        x->~T();
+        pool_release(x, sizeof(T));
+    }
+    template <typename T>
+    static void rcu_pool_delete(void* x) {
+        Transaction::rcu_call<pool_delete_cb<T>>(x);
+    }
+    template <typename T>
+    static void rcu_pool_delete(T* x) {
+        rcu_pool_delete<T>(static_cast<void*>(x));
+    }
+
     bool lock(TransItem&, Transaction&) override { return true; }
     bool check(TransItem&, Transaction&) override { return false; }
     void install(TransItem&, Transaction&) override {}
     void unlock(TransItem&) override {}
-    void cleanup(TransItem& item, bool committed) override {
-        if (committed == !item.has_flag(alloc_flag))
-	  Transaction::rcu_call(item.write_value<free_type>(), item.key<void*>());
-    }
-    void print(std::ostream& w, const TransItem& item) const override {
-        w << "{TransAlloc @" << item.key<void*>();
-        if (item.write_value<int>())
-            w << ".alloc}";
-        else
-            w << ".free}";
+    void cleanup(TransItem&, bool committed) override {
+        auto& entries = logs_[TThread::id()].entries;
+        for (auto& e : entries)
+            if (e.alloc != committed)
+                e.release(e.ptr);
+        entries.clear();
+    }
+    void print(std::ostream& w, const TransItem&) const override {
+        w << "{TransAlloc " << (void*) this << " "
+          << logs_[TThread::id()].entries.size() << " blocks}";
+    }
+
+private:
+    static constexpr unsigned nclasses = max_pooled / granule;
+
+    struct log_entry {
+        void* ptr;
+        free_type release;
+        bool alloc;
+    };
+    struct alignas(CACHE_LINE_SIZE) thread_log {
+        std::vector<log_entry> entries;
+    };
+
+    struct pool_ops {
+        void* (*allocate)();
+        free_type release;
+        free_type rcu_release;
+    };
+
+    thread_log logs_[MAX_THREADS];
+
+    void log(void* ptr, free_type release, bool alloc) {
+        auto item = Sto::item(this, 0);
+        if (!item.has_write())
+            item.add_write();
+        logs_[TThread::id()].entries.push_back({ptr, release, alloc});
+    }
+
+    // what frees a block of size sz once no running transaction can hold it
+    static free_type rcu_releaser(size_t sz) {
+        return sz <= max_pooled ? size_ops(sz).rcu_release : &Transaction::rcu_free;
+    }
+
+    template <typename T>
+    static void pool_delete_cb(void* x) {
+        pool_delete(static_cast<T*>(x));
+    }
+    template <size_t Size>
+    static void rcu_release_cb(void* ptr) {
+        Transaction::rcu_call<&object_pool<Size>::release>(ptr);
+    }
+    template <size_t... I>
+    static const pool_ops* make_ops(std::index_sequence<I...>) {
+        static const pool_ops ops[] = {
+            { &object_pool<(I + 1) * granule>::allocate,
+              &object_pool<(I + 1) * granule>::release,
+              &rcu_release_cb<(I + 1) * granule> }...
+        };
+        return ops;
+    }
+    static const pool_ops& size_ops(size_t sz) {
+        assert(sz <= max_pooled);
+        static const pool_ops* ops = make_ops(std::make_index_sequence<nclasses>());
+        return ops[sz ? (sz - 1) / granule : 0];
     }
 };
@@ -7,11 +7,237 @@
 #include "rpmalloc/rpmalloc.h"
 #endif
 
+#include <algorithm>
+#include <fstream>
+#include <map>
 #include <numa.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "compiler.hh"
 
 TopologyInfo topo_info;
 
+// How set_affinity places runners (set_placement):
+// scatter: round-robin over NUMA nodes, the default;
+// compact: fill a node before the next, SMT siblings next to each other;
+// physical-first: one hardware thread of every physical core, node by
+// node, before any core's second thread;
+// file:<path>: the CPUs listed in path, in order.
+enum class placement_policy { scatter, compact, physical_first, file };
+static placement_policy placement = placement_policy::scatter;
+static std::string placement_path;
+static std::vector<int> placement_map;
+// NUMA node of each runner that set_runner_nodes placed
+static std::vector<int> runner_nodes;
+// CPUs kept for service threads, which runners don't get
+static std::vector<int> housekeeping;
+
+// Parses a CPU list like "0-3,8,10-11", as in sysfs and cpuset files
+static std::vector<int> parse_cpu_list(const std::string& s) {
+    std::vector<int> cpus;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int lo, hi;
+        char dash;
+        std::stringstream is(item);
+        if (!(is >> lo))
+            continue;
+        if (is >> dash >> hi && dash == '-')
+            for (int c = lo; c <= hi; ++c)
+                cpus.push_back(c);
+        else
+            cpus.push_back(lo);
+    }
+    return cpus;
+}
+
+// Reads a placement map: CPU lists separated by whitespace, runner i
+// taking the i-th CPU; '#' starts a comment
+static bool read_placement_map(const std::string& path, std::vector<int>& cpus) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    cpus.clear();
+    std::string line, word;
+    while (std::getline(in, line)) {
+        std::stringstream ls(line.substr(0, line.find('#')));
+        while (ls >> word)
+            for (int c : parse_cpu_list(word))
+                cpus.push_back(c);
+    }
+    return !cpus.empty();
+}
+
+// Lowest-numbered SMT sibling of cpu, which names its physical core
+static int core_of_cpu(int cpu) {
+    std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+    std::string list;
+    if (!(in >> list))
+        return cpu;
+    auto siblings = parse_cpu_list(list);
+    return siblings.empty() ? cpu : *std::min_element(siblings.begin(), siblings.end());
+}
+
+static void build_placement() {
+    auto& nodes = topo_info.cpu_id_list;
+    std::vector<int> order;
+    std::map<int, std::vector<int>> cores;   // core -> its allowed CPUs
+    std::vector<int> core_order;             // cores node by node
+    for (auto& node : nodes)
+        for (int c : node) {
+            int core = core_of_cpu(c);
+            if (cores[core].empty())
+                core_order.push_back(core);
+            cores[core].push_back(c);
+        }
+
+    switch (placement) {
+    case placement_policy::scatter: {
+        size_t most = 0;
+        for (auto& node : nodes)
+            most = std::max(most, node.size());
+        for (size_t q = 0; q != most; ++q)
+            for (auto& node : nodes)
+                if (q < node.size())
+                    order.push_back(node[q]);
+        break;
+    }
+    case placement_policy::compact:
+        for (int core : core_order)
+            order.insert(order.end(), cores[core].begin(), cores[core].end());
+        break;
+    case placement_policy::physical_first: {
+        size_t ncpus = 0;
+        for (auto& node : nodes)
+            ncpus += node.size();
+        // the k-th thread of every core, for k = 0, 1, ...
+        for (size_t k = 0; order.size() != ncpus; ++k)
+            for (int core : core_order)
+                if (k < cores[core].size())
+                    order.push_back(cores[core][k]);
+        break;
+    }
+    case placement_policy::file:
+        for (int c : placement_map) {
+            if (std::find(housekeeping.begin(), housekeeping.end(), c) != housekeeping.end())
+                continue;
+            if (topology_node_of_cpu(c) >= 0)
+                order.push_back(c);
+            else
+                std::cerr << "Warning: placement map CPU " << c << " is not available, skipped." << std::endl;
+        }
+        break;
+    }
+    if (placement != placement_policy::file) {
+        auto kept = std::remove_if(order.begin(), order.end(), [](int c) {
+                return std::find(housekeeping.begin(), housekeeping.end(), c) != housekeeping.end();
+            });
+        if (kept == order.begin())
+            std::cerr << "Warning: housekeeping CPUs leave runners no CPUs, sharing them." << std::endl;
+        else
+            order.erase(kept, order.end());
+    }
+    if (order.empty()) {
+        std::cerr << "Error: placement " << placement_name() << " leaves no CPUs to run on." << std::endl;
+        abort();
+    }
+    topo_info.placement = order;
+}
+
+bool set_placement(const char* spec) {
+    std::string s = spec ? spec : "";
+    if (s == "scatter")
+        placement = placement_policy::scatter;
+    else if (s == "compact")
+        placement = placement_policy::compact;
+    else if (s == "physical-first")
+        placement = placement_policy::physical_first;
+    else if (s.compare(0, 5, "file:") == 0) {
+        if (!read_placement_map(s.substr(5), placement_map)) {
+            std::cerr << "Error: can't read CPUs from placement map " << s.substr(5) << "." << std::endl;
+            return false;
+        }
+        placement = placement_policy::file;
+        placement_path = s.substr(5);
+    } else
+        return false;
+    if (topo_info.num_nodes)
+        build_placement();
+    return true;
+}
+
+// Keeps the CPUs in list ("2,3" or "2-3") for service threads
+// (ServiceThreads); an empty list gives them back to the runners
+bool set_housekeeping_cpus(const char* list) {
+    std::string s = list ? list : "";
+    auto cpus = parse_cpu_list(s);
+    if (cpus.empty() && !s.empty())
+        return false;
+    housekeeping = cpus;
+    if (topo_info.num_nodes)
+        build_placement();
+    return true;
+}
+
+const std::vector<int>& housekeeping_cpus() {
+    return housekeeping;
+}
+
+std::string placement_name() {
+    switch (placement) {
+    case placement_policy::compact:
+        return "compact";
+    case placement_policy::physical_first:
+        return "physical-first";
+    case placement_policy::file:
+        return "file:" + placement_path;
+    default:
+        return "scatter";
+    }
+}
+
+// Pins runner r, for r < nodes.size(), to a CPU of NUMA node nodes[r]:
+// the runners of a node take its CPUs in placement order. Other runners
+// follow the placement policy. An empty nodes undoes this.
+void set_runner_nodes(const std::vector<int>& nodes) {
+    runner_nodes = nodes;
+}
+
+// NUMA nodes with CPUs the process may run on
+std::vector<int> topology_nodes_in_use() {
+    std::vector<int> nodes;
+    for (int n = 0; n < topo_info.num_nodes; ++n)
+        if (!topo_info.cpu_id_list[n].empty())
+            nodes.push_back(n);
+    return nodes;
+}
+
+// Has the calling thread's new pages come from node when it can, or from
+// the node it runs on again if node < 0
+void prefer_numa_node(int node) {
+    if (node < 0)
+        numa_set_localalloc();
+    else
+        numa_set_preferred(node);
+}
+
+// CPU set_affinity pins runner_id to
+static int runner_cpu(int runner_id) {
+    if (size_t(runner_id) < runner_nodes.size()) {
+        int node = runner_nodes[runner_id];
+        int k = std::count(runner_nodes.begin(), runner_nodes.begin() + runner_id, node);
+        std::vector<int> cpus;
+        for (int c : topo_info.placement)
+            if (topology_node_of_cpu(c) == node)
+                cpus.push_back(c);
+        if (!cpus.empty())
+            return cpus[k % cpus.size()];
+    }
+    return topo_info.placement[runner_id % topo_info.placement.size()];
+}
+
 void discover_topology() {
     TopologyInfo info {};
 
@@ -31,6 +257,9 @@ void discover_topology() {
 
     int max_cpus = numa_num_possible_cpus();
     auto cpu_mask = numa_allocate_cpumask();
+    // leave out CPUs outside the process's cpuset, as in a container
+    cpu_set_t allowed;
+    bool have_allowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
 
     for (int i = 0; i < info.num_nodes; ++i) {
         std::vector<int> node_cpu_list;
@@ -43,7 +272,8 @@ void discover_topology() {
         std::cout << "    ";
         bool first = true;
         for (int c = 0; c < max_cpus; ++c) {
-            if (numa_bitmask_isbitset(cpu_mask, c) != 0) {
+            if (numa_bitmask_isbitset(cpu_mask, c) != 0
+                && (!have_allowed || c >= CPU_SETSIZE || CPU_ISSET(c, &allowed))) {
                 if (!first) {
                     std::cout << ",";
                 }
@@ -59,6 +289,83 @@ void discover_topology() {
 
     numa_free_cpumask(cpu_mask);
     topo_info = info;
+
+    build_placement();
+    std::cout << "[discover_topology] Placement " << placement_name() << ":" << std::endl << "    ";
+    for (size_t i = 0; i != topo_info.placement.size(); ++i)
+        std::cout << (i ? "," : "") << topo_info.placement[i];
+    std::cout << std::endl;
+    if (!housekeeping.empty()) {
+        std::cout << "[discover_topology] Housekeeping CPUs:" << std::endl << "    ";
+        for (size_t i = 0; i != housekeeping.size(); ++i)
+            std::cout << (i ? "," : "") << housekeeping[i];
+        std::cout << std::endl;
+    }
+    std::cout << std::flush;
+}
+
+// NUMA node of cpu according to topo_info, or -1 if unknown
+int topology_node_of_cpu(int cpu) {
+    for (int n = 0; n < topo_info.num_nodes; ++n)
+        for (int c : topo_info.cpu_id_list[n])
+            if (c == cpu)
+                return n;
+    return -1;
+}
+
+// Pairs a TSC reading with a CLOCK_MONOTONIC reading (in ns). The
+// clock read is bracketed by two TSC reads and the tightest of a few
+// tries is kept, so a preemption mid-sample doesn't skew the pair.
+static void tsc_clock_sample(uint64_t& tsc, uint64_t& ns) {
+    uint64_t best = 0;
+    for (int i = 0; i != 8; ++i) {
+        struct timespec ts;
+        uint64_t t0 = read_tsc();
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t t1 = read_tsc();
+        if (i == 0 || t1 - t0 < best) {
+            best = t1 - t0;
+            tsc = t0 + (t1 - t0) / 2;
+            ns = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+        }
+    }
+}
+
+// Measures the TSC rate against CLOCK_MONOTONIC over about ms
+// milliseconds, in GHz (ticks per ns). Returns the median of 5 rounds.
+double calibrate_tsc_frequency(unsigned ms) {
+    double rounds[5];
+    for (auto& r : rounds) {
+        uint64_t tsc0, ns0, tsc1, ns1;
+        tsc_clock_sample(tsc0, ns0);
+        struct timespec ts = {0, (long) (ms * 1000000 / 5)};
+        while (nanosleep(&ts, &ts) != 0)
+            /* interrupted */;
+        tsc_clock_sample(tsc1, ns1);
+        r = (double) (tsc1 - tsc0) / (double) (ns1 - ns0);
+    }
+    std::sort(rounds, rounds + 5);
+    return rounds[2];
+}
+
+static double measure_tsc_frequency() {
+    if (cpu_has_feature<IvTscQuery>())
+        return calibrate_tsc_frequency(50);
+    double freq = get_cpu_brand_frequency();
+    if (freq == 0.0) {
+        std::cout << "Warning: Can't determine processor tsc frequency from CPU brand string. Using the default value "
+                "of 1 GHz." << std::endl;
+        freq = 1.0;
+    }
+    return freq;
+}
+
+// TSC frequency in GHz, measured once. Calibrated against
+// CLOCK_MONOTONIC when the TSC is invariant; otherwise the TSC rate may
+// follow the core clock and the CPU brand string is the best guess.
+double tsc_frequency() {
+    static double freq = measure_tsc_frequency();
+    return freq;
 }
 
 void allocator_init() {
@@ -94,25 +401,7 @@ void set_affinity(int runner_id) {
 #else
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
-    int q = runner_id / topo_info.num_nodes;
-    q = q % topo_info.cpu_id_list[0].size();
-    int r = runner_id % topo_info.num_nodes;
-
-    int cpu_id = topo_info.cpu_id_list[r][q];
-
-    //printf("Affinity %d -> %d\n", runner_id, cpu_id);
-
-    // This is for the SEAS machine
-    //int cpu_id = runner_id;
-
-    // This is for the Georgia Tech machine
-    //int cpu_id = 24 * (runner_id % 8) + (runner_id / 8);
-
-    // This is for AWS m4.16xlarge instances (64 threads, 32 cores, 2 sockets)
-    //int cpu_id = runner_id / 2 + 16 * (runner_id % 2) + (runner_id / 32) * 16;
-
-    // This is for AWS m5.24xlarge instances (96 threads, 48 cores, 2 sockets)
-    //int cpu_id = runner_id / 2 + 24 * (runner_id % 2) + (runner_id / 48) * 24;
+    int cpu_id = runner_cpu(runner_id);
 
     CPU_SET(cpu_id, &cpuset);
     int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
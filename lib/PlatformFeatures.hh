@@ -18,7 +18,17 @@
 
 extern void allocator_init();
 extern void set_affinity(int runner_id);
+extern bool set_placement(const char* spec);
+extern std::string placement_name();
+extern void set_runner_nodes(const std::vector<int>& nodes);
+extern std::vector<int> topology_nodes_in_use();
+extern void prefer_numa_node(int node);
+extern bool set_housekeeping_cpus(const char* list);
+extern const std::vector<int>& housekeeping_cpus();
 extern void discover_topology();
+extern int topology_node_of_cpu(int cpu);
+extern double calibrate_tsc_frequency(unsigned ms);
+extern double tsc_frequency();
 
 static constexpr uint32_t level_bstr  = 0x80000004;
 
@@ -27,6 +37,7 @@ enum class Reg : int {eax = 0, ebx, ecx, edx, size};
 class CpuidQuery {
 public:
     static constexpr uint32_t query_level = 0;
+    static constexpr uint32_t query_subleaf = 0;
     static constexpr uint32_t result_bit = 0;
     static constexpr Reg result_reg = Reg::eax;
 };
@@ -45,25 +56,68 @@ public:
     static constexpr Reg result_reg = Reg::edx;
 };
 
+class OsxsaveQuery : public CpuidQuery {
+public:
+    static constexpr uint32_t query_level = 0x1;
+    static constexpr uint32_t result_bit = (1 << 27);
+    static constexpr Reg result_reg = Reg::ecx;
+};
+
+class Avx2Query : public CpuidQuery {
+public:
+    static constexpr uint32_t query_level = 0x7;
+    static constexpr uint32_t result_bit = (1 << 5);
+    static constexpr Reg result_reg = Reg::ebx;
+};
+
+class RtmQuery : public CpuidQuery {
+public:
+    static constexpr uint32_t query_level = 0x7;
+    static constexpr uint32_t result_bit = (1 << 11);
+    static constexpr Reg result_reg = Reg::ebx;
+};
+
+class Avx512fQuery : public CpuidQuery {
+public:
+    static constexpr uint32_t query_level = 0x7;
+    static constexpr uint32_t result_bit = (1 << 16);
+    static constexpr Reg result_reg = Reg::ebx;
+};
+
 template <typename Query>
 inline bool cpu_has_feature() {
-    uint32_t max_level = __get_cpuid_max(0x80000000, nullptr);
+    uint32_t max_level = __get_cpuid_max(Query::query_level & 0x80000000, nullptr);
     if (max_level < Query::query_level) {
         return false;
     } else {
         uint32_t regs[static_cast<int>(Reg::size)];
-        int r = __get_cpuid(Query::query_level,
-                            &regs[static_cast<int>(Reg::eax)],
-                            &regs[static_cast<int>(Reg::ebx)],
-                            &regs[static_cast<int>(Reg::ecx)],
-                            &regs[static_cast<int>(Reg::edx)]);
-        if (r == 0)
-            return false;
-        else
-            return (regs[static_cast<int>(Query::result_reg)] & Query::result_bit);
+        __cpuid_count(Query::query_level, Query::query_subleaf,
+                      regs[static_cast<int>(Reg::eax)],
+                      regs[static_cast<int>(Reg::ebx)],
+                      regs[static_cast<int>(Reg::ecx)],
+                      regs[static_cast<int>(Reg::edx)]);
+        return (regs[static_cast<int>(Query::result_reg)] & Query::result_bit);
     }
 }
 
+enum class SimdLevel : int {scalar = 0, avx2, avx512};
+
+// Widest vector extension that both the CPU and the OS (via XCR0) support
+inline SimdLevel cpu_simd_level() {
+    if (!cpu_has_feature<OsxsaveQuery>())
+        return SimdLevel::scalar;
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    (void)xcr0_hi;
+    // SSE and AVX state
+    if ((xcr0_lo & 0x6) != 0x6 || !cpu_has_feature<Avx2Query>())
+        return SimdLevel::scalar;
+    // opmask and ZMM state
+    if ((xcr0_lo & 0xE0) == 0xE0 && cpu_has_feature<Avx512fQuery>())
+        return SimdLevel::avx512;
+    return SimdLevel::avx2;
+}
+
 inline std::string get_cpu_brand_string() {
     uint32_t max_level = __get_cpuid_max(0x80000000, nullptr);
     if (max_level < level_bstr)
@@ -147,12 +201,7 @@ inline double determine_cpu_freq() {
     }
 
     std::cout << "Determining processor frequency..." << std::endl;
-    freq = get_cpu_brand_frequency();
-    if (freq == 0.0) {
-        std::cout << "Warning: Can't determine processor tsc frequency from CPU brand string. Using the default value "
-                "of 1 GHz." << std::endl;
-        freq = 1.0;
-    }
+    freq = tsc_frequency();
     std::cout << "Info: CPU tsc frequency determined as "
               << std::fixed << std::setprecision(2) << freq << " GHz." << std::endl;
     return freq;
@@ -160,7 +209,10 @@ inline double determine_cpu_freq() {
 
 struct TopologyInfo {
     int num_nodes;
+    // CPUs of each node that the process may run on
     std::vector<std::vector<int>> cpu_id_list;
+    // CPUs in the order set_affinity hands them to runners
+    std::vector<int> placement;
 };
 
 extern TopologyInfo topo_info;
@@ -36,10 +36,22 @@ struct Packer<std::string, false> {
         return wrapper.value();
     }
     static void* pack_unique(TransactionBuffer& buf, const std::string& x) {
-        if (const void* ptr = buf.find<UniqueKey<std::string> >(x))
-            return const_cast<void*>(ptr);
+        if (const std::string* ptr = buf.find_unique(x))
+            return const_cast<std::string*>(ptr);
         else
-            return buf.allocate<UniqueKey<std::string> >(x);
+            return buf.add_unique<std::string>(x);
+    }
+    static void* pack_unique(TransactionBuffer& buf, std::string&& x) {
+        if (const std::string* ptr = buf.find_unique(x))
+            return const_cast<std::string*>(ptr);
+        else
+            return buf.add_unique<std::string>(std::move(x));
+    }
+    static void* pack_unique_stable(TransactionBuffer& buf, const std::string& x) {
+        if (const std::string* ptr = buf.find_unique(x))
+            return const_cast<std::string*>(ptr);
+        buf.add_unique_ref(&x);
+        return const_cast<std::string*>(&x);
     }
     template <typename... Args>
     static void* repack(TransactionBuffer& buf, void*, Args&&... args) {
@@ -19,7 +19,7 @@ pid_t spawn(const std::string &name, perf_mode mode) {
                        "-p", ss.str().c_str(), nullptr));
         } else if (mode == perf_mode::counters) {
             exit(execl("/usr/bin/perf", "perf", "stat", "-e",
-                       "cycles,cache-misses,cache-references,L1-dcache-loads,L1-dcache-load-misses,"
+                       "cycles,instructions,cache-misses,cache-references,L1-dcache-loads,L1-dcache-load-misses,"
                        "context-switches,cpu-migrations,page-faults,branch-instructions,branch-misses,"
                        "dTLB-load-misses,dTLB-loads",
                        "-o", profile_name.c_str(),
@@ -2,6 +2,7 @@
 
 //#include <iostream>
 
+#include <cstdint>
 #include <cstdlib>
 #include <cassert>
 #include <cstring>
@@ -16,71 +17,80 @@ typedef size_t index_t;
 typedef std::vector<double> weight_type;
 typedef std::vector<index_t> trace_type;
 
-#if 0
-// commented out since we use std::discrete_distribution now to do the sampling
-// prefix-sum tree data structure used to sample a given (scaled) pmf
-class PrefixSumTree {
+// Uniform double in [0, 1) from any generator with min() == 0: 53 bits
+// from one 64-bit draw, or from two draws of a 32-bit one (std::mt19937)
+template <typename Rng>
+inline double unit_uniform(Rng& rng) {
+    static_assert(Rng::min() == 0, "generator must start at 0");
+    uint64_t x = rng();
+    if (Rng::max() <= 0xFFFFFFFFULL)
+        x = (x << 32) | uint64_t(rng());
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Alias table (Walker, with Vose's construction): samples index i with
+// probability pmf[i] / sum(pmf) in O(1), from one uniform draw. Built in
+// O(n); takes 12 bytes per index.
+class AliasTable {
 public:
-    PrefixSumTree(size_t num_intervals) {
-        size_t np2 = 1;
-        while (np2 < num_intervals) np2 <<= 1;
-        leaves_idx = np2 - 1;
-        size = np2 * 2;
-        array = new size_t[size];
-        bzero(array, size*sizeof(size_t));
-    }
-
-    ~PrefixSumTree() {
-        delete[] array;
-    }
-
-    // populate the content of the tree given a pmf
-    void load(const pmf_type& pmf) {
-        for (size_t i = 0; i < pmf.size(); ++i)
-            increment_interval((index_t)i, pmf[i]);
-    }
-
-    // this is the "sample" method
-    index_t find_interval(size_t prefix_sum) const {
-        assert(prefix_sum <= array[0]);
-        index_t p = 0;
-        while (p < leaves_idx) {
-            index_t left = p*2+1;
-            index_t right = p*2+2;
-            size_t al = array[left];
-            if (al >= prefix_sum) {
-                p = left;
-            } else {
-                prefix_sum -= al;
-                p = right;
-                assert(prefix_sum <= array[right]);
+    AliasTable() = default;
+    explicit AliasTable(const weight_type& pmf) {
+        build(pmf);
+    }
+
+    void build(const weight_type& pmf) {
+        size_t n = pmf.size();
+        assert(n <= size_t(UINT32_MAX));
+        prob_.assign(n, 1.0);
+        alias_.resize(n);
+        for (size_t i = 0; i < n; ++i)
+            alias_[i] = uint32_t(i);
+        double sum = 0;
+        for (double w : pmf) {
+            assert(w >= 0);
+            sum += w;
+        }
+        if (n == 0 || sum <= 0)
+            return;
+
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+            prob_[i] = pmf[i] * n / sum;
+            (prob_[i] < 1 ? small : large).push_back(uint32_t(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            uint32_t s = small.back(), l = large.back();
+            small.pop_back();
+            alias_[s] = l;
+            prob_[l] -= 1 - prob_[s];
+            if (prob_[l] < 1) {
+                large.pop_back();
+                small.push_back(l);
             }
         }
-        return p - leaves_idx; 
+        // what's left is 1 up to rounding
+        for (auto i : small)
+            prob_[i] = 1;
+        for (auto i : large)
+            prob_[i] = 1;
     }
 
-    size_t adjusted_resolution() const {
-        return array[0];
+    size_t size() const {
+        return prob_.size();
     }
 
-private:
-    // helper function which incrementally updates the content of the tree
-    // while maintaining data structure invariants
-    void increment_interval(index_t index, size_t amount) {
-        index += leaves_idx;
-        while (true) {
-            array[index] += amount;
-            if (index == 0)
-                break;
-            index = (index - 1)/2;
-        } 
+    template <typename Rng>
+    index_t sample(Rng& rng) const {
+        assert(!prob_.empty());
+        double x = unit_uniform(rng) * prob_.size();
+        auto i = index_t(x);
+        return x - i < prob_[i] ? i : alias_[i];
     }
 
-    size_t *array;
-    size_t size;
-    size_t leaves_idx;
+private:
+    std::vector<double> prob_;
+    std::vector<uint32_t> alias_;
 };
-#endif
 
 template <typename IntType>
 class StoUniformIntSampler {
@@ -122,7 +132,7 @@ public:
     typedef typename StoUniformIntSampler<IntType>::rng_type rng_type;
 
     StoRandomDistribution(rng_type& rng, IntType a, IntType b)
-        : begin(a), end(b), uis(rng), dist() {
+        : begin(a), end(b), uis(rng), table() {
         assert(a < b);
     }
 
@@ -139,11 +149,11 @@ public:
     }
 
     virtual uint64_t sample_idx() const {
-        return dist(uis.generator());
+        return table.sample(uis.generator());
     }
 
     virtual uint64_t sample_idx(rng_type& rng) const {
-        return dist(rng);
+        return table.sample(rng);
     }
 
     rng_type& generator() const {
@@ -159,8 +169,7 @@ public:
 
 protected:
     void generate(weight_type&& pmf) {
-        std::discrete_distribution<IntType> d_(pmf.begin(), pmf.end());
-        dist.param(d_.param());
+        table.build(pmf);
     }
 
     IntType begin;
@@ -168,7 +177,7 @@ protected:
 
     mutable StoUniformIntSampler<uint64_t> uis;
     // the core distribution
-    mutable std::discrete_distribution<uint64_t> dist;
+    AliasTable table;
 };
 
 // specialization 1: uniform random distribution
@@ -195,7 +204,125 @@ private:
     }
 };
 
-// specialization 2: zipf distribution
+// xoshiro256** (Blackman and Vigna): a small, fast per-thread generator for
+// workloads sampled on the fly, seeded through splitmix64
+class xoshiro256ss {
+public:
+    typedef uint64_t result_type;
+
+    explicit xoshiro256ss(uint64_t seed) {
+        for (auto& w : s_) {
+            seed += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            w = z ^ (z >> 31);
+        }
+    }
+
+    static constexpr result_type min() {
+        return 0;
+    }
+    static constexpr result_type max() {
+        return ~result_type(0);
+    }
+
+    result_type operator()() {
+        uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, n), by multiply-shift; unbiased enough for n < 2^32
+    uint64_t below(uint64_t n) {
+        return ((*this)() >> 32) * n >> 32;
+    }
+    // Uniform in [0, 1)
+    double uniform() {
+        return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t s_[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+// Zipf distribution over [a, b] sampled by rejection-inversion (Hoermann
+// and Derflinger, 1996), with the same pmf as StoZipfDistribution: rank i
+// (from 0) has weight 1/(i+1)^skew, and a is the most popular value.
+// Setup is O(1) and the state a few doubles, with no table over the
+// range; a sample takes about one try.
+template <typename IntType = index_t>
+class StoZipfRejectionSampler {
+public:
+    StoZipfRejectionSampler(IntType a, IntType b, double skew)
+        : begin_(a), n_(double(b - a + 1)), skew_(skew) {
+        assert(a < b && skew > 0);
+        h_integral_x1_ = h_integral(1.5) - 1;
+        h_integral_n_ = h_integral(n_ + 0.5);
+        s_ = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+    }
+
+    template <typename Rng>
+    IntType sample(Rng& rng) const {
+        while (true) {
+            double u = h_integral_n_ + unit_uniform(rng) * (h_integral_x1_ - h_integral_n_);
+            double x = h_integral_inverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1)
+                k = 1;
+            else if (k > n_)
+                k = n_;
+            if (k - x <= s_ || u >= h_integral(k + 0.5) - h(k))
+                return begin_ + IntType(k) - 1;
+        }
+    }
+
+private:
+    IntType begin_;
+    double n_;
+    double skew_;
+    double h_integral_x1_;
+    double h_integral_n_;
+    double s_;
+
+    double h(double x) const {
+        return std::exp(-skew_ * std::log(x));
+    }
+    // integral of h, up to a constant
+    double h_integral(double x) const {
+        double log_x = std::log(x);
+        return helper2((1 - skew_) * log_x) * log_x;
+    }
+    double h_integral_inverse(double x) const {
+        double t = x * (1 - skew_);
+        if (t < -1)
+            t = -1;
+        return std::exp(helper1(t) * x);
+    }
+    // log1p(x) / x and expm1(x) / x, stable near 0 (skew near 1)
+    static double helper1(double x) {
+        if (std::abs(x) > 1e-8)
+            return std::log1p(x) / x;
+        return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+    static double helper2(double x) {
+        if (std::abs(x) > 1e-8)
+            return std::expm1(x) / x;
+        return 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+    }
+};
+
+// specialization 2: zipf distribution, sampled by rejection-inversion
 template <typename IntType = index_t>
 class StoZipfDistribution : public StoRandomDistribution<IntType> {
 public:
@@ -203,31 +330,18 @@ public:
     using typename StoRandomDistribution<IntType>::rng_type;
 
     StoZipfDistribution(rng_type& rng, IntType a, IntType b, double skew = default_skew) :
-        StoRandomDistribution<IntType>(rng, a, b), skewness(skew), sum_() {
-        calculate_sum();
-        this->generate(generate_weights());
-    }
+        StoRandomDistribution<IntType>(rng, a, b), zipf(0, b - a, skew) {}
 
-private:
-    weight_type generate_weights() {
-        weight_type pmf;
-        for (auto i = this->begin; i <= this->end; ++i) {
-            double p = 1.0/(std::pow((double)(i - this->begin + 1), skewness)*sum_);
-            //std::cout << p << std::endl;
-            pmf.push_back(p);
-        }
-        return pmf;
+    uint64_t sample_idx() const override {
+        return zipf.sample(this->uis.generator());
     }
 
-    void calculate_sum() {
-        double s = 0.0;
-        for (auto i = this->begin; i <= this->end; ++i)
-            s += std::pow(1.0/(double)(i- this->begin +1), skewness);
-        sum_ = s;
+    uint64_t sample_idx(rng_type& rng) const override {
+        return zipf.sample(rng);
     }
 
-    double skewness;
-    double sum_;
+private:
+    StoZipfRejectionSampler<IntType> zipf;
 };
 
 // specialization 3: random distribution defined by a histogram
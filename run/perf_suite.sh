@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Perf regression suite: fixed-shape, fixed-seed configurations of the core
+# benchmarks, each run TRIALS times. Worker threads are pinned by the
+# benchmarks themselves (set_affinity). Every run appends its JSON results
+# document (see bench::db_profiler) to OUT; given a BASELINE written by an
+# earlier run of this script, OUT is then compared against it, and the
+# script fails if any configuration's throughput dropped significantly.
+#
+# Usage: run/perf_suite.sh [-o OUT] [-b BASELINE] [-n TRIALS] [-l SECONDS] [-s SEED]
+#
+# Build the benchmarks with NDEBUG=1 first, the same way for the baseline
+# and for the run compared against it (`make perf-baseline`, `make perf-suite`).
+
+OUT=perf-results.json
+BASELINE=
+TRIALS=5
+TIME=5
+SEED=1
+
+while getopts "o:b:n:l:s:" opt; do
+  case $opt in
+    o) OUT=$OPTARG ;;
+    b) BASELINE=$OPTARG ;;
+    n) TRIALS=$OPTARG ;;
+    l) TIME=$OPTARG ;;
+    s) SEED=$OPTARG ;;
+    *) echo "Usage: $0 [-o OUT] [-b BASELINE] [-n TRIALS] [-l SECONDS] [-s SEED]" >&2; exit 2 ;;
+  esac
+done
+
+# Name, then command line (without time and seed). Keep these fixed: a
+# baseline only compares against runs of identical configurations.
+SUITE=(
+  "tpcc-occ-1wh"    "./tpcc_bench -idefault -w1 -t4 -g"
+  "tpcc-occ-4wh"    "./tpcc_bench -idefault -w4 -t4 -g"
+  "tpcc-mvcc-4wh"   "./tpcc_bench -imvcc -w4 -t4 -g"
+  "tpcc-tictoc-4wh" "./tpcc_bench -itictoc -w4 -t4 -g"
+  "ycsb-a-occ"      "./ycsb_bench -idefault -mA -t4 -g"
+  "ycsb-b-mvcc"     "./ycsb_bench -imvcc -mB -t4 -g"
+  "ycsb-c-occ"      "./ycsb_bench -idefault -mC -t4 -g"
+)
+
+rm -f "$OUT"
+for ((i = 0; i < ${#SUITE[@]}; i += 2)); do
+  NAME=${SUITE[$i]}
+  CMD=${SUITE[$((i + 1))]}
+  for ((trial = 1; trial <= TRIALS; ++trial)); do
+    printf "%s, trial %d/%d\n" "$NAME" "$trial" "$TRIALS"
+    if ! STO_RESULTS_JSON="$OUT" $CMD -l"$TIME" -S"$SEED" > /dev/null; then
+      echo "$NAME failed: $CMD -l$TIME -S$SEED" >&2
+      exit 1
+    fi
+  done
+done
+
+if [ -n "$BASELINE" ]; then
+  python3 "$(dirname "$0")/../benchmark/utils/perf_compare.py" "$BASELINE" "$OUT"
+fi
@@ -0,0 +1,143 @@
+#include "AbortProfile.hh"
+
+#include <algorithm>
+#include <cstring>
+#include "PlatformFeatures.hh"
+
+static const char unattributed[] = "unattributed";
+static const char other_reasons[] = "other reasons";
+
+bool AbortProfile::enabled_ = false;
+std::mutex AbortProfile::mutex_;
+std::atomic<unsigned> AbortProfile::ntypes_(1);
+const char* AbortProfile::names_[AbortProfile::max_types] = {"untyped"};
+AbortProfile::thread_state AbortProfile::threads_[MAX_THREADS];
+
+unsigned AbortProfile::add_type(const char* name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    unsigned n = ntypes_.load(std::memory_order_relaxed);
+    for (unsigned t = 0; t != n; ++t)
+        if (strcmp(names_[t], name) == 0)
+            return t;
+    always_assert(n != max_types, "too many abort profile types registered");
+    names_[n] = name;
+    ntypes_.store(n + 1, std::memory_order_release);
+    return n;
+}
+
+unsigned AbortProfile::retry_bucket(unsigned nfailed) {
+    if (nfailed < 4)
+        return nfailed;
+    unsigned b = 32 - __builtin_clz(nfailed) + 1;   // 4-7 -> 4, 8-15 -> 5, ...
+    return std::min(b, retry_buckets - 1);
+}
+
+void AbortProfile::attempt_slow(int threadid, uint64_t cycles, bool committed, const char* reason) {
+    thread_state& s = threads_[threadid];
+    if (committed) {
+        ++s.commits[s.type];
+        s.commit_cycles[s.type] += cycles;
+        return;
+    }
+    if (!reason)
+        reason = unattributed;
+    cell* c = nullptr;
+    for (unsigned i = 0; i != s.ncells && !c; ++i)
+        if (s.cells[i].reason == reason && s.cells[i].type == s.type)
+            c = &s.cells[i];
+    if (!c && s.ncells != max_reasons) {
+        c = &s.cells[s.ncells++];
+        c->reason = reason;
+        c->type = s.type;
+    } else if (!c) {
+        // full: the last slot becomes a catch-all
+        c = &s.cells[max_reasons - 1];
+        c->reason = other_reasons;
+        c->type = s.type;
+    }
+    ++c->aborts;
+    c->cycles += cycles;
+}
+
+void AbortProfile::retries_slow(int threadid, unsigned nfailed) {
+    thread_state& s = threads_[threadid];
+    ++s.retries[s.type][retry_bucket(nfailed)];
+}
+
+AbortProfile::type_totals AbortProfile::combined(unsigned type) {
+    type_totals out = {};
+    for (auto& s : threads_) {
+        out.commits += s.commits[type];
+        out.commit_cycles += s.commit_cycles[type];
+        for (unsigned b = 0; b != retry_buckets; ++b)
+            out.retries[b] += s.retries[type][b];
+        for (unsigned i = 0; i != s.ncells; ++i) {
+            const cell& c = s.cells[i];
+            if (c.type != type)
+                continue;
+            out.aborts += c.aborts;
+            out.abort_cycles += c.cycles;
+            // reasons are string literals: the same text may sit at
+            // different addresses in different translation units
+            unsigned j = 0;
+            while (j != out.nreasons && strcmp(out.reasons[j].reason, c.reason) != 0)
+                ++j;
+            if (j == out.nreasons) {
+                if (out.nreasons == max_reasons)
+                    j = max_reasons - 1;
+                else
+                    out.reasons[out.nreasons++] = {c.reason, 0, 0};
+            }
+            out.reasons[j].aborts += c.aborts;
+            out.reasons[j].cycles += c.cycles;
+        }
+    }
+    std::sort(out.reasons, out.reasons + out.nreasons,
+              [] (const reason_totals& a, const reason_totals& b) { return a.cycles > b.cycles; });
+    return out;
+}
+
+void AbortProfile::clear() {
+    for (auto& s : threads_) {
+        unsigned type = s.type;
+        memset(&s, 0, sizeof(s));
+        s.type = type;
+    }
+}
+
+void AbortProfile::report(FILE* f) {
+    static const char* bucket_names[retry_buckets] = {
+        "0", "1", "2", "3", "4-7", "8-15", "16-31", "32-63", "64-127", "128+"
+    };
+    double cycles_per_ms = tsc_frequency() * 1e6;
+    bool header = false;
+    for (unsigned t = 0; t != num_types(); ++t) {
+        type_totals tt = combined(t);
+        if (!tt.commits && !tt.aborts)
+            continue;
+        if (!header) {
+            fprintf(f, "$ Abort cost: attempts committed/aborted, wasted ms (%% of attempt time),"
+                    " cycles per aborted attempt\n");
+            header = true;
+        }
+        uint64_t total = tt.commit_cycles + tt.abort_cycles;
+        fprintf(f, "$   %-16s %llu/%llu, %.1f (%.1f%%), %.0f\n", names_[t],
+                (unsigned long long) tt.commits, (unsigned long long) tt.aborts,
+                tt.abort_cycles / cycles_per_ms, total ? 100.0 * tt.abort_cycles / total : 0.0,
+                tt.aborts ? 1.0 * tt.abort_cycles / tt.aborts : 0.0);
+        for (unsigned i = 0; i != tt.nreasons; ++i)
+            fprintf(f, "$     %-22s %llu, %.1f ms, %.0f\n", tt.reasons[i].reason,
+                    (unsigned long long) tt.reasons[i].aborts, tt.reasons[i].cycles / cycles_per_ms,
+                    1.0 * tt.reasons[i].cycles / tt.reasons[i].aborts);
+        uint64_t ntxn = 0;
+        for (unsigned b = 0; b != retry_buckets; ++b)
+            ntxn += tt.retries[b];
+        if (!ntxn)
+            continue;
+        fprintf(f, "$     retries per transaction:");
+        for (unsigned b = 0; b != retry_buckets; ++b)
+            if (tt.retries[b])
+                fprintf(f, " %s: %.2f%%", bucket_names[b], 100.0 * tt.retries[b] / ntxn);
+        fprintf(f, "\n");
+    }
+}
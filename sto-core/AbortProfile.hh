@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// What aborts cost: the cycles each attempt spent from start() to stop(),
+// split into committed and wasted (aborted) attempts, by transaction type
+// and, for aborts, by the reason the attempt last passed to
+// mark_abort_because; and how many attempts each logical transaction (one
+// TransactionLoopGuard) took.
+//
+// A type is a name registered with add_type; type 0 is "untyped". Drivers
+// set the calling thread's type with a type_scope around each transaction.
+// Each thread keeps its own totals, which combined() and report() merge
+// once the run is over.
+class AbortProfile {
+public:
+    static constexpr unsigned max_types = 16;
+    static constexpr unsigned max_reasons = 48;  // per thread; more share one slot
+    // Retry histogram buckets: 0, 1, 2, 3, 4-7, 8-15, ..., 128+
+    static constexpr unsigned retry_buckets = 10;
+
+    static void enable() {
+        enabled_ = true;
+    }
+    static void disable() {
+        enabled_ = false;
+    }
+    static bool enabled() {
+        return enabled_;
+    }
+
+    // Returns the type with this name, registering it if needed
+    static unsigned add_type(const char* name);
+    static unsigned num_types() {
+        return ntypes_.load(std::memory_order_acquire);
+    }
+    static const char* type_name(unsigned type) {
+        return names_[type];
+    }
+
+    // Sets the calling thread's transaction type for its scope
+    class type_scope {
+    public:
+        explicit type_scope(unsigned type)
+            : old_(threads_[TThread::id()].type) {
+            threads_[TThread::id()].type = type;
+        }
+        ~type_scope() {
+            threads_[TThread::id()].type = old_;
+        }
+
+    private:
+        unsigned old_;
+    };
+
+    // An attempt's start tick, or 0 when disabled
+    static uint64_t now() {
+        return enabled_ ? read_tsc() : 0;
+    }
+    // Called as an attempt stops; reason is null for aborts no item was
+    // marked for (user aborts, for instance)
+    static void attempt(int threadid, uint64_t t0, bool committed, const char* reason) {
+        if (t0)
+            attempt_slow(threadid, read_tsc() - t0, committed, reason);
+    }
+    // Called once per logical transaction with its failed attempt count
+    static void retries(int threadid, unsigned nfailed) {
+        if (enabled_)
+            retries_slow(threadid, nfailed);
+    }
+
+    struct reason_totals {
+        const char* reason;
+        uint64_t aborts;
+        uint64_t cycles;
+    };
+    struct type_totals {
+        uint64_t commits;
+        uint64_t commit_cycles;
+        uint64_t aborts;
+        uint64_t abort_cycles;
+        uint64_t retries[retry_buckets];   // logical transactions by failed attempts
+        reason_totals reasons[max_reasons];
+        unsigned nreasons;                 // by descending cycles
+    };
+    // Merged over threads
+    static type_totals combined(unsigned type);
+    static void clear();
+    // Prints wasted cycles and retry distributions per type, if anything
+    // was recorded
+    static void report(FILE* f);
+
+    static unsigned retry_bucket(unsigned nfailed);
+
+private:
+    struct cell {
+        const char* reason;
+        unsigned type;
+        uint64_t aborts;
+        uint64_t cycles;
+    };
+    struct __attribute__((aligned(128))) thread_state {
+        unsigned type;
+        unsigned ncells;
+        cell cells[max_reasons];
+        uint64_t commits[max_types];
+        uint64_t commit_cycles[max_types];
+        uint64_t retries[max_types][retry_buckets];
+    };
+
+    static bool enabled_;
+    static std::mutex mutex_;
+    static std::atomic<unsigned> ntypes_;
+    static const char* names_[max_types];
+    static thread_state threads_[MAX_THREADS];
+
+    static void attempt_slow(int threadid, uint64_t cycles, bool committed, const char* reason);
+    static void retries_slow(int threadid, unsigned nfailed);
+};
@@ -0,0 +1,445 @@
+#include "AsyncIO.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#include "compiler.hh"
+
+#if defined(__NR_io_uring_setup) && defined(IORING_OFF_SQ_RING)
+#define STO_HAVE_IO_URING 1
+#else
+#define STO_HAVE_IO_URING 0
+#endif
+
+namespace {
+std::atomic<uint64_t> batches_;
+std::atomic<uint64_t> fallback_batches_;
+std::atomic<uint64_t> ops_;
+std::atomic<uint64_t> bytes_;
+std::atomic<uint64_t> depth_sum_;
+std::atomic<uint64_t> max_depth_;
+std::atomic<uint64_t> latency_ns_;
+std::atomic<uint64_t> max_latency_ns_;
+
+void raise_to(std::atomic<uint64_t>& x, uint64_t v) {
+    uint64_t cur = x.load(std::memory_order_relaxed);
+    while (cur < v && !x.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+        /* retry */;
+}
+
+uint64_t now_ns() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+}
+
+bool pwritev_all(int fd, struct iovec* iov, int n, off_t offset) {
+    while (n) {
+        ssize_t w = pwritev(fd, iov, n, offset);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        offset += w;
+        for (; n && size_t(w) >= iov->iov_len; ++iov, --n)
+            w -= iov->iov_len;
+        if (n) {
+            iov->iov_base = reinterpret_cast<char*>(iov->iov_base) + w;
+            iov->iov_len -= w;
+        }
+    }
+    return true;
+}
+}
+
+struct AsyncIO::ring {
+#if STO_HAVE_IO_URING
+    // An operation in flight; its index is the SQE's user_data
+    struct slot {
+        op o;
+        struct iovec iov;
+        uint64_t start_ns;
+    };
+
+    int fd = -1;
+    void* sq_map = MAP_FAILED;
+    size_t sq_map_size = 0;
+    void* cq_map = MAP_FAILED;
+    size_t cq_map_size = 0;
+    io_uring_sqe* sqes = reinterpret_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size = 0;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+    std::vector<slot> slots;
+    std::vector<unsigned> free_slots;
+    unsigned in_flight = 0;
+
+    ~ring() {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqes_size);
+        if (cq_map != MAP_FAILED && cq_map != sq_map)
+            munmap(cq_map, cq_map_size);
+        if (sq_map != MAP_FAILED)
+            munmap(sq_map, sq_map_size);
+        if (fd >= 0)
+            close(fd);
+    }
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+    }
+#endif
+};
+
+AsyncIO::AsyncIO(unsigned depth, bool use_uring)
+    : ring_(nullptr), failed_(false) {
+    if (use_uring)
+        setup_ring(std::max(depth, 2U));
+}
+
+AsyncIO::~AsyncIO() {
+    drain();
+    delete ring_;
+}
+
+bool AsyncIO::setup_ring(unsigned depth) {
+#if STO_HAVE_IO_URING
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = syscall(__NR_io_uring_setup, depth, &p);
+    if (fd < 0)
+        return false;
+    ring* r = new ring;
+    r->fd = fd;
+    r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+        r->sq_map_size = r->cq_map_size = std::max(r->sq_map_size, r->cq_map_size);
+    r->sq_map = mmap(nullptr, r->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, IORING_OFF_SQ_RING);
+    if (single)
+        r->cq_map = r->sq_map;
+    else if (r->sq_map != MAP_FAILED)
+        r->cq_map = mmap(nullptr, r->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_CQ_RING);
+    r->sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    if (r->cq_map != MAP_FAILED)
+        r->sqes = reinterpret_cast<io_uring_sqe*>(
+            mmap(nullptr, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 fd, IORING_OFF_SQES));
+    if (r->sqes == MAP_FAILED) {
+        delete r;
+        return false;
+    }
+    char* sq = reinterpret_cast<char*>(r->sq_map);
+    char* cq = reinterpret_cast<char*>(r->cq_map);
+    r->sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    r->sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    r->sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    r->cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    r->cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    r->cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    r->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    // at most one operation in flight per SQ entry, so the CQ (twice as
+    // large) never overflows
+    r->slots.resize(p.sq_entries);
+    for (unsigned s = p.sq_entries; s != 0; --s)
+        r->free_slots.push_back(s - 1);
+    ring_ = r;
+    return true;
+#else
+    (void) depth;
+    return false;
+#endif
+}
+
+bool AsyncIO::register_buffers(const struct iovec* iov, unsigned n) {
+#if STO_HAVE_IO_URING
+    if (!ring_)
+        return false;
+    drain();
+    if (!registered_.empty()) {
+        syscall(__NR_io_uring_register, ring_->fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        registered_.clear();
+    }
+    if (syscall(__NR_io_uring_register, ring_->fd, IORING_REGISTER_BUFFERS, iov, n) != 0)
+        return false;
+    registered_.assign(iov, iov + n);
+    return true;
+#else
+    (void) iov, (void) n;
+    return false;
+#endif
+}
+
+int AsyncIO::fixed_index(const char* p, size_t n) const {
+    for (size_t i = 0; i != registered_.size(); ++i) {
+        const char* b = reinterpret_cast<const char*>(registered_[i].iov_base);
+        if (p >= b && p + n <= b + registered_[i].iov_len)
+            return i;
+    }
+    return -1;
+}
+
+void AsyncIO::write(int fd, const void* p, size_t n, off_t offset) {
+    if (n)
+        queued_.push_back({op_write, fd, reinterpret_cast<const char*>(p), n, offset});
+}
+
+void AsyncIO::sync(int fd) {
+    queued_.push_back({op_sync, fd, nullptr, 0, 0});
+}
+
+void AsyncIO::submit() {
+    if (ring_)
+        submit_ring();
+    else
+        submit_fallback();
+}
+
+bool AsyncIO::wait() {
+    drain();
+    bool ok = !failed_;
+    failed_ = false;
+    return ok;
+}
+
+void AsyncIO::drain() {
+#if STO_HAVE_IO_URING
+    if (ring_) {
+        // reaping can queue the rest of a short write
+        for (submit_ring(); ring_->in_flight; submit_ring())
+            reap(true);
+        return;
+    }
+#endif
+    submit_fallback();
+}
+
+void AsyncIO::submit_ring() {
+#if STO_HAVE_IO_URING
+    ring& r = *ring_;
+    // reap() may append to queued_ while this runs
+    size_t i = 0;
+    while (i != queued_.size()) {
+        unsigned tail = *r.sq_tail, n = 0;
+        uint64_t bytes = 0, now = now_ns();
+        for (; i != queued_.size() && !r.free_slots.empty(); ++i, ++n) {
+            unsigned s = r.free_slots.back();
+            r.free_slots.pop_back();
+            ring::slot& sl = r.slots[s];
+            sl.o = queued_[i];
+            sl.start_ns = now;
+            unsigned idx = (tail + n) & *r.sq_mask;
+            io_uring_sqe* sqe = &r.sqes[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->fd = sl.o.fd;
+            sqe->user_data = s;
+            if (sl.o.kind == op_sync) {
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                sqe->flags = IOSQE_IO_DRAIN;
+            } else {
+                sqe->off = sl.o.offset;
+                int b = fixed_index(sl.o.p, sl.o.n);
+                if (b >= 0) {
+                    sqe->opcode = IORING_OP_WRITE_FIXED;
+                    sqe->addr = reinterpret_cast<uintptr_t>(sl.o.p);
+                    sqe->len = sl.o.n;
+                    sqe->buf_index = b;
+                } else {
+                    sl.iov = {const_cast<char*>(sl.o.p), sl.o.n};
+                    sqe->opcode = IORING_OP_WRITEV;
+                    sqe->addr = reinterpret_cast<uintptr_t>(&sl.iov);
+                    sqe->len = 1;
+                }
+                bytes += sl.o.n;
+            }
+            r.sq_array[idx] = idx;
+        }
+        if (n) {
+            __atomic_store_n(r.sq_tail, tail + n, __ATOMIC_RELEASE);
+            r.in_flight += n;
+            for (unsigned left = n; left; ) {
+                int k = r.enter(left, 0, 0);
+                if (k < 0) {
+                    always_assert(errno == EINTR || errno == EAGAIN || errno == EBUSY,
+                                  "io_uring_enter failed");
+                    std::this_thread::yield();
+                    continue;
+                }
+                left -= k;
+            }
+            account(n, bytes, r.in_flight, false);
+        }
+        if (i != queued_.size())
+            reap(true);
+    }
+    queued_.clear();
+#endif
+}
+
+void AsyncIO::reap(bool block) {
+#if STO_HAVE_IO_URING
+    ring& r = *ring_;
+    while (true) {
+        unsigned head = *r.cq_head;
+        unsigned tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+        if (head != tail) {
+            uint64_t now = now_ns();
+            for (; head != tail; ++head) {
+                const io_uring_cqe& c = r.cqes[head & *r.cq_mask];
+                ring::slot& sl = r.slots[c.user_data];
+                op o = sl.o;
+                int res = c.res;
+                account_latency(now - sl.start_ns);
+                r.free_slots.push_back(c.user_data);
+                --r.in_flight;
+                if (o.kind == op_write) {
+                    if (res == -EINTR || res == -EAGAIN)
+                        res = 0;
+                    else if (res <= 0) {
+                        failed_ = true;
+                        continue;
+                    }
+                    if (size_t(res) < o.n) {
+                        queued_.push_back({op_write, o.fd, o.p + res, o.n - res, o.offset + res});
+                        if (std::find(retry_fds_.begin(), retry_fds_.end(), o.fd) == retry_fds_.end())
+                            retry_fds_.push_back(o.fd);
+                    }
+                } else {
+                    if (res < 0)
+                        failed_ = true;
+                    // a write finished after this sync started; sync again
+                    auto it = std::find(retry_fds_.begin(), retry_fds_.end(), o.fd);
+                    if (it != retry_fds_.end()) {
+                        retry_fds_.erase(it);
+                        queued_.push_back({op_sync, o.fd, nullptr, 0, 0});
+                    }
+                }
+            }
+            __atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+            return;
+        }
+        if (!block || !r.in_flight)
+            return;
+        if (r.enter(0, 1, IORING_ENTER_GETEVENTS) < 0)
+            always_assert(errno == EINTR, "io_uring_enter failed");
+    }
+#else
+    (void) block;
+#endif
+}
+
+void AsyncIO::submit_fallback() {
+    if (queued_.empty())
+        return;
+    uint64_t bytes = 0;
+    size_t i = 0;
+    while (i != queued_.size()) {
+        const op& o = queued_[i];
+        uint64_t start = now_ns();
+        size_t j = i + 1;
+        if (o.kind == op_sync) {
+            if (fdatasync(o.fd) != 0)
+                failed_ = true;
+        } else {
+            // one call for the writes that continue this one
+            struct iovec iov[64];
+            int n = 0;
+            off_t end = o.offset;
+            for (j = i; j != queued_.size() && n != 64 && queued_[j].kind == op_write
+                     && queued_[j].fd == o.fd && queued_[j].offset == end; ++j, ++n) {
+                iov[n] = {const_cast<char*>(queued_[j].p), queued_[j].n};
+                end += queued_[j].n;
+                bytes += queued_[j].n;
+            }
+            if (!pwritev_all(o.fd, iov, n, o.offset))
+                failed_ = true;
+        }
+        uint64_t latency = now_ns() - start;
+        for (; i != j; ++i)
+            account_latency(latency);
+    }
+    account(queued_.size(), bytes, queued_.size(), true);
+    queued_.clear();
+}
+
+int AsyncIO::open_direct(const char* path, int flags, mode_t mode, bool* direct) {
+#ifdef O_DIRECT
+    int fd = ::open(path, flags | O_DIRECT, mode);
+    if (fd >= 0 || errno != EINVAL) {
+        if (direct)
+            *direct = fd >= 0;
+        return fd;
+    }
+#endif
+    if (direct)
+        *direct = false;
+    return ::open(path, flags, mode);
+}
+
+void AsyncIO::account(uint64_t ops, uint64_t bytes, uint64_t depth, bool fallback) {
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    if (fallback)
+        fallback_batches_.fetch_add(1, std::memory_order_relaxed);
+    ops_.fetch_add(ops, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    depth_sum_.fetch_add(depth, std::memory_order_relaxed);
+    raise_to(max_depth_, depth);
+}
+
+void AsyncIO::account_latency(uint64_t ns) {
+    latency_ns_.fetch_add(ns, std::memory_order_relaxed);
+    raise_to(max_latency_ns_, ns);
+}
+
+AsyncIO::stats AsyncIO::statistics() {
+    stats s;
+    s.batches = batches_.load(std::memory_order_relaxed);
+    s.fallback_batches = fallback_batches_.load(std::memory_order_relaxed);
+    s.ops = ops_.load(std::memory_order_relaxed);
+    s.bytes = bytes_.load(std::memory_order_relaxed);
+    s.depth_sum = depth_sum_.load(std::memory_order_relaxed);
+    s.max_depth = max_depth_.load(std::memory_order_relaxed);
+    s.latency_ns = latency_ns_.load(std::memory_order_relaxed);
+    s.max_latency_ns = max_latency_ns_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void AsyncIO::report(FILE* f) {
+    stats s = statistics();
+    if (!s.batches)
+        return;
+    fprintf(f, "$ async io: %llu ops, %.1f MB in %llu batches (%llu with pwritev); "
+            "queue depth %.1f (max %llu), completion %.1f us (max %.1f us)\n",
+            (unsigned long long) s.ops, s.bytes / 1e6, (unsigned long long) s.batches,
+            (unsigned long long) s.fallback_batches, s.avg_depth(),
+            (unsigned long long) s.max_depth, s.avg_latency_us(), s.max_latency_ns / 1e3);
+}
+
+void AsyncIO::report_json(std::ostream& out) {
+    stats s = statistics();
+    out << "{\"batches\": " << s.batches
+        << ", \"fallback_batches\": " << s.fallback_batches
+        << ", \"ops\": " << s.ops
+        << ", \"bytes\": " << s.bytes
+        << ", \"avg_depth\": " << s.avg_depth()
+        << ", \"max_depth\": " << s.max_depth
+        << ", \"avg_latency_us\": " << s.avg_latency_us()
+        << ", \"max_latency_us\": " << s.max_latency_ns / 1e3 << "}";
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Asynchronous file writes for the threads that make data durable: TxnLog
+// loggers, checkpoint part writers and MVCC snapshot dumpers.
+//
+// An AsyncIO belongs to one thread. write() and sync() queue operations,
+// submit() hands everything queued to the kernel as one batch and
+// returns, and wait() reaps the completions, resubmitting the rest of any
+// short write. A sync starts once every operation submitted before it has
+// completed, so a logger queues its round's buffers and an fdatasync,
+// submits them with one system call, and advances its durable epoch when
+// wait() returns true. A writer that double-buffers submits one block and
+// fills the next while the first is in flight.
+//
+// The engine is io_uring, set up through the raw system calls. Buffers
+// passed to register_buffers() are written with fixed-buffer writes, which
+// skip mapping the pages on every write; with a file from open_direct()
+// the data goes from the buffer to the device without a copy. Where
+// io_uring is unavailable (an older kernel, disabled by sysctl or seccomp,
+// or no <linux/io_uring.h> at build time), submit() does the batch itself
+// with pwritev, merging writes to consecutive offsets of a file into one
+// call, and fdatasync.
+//
+// Every engine adds to process-wide statistics: batches, operations, queue
+// depth at submission and completion latency, reported by
+// Transaction::print_stats() and print_stats_json().
+class AsyncIO {
+public:
+    static constexpr unsigned default_depth = 64;
+
+    // A ring of depth entries; with use_uring false, or if the ring can't
+    // be set up, the pwritev fallback
+    explicit AsyncIO(unsigned depth = default_depth, bool use_uring = true);
+    // Waits for the operations in flight
+    ~AsyncIO();
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    bool uring() const {
+        return ring_ != nullptr;
+    }
+
+    // Registers buffers for fixed-buffer writes, replacing any registered
+    // before; false if the kernel refuses them (e.g. over RLIMIT_MEMLOCK),
+    // in which case writes from them still work. Waits for the operations
+    // in flight.
+    bool register_buffers(const struct iovec* iov, unsigned n);
+
+    // Queues a write of n bytes at p to fd at offset; p must stay valid
+    // until wait() returns
+    void write(int fd, const void* p, size_t n, off_t offset);
+    // Queues an fdatasync of fd, after everything queued before it
+    void sync(int fd);
+    // Submits the queued operations
+    void submit();
+    // Submits the queued operations and waits for every operation to
+    // complete; false if one failed since the last wait()
+    bool wait();
+    bool flush() {
+        submit();
+        return wait();
+    }
+
+    // Opens path with O_DIRECT added to flags where the file system
+    // supports it, else without; *direct says which
+    static int open_direct(const char* path, int flags, mode_t mode, bool* direct = nullptr);
+
+    struct stats {
+        uint64_t batches = 0;
+        uint64_t fallback_batches = 0;  // of batches, done with pwritev
+        uint64_t ops = 0;
+        uint64_t bytes = 0;
+        uint64_t depth_sum = 0;         // operations in flight after each batch
+        uint64_t max_depth = 0;
+        uint64_t latency_ns = 0;        // submission to completion, summed
+        uint64_t max_latency_ns = 0;
+        double avg_depth() const {
+            return batches ? double(depth_sum) / batches : 0;
+        }
+        double avg_latency_us() const {
+            return ops ? latency_ns / 1e3 / ops : 0;
+        }
+    };
+    static stats statistics();
+    static void report(FILE* f);
+    static void report_json(std::ostream& out);
+
+private:
+    enum { op_write, op_sync };
+    struct op {
+        int kind;
+        int fd;
+        const char* p;
+        size_t n;
+        off_t offset;
+    };
+    struct ring;
+
+    ring* ring_;
+    std::vector<op> queued_;
+    std::vector<struct iovec> registered_;
+    std::vector<int> retry_fds_;    // fds with a resubmitted write since their last sync
+    bool failed_;
+
+    bool setup_ring(unsigned depth);
+    void drain();
+    void submit_ring();
+    void submit_fallback();
+    void reap(bool block);
+    int fixed_index(const char* p, size_t n) const;
+    static void account(uint64_t ops, uint64_t bytes, uint64_t depth, bool fallback);
+    static void account_latency(uint64_t ns);
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+#include "ConcurrencyControl.hh"
+#include "PlatformFeatures.hh"
+
+// Track the data cells of a row (all but cell 0) in one TransItem
+#ifndef STO_CELL_BITMAP
+#define STO_CELL_BITMAP 0
+#endif
+
+// Cell versions of an IndexValueContainer validated as one array. With
+// STO_CELL_BITMAP, an index keeps cell 0 on the row item and gives all other
+// cells of a row a single "cells item": its read value is a snapshot of the
+// versions of the cells it read, with a bitmap of those cells, and its write
+// value is the bitmap of cells written. check() compares every read cell in
+// one vector pass instead of one TransItem per cell.
+//
+// Only versions validated by value alone (plain OCC, see supports_ro_observe)
+// qualify: a cell passes if its version is unchanged and it is not locked,
+// unless this transaction holds the lock because it wrote the cell.
+
+namespace cell_versions {
+
+typedef TransactionTid::type type;
+
+template <typename VersImpl>
+struct supported : std::integral_constant<bool, supports_ro_observe<VersImpl>::value
+                                                && sizeof(VersImpl) == sizeof(type)> {};
+
+template <size_t N>
+struct snapshot {
+    uint64_t cells = 0;
+    type versions[N] = {};
+};
+
+static constexpr type value_mask = ~(TransactionTid::increment_value - 1);
+
+// Kernels: true if every cell in read has the version in snap and is either
+// unlocked or in owned. cur and snap hold n versions; bits past n are clear.
+typedef bool (*check_type)(const type* cur, const type* snap, unsigned n, uint64_t read, uint64_t owned);
+
+inline bool check_scalar(const type* cur, const type* snap, unsigned n, uint64_t read, uint64_t owned) {
+    (void)n;
+    type bad = 0;
+    for (; read; read &= read - 1) {
+        unsigned c = __builtin_ctzll(read);
+        type own = ((owned >> c) & 1) ? 0 : TransactionTid::lock_bit;
+        bad |= ((cur[c] ^ snap[c]) & value_mask) | (cur[c] & own);
+    }
+    return bad == 0;
+}
+
+__attribute__((target("avx2")))
+inline bool check_avx2(const type* cur, const type* snap, unsigned n, uint64_t read, uint64_t owned) {
+    const __m256i lane_bits = _mm256_set_epi64x(8, 4, 2, 1);
+    const __m256i vmask = _mm256_set1_epi64x(static_cast<long long>(value_mask));
+    const __m256i lock = _mm256_set1_epi64x(static_cast<long long>(TransactionTid::lock_bit));
+    __m256i bad = _mm256_setzero_si256();
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i r = _mm256_and_si256(_mm256_set1_epi64x(static_cast<long long>(read >> i)), lane_bits);
+        __m256i o = _mm256_and_si256(_mm256_set1_epi64x(static_cast<long long>(owned >> i)), lane_bits);
+        r = _mm256_cmpeq_epi64(r, lane_bits);
+        o = _mm256_cmpeq_epi64(o, lane_bits);
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + i));
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(snap + i));
+        __m256i d = _mm256_or_si256(_mm256_and_si256(_mm256_xor_si256(c, s), vmask),
+                                    _mm256_andnot_si256(o, _mm256_and_si256(c, lock)));
+        bad = _mm256_or_si256(bad, _mm256_and_si256(d, r));
+    }
+    if (!_mm256_testz_si256(bad, bad))
+        return false;
+    return i == n || check_scalar(cur + i, snap + i, n - i, read >> i, owned >> i);
+}
+
+inline check_type select_check() {
+    return cpu_simd_level() == SimdLevel::scalar ? check_scalar : check_avx2;
+}
+
+inline const check_type check_kernel = select_check();
+
+// Range kernels: true if each of n versions, stride words apart from cur,
+// matches snap and is unlocked or locked by thread here. Arrays whose
+// elements interleave versions and values use these to validate a range
+// read as one item.
+typedef bool (*check_range_type)(const type* cur, size_t stride, const type* snap, unsigned n, int here);
+
+inline bool check_range_scalar(const type* cur, size_t stride, const type* snap, unsigned n, int here) {
+    const type mine = TransactionTid::lock_bit | here;
+    type bad = 0;
+    for (unsigned i = 0; i != n; ++i, cur += stride) {
+        type c = *cur;
+        bool foreign = (c & TransactionTid::lock_bit)
+            && (c & (TransactionTid::lock_bit | TransactionTid::threadid_mask)) != mine;
+        bad |= ((c ^ snap[i]) & value_mask) | type(foreign);
+    }
+    return bad == 0;
+}
+
+__attribute__((target("avx2")))
+inline bool check_range_avx2(const type* cur, size_t stride, const type* snap, unsigned n, int here) {
+    const __m256i vmask = _mm256_set1_epi64x(static_cast<long long>(value_mask));
+    const __m256i lock = _mm256_set1_epi64x(static_cast<long long>(TransactionTid::lock_bit));
+    const __m256i owner_mask = _mm256_set1_epi64x(static_cast<long long>(TransactionTid::lock_bit | TransactionTid::threadid_mask));
+    const __m256i mine = _mm256_set1_epi64x(static_cast<long long>(TransactionTid::lock_bit | here));
+    const long long s = stride;
+    const __m256i offsets = _mm256_set_epi64x(3 * s, 2 * s, s, 0);
+    __m256i bad = _mm256_setzero_si256();
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4, cur += 4 * stride) {
+        __m256i c = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(cur), offsets, 8);
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(snap + i));
+        __m256i o = _mm256_cmpeq_epi64(_mm256_and_si256(c, owner_mask), mine);
+        __m256i d = _mm256_or_si256(_mm256_and_si256(_mm256_xor_si256(c, v), vmask),
+                                    _mm256_andnot_si256(o, _mm256_and_si256(c, lock)));
+        bad = _mm256_or_si256(bad, d);
+    }
+    if (!_mm256_testz_si256(bad, bad))
+        return false;
+    return i == n || check_range_scalar(cur, stride, snap + i, n - i, here);
+}
+
+inline check_range_type select_check_range() {
+    return cpu_simd_level() == SimdLevel::scalar ? check_range_scalar : check_range_avx2;
+}
+
+inline const check_range_type check_range_kernel = select_check_range();
+
+// Helpers over a row container C (IndexValueContainer) and its cells item
+
+template <typename C>
+const type* words(C& c) {
+    // Instantiated for every container by the indexes' TObject methods, but
+    // only reached when the container has a cell bitmap
+    assert(supported<typename C::version_type>::value);
+    return reinterpret_cast<const type*>(&c.version_at(0));
+}
+
+inline uint64_t written(const TransItem& item) {
+    return item.has_write() ? item.write_value<uint64_t>() : 0;
+}
+
+// Snapshots the version of cell (if not yet read) and checks it is readable
+template <typename C>
+bool observe(TransProxy item, C& c, int cell) {
+    constexpr size_t N = C::num_versions;
+    auto& vers = c.version_at(cell);
+    type v = vers.value();
+    fence();
+    if (!vers.observe_read(item.item(), false))
+        return false;
+    if (!item.has_read()) {
+        bool ok;
+        if (std::is_same<typename C::version_type, TNonopaqueVersion>::value)
+            ok = item.add_read(snapshot<N>());
+        else
+            ok = item.add_read_opaque(snapshot<N>());
+        if (!ok)
+            return false;
+    }
+    auto& s = item.template read_value<snapshot<N>>();
+    if (!(s.cells & (uint64_t(1) << cell))) {
+        s.cells |= uint64_t(1) << cell;
+        s.versions[cell] = v;
+    }
+    return true;
+}
+
+inline void add_write(TransProxy item, int cell) {
+    item.add_write(written(item.item()) | (uint64_t(1) << cell));
+}
+
+template <typename F>
+void for_each(uint64_t cells, F f) {
+    for (; cells; cells &= cells - 1)
+        f(__builtin_ctzll(cells));
+}
+
+// Locks the written cells in order, releasing them all if one fails
+template <typename C>
+bool lock(Transaction& txn, TransItem& item, C& c) {
+    uint64_t cells = written(item), locked = 0;
+    for (; cells; cells &= cells - 1) {
+        int cell = __builtin_ctzll(cells);
+        if (!txn.try_lock(item, c.version_at(cell))) {
+            for_each(locked, [&](int l) { c.version_at(l).cp_unlock(item); });
+            return false;
+        }
+        locked |= uint64_t(1) << cell;
+    }
+    return true;
+}
+
+template <typename C>
+bool check(TransItem& item, C& c) {
+    auto& s = item.read_value<snapshot<C::num_versions>>();
+    return check_kernel(words(c), s.versions, C::num_versions, s.cells, written(item));
+}
+
+template <typename C>
+void unlock(TransItem& item, C& c) {
+    for_each(written(item), [&](int cell) { c.version_at(cell).cp_unlock(item); });
+}
+
+template <typename C>
+void set_version_unlock(Transaction& txn, TransItem& item, C& c) {
+    for_each(written(item), [&](int cell) { txn.set_version_unlock(c.version_at(cell), item); });
+}
+
+} // namespace cell_versions
@@ -0,0 +1,292 @@
+// Commutators assembled from per-column commutative operations
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <tuple>
+#include <utility>
+
+#include "Commutators.hh"
+#include "PlatformFeatures.hh"
+
+namespace commutators {
+
+// ColumnCommutator<T, Ops...> updates one column of a row of type T per
+// operation in Ops, each naming its column by member pointer:
+//
+//   col_add<&T::c>                c += x
+//   col_min<&T::c>                c = min(c, x)
+//   col_max<&T::c>                c = max(c, x)
+//   col_bounded_add<&T::c, L, H>  c = clamp(c + x, L, H)
+//   col_append<&T::c, N>          appends up to N bytes to the string c,
+//                                 truncated at c's max_length
+//
+// The constructor takes one operand per operation, in order. Every
+// operation folds, so a row's commutator is foldable (see is_foldable):
+// MvHistory::flatten combines a run of committed deltas into one and
+// applies it once. The numeric operands live in int64_t lanes, folded
+// a vector at a time by lanes::fold_kernel. bounded_add operands fold only
+// if they have the same sign, and appends only while they fit in N; fold
+// returns false otherwise. Codegen emits these from @commute annotations.
+//
+// A Commutator<T> specialization inherits the ColumnCommutator and its
+// constructors.
+
+namespace lanes {
+
+enum class op : int { add = 0, min, max };
+
+// Lane masks, all ones where a lane folds by that operation
+struct masks {
+    const int64_t* add;
+    const int64_t* min;
+    const int64_t* max;
+};
+
+// Kernels: acc[i] = op_i(acc[i], next[i]) for n lanes, n a multiple of 4
+typedef void (*fold_type)(int64_t* acc, const int64_t* next, const masks& m, size_t n);
+
+inline void fold_scalar(int64_t* acc, const int64_t* next, const masks& m, size_t n) {
+    for (size_t i = 0; i != n; ++i) {
+        int64_t a = acc[i], b = next[i];
+        int64_t sum = int64_t(uint64_t(a) + uint64_t(b));
+        acc[i] = (sum & m.add[i]) | (std::min(a, b) & m.min[i]) | (std::max(a, b) & m.max[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+inline void fold_avx2(int64_t* acc, const int64_t* next, const masks& m, size_t n) {
+    for (size_t i = 0; i != n; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(next + i));
+        __m256i gt = _mm256_cmpgt_epi64(a, b);
+        __m256i sum = _mm256_add_epi64(a, b);
+        __m256i mn = _mm256_blendv_epi8(a, b, gt);
+        __m256i mx = _mm256_blendv_epi8(b, a, gt);
+        __m256i r = _mm256_and_si256(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m.add + i)));
+        r = _mm256_or_si256(r, _mm256_and_si256(mn, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m.min + i))));
+        r = _mm256_or_si256(r, _mm256_and_si256(mx, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m.max + i))));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), r);
+    }
+}
+
+inline fold_type select_fold() {
+    return cpu_simd_level() == SimdLevel::scalar ? fold_scalar : fold_avx2;
+}
+
+inline const fold_type fold_kernel = select_fold();
+
+} // namespace lanes
+
+// Operand storage of the operations that don't use a lane
+struct no_log {
+    bool combines(const no_log&) const {
+        return true;
+    }
+    void fold(const no_log&) {
+    }
+};
+
+template <auto Member, lanes::op Op, int64_t Identity>
+struct lane_column_op {
+    static constexpr bool lane = true;
+    static constexpr lanes::op kind = Op;
+    static constexpr int64_t identity = Identity;
+    typedef int64_t operand_type;
+    typedef no_log log_type;
+
+    static bool combines(int64_t, int64_t) {
+        return true;
+    }
+    static void set(int64_t& x, no_log&, int64_t operand) {
+        x = operand;
+    }
+};
+
+template <auto Member>
+struct col_add : lane_column_op<Member, lanes::op::add, 0> {
+    template <typename T>
+    static void apply(T& row, int64_t x, const no_log&) {
+        row.*Member += x;
+    }
+};
+
+template <auto Member>
+struct col_min : lane_column_op<Member, lanes::op::min, INT64_MAX> {
+    template <typename T>
+    static void apply(T& row, int64_t x, const no_log&) {
+        if (x < row.*Member)
+            row.*Member = x;
+    }
+};
+
+template <auto Member>
+struct col_max : lane_column_op<Member, lanes::op::max, INT64_MIN> {
+    template <typename T>
+    static void apply(T& row, int64_t x, const no_log&) {
+        if (x > row.*Member)
+            row.*Member = x;
+    }
+};
+
+// Adds of one sign compose into one clamped add, as long as the column
+// starts out within [Lo, Hi]
+template <auto Member, int64_t Lo, int64_t Hi>
+struct col_bounded_add : lane_column_op<Member, lanes::op::add, 0> {
+    static bool combines(int64_t a, int64_t b) {
+        return a == 0 || b == 0 || (a < 0) == (b < 0);
+    }
+    template <typename T>
+    static void apply(T& row, int64_t x, const no_log&) {
+        row.*Member = std::clamp<int64_t>(int64_t(row.*Member) + x, Lo, Hi);
+    }
+};
+
+template <size_t N>
+struct append_log {
+    uint32_t len = 0;
+    char buf[N];
+
+    bool combines(const append_log& next) const {
+        return len + next.len <= N;
+    }
+    void fold(const append_log& next) {
+        memcpy(buf + len, next.buf, next.len);
+        len += next.len;
+    }
+};
+
+template <auto Member, size_t N>
+struct col_append {
+    static constexpr bool lane = false;
+    static constexpr lanes::op kind = lanes::op::add;
+    static constexpr int64_t identity = 0;
+    typedef const char* operand_type;
+    typedef append_log<N> log_type;
+
+    static bool combines(int64_t, int64_t) {
+        return true;
+    }
+    static void set(int64_t&, log_type& log, const char* s) {
+        log.len = strnlen(s, N);
+        memcpy(log.buf, s, log.len);
+    }
+    template <typename T>
+    static void apply(T& row, int64_t, const log_type& log) {
+        auto& s = row.*Member;
+        size_t l = s.length();
+        size_t m = std::min(size_t(log.len), s.max_length - l);
+        memcpy(s.c_str() + l, log.buf, m);
+        s.c_str()[l + m] = '\0';
+    }
+};
+
+// Lane assignment of a list of operations: one lane per lane operation,
+// in order, padded to whole vectors. Padding lanes add, so they stay zero.
+template <typename... Ops>
+struct lane_layout {
+    static constexpr size_t num_ops = sizeof...(Ops);
+    static constexpr std::array<bool, num_ops> is_lane = {Ops::lane...};
+    static constexpr std::array<lanes::op, num_ops> kinds = {Ops::kind...};
+    static constexpr size_t num_lanes = (size_t(0) + ... + size_t(Ops::lane));
+    static constexpr size_t words = std::max<size_t>(4, (num_lanes + 3) & ~size_t(3));
+
+    struct mask_table {
+        int64_t add[words] = {};
+        int64_t min[words] = {};
+        int64_t max[words] = {};
+    };
+
+    static constexpr size_t lane_of(size_t i) {
+        size_t l = 0;
+        for (size_t j = 0; j != i; ++j)
+            l += is_lane[j];
+        return l;
+    }
+    static constexpr mask_table make_masks() {
+        mask_table t;
+        for (size_t l = 0; l != words; ++l)
+            t.add[l] = -1;
+        for (size_t i = 0; i != num_ops; ++i)
+            if (is_lane[i]) {
+                size_t l = lane_of(i);
+                t.add[l] = kinds[i] == lanes::op::add ? -1 : 0;
+                t.min[l] = kinds[i] == lanes::op::min ? -1 : 0;
+                t.max[l] = kinds[i] == lanes::op::max ? -1 : 0;
+            }
+        return t;
+    }
+
+    static constexpr mask_table mask_values = make_masks();
+    static constexpr lanes::masks masks = {mask_values.add, mask_values.min, mask_values.max};
+};
+
+template <typename T, typename... Ops>
+class ColumnCommutator {
+    typedef lane_layout<Ops...> layout;
+
+public:
+    // The commutator that changes nothing
+    ColumnCommutator() {
+        init(std::index_sequence_for<Ops...>());
+    }
+    explicit ColumnCommutator(typename Ops::operand_type... operands) {
+        init(std::index_sequence_for<Ops...>());
+        set(std::index_sequence_for<Ops...>(), operands...);
+    }
+
+    void operate(T& row) const {
+        apply(row, std::index_sequence_for<Ops...>());
+    }
+
+    bool fold(const ColumnCommutator& next) {
+        if (!combines(next, std::index_sequence_for<Ops...>()))
+            return false;
+        lanes::fold_kernel(lanes_, next.lanes_, layout::masks, layout::words);
+        fold_logs(next, std::index_sequence_for<Ops...>());
+        return true;
+    }
+
+private:
+    int64_t lanes_[layout::words];
+    std::tuple<typename Ops::log_type...> logs_;
+
+    template <size_t I>
+    int64_t& lane() {
+        return lanes_[layout::lane_of(I)];
+    }
+    template <size_t I>
+    int64_t lane() const {
+        return layout::is_lane[I] ? lanes_[layout::lane_of(I)] : 0;
+    }
+
+    template <size_t... I>
+    void init(std::index_sequence<I...>) {
+        std::fill(lanes_, lanes_ + layout::words, 0);
+        ((layout::is_lane[I] ? void(lane<I>() = Ops::identity) : void()), ...);
+    }
+    template <size_t... I>
+    void set(std::index_sequence<I...>, typename Ops::operand_type... operands) {
+        int64_t scratch;
+        (Ops::set(layout::is_lane[I] ? lane<I>() : scratch, std::get<I>(logs_), operands), ...);
+    }
+    template <size_t... I>
+    void apply(T& row, std::index_sequence<I...>) const {
+        (Ops::apply(row, lane<I>(), std::get<I>(logs_)), ...);
+    }
+    template <size_t... I>
+    bool combines(const ColumnCommutator& next, std::index_sequence<I...>) const {
+        return ((Ops::combines(lane<I>(), next.template lane<I>())
+                 && std::get<I>(logs_).combines(std::get<I>(next.logs_))) && ...);
+    }
+    template <size_t... I>
+    void fold_logs(const ColumnCommutator& next, std::index_sequence<I...>) {
+        (std::get<I>(logs_).fold(std::get<I>(next.logs_)), ...);
+    }
+};
+
+}
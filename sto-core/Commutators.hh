@@ -2,10 +2,24 @@
 
 #pragma once
 
+#include <type_traits>
+#include <utility>
+
 #include "MVCCTypes.hh"
 
 namespace commutators {
 
+// A commutator may define `bool fold(const Commutator& next)`, which
+// absorbs a later update to the same object so that a transaction
+// updating an object twice carries one commutator. fold returns false,
+// and leaves *this alone, if the two updates don't combine.
+template <typename C, typename = void>
+struct is_foldable : std::false_type {};
+
+template <typename C>
+struct is_foldable<C, std::void_t<decltype(std::declval<C&>().fold(std::declval<const C&>()))>>
+    : std::true_type {};
+
 template <typename T>
 class Commutator {
 public:
@@ -37,8 +51,94 @@ public:
         v += delta;
     }
 
+    bool fold(const Commutator& next) {
+        delta += next.delta;
+        return true;
+    }
+
 private:
     int64_t delta;
 };
 
+//////////////////////////////////////////////
+//
+// Combining slot for commutative int64_t deltas
+//
+//////////////////////////////////////////////
+
+// Lets blind commutative writers to one object share a single hold of its
+// version lock instead of taking turns. The first writer to enter locks
+// the version; later writers join while it is held (up to join_limit per
+// hold). Committing writers post their deltas, and the last one to leave
+// applies the combined delta, sets the version to the largest posted tid
+// and unlocks. Readers see the version locked for the whole hold.
+//
+// try_enter() belongs in lock(), post() in install(), leave() in unlock().
+// Only for items without reads: a writer that also read the object must
+// take the version lock itself, and it simply finds it locked.
+template <typename VersImpl>
+class DeltaCombiner {
+public:
+    typedef TransactionTid::type tid_type;
+    static constexpr uint64_t join_limit = 64;
+
+    DeltaCombiner()
+        : state_(0), pending_(0), tid_(0) {
+    }
+
+    // False if the version is locked by someone outside the group, or the
+    // group is full; callers spin and retry like any commit lock.
+    bool try_enter(TransItem& item, VersImpl& vers) {
+        uint64_t s = state_.load(std::memory_order_acquire);
+        while (holders(s) != 0) {
+            if (joins(s) >= join_limit)
+                return false;
+            if (state_.compare_exchange_weak(s, s + join_one + 1,
+                                             std::memory_order_acq_rel))
+                return true;
+        }
+        if (!vers.cp_try_lock(item, TThread::id()))
+            return false;
+        state_.store(join_one + 1, std::memory_order_release);
+        return true;
+    }
+
+    void post(const Commutator<int64_t>& c, tid_type tid) {
+        int64_t delta = 0;
+        c.operate(delta);
+        pending_.fetch_add(delta, std::memory_order_relaxed);
+        tid_type t = tid_.load(std::memory_order_relaxed);
+        while (t < tid && !tid_.compare_exchange_weak(t, tid, std::memory_order_relaxed))
+            ;
+    }
+
+    void leave(TransItem& item, VersImpl& vers, int64_t& value) {
+        uint64_t s = state_.fetch_sub(1, std::memory_order_acq_rel);
+        if (holders(s) != 1)
+            return;
+        // last out: nobody can join until the version is unlocked
+        tid_type tid = tid_.exchange(0, std::memory_order_relaxed);
+        if (tid) {
+            Commutator<int64_t>(pending_.exchange(0, std::memory_order_relaxed)).operate(value);
+            vers.cp_set_version_unlock(tid);
+        } else
+            vers.cp_unlock(item);
+    }
+
+private:
+    static constexpr uint64_t join_one = uint64_t(1) << 32;
+
+    // low word: current holders; high word: joins during this hold
+    std::atomic<uint64_t> state_;
+    std::atomic<int64_t> pending_;
+    std::atomic<tid_type> tid_;
+
+    static uint64_t holders(uint64_t s) {
+        return s & (join_one - 1);
+    }
+    static uint64_t joins(uint64_t s) {
+        return s >> 32;
+    }
+};
+
 }
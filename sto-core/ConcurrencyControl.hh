@@ -36,6 +36,9 @@ class VersionDelegate {
     static void txn_set_any_nonopaque(Transaction& txn, bool val) {
         txn.any_nonopaque_ = val;
     }
+    static void txn_observe_tid(Transaction& txn, TransactionTid::type v) {
+        txn.observe_tid(v);
+    }
 
     static TransactionTid::type& standard_tid(Transaction& txn) {
         return txn.commit_tid_;
@@ -121,6 +124,24 @@ inline TransProxy& TransProxy::add_write(Args&&... args) {
     return *this;
 }
 
+template <typename T, typename... Args>
+inline T& TransProxy::emplace_write(Args&&... args) {
+    if (has_commute()) {
+        clear_commute();
+    }
+    if (!has_write()) {
+        item().__or_flags(TransItem::write_bit);
+        if constexpr (Packer<T>::is_simple)
+            item().wdata_ = Packer<T>::pack(t()->buf_, T(std::forward<Args>(args)...));
+        else
+            item().wdata_ = Packer<T>::pack(t()->buf_, std::forward<Args>(args)...);
+        t()->any_writes_ = true;
+    } else {
+        item().wdata_ = Packer<T>::repack(t()->buf_, item().wdata_, T(std::forward<Args>(args)...));
+    }
+    return Packer<T>::unpack(item().wdata_);
+}
+
 // Helper function accessing the transaction object on this thread
 static inline Transaction& t() {
     return *TThread::txn;
@@ -165,6 +186,7 @@ inline bool TVersion::observe_read_impl(TransItem &item, bool add_read){
         return false;
     if (add_read && !item.has_read()) {
         VersionDelegate::item_or_flags(item, TransItem::read_bit);
+        VersionDelegate::txn_observe_tid(t(), version.value());
         VersionDelegate::item_access_rdata(item).v = Packer<TVersion>::pack(t().buf_, std::move(version));
         //item().__or_flags(TransItem::read_bit);
         //item().rdata_ = Packer<TVersion>::pack(t()->buf_, std::move(version));
@@ -186,6 +208,7 @@ inline bool TNonopaqueVersion::observe_read_impl(TransItem& item, bool add_read)
     }
     if (add_read && !item.has_read()) {
         VersionDelegate::item_or_flags(item, TransItem::read_bit);
+        VersionDelegate::txn_observe_tid(t(), version.value());
         VersionDelegate::item_access_rdata(item).v = Packer<TNonopaqueVersion>::pack(t().buf_, std::move(version));
         VersionDelegate::txn_set_any_nonopaque(t(), true);
         //item().__or_flags(TransItem::read_bit);
@@ -198,15 +221,31 @@ inline bool TNonopaqueVersion::observe_read_impl(TransItem& item, bool add_read)
 
 // Adaptive Reader/Writer lock concurrency control
 
+// 2PL wait-die: past the spin bound, an older transaction keeps waiting
+// for the lock and a younger one aborts (see ContentionManager::wait_for_lock)
+template <bool Adaptive>
+inline bool TLockVersion<Adaptive>::wait_past_bound() {
+#if CONTENTION_REGULATION
+    if (!Adaptive)
+        return ContentionManager::wait_for_lock(lock_owner());
+#endif
+    return false;
+}
+
 template <bool Adaptive>
 inline bool TLockVersion<Adaptive>::try_upgrade_with_spin() {
     uint64_t n = 0;
+    PhaseProfile::wait_timer wt(ph_lock_spin);
     while (true) {
         if (try_upgrade() == LockResponse::locked)
             return true;
+        wt.waiting();
         ++n;
-        if (n == (1 << STO_SPIN_BOUND_WRITE))
-            return false;
+        if (n == (1 << STO_SPIN_BOUND_WRITE)) {
+            if (!wait_past_bound())
+                return false;
+            n = 0;
+        }
         relax_fence();
     }
 }
@@ -214,6 +253,7 @@ inline bool TLockVersion<Adaptive>::try_upgrade_with_spin() {
 template <bool Adaptive>
 inline bool TLockVersion<Adaptive>::try_lock_write_with_spin() {
     uint64_t n = 0;
+    PhaseProfile::wait_timer wt(ph_lock_spin);
     while (true) {
         auto r = try_lock_write();
         if (r == LockResponse::locked)
@@ -222,8 +262,12 @@ inline bool TLockVersion<Adaptive>::try_lock_write_with_spin() {
             ++n;
         else
             return false;
-        if (n == (1 << STO_SPIN_BOUND_WRITE))
-            return false;
+        wt.waiting();
+        if (n == (1 << STO_SPIN_BOUND_WRITE)) {
+            if (!wait_past_bound())
+                return false;
+            n = 0;
+        }
         relax_fence();
     }
 }
@@ -232,14 +276,20 @@ template <bool Adaptive>
 inline std::pair<LockResponse, typename TLockVersion<Adaptive>::type>
 TLockVersion<Adaptive>::try_lock_read_with_spin() {
     uint64_t n = 0;
+    PhaseProfile::wait_timer wt(ph_lock_spin);
     while (true) {
         auto r = try_lock_read();
         if (r.first != LockResponse::spin) {
             return r;
         }
+        wt.waiting();
         ++n;
-        if (n == (1 << STO_SPIN_BOUND_WRITE))
-            return {LockResponse::failed, type()};
+        if (n == (1 << STO_SPIN_BOUND_WRITE)) {
+            if (!wait_past_bound())
+                return {LockResponse::failed, type()};
+            n = 0;
+        }
+        relax_fence();
     }
 }
 
@@ -310,6 +360,9 @@ inline bool TLockVersion<Adaptive>::observe_read_impl(TransItem& item, bool add_
 
     TLockVersion occ_version;
 
+    if (Adaptive && add_read && !item.has_read())
+        record_unlocked(TLockModeStats::read_delta);
+
     bool optimistic;
     auto init_mode = item.cc_mode();
     if (init_mode != CCMode::none) {
@@ -333,6 +386,8 @@ inline bool TLockVersion<Adaptive>::observe_read_impl(TransItem& item, bool add_
         } else if (response.first == LockResponse::locked) {
             VersionDelegate::item_or_flags(item, TransItem::lock_bit);
             VersionDelegate::item_or_flags(item, TransItem::read_bit);
+            // commit-time check compares against the version we locked
+            VersionDelegate::item_access_rdata(item).v = Packer<TLockVersion>::pack(t().buf_, TLockVersion(response.second));
             // XXX hack to prevent the commit protocol from skipping unlocks
             VersionDelegate::txn_set_any_nonopaque(t(), true);
         } else {
@@ -357,6 +412,7 @@ inline bool TLockVersion<Adaptive>::observe_read_impl(TransItem& item, bool add_
         //    return false;
         if (add_read && !item.has_read()) {
             VersionDelegate::item_or_flags(item, TransItem::read_bit);
+            VersionDelegate::txn_observe_tid(t(), occ_version.value());
             VersionDelegate::item_access_rdata(item).v = Packer<TLockVersion>::pack(t().buf_, std::move(occ_version));
             VersionDelegate::txn_set_any_nonopaque(t(), true);
             //item().rdata_ = Packer<TLockVersion>::pack(t()->buf_, std::move(occ_version));
@@ -460,6 +516,7 @@ inline bool TSwissVersion<Opaque>::observe_read_impl(TransItem& item, bool add_r
     }
     if (add_read && !item.has_read()) {
         VersionDelegate::item_or_flags(item, TransItem::read_bit);
+        VersionDelegate::txn_observe_tid(t(), version.value());
         VersionDelegate::item_access_rdata(item).v = Packer<TSwissVersion<Opaque>>::pack(t().buf_, std::move(version));
         if (!is_opaque)
             VersionDelegate::txn_set_any_nonopaque(t(), true);
@@ -535,6 +592,8 @@ inline bool TicTocVersion<Opaque, Extend>::observe_read_impl(TransItem& item, bo
         }
         VersionDelegate::item_or_flags(item, TransItem::read_bit);
         TicTocTid::pack_wide(item.wide_read_value(), BV::v_, wts_);
+        // fold the read into the commit timestamp now, not in try_commit
+        item.tictoc_extract_read_ts<TicTocVersion>().compute_commit_ts_step(VersionDelegate::tictoc_tid(t()), false /* !write */);
         //item().__or_flags(TransItem::observe_bit);
         //item().rdata_ = Packer<TicTocVersion>::pack(t()->buf_, std::move(version));
     }
@@ -555,6 +614,7 @@ inline bool TicTocVersion<Opaque, Extend>::observe_read_impl(TransItem& item, Ti
         VersionDelegate::txn_set_any_nonopaque(t(), true);
         VersionDelegate::item_or_flags(item, TransItem::read_bit);
         TicTocTid::pack_wide(item.wide_read_value(), snapshot.v_, snapshot.wts_);
+        snapshot.compute_commit_ts_step(VersionDelegate::tictoc_tid(t()), false /* !write */);
     }
     return true;
 }
@@ -629,6 +689,7 @@ inline bool TicTocCompressedVersion<Opaque, Extend>::observe_read_impl(TransItem
         VersionDelegate::item_or_flags(item, TransItem::read_bit);
         acquire_fence();
         item.wide_read_value().v0 = v_;
+        item.tictoc_extract_read_ts<TicTocCompressedVersion>().compute_commit_ts_step(VersionDelegate::tictoc_tid(t()), false /* !write */);
         //item().__or_flags(TransItem::observe_bit);
         //item().rdata_ = Packer<TicTocVersion>::pack(t()->buf_, std::move(version));
     }
@@ -767,12 +828,26 @@ inline bool Transaction::try_lock(TransItem& item, VersionBase<VersImpl>& vers)
     // This function will eventually help us track the commit TID when we
     // have no opacity, or for GV7 opacity.
     unsigned n = 0;
+    PhaseProfile::wait_timer wt(ph_lock_spin);
     while (true) {
         if (vers.cp_try_lock(item, threadid_)) {
             locked = true;
             break;
         }
+        wt.waiting();
         ++n;
+        if (sorted_locking_ && state_ == s_committing_locked) {
+            // commit locks are taken in owner order; wait rather than abort
+            if (n == (1U << STO_SPIN_BOUND_SORTED)) {
+# if STO_DEBUG_ABORTS
+                abort_version_ = vers.value();
+# endif
+                locked = false;
+                break;
+            }
+            relax_fence();
+            continue;
+        }
 # if STO_SPIN_EXPBACKOFF
         if (item.has_read() || n == STO_SPIN_BOUND_WRITE) {
 #  if STO_DEBUG_ABORTS
@@ -802,6 +877,7 @@ inline bool Transaction::try_lock(TransItem& item, VersionBase<VersImpl>& vers)
             vers.compute_commit_ts_step(this->tictoc_tid_, true/* write */);
         } else {
             vers.compute_commit_ts_step(this->commit_tid_, true/* write */);
+            observe_tid(vers.value());
         }
     }
     return locked;
@@ -810,9 +886,10 @@ inline bool Transaction::try_lock(TransItem& item, VersionBase<VersImpl>& vers)
 inline Transaction::tid_type Transaction::compute_tictoc_commit_ts() const {
     //assert(state_ == s_committing_locked || state_ == s_committing);
     tid_type commit_ts = 0;
+#if !STO_COMPACT_ITEMS
     TransItem* it = nullptr;
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
-        it = (tidx % tset_chunk ? it + 1 : tset_[tidx/tset_chunk]);
+        it = &tset_[tidx];
         if (it->cc_mode() == CCMode::tictoc) {
             bool compressed = it->is_tictoc_compressed();
             tid_type t;
@@ -827,5 +904,6 @@ inline Transaction::tid_type Transaction::compute_tictoc_commit_ts() const {
             commit_ts = std::max(commit_ts, t);
         }
     }
+#endif
     return commit_ts;
 }
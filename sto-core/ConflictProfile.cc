@@ -0,0 +1,99 @@
+#include "ConflictProfile.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <string>
+#include <typeinfo>
+#include "Transaction.hh"
+
+bool ConflictProfile::enabled_ = false;
+unsigned ConflictProfile::key_buckets_ = 0;
+ConflictProfile::sketch ConflictProfile::sketches_[MAX_THREADS];
+
+static void sketch_add(ConflictProfile::entry* es, unsigned& n, const ConflictProfile::entry& e) {
+    unsigned min = 0;
+    for (unsigned i = 0; i != n; ++i) {
+        if (es[i].object == e.object && es[i].key == e.key) {
+            ++es[i].count;
+            es[i].reason = e.reason;
+            return;
+        }
+        if (es[i].count < es[min].count)
+            min = i;
+    }
+    if (n != ConflictProfile::sketch_size) {
+        es[n++] = e;
+        return;
+    }
+    // evict the smallest entry; the newcomer may have had up to its count
+    uint64_t c = es[min].count;
+    es[min] = e;
+    es[min].count = c + 1;
+    es[min].err = c;
+}
+
+void ConflictProfile::record_slow(int threadid, const TObject* object, uint64_t key, const char* reason) {
+    sketch& s = sketches_[threadid];
+    if (key_buckets_)
+        key = (key * 0x9E3779B97F4A7C15ULL >> 32) % key_buckets_;
+    entry e = {object, 0, typeid(*object).name(), reason, 1, 0};
+    sketch_add(s.objects, s.nobjects, e);
+    e.key = key;
+    sketch_add(s.keys, s.nkeys, e);
+}
+
+std::vector<ConflictProfile::entry> ConflictProfile::top(unsigned n, bool by_key) {
+    std::vector<entry> out;
+    for (auto& s : sketches_) {
+        const entry* es = by_key ? s.keys : s.objects;
+        unsigned ns = by_key ? s.nkeys : s.nobjects;
+        for (unsigned i = 0; i != ns; ++i) {
+            auto it = std::find_if(out.begin(), out.end(), [&](const entry& x) {
+                    return x.object == es[i].object && x.key == es[i].key;
+                });
+            if (it == out.end())
+                out.push_back(es[i]);
+            else {
+                it->count += es[i].count;
+                it->err += es[i].err;
+            }
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const entry& a, const entry& b) {
+            return a.count > b.count;
+        });
+    if (out.size() > n)
+        out.resize(n);
+    return out;
+}
+
+void ConflictProfile::clear() {
+    for (auto& s : sketches_)
+        s.nobjects = s.nkeys = 0;
+}
+
+static std::string type_name(const char* mangled) {
+    int status;
+    char* d = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+    std::string name(status == 0 ? d : mangled);
+    free(d);
+    if (name.size() > 72)
+        name = name.substr(0, 69) + "...";
+    return name;
+}
+
+void ConflictProfile::report(FILE* f, unsigned n) {
+    auto objects = top(n, false);
+    if (objects.empty())
+        return;
+    fprintf(f, "$ Top conflicting objects: aborts (overcount bound), type @ object, latest reason\n");
+    for (auto& e : objects)
+        fprintf(f, "$   %llu (%llu) %s @ %p, %s\n", (unsigned long long) e.count, (unsigned long long) e.err,
+                type_name(e.type).c_str(), (const void*) e.object, e.reason);
+    fprintf(f, "$ Top conflicting keys: aborts (overcount bound), object, %s\n",
+            key_buckets_ ? "key bucket" : "key");
+    for (auto& e : top(n, true))
+        fprintf(f, "$   %llu (%llu) %p, %#llx, %s\n", (unsigned long long) e.count, (unsigned long long) e.err,
+                (const void*) e.object, (unsigned long long) e.key, e.reason);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "TThread.hh"
+
+class TObject;
+
+// Attributes aborts to the TObject, and the item key, that caused them.
+// A transaction remembers the last item it marked with mark_abort_because;
+// when the attempt aborts, the aborting thread records that item here.
+//
+// Each thread keeps two lossy top-K sketches (Space-Saving), one counting
+// objects and one counting (object, key) pairs. A pair missing from a full
+// sketch replaces the entry with the smallest count and starts from that
+// count, so a listed count overstates the true one by at most its err.
+// Only the owning thread writes its sketches; top() and report() read them
+// once the run is over.
+class ConflictProfile {
+public:
+    static constexpr unsigned sketch_size = 32;
+
+    struct entry {
+        const TObject* object;
+        uint64_t key;        // raw item key, or its hash bucket
+        const char* type;    // mangled type name of object
+        const char* reason;  // latest abort reason
+        uint64_t count;
+        uint64_t err;
+    };
+
+    // Starts recording. With key_buckets != 0, keys are hashed into that
+    // many buckets, so that keys that are pointers to short-lived items
+    // still add up.
+    static void enable(unsigned key_buckets = 0) {
+        key_buckets_ = key_buckets;
+        enabled_ = true;
+    }
+    static void disable() {
+        enabled_ = false;
+    }
+    static bool enabled() {
+        return enabled_;
+    }
+
+    static void record(int threadid, const TObject* object, uint64_t key, const char* reason) {
+        if (enabled_ && object)
+            record_slow(threadid, object, key, reason);
+    }
+
+    // The n largest counts over all threads, by object or by (object, key)
+    static std::vector<entry> top(unsigned n, bool by_key);
+    static void clear();
+    // Prints the top n objects and keys, if anything was recorded
+    static void report(FILE* f, unsigned n = 10);
+
+private:
+    struct __attribute__((aligned(64))) sketch {
+        entry objects[sketch_size];
+        entry keys[sketch_size];
+        unsigned nobjects;
+        unsigned nkeys;
+    };
+
+    static bool enabled_;
+    static unsigned key_buckets_;
+    static sketch sketches_[MAX_THREADS];
+
+    static void record_slow(int threadid, const TObject* object, uint64_t key, const char* reason);
+};
@@ -1,4 +1,6 @@
-#include <random>
+#include <algorithm>
+#include <sched.h>
+#include <cstring>
 
 #include "ContentionManager.hh"
 #include "Transaction.hh"
@@ -7,82 +9,260 @@
 
 void ContentionManager::init() {
     static_assert(sizeof(CMInfo) == 64, "CMInfo not cacheline aligned.");
-    std::mt19937 gen(0);
-    std::uniform_int_distribution<uint32_t> dis(1);
-    for (int i = 0; i < MAX_THREADS; ++i) {
-        cm_info[i].seed = dis(gen);
-        cm_info[i].abort_backoff = INIT_BACKOFF_CYCLES;
+}
+
+bool ContentionManager::set_policy(const char* name) {
+    for (auto p : {policy_none, policy_greedy, policy_karma, policy_polka})
+        if (name && strcmp(name, policy_name(p)) == 0) {
+            policy_ = p;
+            return true;
+        }
+    return false;
+}
+
+const char* ContentionManager::policy_name(policy_type p) {
+    switch (p) {
+    case policy_none:
+        return "none";
+    case policy_greedy:
+        return "greedy";
+    case policy_karma:
+        return "karma";
+    case policy_polka:
+        return "polka";
+    default:
+        return "unknown";
     }
 }
 
-bool ContentionManager::should_abort(int this_id, int owner_id) {
+bool ContentionManager::should_abort_slow(int this_id, int owner_id) {
     TXP_INCREMENT(txp_cm_shouldabort);
+    CMInfo& me = info(this_id);
+    CMInfo* ownerp = find_info(owner_id);
+    // a lock holder has run a transaction, so this is only for safety
+    if (!ownerp)
+        return true;
+    CMInfo& owner = *ownerp;
     acquire_fence();
-    if (cm_info[this_id].aborted == 1){
+    if (me.aborted == 1){
         return true;
     }
+    if (me.priority != owner.priority) {
+        if (me.priority < owner.priority)
+            return true;
+        owner.aborted = 1;
+        release_fence();
+        return false;
+    }
+    if (TThread::txn->options().past_deadline())
+        return true;
+
+    if (policy_ != policy_greedy) {
+        if (me.karma + me.attempts > owner.karma) {
+            owner.aborted = 1;
+            release_fence();
+            me.attempts = 0;
+        } else {
+            ++me.attempts;
+            if (policy_ == policy_polka)
+                wait_cycles(rand_r(&me.seed)
+                            % (INIT_BACKOFF_CYCLES << std::min(me.attempts, uint32_t(SUCC_ABORTS_MAX))));
+        }
+        return false;
+    }
 
     // This transaction is still in the timid phase
     acquire_fence();
-    if (cm_info[this_id].timestamp == MAX_TS) {
+    if (me.timestamp == MAX_TS) {
         return true;
     }
 
     //if (cm_info[threadid].write_set_size < cm_info[owner_threadid].write_set_size) {
-    if (cm_info[owner_id].timestamp < cm_info[this_id].timestamp) {
+    if (owner.timestamp < me.timestamp) {
         acquire_fence();
-        return (cm_info[owner_id].aborted == 0);
+        return (owner.aborted == 0);
     } else {
         //FIXME: this might abort a new transaction on that thread
-        cm_info[owner_id].aborted = 1;
+        owner.aborted = 1;
         release_fence();
         return false;
     }
 
 }
 
-bool ContentionManager::on_write(int threadid) {
+bool ContentionManager::on_write_slow(int threadid) {
     TXP_INCREMENT(txp_cm_onwrite);
-    if (cm_info[threadid].aborted == 1) {
+    CMInfo& cm = info(threadid);
+    if (cm.aborted == 1) {
       return false;
     }
-    cm_info[threadid].write_set_size += 1;
-    if ((cm_info[threadid].timestamp == MAX_TS) &&
-            (cm_info[threadid].write_set_size == TS_THRESHOLD)) {
-        cm_info[threadid].timestamp = fetch_and_add(&ts, uint64_t(1));
+    cm.write_set_size += 1;
+    cm.attempts = 0;
+    if (policy_ != policy_greedy)
+        ++cm.karma;
+    else if ((cm.timestamp == MAX_TS) &&
+            (cm.write_set_size == TS_THRESHOLD)) {
+        cm.timestamp = fetch_and_add(&ts, uint64_t(1));
         //cm_info[threadid].timestamp = 1;
     }
     return true;
 }
 
-void ContentionManager::start(Transaction *tx) {
+void ContentionManager::start_slow(Transaction *tx) {
     TXP_INCREMENT(txp_cm_start);
-    int threadid = tx->threadid();
-    if (tx->is_restarted()) {
-        // Do not reset abort count
-        cm_info[threadid].timestamp = MAX_TS;
-        cm_info[threadid].aborted = 0;
-        cm_info[threadid].write_set_size = 0;
+    CMInfo& cm = info(tx->threadid());
+    cm.timestamp = MAX_TS;
+    cm.aborted = 0;
+    cm.priority = tx->options().priority;
+    cm.write_set_size = 0;
+    cm.attempts = 0;
+    if (!tx->is_restarted()) {
+        // Do not reset abort count or karma on a retry
+        cm.abort_count = 0;
+        cm.abort_backoff = INIT_BACKOFF_CYCLES;
+        cm.karma = 0;
+        cm.streak = 0;
+        cm.age = MAX_TS;
+    }
+}
+
+void ContentionManager::on_abort_reason_slow(int threadid, const void* object, const char* reason) {
+    CMInfo& cm = info(threadid);
+    // "commit lock", "locked", "write_lock", "lock-dirty", ... vs.
+    // "commit check", "opacity check", ...
+    if (strstr(reason, "lock")) {
+        cm.cause = cause_lock;
+        if (object != cm.hot_object) {
+            cm.hot_object = object;
+            cm.streak = 0;
+        }
+    } else if (strstr(reason, "check"))
+        cm.cause = cause_check;
+    else
+        cm.cause = cause_other;
+}
+
+// Waits, but not past the transaction's deadline
+static void backoff(uint64_t cycles, const TransactionOptions& opts) {
+    if (opts.deadline) {
+        uint64_t now = read_tsc();
+        cycles = now >= opts.deadline ? 0 : std::min(cycles, opts.deadline - now);
+    }
+    wait_cycles(cycles);
+}
+
+// Wait-die order: the higher priority class, then the older transaction
+static bool outranks(const CMInfo& a, const CMInfo& b) {
+    return a.priority != b.priority ? a.priority > b.priority : a.age < b.age;
+}
+
+// A transaction takes its age from ts the first time it waits, and keeps it
+// until it commits, so a retried transaction only grows older. The
+// transaction that outranks a write-lock holder waits for it; otherwise it
+// dies. Readers aren't recorded in the version, so on a read-locked row only
+// a transaction no other active one outranks waits. Waits thus run down a
+// fixed order, which can't form a cycle.
+bool ContentionManager::wait_for_lock_slow(int owner_id) {
+    int threadid = TThread::id();
+    CMInfo& me = info(threadid);
+    if (me.age == MAX_TS)
+        me.age = fetch_and_add(&ts, uint64_t(1));
+    bool wait;
+    if (owner_id == threadid || TThread::txn->options().past_deadline())
+        wait = false;
+    else if (owner_id >= 0) {
+        // a holder without an age hasn't waited yet; it is the younger
+        acquire_fence();
+        CMInfo* owner = find_info(owner_id);
+        wait = owner && outranks(me, *owner);
     } else {
-        cm_info[threadid].timestamp = MAX_TS;
-        cm_info[threadid].aborted = 0;
-        cm_info[threadid].write_set_size = 0;
-        cm_info[threadid].abort_count = 0;
-        cm_info[threadid].abort_backoff = INIT_BACKOFF_CYCLES;
+        wait = true;
+        for (auto& ti : Transaction::tinfo)
+            if (&ti.cm != &me && ti.cm.age != MAX_TS && outranks(ti.cm, me)) {
+                wait = false;
+                break;
+            }
+    }
+    if (wait) {
+        TXP_INCREMENT(txp_cm_waits);
+        sched_yield();
     }
+    return wait;
 }
 
-void ContentionManager::on_rollback(int threadid) {
+void ContentionManager::on_rollback_slow(int threadid, const TransactionOptions& opts) {
     TXP_INCREMENT(txp_cm_onrollback);
-    if (cm_info[threadid].abort_count < SUCC_ABORTS_MAX) {
-        ++cm_info[threadid].abort_count;
-        cm_info[threadid].abort_backoff <<= 1;
+    CMInfo& cm = info(threadid);
+    if (cm.queue >= 0)
+        queue_release(cm);
+    uint16_t cause = cm.cause;
+    cm.cause = cause_other;
+
+    // High-priority transactions retry at once; they win the conflicts
+    // that made them back off
+    if (opts.priority == TransactionOptions::prio_high) {
+        cm.streak = 0;
+        return;
+    }
+
+    if (cause == cause_check) {
+        // The conflicting writer has already committed, so retrying soon
+        // is likely to succeed: back off linearly, not exponentially.
+        cm.streak = 0;
+        if (cm.abort_count < SUCC_ABORTS_MAX)
+            ++cm.abort_count;
+        backoff(rand_r(&cm.seed) % (cm.abort_count * CHECK_BACKOFF_CYCLES), opts);
+        return;
+    }
+
+    // a queue ticket can't be given up, so deadline-bound retries don't queue
+    if (cause == cause_lock && CM_QUEUE_AFTER && cm.hot_object && !opts.deadline
+        && ++cm.streak >= CM_QUEUE_AFTER) {
+        queue_acquire(cm);
+        return;
     }
-    //uint64_t cycles_to_wait = rand_r((unsigned int*)&cm_info[threadid].seed) % (cm_info[threadid].abort_count * WAIT_CYCLES_MULTIPLICATOR);
-    uint64_t cycles_to_wait = rand_r(&(cm_info[threadid].seed)) % cm_info[threadid].abort_backoff;
-    wait_cycles(cycles_to_wait);
+    if (cause != cause_lock)
+        cm.streak = 0;
+
+    if (cm.abort_count < SUCC_ABORTS_MAX) {
+        ++cm.abort_count;
+        cm.abort_backoff <<= 1;
+    }
+    //uint64_t cycles_to_wait = rand_r((unsigned int*)&cm.seed) % (cm.abort_count * WAIT_CYCLES_MULTIPLICATOR);
+    uint64_t cycles_to_wait = rand_r(&cm.seed) % cm.abort_backoff;
+    backoff(cycles_to_wait, opts);
+}
+
+void ContentionManager::on_commit_slow(int threadid) {
+    CMInfo& cm = info(threadid);
+    if (cm.queue >= 0)
+        queue_release(cm);
+    cm.streak = 0;
+    cm.cause = cause_other;
+    cm.age = MAX_TS;
+}
+
+void ContentionManager::queue_acquire(CMInfo& cm) {
+    TXP_INCREMENT(txp_cm_queued);
+    unsigned qi = queue_index(cm.hot_object);
+    CMQueue& q = queues[qi];
+    uint32_t ticket = q.next.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned spins = 0; q.serving.load(std::memory_order_acquire) != ticket; ++spins) {
+        // the holder may be descheduled mid-attempt
+        if (spins < 1024)
+            relax_fence();
+        else
+            sched_yield();
+    }
+    cm.queue = qi;
+}
+
+void ContentionManager::queue_release(CMInfo& cm) {
+    queues[cm.queue].serving.fetch_add(1, std::memory_order_release);
+    cm.queue = -1;
 }
 
 // Defines and initializes the static fields
 uint64_t ContentionManager::ts = 0;
-CMInfo ContentionManager::cm_info[MAX_THREADS];
+ContentionManager::policy_type ContentionManager::policy_ = ContentionManager::policy_greedy;
+ContentionManager::CMQueue ContentionManager::queues[ContentionManager::nqueues];
@@ -2,6 +2,7 @@
 
 #include "Interface.hh"
 #include "timing.hh"
+#include <atomic>
 #include <climits>
 
 #define MAX_TS UINT_MAX
@@ -9,38 +10,152 @@
 #define SUCC_ABORTS_MAX 10
 #define WAIT_CYCLES_MULTIPLICATOR 10000
 #define INIT_BACKOFF_CYCLES 3072
+#define CHECK_BACKOFF_CYCLES 512
 
+// After this many consecutive lock aborts on the same TObject, retries
+// queue on that object instead of backing off; 0 disables queueing
+#ifndef CM_QUEUE_AFTER
+#define CM_QUEUE_AFTER 4
+#endif
+
+#ifndef MAX_THREADS
 #define MAX_THREADS 128
+#endif
 
 class Transaction;
+struct TransactionOptions;
 
-struct CMInfo {
-    uint32_t aborted;
+// Per-thread contention-manager state. Each thread's copy lives in its
+// threadinfo_t (see ContentionManager::info), so it is first touched, and
+// placed, on that thread's NUMA node, and gets a cache line to itself.
+struct alignas(64) CMInfo {
+    uint8_t aborted;
+    uint8_t priority;        // TransactionOptions::priority_type
     uint32_t seed;
     uint64_t timestamp;
-    uint64_t write_set_size;
-    uint64_t abort_count;
+    uint32_t write_set_size;
+    uint32_t abort_count;
     uint64_t abort_backoff;
-    uint64_t version;
-    uint64_t padding[2];
+    uint32_t karma;          // writes, summed over the attempts of one transaction
+    uint32_t attempts;       // conflicts lost while waiting for the current lock
+    const void* hot_object;  // TObject of the last recorded conflict
+    uint16_t cause;          // ContentionManager::cause_type of that conflict
+    uint16_t streak;         // consecutive lock aborts on hot_object
+    int32_t queue;           // held queue slot, or -1
+    uint64_t age;            // wait-die timestamp, kept across retries; MAX_TS if unset
 
-    CMInfo() = default;
+    CMInfo()
+        : aborted(0), priority(0), seed(uint32_t(uintptr_t(this) >> 6) * 2654435761U | 1),
+          timestamp(MAX_TS), write_set_size(0), abort_count(0),
+          abort_backoff(INIT_BACKOFF_CYCLES), karma(0), attempts(0),
+          hot_object(nullptr), cause(0), streak(0), queue(-1), age(MAX_TS) {
+    }
 };
 
 class ContentionManager {
 public:
+    // Runtime-selectable policy (set_policy). Every policy but none shares
+    // the abort-cause backoff and hot-object queueing in on_rollback; they
+    // differ in who wins a write-lock conflict (should_abort):
+    //   none:   the requester aborts at once; no bookkeeping, no backoff
+    //   greedy: after a timid phase of TS_THRESHOLD writes a transaction
+    //           gets a timestamp, and the older transaction wins
+    //   karma:  priority is the work done (writes, kept across retries);
+    //           a loser spins, gaining a point per attempt, until it
+    //           outranks the owner and aborts it
+    //   polka:  karma, with randomized exponential backoff between attempts
+    // Every policy but none also runs wait-die for 2PL locks (wait_for_lock),
+    // and lets a higher TransactionOptions priority class win outright.
+    enum policy_type {
+        policy_none = 0, policy_greedy, policy_karma, policy_polka
+    };
+    enum cause_type : uint16_t {
+        cause_other = 0, cause_lock, cause_check
+    };
+
     static void init();
-    static bool should_abort(int this_id, int owner_id);
 
-    static bool on_write(int threadid);
+    // Returns false for unknown names
+    static bool set_policy(const char* name);
+    static policy_type policy() {
+        return policy_;
+    }
+    static const char* policy_name(policy_type p = policy_);
+
+    static bool should_abort(int this_id, int owner_id) {
+        return policy_ == policy_none || should_abort_slow(this_id, owner_id);
+    }
+
+    static bool on_write(int threadid) {
+        return policy_ == policy_none || on_write_slow(threadid);
+    }
+
+    static void start(Transaction* tx) {
+        if (policy_ != policy_none)
+            start_slow(tx);
+    }
+
+    // Records why the current attempt is failing (see mark_abort_because)
+    static void on_abort_reason(int threadid, const void* object, const char* reason) {
+        if (policy_ != policy_none)
+            on_abort_reason_slow(threadid, object, reason);
+    }
+
+    // 2PL wait-die, called when a TLockVersion lock wait passes its spin
+    // bound. Returns true if the caller should keep waiting, false if it
+    // should abort. owner_id is the write-lock holder, or -1 for readers.
+    static bool wait_for_lock(int owner_id) {
+        return policy_ != policy_none && wait_for_lock_slow(owner_id);
+    }
 
-    static void start(Transaction *tx); 
+    static void on_rollback(int threadid, const TransactionOptions& opts) {
+        if (policy_ != policy_none)
+            on_rollback_slow(threadid, opts);
+    }
 
-    static void on_rollback(int threadid);
+    static void on_commit(int threadid) {
+        if (policy_ != policy_none)
+            on_commit_slow(threadid);
+    }
+
+    // The retry loop is over without a commit (it gave up, or an exception
+    // left it): gives back a queue ticket taken for the next attempt
+    static inline void on_leave(int threadid);
+
+    // Defined after threadinfo_t, in Transaction.hh
+    static inline CMInfo& info(int threadid);
+    // Another thread's state, without allocating its slot: nullptr if
+    // that thread never ran a transaction
+    static inline CMInfo* find_info(int threadid);
 
 public:
     // Global timestamp
     static uint64_t ts;
-    static CMInfo cm_info[MAX_THREADS];
-};
 
+private:
+    static policy_type policy_;
+
+    // A ticket lock per hash bucket of hot objects. A thread that keeps
+    // losing lock conflicts on one object takes a ticket and holds it
+    // through its next attempt, so those retries run one at a time.
+    struct alignas(64) CMQueue {
+        std::atomic<uint32_t> next;
+        std::atomic<uint32_t> serving;
+    };
+    static constexpr unsigned nqueues = 256;
+    static CMQueue queues[nqueues];
+
+    static unsigned queue_index(const void* object) {
+        return (uintptr_t(object) >> 4) * 0x9E3779B97F4A7C15ULL >> 56;
+    }
+    static void queue_acquire(CMInfo& cm);
+    static void queue_release(CMInfo& cm);
+
+    static bool should_abort_slow(int this_id, int owner_id);
+    static bool on_write_slow(int threadid);
+    static void start_slow(Transaction* tx);
+    static void on_abort_reason_slow(int threadid, const void* object, const char* reason);
+    static bool wait_for_lock_slow(int owner_id);
+    static void on_rollback_slow(int threadid, const TransactionOptions& opts);
+    static void on_commit_slow(int threadid);
+};
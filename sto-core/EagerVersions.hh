@@ -4,11 +4,49 @@
 // They both perform eager (or pessimistic) write-write concurrency control and hence
 // the file name
 
+#include <algorithm>
+#include <atomic>
+
 #include "VersionBase.hh"
 #include "TThread.hh"
 
 enum class LockResponse : int {locked, failed, optimistic, spin};
 
+// Sampled access statistics behind TLockVersion<true>'s choice between
+// optimistic and read-locked reads. Versions hash to buckets holding a
+// saturating score: sampled reads push it up, sampled writes and failed
+// optimistic validations push it down. The opt_bit only flips when the
+// score crosses +threshold or -threshold, so a row whose access mix
+// changes by phase switches mode once per phase, not on every access.
+class TLockModeStats {
+public:
+    static constexpr unsigned nbuckets = 4096;
+    static constexpr unsigned sample_period = 8;
+    static constexpr int32_t read_delta = 1;
+    static constexpr int32_t write_delta = -4;
+    static constexpr int32_t invalid_delta = -16;
+    static constexpr int32_t threshold = 32;
+    static constexpr int32_t limit = 64;
+
+    // Adds delta to the score of obj's bucket for one in sample_period
+    // calls (every call if !sampled). Returns 1 to prefer optimistic reads,
+    // -1 to prefer read locks, 0 to keep the current mode.
+    static int record(const void* obj, int32_t delta, bool sampled = true) {
+        if (sampled && ++tick_ % sample_period)
+            return 0;
+        auto& score = score_[(uintptr_t(obj) >> 3) * 0x9E3779B97F4A7C15ULL >> 52];
+        // lossy read-modify-write: this is only a statistic
+        int32_t x = score.load(std::memory_order_relaxed) + delta;
+        x = std::max(-limit, std::min(limit, x));
+        score.store(x, std::memory_order_relaxed);
+        return x >= threshold ? 1 : (x <= -threshold ? -1 : 0);
+    }
+
+private:
+    static std::atomic<int32_t> score_[nbuckets];
+    static __thread unsigned tick_;
+};
+
 template <bool Adaptive>
 class TLockVersion : public BasicVersion<TLockVersion<Adaptive>> {
 public:
@@ -25,8 +63,10 @@ public:
     TLockVersion() = default;
     explicit TLockVersion(type v)
             : BV(v) {}
+    // While write-locked, the threadid bits hold the owner (they hold the
+    // reader count otherwise)
     TLockVersion(type v, bool insert)
-            : BV(v | (insert ? lock_bit : 0)) {}
+            : BV(v | (insert ? (lock_bit | TThread::id()) : 0)) {}
 
     bool cp_try_lock_impl(TransItem& item, int threadid) {
         (void)item;
@@ -50,11 +90,15 @@ public:
         (void)txn;
         type vv = v_;
         fence();
-        if (TransactionTid::is_dirty(vv) && !item.has_write())
-            return false;
-        return TransactionTid::check_version(vv, item.read_value<type>());
+        bool ok = !(TransactionTid::is_dirty(vv) && !item.has_write())
+            && TransactionTid::check_version(vv, item.read_value<type>());
+        if (Adaptive && !ok && !item.needs_unlock())
+            record_unlocked(TLockModeStats::invalid_delta, false);
+        return ok;
     }
     void cp_set_version_unlock_impl(type new_v) {
+        if (Adaptive)
+            new_v = (new_v & ~opt_bit) | mode_after(TLockModeStats::write_delta);
         TransactionTid::set_version_unlock_dirty(v_, new_v);
     }
 
@@ -77,6 +121,29 @@ public:
     }
 
 private:
+    // opt_bit to install along with a write (we hold the write lock)
+    type mode_after(int32_t delta) const {
+        int want = TLockModeStats::record(this, delta);
+        return want ? (want > 0 ? opt_bit : 0) : (v_ & opt_bit);
+    }
+
+    // Records an event without holding a lock; flips opt_bit if the
+    // score crossed a threshold and no writer is active
+    void record_unlocked(int32_t delta, bool sampled = true) {
+        int want = TLockModeStats::record(this, delta, sampled);
+        if (!want)
+            return;
+        while (true) {
+            type vv = v_;
+            if (vv & (lock_bit | dirty_bit))
+                return;
+            type new_v = want > 0 ? (vv | opt_bit) : (vv & ~opt_bit);
+            if (new_v == vv || ::bool_cmpxchg(&v_, vv, new_v))
+                return;
+            relax_fence();
+        }
+    }
+
     // read/writer/optimistic combined lock
     std::pair<LockResponse, type> try_lock_read() {
         while (true) {
@@ -90,7 +157,7 @@ private:
                 return std::make_pair(LockResponse::optimistic, vv);
             }
             if (::bool_cmpxchg(&v_, vv, (vv & ~mask) | (rlock_cnt+1)))
-                return std::make_pair(LockResponse::locked, type());
+                return std::make_pair(LockResponse::locked, vv);
             else
                 relax_fence();
         }
@@ -103,7 +170,7 @@ private:
             bool read_locked = ((vv & mask) != 0);
             if (write_locked || read_locked)
                 return LockResponse::spin;
-            if (::bool_cmpxchg(&v_, vv, (vv | lock_bit)))
+            if (::bool_cmpxchg(&v_, vv, (vv | lock_bit | TThread::id())))
                 return LockResponse::locked;
             else
                 relax_fence();
@@ -116,49 +183,38 @@ private:
         type rlock_cnt = vv & mask;
         assert(!TransactionTid::is_locked(vv));
         assert(rlock_cnt >= 1);
-        if ((rlock_cnt == 1) && ::bool_cmpxchg(&v_, vv, (vv - 1) | lock_bit))
+        if ((rlock_cnt == 1) && ::bool_cmpxchg(&v_, vv, (vv - 1) | lock_bit | TThread::id()))
             return LockResponse::locked;
         else
             return LockResponse::spin;
     }
 
     void unlock_read() {
-        if (!Adaptive) {
-            type vv = __sync_fetch_and_add(&v_, -1);
-            (void)vv;
-            assert((vv & mask) >= 1);
-        } else {
-            bool reset_opt_bit = TThread::gen[TThread::id()].chance(50);
-            if (!reset_opt_bit) {
-                fetch_and_add(&v_, -1);
-            } else {
-                while (1) {
-                    type vv = v_;
-                    assert((vv & mask) >= 1);
-                    type new_v = (vv - 1) | opt_bit;
-                    if (::bool_cmpxchg(&v_, vv, new_v))
-                        break;
-                    relax_fence();
-                }
-            }
-        }
+        type vv = __sync_fetch_and_add(&v_, -1);
+        (void)vv;
+        assert((vv & mask) >= 1);
     }
 
     void unlock_write() {
         assert(BV::is_locked());
         type new_v;
         if (!Adaptive) {
-            new_v = v_ & ~(lock_bit | dirty_bit | opt_bit);
+            new_v = v_ & ~(lock_bit | dirty_bit | opt_bit | mask);
         } else {
-            new_v = v_ & ~(lock_bit | dirty_bit);
-            if (((new_v & opt_bit) != 0) && TThread::gen[TThread::id()].chance(50)) {
-                new_v &= ~opt_bit;
-            }
+            new_v = (v_ & ~(lock_bit | dirty_bit | opt_bit | mask))
+                | mode_after(TLockModeStats::write_delta);
         }
         v_ = new_v;
         release_fence();
     }
 
+    // Write-lock owner, or -1 if unlocked or only read-locked
+    int lock_owner() const {
+        type vv = v_;
+        return (vv & lock_bit) ? int(vv & mask) : -1;
+    }
+    inline bool wait_past_bound();
+
     inline bool try_upgrade_with_spin();
     inline bool try_lock_write_with_spin();
     inline std::pair<LockResponse, type> try_lock_read_with_spin();
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+
+// Transactions per high-water window; 0 never shrinks
+#ifndef STO_SHRINK_WINDOW
+#define STO_SHRINK_WINDOW 1024
+#endif
+
+// Peak per-transaction use of a per-thread buffer (TransactionBuffer,
+// TransScratch, the tset). When a window closes the owner drops capacity
+// the window's peak didn't need, so one outlier transaction doesn't pin
+// its memory for the life of the thread.
+class HighWater {
+public:
+    static constexpr unsigned window = STO_SHRINK_WINDOW;
+
+    HighWater()
+        : peak_(0), n_(0) {
+    }
+
+    // Records one transaction's use. Returns true when a window closes;
+    // `peak` is then the most any transaction in it used.
+    bool note(size_t used, size_t& peak) {
+        peak_ = std::max(peak_, used);
+        if (window == 0 || ++n_ != window)
+            return false;
+        peak = peak_;
+        peak_ = 0;
+        n_ = 0;
+        return true;
+    }
+
+    // Is `capacity` worth shrinking to `peak`? More than twice the
+    // peak, so a steady workload doesn't free and regrow every window.
+    static bool oversized(size_t capacity, size_t peak, size_t floor) {
+        return capacity > floor && capacity / 2 > peak;
+    }
+
+private:
+    size_t peak_;
+    unsigned n_;
+};
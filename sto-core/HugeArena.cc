@@ -0,0 +1,209 @@
+#include "HugeArena.hh"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "PlatformFeatures.hh"
+
+constexpr size_t HugeArena::slab_size;
+constexpr size_t HugeArena::max_object_size;
+
+bool HugeArena::enabled_;
+HugeArena::node_state HugeArena::nodes_[max_nodes];
+std::atomic<size_t> HugeArena::mapped_;
+std::atomic<size_t> HugeArena::hugetlb_;
+std::atomic<size_t> HugeArena::dax_;
+int HugeArena::pmem_fd_ = -1;
+std::mutex HugeArena::pmem_lock_;
+off_t HugeArena::pmem_size_;
+thread_local HugeArena::thread_cache HugeArena::tc_;
+
+static const char* malloc_name() {
+#if defined(__APPLE__) || MALLOC == 0
+    return "libc";
+#elif MALLOC == 1
+    return "jemalloc";
+#else
+    return "rpmalloc";
+#endif
+}
+
+bool HugeArena::select(const char* name) {
+    if (!name)
+        return false;
+    int fd = -1;
+    if (strcmp(name, "default") == 0 || strcmp(name, malloc_name()) == 0)
+        enabled_ = false;
+    else if (strcmp(name, "hugepage-arena") == 0)
+        enabled_ = true;
+    else if (strncmp(name, "pmem:", 5) == 0) {
+        // a new heap each run: nothing reattaches to an old one yet
+        fd = open(name + 5, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        enabled_ = true;
+    } else
+        return false;
+    if (pmem_fd_ >= 0)
+        close(pmem_fd_);
+    pmem_fd_ = fd;
+    pmem_size_ = 0;
+    return true;
+}
+
+const char* HugeArena::selected() {
+    if (!enabled_)
+        return malloc_name();
+    return persistent() ? "pmem" : "hugepage-arena";
+}
+
+unsigned HugeArena::current_node() {
+    unsigned cpu, node;
+    if (getcpu(&cpu, &node) != 0)
+        return 0;
+    return node % max_nodes;
+}
+
+// Extends the heap file by a slab and maps the new slab at a 2MB-aligned
+// address
+void* HugeArena::map_pmem_slab() {
+    off_t offset;
+    {
+        std::lock_guard<std::mutex> guard(pmem_lock_);
+        offset = pmem_size_;
+        if (ftruncate(pmem_fd_, offset + slab_size) != 0) {
+            std::cerr << "HugeArena: cannot grow the pmem heap: " << strerror(errno) << std::endl;
+            abort();
+        }
+        pmem_size_ += slab_size;
+    }
+    // reserve twice the span, then map the file over its aligned middle
+    auto q = static_cast<char*>(mmap(nullptr, 2 * slab_size, PROT_NONE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (q == MAP_FAILED) {
+        std::cerr << "HugeArena: cannot map a slab" << std::endl;
+        abort();
+    }
+    auto a = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(q) + slab_size - 1)
+                                     & ~(slab_size - 1));
+    void* p = MAP_FAILED;
+#if defined(MAP_SYNC) && defined(MAP_SHARED_VALIDATE)
+    p = mmap(a, slab_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED_VALIDATE | MAP_SYNC | MAP_FIXED, pmem_fd_, offset);
+    if (p != MAP_FAILED)
+        dax_.fetch_add(slab_size, std::memory_order_relaxed);
+#endif
+    if (p == MAP_FAILED)
+        p = mmap(a, slab_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, pmem_fd_, offset);
+    if (p == MAP_FAILED) {
+        std::cerr << "HugeArena: cannot map a pmem slab: " << strerror(errno) << std::endl;
+        abort();
+    }
+    if (a != q)
+        munmap(q, a - q);
+    if (a + slab_size != q + 2 * slab_size)
+        munmap(a + slab_size, q + slab_size - a);
+    return p;
+}
+
+HugeArena::slab* HugeArena::map_slab(unsigned cls, unsigned node) {
+    if (persistent()) {
+        auto s = new (map_pmem_slab()) slab{cls, node};
+        mapped_.fetch_add(slab_size, std::memory_order_relaxed);
+        return s;
+    }
+    bool huge = true;
+    void* p = mmap(nullptr, slab_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) {
+        // no hugetlb pages reserved: map an aligned 2MB region and ask for
+        // a transparent huge page
+        huge = false;
+        auto q = static_cast<char*>(mmap(nullptr, 2 * slab_size, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (q == MAP_FAILED) {
+            std::cerr << "HugeArena: cannot map a slab" << std::endl;
+            abort();
+        }
+        auto a = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(q) + slab_size - 1)
+                                         & ~(slab_size - 1));
+        if (a != q)
+            munmap(q, a - q);
+        if (a + slab_size != q + 2 * slab_size)
+            munmap(a + slab_size, q + slab_size - a);
+        madvise(a, slab_size, MADV_HUGEPAGE);
+        p = a;
+    }
+    // first touch, from a thread on `node`, places the page there
+    auto s = new (p) slab{cls, node};
+    mapped_.fetch_add(slab_size, std::memory_order_relaxed);
+    if (huge)
+        hugetlb_.fetch_add(slab_size, std::memory_order_relaxed);
+    return s;
+}
+
+void HugeArena::refill(thread_cache& tc, unsigned cls) {
+    const size_t osz = (cls + 1) * granule;
+    unsigned node = current_node();
+    node_state& ns = nodes_[node];
+    std::lock_guard<std::mutex> guard(ns.lock);
+    unsigned got = 0;
+    for (; got != batch && ns.free[cls]; ++got) {
+        free_obj* o = ns.free[cls];
+        ns.free[cls] = o->next;
+        o->next = tc.head[cls];
+        tc.head[cls] = o;
+    }
+    for (; got != batch; ++got) {
+        if (size_t(ns.end[cls] - ns.next[cls]) < osz) {
+            slab* s = map_slab(cls, node);
+            ns.next[cls] = reinterpret_cast<char*>(s) + header_size;
+            ns.end[cls] = reinterpret_cast<char*>(s) + slab_size;
+        }
+        auto o = reinterpret_cast<free_obj*>(ns.next[cls]);
+        ns.next[cls] += osz;
+        o->next = tc.head[cls];
+        tc.head[cls] = o;
+    }
+    tc.n[cls] += got;
+}
+
+void HugeArena::spill(thread_cache& tc, unsigned cls, unsigned n) {
+    // sort the spilled objects by home node, then lock each node once
+    free_obj* head[max_nodes] = {};
+    free_obj* tail[max_nodes] = {};
+    for (unsigned i = 0; i != n && tc.head[cls]; ++i) {
+        free_obj* o = tc.head[cls];
+        tc.head[cls] = o->next;
+        --tc.n[cls];
+        auto s = reinterpret_cast<slab*>(reinterpret_cast<uintptr_t>(o) & ~(slab_size - 1));
+        o->next = head[s->node];
+        if (!head[s->node])
+            tail[s->node] = o;
+        head[s->node] = o;
+    }
+    for (unsigned node = 0; node != max_nodes; ++node)
+        if (head[node]) {
+            node_state& ns = nodes_[node];
+            std::lock_guard<std::mutex> guard(ns.lock);
+            tail[node]->next = ns.free[cls];
+            ns.free[cls] = head[node];
+        }
+}
+
+HugeArena::thread_cache::~thread_cache() {
+    // leave each count at the limit, so releases from thread_local
+    // destructors that run later (object_pool's) go straight to the node lists
+    for (unsigned cls = 0; cls != nclasses; ++cls) {
+        if (head[cls])
+            spill(*this, cls, n[cls]);
+        n[cls] = cache_limit;
+    }
+}
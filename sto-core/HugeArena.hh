@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <sys/types.h>
+
+#include "compiler.hh"
+
+// Slab allocator for table memory (index elements, rows, MVCC history
+// elements) on 2MB pages, to cut TLB misses on large prepopulated tables.
+//
+// Each slab is one 2MB page, mmapped with MAP_HUGETLB when hugetlb pages are
+// reserved (see mount_hugepages.sh) and otherwise with a transparent
+// hugepage hint. A slab holds objects of one size class and is first
+// touched by the thread that carves it, so it lands on that thread's NUMA
+// node. Freed objects go to a per-thread cache, spilling to the free list
+// of their slab's node; slabs are never unmapped. Objects up to
+// max_object_size are 16-byte aligned; larger ones go to the global
+// allocator.
+//
+// The arena is off unless select("hugepage-arena") is called at startup.
+// Select before building any table: objects must be freed the way they
+// were allocated.
+//
+// select("pmem:<path>") serves the same slabs from the file at path,
+// mapped shared, for persistent or CXL-attached memory behind a DAX file
+// system. Mappings use MAP_SYNC where the file system supports it, so
+// flushed stores are durable without msync; elsewhere they fall back to
+// the page cache, which is enough for testing but not durable. MVCC
+// versions then publish commits with the flush protocol in
+// MvObject::cp_install (see Persist.hh).
+class HugeArena {
+public:
+    static constexpr size_t slab_size = size_t(1) << 21;
+    static constexpr size_t granule = 16;
+    static constexpr size_t max_object_size = 4096;
+    static constexpr unsigned nclasses = max_object_size / granule;
+    static constexpr unsigned max_nodes = 8;
+
+    // Selects table memory by name: "default" or the compiled-in malloc
+    // ("libc", "jemalloc", "rpmalloc"), "hugepage-arena", or
+    // "pmem:<path>". False if the name is unknown, names a malloc this
+    // binary wasn't built with, or names a file that can't be opened.
+    static bool select(const char* name);
+    static const char* selected();
+
+    static bool enabled() {
+        return enabled_;
+    }
+    // Table memory is a persistent mapping (select("pmem:<path>"))
+    static bool persistent() {
+        return pmem_fd_ >= 0;
+    }
+    static bool serves(size_t sz) {
+        return enabled_ && sz <= max_object_size;
+    }
+
+    static void* allocate(size_t sz) {
+        if (!serves(sz))
+            return ::operator new(sz);
+        unsigned cls = size_class(sz);
+        thread_cache& tc = tc_;
+        if (unlikely(!tc.head[cls]))
+            refill(tc, cls);
+        free_obj* o = tc.head[cls];
+        tc.head[cls] = o->next;
+        --tc.n[cls];
+        return o;
+    }
+    // sz must be the size passed to allocate()
+    static void release(void* p, size_t sz) {
+        if (!serves(sz)) {
+            ::operator delete(p);
+            return;
+        }
+        unsigned cls = size_class(sz);
+        thread_cache& tc = tc_;
+        auto o = static_cast<free_obj*>(p);
+        o->next = tc.head[cls];
+        tc.head[cls] = o;
+        if (unlikely(++tc.n[cls] > cache_limit))
+            spill(tc, cls, cache_limit / 2);
+    }
+
+    // Bytes mapped for slabs, how many of them are hugetlb pages, and how
+    // many are persistent mappings with MAP_SYNC
+    static size_t mapped_bytes() {
+        return mapped_.load(std::memory_order_relaxed);
+    }
+    static size_t hugetlb_bytes() {
+        return hugetlb_.load(std::memory_order_relaxed);
+    }
+    static size_t dax_bytes() {
+        return dax_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr unsigned batch = 64;
+    static constexpr unsigned cache_limit = 4 * batch;
+    static constexpr size_t header_size = 64;
+
+    struct free_obj {
+        free_obj* next;
+    };
+    struct slab {
+        unsigned cls;
+        unsigned node;
+    };
+    struct node_state {
+        std::mutex lock;
+        free_obj* free[nclasses];
+        char* next[nclasses];  // carving position in the open slab
+        char* end[nclasses];
+    };
+    struct thread_cache {
+        free_obj* head[nclasses];
+        unsigned n[nclasses];
+        // hands the cache back to the node lists at thread exit
+        ~thread_cache();
+    };
+
+    static bool enabled_;
+    static node_state nodes_[max_nodes];
+    static std::atomic<size_t> mapped_;
+    static std::atomic<size_t> hugetlb_;
+    static std::atomic<size_t> dax_;
+    static int pmem_fd_;
+    static std::mutex pmem_lock_;  // grows the file
+    static off_t pmem_size_;
+    static thread_local thread_cache tc_;
+
+    static unsigned size_class(size_t sz) {
+        return sz ? (sz - 1) / granule : 0;
+    }
+    static unsigned current_node();
+    static slab* map_slab(unsigned cls, unsigned node);
+    static void* map_pmem_slab();
+    static void refill(thread_cache& tc, unsigned cls);
+    static void spill(thread_cache& tc, unsigned cls, unsigned n);
+};
@@ -27,6 +27,43 @@ public:
         (void) item, (void) committed;
     }
     virtual void print(std::ostream& w, const TransItem& item) const;
+
+    // Whether item's lock may be released as soon as install() returns,
+    // before the rest of the writeset is installed (Transaction::set_early_
+    // unlock). cleanup() then runs unlocked. Objects whose install() calls
+    // set_version_unlock() already release early and needn't override this.
+    virtual bool unlock_after_install(TransItem& item) const {
+        (void) item;
+        return false;
+    }
+
+    // Address of the version word check() will read for item, or nullptr.
+    // Used to prefetch ahead of commit validation (STO_VALIDATE_PREFETCH).
+    virtual const void* version_address(TransItem& item) const {
+        (void) item;
+        return nullptr;
+    }
+
+    // Batched commit callbacks, used when STO_BATCH_COMMIT is enabled. Each
+    // call gets a run of this object's items in tset order. lock_batch and
+    // check_batch return how many leading items succeeded. The defaults
+    // fall back to the per-item calls.
+    virtual unsigned lock_batch(TransItem** items, unsigned n, Transaction& txn) {
+        unsigned i = 0;
+        while (i != n && lock(*items[i], txn))
+            ++i;
+        return i;
+    }
+    virtual unsigned check_batch(TransItem** items, unsigned n, Transaction& txn) {
+        unsigned i = 0;
+        while (i != n && check(*items[i], txn))
+            ++i;
+        return i;
+    }
+    virtual void install_batch(TransItem** items, unsigned n, Transaction& txn) {
+        for (unsigned i = 0; i != n; ++i)
+            install(*items[i], txn);
+    }
 };
 
 typedef TObject Shared;
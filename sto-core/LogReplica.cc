@@ -0,0 +1,266 @@
+#include "LogReplica.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <unistd.h>
+#include "Sto.hh"
+
+std::atomic<LogReplica*> LogReplica::active_;
+
+static bool read_all(int fd, char* p, size_t n) {
+    while (n) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+static uint64_t wall_ns() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+LogReplica::LogReplica(int fd, int nthreads, int first_thread_id,
+                       std::function<void(const record&, int)> f, size_t txn_records)
+    : fd_(fd), nthreads_(std::max(nthreads, 1)), first_thread_id_(first_thread_id),
+      f_(std::move(f)), txn_records_(std::max(txn_records, size_t(1))), ok_(false),
+      parts_(nthreads_), applied_epoch_(0), generation_(0), running_(0), quit_(false) {
+    always_assert(first_thread_id_ + nthreads_ <= MAX_THREADS);
+}
+
+LogReplica::~LogReplica() {
+    join();
+    LogReplica* me = this;
+    active_.compare_exchange_strong(me, nullptr);
+}
+
+void LogReplica::start() {
+    assert(!receiver_.joinable());
+    LogReplica* none = nullptr;
+    always_assert(active_.compare_exchange_strong(none, this), "one replica at a time");
+    receiver_ = std::thread(&LogReplica::run, this);
+}
+
+bool LogReplica::join() {
+    if (receiver_.joinable())
+        receiver_.join();
+    return ok_;
+}
+
+LogReplica::stats LogReplica::statistics() const {
+    std::lock_guard<std::mutex> lk(stats_mu_);
+    return stats_;
+}
+
+void LogReplica::run() {
+    TThread::set_id(first_thread_id_);
+    for (int i = 1; i < nthreads_; ++i)
+        appliers_.emplace_back(&LogReplica::run_applier, this, i);
+
+    std::vector<char> frame;
+    TxnLog::ship_header h;
+    while (read_all(fd_, reinterpret_cast<char*>(&h), sizeof(h))) {
+        if (h.logger == TxnLog::ship_end) {
+            // the primary stopped, after marking everything it logged
+            ok_ = pending_.empty();
+            std::lock_guard<std::mutex> lk(stats_mu_);
+            stats_.bytes += sizeof(h);
+            break;
+        }
+        if (streams_.empty())
+            streams_.resize(h.nloggers);
+        if (h.logger >= streams_.size() || h.nloggers != streams_.size())
+            break;
+        frame.resize(h.length);
+        if (!read_all(fd_, frame.data(), frame.size()))
+            break;
+        size_t received_bytes = sizeof(h) + frame.size();
+
+        // Walk the round: transactions wait in pending_ for their epoch,
+        // the marker at the end completes a prefix of epochs
+        stream& s = streams_[h.logger];
+        tid_type received = 0;
+        size_t pos = 0;
+        bool valid = true, inflated = false;
+        while (pos + sizeof(TxnLog::txn_header) <= frame.size()) {
+            auto th = reinterpret_cast<const TxnLog::txn_header*>(&frame[pos]);
+            size_t len = sizeof(TxnLog::txn_header) + th->length;
+            if (th->type == TxnLog::rec_lz4 && !inflated) {
+                // a compressed round: inflating leaves [0, pos) as it was
+                TxnLog::inflate(frame);
+                inflated = true;
+                continue;
+            }
+            if (th->type == TxnLog::rec_epoch) {
+                s.marker = std::max(s.marker, th->epoch);
+                s.marker_ns = h.sent_ns;
+            } else if (th->type != TxnLog::rec_txn || pos + len > frame.size()) {
+                valid = false;
+                break;
+            } else {
+                auto& p = pending_[th->epoch];
+                p.insert(p.end(), &frame[pos], &frame[pos] + len);
+                const char* w = reinterpret_cast<const char*>(th + 1);
+                for (uint32_t k = 0; k != th->nrecords; ++k) {
+                    auto wh = reinterpret_cast<const TxnLog::write_header*>(w);
+                    received = std::max(received, wh->tid);
+                    w += sizeof(*wh) + TxnLog::pad(wh->keylen) + TxnLog::pad(wh->vallen);
+                }
+            }
+            pos += len;
+        }
+        if (!valid || pos != frame.size())
+            break;
+        {
+            std::lock_guard<std::mutex> lk(stats_mu_);
+            stats_.bytes += received_bytes;
+            stats_.received_tid = std::max(stats_.received_tid, received);
+            stats_.lag_tids = (stats_.received_tid - std::min(stats_.applied_tid, stats_.received_tid))
+                / TransactionTid::increment_value;
+        }
+
+        epoch_type complete = ~epoch_type(0);
+        for (auto& x : streams_)
+            complete = std::min(complete, x.marker);
+        if (complete > applied_epoch_.load(std::memory_order_relaxed))
+            apply_through(complete);
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(apply_mu_);
+        quit_ = true;
+    }
+    apply_cv_.notify_all();
+    for (auto& t : appliers_)
+        t.join();
+    appliers_.clear();
+}
+
+void LogReplica::run_applier(int i) {
+    TThread::set_id(first_thread_id_ + i);
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lk(apply_mu_);
+    while (true) {
+        apply_cv_.wait(lk, [&] { return quit_ || generation_ != seen; });
+        if (quit_)
+            return;
+        seen = generation_;
+        lk.unlock();
+        apply_part(i);
+        lk.lock();
+        if (--running_ == 0)
+            done_cv_.notify_one();
+    }
+}
+
+void LogReplica::apply_through(epoch_type e) {
+    // Partition the batch's records by key, in log order
+    auto end = pending_.upper_bound(e);
+    uint64_t nrecords = 0;
+    for (auto it = pending_.begin(); it != end; ++it) {
+        const std::vector<char>& txns = it->second;
+        size_t pos = 0;
+        while (pos != txns.size()) {
+            auto th = reinterpret_cast<const TxnLog::txn_header*>(&txns[pos]);
+            const char* p = reinterpret_cast<const char*>(th + 1);
+            for (uint32_t k = 0; k != th->nrecords; ++k) {
+                auto w = reinterpret_cast<const TxnLog::write_header*>(p);
+                const char* key = p + sizeof(*w);
+                parts_[TxnLog::partition(w, nthreads_)].push_back(
+                    {w->object_id, key, w->keylen, key + TxnLog::pad(w->keylen), w->vallen,
+                     w->tid, th->epoch, w->flags});
+                p += sizeof(*w) + TxnLog::pad(w->keylen) + TxnLog::pad(w->vallen);
+            }
+            nrecords += th->nrecords;
+            pos += sizeof(*th) + th->length;
+        }
+    }
+
+    // Nothing the batch commits is visible until all of it is
+    tid_type newest = 0;
+    for (auto& part : parts_)
+        for (auto& r : part)
+            newest = std::max(newest, r.tid);
+    Transaction::hold_read_tid();
+    {
+        std::lock_guard<std::mutex> lk(apply_mu_);
+        running_ = nthreads_ - 1;
+        ++generation_;
+    }
+    apply_cv_.notify_all();
+    apply_part(0);
+    {
+        std::unique_lock<std::mutex> lk(apply_mu_);
+        done_cv_.wait(lk, [&] { return running_ == 0; });
+    }
+    Transaction::release_read_tid();
+    applied_epoch_.store(e, std::memory_order_release);
+    pending_.erase(pending_.begin(), end);
+
+    uint64_t completed_ns = 0;
+    for (auto& s : streams_)
+        completed_ns = std::max(completed_ns, s.marker_ns);
+    double lag_ms = std::max(double(int64_t(wall_ns() - completed_ns)), 0.0) / 1e6;
+    std::lock_guard<std::mutex> lk(stats_mu_);
+    stats_.applied_epoch = e;
+    stats_.applied_tid = std::max(stats_.applied_tid, newest);
+    stats_.lag_tids = (stats_.received_tid - std::min(stats_.applied_tid, stats_.received_tid))
+        / TransactionTid::increment_value;
+    stats_.lag_ms = lag_ms;
+    stats_.max_lag_ms = std::max(stats_.max_lag_ms, lag_ms);
+    stats_.records += nrecords;
+    ++stats_.batches;
+}
+
+void LogReplica::apply_part(int i) {
+    std::vector<record>& part = parts_[i];
+    std::stable_sort(part.begin(), part.end(), [](const record& a, const record& b) {
+        return a.tid < b.tid;
+    });
+    // partitions share no keys, so these transactions conflict only with
+    // the replica's own writers
+    for (size_t b = 0; b < part.size(); b += txn_records_) {
+        size_t e = std::min(b + txn_records_, part.size());
+        TRANSACTION_E {
+            for (size_t k = b; k != e; ++k)
+                f_(part[k], i);
+        } RETRY_E(true);
+    }
+    part.clear();
+}
+
+void LogReplica::report(FILE* f) {
+    LogReplica* r = active_.load(std::memory_order_acquire);
+    if (!r)
+        return;
+    stats s = r->statistics();
+    fprintf(f, "$ replica: epoch %llu applied, lag %llu commits, %.3f ms (max %.3f ms); "
+            "%llu records in %llu batches, %.1f MB received\n",
+            (unsigned long long) s.applied_epoch, (unsigned long long) s.lag_tids,
+            s.lag_ms, s.max_lag_ms, (unsigned long long) s.records,
+            (unsigned long long) s.batches, s.bytes / 1e6);
+}
+
+void LogReplica::report_json(std::ostream& out) {
+    LogReplica* r = active_.load(std::memory_order_acquire);
+    if (!r) {
+        out << "null";
+        return;
+    }
+    stats s = r->statistics();
+    out << "{\"applied_epoch\": " << s.applied_epoch
+        << ", \"applied_tid\": " << s.applied_tid
+        << ", \"received_tid\": " << s.received_tid
+        << ", \"lag_tids\": " << s.lag_tids
+        << ", \"lag_ms\": " << s.lag_ms
+        << ", \"max_lag_ms\": " << s.max_lag_ms
+        << ", \"records\": " << s.records
+        << ", \"batches\": " << s.batches
+        << ", \"bytes\": " << s.bytes << "}";
+}
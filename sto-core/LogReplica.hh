@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "TxnLog.hh"
+
+// A read replica fed by a primary's log stream (TxnLog::start_shipping).
+//
+// A receiver thread reads the stream and gathers the transactions it
+// carries by epoch. Once every logger's stream has passed an epoch marker,
+// all transactions of that epoch and earlier have arrived, and the replica
+// applies them as one batch: records are partitioned by key as in
+// TxnLog::recover, and each of nthreads threads applies its partition in
+// version order, calling f(r, i) on thread i inside transactions of up to
+// txn_records writes. f writes r's value to the replica's copy of the
+// object, transactionally.
+//
+// While a batch applies, the replica holds back the read snapshot
+// (Transaction::hold_read_tid), so read-only transactions on the replica
+// (ROTRANSACTION, or SITRANSACTION(true)) read MVCC objects as of the last
+// batch and never see part of one. The replica's objects must start out
+// equal to the primary's as of start_shipping().
+//
+// Lag is reported in commits, between the newest write received and the
+// newest applied, and in milliseconds, from the end of the primary's round
+// that completed a batch to the batch becoming visible here. The latter
+// compares the two machines' clocks.
+class LogReplica {
+public:
+    typedef TxnLog::epoch_type epoch_type;
+    typedef TxnLog::tid_type tid_type;
+    typedef TxnLog::record record;
+
+    struct stats {
+        epoch_type applied_epoch = 0;
+        tid_type received_tid = 0;  // newest primary version received
+        tid_type applied_tid = 0;   // newest applied and visible
+        uint64_t lag_tids = 0;      // commits between them
+        double lag_ms = 0;          // of the last batch
+        double max_lag_ms = 0;
+        uint64_t bytes = 0;         // of log received
+        uint64_t records = 0;       // applied
+        uint64_t batches = 0;
+    };
+
+    static constexpr size_t default_txn_records = 64;
+
+    // Reads the stream from fd, which stays open. The receiver runs as
+    // TThread id first_thread_id and the other appliers as the ids after it.
+    LogReplica(int fd, int nthreads, int first_thread_id,
+               std::function<void(const record&, int)> f,
+               size_t txn_records = default_txn_records);
+    ~LogReplica();
+
+    void start();
+    // Waits for the stream to end; false unless it ended with the
+    // primary's TxnLog::stop() and everything was applied
+    bool join();
+
+    epoch_type applied_epoch() const {
+        return applied_epoch_.load(std::memory_order_acquire);
+    }
+    stats statistics() const;
+
+    // Lag and throughput of the running replica, if any, for
+    // Transaction::print_stats and print_stats_json
+    static void report(FILE* f);
+    static void report_json(std::ostream& out);
+
+private:
+    struct stream {
+        epoch_type marker = 0;  // every transaction up to here has arrived
+        uint64_t marker_ns = 0; // the primary's clock when it did
+    };
+
+    int fd_;
+    int nthreads_;
+    int first_thread_id_;
+    std::function<void(const record&, int)> f_;
+    size_t txn_records_;
+    std::thread receiver_;
+    bool ok_;
+
+    std::vector<stream> streams_;
+    // transaction records not yet applied, by epoch
+    std::map<epoch_type, std::vector<char>> pending_;
+    std::vector<std::vector<record>> parts_;
+    std::atomic<epoch_type> applied_epoch_;
+
+    // appliers wait for a new generation, and count down when done
+    std::vector<std::thread> appliers_;
+    std::mutex apply_mu_;
+    std::condition_variable apply_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_;
+    int running_;
+    bool quit_;
+
+    mutable std::mutex stats_mu_;
+    stats stats_;
+
+    static std::atomic<LogReplica*> active_;
+
+    void run();
+    void run_applier(int i);
+    void apply_through(epoch_type e);
+    void apply_part(int i);
+};
@@ -9,6 +9,8 @@ public:
     template <typename T>
     static void read(TransProxy item, MvHistory<T> *h) {
         Transaction &t = item.transaction();
+        if (t.snapshot_isolation())
+            return;  // snapshot reads are not validated
         TransItem &it = item.item();
         it.__or_flags(TransItem::read_bit);
         it.rdata_.v = Packer<MvHistory<T>*>::pack(t.buf_, h);
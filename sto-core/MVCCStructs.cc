@@ -1,6 +1,11 @@
 #include <bitset>
 
 #include "MVCCStructs.hh"
+#if MVCC_BG_FLATTEN
+#include <unistd.h>
+#include "PlatformFeatures.hh"
+#include "ServiceThreads.hh"
+#endif
 
 std::ostream& operator<<(std::ostream& w, MvStatus s) {
     switch (s) {
@@ -40,6 +45,224 @@ void MvHistoryBase::print_prevs(size_t max) const {
     }
 }
 
+#if MVCC_ARENA
+__thread MvArena::thread_state MvArena::ts_;
+std::mutex MvArena::pool_lock_;
+MvArena::segment* MvArena::pool_;
+size_t MvArena::npool_;
+
+void* MvArena::allocate(size_t sz) {
+    sz = (sz + object_align - 1) & ~(object_align - 1);
+    thread_state& t = ts_;
+    auto epoch = Transaction::global_epochs.global_epoch.load(std::memory_order_relaxed);
+    if (!t.seg || t.next + sz > t.end
+        || (epoch != t.epoch
+            && size_t(t.next - reinterpret_cast<char*>(t.seg)) > segment_size / 8)) {
+        if (t.seg) {
+            // close the old segment: drop the bias, keep its live count
+            size_t delta = open_bias - t.nalloc;
+            if (t.seg->remaining.fetch_sub(delta) == delta)
+                free_segment(t.seg);
+        }
+        t.seg = new_segment();
+        t.next = reinterpret_cast<char*>(t.seg) + header_size;
+        t.end = reinterpret_cast<char*>(t.seg) + segment_size;
+        t.nalloc = 0;
+        t.epoch = epoch;
+    }
+    void* p = t.next;
+    t.next += sz;
+    ++t.nalloc;
+    return p;
+}
+
+void MvArena::release(void* p) {
+    auto s = reinterpret_cast<segment*>(reinterpret_cast<uintptr_t>(p) & ~(segment_size - 1));
+    if (s->remaining.fetch_sub(1) == 1)
+        free_segment(s);
+}
+
+MvArena::segment* MvArena::new_segment() {
+    segment* s = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(pool_lock_);
+        if (pool_) {
+            s = pool_;
+            pool_ = s->next;
+            --npool_;
+        }
+    }
+    if (!s) {
+        s = static_cast<segment*>(aligned_alloc(segment_size, segment_size));
+        always_assert(s);
+    }
+    s->remaining.store(open_bias, std::memory_order_relaxed);
+    s->next = nullptr;
+    return s;
+}
+
+void MvArena::free_segment(segment* s) {
+    {
+        std::lock_guard<std::mutex> guard(pool_lock_);
+        if (npool_ < max_pool) {
+            s->next = pool_;
+            pool_ = s;
+            ++npool_;
+            return;
+        }
+    }
+    free(s);
+}
+#endif
+
+#if MVCC_RTID_STRIPES
+MvReadStripes::table MvReadStripes::tables_[MAX_THREADS];
+std::atomic<int> MvReadStripes::nthreads_;
+#endif
+
+#if MVCC_BG_FLATTEN
+MvFlattener::cell MvFlattener::q_[MvFlattener::capacity];
+std::atomic<size_t> MvFlattener::head_;
+std::atomic<size_t> MvFlattener::tail_;
+std::atomic<bool> MvFlattener::run_;
+std::vector<std::thread> MvFlattener::threads_;
+int MvFlattener::pin_ = -1;
+std::atomic<unsigned> MvFlattener::pushing_;
+std::atomic<unsigned> MvFlattener::busy_;
+std::atomic<bool> MvFlattener::moving_;
+
+bool MvFlattener::push(callback_type f, void* arg) {
+    if (!run_.load(std::memory_order_acquire))
+        return false;
+    // Pairs with advance_pin: either it sees us in pushing_, or we see
+    // moving_ or the pin it moved to
+    pushing_.fetch_add(1);
+    auto mine = Transaction::this_thread().epoch.load(std::memory_order_acquire);
+    auto pin = Transaction::snapshot_pins[pin_].load();
+    bool ok = !moving_.load() && mine != 0
+        && Transaction::signed_epoch_type(pin - mine) <= 0
+        && enqueue(f, arg);
+    pushing_.fetch_sub(1, std::memory_order_release);
+    return ok;
+}
+
+bool MvFlattener::enqueue(callback_type f, void* arg) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    cell* c;
+    while (true) {
+        c = &q_[pos & (capacity - 1)];
+        auto d = intptr_t(c->seq.load(std::memory_order_acquire)) - intptr_t(pos);
+        if (d == 0) {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (d < 0) {
+            return false;
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+    c->f = f;
+    c->arg = arg;
+    c->seq.store(pos + 1, std::memory_order_release);
+    TXP_ACCOUNT(txp_mvcc_flat_bg_depth, pos + 1 - head_.load(std::memory_order_relaxed));
+    return true;
+}
+
+bool MvFlattener::pop(callback_type& f, void*& arg) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    cell* c;
+    while (true) {
+        c = &q_[pos & (capacity - 1)];
+        auto d = intptr_t(c->seq.load(std::memory_order_acquire)) - intptr_t(pos + 1);
+        if (d == 0) {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (d < 0) {
+            return false;
+        } else {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+    f = c->f;
+    arg = c->arg;
+    c->seq.store(pos + capacity, std::memory_order_release);
+    return true;
+}
+
+// Moves the pin up to the current read epoch, so an idle queue doesn't
+// hold back GC, unless work is queued, running or being pushed
+void MvFlattener::advance_pin() {
+    auto& pin = Transaction::snapshot_pins[pin_];
+    auto re = Transaction::global_epochs.read_epoch.load(std::memory_order_acquire);
+    if (pin.load(std::memory_order_relaxed) == re || moving_.exchange(true))
+        return;
+    if (pushing_.load() == 0 && busy_.load() == 0 && depth() == 0)
+        pin.store(re);
+    moving_.store(false);
+}
+
+void MvFlattener::start(int n, int first_tid, int first_cpu) {
+    always_assert(threads_.empty());
+    always_assert(first_tid >= 0 && first_tid + n <= MAX_THREADS);
+    Transaction::tid_type tid;
+    pin_ = Transaction::pin_snapshot(tid);
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i != capacity; ++i)
+        q_[i].seq.store(i, std::memory_order_relaxed);
+    run_.store(true, std::memory_order_release);
+    for (int i = 0; i != n; ++i)
+        threads_.emplace_back(run, first_tid + i, first_cpu < 0 ? -1 : first_cpu + i);
+}
+
+void MvFlattener::stop() {
+    run_.store(false, std::memory_order_release);
+    for (auto& t : threads_)
+        t.join();
+    threads_.clear();
+    Transaction::unpin_snapshot(pin_);
+    pin_ = -1;
+}
+
+void MvFlattener::run(int tid, int cpu) {
+    TThread::set_id(tid);
+    // housekeeping CPUs, if any, take precedence over cpu
+    ServiceThreads::scope service("mvcc flattener");
+    if (cpu >= 0 && housekeeping_cpus().empty())
+        set_affinity(cpu);
+    threadinfo_t& thr = Transaction::tinfo[tid];
+    auto& ge = Transaction::global_epochs;
+    while (true) {
+        callback_type f;
+        void* arg;
+        busy_.fetch_add(1);
+        if (!pop(f, arg)) {
+            busy_.fetch_sub(1);
+            // Don't hold back GC while idle
+            thr.epoch.store(0, std::memory_order_release);
+            thr.write_snapshot_epoch.store(0, std::memory_order_release);
+            advance_pin();
+            if (!run_.load(std::memory_order_acquire) && !depth())
+                break;
+            usleep(idle_us);
+            continue;
+        }
+        // Same epoch announcement as Transaction::start()
+        thr.write_snapshot_epoch.store(ge.global_epoch.load(std::memory_order_acquire), std::memory_order_release);
+        thr.epoch.store(ge.read_epoch.load(std::memory_order_acquire), std::memory_order_release);
+        thr.rcu_set.clean_until(ge.active_epoch.load(std::memory_order_acquire));
+        do {
+            auto t0 = read_tsc();
+            f(arg);
+            TXP_INCREMENT(txp_mvcc_flat_bg_runs);
+            TXP_ACCOUNT(txp_mvcc_flat_bg_cycles, read_tsc() - t0);
+        } while (pop(f, arg));
+        busy_.fetch_sub(1);
+    }
+    TThread::unregister_id(tid);
+}
+#endif
+
 #if !NDEBUG
 void MvHistoryBase::assert_status_fail(const char* description) {
     std::cerr << "MvHistoryBase::assert_status_fail: " << description << "\n";
@@ -3,10 +3,17 @@
 #pragma once
 
 #include <deque>
+#include <mutex>
+#include <optional>
+#include <sched.h>
 #include <stack>
 #include <thread>
+#include <vector>
 
+#include "HugeArena.hh"
+#include "MemStats.hh"
 #include "MVCCTypes.hh"
+#include "Persist.hh"
 #include "Transaction.hh"
 #include "TRcu.hh"
 #define MVCC_GARBAGE_DEBUG 1
@@ -37,14 +44,167 @@ enum MvStatus {
 
 std::ostream& operator<<(std::ostream& w, MvStatus s);
 
+#if MVCC_ARENA
+// Per-thread bump allocator for history elements. Each thread carves
+// elements out of its open segment, switching to a fresh one when it is
+// full or (once it is an eighth used) when the global epoch moves on, so
+// versions written together are reclaimed together. A segment counts its
+// live elements and goes back to a shared pool when the last one is
+// released; releases already arrive after an RCU grace period, so this is
+// safe once active_epoch has passed every element in it.
+class MvArena {
+public:
+    static constexpr size_t segment_size = size_t(1) << 16;
+    static constexpr size_t max_object_size = segment_size / 16;
+    static constexpr size_t object_align = 16;
+
+    static void* allocate(size_t sz);
+    static void release(void* p);
+
+private:
+    struct segment {
+        // live elements, plus open_bias while the segment is still open
+        std::atomic<size_t> remaining;
+        segment* next;  // pool link
+    };
+    struct thread_state {
+        segment* seg;
+        char* next;
+        char* end;
+        size_t nalloc;
+        TRcuSet::epoch_type epoch;
+    };
+
+    static constexpr size_t open_bias = size_t(1) << 40;
+    static constexpr size_t header_size = 64;
+    static constexpr size_t max_pool = 1024;
+    static_assert(sizeof(segment) <= header_size, "segment header too large");
+
+    static __thread thread_state ts_;
+    static std::mutex pool_lock_;
+    static segment* pool_;
+    static size_t npool_;
+
+    static segment* new_segment();
+    static void free_segment(segment* s);
+};
+#endif
+
+#if MVCC_BG_FLATTEN
+// Background delta-chain compaction. MvObject::cp_install pushes objects
+// whose delta chain crossed gc_flattening_length onto a bounded lock-free
+// queue, and the threads started by start() flatten them. Each thread uses
+// its own STO thread id and announces an epoch while it walks chains, just
+// like a transaction. push() fails when no threads run or the queue is
+// full; callers then fall back to an RCU callback.
+//
+// Between push and pop nobody announces an epoch for the object, so the
+// queue holds a snapshot pin of its own. A pusher only queues work when
+// the pin is no later than the epoch its transaction announced, and the
+// pin only moves forward when no work is queued, running or being pushed
+// (moving_ and pushing_ order the two sides). Objects freed through RCU
+// meanwhile therefore outlive their queued flattens.
+class MvFlattener {
+public:
+    typedef void (*callback_type)(void*);
+    static constexpr size_t capacity = size_t(1) << 12;
+    static constexpr unsigned idle_us = 20;
+
+    static bool push(callback_type f, void* arg);
+    // Starts n threads with STO ids first_tid, first_tid + 1, ...; pins
+    // them with set_affinity(first_cpu + i) unless first_cpu < 0.
+    static void start(int n, int first_tid, int first_cpu = -1);
+    // Stops and joins the threads after they drain the queue
+    static void stop();
+    static size_t depth() {
+        return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct cell {
+        std::atomic<size_t> seq;
+        callback_type f;
+        void* arg;
+    };
+
+    static cell q_[capacity];
+    alignas(CACHE_LINE_SIZE) static std::atomic<size_t> head_;
+    alignas(CACHE_LINE_SIZE) static std::atomic<size_t> tail_;
+    static std::atomic<bool> run_;
+    static std::vector<std::thread> threads_;
+    static int pin_;                        // Transaction::snapshot_pins slot
+    static std::atomic<unsigned> pushing_;  // pushers past their pin check
+    static std::atomic<unsigned> busy_;     // threads popping or flattening
+    static std::atomic<bool> moving_;       // the pin is being advanced
+
+    static bool pop(callback_type& f, void*& arg);
+    static bool enqueue(callback_type f, void* arg);
+    static void advance_pin();
+    static void run(int tid, int cpu);
+};
+#endif
+
+#if MVCC_RTID_STRIPES
+// Per-thread read timestamps, striped by version address. A committing
+// reader raises its own thread's stripe for the version it read, so read
+// traffic stays on thread-local cache lines. Writers take the maximum
+// over all threads' stripes as a conservative rtid for the version.
+class MvReadStripes {
+public:
+    using tid_type = TransactionTid::type;
+    static constexpr unsigned nstripes = MVCC_RTID_STRIPES;
+    static_assert((nstripes & (nstripes - 1)) == 0, "MVCC_RTID_STRIPES must be a power of two");
+
+    static void note(const void* h, tid_type tid) {
+        int id = TThread::id();
+        auto& s = tables_[id].s[index(h)];
+        if (s.load(std::memory_order_relaxed) < tid) {
+            // Ordered before the reader's scan of newer versions, as the
+            // rtid_ CAS was
+            s.store(tid, std::memory_order_seq_cst);
+        }
+        if (id >= nthreads_.load(std::memory_order_relaxed))
+            raise_nthreads(id + 1);
+    }
+    static tid_type max(const void* h) {
+        unsigned i = index(h);
+        tid_type m = 0;
+        for (int t = 0, n = nthreads_.load(std::memory_order_acquire); t != n; ++t)
+            m = std::max(m, tables_[t].s[i].load(std::memory_order_acquire));
+        return m;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) table {
+        std::atomic<tid_type> s[nstripes];
+    };
+    static table tables_[MAX_THREADS];
+    static std::atomic<int> nthreads_;
+
+    static unsigned index(const void* h) {
+        return ((reinterpret_cast<uintptr_t>(h) >> 4) * 0x9E3779B97F4A7C15ULL) >> 40 & (nstripes - 1);
+    }
+    static void raise_nthreads(int n) {
+        int cur = nthreads_.load(std::memory_order_relaxed);
+        while (cur < n && !nthreads_.compare_exchange_weak(cur, n)) {
+        }
+    }
+};
+#endif
+
 class MvHistoryBase {
 public:
     using tid_type = TransactionTid::type;
 
     MvHistoryBase() = delete;
     MvHistoryBase(void* obj, tid_type tid, MvStatus status)
-        : status_(status), wtid_(tid), rtid_(tid), prev_(nullptr),
+        : status_(status), ring_slot_(false), sparse_(0), wtid_(tid), rtid_(tid), prev_(nullptr),
           obj_(obj) {
+#if MVCC_SKIP_LEVELS
+        ord_ = 0;
+        for (auto& s : skip_)
+            s = {nullptr, 0};
+#endif
     }
 
 #if NDEBUG
@@ -62,10 +222,46 @@ public:
     void print_prevs(size_t max = 1000) const;
 
     std::atomic<MvStatus> status_;  // Status of this element
+    bool ring_slot_;  // Lives in an MvRingObject's ring
+    uint8_t sparse_;  // Sparse delta: versions back to the full one; 0 if full
     tid_type wtid_;  // Write TID
     std::atomic<tid_type> rtid_;  // Read TID
     std::atomic<MvHistoryBase*> prev_;
     void* obj_;  // Parent object
+
+#if MVCC_SKIP_LEVELS
+    // Skip targets carry their wtid so readers can decide to jump without
+    // touching the target: a reader only jumps to elements newer than its
+    // tid, which GC cannot have freed yet (same argument as the prev_ walk).
+    struct skip_type {
+        MvHistoryBase* h;
+        tid_type wtid;
+    };
+    uint32_t ord_;  // Position in the chain when linked
+    skip_type skip_[MVCC_SKIP_LEVELS];
+
+    // Derive skip pointers from the element this one is linked in front of;
+    // only prev's own fields are read
+    void link_skips(const MvHistoryBase* prev) {
+        ord_ = prev->ord_ + 1;
+        uint32_t stride = 1;
+        for (int l = 0; l != MVCC_SKIP_LEVELS; ++l) {
+            stride *= MVCC_SKIP_STRIDE;
+            if (prev->ord_ % stride == 0)
+                skip_[l] = {const_cast<MvHistoryBase*>(prev), prev->wtid_};
+            else
+                skip_[l] = prev->skip_[l];
+        }
+    }
+
+    // Farthest skip target known to be newer than tid, or nullptr
+    MvHistoryBase* skip_past(tid_type tid) const {
+        for (int l = MVCC_SKIP_LEVELS - 1; l >= 0; --l)
+            if (skip_[l].h && skip_[l].wtid > tid)
+                return skip_[l].h;
+        return nullptr;
+    }
+#endif
 };
 
 template <typename T>
@@ -77,9 +273,12 @@ public:
     typedef MvObject<T> object_type;
     typedef commutators::Commutator<T> comm_type;
 
+    // Longest run of sparse deltas between full versions (MVCC_SPARSE_DELTAS)
+    static constexpr unsigned sparse_limit = mvcc_sparse_deltas<T>::value;
+
     MvHistory() = delete;
     explicit MvHistory(object_type *obj)
-        : MvHistory(obj, 0, nullptr) {
+        : MvHistoryBase(obj, 0, PENDING), v_() {
     }
     explicit MvHistory(
             object_type *obj, tid_type ntid, const T& nv)
@@ -114,7 +313,7 @@ public:
     // Enqueues the deleted version for future cleanup
     inline void enqueue_for_committed() {
         assert_status((status() & COMMITTED_DELTA) == COMMITTED, "enqueue_for_committed");
-        Transaction::rcu_call(gc_committed_cb, this);
+        Transaction::rcu_call<gc_committed_cb>(this);
     }
 
     // Retrieve the object for which this history element is intended
@@ -128,7 +327,11 @@ public:
 
     // Returns the current rtid
     inline tid_type rtid() const {
+#if MVCC_RTID_STRIPES
+        return std::max(rtid_.load(), MvReadStripes::max(this));
+#else
         return rtid_;
+#endif
     }
 
 private:
@@ -218,25 +421,40 @@ public:
         return (status_ & mask) == expected;
     }
 
-    // Spin-wait on interested item
+    // Wait on interested item: spin for MVCC_PENDING_SPINS, then yield
     void wait_if_pending(MvStatus &s) const {
-        while (s & PENDING) {
-            // TODO: implement a backoff or something
-            relax_fence();
+        if (!(s & PENDING))
+            return;
+        PhaseProfile::timer pt(ph_lock_spin);
+#if STO_PROFILE_COUNTERS > 1
+        auto t0 = read_tsc();
+#endif
+        unsigned spins = 0;
+        do {
+            if (MVCC_PENDING_SPINS && spins >= MVCC_PENDING_SPINS) {
+                TXP_INCREMENT(txp_mvcc_pending_yields);
+                sched_yield();
+            } else {
+                ++spins;
+                relax_fence();
+            }
             s = status();
-        }
+        } while (s & PENDING);
+        TXP_INCREMENT(txp_mvcc_pending_waits);
+#if STO_PROFILE_COUNTERS > 1
+        TXP_ACCOUNT(txp_mvcc_pending_cycles, read_tsc() - t0);
+#endif
     }
 
     inline T& v() {
-        if (status_is(DELTA)) {
-            enflatten();
-        }
-        return v_;
+        return *vp();
     }
 
     inline T* vp() {
         if (status_is(DELTA)) {
             enflatten();
+        } else if (sparse_limit && sparse_) {
+            return sparse_vp();
         }
         return &v_;
     }
@@ -246,6 +464,11 @@ public:
         return wtid_;
     }
 
+    // Sparse deltas back to the nearest full version; 0 if this is one
+    inline unsigned sparse_depth() const {
+        return sparse_;
+    }
+
 private:
     static void gc_committed_cb(void* ptr) {
         history_type* h = static_cast<history_type*>(ptr);
@@ -272,9 +495,9 @@ private:
                    && h->status_.compare_exchange_weak(status, MvStatus(status | GARBAGE))) {
             }
 #endif
-            Transaction::rcu_call(gc_deleted_cb, h);
+            Transaction::rcu_call<gc_deleted_cb>(h);
             h->assert_status(!(status & (LOCKED | PENDING)), "gc_committed_cb unlocked not pending");
-            if ((status & COMMITTED_DELTA) == COMMITTED) {
+            if ((status & COMMITTED_DELTA) == COMMITTED && !h->sparse_) {
                 break;
             }
         }
@@ -310,6 +533,7 @@ private:
     // To be called from the source of the flattening.
     void flatten(int old_status, bool fg) {
         assert(old_status == COMMITTED_DELTA);
+        PhaseProfile::call_timer pt(ph_mvcc_flatten);
 
         // Current element is the one initiating the flattening here. It is not
         // included in the trace, but it is included in the committed trace.
@@ -322,7 +546,16 @@ private:
         }
 
         TXP_INCREMENT(txp_mvcc_flat_versions);
-        T value {curr->v_};
+        alignas(T) unsigned char sbuf[sparse_limit ? sizeof(T) : 1];
+        const T* base = &curr->v_;
+        if constexpr (sparse_limit != 0) {
+            if (curr->sparse_)
+                base = &curr->sparse_materialize(sbuf);
+        }
+        T value {*base};
+        // Committed deltas in a row fold into run, when comm_type can
+        // fold, and reach value as one delta
+        std::optional<comm_type> run;
         tid_type safe_wtid = curr->wtid();
         curr->update_rtid(this->wtid());
 
@@ -344,8 +577,24 @@ private:
                 hnext->update_rtid(this->wtid());
                 assert(!(status & DELETED));
                 if (status & DELTA) {
-                    hnext->c_.operate(value);
+                    if constexpr (commutators::is_foldable<comm_type>::value) {
+                        if (!run) {
+                            run.emplace(hnext->c_);
+                        } else if (!run->fold(hnext->c_)) {
+                            run->operate(value);
+                            run.emplace(hnext->c_);
+                        }
+                    } else {
+                        hnext->c_.operate(value);
+                    }
+                } else if (hnext->sparse_) {
+                    if (run) {
+                        run->operate(value);
+                        run.reset();
+                    }
+                    hnext->apply_patch(&value);
                 } else {
+                    run.reset();
                     value = hnext->v_;
                 }
             }
@@ -353,6 +602,9 @@ private:
             trace.pop();
             safe_wtid = hnext->wtid();
         }
+        if (run) {
+            run->operate(value);
+        }
 
         auto expected = COMMITTED_DELTA;
         if (status_.compare_exchange_strong(expected, LOCKED_COMMITTED_DELTA)) {
@@ -368,10 +620,258 @@ private:
         }
     }
 
+    // A sparse delta keeps this where a full version keeps v_: a bitmask of
+    // the 8-byte words of the value that differ from the previous committed
+    // version, followed by those words in order
+    struct sparse_patch {
+        static constexpr size_t nwords = (sizeof(T) + 7) / 8;
+        static constexpr size_t nmask = (nwords + 63) / 64;
+
+        std::atomic<T*> mat;  // Materialized value, for nontransactional readers
+        size_t nchanged;
+        uint64_t mask[nmask];
+
+        uint64_t* words() {
+            return reinterpret_cast<uint64_t*>(this + 1);
+        }
+        static size_t word_size(size_t i) {
+            return std::min(size_t(8), sizeof(T) - i * 8);
+        }
+    };
+
+    static size_t sparse_size(size_t nchanged) {
+        const history_type* h = nullptr;
+        auto offset = reinterpret_cast<uintptr_t>(&h->v_);
+        offset = (offset + alignof(sparse_patch) - 1) & ~(alignof(sparse_patch) - 1);
+        return offset + sizeof(sparse_patch) + nchanged * sizeof(uint64_t);
+    }
+    sparse_patch* patch() const {
+        return reinterpret_cast<sparse_patch*>(reinterpret_cast<uintptr_t>(this)
+                                               + sparse_size(0) - sizeof(sparse_patch));
+    }
+
+    // Returns a pending sparse delta of nv against base, the value of
+    // hprev, or nullptr if it would take more than half the memory of a
+    // full version
+    static history_type* new_sparse(object_type* obj, tid_type ntid, const history_type* hprev,
+                                    const T& base, const T& nv) {
+        if constexpr (sparse_limit == 0) {
+            return nullptr;
+        } else {
+            size_t room = sizeof(history_type) / 2;
+            if (sparse_size(0) >= room)
+                return nullptr;
+            size_t max_changed = (room - sparse_size(0)) / sizeof(uint64_t);
+            uint64_t mask[sparse_patch::nmask] = {};
+            size_t nchanged = 0;
+            auto b = reinterpret_cast<const char*>(&base);
+            auto n = reinterpret_cast<const char*>(&nv);
+            for (size_t i = 0; i != sparse_patch::nwords; ++i) {
+                if (memcmp(b + i * 8, n + i * 8, sparse_patch::word_size(i)) != 0) {
+                    if (++nchanged > max_changed)
+                        return nullptr;
+                    mask[i / 64] |= uint64_t(1) << (i % 64);
+                }
+            }
+
+            size_t sz = sparse_size(nchanged);
+            void* mem = history_type::operator new(sz, std::nothrow);
+            if (!mem)
+                return nullptr;
+            // Only the MvHistoryBase and c_ parts of the element exist
+            auto h = static_cast<history_type*>(new (mem) MvHistoryBase(obj, ntid, PENDING));
+            new (&h->c_) comm_type();
+            h->sparse_ = hprev->sparse_ + 1;
+            sparse_patch* p = h->patch();
+            new (&p->mat) std::atomic<T*>(nullptr);
+            p->nchanged = nchanged;
+            memcpy(p->mask, mask, sizeof(mask));
+            uint64_t* w = p->words();
+            for (size_t m = 0; m != sparse_patch::nmask; ++m) {
+                for (uint64_t bits = mask[m]; bits; bits &= bits - 1) {
+                    size_t i = m * 64 + __builtin_ctzll(bits);
+                    memcpy(w++, n + i * 8, sparse_patch::word_size(i));
+                }
+            }
+            return h;
+        }
+    }
+
+    // Frees a sparse delta made by new_sparse
+    void delete_sparse() {
+        if constexpr (sparse_limit != 0) {
+            sparse_patch* p = patch();
+            size_t sz = sparse_size(p->nchanged);
+            ::operator delete(p->mat.load(std::memory_order_relaxed));
+            c_.~comm_type();
+#if MVCC_GARBAGE_DEBUG
+            memset(static_cast<void*>(this), 0xFF, sizeof(MvHistoryBase));
+#endif
+            history_type::operator delete(this, sz);
+        }
+    }
+
+    // Overwrites the words this sparse delta changed in *out
+    void apply_patch(T* out) const {
+        if constexpr (sparse_limit != 0) {
+            sparse_patch* p = patch();
+            const uint64_t* w = p->words();
+            auto o = reinterpret_cast<char*>(out);
+            for (size_t m = 0; m != sparse_patch::nmask; ++m) {
+                for (uint64_t bits = p->mask[m]; bits; bits &= bits - 1) {
+                    size_t i = m * 64 + __builtin_ctzll(bits);
+                    memcpy(o + i * 8, w++, sparse_patch::word_size(i));
+                }
+            }
+        }
+    }
+
+    // Rebuilds this sparse delta's value in out, from the nearest full
+    // version below it. Each delta in the run was written against the
+    // committed version just below it, and only aborted versions can lie
+    // in between (see MvObject::new_sparse_history).
+    const T& sparse_materialize(void* out) {
+        if constexpr (sparse_limit != 0) {
+            history_type* run[sparse_limit];
+            unsigned n = 0;
+            history_type* h = this;
+            while (h->sparse_) {
+                assert(n < sparse_limit);
+                run[n++] = h;
+                MvStatus s;
+                do {
+                    h = h->prev();
+                    s = h->status();
+                    h->wait_if_pending(s);
+                } while (!(s & COMMITTED));
+            }
+            memcpy(out, h->vp(), sizeof(T));
+            while (n) {
+                run[--n]->apply_patch(static_cast<T*>(out));
+            }
+        }
+        return *static_cast<T*>(out);
+    }
+
+    // A sparse delta's value, materialized in the running transaction's
+    // scratch space or, outside transactions, once for the version
+    T* sparse_vp() {
+        if (TThread::txn && TThread::txn->in_progress()) {
+            T* out = Sto::tx_alloc<T>();
+            sparse_materialize(out);
+            return out;
+        }
+        sparse_patch* p = patch();
+        T* m = p->mat.load(std::memory_order_acquire);
+        if (!m) {
+            T* nm = static_cast<T*>(::operator new(sizeof(T)));
+            sparse_materialize(nm);
+            if (p->mat.compare_exchange_strong(m, nm, std::memory_order_acq_rel)) {
+                m = nm;
+            } else {
+                ::operator delete(nm);
+            }
+        }
+        return m;
+    }
+
     comm_type c_;
     T v_;
 
+#if MVCC_ARENA
+    static constexpr bool use_arena = sizeof(MvHistoryBase) + sizeof(comm_type) + sizeof(T) <= MvArena::max_object_size
+        && alignof(MvHistoryBase) <= MvArena::object_align && alignof(comm_type) <= MvArena::object_align
+        && alignof(T) <= MvArena::object_align;
+#endif
+public:
+    static void* operator new(size_t sz) {
+        MemStats::account(mem_mvcc_history, sz);
+#if MVCC_ARENA
+        if (use_arena && !HugeArena::persistent())
+            return MvArena::allocate(sz);
+#endif
+        return HugeArena::allocate(sz);
+    }
+    static void* operator new(size_t sz, const std::nothrow_t&) noexcept {
+        void* p;
+#if MVCC_ARENA
+        if (use_arena && !HugeArena::persistent())
+            p = MvArena::allocate(sz);
+        else
+#endif
+        if (HugeArena::serves(sz))
+            p = HugeArena::allocate(sz);
+        else
+            p = ::operator new(sz, std::nothrow);
+        if (p)
+            MemStats::account(mem_mvcc_history, sz);
+        return p;
+    }
+    static void* operator new(size_t, void* p) noexcept {
+        return p;
+    }
+    static void operator delete(void* p, size_t sz) {
+        MemStats::account(mem_mvcc_history, -int64_t(sz));
+#if MVCC_ARENA
+        if (use_arena && !HugeArena::persistent()) {
+            MvArena::release(p);
+            return;
+        }
+#endif
+        HugeArena::release(p, sz);
+    }
+private:
+
     friend class MvObject<T>;
+    template <typename, unsigned> friend class MvRingObject;
+};
+
+// Inline history slots of an MvObject beyond its first (ih_). Every slot
+// always holds a constructed element; free ones are UNUSED.
+template <typename T, unsigned N>
+class MvInlineSlots {
+public:
+    typedef MvHistory<T> history_type;
+
+    explicit MvInlineSlots(MvObject<T>* obj) {
+        for (unsigned i = 0; i != N; ++i) {
+            new (&s_[i].h) history_type(obj);
+            s_[i].h.status(UNUSED);
+        }
+    }
+    ~MvInlineSlots() {
+        for (unsigned i = 0; i != N; ++i)
+            s_[i].h.~history_type();
+    }
+
+    history_type* slot(unsigned i) {
+        return &s_[i].h;
+    }
+    bool contains(const history_type* h) const {
+        auto p = reinterpret_cast<uintptr_t>(h);
+        return p >= reinterpret_cast<uintptr_t>(s_)
+            && p < reinterpret_cast<uintptr_t>(s_ + N);
+    }
+
+private:
+    union slot_type {
+        history_type h;
+        slot_type() {}
+        ~slot_type() {}
+    };
+    slot_type s_[N];
+};
+
+template <typename T>
+class MvInlineSlots<T, 0> {
+public:
+    explicit MvInlineSlots(MvObject<T>*) {}
+    MvHistory<T>* slot(unsigned) {
+        return nullptr;
+    }
+    bool contains(const MvHistory<T>*) const {
+        return false;
+    }
 };
 
 template <typename T>
@@ -385,23 +885,26 @@ public:
     static constexpr int gc_flattening_length = 257;
 
 #if MVCC_INLINING
-    MvObject() : h_(&ih_), ih_(this) {
+    static constexpr unsigned inline_slots = mvcc_inline_slots<T>::value;
+    static_assert(inline_slots >= 1, "MvObject needs at least one inline slot");
+
+    MvObject() : h_(&ih_), ih_(this), ihx_(this) {
         if (std::is_trivial<T>::value) {
             ih_.v_ = T();
         }
         ih_.status(COMMITTED_DELETED);
     }
     explicit MvObject(const T& value)
-            : h_(&ih_), ih_(this, 0, value) {
+            : h_(&ih_), ih_(this, 0, value), ihx_(this) {
         ih_.status(COMMITTED);
     }
     explicit MvObject(T&& value)
-            : h_(&ih_), ih_(this, 0, std::move(value)) {
+            : h_(&ih_), ih_(this, 0, std::move(value)), ihx_(this) {
         ih_.status(COMMITTED);
     }
     template <typename... Args>
     explicit MvObject(Args&&... args)
-            : h_(&ih_), ih_(this, 0, T(std::forward<Args>(args)...)) {
+            : h_(&ih_), ih_(this, 0, T(std::forward<Args>(args)...)), ihx_(this) {
         ih_.status(COMMITTED);
     }
 #else
@@ -453,6 +956,10 @@ public:
         // Can only install pending versions
         hw->assert_status(hw->status_is(PENDING), "cp_lock pending");
 
+        // Under snapshot isolation, any live version written after our
+        // snapshot is a write-write conflict
+        const tid_type si_tid = Sto::snapshot_isolation() ? Sto::read_tid() : 0;
+
         std::atomic<MvHistoryBase*>* target = &h_;
         while (true) {
             // Discover target atomic on which to do CAS
@@ -461,12 +968,18 @@ public:
                 if (may_commute && !hw->can_precede(static_cast<history_type*>(t))) {
                     return false;
                 }
+                if (si_tid && !(t->status_.load(std::memory_order_acquire) & ABORTED)) {
+                    return false;
+                }
                 target = &t->prev_;
             } else if (!(t->status_.load(std::memory_order_acquire) & ABORTED)
-                       && t->rtid_.load(std::memory_order_acquire) > tid) {
+                       && static_cast<history_type*>(t)->rtid() > tid) {
                 return false;
             } else {
                 // Properly link h's prev_
+#if MVCC_SKIP_LEVELS
+                hw->link_skips(t);
+#endif
                 hw->prev_.store(t, std::memory_order_release);
 
                 // Attempt to CAS onto the target
@@ -490,7 +1003,8 @@ public:
         history_type* h = nullptr;
         for (h = hw->prev(); h; h = h->prev()) {
             if ((may_commute && !h->can_precede(hw))
-                || (h->status_is(COMMITTED) && h->rtid() > tid)) {
+                || (h->status_is(COMMITTED) && h->rtid() > tid)
+                || (si_tid && !h->status_is(ABORTED) && h->wtid() > si_tid)) {
                 hw->status_abort(ABORTED_WV2);
                 return false;
             }
@@ -511,7 +1025,11 @@ public:
     //               returns true if successful, false is aborted
     bool cp_check(const tid_type tid, history_type* hr) {
         // rtid update
+#if MVCC_RTID_STRIPES
+        MvReadStripes::note(hr, tid);
+#else
         hr->update_rtid(tid);
+#endif
 
         // Read version consistency check
         for (history_type* h = head(); h != hr; h = h->prev()) {
@@ -527,11 +1045,18 @@ public:
     void cp_install(history_type* h) {
         int s = h->status();
         h->assert_status((s & (PENDING | ABORTED)) == PENDING, "cp_install");
-        h->status((s & ~PENDING) | COMMITTED);
+        if (HugeArena::persistent())
+            persist_commit(h, MvStatus((s & ~PENDING) | COMMITTED));
+        else
+            h->status((s & ~PENDING) | COMMITTED);
         if (!(s & DELTA)) {
             cuctr_.store(0, std::memory_order_relaxed);
             flattenv_.store(0, std::memory_order_relaxed);
-            h->enqueue_for_committed();
+            // A sparse delta needs the versions below it until the next
+            // full version's GC frees them all
+            if (!h->sparse_) {
+                h->enqueue_for_committed();
+            }
         } else {
             int dc = cuctr_.load(std::memory_order_relaxed) + 1;
             if (dc <= gc_flattening_length) {
@@ -539,11 +1064,48 @@ public:
             } else if (flattenv_.load(std::memory_order_relaxed) == 0) {
                 cuctr_.store(0, std::memory_order_relaxed);
                 flattenv_.store(h->wtid(), std::memory_order_relaxed);
+#if MVCC_BG_FLATTEN
+                if (!MvFlattener::push(gc_flatten_cb, this))
+#endif
                 Transaction::rcu_call(gc_flatten_cb, this);
             }
         }
     }
 
+    // Repairs the chain of an object found in persistent memory after a
+    // restart, before any transaction runs. Versions still pending or
+    // aborted at the head of the chain never committed and are dropped;
+    // ones further down are marked aborted, since a newer version's skip
+    // pointers may still reach them. Read tids and delta locks are reset.
+    // Returns how many versions were discarded.
+    size_t recover_versions() {
+        size_t dropped = 0;
+        history_type* h = head();
+        while (h && (h->status() & (PENDING | ABORTED))) {
+            history_type* prev = h->prev();
+            h_.store(prev, std::memory_order_relaxed);
+            delete_history(h);
+            h = prev;
+            ++dropped;
+        }
+        for (; h; h = h->prev()) {
+            MvStatus s = h->status();
+            if ((s & PENDING) && !(s & ABORTED)) {
+                h->status(ABORTED);
+                ++dropped;
+            } else if ((s & LOCKED_COMMITTED_DELTA) == LOCKED_COMMITTED_DELTA)
+                h->status(COMMITTED_DELTA);
+            h->rtid_.store(h->wtid_, std::memory_order_relaxed);
+            if (HugeArena::persistent())
+                Persist::flush(h, sizeof(*h));
+        }
+        if (HugeArena::persistent()) {
+            Persist::flush(&h_, sizeof(h_));
+            Persist::fence();
+        }
+        return dropped;
+    }
+
     // Deletes the history element if it was new'ed, or set it as UNUSED if it
     // is the inlined version
     // !!! IMPORTANT !!!
@@ -552,6 +1114,8 @@ public:
     void delete_history(history_type* h) {
         if (is_inlined(h)) {
             h->status_.store(UNUSED, std::memory_order_release);
+        } else if (h->sparse_) {
+            h->delete_sparse();
         } else {
 #if MVCC_GARBAGE_DEBUG
             memset(h, 0xFF, sizeof(MvHistoryBase));
@@ -566,8 +1130,15 @@ public:
     history_type* find(const tid_type tid, const bool wait=true) const {
         history_type* h = head();
 
-        /* TODO: use something smarter than a linear scan */
         while (h) {
+#if MVCC_SKIP_LEVELS
+            // The chain is sorted by wtid, so everything skipped is newer
+            // than tid and needs neither a wait nor a visibility check
+            if (auto s = h->skip_past(tid)) {
+                h = static_cast<history_type*>(s);
+                continue;
+            }
+#endif
             auto status = h->status();
             auto wtid = h->wtid();
             h->assert_status(status & (PENDING | ABORTED | COMMITTED), "find");
@@ -612,8 +1183,10 @@ public:
 
     // Returns whether the given history element is the inlined version
     inline bool is_inlined(const history_type* h) const {
+        if (h->ring_slot_)
+            return true;
 #if MVCC_INLINING
-        return h == &ih_;
+        return h == &ih_ || ihx_.contains(h);
 #else
         (void)h;
         return false;
@@ -626,17 +1199,61 @@ public:
     template <typename... Args>
     history_type* new_history(Args&&... args) {
 #if MVCC_INLINING
-        auto status = ih_.status();
-        if (status == UNUSED &&
-                ih_.status_.compare_exchange_strong(status, PENDING)) {
-            // Use inlined history element
-            new (&ih_) history_type(this, std::forward<Args>(args)...);
-            return &ih_;
+        // Use an inlined history element if one is free, scanning the ring
+        // from just past the last slot handed out
+        unsigned start = islot_.load(std::memory_order_relaxed);
+        for (unsigned k = 0; k != inline_slots; ++k) {
+            unsigned i = (start + k) % inline_slots;
+            history_type* h = i ? ihx_.slot(i - 1) : &ih_;
+            auto status = h->status();
+            if (status == UNUSED &&
+                    h->status_.compare_exchange_strong(status, PENDING)) {
+                islot_.store((i + 1) % inline_slots, std::memory_order_relaxed);
+                new (h) history_type(this, std::forward<Args>(args)...);
+                return h;
+            }
         }
 #endif
         return new(std::nothrow) history_type(this, std::forward<Args>(args)...);
     }
 
+    // Returns a pending version of nv, written by a transaction that read
+    // hprev, as a sparse delta against hprev's value; nullptr if it should
+    // be a full version (new_history). The writer validates its read of
+    // hprev, so hprev stays the committed version just below this one only
+    // if it read at its commit tid: not under snapshot isolation or before
+    // mvcc_rw_upgrade().
+    history_type* new_sparse_history(tid_type tid, history_type* hprev, const T* nv) {
+        if (history_type::sparse_limit == 0 || !nv || HugeArena::persistent()
+            || Sto::snapshot_isolation() || Sto::read_tid() != tid) {
+            return nullptr;
+        }
+        // A full version at most every sparse_limit + 1
+        if ((hprev->status() & (COMMITTED | DELETED | ABORTED)) != COMMITTED
+            || hprev->sparse_ >= history_type::sparse_limit) {
+            return nullptr;
+        }
+        return history_type::new_sparse(this, tid, hprev, *hprev->vp(), *nv);
+    }
+
+#if MVCC_WRITE_INTENT
+    // Marks this object as about to be written by the calling thread's
+    // transaction; false if another transaction already holds the intent
+    bool try_intend_write() {
+        int me = TThread::id() + 1;
+        int cur = intent_.load(std::memory_order_relaxed);
+        if (cur == me)
+            return true;
+        return cur == 0 && intent_.compare_exchange_strong(cur, me, std::memory_order_acq_rel);
+    }
+    // Drops the calling thread's intent, if it holds one
+    void clear_write_intent() {
+        int me = TThread::id() + 1;
+        if (intent_.load(std::memory_order_relaxed) == me)
+            intent_.store(0, std::memory_order_release);
+    }
+#endif
+
     // Read-only
     const T& nontrans_access() const {
         history_type* h = head();
@@ -664,6 +1281,8 @@ public:
             if (h->status_is(COMMITTED)) {
                 if (h->status_is(DELTA)) {
                     h->enflatten();
+                } else if (h->sparse_) {
+                    h = materialize_sparse(h, next);
                 }
                 h->status(COMMITTED);
                 return h->v();
@@ -676,6 +1295,32 @@ public:
     }
 
 protected:
+    // Links a full copy of the committed sparse delta h above it, in place
+    // of the link from next (or the head), and returns the copy. Readers at
+    // h's tid find the copy first; its GC frees h.
+    history_type* materialize_sparse(history_type* h, history_type* next) {
+        history_type* f = new_history(h->wtid(), *h->vp());
+#if MVCC_SKIP_LEVELS
+        f->link_skips(h);
+#endif
+        f->prev_.store(h, std::memory_order_relaxed);
+        f->status(COMMITTED);
+        (next ? next->prev_ : h_).store(f, std::memory_order_release);
+        f->enqueue_for_committed();
+        return f;
+    }
+
+    // A committed version is durable once its status is: the element and
+    // the chain link leading to it reach memory first
+    void persist_commit(history_type* h, MvStatus committed) {
+        Persist::flush(h, sizeof(*h));
+        Persist::flush(&h_, sizeof(h_));
+        Persist::fence();
+        h->status(committed);
+        Persist::flush(&h->status_, sizeof(h->status_));
+        Persist::fence();
+    }
+
     static void gc_flatten_cb(void* ptr) {
         auto object = static_cast<MvObject<T>*>(ptr);
         auto flattenv = object->flattenv_.load(std::memory_order_relaxed);
@@ -699,10 +1344,75 @@ protected:
     std::atomic<MvHistoryBase*> h_;
     std::atomic<int> cuctr_ = 0;  // For gc-time flattening
     std::atomic<tid_type> flattenv_;
+#if MVCC_WRITE_INTENT
+    std::atomic<int> intent_ = 0;  // writer's thread id + 1, or 0
+#endif
 
 #if MVCC_INLINING
     history_type ih_;  // Inlined version
+    MvInlineSlots<T, inline_slots - 1> ihx_;  // Further inlined versions
+    std::atomic<unsigned> islot_ = 0;  // Ring position for new_history
 #endif
 
     friend class MvHistory<T>;
 };
+
+// An MvObject whose newest versions live in a ring of Slots history
+// elements inside it, handed out round-robin as GC frees them. A version
+// the ring can't hold, while older snapshots keep all Slots alive, goes to
+// the heap and is chained as usual. Writes to a quiet object then never
+// allocate, and readers at recent tids stay in its cache lines. GC
+// callbacks touch the ring, so the object must outlive them.
+template <typename T, unsigned Slots>
+class MvRingObject : public MvObject<T> {
+public:
+    typedef MvObject<T> object_type;
+    typedef typename object_type::history_type history_type;
+    static_assert(Slots >= 1, "MvRingObject needs a ring");
+
+    // Constructs like MvObject<T>, then moves the first version into the ring
+    template <typename... Args>
+    explicit MvRingObject(Args&&... args)
+        : object_type(std::forward<Args>(args)...), ring_(this) {
+        history_type* h0 = this->head();
+        history_type* h = ring_.slot(0);
+        h->~history_type();
+        new (h) history_type(this, h0->wtid(), h0->v());
+        h->status(h0->status());
+        h->ring_slot_ = true;
+        this->h_.store(h, std::memory_order_relaxed);
+        this->delete_history(h0);
+        pos_.store(1 % Slots, std::memory_order_relaxed);
+    }
+
+    MvRingObject(const MvRingObject&) = delete;
+    MvRingObject& operator=(const MvRingObject&) = delete;
+
+    // As MvObject<T>::new_history, trying the ring first
+    template <typename... Args>
+    history_type* new_history(Args&&... args) {
+        unsigned start = pos_.load(std::memory_order_relaxed);
+        for (unsigned k = 0; k != Slots; ++k) {
+            unsigned i = (start + k) % Slots;
+            history_type* h = ring_.slot(i);
+            auto status = h->status();
+            if (status == UNUSED &&
+                    h->status_.compare_exchange_strong(status, PENDING)) {
+                pos_.store((i + 1) % Slots, std::memory_order_relaxed);
+                new (h) history_type(this, std::forward<Args>(args)...);
+                h->ring_slot_ = true;
+                return h;
+            }
+        }
+        return object_type::new_history(std::forward<Args>(args)...);
+    }
+
+    // Whether h is one of the ring's elements
+    bool in_ring(const history_type* h) const {
+        return ring_.contains(h);
+    }
+
+private:
+    MvInlineSlots<T, Slots> ring_;
+    std::atomic<unsigned> pos_;
+};
@@ -18,6 +18,89 @@ template <typename T> class MvHistory;
 
 // Generic contained for MVCC abstractions applied to a given object
 template <typename T> class MvObject;
+// An MvObject keeping its newest versions in a ring of Slots elements
+template <typename T, unsigned Slots> class MvRingObject;
 #ifndef MVCC_INLINING
 #define MVCC_INLINING 0
 #endif
+
+// With MVCC_INLINING, the number of history slots embedded in each
+// MvObject<T>, used as a ring. Defaults to MVCC_INLINING; specialize for
+// small, frequently updated value types.
+template <typename T>
+struct mvcc_inline_slots
+    : std::integral_constant<unsigned, (MVCC_INLINING > 1 ? MVCC_INLINING : 1)> {};
+
+// Default size of the version ring TMvBox<T> and TMvArray<T, N> keep in
+// each element (MvRingObject) for small values; 0 keeps plain MvObjects.
+// Elements with a ring must outlive GC of their versions.
+#ifndef MVCC_RING_SLOTS
+#define MVCC_RING_SLOTS 0
+#endif
+template <typename T>
+struct mvcc_ring_slots
+    : std::integral_constant<unsigned, (std::is_trivially_copyable<T>::value && sizeof(T) <= 16
+                                        ? MVCC_RING_SLOTS : 0)> {};
+
+// MvObject<T>, or MvRingObject<T, Slots> if Slots is nonzero
+template <typename T, unsigned Slots>
+using mv_object_t = std::conditional_t<Slots != 0, MvRingObject<T, Slots>, MvObject<T>>;
+
+// Levels of skip pointers kept in each history element; level l points at
+// the nearest older element whose chain ordinal is a multiple of
+// MVCC_SKIP_STRIDE^(l+1). 0 disables them.
+#ifndef MVCC_SKIP_LEVELS
+#define MVCC_SKIP_LEVELS 0
+#endif
+#ifndef MVCC_SKIP_STRIDE
+#define MVCC_SKIP_STRIDE 8
+#endif
+
+// Allocate history elements from per-thread segments (MvArena) instead of
+// one heap allocation each
+#ifndef MVCC_ARENA
+#define MVCC_ARENA 0
+#endif
+
+// Longest run of sparse delta versions between two full ones. A version
+// written by a read-modify-write transaction can store just the 8-byte
+// words that differ from the version it read, when that takes at most half
+// the memory of a full one; readers rebuild it from the nearest full
+// version below. 0 disables them.
+#ifndef MVCC_SPARSE_DELTAS
+#define MVCC_SPARSE_DELTAS 0
+#endif
+static_assert(MVCC_SPARSE_DELTAS < 256, "MVCC_SPARSE_DELTAS too large");
+
+// Sparse delta run length for values of type T; only wide, trivially
+// copyable values are worth diffing
+template <typename T>
+struct mvcc_sparse_deltas
+    : std::integral_constant<unsigned, (std::is_trivially_copyable<T>::value && sizeof(T) >= 64
+                                        ? MVCC_SPARSE_DELTAS : 0)> {};
+
+// Hand long delta chains to MvFlattener threads, when running, instead of
+// flattening them from an RCU callback
+#ifndef MVCC_BG_FLATTEN
+#define MVCC_BG_FLATTEN 0
+#endif
+
+// Record committed reads in per-thread read-timestamp stripes (this many
+// per thread, a power of two) instead of CASing each version's rtid_.
+// 0 keeps the per-version rtid_ updates.
+#ifndef MVCC_RTID_STRIPES
+#define MVCC_RTID_STRIPES 0
+#endif
+
+// Eager write-write detection: a transaction that selects an MvObject for
+// update marks it with a write intent until it commits or aborts, and a
+// second writer aborts at select time instead of at cp_lock.
+#ifndef MVCC_WRITE_INTENT
+#define MVCC_WRITE_INTENT 0
+#endif
+
+// Spins a reader makes on a PENDING version before it starts yielding its
+// timeslice to the (possibly descheduled) writer. 0 spins forever.
+#ifndef MVCC_PENDING_SPINS
+#define MVCC_PENDING_SPINS 1024
+#endif
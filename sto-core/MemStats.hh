@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "TThread.hh"
+
+// Count bytes held by STO's internal structures
+#ifndef STO_MEMORY_STATS
+#define STO_MEMORY_STATS 1
+#endif
+
+enum MemCounters {
+    mem_tset = 0,        // usable tset pages
+    mem_transbuffer,     // TransactionBuffer blocks
+    mem_scratch,         // TransScratch zones
+    mem_rcu,             // TRcuSet groups and lane blocks
+    mem_mvcc_history,    // MVCC history elements
+    mem_index,           // pooled index elements
+    mem_count
+};
+
+struct mem_counters {
+    int64_t bytes_[mem_count];
+    mem_counters() {
+        reset();
+    }
+    int64_t bytes(int c) const {
+        return bytes_[c];
+    }
+    void reset() {
+        for (int i = 0; i != mem_count; ++i)
+            bytes_[i] = 0;
+    }
+};
+
+// Per-thread byte counts: allocations add and frees subtract on the
+// calling thread, so one thread's count goes negative when it frees
+// another's memory (RCU callbacks, handed-off groups). Only the sum over
+// threads, Transaction::mem_counters_combined(), is meaningful.
+class MemStats {
+public:
+    static void account(MemCounters c, int64_t n) {
+#if STO_MEMORY_STATS
+        std::atomic<int64_t>& b = slots_[TThread::id()].bytes[c];
+        b.store(b.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+#else
+        (void) c, (void) n;
+#endif
+    }
+    static int64_t thread_bytes(int id, int c) {
+        return slots_[id].bytes[c].load(std::memory_order_relaxed);
+    }
+    static const char* name(int c);
+
+private:
+    struct __attribute__((aligned(64))) slot {
+        std::atomic<int64_t> bytes[mem_count];
+    };
+    static slot slots_[MAX_THREADS];
+};
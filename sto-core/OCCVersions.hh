@@ -55,6 +55,14 @@ public:
     inline type cp_commit_tid_impl(Transaction& txn);
 };
 
+// Versions that Transaction::ro_observe can validate by value alone
+template <typename V>
+struct supports_ro_observe : std::false_type {};
+template <>
+struct supports_ro_observe<TVersion> : std::true_type {};
+template <>
+struct supports_ro_observe<TNonopaqueVersion> : std::true_type {};
+
 // XXX not sure if it's really used anywhere
 class TCommutativeVersion : BasicVersion<TCommutativeVersion> {
 public:
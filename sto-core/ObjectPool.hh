@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#include "compiler.hh"
+#include "HugeArena.hh"
+#include "MemStats.hh"
+
+// Per-thread free lists for one object size: table rows and index elements,
+// which are allocated and freed at high rates. Rows are freed from RCU
+// callbacks, so by the time one reaches release() its grace period is over
+// and the freeing thread can hand it straight to its next insert. Each
+// thread keeps at most max_cached objects and passes the rest on to
+// HugeArena, which falls back to the global allocator when not selected.
+template <size_t Size>
+class object_pool {
+public:
+    static constexpr size_t max_cached = 4096;
+
+    static void* allocate() {
+        thread_list& tl = tl_;
+        if (free_obj* o = tl.head) {
+            tl.head = o->next;
+            --tl.n;
+            return o;
+        }
+        return HugeArena::allocate(Size);
+    }
+    static void release(void* p) {
+        thread_list& tl = tl_;
+        if (unlikely(tl.n == max_cached)) {
+            HugeArena::release(p, Size);
+            return;
+        }
+        auto o = static_cast<free_obj*>(p);
+        o->next = tl.head;
+        tl.head = o;
+        ++tl.n;
+    }
+
+private:
+    struct free_obj {
+        free_obj* next;
+    };
+    struct thread_list {
+        free_obj* head;
+        size_t n;
+        ~thread_list() {
+            while (free_obj* o = head) {
+                head = o->next;
+                HugeArena::release(o, Size);
+            }
+            n = 0;
+        }
+    };
+    static_assert(Size >= sizeof(free_obj), "pooled objects must hold a pointer");
+
+    static thread_local thread_list tl_;
+};
+
+template <size_t Size>
+thread_local typename object_pool<Size>::thread_list object_pool<Size>::tl_;
+
+// Base for fixed-size table element types: `class row : public
+// pool_allocated<row>` routes new and delete through object_pool. Live
+// objects are counted as mem_index.
+template <typename T>
+struct pool_allocated {
+    static void* operator new(size_t sz) {
+        assert(sz == sizeof(T));
+        (void) sz;
+        MemStats::account(mem_index, sizeof(T));
+        return object_pool<sizeof(T)>::allocate();
+    }
+    static void operator delete(void* p, size_t sz) {
+        assert(sz == sizeof(T));
+        (void) sz;
+        MemStats::account(mem_index, -int64_t(sizeof(T)));
+        object_pool<sizeof(T)>::release(p);
+    }
+};
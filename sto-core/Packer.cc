@@ -1,12 +1,16 @@
 #include "Packer.hh"
+#include "MemStats.hh"
 
 constexpr size_t TransactionBuffer::default_capacity;
+constexpr size_t TransactionBuffer::max_restart_capacity;
 
 void TransactionBuffer::hard_get_space(size_t needed) {
     size_t s = std::max(needed, e_ ? e_->capacity * 2 : default_capacity);
     elt* ne = (elt*) new char[sizeof(elthdr) + s];
+    MemStats::account(mem_transbuffer, sizeof(elthdr) + s);
     ne->next = e_;
     ne->pos = 0;
+    ne->dtor_end = 0;
     ne->capacity = s;
     if (e_)
         linked_size_ += e_->pos;
@@ -18,13 +22,25 @@ void TransactionBuffer::hard_clear(bool delete_all) {
         elt* e = e_->next;
         e_->next = e->next;
         e->clear();
+        MemStats::account(mem_transbuffer, -int64_t(sizeof(elthdr) + e->capacity));
         delete[] (char*) e;
     }
     if (e_)
         e_->clear();
     linked_size_ = 0;
-    if (e_ && delete_all) {
+    // don't keep an outsized block past the transaction that needed it
+    if (e_ && (delete_all || e_->capacity > max_restart_capacity)) {
+        MemStats::account(mem_transbuffer, -int64_t(sizeof(elthdr) + e_->capacity));
         delete[] (char*) e_;
         e_ = 0;
     }
 }
+
+void TransactionBuffer::shrink(size_t peak) {
+    if (e_ && e_->pos)
+        hard_clear(false);
+    if (e_ && HighWater::oversized(e_->capacity, peak, default_capacity)) {
+        hard_clear(true);
+        hard_get_space(std::min(peak, max_restart_capacity));
+    }
+}
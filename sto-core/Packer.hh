@@ -1,6 +1,9 @@
 #pragma once
 #include "compiler.hh"
+#include "HighWater.hh"
 #include <algorithm>
+#include <type_traits>
+#include <vector>
 
 class TransactionBuffer;
 
@@ -15,6 +18,17 @@ template <typename T,
                          && sizeof(T) <= sizeof(void*))>
     struct Packer {};
 
+// A key that stays put in memory for the whole transaction, such as one
+// stored in the indexed object. Sto::item(obj, stable_key(k)) references it
+// in place instead of copying it into the TransactionBuffer.
+template <typename T> struct StableKey {
+    const T* ptr;
+};
+template <typename T>
+inline StableKey<T> stable_key(const T& x) {
+    return StableKey<T>{&x};
+}
+
 
 // TransactionBuffer
 template <typename T> struct ObjectDestroyer {
@@ -66,16 +80,37 @@ public:
     template <typename T, typename U = T>
     const T* find(const U& x) const;
 
+    // Unique keys (Packer::pack_unique) are also listed by type, so a
+    // lookup skips the rest of the buffer. The key may be a buffer object
+    // (add_unique) or live elsewhere for the transaction (add_unique_ref).
+    template <typename T>
+    const T* find_unique(const T& x) const;
+    template <typename T, typename U>
+    T* add_unique(U&& x) {
+        T* p = &allocate<UniqueKey<T> >(std::forward<U>(x))->key;
+        unique_.push_back({ObjectDestroyer<T>::destroy, p});
+        return p;
+    }
+    template <typename T>
+    void add_unique_ref(const T* p) {
+        unique_.push_back({ObjectDestroyer<T>::destroy, p});
+    }
+
     size_t buffer_size() const {
         return linked_size_ + (e_ ? e_->pos : 0);
     }
     void clear() {
-        if (e_ && e_->pos)
+        unique_.clear();
+        size_t peak = 0;
+        if (unlikely(hw_.note(buffer_size(), peak)))
+            shrink(peak);
+        else if (e_ && e_->pos)
             hard_clear(false);
     }
 
 private:
     static constexpr size_t default_capacity = 4080;
+    static constexpr size_t max_restart_capacity = 2097152; // 2MB
     struct itemhdr {
         void (*destroyer)(void*);
         size_t size;
@@ -87,21 +122,31 @@ private:
         elt* next;
         size_t pos;
         size_t capacity;
+        size_t dtor_end;  // end of the last item that needs its destructor
     };
     struct elt : public elthdr {
         char buf[0];
+        // Trivially destructible items are never destroyed, so a block
+        // holding only those resets in O(1)
         void clear() {
             size_t off = 0;
-            while (off < pos) {
+            while (off < dtor_end) {
                 itemhdr* i = (itemhdr*) &buf[off];
                 i->destroyer(i + 1);
                 off += i->size;
             }
-            pos = 0;
+            pos = dtor_end = 0;
         }
     };
+    struct unique_entry {
+        void (*type)(void*);  // ObjectDestroyer<T>::destroy, as a type tag
+        const void* key;
+    };
+
     elt* e_;
     size_t linked_size_;
+    HighWater hw_;
+    std::vector<unique_entry> unique_;
 
     item* get_space(size_t needed) {
         if (!e_ || e_->pos + needed > e_->capacity)
@@ -111,14 +156,18 @@ private:
     }
     void hard_get_space(size_t needed);
     void hard_clear(bool delete_all);
+    void shrink(size_t peak);
 };
 
 template <typename T, typename... Args>
 T* TransactionBuffer::allocate(Args&&... args) {
     size_t isize = aligned_size(sizeof(itemhdr) + sizeof(T));
     item* space = this->get_space(isize);
+    // the destroyer also tags the item's type for find()
     space->destroyer = ObjectDestroyer<T>::destroy;
     space->size = isize;
+    if (!std::is_trivially_destructible<T>::value)
+        e_->dtor_end = e_->pos;
     return new (&space->buf[0]) T(std::forward<Args>(args)...);
 }
 
@@ -138,6 +187,15 @@ const T* TransactionBuffer::find(const U& x) const {
     return nullptr;
 }
 
+template <typename T>
+const T* TransactionBuffer::find_unique(const T& x) const {
+    void (*type)(void*) = ObjectDestroyer<T>::destroy;
+    for (const unique_entry& u : unique_)
+        if (u.type == type && *static_cast<const T*>(u.key) == x)
+            return static_cast<const T*>(u.key);
+    return nullptr;
+}
+
 
 
 template <typename T> struct Packer<T, true> {
@@ -151,6 +209,9 @@ template <typename T> struct Packer<T, true> {
     static void* pack_unique(TransactionBuffer& buf, const T& x) {
         return pack(buf, x);
     }
+    static void* pack_unique_stable(TransactionBuffer& buf, const T& x) {
+        return pack(buf, x);
+    }
     static void* repack(TransactionBuffer& buf, void*, const T& x) {
         return pack(buf, x);
     }
@@ -170,10 +231,23 @@ template <typename T> struct Packer<T, false> {
         return buf.template allocate<T>(std::forward<Args>(args)...);
     }
     static void* pack_unique(TransactionBuffer& buf, const T& x) {
-        if (const void* ptr = buf.template find<UniqueKey<T> >(x))
-            return const_cast<void*>(ptr);
+        if (const T* ptr = buf.find_unique(x))
+            return const_cast<T*>(ptr);
+        else
+            return buf.template add_unique<T>(x);
+    }
+    static void* pack_unique(TransactionBuffer& buf, T&& x) {
+        if (const T* ptr = buf.find_unique(x))
+            return const_cast<T*>(ptr);
         else
-            return buf.template allocate<UniqueKey<T> >(x);
+            return buf.template add_unique<T>(std::move(x));
+    }
+    // x must outlive the transaction
+    static void* pack_unique_stable(TransactionBuffer& buf, const T& x) {
+        if (const T* ptr = buf.find_unique(x))
+            return const_cast<T*>(ptr);
+        buf.add_unique_ref(&x);
+        return const_cast<T*>(&x);
     }
     static void* repack(TransactionBuffer&, void* p, const T& x) {
         unpack(p) = x;
@@ -187,3 +261,11 @@ template <typename T> struct Packer<T, false> {
         return *(T*) p;
     }
 };
+
+template <typename T> struct Packer<StableKey<T>, true> {
+    static constexpr bool is_simple = Packer<T>::is_simple;
+    typedef T type;
+    static void* pack_unique(TransactionBuffer& buf, const StableKey<T>& k) {
+        return Packer<T>::pack_unique_stable(buf, *k.ptr);
+    }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Cache-line write-back for persistent memory. flush() starts writing
+// back the lines covering a range; fence() orders those write-backs before
+// any later store. A store is durable once it is flushed and fenced,
+// provided the memory is mapped with MAP_SYNC (see HugeArena). Uses CLWB
+// or CLFLUSHOPT when compiled for them (-mclwb, -mclflushopt), and CLFLUSH
+// otherwise.
+class Persist {
+public:
+    static constexpr size_t line_size = 64;
+
+    static void flush(const void* p, size_t n) {
+        uintptr_t a = reinterpret_cast<uintptr_t>(p) & ~uintptr_t(line_size - 1);
+        uintptr_t e = reinterpret_cast<uintptr_t>(p) + n;
+        for (; a < e; a += line_size) {
+#if defined(__CLWB__)
+            _mm_clwb(reinterpret_cast<void*>(a));
+#elif defined(__CLFLUSHOPT__)
+            _mm_clflushopt(reinterpret_cast<void*>(a));
+#elif defined(__x86_64__)
+            _mm_clflush(reinterpret_cast<const void*>(a));
+#else
+            (void) a;
+#endif
+        }
+    }
+    static void fence() {
+#if defined(__x86_64__)
+        _mm_sfence();
+#else
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+    }
+};
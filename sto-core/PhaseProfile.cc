@@ -0,0 +1,124 @@
+#include "PhaseProfile.hh"
+
+#include <algorithm>
+#include <cstring>
+#include "PlatformFeatures.hh"
+
+unsigned PhaseProfile::period_ = 0;
+PhaseProfile::thread_state PhaseProfile::state_[MAX_THREADS];
+
+unsigned PhaseProfile::bucket_of(uint64_t v) {
+    constexpr uint64_t sub_count = uint64_t(1) << sub_bits;
+    if (v < sub_count)
+        return v;
+    unsigned shift = 63 - __builtin_clzll(v) - sub_bits;
+    return (shift + 1) * sub_count + ((v >> shift) - sub_count);
+}
+
+uint64_t PhaseProfile::bucket_high(unsigned b) {
+    constexpr unsigned sub_count = 1U << sub_bits;
+    if (b < sub_count)
+        return b;
+    unsigned shift = b / sub_count - 1;
+    uint64_t low = uint64_t(b % sub_count + sub_count) << shift;
+    return low + ((uint64_t(1) << shift) - 1);
+}
+
+void PhaseProfile::fold(thread_state& s) {
+    for (int p = 0; p != ph_attempt_count; ++p) {
+        uint64_t t = s.cur[p];
+        ++s.samples[p];
+        s.ticks[p] += t;
+        s.max[p] = std::max(s.max[p], t);
+        ++s.hist[p][bucket_of(t)];
+        s.cur[p] = 0;
+    }
+    s.sampled = false;
+}
+
+void PhaseProfile::begin_txn_slow(thread_state& s) {
+    if (s.sampled)
+        fold(s);
+    if (period_ && (s.countdown == 0 || --s.countdown == 0)) {
+        s.countdown = period_;
+        s.sampled = true;
+    }
+}
+
+bool PhaseProfile::sample_call(int threadid) {
+    thread_state& s = state_[threadid];
+    if (s.call_countdown == 0 || --s.call_countdown == 0) {
+        s.call_countdown = period_;
+        return true;
+    }
+    return false;
+}
+
+void PhaseProfile::record(int threadid, int p, uint64_t ticks) {
+    thread_state& s = state_[threadid];
+    ++s.samples[p];
+    s.ticks[p] += ticks;
+    s.max[p] = std::max(s.max[p], ticks);
+    ++s.hist[p][bucket_of(ticks)];
+}
+
+PhaseProfile::summary PhaseProfile::summarize(int p, int first, int last) {
+    summary out = {};
+    for (int t = first; t != last; ++t) {
+        thread_state& s = state_[t];
+        if (s.sampled)
+            fold(s);
+        out.samples += s.samples[p];
+        out.ticks += s.ticks[p];
+        out.max = std::max(out.max, s.max[p]);
+    }
+    uint64_t r50 = std::max(uint64_t(1), (out.samples + 1) / 2);
+    uint64_t r99 = std::max(uint64_t(1), uint64_t(0.99 * out.samples + 0.5));
+    uint64_t seen = 0;
+    for (unsigned b = 0; b != num_buckets && seen < out.samples; ++b) {
+        uint64_t n = 0;
+        for (int t = first; t != last; ++t)
+            n += state_[t].hist[p][b];
+        if (seen < r50 && seen + n >= r50)
+            out.p50 = std::min(bucket_high(b), out.max);
+        if (seen < r99 && seen + n >= r99)
+            out.p99 = std::min(bucket_high(b), out.max);
+        seen += n;
+    }
+    return out;
+}
+
+PhaseProfile::summary PhaseProfile::combined(int p) {
+    return summarize(p, 0, MAX_THREADS);
+}
+
+PhaseProfile::summary PhaseProfile::thread_summary(int threadid, int p) {
+    return summarize(p, threadid, threadid + 1);
+}
+
+void PhaseProfile::clear() {
+    for (auto& s : state_)
+        memset(&s, 0, sizeof(s));
+}
+
+void PhaseProfile::report(FILE* f) {
+    static const char* names[] = {
+        "start_rcu", "execute", "commit_lock", "commit_check", "commit_install",
+        "cleanup", "lock_spin", "mvcc_flatten"
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == ph_count, "update the phase names");
+    if (!period_ || !combined(ph_execute).samples)
+        return;
+    double ticks_per_us = tsc_frequency() * 1000;
+    fprintf(f, "$ Phase timers, 1 in %u sampled: est. total s, samples, mean/p50/p99/max us"
+            " per attempt (per call for mvcc_flatten)\n", period_);
+    for (int p = 0; p != ph_count; ++p) {
+        summary s = combined(p);
+        if (!s.samples)
+            continue;
+        fprintf(f, "$   %-15s %.3f, %llu, %.2f/%.2f/%.2f/%.2f\n", names[p],
+                s.ticks * double(period_) / ticks_per_us / 1e6, (unsigned long long) s.samples,
+                s.ticks / ticks_per_us / s.samples, s.p50 / ticks_per_us, s.p99 / ticks_per_us,
+                s.max / ticks_per_us);
+    }
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Phases of a transaction attempt timed by PhaseProfile
+enum PhaseTimers {
+    ph_start_rcu = 0,   // RCU cleanup in Transaction::start
+    ph_execute,         // end of start() to try_commit()
+    ph_commit_lock,     // commit phase 1: write locks (MVCC cp_lock), predicates
+    ph_commit_check,    // commit phase 2: read validation (MVCC cp_check)
+    ph_commit_install,  // commit phase 3: installs (MVCC cp_install)
+    ph_cleanup,         // Transaction::stop: cleanup, unlock, end callbacks
+    ph_lock_spin,       // waiting on held locks and pending MVCC versions
+    ph_attempt_count,
+    // timed per call rather than per attempt
+    ph_mvcc_flatten = ph_attempt_count,  // MVCC delta flattening
+    ph_count
+};
+
+// Sampled per-phase timers that are cheap enough to leave on.
+//
+// With a sample period of N, each thread times one transaction attempt in
+// N: its phase timers read the TSC, the others test one flag. A sampled
+// attempt's ticks per phase are summed, then folded into per-thread totals
+// and histograms when the thread's next attempt starts (or at report time),
+// so the distributions are per attempt, with 0 for phases it skipped.
+// Flattening also runs on background threads, outside any attempt, so it is
+// timed per call instead: each thread times one call in N.
+//
+// Unlike the TimingCounters, this needs no STO_TSC_PROFILE build; a period
+// of 0 (the default) turns it off.
+class PhaseProfile {
+public:
+    // Log-bucketed like bench::latency_histogram: 2^sub_bits buckets per
+    // power of two
+    static constexpr unsigned sub_bits = 2;
+    static constexpr unsigned num_buckets = (64 - sub_bits + 1) << sub_bits;
+
+    static void set_sample_period(unsigned n) {
+        period_ = n;
+    }
+    static unsigned sample_period() {
+        return period_;
+    }
+
+    // Called as each transaction attempt starts
+    static void begin_txn(int threadid) {
+        thread_state& s = state_[threadid];
+        if (s.sampled || period_)
+            begin_txn_slow(s);
+    }
+    static bool sampled(int threadid) {
+        return state_[threadid].sampled;
+    }
+    // A start tick for lap, or 0 if this attempt isn't sampled
+    static uint64_t now(int threadid) {
+        return state_[threadid].sampled ? read_tsc() : 0;
+    }
+    // Adds the ticks since t0 to phase p and returns the current tick, to
+    // chain consecutive phases; does nothing if t0 is 0
+    static uint64_t lap(int threadid, int p, uint64_t t0) {
+        if (!t0)
+            return 0;
+        uint64_t t = read_tsc();
+        state_[threadid].cur[p] += t - t0;
+        return t;
+    }
+
+    // Times a scope inside a sampled attempt
+    class timer {
+    public:
+        explicit timer(int p)
+            : p_(p), t0_(now(TThread::id())) {
+        }
+        ~timer() {
+            lap(TThread::id(), p_, t0_);
+        }
+
+    private:
+        int p_;
+        uint64_t t0_;
+    };
+
+    // Times a wait from the first failed try, if the attempt is sampled
+    class wait_timer {
+    public:
+        explicit wait_timer(int p)
+            : p_(p), t0_(0) {
+        }
+        void waiting() {
+            if (!t0_)
+                t0_ = now(TThread::id());
+        }
+        ~wait_timer() {
+            lap(TThread::id(), p_, t0_);
+        }
+
+    private:
+        int p_;
+        uint64_t t0_;
+    };
+
+    // Times one call in sample_period() of a per-call phase
+    class call_timer {
+    public:
+        explicit call_timer(int p)
+            : p_(p), t0_(period_ && sample_call(TThread::id()) ? read_tsc() : 0) {
+        }
+        ~call_timer() {
+            if (t0_)
+                record(TThread::id(), p_, read_tsc() - t0_);
+        }
+
+    private:
+        int p_;
+        uint64_t t0_;
+    };
+
+    struct summary {
+        uint64_t samples;
+        uint64_t ticks;      // summed over samples
+        uint64_t p50;
+        uint64_t p99;
+        uint64_t max;
+    };
+    // Merged over threads, after the sampling threads have finished
+    static summary combined(int p);
+    // One thread's, likewise after it finished
+    static summary thread_summary(int threadid, int p);
+    static void clear();
+    // Estimated total time per phase (sampled time times the period) and
+    // the per-attempt distribution, if anything was sampled
+    static void report(FILE* f);
+
+private:
+    struct __attribute__((aligned(128))) thread_state {
+        bool sampled;
+        unsigned countdown;       // attempts until the next sampled one
+        unsigned call_countdown;  // calls until the next sampled call_timer
+        uint64_t cur[ph_attempt_count];  // ticks in the current sampled attempt
+        uint64_t samples[ph_count];
+        uint64_t ticks[ph_count];
+        uint64_t max[ph_count];
+        uint64_t hist[ph_count][num_buckets];
+    };
+
+    static unsigned period_;
+    static thread_state state_[MAX_THREADS];
+
+    static void begin_txn_slow(thread_state& s);
+    static void fold(thread_state& s);
+    static summary summarize(int p, int first, int last);
+    static bool sample_call(int threadid);
+    static void record(int threadid, int p, uint64_t ticks);
+    static unsigned bucket_of(uint64_t v);
+    static uint64_t bucket_high(unsigned b);
+};
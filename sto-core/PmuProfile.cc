@@ -0,0 +1,175 @@
+#include "PmuProfile.hh"
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "Transaction.hh"
+
+static_assert(tc_count == 7, "update the TimingCounters phase names");
+
+bool PmuProfile::enabled_ = false;
+std::mutex PmuProfile::mutex_;
+std::atomic<unsigned> PmuProfile::nphases_(tc_count);
+const char* PmuProfile::names_[PmuProfile::max_phases] = {
+    "tc_commit", "tc_commit_wasted", "tc_find_item", "tc_abort",
+    "tc_cleanup", "tc_opacity", "tc_elapsed"
+};
+PmuProfile::thread_totals PmuProfile::threads_[MAX_THREADS];
+
+unsigned PmuProfile::add_phase(const char* name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    unsigned n = nphases_.load(std::memory_order_relaxed);
+    for (unsigned p = 0; p != n; ++p)
+        if (strcmp(names_[p], name) == 0)
+            return p;
+    always_assert(n != max_phases, "too many PMU phases registered");
+    names_[n] = name;
+    nphases_.store(n + 1, std::memory_order_release);
+    return n;
+}
+
+namespace {
+
+// One thread's counter group. The first event leads; an event the CPU
+// doesn't support is left out (fd -1) rather than failing the group.
+struct pmu_group {
+    int fd[PmuProfile::pmu_nevents];
+    perf_event_mmap_page* page[PmuProfile::pmu_nevents];
+    bool opened = false;
+    bool ok = false;
+
+    ~pmu_group() {
+        for (int e = 0; opened && e != PmuProfile::pmu_nevents; ++e) {
+            if (page[e])
+                munmap(page[e], sysconf(_SC_PAGESIZE));
+            if (fd[e] >= 0)
+                close(fd[e]);
+        }
+    }
+
+    void open() {
+        static const struct { uint32_t type; uint64_t config; } events[] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                 | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                 | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)}
+        };
+        opened = true;
+        for (int e = 0; e != PmuProfile::pmu_nevents; ++e) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[e].type;
+            attr.config = events[e].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int leader = e ? fd[0] : -1;
+            fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            page[e] = nullptr;
+            if (fd[e] < 0)
+                continue;
+            void* p = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd[e], 0);
+            if (p != MAP_FAILED)
+                page[e] = static_cast<perf_event_mmap_page*>(p);
+        }
+        ok = fd[PmuProfile::pmu_cycles] >= 0 && fd[PmuProfile::pmu_instructions] >= 0;
+    }
+
+    // The seqlock protocol from perf_event_open(2): the running count is
+    // the kernel's offset plus the live hardware counter
+    static bool read_rdpmc(perf_event_mmap_page* pc, uint64_t& value) {
+        uint32_t seq;
+        bool live;
+        do {
+            seq = pc->lock;
+            fence();
+            uint32_t index = pc->index;
+            int64_t count = pc->offset;
+            live = pc->cap_user_rdpmc && index;
+            if (live) {
+                uint32_t lo, hi;
+                __asm__ __volatile__("rdpmc" : "=a"(lo), "=d"(hi) : "c"(index - 1));
+                int64_t pmc = (uint64_t(hi) << 32) | lo;
+                unsigned shift = 64 - pc->pmc_width;
+                count += (pmc << shift) >> shift;
+            }
+            value = count;
+            fence();
+        } while (pc->lock != seq);
+        return live;
+    }
+
+    void read(PmuProfile::sample& s) {
+        for (int e = 0; e != PmuProfile::pmu_nevents; ++e) {
+            s.v[e] = 0;
+            if (fd[e] >= 0 && !(page[e] && read_rdpmc(page[e], s.v[e]))
+                && ::read(fd[e], &s.v[e], sizeof(s.v[e])) != sizeof(s.v[e]))
+                s.v[e] = 0;
+        }
+    }
+};
+
+thread_local pmu_group group;
+
+}
+
+bool PmuProfile::enable() {
+    if (!group.opened)
+        group.open();
+    enabled_ = group.ok;
+    return enabled_;
+}
+
+bool PmuProfile::read(sample& s) {
+    if (!group.opened)
+        group.open();
+    if (!group.ok)
+        return false;
+    group.read(s);
+    return true;
+}
+
+void PmuProfile::account(unsigned phase, const sample& begin, const sample& end) {
+    totals& t = threads_[TThread::id()].phases[phase];
+    ++t.calls;
+    for (int e = 0; e != pmu_nevents; ++e)
+        t.v[e] += end.v[e] - begin.v[e];
+}
+
+PmuProfile::totals PmuProfile::combined(unsigned phase) {
+    totals out = {};
+    for (auto& th : threads_) {
+        out.calls += th.phases[phase].calls;
+        for (int e = 0; e != pmu_nevents; ++e)
+            out.v[e] += th.phases[phase].v[e];
+    }
+    return out;
+}
+
+void PmuProfile::clear() {
+    for (auto& th : threads_)
+        memset(th.phases, 0, sizeof(th.phases));
+}
+
+void PmuProfile::report(FILE* f) {
+    bool header = false;
+    for (unsigned p = 0; p != num_phases(); ++p) {
+        totals t = combined(p);
+        if (!t.calls)
+            continue;
+        if (!header) {
+            fprintf(f, "$ PMU phases: calls, cycles/call, IPC, LLC misses/kinstr, dTLB misses/kinstr\n");
+            header = true;
+        }
+        double kinstr = t.v[pmu_instructions] / 1000.0;
+        fprintf(f, "$   %-20s %llu, %.0f, %.2f, %.2f, %.2f\n", names_[p], (unsigned long long) t.calls,
+                1.0 * t.v[pmu_cycles] / t.calls,
+                t.v[pmu_cycles] ? 1.0 * t.v[pmu_instructions] / t.v[pmu_cycles] : 0.0,
+                kinstr ? t.v[pmu_llc_misses] / kinstr : 0.0,
+                kinstr ? t.v[pmu_dtlb_misses] / kinstr : 0.0);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include "TThread.hh"
+
+// In-process hardware performance counters, attributed to named phases.
+//
+// Each thread that reads the counters opens its own perf_event_open group
+// (cycles, instructions, last-level cache misses, dTLB load misses) for
+// itself, in user mode, on first use. Reads go through rdpmc using the
+// group's mmap pages, falling back to read(2) when the kernel doesn't allow
+// user-space rdpmc.
+//
+// A phase is a name registered with add_phase. The first tc_count phases
+// are the TimingCounters, so every TimeKeeper scope in an STO_TSC_PROFILE
+// build is also a phase; benchmarks add their transaction types. A scope
+// adds the counter deltas across it to its phase in the calling thread's
+// totals. Nested scopes each count their own span, so an outer phase
+// includes its inner ones.
+class PmuProfile {
+public:
+    enum event {
+        pmu_cycles = 0,
+        pmu_instructions,
+        pmu_llc_misses,
+        pmu_dtlb_misses,
+        pmu_nevents
+    };
+    static constexpr unsigned max_phases = 64;
+
+    struct sample {
+        uint64_t v[pmu_nevents];
+    };
+    struct totals {
+        uint64_t calls;
+        uint64_t v[pmu_nevents];
+    };
+
+    // Returns the phase with this name, registering it if needed
+    static unsigned add_phase(const char* name);
+    static unsigned num_phases() {
+        return nphases_.load(std::memory_order_acquire);
+    }
+    static const char* phase_name(unsigned phase) {
+        return names_[phase];
+    }
+
+    // Starts counting; false if this machine or kernel can't count cycles
+    // and instructions from user space
+    static bool enable();
+    static void disable() {
+        enabled_ = false;
+    }
+    static bool enabled() {
+        return enabled_;
+    }
+
+    // Current counter values for the calling thread; false if its group
+    // couldn't be opened. Events the CPU lacks read as 0.
+    static bool read(sample& s);
+    static void account(unsigned phase, const sample& begin, const sample& end);
+
+    class scope {
+    public:
+        explicit scope(unsigned phase)
+            : phase_(phase), on_(enabled_ && read(begin_)) {
+        }
+        ~scope() {
+            sample end;
+            if (on_ && read(end))
+                account(phase_, begin_, end);
+        }
+
+    private:
+        unsigned phase_;
+        bool on_;
+        sample begin_;
+    };
+
+    // Sum over all threads
+    static totals combined(unsigned phase);
+    static void clear();
+    // Per phase: calls, cycles per call, IPC, and misses per 1000 instructions
+    static void report(FILE* f);
+
+private:
+    struct __attribute__((aligned(64))) thread_totals {
+        totals phases[max_phases];
+    };
+
+    static bool enabled_;
+    static std::mutex mutex_;
+    static std::atomic<unsigned> nphases_;
+    static const char* names_[max_phases];
+    static thread_totals threads_[MAX_THREADS];
+};
@@ -0,0 +1,117 @@
+#include "ServiceThreads.hh"
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <time.h>
+#include "PlatformFeatures.hh"
+
+namespace {
+struct service_thread {
+    const char* role;
+    int cpu;
+    clockid_t clock;
+    struct timespec start;
+    double cpu_seconds;
+    double wall_seconds;
+    bool running;
+};
+
+std::mutex mu;
+std::list<service_thread> threads;
+unsigned next_cpu;
+thread_local service_thread* self;
+
+double seconds(const struct timespec& ts) {
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double since(const struct timespec& start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return seconds(now) - seconds(start);
+}
+
+double cpu_time(clockid_t clock) {
+    struct timespec ts;
+    return clock_gettime(clock, &ts) == 0 ? seconds(ts) : 0;
+}
+}
+
+void ServiceThreads::enter(const char* role) {
+    std::lock_guard<std::mutex> lk(mu);
+    service_thread t = {role, -1, CLOCK_THREAD_CPUTIME_ID, {}, 0, 0, true};
+    auto& cpus = housekeeping_cpus();
+    if (!cpus.empty()) {
+        t.cpu = cpus[next_cpu++ % cpus.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(t.cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            t.cpu = -1;
+    }
+    pthread_getcpuclockid(pthread_self(), &t.clock);
+    clock_gettime(CLOCK_MONOTONIC, &t.start);
+    threads.push_back(t);
+    self = &threads.back();
+}
+
+void ServiceThreads::leave() {
+    std::lock_guard<std::mutex> lk(mu);
+    if (!self)
+        return;
+    self->cpu_seconds = cpu_time(CLOCK_THREAD_CPUTIME_ID);
+    self->wall_seconds = since(self->start);
+    self->running = false;
+    self = nullptr;
+}
+
+std::vector<ServiceThreads::usage> ServiceThreads::usages() {
+    std::lock_guard<std::mutex> lk(mu);
+    std::vector<usage> u;
+    for (auto& t : threads) {
+        // a running thread hasn't reached leave(), so its clock is valid
+        if (t.running)
+            u.push_back({t.role, t.cpu, cpu_time(t.clock), since(t.start), true});
+        else
+            u.push_back({t.role, t.cpu, t.cpu_seconds, t.wall_seconds, false});
+    }
+    return u;
+}
+
+void ServiceThreads::report(FILE* f) {
+    struct role_usage {
+        unsigned n = 0;
+        double cpu = 0, wall = 0;
+        std::string cpus;
+    };
+    std::map<std::string, role_usage> roles;
+    for (auto& u : usages()) {
+        auto& r = roles[u.role];
+        ++r.n;
+        r.cpu += u.cpu_seconds;
+        r.wall = std::max(r.wall, u.wall_seconds);
+        if (u.cpu >= 0)
+            r.cpus += (r.cpus.empty() ? "" : ",") + std::to_string(u.cpu);
+    }
+    for (auto& kv : roles)
+        fprintf(f, "$ service %s: %u thread%s%s%s, %.3f s CPU over %.3f s (%.1f%% of a core)\n",
+                kv.first.c_str(), kv.second.n, kv.second.n == 1 ? "" : "s",
+                kv.second.cpus.empty() ? ", unpinned" : " on CPU ", kv.second.cpus.c_str(),
+                kv.second.cpu, kv.second.wall,
+                kv.second.wall > 0 ? 100 * kv.second.cpu / kv.second.wall : 0.0);
+}
+
+void ServiceThreads::report_json(std::ostream& out) {
+    out << "[";
+    bool first = true;
+    for (auto& u : usages()) {
+        out << (first ? "" : ", ") << "{\"role\": \"" << u.role << "\", \"cpu\": " << u.cpu
+            << ", \"cpu_seconds\": " << u.cpu_seconds << ", \"wall_seconds\": " << u.wall_seconds
+            << ", \"running\": " << (u.running ? "true" : "false") << "}";
+        first = false;
+    }
+    out << "]";
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Background threads that serve the workers instead of running
+// transactions: the epoch advancer, MVCC flatteners, TxnLog loggers and
+// shippers. Each calls enter() as it starts and leave() before it exits.
+//
+// With housekeeping CPUs configured (set_housekeeping_cpus, which also
+// takes them out of the runners' placement), enter() pins the thread to
+// one of them, round-robin; otherwise it runs wherever the scheduler puts
+// it. Either way its CPU time is accounted, so report() shows what the
+// background work costs.
+class ServiceThreads {
+public:
+    struct usage {
+        std::string role;
+        int cpu;              // pinned to, or -1
+        double cpu_seconds;
+        double wall_seconds;
+        bool running;
+    };
+
+    // Registers the calling thread under role (a string literal)
+    static void enter(const char* role);
+    static void leave();
+    // enter() and leave() around a thread's body
+    struct scope {
+        explicit scope(const char* role) {
+            enter(role);
+        }
+        ~scope() {
+            leave();
+        }
+    };
+
+    // Every thread registered, running or not
+    static std::vector<usage> usages();
+
+    // CPU time by role, if any service thread ran
+    static void report(FILE* f);
+    static void report_json(std::ostream& out);
+};
@@ -3,13 +3,15 @@
 #include <limits>
 
 TRcuSet::TRcuSet()
-    : clean_epoch_(0) {
+    : clean_epoch_(0), size_(0) {
     unsigned capacity = (4080 - sizeof(TRcuGroup)) / sizeof(TRcuGroup::TRcuElement);
     current_ = first_ = TRcuGroup::make(capacity);
     // ngroups_ = 1;
 }
 
 TRcuSet::~TRcuSet() {
+    for (auto& l : lanes_)
+        l.clear();
     while (first_) {
         TRcuGroup* next = first_->next_;
         TRcuGroup::free(first_);
@@ -51,13 +53,26 @@ void TRcuSet::grow() {
     assert(current_->head_ == 0 && current_->tail_ == 0);
 }
 
-inline bool TRcuGroup::clean_until(epoch_type max_epoch) {
+TRcuGroup* TRcuSet::orphans_;
+std::atomic<bool> TRcuSet::orphans_lock_;
+std::atomic<size_t> TRcuSet::orphan_size_;
+
+inline bool TRcuGroup::clean_until(epoch_type max_epoch, size_t& nrun, size_t limit) {
     while (head_ != tail_
            && signed_epoch_type(max_epoch - e_[head_].u.epoch) > 0) {
+        epoch_type epoch = e_[head_].u.epoch;
         ++head_;
         while (head_ != tail_ && e_[head_].function) {
+            if (nrun == limit) {
+                // re-date the rest from the slot just run
+                --head_;
+                e_[head_].function = nullptr;
+                e_[head_].u.epoch = epoch;
+                return false;
+            }
             e_[head_].function(e_[head_].u.argument);
             ++head_;
+            ++nrun;
         }
     }
     if (head_ == tail_) {
@@ -68,24 +83,151 @@ inline bool TRcuGroup::clean_until(epoch_type max_epoch) {
     }
 }
 
-void TRcuSet::hard_clean_until(epoch_type max_epoch) {
+bool TRcuSet::hard_clean_until(epoch_type max_epoch, size_t limit, size_t* handed_off) {
     TRcuGroup* empty_head = nullptr;
     TRcuGroup* empty_tail = nullptr;
+    size_t nrun = 0;
+    bool done = true;
     // clean [first_, current_]
-    while (first_->clean_until(max_epoch)) {
+    while (first_->clean_until(max_epoch, nrun, limit)) {
         if (!empty_head) {
             empty_head = first_;
         }
         empty_tail = first_;
         if (first_ == current_) {
             first_ = current_ = empty_head;
-            return;
+            empty_head = nullptr;
+            break;
         }
         first_ = first_->next_;
     }
+    for (auto& l : lanes_) {
+        if (!l.batch_)
+            break;
+        if (!l.clean_until(max_epoch, nrun, limit) && nrun == limit)
+            done = false;
+    }
+    if (nrun == limit) {
+        // out of budget: hand off whole groups that have fully expired
+        while (first_ != current_
+               && signed_epoch_type(max_epoch - first_->max_epoch_) > 0) {
+            TRcuGroup* g = first_;
+            first_ = g->next_;
+            *handed_off += hand_off(g);
+        }
+        done = false;
+    }
     // hook empties after current_; everything after current_ guaranteed empty
     if (empty_head) {
         empty_tail->next_ = current_->next_;
         current_->next_ = empty_head;
     }
+    size_.store(size_.load(std::memory_order_relaxed) - nrun, std::memory_order_relaxed);
+    return done;
+}
+
+void TRcuSet::lock_orphans() {
+    while (orphans_lock_.exchange(true, std::memory_order_acquire))
+        relax_fence();
+}
+
+void TRcuSet::unlock_orphans() {
+    orphans_lock_.store(false, std::memory_order_release);
+}
+
+size_t TRcuSet::hand_off(TRcuGroup* g) {
+    size_t n = g->count();
+    size_.store(size_.load(std::memory_order_relaxed) - n, std::memory_order_relaxed);
+    orphan_size_.fetch_add(n, std::memory_order_relaxed);
+    lock_orphans();
+    g->next_ = orphans_;
+    orphans_ = g;
+    unlock_orphans();
+    return n;
+}
+
+size_t TRcuSet::run_orphans(size_t limit) {
+    size_t nrun = 0;
+    while (nrun < limit && orphan_size_.load(std::memory_order_relaxed)) {
+        lock_orphans();
+        TRcuGroup* g = orphans_;
+        if (g)
+            orphans_ = g->next_;
+        unlock_orphans();
+        if (!g)
+            break;
+        size_t n = 0;
+        g->clean_until(g->max_epoch_ + 1, n, ~size_t(0));
+        orphan_size_.fetch_sub(n, std::memory_order_relaxed);
+        nrun += n;
+        TRcuGroup::free(g);
+    }
+    return nrun;
+}
+
+TRcuLane::block* TRcuLane::block::make(unsigned capacity) {
+    void* x = new char[sizeof(block) + sizeof(uintptr_t) * (capacity - 1)];
+    MemStats::account(mem_rcu, sizeof(block) + sizeof(uintptr_t) * (capacity - 1));
+    block* b = new(x) block;
+    b->head_ = b->tail_ = 0;
+    b->capacity_ = capacity;
+    b->next_ = nullptr;
+    return b;
+}
+
+void TRcuLane::block::free(block* b) {
+    MemStats::account(mem_rcu, -int64_t(sizeof(block) + sizeof(uintptr_t) * (b->capacity_ - 1)));
+    delete[] reinterpret_cast<char*>(b);
+}
+
+void TRcuLane::grow() {
+    block* b = block::make((4080 - sizeof(block)) / sizeof(uintptr_t) + 1);
+    if (current_)
+        current_->next_ = b;
+    else
+        first_ = b;
+    current_ = b;
+}
+
+bool TRcuLane::clean_until(epoch_type max_epoch, size_t& nrun, size_t limit) {
+    while (first_) {
+        block* b = first_;
+        while (b->head_ != b->tail_) {
+            uintptr_t marker = b->e_[b->head_];
+            assert(marker & 1);
+            if (signed_epoch_type(max_epoch - (marker >> 1)) <= 0)
+                return false;
+            unsigned i = b->head_ + 1, j = i;
+            while (j != b->tail_ && !(b->e_[j] & 1))
+                ++j;
+            unsigned n = j - i;
+            if (n > limit - nrun)
+                n = limit - nrun;
+            batch_(reinterpret_cast<void**>(&b->e_[i]), n);
+            nrun += n;
+            if (i + n != j) {
+                // re-date the rest from the slot just run
+                b->head_ = i + n - 1;
+                b->e_[b->head_] = marker;
+                return false;
+            }
+            b->head_ = j;
+        }
+        if (b == current_) {
+            b->head_ = b->tail_ = 0;
+            return true;
+        }
+        first_ = b->next_;
+        block::free(b);
+    }
+    return true;
+}
+
+void TRcuLane::clear() {
+    while (first_) {
+        block* next = first_->next_;
+        block::free(first_);
+        first_ = next;
+    }
+    current_ = nullptr;
 }
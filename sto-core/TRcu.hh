@@ -1,7 +1,9 @@
 #pragma once
 
 #include <new>
+#include <atomic>
 #include "compiler.hh"
+#include "MemStats.hh"
 #include <assert.h>
 
 struct TRcuGroup {
@@ -21,12 +23,13 @@ struct TRcuGroup {
     unsigned tail_;
     unsigned capacity_;
     epoch_type epoch_;
+    epoch_type max_epoch_;
     TRcuGroup* next_;
     TRcuElement e_[1];
 
 private:
     TRcuGroup(unsigned capacity)
-        : head_(0), tail_(0), capacity_(capacity), next_(nullptr) {
+        : head_(0), tail_(0), capacity_(capacity), epoch_(0), max_epoch_(0), next_(nullptr) {
     }
     TRcuGroup(const TRcuGroup&) = delete;
     ~TRcuGroup() {
@@ -34,11 +37,16 @@ private:
     }
 
 public:
+    static size_t bytes(unsigned capacity) {
+        return sizeof(TRcuGroup) + sizeof(TRcuElement) * (capacity - 1);
+    }
     static TRcuGroup* make(unsigned capacity) {
-        void* x = new char[sizeof(TRcuGroup) + sizeof(TRcuElement) * (capacity - 1)];
+        void* x = new char[bytes(capacity)];
+        MemStats::account(mem_rcu, bytes(capacity));
         return new(x) TRcuGroup(capacity);
     }
     static void free(TRcuGroup* g) {
+        MemStats::account(mem_rcu, -int64_t(bytes(g->capacity_)));
         g->~TRcuGroup();
         delete[] reinterpret_cast<char*>(g);
     }
@@ -52,6 +60,8 @@ public:
         if (head_ == tail_ || epoch_ != epoch) {
             e_[tail_].function = nullptr;
             e_[tail_].u.epoch = epoch;
+            if (head_ == tail_ || signed_epoch_type(epoch - max_epoch_) > 0)
+                max_epoch_ = epoch;
             epoch_ = epoch;
             ++tail_;
         }
@@ -60,7 +70,69 @@ public:
         ++tail_;
     }
 
-    inline bool clean_until(epoch_type max_epoch);
+    // Runs callbacks older than max_epoch, stopping once nrun reaches
+    // limit. True if the group is now empty.
+    inline bool clean_until(epoch_type max_epoch, size_t& nrun, size_t limit);
+    // Callbacks not yet run
+    size_t count() const {
+        size_t n = 0;
+        for (unsigned i = head_; i != tail_; ++i)
+            n += e_[i].function != nullptr;
+        return n;
+    }
+};
+
+// Callbacks of one type, stored as bare arguments between epoch markers
+// and run in bulk by one batch function. Arguments must be even (marker
+// words have the low bit set).
+struct TRcuLane {
+    typedef TRcuGroup::epoch_type epoch_type;
+    typedef TRcuGroup::signed_epoch_type signed_epoch_type;
+    typedef void (*batch_type)(void** arguments, unsigned n);
+
+    struct block {
+        unsigned head_;
+        unsigned tail_;
+        unsigned capacity_;
+        block* next_;
+        uintptr_t e_[1];
+
+        static block* make(unsigned capacity);
+        static void free(block* b);
+    };
+
+    batch_type batch_ = nullptr;
+    block* first_ = nullptr;
+    block* current_ = nullptr;
+    epoch_type epoch_ = 0;
+
+    template <TRcuGroup::callback_type F>
+    static void run_batch(void** arguments, unsigned n) {
+        for (unsigned i = 0; i != n; ++i)
+            F(arguments[i]);
+    }
+
+    bool empty() const {
+        return !first_ || first_->head_ == first_->tail_;
+    }
+
+    void add(epoch_type epoch, void* argument) {
+        assert(!(reinterpret_cast<uintptr_t>(argument) & 1));
+        if (unlikely(!current_ || current_->tail_ + 2 > current_->capacity_))
+            grow();
+        if (current_->head_ == current_->tail_ || epoch_ != epoch) {
+            current_->e_[current_->tail_++] = (uintptr_t(epoch) << 1) | 1;
+            epoch_ = epoch;
+        }
+        current_->e_[current_->tail_++] = reinterpret_cast<uintptr_t>(argument);
+    }
+
+    // Like TRcuGroup::clean_until; true if the lane is now empty
+    bool clean_until(epoch_type max_epoch, size_t& nrun, size_t limit);
+    void clear();
+
+private:
+    void grow();
 };
 
 class TRcuSet {
@@ -73,7 +145,12 @@ public:
     ~TRcuSet();
 
     bool empty() const {
-        return first_->empty();
+        if (!first_->empty())
+            return false;
+        for (auto& l : lanes_)
+            if (!l.empty())
+                return false;
+        return true;
     }
 
     void add(epoch_type epoch, callback_type function, void* argument) {
@@ -81,27 +158,85 @@ public:
             grow();
         }
         current_->add(epoch, function, argument);
+        size_.store(size_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Adds a callback to the lane for F if one is free, so runs of F are
+    // made with one indirect call
+    template <callback_type F>
+    void add(epoch_type epoch, void* argument) {
+        if (TRcuLane* l = lane(&TRcuLane::run_batch<F>)) {
+            l->add(epoch, argument);
+            size_.store(size_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else
+            add(epoch, F, argument);
+    }
+
+    // Callbacks not yet run; may be read from other threads
+    size_t backlog() const {
+        return size_.load(std::memory_order_relaxed);
     }
 
     void clean_until(epoch_type max_epoch) {
         if (clean_epoch_ != max_epoch) {
-            hard_clean_until(max_epoch);
+            hard_clean_until(max_epoch, ~size_t(0), nullptr);
         }
         clean_epoch_ = max_epoch;
     }
+    // Bounded clean: runs at most budget callbacks, and hands any fully
+    // expired groups beyond that to the shared orphan list, where
+    // run_orphans() picks them up. Work left in the newest group waits for
+    // the next call. Returns the number of callbacks handed off.
+    size_t clean_until(epoch_type max_epoch, size_t budget) {
+        size_t handed_off = 0;
+        if (clean_epoch_ != max_epoch && hard_clean_until(max_epoch, budget, &handed_off))
+            clean_epoch_ = max_epoch;
+        return handed_off;
+    }
     epoch_type clean_epoch() const {
         return clean_epoch_;
     }
 
+    // Runs handed-off groups until about limit callbacks have run, from
+    // any thread; returns the number run
+    static size_t run_orphans(size_t limit);
+    // Handed-off callbacks not yet run
+    static size_t orphan_backlog() {
+        return orphan_size_.load(std::memory_order_relaxed);
+    }
+
 private:
     TRcuGroup* current_;
     TRcuGroup* first_;
     epoch_type clean_epoch_;
+    std::atomic<size_t> size_;
     // unsigned ngroups_;
 
     TRcuSet(const TRcuSet&) = delete;
     TRcuSet& operator=(const TRcuSet&) = delete;
+    static constexpr unsigned nlanes = 8;
+    TRcuLane lanes_[nlanes];
+
+    static TRcuGroup* orphans_;
+    static std::atomic<bool> orphans_lock_;
+    static std::atomic<size_t> orphan_size_;
+
+    TRcuLane* lane(TRcuLane::batch_type batch) {
+        for (auto& l : lanes_) {
+            if (l.batch_ == batch)
+                return &l;
+            if (!l.batch_) {
+                l.batch_ = batch;
+                return &l;
+            }
+        }
+        return nullptr;
+    }
+
     void check();
     void grow();
-    void hard_clean_until(epoch_type max_epoch);
+    bool hard_clean_until(epoch_type max_epoch, size_t limit, size_t* handed_off);
+    size_t hand_off(TRcuGroup* g);
+    static void lock_orphans();
+    static void unlock_orphans();
 };
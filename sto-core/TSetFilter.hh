@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Membership filter over the (owner, key)s in a transaction's tracking set,
+// used when TRANSACTION_FILTER is enabled. find_item consults it before
+// falling back to a full tset scan: a "no" is definite, so lookups of new
+// items skip the scan even when their hash slot is taken.
+//
+// It is a blocked Bloom filter: each (owner, key) sets two bits in a
+// single 64-bit word, so a test touches one word. Words are tagged with
+// the generation that last wrote them, which lets clear() run in O(1) at
+// transaction start. The filter is sized for tsets of a few thousand
+// items; larger ones make it saturate, and it then just stops helping.
+class tset_filter {
+public:
+    static constexpr unsigned nwords = 1024;
+
+    tset_filter() {
+        memset(gen_, 0, sizeof(gen_));
+    }
+
+    void clear() {
+        if (++cur_gen_ == 0) {
+            memset(gen_, 0, sizeof(gen_));
+            cur_gen_ = 1;
+        }
+    }
+
+    void add(const void* owner, const void* key) {
+        uint64_t h = hash(owner, key);
+        unsigned w = h % nwords;
+        if (gen_[w] != cur_gen_) {
+            gen_[w] = cur_gen_;
+            bits_[w] = 0;
+        }
+        bits_[w] |= mask(h);
+    }
+
+    bool may_contain(const void* owner, const void* key) const {
+        uint64_t h = hash(owner, key);
+        unsigned w = h % nwords;
+        uint64_t m = mask(h);
+        return gen_[w] == cur_gen_ && (bits_[w] & m) == m;
+    }
+
+private:
+    uint64_t bits_[nwords];
+    uint32_t gen_[nwords];
+    uint32_t cur_gen_ = 1;
+
+    static uint64_t hash(const void* owner, const void* key) {
+        uint64_t h = (reinterpret_cast<uintptr_t>(owner) * 0x9E3779B97F4A7C15ULL)
+            ^ reinterpret_cast<uintptr_t>(key);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        return h;
+    }
+    static uint64_t mask(uint64_t h) {
+        return (uint64_t(1) << ((h >> 32) & 63)) | (uint64_t(1) << ((h >> 40) & 63));
+    }
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+#include "compiler.hh"
+
+// Fingerprint kernels backing Transaction::find_item_scan when
+// TSET_SIMD_SCAN is enabled. Every tracking set chunk has a parallel array
+// of 64-bit (owner, key) fingerprints; a kernel returns the first index in
+// [begin, end) whose fingerprint equals fp, or end if there is none.
+// Callers must still compare the actual owner and key.
+
+namespace tset_scan {
+
+typedef unsigned (*find_type)(const uint64_t* fps, unsigned begin, unsigned end, uint64_t fp);
+
+inline uint64_t fingerprint(const void* owner, const void* key) {
+    return (reinterpret_cast<uintptr_t>(owner) * 0x9E3779B97F4A7C15ULL)
+        ^ reinterpret_cast<uintptr_t>(key);
+}
+
+inline unsigned find_scalar(const uint64_t* fps, unsigned begin, unsigned end, uint64_t fp) {
+    for (unsigned i = begin; i != end; ++i)
+        if (fps[i] == fp)
+            return i;
+    return end;
+}
+
+__attribute__((target("avx2")))
+inline unsigned find_avx2(const uint64_t* fps, unsigned begin, unsigned end, uint64_t fp) {
+    const __m256i needle = _mm256_set1_epi64x(static_cast<long long>(fp));
+    unsigned i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(fps + i));
+        int m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, needle)));
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    return find_scalar(fps, i, end, fp);
+}
+
+__attribute__((target("avx512f")))
+inline unsigned find_avx512(const uint64_t* fps, unsigned begin, unsigned end, uint64_t fp) {
+    const __m512i needle = _mm512_set1_epi64(static_cast<long long>(fp));
+    unsigned i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m512i v = _mm512_loadu_si512(reinterpret_cast<const void*>(fps + i));
+        __mmask8 m = _mm512_cmpeq_epi64_mask(v, needle);
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    return find_scalar(fps, i, end, fp);
+}
+
+}
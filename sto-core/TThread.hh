@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <random>
 #include <ContentionManager.hh>
@@ -8,6 +9,14 @@
 #define MAX_THREADS 128
 #endif
 
+// Width of the thread id field in version words: enough for MAX_THREADS,
+// and never narrower than the original 7 bits.
+constexpr int thread_id_bits(unsigned n) {
+    return n <= 1 ? 0 : 1 + thread_id_bits((n + 1) / 2);
+}
+constexpr int thread_id_width = thread_id_bits(MAX_THREADS) < 7 ? 7 : thread_id_bits(MAX_THREADS);
+static_assert(thread_id_width <= 12, "MAX_THREADS too large for the version word layout");
+
 class Transaction;
 
 struct PercentGen {
@@ -38,9 +47,41 @@ public:
     static int id() {
         return the_id;
     }
+    // Also registers id as live (see for_each_active)
     static void set_id(int id) {
-        assert(id >= 0 && id < 128);
+        assert(id >= 0 && id < MAX_THREADS);
         the_id = id;
+        if (!active_slot_[id].load(std::memory_order_relaxed))
+            register_id(id);
+    }
+
+    // Dense list of registered thread ids, so epoch scans skip unused
+    // tinfo slots. An id stays registered until unregister_id(id), which
+    // its owner calls once it no longer announces epochs or wtids.
+    static void register_id(int id);
+    static void unregister_id(int id);
+    // Takes the lowest unregistered id from first up as this thread's id,
+    // registered; returns it, or -1 if there is none. Ids of threads that
+    // call set_id later should stay below first.
+    static int acquire_id(int first = 0);
+
+    // Calls f(id) for every registered id. A scan that races with
+    // (un)registration is repeated, so f may see an id more than once.
+    template <typename F>
+    static void for_each_active(F f) {
+        while (true) {
+            unsigned g = active_gen_.load(std::memory_order_acquire);
+            if (g & 1) {
+                relax_fence();
+                continue;
+            }
+            unsigned n = nactive_.load(std::memory_order_acquire);
+            for (unsigned i = 0; i != n; ++i)
+                f(active_[i].load(std::memory_order_relaxed));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (active_gen_.load(std::memory_order_relaxed) == g)
+                return;
+        }
     }
     static bool always_allocate() {
         return always_allocate_;
@@ -54,4 +95,21 @@ public:
     static void set_hashsize(int hashsize) {
         hashsize_ = hashsize;
     }
+
+private:
+    // generation is odd while the list is being changed
+    static std::atomic<unsigned> active_gen_;
+    static std::atomic<unsigned> nactive_;
+    static std::atomic<int> active_[MAX_THREADS];
+    // 1 + position in active_, or 0 if unregistered
+    static std::atomic<unsigned> active_slot_[MAX_THREADS];
+
+    static unsigned lock_active() {
+        while (true) {
+            unsigned g = active_gen_.load(std::memory_order_relaxed);
+            if (!(g & 1) && active_gen_.compare_exchange_weak(g, g + 1, std::memory_order_acquire))
+                return g + 1;
+            relax_fence();
+        }
+    }
 };
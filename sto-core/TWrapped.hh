@@ -75,6 +75,22 @@ public:
 #endif
 }
 
+    // Read-only transactions: take a consistent (version, value) snapshot
+    // and record it with Transaction::ro_observe instead of a TransItem.
+    template <typename T, typename V>
+    static std::pair<bool, T> read_readonly(const T* v, const V& version) {
+        while (1) {
+            V v0 = version;
+            fence();
+            T result = *v;
+            fence();
+            V v1 = version;
+            if (v0 == v1 || v1.is_locked())
+                return std::make_pair(TThread::txn->ro_observe(version, v1), result);
+            relax_fence();
+        }
+    }
+
     template <typename T, typename V>
     static std::pair<bool, T> read_clean_atomic(const T* v, TransProxy item, const V& version, bool add_read) {
         while (1) {
@@ -204,7 +220,7 @@ public:
     template <typename T>
     static std::pair<bool, const T&> nontrivial_read_to_reference(std::pair<bool, T*> read_result) {
         static_assert(!std::is_trivially_copyable<T>::value, "Type is trivially-copyable");
-        return std::make_pair(read_result.first, *read_result.second);
+        return {read_result.first, *read_result.second};
     }
 
 }; // class TWrappedAccess
@@ -293,14 +309,39 @@ private:
     }
 };
 
-template <typename T, bool Opaque, bool Trivial, bool Small>
+// Two-phase locking: reads take read locks, so they never need validation.
+// Values needn't be small (reads copy them under the lock), which makes
+// this the wrapper for TBox::update_in_place.
+template <typename T, bool Opaque = true,
+          bool Trivial = std::is_trivially_copyable<T>::value,
+          bool Small = is_small<T>::value>
 class TLockWrapped {
 public:
+    typedef T read_type;
+    typedef TLockVersion<false> version_type;
+
     template <typename... Args>
     explicit TLockWrapped(Args&&... args)
         : v_(std::forward<Args>(args)...) {
-        static_assert(Opaque && Trivial && Small, "not implemented");
+        static_assert(Trivial, "not implemented");
     }
+
+    const T& access() const {
+        return v_;
+    }
+    T& access() {
+        return v_;
+    }
+    std::pair<bool, read_type> read(TransProxy item, const version_type& version) const {
+        return TWrappedAccess::read_nonatomic(&v_, item, version, true);
+    }
+    void write(const T& v) {
+        v_ = v;
+    }
+    void write(T&& v) {
+        v_ = std::move(v);
+    }
+
 protected:
     T v_;
 };
@@ -399,6 +440,9 @@ public:
     std::pair<bool, read_type> read(TransProxy item, const version_type& version) const {
         return TWrappedAccess::read_atomic(&v_, item, version, true);
     }
+    std::pair<bool, read_type> read_readonly(const version_type& version) const {
+        return TWrappedAccess::read_readonly(&v_, version);
+    }
     static std::pair<bool, read_type> read(const T* v, TransProxy item, const version_type& version) {
         always_assert(Small, "static read only available for small types");
         return TWrappedAccess::read_atomic(v, item, version, true);
@@ -501,6 +545,9 @@ public:
         else
             return TWrappedAccess::read_atomic(&v_, item, version, true);
     }
+    std::pair<bool, read_type> read_readonly(const version_type& version) const {
+        return TWrappedAccess::read_readonly(&v_, version);
+    }
     static std::pair<bool, read_type> read(const T* vp, TransProxy item, const version_type& version) {
         static_assert(Small, "static read only available for small types");
         return TWrappedAccess::read_nonatomic(vp, item, version, true);
@@ -794,10 +841,18 @@ public:
     TicTocWrapped(Args&&...) = delete;
 };
 
+// Whether wrapper W has a read-only fast path (read_readonly)
+template <typename W, typename = void>
+struct has_read_readonly : std::false_type {};
+template <typename W>
+struct has_read_readonly<W, std::void_t<decltype(std::declval<const W&>().read_readonly(
+        std::declval<const typename W::version_type&>()))>> : std::true_type {};
+
 template <typename T> using TOpaqueWrapped = TWrapped<T>;
 template <typename T> using TNonopaqueWrapped = TWrapped<T, false>;
 
 template <typename T> using TAdaptiveNonopaqueWrapped = TAdaptiveWrapped<T>;
+template <typename T> using TLockNonopaqueWrapped = TLockWrapped<T>;
 template <typename T> using TSwissOpaqueWrapped = TSwissWrapped<T, true>;
 template <typename T> using TSwissNonopaqueWrapped = TSwissWrapped<T, false>;
 
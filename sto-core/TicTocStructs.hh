@@ -1,5 +1,10 @@
 #pragma once
 
+// STO_COMPACT_ITEMS builds TransItems for OCC-only use; see TransItem.hh
+#ifndef STO_COMPACT_ITEMS
+#define STO_COMPACT_ITEMS 0
+#endif
+
 // used to store TicToc version number
 struct WideTid {
     typedef uint64_t single_type;
@@ -18,5 +23,7 @@ struct WideTid {
 // for each TItem
 union rdata_t {
     void *  v;
+#if !STO_COMPACT_ITEMS
     WideTid w;
+#endif
 };
@@ -93,10 +93,11 @@ public:
     // TTid bits: compatibility bits as defined in TransactionTid
 
     // |-----WTS value-----|-delta-|--TTid bits--|
-    //        44 bits       8 bits    12 bits
+    //      51-T bits       8 bits    T bits
+    // T is TransactionTid::mask_width + 5 (12 by default)
 
-    static constexpr type delta_shift = type(12);
-    static constexpr type wts_shift = type(20);
+    static constexpr type delta_shift = type(TransactionTid::mask_width + 5);
+    static constexpr type wts_shift = delta_shift + 8;
     static constexpr type delta_mask = type(0xff) << delta_shift;
 
     static type wts_value(type t) {
@@ -280,7 +281,11 @@ public:
 private:
     // BV::v_ is used as rts
     type wts_;
+#if STO_COMPACT_ITEMS
+    explicit TicTocVersion(const rdata_t&);
+#else
     explicit TicTocVersion(const rdata_t& rd) : BV(rd.w.v0), wts_(rd.w.v1) {}
+#endif
 };
 
 template <bool Opaque = false, bool Extend = true>
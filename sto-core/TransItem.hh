@@ -16,14 +16,23 @@ class TransProxy;
 
 class CicadaHashtable;
 
+class AdaptiveHashtable;
+
 template <typename VersImpl>
 class VersionBase;
 
 template <typename VersImpl>
 class TicTocBase;
 
-enum class CCMode : int {none = 0, opt, lock, tictoc};
+enum class CCMode : int {none = 0, opt, lock, tictoc, mvcc};
 
+// With STO_COMPACT_ITEMS, a TransItem drops the state only TicToc, lock-mode
+// (2PL and adaptive) and MVCC items need: the concurrency-control mode, the
+// TicToc timestamp origin, and the second word of TicToc wide reads. That
+// takes an item from 56 bytes to 32 (40 with STO_ACTIVE_LIST), so the
+// commit loops scan more items per cache line. Only OCC version types work
+// in such builds: TicToc versions fail to link, and items that ask for a
+// lock or MVCC mode fail an assertion.
 class TransItem {
   public:
 #if SIZEOF_VOID_P == 8
@@ -46,14 +55,29 @@ class TransItem {
     static constexpr flags_type owner_mask = pointer_mask;
     static constexpr flags_type user0_bit = flags_type(1) << 48;
     static constexpr int userf_shift = 48;
-    static constexpr flags_type shifted_userf_mask = 0x7FF;
+    static constexpr flags_type shifted_userf_mask = 0xFF;  // bits 48-55; above are special
     static constexpr flags_type special_mask = owner_mask | cl_bit | read_bit | write_bit | lock_bit | predicate_bit | stash_bit | commute_bit | mvhistory_bit;
+    // flags that give an item commit-time work (see STO_ACTIVE_LIST)
+    static constexpr flags_type active_mask = read_bit | write_bit | lock_bit | predicate_bit;
 
 
-    TransItem() : s_(), key_(), rdata_(), wdata_(), mode_(CCMode::none) {};
+#if STO_COMPACT_ITEMS
+    TransItem() : s_(), key_(), rdata_(), wdata_() {
+        init_listed();
+    }
+    TransItem(TObject* owner, void* k)
+        : s_(reinterpret_cast<ownerstore_type>(owner)), key_(k), rdata_(), wdata_() {
+        init_listed();
+    }
+#else
+    TransItem() : s_(), key_(), rdata_(), wdata_(), mode_(CCMode::none) {
+        init_listed();
+    }
     TransItem(TObject* owner, void* k)
         : s_(reinterpret_cast<ownerstore_type>(owner)), key_(k), rdata_(), wdata_(), mode_(CCMode::none) {
+        init_listed();
     }
+#endif
 
     TObject* owner() const {
         return reinterpret_cast<TObject*>(s_ & pointer_mask);
@@ -106,6 +130,11 @@ class TransItem {
         return Packer<T>::unpack(rdata_.v);
     }
 
+#if STO_COMPACT_ITEMS
+    // no room for TicToc reads; using a TicToc version fails to link
+    const WideTid& wide_read_value() const;
+    WideTid& wide_read_value();
+#else
     // Reserved for accessing TicToc versions in the read set
     const WideTid& wide_read_value() const {
         assert(has_read());
@@ -115,6 +144,7 @@ class TransItem {
     WideTid& wide_read_value() {
         return rdata_.w;
     }
+#endif
 
     template <typename T>
     T& predicate_value() {
@@ -221,6 +251,34 @@ class TransItem {
         return *this;
     }
 
+#if STO_COMPACT_ITEMS
+    // every item is optimistic; CCMode::none keeps the adaptive statistics
+    // and TicToc checks in the commit loops quiet
+    CCMode cc_mode() const {
+        return CCMode::none;
+    }
+
+    CCMode cc_mode(CCMode observe_mode) {
+        always_assert(observe_mode == CCMode::opt, "STO_COMPACT_ITEMS builds are OCC-only");
+        return observe_mode;
+    }
+
+    void cc_mode_check_tictoc(void*, bool) {
+        always_assert(false, "STO_COMPACT_ITEMS builds are OCC-only");
+    }
+
+    bool cc_mode_is_optimistic(bool version_optimistic) {
+        always_assert(version_optimistic, "STO_COMPACT_ITEMS builds are OCC-only");
+        return true;
+    }
+
+    // declared for the TicToc versions' sake, never defined
+    template <typename VersImpl>
+    VersImpl& tictoc_fetch_ts_origin();
+    template <typename VersImpl>
+    VersImpl tictoc_extract_read_ts() const;
+    bool is_tictoc_compressed();
+#else
     CCMode cc_mode() const {
         return mode_;
     }
@@ -266,6 +324,7 @@ class TransItem {
         assert(cc_mode() == CCMode::tictoc);
         return (ts_origin_ & tictoc_compressed_type_bit) != 0;
     }
+#endif
 
 private:
     static constexpr uintptr_t tictoc_compressed_type_bit = 0x1;
@@ -275,16 +334,32 @@ private:
     void* key_;
     rdata_t rdata_;
     void* wdata_;
+#if !STO_COMPACT_ITEMS
     uintptr_t ts_origin_; // only used by TicToc
 
     CCMode mode_;
+#endif
+#if STO_ACTIVE_LIST
+    bool listed_; // already on the transaction's active list
+#endif
+
+    void init_listed() {
+#if STO_ACTIVE_LIST
+        listed_ = false;
+#endif
+    }
 
     void __rm_flags(flags_type flags) {
         s_ = s_ & ~flags;
     }
     void __or_flags(flags_type flags) {
+#if STO_ACTIVE_LIST
+        if (!listed_ && (flags & active_mask))
+            list_active();
+#endif
         s_ = s_ | flags;
     }
+    inline void list_active();
 
     friend class Transaction;
     friend class TransProxy;
@@ -292,6 +367,7 @@ private:
     friend class MvAccess;
     friend class VersionDelegate;
     friend class CicadaHashtable;
+    friend class AdaptiveHashtable;
 };
 
 class TransProxy {
@@ -383,6 +459,9 @@ class TransProxy {
     inline TransProxy& add_write(T&& wdata);
     template <typename T, typename... Args>
     inline TransProxy& add_write(Args&&... wdata);
+    // Constructs the write value in place and returns it to fill in
+    template <typename T, typename... Args>
+    inline T& emplace_write(Args&&... args);
     inline TransProxy& clear_write() {
         item().__rm_flags(TransItem::write_bit);
         return *this;
@@ -3,6 +3,9 @@
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include "compiler.hh"
+#include "HighWater.hh"
+#include "MemStats.hh"
 
 class TransScratch {
 public:
@@ -17,6 +20,7 @@ public:
             : tail_next_avail(0), tail_capacity(init_size),
               total_capacity(init_size) {
         auto z = new char [sizeof(zone_hdr) + init_size];
+        MemStats::account(mem_scratch, sizeof(zone_hdr) + init_size);
         new (reinterpret_cast<zone_hdr *>(z)) zone_hdr(init_size);
         zone_head = zone_tail = reinterpret_cast<zone_hdr *>(z);
     }
@@ -46,6 +50,7 @@ protected:
     size_t total_capacity;
     zone_hdr *zone_head;
     zone_hdr *zone_tail;
+    HighWater hw_;
 };
 
 template <typename T>
@@ -58,6 +63,7 @@ T& TransScratch::allocate() {
         assert(new_capacity > sizeof(T));
 
         auto z = new char [sizeof(zone_hdr) + new_capacity];
+        MemStats::account(mem_scratch, sizeof(zone_hdr) + new_capacity);
         auto new_zone = reinterpret_cast<zone_hdr *>(z);
         new (new_zone) zone_hdr(new_capacity);
 
@@ -96,11 +102,16 @@ T& TransScratch::clone(const T &other) {
 }
 
 void TransScratch::clear() {
+    // earlier zones are full up to the last allocation that didn't fit
+    size_t peak = 0;
+    bool window = hw_.note(total_capacity - tail_capacity + tail_next_avail, peak);
     if (zone_head == zone_tail) {
         // there is only one segment, reuse that zone
         assert(total_capacity == tail_capacity);
         tail_next_avail = 0;
-        return;
+        if (likely(!window) || !zone_head
+            || !HighWater::oversized(total_capacity, peak, initial_zone_capacity))
+            return;
     }
 
     zone_hdr *curr = zone_head;
@@ -108,6 +119,7 @@ void TransScratch::clear() {
     while (curr != nullptr) {
         auto next_zone = curr->next;
         capacity_check += curr->length;
+        MemStats::account(mem_scratch, -int64_t(sizeof(zone_hdr) + curr->length));
         delete[] curr;
         curr = next_zone;
     }
@@ -116,8 +128,11 @@ void TransScratch::clear() {
     // limit the size of the consolidated initial zone
     if (total_capacity > max_scratch_restart_capacity)
         total_capacity = max_scratch_restart_capacity;
+    if (window && HighWater::oversized(total_capacity, peak, initial_zone_capacity))
+        total_capacity = std::max(peak, initial_zone_capacity);
 
     auto z = new char [sizeof(zone_hdr) + total_capacity];
+    MemStats::account(mem_scratch, sizeof(zone_hdr) + total_capacity);
     auto single_zone = reinterpret_cast<zone_hdr *>(z);
     new (single_zone) zone_hdr(total_capacity);
 
@@ -1,29 +1,172 @@
 #include "Sto.hh"
 #include <typeinfo>
 #include <bitset>
+#include <cstring>
 #include <fstream>
 
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 
+#include "AsyncIO.hh"
+#include "LogReplica.hh"
+#include "ServiceThreads.hh"
 #include "MVCC.hh"
+#if TSET_SIMD_SCAN || STO_NUMA_ALLOC
+#include "PlatformFeatures.hh"
+#endif
+#if STO_NUMA_ALLOC
+#include <numa.h>
+#include <numaif.h>
+#include <sched.h>
+#endif
 
 Transaction::testing_type Transaction::testing;
-threadinfo_t Transaction::tinfo[MAX_THREADS];
+threadinfo_table Transaction::tinfo;
 __thread int TThread::the_id;
 PercentGen TThread::gen[MAX_THREADS];
+std::atomic<unsigned> TThread::active_gen_;
+std::atomic<unsigned> TThread::nactive_;
+std::atomic<int> TThread::active_[MAX_THREADS];
+std::atomic<unsigned> TThread::active_slot_[MAX_THREADS];
+std::atomic<int32_t> TLockModeStats::score_[TLockModeStats::nbuckets];
+__thread unsigned TLockModeStats::tick_;
 
 Transaction::epoch_state __attribute__((aligned(128))) Transaction::global_epochs = {
-    {2}, {1}, {0}, TransactionTid::increment_value, true
+    {2}, {1}, {0}, {0}, TransactionTid::increment_value, true, {0}
 };
 __thread Transaction *TThread::txn = nullptr;
 std::function<void(threadinfo_t::epoch_type)> Transaction::epoch_advance_callback;
+std::atomic<Transaction::epoch_type> Transaction::snapshot_pins[Transaction::max_snapshot_pins];
+std::atomic<TransactionTid::type> Transaction::read_tid_hold;
 std::atomic<TransactionTid::type> __attribute__((aligned(128)))
     Transaction::_TID(3 * TransactionTid::increment_value);
 std::atomic<TransactionTid::type> __attribute__((aligned(128)))
     Transaction::_RTID(2 * TransactionTid::increment_value);
    // reserve TransactionTid::increment_value for prepopulated
+txp_counters Transaction::retired_p_;
+tc_counters Transaction::retired_tcs_;
+static std::mutex retired_mutex;
 unsigned Transaction::us_per_epoch = 1000;  // Defaults to 1ms
+unsigned Transaction::epoch_cycle_min = 0;
+unsigned Transaction::epoch_cycle_max = 0;
+size_t Transaction::epoch_backlog_target = 0;
+bool Transaction::readonly_fast_path = true;
+bool Transaction::profile_counters = STO_PROFILE_COUNTERS > 0;
+bool Transaction::sorted_locking_default = false;
+bool Transaction::early_unlock = false;
+Transaction::commit_observer_type Transaction::commit_observer_ = nullptr;
+unsigned Transaction::opacity_extension_limit = 0;
+unsigned Transaction::repair_limit = 0;
+bool Transaction::epoch_tids_ = STO_EPOCH_TIDS;
+#if STO_VALIDATE_PREFETCH
+unsigned Transaction::validate_prefetch = STO_VALIDATE_PREFETCH;
+#endif
+
+std::mutex txp_registry::mutex_;
+std::atomic<unsigned> txp_registry::size_(0);
+const char* txp_registry::names_[txp_registry::max_counters];
+
+unsigned txp_registry::add(const char* name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    unsigned n = size_.load(std::memory_order_relaxed);
+    for (unsigned c = 0; c != n; ++c)
+        if (strcmp(names_[c], name) == 0)
+            return c;
+    always_assert(n != max_counters, "too many profile counters registered");
+    names_[n] = name;
+    size_.store(n + 1, std::memory_order_release);
+    return n;
+}
+
+#if TSET_SIMD_SCAN
+static tset_scan::find_type select_tset_find() {
+    switch (cpu_simd_level()) {
+    case SimdLevel::avx512:
+        return tset_scan::find_avx512;
+    case SimdLevel::avx2:
+        return tset_scan::find_avx2;
+    default:
+        return tset_scan::find_scalar;
+    }
+}
+tset_scan::find_type Transaction::tset_find = select_tset_find();
+#endif
+
+threadinfo_t& threadinfo_table::allocate(int i) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t sz = (sizeof(threadinfo_t) + page - 1) & ~(page - 1);
+    void* p = mmap(nullptr, sz, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    always_assert(p != MAP_FAILED);
+    threadinfo_t* t = new (p) threadinfo_t;
+    threadinfo_t* expected = nullptr;
+    if (!slots_[i].compare_exchange_strong(expected, t)) {
+        t->~threadinfo_t();
+        munmap(p, sz);
+        t = expected;
+    }
+    return *t;
+}
+
+#if STO_NUMA_ALLOC
+// Node of the calling thread's CPU, or -1 before discover_topology() ran
+// or on a single-node machine
+static int local_numa_node() {
+    if (topo_info.num_nodes <= 1)
+        return -1;
+    return topology_node_of_cpu(sched_getcpu());
+}
+
+static void* numa_place(size_t sz) {
+    int node = local_numa_node();
+    void* p = node >= 0 ? numa_alloc_onnode(sz, node) : numa_alloc_local(sz);
+    always_assert(p);
+    return p;
+}
+
+static void check_numa_placement(const void* p, const char* what) {
+# if STO_NUMA_ALLOC > 1
+    int node = local_numa_node();
+    void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(sysconf(_SC_PAGESIZE) - 1));
+    int status = -1;
+    if (node >= 0 && move_pages(0, 1, &page, nullptr, &status, 0) == 0
+        && status >= 0 && status != node)
+        std::cerr << "STO: " << what << " " << p << " on node " << status
+                  << ", thread " << TThread::id() << " on node " << node << std::endl;
+# else
+    (void) p, (void) what;
+# endif
+}
+
+void* Transaction::operator new(size_t sz) {
+    return numa_place(sz);
+}
+
+void Transaction::operator delete(void* p, size_t sz) {
+    numa_free(p, sz);
+}
+#endif
+
+// Layout of a transaction's tset reservation: tset_reserve items, then
+// (TSET_SIMD_SCAN) their fingerprints, each part page-aligned
+static size_t page_round_up(size_t n) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (n + page - 1) & ~(page - 1);
+}
+
+static size_t page_round_down(size_t n) {
+    return n & ~size_t(sysconf(_SC_PAGESIZE) - 1);
+}
+
+static constexpr size_t tset_fp_bytes(unsigned n) {
+#if TSET_SIMD_SCAN
+    return sizeof(uint64_t) * n;
+#else
+    (void) n;
+    return 0;
+#endif
+}
 
 static void __attribute__((used)) check_static_assertions() {
     static_assert(sizeof(threadinfo_t) % 128 == 0, "threadinfo is 2-cache-line aligned");
@@ -31,46 +174,227 @@ static void __attribute__((used)) check_static_assertions() {
 
 void Transaction::initialize() {
     static_assert(tset_initial_capacity % tset_chunk == 0, "tset_initial_capacity not an even multiple of tset_chunk");
+    static_assert(tset_reserve % tset_chunk == 0, "tset_reserve not an even multiple of tset_chunk");
     hash_base_ = 32768;
     tset_size_ = 0;
+#if STO_ITEM_MRU
+    mru_clear();
+#endif
     lrng_state_ = 12897;
-#if CICADA_HASHTABLE == 0 && defined(TRANSACTION_HASHTABLE)
+#if CICADA_HASHTABLE == 0 && ADAPTIVE_HASHTABLE == 0 && defined(TRANSACTION_HASHTABLE)
     bzero(hashtable_, sizeof(hashtable_));
 #endif
     commit_tid_ = 0;
     prev_commit_tid_ = 0;
-    for (unsigned i = 0; i != tset_initial_capacity / tset_chunk; ++i)
-        tset_[i] = &tset0_[i * tset_chunk];
-    for (unsigned i = tset_initial_capacity / tset_chunk; i != arraysize(tset_); ++i)
-        tset_[i] = nullptr;
+    epoch_tid_floor_ = 0;
+#if STO_HTM
+    htm_tid_ = 0;
+#endif
+    readonly_ = false;
+    sorted_locking_ = sorted_locking_default;
+    logging_ = false;
+    // claim this thread's threadinfo while running on its node
+    (void) tinfo[threadid_];
+#if STO_NUMA_ALLOC
+    check_numa_placement(this, "Transaction");
+#endif
+    // pages are placed on first touch, by this transaction's thread
+    size_t items_bytes = page_round_up(sizeof(TransItem) * size_t(tset_reserve));
+    void* p = mmap(nullptr, items_bytes + page_round_up(tset_fp_bytes(tset_reserve)), PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    always_assert(p != MAP_FAILED, "cannot reserve the tset");
+    tset_ = static_cast<TransItem*>(p);
+#if TSET_SIMD_SCAN
+    tfp_ = reinterpret_cast<uint64_t*>(static_cast<char*>(p) + items_bytes);
+#endif
+    tset_capacity_ = 0;
+    while (tset_capacity_ != tset_initial_capacity)
+        grow_tset();
+#if STO_ACTIVE_LIST
+    alist_.reserve(tset_initial_capacity);
+#endif
 }
 
 Transaction::~Transaction() {
     if (in_progress())
         silent_abort();
-    TransItem* live = tset0_;
-    for (unsigned i = 0; i != arraysize(tset_); ++i, live += tset_chunk)
-        if (live != tset_[i])
-            delete[] tset_[i];
+    MemStats::account(mem_tset, -int64_t((sizeof(TransItem) + tset_fp_bytes(1)) * tset_capacity_));
+    munmap(tset_, page_round_up(sizeof(TransItem) * size_t(tset_reserve))
+           + page_round_up(tset_fp_bytes(tset_reserve)));
+#if !CICADA_HASHTABLE && !ADAPTIVE_HASHTABLE
+    delete large_ht_;
+#endif
+}
+
+// Makes the next tset_chunk items of the reservation usable
+void Transaction::grow_tset() {
+    always_assert(tset_capacity_ != tset_reserve, "transaction exceeds tset_reserve items");
+    auto base = reinterpret_cast<uintptr_t>(tset_);
+    size_t lo = page_round_down(sizeof(TransItem) * size_t(tset_capacity_));
+    size_t hi = page_round_up(sizeof(TransItem) * size_t(tset_capacity_ + tset_chunk));
+    always_assert(mprotect(reinterpret_cast<void*>(base + lo), hi - lo, PROT_READ | PROT_WRITE) == 0);
+#if TSET_SIMD_SCAN
+    base = reinterpret_cast<uintptr_t>(tfp_);
+    lo = page_round_down(tset_fp_bytes(tset_capacity_));
+    hi = page_round_up(tset_fp_bytes(tset_capacity_ + tset_chunk));
+    always_assert(mprotect(reinterpret_cast<void*>(base + lo), hi - lo, PROT_READ | PROT_WRITE) == 0);
+#endif
+    tset_capacity_ += tset_chunk;
+    MemStats::account(mem_tset, (sizeof(TransItem) + tset_fp_bytes(1)) * tset_chunk);
+}
+
+// Returns the pages of tset items [keep, tset_capacity_) to the kernel
+static void release_tset_pages(void* base, size_t keep_bytes, size_t cap_bytes) {
+    size_t lo = page_round_up(keep_bytes), hi = page_round_up(cap_bytes);
+    if (lo < hi) {
+        void* p = static_cast<char*>(base) + lo;
+        madvise(p, hi - lo, MADV_DONTNEED);
+        mprotect(p, hi - lo, PROT_NONE);
+    }
+}
+
+#if !CICADA_HASHTABLE && !ADAPTIVE_HASHTABLE
+void Transaction::large_put(const TObject* obj, void* xkey) {
+    if (unlikely(!large_ht_active_)) {
+        if (!large_ht_)
+            large_ht_ = new AdaptiveHashtable(*this);
+        large_ht_->rebuild(tset_size_ - 1);
+        large_ht_active_ = true;
+    }
+    large_ht_->put(const_cast<TObject*>(obj), xkey, tset_size_ - 1);
+}
+#endif
+
+void Transaction::reserve_bulk(unsigned n) {
+    if (n <= bulk_capacity_)
+        return;
+    bulk_capacity_ = std::max(n, 2 * bulk_capacity_);
+    bulk_idx_.reset(new unsigned[2 * bulk_capacity_]);
+    bulk_items_.reset(new TransItem*[bulk_capacity_]);
 }
 
-void Transaction::refresh_tset_chunk() {
-    assert(tset_size_ % tset_chunk == 0);
-    assert(tset_size_ < tset_max_capacity);
-    if (!tset_[tset_size_ / tset_chunk])
-        tset_[tset_size_ / tset_chunk] = new TransItem[tset_chunk];
-    tset_next_ = tset_[tset_size_ / tset_chunk];
+void Transaction::shrink_tset(size_t peak) {
+    if (bulk_capacity_ && peak <= bulk_commit_min) {
+        bulk_idx_.reset();
+        bulk_items_.reset();
+        bulk_capacity_ = 0;
+    }
+#if !CICADA_HASHTABLE && !ADAPTIVE_HASHTABLE
+    if (large_ht_ && peak <= hash_index_limit) {
+        delete large_ht_;
+        large_ht_ = nullptr;
+    }
+#endif
+    if (!HighWater::oversized(tset_capacity_, peak, tset_initial_capacity))
+        return;
+    unsigned keep = std::max(tset_initial_capacity, unsigned(peak) + tset_chunk - 1) / tset_chunk * tset_chunk;
+    release_tset_pages(tset_, sizeof(TransItem) * size_t(keep), sizeof(TransItem) * size_t(tset_capacity_));
+#if TSET_SIMD_SCAN
+    release_tset_pages(tfp_, tset_fp_bytes(keep), tset_fp_bytes(tset_capacity_));
+#endif
+    MemStats::account(mem_tset, -int64_t((sizeof(TransItem) + tset_fp_bytes(1)) * (tset_capacity_ - keep)));
+    tset_capacity_ = keep;
+}
+
+void AdaptiveHashtable::rebuild(unsigned nitems) {
+    uint32_t capacity = initial_capacity;
+    while (capacity < 4 * nitems)
+        capacity *= 2;
+    resize(capacity, nitems);
+}
+
+void AdaptiveHashtable::resize(uint32_t capacity, unsigned nitems) {
+    assert(capacity >= initial_capacity && (capacity & (capacity - 1)) == 0);
+    delete[] slots_;
+    slots_ = new uint32_t[capacity]();
+    mask_ = capacity - 1;
+    base_ = 0;
+    nsmall_ = 0;
+    for (unsigned idx = 0; idx != nitems; ++idx) {
+        TransItem* ti = &txn_.tset_[idx];
+        insert_(ti->owner(), ti->key_, idx);
+    }
+}
+
+size_t Transaction::rcu_help(size_t limit) {
+    if (!TRcuSet::orphan_backlog())
+        return 0;
+    threadinfo_t& thr = this_thread();
+    // callbacks may rcu_call; date those like a transaction would
+    thr.write_snapshot_epoch.store(global_epochs.global_epoch.load(std::memory_order_acquire), std::memory_order_release);
+    size_t n = TRcuSet::run_orphans(limit);
+    thr.write_snapshot_epoch.store(0, std::memory_order_release);
+    txp_account<txp_rcu_helped>(n);
+    return n;
+}
+
+void Transaction::rcu_reclaimer(int thread_id) {
+    TThread::set_id(thread_id);
+    threadinfo_t& thr = this_thread();
+    while (global_epochs.run) {
+        size_t n = rcu_help(std::max(STO_RCU_BUDGET, 64));
+        thr.rcu_set.clean_until(global_epochs.active_epoch.load(std::memory_order_acquire));
+        if (!n)
+            usleep(std::max(us_per_epoch / 4, 1U));
+    }
+}
+
+void TThread::register_id(int id) {
+    unsigned g = lock_active();
+    if (!active_slot_[id].load(std::memory_order_relaxed)) {
+        unsigned n = nactive_.load(std::memory_order_relaxed);
+        active_[n].store(id, std::memory_order_relaxed);
+        active_slot_[id].store(n + 1, std::memory_order_relaxed);
+        nactive_.store(n + 1, std::memory_order_release);
+    }
+    active_gen_.store(g + 1, std::memory_order_release);
+}
+
+int TThread::acquire_id(int first) {
+    unsigned g = lock_active();
+    int id = std::max(first, 0);
+    while (id < MAX_THREADS && active_slot_[id].load(std::memory_order_relaxed))
+        ++id;
+    if (id < MAX_THREADS) {
+        unsigned n = nactive_.load(std::memory_order_relaxed);
+        active_[n].store(id, std::memory_order_relaxed);
+        active_slot_[id].store(n + 1, std::memory_order_relaxed);
+        nactive_.store(n + 1, std::memory_order_release);
+        the_id = id;
+    } else
+        id = -1;
+    active_gen_.store(g + 1, std::memory_order_release);
+    return id;
+}
+
+void TThread::unregister_id(int id) {
+    assert(id >= 0 && id < MAX_THREADS);
+    unsigned g = lock_active();
+    if (unsigned slot = active_slot_[id].load(std::memory_order_relaxed)) {
+        unsigned n = nactive_.load(std::memory_order_relaxed) - 1;
+        int last = active_[n].load(std::memory_order_relaxed);
+        active_[slot - 1].store(last, std::memory_order_relaxed);
+        active_slot_[last].store(slot, std::memory_order_relaxed);
+        active_slot_[id].store(0, std::memory_order_relaxed);
+        nactive_.store(n, std::memory_order_release);
+    }
+    active_gen_.store(g + 1, std::memory_order_release);
 }
 
 void* Transaction::epoch_advancer(void*) {
     static int num_epoch_advancers = 0;
     if (fetch_and_add(&num_epoch_advancers, 1) != 0)
         std::cerr << "WARNING: more than one epoch_advancer thread\n";
+    ServiceThreads::scope service("epoch advancer");
 
     // don't bother epoch'ing til things have picked up
     usleep(us_per_epoch);
     while (global_epochs.run) {
         global_epoch_advance_once();
+        TxnTrace::record_global(tr_epoch_advance, global_epochs.global_epoch.load());
+        if (epoch_cycle_max)
+            adapt_epoch_cycle();
+        TxnTrace::poll_dump();
         usleep(us_per_epoch);
     }
 
@@ -82,8 +406,8 @@ void Transaction::global_epoch_advance_once() {
     epoch_type ge = global_epochs.global_epoch.load();
     epoch_type re = global_epochs.global_epoch.load();
     epoch_type ae = global_epochs.read_epoch.load();
-    int i = 0;
-    for (auto& t : tinfo) {
+    TThread::for_each_active([&] (int id) {
+        auto& t = tinfo[id];
         auto twepoch = t.write_snapshot_epoch.load();
         auto trepoch = t.epoch.load();
         if (twepoch != 0 && signed_epoch_type(twepoch - re) < 0) {
@@ -92,26 +416,55 @@ void Transaction::global_epoch_advance_once() {
         if (trepoch != 0 && signed_epoch_type(trepoch - ae) < 0) {
             ae = trepoch;
         }
-        i++;
+    });
+    for (auto& p : snapshot_pins) {
+        auto pepoch = p.load();
+        if (pepoch != 0 && signed_epoch_type(pepoch - ae) < 0)
+            ae = pepoch;
     }
     global_epochs.global_epoch = std::max(ge + 1, epoch_type(1));
+    global_epochs.epoch_tsc.store(read_tsc(), std::memory_order_relaxed);
     global_epochs.read_epoch = re;
     global_epochs.active_epoch = ae;
-    global_epochs.recent_tid = _TID.load(std::memory_order_relaxed);
+    global_epochs.recent_tid = tid_floor();
+    // nothing else may move _RTID, which opacity checks start from
+    if (epoch_tids_)
+        epoch_advance_once();
 
     if (epoch_advance_callback)
         epoch_advance_callback(global_epochs.global_epoch);
 }
 
+void Transaction::adapt_epoch_cycle() {
+    // Halve the cycle while callbacks pile up or grow fast; creep back
+    // toward the maximum once the backlog drains.
+    static size_t last_backlog = 0;
+    size_t backlog = rcu_backlog();
+    unsigned us = us_per_epoch;
+    if (backlog > epoch_backlog_target
+        || backlog > last_backlog + epoch_backlog_target / 4)
+        us = std::max(us / 2, epoch_cycle_min);
+    else if (backlog < epoch_backlog_target / 4)
+        us = std::min(us + us / 4 + 1, epoch_cycle_max);
+    last_backlog = backlog;
+    us_per_epoch = us;
+}
+
 void Transaction::epoch_advance_once() {
-    tid_type min_wtid = _TID.load(std::memory_order_relaxed);
-    for (auto& t : tinfo) {
+    tid_type min_wtid = tid_floor();
+    // pairs with the fence in next_epoch_tid
+    if (epoch_tids_)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    TThread::for_each_active([&] (int id) {
         fence();
-        tid_type wtid = t.wtid;
+        tid_type wtid = tinfo[id].wtid;
         if (wtid != 0 && wtid < min_wtid)
             min_wtid = wtid;
-    }
+    });
     fence();
+    tid_type hold = read_tid_hold.load(std::memory_order_acquire);
+    if (hold != 0 && hold < min_wtid)
+        min_wtid = hold;
     if (min_wtid > 0) {
         tid_type next = min_wtid - TransactionTid::increment_value;
         tid_type rtid;
@@ -122,15 +475,99 @@ void Transaction::epoch_advance_once() {
 }
 
 bool Transaction::preceding_duplicate_read(TransItem* needle) const {
-    const TransItem* it = nullptr;
-    for (unsigned tidx = 0; ; ++tidx) {
-        it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
-        if (it == needle)
+    // Items don't gain or lose reads during a pass, so one scan answers
+    // every failed check in it
+    if (!first_reads_valid_) {
+        first_reads_.clear();
+        const TransItem* it = nullptr;
+        for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
+            it = &tset_[tidx];
+            if (it->has_read())
+                first_reads_.emplace(item_id{it->owner(), it->key_}, it);
+        }
+        first_reads_valid_ = true;
+    }
+    auto it = first_reads_.find(item_id{needle->owner(), needle->key_});
+    return it != first_reads_.end() && it->second != needle;
+}
+
+// Reorders idx so each owner's items are contiguous (tset order within an
+// owner) and fills batch with the matching items.
+void Transaction::group_by_owner(TransItem** batch, unsigned* idx, unsigned n) const {
+    auto item = [this] (unsigned i) {
+        return &tset_[i];
+    };
+    std::sort(idx, idx + n, [&] (unsigned i, unsigned j) {
+        TObject* oi = item(i)->owner();
+        TObject* oj = item(j)->owner();
+        return std::less<TObject*>()(oi, oj) || (oi == oj && i < j);
+    });
+    for (unsigned k = 0; k != n; ++k)
+        batch[k] = item(idx[k]);
+}
+
+#if STO_BATCH_COMMIT
+static inline unsigned owner_run_end(TransItem** batch, unsigned i, unsigned n) {
+    TObject* owner = batch[i]->owner();
+    for (++i; i != n && batch[i]->owner() == owner; ++i)
+        ;
+    return i;
+}
+#endif
+
+bool Transaction::commit_lock(TransItem* it) {
+    if (!it->needs_unlock() && !it->owner()->lock(*it, *this)) {
+        TXP_INCREMENT(txp_lock_aborts);
+        mark_abort_because(it, "commit lock");
+        return false;
+    }
+    it->__or_flags(TransItem::lock_bit);
+    it->__or_flags(TransItem::cl_bit);
+    return true;
+}
+
+// Locks batch, grouped by owner, with one lock_batch call per owner run
+bool Transaction::commit_lock_runs(TransItem** batch, unsigned n) {
+    for (unsigned i = 0; i != n; ) {
+        if (batch[i]->needs_unlock()) {
+            batch[i]->__or_flags(TransItem::cl_bit);
+            ++i;
+            continue;
+        }
+        TObject* owner = batch[i]->owner();
+        unsigned j = i + 1;
+        while (j != n && batch[j]->owner() == owner && !batch[j]->needs_unlock())
+            ++j;
+        unsigned nlocked = owner->lock_batch(batch + i, j - i, *this);
+        for (unsigned k = i; k != i + nlocked; ++k) {
+            batch[k]->__or_flags(TransItem::lock_bit);
+            batch[k]->__or_flags(TransItem::cl_bit);
+        }
+        if (i + nlocked != j) {
+            TXP_INCREMENT(txp_lock_aborts);
+            mark_abort_because(batch[i + nlocked], "commit lock");
+            return false;
+        }
+        i = j;
+    }
+    return true;
+}
+
+inline void Transaction::unlock_installed(TransItem* it) {
+    if (it->needs_unlock() && it->owner()->unlock_after_install(*it)) {
+        it->owner()->unlock(*it);
+        it->clear_needs_unlock();
+    }
+}
+
+bool Transaction::check_ro_reads() const {
+    for (auto& r : ro_reads_) {
+        TransactionTid::type cur = *r.vers;
+        if (TransactionTid::is_locked(cur)
+            || !TransactionTid::check_version(cur, r.observed))
             return false;
-        if (it->owner() == needle->owner() && it->key_ == needle->key_
-            && it->has_read())
-            return true;
     }
+    return true;
 }
 
 bool Transaction::hard_check_opacity(TransItem* item, TransactionTid::type t) {
@@ -154,6 +591,11 @@ bool Transaction::hard_check_opacity(TransItem* item, TransactionTid::type t) {
     }
     assert(state_ == s_in_progress);
 
+    if (opacity_extension_limit && opacity_extensions_ >= opacity_extension_limit) {
+        mark_abort_because(item, "opacity extension limit", t);
+        goto abort;
+    }
+
     TXP_INCREMENT(txp_hco);
     if (TransactionTid::is_locked_elsewhere(t, threadid_)) {
         TXP_INCREMENT(txp_hco_lock);
@@ -164,11 +606,17 @@ bool Transaction::hard_check_opacity(TransItem* item, TransactionTid::type t) {
         TXP_INCREMENT(txp_hco_invalid);
 
     state_ = s_opacity_check;
-    start_tid_ = _TID.load(std::memory_order_relaxed);
+    start_tid_ = opacity_tid();
     release_fence();
+    new_validation_pass();
     TransItem* it = nullptr;
+#if STO_ACTIVE_LIST
+    for (unsigned tidx : alist_) {
+        it = &tset_[tidx];
+#else
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
-        it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
+        it = &tset_[tidx];
+#endif
         if (it->has_read()) {
             TXP_INCREMENT(txp_total_check_read);
             if (!it->owner()->check(*it, *this)
@@ -184,6 +632,11 @@ bool Transaction::hard_check_opacity(TransItem* item, TransactionTid::type t) {
             }
         }
     }
+    if (!check_ro_reads()) {
+        mark_abort_because(item, "opacity check readonly");
+        goto abort;
+    }
+    ++opacity_extensions_;
     state_ = s_in_progress;
     return true;
 }
@@ -198,8 +651,24 @@ void Transaction::stop(bool committed, unsigned* writeset, unsigned nwriteset) {
 #if STO_TSC_PROFILE
     TimeKeeper<tc_cleanup> tk;
 #endif
+    uint64_t phase_t = PhaseProfile::now(threadid_);
+    TxnTrace::record(tr_stop, committed);
+    if (committed && unlikely(commit_observer_))
+        commit_observer_(tset_, tset_size_);
+    if (logging_) {
+        TxnLog::abort_txn();
+        logging_ = false;
+    }
+    AbortProfile::attempt(threadid_, attempt_t0_, committed, conflict_object_ ? conflict_reason_ : nullptr);
+    attempt_t0_ = 0;
     if (!committed) {
         TXP_INCREMENT(txp_total_aborts);
+        if (opts_.priority == TransactionOptions::prio_low)
+            TXP_INCREMENT(txp_low_aborts);
+        else if (opts_.priority == TransactionOptions::prio_normal)
+            TXP_INCREMENT(txp_normal_aborts);
+        else
+            TXP_INCREMENT(txp_high_aborts);
 #if STO_DEBUG_ABORTS
         if (local_random() <= uint32_t(0xFFFFFFFF * STO_DEBUG_ABORTS_FRACTION)) {
             std::ostringstream buf;
@@ -216,6 +685,7 @@ void Transaction::stop(bool committed, unsigned* writeset, unsigned nwriteset) {
             std::cerr << buf.str();
         }
 #endif
+        ConflictProfile::record(threadid_, conflict_object_, conflict_key_, conflict_reason_);
     }
 
     TXP_ACCOUNT(txp_max_transbuffer, buf_.buffer_size());
@@ -229,30 +699,24 @@ void Transaction::stop(bool committed, unsigned* writeset, unsigned nwriteset) {
 /*
         for (unsigned* idxit = writeset + nwriteset; idxit != writeset; ) {
             --idxit;
-            if (*idxit < tset_initial_capacity)
-                it = &tset0_[*idxit];
-            else
-                it = &tset_[*idxit / tset_chunk][*idxit % tset_chunk];
+            it = &tset_[*idxit];
             if (it->needs_unlock())
                 it->owner()->unlock(*it);
         }
 */
         for (unsigned* idxit = writeset + nwriteset; idxit != writeset; ) {
             --idxit;
-            if (*idxit < tset_initial_capacity)
-                it = &tset0_[*idxit];
-            else
-                it = &tset_[*idxit / tset_chunk][*idxit % tset_chunk];
+            it = &tset_[*idxit];
             if (it->has_write()) // always true unless a user turns it off in install()/check()
                 it->owner()->cleanup(*it, committed);
         }
     } else {
 /*
         if (state_ == s_committing_locked) {
-            it = &tset_[tset_size_ / tset_chunk][tset_size_ % tset_chunk];
+            it = &tset_[tset_size_];
             for (unsigned tidx = tset_size_; tidx != first_write_; --tidx) {
                 //outfile << "P6" << std::endl;
-                it = (tidx % tset_chunk ? it - 1 : &tset_[(tidx - 1) / tset_chunk][tset_chunk - 1]);
+                --it;
                 if (it->needs_unlock()) {
                     //outfile << "P7" << std::endl;
                     //outfile << "Unlocking item[" << it->key<unsigned>() << "]" << std::endl;
@@ -261,34 +725,49 @@ void Transaction::stop(bool committed, unsigned* writeset, unsigned nwriteset) {
             }
         }
 */
-        it = &tset_[tset_size_ / tset_chunk][tset_size_ % tset_chunk];
+#if STO_ACTIVE_LIST
+        for (auto ai = alist_.rbegin(); ai != alist_.rend(); ++ai) {
+            it = &tset_[*ai];
+#else
+        it = &tset_[tset_size_];
         for (unsigned tidx = tset_size_; tidx != first_write_; --tidx) {
-            it = (tidx % tset_chunk ? it - 1 : &tset_[(tidx - 1) / tset_chunk][tset_chunk - 1]);
+            --it;
+#endif
             if (it->has_write())
                 it->owner()->cleanup(*it, committed);
         }
     }
 
 unlock_all:
-    it = &tset_[tset_size_ / tset_chunk][tset_size_ % tset_chunk];
+#if STO_ACTIVE_LIST
+    for (auto ai = alist_.rbegin(); ai != alist_.rend(); ++ai) {
+        it = &tset_[*ai];
+#else
+    it = &tset_[tset_size_];
     for (unsigned tidx = tset_size_; tidx != 0; --tidx) {
-        it = (tidx % tset_chunk ? it - 1 : &tset_[(tidx - 1) / tset_chunk][tset_chunk - 1]);
+        --it;
+#endif
         if (it->needs_unlock())
             it->owner()->unlock(*it);
     }
 
     // TODO: this will probably mess up with nested transactions
     threadinfo_t& thr = tinfo[TThread::id()];
-    if (thr.trans_end_callback)
+    if (thr.trans_end_callback && !in_batch_)
         thr.trans_end_callback();
-    thr.wtid.store(0, std::memory_order_release);
+    if (thr.trans_done_callback)
+        thr.trans_done_callback(committed);
+    if (!in_batch_)
+        thr.wtid.store(0, std::memory_order_release);
     // XXX should reset trans_end_callback after calling it...
     state_ = s_aborted + committed;
     restarted = true;
 
 #if CONTENTION_REGULATION
     if (!committed) {
-       ContentionManager::on_rollback(TThread::id());
+       ContentionManager::on_rollback(TThread::id(), opts_);
+    } else {
+       ContentionManager::on_commit(TThread::id());
     }
 #endif
 
@@ -300,6 +779,7 @@ unlock_all:
     if (!committed)
         TSC_ACCOUNT(tc_abort, endtime - start_tsc_);
 #endif
+    PhaseProfile::lap(threadid_, ph_cleanup, phase_t);
 
     //COZ_PROGRESS;
 }
@@ -318,6 +798,8 @@ bool Transaction::try_commit() {
 #endif
     TXP_ACCOUNT(txp_max_set, tset_size_);
     TXP_ACCOUNT(txp_total_n, tset_size_);
+    uint64_t phase_t = PhaseProfile::lap(threadid_, ph_execute, phase_t0_);
+    phase_t0_ = 0;
 
     assert(state_ == s_in_progress || state_ >= s_aborted);
     if (state_ >= s_aborted) {
@@ -326,6 +808,14 @@ bool Transaction::try_commit() {
 
     if (any_nonopaque_)
         TXP_INCREMENT(txp_commit_time_nonopaque);
+    if (readonly_) {
+        always_assert(!any_writes_, "write in a read-only transaction");
+        if (any_nonopaque_ && !exclusive_ && !check_ro_reads()) {
+            TXP_INCREMENT(txp_commit_time_aborts);
+            stop(false, nullptr, 0);
+            return false;
+        }
+    }
 #if !CONSISTENCY_CHECK
     // commit immediately if read-only transaction with opacity
     if (!any_writes_ && !any_nonopaque_) {
@@ -333,29 +823,53 @@ bool Transaction::try_commit() {
         return true;
     }
 #endif
-
     state_ = s_committing;
-
-    unsigned writeset[tset_size_];
+    new_validation_pass();
+    // commit phase being timed, for an abort
+    int phase = ph_commit_lock;
+    TxnTrace::record(tr_commit);
+
+    // a huge tset keeps its index arrays on the heap and locks in
+    // (owner, tset index) order, one lock_batch call per owner
+    bool bulk = tset_size_ > bulk_commit_min;
+#if !STO_SORT_WRITESET && !STO_BATCH_COMMIT
+    bool sorted = sorted_locking_ || bulk;
+#endif
+    if (bulk)
+        reserve_bulk(tset_size_);
+    unsigned stack_writeset[bulk ? 1 : tset_size_];
+    unsigned* writeset = bulk ? bulk_idx_.get() : stack_writeset;
     unsigned nwriteset = 0;
     writeset[0] = tset_size_;
+#if STO_BATCH_COMMIT
+    TransItem* stack_batch[bulk ? 1 : tset_size_];
+    TransItem** batch = bulk ? bulk_items_.get() : stack_batch;
+    unsigned stack_readset[bulk ? 1 : tset_size_];
+    unsigned* readset = bulk ? bulk_idx_.get() + bulk_capacity_ : stack_readset;
+    unsigned nreadset = 0;
+#endif
+#if STO_VALIDATE_PREFETCH
+    unsigned pf_pos = 0, pf_next = 0;
+#endif
 
     TransItem* it = nullptr;
+#if STO_ACTIVE_LIST
+    sort_active_list();
+    for (unsigned tidx : alist_) {
+        it = &tset_[tidx];
+#else
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
-        it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
+        it = &tset_[tidx];
+#endif
         if (it->has_write()) {
             writeset[nwriteset++] = tidx;
-#if !STO_SORT_WRITESET
+#if !STO_SORT_WRITESET && !STO_BATCH_COMMIT
             if (nwriteset == 1) {
                 first_write_ = writeset[0];
                 state_ = s_committing_locked;
             }
-            if (!it->needs_unlock() && !it->owner()->lock(*it, *this)) {
-                mark_abort_because(it, "commit lock");
+            if (!sorted && !commit_lock(it))
                 goto abort;
-            }
-            it->__or_flags(TransItem::lock_bit);
-            it->__or_flags(TransItem::cl_bit);
 #endif
         }
         if (it->has_read()) {
@@ -363,13 +877,8 @@ bool Transaction::try_commit() {
             if (it->cc_mode() == CCMode::opt) {
                 TXP_INCREMENT(txp_total_adaptive_opt);
             }
-            // tracking TicToc commit ts (for reads) here
-            if (it->cc_mode() == CCMode::tictoc) {
-                if (it->is_tictoc_compressed())
-                    it->tictoc_extract_read_ts<TicTocCompressedVersion<>>().compute_commit_ts_step(this->tictoc_tid_, false/* !write */);
-                else
-                    it->tictoc_extract_read_ts<TicTocVersion<>>().compute_commit_ts_step(this->tictoc_tid_, false /* ! write */);
-            }
+            // TicToc reads already folded their wts into tictoc_tid_ when
+            // they were observed
         } else if (it->has_predicate()) {
             TXP_INCREMENT(txp_total_check_predicate);
             if (!it->owner()->check_predicate(*it, *this, true)) {
@@ -381,11 +890,43 @@ bool Transaction::try_commit() {
 
     first_write_ = writeset[0];
 
+#if !STO_SORT_WRITESET && !STO_BATCH_COMMIT
+    // Lock in (owner, tset index) order: global across objects, while each
+    // object still sees its own items in tset order. Batch commit already
+    // locks in this order.
+    if (sorted && nwriteset) {
+        state_ = s_committing_locked;
+        if (bulk) {
+            group_by_owner(bulk_items_.get(), writeset, nwriteset);
+            if (!commit_lock_runs(bulk_items_.get(), nwriteset))
+                goto abort;
+        } else {
+            std::sort(writeset, writeset + nwriteset, [&] (unsigned i, unsigned j) {
+                TObject* oi = tset_[i].owner();
+                TObject* oj = tset_[j].owner();
+                return std::less<TObject*>()(oi, oj) || (oi == oj && i < j);
+            });
+            for (unsigned k = 0; k != nwriteset; ++k)
+                if (!commit_lock(&tset_[writeset[k]]))
+                    goto abort;
+        }
+    }
+#endif
+
+#if STO_BATCH_COMMIT
+    if (nwriteset) {
+        state_ = s_committing_locked;
+        group_by_owner(batch, writeset, nwriteset);
+        if (!commit_lock_runs(batch, nwriteset))
+            goto abort;
+    }
+#endif
+
     //phase1
 #if STO_SORT_WRITESET
     std::sort(writeset, writeset + nwriteset, [&] (unsigned i, unsigned j) {
-        TransItem* ti = &tset_[i / tset_chunk][i % tset_chunk];
-        TransItem* tj = &tset_[j / tset_chunk][j % tset_chunk];
+        TransItem* ti = &tset_[i];
+        TransItem* tj = &tset_[j];
         return *ti < *tj;
     });
 
@@ -393,7 +934,7 @@ bool Transaction::try_commit() {
         state_ = s_committing_locked;
         auto writeset_end = writeset + nwriteset;
         for (auto it = writeset; it != writeset_end; ) {
-            TransItem* me = &tset_[*it / tset_chunk][*it % tset_chunk];
+            TransItem* me = &tset_[*it];
             if (!me->owner()->lock(*me, *this)) {
                 mark_abort_because(me, "commit lock");
                 goto abort;
@@ -411,44 +952,122 @@ bool Transaction::try_commit() {
 #endif
 
     //phase2
+    phase_t = PhaseProfile::lap(threadid_, ph_commit_lock, phase_t);
+    phase = ph_commit_check;
+    // The log record takes its epoch while every write is locked, so a
+    // transaction that depends on this one logs an epoch no older
+    if (TxnLog::enabled() && nwriteset) {
+        TxnLog::begin_txn();
+        logging_ = true;
+    }
+    if (exclusive_)
+        goto install;
+    TxnTrace::record(tr_check);
+check:
+#if STO_VALIDATE_PREFETCH
+    // keep the next window of read versions in flight while checking this one
+    pf_pos = pf_next = 0;
+    prefetch_versions(0, validate_prefetch);
+#endif
+#if STO_ACTIVE_LIST
+    for (unsigned tidx : alist_) {
+        it = &tset_[tidx];
+#else
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
-        it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
+        it = &tset_[tidx];
+#endif
+#if STO_VALIDATE_PREFETCH
+        if (pf_pos++ == pf_next && validate_prefetch) {
+            pf_next += validate_prefetch;
+            prefetch_versions(pf_next, validate_prefetch);
+        }
+#endif
         if (it->has_read() && (it->locked_at_commit() || !it->needs_unlock())) {
             TXP_INCREMENT(txp_total_check_read);
+#if STO_BATCH_COMMIT
+            readset[nreadset++] = tidx;
+#else
             if (!it->owner()->check(*it, *this)
                 && (!may_duplicate_items_ || !preceding_duplicate_read(it))) {
+                if (nrepair_steps_ && repair(tidx, writeset, nwriteset)) {
+                    new_validation_pass();
+                    goto check;
+                }
+                if (!in_progress())
+                    return false;
                 mark_abort_because(it, "commit check");
                 goto abort;
             }
+#endif
         }
     }
 
+#if STO_BATCH_COMMIT
+    group_by_owner(batch, readset, nreadset);
+    for (unsigned i = 0; i != nreadset; ) {
+        unsigned j = owner_run_end(batch, i, nreadset);
+        i += batch[i]->owner()->check_batch(batch + i, j - i, *this);
+        if (i != j) {
+            if (!may_duplicate_items_ || !preceding_duplicate_read(batch[i])) {
+                mark_abort_because(batch[i], "commit check");
+                goto abort;
+            }
+            ++i;
+        }
+    }
+#endif
+
     // fence();
 
     //phase3
+install:
+    phase_t = PhaseProfile::lap(threadid_, phase, phase_t);
+    phase = ph_commit_install;
+    TxnTrace::record(tr_install);
+    run_deferred_updates();
 #if STO_SORT_WRITESET
     for (unsigned tidx = first_write_; tidx != tset_size_; ++tidx) {
-        it = &tset_[tidx / tset_chunk][tidx % tset_chunk];
+        it = &tset_[tidx];
         if (it->has_write()) {
             TXP_INCREMENT(txp_total_w);
             it->owner()->install(*it, *this);
+            if (early_unlock)
+                unlock_installed(it);
         }
     }
+#elif STO_BATCH_COMMIT
+    // writeset is already grouped by owner
+    for (unsigned k = 0; k != nwriteset; ++k)
+        batch[k] = &tset_[writeset[k]];
+    for (unsigned i = 0; i != nwriteset; ) {
+        unsigned j = owner_run_end(batch, i, nwriteset);
+        TXP_ACCOUNT(txp_total_w, j - i);
+        batch[i]->owner()->install_batch(batch + i, j - i, *this);
+        if (early_unlock)
+            for (; i != j; ++i)
+                unlock_installed(batch[i]);
+        i = j;
+    }
 #else
     if (nwriteset) {
         auto writeset_end = writeset + nwriteset;
         for (auto idxit = writeset; idxit != writeset_end; ++idxit) {
-            if (likely(*idxit < tset_initial_capacity))
-                it = &tset0_[*idxit];
-            else
-                it = &tset_[*idxit / tset_chunk][*idxit % tset_chunk];
+            it = &tset_[*idxit];
             TXP_INCREMENT(txp_total_w);
             it->owner()->install(*it, *this);
+            if (early_unlock)
+                unlock_installed(it);
         }
     }
 #endif
 
+    if (logging_) {
+        TxnLog::end_txn();
+        logging_ = false;
+    }
+
     // fence();
+    PhaseProfile::lap(threadid_, ph_commit_install, phase_t);
     stop(true, writeset, nwriteset);
 
     //COZ_PROGRESS;
@@ -457,6 +1076,8 @@ bool Transaction::try_commit() {
 abort:
     //outfile.close();
     // fence();
+    PhaseProfile::lap(threadid_, phase, phase_t);
+    TxnTrace::record(phase == ph_commit_lock ? tr_lock_fail : tr_check_fail, conflict_object_);
     TXP_INCREMENT(txp_commit_time_aborts);
     // scan the whole read set for locks if aborting
     // XXX this can be optimized later
@@ -468,9 +1089,69 @@ abort:
     return false;
 }
 
+#if !STO_BATCH_COMMIT
+// Reruns the repair steps invalidated by the failed check of tset item
+// stale (see repair_step), all of whose writes are locked and listed in
+// writeset. Returns false if the commit must abort instead; a step that
+// aborts has already stopped the transaction.
+bool Transaction::repair(unsigned stale, const unsigned* writeset, unsigned nwriteset) {
+    unsigned s = 0;
+    while (s != nrepair_steps_ && (stale < repair_steps_[s].begin || stale >= repair_steps_[s].end))
+        ++s;
+    if (s == nrepair_steps_ || nrepairs_ == repair_limit)
+        return false;
+    ++nrepairs_;
+    TXP_INCREMENT(txp_repairs);
+
+    uint32_t rerun = uint32_t(1) << s;
+    for (unsigned i = s + 1; i != nrepair_steps_; ++i)
+        if (repair_steps_[i].deps & rerun)
+            rerun |= uint32_t(1) << i;
+    for (unsigned i = s; i != nrepair_steps_; ++i)
+        if (rerun & (uint32_t(1) << i))
+            for (unsigned tidx = repair_steps_[i].begin; tidx != repair_steps_[i].end; ++tidx) {
+                TransItem& item = tset_[tidx];
+                if (item.has_predicate() || item.has_commute())
+                    return false;
+                item.__rm_flags(TransItem::read_bit | TransItem::write_bit);
+            }
+
+    unsigned old_size = tset_size_;
+    for (unsigned i = s; i != nrepair_steps_; ++i)
+        if (rerun & (uint32_t(1) << i)) {
+            bool ok;
+            try {
+                ok = repair_steps_[i].run(repair_steps_[i].closure);
+            } catch (Abort&) {
+                ok = false;
+            }
+            if (!ok || !in_progress())
+                return false;
+        }
+
+    // The reruns may read new items, but the write set must not change
+    unsigned nwrites = 0;
+    for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
+        TransItem& item = tset_[tidx];
+        nwrites += item.has_write();
+        if (tidx >= old_size && item.has_predicate())
+            return false;
+    }
+    for (unsigned k = 0; k != nwriteset; ++k)
+        if (!tset_[writeset[k]].has_write())
+            return false;
+    return nwrites == nwriteset;
+}
+#endif
+
+void reportPerf() {
+    Transaction::print_stats();
+}
+
 void Transaction::print_stats() {
     txp_counters out = txp_counters_combined();
-    if (txp_count >= txp_max_set) {
+    // counters that were never enabled print nothing
+    if (txp_count >= txp_max_set && out.p(txp_total_starts)) {
         unsigned long long txc_total_starts = out.p(txp_total_starts);
         unsigned long long txc_total_aborts = out.p(txp_total_aborts);
         unsigned long long txc_commit_aborts = out.p(txp_commit_time_aborts);
@@ -478,10 +1159,26 @@ void Transaction::print_stats() {
         fprintf(stderr, "$ %llu allocs, %llu bytes\n", out.p(txp_alloc_t), out.p(txp_alloc_b));
         fprintf(stderr, "$ %llu starts, %llu max read set, %llu commits",
                 txc_total_starts, out.p(txp_max_set), txc_total_commits);
+        if (out.p(txp_htm_commits) || out.p(txp_htm_aborts))
+            fprintf(stderr, " (%llu in hardware; %llu hardware aborts, %llu loops fell back)",
+                    out.p(txp_htm_commits), out.p(txp_htm_aborts), out.p(txp_htm_fallbacks));
+        if (out.p(txp_batches))
+            fprintf(stderr, "\n$ %llu starts in %llu batches",
+                    out.p(txp_batched_starts), out.p(txp_batches));
+        if (out.p(txp_repairs))
+            fprintf(stderr, "\n$ %llu commit-time repairs", out.p(txp_repairs));
+        if (out.p(txp_rcu_handoffs) || rcu_backlog())
+            fprintf(stderr, "\n$ rcu: %zu callbacks pending (%zu handed off), %llu handed off, %llu run by helpers",
+                    rcu_backlog(), TRcuSet::orphan_backlog(),
+                    out.p(txp_rcu_handoffs), out.p(txp_rcu_helped));
         if (txc_total_aborts) {
             fprintf(stderr, ", %llu (%.3f%%) aborts",
                     out.p(txp_total_aborts),
                     100.0 * (double) out.p(txp_total_aborts) / out.p(txp_total_starts));
+            if (out.p(txp_low_aborts) || out.p(txp_high_aborts) || out.p(txp_budget_aborts))
+                fprintf(stderr, "\n$ aborts by priority: %llu low, %llu normal, %llu high; %llu loops out of budget",
+                        out.p(txp_low_aborts), out.p(txp_normal_aborts),
+                        out.p(txp_high_aborts), out.p(txp_budget_aborts));
             if (out.p(txp_commit_time_aborts)) {
                 fprintf(stderr, "\n$ %llu (%.3f%%) of aborts at commit time",
                         out.p(txp_commit_time_aborts),
@@ -523,13 +1220,19 @@ void Transaction::print_stats() {
                         out.p(txp_mvcc_check_aborts),
                         100.0 * (double) out.p(txp_mvcc_check_aborts) / out.p(txp_total_aborts));
             }
+
+            if (out.p(txp_mvcc_intent_aborts)) {
+                fprintf(stderr, "\n$ %llu (%.3f%%) of aborts due to MVCC write intents",
+                        out.p(txp_mvcc_intent_aborts),
+                        100.0 * (double) out.p(txp_mvcc_intent_aborts) / out.p(txp_total_aborts));
+            }
         }
         unsigned long long txc_commit_attempts = txc_total_starts - (txc_total_aborts - txc_commit_aborts);
         fprintf(stderr, "\n$ %llu commit attempts, %llu (%.3f%%) nonopaque\n",
                 txc_commit_attempts, out.p(txp_commit_time_nonopaque),
                 100.0 * (double) out.p(txp_commit_time_nonopaque) / txc_commit_attempts);
     }
-    if (txp_count >= txp_hco_abort)
+    if (txp_count >= txp_hco_abort && out.p(txp_tco))
         fprintf(stderr, "$ %llu HCO (%llu lock, %llu invalid, %llu aborts) out of %llu check attempts (%.3f%%)\n",
                 out.p(txp_hco), out.p(txp_hco_lock), out.p(txp_hco_invalid), out.p(txp_hco_abort), out.p(txp_tco),
                 100.0 * (double) out.p(txp_hco) / out.p(txp_tco));
@@ -537,6 +1240,11 @@ void Transaction::print_stats() {
         fprintf(stderr, "$ %llu (%.3f%%) hash collisions, %llu second level\n", out.p(txp_hash_collision),
                 100.0 * (double) out.p(txp_hash_collision) / out.p(txp_hash_find),
                 out.p(txp_hash_collision2));
+    if (txp_count >= txp_item_mru_hits && out.p(txp_item_mru_hits))
+        fprintf(stderr, "$ %llu lookups answered by the item cache\n", out.p(txp_item_mru_hits));
+    if (txp_count >= txp_hash_collision && out.p(txp_bv_hit))
+        fprintf(stderr, "$ %llu (%.3f%%) colliding lookups answered by the tset filter\n", out.p(txp_bv_hit),
+                100.0 * (double) out.p(txp_bv_hit) / out.p(txp_hash_collision));
     if (txp_count >= txp_total_transbuffer)
         fprintf(stderr, "$ %llu max buffer per txn, %llu total buffer\n",
                 out.p(txp_max_transbuffer), out.p(txp_total_transbuffer));
@@ -548,41 +1256,33 @@ void Transaction::print_stats() {
         fprintf(stderr, "$      Committing runs: %llu\n", out.p(txp_mvcc_flat_commits));
         fprintf(stderr, "$        Spinning runs: %llu\n", out.p(txp_mvcc_flat_spins));
         fprintf(stderr, "$     Avg spins/commit: %.3f\n", 1.0 * out.p(txp_mvcc_flat_spins) / out.p(txp_mvcc_flat_commits));
+        if (out.p(txp_mvcc_flat_bg_runs))
+            fprintf(stderr, "$    Background runs: %llu, avg %.0f cycles/run, max queue depth %llu\n",
+                    out.p(txp_mvcc_flat_bg_runs),
+                    1.0 * out.p(txp_mvcc_flat_bg_cycles) / out.p(txp_mvcc_flat_bg_runs),
+                    out.p(txp_mvcc_flat_bg_depth));
     }
-    if (txp_count >= txp_tpcc_st_aborts) {
-        fprintf(stderr, "$ TPCC txn profiles: commits(aborts), abort rate\n");
-        fprintf(stderr, "$     New-Order: %llu(%llu), %.3f%%\n", out.p(txp_tpcc_no_commits), out.p(txp_tpcc_no_aborts),
-                100.0 * (double) out.p(txp_tpcc_no_aborts) / (out.p(txp_tpcc_no_commits) + out.p(txp_tpcc_no_aborts)));
-        fprintf(stderr, "$       Payment: %llu(%llu), %.3f%%\n", out.p(txp_tpcc_pm_commits), out.p(txp_tpcc_pm_aborts),
-                100.0 * (double) out.p(txp_tpcc_pm_aborts) / (out.p(txp_tpcc_pm_commits) + out.p(txp_tpcc_pm_aborts)));
-        fprintf(stderr, "$  Order-Status: %llu(%llu), %.3f%%\n", out.p(txp_tpcc_os_commits), out.p(txp_tpcc_os_aborts),
-                100.0 * (double) out.p(txp_tpcc_os_aborts) / (out.p(txp_tpcc_os_commits) + out.p(txp_tpcc_os_aborts)));
-        fprintf(stderr, "$      Delivery: %llu(%llu), %.3f%%\n", out.p(txp_tpcc_dl_commits), out.p(txp_tpcc_dl_aborts),
-                100.0 * (double) out.p(txp_tpcc_dl_aborts) / (out.p(txp_tpcc_dl_commits) + out.p(txp_tpcc_dl_aborts)));
-        fprintf(stderr, "$   Stock-Level: %llu(%llu), %.3f%%\n", out.p(txp_tpcc_st_commits), out.p(txp_tpcc_st_aborts),
-                100.0 * (double) out.p(txp_tpcc_st_aborts) / (out.p(txp_tpcc_st_commits) + out.p(txp_tpcc_st_aborts)));
-//        fprintf(stderr, "$ NewOrder (stage 1): %llu\n", out.p(txp_tpcc_no_stage1));
-//        fprintf(stderr, "$ NewOrder (stage 2): %llu\n", out.p(txp_tpcc_no_stage2));
-//        fprintf(stderr, "$ NewOrder (stage 3): %llu\n", out.p(txp_tpcc_no_stage3));
-//        fprintf(stderr, "$ NewOrder (stage 4): %llu\n", out.p(txp_tpcc_no_stage4));
-//        fprintf(stderr, "$ NewOrder (stage 5): %llu\n", out.p(txp_tpcc_no_stage5));
-//        fprintf(stderr, "$ Payment  (stage 1): %llu\n", out.p(txp_tpcc_pm_stage1));
-//        fprintf(stderr, "$ Payment  (stage 2): %llu\n", out.p(txp_tpcc_pm_stage2));
-//        fprintf(stderr, "$ Payment  (stage 3): %llu\n", out.p(txp_tpcc_pm_stage3));
-//        fprintf(stderr, "$ Payment  (stage 4): %llu\n", out.p(txp_tpcc_pm_stage4));
-//        fprintf(stderr, "$ Payment  (stage 5): %llu\n", out.p(txp_tpcc_pm_stage5));
-//        fprintf(stderr, "$ Payment  (stage 6): %llu\n", out.p(txp_tpcc_pm_stage6));
-//        fprintf(stderr, "$ Delivery (stage 1): %llu\n", out.p(txp_tpcc_dl_stage1));
-//        fprintf(stderr, "$ Delivery (stage 2): %llu\n", out.p(txp_tpcc_dl_stage2));
-//        fprintf(stderr, "$ Delivery (stage 3): %llu\n", out.p(txp_tpcc_dl_stage3));
-//        fprintf(stderr, "$ Delivery (stage 4): %llu\n", out.p(txp_tpcc_dl_stage4));
-//        fprintf(stderr, "$ Delivery (stage 5): %llu\n", out.p(txp_tpcc_dl_stage5));
-        fprintf(stderr, "$       Lock Abort 1: %llu\n", out.p(txp_tpcc_lock_abort1));
-        fprintf(stderr, "$       Lock Abort 2: %llu\n", out.p(txp_tpcc_lock_abort2));
-        fprintf(stderr, "$       Lock Abort 3: %llu\n", out.p(txp_tpcc_lock_abort3));
-        fprintf(stderr, "$      Check Abort 1: %llu\n", out.p(txp_tpcc_check_abort1));
-        fprintf(stderr, "$      Check Abort 2: %llu\n", out.p(txp_tpcc_check_abort2));
-    }
+    if (txp_count >= txp_mvcc_pending_cycles && out.p(txp_mvcc_pending_waits))
+        fprintf(stderr, "$ %llu waits on pending MVCC versions, %llu yields, avg %.0f cycles/wait\n",
+                out.p(txp_mvcc_pending_waits), out.p(txp_mvcc_pending_yields),
+                1.0 * out.p(txp_mvcc_pending_cycles) / out.p(txp_mvcc_pending_waits));
+    for (unsigned c = 0; c != txp_registry::size(); ++c)
+        if (out.dyn(c))
+            fprintf(stderr, "$ %s: %llu\n", txp_registry::name(c), out.dyn(c));
+    ConflictProfile::report(stderr);
+    AbortProfile::report(stderr);
+    PmuProfile::report(stderr);
+    PhaseProfile::report(stderr);
+    LogReplica::report(stderr);
+    ServiceThreads::report(stderr);
+    AsyncIO::report(stderr);
+    if (TxnLog::shipped_bytes())
+        fprintf(stderr, "$ log shipping: %.1f MB shipped, %.1f MB sent\n",
+                TxnLog::shipped_bytes() / 1e6, TxnLog::sent_bytes() / 1e6);
+    if (TxnLog::compression() && TxnLog::logged_bytes())
+        fprintf(stderr, "$ log compression: %.1f MB logged, %.1f MB written (%.2fx)\n",
+                TxnLog::logged_bytes() / 1e6, TxnLog::written_bytes() / 1e6,
+                TxnLog::logged_bytes() / double(std::max(TxnLog::written_bytes(), uint64_t(1))));
 
 #if STO_TSC_PROFILE
     tc_counters out_tcs = tc_counters_combined();
@@ -599,7 +1299,82 @@ void Transaction::print_stats() {
     fprintf(stderr, "%s\n", ss.str().c_str());
 #endif
 
-    fprintf(stderr, "$ %llu next commit-tid\n", (unsigned long long) _TID.load(std::memory_order_relaxed));
+    if (epoch_cycle_max)
+        fprintf(stderr, "$ epoch cycle %u us (adaptive %u-%u us), %zu rcu callbacks pending\n",
+                us_per_epoch, epoch_cycle_min, epoch_cycle_max, rcu_backlog());
+    else
+        fprintf(stderr, "$ epoch cycle %u us, %zu rcu callbacks pending\n",
+                us_per_epoch, rcu_backlog());
+    if (epoch_tids_)
+        fprintf(stderr, "$ epoch commit-tids, floor %llu\n", (unsigned long long) tid_floor());
+    else
+        fprintf(stderr, "$ %llu next commit-tid\n", (unsigned long long) _TID.load(std::memory_order_relaxed));
+}
+
+void Transaction::print_stats_json(std::ostream& out) {
+    txp_counters tc = txp_counters_combined();
+    auto p = [&](int c) -> unsigned long long {
+        return c < txp_count ? tc.p(c) : 0;
+    };
+    out << "{\"profile_counters\": " << (profile_counters ? "true" : "false")
+        << ", \"starts\": " << p(txp_total_starts)
+        << ", \"commits\": " << p(txp_total_starts) - p(txp_total_aborts)
+        << ", \"aborts\": " << p(txp_total_aborts)
+        << ", \"batches\": " << p(txp_batches)
+        << ", \"batched_starts\": " << p(txp_batched_starts)
+        << ", \"repairs\": " << p(txp_repairs)
+        << ",\n  \"aborts_by_cause\": {\"commit_time\": " << p(txp_commit_time_aborts)
+        << ", \"lock_timeout\": " << p(txp_lock_aborts)
+        << ", \"observe_lock\": " << p(txp_observe_lock_aborts)
+        << ", \"mvcc_lock_status\": " << p(txp_mvcc_lock_status_aborts)
+        << ", \"mvcc_lock_visibility\": " << p(txp_mvcc_lock_vis_aborts)
+        << ", \"mvcc_lock_version_consistency\": " << p(txp_mvcc_lock_vc_aborts)
+        << ", \"mvcc_check\": " << p(txp_mvcc_check_aborts)
+        << ", \"mvcc_intent\": " << p(txp_mvcc_intent_aborts)
+        << ", \"out_of_budget\": " << p(txp_budget_aborts) << "}"
+        << ",\n  \"aborts_by_priority\": {\"low\": " << p(txp_low_aborts)
+        << ", \"normal\": " << p(txp_normal_aborts)
+        << ", \"high\": " << p(txp_high_aborts) << "}"
+        << ",\n  \"counters\": {";
+    for (unsigned c = 0; c != txp_registry::size(); ++c)
+        out << (c ? ", \"" : "\"") << txp_registry::name(c) << "\": " << tc.dyn(c);
+    out << "},\n  \"memory_bytes\": ";
+    if (STO_MEMORY_STATS) {
+        mem_counters mem = mem_counters_combined();
+        for (int c = 0; c != mem_count; ++c)
+            out << (c ? ", \"" : "{\"") << MemStats::name(c) << "\": " << mem.bytes(c);
+        out << "}";
+    } else
+        out << "null";
+    out << ",\n  \"replica\": ";
+    LogReplica::report_json(out);
+    out << ",\n  \"service_threads\": ";
+    ServiceThreads::report_json(out);
+    out << ",\n  \"async_io\": ";
+    AsyncIO::report_json(out);
+    out << ", \"rcu_backlog\": " << rcu_backlog() << "}";
+}
+
+MemStats::slot MemStats::slots_[MAX_THREADS];
+
+const char* MemStats::name(int c) {
+    static const char* names[] = {"tset", "transbuffer", "scratch", "rcu", "mvcc history", "index"};
+    static_assert(arraysize(names) == mem_count, "one name per counter");
+    return unsigned(c) < mem_count ? names[c] : "unknown";
+}
+
+void Transaction::print_memory_stats() {
+    if (!STO_MEMORY_STATS)
+        return;
+    mem_counters out = mem_counters_combined();
+    int64_t total = 0;
+    fprintf(stderr, "$ memory:");
+    for (int c = 0; c != mem_count; ++c) {
+        fprintf(stderr, "%s %s %.1f MB", c ? "," : "", MemStats::name(c),
+                (double) out.bytes(c) / (1 << 20));
+        total += out.bytes(c);
+    }
+    fprintf(stderr, "; %.1f MB total\n", (double) total / (1 << 20));
 }
 
 const char* Transaction::state_name(int state) {
@@ -614,7 +1389,7 @@ void Transaction::print(std::ostream& w) const {
     w << "T0x" << (void*) this << " " << state_name(state_) << " [";
     const TransItem* it = nullptr;
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
-        it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
+        it = &tset_[tidx];
         if (tidx)
             w << " ";
         it->owner()->print(w, *it);
@@ -652,27 +1427,57 @@ std::ostream& operator<<(std::ostream& w, const TransactionGuard& txn) {
     return w;
 }
 
+void Transaction::thread_leave(bool drain) {
+    int id = TThread::id();
+    threadinfo_t& thr = tinfo[id];
+    // 0 is ignored by the epoch scans
+    thr.epoch.store(0, std::memory_order_release);
+    thr.write_snapshot_epoch.store(0, std::memory_order_release);
+    thr.wtid.store(0, std::memory_order_release);
+    while (drain) {
+        thr.rcu_set.clean_until(global_epochs.active_epoch.load(std::memory_order_acquire));
+        if (thr.rcu_set.empty())
+            break;
+        usleep(std::max(us_per_epoch / 4, 1U));
+    }
+    thr.trans_start_callback = nullptr;
+    thr.trans_end_callback = nullptr;
+    thr.trans_done_callback = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(retired_mutex);
+        retired_p_.add(thr.p_);
+        retired_tcs_.add(thr.tcs_);
+    }
+    thr.p_.reset();
+    thr.tcs_.reset();
+    TThread::unregister_id(id);
+}
+
 void Transaction::rcu_release_all(std::thread& epoch_advancer, int num_work_threads) {
     Transaction::global_epochs.run = false;
     if (epoch_advancer.joinable()) {
         epoch_advancer.join();
     }
 
+    // Threads that left without draining (thread_leave) can leave
+    // callbacks in any slot, not just the first num_work_threads, so this
+    // cleans every slot in use
+    (void) num_work_threads;
     auto wse = global_epochs.global_epoch.load(std::memory_order_relaxed);
-    for (int i = 0; i < num_work_threads; ++i) {
-        wse = std::max(wse, Transaction::tinfo[i].write_snapshot_epoch.load(std::memory_order_relaxed));
+    for (auto& t : tinfo) {
+        wse = std::max(wse, t.write_snapshot_epoch.load(std::memory_order_relaxed));
     }
     assert(wse > global_epochs.active_epoch.load());
 
     bool more = true;
     while (more) {
-        more = false;
+        more = TRcuSet::run_orphans(~size_t(0)) != 0;
         auto ae = global_epochs.active_epoch.load();
         // XXX this would be safe to do in parallel too
-        for (int i = 0; i < num_work_threads; ++i) {
-            Transaction::tinfo[i].write_snapshot_epoch = wse;
-            Transaction::tinfo[i].rcu_set.clean_until(ae);
-            more = more || !Transaction::tinfo[i].rcu_set.empty();
+        for (auto& t : tinfo) {
+            t.write_snapshot_epoch = wse;
+            t.rcu_set.clean_until(ae);
+            more = more || !t.rcu_set.empty();
         }
         global_epochs.active_epoch.store(ae + 1);
         ++wse;
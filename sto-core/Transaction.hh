@@ -5,9 +5,21 @@
 #include "small_vector.hh"
 #include "TRcu.hh"
 #include "ContentionManager.hh"
+#include "PlatformFeatures.hh"
+#include "ConflictProfile.hh"
+#include "AbortProfile.hh"
+#include "PmuProfile.hh"
+#include "PhaseProfile.hh"
+#include "TxnTrace.hh"
+#include "TxnLog.hh"
 #include "TransScratch.hh"
 #include "VersionBase.hh"
+#if TSET_SIMD_SCAN
+#include "TSetScan.hh"
+#endif
+#include "TSetFilter.hh"
 #include <algorithm>
+#include <unordered_map>
 #include <functional>
 #include <memory>
 #include <type_traits>
@@ -16,16 +28,25 @@
 #include <sstream>
 #include <fstream>
 #include <atomic>
+#include <mutex>
 #include <thread>
 
 //#include <coz.h>
 
+// Profile counters. Level 0 and 1 counters (the first section of enum
+// txp) and registered workload counters are always compiled in, and are
+// counted while Transaction::set_profile_counters(true) is in effect;
+// levels >= 1 turn them on from the start. Level 2 compiles in the rest.
 #ifndef STO_PROFILE_COUNTERS
 #define STO_PROFILE_COUNTERS 0
 #endif
 #ifndef STO_TSC_PROFILE
 #define STO_TSC_PROFILE 0
 #endif
+// Default for Transaction::set_epoch_tids
+#ifndef STO_EPOCH_TIDS
+#define STO_EPOCH_TIDS 0
+#endif
 
 #ifndef BILLION
 #define BILLION 1000000000.0
@@ -33,10 +54,6 @@
 #error "BILLION already defined!"
 #endif
 
-#ifndef PROC_TSC_FREQ
-#define PROC_TSC_FREQ 2.2 // Default processor base freq in GHz
-#endif
-
 #ifndef STO_DEBUG_HASH_COLLISIONS
 #define STO_DEBUG_HASH_COLLISIONS 0
 #endif
@@ -79,6 +96,12 @@
 #endif
 #endif
 
+// log2 of the commit-lock spin limit under sorted locking. Cross-object
+// cycles can't form; this only breaks cycles among one object's items.
+#ifndef STO_SPIN_BOUND_SORTED
+#define STO_SPIN_BOUND_SORTED 16
+#endif
+
 #ifndef STO_SPIN_BOUND_WAIT
 #if STO_SPIN_EXPBACKOFF
 #define STO_SPIN_BOUND_WAIT 18
@@ -91,6 +114,77 @@
 #define CONTENTION_REGULATION 1
 #endif
 
+#ifndef TSET_SIMD_SCAN
+#define TSET_SIMD_SCAN 0
+#endif
+
+#ifndef STO_ACTIVE_LIST
+#define STO_ACTIVE_LIST 0
+#endif
+
+// Items a transaction looked up most recently, checked before the tset
+// hashtable; 0 disables the cache
+#ifndef STO_ITEM_MRU
+#define STO_ITEM_MRU 4
+#endif
+
+#if STO_ACTIVE_LIST && STO_SORT_WRITESET
+#error "STO_ACTIVE_LIST does not support STO_SORT_WRITESET!"
+#endif
+
+#ifndef STO_BATCH_COMMIT
+#define STO_BATCH_COMMIT 0
+#endif
+
+#if STO_BATCH_COMMIT && STO_SORT_WRITESET
+#error "STO_BATCH_COMMIT does not support STO_SORT_WRITESET!"
+#endif
+
+// Default number of reads whose versions are prefetched ahead of commit
+// validation; 0 compiles the prefetching out
+#ifndef STO_VALIDATE_PREFETCH
+#define STO_VALIDATE_PREFETCH 0
+#endif
+
+// 1: allocate Transaction objects and tset chunks on the calling thread's
+// NUMA node (needs libnuma and discover_topology()); 2: also report any
+// allocation that ends up on a remote node
+#ifndef STO_NUMA_ALLOC
+#define STO_NUMA_ALLOC 0
+#endif
+
+// Most rcu callbacks Transaction::start() runs inline; fully expired work
+// beyond that is handed to Transaction::rcu_help() callers (idle threads,
+// rcu_reclaimer). 0 runs everything inline.
+#ifndef STO_RCU_BUDGET
+#define STO_RCU_BUDGET 0
+#endif
+
+// 1: transaction loops first run small transactions as RTM hardware
+// transactions (if the CPU has RTM), falling back to the software commit
+#ifndef STO_HTM
+#define STO_HTM 0
+#endif
+
+// Hardware attempts per transaction loop before running in software
+#ifndef STO_HTM_ATTEMPTS
+#define STO_HTM_ATTEMPTS 3
+#endif
+
+// Largest tracking set committed in hardware
+#ifndef STO_HTM_MAX_ITEMS
+#define STO_HTM_MAX_ITEMS 4
+#endif
+
+#if STO_HTM
+#include <immintrin.h>
+#include "PlatformFeatures.hh"
+#endif
+
+#if CICADA_HASHTABLE && ADAPTIVE_HASHTABLE
+#error "CICADA_HASHTABLE and ADAPTIVE_HASHTABLE can't be enabled at the same time!"
+#endif
+
 #if TPCC_SPLIT_TABLE
 #if TABLE_FINE_GRAINED
 #error "Split table and fine-grained table can't be enabled at the same time!"
@@ -100,7 +194,9 @@
 #define CONSISTENCY_CHECK 0
 #define ASSERT_TX_SIZE 0
 #define TRANSACTION_HASHTABLE 1
-//#define TRANSACTION_FILTER 0
+#ifndef TRANSACTION_FILTER
+#define TRANSACTION_FILTER 1
+#endif
 
 #if ASSERT_TX_SIZE
 #if STO_PROFILE_COUNTERS > 1
@@ -133,6 +229,29 @@
             __txn_guard.start();                  \
             Sto::mvcc_rw_upgrade();
 
+// Read-only transaction: OCC reads via ro_observe are tracked outside the
+// tset, MVCC reads use the read snapshot without recording items
+#define ROTRANSACTION                             \
+    do {                                          \
+        __label__ abort_in_progress;              \
+        __label__ try_commit;                     \
+        __label__ after_commit;                   \
+        TransactionLoopGuard __txn_guard;         \
+        while (1) {                               \
+            __txn_guard.start_readonly();
+
+// Transaction that runs under MVCC snapshot isolation when si is true
+#define SITRANSACTION(si)                         \
+    do {                                          \
+        __label__ abort_in_progress;              \
+        __label__ try_commit;                     \
+        __label__ after_commit;                   \
+        TransactionLoopGuard __txn_guard;         \
+        while (1) {                               \
+            __txn_guard.start();                  \
+            if (si)                               \
+                Sto::set_snapshot_isolation(true);
+
 #define RETRY(retry)                              \
             goto try_commit;                      \
 abort_in_progress:                                \
@@ -142,7 +261,7 @@ try_commit:                                       \
             if (__txn_guard.try_commit())         \
                 break;                            \
 after_commit:                                     \
-            if (!(retry)) {                       \
+            if (!(retry) || !__txn_guard.may_retry()) { \
                 break;                            \
             }                                     \
         }                                         \
@@ -168,6 +287,13 @@ if (!(trans_op))             \
             Sto::mvcc_rw_upgrade();               \
             try {
 
+#define ROTRANSACTION_E                           \
+    do {                                          \
+        TransactionLoopGuard __txn_guard;         \
+        while (1) {                               \
+            __txn_guard.start_readonly();         \
+            try {
+
 #define RETRY_E(retry)                            \
                 if (__txn_guard.try_commit())     \
                     break;                        \
@@ -176,7 +302,7 @@ if (!(trans_op))             \
             } catch (Transaction::Abort e) {      \
                 __txn_guard.silent_abort();       \
             }                                     \
-            if (!(retry))                         \
+            if (!(retry) || !__txn_guard.may_retry()) \
                 throw Transaction::Abort();       \
         }                                         \
     } while (false)
@@ -184,11 +310,21 @@ if (!(trans_op))             \
 #define TXN_DO_E(trans_op)      \
 if (!(trans_op)) {throw Transaction::Abort();}
 
+// For helpers that run part of a transaction and return false when it must
+// abort: the caller passes that on with TXN_DO or CHK, so an abort costs a
+// branch at each level rather than an unwind
+#define TXN_CHECK(trans_op)                 \
+if (!(trans_op)) {                          \
+    Sto::transaction()->silent_abort();     \
+    return false;                           \
+}
+
 
 #if STO_USE_EXCEPTION
 
 #define TXN   TRANSACTION_E
 #define RWTXN RWTRANSACTION_E
+#define TXN_RO ROTRANSACTION_E
 #define CHK   TXN_DO_E
 #define TEND  RETRY_E
 
@@ -196,6 +332,7 @@ if (!(trans_op)) {throw Transaction::Abort();}
 
 #define TXN   TRANSACTION
 #define RWTXN RWTRANSACTION
+#define TXN_RO ROTRANSACTION
 #define CHK   TXN_DO
 #define TEND  RETRY
 
@@ -203,7 +340,7 @@ if (!(trans_op)) {throw Transaction::Abort();}
 
 // transaction performance counters
 enum txp {
-    // all logging levels
+    // all logging levels (counted when enabled at run time)
     txp_total_aborts = 0,
     txp_total_starts,
     txp_commit_time_nonopaque,
@@ -219,6 +356,12 @@ enum txp {
     txp_cm_onrollback,
     txp_cm_onwrite,
     txp_cm_start,
+    txp_cm_queued,
+    txp_cm_waits,
+    txp_low_aborts,
+    txp_normal_aborts,
+    txp_high_aborts,
+    txp_budget_aborts,
     txp_allocate,
     txp_bv_hit,
     txp_tco,
@@ -230,42 +373,24 @@ enum txp {
     txp_mvcc_lock_vc_aborts,
     txp_mvcc_lock_vis_aborts,
     txp_mvcc_check_aborts,
+    txp_mvcc_intent_aborts,
+    txp_htm_commits,
+    txp_htm_aborts,
+    txp_htm_fallbacks,
+    txp_batches,            // begin_batch()
+    txp_batched_starts,
+    txp_repairs,
     // STO_PROFILE_COUNTERS > 1 only
     txp_mvcc_flat_runs,
     txp_mvcc_flat_versions,
     txp_mvcc_flat_commits,
     txp_mvcc_flat_spins,
-    txp_tpcc_no_aborts,
-    txp_tpcc_no_commits,
-    txp_tpcc_no_stage1,
-    txp_tpcc_no_stage2,
-    txp_tpcc_no_stage3,
-    txp_tpcc_no_stage4,
-    txp_tpcc_no_stage5,
-    txp_tpcc_pm_aborts,
-    txp_tpcc_pm_commits,
-    txp_tpcc_pm_stage1,
-    txp_tpcc_pm_stage2,
-    txp_tpcc_pm_stage3,
-    txp_tpcc_pm_stage4,
-    txp_tpcc_pm_stage5,
-    txp_tpcc_pm_stage6,
-    txp_tpcc_os_aborts,
-    txp_tpcc_os_commits,
-    txp_tpcc_dl_stage1,
-    txp_tpcc_dl_stage2,
-    txp_tpcc_dl_stage3,
-    txp_tpcc_dl_stage4,
-    txp_tpcc_dl_stage5,
-    txp_tpcc_dl_aborts,
-    txp_tpcc_dl_commits,
-    txp_tpcc_st_aborts,
-    txp_tpcc_st_commits,
-    txp_tpcc_lock_abort1,
-    txp_tpcc_lock_abort2,
-    txp_tpcc_lock_abort3,
-    txp_tpcc_check_abort1,
-    txp_tpcc_check_abort2,
+    txp_mvcc_flat_bg_runs,  // MVCC_BG_FLATTEN
+    txp_mvcc_flat_bg_cycles,
+    txp_mvcc_flat_bg_depth,
+    txp_mvcc_pending_waits,
+    txp_mvcc_pending_yields,
+    txp_mvcc_pending_cycles,
     txp_total_n,
     txp_total_r,
     txp_total_adaptive_opt,
@@ -279,6 +404,7 @@ enum txp {
     txp_hash_find,
     txp_hash_collision,
     txp_hash_collision2,
+    txp_item_mru_hits,
     txp_total_searched,
     txp_rcu_del_req,
     txp_rcu_del_impl,
@@ -286,6 +412,8 @@ enum txp {
     txp_rcu_delarr_impl,
     txp_rcu_free_req,
     txp_rcu_free_impl,
+    txp_rcu_handoffs,
+    txp_rcu_helped,
     txp_dealloc_performed,
     txp_rtid_atomic,
     txp_mvcc_bad_versions,
@@ -293,18 +421,39 @@ enum txp {
     txp_total_sum,
     txp_gc_inserts,
     txp_gc_deletes,
-#if !STO_PROFILE_COUNTERS
-    txp_count = 0
-#elif STO_PROFILE_COUNTERS == 1
-    txp_count = txp_hco_abort + 1
+#if STO_PROFILE_COUNTERS <= 1
+    txp_count = txp_repairs + 1
 #else
     txp_count
 #endif
 };
 typedef uint64_t txp_counter_type;
 
+// Workload-specific counters, registered by name at startup instead of
+// being listed in enum txp. add() returns a slot in every thread's
+// txp_counters; registering a name twice returns the same slot. Account
+// with TXP_DYN_INCREMENT/TXP_DYN_ACCOUNT. Counts are sums.
+class txp_registry {
+public:
+    static constexpr unsigned max_counters = 64;
+
+    static unsigned add(const char* name);
+    static unsigned size() {
+        return size_.load(std::memory_order_acquire);
+    }
+    static const char* name(unsigned c) {
+        return names_[c];
+    }
+
+private:
+    static std::mutex mutex_;
+    static std::atomic<unsigned> size_;
+    static const char* names_[max_counters];
+};
+
 inline constexpr bool txp_is_max(unsigned p) {
-    return p == txp_max_set || p == txp_max_transbuffer;
+    return p == txp_max_set || p == txp_max_transbuffer
+        || p == txp_mvcc_flat_bg_depth;
 }
 
 template <unsigned P, unsigned N, bool Less = (P < N)> struct txp_helper;
@@ -327,18 +476,36 @@ template <unsigned P, unsigned N> struct txp_helper<P, N, false> {
     }
 };
 
-struct txp_counters {
+// Written only by the owning thread, with plain adds; on its own cache
+// lines so that counting does not disturb the epoch fields other threads
+// poll in threadinfo_t.
+struct alignas(CACHE_LINE_SIZE) txp_counters {
     txp_counter_type p_[txp_count];
+    txp_counter_type dyn_[txp_registry::max_counters];
     txp_counters() {
-        for (unsigned i = 0; i != txp_count; ++i)
-            p_[i] = 0;
+        reset();
     }
     unsigned long long p(int p) {
         return txp_helper<0, txp_count>::counter_exists(p) ? p_[p] : 0;
     }
+    unsigned long long dyn(unsigned c) {
+        return dyn_[c];
+    }
     void reset() {
         for (int i = 0; i != txp_count; ++i)
             p_[i] = 0;
+        for (unsigned i = 0; i != txp_registry::max_counters; ++i)
+            dyn_[i] = 0;
+    }
+    void add(const txp_counters& x) {
+        for (int p = 0; p != txp_count; ++p) {
+            if (txp_is_max(p))
+                p_[p] = std::max(p_[p], x.p_[p]);
+            else
+                p_[p] += x.p_[p];
+        }
+        for (unsigned c = 0; c != txp_registry::max_counters; ++c)
+            dyn_[c] += x.dyn_[c];
     }
 };
 
@@ -382,12 +549,16 @@ struct tc_counters {
         return tc_helper<0, tc_count>::counter_exists(name) ? tcs_[name] : 0;
     }
     double to_realtime(int name) {
-        return (double)timing_counter(name) / BILLION / PROC_TSC_FREQ;
+        return (double)timing_counter(name) / BILLION / tsc_frequency();
     }
     void reset() {
         for (int i = 0; i < tc_count; ++i)
             tcs_[i] = 0;
     }
+    void add(const tc_counters& x) {
+        for (int i = 0; i < tc_count; ++i)
+            tcs_[i] += x.tcs_[i];
+    }
 };
 
 #include "Interface.hh"
@@ -402,21 +573,79 @@ struct __attribute__((aligned(128))) threadinfo_t {
     std::atomic<epoch_type> write_snapshot_epoch;
     std::atomic<epoch_type> epoch;
     std::atomic<tid_type> wtid;
+    tid_type last_tid = 0;  // with epoch TIDs, the thread's last commit TID
     TRcuSet rcu_set;
     // XXX(NH): these should be vectors so multiple data structures can register
     // callbacks for these
     std::function<void(void)> trans_start_callback;
     std::function<void(void)> trans_end_callback;
+    // called after trans_end_callback with whether the transaction committed
+    std::function<void(bool)> trans_done_callback;
     txp_counters p_;
     tc_counters tcs_;
+    CMInfo cm;
     threadinfo_t() {
     }
 };
 
+// Per-thread threadinfo_t slots, allocated on first access. A slot gets its
+// own freshly mapped pages, so when the owning thread claims it (see
+// Transaction::initialize) first touch places it on that thread's NUMA node.
+// Iteration skips slots that were never allocated.
+class threadinfo_table {
+public:
+    threadinfo_t& operator[](int i) {
+        threadinfo_t* t = slots_[i].load(std::memory_order_acquire);
+        return t ? *t : allocate(i);
+    }
+    // Thread i's slot, or nullptr if it was never allocated
+    threadinfo_t* find(int i) const {
+        return slots_[i].load(std::memory_order_acquire);
+    }
+
+    class iterator {
+    public:
+        iterator(std::atomic<threadinfo_t*>* p, std::atomic<threadinfo_t*>* e)
+            : p_(p), e_(e) {
+            skip();
+        }
+        threadinfo_t& operator*() const {
+            return *p_->load(std::memory_order_acquire);
+        }
+        iterator& operator++() {
+            ++p_;
+            skip();
+            return *this;
+        }
+        bool operator!=(const iterator& x) const {
+            return p_ != x.p_;
+        }
+    private:
+        std::atomic<threadinfo_t*>* p_;
+        std::atomic<threadinfo_t*>* e_;
+        void skip() {
+            while (p_ != e_ && !p_->load(std::memory_order_relaxed))
+                ++p_;
+        }
+    };
+    iterator begin() {
+        return iterator(slots_, slots_ + MAX_THREADS);
+    }
+    iterator end() {
+        return iterator(slots_ + MAX_THREADS, slots_ + MAX_THREADS);
+    }
+
+private:
+    std::atomic<threadinfo_t*> slots_[MAX_THREADS];
+
+    threadinfo_t& allocate(int i);
+};
+
 template <int T, bool tmp_stats=false>
 class TimeKeeper {
 public:
-    TimeKeeper() {
+    TimeKeeper()
+        : pmu_(T) {
         init_tsc = read_tsc();
     }
     ~TimeKeeper() {
@@ -432,6 +661,7 @@ public:
 
 private:
     tc_counter_type init_tsc;
+    PmuProfile::scope pmu_;
 
     inline void sync_thread_counter();
     inline void sync_thread_counter_tmp();
@@ -445,18 +675,29 @@ private:
 template <typename VersImpl>
 class TicTocBase;
 
+// Cicada-style item index: root buckets of AccessBucketSize tset indexes,
+// chained into overflow buckets as they fill. The root count is a power of
+// two chosen at clear() from a decaying maximum of recent tset sizes, so
+// roots stay about half full; overflow buckets are only for transactions
+// much larger than the recent ones.
 class CicadaHashtable {
 public:
     static constexpr uint16_t AccessBucketSize = 6;
-    static constexpr uint16_t AccessBucketRootCount = 257;
+    static constexpr uint16_t MinRootCount = 64;
+    static constexpr uint16_t MaxRootCount = 8192;
     static constexpr uint16_t EmptyBucketID = static_cast<uint16_t>(-1);
 
     explicit CicadaHashtable(Transaction& t)
-        : txn_(t), access_bucket_count_(0), access_buckets_(AccessBucketRootCount) {}
+        : txn_(t), access_bucket_count_(0), root_mask_(MinRootCount - 1),
+          recent_size_(0), access_buckets_(MinRootCount) {}
 
     inline TransItem* find(TObject* owner, void* key) const;
     inline void put(TObject* owner, void* key, uint32_t idx);
-    void clear() { access_bucket_count_ = 0; }
+    inline void clear(unsigned last_size);
+
+    uint16_t root_count() const {
+        return root_mask_ + 1;
+    }
 
 private:
     struct AccessBucket {
@@ -465,17 +706,84 @@ private:
         uint32_t idx[AccessBucketSize];
     } __attribute__((aligned(64)));
 
-    static inline uint16_t hash_(TObject* owner, void* key) {
-        return static_cast<uint16_t>(
-            (reinterpret_cast<uintptr_t>(owner) / 64 + reinterpret_cast<uintptr_t>(key)) % AccessBucketRootCount
-        );
+    inline uint16_t hash_(TObject* owner, void* key) const {
+        uint64_t h = (reinterpret_cast<uintptr_t>(owner) >> 4) ^ reinterpret_cast<uintptr_t>(key);
+        h *= 0x9E3779B97F4A7C15ULL;
+        return static_cast<uint16_t>(h >> 32) & root_mask_;
     }
+    inline void init_roots() const;
 
     Transaction& txn_;
     mutable uint16_t access_bucket_count_;
+    uint16_t root_mask_;
+    unsigned recent_size_;
     mutable std::vector<AccessBucket> access_buckets_;
 };
 
+// Open-addressing item index sized to the tracking set. A slot holds
+// base_ + tset index + 1; any value <= base_ is empty, so clear() only
+// advances base_. Capacity doubles to keep the load factor under 1/2 and
+// halves again after a run of transactions much smaller than the table.
+class AdaptiveHashtable {
+public:
+    static constexpr uint32_t initial_capacity = 32; // 128 bytes of slots
+    static constexpr unsigned shrink_after = 64;
+
+    explicit AdaptiveHashtable(Transaction& t)
+        : txn_(t), slots_(new uint32_t[initial_capacity]()),
+          mask_(initial_capacity - 1), base_(0), nsmall_(0) {}
+    ~AdaptiveHashtable() {
+        delete[] slots_;
+    }
+
+    inline TransItem* find(TObject* owner, void* key) const;
+    inline void put(TObject* owner, void* key, uint32_t idx);
+    inline void clear(unsigned last_size);
+    // Empties the table and indexes the transaction's first nitems items
+    void rebuild(unsigned nitems);
+
+    uint32_t capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+    static inline uint32_t hash_(TObject* owner, void* key, uint32_t mask) {
+        uint64_t h = (reinterpret_cast<uintptr_t>(owner) >> 4) ^ reinterpret_cast<uintptr_t>(key);
+        h *= 0x9E3779B97F4A7C15ULL;
+        return static_cast<uint32_t>(h >> 32) & mask;
+    }
+    void insert_(TObject* owner, void* key, uint32_t idx) {
+        uint32_t hi = hash_(owner, key, mask_);
+        while (slots_[hi] > base_)
+            hi = (hi + 1) & mask_;
+        slots_[hi] = base_ + idx + 1;
+    }
+    void resize(uint32_t capacity, unsigned nitems);
+
+    Transaction& txn_;
+    uint32_t* slots_;
+    uint32_t mask_;
+    uint32_t base_;
+    unsigned nsmall_;
+};
+
+// Scheduling metadata for one TransactionLoopGuard loop (all its retries);
+// see Sto::set_options. The contention manager lets a higher priority class
+// win conflicts. A loop whose budget (retries or deadline) is used up stops
+// retrying, and past the deadline lock waits and backoffs give up early.
+struct TransactionOptions {
+    enum priority_type : uint8_t {
+        prio_low = 0, prio_normal, prio_high
+    };
+    priority_type priority = prio_normal;
+    unsigned max_retries = 0;  // 0: no limit
+    uint64_t deadline = 0;     // read_tsc() value; 0: none
+
+    bool past_deadline() const {
+        return deadline && read_tsc() >= deadline;
+    }
+};
+
 class Transaction {
 public:
     typedef TransactionTid::type tid_type;
@@ -489,51 +797,112 @@ public:
     using epoch_type = TRcuSet::epoch_type;
     using signed_epoch_type = TRcuSet::signed_epoch_type;
 
-    static threadinfo_t tinfo[MAX_THREADS];
+    static threadinfo_table tinfo;
     static struct epoch_state {
         std::atomic<epoch_type> global_epoch; // != 0
         std::atomic<epoch_type> read_epoch;   // minimum global_epoch
         std::atomic<epoch_type> active_epoch; // no thread is before this epoch
+        std::atomic<epoch_type> durable_epoch; // TxnLog has every commit up to this
         tid_type recent_tid;
         bool run;
+        std::atomic<uint64_t> epoch_tsc;  // read_tsc() when global_epoch last moved
     } global_epochs;
+
+    // Registered snapshots (pin_snapshot); each holds back active_epoch
+    static constexpr int max_snapshot_pins = 8;
+    static std::atomic<epoch_type> snapshot_pins[max_snapshot_pins];
+    // Set by hold_read_tid; caps _RTID while nonzero
+    static std::atomic<tid_type> read_tid_hold;
 private:
     static std::atomic<tid_type> _TID;
     static std::atomic<tid_type> _RTID;
+    // counters of threads that left (thread_leave)
+    static txp_counters retired_p_;
+    static tc_counters retired_tcs_;
     static unsigned us_per_epoch;  // Defaults to 100ms
+    static unsigned epoch_cycle_min;  // adaptive bounds; max 0 = fixed cycle
+    static unsigned epoch_cycle_max;
+    static size_t epoch_backlog_target;
+    static bool readonly_fast_path;
+    static bool profile_counters;
+    static bool sorted_locking_default;
+    static bool early_unlock;
+    static void (*commit_observer_)(const TransItem* items, unsigned n);
+    static unsigned opacity_extension_limit;
+    static unsigned repair_limit;
+    static bool epoch_tids_;
+#if STO_VALIDATE_PREFETCH
+    static unsigned validate_prefetch; // prefetch distance; 0 disables
+#endif
+
+    // Epoch TID layout, above the version flag bits:
+    // |--EPOCH--|--TICKS--|--THREAD ID--|
+    //   33 bits   12 bits   W bits
+    static constexpr int epoch_tid_tick_bits = 12;
+    static constexpr uint64_t epoch_tid_max_ticks = (uint64_t(1) << epoch_tid_tick_bits) - 1;
+    static constexpr int epoch_tid_tsc_shift = 10;
+    // between one thread's successive TIDs, which keeps the thread id
+    static constexpr tid_type epoch_tid_step = TransactionTid::increment_value << TransactionTid::mask_width;
+    static tid_type epoch_tid(epoch_type e, uint64_t ticks, int threadid) {
+        tid_type seq = (tid_type(e) << epoch_tid_tick_bits) | std::min(ticks, epoch_tid_max_ticks);
+        return ((seq << TransactionTid::mask_width) | tid_type(threadid)) * TransactionTid::increment_value;
+    }
+    // No commit that starts from now on gets a lower TID
+    static tid_type tid_floor() {
+        if (epoch_tids_)
+            return epoch_tid(global_epochs.global_epoch.load(std::memory_order_acquire), 0, 0);
+        return _TID.load(std::memory_order_relaxed);
+    }
+    // Every version at or below this TID committed before now
+    static tid_type opacity_tid() {
+        if (epoch_tids_)
+            return _RTID.load(std::memory_order_acquire);
+        return _TID.load(std::memory_order_relaxed);
+    }
 public:
 
     static std::function<void(threadinfo_t::epoch_type)> epoch_advance_callback;
 
     static txp_counters txp_counters_combined() {
-        txp_counters out;
-        for (int i = 0; i != MAX_THREADS; ++i)
-            for (int p = 0; p != txp_count; ++p) {
-                if (txp_is_max(p))
-                    out.p_[p] = std::max(out.p_[p], tinfo[i].p_.p_[p]);
-                else
-                    out.p_[p] += tinfo[i].p_.p_[p];
-            }
+        txp_counters out = retired_p_;
+        for (auto& t : tinfo)
+            out.add(t.p_);
         return out;
     }
 
     static tc_counters tc_counters_combined() {
-        tc_counters ret;
-        for (int i = 0; i < MAX_THREADS; ++i) {
-            for (int t = 0; t < tc_count; ++t) {
-                ret.tcs_[t] += tinfo[i].tcs_.tcs_[t];
-            }
-        }
+        tc_counters ret = retired_tcs_;
+        for (auto& t : tinfo)
+            ret.add(t.tcs_);
         return ret;
     }
 
+    static mem_counters mem_counters_combined() {
+        mem_counters out;
+        for (int i = 0; i != MAX_THREADS; ++i)
+            for (int c = 0; c != mem_count; ++c)
+                out.bytes_[c] += MemStats::thread_bytes(i, c);
+        return out;
+    }
+
     static void print_stats();
+    // The counters print_stats reports, and the memory stats, as one JSON
+    // object; counters that weren't enabled read 0
+    static void print_stats_json(std::ostream& out);
+    // Bytes held by each internal structure (see MemStats.hh)
+    static void print_memory_stats();
 
     static void clear_stats() {
-        for (int i = 0; i != MAX_THREADS; ++i) {
-            tinfo[i].p_.reset();
-            tinfo[i].tcs_.reset();
+        for (auto& t : tinfo) {
+            t.p_.reset();
+            t.tcs_.reset();
         }
+        retired_p_.reset();
+        retired_tcs_.reset();
+        ConflictProfile::clear();
+        AbortProfile::clear();
+        PmuProfile::clear();
+        PhaseProfile::clear();
     }
 
     template <typename T>
@@ -560,6 +929,50 @@ public:
     static void* epoch_advancer(void*);
     static void epoch_advance_once();
     static void global_epoch_advance_once();
+    static void adapt_epoch_cycle();
+
+    // Pending rcu callbacks over all registered threads, including
+    // handed-off ones (approximate while threads register)
+    static size_t rcu_backlog() {
+        size_t n = TRcuSet::orphan_backlog();
+        TThread::for_each_active([&] (int id) {
+            n += tinfo[id].rcu_set.backlog();
+        });
+        return n;
+    }
+
+    // Pin a read snapshot outside any transaction. Sets tid to a read tid
+    // whose versions stay reachable (GC is held back) until the returned
+    // slot is passed to unpin_snapshot.
+    static int pin_snapshot(tid_type& tid) {
+        auto e = global_epochs.read_epoch.load(std::memory_order_acquire);
+        for (int i = 0; i != max_snapshot_pins; ++i) {
+            epoch_type expected = 0;
+            if (snapshot_pins[i].compare_exchange_strong(expected, e)) {
+                fence();
+                epoch_advance_once();
+                tid = _RTID;
+                return i;
+            }
+        }
+        always_assert(false, "too many snapshot pins");
+        return -1;
+    }
+    static void unpin_snapshot(int slot) {
+        assert(slot >= 0 && slot < max_snapshot_pins && snapshot_pins[slot]);
+        snapshot_pins[slot].store(0, std::memory_order_release);
+    }
+    // Keep new read snapshots (_RTID) below every tid allocated from now
+    // until release_read_tid(), so that what commits meanwhile becomes
+    // visible to snapshot reads all at once. One holder at a time; used
+    // by LogReplica to apply each epoch atomically.
+    static void hold_read_tid() {
+        assert(!read_tid_hold.load(std::memory_order_relaxed));
+        read_tid_hold.store(tid_floor(), std::memory_order_seq_cst);
+    }
+    static void release_read_tid() {
+        read_tid_hold.store(0, std::memory_order_release);
+    }
     template <typename T>
     static void rcu_delete(T* x) {
         auto& thr = this_thread();
@@ -575,31 +988,63 @@ public:
     static void rcu_free(void* ptr) {
         auto& thr = this_thread();
         txp_account<txp_rcu_free_req>(1);
-        thr.rcu_set.add(thr.write_snapshot_epoch, rcu_free_cb, ptr);
+        thr.rcu_set.add<rcu_free_cb>(thr.write_snapshot_epoch, ptr);
     }
     static void rcu_call(TRcuSet::callback_type function, void* argument) {
         auto& thr = this_thread();
         thr.rcu_set.add(thr.write_snapshot_epoch, function, argument);
     }
+    // Same, for a callback known at compile time: calls with the same F are
+    // stored compactly and run in bulk. argument must be even.
+    template <TRcuSet::callback_type F>
+    static void rcu_call(void* argument) {
+        auto& thr = this_thread();
+        thr.rcu_set.add<F>(thr.write_snapshot_epoch, argument);
+    }
 
     static void rcu_release_all(std::thread& epoch_advancer, int nworkth);
 
-#if STO_PROFILE_COUNTERS
+    // For a thread that leaves while others keep running (Sto::thread_leave).
+    // Stops the thread holding back epochs and the read TID, folds its
+    // counters into the retired totals, clears its callbacks, and
+    // unregisters its id. With drain, first waits until the epoch advancer
+    // has moved active_epoch past the thread's rcu callbacks and they have
+    // run. Otherwise they stay with the id, for its next owner or
+    // rcu_release_all to run.
+    static void thread_leave(bool drain);
+
+    // Runs up to about limit rcu callbacks handed off by bounded cleaning
+    // (STO_RCU_BUDGET). For idle threads; call outside a transaction.
+    static size_t rcu_help(size_t limit);
+    // Dedicated reclaimer thread body: helps until global_epochs.run
+    // is cleared. thread_id must be unused by workers.
+    static void rcu_reclaimer(int thread_id);
+
+    // Counting costs a predictable branch while disabled
+    static void set_profile_counters(bool enabled) {
+        profile_counters = enabled;
+    }
+    static bool profile_counters_enabled() {
+        return profile_counters;
+    }
+
     template <unsigned P> static void txp_account(txp_counter_type n) {
-        txp_helper<P, txp_count>::account_array(tinfo[TThread::id()].p_.p_, n);
+        if (P < txp_count && profile_counters)
+            txp_helper<P, txp_count>::account_array(tinfo[TThread::id()].p_.p_, n);
     }
     template <unsigned P> static txp_counter_type txp_inspect() {
         return tinfo[TThread::id()].p_.p(P);
     }
-#else
-    template <unsigned P> static void txp_account(txp_counter_type) {
+    static void txp_account_dyn(unsigned c, txp_counter_type n) {
+        if (profile_counters)
+            tinfo[TThread::id()].p_.dyn_[c] += n;
     }
-    template <unsigned P> static txp_counter_type txp_inspect() {return 0;}
-#endif
 
 #define TXP_INCREMENT(p) Transaction::txp_account<(p)>(1)
 #define TXP_ACCOUNT(p, n) Transaction::txp_account<(p)>((n))
 #define TXP_INSPECT(p) Transaction::txp_inspect<(p)>()
+#define TXP_DYN_INCREMENT(c) Transaction::txp_account_dyn((c), 1)
+#define TXP_DYN_ACCOUNT(c, n) Transaction::txp_account_dyn((c), (n))
 
     static unsigned get_epoch_cycle() {
         return us_per_epoch;
@@ -611,10 +1056,97 @@ public:
         fence();
     }
 
+    // Let epoch_advancer pick its cycle within [min_us, max_us]: shorter
+    // while the rcu backlog is above backlog_target, longer when idle.
+    static void set_adaptive_epoch_cycle(unsigned min_us, unsigned max_us,
+                                         size_t backlog_target = 1 << 14) {
+        assert(min_us > 0 && min_us <= max_us && backlog_target > 0);
+        fence();
+        epoch_cycle_min = min_us;
+        epoch_cycle_max = max_us;
+        epoch_backlog_target = backlog_target;
+        us_per_epoch = std::min(std::max(us_per_epoch, min_us), max_us);
+        fence();
+    }
+
+    // Commit TIDs come from one shared counter by default, whose cache
+    // line every committing thread fights over. With epoch TIDs, each
+    // thread makes its own, Silo-style: the global epoch, then TSC ticks
+    // since the epoch began (saturating), then the thread id, and always
+    // above the thread's last TID and above every version the transaction
+    // read or locked (observe_tid). They are unique and, within a thread,
+    // increasing, and no commit gets a TID below the floor of the epoch it
+    // started in, so _RTID and the thread's wtid work as before. But as in
+    // Silo, snapshot reads (_RTID) see a commit only once the epoch it
+    // committed in has ended. A key's versions still increase, so TxnLog
+    // replays in order, provided its object locks through try_lock and
+    // reads through the OCC versions' observe, and nothing takes the
+    // commit TID before the commit locks. Opacity checks
+    // start from _RTID instead of the counter, which makes more of them
+    // hard. TIDs wrap after 2^33 epochs. Set before transactions run.
+    static void set_epoch_tids(bool enabled) {
+        epoch_tids_ = enabled;
+    }
+    static bool epoch_tids() {
+        return epoch_tids_;
+    }
+
+    static void set_readonly_fast_path(bool enabled) {
+        readonly_fast_path = enabled;
+    }
+
+    // Calls f with the items of every transaction that commits, as it
+    // finishes, on the committing thread (bench::trace_recorder captures
+    // traces this way). nullptr, the default, calls nothing. Set while no
+    // transaction runs.
+    typedef void (*commit_observer_type)(const TransItem* items, unsigned n);
+    static void set_commit_observer(commit_observer_type f) {
+        commit_observer_ = f;
+    }
+
+    static void set_sorted_locking_default(bool sorted) {
+        sorted_locking_default = sorted;
+    }
+
+    static void set_early_unlock(bool enabled) {
+        early_unlock = enabled;
+    }
+
+    // Each time an opaque transaction reads a version newer than its
+    // snapshot, it revalidates its whole read set to move the snapshot
+    // forward, so a long transaction's opacity work grows quadratically.
+    // With a nonzero limit, an attempt that has already extended its
+    // snapshot n times aborts instead, as in TL2, bounding the work at
+    // n passes over the read set. 0 (the default) extends without limit.
+    static void set_opacity_extension_limit(unsigned n) {
+        opacity_extension_limit = n;
+    }
+
+    // A commit may repair a transaction written as repair steps up to n
+    // times instead of aborting it (see repair_step). 0 (the default)
+    // disables repair, and repair_step just runs the step.
+    static void set_repair_limit(unsigned n) {
+        repair_limit = n;
+    }
+
+#if STO_VALIDATE_PREFETCH
+    static void set_validate_prefetch(unsigned n) {
+        validate_prefetch = n;
+    }
+#endif
+
 
 private:
+    // The tset is one array in address space reserved for tset_reserve
+    // items, made usable (mprotect) tset_chunk items at a time as it grows
     static constexpr unsigned tset_chunk = 512;
-    static constexpr unsigned tset_max_capacity = 32768;
+    static constexpr unsigned tset_reserve = 1U << 24;
+    // hashtable_ entries hash_base_ + index (< hash_size) fit in 16 bits up
+    // to this many items; the items of a bigger tset go in large_ht_
+    static constexpr unsigned hash_index_limit = 65535 - hash_size;
+    // Commits of more items than this keep their index arrays on the heap
+    // and lock in owner order, a run of one owner's items at a time
+    static constexpr unsigned bulk_commit_min = 4096;
 
     void initialize();
 
@@ -622,6 +1154,8 @@ private:
         : threadid_(TThread::id()), is_test_(false)
 #if CICADA_HASHTABLE
           , cht_(*this)
+#elif ADAPTIVE_HASHTABLE
+          , aht_(*this)
 #endif
     {
         initialize();
@@ -635,9 +1169,13 @@ private:
         : threadid_(threadid), is_test_(true), restarted(false)
 #if CICADA_HASHTABLE
           , cht_(*this)
+#elif ADAPTIVE_HASHTABLE
+          , aht_(*this)
 #endif
     {
         initialize();
+        // start() announces epochs and wtid for the current thread id
+        TThread::set_id(threadid);
         start();
     }
 
@@ -645,14 +1183,23 @@ private:
         : threadid_(TThread::id()), is_test_(false), restarted(false)
 #if CICADA_HASHTABLE
           , cht_(*this)
+#elif ADAPTIVE_HASHTABLE
+          , aht_(*this)
 #endif
     {
         initialize();
+        // make sure epoch scans see this thread
+        TThread::set_id(threadid_);
         state_ = s_aborted;
     }
 
     ~Transaction();
 
+#if STO_NUMA_ALLOC
+    static void* operator new(size_t sz);
+    static void operator delete(void* p, size_t sz);
+#endif
+
     void callCMstart();
 
     // reset data so we can be reused for another transaction
@@ -664,19 +1211,57 @@ private:
 #if STO_TSC_PROFILE
         start_tsc_ = read_tsc();
 #endif
+        PhaseProfile::begin_txn(threadid_);
+        TxnTrace::record(tr_start);
+        if (TxnLog::enabled())
+            TxnLog::poll();
+        attempt_t0_ = AbortProfile::now();
         special_txp = false;
-        // New committed versions “happen” in write_snapshot_epoch
-        thr.write_snapshot_epoch.store(global_epochs.global_epoch.load(std::memory_order_acquire), std::memory_order_release);
-        thr.epoch.store(global_epochs.read_epoch.load(std::memory_order_acquire), std::memory_order_release);
-        thr.rcu_set.clean_until(global_epochs.active_epoch.load(std::memory_order_acquire));
-        thr.wtid.store(_TID.load(std::memory_order_relaxed), std::memory_order_release);
-        if (thr.trans_start_callback)
-            thr.trans_start_callback();
-        hash_base_ += tset_size_ + 1;
-        tset_size_ = 0;
-        tset_next_ = tset0_;
+        uint64_t phase_t;
+        if (in_batch_) {
+            phase_t = PhaseProfile::now(threadid_);
+            TXP_INCREMENT(txp_batched_starts);
+        } else {
+            announce_epochs(thr);
+            phase_t = PhaseProfile::now(threadid_);
+            clean_rcu(thr);
+            phase_t = PhaseProfile::lap(threadid_, ph_start_rcu, phase_t);
+#if STO_HTM
+            // in an RTM attempt, the reserved TID bounds this thread's
+            // commit without reading the shared counter
+            thr.wtid.store(htm_tid_ ? htm_tid_ : tid_floor(), std::memory_order_release);
+#else
+            thr.wtid.store(tid_floor(), std::memory_order_release);
+#endif
+            if (thr.trans_start_callback)
+                thr.trans_start_callback();
+        }
 #if CICADA_HASHTABLE
-        cht_.clear();
+        cht_.clear(tset_size_);
+#elif ADAPTIVE_HASHTABLE
+        aht_.clear(tset_size_);
+#elif TRANSACTION_FILTER
+        filter_.clear();
+#endif
+        hash_base_ += std::min(tset_size_, hash_index_limit) + 1;
+#if !CICADA_HASHTABLE && !ADAPTIVE_HASHTABLE
+        if (unlikely(large_ht_active_)) {
+            large_ht_->clear(tset_size_);
+            large_ht_active_ = false;
+        }
+#endif
+        size_t tset_peak = 0;
+        if (unlikely(tset_hw_.note(tset_size_, tset_peak)))
+            shrink_tset(tset_peak);
+        tset_size_ = 0;
+        tset_next_ = tset_;
+#if STO_ACTIVE_LIST
+        alist_.clear();
+#endif
+#if STO_ITEM_MRU
+        mru_clear();
+#endif
+#if CICADA_HASHTABLE || ADAPTIVE_HASHTABLE
 #elif TRANSACTION_HASHTABLE
         if (hash_base_ >= hash_size) {
             memset(hashtable_, 0, sizeof(hashtable_));
@@ -691,21 +1276,157 @@ private:
         any_writes_ = any_nonopaque_ = may_duplicate_items_ = false;
         first_write_ = 0;
         mvcc_rw_ = false;
+        readonly_ = false;
+        snapshot_isolation_ = false;
+        ro_reads_.clear();
+        ndeferred_ = 0;
+        nrepair_steps_ = nrepairs_ = 0;
+        sorted_locking_ = sorted_locking_default;
+        exclusive_ = false;
+        logging_ = false;
+        opacity_extensions_ = 0;
         if (commit_tid_ > 0)
             prev_commit_tid_ = commit_tid_;
         start_tid_ = read_tid_ = commit_tid_ = 0;
         tictoc_tid_ = 0;
+        epoch_tid_floor_ = 0;
         buf_.clear();
 #if STO_DEBUG_ABORTS
         abort_item_ = nullptr;
         abort_reason_ = nullptr;
         abort_version_ = 0;
 #endif
+        conflict_object_ = nullptr;
         TXP_INCREMENT(txp_total_starts);
         state_ = s_in_progress;
         callCMstart();
+        phase_t0_ = phase_t ? read_tsc() : 0;
+    }
+
+    static void announce_epochs(threadinfo_t& thr) {
+        // New committed versions “happen” in write_snapshot_epoch
+        thr.write_snapshot_epoch.store(global_epochs.global_epoch.load(std::memory_order_acquire), std::memory_order_release);
+        thr.epoch.store(global_epochs.read_epoch.load(std::memory_order_acquire), std::memory_order_release);
+    }
+    static void clean_rcu(threadinfo_t& thr) {
+        TxnTrace::record(tr_rcu_begin);
+#if STO_RCU_BUDGET
+        if (size_t n = thr.rcu_set.clean_until(global_epochs.active_epoch.load(std::memory_order_acquire),
+                                               STO_RCU_BUDGET))
+            txp_account<txp_rcu_handoffs>(n);
+#else
+        thr.rcu_set.clean_until(global_epochs.active_epoch.load(std::memory_order_acquire));
+#endif
+        TxnTrace::record(tr_rcu_end);
+    }
+
+    // The thread-level parts of start() and stop(), done once for any
+    // number of transactions: epochs, RCU cleanup, the thread's lower
+    // bound on commit TIDs (wtid), and the start and end callbacks. While
+    // held, the thread's epochs and wtid stay put, holding back
+    // reclamation and the read TID as one long transaction would.
+    static void hold_thread(threadinfo_t& thr) {
+        announce_epochs(thr);
+        clean_rcu(thr);
+        thr.wtid.store(tid_floor(), std::memory_order_release);
+        if (thr.trans_start_callback)
+            thr.trans_start_callback();
+        TXP_INCREMENT(txp_batches);
+    }
+    static void release_thread(threadinfo_t& thr) {
+        if (thr.trans_end_callback)
+            thr.trans_end_callback();
+        thr.wtid.store(0, std::memory_order_release);
+    }
+
+public:
+    // Between begin_batch() and end_batch(), transactions on this thread
+    // share the thread-level work of start() and stop() (hold_thread)
+    // instead of each doing its own. Keep batches short. See
+    // TransactionBatch.
+    void begin_batch() {
+        assert(!in_batch_ && !in_progress());
+        hold_thread(this_thread());
+        in_batch_ = true;
+    }
+    void end_batch() {
+        assert(in_batch_ && !in_progress());
+        in_batch_ = false;
+        release_thread(this_thread());
+    }
+    bool in_batch() const {
+        return in_batch_;
+    }
+
+    // Start a read-only transaction. Must not write. With the fast path
+    // disabled this is an ordinary transaction (for comparisons).
+    void start_readonly() {
+        start();
+        readonly_ = readonly_fast_path;
+    }
+
+    bool readonly() const {
+        return readonly_;
     }
 
+    // True once this transaction has registered any write
+    bool any_writes() const {
+        return any_writes_;
+    }
+
+    // Commit-lock policy for this transaction. Sorted locking acquires write
+    // locks in global TransItem order and waits for held locks instead of
+    // aborting. Reset to sorted_locking_default by start().
+    void set_sorted_locking(bool sorted) {
+        sorted_locking_ = sorted;
+    }
+    bool sorted_locking() const {
+        return sorted_locking_;
+    }
+
+    // The caller serializes this transaction with every other one that can
+    // touch its items (for instance by owning their partition), so commit
+    // skips read validation. Write locks are still taken, uncontended:
+    // installs publish versions through them. Reset by start().
+    void set_exclusive(bool exclusive) {
+        exclusive_ = exclusive;
+    }
+    bool exclusive() const {
+        return exclusive_;
+    }
+
+    // MVCC snapshot isolation for this transaction. Reads come from the
+    // read_tid() snapshot and are neither recorded nor validated; commit
+    // only checks write-write conflicts. Set before the first read; reset
+    // by start().
+    void set_snapshot_isolation(bool si) {
+        assert(!read_tid_);
+        snapshot_isolation_ = si;
+    }
+    bool snapshot_isolation() const {
+        return snapshot_isolation_;
+    }
+
+    // Read-only fast path for optimistic versions: remember where the
+    // version lives and what was observed, without allocating a TransItem.
+    // observed must be an unlocked value read before the data it protects.
+    template <typename VersImpl>
+    bool ro_observe(const BasicVersion<VersImpl>& vers, BasicVersion<VersImpl> observed) {
+        assert(readonly_);
+        if (observed.is_locked()) {
+            TXP_INCREMENT(txp_observe_lock_aborts);
+            return false;
+        }
+        if (observed.value() & TransactionTid::nonopaque_bit)
+            any_nonopaque_ = true;
+        else if (!check_opacity(observed.value()))
+            return false;
+        ro_reads_.push_back({&const_cast<BasicVersion<VersImpl>&>(vers).value(), observed.value()});
+        return true;
+    }
+
+private:
+
 #if TRANSACTION_HASHTABLE
     static int hash_int_array_index(const TObject* obj, void* key) {
 	(void) obj;
@@ -729,15 +1450,29 @@ private:
     }
 #endif
 
-    void refresh_tset_chunk();
+    void grow_tset();
+    void shrink_tset(size_t peak);
+#if !CICADA_HASHTABLE && !ADAPTIVE_HASHTABLE
+    // Once a tset passes hash_index_limit items, large_ht_ indexes all of
+    // them and grows with the tset
+    void large_put(const TObject* obj, void* xkey);
+#endif
 
     void allocate_item_update_hash(const TObject* obj, void* xkey) {
 #if CICADA_HASHTABLE
         cht_.put(const_cast<TObject *>(obj), xkey, tset_size_ - 1);
+#elif ADAPTIVE_HASHTABLE
+        aht_.put(const_cast<TObject *>(obj), xkey, tset_size_ - 1);
 #else
+        if (unlikely(tset_size_ > hash_index_limit)) {
+            large_put(obj, xkey);
+            return;
+        }
+#if TRANSACTION_FILTER
+        filter_.add(obj, xkey);
+#endif
 #if TRANSACTION_HASHTABLE
         unsigned hi = hash(obj, xkey);
-        //bitvector_[hi % bv_size] = true;
 # if TRANSACTION_HASHTABLE > 1
         if (hashtable_[hi] > hash_base_)
             hi = (hi + hash_step) % hash_size;
@@ -750,12 +1485,15 @@ private:
 
     TransItem* allocate_item(const TObject* obj, void* xkey) {
 	    //TXP_INCREMENT(txp_allocate);
-        if (tset_size_ && tset_size_ % tset_chunk == 0)
-            refresh_tset_chunk();
+        if (unlikely(tset_size_ == tset_capacity_))
+            grow_tset();
         ++tset_size_;
         new(reinterpret_cast<void*>(tset_next_)) TransItem(const_cast<TObject*>(obj), xkey);
         //tset_next_->s_ = reinterpret_cast<TransItem::ownerstore_type>(const_cast<TObject*>(obj));
         //tset_next_->key_ = xkey;
+#if TSET_SIMD_SCAN
+        tfp_[tset_size_ - 1] = tset_scan::fingerprint(obj, xkey);
+#endif
         allocate_item_update_hash(obj, xkey);
         return tset_next_++;
     }
@@ -784,11 +1522,35 @@ private:
     TransProxy item(const TObject* obj, T key) {
         void* xkey = Packer<T>::pack_unique(buf_, std::move(key));
         TransItem* ti = find_item(const_cast<TObject*>(obj), xkey);
-        if (!ti)
+        if (!ti) {
             ti = allocate_item(obj, xkey);
+#if STO_ITEM_MRU
+            mru_note(ti);
+#endif
+        }
         return TransProxy(*this, *ti);
     }
 
+    // Like item(obj, key), trying hint first: an item this transaction
+    // returned earlier, e.g. kept by an accessor between a select and an
+    // update of the same row. A hint from another transaction, or for
+    // another key, is ignored. Sets hint to the item.
+    template <typename T>
+    TransProxy item(const TObject* obj, T key, TransItem*& hint) {
+        void* xkey = Packer<T>::pack_unique(buf_, std::move(key));
+        if (!(hint && hint >= tset_ && hint < tset_next_ && !may_duplicate_items_
+              && hint->owner() == obj && hint->key_ == xkey)) {
+            hint = find_item(const_cast<TObject*>(obj), xkey);
+            if (!hint) {
+                hint = allocate_item(obj, xkey);
+#if STO_ITEM_MRU
+                mru_note(hint);
+#endif
+            }
+        }
+        return TransProxy(*this, *hint);
+    }
+
     template <typename T>
     std::tuple<bool, TransProxy> find_write_item(const TObject* obj, T key) {
         void* xkey = Packer<T>::pack_unique(buf_, std::move(key));
@@ -801,10 +1563,12 @@ private:
 
     template <typename T>
     TransProxy item_inlined(const TObject* obj, T key) {
-#if CICADA_HASHTABLE
+#if CICADA_HASHTABLE || ADAPTIVE_HASHTABLE || TSET_SIMD_SCAN
         return item(obj, key);
 #else
 # if TRANSACTION_HASHTABLE
+        if (unlikely(tset_size_ >= hash_index_limit))
+            return item(obj, key);
         bool found = false;
         TransItem* ti;
         void* xkey = Packer<T>::pack_unique(buf_, std::move(key));
@@ -812,17 +1576,19 @@ private:
         unsigned hi = hash(obj, xkey);
         if (hashtable_[hi] > hash_base_) {
             unsigned tidx =  hashtable_[hi] - hash_base_ - 1;
-            if (likely(tidx < tset_initial_capacity))
-                ti = &tset0_[tidx];
-            else
-                ti = &tset_[tidx / tset_chunk][tidx % tset_chunk];
+            ti = &tset_[tidx];
             if (ti->owner() == obj && ti->key_ == xkey) {
                 found = true;
             } else {
 # endif
 	        //std::cout << "Hash not found!" << std::endl;
+# if TRANSACTION_FILTER
+                if (!filter_.may_contain(obj, xkey)) {
+                    TXP_INCREMENT(txp_bv_hit);
+                } else
+# endif
                 for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
-                    ti = (tidx % tset_chunk ? ti + 1 : tset_[tidx / tset_chunk]);
+                    ti = &tset_[tidx];
                     TXP_INCREMENT(txp_total_searched);
                     if (ti->owner() == obj && ti->key_ == xkey) {
                         found = true;
@@ -834,10 +1600,13 @@ private:
         }
 # endif
         if (!found) {
-            if (tset_size_ && tset_size_ % tset_chunk == 0)
-                refresh_tset_chunk();
+            if (unlikely(tset_size_ == tset_capacity_))
+                grow_tset();
             ++tset_size_;
             new(reinterpret_cast<void*>(tset_next_)) TransItem(const_cast<TObject*>(obj), xkey);
+# if TRANSACTION_FILTER
+            filter_.add(obj, xkey);
+# endif
 # if TRANSACTION_HASHTABLE
             if (hashtable_[hi] <= hash_base_)
                 hashtable_[hi] = hash_base_ + tset_size_;
@@ -874,23 +1643,70 @@ private:
 
 private:
     TransItem* find_item_scan(TObject* obj, void* xkey) const {
+#if TSET_SIMD_SCAN
+        uint64_t fp = tset_scan::fingerprint(obj, xkey);
+        unsigned n = tset_size_;
+        TXP_ACCOUNT(txp_total_searched, n);
+        for (unsigned i = tset_find(tfp_, 0, n, fp); i != n; i = tset_find(tfp_, i + 1, n, fp)) {
+            const TransItem* it = &tset_[i];
+            if (it->owner() == obj && it->key_ == xkey)
+                return const_cast<TransItem*>(it);
+        }
+        return nullptr;
+#else
         const TransItem* it = nullptr;
         for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
-            it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
+            it = &tset_[tidx];
             TXP_INCREMENT(txp_total_searched);
             if (it->owner() == obj && it->key_ == xkey)
                 return const_cast<TransItem*>(it);
         }
         return nullptr;
+#endif
     }
     // tries to find an existing item with this key, returns NULL if not found
     TransItem* find_item(TObject* obj, void* xkey) const {
+#if STO_ITEM_MRU
+        for (unsigned i = 0; i != STO_ITEM_MRU; ++i) {
+            unsigned tidx = mru_[i];
+            if (tidx < tset_size_ && tset_[tidx].owner() == obj && tset_[tidx].key_ == xkey) {
+                TXP_INCREMENT(txp_item_mru_hits);
+                return &tset_[tidx];
+            }
+        }
+        TransItem* ti = find_item_indexed(obj, xkey);
+        if (ti)
+            mru_note(ti);
+        return ti;
+#else
+        return find_item_indexed(obj, xkey);
+#endif
+    }
+
+#if STO_ITEM_MRU
+    // Only the first item for a key may enter the cache: with duplicates
+    // (fresh_item, read_item), lookups must keep finding that one
+    void mru_note(const TransItem* ti) const {
+        mru_[mru_next_] = ti - tset_;
+        mru_next_ = (mru_next_ + 1) % STO_ITEM_MRU;
+    }
+    void mru_clear() {
+        for (auto& tidx : mru_)
+            tidx = ~0U;
+    }
+#endif
+
+    TransItem* find_item_indexed(TObject* obj, void* xkey) const {
 #if STO_TSC_PROFILE
         TimeKeeper<tc_find_item> tk;
 #endif
 #if CICADA_HASHTABLE
         return cht_.find(obj, xkey);
+#elif ADAPTIVE_HASHTABLE
+        return aht_.find(obj, xkey);
 #else
+        if (unlikely(large_ht_active_))
+            return large_ht_->find(obj, xkey);
 #if TRANSACTION_HASHTABLE
         TXP_INCREMENT(txp_hash_find);
         unsigned hi = hash(obj, xkey);
@@ -899,10 +1715,7 @@ private:
                 return nullptr;
             unsigned tidx = hashtable_[hi] - hash_base_ - 1;
             const TransItem* ti;
-            if (likely(tidx < tset_initial_capacity))
-                ti = &tset0_[tidx];
-            else
-                ti = &tset_[tidx / tset_chunk][tidx % tset_chunk];
+            ti = &tset_[tidx];
             if (ti->owner() == obj && ti->key_ == xkey)
                 return const_cast<TransItem*>(ti);
             if (!steps) {
@@ -919,6 +1732,12 @@ private:
                 TXP_INCREMENT(txp_hash_collision2);
             hi = (hi + hash_step) % hash_size;
         }
+#endif
+#if TRANSACTION_FILTER
+        if (!filter_.may_contain(obj, xkey)) {
+            TXP_INCREMENT(txp_bv_hit);
+            return nullptr;
+        }
 #endif
 	// std::cout << "Hash not found!" << std::endl;
 	return find_item_scan(obj, xkey);
@@ -926,19 +1745,72 @@ private:
    }
 
     bool preceding_duplicate_read(TransItem *it) const;
+    // Call before a validation pass that may use preceding_duplicate_read
+    void new_validation_pass() {
+        first_reads_valid_ = false;
+    }
+    bool check_ro_reads() const;
+    bool commit_lock(TransItem* it);
+    bool commit_lock_runs(TransItem** batch, unsigned n);
+    inline void unlock_installed(TransItem* it);
+    void group_by_owner(TransItem** batch, unsigned* idx, unsigned n) const;
+    void reserve_bulk(unsigned n);
+
+#if STO_VALIDATE_PREFETCH
+    // Prefetch the versions of reads at commit scan positions [pos, pos + n)
+    void prefetch_versions(unsigned pos, unsigned n) const {
+# if STO_ACTIVE_LIST
+        unsigned end = std::min(pos + n, unsigned(alist_.size()));
+# else
+        unsigned end = std::min(pos + n, tset_size_);
+# endif
+        for (; pos < end; ++pos) {
+# if STO_ACTIVE_LIST
+            unsigned tidx = alist_[pos];
+# else
+            unsigned tidx = pos;
+# endif
+            TransItem* it = &tset_[tidx];
+            if (it->has_read())
+                if (const void* v = it->owner()->version_address(*it))
+                    ::prefetch(v);
+        }
+    }
+#endif
+
+#if STO_ACTIVE_LIST
+    unsigned item_index(const TransItem* it) const {
+        always_assert(it >= tset_ && it < tset_ + tset_size_, "item not in this transaction's tset");
+        return it - tset_;
+    }
+    // Commit phases visit the active list in tset order
+    void sort_active_list() {
+        if (!std::is_sorted(alist_.begin(), alist_.end()))
+            std::sort(alist_.begin(), alist_.end());
+    }
+#endif
 
 public:
-#if STO_DEBUG_ABORTS
     void mark_abort_because(TransItem* item, const char* reason, TransactionTid::type version = 0) const {
+#if STO_DEBUG_ABORTS
         abort_item_ = item;
         abort_reason_ = reason;
         if (version)
             abort_version_ = version;
-    }
 #else
-    void mark_abort_because(TransItem*, const char*, TransactionTid::type = 0) const {
-    }
+        (void) version;
+#endif
+        if (item) {
+            conflict_object_ = item->owner();
+            conflict_key_ = item->key<uint64_t>();
+            conflict_reason_ = reason;
+        }
+#if CONTENTION_REGULATION
+        ContentionManager::on_abort_reason(TThread::id(), item ? item->owner() : nullptr, reason);
+#else
+        (void) item, (void) reason;
 #endif
+    }
 
     void abort_because(TransItem& item, const char* reason, TransactionTid::type version = 0) {
         mark_abort_because(&item, reason, version);
@@ -971,6 +1843,59 @@ public:
         return state_ < s_aborted;
     }
 
+    // Deferred updates run at commit, once every write is locked and the
+    // read set has been validated, just before install, in the order they
+    // were registered. f() may read and update whatever this transaction
+    // has locked (the rows it writes) and typically fills in a buffered
+    // write value from the current contents of a hot row, so the row never
+    // joins the read set and only conflicts during the commit critical
+    // section. Results f() leaves in its captures are visible to later
+    // deferred updates, to the install steps, and to the caller once
+    // commit returns true. f is copied bytewise into scratch space and
+    // never destroyed. Objects whose lock() already consumes the write
+    // value (MVCC) don't see changes f makes to it.
+    static constexpr unsigned max_deferred_updates = 16;
+
+    template <typename F>
+    void defer_update(const F& f) {
+        static_assert(std::is_trivially_copyable<F>::value && std::is_trivially_destructible<F>::value,
+                      "deferred updates are copied as bytes");
+        always_assert(ndeferred_ != max_deferred_updates, "too many deferred updates");
+        always_assert(any_writes_, "deferred update without a write");
+        deferred_[ndeferred_++] = {&run_deferred<F>, new (&scratch_.allocate<F>()) F(f)};
+    }
+
+    // Repair steps. repair_step(f, deps) runs f(), which returns false if
+    // the transaction must abort, and remembers it with the tset items it
+    // added and deps, the mask of earlier steps (bit i for the i-th step
+    // run) whose results f uses. When a read fails validation at commit, a
+    // repair reruns, in order and with every lock kept, the step that added
+    // the stale item and the steps that depend on it, directly or not,
+    // after clearing their items' reads and writes; then validation starts
+    // over. The commit aborts instead if the stale item belongs to no step,
+    // after set_repair_limit repairs, or if the reruns leave a different
+    // set of writes than the one locked. So a step must find its rows again
+    // by key and write the same ones, and what it hands to later steps must
+    // outlive the transaction body, which is out of scope by commit. f is
+    // copied bytewise into scratch space and never destroyed. The batched
+    // check (STO_BATCH_COMMIT) doesn't repair.
+    static constexpr unsigned max_repair_steps = 32;
+
+    template <typename F>
+    bool repair_step(const F& f, uint32_t deps = 0) {
+        static_assert(std::is_trivially_copyable<F>::value && std::is_trivially_destructible<F>::value,
+                      "repair steps are copied as bytes");
+        if (!repair_limit)
+            return f();
+        always_assert(nrepair_steps_ != max_repair_steps, "too many repair steps");
+        unsigned begin = tset_size_;
+        if (!f())
+            return false;
+        repair_steps_[nrepair_steps_++] = {&run_repair_step<F>, new (&scratch_.allocate<F>()) F(f),
+                                           begin, tset_size_, deps};
+        return true;
+    }
+
     template <typename T>
     T *tx_alloc(const T *src) {
         TXP_INCREMENT(txp_alloc_t);
@@ -1003,7 +1928,7 @@ public:
         assert(state_ <= s_committing_locked);
         TXP_INCREMENT(txp_tco);
         if (!start_tid_)
-            start_tid_ = _TID.load(std::memory_order_relaxed);
+            start_tid_ = opacity_tid();
         if (!TransactionTid::try_check_opacity(start_tid_, v)
             && state_ < s_committing)
             return hard_check_opacity(&item, v);
@@ -1022,7 +1947,7 @@ public:
     bool check_opacity(TransactionTid::type v) {
         assert(state_ <= s_committing_locked);
         if (!start_tid_)
-            start_tid_ = _TID.load(std::memory_order_relaxed);
+            start_tid_ = opacity_tid();
         if (!TransactionTid::try_check_opacity(start_tid_, v)
             && state_ < s_committing)
             return hard_check_opacity(nullptr, v);
@@ -1030,7 +1955,7 @@ public:
     }
 
     bool check_opacity() {
-        return check_opacity(_TID.load(std::memory_order_relaxed));
+        return check_opacity(tid_floor());
     }
 
     // flips the manual rw flag for mvcc
@@ -1043,7 +1968,7 @@ public:
         if (!read_tid_) {
             TXP_INCREMENT(txp_rtid_atomic);
             fence();
-            if (mvcc_rw_) {
+            if (mvcc_rw_ && !snapshot_isolation_) {
                 //read_tid_ = _TID.load(std::memory_order_relaxed);
                 read_tid_ = write_tid();
             } else {
@@ -1058,12 +1983,69 @@ public:
     tid_type write_tid() const {
         if (!commit_tid_) {
             threadinfo_t& thr = this_thread();
-            commit_tid_ = _TID.fetch_add(TransactionTid::increment_value);
-            thr.wtid.store(commit_tid_, std::memory_order_release);
+            if (epoch_tids_)
+                commit_tid_ = next_epoch_tid(thr);
+#if STO_HTM
+            // the TID reserved for a hardware attempt, unless a version
+            // read or locked since then has passed it
+            else if (htm_tid_ > epoch_tid_floor_)
+                commit_tid_ = htm_tid_;
+#endif
+            else
+                commit_tid_ = _TID.fetch_add(TransactionTid::increment_value);
+            // a held thread's wtid is already below every commit TID
+            if (!in_batch_)
+                thr.wtid.store(commit_tid_, std::memory_order_release);
         }
         return commit_tid_;
     }
 
+    tid_type next_epoch_tid(threadinfo_t& thr) const {
+        // Orders the wtid announced at start before the epoch load; an
+        // epoch_advance_once that misses that wtid reads an epoch no later
+        // than this one
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        epoch_type e = global_epochs.global_epoch.load(std::memory_order_acquire);
+        uint64_t base = global_epochs.epoch_tsc.load(std::memory_order_relaxed);
+        uint64_t now = read_tsc();
+        uint64_t ticks = now > base ? (now - base) >> epoch_tid_tsc_shift : 0;
+        // As in Silo, also above every version read or locked so far, so a
+        // key's versions increase even when ticks saturate or TSCs skew.
+        // The bump may carry into the next epoch, which only delays when
+        // snapshots see the commit.
+        tid_type above = (epoch_tid_floor_ | (epoch_tid_step - 1)) + 1
+            + tid_type(threadid_) * TransactionTid::increment_value;
+        thr.last_tid = std::max({epoch_tid(e, ticks, threadid_), thr.last_tid + epoch_tid_step, above});
+        return thr.last_tid;
+    }
+    // Records a version read or locked by this transaction; with epoch TIDs
+    // the commit TID is chosen above it
+    void observe_tid(tid_type v) {
+#if STO_HTM
+        if ((epoch_tids_ || htm_tid_) && v > epoch_tid_floor_)
+#else
+        if (epoch_tids_ && v > epoch_tid_floor_)
+#endif
+            epoch_tid_floor_ = v;
+    }
+
+#if STO_HTM
+    // Takes a commit TID from the shared counter ahead of an RTM attempt,
+    // so that hardware writers don't all write the counter's cache line
+    // inside their regions and abort one another. It is announced as the
+    // thread's wtid right away. An aborted attempt leaves it unused;
+    // clear_htm_tid() before running in software.
+    void reserve_htm_tid() {
+        if (!epoch_tids_) {
+            htm_tid_ = _TID.fetch_add(TransactionTid::increment_value);
+            this_thread().wtid.store(htm_tid_, std::memory_order_release);
+        }
+    }
+    void clear_htm_tid() {
+        htm_tid_ = 0;
+    }
+#endif
+
     // committing
     tid_type commit_tid() const {
 #if !CONSISTENCY_CHECK
@@ -1074,6 +2056,29 @@ public:
 
     inline tid_type compute_tictoc_commit_ts() const;
 
+    // Appends a redo record for a write being installed, if this commit is
+    // logged (TxnLog). Called from install(); tid is the version installed,
+    // which orders the writes to one key.
+    void log_write(uint32_t object_id, const void* key, uint32_t keylen,
+                   const void* value, uint32_t vallen, tid_type tid) const {
+        if (STO_LOGGING && logging_)
+            TxnLog::append(object_id, key, keylen, value, vallen, tid);
+    }
+    // log_write of an update from old_value, logging only what changed
+    // (TxnLog::append_delta)
+    void log_delta(uint32_t object_id, const void* key, uint32_t keylen,
+                   const void* old_value, const void* value, uint32_t vallen, tid_type tid) const {
+        if (STO_LOGGING && logging_)
+            TxnLog::append_delta(object_id, key, keylen, old_value, value, vallen, tid);
+    }
+    void log_delete(uint32_t object_id, const void* key, uint32_t keylen, tid_type tid) const {
+        if (STO_LOGGING && logging_)
+            TxnLog::append_delete(object_id, key, keylen, tid);
+    }
+    bool logging() const {
+        return STO_LOGGING && logging_;
+    }
+
     template <typename VersImpl>
     void set_version(VersionBase<VersImpl>& version, typename VersionBase<VersImpl>::type flags = 0) const {
         assert(state_ == s_committing_locked || state_ == s_committing);
@@ -1181,11 +2186,39 @@ public:
     bool is_restarted() {
         return restarted;
     }
+
+    unsigned tset_size() const {
+        return tset_size_;
+    }
   
     void set_restarted(bool r) {
         restarted = r;
     }
 
+    const TransactionOptions& options() const {
+        return opts_;
+    }
+    // The object and item key the last attempt aborted on, if it marked
+    // one (mark_abort_because); valid until the next start
+    const TObject* conflict_object() const {
+        return conflict_object_;
+    }
+    uint64_t conflict_key() const {
+        return conflict_key_;
+    }
+    void set_options(const TransactionOptions& opts) {
+        opts_ = opts;
+    }
+    // Called after the nfailed'th failed attempt of a retry loop
+    bool may_retry(unsigned nfailed) const {
+        if ((opts_.max_retries && nfailed > opts_.max_retries)
+            || opts_.past_deadline()) {
+            TXP_INCREMENT(txp_budget_aborts);
+            return false;
+        }
+        return true;
+    }
+
 private:
     enum {
         s_in_progress = 0, s_opacity_check = 1, s_committing = 2,
@@ -1194,7 +2227,7 @@ private:
 
     int threadid_;
     uint16_t hash_base_;
-    uint16_t first_write_;
+    unsigned first_write_;
     uint8_t state_;
     bool any_writes_;
 public:
@@ -1203,17 +2236,35 @@ private:
     bool may_duplicate_items_;
     bool is_test_;
     bool restarted;
+    bool in_batch_ = false;
+    TransactionOptions opts_;
     TransItem* tset_next_;
     unsigned tset_size_;
+#if STO_ITEM_MRU
+    mutable unsigned mru_[STO_ITEM_MRU];  // tset indexes, ~0U if unused
+    mutable unsigned mru_next_ = 0;
+#endif
     mutable bool mvcc_rw_;  // manual MVCC read-write flag
+    bool readonly_;
+    bool sorted_locking_;
+    bool exclusive_;
+    bool snapshot_isolation_;
+    bool logging_;          // this commit has an open TxnLog record
+    unsigned opacity_extensions_;  // successful hard_check_opacity calls
     mutable tid_type start_tid_;
     mutable tid_type read_tid_;
     mutable tid_type commit_tid_;
     mutable tid_type prev_commit_tid_;
     mutable tid_type tictoc_tid_; // commit tid reserved for TicToc
+    tid_type epoch_tid_floor_;    // newest version read or locked (epoch
+                                  // TIDs or a reserved HTM TID)
+#if STO_HTM
+    tid_type htm_tid_;            // commit tid reserved for an RTM attempt
+#endif
 public:
     mutable TransactionBuffer buf_;
     mutable TransScratch scratch_;
+    HighWater tset_hw_;
 private:
     mutable uint32_t lrng_state_;
 #if STO_DEBUG_ABORTS
@@ -1221,18 +2272,102 @@ private:
     mutable const char* abort_reason_;
     mutable tid_type abort_version_;
 #endif
+    // last item marked by mark_abort_because, for ConflictProfile
+    mutable const TObject* conflict_object_;
+    mutable uint64_t conflict_key_;
+    mutable const char* conflict_reason_;
+    // PhaseProfile tick at the end of start(), if this attempt is sampled
+    uint64_t phase_t0_ = 0;
+    // start tick of this attempt, for AbortProfile
+    uint64_t attempt_t0_ = 0;
 #if STO_TSC_PROFILE
     mutable tc_counter_type start_tsc_;
 #endif
-    TransItem* tset_[tset_max_capacity / tset_chunk];
+    // The tset, usable up to tset_capacity_ items (see tset_reserve)
+    TransItem* tset_;
+    unsigned tset_capacity_;
+    // Index and item arrays for bulk commits (bulk_commit_min): two index
+    // arrays and one item array of bulk_capacity_ entries
+    std::unique_ptr<unsigned[]> bulk_idx_;
+    std::unique_ptr<TransItem*[]> bulk_items_;
+    unsigned bulk_capacity_ = 0;
+    struct ro_read {
+        const volatile TransactionTid::type* vers;
+        TransactionTid::type observed;
+    };
+    std::vector<ro_read> ro_reads_; // read-only mode reads outside the tset
+    struct deferred_update {
+        void (*run)(void*);
+        void* closure;
+    };
+    deferred_update deferred_[max_deferred_updates];
+    unsigned ndeferred_ = 0;
+
+    template <typename F>
+    static void run_deferred(void* closure) {
+        (*reinterpret_cast<F*>(closure))();
+    }
+    void run_deferred_updates() {
+        for (unsigned i = 0; i != ndeferred_; ++i)
+            deferred_[i].run(deferred_[i].closure);
+    }
+    struct repair_record {
+        bool (*run)(void*);
+        void* closure;
+        unsigned begin;     // the tset items the step added
+        unsigned end;
+        uint32_t deps;
+    };
+    repair_record repair_steps_[max_repair_steps];
+    unsigned nrepair_steps_ = 0;
+    unsigned nrepairs_ = 0;
+
+    template <typename F>
+    static bool run_repair_step(void* closure) {
+        return (*reinterpret_cast<F*>(closure))();
+    }
+    bool repair(unsigned stale, const unsigned* writeset, unsigned nwriteset);
+    // For duplicate items: the first item in the tset with a read, per
+    // (owner, key). Built on the first failed check of a validation pass.
+    struct item_id {
+        const TObject* owner;
+        void* key;
+        bool operator==(const item_id& x) const {
+            return owner == x.owner && key == x.key;
+        }
+    };
+    struct item_id_hash {
+        size_t operator()(const item_id& x) const {
+            return std::hash<uintptr_t>()(reinterpret_cast<uintptr_t>(x.owner) * 0x9E3779B97F4A7C15ULL
+                                          ^ reinterpret_cast<uintptr_t>(x.key));
+        }
+    };
+    mutable std::unordered_map<item_id, const TransItem*, item_id_hash> first_reads_;
+    mutable bool first_reads_valid_ = false;
+#if STO_ACTIVE_LIST
+    // tset indexes of items that were ever read, written, locked, or given
+    // a predicate; the only items commit has to look at
+    std::vector<unsigned> alist_;
+#endif
+#if TSET_SIMD_SCAN
+    // (owner, key) fingerprints, parallel to tset_ and in its reservation
+    uint64_t* tfp_;
+    static tset_scan::find_type tset_find;
+#endif
 #if CICADA_HASHTABLE
     CicadaHashtable cht_;
+#elif ADAPTIVE_HASHTABLE
+    AdaptiveHashtable aht_;
 #else
 #if TRANSACTION_HASHTABLE
     uint16_t hashtable_[hash_size];
 #endif
+#if TRANSACTION_FILTER
+    tset_filter filter_;
+#endif
+    AdaptiveHashtable* large_ht_ = nullptr;
+    bool large_ht_active_ = false;
 #endif
-    TransItem tset0_[tset_initial_capacity];
 
     bool hard_check_opacity(TransItem* item, TransactionTid::type t);
     void stop(bool committed, unsigned* writes, unsigned nwrites);
@@ -1241,22 +2376,46 @@ private:
     friend class TransItem;
     friend class Sto;
     friend class TestTransaction;
+    friend class TxnCoScheduler;
     friend class MvHistoryBase;
     friend class CicadaHashtable;
+    friend class AdaptiveHashtable;
 
     friend class VersionDelegate;
 };
 
+inline CMInfo& ContentionManager::info(int threadid) {
+    return Transaction::tinfo[threadid].cm;
+}
+
+inline CMInfo* ContentionManager::find_info(int threadid) {
+    threadinfo_t* t = Transaction::tinfo.find(threadid);
+    return t ? &t->cm : nullptr;
+}
+
+inline void ContentionManager::on_leave(int threadid) {
+    CMInfo& cm = info(threadid);
+    if (cm.queue >= 0)
+        queue_release(cm);
+}
+
+inline TxnLog::epoch_type TxnLog::durable_epoch() {
+    return Transaction::global_epochs.durable_epoch.load(std::memory_order_acquire);
+}
+
+void CicadaHashtable::init_roots() const {
+    for (uint16_t i = 0; i != root_count(); ++i) {
+        access_buckets_[i].count = 0;
+        access_buckets_[i].next = EmptyBucketID;
+    }
+    access_bucket_count_ = root_count();
+}
+
 TransItem* CicadaHashtable::find(TObject* owner, void* xkey) const {
     AccessBucket* bkt;
     uint16_t bkt_id;
-    if (access_bucket_count_ == 0) {
-        for (uint16_t i = 0; i < AccessBucketRootCount; i++) {
-            access_buckets_[i].count = 0;
-            access_buckets_[i].next = EmptyBucketID;
-        }
-        access_bucket_count_ = AccessBucketRootCount;
-    }
+    if (access_bucket_count_ == 0)
+        init_roots();
 
     bkt_id = hash_(owner, xkey);
     bkt = &access_buckets_[bkt_id];
@@ -1264,10 +2423,7 @@ TransItem* CicadaHashtable::find(TObject* owner, void* xkey) const {
         for (auto i = 0; i < bkt->count; i++) {
             auto idx = bkt->idx[i];
             TransItem* ti;
-            if (likely(idx < txn_.tset_initial_capacity))
-                ti = &txn_.tset0_[idx];
-            else
-                ti = &txn_.tset_[idx / txn_.tset_chunk][idx % txn_.tset_chunk];
+            ti = &txn_.tset_[idx];
             if (ti->owner() == owner && ti->key_ == xkey) {
                 return ti;
             }
@@ -1282,14 +2438,8 @@ TransItem* CicadaHashtable::find(TObject* owner, void* xkey) const {
 void CicadaHashtable::put(TObject* owner, void* xkey, uint32_t idx) {
     AccessBucket* bkt;
     uint16_t bkt_id;
-    // TODO: Factor this out because it is used later again.
-    if (access_bucket_count_ == 0) {
-        for (uint16_t i = 0; i < AccessBucketRootCount; i++) {
-            access_buckets_[i].count = 0;
-            access_buckets_[i].next = EmptyBucketID;
-        }
-        access_bucket_count_ = AccessBucketRootCount;
-    }
+    if (access_bucket_count_ == 0)
+        init_roots();
 
     bkt_id = hash_(owner, xkey);
     bkt = &access_buckets_[bkt_id];
@@ -1317,6 +2467,64 @@ void CicadaHashtable::put(TObject* owner, void* xkey, uint32_t idx) {
     bkt->idx[bkt->count++] = idx;
 }
 
+void CicadaHashtable::clear(unsigned last_size) {
+    // the maximum jumps to a large transaction and decays by 1/16 per
+    // smaller one; shrink only once it is well below the roots' capacity
+    recent_size_ = std::max(last_size, recent_size_ - recent_size_ / 16);
+    unsigned want = MinRootCount;
+    while (want < MaxRootCount && want * AccessBucketSize < 2 * recent_size_)
+        want *= 2;
+    if (want > root_count() || 4 * want <= root_count()) {
+        root_mask_ = want - 1;
+        if (access_buckets_.size() < want)
+            access_buckets_.resize(want);
+    }
+    access_bucket_count_ = 0;
+}
+
+TransItem* AdaptiveHashtable::find(TObject* owner, void* xkey) const {
+    TXP_INCREMENT(txp_hash_find);
+    uint32_t hi = hash_(owner, xkey, mask_);
+    for (uint32_t v = slots_[hi]; v > base_; v = slots_[hi]) {
+        uint32_t idx = v - base_ - 1;
+        TransItem* ti = &txn_.tset_[idx];
+        if (ti->owner() == owner && ti->key_ == xkey)
+            return ti;
+        TXP_INCREMENT(txp_hash_collision);
+        hi = (hi + 1) & mask_;
+    }
+    return nullptr;
+}
+
+void AdaptiveHashtable::put(TObject* owner, void* xkey, uint32_t idx) {
+    if (unlikely(2 * (idx + 1) > capacity()))
+        resize(2 * capacity(), idx);
+    insert_(owner, xkey, idx);
+}
+
+void AdaptiveHashtable::clear(unsigned last_size) {
+    if (capacity() > initial_capacity && 8 * last_size < capacity()) {
+        if (++nsmall_ == shrink_after) {
+            resize(capacity() / 2, 0);
+            return;
+        }
+    } else
+        nsmall_ = 0;
+    if (unlikely(base_ + last_size >= UINT32_MAX - 2 * capacity())) {
+        memset(slots_, 0, sizeof(uint32_t) * capacity());
+        base_ = 0;
+    } else
+        base_ += last_size;
+}
+
+
+void TransItem::list_active() {
+#if STO_ACTIVE_LIST
+    Transaction* t = TThread::txn;
+    listed_ = true;
+    t->alist_.push_back(t->item_index(this));
+#endif
+}
 
 template <int T, bool tmp_stats>
 inline void TimeKeeper<T, tmp_stats>::sync_thread_counter() {
@@ -1353,11 +2561,72 @@ public:
         t->start();
     }
 
+    static void start_readonly_transaction() {
+        Transaction* t = transaction();
+        always_assert(!t->in_progress());
+        t->start_readonly();
+    }
+
+    static bool readonly() {
+        return TThread::txn->readonly();
+    }
+
+    static bool any_writes() {
+        return TThread::txn->any_writes();
+    }
+
+    static void set_sorted_locking(bool sorted) {
+        always_assert(in_progress());
+        TThread::txn->set_sorted_locking(sorted);
+    }
+
+    static void set_exclusive(bool exclusive) {
+        always_assert(in_progress());
+        TThread::txn->set_exclusive(exclusive);
+    }
+
+    static void set_snapshot_isolation(bool si) {
+        always_assert(in_progress());
+        TThread::txn->set_snapshot_isolation(si);
+    }
+
+    static bool snapshot_isolation() {
+        return TThread::txn->snapshot_isolation();
+    }
+
+    // Options for the next transaction loop (TRANSACTION, TXN, ...) on
+    // this thread; they end with it
+    static void set_options(const TransactionOptions& opts) {
+        transaction()->set_options(opts);
+    }
+
+#if STO_HTM
+    static bool htm_supported() {
+        static const bool supported = cpu_has_feature<RtmQuery>();
+        return supported;
+    }
+#endif
+
 		static void delete_transaction() {
 				delete TThread::txn;
 				TThread::txn = nullptr;
 		}
 
+    // Threads that come and go at run time take an id with thread_join,
+    // which returns it, or -1 if every id from first_id up is taken, and
+    // give it back with thread_leave; see Transaction::thread_leave.
+    static int thread_join(int first_id = 0) {
+        int id = TThread::acquire_id(first_id);
+        if (id >= 0)
+            update_threadid();
+        return id;
+    }
+    static void thread_leave(bool drain = true) {
+        always_assert(!in_progress());
+        Transaction::thread_leave(drain);
+        delete_transaction();
+    }
+
     static void update_threadid() {
         if (TThread::txn)
             TThread::txn->threadid_ = TThread::id();
@@ -1383,6 +2652,11 @@ public:
         return TThread::txn->item(s, key);
     }
 
+    template <typename T>
+    static TransProxy item(const TObject* s, T key, TransItem*& hint) {
+        return TThread::txn->item(s, key, hint);
+    }
+
     static void check_opacity(TransactionTid::type t) {
         always_assert(in_progress());
         TThread::txn->check_opacity(t);
@@ -1457,6 +2731,18 @@ public:
         return TransactionTid::increment_value;
     }
 
+    // See Transaction::defer_update
+    template <typename F>
+    static void defer_update(const F& f) {
+        TThread::txn->defer_update(f);
+    }
+
+    // See Transaction::repair_step
+    template <typename F>
+    static bool repair_step(const F& f, uint32_t deps = 0) {
+        return TThread::txn->repair_step(f, deps);
+    }
+
     template <typename T>
     static inline T* tx_alloc(const T* blob) {
         return TThread::txn->tx_alloc<T>(blob);
@@ -1478,6 +2764,9 @@ public:
         use();
     }
     ~TestTransaction() {
+        // don't leave a dangling pointer for the next Sto::transaction()
+        if (TThread::txn == &t_)
+            TThread::txn = nullptr;
         //if (base_ && !base_->is_test_) {
         //    TThread::txn = base_;
         //    TThread::set_id(base_->threadid_);
@@ -1525,6 +2814,25 @@ class TransactionGuard {
     }
 };
 
+// Scoped pin_snapshot, for AS OF reads on MVCC indexes
+class SnapshotPin {
+  public:
+    SnapshotPin() {
+        slot_ = Transaction::pin_snapshot(tid_);
+    }
+    ~SnapshotPin() {
+        Transaction::unpin_snapshot(slot_);
+    }
+    SnapshotPin(const SnapshotPin&) = delete;
+    SnapshotPin& operator=(const SnapshotPin&) = delete;
+    TransactionTid::type tid() const {
+        return tid_;
+    }
+  private:
+    TransactionTid::type tid_;
+    int slot_;
+};
+
 class TransactionLoopGuard {
   public:
     TransactionLoopGuard() {
@@ -1537,18 +2845,91 @@ class TransactionLoopGuard {
     }
 
     ~TransactionLoopGuard() {
+#if STO_HTM
+        if (in_htm_)
+            _xabort(htm_conflict);
+#endif
         if (TThread::txn->in_progress())
             TThread::txn->silent_abort();
-    }
-    void start() {
+        ContentionManager::on_leave(TThread::id());
+        AbortProfile::retries(TThread::id(), nfailed_);
+        TThread::txn->set_options(TransactionOptions());
+    }
+    // With STO_HTM, the first attempts run the whole transaction, commit
+    // protocol included, inside an RTM region. Version locks are only ever
+    // taken and released inside the region, and every version the commit
+    // reads joins its read set, so a concurrent software committer's lock
+    // aborts the hardware transaction. A hardware abort resumes here with
+    // all of the attempt's effects, including STO's own bookkeeping, undone.
+    // The commit TID is reserved before the region starts (reserve_htm_tid),
+    // so the shared TID counter stays out of the hardware write set.
+    __attribute__((always_inline)) void start() {
+#if STO_HTM
+        if (htm_left_ && Sto::htm_supported()) {
+            TThread::txn->reserve_htm_tid();
+            unsigned status = _xbegin();
+            if (status == _XBEGIN_STARTED) {
+                in_htm_ = true;
+                Sto::start_transaction();
+                return;
+            }
+            TThread::txn->clear_htm_tid();
+            htm_aborted(status);
+        }
+#endif
         Sto::start_transaction();
     }
+    void start_readonly() {
+        Sto::start_readonly_transaction();
+    }
     void silent_abort() {
+#if STO_HTM
+        if (in_htm_)
+            _xabort(htm_conflict);
+#endif
         TThread::txn->silent_abort();
     }
     bool try_commit() {
+#if STO_HTM
+        if (in_htm_) {
+            Transaction* t = TThread::txn;
+            if (t->tset_size() > STO_HTM_MAX_ITEMS)
+                _xabort(htm_too_big);
+            if (!t->in_progress() || !t->try_commit())
+                _xabort(htm_conflict);
+            _xend();
+            in_htm_ = false;
+            t->clear_htm_tid();
+            TXP_INCREMENT(txp_htm_commits);
+            return true;
+        }
+#endif
         return TThread::txn->in_progress() && TThread::txn->try_commit();
     }
+    // False once the loop's retry budget is spent
+    bool may_retry() {
+        return TThread::txn->may_retry(++nfailed_);
+    }
+  private:
+    unsigned nfailed_ = 0;
+#if STO_HTM
+    enum { htm_conflict = 1, htm_too_big = 2 };
+    unsigned htm_left_ = STO_HTM_ATTEMPTS;
+    bool in_htm_ = false;
+
+    void htm_aborted(unsigned status) {
+        TXP_INCREMENT(txp_htm_aborts);
+        bool explicit_abort = status & _XABORT_EXPLICIT;
+        if ((explicit_abort && _XABORT_CODE(status) == htm_too_big)
+            || (status & _XABORT_CAPACITY)
+            || (!explicit_abort && !(status & _XABORT_RETRY)))
+            htm_left_ = 0;
+        else
+            --htm_left_;
+        if (!htm_left_)
+            TXP_INCREMENT(txp_htm_fallbacks);
+    }
+#endif
 };
 
 
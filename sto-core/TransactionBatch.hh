@@ -0,0 +1,111 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "Sto.hh"
+
+// Runs many small, independent transactions on the calling thread, such as
+// single-key updates, where the fixed cost of starting each one matters.
+//
+// Each member is a TRANSACTION_E body: it aborts with TXN_DO_E or by
+// throwing Transaction::Abort, and may run again, so it must reset
+// anything it changes outside the transaction. run() runs the members in
+// rounds. A round runs the members still pending in order, each in its own
+// transaction, inside one Transaction::begin_batch(): they share the epoch
+// announcement, RCU cleanup and start/end callbacks that every
+// Transaction::start() otherwise does, and reuse the thread's Transaction.
+// Members that abort wait for the next round, which refreshes the epoch;
+// members that committed don't run again.
+//
+// A member that runs out of the retry budget (TransactionOptions, set with
+// Sto::set_options before run()) stays uncommitted. An
+// exception other than Transaction::Abort aborts that member, ends the
+// batch and propagates; later members are left pending.
+class TransactionBatch {
+public:
+    typedef std::function<void()> body;
+
+    // Returns the member's index
+    size_t add(body f) {
+        members_.push_back({std::move(f), 0, false});
+        return members_.size() - 1;
+    }
+    size_t size() const {
+        return members_.size();
+    }
+    void clear() {
+        members_.clear();
+    }
+
+    // True once every member committed
+    bool run() {
+        Transaction* t = Sto::transaction();
+        TransactionOptions opts = t->options();
+        pending_.clear();
+        rounds_ = 0;
+        for (size_t i = 0; i != members_.size(); ++i)
+            if (!members_[i].committed)
+                pending_.push_back(i);
+        bool ok = true;
+        while (!pending_.empty()) {
+            ++rounds_;
+            size_t n = 0;
+            t->begin_batch();
+            try {
+                for (size_t i : pending_) {
+                    member& m = members_[i];
+                    if (attempt(t, m))
+                        m.committed = true;
+                    else if (t->may_retry(++m.nfailed))
+                        pending_[n++] = i;
+                    else
+                        ok = false;
+                    t->set_options(opts);
+                }
+            } catch (...) {
+                if (t->in_progress())
+                    t->silent_abort();
+                t->end_batch();
+                t->set_options(opts);
+                throw;
+            }
+            t->end_batch();
+            pending_.resize(n);
+        }
+        t->set_options(TransactionOptions());
+        return ok;
+    }
+
+    bool committed(size_t i) const {
+        return members_[i].committed;
+    }
+    // Rounds the last run() took
+    unsigned rounds() const {
+        return rounds_;
+    }
+
+private:
+    struct member {
+        body f;
+        unsigned nfailed;
+        bool committed;
+    };
+
+    std::vector<member> members_;
+    std::vector<size_t> pending_;
+    unsigned rounds_ = 0;
+
+    static bool attempt(Transaction* t, member& m) {
+        t->set_restarted(false);
+        Sto::start_transaction();
+        try {
+            m.f();
+            if (t->in_progress() && t->try_commit())
+                return true;
+        } catch (Transaction::Abort&) {
+        }
+        if (t->in_progress())
+            t->silent_abort();
+        return false;
+    }
+};
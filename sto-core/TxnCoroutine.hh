@@ -0,0 +1,290 @@
+#pragma once
+
+// Transactions written as C++20 coroutines, many of which share a thread.
+// Needs -std=c++20; without coroutine support this header is empty.
+//
+// A TxnCoroutine is a transaction body that may suspend with co_await,
+// and that aborts as a TRANSACTION_E body does (TXN_DO_E, or throwing
+// Transaction::Abort):
+//
+//     TxnCoroutine transfer(TBox<int>& a, TBox<int>& b, reply& r) {
+//         int v = a;
+//         co_await TxnCoScheduler::wait_until([&] { return r.ready(); });
+//         a = v - r.amount();
+//         b = b + r.amount();
+//     }
+//
+// A TxnCoScheduler runs such bodies on the calling thread. Each
+// transaction in flight has its own Transaction object, installed as
+// TThread::txn while its coroutine runs, so one suspended in the middle
+// leaves the others free to start, run and commit. A transaction commits
+// once its body returns; commit never suspends. One that aborts starts
+// over with a fresh body.
+//
+// The transactions share the thread's id, so per-thread counters add up
+// as usual. The thread's epochs and wtid are announced once for all of
+// them (Transaction::hold_thread) instead of by each start(), so nothing
+// a transaction in flight might see is reclaimed, and no commit TID in
+// flight falls below the read TID. The scheduler stops admitting
+// transactions once the global epoch has moved on from the held one, and
+// renews the hold when the last one in flight finishes, so a steady
+// stream of work can't hold back reclamation for long.
+//
+// The body's own co_awaits, yield() and wait_until(pred), are the only
+// suspension points. Waits inside STO, such as an MVCC read of a pending
+// version, still block the thread.
+
+#if __cpp_impl_coroutine
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Sto.hh"
+
+class TxnCoroutine {
+public:
+    struct promise_type {
+        std::exception_ptr error;
+
+        TxnCoroutine get_return_object() {
+            return TxnCoroutine(handle::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+            error = std::current_exception();
+        }
+    };
+    typedef std::coroutine_handle<promise_type> handle;
+
+    TxnCoroutine() = default;
+    TxnCoroutine(TxnCoroutine&& x) noexcept
+        : h_(std::exchange(x.h_, {})) {
+    }
+    TxnCoroutine& operator=(TxnCoroutine&& x) noexcept {
+        std::swap(h_, x.h_);
+        return *this;
+    }
+    ~TxnCoroutine() {
+        if (h_)
+            h_.destroy();
+    }
+
+private:
+    handle h_;
+
+    explicit TxnCoroutine(handle h)
+        : h_(h) {
+    }
+    friend class TxnCoScheduler;
+};
+
+class TxnCoScheduler {
+public:
+    typedef std::function<TxnCoroutine()> body;
+    // nullptr once the transaction committed, or the exception, other
+    // than Transaction::Abort, that ended it
+    typedef std::function<void(std::exception_ptr)> completion;
+
+    struct stats {
+        uint64_t committed = 0;
+        uint64_t failed = 0;
+        uint64_t aborts = 0;         // attempts that started over
+        uint64_t suspensions = 0;
+        uint64_t holds = 0;          // epoch holds, renewed as the epoch moves
+    };
+
+    explicit TxnCoScheduler(unsigned max_inflight = 16)
+        : slots_(std::max(max_inflight, 1u)) {
+    }
+    ~TxnCoScheduler() {
+        for (auto& s : slots_)
+            delete s.txn;
+    }
+
+    // Queues a transaction; make() creates its body, once per attempt.
+    // Failures of transactions without a done callback are rethrown by
+    // run(), after every other transaction finished.
+    void spawn(body make, completion done = nullptr) {
+        queue_.push_back({std::move(make), std::move(done)});
+    }
+
+    // Runs every queued transaction to completion on this thread
+    void run();
+
+    stats statistics() const {
+        return stats_;
+    }
+
+    struct awaiter {
+        std::function<bool()> pred;
+
+        bool await_ready() {
+            return pred && pred();
+        }
+        void await_suspend(std::coroutine_handle<>) {
+            current_->wait = std::move(pred);
+            current_->waiting = true;
+        }
+        void await_resume() {
+        }
+    };
+    // Lets the other transactions in flight run
+    static awaiter yield() {
+        return {nullptr};
+    }
+    // Suspends until pred() is true; the scheduler polls it
+    static awaiter wait_until(std::function<bool()> pred) {
+        return {std::move(pred)};
+    }
+
+private:
+    struct job {
+        body make;
+        completion done;
+    };
+    struct slot {
+        Transaction* txn = nullptr;
+        bool active = false;
+        job j;
+        TxnCoroutine co;
+        std::function<bool()> wait;
+        bool waiting = false;
+    };
+
+    std::vector<slot> slots_;
+    std::deque<job> queue_;
+    unsigned inflight_ = 0;
+    stats stats_;
+    std::exception_ptr error_;
+    bool held_ = false;
+    threadinfo_t::epoch_type held_epoch_ = 0;
+
+    static inline thread_local slot* current_;
+
+    bool hold_stale() const {
+        return Transaction::global_epochs.global_epoch.load(std::memory_order_acquire) != held_epoch_;
+    }
+    void begin(slot& s);
+    // Resumes s's body, and commits it if it returned
+    void step(slot& s);
+    void finish(slot& s, std::exception_ptr error);
+};
+
+inline void TxnCoScheduler::run() {
+    Transaction* saved = TThread::txn;
+    always_assert(!saved || !saved->in_progress());
+    threadinfo_t& thr = Transaction::tinfo[TThread::id()];
+
+    while (!queue_.empty() || inflight_) {
+        bool progress = false;
+        for (auto& s : slots_) {
+            if (s.active || queue_.empty())
+                continue;
+            if (held_ && hold_stale())
+                break;
+            if (!held_) {
+                Transaction::hold_thread(thr);
+                held_ = true;
+                held_epoch_ = Transaction::global_epochs.global_epoch.load(std::memory_order_acquire);
+                ++stats_.holds;
+            }
+            s.j = std::move(queue_.front());
+            queue_.pop_front();
+            s.active = true;
+            ++inflight_;
+            begin(s);
+        }
+        for (auto& s : slots_)
+            if (s.active && (!s.waiting || !s.wait || s.wait())) {
+                step(s);
+                progress = true;
+            }
+        TThread::txn = saved;
+        if (!inflight_ && held_) {
+            Transaction::release_thread(thr);
+            held_ = false;
+        }
+        if (!progress)
+            std::this_thread::yield();
+    }
+
+    if (error_)
+        std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+inline void TxnCoScheduler::begin(slot& s) {
+    if (!s.txn) {
+        s.txn = new Transaction(false);
+        s.txn->in_batch_ = true;
+    }
+    s.co = s.j.make();
+    s.waiting = false;
+    s.wait = nullptr;
+    TThread::txn = s.txn;
+    s.txn->set_restarted(false);
+    s.txn->start();
+}
+
+inline void TxnCoScheduler::step(slot& s) {
+    TThread::txn = s.txn;
+    s.waiting = false;
+    current_ = &s;
+    s.co.h_.resume();
+    current_ = nullptr;
+    if (!s.co.h_.done()) {
+        ++stats_.suspensions;
+        return;
+    }
+
+    bool committed = false;
+    std::exception_ptr error = s.co.h_.promise().error;
+    try {
+        if (error)
+            std::rethrow_exception(error);
+        committed = s.txn->in_progress() && s.txn->try_commit();
+    } catch (Transaction::Abort&) {
+        error = nullptr;
+    } catch (...) {
+        error = std::current_exception();
+    }
+    if (s.txn->in_progress())
+        s.txn->silent_abort();
+    s.co = TxnCoroutine();
+    if (committed || error)
+        finish(s, error);
+    else {
+        ++stats_.aborts;
+        if (hold_stale()) {
+            // retry under a fresh hold, in case the old epoch caused the abort
+            queue_.push_front(std::move(s.j));
+            s.active = false;
+            --inflight_;
+        } else
+            begin(s);
+    }
+}
+
+inline void TxnCoScheduler::finish(slot& s, std::exception_ptr error) {
+    ++(error ? stats_.failed : stats_.committed);
+    job j = std::move(s.j);
+    s.active = false;
+    --inflight_;
+    if (j.done)
+        j.done(error);
+    else if (error && !error_)
+        error_ = error;
+}
+
+#endif
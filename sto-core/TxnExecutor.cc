@@ -0,0 +1,259 @@
+#include "TxnExecutor.hh"
+
+#include <algorithm>
+#include <random>
+#include "PlatformFeatures.hh"
+
+thread_local TxnExecutor* TxnExecutor::self_;
+thread_local int TxnExecutor::self_index_;
+
+TxnExecutor::TxnExecutor(const params& p)
+    : params_(p), workers_(std::max(p.nworkers, 1)), slots_(p.conflict_slots), next_worker_(0), submitted_(0),
+      outstanding_(0), generation_(0), sleeping_(0), quit_(false) {
+    params_.nworkers = workers_.size();
+    params_.min_backoff_us = std::max(params_.min_backoff_us, 1u);
+    params_.max_backoff_us = std::max(params_.max_backoff_us, params_.min_backoff_us);
+    always_assert(params_.first_thread_id + params_.nworkers <= MAX_THREADS);
+}
+
+TxnExecutor::~TxnExecutor() {
+    stop();
+}
+
+void TxnExecutor::start() {
+    assert(!workers_[0].thread.joinable());
+    for (int i = 0; i != params_.nworkers; ++i)
+        workers_[i].thread = std::thread(&TxnExecutor::run_worker, this, i);
+}
+
+void TxnExecutor::drain() {
+    always_assert(self_ != this, "drain() from a worker");
+    std::unique_lock<std::mutex> lk(idle_mu_);
+    drained_cv_.wait(lk, [&] { return outstanding_.load() == 0; });
+}
+
+void TxnExecutor::stop() {
+    if (!workers_[0].thread.joinable())
+        return;
+    drain();
+    {
+        std::lock_guard<std::mutex> lk(idle_mu_);
+        quit_ = true;
+    }
+    idle_cv_.notify_all();
+    for (auto& w : workers_)
+        w.thread.join();
+}
+
+TxnExecutor::stats TxnExecutor::statistics() const {
+    stats s;
+    s.submitted = submitted_.load(std::memory_order_relaxed);
+    for (auto& w : workers_) {
+        s.committed += w.committed.load(std::memory_order_relaxed);
+        s.failed += w.failed.load(std::memory_order_relaxed);
+        s.retries += w.retries.load(std::memory_order_relaxed);
+        s.steals += w.steals.load(std::memory_order_relaxed);
+        s.steered += w.steered.load(std::memory_order_relaxed);
+        s.rerouted += w.rerouted.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+void TxnExecutor::enqueue(std::function<outcome()> attempt, uint64_t key) {
+    ++submitted_;
+    ++outstanding_;
+    int i;
+    if (key)
+        i = worker_of(key);
+    else if (self_ == this)
+        i = self_index_;
+    else
+        i = next_worker_.fetch_add(1, std::memory_order_relaxed) % params_.nworkers;
+    push(i, job{std::move(attempt), key, 0, clock::time_point(), {}});
+}
+
+void TxnExecutor::enqueue(std::function<outcome()> attempt, const std::vector<uint64_t>& keys) {
+    if (slots_.empty()) {
+        enqueue(std::move(attempt), 0);
+        return;
+    }
+    // Steer by the most contended declared key, if any is contended
+    job j{std::move(attempt), 0, 0, clock::time_point(), {}};
+    uint32_t best = 0;
+    for (uint64_t k : keys) {
+        unsigned s = slot_of(k);
+        slot& sl = slots_[s];
+        uint32_t score = sl.inflight.fetch_add(1) + sl.heat.load(std::memory_order_relaxed);
+        if (score > best) {
+            best = score;
+            j.key = s + 1;
+        }
+        j.slots.push_back(s);
+    }
+    ++submitted_;
+    ++outstanding_;
+    int i;
+    if (j.key) {
+        i = worker_of(j.key);
+        workers_[i].steered.fetch_add(1, std::memory_order_relaxed);
+    } else if (self_ == this)
+        i = self_index_;
+    else
+        i = next_worker_.fetch_add(1, std::memory_order_relaxed) % params_.nworkers;
+    push(i, std::move(j));
+}
+
+int TxnExecutor::worker_of(uint64_t key) const {
+    return ((key * 0x9E3779B97F4A7C15ULL) >> 32) % params_.nworkers;
+}
+
+unsigned TxnExecutor::slot_of(uint64_t key) const {
+    return ((key * 0xC2B2AE3D27D4EB4FULL) >> 32) % slots_.size();
+}
+
+void TxnExecutor::push(int i, job j) {
+    worker& w = workers_[i];
+    {
+        std::lock_guard<std::mutex> lk(w.mu);
+        if (j.key)
+            w.keyed.push_back(std::move(j));
+        else
+            w.shared.push_back(std::move(j));
+    }
+    ++generation_;
+    wake();
+}
+
+void TxnExecutor::wake() {
+    // A worker going to sleep counts itself in sleeping_ before it checks
+    // generation_, and a push bumps generation_ before checking
+    // sleeping_, so one of them sees the other
+    if (sleeping_.load() == 0)
+        return;
+    std::lock_guard<std::mutex> lk(idle_mu_);
+    idle_cv_.notify_all();
+}
+
+bool TxnExecutor::take(int i, job& j, clock::time_point& next_due) {
+    worker& w = workers_[i];
+    {
+        std::lock_guard<std::mutex> lk(w.mu);
+        if (!w.waiting.empty()) {
+            if (w.waiting.front().due <= clock::now()) {
+                std::pop_heap(w.waiting.begin(), w.waiting.end(), later());
+                j = std::move(w.waiting.back());
+                w.waiting.pop_back();
+                return true;
+            }
+            next_due = w.waiting.front().due;
+        }
+        std::deque<job>* q = !w.keyed.empty() ? &w.keyed : &w.shared;
+        if (!q->empty()) {
+            j = std::move(q->front());
+            q->pop_front();
+            return true;
+        }
+    }
+    for (int k = 1; k != params_.nworkers; ++k) {
+        worker& v = workers_[(i + k) % params_.nworkers];
+        std::lock_guard<std::mutex> lk(v.mu);
+        if (!v.shared.empty()) {
+            j = std::move(v.shared.back());
+            v.shared.pop_back();
+            w.steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TxnExecutor::requeue(int i, job j) {
+    static thread_local std::minstd_rand rng(std::random_device{}());
+    unsigned shift = std::min(j.retries, 20u);
+    ++j.retries;
+    uint64_t backoff = std::min(uint64_t(params_.min_backoff_us) << shift,
+                                uint64_t(params_.max_backoff_us));
+    // somewhere in the upper half, so that retries of transactions that
+    // aborted together spread out
+    backoff = backoff - (rng() % (backoff / 2 + 1));
+    j.due = clock::now() + std::chrono::microseconds(backoff);
+    worker& w = workers_[i];
+    {
+        std::lock_guard<std::mutex> lk(w.mu);
+        w.waiting.push_back(std::move(j));
+        std::push_heap(w.waiting.begin(), w.waiting.end(), later());
+    }
+    // another worker has to notice the new due time
+    if (self_ != this || self_index_ != i) {
+        ++generation_;
+        wake();
+    }
+}
+
+void TxnExecutor::finished(job& j, bool committed) {
+    for (unsigned s : j.slots) {
+        slot& sl = slots_[s];
+        sl.inflight.fetch_sub(1);
+        if (!committed)
+            continue;
+        uint32_t h = sl.heat.load(std::memory_order_relaxed);
+        if (h)
+            sl.heat.store(h - (h + 7) / 8, std::memory_order_relaxed);
+    }
+    j.attempt = nullptr;
+    j.slots.clear();
+    if (--outstanding_ == 0) {
+        std::lock_guard<std::mutex> lk(idle_mu_);
+        drained_cv_.notify_all();
+    }
+}
+
+void TxnExecutor::run_worker(int i) {
+    worker& w = workers_[i];
+    self_ = this;
+    self_index_ = i;
+    TThread::set_id(params_.first_thread_id + i);
+    if (params_.pin)
+        set_affinity(i);
+    if (worker_init_)
+        worker_init_(i);
+
+    job j;
+    while (true) {
+        uint64_t seen = generation_.load();
+        clock::time_point next_due = clock::time_point::max();
+        if (take(i, j, next_due)) {
+            outcome o = j.attempt();
+            if (o == aborted) {
+                w.retries.fetch_add(1, std::memory_order_relaxed);
+                for (unsigned s : j.slots)
+                    slots_[s].heat.fetch_add(abort_heat, std::memory_order_relaxed);
+                int target = i;
+                const TObject* obj = TThread::txn->conflict_object();
+                if (!j.key && obj && !slots_.empty()) {
+                    uint64_t item = reinterpret_cast<uintptr_t>(obj) * 31 + TThread::txn->conflict_key();
+                    j.key = slot_of(item) + 1;
+                    target = worker_of(j.key);
+                    w.rerouted.fetch_add(1, std::memory_order_relaxed);
+                }
+                requeue(target, std::move(j));
+                continue;
+            }
+            (o == committed ? w.committed : w.failed).fetch_add(1, std::memory_order_relaxed);
+            finished(j, o == committed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(idle_mu_);
+        if (quit_)
+            break;
+        ++sleeping_;
+        auto ready = [&] { return quit_ || generation_.load() != seen; };
+        if (next_due == clock::time_point::max())
+            idle_cv_.wait(lk, ready);
+        else
+            idle_cv_.wait_until(lk, next_due, ready);
+        --sleeping_;
+    }
+    self_ = nullptr;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Sto.hh"
+
+// Runs transactions submitted from any thread on a pool of worker threads.
+//
+// submit(f) queues f, a transaction body: it runs one attempt inside a
+// transaction the worker opens, aborts it as a TRANSACTION_E body would
+// (TXN_DO_E, or throwing Transaction::Abort), and returns the
+// transaction's result. The future submit() returns gets that result once
+// an attempt commits. f may run several times, so it must reset anything
+// it changes outside the transaction. Any other exception f throws aborts
+// the transaction for good and goes to the future.
+//
+// Each worker has its own deque. Submissions from outside the pool go to
+// the workers round-robin, and a worker's own submissions to its deque; a
+// worker runs its jobs oldest first and, when it runs out, steals the
+// newest job of another. A transaction that aborts isn't retried in
+// place: it waits on its worker for a randomized, exponentially growing
+// backoff while the worker runs other jobs, then runs again.
+//
+// submit(f, key) with a nonzero key steers f to the worker key hashes to,
+// and such jobs are never stolen: transactions that would conflict on a
+// key run one at a time on one worker instead of aborting each other.
+//
+// Scheduling can also follow conflicts as they happen. submit(f, keys)
+// declares the keys f may conflict on (a TPC-C district, a YCSB row) and
+// steers f like submit(f, key) only while one of them is contended: while
+// another transaction declaring it hasn't finished, or while transactions
+// declaring it have recently aborted. Transactions on keys nobody else is
+// using run anywhere. And an unkeyed transaction that aborts on an item
+// it can name (the item ConflictProfile would count) is retried on the
+// worker that item hashes to, and stays there, so the retries of
+// transactions fighting over one hot item line up on one worker.
+// Declared keys and items share conflict_slots hash slots; 0 turns this
+// off.
+//
+// Workers run as TThread ids first_thread_id and up, pinned with
+// set_affinity(i) if pin is set.
+class TxnExecutor {
+public:
+    struct params {
+        int nworkers = 1;
+        int first_thread_id = 0;
+        bool pin = true;
+        unsigned min_backoff_us = 1;    // after the first abort
+        unsigned max_backoff_us = 1000;
+        unsigned conflict_slots = 4096;
+    };
+    struct stats {
+        uint64_t submitted = 0;
+        uint64_t committed = 0;
+        uint64_t failed = 0;            // threw something other than Abort
+        uint64_t retries = 0;           // aborted attempts, requeued
+        uint64_t steals = 0;
+        uint64_t steered = 0;           // declared keys were contended
+        uint64_t rerouted = 0;          // retried where they aborted
+    };
+
+    explicit TxnExecutor(const params& p);
+    // Waits for every submitted transaction (stop())
+    ~TxnExecutor();
+
+    // Runs f(i) on worker i before it runs transactions, e.g. to
+    // initialize tables for the thread
+    void on_worker_start(std::function<void(int)> f) {
+        worker_init_ = std::move(f);
+    }
+    void start();
+    // Waits until every transaction submitted so far has finished
+    void drain();
+    // Drains, then stops the workers
+    void stop();
+
+    template <typename F>
+    auto submit(F f, uint64_t key = 0) -> std::future<decltype(f())>;
+    template <typename F>
+    auto submit(F f, const std::vector<uint64_t>& keys) -> std::future<decltype(f())>;
+
+    int nworkers() const {
+        return params_.nworkers;
+    }
+    stats statistics() const;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    enum outcome { committed, aborted, failed };
+    struct job {
+        std::function<outcome()> attempt;
+        uint64_t key;
+        unsigned retries;
+        clock::time_point due;
+        std::vector<unsigned> slots;    // of declared keys
+    };
+    // A conflict slot counts the unfinished transactions declaring its
+    // keys, and its heat rises with their aborts and decays as they commit
+    struct slot {
+        std::atomic<uint32_t> inflight{0};
+        std::atomic<uint32_t> heat{0};
+    };
+    static constexpr uint32_t abort_heat = 8;
+    struct later {
+        bool operator()(const job& a, const job& b) const {
+            return a.due > b.due;
+        }
+    };
+    struct __attribute__((aligned(128))) worker {
+        std::mutex mu;
+        std::deque<job> shared;     // others may steal these
+        std::deque<job> keyed;      // these stay here
+        std::vector<job> waiting;   // aborted, a heap by due
+        std::thread thread;
+        std::atomic<uint64_t> committed{0};
+        std::atomic<uint64_t> failed{0};
+        std::atomic<uint64_t> retries{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> steered{0};
+        std::atomic<uint64_t> rerouted{0};
+    };
+
+    params params_;
+    std::vector<worker> workers_;
+    std::vector<slot> slots_;
+    std::function<void(int)> worker_init_;
+    std::atomic<unsigned> next_worker_;
+    std::atomic<uint64_t> submitted_;
+    std::atomic<uint64_t> outstanding_;
+    std::atomic<uint64_t> generation_;  // bumped by every push
+    std::atomic<int> sleeping_;
+    bool quit_;
+    std::mutex idle_mu_;
+    std::condition_variable idle_cv_;
+    std::condition_variable drained_cv_;
+
+    static thread_local TxnExecutor* self_;
+    static thread_local int self_index_;
+
+    void enqueue(std::function<outcome()> attempt, uint64_t key);
+    void enqueue(std::function<outcome()> attempt, const std::vector<uint64_t>& keys);
+    int worker_of(uint64_t key) const;
+    unsigned slot_of(uint64_t key) const;
+    void push(int i, job j);
+    void wake();
+    bool take(int i, job& j, clock::time_point& next_due);
+    void requeue(int i, job j);
+    void finished(job& j, bool committed);
+    void run_worker(int i);
+
+    template <typename F, typename R>
+    static outcome attempt(F& f, std::promise<R>& p);
+};
+
+template <typename F, typename R>
+TxnExecutor::outcome TxnExecutor::attempt(F& f, std::promise<R>& p) {
+    TransactionLoopGuard guard;
+    guard.start();
+    try {
+        if constexpr (std::is_void<R>::value) {
+            f();
+            if (!guard.try_commit())
+                throw Transaction::Abort();
+            p.set_value();
+        } else {
+            R r = f();
+            if (!guard.try_commit())
+                throw Transaction::Abort();
+            p.set_value(std::move(r));
+        }
+        return committed;
+    } catch (Transaction::Abort&) {
+        guard.silent_abort();
+        return aborted;
+    } catch (...) {
+        guard.silent_abort();
+        p.set_exception(std::current_exception());
+        return failed;
+    }
+}
+
+template <typename F>
+auto TxnExecutor::submit(F f, uint64_t key) -> std::future<decltype(f())> {
+    typedef decltype(f()) R;
+    auto p = std::make_shared<std::promise<R>>();
+    auto fut = p->get_future();
+    enqueue([f = std::move(f), p]() mutable {
+            return attempt(f, *p);
+        }, key);
+    return fut;
+}
+
+template <typename F>
+auto TxnExecutor::submit(F f, const std::vector<uint64_t>& keys) -> std::future<decltype(f())> {
+    typedef decltype(f()) R;
+    auto p = std::make_shared<std::promise<R>>();
+    auto fut = p->get_future();
+    enqueue([f = std::move(f), p]() mutable {
+            return attempt(f, *p);
+        }, keys);
+    return fut;
+}
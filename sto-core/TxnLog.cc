@@ -0,0 +1,673 @@
+#include "TxnLog.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#if HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+#include "AsyncIO.hh"
+#include "ServiceThreads.hh"
+#include "Transaction.hh"
+
+struct TxnLog::shipper {
+    int fd;
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<std::vector<char>> frames;
+    bool stopping = false;
+    std::atomic<bool> failed{false};
+    std::thread thread;
+};
+
+bool TxnLog::enabled_ = false;
+std::atomic<bool> TxnLog::stopping_;
+size_t TxnLog::buffer_size_ = TxnLog::default_buffer_size;
+TxnLog::thread_log TxnLog::logs_[MAX_THREADS];
+std::vector<TxnLog::logger*> TxnLog::loggers_;
+std::atomic<TxnLog::shipper*> TxnLog::shipper_;
+std::atomic<bool> TxnLog::compress_;
+static std::atomic<uint64_t> shipped_bytes_;
+static std::atomic<uint64_t> sent_bytes_;
+static std::atomic<uint64_t> logged_bytes_;
+static std::atomic<uint64_t> written_bytes_;
+
+bool TxnLog::start(const char* dir, int nloggers, size_t buffer_size) {
+    always_assert(!enabled_ && nloggers > 0);
+    for (int i = 0; i != nloggers; ++i) {
+        std::string path = std::string(dir) + "/log." + std::to_string(i);
+        logger* l = new logger;
+        l->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        loggers_.push_back(l);
+        if (l->fd < 0) {
+            for (logger* x : loggers_) {
+                if (x->fd >= 0)
+                    close(x->fd);
+                delete x;
+            }
+            loggers_.clear();
+            return false;
+        }
+    }
+    buffer_size_ = std::max(buffer_size, size_t(4096));
+    logged_bytes_.store(0, std::memory_order_relaxed);
+    written_bytes_.store(0, std::memory_order_relaxed);
+    Transaction::global_epochs.durable_epoch.store(0, std::memory_order_relaxed);
+    stopping_.store(false, std::memory_order_relaxed);
+    for (int i = 0; i != nloggers; ++i)
+        loggers_[i]->thread = std::thread(run_logger, i);
+    enabled_ = true;
+    return true;
+}
+
+void TxnLog::stop() {
+    if (!enabled_)
+        return;
+    for (auto& t : logs_) {
+        if (t.current().len)
+            handoff(t);
+        t.pending.store(0, std::memory_order_release);
+    }
+    stopping_.store(true, std::memory_order_release);
+    for (logger* l : loggers_)
+        l->thread.join();
+    update_durable();
+    if (shipper* s = shipper_.exchange(nullptr)) {
+        std::vector<char> end(sizeof(ship_header));
+        *reinterpret_cast<ship_header*>(end.data()) = {ship_end, uint32_t(loggers_.size()), 0, 0};
+        shipped_bytes_.fetch_add(end.size(), std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lk(s->mu);
+            s->frames.push_back(std::move(end));
+            s->stopping = true;
+        }
+        s->cv.notify_one();
+        s->thread.join();
+        delete s;
+    }
+    for (logger* l : loggers_) {
+        close(l->fd);
+        delete l;
+    }
+    loggers_.clear();
+    enabled_ = false;
+    // everything is durable now
+    for (auto& t : logs_)
+        fire_acks(t, ~epoch_type(0));
+    for (auto& t : logs_) {
+        for (auto& b : t.bufs) {
+            free(b.data);
+            b = buffer();
+        }
+        t.filled.store(0, std::memory_order_relaxed);
+        t.flushed.store(0, std::memory_order_relaxed);
+    }
+}
+
+void TxnLog::start_shipping(int fd) {
+    always_assert(enabled_ && !shipper_.load());
+    shipper* s = new shipper;
+    s->fd = fd;
+    shipped_bytes_.store(0, std::memory_order_relaxed);
+    sent_bytes_.store(0, std::memory_order_relaxed);
+    s->thread = std::thread(run_shipper, s);
+    shipper_.store(s, std::memory_order_release);
+}
+
+uint64_t TxnLog::shipped_bytes() {
+    return shipped_bytes_.load(std::memory_order_relaxed);
+}
+
+uint64_t TxnLog::sent_bytes() {
+    return sent_bytes_.load(std::memory_order_relaxed);
+}
+
+bool TxnLog::set_compression(bool on) {
+#if HAVE_LIBLZ4
+    compress_.store(on, std::memory_order_relaxed);
+    return true;
+#else
+    compress_.store(false, std::memory_order_relaxed);
+    return !on;
+#endif
+}
+
+uint64_t TxnLog::logged_bytes() {
+    return logged_bytes_.load(std::memory_order_relaxed);
+}
+
+uint64_t TxnLog::written_bytes() {
+    return written_bytes_.load(std::memory_order_relaxed);
+}
+
+void TxnLog::deflate(const char* p, size_t n, std::vector<char>& out) {
+#if HAVE_LIBLZ4
+    // in chunks, which bounds the blocks and keeps within LZ4's input limit
+    for (size_t off = 0; off < n; off += lz4_chunk) {
+        int len = std::min(n - off, lz4_chunk);
+        size_t at = out.size();
+        size_t head = sizeof(txn_header) + sizeof(lz4_header);
+        out.resize(at + head + pad(LZ4_compressBound(len)));
+        int c = LZ4_compress_default(p + off, &out[at + head], len, out.size() - at - head);
+        always_assert(c > 0);
+        memset(&out[at + head + c], 0, pad(c) - c);
+        out.resize(at + head + pad(c));
+        txn_header h = {rec_lz4, 0, 0, sizeof(lz4_header) + pad(c)};
+        lz4_header z = {uint64_t(len), uint64_t(c)};
+        memcpy(&out[at], &h, sizeof(h));
+        memcpy(&out[at + sizeof(h)], &z, sizeof(z));
+    }
+#else
+    (void) p, (void) n, (void) out;
+    always_assert(false, "built without liblz4");
+#endif
+}
+
+void TxnLog::inflate(std::vector<char>& data) {
+    std::vector<char> out;
+    out.reserve(data.size() * 2);
+    size_t pos = 0;
+    while (pos + sizeof(txn_header) <= data.size()) {
+        const txn_header* h = reinterpret_cast<const txn_header*>(&data[pos]);
+        size_t len = sizeof(txn_header) + h->length;
+        if (h->type != rec_lz4 || pos + len > data.size()) {
+            // copied as is; a torn record stops the reader anyway
+            out.insert(out.end(), &data[pos], &data[pos] + std::min(len, data.size() - pos));
+            pos += len;
+            continue;
+        }
+        lz4_header z;
+        if (h->length < sizeof(z))
+            break;
+        memcpy(&z, h + 1, sizeof(z));
+        if (z.compressed_length > h->length - sizeof(z) || z.raw_length > lz4_chunk)
+            break;
+#if HAVE_LIBLZ4
+        size_t at = out.size();
+        out.resize(at + z.raw_length);
+        int r = LZ4_decompress_safe(reinterpret_cast<const char*>(h + 1) + sizeof(z), &out[at],
+                                    z.compressed_length, z.raw_length);
+        if (r < 0 || size_t(r) != z.raw_length) {
+            out.resize(at);
+            break;
+        }
+#else
+        break;
+#endif
+        pos += len;
+    }
+    data.swap(out);
+}
+
+namespace {
+// Calls f(offset, length) for each run of 8-byte words that differ
+// between a and b. Runs one unchanged word apart merge, since a run
+// header costs as much as the word.
+template <typename F>
+void for_each_changed_run(const char* a, const char* b, size_t n, F f) {
+    auto differs = [&](size_t i) {
+        return memcmp(a + i, b + i, std::min(n - i, size_t(8))) != 0;
+    };
+    size_t i = 0;
+    while (i < n) {
+        if (!differs(i)) {
+            i += 8;
+            continue;
+        }
+        size_t start = i;
+        for (i += 8; i < n && (differs(i) || (i + 8 < n && differs(i + 8))); i += 8)
+            /* extend */;
+        i = std::min(i, n);
+        f(start, i - start);
+    }
+}
+}
+
+void TxnLog::append_delta(uint32_t object_id, const void* key, uint32_t keylen,
+                          const void* old_value, const void* value, uint32_t vallen, tid_type tid) {
+    const char* a = reinterpret_cast<const char*>(old_value);
+    const char* b = reinterpret_cast<const char*>(value);
+    size_t size = 0;
+    for_each_changed_run(a, b, vallen, [&](size_t, size_t len) {
+            size += sizeof(delta_run) + pad(len);
+        });
+    if (!size)
+        return;
+    if (size >= vallen) {
+        append(object_id, key, keylen, value, vallen, tid);
+        return;
+    }
+    char* p = append_header(object_id, key, keylen, size, write_delta, tid);
+    for_each_changed_run(a, b, vallen, [&](size_t off, size_t len) {
+            delta_run d = {uint32_t(off), uint32_t(len)};
+            memcpy(p, &d, sizeof(d));
+            memcpy(p + sizeof(d), b + off, len);
+            memset(p + sizeof(d) + len, 0, pad(len) - len);
+            p += sizeof(d) + pad(len);
+        });
+}
+
+bool TxnLog::apply_delta(const record& r, void* value, size_t vallen) {
+    const char* p = r.value;
+    const char* e = r.value + r.vallen;
+    while (p != e) {
+        delta_run d;
+        if (size_t(e - p) < sizeof(d))
+            return false;
+        memcpy(&d, p, sizeof(d));
+        p += sizeof(d);
+        if (d.offset > vallen || d.length > vallen - d.offset || pad(d.length) > size_t(e - p))
+            return false;
+        memcpy(reinterpret_cast<char*>(value) + d.offset, p, d.length);
+        p += pad(d.length);
+    }
+    return true;
+}
+
+void TxnLog::grow(buffer& b, size_t need) {
+    size_t cap = std::max(std::max(b.cap * 2, buffer_size_), need);
+    b.data = reinterpret_cast<char*>(realloc(b.data, cap));
+    always_assert(b.data);
+    b.cap = cap;
+}
+
+void TxnLog::handoff(thread_log& t) {
+    uint64_t f = t.filled.load(std::memory_order_relaxed) + 1;
+    t.filled.store(f, std::memory_order_release);
+    t.pending.store(0, std::memory_order_release);
+    while (f - t.flushed.load(std::memory_order_acquire) >= nbuffers)
+        std::this_thread::yield();
+    t.bufs[f % nbuffers].len = 0;
+}
+
+void TxnLog::flush_thread() {
+    if (!enabled())
+        return;
+    thread_log& t = logs_[TThread::id()];
+    if (t.current().len)
+        handoff(t);
+}
+
+void TxnLog::poll() {
+    thread_log& t = logs_[TThread::id()];
+    buffer& b = t.current();
+    if (b.len && b.epoch < Transaction::global_epochs.global_epoch.load(std::memory_order_relaxed))
+        handoff(t);
+    t.last_logged = false;
+    if (!t.acks.empty())
+        fire_acks(t, durable_epoch());
+}
+
+void TxnLog::on_durable(std::function<void()> f) {
+    thread_log& t = logs_[TThread::id()];
+    // a commit that logged nothing read state installed no later than the
+    // current epoch
+    epoch_type e = t.last_logged ? t.last_epoch
+        : Transaction::global_epochs.global_epoch.load(std::memory_order_acquire);
+    t.acks.push_back({e, std::move(f)});
+}
+
+void TxnLog::fire_durable() {
+    fire_acks(logs_[TThread::id()], durable_epoch());
+}
+
+void TxnLog::fire_acks(thread_log& t, epoch_type durable) {
+    while (!t.acks.empty() && t.acks.front().epoch <= durable) {
+        auto f = std::move(t.acks.front().f);
+        t.acks.pop_front();
+        f();
+    }
+}
+
+void TxnLog::begin_txn() {
+    thread_log& t = logs_[TThread::id()];
+    auto& global_epoch = Transaction::global_epochs.global_epoch;
+    epoch_type e = global_epoch.load(std::memory_order_acquire);
+    if (t.current().len && t.current().epoch < e)
+        handoff(t);
+    if (!t.pending.load(std::memory_order_relaxed)) {
+        // A logger that sees no pending epoch read the global epoch before
+        // this store, so no newer than the reload below
+        t.pending.store(e, std::memory_order_seq_cst);
+        e = global_epoch.load(std::memory_order_seq_cst);
+    }
+    buffer& b = t.current();
+    if (b.len + sizeof(txn_header) > b.cap)
+        grow(b, b.len + sizeof(txn_header));
+    if (!b.len)
+        b.epoch = e;
+    t.txn_start = b.len;
+    t.txn_records = 0;
+    txn_header* h = reinterpret_cast<txn_header*>(b.data + b.len);
+    h->type = rec_txn;
+    h->nrecords = 0;
+    h->epoch = e;
+    h->length = 0;
+    b.len += sizeof(txn_header);
+}
+
+static bool send_all(int fd, const char* p, size_t n) {
+    while (n) {
+        // a replica that hung up fails the send instead of raising SIGPIPE
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == ENOTSOCK)
+            w = write(fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= w;
+    }
+    return true;
+}
+
+void TxnLog::ship(std::vector<char>&& frame) {
+    shipper* s = shipper_.load(std::memory_order_acquire);
+    if (s->failed.load(std::memory_order_relaxed))
+        return;
+    shipped_bytes_.fetch_add(frame.size(), std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lk(s->mu);
+        s->frames.push_back(std::move(frame));
+    }
+    s->cv.notify_one();
+}
+
+void TxnLog::run_shipper(shipper* s) {
+    ServiceThreads::scope service("log shipper");
+    std::unique_lock<std::mutex> lk(s->mu);
+    while (true) {
+        s->cv.wait(lk, [s] { return !s->frames.empty() || s->stopping; });
+        if (s->frames.empty())
+            return;
+        std::vector<char> frame = std::move(s->frames.front());
+        s->frames.pop_front();
+        lk.unlock();
+        if (!s->failed.load(std::memory_order_relaxed)) {
+            if (send_all(s->fd, frame.data(), frame.size()))
+                sent_bytes_.fetch_add(frame.size(), std::memory_order_relaxed);
+            else
+                s->failed.store(true, std::memory_order_relaxed);
+        }
+        lk.lock();
+    }
+}
+
+void TxnLog::run_logger(int i) {
+    ServiceThreads::scope service("logger");
+    logger& l = *loggers_[i];
+    int n = loggers_.size();
+    epoch_type written = 0;
+    // a round's writes and its sync go to the kernel in one batch
+    AsyncIO io;
+    off_t offset = 0;
+    auto queue_write = [&] (const char* p, size_t len) {
+        io.write(l.fd, p, len, offset);
+        offset += len;
+    };
+    std::vector<uint64_t> filled(MAX_THREADS);
+    while (true) {
+        bool stopping = stopping_.load(std::memory_order_acquire);
+        epoch_type g = Transaction::global_epochs.global_epoch.load(std::memory_order_seq_cst);
+        // once stopped, nothing is in flight
+        epoch_type bound = stopping ? g : g - 1;
+        bool any = false;
+        // with a replica, the round is also copied into a frame; when
+        // compressing, the frame collects the round as it will be written
+        bool shipping = shipper_.load(std::memory_order_acquire) != nullptr;
+        bool compress = compress_.load(std::memory_order_relaxed);
+        std::vector<char> frame;
+        if (shipping)
+            frame.resize(sizeof(ship_header));
+        size_t head = frame.size();
+        uint64_t raw = 0;
+        for (int t = i; t < MAX_THREADS; t += n) {
+            thread_log& tl = logs_[t];
+            epoch_type p = tl.pending.load(std::memory_order_seq_cst);
+            if (p && p - 1 < bound)
+                bound = p - 1;
+            filled[t] = tl.filled.load(std::memory_order_acquire);
+            for (uint64_t k = tl.flushed.load(std::memory_order_relaxed); k != filled[t]; ++k) {
+                const buffer& b = tl.bufs[k % nbuffers];
+                if (compress)
+                    deflate(b.data, b.len, frame);
+                else {
+                    queue_write(b.data, b.len);
+                    if (shipping)
+                        frame.insert(frame.end(), b.data, b.data + b.len);
+                }
+                raw += b.len;
+                any = true;
+            }
+        }
+        txn_header marker = {rec_epoch, 0, bound, 0};
+        if (bound > written) {
+            if (!compress)
+                queue_write(reinterpret_cast<const char*>(&marker), sizeof(marker));
+            if (shipping || compress)
+                frame.insert(frame.end(), reinterpret_cast<const char*>(&marker),
+                             reinterpret_cast<const char*>(&marker + 1));
+            raw += sizeof(marker);
+            any = true;
+        }
+        if (compress)
+            queue_write(frame.data() + head, frame.size() - head);
+        logged_bytes_.fetch_add(raw, std::memory_order_relaxed);
+        written_bytes_.fetch_add(compress ? frame.size() - head : raw, std::memory_order_relaxed);
+        // group commit: one sync covers every buffer of the round, and
+        // the buffers stay the logger's until it completes
+        if (any) {
+            io.sync(l.fd);
+            always_assert(io.flush(), "log write failed");
+        }
+        // only durable rounds reach the replica
+        if (shipping && any) {
+            auto now = std::chrono::system_clock::now().time_since_epoch();
+            *reinterpret_cast<ship_header*>(frame.data()) = {
+                uint32_t(i), uint32_t(n), frame.size() - sizeof(ship_header),
+                uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count())
+            };
+            ship(std::move(frame));
+        }
+        for (int t = i; t < MAX_THREADS; t += n)
+            logs_[t].flushed.store(filled[t], std::memory_order_release);
+        if (bound > written) {
+            written = bound;
+            l.durable.store(bound, std::memory_order_release);
+            update_durable();
+        }
+        if (stopping)
+            return;
+        if (!any)
+            usleep(1000);
+    }
+}
+
+void TxnLog::update_durable() {
+    epoch_type e = ~epoch_type(0);
+    for (logger* l : loggers_)
+        e = std::min(e, l->durable.load(std::memory_order_acquire));
+    auto& durable = Transaction::global_epochs.durable_epoch;
+    epoch_type cur = durable.load(std::memory_order_relaxed);
+    while (cur < e && !durable.compare_exchange_weak(cur, e, std::memory_order_release))
+        /* retry */;
+}
+
+unsigned TxnLog::partition(const write_header* w, unsigned nparts) {
+    // FNV-1a over object id and key
+    uint64_t h = 14695981039346656037ULL ^ w->object_id;
+    const unsigned char* k = reinterpret_cast<const unsigned char*>(w + 1);
+    for (uint32_t i = 0; i != w->keylen; ++i)
+        h = (h ^ k[i]) * 1099511628211ULL;
+    return (h ^ (h >> 32)) % nparts;
+}
+
+namespace {
+struct log_file {
+    std::string path;
+    std::vector<char> data;
+    std::vector<size_t> txns;   // offsets of complete transaction records
+    uint64_t last = 0;          // last epoch marker
+};
+
+bool read_file(const std::string& path, std::vector<char>& data) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    off_t size = lseek(fd, 0, SEEK_END);
+    data.resize(size > 0 ? size : 0);
+    size_t pos = 0;
+    while (pos != data.size()) {
+        ssize_t r = pread(fd, &data[pos], data.size() - pos, pos);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        pos += r;
+    }
+    data.resize(pos);
+    close(fd);
+    return true;
+}
+
+template <typename F>
+void run_threads(int nthreads, F f) {
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nthreads; ++i)
+        threads.emplace_back([&f, i] {
+            TThread::set_id(i);
+            f(i);
+        });
+    f(0);
+    for (auto& t : threads)
+        t.join();
+}
+}
+
+TxnLog::epoch_type TxnLog::recover(const char* dir, const std::function<void(const record&)>& f,
+                                   epoch_type from_epoch) {
+    return recover(dir, 1, [&f](const record& r, int) { f(r); }, from_epoch).durable;
+}
+
+TxnLog::recovery_stats TxnLog::recover(const char* dir, int nthreads,
+                                       const std::function<void(const record&, int)>& f,
+                                       epoch_type from_epoch) {
+    recovery_stats stats;
+    auto start = std::chrono::steady_clock::now();
+    nthreads = std::max(nthreads, 1);
+
+    std::vector<log_file> files;
+    if (DIR* d = opendir(dir)) {
+        while (struct dirent* de = readdir(d))
+            if (strncmp(de->d_name, "log.", 4) == 0)
+                files.push_back({std::string(dir) + "/" + de->d_name, {}, {}, 0});
+        closedir(d);
+    }
+    if (files.empty())
+        return stats;
+
+    // Read the files in parallel, indexing each one's transactions. The
+    // walk only follows record lengths; parsing waits for the split below.
+    std::atomic<size_t> next_file(0);
+    std::atomic<uint64_t> stats_bytes(0);
+    run_threads(std::min(nthreads, int(files.size())), [&](int) {
+        size_t i;
+        while ((i = next_file.fetch_add(1)) < files.size()) {
+            log_file& lf = files[i];
+            read_file(lf.path, lf.data);
+            stats_bytes.fetch_add(lf.data.size(), std::memory_order_relaxed);
+            size_t pos = 0;
+            bool inflated = false;
+            while (pos + sizeof(txn_header) <= lf.data.size()) {
+                const txn_header* h = reinterpret_cast<const txn_header*>(&lf.data[pos]);
+                if (h->type == rec_lz4 && !inflated) {
+                    // walk the file again as it was logged
+                    inflate(lf.data);
+                    inflated = true;
+                    lf.txns.clear();
+                    lf.last = 0;
+                    pos = 0;
+                    continue;
+                }
+                if (h->type == rec_epoch)
+                    lf.last = h->epoch;
+                else if (h->type != rec_txn || pos + sizeof(txn_header) + h->length > lf.data.size())
+                    break;
+                else
+                    lf.txns.push_back(pos);
+                pos += sizeof(txn_header) + h->length;
+            }
+        }
+    });
+
+    // the durable epoch is the lowest of the loggers' last markers; a
+    // round torn by a crash is ignored
+    epoch_type durable = ~epoch_type(0);
+    size_t ntxns = 0;
+    stats.bytes = stats_bytes.load();
+    for (auto& lf : files) {
+        durable = std::min(durable, lf.last);
+        ntxns += lf.txns.size();
+    }
+
+    // Each thread parses an equal share of the transactions into one
+    // bucket per partition, in log order
+    std::vector<std::vector<std::vector<record>>> buckets(nthreads);
+    run_threads(nthreads, [&](int t) {
+        auto& mine = buckets[t];
+        mine.resize(nthreads);
+        size_t first = ntxns * t / nthreads, last = ntxns * (t + 1) / nthreads;
+        size_t base = 0;
+        for (auto& lf : files) {
+            size_t b = std::max(first, base), e = std::min(last, base + lf.txns.size());
+            for (size_t i = b; i < e; ++i) {
+                const txn_header* h = reinterpret_cast<const txn_header*>(&lf.data[lf.txns[i - base]]);
+                if (h->epoch < from_epoch || h->epoch > durable)
+                    continue;
+                const char* p = reinterpret_cast<const char*>(h + 1);
+                for (uint32_t k = 0; k != h->nrecords; ++k) {
+                    const write_header* w = reinterpret_cast<const write_header*>(p);
+                    const char* key = p + sizeof(write_header);
+                    mine[partition(w, nthreads)].push_back({w->object_id, key, w->keylen,
+                                                            key + pad(w->keylen), w->vallen,
+                                                            w->tid, h->epoch, w->flags});
+                    p += sizeof(write_header) + pad(w->keylen) + pad(w->vallen);
+                }
+            }
+            base += lf.txns.size();
+        }
+    });
+
+    // Thread i owns partition i: gather it, order it by version, apply
+    std::atomic<uint64_t> nrecords(0);
+    run_threads(nthreads, [&](int t) {
+        std::vector<record> records;
+        size_t n = 0;
+        for (auto& b : buckets)
+            n += b[t].size();
+        records.reserve(n);
+        for (auto& b : buckets) {
+            records.insert(records.end(), b[t].begin(), b[t].end());
+            std::vector<record>().swap(b[t]);
+        }
+        std::stable_sort(records.begin(), records.end(), [](const record& a, const record& b) {
+            return a.tid < b.tid;
+        });
+        for (auto& r : records)
+            f(r, t);
+        nrecords.fetch_add(records.size());
+    });
+
+    stats.durable = durable;
+    stats.records = nrecords.load();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Compile in the commit-path logging hooks; they still log nothing until
+// TxnLog::start()
+#ifndef STO_LOGGING
+#define STO_LOGGING 1
+#endif
+
+// Redo logging of committed writes, in the style of SiloR.
+//
+// Objects opt in per instance (e.g. TBox::set_log_id) and, in install(),
+// append each write's object id, key, new value and installed version
+// through Transaction::log_write. Those records go to a buffer owned by
+// the committing thread, framed as one transaction record tagged with the
+// epoch the transaction read while it held its locks. Nothing on the
+// commit path writes shared memory: a thread hands a full buffer (or one
+// from an older epoch) to its logger by bumping its own counter, and only
+// waits if the logger has fallen a whole ring of buffers behind.
+//
+// Each logger thread serves the worker threads congruent to its index,
+// writing their buffers to its own file, <dir>/log.<i>, and fsyncing once
+// per round for all of them (group commit); the round's writes and sync go
+// to the kernel as one AsyncIO batch. A round ends with an epoch
+// marker: every transaction of an epoch at or below it, on any of the
+// logger's threads, is on disk. durable_epoch() is the minimum over the
+// loggers. The epoch advancer (Transaction::epoch_advancer) must be
+// running for the watermark to move, and a thread that stops committing
+// should call flush_thread() (wait_durable() does) so its last partial
+// buffer does not hold the watermark back.
+//
+// Commits are acknowledged asynchronously: on_durable() queues a callback
+// on the committing thread, which runs it at a later transaction start
+// once Transaction::global_epochs.durable_epoch passes the commit's epoch.
+// Workers never wait for the disk; one fsync acknowledges every commit of
+// the epochs it covers.
+//
+// recover() replays the records of epochs at or below the durable
+// epoch, ordered by version; a version orders the writes to one key, so
+// replay can be split across threads by key.
+//
+// With set_compression(true), each logger compresses the buffers of its
+// round with LZ4 before writing them; epoch markers stay uncompressed.
+// recover() and LogReplica inflate compressed blocks as they read them,
+// so a log may mix both forms.
+//
+// start_shipping() also streams the log to a read replica (LogReplica):
+// each logger copies its round into a queue, and a sender thread writes
+// the copies out, so shipping costs the loggers one copy and the commit
+// path nothing.
+class TxnLog {
+public:
+    typedef uint64_t epoch_type;
+    typedef uint64_t tid_type;
+
+    // Kinds of logged write (record::flags)
+    enum { write_delta = 1, write_delete = 2 };
+
+    // One logged write, as passed to recover()'s callback. A delta record
+    // (append_delta) holds only the changed parts of the value; patch the
+    // key's current value with apply_delta(). A delete has no value.
+    struct record {
+        uint32_t object_id;
+        const char* key;
+        uint32_t keylen;
+        const char* value;
+        uint32_t vallen;
+        tid_type tid;
+        epoch_type epoch;
+        uint32_t flags;
+
+        bool is_delta() const {
+            return flags & write_delta;
+        }
+        bool is_delete() const {
+            return flags & write_delete;
+        }
+    };
+
+    // Starts nloggers logger threads writing to dir, with per-thread
+    // buffers of buffer_size bytes; false if a log file can't be created
+    static bool start(const char* dir, int nloggers = 1, size_t buffer_size = default_buffer_size);
+    // Makes everything logged so far durable and stops the loggers. Call
+    // while no thread commits.
+    static void stop();
+    static bool enabled() {
+        return STO_LOGGING && enabled_;
+    }
+
+    // Streams the log to a LogReplica reading the other end of fd,
+    // typically a connected socket; fd stays open. Call after start() and
+    // before the transactions to ship commit; stop() ends the stream. If
+    // fd fails, shipping stops and logging goes on.
+    static void start_shipping(int fd);
+    // Bytes handed to the sender so far, and bytes written to fd
+    static uint64_t shipped_bytes();
+    static uint64_t sent_bytes();
+
+    // Compresses logger rounds from the next round on; false, leaving the
+    // log uncompressed, if built without liblz4
+    static bool set_compression(bool on);
+    static bool compression() {
+        return compress_.load(std::memory_order_relaxed);
+    }
+    // Bytes of log produced since start(), and bytes written for them
+    static uint64_t logged_bytes();
+    static uint64_t written_bytes();
+
+    // Every transaction committed in an epoch at or below this is durable
+    // (Transaction::global_epochs.durable_epoch; defined in Transaction.hh)
+    static inline epoch_type durable_epoch();
+    // The epoch the calling thread's last logged transaction committed in
+    static epoch_type last_epoch() {
+        return logs_[TThread::id()].last_epoch;
+    }
+    // Waits until epoch e is durable, first handing off the calling
+    // thread's partial buffer
+    static void wait_durable(epoch_type e) {
+        flush_thread();
+        while (durable_epoch() < e)
+            std::this_thread::yield();
+    }
+    // Hands the calling thread's partial buffer to its logger
+    static void flush_thread();
+
+    // While logging, calls f on this thread once the calling thread's last
+    // committed transaction is durable. Callbacks run in commit order, from poll()
+    // at a later transaction start, from fire_durable(), or from stop().
+    static void on_durable(std::function<void()> f);
+    // Runs the calling thread's callbacks whose commits are durable; for
+    // threads that have stopped committing
+    static void fire_durable();
+
+    // Replays the durable records of the logs in dir in increasing version
+    // order, skipping epochs before from_epoch (a checkpoint's start
+    // epoch); returns the durable epoch, or 0 if dir has no logs
+    static epoch_type recover(const char* dir, const std::function<void(const record&)>& f,
+                              epoch_type from_epoch = 0);
+
+    struct recovery_stats {
+        epoch_type durable = 0;
+        uint64_t bytes = 0;     // of log read
+        uint64_t records = 0;   // replayed
+        double seconds = 0;
+        double gbps() const {
+            return seconds > 0 ? bytes / seconds / 1e9 : 0;
+        }
+    };
+    // recover() on nthreads threads. The logs are read and parsed in
+    // parallel, and records are partitioned by a hash of object id and key,
+    // so all writes to a key replay on one thread, in version order: the
+    // last writer wins without any synchronization between threads. f(r, i)
+    // runs on thread i; thread 0 is the caller, and the others run with
+    // TThread id i.
+    static recovery_stats recover(const char* dir, int nthreads,
+                                  const std::function<void(const record&, int)>& f,
+                                  epoch_type from_epoch = 0);
+
+    static constexpr size_t default_buffer_size = 1 << 20;
+
+    // Commit path, called by Transaction. begin_txn opens a transaction
+    // record once the commit holds its locks; end_txn closes it after
+    // install, and abort_txn drops it.
+    static void begin_txn();
+    static void append(uint32_t object_id, const void* key, uint32_t keylen,
+                       const void* value, uint32_t vallen, tid_type tid) {
+        char* p = append_header(object_id, key, keylen, vallen, 0, tid);
+        memcpy(p, value, vallen);
+    }
+    // A write that changed old_value, vallen bytes, into value. Only the
+    // 8-byte words that differ are logged, as runs of changed words, so
+    // a one-column update of a wide row logs that column; falls back to a
+    // whole-value record when the runs would be no smaller.
+    static void append_delta(uint32_t object_id, const void* key, uint32_t keylen,
+                             const void* old_value, const void* value, uint32_t vallen, tid_type tid);
+    static void append_delete(uint32_t object_id, const void* key, uint32_t keylen, tid_type tid) {
+        append_header(object_id, key, keylen, 0, write_delete, tid);
+    }
+    // Patches value, vallen bytes long, with delta record r; false if r
+    // doesn't fit it
+    static bool apply_delta(const record& r, void* value, size_t vallen);
+    static void end_txn() {
+        thread_log& t = logs_[TThread::id()];
+        buffer& b = t.current();
+        txn_header* h = reinterpret_cast<txn_header*>(b.data + t.txn_start);
+        if (!t.txn_records)
+            b.len = t.txn_start;
+        else {
+            h->nrecords = t.txn_records;
+            h->length = b.len - t.txn_start - sizeof(txn_header);
+            t.last_epoch = h->epoch;
+            t.last_logged = true;
+        }
+        if (b.len >= b.cap / 2)
+            handoff(t);
+        else if (!b.len)
+            t.pending.store(0, std::memory_order_release);
+    }
+    static void abort_txn() {
+        thread_log& t = logs_[TThread::id()];
+        t.current().len = t.txn_start;
+        if (!t.current().len)
+            t.pending.store(0, std::memory_order_release);
+    }
+    // Hands off a buffer left behind by an older epoch and runs durable
+    // callbacks; called when a transaction starts
+    static void poll();
+
+private:
+    enum { rec_txn = 1, rec_epoch = 2, rec_lz4 = 3 };
+
+    struct txn_header {
+        uint32_t type;
+        uint32_t nrecords;
+        epoch_type epoch;
+        uint64_t length;      // bytes of write records that follow
+    };
+    struct write_header {
+        uint32_t object_id;
+        uint32_t keylen;
+        uint32_t vallen;
+        uint32_t flags;
+        tid_type tid;
+    };
+    // A compressed block (rec_lz4) of log, which inflates to records and
+    // markers; follows a txn_header whose length counts this header and
+    // the padded compressed bytes
+    struct lz4_header {
+        uint64_t raw_length;
+        uint64_t compressed_length;
+    };
+    static constexpr size_t lz4_chunk = 1 << 22;
+    // A run of changed bytes in a delta record, followed by the bytes
+    struct delta_run {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // A shipped frame: one logger's round as written to its file, or the
+    // end of the stream
+    struct ship_header {
+        uint32_t logger;
+        uint32_t nloggers;
+        uint64_t length;      // bytes of log that follow
+        uint64_t sent_ns;     // the primary's wall clock at the end of the round
+    };
+    static constexpr uint32_t ship_end = ~uint32_t(0);
+    struct shipper;
+
+    struct buffer {
+        char* data = nullptr;
+        size_t len = 0;
+        size_t cap = 0;
+        epoch_type epoch = 0;  // of its first transaction
+    };
+
+    static constexpr unsigned nbuffers = 4;
+
+    struct ack {
+        epoch_type epoch;
+        std::function<void()> f;
+    };
+
+    // Buffers [flushed, filled) belong to the logger; buffer filled (mod
+    // nbuffers) is the one the worker is filling
+    struct __attribute__((aligned(128))) thread_log {
+        buffer bufs[nbuffers];
+        std::atomic<uint64_t> filled;
+        std::atomic<uint64_t> flushed;
+        // Oldest epoch this thread may still log into a buffer not yet
+        // handed off, or 0
+        std::atomic<epoch_type> pending;
+        size_t txn_start;
+        unsigned txn_records;
+        epoch_type last_epoch;
+        bool last_logged;      // the last commit wrote a transaction record
+        std::deque<ack> acks;  // in commit, so epoch, order
+
+        buffer& current() {
+            return bufs[filled.load(std::memory_order_relaxed) % nbuffers];
+        }
+    };
+
+    struct __attribute__((aligned(128))) logger {
+        int fd = -1;
+        std::atomic<epoch_type> durable{0};
+        std::thread thread;
+    };
+
+    static bool enabled_;
+    static std::atomic<bool> stopping_;
+    static size_t buffer_size_;
+    static thread_log logs_[MAX_THREADS];
+    static std::vector<logger*> loggers_;
+    static std::atomic<shipper*> shipper_;
+    static std::atomic<bool> compress_;
+
+    static size_t pad(size_t n) {
+        return (n + 7) & ~size_t(7);
+    }
+    // Appends a write record's header and key; returns where its vallen
+    // bytes of value go
+    static char* append_header(uint32_t object_id, const void* key, uint32_t keylen,
+                               uint32_t vallen, uint32_t flags, tid_type tid) {
+        thread_log& t = logs_[TThread::id()];
+        size_t need = sizeof(write_header) + pad(keylen) + pad(vallen);
+        buffer& b = t.current();
+        if (unlikely(b.len + need > b.cap))
+            grow(b, b.len + need);
+        write_header* w = reinterpret_cast<write_header*>(b.data + b.len);
+        w->object_id = object_id;
+        w->keylen = keylen;
+        w->vallen = vallen;
+        w->flags = flags;
+        w->tid = tid;
+        char* p = b.data + b.len + sizeof(write_header);
+        memcpy(p, key, keylen);
+        // zero the padding, which compresses and leaks nothing
+        memset(p + keylen, 0, pad(keylen) - keylen);
+        memset(p + pad(keylen) + vallen, 0, pad(vallen) - vallen);
+        b.len += need;
+        ++t.txn_records;
+        return p + pad(keylen);
+    }
+    static void grow(buffer& b, size_t need);
+    // Appends n bytes of log at p to out as rec_lz4 blocks
+    static void deflate(const char* p, size_t n, std::vector<char>& out);
+    // Replaces the rec_lz4 blocks in data with what they inflate to. A
+    // block that doesn't inflate ends data, as a torn record would.
+    static void inflate(std::vector<char>& data);
+    static void handoff(thread_log& t);
+    static void run_logger(int i);
+    static void update_durable();
+    static void fire_acks(thread_log& t, epoch_type durable);
+    static unsigned partition(const write_header* w, unsigned nparts);
+    static void ship(std::vector<char>&& frame);
+    static void run_shipper(shipper* s);
+
+    friend class LogReplica;
+};
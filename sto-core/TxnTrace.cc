@@ -0,0 +1,186 @@
+#include "TxnTrace.hh"
+
+#include <algorithm>
+#include <vector>
+#include "PlatformFeatures.hh"
+
+bool TxnTrace::enabled_ = false;
+size_t TxnTrace::capacity_ = TxnTrace::default_events;
+TxnTrace::ring TxnTrace::rings_[MAX_THREADS + 1];
+const char* TxnTrace::dump_path_ = nullptr;
+volatile sig_atomic_t TxnTrace::dump_requested_ = 0;
+
+void TxnTrace::enable(size_t events_per_thread) {
+    size_t cap = 1;
+    while (cap < events_per_thread)
+        cap <<= 1;
+    capacity_ = cap;
+    enabled_ = true;
+}
+
+void TxnTrace::allocate(ring& r) {
+    r.mask = capacity_ - 1;
+    r.buf = new event[capacity_];
+}
+
+void TxnTrace::clear() {
+    for (auto& r : rings_)
+        r.head.store(0, std::memory_order_relaxed);
+}
+
+namespace {
+
+// Open slices on one thread, so the dump can close them at tr_stop and
+// skip ends whose begins were overwritten
+struct slice_stack {
+    const char* open[3];
+    int n = 0;
+
+    bool top_is(const char* name) const {
+        return n && open[n - 1] == name;
+    }
+};
+
+const char rcu_name[] = "rcu_cleanup";
+const char lock_name[] = "lock";
+const char check_name[] = "check";
+
+void emit(FILE* f, bool& first, int tid, const char* name, char ph, double us,
+          const char* args = nullptr) {
+    fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s%s%s}",
+            first ? "" : ",\n", name, ph, us, tid, ph == 'i' ? ",\"s\":\"t\"" : "",
+            args ? ",\"args\":" : "", args ? args : "");
+    first = false;
+}
+
+void begin(FILE* f, bool& first, int tid, slice_stack& s, const char* name, double us) {
+    if (s.n == 3)
+        return;
+    s.open[s.n++] = name;
+    emit(f, first, tid, name, 'B', us);
+}
+
+void end(FILE* f, bool& first, int tid, slice_stack& s, double us, const char* args = nullptr) {
+    if (s.n)
+        emit(f, first, tid, s.open[--s.n], 'E', us, args);
+}
+
+}
+
+bool TxnTrace::dump(FILE* f) {
+    // copy each ring, dropping what a running writer overwrote meanwhile
+    std::vector<std::vector<event>> copies(MAX_THREADS + 1);
+    uint64_t t0 = ~uint64_t(0);
+    for (int t = 0; t != MAX_THREADS + 1; ++t) {
+        ring& r = rings_[t];
+        uint64_t h = r.head.load(std::memory_order_acquire);
+        if (!h)
+            continue;
+        uint64_t from = h > r.mask + 1 ? h - r.mask - 1 : 0;
+        auto& c = copies[t];
+        for (uint64_t i = from; i != h; ++i)
+            c.push_back(r.buf[i & r.mask]);
+        uint64_t h1 = r.head.load(std::memory_order_acquire);
+        if (h1 > r.mask + 1 && h1 - r.mask - 1 > from)
+            c.erase(c.begin(), c.begin() + std::min(h1 - r.mask - 1 - from, uint64_t(c.size())));
+        if (!c.empty())
+            t0 = std::min(t0, c.front().tsc);
+    }
+
+    double ticks_per_us = tsc_frequency() * 1000;
+    bool first = true;
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    char args[64];
+    for (int t = 0; t != MAX_THREADS + 1; ++t) {
+        if (copies[t].empty())
+            continue;
+        snprintf(args, sizeof(args), "{\"name\":\"%s %d\"}",
+                 t == MAX_THREADS ? "epoch advancer" : "thread", t);
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":%s}",
+                first ? "" : ",\n", t, args);
+        first = false;
+
+        slice_stack s;
+        for (const event& e : copies[t]) {
+            double us = (e.tsc - t0) / ticks_per_us;
+            uint64_t arg = e.type_arg & ((uint64_t(1) << arg_bits) - 1);
+            switch (e.type_arg >> arg_bits) {
+            case tr_start:
+                while (s.n)
+                    end(f, first, t, s, us);
+                begin(f, first, t, s, "txn", us);
+                break;
+            case tr_rcu_begin:
+                begin(f, first, t, s, rcu_name, us);
+                break;
+            case tr_rcu_end:
+                if (s.top_is(rcu_name))
+                    end(f, first, t, s, us);
+                break;
+            case tr_commit:
+                begin(f, first, t, s, "commit", us);
+                begin(f, first, t, s, lock_name, us);
+                break;
+            case tr_check:
+                if (s.top_is(lock_name))
+                    end(f, first, t, s, us);
+                begin(f, first, t, s, check_name, us);
+                break;
+            case tr_install:
+                if (s.top_is(lock_name) || s.top_is(check_name))
+                    end(f, first, t, s, us);
+                begin(f, first, t, s, "install", us);
+                break;
+            case tr_lock_fail:
+            case tr_check_fail:
+                snprintf(args, sizeof(args), "{\"object\":\"0x%llx\"}", (unsigned long long) arg);
+                emit(f, first, t, e.type_arg >> arg_bits == tr_lock_fail ? "lock_fail" : "check_fail",
+                     'i', us, args);
+                break;
+            case tr_stop:
+                snprintf(args, sizeof(args), "{\"committed\":%s}", arg ? "true" : "false");
+                while (s.n > 1)
+                    end(f, first, t, s, us);
+                end(f, first, t, s, us, args);
+                break;
+            case tr_epoch_advance:
+                snprintf(args, sizeof(args), "{\"epoch\":%llu}", (unsigned long long) arg);
+                emit(f, first, t, "epoch_advance", 'i', us, args);
+                break;
+            }
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return !ferror(f);
+}
+
+bool TxnTrace::dump(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return false;
+    bool ok = dump(f);
+    return fclose(f) == 0 && ok;
+}
+
+void TxnTrace::request_dump(int) {
+    dump_requested_ = 1;
+}
+
+void TxnTrace::dump_on_signal(int signo, const char* path) {
+    dump_path_ = path;
+    struct sigaction sa = {};
+    sa.sa_handler = request_dump;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(signo, &sa, nullptr);
+}
+
+void TxnTrace::poll_dump() {
+    if (!dump_requested_ || !dump_path_)
+        return;
+    dump_requested_ = 0;
+    if (dump(dump_path_))
+        fprintf(stderr, "Trace written to %s\n", dump_path_);
+    else
+        fprintf(stderr, "Can't write trace to %s\n", dump_path_);
+}
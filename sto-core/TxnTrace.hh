@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Compile in the lifecycle tracepoints; they still record nothing until
+// TxnTrace::enable()
+#ifndef STO_TRACE
+#define STO_TRACE 1
+#endif
+
+// Transaction lifecycle events recorded by TxnTrace
+enum TraceEvents {
+    tr_start = 0,       // Transaction::start
+    tr_rcu_begin,       // RCU cleanup in start
+    tr_rcu_end,
+    tr_commit,          // try_commit, entering the lock phase
+    tr_check,           // locks held, entering read validation
+    tr_install,         // validated, entering installs
+    tr_lock_fail,       // commit aborted while locking; arg is the object
+    tr_check_fail,      // commit aborted in validation; arg is the object
+    tr_stop,            // Transaction::stop; arg is 1 if committed
+    tr_epoch_advance,   // epoch advancer; arg is the new global epoch
+    tr_count
+};
+
+// Per-thread ring buffers of fixed-size lifecycle events, for finding
+// which thread and which phase a latency spike came from.
+//
+// Each thread writes only its own ring, so recording is a TSC read and a
+// 16-byte store; the oldest events are overwritten once a ring is full.
+// The epoch advancer, which has no thread id of its own, writes a separate
+// ring. dump() writes every ring as Chrome trace JSON (chrome://tracing,
+// ui.perfetto.dev): a "txn" slice per attempt, nested "rcu_cleanup" and
+// "commit" slices, "lock", "check" and "install" inside commit, and
+// instants for failures and epoch advances. Dumping while threads run is
+// allowed; events overwritten during the copy are dropped.
+class TxnTrace {
+public:
+    // Starts recording, with rings of at least events_per_thread events
+    // (rounded up to a power of two), allocated on each thread's first
+    // event. Rings already allocated keep their size.
+    static void enable(size_t events_per_thread = default_events);
+    static void disable() {
+        enabled_ = false;
+    }
+    static bool enabled() {
+        return STO_TRACE && enabled_;
+    }
+
+    static void record(TraceEvents type, uint64_t arg = 0) {
+        if (enabled())
+            append(rings_[TThread::id()], type, arg);
+    }
+    static void record(TraceEvents type, const void* arg) {
+        record(type, reinterpret_cast<uintptr_t>(arg));
+    }
+    // For the epoch advancer thread only
+    static void record_global(TraceEvents type, uint64_t arg = 0) {
+        if (enabled())
+            append(rings_[MAX_THREADS], type, arg);
+    }
+
+    // Chrome trace JSON of every ring's events; false if f had an error
+    static bool dump(FILE* f);
+    static bool dump(const char* path);
+    // Discards recorded events; call while no thread records
+    static void clear();
+
+    // Makes signal signo request a dump to path. The handler only sets a
+    // flag; the epoch advancer writes the dump on its next cycle (or call
+    // poll_dump from any thread that runs periodically).
+    static void dump_on_signal(int signo, const char* path);
+    static void poll_dump();
+
+    static constexpr size_t default_events = 1 << 16;
+
+private:
+    struct event {
+        uint64_t tsc;
+        uint64_t type_arg;    // type in the top 8 bits, arg below
+    };
+    static constexpr int arg_bits = 56;
+
+    struct __attribute__((aligned(128))) ring {
+        event* buf;
+        size_t mask;
+        std::atomic<uint64_t> head;   // events ever written
+    };
+
+    static bool enabled_;
+    static size_t capacity_;
+    static ring rings_[MAX_THREADS + 1];
+    static const char* dump_path_;
+    static volatile sig_atomic_t dump_requested_;
+
+    static void append(ring& r, TraceEvents type, uint64_t arg) {
+        if (unlikely(!r.buf))
+            allocate(r);
+        uint64_t h = r.head.load(std::memory_order_relaxed);
+        event& e = r.buf[h & r.mask];
+        e.tsc = read_tsc();
+        e.type_arg = (uint64_t(type) << arg_bits) | (arg & ((uint64_t(1) << arg_bits) - 1));
+        r.head.store(h + 1, std::memory_order_release);
+    }
+    static void allocate(ring& r);
+    static void request_dump(int);
+};
@@ -16,12 +16,13 @@ public:
     // Common layout definition
 
     // |-----VALUE-----|O|D|U|N|L|--MASK--|
-    //       52 bits    1 1 1 1 1  7 bits
+    //   59-W bits      1 1 1 1 1  W bits
 
-    static constexpr signed_type mask_width = 7;
+    // W is 7 for MAX_THREADS <= 128 and grows with it (see TThread.hh)
+    static constexpr signed_type mask_width = thread_id_width;
 
     // bits holding thread id of the thread holding the exclusive lock
-    static constexpr type threadid_mask = type(0x7F);
+    static constexpr type threadid_mask = type((0x1 << mask_width) - 1);
     // the exclusive lock bit, used for write locks
     static constexpr type lock_bit = type(0x1 << mask_width);
     // Used for data structures that don't use opacity. When they increment
@@ -410,7 +411,7 @@ public:
     }
 
     template <typename Exception>
-    static inline void opaque_throw(const Exception& exception) {
+    [[noreturn]] static inline void opaque_throw(const Exception& exception) {
         throw exception;
     }
 
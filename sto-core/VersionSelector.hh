@@ -1,5 +1,6 @@
 #pragma once
 
+#include "CellVersions.hh"
 #include "MVCC.hh"
 #include "VersionBase.hh"
 
@@ -16,6 +17,10 @@ template <typename T, typename VersImpl>
 class VerSelBase {
 public:
     typedef VersImpl version_type;
+    // Hash index nodes of the row keep its versions ahead of the key
+    // (see bench::uindex_elem_fields). Generated selectors turn this on
+    // for rows with several groups, whose hot group comes first.
+    static constexpr bool versions_first = false;
 
     constexpr static int map(int col_n) {
         return T::map_impl(col_n);
@@ -81,8 +86,14 @@ public:
     using Selector::map;
     using Selector::version_at;
     using Selector::num_versions;
+    using Selector::versions_first;
     typedef commutators::Commutator<RowType> comm_type;
 
+    // Cells past 0 share one TransItem per row (see CellVersions.hh)
+    static constexpr bool cell_bitmap = STO_CELL_BITMAP && (num_versions > 1)
+                                        && cell_versions::supported<VersImpl>::value;
+    static_assert(!cell_bitmap || num_versions <= 64, "too many cells for a cell bitmap");
+
     IndexValueContainer(type v, const RowType& r) : Selector(v), row(r) {}
     IndexValueContainer(type v, bool insert, const RowType& r) : Selector(v, insert), row(r) {}
 
@@ -0,0 +1,184 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "grouping.hpp"
+
+static size_t field_bytes(const FieldType &t) {
+    switch (t.tname) {
+    case BigInt:
+        return 8;
+    case SmallInt:
+    case Float:
+        return 4;
+    case VarChar:
+        return t.len + 1;
+    case Char:
+        return t.len;
+    }
+    return 0;
+}
+
+bool read_profile(const char *filename, AccessProfile &profile) {
+    std::ifstream in(filename);
+    if (!in.good()) {
+        std::cerr << "Error: cannot open profile " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string tag, name;
+        size_t n;
+        if (!(ls >> tag >> name >> n) || tag != "row") {
+            std::cerr << "Error: bad profile line \"" << line << "\"" << std::endl;
+            return false;
+        }
+        size_t colons = name.rfind("::");
+        if (colons != std::string::npos)
+            name = name.substr(colons + 2);
+        auto &patterns = profile[name];
+        for (size_t i = 0; i < n; ++i) {
+            AccessPattern p;
+            if (!std::getline(in, line)) {
+                std::cerr << "Error: profile of " << name << " is truncated" << std::endl;
+                return false;
+            }
+            std::istringstream ps(line);
+            if (!(ps >> std::dec >> p.count >> std::hex >> p.read >> p.write)) {
+                std::cerr << "Error: bad profile line \"" << line << "\"" << std::endl;
+                return false;
+            }
+            patterns.push_back(p);
+        }
+    }
+    return true;
+}
+
+namespace {
+
+class GroupCost {
+public:
+    GroupCost(const StructSpec &spec, const std::vector<AccessPattern> &patterns,
+              const GroupingCosts &costs)
+        : costs_(costs) {
+        auto &fields = spec.fields;
+        uint64_t all = fields.size() >= 64 ? ~uint64_t(0) : (uint64_t(1) << fields.size()) - 1;
+        double total = 0;
+        for (auto &p : patterns)
+            total += p.count;
+        for (auto &p : patterns) {
+            uint64_t read = p.read & all, write = p.write & all;
+            if (!p.count || !(read | write))
+                continue;
+            if ((p.read | p.write) & ~all)
+                std::cerr << "Warning: profile of " << spec.struct_name
+                          << " names columns past its last field" << std::endl;
+            weights_.push_back(p.count / total);
+            touched_.push_back(read | write);
+            written_.push_back(write);
+        }
+        row_bytes_ = 0;
+        for (auto &f : fields) {
+            bytes_.push_back(field_bytes(f.t));
+            row_bytes_ += bytes_.back();
+        }
+    }
+
+    double operator()(uint64_t group) const {
+        double group_bytes = 0;
+        for (size_t i = 0; i < bytes_.size(); ++i)
+            if (group & (uint64_t(1) << i))
+                group_bytes += bytes_[i];
+        double access_cost = costs_.cell + costs_.bytes * group_bytes / row_bytes_;
+
+        double c = 0;
+        for (size_t p = 0; p < weights_.size(); ++p) {
+            if (!(group & touched_[p]))
+                continue;
+            c += weights_[p] * access_cost;
+            for (size_t q = 0; q < weights_.size(); ++q)
+                if ((group & written_[q]) && !(group & written_[q] & touched_[p]))
+                    c += weights_[p] * weights_[q] * costs_.false_conflict;
+        }
+        return c;
+    }
+
+private:
+    const GroupingCosts &costs_;
+    std::vector<double> weights_;
+    std::vector<uint64_t> touched_;
+    std::vector<uint64_t> written_;
+    std::vector<double> bytes_;
+    double row_bytes_;
+};
+
+// Agglomerative grouping: every field starts alone, and the pair of groups
+// whose merge lowers the cost the most is merged until no merge helps.
+// The cost is a sum over groups, so a merge only changes its own terms.
+// Merges that cost nothing are taken, which gathers unused fields into one
+// cold group.
+std::vector<uint64_t> best_groups(const StructSpec &spec, const std::vector<AccessPattern> &patterns,
+                                  const GroupingCosts &costs) {
+    GroupCost cost(spec, patterns, costs);
+    std::vector<uint64_t> groups;
+    std::vector<double> group_costs;
+    for (size_t i = 0; i < spec.fields.size(); ++i) {
+        groups.push_back(uint64_t(1) << i);
+        group_costs.push_back(cost(groups.back()));
+    }
+
+    const double epsilon = 1e-12;
+    while (groups.size() > 1) {
+        size_t best_a = 0, best_b = 0;
+        double best_delta = 0, best_cost = 0;
+        bool found = false;
+        for (size_t a = 0; a < groups.size(); ++a)
+            for (size_t b = a + 1; b < groups.size(); ++b) {
+                double merged = cost(groups[a] | groups[b]);
+                double delta = merged - group_costs[a] - group_costs[b];
+                if (delta <= epsilon && (!found || delta < best_delta - epsilon)) {
+                    best_a = a;
+                    best_b = b;
+                    best_delta = delta;
+                    best_cost = merged;
+                    found = true;
+                }
+            }
+        if (!found)
+            break;
+        groups[best_a] |= groups[best_b];
+        group_costs[best_a] = best_cost;
+        groups.erase(groups.begin() + best_b);
+        group_costs.erase(group_costs.begin() + best_b);
+    }
+    return groups;
+}
+
+} // namespace
+
+size_t regroup(std::vector<StructSpec> &specs, const AccessProfile &profile,
+               const GroupingCosts &costs) {
+    size_t n = 0;
+    for (auto &spec : specs) {
+        auto it = profile.find(spec.struct_name);
+        if (it == profile.end())
+            continue;
+        if (spec.fields.size() > 64) {
+            std::cerr << "Warning: " << spec.struct_name << " has more than 64 fields, not regrouped" << std::endl;
+            continue;
+        }
+        // groups come out in order of their first field, as does each
+        // group's field list
+        spec.groups.clear();
+        for (auto g : best_groups(spec, it->second, costs)) {
+            std::vector<std::string> names;
+            for (size_t i = 0; i < spec.fields.size(); ++i)
+                if (g & (uint64_t(1) << i))
+                    names.push_back(spec.fields[i].name);
+            spec.groups.push_back(names);
+        }
+        ++n;
+    }
+    return n;
+}
@@ -0,0 +1,43 @@
+#ifndef __GROUPING_HPP__
+#define __GROUPING_HPP__ 1
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "parser.tab.hh"
+
+// One line of a column access profile written by a benchmark built with
+// PROFILE_COLUMNS=1 (benchmark/DB_column_profile.hh): count row accesses
+// read the columns in read and wrote those in write. Bit i names the i-th
+// field of the struct's spec, so the spec must list fields in NamedColumn
+// order.
+struct AccessPattern {
+    uint64_t count;
+    uint64_t read;
+    uint64_t write;
+};
+
+// Access patterns by unqualified row type name
+typedef std::map<std::string, std::vector<AccessPattern>> AccessProfile;
+
+// Relative weights of the grouping cost, per recorded row access: each
+// cell touched costs a version check, reading a cell costs its share of
+// the row's bytes, and a cell written by one access and touched by another
+// that shares no written column with it costs a false conflict, which is
+// the most expensive since it aborts a whole transaction.
+struct GroupingCosts {
+    double cell = 1.0;
+    double bytes = 1.0;
+    double false_conflict = 8.0;
+};
+
+bool read_profile(const char *filename, AccessProfile &profile);
+
+// Replaces the groups of every spec that has patterns in profile with the
+// grouping of least cost. Returns the number of specs regrouped.
+size_t regroup(std::vector<StructSpec> &specs, const AccessProfile &profile,
+               const GroupingCosts &costs = GroupingCosts());
+
+#endif /* END __GROUPING_HPP__ */
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
@@ -11,6 +12,7 @@
 #include <set>
 
 #include "driver.hpp"
+#include "grouping.hpp"
 
 const std::string TName_str[] = {"int64_t", "int32_t", "float", "var_string", "fix_string"};
 
@@ -129,6 +131,28 @@ bool type_check_single(StructSpec &result) {
     assert(group_fname_set.size() == field_name_set.size());
     assert(group_fname_set.size() == gfields);
 
+    std::set<std::string> commute_fname_set;
+    for (auto& c : result.commutes) {
+        auto f = std::find_if(fields.begin(), fields.end(), [&](const Field& f) { return f.name == c.field; });
+        if (f == fields.end()) {
+            std::cerr << "Error: Struct " << struct_name << " has a field \"" << c.field << "\" commuted but undeclared" << std::endl;
+            return false;
+        }
+        if (!commute_fname_set.insert(c.field).second) {
+            std::cerr << "Error: Struct " << struct_name << " has a field \"" << c.field << "\" commuted more than once" << std::endl;
+            return false;
+        }
+        bool numeric = f->t.tname == BigInt || f->t.tname == SmallInt || f->t.tname == Float;
+        if (c.op == Append ? f->t.tname != VarChar : !numeric) {
+            std::cerr << "Error: Struct " << struct_name << " has a field \"" << c.field << "\" of the wrong type for its commutative operation" << std::endl;
+            return false;
+        }
+        if ((c.op == BoundedAdd && c.lo > c.hi) || (c.op == Append && c.lo <= 0)) {
+            std::cerr << "Error: Struct " << struct_name << " has a field \"" << c.field << "\" with bad commutative operation bounds" << std::endl;
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -164,8 +188,20 @@ void generate_code_single_struct(StructSpec &result) {
     }
     ss << " };" << std::endl << std::endl;
 
-    for (auto& f : fields)
-        ss << idt << cxx_type_name(f.t) << ' ' << f.name << ';' << std::endl;
+    // With several groups, members go group by group, the hot group 0
+    // first: it then shares the index node's first cache line with the
+    // versions (versions_first), and the cold groups follow. Column
+    // numbers keep the @fields order.
+    if (result.groups.size() > 1) {
+        for (auto& g : result.groups)
+            for (auto& fn : g)
+                for (auto& f : fields)
+                    if (f.name == fn)
+                        ss << idt << cxx_type_name(f.t) << ' ' << f.name << ';' << std::endl;
+    } else {
+        for (auto& f : fields)
+            ss << idt << cxx_type_name(f.t) << ' ' << f.name << ';' << std::endl;
+    }
     ss << "};" << std::endl;
 
     ss << std::endl;
@@ -185,12 +221,15 @@ void generate_code_single_versel(StructSpec &result) {
     ss << "class VerSel<" << struct_name << ", VersImpl> : public VerSelBase<VerSel<" << struct_name << ", VersImpl>, VersImpl> {" << std::endl;
     ss << "public:" << std::endl;
     ss << idt << "typedef VersImpl version_type;" << std::endl;
-    ss << idt << "static constexpr size_t num_versions = " << groups.size() << ';' << std::endl << std::endl;
+    ss << idt << "static constexpr size_t num_versions = " << groups.size() << ';' << std::endl;
+    if (groups.size() > 1)
+        ss << idt << "static constexpr bool versions_first = true;" << std::endl;
+    ss << std::endl;
 
     ss << idt << "explicit VerSel(type v) : vers_() { (void)v; }" << std::endl;
     ss << idt << "VerSel(type v, bool insert) : vers_() { (void)v; (void)insert; }" << std::endl << std::endl;
 
-    ss << idt << "static int map_impl(int col_n) {" << std::endl;
+    ss << idt << "constexpr static int map_impl(int col_n) {" << std::endl;
     ss << idt << idt << "uint64_t mask = ~(~0ul << vidx_width) ;" << std::endl;
     ss << idt << idt << "int shift = col_n * vidx_width;" << std::endl;
     ss << idt << idt << "return static_cast<int>((col_cell_map & (mask << shift)) >> shift);" << std::endl;
@@ -247,26 +286,302 @@ void generate_code(std::vector<StructSpec> &result) {
     std::cout << "}; // namespace ver_sel" << std::endl;
 }
 
+std::string spec_type_name(const FieldType& t) {
+    static const std::string names[] = {"BIGINT", "SMALLINT", "FLOAT", "VARCHAR", "CHAR"};
+    std::stringstream ss;
+    ss << names[t.tname];
+    if (t.tname == VarChar || t.tname == Char)
+        ss << '(' << t.len << ')';
+    return ss.str();
+}
+
+std::string commute_spec_name(const Commute& c) {
+    static const std::string names[] = {"ADD", "MIN", "MAX", "BOUNDED_ADD", "APPEND"};
+    std::stringstream ss;
+    ss << c.field << '(' << names[c.op];
+    if (c.op == BoundedAdd)
+        ss << '(' << c.lo << ", " << c.hi << ')';
+    else if (c.op == Append)
+        ss << '(' << c.lo << ')';
+    ss << ')';
+    return ss.str();
+}
+
+// Prints specs back in the input format, e.g. after regrouping
+void generate_specs(std::vector<StructSpec> &result) {
+    for (auto &spec : result) {
+        std::stringstream ss;
+        ss << "@@@" << std::endl;
+        ss << "@name: " << spec.struct_name << std::endl;
+        ss << "@fields: {";
+        for (size_t i = 0; i < spec.fields.size(); ++i) {
+            if (i != 0)
+                ss << ',' << ((i % 3) ? " " : "\n          ");
+            ss << spec.fields[i].name << '(' << spec_type_name(spec.fields[i].t) << ')';
+        }
+        ss << '}' << std::endl;
+        ss << "@groups: {";
+        for (size_t i = 0; i < spec.groups.size(); ++i) {
+            if (i != 0)
+                ss << ",\n          ";
+            ss << '{';
+            for (size_t j = 0; j < spec.groups[i].size(); ++j)
+                ss << (j ? ", " : "") << spec.groups[i][j];
+            ss << '}';
+        }
+        ss << '}' << std::endl;
+        if (!spec.commutes.empty()) {
+            ss << "@commute: {";
+            for (size_t i = 0; i < spec.commutes.size(); ++i)
+                ss << (i ? ", " : "") << commute_spec_name(spec.commutes[i]);
+            ss << '}' << std::endl;
+        }
+        ss << "@@@" << std::endl;
+        std::cout << ss.str() << std::endl;
+    }
+}
+
+// Split structs, SplitParams and SplitRecordAccessor specializations for
+// the MVCC split layout, in the form of benchmark/*_split_params_ts.hh.
+// Split i of row type T is the struct T_split<i>, declared in namespace ns
+// next to T. RecordAccessor and UniRecordAccessor don't depend on the
+// layout and are left to the existing file.
+void generate_split_params_single(StructSpec &result, const std::string &ns) {
+    std::stringstream ss;
+    const std::string idt = "  ";
+    const std::string row = ns + "::" + result.struct_name;
+    auto& groups = result.groups;
+    auto split_name = [&](size_t i) {
+        std::stringstream n;
+        n << ns << "::" << result.struct_name << "_split" << i;
+        return n.str();
+    };
+    auto field_type = [&](const std::string &fn) {
+        for (auto &f : result.fields)
+            if (f.name == fn)
+                return cxx_type_name(f.t);
+        assert(false);
+        return std::string();
+    };
+
+    ss << "template <>" << std::endl;
+    ss << "struct SplitParams<" << row << "> {" << std::endl;
+    ss << idt << "using split_type_list = std::tuple<";
+    for (size_t i = 0; i < groups.size(); ++i)
+        ss << (i ? ", " : "") << split_name(i);
+    ss << ">;" << std::endl;
+    ss << idt << "using layout_type = typename SplitMvObjectBuilder<split_type_list>::type;" << std::endl;
+    ss << idt << "static constexpr size_t num_splits = std::tuple_size<split_type_list>::value;" << std::endl << std::endl;
+
+    ss << idt << "static constexpr auto split_builder = std::make_tuple(" << std::endl;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        ss << idt << idt << "[](const " << row << "& in) -> " << split_name(i) << " {" << std::endl;
+        ss << idt << idt << idt << split_name(i) << " out;" << std::endl;
+        for (auto &fn : groups[i])
+            ss << idt << idt << idt << "out." << fn << " = in." << fn << ';' << std::endl;
+        ss << idt << idt << idt << "return out;" << std::endl;
+        ss << idt << idt << '}' << (i + 1 < groups.size() ? "," : "") << std::endl;
+    }
+    ss << idt << ");" << std::endl << std::endl;
+
+    ss << idt << "static constexpr auto split_merger = std::make_tuple(" << std::endl;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        ss << idt << idt << "[](" << row << "* out, const " << split_name(i) << "& in) -> void {" << std::endl;
+        for (auto &fn : groups[i])
+            ss << idt << idt << idt << "out->" << fn << " = in." << fn << ';' << std::endl;
+        ss << idt << idt << '}' << (i + 1 < groups.size() ? "," : "") << std::endl;
+    }
+    ss << idt << ");" << std::endl << std::endl;
+
+    ss << idt << "static constexpr auto map = [](int col_n) -> int {" << std::endl;
+    ss << idt << idt << "switch (col_n) {" << std::endl;
+    for (size_t i = 1; i < groups.size(); ++i) {
+        for (auto &fn : groups[i]) {
+            size_t col = 0;
+            while (result.fields[col].name != fn)
+                ++col;
+            ss << idt << idt << "case " << col << ":" << std::endl;
+        }
+        ss << idt << idt << idt << "return " << i << ';' << std::endl;
+    }
+    ss << idt << idt << "default:" << std::endl;
+    ss << idt << idt << idt << "return 0;" << std::endl;
+    ss << idt << idt << '}' << std::endl;
+    ss << idt << "};" << std::endl;
+    ss << "};" << std::endl << std::endl;
+
+    ss << "template <>" << std::endl;
+    ss << "class SplitRecordAccessor<" << row << "> : public RecordAccessor<SplitRecordAccessor<"
+       << row << ">, " << row << "> {" << std::endl;
+    ss << " public:" << std::endl;
+    ss << idt << "static constexpr size_t num_splits = SplitParams<" << row << ">::num_splits;" << std::endl << std::endl;
+    ss << idt << "SplitRecordAccessor(const std::array<void*, num_splits>& vptrs)" << std::endl;
+    ss << idt << idt << ": ";
+    for (size_t i = 0; i < groups.size(); ++i)
+        ss << (i ? ", " : "") << "vptr_" << i << "_(reinterpret_cast<" << split_name(i) << "*>(vptrs[" << i << "]))";
+    ss << " {}" << std::endl << std::endl;
+    ss << " private:" << std::endl;
+    for (size_t i = 0; i < groups.size(); ++i)
+        for (auto &fn : groups[i]) {
+            ss << idt << "const " << field_type(fn) << "& " << fn << "_impl() const {" << std::endl;
+            ss << idt << idt << "return vptr_" << i << "_->" << fn << ';' << std::endl;
+            ss << idt << '}' << std::endl << std::endl;
+        }
+    ss << idt << "void copy_into_impl(" << row << "* dst) const {" << std::endl;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        ss << idt << idt << "if (vptr_" << i << "_) {" << std::endl;
+        for (auto &fn : groups[i])
+            ss << idt << idt << idt << "dst->" << fn << " = vptr_" << i << "_->" << fn << ';' << std::endl;
+        ss << idt << idt << '}' << std::endl;
+    }
+    ss << idt << '}' << std::endl << std::endl;
+    for (size_t i = 0; i < groups.size(); ++i)
+        ss << idt << "const " << split_name(i) << "* vptr_" << i << "_;" << std::endl;
+    ss << std::endl;
+    ss << idt << "friend RecordAccessor<SplitRecordAccessor<" << row << ">, " << row << ">;" << std::endl;
+    ss << "};" << std::endl;
+    std::cout << ss.str() << std::endl;
+}
+
+void generate_split_params(std::vector<StructSpec> &result, const std::string &ns) {
+    const std::string idt = "    ";
+    std::cout << "#pragma once" << std::endl << std::endl;
+    std::cout << "// The following code is automatically generated by Hao & Yihe's parser/codegen"  << std::endl;
+    std::cout << "// Please do not manually modify!" << std::endl << std::endl;
+
+    std::cout << "namespace " << ns << " {" << std::endl << std::endl;
+    for (auto &spec : result)
+        for (size_t i = 0; i < spec.groups.size(); ++i) {
+            std::cout << "struct " << spec.struct_name << "_split" << i << " {" << std::endl;
+            for (auto &fn : spec.groups[i])
+                for (auto &f : spec.fields)
+                    if (f.name == fn)
+                        std::cout << idt << cxx_type_name(f.t) << ' ' << fn << ';' << std::endl;
+            std::cout << "};" << std::endl << std::endl;
+        }
+    std::cout << "} // namespace " << ns << std::endl << std::endl;
+
+    std::cout << "namespace bench {" << std::endl << std::endl;
+    for (auto &spec : result)
+        generate_split_params_single(spec, ns);
+    std::cout << "} // namespace bench" << std::endl;
+}
+
+// ColumnTraits specializations for projections (benchmark/DB_projection.hh)
+// of every field of the row types in namespace ns
+void generate_column_traits(std::vector<StructSpec> &result, const std::string &ns) {
+    const std::string idt = "  ";
+    std::cout << "#pragma once" << std::endl << std::endl;
+    std::cout << "// The following code is automatically generated by Hao & Yihe's parser/codegen"  << std::endl;
+    std::cout << "// Please do not manually modify!" << std::endl << std::endl;
+
+    std::cout << "namespace bench {" << std::endl << std::endl;
+    for (auto &spec : result) {
+        const std::string row = ns + "::" + spec.struct_name;
+        for (auto &f : spec.fields) {
+            std::stringstream ss;
+            ss << "template <>" << std::endl;
+            ss << "struct ColumnTraits<" << row << ", " << row << "::NamedColumn::" << f.name << "> {" << std::endl;
+            ss << idt << "typedef " << cxx_type_name(f.t) << " type;" << std::endl;
+            ss << idt << "static const type& get(const " << row << "& r) {" << std::endl;
+            ss << idt << idt << "return r." << f.name << ';' << std::endl;
+            ss << idt << '}' << std::endl;
+            ss << idt << "template <typename A>" << std::endl;
+            ss << idt << "static const type& get(const RecordAccessor<A, " << row << ">& a) {" << std::endl;
+            ss << idt << idt << "return a." << f.name << "();" << std::endl;
+            ss << idt << '}' << std::endl;
+            ss << "};" << std::endl;
+            std::cout << ss.str() << std::endl;
+        }
+    }
+    std::cout << "} // namespace bench" << std::endl;
+}
+
+// Commutator specializations (sto-core/ColumnCommutators.hh) for the row
+// types in namespace ns that have @commute fields
+void generate_commutators(std::vector<StructSpec> &result, const std::string &ns) {
+    const std::string idt = "    ";
+    static const std::string ops[] = {"col_add", "col_min", "col_max", "col_bounded_add", "col_append"};
+    std::cout << "#pragma once" << std::endl << std::endl;
+    std::cout << "// The following code is automatically generated by Hao & Yihe's parser/codegen"  << std::endl;
+    std::cout << "// Please do not manually modify!" << std::endl << std::endl;
+
+    std::cout << "namespace commutators {" << std::endl << std::endl;
+    for (auto &spec : result) {
+        if (spec.commutes.empty())
+            continue;
+        const std::string row = ns + "::" + spec.struct_name;
+        std::stringstream ss;
+        ss << "template <>" << std::endl;
+        ss << "class Commutator<" << row << ">" << std::endl;
+        ss << idt << ": public ColumnCommutator<" << row;
+        for (auto &c : spec.commutes) {
+            ss << ',' << std::endl << idt << idt << ops[c.op] << "<&" << row << "::" << c.field;
+            if (c.op == BoundedAdd)
+                ss << ", " << c.lo << ", " << c.hi;
+            else if (c.op == Append)
+                ss << ", " << c.lo;
+            ss << '>';
+        }
+        ss << "> {" << std::endl;
+        ss << "public:" << std::endl;
+        ss << idt << "using ColumnCommutator::ColumnCommutator;" << std::endl;
+        ss << "};" << std::endl;
+        std::cout << ss.str() << std::endl;
+    }
+    std::cout << "} // namespace commutators" << std::endl;
+}
+
 int main(const int argc, const char **argv) {
     /** check for the right # of arguments **/
     std::vector<StructSpec> result;
-    if( argc == 2 ) {
+    const char *profile_file = nullptr;
+    const char *split_ns = nullptr;
+    const char *traits_ns = nullptr;
+    const char *commute_ns = nullptr;
+    int argi = 1;
+    while (argi + 1 < argc && argv[argi][0] == '-' && argv[argi][1] != 'o') {
+        if (std::strcmp(argv[argi], "-p") == 0 && argi + 2 < argc) {
+            profile_file = argv[argi + 1];
+            argi += 2;
+        } else if (std::strcmp(argv[argi], "-s") == 0 && argi + 2 < argc) {
+            split_ns = argv[argi + 1];
+            argi += 2;
+        } else if (std::strcmp(argv[argi], "-c") == 0 && argi + 2 < argc) {
+            traits_ns = argv[argi + 1];
+            argi += 2;
+        } else if (std::strcmp(argv[argi], "-m") == 0 && argi + 2 < argc) {
+            commute_ns = argv[argi + 1];
+            argi += 2;
+        } else {
+            break;
+        }
+    }
+    if( argi + 1 == argc ) {
         MC::MC_Driver driver;
         /** example for piping input from terminal, i.e., using cat **/
-        if( std::strncmp( argv[ 1 ], "-o", 2 ) == 0 ) {
+        if( std::strncmp( argv[ argi ], "-o", 2 ) == 0 ) {
             driver.parse( std::cin, result );
         }
         /** simple help menu **/
-        else if( std::strncmp( argv[ 1 ], "-h", 2 ) == 0 ) {
+        else if( std::strncmp( argv[ argi ], "-h", 2 ) == 0 ) {
             std::cout << "use -o for pipe to std::cin\n";
             std::cout << "just give a filename to count from a file\n";
+            std::cout << "use -p PROFILE to regroup the structs in PROFILE from\n"
+                         "  their recorded column accesses, and print the new specs\n";
+            std::cout << "use -s NAMESPACE to print SplitParams specializations\n"
+                         "  for row types in NAMESPACE instead\n";
+            std::cout << "use -c NAMESPACE to print ColumnTraits specializations\n"
+                         "  (for select_row projections) for row types in NAMESPACE instead\n";
+            std::cout << "use -m NAMESPACE to print Commutator specializations\n"
+                         "  from the @commute fields of row types in NAMESPACE instead\n";
             std::cout << "use -h to get this menu\n";
             return( EXIT_SUCCESS );
         }
         /** example reading input from a file **/
         else {
             /** assume file, prod code, use stat to check **/
-            driver.parse( argv[1], result );
+            driver.parse( argv[argi], result );
         }
     } else {
         /** exit with failure condition **/
@@ -286,7 +601,24 @@ int main(const int argc, const char **argv) {
         return ( EXIT_FAILURE );
     }
 
-    generate_code(result);
+    if (profile_file) {
+        AccessProfile profile;
+        if (!read_profile(profile_file, profile))
+            return ( EXIT_FAILURE );
+        if (regroup(result, profile) == 0)
+            std::cerr << "Warning: no struct in " << profile_file << " matches the specs" << std::endl;
+    }
+
+    if (split_ns)
+        generate_split_params(result, split_ns);
+    else if (traits_ns)
+        generate_column_traits(result, traits_ns);
+    else if (commute_ns)
+        generate_commutators(result, commute_ns);
+    else if (profile_file)
+        generate_specs(result);
+    else
+        generate_code(result);
 
     return( EXIT_SUCCESS );
 }
@@ -35,10 +35,22 @@
 	std::string name;
   }; 
 
+  enum CommuteOpName { Add = 0, Min, Max, BoundedAdd, Append };
+
+  // A commutative update of one field (@commute); lo and hi bound a
+  // BOUNDED_ADD, and lo is the per-update length of an APPEND
+  struct Commute {
+	CommuteOpName op;
+	std::string field;
+	int lo;
+	int hi;
+  };
+
   struct StructSpec {
 	std::string struct_name;
 	std::vector<Field> fields;
 	std::vector<std::vector<std::string>> groups;
+	std::vector<Commute> commutes;
   };
 }
 
@@ -61,8 +73,9 @@
 %define api.value.type variant
 %define parse.assert
 
-%token NAME FIELDS GROUPS LBRACE RBRACE COLON COMMA AT
+%token NAME FIELDS GROUPS COMMUTE LBRACE RBRACE COLON COMMA AT
 %token BIGINT SMALLINT FLOAT VARCHAR CHAR LPAREN RPAREN
+%token ADD MIN MAX BOUNDED_ADD APPEND
 %token END 0 "end of file"
 %token <std::string> IDENTIFIER
 %token <int> NUMBER
@@ -76,6 +89,10 @@
 %type <std::vector<std::string>> group
 %type <std::vector<std::vector<std::string>>> group_list
 %type <std::vector<std::vector<std::string>>> group_spec
+%type <Commute> commute
+%type <Commute> commute_op
+%type <std::vector<Commute>> commute_list
+%type <std::vector<Commute>> commute_spec
 %type <std::string> name_spec
 %type <StructSpec> spec
 %type <std::vector<StructSpec>> spec_list
@@ -101,8 +118,8 @@ spec_list
   ;
 
 spec
-  : AT AT AT name_spec field_spec group_spec AT AT AT 
-	{ $$ = { $4, $5, $6 }; }
+  : AT AT AT name_spec field_spec group_spec commute_spec AT AT AT
+	{ $$ = { $4, $5, $6, $7 }; }
   ;
 
 name_spec
@@ -120,6 +137,13 @@ group_spec
 	{ $$ = $4; }
   ;
 
+commute_spec
+  : %empty
+	{ $$ = std::vector<Commute>(); }
+  | COMMUTE COLON LBRACE commute_list RBRACE
+	{ $$ = $4; }
+  ;
+
 field_list
   : field
 	{ $$ = std::vector<Field>(1, $1); }
@@ -143,6 +167,35 @@ group
 	{ $$ = $2; }
   ;
 
+commute_list
+  : commute
+	{ $$ = std::vector<Commute>(1, $1); }
+  | commute_list COMMA commute
+	{ $1.push_back($3);
+	  $$ = $1;
+	}
+  ;
+
+commute
+  : field_name LPAREN commute_op RPAREN
+	{ $$ = $3;
+	  $$.field = $1;
+	}
+  ;
+
+commute_op
+  : ADD
+	{ $$ = { Add, "", 0, 0 }; }
+  | MIN
+	{ $$ = { Min, "", 0, 0 }; }
+  | MAX
+	{ $$ = { Max, "", 0, 0 }; }
+  | BOUNDED_ADD LPAREN NUMBER COMMA NUMBER RPAREN
+	{ $$ = { BoundedAdd, "", $3, $5 }; }
+  | APPEND LPAREN NUMBER RPAREN
+	{ $$ = { Append, "", $3, 0 }; }
+  ;
+
 field
   : field_name LPAREN field_type RPAREN
 	{ $$ = { $3, $1 }; }
@@ -0,0 +1,66 @@
+#pragma once
+#include <mutex>
+#include <unordered_map>
+
+// A plain thread-safe map (hash shards behind mutexes) with the interface
+// TBoostedMap expects; it knows nothing about transactions.
+template <typename K, typename V, unsigned NShards = 64>
+class StripedMap {
+public:
+    bool find(const K& k, V& v) const {
+        auto& s = shard(k);
+        std::lock_guard<std::mutex> guard(s.m);
+        auto it = s.map.find(k);
+        if (it == s.map.end())
+            return false;
+        v = it->second;
+        return true;
+    }
+    bool insert(const K& k, const V& v) {
+        auto& s = shard(k);
+        std::lock_guard<std::mutex> guard(s.m);
+        return s.map.emplace(k, v).second;
+    }
+    bool erase(const K& k, V& old) {
+        auto& s = shard(k);
+        std::lock_guard<std::mutex> guard(s.m);
+        auto it = s.map.find(k);
+        if (it == s.map.end())
+            return false;
+        old = it->second;
+        s.map.erase(it);
+        return true;
+    }
+    bool put(const K& k, const V& v, V& old) {
+        auto& s = shard(k);
+        std::lock_guard<std::mutex> guard(s.m);
+        auto r = s.map.emplace(k, v);
+        if (r.second)
+            return false;
+        old = r.first->second;
+        r.first->second = v;
+        return true;
+    }
+    size_t size() const {
+        size_t n = 0;
+        for (auto& s : shards_) {
+            std::lock_guard<std::mutex> guard(s.m);
+            n += s.map.size();
+        }
+        return n;
+    }
+
+private:
+    struct alignas(64) shard_type {
+        mutable std::mutex m;
+        std::unordered_map<K, V> map;
+    };
+    shard_type shards_[NShards];
+
+    shard_type& shard(const K& k) {
+        return shards_[std::hash<K>()(k) % NShards];
+    }
+    const shard_type& shard(const K& k) const {
+        return shards_[std::hash<K>()(k) % NShards];
+    }
+};
@@ -0,0 +1,250 @@
+// Compares the boosted map adapter (TBoostedMap, running inside STO
+// transactions) against the standalone boosting runtime on the same
+// thread-safe map. The standalone side is only built with
+// `make BOOSTING_STANDALONE=1`.
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/time.h>
+#include "Sto.hh"
+#include "TBoosted.hh"
+#include "StripedMap.hh"
+#include "clp.h"
+
+#ifdef BOOSTING_STANDALONE
+// the standalone runtime brings its own transaction macros
+#undef TRANSACTION
+#undef RETRY
+#include "Boosting_standalone.hh"
+#endif
+
+int nthreads = 4;
+int ntrans = 200000;
+int opspertrans = 4;
+int nkeys = 10000;
+double write_percent = 0.5;
+
+typedef StripedMap<long, long> map_type;
+
+struct result {
+    unsigned long long commits = 0;
+    unsigned long long aborts = 0;
+};
+
+// Each transaction reads opspertrans random keys and increments a
+// write_percent share of them
+template <typename Map>
+static void run_txn(Map& m, std::mt19937& rng) {
+    for (int j = 0; j < opspertrans; ++j) {
+        long k = rng() % nkeys;
+        long v = 0;
+        m.get(k, v);
+        if (rng() % 100 < write_percent * 100)
+            m.put(k, v + 1);
+    }
+}
+
+struct sto_map {
+    TBoostedMap<long, long, map_type> m;
+
+    void get(long k, long& v) {
+        m.transGet(k, v);
+    }
+    void put(long k, long v) {
+        m.transPut(k, v);
+    }
+    map_type& map() {
+        return m.nontrans_map();
+    }
+
+    static void thread_init(int me) {
+        TThread::set_id(me);
+    }
+    template <typename F>
+    static void run(F f, result& r) {
+        while (true) {
+            Sto::start_transaction();
+            try {
+                f();
+                if (Sto::try_commit())
+                    break;
+            } catch (Transaction::Abort e) {
+                Sto::silent_abort();
+            }
+            ++r.aborts;
+        }
+        ++r.commits;
+    }
+};
+
+#ifdef BOOSTING_STANDALONE
+struct standalone_map {
+    static constexpr unsigned nlocks = 1024;
+    map_type map_;
+    RWLock locks_[nlocks];
+
+    static void undo_put(void* self, void* k, void* old) {
+        long cur;
+        ((standalone_map*) self)->map_.put((long) k, (long) old, cur);
+    }
+    static void undo_insert(void* self, void* k, void*) {
+        long cur;
+        ((standalone_map*) self)->map_.erase((long) k, cur);
+    }
+
+    void get(long k, long& v) {
+        transReadLock(&locks_[std::hash<long>()(k) % nlocks]);
+        map_.find(k, v);
+    }
+    void put(long k, long v) {
+        transWriteLock(&locks_[std::hash<long>()(k) % nlocks]);
+        long old;
+        if (map_.put(k, v, old))
+            ON_ABORT(undo_put, this, (void*) k, (void*) old);
+        else
+            ON_ABORT(undo_insert, this, (void*) k, nullptr);
+    }
+    map_type& map() {
+        return map_;
+    }
+
+    static void thread_init(int me) {
+        boosting_setThreadID(me);
+    }
+    template <typename F>
+    static void run(F f, result& r) {
+        while (true) {
+            boosting_txStartHook();
+            try {
+                f();
+                BOOSTING_T().did_commit();
+                break;
+            } catch (Boosting::Abort e) {
+            }
+            BOOSTING_T().did_abort();
+            ++r.aborts;
+        }
+        ++r.commits;
+    }
+};
+#endif
+
+template <typename M>
+static void run_and_report(const char* name) {
+    M* m = new M;
+    for (long k = 0; k < nkeys; ++k) {
+        long old;
+        m->map().put(k, 0, old);
+    }
+
+    std::vector<result> results(nthreads);
+    std::vector<std::thread> ts;
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    for (int me = 0; me < nthreads; ++me)
+        ts.emplace_back([&, me] {
+                M::thread_init(me);
+                std::mt19937 rng(me + 1);
+                for (int i = 0; i < ntrans / nthreads; ++i) {
+                    // retries of this transaction do the same thing
+                    std::mt19937 snap = rng;
+                    M::run([&] {
+                            rng = snap;
+                            run_txn(*m, rng);
+                        }, results[me]);
+                }
+            });
+    for (auto& t : ts)
+        t.join();
+    gettimeofday(&tv2, NULL);
+
+    result total;
+    for (auto& r : results) {
+        total.commits += r.commits;
+        total.aborts += r.aborts;
+    }
+    double time = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("%s: %.0f txn/s, %llu commits, %llu aborts\n", name,
+           total.commits / time, total.commits, total.aborts);
+    delete m;
+}
+
+enum {
+    opt_nthreads = 1, opt_ntrans, opt_opspertrans, opt_nkeys, opt_writepercent
+};
+
+static const Clp_Option options[] = {
+    { "nthreads", 0, opt_nthreads, Clp_ValInt, Clp_Optional },
+    { "ntrans", 0, opt_ntrans, Clp_ValInt, Clp_Optional },
+    { "opspertrans", 0, opt_opspertrans, Clp_ValInt, Clp_Optional },
+    { "nkeys", 0, opt_nkeys, Clp_ValInt, Clp_Optional },
+    { "writepercent", 0, opt_writepercent, Clp_ValDouble, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: [OPTIONS] [TESTS]\n\
+           Options:\n\
+           --nthreads=NTHREADS (default %d)\n\
+           --ntrans=NTRANS, total transactions, split between threads (default %d)\n\
+           --opspertrans=OPSPERTRANS, keys accessed per transaction (default %d)\n\
+           --nkeys=NKEYS, size of the key space (default %d)\n\
+           --writepercent=WRITEPERCENT, share of accesses that also write (default %f)\n\
+           Tests: sto, standalone (default: all that were built)\n",
+           nthreads, ntrans, opspertrans, nkeys, write_percent);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    Clp_Parser* clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    std::vector<const char*> tests;
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+        case opt_nthreads:
+            nthreads = clp->val.i;
+            break;
+        case opt_ntrans:
+            ntrans = clp->val.i;
+            break;
+        case opt_opspertrans:
+            opspertrans = clp->val.i;
+            break;
+        case opt_nkeys:
+            nkeys = clp->val.i;
+            break;
+        case opt_writepercent:
+            write_percent = clp->val.d;
+            break;
+        case Clp_NotOption:
+            tests.push_back(clp->vstr);
+            break;
+        default:
+            help();
+        }
+    }
+    Clp_DeleteParser(clp);
+
+    if (tests.empty()) {
+        tests.push_back("sto");
+#ifdef BOOSTING_STANDALONE
+        tests.push_back("standalone");
+#endif
+    }
+
+    for (auto test : tests) {
+        if (strcmp(test, "sto") == 0)
+            run_and_report<sto_map>("sto");
+#ifdef BOOSTING_STANDALONE
+        else if (strcmp(test, "standalone") == 0)
+            run_and_report<standalone_map>("standalone");
+#endif
+        else
+            help();
+    }
+
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, nthreads);
+    return 0;
+}
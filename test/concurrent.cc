@@ -1016,8 +1016,8 @@ void HotspotRW<DS>::report() {
     for (int i = 0; i < nthreads; ++i) {
         ss << "Thread " << i;
         ss << ": n=" << skew_account[i].ntxns_at_stop;
-        ss << ", t_stop=" << (unsigned long)((double)skew_account[i].time_to_stop / PROC_TSC_FREQ);
-        auto ttq = (unsigned long)((double)skew_account[i].time_to_quota / PROC_TSC_FREQ);
+        ss << ", t_stop=" << (unsigned long)((double)skew_account[i].time_to_stop / tsc_frequency());
+        auto ttq = (unsigned long)((double)skew_account[i].time_to_quota / tsc_frequency());
         times_to_quota.push_back(ttq);
         ss << ", t_quota=" << ttq;
         ss << std::endl;
@@ -1883,7 +1883,7 @@ void time_and_run(double *real_time,
     startAndWait(nthreads, tester, t1);
     unsigned long t2 = read_tsc();
     getrusage(RUSAGE_SELF, ru2);
-    *real_time = ((double)(t2-t1)) / BILLION / PROC_TSC_FREQ;
+    *real_time = ((double)(t2-t1)) / BILLION / tsc_frequency();
     tester->report();
 }
 
@@ -2070,7 +2070,7 @@ int main(int argc, char *argv[]) {
           sep = ", ";
       }
       if (txp_count > txp_total_aborts) {
-          printf("%stotal_aborts: %llu (%llu aborts at commit time, %llu in observe, %llus due to write lock time-outs)\n CM::should_abort: %llu, CM::on_write: %llu, CM::on_rollback: %llu, CM::start: %llu\n Allocate new items: %llu, BV hit: %llu", sep, tc.p(txp_total_aborts), tc.p(txp_commit_time_aborts), tc.p(txp_observe_lock_aborts), tc.p(txp_lock_aborts), tc.p(txp_cm_shouldabort), tc.p(txp_cm_onwrite), tc.p(txp_cm_onrollback), tc.p(txp_cm_start), tc.p(txp_allocate), tc.p(txp_bv_hit));
+          printf("%stotal_aborts: %llu (%llu aborts at commit time, %llu in observe, %llus due to write lock time-outs)\n CM::should_abort: %llu, CM::on_write: %llu, CM::on_rollback: %llu, CM::start: %llu, CM::queued: %llu, CM::waits: %llu\n Allocate new items: %llu, BV hit: %llu", sep, tc.p(txp_total_aborts), tc.p(txp_commit_time_aborts), tc.p(txp_observe_lock_aborts), tc.p(txp_lock_aborts), tc.p(txp_cm_shouldabort), tc.p(txp_cm_onwrite), tc.p(txp_cm_onrollback), tc.p(txp_cm_start), tc.p(txp_cm_queued), tc.p(txp_cm_waits), tc.p(txp_allocate), tc.p(txp_bv_hit));
           sep = ", ";
       }
       if (*sep)
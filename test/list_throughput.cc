@@ -0,0 +1,204 @@
+// Scalability of LazyList under a lookup/insert/delete mix. "lazylist"
+// validates only the nodes and gaps each operation touched; "sized" also
+// reads size() in every transaction, which validates against one
+// list-wide version the way every List traversal does. With
+// --partitioned, each thread works in its own key range, so the only
+// conflicts left are those the list itself introduces. Run with
+// increasing --nthreads to see how each scales.
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/time.h>
+#include "Sto.hh"
+#include "LazyList.hh"
+#include "clp.h"
+#include "randgen.hh"
+
+int global_seed = 0;
+int nthreads = 4;
+int ntrans = 1000000;
+int opspertrans = 4;
+int nkeys = 1000;
+double write_percent = 0.2;
+bool partitioned = false;
+unsigned initial_seeds[128];
+
+template <bool ReadSize>
+struct lazylist_set {
+    LazyList<uint64_t> l;
+    void nontrans_insert(uint64_t k) {
+        l.insert(k);
+    }
+    void begin_txn() {
+        if (ReadSize)
+            (void) l.size();
+    }
+    bool lookup(uint64_t k) {
+        return l.transContains(k);
+    }
+    void insert(uint64_t k) {
+        l.transInsert(k);
+    }
+    void erase(uint64_t k) {
+        l.transDelete(k);
+    }
+};
+
+struct thread_result {
+    uint64_t commits;
+    uint64_t attempts;
+};
+
+template <typename M>
+void run(M* m, int me, thread_result* result) {
+    TThread::set_id(me);
+    Rand transgen(initial_seeds[2*me], initial_seeds[2*me + 1]);
+    std::uniform_int_distribution<int> dist(0, 99);
+    uint64_t range = partitioned ? nkeys / nthreads : nkeys;
+    uint64_t base = partitioned ? me * range : 0;
+    std::uniform_int_distribution<uint64_t> keydist(0, range - 1);
+    uint64_t attempts = 0;
+    int n = ntrans / nthreads;
+    for (int i = 0; i < n; ++i) {
+        // so that retries of this transaction do the same thing
+        Rand transgen_snap = transgen;
+        TRANSACTION_E {
+            ++attempts;
+            transgen = transgen_snap;
+            m->begin_txn();
+            for (int j = 0; j < opspertrans; ++j) {
+                uint64_t k = base + keydist(transgen);
+                if (dist(transgen) >= write_percent * 100)
+                    m->lookup(k);
+                else if (m->lookup(k))
+                    m->erase(k);
+                else
+                    m->insert(k);
+            }
+        } RETRY_E(true);
+    }
+    result->commits = n;
+    result->attempts = attempts;
+}
+
+template <typename M>
+void run_and_report(const char* name) {
+    M* m = new M;
+    for (int k = 0; k < nkeys; k += 2)
+        m->nontrans_insert(k);
+
+    std::vector<thread_result> results(nthreads);
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nthreads; ++i)
+        threads.emplace_back(run<M>, m, i, &results[i]);
+    for (auto& t : threads)
+        t.join();
+    gettimeofday(&tv2, NULL);
+
+    uint64_t commits = 0, attempts = 0;
+    for (auto& r : results) {
+        commits += r.commits;
+        attempts += r.attempts;
+    }
+    double time = (tv2.tv_sec - tv1.tv_sec) + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("%s: %.0f txns/s, %.2f%% aborts (%llu commits, %llu attempts, %.3fs)\n",
+           name, commits / time, 100.0 * (attempts - commits) / attempts,
+           (unsigned long long) commits, (unsigned long long) attempts, time);
+    delete m;
+}
+
+enum {
+    opt_nthreads = 1, opt_ntrans, opt_opspertrans, opt_writepercent, opt_nkeys,
+    opt_partitioned, opt_seed
+};
+
+static const Clp_Option options[] = {
+    { "nthreads", 0, opt_nthreads, Clp_ValInt, Clp_Optional },
+    { "ntrans", 0, opt_ntrans, Clp_ValInt, Clp_Optional },
+    { "opspertrans", 0, opt_opspertrans, Clp_ValInt, Clp_Optional },
+    { "writepercent", 0, opt_writepercent, Clp_ValDouble, Clp_Optional },
+    { "keys", 0, opt_nkeys, Clp_ValInt, Clp_Optional },
+    { "partitioned", 0, opt_partitioned, 0, Clp_Negate },
+    { "seed", 0, opt_seed, Clp_ValInt, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: list_throughput [OPTIONS] [lazylist|sized]...\n\
+           Options:\n\
+           --nthreads=NTHREADS (default %d)\n\
+           --ntrans=NTRANS, how many total transactions to run (they'll be split between threads) (default %d)\n\
+           --opspertrans=OPSPERTRANS, how many operations to run per transaction (default %d)\n\
+           --writepercent=WRITEPERCENT, probability with which an operation inserts or erases (default %f)\n\
+           --keys=KEYS, size of the key space, half of which is prepopulated (default %d)\n\
+           --partitioned, give each thread its own key range\n\
+           --seed=SEED, global seed to run the experiment \n",
+           nthreads, ntrans, opspertrans, write_percent, nkeys);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    std::vector<const char*> tests;
+
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+        case opt_nthreads:
+            nthreads = clp->val.i;
+            break;
+        case opt_ntrans:
+            ntrans = clp->val.i;
+            break;
+        case opt_opspertrans:
+            opspertrans = clp->val.i;
+            break;
+        case opt_writepercent:
+            write_percent = clp->val.d;
+            break;
+        case opt_nkeys:
+            nkeys = clp->val.i;
+            break;
+        case opt_partitioned:
+            partitioned = !clp->negated;
+            break;
+        case opt_seed:
+            global_seed = clp->val.i;
+            break;
+        case Clp_NotOption:
+            tests.push_back(clp->vstr);
+            break;
+        default:
+            help();
+        }
+    }
+    Clp_DeleteParser(clp);
+
+    if (tests.empty()) {
+        tests.push_back("lazylist");
+        tests.push_back("sized");
+    }
+
+    if (global_seed)
+        srandom(global_seed);
+    else
+        srandomdev();
+    for (unsigned i = 0; i < arraysize(initial_seeds); ++i)
+        initial_seeds[i] = random();
+
+    pthread_t advancer;
+    pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
+    pthread_detach(advancer);
+
+    for (auto test : tests) {
+        if (strcmp(test, "lazylist") == 0)
+            run_and_report<lazylist_set<false>>("lazylist");
+        else if (strcmp(test, "sized") == 0)
+            run_and_report<lazylist_set<true>>("sized");
+        else
+            help();
+    }
+    return 0;
+}
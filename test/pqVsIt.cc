@@ -1,4 +1,5 @@
 #define TVECTOR_DEFAULT_CAPACITY 16384
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <assert.h>
@@ -11,6 +12,7 @@
 #include "TVector_nopred.hh"
 #include "PriorityQueue.hh"
 #include "PriorityQueue1.hh"
+#include "TRelaxedPriorityQueue.hh"
 #include "clp.h"
 #include "randgen.hh"
 int waiting = 5000;
@@ -22,6 +24,7 @@ int prepopulate = 1000;
 double push_percent = 0.75;
 int blocks = 1000;
 int runtime = 10;
+bool scale = false;
 unsigned initial_seeds[128];
 
 volatile bool running = true;
@@ -105,7 +108,10 @@ uint64_t run(T* q, int me) {
                     break;
                 }
         
-            } catch (Transaction::Abort e) { }
+            } catch (Transaction::Abort e) {
+                // datatypes may throw without aborting the transaction
+                Sto::silent_abort();
+            }
             transgen = transgen_snap;
         }
         /* Waiting time */
@@ -154,7 +160,7 @@ void print_time(struct timeval tv1, struct timeval tv2) {
 }
 
 enum {
-    opt_nthreads = 1, opt_ntrans, opt_opspertrans, opt_pushpercent, opt_toppercent, opt_prepopulate, opt_seed
+    opt_nthreads = 1, opt_ntrans, opt_opspertrans, opt_pushpercent, opt_toppercent, opt_prepopulate, opt_seed, opt_runtime, opt_scale
 };
 
 static const Clp_Option options[] = {
@@ -164,7 +170,9 @@ static const Clp_Option options[] = {
     { "pushpercent", 0, opt_pushpercent, Clp_ValDouble, Clp_Optional },
     { "toppercent", 0, opt_toppercent, Clp_ValDouble, Clp_Optional },
     { "prepopulate", 0, opt_prepopulate, Clp_ValInt, Clp_Optional },
-    { "seed", 0, opt_seed, Clp_ValInt, Clp_Optional }
+    { "seed", 0, opt_seed, Clp_ValInt, Clp_Optional },
+    { "runtime", 0, opt_runtime, Clp_ValInt, Clp_Optional },
+    { "scale", 0, opt_scale, 0, Clp_Negate }
 };
 
 static void help() {
@@ -175,8 +183,11 @@ static void help() {
            --opspertrans=OPSPERTRANS, how many operations to run per transaction (default %d)\n\
            --pushpercent=PUSHPERCENT, probability with which to do pushes (default %f)\n\
            --prepopulate=PREPOPULATE, prepopulate table with given number of items (default %d)\n\
-           --seed=SEED, global seed to run the experiment \n",
-            nthreads, ntrans, opspertrans, push_percent, prepopulate);
+           --seed=SEED, global seed to run the experiment \n\
+           --runtime=RUNTIME, seconds to run each test (default %d)\n\
+           --scale, run each test at 1, 2, 4, ... NTHREADS threads\n\
+           Tests: PQ, PQ1, std, std-nopred, relaxed (default PQ and PQ1)\n",
+            nthreads, ntrans, opspertrans, push_percent, prepopulate, runtime);
     exit(1);
 }
 
@@ -252,6 +263,12 @@ int main(int argc, char *argv[]) {
             case opt_seed:
                 global_seed = clp->val.i;
                 break;
+            case opt_runtime:
+                runtime = clp->val.i;
+                break;
+            case opt_scale:
+                scale = !clp->negated;
+                break;
             case Clp_NotOption:
                 tests.push_back(clp->vstr);
                 break;
@@ -277,18 +294,29 @@ int main(int argc, char *argv[]) {
     pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
     pthread_detach(advancer);
 
-    // Run a parallel test with lots of transactions doing pushes and pops
+    // Run a parallel test with lots of transactions doing pushes and pops;
+    // with --scale, once per thread count to show how each queue scales
+    // (doubling, and ending on max_threads even when it isn't a power of 2)
+    int max_threads = nthreads;
     for (auto test : tests) {
-        if (strcmp(test, "PQ") == 0 || strcmp(test, "pq") == 0)
-            run_and_report<PriorityQueue<int>>("PQ");
-        else if (strcmp(test, "PQ1") == 0 || strcmp(test, "pq1") == 0 || strcmp(test, "it") == 0)
-            run_and_report<PriorityQueue1<int>>("PQ1");
-        else if (strcmp(test, "std") == 0)
-            run_and_report<std::priority_queue<int, TVector<int>>>("std");
-        else if (strcmp(test, "std-nopred") == 0)
-            run_and_report<std::priority_queue<int, TVector_nopred<int>>>("std-nopred");
-        else
-            assert(false);
+        for (nthreads = scale ? 1 : max_threads; ; nthreads = std::min(nthreads * 2, max_threads)) {
+            if (scale)
+                printf("%d threads, ", nthreads);
+            if (strcmp(test, "PQ") == 0 || strcmp(test, "pq") == 0)
+                run_and_report<PriorityQueue<int>>("PQ");
+            else if (strcmp(test, "PQ1") == 0 || strcmp(test, "pq1") == 0 || strcmp(test, "it") == 0)
+                run_and_report<PriorityQueue1<int>>("PQ1");
+            else if (strcmp(test, "std") == 0)
+                run_and_report<std::priority_queue<int, TVector<int>>>("std");
+            else if (strcmp(test, "std-nopred") == 0)
+                run_and_report<std::priority_queue<int, TVector_nopred<int>>>("std-nopred");
+            else if (strcmp(test, "relaxed") == 0)
+                run_and_report<TRelaxedPriorityQueue<int>>("relaxed");
+            else
+                assert(false);
+            if (nthreads >= max_threads)
+                break;
+        }
     }
 
     return 0;
@@ -4,10 +4,12 @@
 #include <vector>
 #include <random>
 #include <map>
+#include <thread>
 #include "Transaction.hh"
 #include "Vector.hh"
 #include "PriorityQueue.hh"
 #include "PriorityQueue1.hh"
+#include "TRelaxedPriorityQueue.hh"
 #include "randgen.hh"
 
 #define GLOBAL_SEED 0
@@ -522,6 +524,41 @@ void print_time(struct timeval tv1, struct timeval tv2) {
     printf("%f\n", (tv2.tv_sec-tv1.tv_sec) + (tv2.tv_usec-tv1.tv_usec)/1000000.0);
 }
 
+// Scalability: every thread runs NTRANS push/pop/push transactions
+template <typename T>
+void run_mix(T* q, int me) {
+    TThread::set_id(me);
+    std::uniform_int_distribution<long> slotdist(0, MAX_VALUE);
+    Rand transgen(initial_seeds[2*me], initial_seeds[2*me + 1]);
+    for (int i = 0; i < NTRANS; ++i) {
+        // so that retries of this transaction do the same thing
+        Rand transgen_snap = transgen;
+        TRANSACTION_E {
+            transgen = transgen_snap;
+            q->push(slotdist(transgen));
+            q->pop();
+            q->push(slotdist(transgen));
+        } RETRY_E(true);
+    }
+}
+
+template <typename T>
+void scalability(const char* name) {
+    for (int n = 1; n <= N_THREADS; n *= 2) {
+        T q;
+        struct timeval tv1, tv2;
+        gettimeofday(&tv1, NULL);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < n; ++i)
+            threads.emplace_back(run_mix<T>, &q, i);
+        for (auto& t : threads)
+            t.join();
+        gettimeofday(&tv2, NULL);
+        printf("%s, %d threads: ", name, n);
+        print_time(tv1, tv2);
+    }
+}
+
 int main() {
     queueTests();
     std::cout << "Done queue tests" << std::endl;
@@ -663,5 +700,10 @@ int main() {
         } RETRY(false);
     }
 
+    // PriorityQueue serializes pops on its root; the relaxed queue spreads
+    // them over sub-queues
+    scalability<data_structure>("PriorityQueue");
+    scalability<TRelaxedPriorityQueue<int>>("TRelaxedPriorityQueue");
+
 	return 0;
 }
@@ -0,0 +1,192 @@
+// Throughput of the transactional queues under a mixed push/pop workload:
+// Queue, which serializes pushes on its tail version and pops on its head
+// version, against TSegmentedQueue, whose pops conflict per element.
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/time.h>
+#include "Sto.hh"
+#include "Queue.hh"
+#include "TSegmentedQueue.hh"
+#include "clp.h"
+#include "randgen.hh"
+
+int global_seed = 0;
+int nthreads = 4;
+int ntrans = 1000000;
+int opspertrans = 4;
+int prepopulate = 1000;
+double push_percent = 0.5;
+unsigned initial_seeds[128];
+
+struct ring_queue {
+    Queue<int> q;
+    void push(int v) {
+        q.transPush(v);
+    }
+    void pop() {
+        q.transPop();
+    }
+    void nontrans_push(int v) {
+        q.nontrans_push(v);
+    }
+};
+
+struct segmented_queue {
+    TSegmentedQueue<int> q;
+    void push(int v) {
+        q.push(v);
+    }
+    void pop() {
+        q.pop();
+    }
+    void nontrans_push(int v) {
+        q.nontrans_push(v);
+    }
+};
+
+struct thread_result {
+    uint64_t commits;
+    uint64_t attempts;
+};
+
+template <typename Q>
+void run(Q* q, int me, thread_result* result) {
+    TThread::set_id(me);
+    Rand transgen(initial_seeds[2*me], initial_seeds[2*me + 1]);
+    std::uniform_int_distribution<int> dist(0, 99);
+    uint64_t attempts = 0;
+    int n = ntrans / nthreads;
+    for (int i = 0; i < n; ++i) {
+        // so that retries of this transaction do the same thing
+        Rand transgen_snap = transgen;
+        TRANSACTION_E {
+            ++attempts;
+            transgen = transgen_snap;
+            for (int j = 0; j < opspertrans; ++j) {
+                if (dist(transgen) < push_percent * 100)
+                    q->push(me);
+                else
+                    q->pop();
+            }
+        } RETRY_E(true);
+    }
+    result->commits = n;
+    result->attempts = attempts;
+}
+
+template <typename Q>
+void run_and_report(const char* name) {
+    Q* q = new Q;
+    for (int i = 0; i < prepopulate; ++i)
+        q->nontrans_push(i);
+
+    std::vector<thread_result> results(nthreads);
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nthreads; ++i)
+        threads.emplace_back(run<Q>, q, i, &results[i]);
+    for (auto& t : threads)
+        t.join();
+    gettimeofday(&tv2, NULL);
+
+    uint64_t commits = 0, attempts = 0;
+    for (auto& r : results) {
+        commits += r.commits;
+        attempts += r.attempts;
+    }
+    double time = (tv2.tv_sec - tv1.tv_sec) + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("%s: %.0f txns/s, %.2f%% aborts (%llu commits, %llu attempts, %.3fs)\n",
+           name, commits / time, 100.0 * (attempts - commits) / attempts,
+           (unsigned long long) commits, (unsigned long long) attempts, time);
+    delete q;
+}
+
+enum {
+    opt_nthreads = 1, opt_ntrans, opt_opspertrans, opt_pushpercent, opt_prepopulate, opt_seed
+};
+
+static const Clp_Option options[] = {
+    { "nthreads", 0, opt_nthreads, Clp_ValInt, Clp_Optional },
+    { "ntrans", 0, opt_ntrans, Clp_ValInt, Clp_Optional },
+    { "opspertrans", 0, opt_opspertrans, Clp_ValInt, Clp_Optional },
+    { "pushpercent", 0, opt_pushpercent, Clp_ValDouble, Clp_Optional },
+    { "prepopulate", 0, opt_prepopulate, Clp_ValInt, Clp_Optional },
+    { "seed", 0, opt_seed, Clp_ValInt, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: queue_throughput [OPTIONS] [ring|segmented]...\n\
+           Options:\n\
+           --nthreads=NTHREADS (default %d)\n\
+           --ntrans=NTRANS, how many total transactions to run (they'll be split between threads) (default %d)\n\
+           --opspertrans=OPSPERTRANS, how many operations to run per transaction (default %d)\n\
+           --pushpercent=PUSHPERCENT, probability with which to do pushes (default %f)\n\
+           --prepopulate=PREPOPULATE, prepopulate queue with given number of items (default %d)\n\
+           --seed=SEED, global seed to run the experiment \n",
+           nthreads, ntrans, opspertrans, push_percent, prepopulate);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    std::vector<const char*> tests;
+
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+        case opt_nthreads:
+            nthreads = clp->val.i;
+            break;
+        case opt_ntrans:
+            ntrans = clp->val.i;
+            break;
+        case opt_opspertrans:
+            opspertrans = clp->val.i;
+            break;
+        case opt_pushpercent:
+            push_percent = clp->val.d;
+            break;
+        case opt_prepopulate:
+            prepopulate = clp->val.i;
+            break;
+        case opt_seed:
+            global_seed = clp->val.i;
+            break;
+        case Clp_NotOption:
+            tests.push_back(clp->vstr);
+            break;
+        default:
+            help();
+        }
+    }
+    Clp_DeleteParser(clp);
+
+    if (tests.empty()) {
+        tests.push_back("ring");
+        tests.push_back("segmented");
+    }
+
+    if (global_seed)
+        srandom(global_seed);
+    else
+        srandomdev();
+    for (unsigned i = 0; i < arraysize(initial_seeds); ++i)
+        initial_seeds[i] = random();
+
+    pthread_t advancer;
+    pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
+    pthread_detach(advancer);
+
+    for (auto test : tests) {
+        if (strcmp(test, "ring") == 0)
+            run_and_report<ring_queue>("ring");
+        else if (strcmp(test, "segmented") == 0)
+            run_and_report<segmented_queue>("segmented");
+        else
+            help();
+    }
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Throughput of parallel log replay. Worker threads commit transactions
+// that each overwrite a few logged boxes, then the log is replayed with
+// an increasing number of threads into per-box arrays of last values,
+// reporting GB/s of log replayed. Replay only stores each value, so this
+// measures reading, partitioning and ordering the log.
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/time.h>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "clp.h"
+
+int nthreads = 4;
+int ntrans = 1000000;
+int opspertrans = 4;
+int nboxes = 100000;
+int nloggers = 2;
+int max_recover_threads = 8;
+const char* log_dir = nullptr;
+
+struct payload {
+    char bytes[96];
+};
+std::ostream& operator<<(std::ostream& w, const payload& p) {
+    return w << "payload{" << int(p.bytes[0]) << "}";
+}
+
+void run(std::vector<TBox<payload>>* boxes, int me) {
+    TThread::set_id(me);
+    std::mt19937 gen(me + 1);
+    std::uniform_int_distribution<int> keydist(0, nboxes - 1);
+    int n = ntrans / nthreads;
+    payload p;
+    memset(p.bytes, me, sizeof(p.bytes));
+    for (int i = 0; i < n; ++i) {
+        // so that retries of this transaction do the same thing
+        std::mt19937 gen_snap = gen;
+        TRANSACTION_E {
+            gen = gen_snap;
+            for (int j = 0; j < opspertrans; ++j)
+                (*boxes)[keydist(gen)] = p;
+        } RETRY_E(true);
+    }
+    TxnLog::flush_thread();
+}
+
+enum {
+    opt_nthreads = 1, opt_ntrans, opt_opspertrans, opt_nboxes, opt_nloggers,
+    opt_recover_threads, opt_log_dir
+};
+
+static const Clp_Option options[] = {
+    { "nthreads", 0, opt_nthreads, Clp_ValInt, Clp_Optional },
+    { "ntrans", 0, opt_ntrans, Clp_ValInt, Clp_Optional },
+    { "opspertrans", 0, opt_opspertrans, Clp_ValInt, Clp_Optional },
+    { "boxes", 0, opt_nboxes, Clp_ValInt, Clp_Optional },
+    { "loggers", 0, opt_nloggers, Clp_ValInt, Clp_Optional },
+    { "recover-threads", 0, opt_recover_threads, Clp_ValInt, Clp_Optional },
+    { "log-dir", 0, opt_log_dir, Clp_ValString, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: recovery_throughput [OPTIONS]\n\
+           Options:\n\
+           --nthreads=NTHREADS, threads writing the log (default %d)\n\
+           --ntrans=NTRANS, how many total transactions to log (default %d)\n\
+           --opspertrans=OPSPERTRANS, boxes written per transaction (default %d)\n\
+           --boxes=BOXES, number of logged boxes (default %d)\n\
+           --loggers=LOGGERS, logger threads and log files (default %d)\n\
+           --recover-threads=N, replay with 1, 2, 4, ... up to N threads (default %d)\n\
+           --log-dir=DIR, where to write the log (default a new directory in /tmp)\n",
+           nthreads, ntrans, opspertrans, nboxes, nloggers, max_recover_threads);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+        case opt_nthreads:
+            nthreads = clp->val.i;
+            break;
+        case opt_ntrans:
+            ntrans = clp->val.i;
+            break;
+        case opt_opspertrans:
+            opspertrans = clp->val.i;
+            break;
+        case opt_nboxes:
+            nboxes = clp->val.i;
+            break;
+        case opt_nloggers:
+            nloggers = clp->val.i;
+            break;
+        case opt_recover_threads:
+            max_recover_threads = clp->val.i;
+            break;
+        case opt_log_dir:
+            log_dir = clp->val.s;
+            break;
+        default:
+            help();
+        }
+    }
+    Clp_DeleteParser(clp);
+
+    char tmpdir[] = "/tmp/sto-recovery-XXXXXX";
+    std::string dir = log_dir ? log_dir : mkdtemp(tmpdir);
+    std::vector<TBox<payload>> boxes(nboxes);
+    for (int i = 0; i < nboxes; ++i) {
+        boxes[i].nontrans_write(payload());
+        boxes[i].set_log_id(i + 1);
+    }
+
+    always_assert(TxnLog::start(dir.c_str(), nloggers));
+    std::atomic<bool> done(false);
+    std::thread advancer([&] {
+        while (!done) {
+            Transaction::global_epoch_advance_once();
+            usleep(1000);
+        }
+    });
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nthreads; ++i)
+        threads.emplace_back(run, &boxes, i);
+    for (auto& t : threads)
+        t.join();
+    done = true;
+    advancer.join();
+    TThread::set_id(0);
+    TxnLog::stop();
+    gettimeofday(&tv2, NULL);
+    double time = (tv2.tv_sec - tv1.tv_sec) + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("logged: %.0f txns/s (%d txns, %.3fs)\n", (ntrans / nthreads * nthreads) / time,
+           ntrans / nthreads * nthreads, time);
+
+    std::vector<payload> recovered(nboxes + 1, payload());
+    for (int n = 1; n <= max_recover_threads; n *= 2) {
+        auto stats = TxnLog::recover(dir.c_str(), n, [&](const TxnLog::record& r, int) {
+                memcpy(&recovered[r.object_id], r.value, sizeof(payload));
+            });
+        printf("replay, %d threads: %.2f GB/s (%.1f MB, %llu records, %.3fs)\n",
+               n, stats.gbps(), stats.bytes / 1e6, (unsigned long long) stats.records, stats.seconds);
+    }
+    TThread::set_id(0);
+    for (int i = 0; i < nboxes; ++i)
+        always_assert(memcmp(&recovered[i + 1], &boxes[i].nontrans_read(), sizeof(payload)) == 0);
+
+    if (!log_dir) {
+        std::string cmd = "rm -rf " + dir;
+        if (system(cmd.c_str()) != 0)
+            perror("rm");
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+// Throughput of the transactional ordered maps under a lookup/insert/erase
+// mix: TSkipList against the masstree-based bench::ordered_index. With
+// --partitioned, each thread works in its own key range, so the only
+// conflicts left are those the structure itself introduces.
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/time.h>
+#include "Sto.hh"
+#include "TSkipList.hh"
+#include "DB_params.hh"
+#include "Garbage_bench.hh"
+#include "clp.h"
+#include "randgen.hh"
+
+int global_seed = 0;
+int nthreads = 4;
+int ntrans = 1000000;
+int opspertrans = 4;
+int nkeys = 100000;
+double write_percent = 0.2;
+bool partitioned = false;
+unsigned initial_seeds[128];
+
+struct skiplist_map {
+    TSkipList<uint64_t, int> m;
+    void thread_init() {
+    }
+    void nontrans_insert(uint64_t k) {
+        m.nontrans_insert(k, 0);
+    }
+    bool lookup(uint64_t k) {
+        return m.count(k);
+    }
+    void insert(uint64_t k) {
+        m.insert(k, 0);
+    }
+    void erase(uint64_t k) {
+        m.erase(k);
+    }
+};
+
+struct oindex_map {
+    typedef garbage_bench::garbage_row row_type;
+    typedef garbage_bench::garbage_key key_type;
+    typedef row_type::NamedColumn nc;
+    bench::ordered_index<key_type, row_type, db_params::db_default_params> m;
+
+    // big-endian, so masstree orders keys numerically
+    static key_type make_key(uint64_t k) {
+        return key_type(bench::bswap(k));
+    }
+    void thread_init() {
+        m.thread_init();
+    }
+    void nontrans_insert(uint64_t k) {
+        m.nontrans_put(make_key(k), row_type(0));
+    }
+    bool lookup(uint64_t k) {
+        auto [success, found, row, value]
+            = m.select_split_row(make_key(k), {{nc::value, bench::access_t::read}});
+        (void) row;
+        (void) value;
+        if (!success)
+            throw Transaction::Abort();
+        return found;
+    }
+    void insert(uint64_t k) {
+        bool success, found;
+        std::tie(success, found) = m.insert_row(make_key(k), Sto::tx_alloc<row_type>());
+        if (!success)
+            throw Transaction::Abort();
+    }
+    void erase(uint64_t k) {
+        bool success, found;
+        std::tie(success, found) = m.delete_row(make_key(k));
+        if (!success)
+            throw Transaction::Abort();
+    }
+};
+
+struct thread_result {
+    uint64_t commits;
+    uint64_t attempts;
+};
+
+template <typename M>
+void run(M* m, int me, thread_result* result) {
+    TThread::set_id(me);
+    m->thread_init();
+    Rand transgen(initial_seeds[2*me], initial_seeds[2*me + 1]);
+    std::uniform_int_distribution<int> dist(0, 99);
+    uint64_t range = partitioned ? nkeys / nthreads : nkeys;
+    uint64_t base = partitioned ? me * range : 0;
+    std::uniform_int_distribution<uint64_t> keydist(0, range - 1);
+    uint64_t attempts = 0;
+    int n = ntrans / nthreads;
+    for (int i = 0; i < n; ++i) {
+        // so that retries of this transaction do the same thing
+        Rand transgen_snap = transgen;
+        TRANSACTION_E {
+            ++attempts;
+            transgen = transgen_snap;
+            for (int j = 0; j < opspertrans; ++j) {
+                uint64_t k = base + keydist(transgen);
+                if (dist(transgen) >= write_percent * 100)
+                    m->lookup(k);
+                else if (m->lookup(k))
+                    m->erase(k);
+                else
+                    m->insert(k);
+            }
+        } RETRY_E(true);
+    }
+    result->commits = n;
+    result->attempts = attempts;
+}
+
+template <typename M>
+void run_and_report(const char* name) {
+    M* m = new M;
+    m->thread_init();
+    for (int k = 0; k < nkeys; k += 2)
+        m->nontrans_insert(k);
+
+    std::vector<thread_result> results(nthreads);
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nthreads; ++i)
+        threads.emplace_back(run<M>, m, i, &results[i]);
+    for (auto& t : threads)
+        t.join();
+    gettimeofday(&tv2, NULL);
+
+    uint64_t commits = 0, attempts = 0;
+    for (auto& r : results) {
+        commits += r.commits;
+        attempts += r.attempts;
+    }
+    double time = (tv2.tv_sec - tv1.tv_sec) + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("%s: %.0f txns/s, %.2f%% aborts (%llu commits, %llu attempts, %.3fs)\n",
+           name, commits / time, 100.0 * (attempts - commits) / attempts,
+           (unsigned long long) commits, (unsigned long long) attempts, time);
+    delete m;
+}
+
+enum {
+    opt_nthreads = 1, opt_ntrans, opt_opspertrans, opt_writepercent, opt_nkeys,
+    opt_partitioned, opt_seed
+};
+
+static const Clp_Option options[] = {
+    { "nthreads", 0, opt_nthreads, Clp_ValInt, Clp_Optional },
+    { "ntrans", 0, opt_ntrans, Clp_ValInt, Clp_Optional },
+    { "opspertrans", 0, opt_opspertrans, Clp_ValInt, Clp_Optional },
+    { "writepercent", 0, opt_writepercent, Clp_ValDouble, Clp_Optional },
+    { "keys", 0, opt_nkeys, Clp_ValInt, Clp_Optional },
+    { "partitioned", 0, opt_partitioned, 0, Clp_Negate },
+    { "seed", 0, opt_seed, Clp_ValInt, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: skiplist_throughput [OPTIONS] [skiplist|oindex]...\n\
+           Options:\n\
+           --nthreads=NTHREADS (default %d)\n\
+           --ntrans=NTRANS, how many total transactions to run (they'll be split between threads) (default %d)\n\
+           --opspertrans=OPSPERTRANS, how many operations to run per transaction (default %d)\n\
+           --writepercent=WRITEPERCENT, probability with which an operation inserts or erases (default %f)\n\
+           --keys=KEYS, size of the key space, half of which is prepopulated (default %d)\n\
+           --partitioned, give each thread its own key range\n\
+           --seed=SEED, global seed to run the experiment \n",
+           nthreads, ntrans, opspertrans, write_percent, nkeys);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    std::vector<const char*> tests;
+
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+        case opt_nthreads:
+            nthreads = clp->val.i;
+            break;
+        case opt_ntrans:
+            ntrans = clp->val.i;
+            break;
+        case opt_opspertrans:
+            opspertrans = clp->val.i;
+            break;
+        case opt_writepercent:
+            write_percent = clp->val.d;
+            break;
+        case opt_nkeys:
+            nkeys = clp->val.i;
+            break;
+        case opt_partitioned:
+            partitioned = !clp->negated;
+            break;
+        case opt_seed:
+            global_seed = clp->val.i;
+            break;
+        case Clp_NotOption:
+            tests.push_back(clp->vstr);
+            break;
+        default:
+            help();
+        }
+    }
+    Clp_DeleteParser(clp);
+
+    if (tests.empty()) {
+        tests.push_back("skiplist");
+        tests.push_back("oindex");
+    }
+
+    if (global_seed)
+        srandom(global_seed);
+    else
+        srandomdev();
+    for (unsigned i = 0; i < arraysize(initial_seeds); ++i)
+        initial_seeds[i] = random();
+
+    pthread_t advancer;
+    pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
+    pthread_detach(advancer);
+
+    for (auto test : tests) {
+        if (strcmp(test, "skiplist") == 0)
+            run_and_report<skiplist_map>("skiplist");
+        else if (strcmp(test, "oindex") == 0)
+            run_and_report<oindex_map>("oindex");
+        else
+            help();
+    }
+    return 0;
+}
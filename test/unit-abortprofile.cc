@@ -0,0 +1,101 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include "Sto.hh"
+#include "TBox.hh"
+
+static const unsigned test_type = AbortProfile::add_type("test_txn");
+
+void testTypes() {
+    assert(strcmp(AbortProfile::type_name(0), "untyped") == 0);
+    assert(test_type != 0);
+    assert(AbortProfile::add_type("test_txn") == test_type);
+    assert(strcmp(AbortProfile::type_name(test_type), "test_txn") == 0);
+    assert(AbortProfile::retry_bucket(0) == 0);
+    assert(AbortProfile::retry_bucket(3) == 3);
+    assert(AbortProfile::retry_bucket(4) == 4);
+    assert(AbortProfile::retry_bucket(7) == 4);
+    assert(AbortProfile::retry_bucket(8) == 5);
+    assert(AbortProfile::retry_bucket(1000000) == AbortProfile::retry_buckets - 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDisabled() {
+    TThread::set_id(0);
+    Transaction::clear_stats();
+    TBox<int> box;
+    TRANSACTION_E {
+        box = box + 1;
+    } RETRY_E(true);
+    auto t = AbortProfile::combined(0);
+    assert(t.commits == 0 && t.aborts == 0 && t.retries[0] == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAttempts() {
+    Transaction::clear_stats();
+    AbortProfile::enable();
+    TBox<int> box;
+    {
+        TestTransaction t1(1);
+        box = box + 1;
+        TestTransaction t2(2);
+        box = 5;
+        assert(t2.try_commit());
+        TThread::set_id(1);
+        AbortProfile::type_scope scope(test_type);
+        assert(!t1.try_commit());
+    }
+    {
+        TThread::set_id(0);
+        AbortProfile::type_scope scope(test_type);
+        TRANSACTION_E {
+            box = box + 1;
+        } RETRY_E(true);
+    }
+    AbortProfile::disable();
+
+    auto t = AbortProfile::combined(test_type);
+    assert(t.aborts == 1 && t.abort_cycles > 0);
+    assert(t.commits == 1 && t.commit_cycles > 0);
+    assert(t.nreasons == 1);
+    assert(strcmp(t.reasons[0].reason, "commit check") == 0);
+    assert(t.reasons[0].aborts == 1);
+    // one logical transaction, which committed on its first attempt
+    assert(t.retries[0] == 1);
+    auto u = AbortProfile::combined(0);
+    assert(u.commits == 1 && u.aborts == 0);
+    AbortProfile::report(stdout);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRetries() {
+    TThread::set_id(0);
+    Transaction::clear_stats();
+    AbortProfile::enable();
+    TBox<int> box;
+    int tries = 0;
+    {
+        AbortProfile::type_scope scope(test_type);
+        TRANSACTION_E {
+            box = box + 1;
+            if (++tries < 3)
+                Sto::abort();
+        } RETRY_E(true);
+    }
+    AbortProfile::disable();
+    auto t = AbortProfile::combined(test_type);
+    assert(t.aborts == 2 && t.commits == 1);
+    assert(t.retries[2] == 1);
+    assert(strcmp(t.reasons[0].reason, "unattributed") == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testTypes();
+    testDisabled();
+    testAttempts();
+    testRetries();
+    return 0;
+}
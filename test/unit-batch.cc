@@ -0,0 +1,137 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "TransactionBatch.hh"
+
+void testBatch() {
+    // members commit in one round, with one start callback between them
+    constexpr int nboxes = 10;
+    std::vector<TBox<int>> boxes(nboxes);
+    int callbacks = 0;
+    TThread::set_id(0);
+    auto& thr = Transaction::tinfo[0];
+    thr.trans_start_callback = [&] { ++callbacks; };
+    thr.trans_end_callback = [&] { --callbacks; };
+    TransactionBatch b;
+    for (int i = 0; i < 1000; ++i)
+        b.add([&, i] {
+                assert(callbacks == 1 && Sto::transaction()->in_batch());
+                boxes[i % nboxes] = boxes[i % nboxes] + 1;
+            });
+    assert(b.run());
+    assert(b.rounds() == 1 && callbacks == 0);
+    thr.trans_start_callback = nullptr;
+    thr.trans_end_callback = nullptr;
+    for (auto& box : boxes)
+        assert(box.nontrans_read() == 100);
+    // an ordinary transaction afterwards starts as usual
+    TRANSACTION_E {
+        assert(!Sto::transaction()->in_batch());
+        boxes[0] = boxes[0] + 1;
+    } RETRY_E(true);
+    assert(boxes[0].nontrans_read() == 101);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRetryFailed() {
+    // only the member that aborted runs again
+    TBox<int> a, b;
+    int runs_a = 0, runs_b = 0;
+    TransactionBatch batch;
+    batch.add([&] {
+            ++runs_a;
+            a = 1;
+        });
+    batch.add([&] {
+            if (++runs_b == 1)
+                throw Transaction::Abort();
+            b = 2;
+        });
+    assert(batch.run());
+    assert(batch.rounds() == 2 && runs_a == 1 && runs_b == 2);
+    assert(a.nontrans_read() == 1 && b.nontrans_read() == 2);
+    // committed members stay committed
+    assert(batch.run() && batch.rounds() == 0 && runs_a == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testBudget() {
+    // a member out of budget stays uncommitted; the others commit
+    TBox<int> a;
+    TransactionBatch batch;
+    batch.add([&] { a = a + 1; });
+    batch.add([&] { throw Transaction::Abort(); });
+    batch.add([&] { a = a + 1; });
+    TransactionOptions opts;
+    opts.max_retries = 3;
+    Sto::set_options(opts);
+    assert(!batch.run());
+    assert(batch.committed(0) && !batch.committed(1) && batch.committed(2));
+    assert(batch.rounds() == 4 && a.nontrans_read() == 2);
+    assert(Sto::transaction()->options().max_retries == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testException() {
+    // another exception ends the batch, with the member rolled back
+    TBox<int> a;
+    TransactionBatch batch;
+    batch.add([&] { a = 1; });
+    batch.add([&] {
+            a = 2;
+            throw std::runtime_error("no");
+        });
+    batch.add([&] { a = 3; });
+    bool threw = false;
+    try {
+        batch.run();
+    } catch (std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw && !Sto::transaction()->in_batch());
+    assert(batch.committed(0) && !batch.committed(1) && !batch.committed(2));
+    assert(a.nontrans_read() == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConcurrent() {
+    // batches on several threads, contending on a few boxes
+    constexpr int nthreads = 4, nbatches = 50, batch_size = 32;
+    std::vector<TBox<int>> boxes(3);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t)
+        threads.emplace_back([&, t] {
+                TThread::set_id(t);
+                for (int n = 0; n < nbatches; ++n) {
+                    TransactionBatch b;
+                    for (int i = 0; i < batch_size; ++i)
+                        b.add([&, i] {
+                                boxes[i % 3] = boxes[i % 3] + 1;
+                            });
+                    assert(b.run());
+                }
+            });
+    for (auto& th : threads)
+        th.join();
+    int total = 0;
+    for (auto& box : boxes)
+        total += box.nontrans_read();
+    assert(total == nthreads * nbatches * batch_size);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testBatch();
+    testRetryFailed();
+    testBudget();
+    testException();
+    testConcurrent();
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 8);
+    return 0;
+}
@@ -0,0 +1,233 @@
+#undef NDEBUG
+#undef STO_CELL_BITMAP
+#define STO_CELL_BITMAP 1
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include "Sto.hh"
+#include "VersionSelector.hh"
+
+struct wide_row {
+    enum class NamedColumn : int { a = 0, b, c, d, e, f };
+    int64_t cols[6];
+};
+
+namespace ver_sel {
+
+// One cell per column
+template <typename VersImpl>
+class VerSel<wide_row, VersImpl> : public VerSelBase<VerSel<wide_row, VersImpl>, VersImpl> {
+public:
+    typedef VersImpl version_type;
+    static constexpr size_t num_versions = 6;
+
+    explicit VerSel(type v) : vers_() {
+        for (auto& vers : vers_)
+            new (&vers) version_type(v);
+    }
+    VerSel(type v, bool insert) : vers_() {
+        for (auto& vers : vers_)
+            new (&vers) version_type(v, insert);
+    }
+
+    constexpr static int map_impl(int col_n) {
+        return col_n;
+    }
+
+    version_type& version_at_impl(int cell) {
+        return vers_[cell];
+    }
+
+    void install_by_cell_impl(wide_row *dst, const wide_row *src, int cell) {
+        dst->cols[cell] = src->cols[cell];
+    }
+
+private:
+    version_type vers_[num_versions];
+};
+
+}  // namespace ver_sel
+
+typedef IndexValueContainer<wide_row, TVersion> container_type;
+static_assert(container_type::cell_bitmap, "wide_row should use a cell bitmap");
+
+// One row whose cells 1-5 share a single item, as in the OCC indexes. The
+// row item (key 0) only buffers the written row; the cells item is key 1.
+class cell_table : public TObject {
+public:
+    cell_table() : row_(Sto::initialized_tid(), wide_row()) {}
+
+    int64_t read(int col) {
+        auto cells = Sto::item(this, 1);
+        if ((cell_versions::written(cells.item()) >> col) & 1)
+            return Sto::item(this, 0).template write_value<wide_row>().cols[col];
+        if (!cell_versions::observe(cells, row_, col))
+            throw Transaction::Abort();
+        return row_.row.cols[col];
+    }
+
+    void write(int col, int64_t v) {
+        auto item = Sto::item(this, 0);
+        if (!item.has_write())
+            item.add_write(row_.row);
+        item.template write_value<wide_row>().cols[col] = v;
+        cell_versions::add_write(Sto::item(this, 1), col);
+    }
+
+    int64_t nontrans_read(int col) {
+        return row_.row.cols[col];
+    }
+
+    bool lock(TransItem& item, Transaction& txn) override {
+        return item.key<int>() == 0 || cell_versions::lock(txn, item, row_);
+    }
+    bool check(TransItem& item, Transaction&) override {
+        return cell_versions::check(item, row_);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        if (item.key<int>() == 0)
+            return;
+        auto& copy = Sto::item(this, 0).template write_value<wide_row>();
+        cell_versions::for_each(cell_versions::written(item), [&](int cell) {
+                row_.install_cell(cell, &copy);
+            });
+        cell_versions::set_version_unlock(txn, item, row_);
+    }
+    void unlock(TransItem& item) override {
+        if (item.key<int>() != 0)
+            cell_versions::unlock(item, row_);
+    }
+
+private:
+    container_type row_;
+};
+
+static bool reference_check(const uint64_t* cur, const uint64_t* snap, unsigned n,
+                            uint64_t read, uint64_t owned) {
+    for (unsigned c = 0; c != n; ++c) {
+        if (!((read >> c) & 1))
+            continue;
+        if (TransactionTid::is_locked(cur[c]) && !((owned >> c) & 1))
+            return false;
+        if (!TransactionTid::check_version(cur[c], snap[c]))
+            return false;
+    }
+    return true;
+}
+
+void testKernels() {
+    std::mt19937_64 rng(53);
+    bool avx2 = cpu_simd_level() != SimdLevel::scalar;
+    uint64_t cur[64], snap[64];
+    for (int trial = 0; trial != 20000; ++trial) {
+        unsigned n = 1 + rng() % 64;
+        uint64_t all = n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+        for (unsigned c = 0; c != n; ++c) {
+            snap[c] = (rng() % 4) * TransactionTid::increment_value;
+            cur[c] = snap[c];
+            // a few cells move on, or are locked
+            if (rng() % 32 == 0)
+                cur[c] += TransactionTid::increment_value;
+            if (rng() % 32 == 0)
+                cur[c] |= TransactionTid::lock_bit | (rng() % 8);
+        }
+        uint64_t read = rng() & rng() & all, owned = rng() & all;
+        bool expected = reference_check(cur, snap, n, read, owned);
+        assert(cell_versions::check_scalar(cur, snap, n, read, owned) == expected);
+        if (avx2)
+            assert(cell_versions::check_avx2(cur, snap, n, read, owned) == expected);
+        assert(cell_versions::check_kernel(cur, snap, n, read, owned) == expected);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRangeKernels() {
+    std::mt19937_64 rng(87);
+    bool avx2 = cpu_simd_level() != SimdLevel::scalar;
+    uint64_t cur[3 * 64], snap[64];
+    for (int trial = 0; trial != 20000; ++trial) {
+        unsigned n = rng() % 65, stride = 1 + rng() % 3;
+        int here = rng() % 8;
+        bool expected = true;
+        for (unsigned i = 0; i != n; ++i) {
+            uint64_t& c = cur[i * stride];
+            snap[i] = (rng() % 4) * TransactionTid::increment_value;
+            c = snap[i];
+            if (rng() % 64 == 0)
+                c += TransactionTid::increment_value;
+            if (rng() % 64 == 0)
+                c |= TransactionTid::lock_bit | (rng() % 8);
+            if (!TransactionTid::check_version(c, snap[i])
+                || (TransactionTid::is_locked(c) && !TransactionTid::is_locked_here(c, here)))
+                expected = false;
+        }
+        assert(cell_versions::check_range_scalar(cur, stride, snap, n, here) == expected);
+        if (avx2)
+            assert(cell_versions::check_range_avx2(cur, stride, snap, n, here) == expected);
+        assert(cell_versions::check_range_kernel(cur, stride, snap, n, here) == expected);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDisjointCells() {
+    cell_table t;
+    {
+        TestTransaction t1(1);
+        assert(t.read(1) == 0 && t.read(2) == 0);
+        t.write(5, 1);
+
+        TestTransaction t2(2);
+        t.write(3, 7);
+        assert(t2.try_commit());
+
+        // cells 1 and 2 did not change
+        assert(t1.try_commit());
+    }
+    assert(t.nontrans_read(3) == 7 && t.nontrans_read(5) == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConflictingCell() {
+    cell_table t;
+    {
+        TestTransaction t1(1);
+        assert(t.read(1) == 0 && t.read(4) == 0);
+        t.write(5, 1);
+
+        TestTransaction t2(2);
+        assert(t.read(2) == 0);
+        t.write(4, 9);
+        assert(t2.try_commit());
+
+        assert(!t1.try_commit());
+    }
+    assert(t.nontrans_read(4) == 9 && t.nontrans_read(5) == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testReadMyWrite() {
+    cell_table t;
+    {
+        TestTransaction t1(1);
+        assert(t.read(2) == 0);
+        t.write(2, 4);
+        t.write(3, 5);
+        assert(t.read(2) == 4 && t.read(3) == 5);
+        assert(t1.try_commit());
+    }
+    {
+        TestTransaction t2(2);
+        assert(t.read(2) == 4 && t.read(3) == 5);
+        assert(t2.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testKernels();
+    testRangeKernels();
+    testDisjointCells();
+    testConflictingCell();
+    testReadMyWrite();
+    return 0;
+}
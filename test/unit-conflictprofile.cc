@@ -0,0 +1,105 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include "Sto.hh"
+#include "TBox.hh"
+
+void testAttribution() {
+    ConflictProfile::clear();
+    ConflictProfile::enable();
+    TBox<int> hot;
+    TBox<int> cold;
+
+    for (int i = 0; i != 3; ++i) {
+        TestTransaction t1(1);
+        int x = hot;
+        cold = x + 1;
+
+        TestTransaction t2(2);
+        hot = i;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    ConflictProfile::disable();
+
+    auto objects = ConflictProfile::top(10, false);
+    assert(objects.size() == 1);
+    assert(objects[0].object == &hot);
+    assert(objects[0].count == 3 && objects[0].err == 0);
+    assert(strstr(objects[0].reason, "check"));
+    auto keys = ConflictProfile::top(10, true);
+    assert(keys.size() == 1 && keys[0].object == &hot && keys[0].count == 3);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDisabled() {
+    ConflictProfile::clear();
+    TBox<int> hot;
+    {
+        TestTransaction t1(1);
+        int x = hot;
+        hot = x + 1;
+
+        TestTransaction t2(2);
+        hot = 5;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(ConflictProfile::top(10, false).empty());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSketch() {
+    ConflictProfile::clear();
+    ConflictProfile::enable();
+    TBox<int> boxes[2];
+    // a heavy hitter among more keys than the sketch holds
+    for (uint64_t k = 0; k != 4 * ConflictProfile::sketch_size; ++k) {
+        ConflictProfile::record(0, &boxes[0], 7, "commit check");
+        ConflictProfile::record(0, &boxes[1], 1000 + k, "commit lock");
+    }
+    for (int t = 1; t != 3; ++t)
+        ConflictProfile::record(t, &boxes[0], 7, "commit lock");
+    ConflictProfile::disable();
+
+    auto keys = ConflictProfile::top(1, true);
+    assert(keys.size() == 1);
+    assert(keys[0].object == &boxes[0] && keys[0].key == 7);
+    assert(keys[0].count >= 4 * ConflictProfile::sketch_size + 2);
+    assert(keys[0].count - keys[0].err <= 4 * ConflictProfile::sketch_size + 2);
+
+    auto objects = ConflictProfile::top(10, false);
+    assert(objects.size() == 2);
+    assert(objects[0].count == objects[1].count + 2);
+    ConflictProfile::clear();
+    assert(ConflictProfile::top(10, true).empty());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testKeyBuckets() {
+    ConflictProfile::clear();
+    ConflictProfile::enable(4);
+    TBox<int> box;
+    for (uint64_t k = 0; k != 100; ++k)
+        ConflictProfile::record(0, &box, k, "commit check");
+    ConflictProfile::disable();
+    auto keys = ConflictProfile::top(10, true);
+    assert(keys.size() <= 4);
+    uint64_t total = 0;
+    for (auto& e : keys) {
+        assert(e.key < 4);
+        total += e.count;
+    }
+    assert(total == 100);
+    ConflictProfile::clear();
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testAttribution();
+    testDisabled();
+    testSketch();
+    testKeyBuckets();
+    return 0;
+}
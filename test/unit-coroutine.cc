@@ -0,0 +1,161 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "TxnCoroutine.hh"
+
+#if __cpp_impl_coroutine
+
+static TxnCoroutine increment(TBox<int>& box, int& ran) {
+    ++ran;
+    int v = box;
+    co_await TxnCoScheduler::yield();
+    box = v + 1;
+}
+
+void testCommit() {
+    // transactions on one box interleave at yield(), so all but one of
+    // every overlapping group abort and run again; each commits once
+    TBox<int> box;
+    int ran = 0;
+    TxnCoScheduler sched(8);
+    for (int i = 0; i < 100; ++i)
+        sched.spawn([&] { return increment(box, ran); });
+    sched.run();
+    assert(box.nontrans_read() == 100);
+    auto s = sched.statistics();
+    assert(s.committed == 100 && s.failed == 0 && s.aborts > 0);
+    assert(ran == 100 + int(s.aborts));
+    printf("PASS: %s (%llu aborts)\n", __FUNCTION__, (unsigned long long) s.aborts);
+}
+
+static TxnCoroutine wait_then_write(TBox<int>& box, const int& committed, int& seen) {
+    co_await TxnCoScheduler::wait_until([&] { return committed == 10; });
+    seen = committed;
+    box = 1;
+}
+
+static TxnCoroutine write_one(TBox<int>& box, int i) {
+    box = i;
+    co_return;
+}
+
+void testWait() {
+    // one transaction waits in the middle while others start and commit
+    TBox<int> waiter;
+    std::vector<TBox<int>> boxes(10);
+    int committed = 0, seen = -1;
+    TxnCoScheduler sched(4);
+    sched.spawn([&] { return wait_then_write(waiter, committed, seen); });
+    for (int i = 0; i < 10; ++i)
+        sched.spawn([&, i] { return write_one(boxes[i], i + 1); },
+                    [&](std::exception_ptr err) {
+                        assert(!err);
+                        ++committed;
+                    });
+    sched.run();
+    assert(seen == 10 && waiter.nontrans_read() == 1);
+    for (int i = 0; i < 10; ++i)
+        assert(boxes[i].nontrans_read() == i + 1);
+    auto s = sched.statistics();
+    assert(s.committed == 11 && s.aborts == 0 && s.suspensions > 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+static TxnCoroutine fail(TBox<int>& box) {
+    box = 5;
+    co_await TxnCoScheduler::yield();
+    throw std::runtime_error("no");
+}
+
+static TxnCoroutine abort_once(TBox<int>& box, int& n) {
+    if (n++ == 0)
+        throw Transaction::Abort();
+    box = box + 2;
+    co_return;
+}
+
+void testFailure() {
+    // an exception other than Abort ends the transaction, rolled back;
+    // run() rethrows it once the rest finished
+    TBox<int> box;
+    int n = 0;
+    TxnCoScheduler sched;
+    sched.spawn([&] { return fail(box); });
+    sched.spawn([&] { return abort_once(box, n); });
+    bool threw = false;
+    try {
+        sched.run();
+    } catch (std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(box.nontrans_read() == 2);
+    auto s = sched.statistics();
+    assert(s.committed == 1 && s.failed == 1 && s.aborts == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+static TxnCoroutine check_hold(TBox<int>& box, TransactionTid::type& wtid) {
+    auto& thr = Transaction::tinfo[TThread::id()];
+    assert(Sto::transaction()->in_batch());
+    if (!wtid)
+        wtid = thr.wtid.load();
+    assert(wtid && thr.wtid.load() == wtid);
+    box = box + 1;
+    co_await TxnCoScheduler::yield();
+    assert(thr.wtid.load() == wtid);
+}
+
+void testHold() {
+    // the thread's wtid and callbacks are set once for the transactions
+    // in flight together, and released after
+    TBox<int> box;
+    TThread::set_id(0);
+    auto& thr = Transaction::tinfo[0];
+    int callbacks = 0;
+    thr.trans_start_callback = [&] { ++callbacks; };
+    thr.trans_end_callback = [&] { --callbacks; };
+    TransactionTid::type wtid = 0;
+    TxnCoScheduler sched(4);
+    for (int i = 0; i < 4; ++i)
+        sched.spawn([&] {
+                assert(callbacks == 1);
+                return check_hold(box, wtid);
+            });
+    sched.run();
+    assert(callbacks == 0 && thr.wtid.load() == 0);
+    assert(sched.statistics().holds == 1);
+    thr.trans_start_callback = nullptr;
+    thr.trans_end_callback = nullptr;
+    // the thread's own transaction is untouched
+    TRANSACTION_E {
+        assert(!Sto::transaction()->in_batch());
+        box = box + 1;
+    } RETRY_E(true);
+    assert(box.nontrans_read() == 5);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testCommit();
+    testWait();
+    testFailure();
+    testHold();
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 8);
+    return 0;
+}
+
+#else
+
+int main() {
+    printf("SKIP: unit-coroutine needs C++20 coroutines\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,241 @@
+#undef NDEBUG
+#include <cassert>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "DB_art.hh"
+
+struct leaf {
+    uint64_t key;       // big-endian, so byte order is key order
+    uint64_t id;
+    explicit leaf(uint64_t k) : key(__builtin_bswap64(k)), id(k) {}
+};
+
+struct leaf_key {
+    const void* operator()(const leaf* x) const {
+        return &x->key;
+    }
+};
+
+typedef bench::art_tree<leaf, sizeof(uint64_t), leaf_key> tree_type;
+typedef tree_type::node node;
+
+static uint64_t be(uint64_t k) {
+    return __builtin_bswap64(k);
+}
+
+static leaf* lookup(const tree_type& t, uint64_t k) {
+    uint64_t key = be(k);
+    return t.lookup(&key);
+}
+
+// Keys visited from k on, up to limit of them
+template <bool Reverse>
+static std::vector<uint64_t> scan(const tree_type& t, uint64_t k, size_t limit = -1) {
+    std::vector<uint64_t> ids;
+    uint64_t key = be(k);
+    auto node_cb = [](node*, tree_type::version_value_type) { return true; };
+    auto leaf_cb = [&](leaf* x) {
+        ids.push_back(x->id);
+        return ids.size() < limit;
+    };
+    assert(t.scan<Reverse>(&key, node_cb, leaf_cb));
+    return ids;
+}
+
+// Observer keeping the nodes an insert changed, with their new versions
+struct recorder {
+    std::vector<std::pair<node*, tree_type::version_value_type>> changes;
+    void changed(node* n, tree_type::version_value_type before, tree_type::version_value_type after) {
+        assert(before != after);
+        changes.emplace_back(n, after);
+    }
+    void created(node*, tree_type::version_value_type) {
+    }
+};
+
+void testInsertLookup() {
+    tree_type t;
+    std::mt19937_64 rng(1);
+    std::vector<leaf*> leaves;
+    std::set<uint64_t> keys;
+    for (int i = 0; i != 20000; ++i) {
+        // mix dense and sparse keys, so every node kind appears
+        uint64_t k = i % 2 ? rng() : rng() % 5000;
+        if (!keys.insert(k).second)
+            continue;
+        leaves.push_back(new leaf(k));
+        assert(t.insert(leaves.back()) == nullptr);
+    }
+    for (leaf* x : leaves) {
+        assert(lookup(t, x->id) == x);
+        // a second insert finds the first
+        leaf dup(x->id);
+        assert(t.insert(&dup) == x);
+    }
+    for (uint64_t k = 0; k != 10000; ++k)
+        assert(!lookup(t, k) == !keys.count(k));
+    for (leaf* x : leaves)
+        delete x;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testScan() {
+    tree_type t;
+    std::mt19937_64 rng(2);
+    std::vector<leaf*> leaves;
+    std::set<uint64_t> keys;
+    for (int i = 0; i != 3000; ++i) {
+        uint64_t k = rng() % 100000;
+        if (keys.insert(k).second) {
+            leaves.push_back(new leaf(k));
+            t.insert(leaves.back());
+        }
+    }
+    for (int i = 0; i != 200; ++i) {
+        uint64_t k = i == 0 ? 0 : rng() % 110000;
+        std::vector<uint64_t> expect(keys.lower_bound(k), keys.end());
+        assert(scan<false>(t, k) == expect);
+        std::vector<uint64_t> rexpect(std::make_reverse_iterator(keys.upper_bound(k)), keys.rend());
+        assert(scan<true>(t, k) == rexpect);
+        // a stopped scan visits a prefix of the keys
+        auto first = scan<false>(t, k, 5);
+        assert(first.size() == std::min(size_t(5), expect.size()));
+        assert(std::equal(first.begin(), first.end(), expect.begin()));
+    }
+    // from the ends of the key space
+    assert(scan<true>(t, ~uint64_t(0)).size() == keys.size());
+    assert(scan<false>(t, ~uint64_t(0)).empty());
+    for (leaf* x : leaves)
+        delete x;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRemove() {
+    tree_type t;
+    std::vector<leaf*> leaves;
+    for (uint64_t k = 0; k != 1000; ++k) {
+        leaves.push_back(new leaf(k * 37));
+        t.insert(leaves.back());
+    }
+    for (uint64_t k = 0; k != 1000; k += 2) {
+        uint64_t key = be(k * 37);
+        assert(t.remove(&key) == leaves[k]);
+        assert(t.remove(&key) == nullptr);
+    }
+    for (uint64_t k = 0; k != 1000; ++k)
+        assert((lookup(t, k * 37) != nullptr) == (k % 2 == 1));
+    assert(scan<false>(t, 0).size() == 500);
+    // removed keys can come back
+    assert(t.insert(leaves[0]) == nullptr);
+    assert(lookup(t, 0) == leaves[0]);
+    for (leaf* x : leaves)
+        delete x;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testWitness() {
+    // an insert of an absent key changes the node that witnessed it
+    tree_type t;
+    std::vector<leaf*> leaves;
+    std::mt19937_64 rng(3);
+    for (int i = 0; i != 2000; ++i) {
+        leaves.push_back(new leaf(rng() % 4096));
+        t.insert(leaves.back());
+    }
+    for (int i = 0; i != 2000; ++i) {
+        uint64_t k = rng() % 8192;
+        uint64_t key = be(k);
+        node* w = nullptr;
+        tree_type::version_value_type wv {};
+        if (t.lookup(&key, w, wv))
+            continue;
+        assert(tree_type::current_version(w) == wv);
+        leaves.push_back(new leaf(k));
+        recorder r;
+        assert(t.insert(leaves.back(), r) == nullptr);
+        assert(tree_type::current_version(w) != wv);
+        assert(std::any_of(r.changes.begin(), r.changes.end(), [&](auto& c) {
+                    return c.first == w && c.second == tree_type::current_version(w);
+                }));
+    }
+    // and so does an insert into the range of a scan, at a node it read
+    std::vector<std::pair<node*, tree_type::version_value_type>> read;
+    uint64_t key = be(1000);
+    auto node_cb = [&](node* n, tree_type::version_value_type v) {
+        read.emplace_back(n, v);
+        return true;
+    };
+    uint64_t last = 0;
+    auto leaf_cb = [&](leaf* x) {
+        last = x->id;
+        return x->id < 2000;
+    };
+    assert(t.scan<false>(&key, node_cb, leaf_cb));
+    for (uint64_t k = 1001; k < last; ++k) {
+        if (lookup(t, k))
+            continue;
+        leaves.push_back(new leaf(k));
+        t.insert(leaves.back());
+        break;
+    }
+    assert(std::any_of(read.begin(), read.end(), [](auto& r) {
+                return tree_type::current_version(r.first) != r.second;
+            }));
+    for (leaf* x : leaves)
+        delete x;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConcurrent() {
+    // inserters race on interleaved keys while scanners check key order
+    tree_type t;
+    constexpr uint64_t per_thread = 50000;
+    std::vector<leaf*> leaves(4 * per_thread);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> threads;
+    for (int th = 0; th != 4; ++th)
+        threads.emplace_back([&, th] {
+            TThread::set_id(th);
+            for (uint64_t i = 0; i != per_thread; ++i) {
+                uint64_t k = i * 4 + th;
+                leaves[k] = new leaf(k * 2654435761U);
+                assert(t.insert(leaves[k]) == nullptr);
+                assert(lookup(t, k * 2654435761U) == leaves[k]);
+            }
+        });
+    std::thread scanner([&] {
+            TThread::set_id(4);
+            while (!done) {
+                auto ids = scan<false>(t, 0, 1000);
+                assert(std::is_sorted(ids.begin(), ids.end()));
+                assert(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+            }
+        });
+    for (auto& th : threads)
+        th.join();
+    done = true;
+    scanner.join();
+    for (uint64_t k = 0; k != 4 * per_thread; ++k)
+        assert(lookup(t, k * 2654435761U) == leaves[k]);
+    assert(scan<false>(t, 0).size() == 4 * per_thread);
+    for (leaf* x : leaves)
+        delete x;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testInsertLookup();
+    testScan();
+    testRemove();
+    testWitness();
+    testConcurrent();
+
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 5);
+    return 0;
+}
@@ -0,0 +1,202 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "DB_buckets.hh"
+
+using bench::resizable_buckets;
+
+struct node {
+    node* next;
+    uint64_t key;
+    explicit node(uint64_t k) : next(nullptr), key(k) {}
+};
+
+typedef resizable_buckets<node, TNonopaqueVersion> buckets_type;
+typedef buckets_type::bucket_entry bucket_entry;
+
+static size_t hash_node(const node* n) {
+    return n->key;
+}
+
+static node* find_in(const bucket_entry& b, uint64_t k, size_t* depth = nullptr) {
+    return buckets_type::find_in(b, k, [&](const node* n) { return n->key == k; }, depth);
+}
+
+static void insert(buckets_type& bs, uint64_t k) {
+    bs.help_migrate(hash_node);
+    bucket_entry& b = bs.lock(k);
+    size_t depth = 0;
+    node* n = find_in(b, k, &depth);
+    if (!n) {
+        n = new node(k);
+        buckets_type::insert(b, k, n);
+        b.version.inc_nonopaque();
+    }
+    b.version.unlock_exclusive();
+    bs.note_insert(b, depth, hash_node);
+}
+
+static node* lookup(buckets_type& bs, uint64_t k) {
+    return bs.nontrans_find(k, [&](const node* n) { return n->key == k; });
+}
+
+static size_t count_all(buckets_type& bs) {
+    size_t n = 0;
+    bs.for_each(hash_node, [&](const bucket_entry& b) {
+            buckets_type::for_each_node(b, [&](node*) { ++n; });
+        });
+    return n;
+}
+
+static void free_all(buckets_type& bs) {
+    std::vector<node*> nodes;
+    bs.for_each(hash_node, [&](const bucket_entry& b) {
+            buckets_type::for_each_node(b, [&](node* e) { nodes.push_back(e); });
+        });
+    for (node* e : nodes)
+        delete e;
+}
+
+void testProbes() {
+    // interleaved probes find what find_in finds, along slots and chains
+    buckets_type bs(8);
+    std::vector<node*> nodes;
+    for (uint64_t k = 0; k != 200; ++k) {
+        bucket_entry& b = bs.lock(k);
+        nodes.push_back(new node(k));
+        buckets_type::insert(b, k, nodes.back());
+        b.version.unlock_exclusive();
+    }
+    assert(bs.nbuckets() == 8);
+    const size_t n = 40;
+    buckets_type::probe ps[n];
+    for (size_t i = 0; i != n; ++i)
+        ps[i] = buckets_type::probe(i * 7);
+    bs.run_probes(ps, n, [&](size_t i) {
+            uint64_t k = i * 7;
+            return [k](const node* e) { return e->key == k; };
+        });
+    for (size_t i = 0; i != n; ++i) {
+        assert(ps[i].done());
+        assert(ps[i].node() == (i * 7 < 200 ? nodes[i * 7] : nullptr));
+        assert(&ps[i].bucket() == &bs.lock(i * 7));
+        ps[i].bucket().version.unlock_exclusive();
+    }
+    for (node* e : nodes)
+        delete e;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testGrow() {
+    buckets_type bs(4);
+    for (uint64_t k = 0; k != 10000; ++k)
+        insert(bs, k);
+    assert(bs.nbuckets() >= 10000 / (2 * (buckets_type::nslots + buckets_type::max_chain)));
+    for (uint64_t k = 0; k != 10000; ++k) {
+        node* n = lookup(bs, k);
+        assert(n && n->key == k);
+    }
+    assert(!lookup(bs, 10000));
+    assert(count_all(bs) == 10000);
+    free_all(bs);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSlots() {
+    static_assert(sizeof(bucket_entry) == 64, "bucket is one cache line");
+    buckets_type bs(1);
+    bucket_entry& b = bs.lock(0);
+    std::vector<node*> nodes;
+    for (uint64_t k = 0; k != buckets_type::nslots + 2; ++k) {
+        nodes.push_back(new node(k));
+        buckets_type::insert(b, k, nodes.back());
+    }
+    // the first nslots keys fill the slots, the rest overflow
+    for (unsigned i = 0; i != buckets_type::nslots; ++i)
+        assert(b.slot[i] == nodes[i]);
+    assert(b.head == nodes.back() && b.head->next == nodes[buckets_type::nslots]);
+    for (uint64_t k = 0; k != nodes.size(); ++k) {
+        size_t depth = 0;
+        assert(find_in(b, k, &depth) == nodes[k]);
+        assert(depth == (k < buckets_type::nslots ? 0 : nodes.size() - 1 - k));
+    }
+    assert(!find_in(b, nodes.size()));
+    // an emptied slot is reused before the chain grows
+    assert(buckets_type::erase(b, nodes[1]));
+    assert(!buckets_type::erase(b, nodes[1]));
+    assert(!find_in(b, 1));
+    buckets_type::insert(b, 1, nodes[1]);
+    assert(b.slot[1] == nodes[1] && find_in(b, 1) == nodes[1]);
+    assert(buckets_type::erase(b, nodes[buckets_type::nslots]));
+    assert(b.head == nodes.back() && !b.head->next);
+    b.version.unlock_exclusive();
+    for (node* n : nodes)
+        delete n;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOneHotBucket() {
+    // colliding keys don't grow the table past what the sampled load needs
+    buckets_type bs(64);
+    for (uint64_t k = 0; k != 200; ++k)
+        insert(bs, k * 64);
+    assert(bs.nbuckets() == 64);
+    free_all(bs);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testMovedVersion() {
+    // an absence observed in a bucket that is later migrated fails validation
+    buckets_type bs(4);
+    TNonopaqueVersion v;
+    bucket_entry& b = bs.find(3, v);
+    assert(!find_in(b, 3));
+    for (uint64_t k = 0; k != 1000; ++k)
+        if (k != 3)
+            insert(bs, k);
+    assert(bs.nbuckets() > 4);
+    assert(b.moved && b.version.value() != v.value());
+    bucket_entry& nb = bs.find(3, v);
+    assert(&nb != &b && !nb.moved);
+    free_all(bs);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConcurrent() {
+    buckets_type bs(16);
+    const uint64_t per_thread = 50000;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t != 4; ++t)
+        threads.emplace_back([&, t] {
+            for (uint64_t i = 0; i != per_thread; ++i) {
+                uint64_t k = i * 4 + t;
+                insert(bs, k);
+                // our own keys stay visible while others migrate
+                if (i % 7 == 0) {
+                    uint64_t j = (i / 2) * 4 + t;
+                    node* n = lookup(bs, j);
+                    assert(n && n->key == j);
+                }
+            }
+        });
+    for (auto& th : threads)
+        th.join();
+    for (uint64_t k = 0; k != 4 * per_thread; ++k)
+        assert(lookup(bs, k));
+    assert(count_all(bs) == 4 * per_thread);
+    free_all(bs);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSlots();
+    testProbes();
+    testGrow();
+    testOneHotBucket();
+    testMovedVersion();
+    testConcurrent();
+    return 0;
+}
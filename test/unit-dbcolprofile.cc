@@ -0,0 +1,64 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include "Sto.hh"
+#include "DB_column_profile.hh"
+
+namespace profiled {
+struct row_a {};
+struct row_b {};
+}
+
+enum class access_t : int8_t { none = 0, read = 1, write = 2, update = 3 };
+
+struct column_access_t {
+    int col_id;
+    access_t access;
+};
+
+static void record_a(std::initializer_list<column_access_t> accesses) {
+    bench::column_profile::record<profiled::row_a>(accesses);
+}
+
+// Lines of row's section of the dump, after its header
+static std::string section(const std::string& dump, const std::string& row) {
+    auto begin = dump.find("row " + row + " ");
+    assert(begin != std::string::npos);
+    begin = dump.find('\n', begin) + 1;
+    auto end = dump.find("row ", begin);
+    return dump.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+void testPatterns() {
+    TThread::set_id(0);
+    for (int i = 0; i != 3; ++i)
+        record_a({{0, access_t::read}, {2, access_t::read}});
+    record_a({{2, access_t::read}, {0, access_t::read}});
+    record_a({{1, access_t::update}, {3, access_t::write}});
+    TThread::set_id(2);
+    record_a({{0, access_t::read}, {2, access_t::read}});
+    // columns past the mask width are dropped
+    record_a({{bench::column_profile::max_columns, access_t::write}});
+    bench::column_profile::record<profiled::row_b>(
+        std::initializer_list<column_access_t>{{5, access_t::read}});
+
+    std::ostringstream out;
+    bench::column_profile::dump(out);
+    std::string dump = out.str();
+    assert(dump.find("row profiled::row_a 3\n") != std::string::npos);
+    assert(dump.find("row profiled::row_b 1\n") != std::string::npos);
+    std::string a = section(dump, "profiled::row_a");
+    assert(a.find("5 0x5 0x0\n") != std::string::npos);
+    assert(a.find("1 0x2 0xa\n") != std::string::npos);
+    assert(a.find("1 0x0 0x0\n") != std::string::npos);
+    assert(section(dump, "profiled::row_b") == "1 0x20 0x0\n");
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testPatterns();
+    return 0;
+}
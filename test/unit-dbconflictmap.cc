@@ -0,0 +1,92 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "DB_conflict_map.hh"
+
+struct hot_row {};
+struct cold_row {};
+
+static uint64_t slice(uint64_t prefix16, uint64_t rest = 0) {
+    return (prefix16 << 48) | rest;
+}
+
+void testHeatmap() {
+    bench::key_conflict_map::enable(2, 1);
+    std::unique_ptr<bench::key_conflict_map> m(bench::key_conflict_map::make<hot_row>());
+    assert(m->name() == "hot_row");
+    assert(m->heatmap().empty());
+
+    // keys agreeing in their first two bytes land in one cell
+    for (uint64_t i = 0; i != 5; ++i)
+        m->record(bench::key_conflict_map::lock_failure, slice(0x0203, i));
+    m->record(bench::key_conflict_map::phantom, slice(0x0203));
+    m->record(bench::key_conflict_map::validation_failure, slice(0x0001, 99));
+
+    // another thread's sketch is merged in
+    std::thread([&] {
+            TThread::set_id(1);
+            m->record(bench::key_conflict_map::validation_failure, slice(0x0203, 7));
+        }).join();
+
+    auto cells = m->heatmap();
+    assert(cells.size() == 2);
+    assert(cells[0].prefix == 0x0001 && cells[0].count[bench::key_conflict_map::validation_failure] == 1);
+    assert(cells[1].prefix == 0x0203);
+    assert(cells[1].count[bench::key_conflict_map::lock_failure] == 5);
+    assert(cells[1].count[bench::key_conflict_map::validation_failure] == 1);
+    assert(cells[1].count[bench::key_conflict_map::phantom] == 1);
+    assert(cells[1].err == 0 && cells[1].total() == 7);
+
+    assert(bench::key_conflict_map::recorded());
+    std::ostringstream out;
+    bench::key_conflict_map::dump(out);
+    assert(out.str() == "index,prefix,lock,validation,phantom,err\n"
+           "\"hot_row\",0001,0,1,0,0\n"
+           "\"hot_row\",0203,5,1,1,0\n");
+
+    m->clear();
+    assert(m->heatmap().empty());
+    bench::key_conflict_map::disable();
+    m->record(bench::key_conflict_map::lock_failure, slice(1));
+    assert(m->heatmap().empty());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSampling() {
+    bench::key_conflict_map::enable(1, 4);
+    std::unique_ptr<bench::key_conflict_map> m(bench::key_conflict_map::make<cold_row>());
+
+    // one failure in 4 is recorded, with weight 4
+    for (int i = 0; i != 40; ++i)
+        m->record(bench::key_conflict_map::lock_failure, slice(0x0500));
+    auto cells = m->heatmap();
+    assert(cells.size() == 1 && cells[0].prefix == 0x05);
+    assert(cells[0].total() == 40);
+
+    // a full sketch keeps the heavy prefixes, and bounds the overcount
+    bench::key_conflict_map::enable(1, 1);
+    m->clear();
+    for (int round = 0; round != 8; ++round)
+        for (uint64_t p = 0; p != 2 * bench::key_conflict_map::sketch_size; ++p)
+            m->record(bench::key_conflict_map::lock_failure, slice((p + 1) << 8));
+    for (int i = 0; i != 64; ++i)
+        m->record(bench::key_conflict_map::validation_failure, slice(0xFF00));
+    cells = m->heatmap();
+    assert(cells.size() == bench::key_conflict_map::sketch_size);
+    auto hot = cells.back();
+    assert(hot.prefix == 0xFF);
+    assert(hot.total() >= 64 && hot.total() - hot.err <= 64);
+
+    bench::key_conflict_map::disable();
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testHeatmap();
+    testSampling();
+    return 0;
+}
@@ -0,0 +1,139 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include "Sto.hh"
+#include "DB_dynsplit.hh"
+
+struct row {
+    enum class NamedColumn : int { a = 0, b, c, d };
+    int64_t a;
+    int64_t b;
+    int32_t c;
+    int64_t d;
+};
+
+template <>
+struct bench::DynamicSplitColumns<row> {
+    static constexpr std::array<column_range, 4> columns = {{
+        DYNSPLIT_COLUMN(row, a), DYNSPLIT_COLUMN(row, b),
+        DYNSPLIT_COLUMN(row, c), DYNSPLIT_COLUMN(row, d)
+    }};
+};
+
+typedef bench::dynamic_split<row, 3> split_type;
+
+enum class access_t : int8_t { none = 0, read = 1, write = 2, update = 3 };
+
+struct column_access_t {
+    int col_id;
+    access_t access;
+};
+
+static std::array<access_t, split_type::num_splits>
+accesses_of(uint8_t layout, std::initializer_list<column_access_t> accesses) {
+    return split_type::instance().split_accesses<access_t>(layout, accesses);
+}
+
+// Splits of v as the index builds them
+static std::array<void*, split_type::num_splits> build(const row& v, bench::dynamic_layout_tag& tag,
+                                                       std::array<row, 3>& copies) {
+    constexpr auto builders = split_type::split_builders();
+    tag = std::get<0>(builders)(v);
+    copies[0] = std::get<1>(builders)(v);
+    copies[1] = std::get<2>(builders)(v);
+    copies[2] = std::get<3>(builders)(v);
+    return {{&tag, &copies[0], &copies[1], &copies[2]}};
+}
+
+void testLayouts() {
+    auto& s = split_type::instance();
+    assert(s.current() == 0 && s.num_layouts() == 1);
+    // everything starts in the first data split
+    auto a = accesses_of(0, {{1, access_t::update}});
+    assert(a[0] == access_t::read && a[1] == access_t::update);
+    assert(a[2] == access_t::none && a[3] == access_t::none);
+
+    split_type::layout_type l = s.layout(0);
+    l[1] = 2;
+    assert(s.publish(l) && s.current() == 1 && s.num_layouts() == 2);
+    // republishing the current layout is a no-op
+    assert(s.publish(l) && s.num_layouts() == 2);
+    a = accesses_of(1, {{1, access_t::update}, {0, access_t::read}});
+    assert(a[0] == access_t::read && a[1] == access_t::read && a[3] == access_t::update);
+    // reads of a stale row follow its own layout
+    a = accesses_of(0, {{1, access_t::read}});
+    assert(a[1] == access_t::read && a[3] == access_t::none);
+    // and writes migrate it
+    a = accesses_of(0, {{1, access_t::write}});
+    for (auto x : a)
+        assert(x == access_t::update);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testMerge() {
+    auto& s = split_type::instance();
+    row v{1, 2, 3, 4};
+    bench::dynamic_layout_tag tag;
+    std::array<row, 3> copies;
+    auto splits = build(v, tag, copies);
+    assert(tag.layout == s.current());
+    // a write to b touches only its split
+    copies[2].b = 20;
+    copies[0].b = -1;
+    row out{};
+    s.merge(&out, splits);
+    assert(out.a == 1 && out.b == 20 && out.c == 3 && out.d == 4);
+    assert((split_type::column<int64_t>(splits, 1) == 20));
+    assert((split_type::column<int32_t>(splits, 2) == 3));
+    // splits not read are left alone
+    row partial{0, 0, 0, 0};
+    auto some = splits;
+    some[1] = nullptr;
+    s.merge(&partial, some);
+    assert(partial.a == 0 && partial.b == 20 && partial.d == 0);
+    // the mergers, run in split order, agree
+    constexpr auto mergers = split_type::split_mergers();
+    row merged{};
+    std::get<0>(mergers)(&merged, &tag);
+    std::get<1>(mergers)(&merged, &copies[0]);
+    std::get<2>(mergers)(&merged, &copies[1]);
+    std::get<3>(mergers)(&merged, &copies[2]);
+    assert(merged.a == 1 && merged.b == 20 && merged.c == 3 && merged.d == 4);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPolicy() {
+    auto& s = split_type::instance();
+    s.propose();  // forget earlier samples
+    uint8_t id = s.current();
+    assert(s.split_of(id, 0) == 1 && s.split_of(id, 3) == 1);
+    // d is written most in the hot home split
+    for (int i = 0; i != 1000; ++i) {
+        accesses_of(id, {{3, access_t::update}, {0, access_t::read}});
+        if (i % 10 == 0)
+            s.record_conflict(id, 1);
+    }
+    accesses_of(id, {{0, access_t::update}});
+    auto l = s.propose();
+    assert(l[3] != 0 && l[3] != l[1] && l[0] == 0 && l[2] == 0);
+    assert(s.publish(l));
+    id = s.current();
+    // b cools off and goes home; d stays hot
+    for (int i = 0; i != 1000; ++i) {
+        accesses_of(id, {{3, access_t::update}});
+        if (i % 10 == 0)
+            s.record_conflict(id, s.split_of(id, 3));
+    }
+    l = s.propose();
+    assert(l[1] == 0 && l[3] != 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testLayouts();
+    testMerge();
+    testPolicy();
+    return 0;
+}
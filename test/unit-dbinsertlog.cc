@@ -0,0 +1,86 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "DB_insert_log.hh"
+
+typedef bench::insert_log<uint64_t, 1024> log_type;
+
+static auto in_range(uint64_t lo, uint64_t hi) {
+    return [=](const uint64_t& k) { return lo <= k && k <= hi; };
+}
+
+void testRange() {
+    log_type log;
+    uint64_t since = log.position();
+    assert(log.check(since, in_range(0, ~uint64_t(0))));
+    TThread::set_id(1);
+    log.append(5);
+    log.append(50);
+    TThread::set_id(0);
+    assert(log.check(since, in_range(10, 20)));
+    assert(!log.check(since, in_range(40, 60)));
+    assert(!log.check(since, in_range(5, 5)));
+    // inserts before the position don't count
+    assert(log.check(log.position(), in_range(0, 100)));
+    // nor do the checker's own
+    log.append(15);
+    assert(log.check(since, in_range(10, 20)));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testWrap() {
+    log_type log;
+    TThread::set_id(1);
+    for (uint64_t k = 0; k != 10; ++k)
+        log.append(k);
+    uint64_t since = log.position();
+    for (uint64_t k = 0; k != 1024; ++k)
+        log.append(1000);
+    TThread::set_id(0);
+    assert(log.check(since, in_range(0, 10)));
+    TThread::set_id(1);
+    log.append(1000);
+    TThread::set_id(0);
+    // the ring no longer holds everything since the position
+    assert(!log.check(since, in_range(0, 10)));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConcurrent() {
+    log_type log;
+    TThread::set_id(0);
+    uint64_t since = log.position();
+    const uint64_t per_thread = 200;
+    std::vector<std::thread> threads;
+    for (int t = 1; t != 5; ++t)
+        threads.emplace_back([&, t] {
+            TThread::set_id(t);
+            for (uint64_t i = 0; i != per_thread; ++i)
+                log.append(t * per_thread + i);
+        });
+    // checks racing with the appends may fail, but only for keys in range
+    for (int i = 0; i != 100; ++i)
+        log.check(since, in_range(0, ~uint64_t(0)));
+    for (auto& th : threads)
+        th.join();
+    std::vector<bool> seen(5 * per_thread);
+    assert(log.check(since, [&](const uint64_t& k) {
+                assert(k >= per_thread && k < 5 * per_thread && !seen[k]);
+                seen[k] = true;
+                return false;
+            }));
+    for (uint64_t k = per_thread; k != 5 * per_thread; ++k)
+        assert(seen[k]);
+    assert(!log.check(since, in_range(3 * per_thread, 3 * per_thread)));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testRange();
+    testWrap();
+    testConcurrent();
+    return 0;
+}
@@ -0,0 +1,80 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <tuple>
+#include "DB_keypack.hh"
+
+using bench::packed_key;
+
+// orderline_key layout under TPCC_PACKED_KEYS
+typedef packed_key<16, 8, 32, 8> ol_key;
+// straddles the two slices
+typedef packed_key<16, 8, 16, 32> oc_key;
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+void testLayout() {
+    static_assert(sizeof(ol_key) == 8, "one ikey slice");
+    static_assert(sizeof(oc_key) == 16, "two slices");
+    static_assert(sizeof(packed_key<64, 1>) == 16, "");
+
+    ol_key k(0x0102, 0x03, 0x04050607, 0x08);
+    const unsigned char expected[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    assert(!memcmp(&k, expected, sizeof(expected)));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRoundTrip() {
+    std::mt19937_64 rng(56);
+    for (int i = 0; i != 10000; ++i) {
+        uint64_t w = rng() & 0xFFFF, d = rng() & 0xFF, c = rng() & 0xFFFF, o = rng() & 0xFFFFFFFF;
+        oc_key k(w, d, c, o);
+        assert(k.get<0>() == w && k.get<1>() == d && k.get<2>() == c && k.get<3>() == o);
+        packed_key<64, 3> wide(rng(), 5);
+        assert(wide.get<1>() == 5);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOrder() {
+    std::mt19937_64 rng(57);
+    for (int i = 0; i != 10000; ++i) {
+        // small ranges, so that fields are often equal
+        uint64_t a[4], b[4];
+        for (int f = 0; f != 4; ++f) {
+            a[f] = rng() % 4;
+            b[f] = rng() % 4;
+        }
+        a[3] |= uint64_t(rng() % 2) << 31;
+        oc_key ka(a[0], a[1], a[2], a[3]), kb(b[0], b[1], b[2], b[3]);
+        auto ta = std::make_tuple(a[0], a[1], a[2], a[3]);
+        auto tb = std::make_tuple(b[0], b[1], b[2], b[3]);
+        int expected = ta < tb ? -1 : (tb < ta ? 1 : 0);
+        assert(sign(memcmp(&ka, &kb, sizeof(ka))) == expected);
+        assert((ka == kb) == (expected == 0));
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSaturatedBound() {
+    // as in order-status's scan from (w, d, c, max)
+    oc_key bound(1, 2, 3, std::numeric_limits<uint64_t>::max());
+    oc_key last(1, 2, 3, 0xFFFFFFFE), next(1, 2, 4, 0);
+    assert(bound.get<3>() == 0xFFFFFFFF);
+    assert(memcmp(&last, &bound, sizeof(bound)) < 0);
+    assert(memcmp(&bound, &next, sizeof(bound)) < 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testLayout();
+    testRoundTrip();
+    testOrder();
+    testSaturatedBound();
+    return 0;
+}
@@ -0,0 +1,155 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "DB_latency.hh"
+#include "Sto.hh"
+#include "TBox.hh"
+
+using bench::latency_histogram;
+using bench::latency_profile;
+using bench::arrival_schedule;
+
+void testBuckets() {
+    // every value lies in its bucket, and buckets are contiguous
+    uint64_t prev_high = 0;
+    for (unsigned b = 1; b != latency_histogram::num_buckets; ++b) {
+        uint64_t high = latency_histogram::bucket_high(b);
+        assert(high > prev_high);
+        assert(latency_histogram::bucket_of(prev_high + 1) == b);
+        assert(latency_histogram::bucket_of(high) == b);
+        prev_high = high;
+    }
+    assert(prev_high == ~uint64_t(0));
+
+    // relative bucket width
+    std::mt19937_64 rng(61);
+    for (int i = 0; i != 100000; ++i) {
+        uint64_t v = rng() >> (rng() % 64);
+        uint64_t high = latency_histogram::bucket_high(latency_histogram::bucket_of(v));
+        assert(high >= v && high - v <= v / latency_histogram::sub_count);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testQuantiles() {
+    latency_histogram h;
+    assert(h.quantile(0.5) == 0 && h.count() == 0);
+    for (uint64_t v = 1; v <= 10000; ++v)
+        h.record(v);
+    assert(h.count() == 10000 && h.min() == 1 && h.max() == 10000);
+    auto near = [](uint64_t got, uint64_t want) {
+        return got >= want && got - want <= want / latency_histogram::sub_count;
+    };
+    assert(near(h.quantile(0.5), 5000));
+    assert(near(h.quantile(0.99), 9900));
+    assert(near(h.quantile(0.999), 9990));
+    assert(h.quantile(1.0) == 10000);
+
+    latency_histogram g;
+    g.record(1000000);
+    h.merge(g);
+    assert(h.count() == 10001 && h.max() == 1000000 && h.quantile(1.0) == 1000000);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testProfile() {
+    latency_profile::name_types({"short", "long"});
+    std::vector<std::thread> thrs;
+    for (int t = 0; t != 4; ++t)
+        thrs.emplace_back([t]() {
+                TThread::set_id(t);
+                for (int i = 0; i != 1000; ++i) {
+                    latency_profile::record(0, 100);
+                    latency_profile::record(1, 100000 + t);
+                }
+            });
+    for (auto& t : thrs)
+        t.join();
+
+    auto all = latency_profile::merged();
+    assert(all.size() == 2);
+    assert(all[0].count() == 4000 && all[0].quantile(0.99) == 100);
+    assert(all[1].count() == 4000 && all[1].min() == 100000 && all[1].max() == 100003);
+
+    std::ostringstream json;
+    latency_profile::dump(json, 1000.0);
+    assert(json.str().find("\"short\": {\"count\": 4000, ") != std::string::npos);
+    assert(json.str().find("\"long\": {\"count\": 4000, ") != std::string::npos);
+
+    // naming the types again starts over
+    latency_profile::name_types({"one"});
+    assert(latency_profile::merged()[0].count() == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testArrivals() {
+    // a constant schedule that started in the past is behind: arrivals come
+    // back to back, spaced by the schedule rather than by the clock
+    uint64_t start = read_tsc() - 1000000;
+    arrival_schedule fixed({1000, false}, 1000000000.0, start, 0);
+    assert(fixed.open_loop());
+    for (int i = 0; i != 100; ++i) {
+        assert(fixed.wait(~uint64_t(0)));
+        assert(fixed.arrival() == start + uint64_t(i) * 1000000);
+    }
+    assert(!fixed.wait(start + 100 * 1000000));
+
+    // Poisson gaps average to the rate's
+    arrival_schedule poisson({1000, true}, 1000000000.0, 0, 62);
+    for (int i = 0; i != 10000; ++i)
+        assert(poisson.wait(~uint64_t(0)));
+    double mean_gap = double(poisson.arrival()) / 9999;
+    assert(mean_gap > 950000 && mean_gap < 1050000);
+
+    // the latency of a late arrival includes its wait
+    latency_profile::name_types({"only"});
+    arrival_schedule late({1, false}, 1000000000.0, read_tsc() - 5000000, 0);
+    assert(late.wait(~uint64_t(0)));
+    late.record(0);
+    assert(latency_profile::recorded() && latency_profile::merged()[0].min() >= 5000000);
+
+    arrival_schedule closed({}, 1000000000.0, 0, 0);
+    assert(!closed.open_loop() && closed.wait(~uint64_t(0)) && !closed.wait(1));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDurable() {
+    TThread::set_id(0);
+    char dir[] = "/tmp/sto-dblatency-XXXXXX";
+    assert(mkdtemp(dir));
+    latency_profile::name_types({"txn"});
+    assert(TxnLog::start(dir));
+    TBox<int> box;
+    for (int i = 0; i != 10; ++i) {
+        latency_profile::timer lt;
+        TRANSACTION_E {
+            box = i;
+        } RETRY_E(false);
+        lt.record(0);
+    }
+    // stop makes the commits durable and acknowledges them
+    TxnLog::stop();
+    auto durable = latency_profile::merged(true);
+    assert(durable[0].count() == 10);
+    assert(latency_profile::merged()[0].count() == (STO_PROFILE_LATENCY ? 10 : 0));
+
+    std::ostringstream json;
+    latency_profile::dump(json, 1000.0);
+    assert(json.str().find("\"durable_types\": {\n  \"txn\": {\"count\": 10, ") != std::string::npos);
+    std::string cmd = std::string("rm -rf ") + dir;
+    assert(system(cmd.c_str()) == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testBuckets();
+    testQuantiles();
+    testProfile();
+    testArrivals();
+    testDurable();
+    return 0;
+}
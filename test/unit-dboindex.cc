@@ -1,6 +1,11 @@
+#include <cstdlib>
+#include <cstring>
+#include <random>
 #include "DB_index.hh"
 #include "DB_structs.hh"
 #include "DB_params.hh"
+#include "DB_checkpoint.hh"
+#include "DB_analytics.hh"
 
 struct coarse_grained_row {
     enum class NamedColumn : int { aa = 0, bb, cc };
@@ -19,9 +24,15 @@ struct key_type {
     uint64_t id;
 
     explicit key_type(uint64_t key) : id(bench::bswap(key)) {}
+    explicit key_type(const lcdf::Str& s) {
+        memcpy(this, s.data(), sizeof(*this));
+    }
     operator lcdf::Str() const {
         return lcdf::Str((const char *)this, sizeof(*this));
     }
+    bool operator==(const key_type& other) const {
+        return id == other.id;
+    }
 };
 
 // using example_row from VersionSelector.hh
@@ -306,6 +317,9 @@ using access_t = bench::access_t;
 using RowAccess = bench::RowAccess;
 
 using MVIndex = bench::mvcc_ordered_index<key_type, coarse_grained_row, db_params::db_mvcc_params>;
+using NodeIndex = bench::ordered_index<key_type, coarse_grained_row, db_params::db_default_node_params>;
+using ArtIndex = bench::art_ordered_index<key_type, coarse_grained_row, db_params::db_default_params>;
+using BtreeIndex = bench::btree_ordered_index<key_type, coarse_grained_row, db_params::db_default_params>;
 
 template <typename IndexType>
 void init_cindex(IndexType& ci) {
@@ -381,7 +395,9 @@ void test_coarse_read_my_split() {
         for (int i = 0; i < 10; ++i) {
             auto r = Sto::tx_alloc<coarse_grained_row>();
             new (r) coarse_grained_row(i, i, i);
-            ci.insert_row(key_type(10 + i), r);
+            auto [ins_success, ins_found] = ci.insert_row(key_type(10 + i), r);
+            (void) ins_found;
+            assert(ins_success);
         }
         assert(t.try_commit());
     }
@@ -762,6 +778,686 @@ void test_mvcc_snapshot() {
     printf("pass %s\n", __FUNCTION__);
 }
 
+void test_analytics_kernels() {
+    namespace an = bench::analytics;
+    std::mt19937_64 rng(7);
+    int64_t col[1024];
+    for (auto& v : col)
+        v = int64_t(rng() % 2000) - 1000;
+    // every kernel agrees with the scalar one, at lengths with and without
+    // a partial last word
+    for (size_t n : {0, 1, 4, 63, 64, 65, 200, 1024}) {
+        uint64_t sel[16], ref[16];
+        for (size_t w = 0; w != 16; ++w)
+            ref[w] = rng();
+        memcpy(sel, ref, sizeof(sel));
+        an::filter_scalar(col, n, -300, 500, ref);
+        an::filter_kernel(col, n, -300, 500, sel);
+        for (size_t w = 0; w * 64 < n; ++w)
+            assert(sel[w] == ref[w]);
+        int64_t sum = 0;
+        for (size_t i = 0; i != n; ++i)
+            if ((ref[i / 64] >> (i % 64)) & 1) {
+                assert(col[i] >= -300 && col[i] <= 500);
+                sum += col[i];
+            }
+        assert(an::sum_scalar(col, n, ref) == sum);
+        assert(an::sum_kernel(col, n, ref) == sum);
+    }
+
+    bench::column_batch<1> b;
+    b.size = 100;
+    for (size_t i = 0; i != b.size; ++i)
+        b.columns[0][i] = i;
+    b.select_all();
+    assert(b.count() == 100 && b.sum(0) == 4950);
+    b.filter(0, 10, 19);
+    assert(b.count() == 10 && b.sum(0) == 145);
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+void test_mvcc_analytic_scan() {
+    typedef CoarseIndex::NamedColumn nc;
+    MVIndex mi;
+    mi.thread_init();
+    for (uint64_t i = 1; i <= 3000; ++i)
+        mi.nontrans_put(key_type(i), coarse_grained_row(i, i % 7, 1));
+
+    // columns aa and bb
+    auto extract = [](const key_type&, const auto& split_values, bench::column_batch<2>& b, size_t row) {
+        auto v = reinterpret_cast<const coarse_grained_row*>(split_values[0]);
+        b.columns[0][row] = v->aa;
+        b.columns[1][row] = v->bb;
+    };
+    bench::snapshot_scanner<MVIndex, 2> scanner;
+    // sum(aa) where bb = 3
+    auto query = [&](TransactionTid::type tid, lcdf::Str begin, lcdf::Str end, uint64_t& rows) {
+        int64_t sum = 0;
+        rows = scanner.scan(mi, begin, end, tid, extract, [&](bench::column_batch<2>& b) {
+            assert(b.count() == b.size);
+            b.filter(1, 3, 3);
+            sum += b.sum(0);
+        });
+        return sum;
+    };
+    int64_t expect = 0;
+    for (uint64_t i = 1; i <= 3000; ++i)
+        if (i % 7 == 3)
+            expect += i;
+
+    uint64_t rows;
+    {
+        SnapshotPin pin;
+        // an update committed after the pin is not seen through it
+        {
+            TestTransaction t(0);
+            auto [success, found, row, value] = mi.select_split_row(key_type(10), {{nc::aa, access_t::update}});
+            assert(success && found);
+            auto new_row = Sto::tx_alloc<coarse_grained_row>();
+            value.copy_into(new_row);
+            new_row->aa = 1000000;
+            mi.update_row(row, new_row);
+            assert(t.try_commit());
+        }
+        assert(query(pin.tid(), lcdf::Str(), lcdf::Str(), rows) == expect);
+        assert(rows == 3000);
+    }
+    {
+        SnapshotPin pin;
+        assert(query(pin.tid(), lcdf::Str(), lcdf::Str(), rows) == expect - 10 + 1000000);
+        // keys 100 through 199
+        query(pin.tid(), key_type(100), key_type(200), rows);
+        assert(rows == 100);
+    }
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+void test_parallel_scan() {
+    typedef CoarseIndex::NamedColumn nc;
+    CoarseIndex ci;
+    ci.thread_init();
+    for (uint64_t i = 1; i <= 20000; ++i)
+        ci.nontrans_put(key_type(2 * i), coarse_grained_row(i, i, i));
+    bench::scan_helpers helpers(3, 4);
+
+    // rows of [begin, end) in order when the pieces are put in order
+    auto scan = [&](uint64_t begin, uint64_t end, std::vector<uint64_t>& rows) {
+        std::vector<std::vector<uint64_t>> pieces(4 * helpers.size());
+        bool ok = ci.parallel_range_scan(key_type(begin), key_type(end),
+            [&](size_t piece, const key_type&, const coarse_grained_row* value) {
+                pieces.at(piece).push_back(value->aa);
+                return true;
+            }, {{nc::aa, access_t::read}}, &helpers);
+        rows.clear();
+        for (auto& piece : pieces)
+            rows.insert(rows.end(), piece.begin(), piece.end());
+        return ok;
+    };
+
+    std::vector<uint64_t> rows;
+    {
+        TestTransaction t(0);
+        t.get_tx().start_readonly();
+        assert(scan(200, 30000, rows));
+        assert(rows.size() == 14900);
+        for (size_t i = 0; i != rows.size(); ++i)
+            assert(rows[i] == 100 + i);
+        assert(t.try_commit());
+    }
+
+    // the scan's reads are validated at commit: an update of a row it read
+    // aborts it, and so does an insert into its range
+    {
+        TestTransaction t1(0);
+        t1.get_tx().start_readonly();
+        assert(scan(2, 40002, rows) && rows.size() == 20000);
+
+        TestTransaction t2(1);
+        auto [success, found, row, value] = ci.select_split_row(key_type(10000), {{nc::aa, access_t::update}});
+        assert(success && found);
+        auto new_row = Sto::tx_alloc<coarse_grained_row>();
+        value.copy_into(new_row);
+        new_row->aa = 0;
+        ci.update_row(row, new_row);
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    {
+        TestTransaction t1(0);
+        t1.get_tx().start_readonly();
+        assert(scan(2, 40002, rows) && rows.size() == 20000);
+
+        TestTransaction t2(1);
+        coarse_grained_row row_value(0, 0, 0);
+        auto [success, found] = ci.insert_row(key_type(30001), &row_value);
+        assert(success && !found);
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    // snapshot scans of an MVCC table need no merging
+    MVIndex mi;
+    mi.thread_init();
+    for (uint64_t i = 1; i <= 20000; ++i)
+        mi.nontrans_put(key_type(i), coarse_grained_row(i, i, i));
+    {
+        SnapshotPin pin;
+        std::vector<uint64_t> sums(4 * helpers.size());
+        mi.parallel_range_scan_as_of(key_type(1), key_type(20001), pin.tid(),
+            [&](size_t piece, const key_type&, const coarse_grained_row& value) {
+                sums.at(piece) += value.aa;
+                return true;
+            }, &helpers);
+        uint64_t sum = 0;
+        for (auto s : sums)
+            sum += s;
+        assert(sum == uint64_t(20000) * 20001 / 2);
+    }
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+void test_bulk_load() {
+    CoarseIndex ci;
+    ci.thread_init();
+
+    std::vector<std::pair<key_type, coarse_grained_row>> rows;
+    for (uint64_t i = 1; i <= 10000; ++i)
+        rows.emplace_back(key_type(i), coarse_grained_row(i, i, i));
+    ci.bulk_load(rows.begin(), rows.end(), 4);
+
+    for (uint64_t i = 1; i <= 10000; ++i) {
+        auto row = ci.nontrans_get(key_type(i));
+        assert(row && row->aa == i);
+    }
+    assert(!ci.nontrans_get(key_type(10001)));
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+void test_delete_range() {
+    typedef CoarseIndex::NamedColumn nc;
+    CoarseIndex ci;
+    ci.thread_init();
+
+    init_cindex(ci);
+
+    {
+        TestTransaction t(0);
+        auto [success, ndeleted] = ci.delete_range(key_type(3), key_type(7));
+        assert(success && ndeleted == 4);
+        // the rows are gone to this transaction too
+        auto [sel_success, found, row, value] = ci.select_split_row(key_type(4), {{nc::aa, access_t::read}});
+        (void) row, (void) value;
+        assert(sel_success && !found);
+        assert(t.try_commit());
+    }
+    for (uint64_t i = 1; i <= 10; ++i)
+        assert(!ci.nontrans_get(key_type(i)) == (i >= 3 && i < 7));
+
+    {
+        // a limit stops after that many rows
+        TestTransaction t(0);
+        auto [success, ndeleted] = ci.delete_range(key_type(1), key_type(10), 2);
+        assert(success && ndeleted == 2);
+        assert(t.try_commit());
+    }
+    assert(!ci.nontrans_get(key_type(1)) && !ci.nontrans_get(key_type(2)));
+    assert(ci.nontrans_get(key_type(7)));
+
+    {
+        // an insert into the range makes the delete fail at commit
+        TestTransaction t1(0);
+        auto [success, ndeleted] = ci.delete_range(key_type(5), key_type(10));
+        assert(success && ndeleted == 3);
+        TestTransaction t2(1);
+        coarse_grained_row r(5, 5, 5);
+        auto [ins_success, ins_found] = ci.insert_row(key_type(5), Sto::tx_alloc(&r));
+        (void) ins_found;
+        assert(ins_success);
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    assert(ci.nontrans_get(key_type(7)) && ci.nontrans_get(key_type(10)));
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+void test_truncate() {
+    CoarseIndex ci;
+    ci.thread_init();
+
+    for (uint64_t i = 1; i <= 10000; ++i)
+        ci.nontrans_put(key_type(i), coarse_grained_row(i, i, i));
+    ci.truncate();
+    for (uint64_t i = 1; i <= 10000; i += 97)
+        assert(!ci.nontrans_get(key_type(i)));
+
+    // the table is usable again
+    init_cindex(ci);
+    {
+        TestTransaction t(0);
+        auto [success, ndeleted] = ci.delete_range(key_type(1), key_type(11));
+        assert(success && ndeleted == 10);
+        assert(t.try_commit());
+    }
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+void test_checkpoint() {
+    CoarseIndex ci;
+    ci.thread_init();
+    for (uint64_t i = 1; i <= 1000; ++i)
+        ci.nontrans_put(key_type(i), coarse_grained_row(i, i, i));
+    MVIndex mi;
+    mi.thread_init();
+    init_cindex(mi);
+
+    char dir[] = "/tmp/sto-checkpoint-XXXXXX";
+    always_assert(mkdtemp(dir));
+    bench::checkpointer ck(dir, 2, 2);
+    ck.add_table("coarse", ci, std::vector<key_type>{key_type(250), key_type(500), key_type(750)});
+    ck.add_table("mvcc", mi, std::vector<key_type>{});
+    ck.start();
+    assert(ck.join());
+    assert(ck.rows() == 1010);
+    assert(bench::checkpointer::last_start_epoch(dir) == ck.start_epoch());
+
+    // the key ranges split the rows in order
+    uint64_t next = 1;
+    for (int part = 0; part != 4; ++part) {
+        std::string path = std::string(dir) + "/coarse." + std::to_string(part);
+        bool ok = bench::checkpointer::read_part<key_type, coarse_grained_row>(path,
+            [&] (const key_type& k, const coarse_grained_row& row) {
+                assert(k.id == bench::bswap(next) && row.aa == next);
+                ++next;
+            });
+        assert(ok && next == uint64_t(part == 3 ? 1001 : 250 * (part + 1)));
+    }
+
+    // recovery bulk loads the parts back, in key order; there's no log
+    CoarseIndex rci;
+    rci.thread_init();
+    bench::recoverer rec(2);
+    rec.add_table("coarse", 1, rci);
+    assert(rec.run(dir, dir));
+    assert(rec.statistics().checkpoint_rows == 1000 && rec.statistics().log.records == 0);
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        auto row = rci.nontrans_get(key_type(i));
+        assert(row && row->aa == i);
+    }
+
+    std::string cmd = std::string("rm -rf ") + dir;
+    always_assert(system(cmd.c_str()) == 0);
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+template <typename TreeIndex>
+void test_tree_basic() {
+    typedef typename TreeIndex::NamedColumn nc;
+    TreeIndex ai;
+    ai.thread_init();
+
+    init_cindex(ai);
+
+    {
+        TestTransaction t(0);
+        auto [success, found, row, value] = ai.select_split_row(key_type(1), {{nc::aa, access_t::update}});
+        assert(success && found);
+        assert(value.aa() == 1);
+        auto new_row = Sto::tx_alloc<coarse_grained_row>();
+        value.copy_into(new_row);
+        new_row->aa = 2;
+        ai.update_row(row, new_row);
+        auto [ins_success, ins_found] = ai.insert_row(key_type(20), new_row);
+        assert(ins_success && !ins_found);
+        auto [del_success, del_found] = ai.delete_row(key_type(3));
+        assert(del_success && del_found);
+        assert(t.try_commit());
+    }
+
+    {
+        TestTransaction t(0);
+        auto [success, found, row, value] = ai.select_split_row(key_type(1), {{nc::aa, access_t::read}});
+        (void) row;
+        assert(success && found && value.aa() == 2);
+        std::tie(success, found, row, value) = ai.select_split_row(key_type(20), {{nc::aa, access_t::read}});
+        assert(success && found && value.aa() == 2);
+        std::tie(success, found, row, value) = ai.select_split_row(key_type(3), {{nc::aa, access_t::read}});
+        assert(success && !found);
+        assert(t.try_commit());
+    }
+    assert(!ai.nontrans_get(key_type(3)));
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+template <typename TreeIndex>
+void test_tree_scan() {
+    TreeIndex ai;
+    ai.thread_init();
+
+    init_cindex(ai);
+
+    {
+        TestTransaction t(0);
+        std::vector<uint64_t> seen;
+        auto callback = [&] (const key_type& k, const coarse_grained_row* row) {
+            assert(row->aa == bench::bswap(k.id));
+            seen.push_back(row->aa);
+            return true;
+        };
+        bool ok = ai.template range_scan<decltype(callback), false>(key_type(3), key_type(7), callback,
+                                                                    RowAccess::ObserveValue);
+        assert(ok && (seen == std::vector<uint64_t>{3, 4, 5, 6}));
+        seen.clear();
+        ok = ai.template range_scan<decltype(callback), true>(key_type(8), key_type(2), callback,
+                                                              RowAccess::ObserveValue, true, 3);
+        assert(ok && (seen == std::vector<uint64_t>{8, 7, 6}));
+        assert(t.try_commit());
+    }
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+template <typename TreeIndex>
+void test_tree_phantoms() {
+    typedef typename TreeIndex::NamedColumn nc;
+    TreeIndex ai;
+    ai.thread_init();
+
+    init_cindex(ai);
+    coarse_grained_row r(0, 0, 0);
+    auto callback = [] (const key_type&, const coarse_grained_row*) {
+        return true;
+    };
+
+    {
+        // an insert into a scanned range
+        TestTransaction t1(0);
+        bool ok = ai.template range_scan<decltype(callback), false>(key_type(1), key_type(100), callback,
+                                                                    RowAccess::ObserveValue);
+        assert(ok);
+
+        TestTransaction t2(1);
+        auto [success, found] = ai.insert_row(key_type(50), &r);
+        assert(success && !found);
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    {
+        // an insert of a key found absent
+        TestTransaction t1(0);
+        auto [success, found, row, value] = ai.select_split_row(key_type(60), {{nc::aa, access_t::read}});
+        (void) row;
+        (void) value;
+        assert(success && !found);
+
+        TestTransaction t2(1);
+        std::tie(success, found) = ai.insert_row(key_type(60), &r);
+        assert(success && !found);
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    {
+        // a transaction's own inserts don't invalidate its scan
+        TestTransaction t1(0);
+        bool ok = ai.template range_scan<decltype(callback), false>(key_type(1), key_type(1000), callback,
+                                                                    RowAccess::ObserveValue);
+        assert(ok);
+        for (uint64_t i = 100; i != 400; ++i) {
+            auto [success, found] = ai.insert_row(key_type(i), &r);
+            assert(success && !found);
+        }
+        assert(t1.try_commit());
+    }
+    for (uint64_t i = 100; i != 400; ++i)
+        assert(ai.nontrans_get(key_type(i)));
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+// With NodeTrack, the leaves a scan passes are tracked in one item
+void test_leaf_set() {
+    NodeIndex ni;
+    ni.thread_init();
+    for (uint64_t i = 1; i <= 2000; ++i)
+        ni.nontrans_put(key_type(2 * i), coarse_grained_row(i, i, i));
+    auto callback = [] (const key_type&, const coarse_grained_row*) {
+        return true;
+    };
+
+    {
+        TestTransaction t1(0);
+        bool ok = ni.template range_scan<decltype(callback), false>(key_type(1), key_type(5000), callback,
+                                                                    RowAccess::None);
+        assert(ok);
+        assert(Sto::transaction()->tset_size() == 1);
+
+        // an insert into any of the scanned leaves
+        TestTransaction t2(1);
+        coarse_grained_row r(0, 0, 0);
+        auto [success, found] = ni.insert_row(key_type(2001), &r);
+        assert(success && !found);
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+// Reads its own writes, so scans show its pending inserts
+struct rmw_params : public db_params::db_default_params {
+    static constexpr bool RdMyWr = true;
+};
+
+template <typename IndexType>
+void test_deferred() {
+    typedef IndexType index_type;
+    typedef typename index_type::NamedColumn nc;
+    index_type ai;
+    ai.thread_init();
+
+    init_cindex(ai);
+    coarse_grained_row r(50, 50, 50);
+    auto callback = [] (const key_type&, const coarse_grained_row*) {
+        return true;
+    };
+
+    {
+        // pending inserts stay out of the tree until commit
+        TestTransaction t1(0);
+        auto [success, found] = ai.insert_row(key_type(50), &r);
+        assert(success && !found);
+        assert(!ai.nontrans_get(key_type(50)));
+        auto [ssuccess, sfound, row, value] = ai.select_split_row(key_type(50), {{nc::aa, access_t::read}});
+        (void) row;
+        assert(ssuccess && sfound && value.aa() == 50);
+
+        TestTransaction t2(1);
+        std::tie(ssuccess, sfound, row, value) = ai.select_split_row(key_type(50), {{nc::aa, access_t::read}});
+        assert(ssuccess && !sfound);
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(t1.try_commit());
+        assert(ai.nontrans_get(key_type(50)));
+    }
+
+    {
+        // an aborted insert leaves a scan of its range alone
+        TestTransaction t1(0);
+        bool ok = ai.template range_scan<decltype(callback), false>(key_type(1), key_type(100), callback,
+                                                                    RowAccess::ObserveValue);
+        assert(ok);
+
+        TestTransaction t2(1);
+        auto [success, found] = ai.insert_row(key_type(60), &r);
+        assert(success && !found);
+        t2.get_tx().silent_abort();
+
+        t1.use();
+        assert(t1.try_commit());
+        assert(!ai.nontrans_get(key_type(60)));
+    }
+
+    {
+        // of two pending inserts of a key, the second to commit aborts
+        TestTransaction t1(0);
+        auto [success, found] = ai.insert_row(key_type(70), &r);
+        assert(success && !found);
+
+        TestTransaction t2(1);
+        coarse_grained_row r2(71, 71, 71);
+        std::tie(success, found) = ai.insert_row(key_type(70), &r2);
+        assert(success && !found);
+
+        t1.use();
+        assert(t1.try_commit());
+        t2.use();
+        assert(!t2.try_commit());
+        assert(ai.nontrans_get(key_type(70))->aa == 50);
+    }
+
+    {
+        // scans merge pending inserts in key order, and show them when the
+        // columns they read are written; deletes drop them
+        TestTransaction t(0);
+        coarse_grained_row r12(12, 12, 12), r15(15, 15, 15);
+        auto [success, found] = ai.insert_row(key_type(15), &r15);
+        assert(success && !found);
+        std::tie(success, found) = ai.insert_row(key_type(12), &r12);
+        assert(success && !found);
+        std::vector<uint64_t> seen;
+        auto collect = [&] (const key_type&, const coarse_grained_row* row) {
+            seen.push_back(row->aa);
+            return true;
+        };
+        bool ok = ai.template range_scan<decltype(collect), false>(key_type(8), key_type(14), collect,
+                                                                   {{nc::aa, access_t::read}});
+        assert(ok && (seen == std::vector<uint64_t>{8, 9, 10, 12}));
+        seen.clear();
+        ok = ai.template range_scan<decltype(collect), true>(key_type(13), key_type(1), collect,
+                                                             {{nc::aa, access_t::read}}, true, 3);
+        assert(ok && (seen == std::vector<uint64_t>{12, 10, 9}));
+        auto [dsuccess, dfound] = ai.delete_row(key_type(12));
+        assert(dsuccess && dfound);
+        seen.clear();
+        ok = ai.template range_scan<decltype(collect), false>(key_type(11), key_type(1000), collect,
+                                                              {{nc::aa, access_t::read}});
+        assert(ok && (seen == std::vector<uint64_t>{15, 50, 50}));
+        assert(t.try_commit());
+    }
+    assert(ai.nontrans_get(key_type(15)) && !ai.nontrans_get(key_type(12)));
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
+void test_hash_deferred() {
+    typedef bench::unordered_index<key_type, coarse_grained_row, rmw_params,
+                                   bench::index_hash<key_type>, true> index_type;
+    typedef typename index_type::NamedColumn nc;
+    index_type hi(64);
+    hi.thread_init();
+
+    init_cindex(hi);
+    coarse_grained_row r(50, 50, 50);
+
+    {
+        // pending inserts stay out of the buckets until commit
+        TestTransaction t1(0);
+        auto [success, found] = hi.insert_row(key_type(50), &r);
+        assert(success && !found);
+        assert(!hi.nontrans_get(key_type(50)));
+        auto [ssuccess, sfound, row, value] = hi.select_split_row(key_type(50), {{nc::aa, access_t::read}});
+        (void) row;
+        assert(ssuccess && sfound && value.aa() == 50);
+
+        TestTransaction t2(1);
+        std::tie(ssuccess, sfound, row, value) = hi.select_split_row(key_type(50), {{nc::aa, access_t::read}});
+        assert(ssuccess && !sfound);
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(t1.try_commit());
+        assert(hi.nontrans_get(key_type(50)));
+    }
+
+    {
+        // an aborted insert leaves a lookup of its bucket alone
+        TestTransaction t1(0);
+        auto [ssuccess, sfound, row, value] = hi.select_split_row(key_type(60), {{nc::aa, access_t::read}});
+        (void) row; (void) value;
+        assert(ssuccess && !sfound);
+
+        TestTransaction t2(1);
+        auto [success, found] = hi.insert_row(key_type(60), &r);
+        assert(success && !found);
+        t2.get_tx().silent_abort();
+
+        t1.use();
+        assert(t1.try_commit());
+        assert(!hi.nontrans_get(key_type(60)));
+    }
+
+    {
+        // of two pending inserts of a key, the second to commit aborts
+        TestTransaction t1(0);
+        auto [success, found] = hi.insert_row(key_type(70), &r);
+        assert(success && !found);
+
+        TestTransaction t2(1);
+        coarse_grained_row r2(71, 71, 71);
+        std::tie(success, found) = hi.insert_row(key_type(70), &r2);
+        assert(success && !found);
+
+        t1.use();
+        assert(t1.try_commit());
+        t2.use();
+        assert(!t2.try_commit());
+        assert(hi.nontrans_get(key_type(70))->aa == 50);
+    }
+
+    {
+        // a lookup that misses, then our own insert of the key, still
+        // commits; deletes drop pending inserts
+        TestTransaction t(0);
+        coarse_grained_row r12(12, 12, 12), r15(15, 15, 15);
+        auto [ssuccess, sfound, row, value] = hi.select_split_row(key_type(15), {{nc::aa, access_t::read}});
+        (void) row; (void) value;
+        assert(ssuccess && !sfound);
+        auto [success, found] = hi.insert_row(key_type(15), &r15);
+        assert(success && !found);
+        std::tie(success, found) = hi.insert_row(key_type(12), &r12);
+        assert(success && !found);
+        auto [dsuccess, dfound] = hi.delete_row(key_type(12));
+        assert(dsuccess && dfound);
+        std::tie(ssuccess, sfound, row, value) = hi.select_split_row(key_type(12), {{nc::aa, access_t::read}});
+        assert(ssuccess && !sfound);
+        assert(t.try_commit());
+    }
+    assert(hi.nontrans_get(key_type(15)) && !hi.nontrans_get(key_type(12)));
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
 int main() {
     test_coarse_basic();
     test_coarse_read_my_split();
@@ -773,6 +1469,25 @@ int main() {
     test_fine_delete0();
     test_fine_delete1();
     test_mvcc_snapshot();
+    test_analytics_kernels();
+    test_mvcc_analytic_scan();
+    test_parallel_scan();
+    test_bulk_load();
+    test_delete_range();
+    test_truncate();
+    test_checkpoint();
+    test_tree_basic<ArtIndex>();
+    test_tree_basic<BtreeIndex>();
+    test_tree_scan<ArtIndex>();
+    test_tree_scan<BtreeIndex>();
+    test_tree_phantoms<ArtIndex>();
+    test_tree_phantoms<BtreeIndex>();
+    test_tree_phantoms<NodeIndex>();
+    test_leaf_set();
+    test_deferred<bench::tree_ordered_index<key_type, coarse_grained_row, rmw_params, bench::art_tree, true>>();
+    test_deferred<bench::tree_ordered_index<key_type, coarse_grained_row, rmw_params, bench::olc_btree, true>>();
+    test_deferred<bench::ordered_index<key_type, coarse_grained_row, rmw_params, true>>();
+    test_hash_deferred();
     printf("All tests pass!\n");
 
     std::thread advancer;  // empty thread because we have no advancer thread
@@ -0,0 +1,78 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "DB_partition.hh"
+
+using bench::partition_map;
+
+void testGuards() {
+    // warehouses 1-4 in partition 0, 5-8 in partition 1
+    partition_map parts(8, 2);
+    parts.assign(1, 4, 0);
+    parts.assign(5, 8, 1);
+    assert(parts.partition_of(4) == 0 && parts.partition_of(5) == 1);
+
+    {
+        partition_map::guard g(&parts, 0, 3);
+        g.add(1);
+        assert(!g.cross_partition() && !g.exclusive());
+        g.lock();
+        assert(g.exclusive());
+    }
+    {
+        partition_map::guard g(&parts, 1, 6);
+        uint64_t remote[] = {6, 2, 7};
+        g.add(remote, remote + 3);
+        g.lock();
+        assert(g.cross_partition() && !g.exclusive());
+    }
+    {
+        // the home partition counts even when the key is not in it
+        partition_map::guard g(&parts, 1, 2);
+        g.lock();
+        assert(g.cross_partition());
+    }
+    {
+        partition_map::guard g(nullptr, 0, 3);
+        g.lock();
+        assert(!g.exclusive() && !g.cross_partition());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSerialization() {
+    partition_map parts(4, 2);
+    parts.assign(1, 2, 0);
+    parts.assign(3, 4, 1);
+    uint64_t counts[2] = {0, 0};
+    const int niters = 20000;
+
+    std::vector<std::thread> thrs;
+    for (int t = 0; t != 4; ++t)
+        thrs.emplace_back([&, t]() {
+            int home = t % 2;
+            for (int i = 0; i != niters; ++i) {
+                // threads 0 and 1 stay home; 2 and 3 also take the other partition
+                partition_map::guard g(&parts, home, 1 + 2 * home);
+                if (t >= 2)
+                    g.add(3 - 2 * home);
+                g.lock();
+                ++counts[home];
+                if (t >= 2)
+                    ++counts[1 - home];
+            }
+        });
+    for (auto& t : thrs)
+        t.join();
+    // unsynchronized increments, serialized by the partition locks
+    assert(counts[0] == 3 * niters && counts[1] == 3 * niters);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testGuards();
+    testSerialization();
+    return 0;
+}
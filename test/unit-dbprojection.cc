@@ -0,0 +1,120 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "DB_projection.hh"
+
+namespace proj {
+
+struct customer {
+    enum class NamedColumn : int { c_id = 0, c_balance, c_data };
+    int64_t c_id;
+    int64_t c_balance;
+    char c_data[500];
+};
+
+} // namespace proj
+
+namespace bench {
+
+template <typename A>
+class RecordAccessor<A, proj::customer> {
+public:
+    const int64_t& c_id() const {
+        return impl().c_id_impl();
+    }
+    const int64_t& c_balance() const {
+        return impl().c_balance_impl();
+    }
+
+private:
+    const A& impl() const {
+        return *static_cast<const A*>(this);
+    }
+};
+
+// Counts column reads, to check that a projection reads only its columns
+class counting_accessor : public RecordAccessor<counting_accessor, proj::customer> {
+public:
+    counting_accessor(const proj::customer* vptr) : vptr_(vptr) {}
+    mutable int reads = 0;
+
+private:
+    const int64_t& c_id_impl() const {
+        ++reads;
+        return vptr_->c_id;
+    }
+    const int64_t& c_balance_impl() const {
+        ++reads;
+        return vptr_->c_balance;
+    }
+
+    const proj::customer* vptr_;
+    friend RecordAccessor<counting_accessor, proj::customer>;
+};
+
+// As printed by the codegen's -c proj
+template <>
+struct ColumnTraits<proj::customer, proj::customer::NamedColumn::c_id> {
+    typedef int64_t type;
+    static const type& get(const proj::customer& r) {
+        return r.c_id;
+    }
+    template <typename A>
+    static const type& get(const RecordAccessor<A, proj::customer>& a) {
+        return a.c_id();
+    }
+};
+
+template <>
+struct ColumnTraits<proj::customer, proj::customer::NamedColumn::c_balance> {
+    typedef int64_t type;
+    static const type& get(const proj::customer& r) {
+        return r.c_balance;
+    }
+    template <typename A>
+    static const type& get(const RecordAccessor<A, proj::customer>& a) {
+        return a.c_balance();
+    }
+};
+
+} // namespace bench
+
+using nc = proj::customer::NamedColumn;
+
+void testFromRow() {
+    proj::customer c;
+    c.c_id = 7;
+    c.c_balance = -20;
+    memset(c.c_data, 'x', sizeof(c.c_data));
+
+    bench::projection<proj::customer, nc::c_balance, nc::c_id> p(c);
+    static_assert(sizeof(p) == 2 * sizeof(int64_t), "projection should hold only its columns");
+    assert(p.get<nc::c_id>() == 7);
+    assert(p.get<nc::c_balance>() == -20);
+
+    // copies, not references into the row
+    c.c_balance = 5;
+    assert(p.get<nc::c_balance>() == -20);
+    auto q = p;
+    assert(q.get<nc::c_id>() == 7);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testFromAccessor() {
+    proj::customer c;
+    c.c_id = 3;
+    c.c_balance = 100;
+    bench::counting_accessor a(&c);
+    bench::projection<proj::customer, nc::c_balance> p(a);
+    assert(a.reads == 1);
+    assert(p.get<nc::c_balance>() == 100);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testFromRow();
+    testFromAccessor();
+    return 0;
+}
@@ -0,0 +1,152 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include "Sto.hh"
+#include "DB_params.hh"
+#include "DB_views.hh"
+#include "DB_replicas.hh"
+
+struct row_key {
+    row_key() = default;
+    explicit row_key(uint64_t k) : k(k) {}
+    bool operator==(const row_key& other) const {
+        return k == other.k;
+    }
+
+    uint64_t k;
+};
+
+typedef bench::latest_row row_type;
+typedef row_type::NamedColumn nc;
+using bench::access_t;
+
+template <typename DBParams>
+using Index = bench::unordered_index<row_key, row_type, DBParams>;
+
+// Reads key k's value from the calling thread's replica; -1 if absent
+template <typename Table>
+int64_t read(Table& t, uint64_t k) {
+    auto [success, found, rid, value] = t.select_split_row(row_key(k), {{nc::latest, access_t::read}});
+    (void)rid;
+    assert(success);
+    return found ? value.latest() : -1;
+}
+
+template <typename Table>
+int64_t replica_value(Table& t, size_t i, uint64_t k) {
+    auto row = t.replica(i).nontrans_get(row_key(k));
+    return row ? row->latest : -1;
+}
+
+template <typename DBParams>
+void testLoad() {
+    bench::replicated_index<Index<DBParams>> t({0, 1}, 64);
+    assert(t.num_replicas() == 2);
+    t.nontrans_put(row_key(1), row_type{10});
+    assert(replica_value(t, 0, 1) == 10 && replica_value(t, 1, 1) == 10);
+    // each thread reads the replica of its node, or the first
+    bench::replica_thread_node() = 1;
+    assert(&t.local() == &t.replica(1));
+    bench::replica_thread_node() = 7;
+    assert(&t.local() == &t.replica(0));
+    bench::replica_thread_node() = -1;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+template <typename DBParams>
+void testUpdate() {
+    bench::replicated_index<Index<DBParams>> t({0, 1}, 64);
+    t.nontrans_put(row_key(1), row_type{10});
+    t.nontrans_put(row_key(2), row_type{20});
+    {
+        TestTransaction tx(0);
+        auto [success, found, rid, value] = t.select_split_row(row_key(1), {{nc::latest, access_t::update}});
+        assert(success && found && value.latest() == 10);
+        auto new_row = Sto::tx_alloc<row_type>();
+        new_row->latest = 11;
+        t.update_row(rid, new_row);
+        // a second select of the row reuses its copies
+        std::tie(success, found, rid, value) = t.select_split_row(row_key(1), {{nc::latest, access_t::update}});
+        assert(success && found);
+        new_row = Sto::tx_alloc<row_type>();
+        new_row->latest = 12;
+        t.update_row(rid, new_row);
+        assert(tx.try_commit());
+    }
+    assert(replica_value(t, 0, 1) == 12 && replica_value(t, 1, 1) == 12);
+    {
+        // a commutator reaches every replica too
+        TestTransaction tx(0);
+        auto [success, found, rid, value] = t.select_split_row(row_key(2), {{nc::latest, access_t::write}});
+        (void)value;
+        assert(success && found);
+        t.update_row(rid, typename Index<DBParams>::comm_type(25));
+        assert(tx.try_commit());
+    }
+    assert(replica_value(t, 0, 2) == 25 && replica_value(t, 1, 2) == 25);
+    {
+        // reads leave the other replica alone
+        TestTransaction tx(0);
+        bench::replica_thread_node() = 1;
+        assert(read(t, 1) == 12 && read(t, 3) == -1);
+        bench::replica_thread_node() = -1;
+        assert(tx.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+template <typename DBParams>
+void testConflict() {
+    bench::replicated_index<Index<DBParams>> t({0, 1}, 64);
+    t.nontrans_put(row_key(1), row_type{10});
+    {
+        // a reader of replica 1 sees a writer that selected on replica 0
+        TestTransaction t1(0);
+        bench::replica_thread_node() = 1;
+        assert(read(t, 1) == 10);
+        TestTransaction t2(1);
+        bench::replica_thread_node() = 0;
+        auto [success, found, rid, value] = t.select_split_row(row_key(1), {{nc::latest, access_t::update}});
+        (void)value;
+        assert(success && found);
+        auto new_row = Sto::tx_alloc<row_type>();
+        new_row->latest = 11;
+        t.update_row(rid, new_row);
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    {
+        // a reader that commits first doesn't stop the writer
+        TestTransaction t1(0);
+        bench::replica_thread_node() = 1;
+        assert(read(t, 1) == 11);
+        TestTransaction t2(1);
+        bench::replica_thread_node() = 0;
+        auto [success, found, rid, value] = t.select_split_row(row_key(1), {{nc::latest, access_t::update}});
+        (void)value;
+        assert(success && found);
+        auto new_row = Sto::tx_alloc<row_type>();
+        new_row->latest = 12;
+        t.update_row(rid, new_row);
+        t1.use();
+        assert(t1.try_commit());
+        t2.use();
+        assert(t2.try_commit());
+    }
+    assert(replica_value(t, 0, 1) == 12 && replica_value(t, 1, 1) == 12);
+    bench::replica_thread_node() = -1;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testLoad<db_params::db_default_params>();
+    testUpdate<db_params::db_default_params>();
+    testUpdate<db_params::db_default_commute_params>();
+    testConflict<db_params::db_default_params>();
+
+    std::thread advancer;
+    Transaction::rcu_release_all(advancer, 2);
+    return 0;
+}
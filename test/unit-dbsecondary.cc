@@ -0,0 +1,105 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "DB_secondary.hh"
+
+// Records transactional inserts and applied nontrans_puts
+struct fake_index {
+    typedef uint64_t key_type;
+    typedef uint64_t value_type;
+
+    std::map<uint64_t, uint64_t> inserted;
+    std::map<uint64_t, uint64_t> put;
+
+    std::tuple<bool, bool> insert_row(const key_type& k, value_type* vptr, bool) {
+        bool found = inserted.count(k) || put.count(k);
+        if (!found)
+            inserted[k] = *vptr;
+        return {true, found};
+    }
+    void nontrans_put(const key_type& k, const value_type& v) {
+        put[k] = v;
+    }
+};
+
+struct key_of {
+    uint64_t operator()(uint64_t k, uint64_t v) const {
+        return v * 1000 + k;
+    }
+};
+
+typedef bench::secondary_index<fake_index, fake_index, key_of> secondary_type;
+
+void testImmediate() {
+    fake_index primary, secondary;
+    secondary_type s(primary, secondary, false);
+    uint64_t v = 7, sv = 1;
+    TRANSACTION_E {
+        auto [success, found] = s.insert_row(1, &v, &sv);
+        assert(success && !found);
+    } RETRY_E(false);
+    assert(primary.inserted.at(1) == 7);
+    assert(secondary.inserted.at(7001) == 1 && secondary.put.empty());
+    // an existing primary key adds no entry
+    TRANSACTION_E {
+        auto [success, found] = s.insert_row(1, &v, &sv);
+        assert(success && found);
+    } RETRY_E(false);
+    assert(secondary.inserted.size() == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDeferred() {
+    fake_index primary, secondary;
+    secondary_type s(primary, secondary, true);
+    TBox<int> box;
+    uint64_t v = 3, sv = 2;
+    TRANSACTION_E {
+        box = 1;
+        s.insert_row(1, &v, &sv);
+        s.insert_row(2, &v, &sv);
+        assert(secondary.put.empty());
+    } RETRY_E(false);
+    assert(bench::deferred_index_updates::empty());
+    assert(secondary.inserted.empty());
+    assert(secondary.put.size() == 2 && secondary.put.at(3001) == 2 && secondary.put.at(3002) == 2);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAborted() {
+    fake_index primary, secondary;
+    secondary_type s(primary, secondary, true);
+    TBox<int> box;
+    uint64_t v = 5, sv = 4;
+    {
+        TestTransaction t(0);
+        box = 1;
+        s.insert_row(1, &v, &sv);
+        assert(!bench::deferred_index_updates::empty());
+        t.get_tx().silent_abort();
+    }
+    assert(bench::deferred_index_updates::empty() && secondary.put.empty());
+    // entries queued by an attempt that aborted don't leak into the retry
+    int attempts = 0;
+    TRANSACTION_E {
+        box = 2;
+        s.insert_row(10 + attempts, &v, &sv);
+        if (++attempts == 1)
+            Sto::silent_abort();
+    } RETRY_E(true);
+    assert(attempts == 2);
+    assert(secondary.put.size() == 1 && secondary.put.count(5011));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testImmediate();
+    testDeferred();
+    testAborted();
+    return 0;
+}
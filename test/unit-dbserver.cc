@@ -0,0 +1,126 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "DB_server.hh"
+
+enum { proc_add = 1, proc_echo = 2, proc_refuse = 3, proc_missing = 9 };
+
+// Two clients of two connections each keep eight requests in flight,
+// mostly transactional increments of a counter that the server groups
+// four to a transaction, plus echoes, calls of an unknown procedure, and
+// transactional requests that write the counter and then refuse.
+void testPipelinedRequests() {
+    constexpr uint64_t per_connection = 2000;
+    TBox<int64_t> counter;
+    counter.nontrans_write(0);
+
+    bench::txn_server::params sp;
+    sp.nworkers = 2;
+    sp.first_thread_id = 0;
+    sp.pin = false;
+    sp.group = 4;
+    bench::txn_server server(sp);
+    server.add_txn_procedure(proc_add, [&](const char* args, size_t len, std::string& out, int) {
+            int64_t delta;
+            assert(len == sizeof(delta));
+            memcpy(&delta, args, sizeof(delta));
+            int64_t v = counter + delta;
+            counter = v;
+            out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+            return uint16_t(bench::status_ok);
+        });
+    server.add_txn_procedure(proc_refuse, [&](const char*, size_t, std::string& out, int) -> uint16_t {
+            counter = counter + 1000;
+            out = "refused";
+            throw bench::txn_server::user_abort();
+        });
+    server.add_procedure(proc_echo, [](const char* args, size_t len, std::string& out, int) {
+            out.append(args, len);
+            return uint16_t(bench::status_ok);
+        });
+    assert(server.start());
+    assert(server.port() > 0);
+
+    bench::txn_client::params cp;
+    cp.port = server.port();
+    cp.nthreads = 2;
+    cp.connections = 2;
+    cp.depth = 8;
+    cp.seconds = 60;
+    cp.requests = per_connection;
+    bench::txn_client client(cp);
+    std::atomic<uint64_t> adds(0), missing(0), refused(0);
+    bench::txn_client::result r;
+    bool ok = client.run([&](std::string& args, sampling::xoshiro256ss& rng) {
+            uint64_t x = rng();
+            if (x % 10 == 0) {
+                args = "hello";
+                return uint16_t(proc_echo);
+            } else if (x % 10 == 1) {
+                ++missing;
+                return uint16_t(proc_missing);
+            } else if (x % 10 == 2) {
+                ++refused;
+                return uint16_t(proc_refuse);
+            }
+            int64_t delta = 1;
+            args.append(reinterpret_cast<const char*>(&delta), sizeof(delta));
+            ++adds;
+            return uint16_t(proc_add);
+        }, r);
+    assert(ok);
+    server.stop();
+
+    uint64_t total = cp.nthreads * cp.connections * per_connection;
+    assert(r.completed == total);
+    assert(r.failed == missing + refused);
+    assert(r.latency.count() == total);
+    assert(counter.nontrans_read() == int64_t(adds));
+    auto s = server.statistics();
+    assert(s.connections == uint64_t(cp.nthreads * cp.connections));
+    assert(s.requests == total);
+    assert(s.batches > 0 && s.batches <= total);
+    uint64_t txn_requests = adds + refused;
+    assert(s.transactions >= (txn_requests + sp.group - 1) / sp.group
+           && s.transactions <= txn_requests);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOversizedRequest() {
+    // a request past max_request gets too_large and its connection closes
+    bench::txn_server::params sp;
+    sp.pin = false;
+    sp.max_request = 16;
+    bench::txn_server server(sp);
+    server.add_procedure(proc_echo, [](const char* args, size_t len, std::string& out, int) {
+            out.append(args, len);
+            return uint16_t(bench::status_ok);
+        });
+    assert(server.start());
+    bench::txn_client::params cp;
+    cp.port = server.port();
+    cp.seconds = 10;
+    cp.requests = 1;
+    bench::txn_client::result r;
+    bool ok = bench::txn_client(cp).run([](std::string& args, sampling::xoshiro256ss&) {
+            args.assign(100, 'x');
+            return uint16_t(proc_echo);
+        }, r);
+    assert(!ok);
+    assert(r.completed == 1 && r.failed == 1);
+    server.stop();
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testPipelinedRequests();
+    testOversizedRequest();
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 8);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <type_traits>
+#include "DB_strings.hh"
+
+using bench::inline_string;
+using bench::overflow_string;
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+void testKernels() {
+    std::mt19937 rng(55);
+    char a[128], b[128];
+    for (int trial = 0; trial != 50000; ++trial) {
+        size_t n = rng() % 101;
+        for (size_t i = 0; i != n; ++i)
+            a[i] = b[i] = char(rng());
+        // differ at one position, sometimes
+        if (n && rng() % 2)
+            b[rng() % n] = char(rng());
+        assert(bench::bytes_equal(a, b, n) == (memcmp(a, b, n) == 0));
+        assert(sign(bench::bytes_compare(a, b, n)) == sign(memcmp(a, b, n)));
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testInlineString() {
+    static_assert(std::is_trivially_copyable<inline_string<24>>::value, "key-safe");
+    static_assert(sizeof(inline_string<24>) == 25, "one length byte");
+    static_assert(sizeof(inline_string<300>) == 302, "two length bytes");
+
+    inline_string<24> e, a("CUSTOMERNAMEBARBARABLE"), b(std::string("CUSTOMERNAMEBARBARABLE"));
+    assert(e.length() == 0 && a.length() == 22);
+    assert(a == b && a == "CUSTOMERNAMEBARBARABLE" && a == std::string(b));
+    assert(a != e && !(a == "CUSTOMERNAMEBARBARABL"));
+    assert(e < a && a.compare(b) == 0);
+    assert(inline_string<24>("ab") < inline_string<24>("abc"));
+    assert(inline_string<24>("abd").compare(inline_string<24>("abc")) > 0);
+
+    // truncated to ML
+    inline_string<4> t("abcdefg");
+    assert(t.length() == 4 && t == "abcd");
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOverflowString() {
+    typedef overflow_string<100, 16> ostr;
+    static_assert(sizeof(ostr) == 17, "pays inline length only");
+
+    std::string shortv = "short data", longv(80, 'x');
+    ostr s(shortv), l(longv);
+    assert(!s.overflowed() && l.overflowed());
+    assert(s == shortv && l == longv && l.length() == 80);
+
+    ostr c(l);
+    assert(c == l && c.data() != l.data());
+    c = s;
+    assert(!c.overflowed() && c == shortv);
+    c = l;
+    assert(c.overflowed() && c == longv);
+    c = c;
+    assert(c == longv);
+    assert(s.compare(l) < 0 && l.compare(c) == 0);
+    assert(std::string(l) == longv);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testKernels();
+    testInlineString();
+    testOverflowString();
+    return 0;
+}
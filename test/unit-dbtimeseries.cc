@@ -0,0 +1,95 @@
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "DB_timeseries.hh"
+
+using bench::timeseries_sampler;
+
+static size_t count_fields(const std::string& line) {
+    size_t n = 1;
+    for (char c : line)
+        n += (c == ',');
+    return n;
+}
+
+void testSampling() {
+    TBox<int> box;
+    std::atomic<bool> done(false);
+    std::vector<std::thread> thrs;
+    for (int t = 0; t != 2; ++t)
+        thrs.emplace_back([&, t]() {
+                TThread::set_id(t);
+                while (!done.load(std::memory_order_relaxed)) {
+                    TRANSACTION_E {
+                        box = box + 1;
+                    } RETRY_E(true);
+                }
+            });
+
+    timeseries_sampler sampler;
+    sampler.start(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    sampler.stop();
+    done = true;
+    for (auto& t : thrs)
+        t.join();
+
+    auto& samples = sampler.samples();
+    assert(samples.size() >= 3);
+    for (size_t i = 1; i != samples.size(); ++i) {
+        assert(samples[i].tsc > samples[i - 1].tsc);
+        assert(samples[i].global_epoch >= samples[i - 1].global_epoch);
+        if (txp_count > txp_total_aborts)
+            for (int t = 0; t != 2; ++t)
+                assert(samples[i].thread_commits[t] >= samples[i - 1].thread_commits[t]);
+    }
+    if (txp_count > txp_total_aborts)
+        assert(samples.back().thread_commits[0] && samples.back().thread_commits[1]);
+
+    // a header, then one row per interval with as many fields
+    std::istringstream csv([&]() {
+            std::ostringstream out;
+            sampler.dump(out, 1e9);
+            return out.str();
+        }());
+    std::string header, line;
+    std::getline(csv, header);
+    assert(header.compare(0, 15, "ms,commits_per_") == 0);
+    size_t rows = 0;
+    while (std::getline(csv, line)) {
+        assert(count_fields(line) == count_fields(header));
+        ++rows;
+    }
+    assert(rows == samples.size() - 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRestart() {
+    timeseries_sampler sampler;
+    sampler.stop();
+    assert(sampler.samples().empty());
+    auto t0 = std::chrono::steady_clock::now();
+    sampler.start(1000);
+    sampler.stop();
+    // stopping doesn't wait out the interval
+    assert(std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(500));
+    assert(sampler.samples().size() == 2);
+    sampler.start(1000);
+    sampler.stop();
+    assert(sampler.samples().size() == 2);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSampling();
+    testRestart();
+    return 0;
+}
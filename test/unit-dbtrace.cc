@@ -0,0 +1,184 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "DB_trace.hh"
+#include "Sto.hh"
+#include "TBox.hh"
+
+using bench::trace_file;
+using bench::trace_op;
+using bench::trace_record;
+using bench::trace_recorder;
+using bench::trace_writer;
+
+static std::string make_path() {
+    char path[] = "/tmp/sto-trace-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    return path;
+}
+
+void testRoundTrip() {
+    std::string path = make_path();
+    {
+        trace_writer w(path);
+        assert(w.ok());
+        for (uint64_t t = 0; t != 100000; ++t) {
+            w.begin_txn();
+            w.add(t % 3, trace_op::read, t);
+            w.add(t % 3, trace_op::update, t + 1);
+            if (t % 10 == 0)
+                w.add(2, trace_op::scan, t, 20);
+        }
+        assert(w.close());
+    }
+
+    trace_file f(path);
+    assert(f.ok());
+    assert(f.header().ntables == 3);
+    assert(f.header().ntxns == 100000);
+    assert(f.size() == 210000);
+    assert(f.count(trace_op::scan) == 10000);
+    const trace_record* r = f.begin();
+    for (uint64_t t = 0; t != 100000; ++t) {
+        assert(r[0].begins_txn() && r[0].op == trace_op::read && r[0].key == t && r[0].table == t % 3);
+        assert(!r[1].begins_txn() && r[1].op == trace_op::update && r[1].key == t + 1);
+        const trace_record* e = f.txn_end(r, f.end());
+        assert(e == r + (t % 10 == 0 ? 3 : 2));
+        if (t % 10 == 0)
+            assert(r[2].op == trace_op::scan && r[2].arg == 20);
+        r = e;
+    }
+    assert(r == f.end());
+
+    // not a trace
+    unlink(path.c_str());
+    assert(!trace_file(path).ok());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPartition() {
+    std::string path = make_path();
+    {
+        trace_writer w(path);
+        // transactions of 1 to 7 records
+        for (uint64_t t = 0; t != 1000; ++t) {
+            w.begin_txn();
+            for (uint64_t i = 0; i <= t % 7; ++i)
+                w.add(0, trace_op::read, t);
+        }
+        assert(w.close());
+    }
+    trace_file f(path);
+    assert(f.ok());
+
+    for (unsigned nparts : {1, 3, 8, 64}) {
+        auto parts = f.partition(nparts);
+        assert(parts.size() == nparts);
+        assert(parts.front().first == f.begin() && parts.back().second == f.end());
+        for (unsigned i = 0; i != nparts; ++i) {
+            // contiguous runs of whole transactions, of about equal size
+            if (i)
+                assert(parts[i].first == parts[i - 1].second);
+            assert(parts[i].first == f.end() || parts[i].first->begins_txn());
+            size_t n = parts[i].second - parts[i].first;
+            assert(n + 7 >= f.size() / nparts && n <= f.size() / nparts + 7);
+        }
+    }
+
+    // more parts than transactions leaves some empty
+    {
+        trace_writer w(path);
+        w.add(0, trace_op::update, 1);
+        w.begin_txn();
+        w.add(0, trace_op::update, 2);
+        assert(w.close());
+    }
+    trace_file g(path);
+    auto parts = g.partition(4);
+    size_t nonempty = 0;
+    for (auto& p : parts)
+        nonempty += p.first != p.second;
+    assert(nonempty == 2 && parts.back().second == g.end());
+    unlink(path.c_str());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRecorder() {
+    static constexpr int nboxes = 16;
+    static constexpr int nthreads = 4;
+    static constexpr int ntxns = 1000;
+    TBox<int> boxes[nboxes];
+    TBox<int> untraced;
+    for (int i = 0; i != nboxes; ++i)
+        trace_recorder::add_table(&boxes[i], 1, [i] (const TransItem&, uint64_t& key) {
+                key = i;
+                return true;
+            });
+    trace_recorder::start();
+
+    std::vector<std::thread> thrs;
+    for (int t = 0; t != nthreads; ++t)
+        thrs.emplace_back([&, t] {
+                TThread::set_id(t);
+                for (int n = 0; n != ntxns; ++n) {
+                    int a = (t + n) % nboxes, b = (t + 3 * n + 1) % nboxes;
+                    TRANSACTION_E {
+                        int x = boxes[a];
+                        boxes[b] = x + 1;
+                        untraced = n;
+                    } RETRY_E(true);
+                }
+            });
+    for (auto& t : thrs)
+        t.join();
+    trace_recorder::stop();
+
+    // not recorded once stopped
+    TThread::set_id(0);
+    TRANSACTION_E {
+        boxes[0] = 1;
+    } RETRY_E(true);
+
+    std::string path = make_path();
+    assert(trace_recorder::write(path));
+    trace_recorder::clear();
+
+    trace_file f(path);
+    assert(f.ok());
+    assert(f.header().ntxns == nthreads * ntxns);
+    assert(f.header().ntables == 2);
+    // each thread's transactions, in order: a read of a, a write of b (or
+    // one update, if a == b)
+    const trace_record* r = f.begin();
+    for (int t = 0; t != nthreads; ++t)
+        for (int n = 0; n != ntxns; ++n) {
+            int a = (t + n) % nboxes, b = (t + 3 * n + 1) % nboxes;
+            const trace_record* e = f.txn_end(r, f.end());
+            assert(r->begins_txn() && r->table == 1);
+            if (a == b)
+                assert(e == r + 1 && r->op == trace_op::update && r->key == uint64_t(a));
+            else {
+                assert(e == r + 2);
+                for (; r != e; ++r)
+                    assert((r->op == trace_op::read && r->key == uint64_t(a))
+                           || (r->op == trace_op::update && r->key == uint64_t(b)));
+            }
+            r = e;
+        }
+    assert(r == f.end());
+    unlink(path.c_str());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testRoundTrip();
+    testPartition();
+    testRecorder();
+    return 0;
+}
@@ -0,0 +1,153 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include "Sto.hh"
+#include "DB_params.hh"
+#include "DB_views.hh"
+
+struct group_key {
+    group_key() = default;
+    explicit group_key(uint64_t g) : g(g) {}
+    bool operator==(const group_key& other) const {
+        return g == other.g;
+    }
+
+    uint64_t g;
+};
+
+// Base rows are (k, v): group k % 4, value v
+struct group_of {
+    group_key operator()(uint64_t k, uint64_t) const {
+        return group_key(k % 4);
+    }
+};
+struct value_of {
+    int64_t operator()(uint64_t, uint64_t v) const {
+        return v;
+    }
+};
+
+template <typename DBParams>
+using Index = typename std::conditional<DBParams::MVCC,
+      bench::mvcc_unordered_index<group_key, bench::latest_row, DBParams>,
+      bench::unordered_index<group_key, bench::latest_row, DBParams>>::type;
+template <typename DBParams>
+using AggIndex = typename std::conditional<DBParams::MVCC,
+      bench::mvcc_unordered_index<group_key, bench::aggregate_row, DBParams>,
+      bench::unordered_index<group_key, bench::aggregate_row, DBParams>>::type;
+
+template <typename DBParams>
+void testLatest() {
+    typedef Index<DBParams> index_type;
+    index_type idx(1024);
+    bench::latest_view<index_type, group_of, value_of> view(idx);
+
+    {
+        // groups are created on first insert
+        TestTransaction t(0);
+        assert(view.insert(1, 10));
+        assert(view.insert(2, 4));
+        assert(t.try_commit());
+    }
+    {
+        // repeated updates of a group fold together
+        TestTransaction t(0);
+        assert(view.insert(5, 30));
+        assert(view.insert(9, 20));
+        assert(t.try_commit());
+    }
+    {
+        TestTransaction t(0);
+        int64_t latest = 0;
+        auto [success, found] = view.read(group_key(1), &latest);
+        assert(success && found && latest == 30);
+        std::tie(success, found) = view.read(group_key(2), &latest);
+        assert(success && found && latest == 4);
+        std::tie(success, found) = view.read(group_key(3), &latest);
+        assert(success && !found);
+        assert(t.try_commit());
+    }
+    {
+        // concurrent maintenance of one group conflicts only without
+        // commutative updates (OCC)
+        TestTransaction t1(0);
+        assert(view.insert(13, 50));
+        TestTransaction t2(1);
+        assert(view.insert(17, 40));
+        t1.use();
+        assert(t1.try_commit());
+        t2.use();
+        assert(t2.try_commit() == (DBParams::Commute || DBParams::MVCC));
+    }
+    {
+        TestTransaction t(0);
+        int64_t latest = 0;
+        auto [success, found] = view.read(group_key(1), &latest);
+        assert(success && found && latest == 50);
+        assert(t.try_commit());
+    }
+
+    printf("PASS: %s (mvcc %d, commute %d)\n", __FUNCTION__, DBParams::MVCC, DBParams::Commute);
+}
+
+template <typename DBParams>
+void testAggregate() {
+    typedef AggIndex<DBParams> index_type;
+    index_type idx(1024);
+    bench::aggregate_view<index_type, group_of, value_of> view(idx);
+
+    {
+        TestTransaction t(0);
+        assert(view.insert(1, 10));
+        assert(view.insert(2, 7));
+        assert(t.try_commit());
+    }
+    {
+        TestTransaction t(0);
+        assert(view.insert(5, 30));
+        assert(view.insert(9, 20));
+        assert(view.remove(1, 10));
+        assert(t.try_commit());
+    }
+    {
+        // a row changes value within its group, and another moves from
+        // group 2 to group 3
+        TestTransaction t(0);
+        assert(view.insert(6, 7));
+        assert(view.update(6, 7, 9));
+        assert(view.update(2, 7, 7) && view.remove(2, 7) && view.insert(3, 7));
+        assert(t.try_commit());
+    }
+    {
+        TestTransaction t(0);
+        int64_t count = 0, sum = 0;
+        auto [success, found] = view.read(group_key(1), &count, &sum);
+        assert(success && found && count == 2 && sum == 50);
+        std::tie(success, found) = view.read(group_key(2), &count, &sum);
+        assert(success && found && count == 1 && sum == 9);
+        std::tie(success, found) = view.read(group_key(3), &count, &sum);
+        assert(success && found && count == 1 && sum == 7);
+        std::tie(success, found) = view.read(group_key(0), &count, &sum);
+        assert(success && !found);
+        assert(t.try_commit());
+    }
+
+    printf("PASS: %s (mvcc %d, commute %d)\n", __FUNCTION__, DBParams::MVCC, DBParams::Commute);
+}
+
+int main() {
+    testLatest<db_params::db_default_params>();
+    testLatest<db_params::db_default_commute_params>();
+    testLatest<db_params::db_mvcc_params>();
+    testLatest<db_params::db_mvcc_commute_params>();
+    testAggregate<db_params::db_default_params>();
+    testAggregate<db_params::db_default_commute_params>();
+    testAggregate<db_params::db_mvcc_params>();
+    testAggregate<db_params::db_mvcc_commute_params>();
+
+    std::thread advancer;
+    Transaction::rcu_release_all(advancer, 2);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+
+static std::atomic<int> nfreed;
+
+static void count_free(void*) {
+    ++nfreed;
+}
+
+static int count_active() {
+    int n = 0;
+    TThread::for_each_active([&] (int) { ++n; });
+    return n;
+}
+
+void testJoinLeave() {
+    // waves of threads join, commit, retire rcu callbacks, and leave;
+    // ids are reused, and nothing a thread left behind is lost
+    constexpr int nwaves = 5, nthreads = 4, ntxns = 200;
+    TBox<int> box;
+    Transaction::set_profile_counters(true);
+    Transaction::clear_stats();
+    int base = count_active();
+    for (int w = 0; w < nwaves; ++w) {
+        std::vector<std::thread> ts;
+        std::vector<int> ids(nthreads, -1);
+        for (int i = 0; i < nthreads; ++i)
+            ts.emplace_back([&, i] {
+                    ids[i] = Sto::thread_join(8);
+                    assert(ids[i] >= 8 && TThread::id() == ids[i]);
+                    for (int n = 0; n < ntxns; ++n) {
+                        TRANSACTION_E {
+                            box = box + 1;
+                            Transaction::rcu_call<count_free>(nullptr);
+                        } RETRY_E(true);
+                    }
+                    Sto::thread_leave();
+                    assert(Transaction::tinfo[ids[i]].rcu_set.empty());
+                });
+        for (auto& t : ts)
+            t.join();
+        for (int id : ids)
+            assert(id >= 8 && id < 8 + nthreads);
+        assert(count_active() == base);
+    }
+    assert(box.nontrans_read() == nwaves * nthreads * ntxns);
+    assert(nfreed == nwaves * nthreads * ntxns);
+    // the departed threads' counters live on in the retired totals
+    for (int id = 8; id < 8 + nthreads; ++id)
+        assert(Transaction::tinfo[id].p_.p(txp_total_starts) == 0);
+    auto starts = Transaction::txp_counters_combined().p(txp_total_starts);
+    assert(starts >= uint64_t(nwaves * nthreads * ntxns));
+    Transaction::set_profile_counters(false);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testLeaveWithoutDrain() {
+    // a thread that leaves mid-epoch doesn't hold back reclamation, and
+    // its callbacks run under the id's next owner
+    nfreed = 0;
+    int id = -1;
+    std::thread([&] {
+            id = Sto::thread_join(8);
+            TRANSACTION_E {
+                Transaction::rcu_call<count_free>(nullptr);
+            } RETRY_E(true);
+            Sto::thread_leave(false);
+        }).join();
+    auto ae = Transaction::global_epochs.active_epoch.load();
+    while (Transaction::global_epochs.active_epoch.load() < ae + 3)
+        usleep(1000);
+    assert(nfreed == 0);
+    std::thread([&] {
+            assert(Sto::thread_join(8) == id);
+            while (nfreed == 0) {
+                TRANSACTION_E {
+                } RETRY_E(true);
+                usleep(1000);
+            }
+            Sto::thread_leave();
+        }).join();
+    assert(nfreed == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    Transaction::set_epoch_cycle(1000);
+    auto advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+    testJoinLeave();
+    testLeaveWithoutDrain();
+    Transaction::rcu_release_all(advancer, 8);
+    return 0;
+}
@@ -0,0 +1,139 @@
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "TMvBox.hh"
+
+static int tid_thread(TransactionTid::type tid) {
+    return (tid / TransactionTid::increment_value) & TransactionTid::threadid_mask;
+}
+
+// a box whose version the test can stamp
+struct StampedBox : TBox<int> {
+    using TBox<int>::operator=;
+    void stamp(TransactionTid::type v) {
+        vers_ = version_type(v);
+    }
+    TransactionTid::type version() const {
+        return vers_.value();
+    }
+};
+
+// the last epoch TID thread can take in epoch e before its ticks saturate
+static TransactionTid::type last_epoch_tid(Transaction::epoch_type e, int thread) {
+    TransactionTid::type seq = (TransactionTid::type(e) << 12) | 4095;
+    return ((seq << TransactionTid::mask_width) | thread) * TransactionTid::increment_value;
+}
+
+static void wait_epochs(int n) {
+    auto e = Transaction::global_epochs.global_epoch.load();
+    while (Transaction::global_epochs.global_epoch.load() < e + n)
+        usleep(500);
+}
+
+void testUnique() {
+    // threads make their own commit TIDs: unique, increasing per thread,
+    // tagged with the thread id, and the transactions still serialize
+    constexpr int nthreads = 4, ntxns = 5000, nboxes = 3;
+    std::vector<TBox<int>> boxes(nboxes);
+    std::vector<std::vector<TransactionTid::type>> tids(nthreads);
+    std::vector<std::thread> ts;
+    for (int i = 0; i < nthreads; ++i)
+        ts.emplace_back([&, i] {
+                TThread::set_id(i);
+                for (int n = 0; n < ntxns; ++n) {
+                    TransactionTid::type tid = 0;
+                    TRANSACTION_E {
+                        auto& b = boxes[(n + i) % nboxes];
+                        b = b + 1;
+                        tid = Sto::transaction()->write_tid();
+                    } RETRY_E(true);
+                    tids[i].push_back(tid);
+                }
+            });
+    for (auto& t : ts)
+        t.join();
+
+    int total = 0;
+    for (auto& b : boxes)
+        total += b.nontrans_read();
+    assert(total == nthreads * ntxns);
+    std::vector<TransactionTid::type> all;
+    for (int i = 0; i < nthreads; ++i) {
+        assert(std::is_sorted(tids[i].begin(), tids[i].end()));
+        for (auto tid : tids[i]) {
+            assert(tid_thread(tid) == i);
+            all.push_back(tid);
+        }
+    }
+    std::sort(all.begin(), all.end());
+    assert(std::adjacent_find(all.begin(), all.end()) == all.end());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSnapshot() {
+    // a snapshot read sees a commit once its epoch ended; a read-write
+    // transaction sees it at once
+    static TMvBox<int> box;
+    {
+        TransactionGuard t;
+        box = 1;
+    }
+    wait_epochs(2);
+    {
+        TransactionGuard t;
+        box = 2;
+    }
+    TRANSACTION_E {
+        Sto::mvcc_rw_upgrade();
+        assert(box == 2);
+    } RETRY_E(true);
+    wait_epochs(2);
+    {
+        TransactionGuard t;
+        int v = box;
+        assert(v == 2);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAboveObserved() {
+    // a commit TID exceeds every version it read or locked, even one stamped
+    // late in the epoch by another thread (saturated ticks or a skewed TSC)
+    TThread::set_id(0);
+    static StampedBox a, b;
+    auto e = Transaction::global_epochs.global_epoch.load();
+    auto late = last_epoch_tid(e, 5);
+    a.stamp(late);
+    TRANSACTION_E {
+        b = a + 1;
+    } RETRY_E(true);
+    assert(b.version() > late);
+    assert(tid_thread(b.version()) == 0);
+
+    // a blind write goes above the version it overwrites
+    late = last_epoch_tid(e + 1, 6);
+    a.stamp(late);
+    TRANSACTION_E {
+        a = 7;
+    } RETRY_E(true);
+    assert(a.version() > late);
+    assert(tid_thread(a.version()) == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    Transaction::set_epoch_tids(true);
+    Transaction::set_epoch_cycle(1000);
+    auto advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+    testUnique();
+    testSnapshot();
+    testAboveObserved();
+    Transaction::rcu_release_all(advancer, 4);
+    return 0;
+}
@@ -0,0 +1,209 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "TxnExecutor.hh"
+
+static TxnExecutor::params test_params(int nworkers) {
+    TxnExecutor::params p;
+    p.nworkers = nworkers;
+    p.pin = false;
+    return p;
+}
+
+void testContended() {
+    // every transaction moves one unit between two of a few boxes, so
+    // many abort, and each commits exactly once
+    constexpr int nboxes = 4;
+    constexpr int ntxns = 4000;
+    std::vector<TBox<int>> boxes(nboxes);
+    TxnExecutor ex(test_params(4));
+    ex.start();
+    std::vector<std::future<int>> fs;
+    for (int i = 0; i < ntxns; ++i)
+        fs.push_back(ex.submit([&, i] {
+                int from = i % nboxes, to = (i / nboxes + from + 1) % nboxes;
+                if (from == to)
+                    to = (to + 1) % nboxes;
+                int v = boxes[from];
+                boxes[from] = v - 1;
+                boxes[to] = boxes[to] + 1;
+                return i;
+            }));
+    for (int i = 0; i < ntxns; ++i)
+        assert(fs[i].get() == i);
+    ex.stop();
+
+    int total = 0;
+    for (auto& b : boxes)
+        total += b.nontrans_read();
+    assert(total == 0);
+    auto s = ex.statistics();
+    assert(s.submitted == ntxns && s.committed == ntxns && s.failed == 0);
+    printf("PASS: %s (%llu retries, %llu steals)\n", __FUNCTION__,
+           (unsigned long long) s.retries, (unsigned long long) s.steals);
+}
+
+void testFailure() {
+    // an exception other than Abort ends the transaction, rolled back
+    TBox<int> box;
+    TxnExecutor ex(test_params(2));
+    ex.start();
+    auto bad = ex.submit([&] {
+            box = 1;
+            throw std::runtime_error("no");
+        });
+    auto aborted_once = ex.submit([&, n = 0]() mutable {
+            if (n++ == 0)
+                throw Transaction::Abort();
+            box = box + 2;
+        });
+    bool threw = false;
+    try {
+        bad.get();
+    } catch (std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    aborted_once.get();
+    ex.stop();
+    assert(box.nontrans_read() == 2);
+    auto s = ex.statistics();
+    assert(s.committed == 1 && s.failed == 1 && s.retries == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testKeyed() {
+    // transactions with one key run on one worker, one at a time, so
+    // transactions that only conflict within a key never abort
+    constexpr int nkeys = 8;
+    constexpr int ntxns = 4000;
+    std::vector<TBox<int>> boxes(nkeys);
+    std::vector<int> worker_of(nkeys, -1);
+    TxnExecutor ex(test_params(4));
+    ex.start();
+    std::vector<std::future<void>> fs;
+    for (int i = 0; i < ntxns; ++i) {
+        int k = i % nkeys;
+        fs.push_back(ex.submit([&, k] {
+                int& w = worker_of[k];
+                assert(w == -1 || w == TThread::id());
+                w = TThread::id();
+                boxes[k] = boxes[k] + 1;
+            }, k + 1));
+    }
+    for (auto& f : fs)
+        f.get();
+    ex.stop();
+    for (auto& b : boxes)
+        assert(b.nontrans_read() == ntxns / nkeys);
+    auto s = ex.statistics();
+    assert(s.committed == ntxns && s.retries == 0 && s.steals == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSubmitFromWorker() {
+    // a worker's own submissions go on its deque, where idle workers steal
+    // them; stop() waits for all of them
+    constexpr int nchildren = 200;
+    TBox<int> box;
+    std::atomic<int> ran(0);
+    TxnExecutor ex(test_params(3));
+    ex.start();
+    ex.submit([&] {
+            // once, even if this transaction ran again
+            if (ran.exchange(1) == 0)
+                for (int i = 0; i < nchildren; ++i)
+                    ex.submit([&] {
+                            box = box + 1;
+                        });
+        }).get();
+    ex.stop();
+    assert(box.nontrans_read() == nchildren);
+    assert(ex.statistics().committed == nchildren + 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDeclaredKeys() {
+    // declared keys steer only while they're contended
+    constexpr int nkeys = 4;
+    std::vector<TBox<int>> boxes(nkeys);
+    TxnExecutor ex(test_params(4));
+    ex.start();
+    for (int i = 0; i < 100; ++i) {
+        ex.submit([&, i] {
+                boxes[i % nkeys] = boxes[i % nkeys] + 1;
+            }, std::vector<uint64_t>{uint64_t(i % nkeys)});
+        ex.drain();
+    }
+    assert(ex.statistics().steered == 0);
+
+    // a transaction holds its worker until the others are queued, so they
+    // overlap it and each other
+    std::atomic<bool> release(false);
+    std::vector<std::future<void>> fs;
+    fs.push_back(ex.submit([&] {
+            boxes[0] = boxes[0] + 1;
+            while (!release)
+                std::this_thread::yield();
+        }, std::vector<uint64_t>{0, 1}));
+    for (int i = 0; i < 100; ++i)
+        fs.push_back(ex.submit([&, i] {
+                boxes[i % 2] = boxes[i % 2] + 1;
+            }, std::vector<uint64_t>{uint64_t(i % 2)}));
+    release = true;
+    for (auto& f : fs)
+        f.get();
+    ex.stop();
+    assert(boxes[0].nontrans_read() + boxes[1].nontrans_read() == 50 + 101);
+    auto s = ex.statistics();
+    assert(s.steered == 100 && s.committed == 201);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testReroute() {
+    // a transaction that loses a conflict on an item is retried on the
+    // worker that item hashes to
+    TBox<int> box;
+    std::atomic<int> stage(0);
+    TxnExecutor ex(test_params(2));
+    ex.start();
+    auto a = ex.submit([&] {
+            int v = box;
+            if (stage == 0) {
+                stage = 1;
+                while (stage != 2)
+                    std::this_thread::yield();
+            }
+            box = v + 1;
+        });
+    while (stage != 1)
+        std::this_thread::yield();
+    ex.submit([&] {
+            box = box + 10;
+        }).get();
+    stage = 2;
+    a.get();
+    ex.stop();
+    assert(box.nontrans_read() == 11);
+    auto s = ex.statistics();
+    assert(s.retries == 1 && s.rerouted == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testContended();
+    testFailure();
+    testKeyed();
+    testSubmitFromWorker();
+    testDeclaredKeys();
+    testReroute();
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 8);
+    return 0;
+}
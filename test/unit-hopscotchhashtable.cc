@@ -0,0 +1,274 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "Commutators.hh"
+#include "HopscotchHashtable.hh"
+
+typedef HopscotchHashtable<Hashtable_params<int, int>> ht_type;
+
+// Key 1000 + k shares a hash with key k
+struct aliasing_hash {
+    size_t operator()(int k) const {
+        return k >= 1000 ? k - 1000 : k;
+    }
+};
+
+void testNontrans() {
+    ht_type ht;
+    ht.nontrans_put(1, 42);
+    assert(ht.nontrans_get(1) && *ht.nontrans_get(1) == 42);
+    assert(!ht.nontrans_get(42));
+    ht.nontrans_put(1, 9001);
+    assert(*ht.nontrans_get(1) == 9001);
+    assert(ht.nontrans_delete(1));
+    assert(!ht.nontrans_delete(1));
+    assert(!ht.nontrans_get(1));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testTransPutGetUpdate() {
+    ht_type ht;
+    {
+        TestTransaction t(1);
+        int value = 42;
+        auto result = ht.transPut(1, &value);
+        assert(!result.abort && !result.existed);
+        assert(t.try_commit());
+    }
+    assert(*ht.nontrans_get(1) == 42);
+    {
+        TestTransaction t(1);
+        auto result = ht.transGet(1, ht_type::ReadWriteAccess);
+        assert(!result.abort && result.success);
+        int value = 9001;
+        ht.transUpdate(result.ref, &value);
+        assert(*ht.nontrans_get(1) == 42);
+        assert(t.try_commit());
+    }
+    assert(*ht.nontrans_get(1) == 9001);
+    {
+        // reads don't see pending inserts
+        TestTransaction t1(1);
+        int value = 3;
+        assert(!ht.transPut(3, &value).existed);
+        TestTransaction t2(2);
+        assert(!ht.transGet(3, ht_type::ReadOnlyAccess).value);
+        assert(t1.try_commit());
+        assert(t2.try_commit());
+    }
+    assert(*ht.nontrans_get(3) == 3);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testTransDelete() {
+    ht_type ht;
+    ht.nontrans_put(1, 42);
+    {
+        TestTransaction t(1);
+        auto result = ht.transDelete(1);
+        assert(!result.abort && result.success);
+        assert(*ht.nontrans_get(1) == 42);
+        assert(t.try_commit());
+    }
+    assert(!ht.nontrans_get(1));
+    {
+        TestTransaction t(1);
+        auto result = ht.transDelete(1);
+        assert(!result.abort && !result.success);
+        assert(t.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbortedInsert() {
+    ht_type ht;
+    {
+        TestTransaction t(1);
+        int value = 5;
+        ht.transPut(5, &value);
+        // destroying the transaction aborts it
+    }
+    assert(!ht.nontrans_get(5));
+    ht.nontrans_put(5, 6);
+    assert(*ht.nontrans_get(5) == 6);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPhantom() {
+    ht_type ht;
+    {
+        // an absent key that appears fails the reader
+        TestTransaction t1(1);
+        assert(!ht.transGet(7, ht_type::ReadOnlyAccess).success);
+        int one = 1;
+        ht.transPut(100, &one, true);
+        TestTransaction t2(2);
+        int value = 7;
+        ht.transPut(7, &value);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // ...but an insert of another key leaves it alone
+        TestTransaction t1(1);
+        assert(!ht.transGet(8, ht_type::ReadOnlyAccess).success);
+        int one = 1;
+        ht.transPut(100, &one, true);
+        TestTransaction t2(2);
+        int value = 9;
+        ht.transPut(9, &value);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDisplacement() {
+    HopscotchHashtable<Hashtable_params<int, int, aliasing_hash>> ht(64);
+    for (int i = 0; i != 40; ++i) {
+        ht.nontrans_put(i, i);
+    }
+    // the first free slot is out of reach of bucket 0 until a key moves
+    ht.nontrans_put(1000, 1000);
+    {
+        TestTransaction t(1);
+        int value = 1001;
+        assert(!ht.transPut(1001, &value).existed);
+        assert(t.try_commit());
+    }
+    assert(ht.nbuckets() == 64);
+    for (int i = 0; i != 40; ++i) {
+        assert(ht.nontrans_get(i) && *ht.nontrans_get(i) == i);
+    }
+    assert(*ht.nontrans_get(1000) == 1000 && *ht.nontrans_get(1001) == 1001);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testGrowth() {
+    ht_type ht(16);
+    for (int i = 0; i != 4096; ++i) {
+        ht.nontrans_put(i, i + 1);
+    }
+    assert(ht.nbuckets() >= 4096);
+    for (int i = 0; i < 4096; i += 2) {
+        assert(ht.nontrans_delete(i));
+    }
+    for (int i = 0; i != 4096; ++i) {
+        int* vp = ht.nontrans_get(i);
+        assert(i % 2 ? vp && *vp == i + 1 : !vp);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testGrowthDuringTransaction() {
+    ht_type ht(16);
+    for (int i = 0; i != 8; ++i) {
+        ht.nontrans_put(i, i);
+    }
+    {
+        // references and element versions survive a resize...
+        TestTransaction t1(1);
+        auto result = ht.transGet(3, ht_type::ReadWriteAccess);
+        assert(result.success);
+        int value = 33;
+        ht.transUpdate(result.ref, &value);
+        TestTransaction t2(2);
+        for (int i = 100; i != 200; ++i) {
+            ht.transPut(i, &value);
+        }
+        assert(t2.try_commit());
+        assert(ht.nbuckets() > 16);
+        t1.use();
+        assert(t1.try_commit());
+    }
+    assert(*ht.nontrans_get(3) == 33);
+    {
+        // ...while absent keys were observed in the old buckets
+        size_t n = ht.nbuckets();
+        TestTransaction t1(1);
+        assert(!ht.transGet(1000, ht_type::ReadOnlyAccess).success);
+        int value = 0;
+        ht.transPut(3, &value, true);
+        TestTransaction t2(2);
+        for (int i = 2000; i != 2000 + int(4 * n); ++i) {
+            ht.transPut(i, &value);
+        }
+        assert(t2.try_commit());
+        assert(ht.nbuckets() > n);
+        assert(!t1.try_commit());
+    }
+    assert(*ht.nontrans_get(3) == 33);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testCommute() {
+    typedef HopscotchHashtable<Hashtable_params<int, int64_t>> cht_type;
+    cht_type ht;
+    ht.nontrans_put(1, 10);
+    {
+        TestTransaction t(1);
+        auto result = ht.transGet(1, cht_type::BlindAccess);
+        assert(result.success);
+        commutators::Commutator<int64_t> comm(5);
+        ht.transUpdate(result.ref, comm);
+        assert(t.try_commit());
+    }
+    assert(*ht.nontrans_get(1) == 15);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads insert disjoint keys into a small table, growing it many times,
+// while reading each other's keys
+void testConcurrentGrowth() {
+    constexpr int nthreads = 4;
+    constexpr int nkeys = 20000;
+    ht_type ht(16);
+
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        for (int i = 0; i != nkeys; ++i) {
+            int k = i * nthreads + me;
+            int value = k;
+            TRANSACTION_E {
+                auto result = ht.transPut(k, &value);
+                if (result.abort)
+                    throw Transaction::Abort();
+                if (i) {
+                    auto prev = ht.transGet(k - nthreads, ht_type::ReadOnlyAccess);
+                    if (prev.abort)
+                        throw Transaction::Abort();
+                    assert(prev.success && *prev.value == k - nthreads);
+                }
+            } RETRY_E(true);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+    TThread::set_id(0);
+
+    for (int k = 0; k != nthreads * nkeys; ++k) {
+        assert(ht.nontrans_get(k) && *ht.nontrans_get(k) == k);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testNontrans();
+    testTransPutGetUpdate();
+    testTransDelete();
+    testAbortedInsert();
+    testPhantom();
+    testDisplacement();
+    testGrowth();
+    testGrowthDuringTransaction();
+    testCommute();
+    testConcurrentGrowth();
+    return 0;
+}
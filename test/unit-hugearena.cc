@@ -0,0 +1,129 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TMvBox.hh"
+#include "HugeArena.hh"
+#include "ObjectPool.hh"
+
+struct Row : pool_allocated<Row> {
+    uint64_t key;
+    char payload[200];
+    explicit Row(uint64_t k) : key(k) {
+        memset(payload, int(k & 0xFF), sizeof(payload));
+    }
+    bool intact() const {
+        for (char c : payload)
+            if (c != char(key & 0xFF))
+                return false;
+        return true;
+    }
+};
+
+static bool same_slab(const void* a, const void* b) {
+    return (reinterpret_cast<uintptr_t>(a) ^ reinterpret_cast<uintptr_t>(b)) < HugeArena::slab_size;
+}
+
+void testSelect() {
+    assert(!HugeArena::select(nullptr));
+    assert(!HugeArena::select("tcmalloc"));
+    assert(HugeArena::select("default"));
+    assert(!HugeArena::enabled());
+    // selected before anything below allocates table memory
+    assert(HugeArena::select("hugepage-arena"));
+    assert(HugeArena::enabled());
+    assert(strcmp(HugeArena::selected(), "hugepage-arena") == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testReuse() {
+    int64_t index_bytes = Transaction::mem_counters_combined().bytes(mem_index);
+    std::vector<Row*> rows;
+    for (uint64_t i = 0; i != 1000; ++i)
+        rows.push_back(new Row(i));
+    assert(Transaction::mem_counters_combined().bytes(mem_index)
+           == index_bytes + int64_t(1000 * sizeof(Row)));
+    for (Row* r : rows) {
+        assert(reinterpret_cast<uintptr_t>(r) % HugeArena::granule == 0);
+        assert(r->intact());
+    }
+    assert(same_slab(rows[0], rows[1]));
+    Row* last = rows.back();
+    delete last;
+    rows.pop_back();
+    Row* again = new Row(1);
+    assert(again == last);
+    rows.push_back(again);
+
+    // one size class per slab
+    void* other = HugeArena::allocate(32);
+    assert(!same_slab(other, rows[0]));
+    HugeArena::release(other, 32);
+
+    for (Row* r : rows)
+        delete r;
+    assert(Transaction::mem_counters_combined().bytes(mem_index) == index_bytes);
+    assert(HugeArena::mapped_bytes() >= HugeArena::slab_size);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testCrossThread() {
+    // rows allocated on one thread and freed on another are reused
+    std::vector<Row*> rows(20000);
+    std::thread producer([&] {
+        for (uint64_t i = 0; i != rows.size(); ++i)
+            rows[i] = new Row(i);
+    });
+    producer.join();
+    std::vector<std::thread> consumers;
+    for (unsigned t = 0; t != 4; ++t)
+        consumers.emplace_back([&, t] {
+            for (size_t i = t; i < rows.size(); i += 4) {
+                assert(rows[i]->key == i && rows[i]->intact());
+                delete rows[i];
+            }
+            for (size_t i = t; i < rows.size(); i += 4)
+                rows[i] = new Row(i);
+        });
+    for (auto& c : consumers)
+        c.join();
+    for (size_t i = 0; i != rows.size(); ++i) {
+        assert(rows[i]->key == i && rows[i]->intact());
+        delete rows[i];
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testMvVersions() {
+    static TMvBox<int64_t> box;
+    for (int64_t i = 1; i <= 5000; ++i) {
+        TRANSACTION_E {
+            box = box + 1;
+        } RETRY_E(false);
+        if (i % 100 == 0)
+            Transaction::epoch_advance_once();
+    }
+    {
+        TransactionGuard t;
+        int64_t v = box;
+        assert(v == 5000);
+    }
+    mem_counters mc = Transaction::mem_counters_combined();
+    assert(mc.bytes(mem_mvcc_history) > 0 && mc.bytes(mem_rcu) > 0);
+    Transaction::print_memory_stats();
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testSelect();
+    testReuse();
+    testCrossThread();
+    testMvVersions();
+
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 8);
+    return 0;
+}
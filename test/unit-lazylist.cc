@@ -0,0 +1,243 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "LazyList.hh"
+
+typedef LazyList<int> list_type;
+
+void testSimple() {
+    list_type l;
+    TRANSACTION_E {
+        assert(l.transInsert(3));
+        assert(l.transInsert(1));
+        assert(l.transInsert(2));
+        assert(!l.transInsert(2));
+        assert(l.transFind(2) && *l.transFind(2) == 2);
+    } RETRY_E(false);
+    TRANSACTION_E {
+        assert(l.transContains(1) && l.transContains(3) && !l.transContains(4));
+        assert(l.transDelete(2));
+        assert(!l.transDelete(2));
+        assert(!l.transContains(2));
+        assert(!l.transDelete(7));
+        assert(l.size() == 2);
+    } RETRY_E(false);
+    assert(l.nontrans_size() == 2);
+    assert(!l.nontrans_contains(2) && l.nontrans_contains(3));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOwnWrites() {
+    list_type l;
+    l.insert(5);
+    TRANSACTION_E {
+        assert(l.transInsert(7));
+        assert(l.transContains(7));
+        assert(l.transDelete(7));
+        assert(!l.transContains(7));
+        assert(l.transInsert(7));
+        assert(l.transDelete(5));
+        assert(!l.transContains(5));
+        assert(l.transInsert(5));
+        assert(l.size() == 2);
+    } RETRY_E(false);
+    assert(l.nontrans_contains(5) && l.nontrans_contains(7));
+    assert(l.nontrans_size() == 2);
+
+    // a deleted insert vanishes at commit
+    TRANSACTION_E {
+        l.transInsert(9);
+        l.transDelete(9);
+    } RETRY_E(false);
+    assert(!l.nontrans_contains(9) && l.nontrans_size() == 2);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbortedInsert() {
+    list_type l;
+    {
+        TestTransaction t(1);
+        l.transInsert(4);
+        // destroying the transaction aborts it
+    }
+    assert(!l.nontrans_contains(4) && l.nontrans_size() == 0);
+    assert(l.insert(4));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDisjointWriters() {
+    list_type l;
+    for (int i = 0; i < 10; i += 2)
+        l.insert(i);
+    {
+        // inserts and deletes of different elements commute, size included
+        TestTransaction t1(1);
+        assert(l.transInsert(3));
+        assert(l.transDelete(8));
+        TestTransaction t2(2);
+        assert(l.transInsert(5));
+        assert(l.transDelete(0));
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    assert(l.nontrans_size() == 5);
+    {
+        // ...as do lookups far from the insert
+        TestTransaction t1(1);
+        assert(!l.transContains(7));
+        assert(l.transContains(2));
+        l.transInsert(100);
+        TestTransaction t2(2);
+        assert(l.transInsert(1));
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConflicts() {
+    list_type l;
+    for (int i = 0; i < 10; i += 2)
+        l.insert(i);
+    {
+        // an absent element that appears fails the reader
+        TestTransaction t1(1);
+        assert(!l.transContains(5));
+        l.transInsert(100);
+        TestTransaction t2(2);
+        assert(l.transInsert(5));
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // a deleted element fails the reader
+        TestTransaction t1(1);
+        assert(l.transContains(4));
+        l.transInsert(101);
+        TestTransaction t2(2);
+        assert(l.transDelete(4));
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // size readers see every change
+        TestTransaction t1(1);
+        size_t n = l.size();
+        assert(n == 5);
+        l.transInsert(102);
+        TestTransaction t2(2);
+        assert(l.transInsert(11));
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // another transaction's phantom aborts a lookup
+        TestTransaction t1(1);
+        assert(l.transInsert(13));
+        TestTransaction t2(2);
+        try {
+            l.transContains(13);
+            assert(false);
+        } catch (Transaction::Abort&) {
+        }
+        t1.use();
+        assert(t1.try_commit());
+    }
+    assert(l.nontrans_contains(13));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testIter() {
+    list_type l;
+    for (int i = 0; i < 10; ++i)
+        l.insert(i);
+    TRANSACTION_E {
+        l.transDelete(4);
+        l.transInsert(20);
+        int expected[] = {0, 1, 2, 3, 5, 6, 7, 8, 9, 20};
+        int n = 0;
+        for (auto it = l.begin(); it != l.end(); ++it)
+            assert(*it == expected[n++]);
+        assert(n == 10);
+    } RETRY_E(false);
+    {
+        // a scan conflicts with inserts into the range it covered...
+        TestTransaction t1(1);
+        auto it = l.begin();
+        ++it;
+        assert(*it == 1);
+        l.transInsert(200);
+        TestTransaction t2(2);
+        assert(l.transInsert(-1));
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // ...but not past it
+        TestTransaction t1(1);
+        auto it = l.begin();
+        ++it;
+        assert(*it == 0);
+        l.transInsert(201);
+        TestTransaction t2(2);
+        assert(l.transInsert(15));
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads insert and delete interleaved elements, checking each other's
+void testConcurrent() {
+    constexpr int nthreads = 4;
+    constexpr int nelems = 2000;
+    list_type l;
+
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        for (int i = 0; i != nelems; ++i) {
+            int e = i * nthreads + me;
+            TRANSACTION_E {
+                assert(l.transInsert(e));
+                if (i)
+                    assert(l.transContains(e - nthreads));
+                if (i % 2)
+                    assert(l.transDelete(e - nthreads));
+            } RETRY_E(true);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+    TThread::set_id(0);
+
+    for (int i = 0; i != nelems; ++i)
+        for (int me = 0; me != nthreads; ++me)
+            assert(l.nontrans_contains(i * nthreads + me) == (i % 2 == 1));
+    size_t n = 0;
+    TRANSACTION_E {
+        n = 0;
+        for (auto it = l.begin(); it != l.end(); ++it)
+            ++n;
+        assert(n == l.size());
+    } RETRY_E(false);
+    assert(n == l.nontrans_size());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSimple();
+    testOwnWrites();
+    testAbortedInsert();
+    testDisjointWriters();
+    testConflicts();
+    testIter();
+    testConcurrent();
+    return 0;
+}
@@ -535,7 +535,11 @@ void MVCCIndexTester<Ordered>::ScanTest() {
             TestTransaction t1(1);
             t1.get_tx().mvcc_rw_upgrade();
 
-            idx.insert_row(new_key, &new_value);
+            {
+                auto [success, found] = idx.insert_row(new_key, &new_value);
+                assert(success);
+                assert(!found);
+            }
 
             TestTransaction t2(2);
             t2.get_tx().mvcc_rw_upgrade();
@@ -652,7 +656,11 @@ void MVCCIndexTester<Ordered>::InsertTest() {
         TestTransaction t1(1);
         t1.get_tx().mvcc_rw_upgrade();
 
-        idx.insert_row(new_key, &new_value);
+        {
+            auto [success, found] = idx.insert_row(new_key, &new_value);
+            assert(success);
+            assert(!found);
+        }
 
         TestTransaction t2(2);
         t2.get_tx().mvcc_rw_upgrade();
@@ -0,0 +1,188 @@
+#undef NDEBUG
+#define MVCC_SPARSE_DELTAS 4
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TMvBox.hh"
+
+struct wide_row {
+    static constexpr int ncols = 32;
+    int64_t f[ncols];
+
+    bool operator==(const wide_row& other) const {
+        return memcmp(f, other.f, sizeof(f)) == 0;
+    }
+};
+
+std::ostream& operator<<(std::ostream& w, const wide_row& r) {
+    return w << "wide_row{" << r.f[0] << ", ..., " << r.f[wide_row::ncols - 1] << "}";
+}
+
+typedef TMvBox<wide_row> box_type;
+typedef MvHistory<wide_row> history_type;
+static_assert(history_type::sparse_limit == 4, "wide_row gets sparse deltas");
+
+static wide_row initial_row() {
+    wide_row r;
+    for (int i = 0; i != wide_row::ncols; ++i)
+        r.f[i] = i;
+    return r;
+}
+
+// The row after n bumps, the kth of which incremented column k % 8 and
+// the last column
+static wide_row bumped_row(int n) {
+    wide_row r = initial_row();
+    for (int k = 0; k != n; ++k) {
+        ++r.f[k % 8];
+        ++r.f[wide_row::ncols - 1];
+    }
+    return r;
+}
+
+static void bump(box_type& box, int k) {
+    TestTransaction t(0);
+    Sto::mvcc_rw_upgrade();
+    wide_row r = box;
+    ++r.f[k % 8];
+    ++r.f[wide_row::ncols - 1];
+    box = r;
+    assert(t.try_commit());
+}
+
+void testSparseVersions() {
+    static box_type box;
+    box.nontrans_write(initial_row());
+    for (int k = 0; k != 10; ++k)
+        bump(box, k);
+
+    // Read-modify-writes make runs of 4 sparse deltas between full
+    // versions, and every version reads back whole, in transactions and
+    // outside them
+    TestTransaction t(0);
+    Sto::mvcc_rw_upgrade();
+    history_type* h = TMvBoxAccess::head(box);
+    for (int n = 10; n >= 0; --n, h = h->prev()) {
+        assert(h && h->status_is(COMMITTED));
+        assert(h->sparse_depth() == unsigned(n % 5));
+        assert(TMvBoxAccess::find(box, h->wtid()) == h);
+        assert(h->v() == bumped_row(n));
+    }
+    assert(t.try_commit());
+
+    assert(box.nontrans_read() == bumped_row(10));
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSparseReads() {
+    static box_type box;
+    box.nontrans_write(initial_row());
+    bump(box, 0);
+    bump(box, 1);
+
+    // An older snapshot reads a sparse delta while newer ones pile up
+    TestTransaction t1(1);
+    wide_row r1 = box;
+    assert(r1 == bumped_row(2));
+
+    bump(box, 2);
+    bump(box, 3);
+
+    t1.use();
+    r1 = box;
+    assert(r1 == bumped_row(2));
+    assert(t1.try_commit());
+
+    // A blind write is a full version
+    {
+        TestTransaction t(0);
+        Sto::mvcc_rw_upgrade();
+        box = bumped_row(4);
+        assert(t.try_commit());
+    }
+    {
+        TestTransaction t(0);
+        Sto::mvcc_rw_upgrade();
+        assert(TMvBoxAccess::head(box)->sparse_depth() == 0);
+        assert(t.try_commit());
+    }
+    bump(box, 4);
+    assert(box.nontrans_read() == bumped_row(5));
+
+    // Nontransactional writes to a sparse head go to a full copy of it
+    {
+        wide_row& r = box.nontrans_access();
+        assert(r == bumped_row(5));
+        ++r.f[0];
+    }
+    wide_row expected = bumped_row(5);
+    ++expected.f[0];
+    assert(box.nontrans_read() == expected);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSparseConcurrent() {
+    static constexpr int nwriters = 4;
+    static constexpr int bumps_per_writer = 20000;
+    static box_type box;
+    box.nontrans_write(initial_row());
+    std::atomic<bool> stop = false;
+
+    std::thread advancer(&Transaction::epoch_advancer, nullptr);
+    advancer.detach();
+
+    // Writers bump their own columns; every snapshot has as many bumps of
+    // the last column as of the others
+    std::vector<std::thread> thrs;
+    for (int w = 0; w != nwriters; ++w)
+        thrs.emplace_back([&, w] {
+                TThread::set_id(w);
+                for (int n = 0; n != bumps_per_writer; ++n) {
+                    RWTRANSACTION_E {
+                        wide_row r = box;
+                        ++r.f[w];
+                        ++r.f[wide_row::ncols - 1];
+                        box = r;
+                    } RETRY_E(true);
+                }
+            });
+    thrs.emplace_back([&] {
+            TThread::set_id(nwriters);
+            while (!stop.load()) {
+                TRANSACTION_E {
+                    wide_row r = box;
+                    int64_t bumps = 0;
+                    for (int w = 0; w != nwriters; ++w)
+                        bumps += r.f[w] - w;
+                    assert(bumps == r.f[wide_row::ncols - 1] - (wide_row::ncols - 1));
+                } RETRY_E(true);
+            }
+        });
+    for (int w = 0; w != nwriters; ++w)
+        thrs[w].join();
+    stop.store(true);
+    thrs.back().join();
+
+    wide_row r = box.nontrans_read();
+    for (int w = 0; w != nwriters; ++w)
+        assert(r.f[w] == w + bumps_per_writer);
+    assert(r.f[wide_row::ncols - 1] == wide_row::ncols - 1 + nwriters * bumps_per_writer);
+
+    Transaction::epoch_advance_once();
+    Transaction::epoch_advance_once();
+    Transaction::rcu_release_all(advancer, nwriters + 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSparseVersions();
+    testSparseReads();
+    testSparseConcurrent();
+    return 0;
+}
@@ -1,3 +1,5 @@
+#undef NDEBUG
+#include <cassert>
 #include <iostream>
 #include <sstream>
 #include <thread>
@@ -61,7 +63,40 @@ void array_init(array_type& arr) {
         arr.nontrans_put(i, 0);
 }
 
+// Reads of versions newer than the snapshot extend it, up to the limit
+void extension_limit() {
+    TBox<int> a, b, c;
+    Transaction::set_opacity_extension_limit(1);
+    {
+        TestTransaction t1(1);
+        int x = a;
+        TestTransaction t2(2);
+        b = 1;
+        c = 1;
+        assert(t2.try_commit());
+        t1.use();
+        int y = b;  // first extension
+        assert(x == 0 && y == 1);
+        TestTransaction t3(3);
+        c = 2;
+        assert(t3.try_commit());
+        t1.use();
+        bool aborted = false;
+        try {
+            int z = c;  // over the limit
+            (void) z;
+        } catch (Transaction::Abort e) {
+            aborted = true;
+        }
+        assert(aborted);
+    }
+    Transaction::set_opacity_extension_limit(0);
+    std::cout << "extension limit passed." << std::endl;
+}
+
 int main() {
+    extension_limit();
+
     array_type arr;
     array_init(arr);
 
@@ -0,0 +1,86 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include "Sto.hh"
+#include "TBox.hh"
+
+void testOff() {
+    TThread::set_id(0);
+    Transaction::clear_stats();
+    PhaseProfile::set_sample_period(0);
+    TBox<int> box;
+    for (int i = 0; i != 10; ++i) {
+        TRANSACTION_E {
+            box = box + 1;
+        } RETRY_E(true);
+    }
+    for (int p = 0; p != ph_count; ++p)
+        assert(PhaseProfile::combined(p).samples == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testEveryAttempt() {
+    TThread::set_id(0);
+    Transaction::clear_stats();
+    PhaseProfile::set_sample_period(1);
+    TBox<int> box;
+    for (int i = 0; i != 10; ++i) {
+        TRANSACTION_E {
+            box = box + 1;
+        } RETRY_E(true);
+    }
+    PhaseProfile::set_sample_period(0);
+
+    auto ex = PhaseProfile::combined(ph_execute);
+    assert(ex.samples >= 10);
+    assert(ex.ticks > 0 && ex.p50 <= ex.p99 && ex.p99 <= ex.max);
+    assert(PhaseProfile::combined(ph_commit_install).ticks > 0);
+    assert(PhaseProfile::combined(ph_cleanup).ticks > 0);
+    // every attempt counts in every per-attempt phase, waits or not
+    assert(PhaseProfile::combined(ph_lock_spin).samples == ex.samples);
+    assert(PhaseProfile::combined(ph_mvcc_flatten).samples == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSampling() {
+    TThread::set_id(0);
+    Transaction::clear_stats();
+    PhaseProfile::set_sample_period(4);
+    TBox<int> box;
+    for (int i = 0; i != 40; ++i) {
+        TRANSACTION_E {
+            box = box + 1;
+        } RETRY_E(true);
+    }
+    PhaseProfile::set_sample_period(0);
+    auto ex = PhaseProfile::combined(ph_execute);
+    assert(ex.samples >= 10 && ex.samples <= 11);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbortedCommit() {
+    Transaction::clear_stats();
+    PhaseProfile::set_sample_period(1);
+    TBox<int> box;
+    {
+        TestTransaction t1(1);
+        box = box + 1;
+        TestTransaction t2(2);
+        box = 5;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    PhaseProfile::set_sample_period(0);
+    // the aborted attempt timed its lock and check phases, not install
+    assert(PhaseProfile::combined(ph_commit_check).ticks > 0);
+    assert(PhaseProfile::combined(ph_execute).samples == 2);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testOff();
+    testEveryAttempt();
+    testSampling();
+    testAbortedCommit();
+    return 0;
+}
@@ -0,0 +1,105 @@
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Sto.hh"
+#include "TMvBox.hh"
+#include "HugeArena.hh"
+
+static std::string heap_path;
+
+void testSelect() {
+    assert(!HugeArena::select("pmem:/nonexistent/dir/heap"));
+    char path[] = "/tmp/sto-pmem-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    heap_path = path;
+    // selected before anything below allocates table memory
+    assert(HugeArena::select(("pmem:" + heap_path).c_str()));
+    assert(HugeArena::enabled() && HugeArena::persistent());
+    assert(strcmp(HugeArena::selected(), "pmem") == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testFileBacked() {
+    // objects live in the heap file: what they hold is in the file
+    auto p = static_cast<uint64_t*>(HugeArena::allocate(64));
+    p[0] = 0x5354'4f50'4d45'4d21;
+    struct stat st;
+    assert(stat(heap_path.c_str(), &st) == 0 && size_t(st.st_size) >= HugeArena::slab_size);
+    int fd = open(heap_path.c_str(), O_RDONLY);
+    assert(fd >= 0);
+    std::vector<uint64_t> words(HugeArena::slab_size / sizeof(uint64_t));
+    assert(pread(fd, words.data(), HugeArena::slab_size, 0) == ssize_t(HugeArena::slab_size));
+    close(fd);
+    assert(std::find(words.begin(), words.end(), p[0]) != words.end());
+    assert(HugeArena::mapped_bytes() >= HugeArena::slab_size);
+    HugeArena::release(p, 64);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testCommits() {
+    // commits go through the persistent install
+    static TMvBox<int64_t> box;
+    for (int64_t i = 1; i <= 1000; ++i) {
+        TRANSACTION_E {
+            box = box + 1;
+        } RETRY_E(false);
+        if (i % 100 == 0)
+            Transaction::epoch_advance_once();
+    }
+    TransactionGuard t;
+    int64_t v = box;
+    assert(v == 1000);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRecoverVersions() {
+    typedef MvObject<int> object_type;
+    auto obj = new object_type(1);
+    // cp_lock looks up the isolation level of the running transaction
+    TransactionGuard guard;
+
+    // a version still pending at the head never committed
+    auto h = obj->new_history(100, 2);
+    assert(obj->cp_lock(100, h));
+    assert(obj->head() == h);
+    assert(obj->recover_versions() == 1);
+    assert(obj->head()->status_is(COMMITTED) && obj->nontrans_access() == 1);
+
+    // one pending below a committed version is aborted in place
+    auto h2 = obj->new_history(200, 3);
+    assert(obj->cp_lock(200, h2));
+    auto h3 = obj->new_history(300, 4);
+    assert(obj->cp_lock(300, h3));
+    obj->cp_install(h3);
+    assert(obj->recover_versions() == 1);
+    assert(obj->head() == h3 && h2->status_is(ABORTED));
+    assert(obj->find(250, false)->v() == 1);
+    assert(obj->find(300, false)->v() == 4);
+
+    // nothing left to repair
+    assert(obj->recover_versions() == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testSelect();
+    testFileBacked();
+    testCommits();
+    testRecoverVersions();
+
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 8);
+    unlink(heap_path.c_str());
+    return 0;
+}
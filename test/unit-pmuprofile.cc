@@ -0,0 +1,74 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include "Sto.hh"
+#include "TBox.hh"
+
+static const unsigned pmu_test_loop = PmuProfile::add_phase("test_loop");
+
+void testPhases() {
+    assert(PmuProfile::num_phases() > unsigned(tc_count));
+    assert(strcmp(PmuProfile::phase_name(tc_commit), "tc_commit") == 0);
+    assert(strcmp(PmuProfile::phase_name(tc_elapsed), "tc_elapsed") == 0);
+    assert(pmu_test_loop >= unsigned(tc_count));
+    assert(PmuProfile::add_phase("test_loop") == pmu_test_loop);
+    assert(strcmp(PmuProfile::phase_name(pmu_test_loop), "test_loop") == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAccount() {
+    TThread::set_id(0);
+    PmuProfile::clear();
+    PmuProfile::sample a = {{100, 200, 3, 4}};
+    PmuProfile::sample b = {{150, 300, 5, 4}};
+    PmuProfile::account(pmu_test_loop, a, b);
+    TThread::set_id(1);
+    PmuProfile::account(pmu_test_loop, a, b);
+    TThread::set_id(0);
+
+    auto t = PmuProfile::combined(pmu_test_loop);
+    assert(t.calls == 2);
+    assert(t.v[PmuProfile::pmu_cycles] == 100);
+    assert(t.v[PmuProfile::pmu_instructions] == 200);
+    assert(t.v[PmuProfile::pmu_llc_misses] == 4);
+    assert(t.v[PmuProfile::pmu_dtlb_misses] == 0);
+    Transaction::clear_stats();
+    assert(PmuProfile::combined(pmu_test_loop).calls == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testScope() {
+    TThread::set_id(0);
+    PmuProfile::clear();
+    {
+        // disabled: nothing recorded
+        PmuProfile::scope s(pmu_test_loop);
+    }
+    assert(PmuProfile::combined(pmu_test_loop).calls == 0);
+
+    if (!PmuProfile::enable()) {
+        printf("SKIP: %s (no perf_event_open access)\n", __FUNCTION__);
+        return;
+    }
+    volatile uint64_t x = 0;
+    {
+        PmuProfile::scope s(pmu_test_loop);
+        for (int i = 0; i != 1000000; ++i)
+            x = x + i;
+    }
+    PmuProfile::disable();
+    auto t = PmuProfile::combined(pmu_test_loop);
+    assert(t.calls == 1);
+    assert(t.v[PmuProfile::pmu_instructions] > 1000000);
+    assert(t.v[PmuProfile::pmu_cycles] > 0);
+    PmuProfile::report(stdout);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testPhases();
+    testAccount();
+    testScope();
+    return 0;
+}
@@ -36,17 +36,74 @@ void* tracker_run(void* argument) {
     return nullptr;
 }
 
+static unsigned ncalled;
+static void count_cb(void*) {
+    ++ncalled;
+}
+
+// Bounded cleaning runs at most the budget inline and hands off whole
+// expired groups
+void test_bounded_clean() {
+    TRcuSet set;
+    for (unsigned i = 0; i != 2000; ++i)
+        set.add(1 + i / 100, count_cb, nullptr);
+    always_assert(set.backlog() == 2000, "bounded clean");
+
+    // nothing has expired yet
+    always_assert(set.clean_until(1, 10) == 0 && ncalled == 0, "bounded clean");
+    size_t handed_off = set.clean_until(11, 10);
+    always_assert(ncalled == 10, "bounded clean");
+    always_assert(handed_off > 0 && handed_off == TRcuSet::orphan_backlog(), "bounded clean");
+    always_assert(set.backlog() + handed_off == 1990, "bounded clean");
+    always_assert(TRcuSet::run_orphans(~size_t(0)) == handed_off, "bounded clean");
+    always_assert(TRcuSet::orphan_backlog() == 0, "bounded clean");
+
+    // the rest of epochs 1-10 drains 10 at a time; later epochs stay
+    while (set.backlog() > 1000)
+        set.clean_until(11, 10);
+    always_assert(ncalled == 1000 && set.backlog() == 1000, "bounded clean");
+    set.clean_until(21);
+    always_assert(ncalled == 2000 && set.empty(), "bounded clean");
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Typed callbacks go to a lane and keep their epochs
+void test_lanes() {
+    ncalled = 0;
+    TRcuSet set;
+    static long cells[1200];
+    for (unsigned i = 0; i != 1200; ++i) {
+        if (i % 3)
+            set.add<count_cb>(1 + i / 100, &cells[i]);
+        else
+            set.add(1 + i / 100, count_cb, &cells[i]);
+    }
+    always_assert(set.backlog() == 1200, "lanes");
+    set.clean_until(6);
+    always_assert(ncalled == 500 && set.backlog() == 700, "lanes");
+    // bounded cleaning stops partway through a lane run
+    set.clean_until(11, 250);
+    always_assert(ncalled == 750 && !set.empty(), "lanes");
+    set.clean_until(11, 250);
+    always_assert(ncalled == 1000 && set.backlog() == 200, "lanes");
+    set.clean_until(13);
+    always_assert(ncalled == 1200 && set.empty(), "lanes");
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 
 static const Clp_Option options[] = {
     { "delay", 'd', 'd', Clp_ValDouble, Clp_Negate },
     { "nthreads", 'j', 'j', Clp_ValInt, 0 },
-    { "nepochs", 'e', 'e', Clp_ValInt, 0 }
+    { "nepochs", 'e', 'e', Clp_ValInt, 0 },
+    { "adaptive", 'a', 'a', Clp_NoVal, Clp_Negate }
 };
 
 int main(int argc, char* argv[]) {
     unsigned nthreads = 4;
     TRcuSet::epoch_type nepochs = 1000;
     delay = 0.000001;
+    bool adaptive = false;
 
     Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
     int opt;
@@ -61,12 +118,18 @@ int main(int argc, char* argv[]) {
         case 'e':
             nepochs = clp->val.i;
             break;
+        case 'a':
+            adaptive = !clp->negated;
+            break;
         default:
             abort();
         }
     }
     Clp_DeleteParser(clp);
 
+    test_bounded_clean();
+    test_lanes();
+
     if (nthreads > MAX_THREADS) {
         printf("Asked for %d threads but MAX_THREADS is %d\n", nthreads, MAX_THREADS);
         exit(1);
@@ -76,6 +139,8 @@ int main(int argc, char* argv[]) {
     for (uintptr_t i = 0; i < nthreads; ++i)
         pthread_create(&tids[i], NULL, tracker_run, reinterpret_cast<void*>(i));
     Transaction::set_epoch_cycle(1000);
+    if (adaptive)
+        Transaction::set_adaptive_epoch_cycle(100, 10000, 64);
     auto advancer = std::thread(&Transaction::epoch_advancer, nullptr);
 
     while (Transaction::global_epochs.global_epoch < nepochs + 1)
@@ -89,11 +154,24 @@ int main(int argc, char* argv[]) {
     Transaction::rcu_release_all(advancer, nthreads);
 
     auto nfreed_before = nfreed;
+    always_assert(Transaction::rcu_backlog() == nallocated - nfreed_before, "rcu backlog");
     for (unsigned i = 0; i < nthreads; ++i)
         Transaction::tinfo[i].rcu_set.~TRcuSet();
 
     always_assert(nallocated == nfreed, "rcu check");
     always_assert(nfreed_before > 0, "rcu check");
+
+    // epoch scans visit exactly the registered tracker threads
+    auto count_trackers = [&] () {
+        unsigned n = 0;
+        TThread::for_each_active([&] (int id) {
+            n += unsigned(id) < nthreads;
+        });
+        return n;
+    };
+    always_assert(count_trackers() == nthreads, "active threads");
+    TThread::unregister_id(0);
+    always_assert(count_trackers() == nthreads - 1, "active threads");
     printf("created %" PRIu64 ", deleted %" PRIu64 ", finally deleted %" PRIu64 "\n", nallocated, nfreed_before, nfreed);
     printf("Test pass.\n");
     return 0;
@@ -0,0 +1,162 @@
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "TMvBox.hh"
+#include "LogReplica.hh"
+
+static std::string make_dir() {
+    char path[] = "/tmp/sto-replica-XXXXXX";
+    assert(mkdtemp(path));
+    return path;
+}
+
+static void remove_dir(const std::string& dir) {
+    std::string cmd = "rm -rf " + dir;
+    assert(system(cmd.c_str()) == 0);
+}
+
+// Primary threads 0-1 move amounts between logged boxes; the replica
+// applies the shipped log to MVCC boxes with threads 4-5, one write per
+// transaction, while thread 6 checks, in read-only transactions, that
+// every snapshot it reads keeps the total. The log is compressed if
+// compressed is set.
+void testReplicate(bool compressed) {
+    constexpr int nthreads = 2;
+    constexpr int nboxes = 16;
+    constexpr int ntxns = 3000;
+    constexpr int64_t initial = 1000;
+    std::string dir = make_dir();
+    std::vector<TBox<int64_t>> primary(nboxes);
+    std::vector<TMvBox<int64_t>> replica(nboxes);
+    for (int i = 0; i < nboxes; ++i) {
+        primary[i].nontrans_write(initial);
+        primary[i].set_log_id(i + 1);
+        replica[i].nontrans_write(initial);
+    }
+
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    TThread::set_id(0);
+    TxnLog::set_compression(compressed);
+    assert(TxnLog::start(dir.c_str(), 2));
+    TxnLog::start_shipping(fds[0]);
+    LogReplica rep(fds[1], 2, 4, [&](const TxnLog::record& r, int) {
+            assert(r.keylen == 0 && r.vallen == sizeof(int64_t));
+            replica[r.object_id - 1] = *reinterpret_cast<const int64_t*>(r.value);
+        }, 1);
+    rep.start();
+
+    std::atomic<bool> done(false);
+    std::atomic<int> snapshots(0);
+    std::thread reader([&] {
+        TThread::set_id(6);
+        while (!done || snapshots < 10) {
+            int64_t total = 0;
+            ROTRANSACTION_E {
+                total = 0;
+                for (auto& b : replica)
+                    total += b;
+            } RETRY_E(true);
+            assert(total == initial * nboxes);
+            ++snapshots;
+        }
+    });
+    std::thread advancer([&] {
+        while (!done) {
+            Transaction::global_epoch_advance_once();
+            usleep(1000);
+        }
+    });
+    std::vector<std::thread> workers;
+    for (int t = 0; t < nthreads; ++t)
+        workers.emplace_back([&, t] {
+            TThread::set_id(t);
+            for (int i = 0; i < ntxns; ++i) {
+                int from = (i * 7 + t) % nboxes, to = (i * 3 + t + 1) % nboxes;
+                if (from == to)
+                    continue;
+                TRANSACTION_E {
+                    primary[from] = primary[from] - 1;
+                    primary[to] = primary[to] + 1;
+                } RETRY_E(true);
+            }
+            TxnLog::flush_thread();
+        });
+    for (auto& w : workers)
+        w.join();
+
+    // the replica catches up while the primary is still running
+    TThread::set_id(0);
+    TxnLog::epoch_type e = std::max(TxnLog::last_epoch(), Transaction::global_epochs.global_epoch.load() - 1);
+    while (rep.applied_epoch() < e)
+        usleep(1000);
+    done = true;
+    advancer.join();
+    reader.join();
+    TThread::set_id(0);
+    TxnLog::stop();
+    assert(rep.join());
+    for (int i = 0; i < nboxes; ++i)
+        assert(replica[i].nontrans_read() == primary[i].nontrans_read());
+
+    auto s = rep.statistics();
+    assert(s.lag_tids == 0 && s.applied_tid == s.received_tid);
+    assert(s.records > 0 && s.batches > 0 && s.bytes == TxnLog::sent_bytes());
+    assert(TxnLog::sent_bytes() == TxnLog::shipped_bytes());
+    assert(snapshots >= 10);
+    if (compressed)
+        assert(TxnLog::written_bytes() < TxnLog::logged_bytes());
+    TxnLog::set_compression(false);
+    close(fds[0]);
+    close(fds[1]);
+    remove_dir(dir);
+    printf("PASS: %s%s\n", __FUNCTION__, compressed ? " (compressed)" : "");
+}
+
+void testReplicaGone() {
+    // a replica that hangs up stops shipping, not logging
+    std::string dir = make_dir();
+    TBox<int> a;
+    a.set_log_id(1);
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    TThread::set_id(0);
+    assert(TxnLog::start(dir.c_str(), 1));
+    TxnLog::start_shipping(fds[0]);
+    close(fds[1]);
+    for (int i = 0; i < 100; ++i) {
+        TRANSACTION_E {
+            a = i;
+        } RETRY_E(false);
+        Transaction::global_epoch_advance_once();
+    }
+    TxnLog::stop();
+    int value = -1;
+    TxnLog::recover(dir.c_str(), [&](const TxnLog::record& r) {
+            value = *reinterpret_cast<const int*>(r.value);
+        });
+    assert(value == 99);
+    assert(TxnLog::sent_bytes() < TxnLog::shipped_bytes());
+    close(fds[0]);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testReplicate(false);
+    if (TxnLog::set_compression(true))
+        testReplicate(true);
+    testReplicaGone();
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 8);
+    return 0;
+}
@@ -1,9 +1,14 @@
+#undef NDEBUG
+#include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
+#include <vector>
 #include "sampling.hh"
 
 using namespace sampling;
 
-int main() {
+void printZipf() {
     // testing a zipf distribution, generating numbers between 1 and 1000 with theta=0.8
     StoRandomDistribution<>::rng_type rng(1/*seed*/);
     StoRandomDistribution<> *dist = new StoZipfDistribution<>(rng /*generator*/, 1 /*low*/, 1000 /*high*/, 0.8 /*skew*/);
@@ -13,6 +18,117 @@ int main() {
     std::cout << std::endl;
 
     delete dist;
+}
+
+void testXoshiro() {
+    xoshiro256ss a(7), b(7), c(8);
+    bool differs = false;
+    for (int i = 0; i != 100; ++i) {
+        uint64_t x = a();
+        assert(x == b());
+        differs |= (x != c());
+    }
+    assert(differs);
+    for (int i = 0; i != 100000; ++i) {
+        assert(a.below(10) < 10);
+        double u = a.uniform();
+        assert(u >= 0 && u < 1);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testZipfRejection() {
+    // frequencies follow the pmf StoZipfDistribution uses
+    for (double skew : {0.5, 0.8, 0.99, 1.0, 1.2}) {
+        const int n = 100, nsamples = 1000000;
+        StoZipfRejectionSampler<> zipf(5, 5 + n - 1, skew);
+        xoshiro256ss rng(65);
+        std::vector<int> counts(n, 0);
+        for (int i = 0; i != nsamples; ++i) {
+            auto k = zipf.sample(rng);
+            assert(k >= 5 && k < 5 + n);
+            ++counts[k - 5];
+        }
+        double sum = 0;
+        for (int i = 1; i <= n; ++i)
+            sum += 1 / std::pow(i, skew);
+        for (int i : {0, 1, 9, n - 1}) {
+            double expected = nsamples / std::pow(i + 1, skew) / sum;
+            assert(std::abs(counts[i] - expected) < 5 * std::sqrt(expected) + 1);
+        }
+    }
+
+    // large ranges need no table
+    StoZipfRejectionSampler<uint32_t> big(0, 9999999, 0.99);
+    xoshiro256ss rng(66);
+    uint64_t zeros = 0;
+    for (int i = 0; i != 100000; ++i) {
+        uint32_t k = big.sample(rng);
+        assert(k <= 9999999);
+        zeros += (k == 0);
+    }
+    assert(zeros > 3000 && zeros < 8000);
+    printf("PASS: %s\n", __FUNCTION__);
+}
 
+void testAliasTable() {
+    // frequencies follow the weights, zero weights never come up, and a
+    // 32-bit generator works as well as a 64-bit one
+    weight_type pmf = {1, 0, 2, 7, 0.5, 9.5, 0, 30};
+    double sum = 50;
+    AliasTable table(pmf);
+    assert(table.size() == pmf.size());
+    const int nsamples = 1000000;
+    std::vector<int> counts(pmf.size(), 0);
+    xoshiro256ss rng(67);
+    std::mt19937 mt(67);
+    for (int i = 0; i != nsamples; ++i) {
+        ++counts[table.sample(rng)];
+        ++counts[table.sample(mt)];
+    }
+    for (size_t i = 0; i != pmf.size(); ++i) {
+        double expected = 2 * nsamples * pmf[i] / sum;
+        if (pmf[i] == 0)
+            assert(counts[i] == 0);
+        else
+            assert(std::abs(counts[i] - expected) < 5 * std::sqrt(expected) + 1);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDistributions() {
+    // the same seed gives the same samples
+    typedef StoRandomDistribution<>::rng_type rng_type;
+    rng_type r1(3), r2(3);
+    StoZipfDistribution<> z1(r1, 10, 100009, 0.99), z2(r2, 10, 100009, 0.99);
+    uint64_t tens = 0;
+    for (int i = 0; i != 100000; ++i) {
+        auto k = z1.sample();
+        assert(k == z2.sample() && k >= 10 && k <= 100009);
+        tens += (k == 10);
+    }
+    // about 1/H(100000, 0.99) of the samples, where H is about 12.5
+    assert(tens > 7000 && tens < 9000);
+
+    typedef StoCustomDistribution<char> cdist_type;
+    cdist_type::histogram_type hist = {{'a', 1}, {'b', 0}, {'c', 3}};
+    rng_type r3(4), r4(4);
+    cdist_type c1(r3, hist), c2(r4, hist);
+    int as = 0;
+    for (int i = 0; i != 100000; ++i) {
+        char c = c1.sample();
+        assert(c == c2.sample() && c != 'b');
+        as += (c == 'a');
+    }
+    assert(as > 24000 && as < 26000);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    printZipf();
+    testXoshiro();
+    testZipfRejection();
+    testAliasTable();
+    testDistributions();
     return 0;
 }
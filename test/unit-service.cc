@@ -0,0 +1,109 @@
+#undef NDEBUG
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sched.h>
+#include <thread>
+#include <time.h>
+#include "Sto.hh"
+#include "ServiceThreads.hh"
+
+static double thread_cpu_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Burns seconds of this thread's CPU time, however long that takes
+static void spin(double seconds) {
+    double end = thread_cpu_seconds() + seconds;
+    while (thread_cpu_seconds() < end)
+        /* burn CPU */;
+}
+
+static const ServiceThreads::usage* find(const std::vector<ServiceThreads::usage>& us, const char* role) {
+    for (auto& u : us)
+        if (u.role == role)
+            return &u;
+    return nullptr;
+}
+
+void testAccounting() {
+    // a busy thread and an idle one, both counted while and after running
+    std::atomic<bool> go(false);
+    std::thread busy([&] {
+            ServiceThreads::scope service("busy");
+            spin(0.05);
+            go = true;
+            spin(0.05);
+        });
+    std::thread idle([] {
+            ServiceThreads::scope service("idle");
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        });
+    while (!go)
+        std::this_thread::yield();
+    auto mid = ServiceThreads::usages();
+    auto b = find(mid, "busy");
+    assert(b && b->running && b->cpu_seconds >= 0.02);
+    busy.join();
+    idle.join();
+
+    auto us = ServiceThreads::usages();
+    b = find(us, "busy");
+    auto i = find(us, "idle");
+    assert(b && !b->running && b->cpu_seconds >= 0.05 && b->wall_seconds >= 0.1);
+    assert(i && !i->running && i->cpu_seconds < 0.05 && i->wall_seconds >= 0.1);
+    assert(b->cpu == -1 && i->cpu == -1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testHousekeepingCpus() {
+    // service threads go to housekeeping CPUs, runners to the others
+    int cpu = topo_info.placement.back();
+    assert(!set_housekeeping_cpus("not-a-cpu"));
+    assert(set_housekeeping_cpus(std::to_string(cpu).c_str()));
+    if (topo_info.placement.size() > 1 || topo_info.placement[0] != cpu)
+        for (int c : topo_info.placement)
+            assert(c != cpu);
+    int ran_on = -1;
+    std::thread t([&] {
+            ServiceThreads::scope service("pinned");
+            ran_on = sched_getcpu();
+        });
+    t.join();
+    auto us = ServiceThreads::usages();
+    auto p = find(us, "pinned");
+    assert(p && p->cpu == cpu && ran_on == cpu);
+    assert(set_housekeeping_cpus(""));
+    assert(housekeeping_cpus().empty());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testEpochAdvancer() {
+    Transaction::set_epoch_cycle(1000);
+    std::thread advancer(&Transaction::epoch_advancer, nullptr);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto us = ServiceThreads::usages();
+    auto a = find(us, "epoch advancer");
+    assert(a && a->running);
+    Transaction::rcu_release_all(advancer, 1);
+    us = ServiceThreads::usages();
+    a = find(us, "epoch advancer");
+    assert(a && !a->running);
+    char buf[4096] = {};
+    FILE* f = fmemopen(buf, sizeof(buf), "w");
+    ServiceThreads::report(f);
+    fclose(f);
+    assert(strstr(buf, "$ service epoch advancer: 1 thread, unpinned"));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    discover_topology();
+    testAccounting();
+    testHousekeepingCpus();
+    testEpochAdvancer();
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <assert.h>
 #include <vector>
+#include <thread>
 #include "Transaction.hh"
 #include "SwissTArray.hh"
 #include "TBox.hh"
@@ -92,10 +93,89 @@ void testAbortReleaseLock() {
 	printf("PASS: %s\n", __FUNCTION__);
 }
 
+// Writers lock f[0] and f[1] in opposite orders, so every policy has to
+// resolve lock-wait cycles
+void testContentionPolicies() {
+    for (const char* policy : {"none", "greedy", "karma", "polka"}) {
+        always_assert(ContentionManager::set_policy(policy));
+        SwissTArray<int, 100> f;
+        std::vector<std::thread> threads;
+        for (int i = 0; i != 4; ++i)
+            threads.emplace_back([&f, i] {
+                TThread::set_id(i);
+                for (int n = 0; n != 2000; ++n) {
+                    int x = i & 1;
+                    TRANSACTION_E {
+                        f[x] = f[x] + 1;
+                        f[1 - x] = f[1 - x] + 1;
+                    } RETRY_E(true);
+                }
+            });
+        for (auto& t : threads)
+            t.join();
+        assert(f.nontrans_get(0) == 8000 && f.nontrans_get(1) == 8000);
+    }
+    always_assert(!ContentionManager::set_policy("bogus"));
+    ContentionManager::set_policy("greedy");
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// A higher priority class wins a write-lock conflict either way round
+void testPriorityWins() {
+    TestTransaction t1(1);
+    TestTransaction t2(2);
+    ContentionManager::info(1).priority = TransactionOptions::prio_normal;
+    ContentionManager::info(2).priority = TransactionOptions::prio_high;
+    ContentionManager::info(1).aborted = ContentionManager::info(2).aborted = 0;
+    assert(!ContentionManager::should_abort(2, 1));
+    assert(ContentionManager::info(1).aborted == 1);
+    assert(ContentionManager::should_abort(1, 2));
+    assert(ContentionManager::info(2).aborted == 0);
+    ContentionManager::info(1).aborted = 0;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// A retry loop stops at max_retries or the deadline; options end with it
+void testRetryBudget() {
+    TransactionOptions opts;
+    opts.max_retries = 3;
+    int attempts = 0;
+    Sto::set_options(opts);
+    try {
+        TRANSACTION_E {
+            ++attempts;
+            throw Transaction::Abort();
+        } RETRY_E(true);
+        assert(false);
+    } catch (Transaction::Abort&) {
+    }
+    assert(attempts == 4);
+    assert(Sto::transaction()->options().max_retries == 0);
+
+    opts = TransactionOptions();
+    opts.deadline = read_tsc();
+    attempts = 0;
+    Sto::set_options(opts);
+    try {
+        TRANSACTION_E {
+            ++attempts;
+            throw Transaction::Abort();
+        } RETRY_E(true);
+        assert(false);
+    } catch (Transaction::Abort&) {
+    }
+    assert(attempts == 1);
+    assert(!Sto::transaction()->options().deadline);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 int main() {
     //testSimpleInt();
     testWriteWriteConflict();
     testAbortReleaseLock();
+    testContentionPolicies();
+    testPriorityWins();
+    testRetryBudget();
     std::cout << "Tests finished." << std::endl;
     return 0;
 }
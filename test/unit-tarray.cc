@@ -2,6 +2,8 @@
 #include <string>
 #include <iostream>
 #include <assert.h>
+#include <random>
+#include <thread>
 #include <vector>
 #include "Sto.hh"
 #include "TArray.hh"
@@ -275,6 +277,120 @@ void testNoOpacity1() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testReadOnly1() {
+    TArray<int, 10, TNonopaqueWrapped> f;
+    for (int i = 0; i < 10; i++)
+        f.nontrans_put(i, i);
+
+    {
+        TestTransaction t1(1);
+        t1.get_tx().start_readonly();
+        int x = f[3];
+        assert(x == 3);
+
+        TestTransaction t(2);
+        f[3] = 2;
+        assert(t.try_commit());
+
+        t1.use();
+        x = f[4];
+        assert(x == 4);
+        assert(!t1.try_commit());
+    }
+
+    {
+        int sum = 0;
+        ROTRANSACTION_E {
+            sum = 0;
+            for (int i = 0; i < 10; i++)
+                sum += f[i];
+        } RETRY_E(true);
+        assert(sum == 44);
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSortedLocking1() {
+    TArray<int, 10> f;
+    for (int i = 0; i < 10; i++)
+        f.nontrans_put(i, i);
+
+    {
+        TestTransaction t1(1);
+        t1.get_tx().set_sorted_locking(true);
+        f[7] = f[7] + 1;
+        f[2] = f[2] + 1;
+        f[5] = 0;
+        assert(t1.try_commit());
+    }
+
+    {
+        TestTransaction t1(1);
+        t1.get_tx().set_sorted_locking(true);
+        int x = f[2];
+        f[8] = x;
+
+        TestTransaction t2(2);
+        f[2] = 9;
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    {
+        TransactionGuard t;
+        assert(f[2] == 9 && f[5] == 0 && f[7] == 8 && f[8] == 8);
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testExclusive1() {
+    TArray<int, 10> f;
+    for (int i = 0; i < 10; i++)
+        f.nontrans_put(i, i);
+
+    // an exclusive transaction does not validate its reads: the caller
+    // promised nobody else would write them, so a stale read commits
+    {
+        TestTransaction t1(1);
+        t1.get_tx().set_exclusive(true);
+        int x = f[2];
+        f[8] = x;
+
+        TestTransaction t2(2);
+        f[2] = 9;
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(t1.try_commit());
+    }
+
+    {
+        TransactionGuard t;
+        assert(f[2] == 9 && f[8] == 2);
+    }
+
+    // reset by start()
+    {
+        TestTransaction t1(1);
+        assert(!t1.get_tx().exclusive());
+        int x = f[3];
+        f[7] = x;
+
+        TestTransaction t2(2);
+        f[3] = 0;
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 void benchArray64() {
     TArray<int, 64> a;
     for (int i = 0; i < 64; ++i)
@@ -295,6 +411,112 @@ void benchArray64() {
     printf("NS PER ITER (iter = 1000tx): %g\n", (after - before) * 1.0e9 / niters);
 }
 
+void testRangeRead() {
+    TestArray<int, 100> f;
+    for (int i = 0; i < 100; ++i)
+        f.nontrans_put(i, i);
+    {
+        TransactionGuard t;
+        f[12] = 120;
+        int buf[30];
+        f.transGet_range(0, 30, buf);
+        for (int i = 0; i < 30; ++i)
+            assert(buf[i] == (i == 12 ? 120 : i));
+        // writing inside a range already read is fine
+        f[20] = 200;
+        f.transGet_range(0, 30, buf);
+        assert(buf[20] == 200);
+    }
+    assert(f.nontrans_get(12) == 120 && f.nontrans_get(20) == 200);
+
+    int vals[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    {
+        TransactionGuard t;
+        f.transPut_range(90, 100, vals);
+    }
+    for (int i = 90; i < 100; ++i)
+        assert(f.nontrans_get(i) == i - 90);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRangeConflict() {
+    TestArray<int, 100> f;
+    for (int i = 0; i < 100; ++i)
+        f.nontrans_put(i, i);
+    int buf[50];
+    {
+        TestTransaction t1(1);
+        f.transGet_range(10, 60, buf);
+        f[0] = 1;
+
+        TestTransaction t2(2);
+        f[37] = 0;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // writes outside the range don't conflict
+        TestTransaction t1(1);
+        f.transGet_range(10, 60, buf);
+        f[0] = 2;
+
+        TestTransaction t2(2);
+        f[60] = 0;
+        f[9] = 0;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    {
+        // a range read after a concurrent commit sees a new version
+        TestTransaction t1(1);
+        f.transGet_range(10, 20, buf);
+        f[0] = 3;
+
+        TestTransaction t2(2);
+        f[15] = 15;
+        assert(t2.try_commit());
+
+        t1.use();
+        try {
+            f.transGet_range_throws(10, 20, buf);
+            assert(false && "shouldn't get here");
+        } catch (Transaction::Abort e) {
+        }
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void benchRangeRead() {
+    TArray<int, 1024> a;
+    for (int i = 0; i < 1024; ++i)
+        a.nontrans_put(i, i);
+    const unsigned long niters = 1000;
+    long sum = 0;
+
+    double before = gettime_d();
+    for (unsigned long iter = 0; iter < niters; ++iter) {
+        TRANSACTION_E {
+            for (int i = 0; i < 1024; ++i)
+                sum += a[i];
+            a[0] = 0;
+        } RETRY_E(true);
+    }
+    double middle = gettime_d();
+    for (unsigned long iter = 0; iter < niters; ++iter) {
+        TRANSACTION_E {
+            int buf[1024];
+            a.transGet_range(0, 1024, buf);
+            for (int i = 0; i < 1024; ++i)
+                sum += buf[i];
+            a[0] = 0;
+        } RETRY_E(true);
+    }
+    double after = gettime_d();
+
+    printf("NS PER 1024-ELEMENT READ: %g per element, %g as a range (sum %ld)\n",
+           (middle - before) * 1.0e9 / niters, (after - middle) * 1.0e9 / niters, sum);
+}
+
 void testRWLock1() {
     TArrayAdaptive<int, 10> f;
     for (int i = 0; i < 10; i++)
@@ -339,6 +561,128 @@ void testRWLock1() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+template <typename A>
+static void runHotSlots(A& a, typename A::lock_policy policy, const char* name) {
+    // every transaction reads a few cold slots and increments one slot;
+    // half the increments land on one of two hot slots
+    constexpr int nthreads = 4, ntxns = 20000, nhot = 2;
+    a.set_policy(policy);
+    for (unsigned i = 0; i < a.size(); ++i)
+        a.nontrans_put(i, 0);
+    std::vector<unsigned> aborts(nthreads, 0);
+    std::vector<std::thread> ts;
+    double t0 = gettime_d();
+    for (int tid = 0; tid < nthreads; ++tid)
+        ts.emplace_back([&, tid] {
+                TThread::set_id(tid);
+                std::mt19937 rng(tid + 1);
+                for (int n = 0; n < ntxns; ++n) {
+                    unsigned target = rng() % 2 ? rng() % nhot
+                        : nhot + rng() % (a.size() - nhot);
+                    unsigned reads[3];
+                    for (auto& r : reads)
+                        r = nhot + rng() % (a.size() - nhot);
+                    while (true) {
+                        Sto::start_transaction();
+                        try {
+                            int sum = 0;
+                            for (auto r : reads)
+                                sum += a[r];
+                            (void) sum;
+                            a[target] = a[target] + 1;
+                            if (Sto::try_commit())
+                                break;
+                        } catch (Transaction::Abort&) {
+                            // failed accesses throw without aborting
+                            Sto::silent_abort();
+                        }
+                        ++aborts[tid];
+                    }
+                }
+            });
+    for (auto& t : ts)
+        t.join();
+    double t1 = gettime_d();
+
+    int total = 0;
+    for (unsigned i = 0; i < a.size(); ++i)
+        total += a.nontrans_get(i);
+    assert(total == nthreads * ntxns);
+    unsigned total_aborts = 0;
+    for (auto n : aborts)
+        total_aborts += n;
+    printf("  %-10s %8u aborts, %.0f txn/s\n", name, total_aborts,
+           nthreads * ntxns / (t1 - t0));
+}
+
+void testAdaptivePromote() {
+    static TArrayAdaptive<int, 16> a;
+    for (int i = 0; i < 16; i++)
+        a.nontrans_put(i, i);
+
+    // every round one of the two transactions conflicts on slot 3
+    for (int r = 0; r < 8 && !a.is_hot(3); ++r) {
+        TestTransaction t0(1);
+        int x = a[3];
+        assert(x == 3);
+        try {
+            TestTransaction t1(2);
+            a[3] = 3;
+            t1.try_commit();
+        } catch (Transaction::Abort e) {}
+        t0.try_commit();
+    }
+    assert(a.is_hot(3));
+    assert(!a.is_hot(4));
+
+    // a hot slot is write-locked by the first read...
+    {
+        TestTransaction t0(1);
+        int x = a[3];
+        assert(x == 3);
+        bool aborted = false;
+        try {
+            TestTransaction t1(2);
+            int y = a[3];
+            (void) y;
+        } catch (Transaction::Abort e) {
+            aborted = true;
+        }
+        assert(aborted);
+        assert(t0.try_commit());
+    }
+    // ...which later writes can still upgrade
+    {
+        TestTransaction t0(1);
+        int x = a[3];
+        a[3] = x + 1;
+        assert(a[3] == 4);
+        assert(t0.try_commit());
+    }
+    assert(a.nontrans_get(3) == 4);
+
+    // cold slots are unaffected
+    {
+        TestTransaction t0(1);
+        int x = a[4];
+        TestTransaction t1(2);
+        int y = a[4];
+        assert(x == 4 && y == 4);
+        assert(t1.try_commit());
+        assert(t0.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void benchAdaptiveHotSlots() {
+    using array_type = TArrayAdaptive<int, 1024>;
+    static array_type opt, locked, adaptive;
+    runHotSlots(opt, array_type::lock_policy::optimistic, "optimistic");
+    runHotSlots(locked, array_type::lock_policy::locked, "locked");
+    runHotSlots(adaptive, array_type::lock_policy::adaptive, "adaptive");
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 int main() {
     testSimpleInt();
     testSimpleString();
@@ -351,10 +695,18 @@ int main() {
     testConflictingModifyIter3();
     testOpacity1();
     testNoOpacity1();
+    testReadOnly1();
+    testSortedLocking1();
+    testExclusive1();
     benchArray64();
+    testRangeRead();
+    testRangeConflict();
+    benchRangeRead();
     testRWLock1();
+    testAdaptivePromote();
+    benchAdaptiveHotSlots();
 
     std::thread advancer;  // empty thread because we have no advancer thread
-    Transaction::rcu_release_all(advancer, 2);
+    Transaction::rcu_release_all(advancer, 4);
     return 0;
 }
@@ -0,0 +1,165 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "TBoosted.hh"
+#include "StripedMap.hh"
+
+typedef TBoostedMap<int, int, StripedMap<int, int>> map_type;
+
+void testSimple() {
+    map_type m;
+    {
+        TransactionGuard t;
+        assert(m.transInsert(1, 10));
+        assert(!m.transInsert(1, 11));
+        assert(m.transPut(2, 20) == false);
+        int v;
+        assert(m.transGet(1, v) && v == 10);
+        assert(m.transGet(2, v) && v == 20);
+    }
+    {
+        TransactionGuard t;
+        assert(m.transPut(1, 12));
+        assert(m.transDelete(2));
+        assert(!m.transDelete(2));
+        int v;
+        assert(m.transGet(1, v) && v == 12);
+        assert(!m.transGet(2, v));
+    }
+    assert(m.nontrans_map().size() == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testUndo() {
+    // an abort runs every inverse, newest first
+    map_type m;
+    m.nontrans_map().insert(1, 10);
+    m.nontrans_map().insert(2, 20);
+    {
+        TestTransaction t(1);
+        m.transPut(1, 11);
+        m.transPut(1, 12);
+        m.transDelete(2);
+        m.transInsert(2, 21);
+        m.transInsert(3, 30);
+        t.get_tx().silent_abort();
+    }
+    int v;
+    assert(m.nontrans_map().find(1, v) && v == 10);
+    assert(m.nontrans_map().find(2, v) && v == 20);
+    assert(!m.nontrans_map().find(3, v));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testLockConflict() {
+    map_type m;
+    m.nontrans_map().insert(1, 10);
+    {
+        // readers share a key
+        TestTransaction t1(1);
+        int v;
+        assert(m.transGet(1, v) && v == 10);
+        TestTransaction t2(2);
+        assert(m.transGet(1, v) && v == 10);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    {
+        // a writer excludes other transactions until it ends
+        TestTransaction t1(1);
+        m.transPut(1, 11);
+        bool aborted = false;
+        try {
+            TestTransaction t2(2);
+            int v;
+            m.transGet(1, v);
+        } catch (Transaction::Abort e) {
+            aborted = true;
+        }
+        assert(aborted);
+        t1.use();
+        assert(t1.try_commit());
+    }
+    {
+        TestTransaction t2(2);
+        int v;
+        assert(m.transGet(1, v) && v == 11);
+        assert(t2.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testMixed() {
+    // a boosted map and an OCC box commit or abort together
+    map_type m;
+    TBox<int> box;
+    {
+        TestTransaction t1(1);
+        m.transInsert(5, 50);
+        int x = box;
+        box = x + 1;
+        TestTransaction t2(2);
+        box = 2;
+        assert(t2.try_commit());
+        // box validation fails, so the insert is undone
+        assert(!t1.try_commit());
+    }
+    int v;
+    assert(!m.nontrans_map().find(5, v));
+    assert(box.nontrans_read() == 2);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConcurrentTransfers() {
+    // transfers between accounts keep the total constant
+    constexpr int nthreads = 4, naccounts = 64, ntxns = 20000;
+    map_type m;
+    for (int i = 0; i < naccounts; ++i)
+        m.nontrans_map().insert(i, 100);
+    std::vector<std::thread> ts;
+    for (int tid = 0; tid < nthreads; ++tid)
+        ts.emplace_back([&, tid] {
+                TThread::set_id(tid);
+                unsigned seed = tid + 1;
+                for (int n = 0; n < ntxns; ++n) {
+                    int a = rand_r(&seed) % naccounts;
+                    int b = rand_r(&seed) % naccounts;
+                    TRANSACTION_E {
+                        int va, vb;
+                        bool found = m.transGet(a, va);
+                        assert(found);
+                        m.transPut(a, va - 1);
+                        found = m.transGet(b, vb);
+                        assert(found);
+                        m.transPut(b, vb + 1);
+                    } RETRY_E(true);
+                }
+            });
+    for (auto& t : ts)
+        t.join();
+
+    int total = 0;
+    for (int i = 0; i < naccounts; ++i) {
+        int v;
+        assert(m.nontrans_map().find(i, v));
+        total += v;
+    }
+    assert(total == 100 * naccounts);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSimple();
+    testUndo();
+    testLockConflict();
+    testMixed();
+    testConcurrentTransfers();
+
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 4);
+    return 0;
+}
@@ -1,10 +1,13 @@
 #undef NDEBUG
 #include <string>
 #include <iostream>
+#include <memory>
 #include <cassert>
 #include <vector>
+#include <thread>
 #include "Sto.hh"
 #include "TBox.hh"
+#include "Commutators.hh"
 //XXX disabled string wrapper due to unknown compiler issue
 //#include "StringWrapper.hh"
 
@@ -44,6 +47,27 @@ void testSimpleString() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testEmplaceWrite() {
+    TBox<std::string> f;
+
+    {
+        TransactionGuard t;
+        // filled in the transaction buffer, then moved into the box
+        std::string& w = Sto::item(&f, 0).emplace_write<std::string>(1000, 'x');
+        w.append("y");
+        assert(Sto::item(&f, 0).write_value<std::string>().size() == 1001);
+        Sto::item(&f, 0).emplace_write<std::string>(10, 'z');
+    }
+
+    {
+        TransactionGuard t2;
+        std::string f_read = f;
+        assert(f_read == std::string(10, 'z'));
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 void testConcurrentInt() {
     TBox<int> ib;
     TBox<int> box;
@@ -249,12 +273,518 @@ void testStringWrapper() {
 }
 #endif
 
+// Minimal commutative counter on DeltaCombiner, like TCommuteIntegerBox
+class CombinedCounter : public TObject {
+public:
+    int64_t read() {
+        auto item = Sto::item(this, 0);
+        if (!item.observe(vers_))
+            throw Transaction::Abort();
+        return value_ + item.template write_value<int64_t>(0);
+    }
+    void increment(int64_t d) {
+        auto item = Sto::item(this, 0);
+        item.acquire_write(vers_, item.template write_value<int64_t>(0) + d);
+    }
+    int64_t nontrans_read() const {
+        return value_;
+    }
+
+    bool lock(TransItem& item, Transaction& txn) override {
+        if (item.has_read())
+            return txn.try_lock(item, vers_);
+        for (unsigned n = 0; !combiner_.try_enter(item, vers_); ++n) {
+            if (n == (1U << STO_SPIN_BOUND_WRITE))
+                return false;
+            relax_fence();
+        }
+        return true;
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        return vers_.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        if (item.has_read()) {
+            value_ += item.template write_value<int64_t>();
+            txn.set_version_unlock(vers_, item);
+        } else
+            combiner_.post(commutators::Commutator<int64_t>(item.template write_value<int64_t>()),
+                           vers_.cp_commit_tid(txn));
+    }
+    bool unlock_after_install(TransItem& item) const override {
+        return !item.has_read();
+    }
+    void unlock(TransItem& item) override {
+        if (item.has_read())
+            vers_.cp_unlock(item);
+        else
+            combiner_.leave(item, vers_, value_);
+    }
+
+private:
+    TVersion vers_;
+    int64_t value_ = 0;
+    commutators::DeltaCombiner<TVersion> combiner_;
+};
+
+void testCombinedIncrements() {
+    CombinedCounter c[2];
+
+    {
+        TestTransaction t1(1);
+        int64_t x = c[0].read();
+        c[1].increment(x + 1);
+
+        TestTransaction t2(2);
+        c[0].increment(5);
+        assert(t2.try_commit());
+        // the combined install bumped the version
+        assert(!t1.try_commit());
+    }
+    assert(c[0].nontrans_read() == 5 && c[1].nontrans_read() == 0);
+
+    constexpr int nthreads = 4, ntxns = 2000;
+    std::vector<std::thread> threads;
+    for (int id = 0; id != nthreads; ++id)
+        threads.emplace_back([&c, id] {
+            TThread::set_id(id);
+            for (int n = 0; n != ntxns; ++n) {
+                TRANSACTION_E {
+                    if (id == 0 && n % 8 == 0) {
+                        // read-modify-write takes the version lock itself
+                        int64_t x = c[0].read();
+                        c[0].increment(1);
+                        c[1].increment(-1);
+                        (void) x;
+                    } else {
+                        c[n % 2].increment(1);
+                        c[(n + 1) % 2].increment(1);
+                    }
+                } RETRY_E(true);
+                sched_yield();
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+    assert(c[0].nontrans_read() + c[1].nontrans_read()
+           == 5 + 2 * (nthreads * ntxns - ntxns / 8));
+    assert(c[0].nontrans_read() - c[1].nontrans_read()
+           == 5 + 2 * (ntxns / 8));
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Box whose install keeps the lock, opting in to early unlock and
+// counting how often Transaction asks
+class EarlyUnlockBox : public TObject {
+public:
+    mutable int hooks = 0;
+    int unlocks = 0;
+
+    int read() {
+        auto item = Sto::item(this, 0);
+        if (item.has_write())
+            return item.template write_value<int>();
+        if (!item.observe(vers_))
+            throw Transaction::Abort();
+        return value_;
+    }
+    void write(int x) {
+        Sto::item(this, 0).add_write(x);
+    }
+    int nontrans_read() const {
+        return value_;
+    }
+
+    bool lock(TransItem& item, Transaction& txn) override {
+        return txn.try_lock(item, vers_);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        return vers_.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        value_ = item.template write_value<int>();
+        txn.set_version(vers_);
+    }
+    bool unlock_after_install(TransItem&) const override {
+        ++hooks;
+        return true;
+    }
+    void unlock(TransItem& item) override {
+        ++unlocks;
+        vers_.cp_unlock(item);
+    }
+
+private:
+    TVersion vers_;
+    int value_ = 0;
+};
+
+void testEarlyUnlock() {
+    Transaction::set_early_unlock(true);
+    EarlyUnlockBox b;
+
+    // asked once per committed write, and unlocked only then
+    for (int i = 1; i <= 3; ++i) {
+        TestTransaction t(0);
+        b.write(b.read() + 1);
+        assert(t.try_commit());
+        assert(b.hooks == i && b.unlocks == i);
+    }
+
+    // not asked for a transaction that fails validation
+    {
+        TestTransaction t1(1);
+        b.write(b.read() + 1);
+        TestTransaction t2(2);
+        b.write(10);
+        assert(t2.try_commit());
+        assert(b.hooks == 4 && b.unlocks == 4);
+        assert(!t1.try_commit());
+        assert(b.hooks == 4 && b.unlocks == 5);
+    }
+
+    // nor for one that aborts before commit
+    {
+        TestTransaction t(0);
+        b.write(20);
+        t.get_tx().silent_abort();
+    }
+    assert(b.hooks == 4 && b.nontrans_read() == 10);
+
+    Transaction::set_early_unlock(false);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSmallCommit() {
+    // commits of a box or two still lock and validate every item
+    TBox<int> a, b;
+    {
+        // a read of a box another transaction changed
+        TestTransaction t1(1);
+        b = a + 1;
+        TestTransaction t2(2);
+        a = 5;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // a read-modify-write of a box another transaction changed
+        TestTransaction t1(1);
+        a = a + 1;
+        b = 1;
+        TestTransaction t2(2);
+        a = 6;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(a.nontrans_read() == 6 && b.nontrans_read() == 0);
+    a.nontrans_write(5);
+    {
+        TestTransaction t1(1);
+        a = a + 1;
+        b = b + 1;
+        assert(t1.try_commit());
+    }
+    assert(a.nontrans_read() == 6 && b.nontrans_read() == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDeferredUpdate() {
+    // a blind write filled in at commit from the current value
+    TBox<int> hot, other;
+    hot.nontrans_write(10);
+    int seen = -1;
+    {
+        TestTransaction t1(1);
+        hot = 0;
+        TransItem* item = &Sto::item(&hot, 0).item();
+        TBox<int>* h = &hot;
+        int* out = &seen;
+        Sto::defer_update([item, h, out] {
+            *out = item->write_value<int>() = h->nontrans_read() + 5;
+        });
+        TestTransaction t2(2);
+        hot = 20;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    assert(hot.nontrans_read() == 25 && seen == 25);
+
+    // nothing runs if validation fails
+    seen = -1;
+    {
+        TestTransaction t1(1);
+        hot = other + 1;
+        int* out = &seen;
+        Sto::defer_update([out] { *out = 1; });
+        TestTransaction t2(2);
+        other = 1;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(hot.nontrans_read() == 25 && seen == -1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRepair() {
+    Transaction::set_repair_limit(1);
+    TBox<int> a, b, x, y, z;
+    int av = 0, runs[3] = {0, 0, 0};
+    {
+        // only the stale step and the step that uses its result rerun
+        TestTransaction t1(1);
+        assert(Sto::repair_step([&] { ++runs[0]; av = a; x = av + 1; return true; }));
+        assert(Sto::repair_step([&] { ++runs[1]; z = b; return true; }));
+        assert(Sto::repair_step([&] { ++runs[2]; y = av * 10; return true; }, 1));
+        TestTransaction t2(2);
+        a = 5;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    assert(x.nontrans_read() == 6 && y.nontrans_read() == 50 && z.nontrans_read() == 0);
+    assert(runs[0] == 2 && runs[1] == 1 && runs[2] == 2);
+
+    {
+        // a stale read outside any step aborts
+        TestTransaction t1(1);
+        int bv = b;
+        assert(Sto::repair_step([&] { av = a; x = av + bv; return true; }));
+        TestTransaction t2(2);
+        b = 1;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // so does a rerun that writes elsewhere
+        TestTransaction t1(1);
+        assert(Sto::repair_step([&] {
+            if (a == 5)
+                x = 0;
+            else
+                y = 0;
+            return true;
+        }));
+        TestTransaction t2(2);
+        a = 6;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // and a second stale read, past the repair limit
+        TestTransaction t1(1);
+        assert(Sto::repair_step([&] { x = a + 0; return true; }));
+        assert(Sto::repair_step([&] { y = b + 0; return true; }));
+        TestTransaction t2(2);
+        a = 7;
+        b = 2;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(x.nontrans_read() == 6 && y.nontrans_read() == 50);
+    Transaction::set_repair_limit(0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Reads through read_item, which may add the same item more than once
+class DupReadBox : public TBox<int, TNonopaqueWrapped<int>> {
+public:
+    int dup_read() {
+        auto item = Sto::read_item(this, 0);
+        auto result = v_.read(item, vers_);
+        if (!result.first)
+            throw Transaction::Abort();
+        return result.second;
+    }
+};
+
+void testDuplicateReads() {
+    DupReadBox a, b;
+    {
+        // every copy of an item validates
+        TestTransaction t1(1);
+        for (int i = 0; i != 100; ++i) {
+            assert(a.dup_read() == 0);
+            assert(b.dup_read() == 0);
+        }
+        assert(t1.try_commit());
+    }
+    {
+        // a change after the first read fails the earliest copy
+        TestTransaction t1(1);
+        a.dup_read();
+        b.dup_read();
+        TestTransaction t2(2);
+        a.write(1);
+        assert(t2.try_commit());
+        t1.use();
+        assert(a.dup_read() == 1);
+        assert(!t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testItemLookups() {
+    TBox<int> f, g;
+    TransItem* hint = nullptr;
+    {
+        TestTransaction t1(1);
+        TransItem* fi = &Sto::item(&f, 0).item();
+        Sto::item(&g, 0).add_write(1);
+        // repeated lookups find the same item
+        for (int i = 0; i != 3; ++i) {
+            assert(&Sto::item(&f, 0).item() == fi);
+            assert(&Sto::item(&f, 0, hint).item() == fi);
+            assert(hint == fi);
+        }
+        // a hint for another key is replaced
+        assert(&Sto::item(&g, 0, hint).item() == &Sto::item(&g, 0).item());
+        assert(hint != fi);
+        assert(t1.try_commit());
+    }
+    {
+        // hints and cached items don't outlive their transaction
+        TestTransaction t1(1);
+        TransItem* gi = &Sto::item(&g, 0).item();
+        TransItem* fi = &Sto::item(&f, 0, hint).item();
+        assert(fi != gi && !fi->has_write());
+        assert(&Sto::item(&g, 0).item() == gi);
+        assert(t1.try_commit());
+    }
+    {
+        // with duplicate reads, lookups keep finding the first copy
+        DupReadBox a;
+        TestTransaction t1(1);
+        a.dup_read();
+        TransItem* first = &Sto::item(&a, 0).item();
+        a.dup_read();
+        a.dup_read();
+        assert(&Sto::item(&a, 0).item() == first);
+        assert(&Sto::item(&a, 0, hint).item() == first);
+        assert(t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+struct BigRow {
+    int64_t cols[32];
+};
+
+std::ostream& operator<<(std::ostream& w, const BigRow& r) {
+    return w << "BigRow{" << r.cols[0] << ", ...}";
+}
+
+void testInPlace() {
+    // a large 2PL box updated under its write lock, with no install copy
+    TBox<BigRow, TLockWrapped<BigRow>> box;
+    for (int i = 0; i < 32; ++i)
+        box.nontrans_access().cols[i] = i;
+
+    {
+        TransactionGuard t;
+        BigRow& r = box.update_in_place();
+        r.cols[3] = 300;
+        assert(box.read().cols[3] == 300);
+        // plain writes after an in-place update land in place too
+        BigRow copy = box.read();
+        copy.cols[4] = 400;
+        box = copy;
+        assert(&box.update_in_place() == &r);
+    }
+    assert(box.nontrans_read().cols[3] == 300 && box.nontrans_read().cols[4] == 400);
+
+    {
+        // abort restores the saved value; a pending redo write is applied
+        // before the in-place update
+        TestTransaction t1(1);
+        BigRow copy = box.read();
+        copy.cols[5] = 500;
+        box = copy;
+        box.update_in_place().cols[6] = 600;
+        assert(box.nontrans_read().cols[5] == 500 && box.nontrans_read().cols[6] == 600);
+
+        // others can't read until the transaction ends (no contention
+        // manager, so the read gives up instead of waiting on t1)
+        ContentionManager::set_policy("none");
+        bool aborted = false;
+        try {
+            TestTransaction t2(2);
+            BigRow r = box.read();
+            (void) r;
+        } catch (Transaction::Abort e) {
+            aborted = true;
+        }
+        assert(aborted);
+        ContentionManager::set_policy("greedy");
+        t1.use();
+        t1.get_tx().silent_abort();
+    }
+    for (int i = 0; i < 32; ++i)
+        assert(box.nontrans_read().cols[i] == (i == 3 ? 300 : i == 4 ? 400 : i));
+
+    {
+        // and released its lock
+        TestTransaction t1(1);
+        BigRow r = box.read();
+        assert(r.cols[3] == 300);
+        assert(t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testHugeTransaction() {
+    // more items than the 16-bit hashtable indexes, committed in bulk
+    const int n = 40000;
+    std::unique_ptr<TBox<int>[]> boxes(new TBox<int>[n]);
+    {
+        TransactionGuard t;
+        for (int i = 0; i != n; ++i)
+            boxes[i] = i;
+        // later accesses find the items already in the tset
+        for (int i = 0; i < n; i += 7)
+            boxes[i] = boxes[i] + 1;
+        assert(TThread::txn->tset_size() == unsigned(n));
+    }
+    for (int i = 0; i != n; ++i)
+        assert(boxes[i].nontrans_read() == i + (i % 7 == 0));
+    {
+        TestTransaction t1(1);
+        int sum = 0;
+        for (int i = 0; i != n; ++i)
+            sum += boxes[i];
+        boxes[0] = sum;
+        TestTransaction t2(2);
+        boxes[n - 1] = 0;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // the next transaction starts over in the small hashtable
+        TransactionGuard t;
+        boxes[1] = boxes[1] + boxes[2];
+        int v = boxes[1];
+        assert(v == 3);
+    }
+    assert(boxes[1].nontrans_read() == 3);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 int main() {
     testSimpleInt();
     testSimpleString();
+    testEmplaceWrite();
     testConcurrentInt();
     testOpacity1();
     testNoOpacity1();
+    testCombinedIncrements();
+    testEarlyUnlock();
+    testInPlace();
+    testSmallCommit();
+    testDeferredUpdate();
+    testRepair();
+    testDuplicateReads();
+    testItemLookups();
+    testHugeTransaction();
     //testStringWrapper();
 
     std::thread advancer;  // empty thread because we have no advancer thread
@@ -0,0 +1,249 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TChunkedVector.hh"
+
+typedef TChunkedVector<int> vector_type;
+
+void testSimple() {
+    vector_type v;
+    TRANSACTION_E {
+        for (int i = 0; i != 10; ++i)
+            v.push_back(i * 10);
+    } RETRY_E(false);
+    assert(v.nontrans_size() == 10);
+    TRANSACTION_E {
+        assert(v.size() == 10);
+        assert(v[3] == 30);
+        v[3] = 31;
+        assert(v[3] == 31);
+        assert(v.back() == 90);
+        assert(v.front() == 0);
+    } RETRY_E(false);
+    assert(v.nontrans_get(3) == 31);
+    TRANSACTION_E {
+        try {
+            int x = v[10];
+            (void) x;
+            assert(false && "shouldn't get here");
+        } catch (std::out_of_range&) {
+        }
+    } RETRY_E(false);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOwnPushes() {
+    vector_type v;
+    for (int i = 0; i != 3; ++i)
+        v.nontrans_push_back(i);
+    TRANSACTION_E {
+        v.push_back(3);
+        v.push_back(4);
+        assert(v.size() == 5);
+        assert(v[4] == 4);
+        v[3] = 33;
+        v.pop_back();
+        assert(v.size() == 4);
+        assert(v.back() == 33);
+    } RETRY_E(false);
+    assert(v.nontrans_size() == 4 && v.nontrans_get(3) == 33);
+
+    // popping committed elements, then refilling one
+    TRANSACTION_E {
+        v.pop_back();
+        v.pop_back();
+        v.push_back(20);
+        assert(v.size() == 3);
+        assert(v[2] == 20);
+        try {
+            int x = v[3];
+            (void) x;
+            assert(false && "shouldn't get here");
+        } catch (std::out_of_range&) {
+        }
+    } RETRY_E(false);
+    assert(v.nontrans_size() == 3 && v.nontrans_get(2) == 20);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbortedPush() {
+    vector_type v;
+    {
+        TestTransaction t(1);
+        v.push_back(1);
+        // destroying the transaction aborts it
+    }
+    assert(v.nontrans_size() == 0);
+    TRANSACTION_E {
+        v.push_back(2);
+    } RETRY_E(false);
+    assert(v.nontrans_size() == 1 && v.nontrans_get(0) == 2);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAppendsCommute() {
+    vector_type v;
+    v.nontrans_push_back(0);
+    {
+        TestTransaction t1(1);
+        v.push_back(1);
+        assert(v[0] == 0);
+        TestTransaction t2(2);
+        v.push_back(2);
+        v.push_back(2);
+        TestTransaction t3(3);
+        v.push_back(3);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+        assert(t3.try_commit());
+    }
+    assert(v.nontrans_size() == 5);
+    assert(v.nontrans_get(1) == 2 && v.nontrans_get(2) == 2);
+    assert(v.nontrans_get(3) == 1 && v.nontrans_get(4) == 3);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSizeConflict() {
+    vector_type v;
+    v.nontrans_push_back(0);
+    {
+        // an exact size observation loses to a concurrent append
+        TestTransaction t1(1);
+        assert(v.size() == 1);
+        v[0] = 1;
+        TestTransaction t2(2);
+        v.push_back(2);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // ...but a range the append doesn't contradict survives it
+        TestTransaction t1(1);
+        assert(v.size() > 0);
+        v[0] = 1;
+        TestTransaction t2(2);
+        v.push_back(3);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    {
+        // reading an own push pins the size
+        TestTransaction t1(1);
+        v.push_back(4);
+        assert(v[3] == 4);
+        TestTransaction t2(2);
+        v.push_back(5);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(v.nontrans_size() == 4 && v.nontrans_get(3) == 5);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPopConflict() {
+    vector_type v;
+    for (int i = 0; i != 4; ++i)
+        v.nontrans_push_back(i);
+    {
+        TestTransaction t1(1);
+        assert(v[3] == 3);
+        v[0] = 10;
+        TestTransaction t2(2);
+        v.pop_back();
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // a pop waits out a pending append's size
+        TestTransaction t1(1);
+        v.pop_back();
+        TestTransaction t2(2);
+        v.push_back(7);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(v.nontrans_size() == 4 && v.nontrans_get(3) == 7);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testGrowthKeepsVersions() {
+    vector_type v;
+    v.nontrans_push_back(0);
+    {
+        // appends spanning several chunks don't touch element 0
+        TestTransaction t1(1);
+        assert(v[0] == 0);
+        v.push_back(-1);
+        TestTransaction t2(2);
+        for (int i = 1; i != 1000; ++i)
+            v.push_back(i);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    assert(v.nontrans_size() == 1001);
+    for (int i = 0; i != 1000; ++i)
+        assert(v.nontrans_get(i) == i);
+    assert(v.nontrans_get(1000) == -1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads append concurrently; every append lands exactly once, in each
+// thread's order
+void testConcurrent() {
+    constexpr int nthreads = 4;
+    constexpr int ntrans = 20000;
+    vector_type v;
+    std::vector<unsigned long> attempts(nthreads);
+
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        for (int i = 0; i != ntrans; ++i) {
+            TRANSACTION_E {
+                ++attempts[me];
+                v.push_back(me * ntrans + i);
+                if (i % 2)
+                    v.push_back(-1);
+            } RETRY_E(true);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+    TThread::set_id(0);
+
+    unsigned long aborts = 0;
+    for (auto a : attempts)
+        aborts += a - ntrans;
+    assert(aborts == 0);
+    assert(v.nontrans_size() == nthreads * ntrans * 3 / 2);
+    std::vector<int> next(nthreads, 0);
+    for (int i = 0; i != v.nontrans_size(); ++i) {
+        int x = v.nontrans_get(i);
+        if (x < 0)
+            continue;
+        int t = x / ntrans;
+        assert(x % ntrans == next[t]);
+        ++next[t];
+    }
+    for (int t = 0; t != nthreads; ++t)
+        assert(next[t] == ntrans);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSimple();
+    testOwnPushes();
+    testAbortedPush();
+    testAppendsCommute();
+    testSizeConflict();
+    testPopConflict();
+    testGrowthKeepsVersions();
+    testConcurrent();
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "TFlexArray.hh"
 #include <iostream>
+#include <thread>
+#include <vector>
 
 void test_compile() {
     constexpr unsigned sz = 1000;
@@ -107,8 +109,87 @@ void test_tictoc2() {
     std::cout << "PASS: " << std::string(__FUNCTION__) << std::endl;
 }
 
+// The adaptive lock changes read mode once per phase, not per access
+void test_adaptive_phases() {
+    TAdaptiveArray<int, 1> array;
+    auto read_mode = [&] {
+        TransactionGuard guard;
+        int a;
+        bool ok = array.transGet(0, a);
+        assert(ok);
+        return Sto::item(&array, 0).item().cc_mode();
+    };
+    auto write = [&] (int x) {
+        TransactionGuard guard;
+        bool ok = array.transPut(0, x);
+        assert(ok);
+    };
+
+    for (int i = 0; i < 1000; ++i)
+        read_mode();
+    assert(read_mode() == CCMode::opt);
+    for (int i = 0; i < 16; ++i)
+        write(i);
+    assert(read_mode() == CCMode::opt);
+    for (int i = 0; i < 1000; ++i)
+        write(i);
+    assert(read_mode() == CCMode::lock);
+    for (int i = 0; i < 16; ++i)
+        read_mode();
+    assert(read_mode() == CCMode::lock);
+    std::cout << "PASS: " << std::string(__FUNCTION__) << std::endl;
+}
+
+// 2PL transfers lock cells in random orders, and one thread keeps locking
+// every cell, so lock waits form cycles. With policy none (abort at the
+// spin bound) the long transaction can starve; wait-die lets it finish.
+void test_2pl_wait_die() {
+    constexpr int ncells = 8;
+    for (const char* policy : {"greedy", "polka"}) {
+        always_assert(ContentionManager::set_policy(policy));
+        T2PLArray<int, ncells> array;
+        for (int i = 0; i < ncells; ++i)
+            array.nontrans_put(i, 0);
+        std::vector<std::thread> threads;
+        for (int id = 0; id != 4; ++id)
+            threads.emplace_back([&array, id] {
+                TThread::set_id(id);
+                unsigned seed = id + 1;
+                for (int n = 0; n != 1000; ++n) {
+                    int i = rand_r(&seed) % ncells;
+                    int j = (i + 1 + rand_r(&seed) % (ncells - 1)) % ncells;
+                    TRANSACTION_E {
+                        int a, b;
+                        if (id == 0) {
+                            // long transaction: touch every cell
+                            for (int k = ncells - 1; k >= 0; --k) {
+                                TXN_DO_E(array.transGet(k, a));
+                                TXN_DO_E(array.transPut(k, a));
+                            }
+                        } else {
+                            TXN_DO_E(array.transGet(i, a));
+                            TXN_DO_E(array.transPut(i, a - 1));
+                            TXN_DO_E(array.transGet(j, b));
+                            TXN_DO_E(array.transPut(j, b + 1));
+                        }
+                    } RETRY_E(true);
+                }
+            });
+        for (auto& t : threads)
+            t.join();
+        int sum = 0;
+        for (int i = 0; i < ncells; ++i)
+            sum += array.nontrans_get(i);
+        assert(sum == 0);
+    }
+    ContentionManager::set_policy("greedy");
+    std::cout << "PASS: " << std::string(__FUNCTION__) << std::endl;
+}
+
 int main() {
     test_compile();
+    test_adaptive_phases();
+    test_2pl_wait_die();
     test_tictoc0();
     test_tictoc1();
     test_tictoc2();
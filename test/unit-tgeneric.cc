@@ -132,10 +132,60 @@ void testVariableSizes() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+// With one version every word conflicts with every other, falsely
+void testFalseConflicts() {
+    long f[2] = {0, 0};
+    TGeneric g(1);
+    assert(g.table_size() == 1);
+
+    {
+        TestTransaction t1(1);
+        long x = g.read(&f[0]);
+        g.write(&f[0], x + 1);
+        TestTransaction t2(2);
+        g.write(&f[1], 5);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        TestTransaction t1(1);
+        long x = g.read(&f[0]);
+        g.write(&f[0], x + 1);
+        TestTransaction t2(2);
+        g.write(&f[0], 7);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    auto st = g.stats();
+    assert(st.check_failures == 2 && st.false_conflicts == 1);
+    assert(g.false_conflict_rate() == 0.5);
+    g.clear_stats();
+    assert(g.stats().check_failures == 0);
+
+    // a bigger table separates the words
+    g.nontrans_resize(1024, TGeneric::striped);
+    assert(g.table_size() == 1024 && g.layout() == TGeneric::striped);
+    {
+        TestTransaction t1(1);
+        long x = g.read(&f[0]);
+        assert(x == 7);
+        g.write(&f[0], x + 1);
+        TestTransaction t2(2);
+        g.write(&f[1], 6);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    assert(f[0] == 8 && f[1] == 6);
+    assert(g.stats().check_failures == 0);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 int main() {
     testSimpleInt();
     testOpacity1();
     testNoOpacity1();
     testVariableSizes();
+    testFalseConflicts();
     return 0;
 }
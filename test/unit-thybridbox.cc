@@ -0,0 +1,161 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include "Sto.hh"
+#include "THybridBox.hh"
+
+void testSimpleInt() {
+    static THybridBox<int> f;
+
+    {
+        TransactionGuard t;
+        f = 100;
+    }
+
+    {
+        TransactionGuard t2;
+        int f_read = f;
+        assert(f_read == 100);
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConflict() {
+    static THybridBox<int> f, g;
+
+    // Read-write transactions validate as in TBox
+    {
+        TestTransaction t1(1);
+        int x = f;
+        g = x + 1;
+
+        TestTransaction t2(2);
+        f = 5;
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    assert(f.nontrans_read() == 5);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Read f from a read-only snapshot taken before a concurrent write of v
+static bool stale_read(THybridBox<int>& f, int v, int expect) {
+    TestTransaction t1(1);
+    t1.get_tx().start_readonly();
+    (void) Sto::read_tid();
+
+    TestTransaction t2(2);
+    f = v;
+    assert(t2.try_commit());
+
+    t1.use();
+    try {
+        int x = f;
+        assert(x == expect);
+    } catch (Transaction::Abort&) {
+        t1.get_tx().silent_abort();
+        return false;
+    }
+    assert(t1.try_commit());
+    return true;
+}
+
+void testPromote() {
+    static THybridBox<int> f;
+    f.nontrans_write(0);
+    assert(f.cc_mode() == CCMode::opt);
+
+    // Fresh snapshots are served by the single version
+    {
+        TestTransaction t(1);
+        t.get_tx().start_readonly();
+        int x = f;
+        assert(x == 0);
+        assert(t.try_commit());
+    }
+
+    // Stale snapshots abort until the box turns multiversion
+    int v = 0;
+    for (unsigned i = 0; i != THybridBox<int>::promote_after; ++i) {
+        assert(!stale_read(f, v + 1, v));
+        ++v;
+    }
+    assert(f.cc_mode() == CCMode::opt);
+    assert(stale_read(f, v + 1, v));  // promoting write keeps v
+    ++v;
+    assert(f.cc_mode() == CCMode::mvcc);
+    assert(stale_read(f, v + 1, v));
+    ++v;
+
+    // A window without stale readers drops it back to a single version
+    // (the first window still saw the read above)
+    for (unsigned i = 0; i != 2 * THybridBox<int>::demote_after; ++i) {
+        TestTransaction t(2);
+        f = ++v;
+        assert(t.try_commit());
+    }
+    assert(f.cc_mode() == CCMode::opt);
+    assert(!stale_read(f, v + 1, v));
+    assert(f.nontrans_read() == v + 1);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConcurrent() {
+    static THybridBox<int> a, b;
+    static std::atomic<bool> stop;
+    static std::atomic<unsigned> ro_commits;
+    a.nontrans_write(0);
+    b.nontrans_write(0);
+
+    // Writers keep a == b; read-only snapshots must always agree
+    auto writer = [](int id) {
+        TThread::set_id(id);
+        while (ro_commits < 2)
+            relax_fence();
+        for (int i = 0; i != 20000; ++i) {
+            TRANSACTION_E {
+                int x = a;
+                a = x + 1;
+                b = x + 1;
+            } RETRY_E(true);
+        }
+    };
+    auto reader = [](int id) {
+        TThread::set_id(id);
+        do {
+            ROTRANSACTION_E {
+                int x = a;
+                int y = b;
+                always_assert(x == y, "hybrid snapshot");
+            } RETRY_E(true);
+            ++ro_commits;
+        } while (!stop);
+    };
+    std::thread w1(writer, 1), w2(writer, 2), r1(reader, 3), r2(reader, 4);
+    w1.join();
+    w2.join();
+    stop = true;
+    r1.join();
+    r2.join();
+    assert(a.nontrans_read() == 40000 && b.nontrans_read() == 40000);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSimpleInt();
+    testConflict();
+    testPromote();
+    testConcurrent();
+
+    std::thread advancer;  // empty thread because we have no advancer thread
+    Transaction::rcu_release_all(advancer, 8);
+    return 0;
+}
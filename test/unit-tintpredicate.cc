@@ -276,6 +276,41 @@ int main() {
         std::string hello("Hello");
         void* v7 = Packer<std::string>::pack(buf, StringWrapper(hello));
         assert(v7 == &hello);
+
+        void* v8 = Packer<std::string>::pack_unique(buf, std::string("Hello2"));
+        assert(v8 == v4);
+        std::string stable("Stable");
+        void* v9 = Packer<StableKey<std::string> >::pack_unique(buf, stable_key(stable));
+        assert(v9 == &stable);
+        assert(Packer<std::string>::pack_unique(buf, "Stable") == v9);
+        assert(Packer<StableKey<std::string> >::pack_unique(buf, stable_key(hello)) == v2);
+        buf.clear();
+        assert(Packer<std::string>::pack_unique(buf, "Stable") != v9);
+    }
+
+    // only non-trivially destructible objects are destroyed at clear
+    {
+        static int destroyed = 0;
+        struct counted {
+            ~counted() {
+                ++destroyed;
+            }
+        };
+        struct pair_type {
+            uintptr_t a, b;
+        };
+        TransactionBuffer buf;
+        for (int i = 0; i != 3; ++i) {
+            buf.allocate<pair_type>(pair_type{1, 2});
+            buf.allocate<counted>();
+            buf.allocate<pair_type>(pair_type{3, 4});
+        }
+        buf.clear();
+        assert(destroyed == 3);
+        for (int i = 0; i != 1000; ++i)
+            buf.allocate<pair_type>(pair_type{5, 6});
+        buf.clear();
+        assert(destroyed == 3 && buf.buffer_size() == 0);
     }
 
 
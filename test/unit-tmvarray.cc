@@ -288,6 +288,45 @@ void testMvInline() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testMvRing() {
+    // versions stay inside the array while its ring has room, go to the
+    // heap while GC can't free the ring, and come back once it has
+    static TMvArray<int64_t, 4, 4> f;
+    auto inside = [](const void* p) {
+        auto c = reinterpret_cast<const char*>(p);
+        return c >= reinterpret_cast<const char*>(&f)
+            && c < reinterpret_cast<const char*>(&f + 1);
+    };
+    f.nontrans_put(2, 0);
+    assert(inside(&f.nontrans_access(2)));
+
+    for (int i = 1; i <= 4; ++i) {
+        TestTransaction t(1);
+        f[2] = i;
+        assert(t.try_commit());
+        // the first version and three writes fill the ring
+        assert(inside(&f.nontrans_access(2)) == (i < 4));
+    }
+
+    // GC retires old versions in one epoch and frees them in a later one,
+    // each when the writer's thread starts a transaction
+    for (int i = 0; i < 8; ++i) {
+        Transaction::global_epoch_advance_once();
+        TestTransaction t(1);
+        assert(t.try_commit());
+    }
+
+    {
+        TestTransaction t(1);
+        f[2] = f[2] + 1;
+        assert(t.try_commit());
+    }
+    assert(f.nontrans_get(2) == 5);
+    assert(inside(&f.nontrans_access(2)));
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 void benchArray64() {
     TMvArray<int, 64> a;
     for (int i = 0; i < 64; ++i)
@@ -313,6 +352,8 @@ void benchArray64() {
 
 
 int main() {
+    // first, while no earlier test's transaction holds GC back
+    testMvRing();
     testSimpleInt();
     testSimpleString();
     testIter();
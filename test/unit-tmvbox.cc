@@ -5,14 +5,53 @@
 #include <vector>
 #include "Sto.hh"
 #include "Commutators.hh"
+#include "ColumnCommutators.hh"
 #include "TMvBox.hh"
 //XXX disabled string wrapper due to unknown compiler issue
 //#include "StringWrapper.hh"
 
 #define GUARDED if (TransactionGuard tguard{})
 
+struct mv_log {
+    static constexpr size_t max_length = 15;
+    char s_[max_length + 1] = {};
+
+    size_t length() const {
+        return strlen(s_);
+    }
+    char* c_str() {
+        return s_;
+    }
+};
+
+struct mv_stats {
+    int64_t total;
+    int64_t low;
+    int64_t high;
+    int32_t level;
+    mv_log log;
+};
+
+std::ostream& operator<<(std::ostream& w, const mv_stats& s) {
+    return w << s.total << ' ' << s.low << ' ' << s.high << ' ' << s.level << ' ' << s.log.s_;
+}
+
+namespace commutators {
+template <>
+class Commutator<mv_stats>
+    : public ColumnCommutator<mv_stats, col_add<&mv_stats::total>, col_min<&mv_stats::low>,
+                              col_max<&mv_stats::high>, col_bounded_add<&mv_stats::level, 0, 100>,
+                              col_append<&mv_stats::log, 4>> {
+public:
+    using ColumnCommutator::ColumnCommutator;
+};
+}
+
+// Boxes are static: with MVCC_INLINING, GC callbacks on their inline history
+// elements are only drained by rcu_release_all() at the end of main().
+
 void testSimpleInt() {
-    TMvBox<int> f;
+    static TMvBox<int> f;
 
     {
         TransactionGuard t;
@@ -31,7 +70,7 @@ void testSimpleInt() {
 }
 
 void testSimpleString() {
-    TMvBox<std::string> f;
+    static TMvBox<std::string> f;
 
     {
         TransactionGuard t;
@@ -50,8 +89,8 @@ void testSimpleString() {
 }
 
 void testConcurrentInt() {
-    TMvBox<int> ib;
-    TMvBox<int> box;
+    static TMvBox<int> ib;
+    static TMvBox<int> box;
     bool match;
 
     {
@@ -109,8 +148,8 @@ void testConcurrentInt() {
 }
 
 void testOpacity1() {
-    TMvBox<int> f, g;
-    TMvBox<int> box;
+    static TMvBox<int> f, g;
+    static TMvBox<int> box;
     f.nontrans_write(3);
 
     {
@@ -142,7 +181,7 @@ void testOpacity1() {
 }
 
 void testMvReads() {
-    TMvBox<int> f, g;
+    static TMvBox<int> f, g;
     f.nontrans_write(1);
     g.nontrans_write(-1);
 
@@ -233,7 +272,7 @@ void testMvReads() {
 }
 
 void testMvWrites() {
-    TMvBox<int> f, g;
+    static TMvBox<int> f, g;
     f.nontrans_write(1);
     g.nontrans_write(-1);
 
@@ -298,7 +337,7 @@ void testMvWrites() {
 }
 
 void testMvCommute1() {
-    TMvCommuteIntegerBox box;
+    static TMvCommuteIntegerBox box;
     box.nontrans_write(0);
 
     {
@@ -326,7 +365,7 @@ void testMvCommute1() {
 }
 
 void testMvCommute2() {
-    TMvCommuteIntegerBox box;
+    static TMvCommuteIntegerBox box;
     box.nontrans_write(0);
 
     {
@@ -355,8 +394,51 @@ void testMvCommute2() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testMvSnapshotIsolation() {
+    static TMvBox<int> f, g;
+    f.nontrans_write(0);
+    g.nontrans_write(0);
+
+    // A stale snapshot read doesn't abort the reader
+    {
+        TestTransaction t1(1);
+        Sto::set_snapshot_isolation(true);
+        int x = f;
+        assert(x == 0);
+
+        TestTransaction t2(2);
+        f = 1;
+        assert(t2.try_commit());
+
+        t1.use();
+        g = 5;
+        assert(t1.try_commit());
+    }
+    assert(f.nontrans_read() == 1);
+    assert(g.nontrans_read() == 5);
+
+    // Write-write conflicts still abort
+    {
+        TestTransaction t1(1);
+        Sto::set_snapshot_isolation(true);
+        int x = f;
+        (void) x;
+
+        TestTransaction t2(2);
+        f = 2;
+        assert(t2.try_commit());
+
+        t1.use();
+        f = 3;
+        assert(!t1.try_commit());
+    }
+    assert(f.nontrans_read() == 2);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 void testMvInline() {
-    TMvBox<int> box;
+    static TMvBox<int> box;
     box.nontrans_write(0);
 
     const int *v0 = &box.nontrans_access();
@@ -383,13 +465,14 @@ void testMvInline() {
     const int *v2 = &box.nontrans_access();
     assert(*v2 == 2);
     assert(v1 != v2);
-    assert(v0 == v2);
+    if (mvcc_inline_slots<int>::value == 1)
+        assert(v0 == v2);
 
     printf("PASS: %s\n", __FUNCTION__);
 }
 
 void testCommuteGC() {
-    TMvCommuteIntegerBox box;
+    static TMvCommuteIntegerBox box;
     box.nontrans_write(0);
 
     {
@@ -448,6 +531,171 @@ void testCommuteGC() {
 }
 
 
+void testColumnCommutatorFold() {
+    typedef commutators::Commutator<mv_stats> comm_type;
+
+    // The kernels agree
+    int64_t a[8] = {1, 5, -3, 0, INT64_MAX, -7, 2, 9};
+    int64_t b[8] = {2, -5, 4, 0, 1, 3, -8, 9};
+    int64_t add[8] = {-1, 0, 0, -1, 0, -1, 0, 0};
+    int64_t min[8] = {0, -1, 0, 0, -1, 0, -1, 0};
+    int64_t max[8] = {0, 0, -1, 0, 0, 0, 0, -1};
+    commutators::lanes::masks m = {add, min, max};
+    int64_t x[8], y[8];
+    memcpy(x, a, sizeof(a));
+    memcpy(y, a, sizeof(a));
+    commutators::lanes::fold_scalar(x, b, m, 8);
+    if (cpu_simd_level() != SimdLevel::scalar) {
+        commutators::lanes::fold_avx2(y, b, m, 8);
+        assert(memcmp(x, y, sizeof(x)) == 0);
+    }
+    int64_t expect[8] = {3, -5, 4, 0, 1, -4, -8, 9};
+    assert(memcmp(x, expect, sizeof(x)) == 0);
+
+    // Folding then applying equals applying in turn
+    mv_stats s1 = {10, 50, 50, 40, {}};
+    mv_stats s2 = s1;
+    comm_type c1(5, 20, 30, 10, "ab");
+    comm_type c2(-2, 30, 70, 15, "cd");
+    c1.operate(s1);
+    c2.operate(s1);
+    assert(c1.fold(c2));
+    c1.operate(s2);
+    assert(s1.total == 13 && s2.total == 13);
+    assert(s1.low == 20 && s2.low == 20);
+    assert(s1.high == 70 && s2.high == 70);
+    assert(s1.level == 65 && s2.level == 65);
+    assert(strcmp(s1.log.c_str(), "abcd") == 0 && strcmp(s2.log.c_str(), "abcd") == 0);
+
+    // bounded adds of opposite signs, or a full log, don't fold
+    comm_type c3(1, 0, 0, 5, "");
+    assert(!c3.fold(comm_type(1, 0, 0, -5, "")));
+    assert(!c1.fold(comm_type(0, 0, 0, 0, "e")));
+    // and a failed fold changes nothing
+    mv_stats s3 = {0, 0, 0, 50, {}};
+    c3.operate(s3);
+    assert(s3.total == 1 && s3.level == 55);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testMvColumnCommute() {
+    typedef commutators::Commutator<mv_stats> comm_type;
+    static TMvBox<mv_stats> box;
+    box.nontrans_write(mv_stats{0, 1000, -1000, 0, {}});
+
+    // A chain long enough to flatten, with runs broken by appends that
+    // overflow the fold buffer and bounded adds that change sign
+    mv_stats expect = box.nontrans_read();
+    for (int i = 1; i <= 300; ++i) {
+        comm_type c(i, 1000 - i, i % 97, (i % 40 < 30) ? 3 : -2, (i % 3) ? "" : "xy");
+        c.operate(expect);
+        TestTransaction t(1);
+        Sto::item(&box, 0).add_commute(c);
+        assert(t.try_commit());
+    }
+
+    {
+        TestTransaction t(2);
+        mv_stats v = box.read();
+        assert(t.try_commit());
+        assert(v.total == expect.total && v.total == 300 * 301 / 2);
+        assert(v.low == expect.low && v.low == 700);
+        assert(v.high == expect.high && v.high == 96);
+        assert(v.level == expect.level);
+        assert(strcmp(v.log.c_str(), expect.log.c_str()) == 0);
+        assert(v.log.length() == mv_log::max_length);
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testMvOldSnapshot() {
+    static TMvBox<int> f;
+    f.nontrans_write(0);
+
+    // An old snapshot stays readable behind a long version chain
+    {
+        TestTransaction t1(1);
+        for (int i = 1; i <= 300; ++i) {
+            TestTransaction t2(2);
+            f = i;
+            assert(t2.try_commit());
+        }
+
+        t1.use();
+        int x = f;
+        assert(x == 0);
+        assert(t1.try_commit());
+    }
+
+    assert(f.nontrans_read() == 300);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testMvSnapshotPin() {
+    static TMvBox<int> f;
+    f.nontrans_write(0);
+
+    // A pinned snapshot survives later writes and GC
+    {
+        SnapshotPin pin;
+        auto pinned = Transaction::snapshot_pins[0].load();
+        for (int i = 1; i <= 300; ++i) {
+            TestTransaction t(1);
+            f = i;
+            assert(t.try_commit());
+            Transaction::global_epoch_advance_once();
+        }
+        assert(Transaction::global_epochs.active_epoch.load() == pinned);
+        auto h = TMvBoxAccess::find(f, pin.tid());
+        assert(h->status_is(COMMITTED));
+        assert(h->v() == 0);
+    }
+    assert(Transaction::snapshot_pins[0].load() == 0);
+    assert(f.nontrans_read() == 300);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+#if MVCC_BG_FLATTEN
+void testMvBgFlatten() {
+    static TMvCommuteIntegerBox box;
+    box.nontrans_write(0);
+
+    MvFlattener::start(1, 7);
+    for (int i = 0; i < 300; ++i) {
+        TestTransaction t(1);
+        box.increment(1);
+        assert(t.try_commit());
+    }
+    MvFlattener::stop();
+    // stop() gives back the queue's snapshot pin
+    assert(Transaction::snapshot_pins[0].load() == 0);
+
+    // The flattener, not a reader, cut the delta chain
+    {
+        TestTransaction t(2);
+        Sto::mvcc_rw_upgrade();
+        auto h = TMvBoxAccess::head(box);
+        assert(t.try_commit());
+        int deltas = 0;
+        while (h->status_is(COMMITTED_DELTA)) {
+            ++deltas;
+            h = h->prev();
+        }
+        assert(h->status() == COMMITTED);
+        assert(h->prev());
+        assert(deltas < 300);
+    }
+
+    assert(300 == box.nontrans_read());
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+#endif
+
 int main() {
     testSimpleInt();
     testSimpleString();
@@ -458,11 +706,19 @@ int main() {
     testMvCommute1();
     testMvCommute2();
     testCommuteGC();
+    testColumnCommutatorFold();
+    testMvColumnCommute();
+    testMvOldSnapshot();
+    testMvSnapshotIsolation();
+    testMvSnapshotPin();
 #if MVCC_INLINING
     testMvInline();
 #endif
+#if MVCC_BG_FLATTEN
+    testMvBgFlatten();
+#endif
 
     std::thread advancer;  // empty thread because we have no advancer thread
-    Transaction::rcu_release_all(advancer, 7);
+    Transaction::rcu_release_all(advancer, 8);
     return 0;
 }
@@ -0,0 +1,117 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "TransAlloc.hh"
+
+static int live_objects;
+
+struct tracked {
+    int x;
+    char pad[40];
+    explicit tracked(int x)
+        : x(x) {
+        ++live_objects;
+    }
+    ~tracked() {
+        --live_objects;
+    }
+};
+
+// Runs RCU callbacks registered so far
+static void flush_rcu() {
+    auto& t = Transaction::tinfo[TThread::id()];
+    t.write_snapshot_epoch = 0;
+    t.epoch = 0;
+    for (int i = 0; i != 4; ++i)
+        Transaction::global_epoch_advance_once();
+    t.rcu_set.clean_until(Transaction::global_epochs.active_epoch);
+}
+
+void testCommitAndAbort() {
+    TransAlloc ta;
+    TBox<tracked*> box(nullptr);
+    TRANSACTION_E {
+        box = ta.transNew<tracked>(1);
+    } RETRY_E(false);
+    flush_rcu();
+    assert(live_objects == 1 && box.nontrans_read()->x == 1);
+
+    // an aborted allocation is returned
+    {
+        TestTransaction t(1);
+        tracked* p = ta.transNew<tracked>(2);
+        assert(live_objects == 2 && p->x == 2);
+        // destroying the transaction aborts it
+    }
+    flush_rcu();
+    assert(live_objects == 1);
+
+    // an aborted free is not
+    {
+        TestTransaction t(1);
+        ta.transDelete(box.nontrans_read());
+    }
+    flush_rcu();
+    assert(live_objects == 1 && box.nontrans_read()->x == 1);
+
+    TRANSACTION_E {
+        ta.transDelete(&*box);
+        box = nullptr;
+    } RETRY_E(false);
+    // ...while a committed free waits out the grace period
+    assert(live_objects == 1);
+    flush_rcu();
+    assert(live_objects == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSizedBlocks() {
+    TransAlloc ta;
+    void* small;
+    void* large;
+    TRANSACTION_E {
+        small = ta.transMalloc(24);
+        large = ta.transMalloc(4 * TransAlloc::max_pooled);
+        memset(small, 1, 24);
+        memset(large, 2, 4 * TransAlloc::max_pooled);
+    } RETRY_E(false);
+    TRANSACTION_E {
+        ta.transFree(small, 24);
+        ta.transFree(large, 4 * TransAlloc::max_pooled);
+    } RETRY_E(false);
+    flush_rcu();
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Released blocks are reused by the same thread's next allocations
+void testPoolReuse() {
+    TransAlloc ta;
+    std::set<void*> freed;
+    TRANSACTION_E {
+        for (int i = 0; i != 100; ++i) {
+            void* p = ta.transMalloc(48);
+            freed.insert(p);
+            ta.transFree(p, 48);
+        }
+    } RETRY_E(false);
+    flush_rcu();
+    int reused = 0;
+    TRANSACTION_E {
+        reused = 0;
+        for (int i = 0; i != 100; ++i)
+            reused += freed.count(ta.transMalloc(48));
+    } RETRY_E(false);
+    assert(reused == 100);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testCommitAndAbort();
+    testSizedBlocks();
+    testPoolReuse();
+    return 0;
+}
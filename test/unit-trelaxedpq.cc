@@ -0,0 +1,189 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TRelaxedPriorityQueue.hh"
+
+typedef TRelaxedPriorityQueue<int> pq_type;
+
+// One sub-queue: the queue is exact
+void testExact() {
+    pq_type q(1);
+    TRANSACTION_E {
+        q.push(3);
+        q.push(7);
+        q.push(5);
+    } RETRY_E(false);
+    assert(q.nontrans_size() == 3);
+
+    int v = 0;
+    TRANSACTION_E {
+        assert(q.pop(v) && v == 7);
+        assert(q.pop(v) && v == 5);
+    } RETRY_E(false);
+    assert(q.nontrans_size() == 1);
+
+    TRANSACTION_E {
+        assert(q.pop(v) && v == 3);
+        assert(!q.pop(v));
+    } RETRY_E(false);
+    assert(q.nontrans_size() == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOwnPushes() {
+    pq_type q(1);
+    q.nontrans_push(5);
+    int v = 0;
+    TRANSACTION_E {
+        q.push(9);
+        q.push(1);
+        // own pushes compete with the shared elements
+        assert(q.pop(v) && v == 9);
+        assert(q.pop(v) && v == 5);
+        assert(q.pop(v) && v == 1);
+        assert(!q.pop(v));
+    } RETRY_E(false);
+    assert(q.nontrans_size() == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Every element comes out exactly once, whatever sub-queues pops sample
+void testRelaxed() {
+    pq_type q(4);
+    for (int i = 0; i != 100; ++i) {
+        TThread::set_id(i % 4);
+        q.nontrans_push(i);
+    }
+    TThread::set_id(0);
+    std::vector<int> popped;
+    while (true) {
+        bool found = false;
+        int v = 0;
+        TRANSACTION_E {
+            found = q.pop(v);
+        } RETRY_E(false);
+        if (!found)
+            break;
+        popped.push_back(v);
+    }
+    std::sort(popped.begin(), popped.end());
+    assert(popped.size() == 100);
+    for (int i = 0; i != 100; ++i)
+        assert(popped[i] == i);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPushesCommute() {
+    pq_type q(1);
+    {
+        TestTransaction t1(1);
+        q.push(1);
+        TestTransaction t2(2);
+        q.push(2);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    int v;
+    assert(q.nontrans_pop(v) && v == 2);
+    assert(q.nontrans_pop(v) && v == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPopConflict() {
+    pq_type q(1);
+    q.nontrans_push(1);
+    q.nontrans_push(2);
+    {
+        int v1, v2;
+        TestTransaction t1(1);
+        assert(q.pop(v1) && v1 == 2);
+        TestTransaction t2(2);
+        assert(q.pop(v2) && v2 == 2);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(q.nontrans_size() == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testEmptyConflict() {
+    pq_type q(2);
+    {
+        int v;
+        TestTransaction t1(1);
+        // (a read-only transaction would serialize before t2 and commit)
+        assert(!q.pop(v));
+        q.push(5);
+        TestTransaction t2(2);
+        q.push(1);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(q.nontrans_size() == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads push distinct values and pop; every value comes out exactly once
+void testConcurrent() {
+    constexpr int nthreads = 4;
+    constexpr int ntrans = 20000;
+    pq_type q(2 * nthreads);
+    std::vector<std::vector<int>> popped(nthreads);
+
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        int seq = 0;
+        for (int i = 0; i != ntrans; ++i) {
+            std::vector<int> got;
+            int pushes = 0;
+            TRANSACTION_E {
+                got.clear();
+                pushes = 0;
+                for (int op = 0; op != 4; ++op) {
+                    int v;
+                    if ((i + op + me) % 2)
+                        q.push((seq + pushes++) * nthreads + me);
+                    else if (q.pop(v))
+                        got.push_back(v);
+                }
+            } RETRY_E(true);
+            seq += pushes;
+            popped[me].insert(popped[me].end(), got.begin(), got.end());
+        }
+    };
+
+    std::thread advancer(&Transaction::epoch_advancer, nullptr);
+    advancer.detach();
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+
+    std::vector<int> all;
+    for (auto& p : popped)
+        all.insert(all.end(), p.begin(), p.end());
+    int v;
+    while (q.nontrans_pop(v))
+        all.push_back(v);
+    std::sort(all.begin(), all.end());
+    assert(all.size() == size_t(nthreads) * ntrans * 2);
+    for (size_t i = 0; i != all.size(); ++i)
+        assert(all[i] == int(i));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testExact();
+    testOwnPushes();
+    testRelaxed();
+    testPushesCommute();
+    testPopConflict();
+    testEmptyConflict();
+    testConcurrent();
+    return 0;
+}
@@ -0,0 +1,215 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TSegmentedQueue.hh"
+
+// Small segments, so tests cross segment boundaries
+typedef TSegmentedQueue<int, 4> queue_type;
+
+void testSimple() {
+    queue_type q;
+    TRANSACTION_E {
+        q.push(1);
+        q.push(2);
+        q.push(3);
+    } RETRY_E(false);
+    assert(q.nontrans_size() == 3);
+
+    int v = 0;
+    TRANSACTION_E {
+        assert(q.front(v) && v == 1);
+        assert(q.pop(v) && v == 1);
+        assert(q.pop(v) && v == 2);
+        assert(q.front(v) && v == 3);
+    } RETRY_E(false);
+    assert(q.nontrans_size() == 1);
+
+    TRANSACTION_E {
+        assert(q.pop(v) && v == 3);
+        assert(!q.pop(v));
+        assert(!q.front(v));
+    } RETRY_E(false);
+    assert(q.nontrans_empty());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOwnPushes() {
+    queue_type q;
+    q.nontrans_push(1);
+    int v = 0;
+    TRANSACTION_E {
+        q.push(2);
+        q.push(3);
+        // the shared element comes first, then our own pushes
+        assert(q.pop(v) && v == 1);
+        assert(q.front(v) && v == 2);
+        assert(q.pop(v) && v == 2);
+    } RETRY_E(false);
+    assert(q.nontrans_size() == 1);
+    assert(q.nontrans_pop(v) && v == 3);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSegments() {
+    queue_type q;
+    for (int round = 0; round != 10; ++round) {
+        TRANSACTION_E {
+            for (int i = 0; i != 7; ++i)
+                q.push(round * 7 + i);
+        } RETRY_E(false);
+    }
+    for (int i = 0; i != 70; i += 5) {
+        TRANSACTION_E {
+            int v;
+            for (int j = i; j != i + 5 && j != 70; ++j)
+                assert(q.pop(v) && v == j);
+        } RETRY_E(false);
+    }
+    assert(q.nontrans_empty());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPushesCommute() {
+    queue_type q;
+    {
+        TestTransaction t1(1);
+        q.push(1);
+        TestTransaction t2(2);
+        q.push(2);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    int v;
+    // in commit order
+    assert(q.nontrans_pop(v) && v == 2);
+    assert(q.nontrans_pop(v) && v == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPopConflict() {
+    queue_type q;
+    q.nontrans_push(1);
+    q.nontrans_push(2);
+    {
+        int v1, v2;
+        TestTransaction t1(1);
+        assert(q.pop(v1) && v1 == 1);
+        TestTransaction t2(2);
+        assert(q.pop(v2) && v2 == 1);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(q.nontrans_size() == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPopPushNoConflict() {
+    queue_type q;
+    q.nontrans_push(1);
+    {
+        int v;
+        TestTransaction t1(1);
+        assert(q.pop(v) && v == 1);
+        TestTransaction t2(2);
+        q.push(2);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    int v;
+    assert(q.nontrans_pop(v) && v == 2);
+    assert(q.nontrans_empty());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testEmptyConflict() {
+    queue_type q;
+    {
+        int v;
+        TestTransaction t1(1);
+        // (a read-only transaction would serialize before t2 and commit)
+        assert(!q.pop(v));
+        q.push(5);
+        TestTransaction t2(2);
+        q.push(1);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    int v;
+    assert(q.nontrans_pop(v) && v == 1);
+    assert(q.nontrans_empty());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads push their own increasing sequences and pop; every element comes
+// out exactly once, and each popper sees each pusher's elements in order
+void testConcurrent() {
+    constexpr int nthreads = 4;
+    constexpr int ntrans = 20000;
+    TSegmentedQueue<int> q;
+    std::vector<std::vector<int>> popped(nthreads);
+
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        int seq = 0;
+        for (int i = 0; i != ntrans; ++i) {
+            std::vector<int> got;
+            int pushes = 0;
+            TRANSACTION_E {
+                got.clear();
+                pushes = 0;
+                for (int op = 0; op != 4; ++op) {
+                    int v;
+                    if ((i + op + me) % 2)
+                        q.push((me << 24) | (seq + pushes++));
+                    else if (q.pop(v))
+                        got.push_back(v);
+                }
+            } RETRY_E(true);
+            seq += pushes;
+            popped[me].insert(popped[me].end(), got.begin(), got.end());
+        }
+    };
+
+    std::thread advancer(&Transaction::epoch_advancer, nullptr);
+    advancer.detach();
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+
+    int v;
+    while (q.nontrans_pop(v))
+        popped[0].push_back(v);
+
+    std::vector<std::vector<bool>> seen(nthreads, std::vector<bool>(ntrans * 4, false));
+    size_t total = 0;
+    for (auto& p : popped) {
+        std::vector<int> last(nthreads, -1);
+        for (int x : p) {
+            int owner = x >> 24, s = x & 0xFFFFFF;
+            assert(!seen[owner][s]);
+            seen[owner][s] = true;
+            assert(s > last[owner]);
+            last[owner] = s;
+        }
+        total += p.size();
+    }
+    assert(total == size_t(nthreads) * ntrans * 2);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSimple();
+    testOwnPushes();
+    testSegments();
+    testPushesCommute();
+    testPopConflict();
+    testPopPushNoConflict();
+    testEmptyConflict();
+    testConcurrent();
+    return 0;
+}
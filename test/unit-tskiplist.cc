@@ -0,0 +1,320 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TSkipList.hh"
+
+typedef TSkipList<int, int> list_type;
+typedef TSkipList<int, int, true> sized_list_type;
+
+void testSimple() {
+    list_type l;
+    TRANSACTION_E {
+        l[3] = 30;
+        l[1] = 10;
+        assert(l.insert(2, 20));
+        assert(!l.insert(2, 21));
+        assert(l[2] == 20);
+    } RETRY_E(false);
+    TRANSACTION_E {
+        assert(l.count(1) && l.count(2) && l.count(3) && !l.count(4));
+        assert(l[3] == 30);
+        assert(l.erase(2) == 1);
+        assert(l.erase(2) == 0);
+        assert(!l.count(2));
+        assert(l.erase(7) == 0);
+    } RETRY_E(false);
+    assert(l.nontrans_size() == 2);
+    int v;
+    assert(!l.nontrans_find(2, v));
+    assert(l.nontrans_find(3, v) && v == 30);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testOwnWrites() {
+    list_type l;
+    l.nontrans_insert(5, 50);
+    TRANSACTION_E {
+        l[7] = 70;
+        assert(l.count(7));
+        assert(l.erase(7) == 1);
+        assert(!l.count(7));
+        l[7] = 71;
+        assert(l[7] == 71);
+        assert(l.erase(5) == 1);
+        assert(!l.count(5));
+        assert(l.insert(5, 51));
+    } RETRY_E(false);
+    int v;
+    assert(l.nontrans_find(5, v) && v == 51);
+    assert(l.nontrans_find(7, v) && v == 71);
+    assert(l.nontrans_size() == 2);
+
+    // an erased insert vanishes at commit
+    TRANSACTION_E {
+        l[9] = 90;
+        l.erase(9);
+    } RETRY_E(false);
+    assert(!l.nontrans_contains(9));
+    assert(l.nontrans_size() == 2);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbortedInsert() {
+    list_type l;
+    {
+        TestTransaction t(1);
+        l[4] = 40;
+        // destroying the transaction aborts it
+    }
+    assert(!l.nontrans_contains(4));
+    assert(l.nontrans_size() == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testIterate() {
+    list_type l;
+    for (int i = 0; i != 20; i += 2)
+        l.nontrans_insert(i, i * 10);
+    TRANSACTION_E {
+        int expect = 0;
+        for (auto it = l.begin(); it != l.end(); ++it) {
+            assert(it->first == expect);
+            assert(it->second == expect * 10);
+            expect += 2;
+        }
+        assert(expect == 20);
+
+        auto it = l.lower_bound(5);
+        assert(it != l.end() && it->first == 6);
+        assert(l.lower_bound(19) == l.end());
+        assert(l.find(8) != l.end() && (*l.find(8)).second == 80);
+        assert(l.find(9) == l.end());
+    } RETRY_E(false);
+
+    // iteration sees this transaction's inserts and skips its erases
+    TRANSACTION_E {
+        l[5] = 50;
+        l.erase(6);
+        std::vector<int> keys;
+        for (auto it = l.lower_bound(3); it != l.end() && it->first < 10; ++it)
+            keys.push_back(it->first);
+        assert((keys == std::vector<int>{4, 5, 8}));
+    } RETRY_E(false);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDisjointInsertsCommute() {
+    list_type l;
+    for (int i = 0; i != 100; i += 10)
+        l.nontrans_insert(i, i);
+    {
+        TestTransaction t1(1);
+        l[15] = 1;
+        assert(!l.count(25));
+        TestTransaction t2(2);
+        l[55] = 2;
+        assert(!l.count(65));
+        // inserts into the same gap as t1's don't conflict with it either
+        l[12] = 2;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    assert(l.nontrans_contains(15) && l.nontrans_contains(55) && l.nontrans_contains(12));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbsentConflict() {
+    list_type l;
+    l.nontrans_insert(10, 10);
+    l.nontrans_insert(20, 20);
+    {
+        TestTransaction t1(1);
+        assert(!l.count(15));
+        l[100] = 1;
+        TestTransaction t2(2);
+        l[17] = 2;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // an insert elsewhere leaves the absent read alone
+        TestTransaction t1(1);
+        assert(!l.count(25));
+        l[100] = 1;
+        TestTransaction t2(2);
+        l[5] = 2;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPhantom() {
+    list_type l;
+    {
+        TestTransaction t1(1);
+        l[5] = 5;
+        try {
+            TestTransaction t2(2);
+            l.count(5);
+            assert(false && "shouldn't get here");
+        } catch (Transaction::Abort e) {
+            TestTransaction::hard_reset();
+        }
+        assert(t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testEraseConflict() {
+    list_type l;
+    l.nontrans_insert(1, 1);
+    {
+        TestTransaction t1(1);
+        assert(l[1] == 1);
+        l[2] = 2;
+        TestTransaction t2(2);
+        assert(l.erase(1) == 1);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    {
+        // a blind write loses to a committed erase
+        l.nontrans_insert(1, 1);
+        TestTransaction t1(1);
+        l[1] = 5;
+        TestTransaction t2(2);
+        assert(l.erase(1) == 1);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(!l.nontrans_contains(1));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testScanConflict() {
+    list_type l;
+    for (int i = 0; i != 10; ++i)
+        l.nontrans_insert(i * 10, i);
+    {
+        TestTransaction t1(1);
+        int n = 0;
+        for (auto it = l.lower_bound(20); it != l.end() && it->first <= 50; ++it)
+            ++n;
+        assert(n == 4);
+        l[1000] = 1;
+        TestTransaction t2(2);
+        l[35] = 2;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSize() {
+    sized_list_type l;
+    l.nontrans_insert(1, 1);
+    TRANSACTION_E {
+        assert(l.size() == 1);
+        l[2] = 2;
+        l[3] = 3;
+        l.erase(1);
+        assert(l.size() == 2);
+    } RETRY_E(false);
+    TRANSACTION_E {
+        assert(l.size() == 2);
+    } RETRY_E(false);
+    {
+        TestTransaction t1(1);
+        assert(l.size() == 2);
+        l[7] = 7;
+        TestTransaction t2(2);
+        l[8] = 8;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads insert and erase in their own key ranges and in a shared one;
+// the result matches the committed operations
+void testConcurrent() {
+    constexpr int nthreads = 4;
+    constexpr int ntrans = 20000;
+    constexpr int range = 256;
+    list_type l;
+    std::vector<std::map<int, int>> expect(nthreads);
+
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        auto& gen = TThread::gen[me].gen;
+        for (int i = 0; i != ntrans; ++i) {
+            int k1 = me * range + gen() % range;
+            int k2 = me * range + gen() % range;
+            bool erase1 = gen() % 2;
+            TRANSACTION_E {
+                if (erase1)
+                    l.erase(k1);
+                else
+                    l[k1] = i;
+                if (!l.count(k2))
+                    l[k2] = -i;
+                l.count(nthreads * range + gen() % 16);
+            } RETRY_E(true);
+            if (erase1)
+                expect[me].erase(k1);
+            else
+                expect[me][k1] = i;
+            if (!expect[me].count(k2))
+                expect[me][k2] = -i;
+        }
+    };
+
+    std::thread advancer(&Transaction::epoch_advancer, nullptr);
+    advancer.detach();
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+    TThread::set_id(0);
+
+    size_t total = 0;
+    for (int t = 0; t != nthreads; ++t) {
+        for (auto& kv : expect[t]) {
+            int v;
+            assert(l.nontrans_find(kv.first, v) && v == kv.second);
+        }
+        total += expect[t].size();
+    }
+    assert(l.nontrans_size() == total);
+    TRANSACTION_E {
+        int prev = -1;
+        size_t n = 0;
+        for (auto it = l.begin(); it != l.end(); ++it, ++n) {
+            assert(it->first > prev);
+            prev = it->first;
+        }
+        assert(n == total);
+    } RETRY_E(false);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSimple();
+    testOwnWrites();
+    testAbortedInsert();
+    testIterate();
+    testDisjointInsertsCommute();
+    testAbsentConflict();
+    testPhantom();
+    testEraseConflict();
+    testScanConflict();
+    testSize();
+    testConcurrent();
+    return 0;
+}
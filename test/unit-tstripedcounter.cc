@@ -0,0 +1,139 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "Transaction.hh"
+#include "TCounter.hh"
+#include "TStripedCounter.hh"
+
+typedef TStripedCounter<int> counter_type;
+
+void testTrivial() {
+    counter_type c;
+    {
+        TransactionGuard t;
+        c = 1;
+    }
+    {
+        TransactionGuard t;
+        int i_read = c;
+        assert(i_read == 1);
+        c += 4;
+        assert(c == 5);
+    }
+    assert(c.nontrans_read() == 5);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testIncrementsCommute() {
+    counter_type c(10);
+    {
+        TestTransaction t1(1);
+        ++c;
+        TestTransaction t2(2);
+        c += 5;
+        TestTransaction t3(3);
+        c -= 2;
+        assert(t3.try_commit());
+        assert(t1.try_commit());
+        assert(t2.try_commit());
+    }
+    assert(c.nontrans_read() == 14);
+
+    // the same stripe still commutes: deltas don't read
+    {
+        TestTransaction t1(1);
+        ++c;
+        TestTransaction t2(1 + 16);
+        ++c;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    assert(c.nontrans_read() == 16);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testReadConflict() {
+    counter_type c(10);
+    {
+        TestTransaction t1(1);
+        int x = c;
+        assert(x == 10);
+        c += 1;
+        TestTransaction t2(5);
+        ++c;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    assert(c.nontrans_read() == 11);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAssign() {
+    counter_type c(10);
+    {
+        TestTransaction t1(1);
+        c += 3;
+        c = 7;
+        c += 1;
+        assert(c == 8);
+        TestTransaction t2(2);
+        ++c;
+        assert(t2.try_commit());
+        // the assignment locks every stripe but doesn't read them
+        assert(t1.try_commit());
+    }
+    assert(c.nontrans_read() == 8);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Blind increments from many threads: every increment lands, and with
+// stripes they don't abort each other
+template <typename C>
+unsigned long stress(const char* name) {
+    constexpr int nthreads = 4;
+    constexpr int ntrans = 100000;
+    C c;
+    std::vector<unsigned long> attempts(nthreads);
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        for (int i = 0; i != ntrans; ++i) {
+            TRANSACTION_E {
+                ++attempts[me];
+                ++c;
+            } RETRY_E(true);
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    assert(c.nontrans_read() == nthreads * ntrans);
+
+    unsigned long aborts = 0;
+    for (auto a : attempts)
+        aborts += a - ntrans;
+    printf("  %s: %.0f increments/s, %lu aborts\n", name, nthreads * ntrans / secs, aborts);
+    return aborts;
+}
+
+void testStress() {
+    stress<TCounter<int>>("TCounter");
+    unsigned long aborts = stress<counter_type>("TStripedCounter");
+    assert(aborts == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testTrivial();
+    testIncrementsCommute();
+    testReadConflict();
+    testAssign();
+    testStress();
+    return 0;
+}
@@ -0,0 +1,437 @@
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Sto.hh"
+#include "AsyncIO.hh"
+#include "TBox.hh"
+
+static std::string make_dir() {
+    char path[] = "/tmp/sto-txnlog-XXXXXX";
+    assert(mkdtemp(path));
+    return path;
+}
+
+static void remove_dir(const std::string& dir) {
+    std::string cmd = "rm -rf " + dir;
+    assert(system(cmd.c_str()) == 0);
+}
+
+// The last value recovered for each object
+static std::map<uint32_t, int> recover(const std::string& dir, TxnLog::epoch_type* durable = nullptr) {
+    std::map<uint32_t, int> values;
+    TxnLog::tid_type last_tid = 0;
+    auto e = TxnLog::recover(dir.c_str(), [&](const TxnLog::record& r) {
+        assert(r.keylen == 0 && r.vallen == sizeof(int));
+        assert(r.tid >= last_tid);
+        last_tid = r.tid;
+        values[r.object_id] = *reinterpret_cast<const int*>(r.value);
+    });
+    if (durable)
+        *durable = e;
+    return values;
+}
+
+static void advance_until_durable(TxnLog::epoch_type e) {
+    TxnLog::flush_thread();
+    while (TxnLog::durable_epoch() < e) {
+        Transaction::global_epoch_advance_once();
+        usleep(1000);
+    }
+}
+
+void testLogAndRecover() {
+    TThread::set_id(0);
+    std::string dir = make_dir();
+    assert(recover(dir).empty());
+    TBox<int> a, b, unlogged;
+    a.set_log_id(1);
+    b.set_log_id(2);
+
+    assert(TxnLog::start(dir.c_str(), 2));
+    TRANSACTION_E {
+        a = 1;
+        b = 2;
+        unlogged = 3;
+    } RETRY_E(false);
+    TRANSACTION_E {
+        a = a + 10;
+    } RETRY_E(false);
+    auto e = TxnLog::last_epoch();
+    assert(e != 0);
+    {
+        // aborted transactions leave no record
+        TestTransaction t(1);
+        b = 99;
+        assert(b == 99);
+    }
+    TThread::set_id(0);
+    // read-only transactions open no record
+    TRANSACTION_E {
+        assert(a == 11);
+    } RETRY_E(false);
+
+    advance_until_durable(e);
+    auto values = recover(dir);
+    assert(values.size() == 2 && values[1] == 11 && values[2] == 2);
+
+    TRANSACTION_E {
+        b = 20;
+    } RETRY_E(false);
+    TxnLog::stop();
+    TxnLog::epoch_type durable;
+    values = recover(dir, &durable);
+    assert(durable >= TxnLog::last_epoch());
+    assert(values[1] == 11 && values[2] == 20);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Records of epochs past the durable epoch are ignored
+void testTornLog() {
+    TThread::set_id(0);
+    std::string dir = make_dir();
+    TBox<int> a;
+    a.set_log_id(7);
+    assert(TxnLog::start(dir.c_str(), 1, 4096));
+    TRANSACTION_E {
+        a = 1;
+    } RETRY_E(false);
+    advance_until_durable(TxnLog::last_epoch());
+    TxnLog::stop();
+    // a later session writes a new log that was never made durable
+    std::string path = dir + "/log.0";
+    FILE* f = fopen(path.c_str(), "a");
+    struct {
+        uint32_t type, nrecords;
+        uint64_t epoch, length;
+        uint32_t object_id, keylen, vallen, pad;
+        uint64_t tid;
+        int value, pad2;
+    } rec = {1, 1, ~uint64_t(0), 32, 7, 0, 4, 0, ~uint64_t(0), 42, 0};
+    fwrite(&rec, sizeof(rec), 1, f);
+    fclose(f);
+    auto values = recover(dir);
+    assert(values.size() == 1 && values[7] == 1);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Acknowledgements wait for the durable epoch and run in commit order
+void testDurableAcks() {
+    TThread::set_id(0);
+    std::string dir = make_dir();
+    TBox<int> a;
+    a.set_log_id(1);
+    assert(TxnLog::start(dir.c_str(), 1));
+    std::vector<int> acked;
+    TRANSACTION_E {
+        a = 1;
+    } RETRY_E(false);
+    TxnLog::on_durable([&] { acked.push_back(1); });
+    auto e = TxnLog::last_epoch();
+    assert(Transaction::global_epochs.durable_epoch < e);
+    TRANSACTION_E {
+        assert(a == 1);
+    } RETRY_E(false);
+    TxnLog::on_durable([&] { acked.push_back(2); });
+    // not durable yet: the next transaction start runs nothing
+    TRANSACTION_E {
+        a = 2;
+    } RETRY_E(false);
+    assert(acked.empty());
+    TxnLog::on_durable([&] { acked.push_back(3); });
+
+    advance_until_durable(Transaction::global_epochs.global_epoch);
+    TRANSACTION_E {
+        assert(a == 2);
+    } RETRY_E(false);
+    assert(acked.size() == 3 && acked[0] == 1 && acked[1] == 2 && acked[2] == 3);
+
+    // stop acknowledges whatever is left
+    TRANSACTION_E {
+        a = 3;
+    } RETRY_E(false);
+    TxnLog::on_durable([&] { acked.push_back(4); });
+    TxnLog::stop();
+    assert(acked.size() == 4 && acked[3] == 4);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads increment their own boxes and a shared one; recovery after stop
+// reproduces the final state
+void testConcurrent() {
+    constexpr int nthreads = 4;
+    constexpr int ntxns = 5000;
+    std::string dir = make_dir();
+    TBox<int> shared;
+    shared.set_log_id(100);
+    std::vector<TBox<int>> own(nthreads);
+    for (int t = 0; t != nthreads; ++t)
+        own[t].set_log_id(t + 1);
+
+    // small buffers, so workers hand off and wait on the loggers
+    assert(TxnLog::start(dir.c_str(), 2, 4096));
+    std::atomic<bool> done(false);
+    std::thread advancer([&] {
+        while (!done) {
+            Transaction::global_epoch_advance_once();
+            usleep(100);
+        }
+    });
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        for (int i = 0; i != ntxns; ++i) {
+            TRANSACTION_E {
+                own[me] = own[me] + 1;
+                if (i % 10 == 0)
+                    shared = shared + 1;
+            } RETRY_E(true);
+        }
+        TxnLog::flush_thread();
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+    done = true;
+    advancer.join();
+    TThread::set_id(0);
+    TxnLog::stop();
+
+    auto values = recover(dir);
+    for (int t = 0; t != nthreads; ++t)
+        assert(values[t + 1] == ntxns);
+    assert(values[100] == nthreads * ntxns / 10);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Parallel replay applies each object's writes on one thread, in version
+// order, and ends in the same state as serial replay
+void testParallelRecover() {
+    constexpr int nthreads = 4;
+    constexpr int nboxes = 64;
+    constexpr int ntxns = 2000;
+    std::string dir = make_dir();
+    std::vector<TBox<int>> boxes(nboxes);
+    for (int i = 0; i != nboxes; ++i)
+        boxes[i].set_log_id(i + 1);
+
+    assert(TxnLog::start(dir.c_str(), 2, 4096));
+    std::atomic<bool> done(false);
+    std::thread advancer([&] {
+        while (!done) {
+            Transaction::global_epoch_advance_once();
+            usleep(100);
+        }
+    });
+    auto worker = [&] (int me) {
+        TThread::set_id(me);
+        for (int i = 0; i != ntxns; ++i) {
+            TRANSACTION_E {
+                int x = (i * 7 + me) % nboxes;
+                auto& a = boxes[x];
+                auto& b = boxes[(x + 1 + i % (nboxes - 1)) % nboxes];
+                a = a + 1;
+                b = b + 2;
+            } RETRY_E(true);
+        }
+        TxnLog::flush_thread();
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t != nthreads; ++t)
+        threads.emplace_back(worker, t);
+    for (auto& t : threads)
+        t.join();
+    done = true;
+    advancer.join();
+    TThread::set_id(0);
+    TxnLog::stop();
+
+    auto serial = recover(dir);
+    for (int nrecover : {1, 3, 8}) {
+        std::vector<std::map<uint32_t, int>> values(nrecover);
+        std::vector<std::map<uint32_t, TxnLog::tid_type>> tids(nrecover);
+        auto stats = TxnLog::recover(dir.c_str(), nrecover, [&](const TxnLog::record& r, int t) {
+            assert(t == 0 || TThread::id() == t);
+            assert(r.tid >= tids[t][r.object_id]);
+            tids[t][r.object_id] = r.tid;
+            values[t][r.object_id] = *reinterpret_cast<const int*>(r.value);
+        });
+        TThread::set_id(0);
+        assert(stats.durable > 0 && stats.bytes > 0 && stats.seconds > 0);
+        assert(stats.records == uint64_t(nthreads * ntxns * 2));
+        std::map<uint32_t, int> merged;
+        for (auto& v : values)
+            for (auto& kv : v) {
+                // each object replays on exactly one thread
+                assert(!merged.count(kv.first));
+                merged.insert(kv);
+            }
+        assert(merged == serial);
+    }
+    int sum = 0;
+    for (auto& v : serial)
+        sum += v.second;
+    assert(sum == nthreads * ntxns * 3);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Updates log the words they change; deletes log only the key
+void testDeltaRecords() {
+    TThread::set_id(0);
+    std::string dir = make_dir();
+    struct row {
+        int64_t col[8];
+    };
+    row old_row, new_row;
+    for (int i = 0; i != 8; ++i)
+        old_row.col[i] = new_row.col[i] = i;
+    new_row.col[3] = 33;
+    int key = 5;
+
+    assert(TxnLog::start(dir.c_str(), 1));
+    TxnLog::begin_txn();
+    TxnLog::append_delta(1, &key, sizeof(key), &old_row, &new_row, sizeof(row), 100);
+    // an unchanged row logs nothing
+    TxnLog::append_delta(1, &key, sizeof(key), &new_row, &new_row, sizeof(row), 100);
+    TxnLog::end_txn();
+    row wide = new_row;
+    for (auto& c : wide.col)
+        c += 100;
+    TxnLog::begin_txn();
+    // changing every word logs the whole row
+    TxnLog::append_delta(1, &key, sizeof(key), &new_row, &wide, sizeof(row), 200);
+    TxnLog::append_delete(2, &key, sizeof(key), 200);
+    TxnLog::end_txn();
+    TxnLog::stop();
+
+    std::vector<TxnLog::record> records;
+    std::vector<row> values;
+    TxnLog::recover(dir.c_str(), [&](const TxnLog::record& r) {
+            assert(r.keylen == sizeof(key) && *reinterpret_cast<const int*>(r.key) == key);
+            records.push_back(r);
+            row v = old_row;
+            if (r.is_delta()) {
+                assert(r.vallen < sizeof(row));
+                assert(TxnLog::apply_delta(r, &v, sizeof(v)));
+                // the delta doesn't fit a narrower value
+                assert(!TxnLog::apply_delta(r, &v, 3 * sizeof(int64_t)));
+            } else if (!r.is_delete())
+                memcpy(&v, r.value, sizeof(v));
+            values.push_back(v);
+        });
+    assert(records.size() == 3);
+    assert(records[0].is_delta() && memcmp(&values[0], &new_row, sizeof(row)) == 0);
+    assert(!records[1].is_delta() && !records[1].is_delete() && records[1].vallen == sizeof(row)
+           && memcmp(&values[1], &wide, sizeof(row)) == 0);
+    assert(records[2].is_delete() && records[2].vallen == 0 && records[2].object_id == 2);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// A compressed log recovers as the uncompressed one would
+void testCompressedLog() {
+    TThread::set_id(0);
+    if (!TxnLog::set_compression(true)) {
+        assert(!TxnLog::compression());
+        printf("SKIP: %s (no liblz4)\n", __FUNCTION__);
+        return;
+    }
+    std::string dir = make_dir();
+    TBox<int> a, b;
+    a.set_log_id(1);
+    b.set_log_id(2);
+    assert(TxnLog::start(dir.c_str(), 2));
+    for (int i = 0; i != 2000; ++i) {
+        TRANSACTION_E {
+            a = i;
+            b = i / 2;
+        } RETRY_E(false);
+        if (i % 500 == 0)
+            advance_until_durable(TxnLog::last_epoch());
+    }
+    TxnLog::stop();
+    assert(TxnLog::written_bytes() < TxnLog::logged_bytes() / 2);
+    auto values = recover(dir);
+    assert(values.size() == 2 && values[1] == 1999 && values[2] == 999);
+
+    // a new log, partly uncompressed
+    assert(TxnLog::start(dir.c_str(), 2));
+    TRANSACTION_E {
+        a = -1;
+    } RETRY_E(false);
+    advance_until_durable(TxnLog::last_epoch());
+    TxnLog::set_compression(false);
+    TRANSACTION_E {
+        b = -2;
+    } RETRY_E(false);
+    TxnLog::stop();
+    values = recover(dir);
+    assert(values.size() == 2 && values[1] == -1 && values[2] == -2);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAsyncIO() {
+    std::string dir = make_dir();
+    for (bool use_uring : {true, false}) {
+        AsyncIO io(4, use_uring);
+        std::string path = dir + "/io";
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        assert(fd >= 0);
+        // more writes than ring entries, out of order, from a registered
+        // buffer and from an unregistered one
+        std::vector<char> fixed(4096), plain(4096);
+        for (size_t i = 0; i != fixed.size(); ++i) {
+            fixed[i] = char(i * 7);
+            plain[i] = char(i * 13);
+        }
+        struct iovec iov = {fixed.data(), fixed.size()};
+        io.register_buffers(&iov, 1);
+        for (int k = 15; k >= 0; --k) {
+            const std::vector<char>& src = k % 2 ? plain : fixed;
+            io.write(fd, src.data() + k * 256, 256, k * 256);
+        }
+        io.sync(fd);
+        io.submit();
+        assert(io.wait());
+        std::vector<char> back(4096);
+        assert(pread(fd, back.data(), back.size(), 0) == ssize_t(back.size()));
+        for (size_t i = 0; i != back.size(); ++i)
+            assert(back[i] == ((i / 256) % 2 ? plain[i] : fixed[i]));
+        close(fd);
+
+        // a failed write fails the next wait, and only that one
+        io.write(fd, fixed.data(), 16, 0);
+        assert(!io.flush());
+        assert(io.flush());
+    }
+    AsyncIO::stats s = AsyncIO::statistics();
+    assert(s.fallback_batches > 0 && s.ops >= 2 * 17 && s.max_depth > 0);
+    remove_dir(dir);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testLogAndRecover();
+    testTornLog();
+    testDurableAcks();
+    testConcurrent();
+    testParallelRecover();
+    testDeltaRecords();
+    testCompressedLog();
+    testAsyncIO();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "Sto.hh"
+#include "TBox.hh"
+
+static std::string dump_string() {
+    char* buf = nullptr;
+    size_t len = 0;
+    FILE* f = open_memstream(&buf, &len);
+    assert(TxnTrace::dump(f));
+    fclose(f);
+    std::string s(buf, len);
+    free(buf);
+    return s;
+}
+
+static size_t count(const std::string& s, const std::string& needle) {
+    size_t n = 0;
+    for (size_t p = s.find(needle); p != std::string::npos; p = s.find(needle, p + 1))
+        ++n;
+    return n;
+}
+
+void testDisabled() {
+    TThread::set_id(0);
+    TBox<int> box;
+    TRANSACTION_E {
+        box = box + 1;
+    } RETRY_E(true);
+    std::string s = dump_string();
+    assert(s.find("\"txn\"") == std::string::npos);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testLifecycle() {
+    TThread::set_id(0);
+    TxnTrace::enable(1024);
+    TBox<int> box;
+    for (int i = 0; i != 3; ++i) {
+        TRANSACTION_E {
+            box = box + 1;
+        } RETRY_E(true);
+    }
+    TxnTrace::disable();
+    std::string s = dump_string();
+    assert(s.find("\"traceEvents\"") != std::string::npos);
+    assert(count(s, "\"name\":\"txn\",\"ph\":\"B\"") == 3);
+    assert(count(s, "\"name\":\"txn\",\"ph\":\"E\"") == 3);
+    assert(count(s, "\"name\":\"install\",\"ph\":\"B\"") == 3);
+    assert(count(s, "\"committed\":true") == 3);
+    TxnTrace::clear();
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbort() {
+    TxnTrace::enable(1024);
+    TBox<int> box;
+    {
+        TestTransaction t1(1);
+        box = box + 1;
+        TestTransaction t2(2);
+        box = 5;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+    TxnTrace::disable();
+    std::string s = dump_string();
+    assert(count(s, "\"check_fail\"") == 1);
+    assert(count(s, "\"committed\":false") == 1);
+    assert(s.find("\"thread 1\"") != std::string::npos);
+    assert(s.find("\"thread 2\"") != std::string::npos);
+    TxnTrace::clear();
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testWrap() {
+    // a ring keeps only its newest events; slices cut off by the wrap are
+    // dropped rather than left unbalanced
+    TThread::set_id(3);
+    TxnTrace::enable(16);
+    TBox<int> box;
+    for (int i = 0; i != 100; ++i) {
+        TRANSACTION_E {
+            box = box + 1;
+        } RETRY_E(true);
+    }
+    TxnTrace::disable();
+    std::string s = dump_string();
+    // 7 events per transaction: the last 16 hold 2 or 3 starts
+    size_t begins = count(s, "\"name\":\"txn\",\"ph\":\"B\"");
+    assert(begins >= 2 && begins <= 3);
+    assert(count(s, "\"name\":\"txn\",\"ph\":\"E\"") <= begins);
+    TxnTrace::clear();
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testDisabled();
+    testLifecycle();
+    testAbort();
+    testWrap();
+    return 0;
+}
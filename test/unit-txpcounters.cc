@@ -0,0 +1,76 @@
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+
+static const unsigned txp_test_ops = txp_registry::add("test_ops");
+
+void testRegistry() {
+    assert(txp_registry::size() >= 1);
+    assert(strcmp(txp_registry::name(txp_test_ops), "test_ops") == 0);
+    // the same name gets the same slot
+    assert(txp_registry::add("test_ops") == txp_test_ops);
+    unsigned c = txp_registry::add("test_other");
+    assert(c != txp_test_ops);
+    assert(txp_registry::size() > c);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testRuntimeToggle() {
+    TThread::set_id(0);
+    Transaction::clear_stats();
+    TBox<int> box;
+
+    Transaction::set_profile_counters(false);
+    TRANSACTION_E {
+        box = box + 1;
+        TXP_DYN_INCREMENT(txp_test_ops);
+    } RETRY_E(true);
+    auto out = Transaction::txp_counters_combined();
+    assert(out.p(txp_total_starts) == 0);
+    assert(out.dyn(txp_test_ops) == 0);
+
+    Transaction::set_profile_counters(true);
+    TRANSACTION_E {
+        box = box + 1;
+        TXP_DYN_ACCOUNT(txp_test_ops, 2);
+    } RETRY_E(true);
+    out = Transaction::txp_counters_combined();
+    assert(out.p(txp_total_starts) == 1);
+    assert(out.dyn(txp_test_ops) == 2);
+
+    Transaction::set_profile_counters(false);
+    Transaction::clear_stats();
+    assert(Transaction::txp_counters_combined().dyn(txp_test_ops) == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPerThread() {
+    Transaction::clear_stats();
+    Transaction::set_profile_counters(true);
+    std::vector<std::thread> thrs;
+    for (int t = 0; t != 4; ++t)
+        thrs.emplace_back([t]() {
+                TThread::set_id(t);
+                for (int i = 0; i != 1000; ++i)
+                    TXP_DYN_INCREMENT(txp_test_ops);
+            });
+    for (auto& t : thrs)
+        t.join();
+    Transaction::set_profile_counters(false);
+    for (int t = 0; t != 4; ++t)
+        assert(Transaction::tinfo[t].p_.dyn(txp_test_ops) == 1000);
+    assert(Transaction::txp_counters_combined().dyn(txp_test_ops) == 4000);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testRegistry();
+    testRuntimeToggle();
+    testPerThread();
+    return 0;
+}